@@ -228,11 +228,18 @@ exec "./{loader}" {args} "$@"
         output = script_file,
     )
 
+    runfiles = ctx.runfiles(files = [ctx.executable.loader] +
+                                    ctx.files.enclaves +
+                                    ctx.files.data)
+
+    # Executables in `data`, such as other enclave runners, bring their own
+    # runfiles.
+    for dep in ctx.attr.data:
+        runfiles = runfiles.merge(dep[DefaultInfo].default_runfiles)
+
     return [DefaultInfo(
         executable = script_file,
-        runfiles = ctx.runfiles(files = [ctx.executable.loader] +
-                                        ctx.files.enclaves +
-                                        ctx.files.data),
+        runfiles = runfiles,
     )]
 
 def _make_enclave_runner_rule(test = False):
@@ -308,6 +315,7 @@ def enclave_loader(name, enclaves, loader_args, **kwargs):
         loader_args = loader_args,
         enclaves = _invert_enclave_name_mapping(enclaves),
         data = kwargs.get("data", []),
+        visibility = kwargs.get("visibility"),
     )
 
 def sim_enclave(name, **kwargs):
@@ -528,3 +536,135 @@ def cc_enclave_test(
         testonly = 1,
         tags = ["enclave_test"] + tags,
     )
+
+def cc_enclave_benchmark(
+        name,
+        srcs,
+        enclave_config = "",
+        simulated = False,
+        benchmark_args = [],
+        tags = [],
+        deps = [],
+        **kwargs):
+    """Build target that runs google-benchmark benchmarks inside of an enclave.
+
+    This macro creates an enclave holding the benchmarks in `srcs` and the
+    benchmark shim enclave, and a runner script which loads it and runs the
+    benchmarks with `bazel run`. Results are printed as JSON unless
+    `benchmark_args` or the command line set another --benchmark_format.
+    Arguments given to the runner are passed to the benchmark library in the
+    enclave, so --benchmark_filter and --benchmark_out work as they do natively.
+
+    Args:
+      name: Name for the runner script. The enclave is named <name>.so.
+      srcs: Sources of the benchmarks, which register them with BENCHMARK().
+      enclave_config: An sgx_enclave_configuration target to be passed to the
+          enclave. Optional.
+      simulated: If True, the enclave is built with sim_enclave for the
+          simulation backend rather than for hardware.
+      benchmark_args: Arguments passed to the benchmark library. Optional.
+      tags: Label attached to the targets to allow for querying.
+      deps: Dependencies of the benchmarks.
+      **kwargs: sgx_enclave arguments.
+    """
+
+    # Create a copy of the benchmark enclave runner
+    host_loader_name = name + "_host_loader"
+    copy_from_host(
+        target = "//asylo/bazel:benchmark_shim_loader",
+        output = host_loader_name,
+        name = name + "_as_host",
+    )
+
+    enclave_name = name + ".so"
+    enclave_target = ":" + enclave_name
+
+    # Collect any arguments to sgx_enclave that override the defaults
+    enclave_kwargs = dict(kwargs)
+    enclave_kwargs.pop("data", None)
+    if enclave_config:
+        enclave_kwargs["config"] = enclave_config
+    enclave_rule = sim_enclave if simulated else sgx_enclave
+    enclave_rule(
+        name = enclave_name,
+        srcs = srcs,
+        deps = deps + ["//asylo/bazel:benchmark_shim_enclave"],
+        testonly = 1,
+        tags = tags,
+        **enclave_kwargs
+    )
+
+    # //asylo/bazel:benchmark_shim_loader expects the path to the enclave to
+    # be provided as the --enclave_path command-line flag.
+    enclaves = {"shim": enclave_target}
+    loader_args = ['--enclave_path="{shim}"', "--benchmark_format=json"]
+    _enclave_runner_script(
+        name = name,
+        loader = host_loader_name,
+        loader_args = loader_args + benchmark_args,
+        enclaves = _invert_enclave_name_mapping(enclaves),
+        data = kwargs.get("data", []),
+        testonly = 1,
+        tags = ["enclave_benchmark"] + tags,
+    )
+
+def enclave_benchmark(
+        name,
+        enclave_benchmark_name = "",
+        enclave_benchmark_config = "",
+        simulated = False,
+        benchmark_args = [],
+        srcs = [],
+        deps = [],
+        tags = [],
+        **kwargs):
+    """Build macro that builds benchmarks both natively and inside an enclave.
+
+    This macro generates a cc_binary which runs the google-benchmark benchmarks
+    in `srcs` natively, and a cc_enclave_benchmark which runs the same
+    benchmarks inside of an enclave, so that the two can be compared. Both
+    print their results as JSON by default.
+
+    Args:
+      name: Name of the native benchmark binary.
+      enclave_benchmark_name: Name for the generated cc_enclave_benchmark. If
+          not provided and name ends with "_benchmark", then defaults to name
+          with "_benchmark" replaced with "_enclave_benchmark". Otherwise
+          defaults to name appended with "_enclave".
+      enclave_benchmark_config: An sgx_enclave_configuration target to be
+          passed to the enclave. Optional.
+      simulated: If True, the enclave is built for the simulation backend.
+      benchmark_args: Arguments passed to the benchmark library of both
+          binaries. Optional.
+      srcs: Sources of the benchmarks.
+      deps: Dependencies of the benchmarks.
+      tags: Label attached to the targets to allow for querying.
+      **kwargs: cc_binary arguments.
+    """
+    native.cc_binary(
+        name = name,
+        srcs = srcs,
+        deps = deps + ["@com_github_google_benchmark//:benchmark_main"],
+        args = ["--benchmark_format=json"] + benchmark_args,
+        testonly = 1,
+        tags = ["benchmark"] + tags,
+        **kwargs
+    )
+
+    if not enclave_benchmark_name:
+        if name.endswith("_benchmark"):
+            enclave_benchmark_name = "_enclave_benchmark".join(
+                name.rsplit("_benchmark", 1),
+            )
+        else:
+            enclave_benchmark_name = name + "_enclave"
+    cc_enclave_benchmark(
+        name = enclave_benchmark_name,
+        srcs = srcs,
+        enclave_config = enclave_benchmark_config,
+        simulated = simulated,
+        benchmark_args = benchmark_args,
+        tags = tags,
+        deps = deps,
+        **kwargs
+    )
@@ -86,6 +86,45 @@ cc_library(
             strip_prefix = "googletest-release-1.8.0",
         )
 
+    # Google benchmark library. Used by benchmark targets, both native and in
+    # enclaves.
+    if "com_github_google_benchmark" not in native.existing_rules():
+        native.new_http_archive(
+            name = "com_github_google_benchmark",
+            build_file_content = """
+cc_library(
+    name = "benchmark",
+    srcs = glob(
+        [
+            "src/*.cc",
+            "src/*.h",
+        ],
+        exclude = ["src/benchmark_main.cc"],
+    ),
+    hdrs = ["include/benchmark/benchmark.h"],
+    copts = ["-DHAVE_STD_REGEX"],
+    includes = ["include"],
+    linkopts = select({
+        "@com_google_asylo//asylo": [],
+        "//conditions:default": ["-pthread"],
+    }),
+    visibility = ["//visibility:public"],
+)
+
+cc_library(
+    name = "benchmark_main",
+    srcs = ["src/benchmark_main.cc"],
+    visibility = ["//visibility:public"],
+    deps = [":benchmark"],
+)
+""",
+            # Release v1.4.1
+            urls = [
+                "https://github.com/google/benchmark/archive/v1.4.1.tar.gz",
+            ],
+            strip_prefix = "benchmark-1.4.1",
+        )
+
     # gflags
     if "com_github_gflags_gflags" not in native.existing_rules():
         native.http_archive(
@@ -0,0 +1,77 @@
+/*
+ *
+ * Copyright 2017 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <string>
+#include <vector>
+
+#include "asylo/bazel/benchmark_shim_enclave.pb.h"
+#include "asylo/trusted_application.h"
+#include "benchmark/benchmark.h"
+
+#ifdef ASYLO_PGO_GENERATE
+// Writes the execution profile collected so far. Provided by libgcov.
+extern "C" void __gcov_dump();
+#endif
+
+namespace asylo {
+
+// A TrustedApplication that runs the google-benchmark benchmarks linked into
+// the enclave.
+class BenchmarkShimEnclave : public TrustedApplication {
+ public:
+  BenchmarkShimEnclave() = default;
+
+  Status Initialize(const EnclaveConfig &config) override {
+    const BenchmarkShimEnclaveConfig &shim_config =
+        config.GetExtension(benchmark_shim_enclave_config);
+    args_.assign(shim_config.benchmark_args().begin(),
+                 shim_config.benchmark_args().end());
+    return Status::OkStatus();
+  }
+
+  Status Run(const EnclaveInput &input, EnclaveOutput *output) override {
+    char argv0[] = "benchmark_shim_enclave";
+    std::vector<char *> argv = {argv0};
+    for (std::string &arg : args_) {
+      argv.push_back(&arg[0]);
+    }
+    argv.push_back(nullptr);
+    int argc = argv.size() - 1;
+    ::benchmark::Initialize(&argc, argv.data());
+    if (::benchmark::ReportUnrecognizedArguments(argc, argv.data())) {
+      return Status(error::GoogleError::INVALID_ARGUMENT,
+                    "Unrecognized benchmark arguments");
+    }
+    ::benchmark::RunSpecifiedBenchmarks();
+#ifdef ASYLO_PGO_GENERATE
+    // Enclaves do not run exit handlers when they are destroyed, so the
+    // profile of a --config=asylo_pgo_generate build is written here.
+    __gcov_dump();
+#endif
+    return Status::OkStatus();
+  }
+
+ private:
+  std::vector<std::string> args_;
+};
+
+TrustedApplication *BuildTrustedApplication() {
+  return new BenchmarkShimEnclave;
+}
+
+}  // namespace asylo
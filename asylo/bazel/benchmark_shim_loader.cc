@@ -0,0 +1,74 @@
+/*
+ *
+ * Copyright 2017 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/bazel/benchmark_shim_enclave.pb.h"
+#include "asylo/client.h"
+#include "gflags/gflags.h"
+#include "asylo/util/logging.h"
+
+DEFINE_string(enclave_path, "", "Path to enclave to load");
+
+namespace {
+
+constexpr char kEnclaveName[] = "/benchmark_shim_enclave";
+
+}  // namespace
+
+int main(int argc, char *argv[]) {
+  // Flags other than --enclave_path are left in argv and passed to the
+  // benchmark library in the enclave.
+  google::AllowCommandLineReparsing();
+  google::ParseCommandLineFlags(&argc, &argv, true);
+
+  asylo::EnclaveConfig config;
+  asylo::BenchmarkShimEnclaveConfig *shim_config =
+      config.MutableExtension(asylo::benchmark_shim_enclave_config);
+  for (int i = 1; i < argc; ++i) {
+    shim_config->add_benchmark_args(argv[i]);
+  }
+
+  // Load the enclave
+  asylo::EnclaveManager::Configure(asylo::EnclaveManagerOptions());
+  auto manager_result = asylo::EnclaveManager::Instance();
+  if (!manager_result.ok()) {
+    LOG(QFATAL) << "Instance returned status: " << manager_result.status();
+  }
+  asylo::EnclaveManager *manager = manager_result.ValueOrDie();
+  asylo::SGXLoader loader(FLAGS_enclave_path, /*debug*/ true);
+  asylo::Status status = manager->LoadEnclave(kEnclaveName, loader, config);
+  if (!status.ok()) {
+    LOG(QFATAL) << "LoadEnclave returned status: " << status;
+  }
+
+  // Run the benchmarks
+  asylo::EnclaveClient *client = manager->GetClient(kEnclaveName);
+  asylo::EnclaveInput input;
+  status = client->EnterAndRun(input, /*output*/ nullptr);
+  if (!status.ok()) {
+    LOG(QFATAL) << "EnterAndRun returned status: " << status;
+  }
+
+  // Destroy the enclave
+  asylo::EnclaveFinal final_input;
+  status = manager->DestroyEnclave(client, final_input);
+  if (!status.ok()) {
+    LOG(QFATAL) << "DestroyEnclave returned status: " << status;
+  }
+
+  return 0;
+}
@@ -4,6 +4,10 @@ Flags specified here should not affect any ABI, but may influence warnings and
 optimizations.  They are used on top of any flags provided by the crosstool in
 use and are intended to be only used within the Asylo project (not affecting
 consumers of the Asylo project).
+
+Optimization profiles for enclave builds, which must apply to every target of
+an enclave including its dependencies, are the asylo_opt, asylo_opt_avx2,
+asylo_pgo_generate and asylo_pgo_use configs in tools/bazel.rc.
 """
 
 # Customization of compiler-generated warning output.
@@ -22,6 +22,7 @@
 #include "asylo/bazel/test_shim_enclave.pb.h"
 #include "gflags/gflags.h"
 #include "asylo/test/util/enclave_test_application.h"
+#include "asylo/test/util/performance_assertions.h"
 #include "asylo/test/util/test_flags.h"
 
 namespace asylo {
@@ -68,6 +69,10 @@ class TestShimEnclave : public EnclaveTestCase {
     char argv0[] = "placeholder";
     char *argv[] = {argv0, nullptr};
     ::testing::InitGoogleTest(&argc, argv);
+    // Record the host calls and malloc calls of each test in the results
+    // summary. The listener is owned by gtest.
+    ::testing::UnitTest::GetInstance()->listeners().Append(
+        new PerformanceCountersListener);
     CHECK_EQ(RUN_ALL_TESTS(), 0);
   }
 
@@ -0,0 +1,272 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/benchmarks/benchmark_report.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <cmath>
+#include <fstream>
+#include <map>
+#include <sstream>
+
+#include <google/protobuf/util/json_util.h>
+#include "absl/strings/ascii.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_split.h"
+#include "absl/strings/string_view.h"
+#include "absl/strings/strip.h"
+
+namespace asylo {
+namespace {
+
+int64_t MonotonicNanoseconds() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+// Returns the text between <|tag|> and </|tag|> in |xml|, or an empty string.
+std::string XmlElement(const std::string &xml, const std::string &tag) {
+  std::string open = absl::StrCat("<", tag, ">");
+  size_t start = xml.find(open);
+  if (start == std::string::npos) {
+    return "";
+  }
+  start += open.size();
+  size_t end = xml.find(absl::StrCat("</", tag, ">"), start);
+  if (end == std::string::npos) {
+    return "";
+  }
+  return std::string(
+      absl::StripAsciiWhitespace(xml.substr(start, end - start)));
+}
+
+// Parses a decimal or 0x-prefixed hexadecimal size.
+bool ParseSize(const std::string &text, uint64_t *value) {
+  absl::string_view digits = text;
+  int base = 10;
+  if (absl::ConsumePrefix(&digits, "0x") ||
+      absl::ConsumePrefix(&digits, "0X")) {
+    base = 16;
+  }
+  if (digits.empty() || !absl::ascii_isxdigit(digits[0])) {
+    return false;
+  }
+  std::string number(digits);
+  char *end = nullptr;
+  errno = 0;
+  unsigned long long parsed = strtoull(number.c_str(), &end, base);
+  if (errno != 0 || *end != '\0') {
+    return false;
+  }
+  *value = parsed;
+  return true;
+}
+
+// Returns the labels of |result| as "name=value" pairs in order of name.
+std::string ResultKey(const BenchmarkResult &result) {
+  std::map<std::string, std::string> labels(result.labels().begin(),
+                                            result.labels().end());
+  std::string key;
+  for (const auto &label : labels) {
+    absl::StrAppend(&key, key.empty() ? "" : ",", label.first, "=",
+                    label.second);
+  }
+  return key;
+}
+
+}  // namespace
+
+BenchmarkRecorder::BenchmarkRecorder(const std::string &suite)
+    : start_ns_(MonotonicNanoseconds()) {
+  report_.set_suite(suite);
+}
+
+BenchmarkResult *BenchmarkRecorder::AddResult(const Labels &labels) {
+  BenchmarkResult *result = report_.add_results();
+  for (const auto &label : labels) {
+    (*result->mutable_labels())[label.first] = label.second;
+  }
+  return result;
+}
+
+Status BenchmarkRecorder::WriteJson(const std::string &path) {
+  if (path.empty()) {
+    return Status::OkStatus();
+  }
+  report_.set_wall_seconds((MonotonicNanoseconds() - start_ns_) / 1e9);
+  return WriteJsonFile(path, report_);
+}
+
+void AddMetric(const std::string &name, double value,
+               BenchmarkMetric::Direction direction, BenchmarkResult *result) {
+  BenchmarkMetric *metric = result->add_metrics();
+  metric->set_name(name);
+  metric->set_value(value);
+  metric->set_direction(direction);
+}
+
+Status WriteJsonFile(const std::string &path,
+                     const google::protobuf::Message &message) {
+  google::protobuf::util::JsonPrintOptions options;
+  options.add_whitespace = true;
+  options.preserve_proto_field_names = true;
+  std::string json;
+  auto status =
+      google::protobuf::util::MessageToJsonString(message, &json, options);
+  if (!status.ok()) {
+    return Status(error::GoogleError::INTERNAL, status.ToString());
+  }
+  std::ofstream output(path);
+  output << json;
+  if (!output) {
+    return Status(error::GoogleError::INTERNAL,
+                  absl::StrCat("Failed to write ", path));
+  }
+  return Status::OkStatus();
+}
+
+Status ReadJsonFile(const std::string &path,
+                    google::protobuf::Message *message) {
+  std::ifstream input(path);
+  if (!input) {
+    return Status(error::GoogleError::NOT_FOUND,
+                  absl::StrCat("Failed to open ", path));
+  }
+  std::stringstream json;
+  json << input.rdbuf();
+  auto status =
+      google::protobuf::util::JsonStringToMessage(json.str(), message);
+  if (!status.ok()) {
+    return Status(error::GoogleError::INVALID_ARGUMENT,
+                  absl::StrCat(path, ": ", status.ToString()));
+  }
+  return Status::OkStatus();
+}
+
+void ParseCpuInfo(const std::string &cpuinfo, BenchmarkMachineInfo *machine) {
+  int processors = 0;
+  for (absl::string_view line : absl::StrSplit(cpuinfo, '\n')) {
+    std::pair<absl::string_view, absl::string_view> field =
+        absl::StrSplit(line, absl::MaxSplits(':', 1));
+    absl::string_view name = absl::StripAsciiWhitespace(field.first);
+    std::string value(absl::StripAsciiWhitespace(field.second));
+    if (name == "processor") {
+      ++processors;
+    }
+    // Only the first processor is described.
+    if (processors > 1) {
+      continue;
+    }
+    if (name == "model name") {
+      machine->set_cpu_model(value);
+    } else if (name == "microcode") {
+      machine->set_microcode(value);
+    } else if (name == "flags") {
+      std::vector<absl::string_view> flags =
+          absl::StrSplit(value, ' ', absl::SkipEmpty());
+      machine->set_sgx_supported(false);
+      for (absl::string_view flag : flags) {
+        if (flag == "sgx") {
+          machine->set_sgx_supported(true);
+        }
+      }
+    }
+  }
+  machine->set_logical_cpus(processors);
+}
+
+Status ParseEnclaveConfig(const std::string &xml,
+                          BenchmarkEnclaveConfig *config) {
+  uint64_t heap_max_bytes;
+  if (!ParseSize(XmlElement(xml, "HeapMaxSize"), &heap_max_bytes)) {
+    return Status(error::GoogleError::INVALID_ARGUMENT,
+                  "Enclave configuration has no HeapMaxSize");
+  }
+  uint64_t tcs_count;
+  if (!ParseSize(XmlElement(xml, "TCSNum"), &tcs_count)) {
+    return Status(error::GoogleError::INVALID_ARGUMENT,
+                  "Enclave configuration has no TCSNum");
+  }
+  config->set_heap_max_bytes(heap_max_bytes);
+  config->set_tcs_count(static_cast<int32_t>(tcs_count));
+  uint64_t stack_max_bytes;
+  if (ParseSize(XmlElement(xml, "StackMaxSize"), &stack_max_bytes)) {
+    config->set_stack_max_bytes(stack_max_bytes);
+  }
+  return Status::OkStatus();
+}
+
+std::vector<BenchmarkChange> CompareBenchmarkReports(
+    const BenchmarkReport &baseline, const BenchmarkReport &current,
+    double threshold) {
+  // The current results by suite and key.
+  std::map<std::pair<std::string, std::string>, const BenchmarkResult *>
+      current_results;
+  for (const BenchmarkSuiteReport &suite : current.suites()) {
+    for (const BenchmarkResult &result : suite.results()) {
+      current_results[{suite.suite(), ResultKey(result)}] = &result;
+    }
+  }
+
+  std::vector<BenchmarkChange> changes;
+  for (const BenchmarkSuiteReport &suite : baseline.suites()) {
+    for (const BenchmarkResult &result : suite.results()) {
+      std::string key = ResultKey(result);
+      auto found = current_results.find({suite.suite(), key});
+      if (found == current_results.end()) {
+        changes.push_back(BenchmarkChange{suite.suite(), key, "", 0.0, 0.0,
+                                          0.0, /*regression=*/true,
+                                          /*missing=*/true});
+        continue;
+      }
+      for (const BenchmarkMetric &metric : result.metrics()) {
+        const BenchmarkMetric *current_metric = nullptr;
+        for (const BenchmarkMetric &candidate : found->second->metrics()) {
+          if (candidate.name() == metric.name()) {
+            current_metric = &candidate;
+          }
+        }
+        if (!current_metric || metric.value() == 0.0) {
+          continue;
+        }
+        double relative_change =
+            (current_metric->value() - metric.value()) /
+            std::fabs(metric.value());
+        if (std::fabs(relative_change) <= threshold) {
+          continue;
+        }
+        bool regression =
+            (metric.direction() == BenchmarkMetric::HIGHER_IS_BETTER &&
+             relative_change < 0) ||
+            (metric.direction() == BenchmarkMetric::LOWER_IS_BETTER &&
+             relative_change > 0);
+        changes.push_back(BenchmarkChange{
+            suite.suite(), key, metric.name(), metric.value(),
+            current_metric->value(), relative_change, regression,
+            /*missing=*/false});
+      }
+    }
+  }
+  return changes;
+}
+
+}  // namespace asylo
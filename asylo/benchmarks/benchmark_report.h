@@ -0,0 +1,108 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_BENCHMARKS_BENCHMARK_REPORT_H_
+#define ASYLO_BENCHMARKS_BENCHMARK_REPORT_H_
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <google/protobuf/message.h>
+#include "asylo/benchmarks/benchmark_report.pb.h"
+#include "asylo/util/status.h"
+
+namespace asylo {
+
+// Collects the results printed by a benchmark driver, so that they can also
+// be written as JSON for //asylo/benchmarks:all.
+class BenchmarkRecorder {
+ public:
+  using Labels = std::vector<std::pair<std::string, std::string>>;
+
+  explicit BenchmarkRecorder(const std::string &suite);
+
+  // Adds the result of the configuration described by |labels|, and returns it
+  // for AddMetric().
+  BenchmarkResult *AddResult(const Labels &labels);
+
+  // Writes the results as JSON to |path|. Does nothing if |path| is empty, so
+  // that drivers can pass their --json_output flag as it is.
+  Status WriteJson(const std::string &path);
+
+  const BenchmarkSuiteReport &report() const { return report_; }
+
+ private:
+  BenchmarkSuiteReport report_;
+  int64_t start_ns_;
+};
+
+// Adds the metric |name| to |result|.
+void AddMetric(const std::string &name, double value,
+               BenchmarkMetric::Direction direction, BenchmarkResult *result);
+
+// Writes |message| as JSON to |path|.
+Status WriteJsonFile(const std::string &path,
+                     const google::protobuf::Message &message);
+
+// Reads |message| from the JSON file |path|.
+Status ReadJsonFile(const std::string &path,
+                    google::protobuf::Message *message);
+
+// Fills the processor fields of |machine| from the contents of /proc/cpuinfo.
+void ParseCpuInfo(const std::string &cpuinfo, BenchmarkMachineInfo *machine);
+
+// Fills the sizes of |config| from the XML file an enclave was signed with, as
+// written by sgx_enclave_configuration. Returns an INVALID_ARGUMENT error if
+// the heap size or TCS count is missing.
+Status ParseEnclaveConfig(const std::string &xml,
+                          BenchmarkEnclaveConfig *config);
+
+// A metric which differs between two reports.
+struct BenchmarkChange {
+  std::string suite;
+
+  // The labels of the result, as "name=value" pairs in order of name.
+  std::string result;
+
+  std::string metric;
+  double baseline;
+  double current;
+
+  // (current - baseline) / baseline.
+  double relative_change;
+
+  // Whether the metric got worse, or the result is missing from the current
+  // report.
+  bool regression;
+  bool missing;
+};
+
+// Returns the metrics of |current| which differ from those of |baseline| by
+// more than |threshold| relative to the baseline, and the results of
+// |baseline| missing from |current|. Results and metrics only in |current|,
+// and metrics with a baseline of zero, are not compared. Changes are listed in
+// the order of |baseline|.
+std::vector<BenchmarkChange> CompareBenchmarkReports(
+    const BenchmarkReport &baseline, const BenchmarkReport &current,
+    double threshold);
+
+}  // namespace asylo
+
+#endif  // ASYLO_BENCHMARKS_BENCHMARK_REPORT_H_
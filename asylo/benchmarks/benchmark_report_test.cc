@@ -0,0 +1,149 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/benchmarks/benchmark_report.h"
+
+#include <string>
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include "asylo/test/util/status_matchers.h"
+#include "asylo/test/util/test_flags.h"
+
+namespace asylo {
+namespace {
+
+using ::testing::Not;
+
+// Returns a report of the crypto suite with one result measured at |ops| ops/s
+// and |cycles| cycles/op.
+BenchmarkReport CryptoReport(double ops, double cycles) {
+  BenchmarkRecorder recorder("crypto");
+  BenchmarkResult *result =
+      recorder.AddResult({{"primitive", "SHA256"}, {"mode", "sim"}});
+  AddMetric("ops/s", ops, BenchmarkMetric::HIGHER_IS_BETTER, result);
+  AddMetric("cycles/op", cycles, BenchmarkMetric::LOWER_IS_BETTER, result);
+  BenchmarkReport report;
+  *report.add_suites() = recorder.report();
+  return report;
+}
+
+TEST(BenchmarkReportTest, RecorderWritesJson) {
+  std::string path = FLAGS_test_tmpdir + "/benchmark_report_test.json";
+  BenchmarkRecorder recorder("transition");
+  BenchmarkResult *result =
+      recorder.AddResult({{"operation", "ECALL"}, {"bytes", "64"}});
+  AddMetric("ops/s", 12345.5, BenchmarkMetric::HIGHER_IS_BETTER, result);
+  ASSERT_THAT(recorder.WriteJson(path), IsOk());
+
+  BenchmarkSuiteReport read;
+  ASSERT_THAT(ReadJsonFile(path, &read), IsOk());
+  EXPECT_EQ(read.suite(), "transition");
+  EXPECT_GE(read.wall_seconds(), 0.0);
+  ASSERT_EQ(read.results_size(), 1);
+  EXPECT_EQ(read.results(0).labels().at("operation"), "ECALL");
+  EXPECT_EQ(read.results(0).labels().at("bytes"), "64");
+  ASSERT_EQ(read.results(0).metrics_size(), 1);
+  EXPECT_EQ(read.results(0).metrics(0).value(), 12345.5);
+  EXPECT_EQ(read.results(0).metrics(0).direction(),
+            BenchmarkMetric::HIGHER_IS_BETTER);
+}
+
+TEST(BenchmarkReportTest, EmptyPathWritesNothing) {
+  BenchmarkRecorder recorder("transition");
+  EXPECT_THAT(recorder.WriteJson(""), IsOk());
+  BenchmarkSuiteReport read;
+  EXPECT_THAT(ReadJsonFile(FLAGS_test_tmpdir + "/missing.json", &read),
+              Not(IsOk()));
+}
+
+TEST(BenchmarkReportTest, ParsesFirstProcessorOfCpuInfo) {
+  const std::string cpuinfo =
+      "processor\t: 0\n"
+      "model name\t: Intel(R) Xeon(R) CPU E3-1270 v6 @ 3.80GHz\n"
+      "microcode\t: 0x8e\n"
+      "flags\t\t: fpu vme sgx smx\n"
+      "\n"
+      "processor\t: 1\n"
+      "model name\t: Other\n"
+      "microcode\t: 0x1\n";
+  BenchmarkMachineInfo machine;
+  ParseCpuInfo(cpuinfo, &machine);
+  EXPECT_EQ(machine.cpu_model(), "Intel(R) Xeon(R) CPU E3-1270 v6 @ 3.80GHz");
+  EXPECT_EQ(machine.microcode(), "0x8e");
+  EXPECT_TRUE(machine.sgx_supported());
+  EXPECT_EQ(machine.logical_cpus(), 2);
+}
+
+TEST(BenchmarkReportTest, ParsesEnclaveConfig) {
+  const std::string xml =
+      "<EnclaveConfiguration>\n"
+      "  <StackMaxSize>0x40000</StackMaxSize>\n"
+      "  <HeapMaxSize>0x100000</HeapMaxSize>\n"
+      "  <TCSNum>10</TCSNum>\n"
+      "</EnclaveConfiguration>\n";
+  BenchmarkEnclaveConfig config;
+  ASSERT_THAT(ParseEnclaveConfig(xml, &config), IsOk());
+  EXPECT_EQ(config.heap_max_bytes(), 0x100000);
+  EXPECT_EQ(config.stack_max_bytes(), 0x40000);
+  EXPECT_EQ(config.tcs_count(), 10);
+
+  EXPECT_THAT(ParseEnclaveConfig("<TCSNum>10</TCSNum>", &config), Not(IsOk()));
+  EXPECT_THAT(ParseEnclaveConfig("<HeapMaxSize>0x</HeapMaxSize><TCSNum>1"
+                                 "</TCSNum>",
+                                 &config),
+              Not(IsOk()));
+}
+
+TEST(BenchmarkReportTest, ChangesWithinThresholdAreIgnored) {
+  EXPECT_TRUE(CompareBenchmarkReports(CryptoReport(1000, 50),
+                                      CryptoReport(960, 52), 0.05)
+                  .empty());
+}
+
+TEST(BenchmarkReportTest, WorseMetricsAreRegressions) {
+  std::vector<BenchmarkChange> changes = CompareBenchmarkReports(
+      CryptoReport(1000, 50), CryptoReport(800, 40), 0.05);
+  ASSERT_EQ(changes.size(), 2);
+  EXPECT_EQ(changes[0].suite, "crypto");
+  EXPECT_EQ(changes[0].result, "mode=sim,primitive=SHA256");
+  EXPECT_EQ(changes[0].metric, "ops/s");
+  EXPECT_DOUBLE_EQ(changes[0].relative_change, -0.2);
+  EXPECT_TRUE(changes[0].regression);
+  EXPECT_EQ(changes[1].metric, "cycles/op");
+  EXPECT_FALSE(changes[1].regression);
+}
+
+TEST(BenchmarkReportTest, MissingResultsAreRegressions) {
+  BenchmarkReport current = CryptoReport(1000, 50);
+  (*current.mutable_suites(0)->mutable_results(0)->mutable_labels())["mode"] =
+      "hw";
+  std::vector<BenchmarkChange> changes =
+      CompareBenchmarkReports(CryptoReport(1000, 50), current, 0.05);
+  ASSERT_EQ(changes.size(), 1);
+  EXPECT_TRUE(changes[0].missing);
+  EXPECT_TRUE(changes[0].regression);
+
+  // Results only in the current report are not compared.
+  EXPECT_TRUE(
+      CompareBenchmarkReports(BenchmarkReport(), current, 0.05).empty());
+}
+
+}  // namespace
+}  // namespace asylo
@@ -0,0 +1,272 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+// Runs the benchmark suites of Asylo one after another with the same flags and
+// on the same processors, and combines their results into one JSON report
+// with the machine and the enclave configuration they ran on. Given a
+// baseline report, lists the metrics which changed by more than
+// --regression_threshold and exits with status 1 if any got worse, so that a
+// performance regression fails like a test.
+//
+// Whether the enclaves run in hardware or simulation mode is decided when they
+// are built; pass --enclave_label to tell the two apart in the report. The
+// suites are found relative to the working directory, which the runner script
+// sets to the root of its runfiles.
+
+#include <sched.h>
+#include <stdio.h>
+#include <sys/utsname.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "absl/strings/ascii.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_split.h"
+#include "asylo/benchmarks/benchmark_report.h"
+#include "asylo/util/logging.h"
+#include "gflags/gflags.h"
+
+DEFINE_string(suites, "transition,socket,storage,crypto,identity,handshake,"
+                      "translator",
+              "Comma-separated benchmark suites to run");
+DEFINE_string(modes, "native,enclave",
+              "Comma-separated modes passed to the suites which take them");
+DEFINE_string(enclave_label, "enclave",
+              "Name reported for the enclave mode, e.g. sim or hw");
+DEFINE_string(cpus, "",
+              "Comma-separated processors to run the suites on, or empty for "
+              "all");
+DEFINE_string(enclave_config, "",
+              "sgx_enclave_configuration XML the suite enclaves were signed "
+              "with");
+DEFINE_string(output, "/tmp/asylo_benchmark_report.json",
+              "File to write the combined report to");
+DEFINE_string(baseline, "", "Report to compare the results against");
+DEFINE_double(regression_threshold, 0.1,
+              "Relative change of a metric from the baseline which is "
+              "reported");
+DEFINE_string(work_dir, "/tmp", "Directory for the results of each suite");
+
+namespace asylo {
+namespace {
+
+// A benchmark suite and the runner script of its driver.
+struct Suite {
+  const char *name;
+  const char *runner;
+
+  // Whether the driver takes --modes. The others only run in the enclave.
+  bool takes_modes;
+};
+
+constexpr Suite kSuites[] = {
+    {"transition", "asylo/platform/arch/transition_benchmark", true},
+    {"socket", "asylo/platform/posix/sockets/socket_benchmark", true},
+    {"storage", "asylo/platform/storage/secure/storage_benchmark", false},
+    {"crypto", "asylo/crypto/crypto_benchmark", true},
+    {"identity", "asylo/identity/sgx/identity_benchmark", true},
+    {"handshake", "asylo/grpc/auth/test/handshake_benchmark", true},
+    {"translator", "asylo/examples/grpc_server/translator_benchmark", true},
+};
+
+std::string ReadFile(const std::string &path) {
+  std::ifstream file(path);
+  std::stringstream contents;
+  contents << file.rdbuf();
+  return contents.str();
+}
+
+// Restricts this process, and so the suites it starts, to the processors in
+// |cpus|.
+void SetAffinity(const std::string &cpus) {
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  for (const auto &cpu : absl::StrSplit(cpus, ',')) {
+    int value;
+    if (!absl::SimpleAtoi(cpu, &value) || value < 0 || value >= CPU_SETSIZE) {
+      LOG(QFATAL) << "Invalid processor: " << cpu;
+    }
+    CPU_SET(value, &set);
+  }
+  if (sched_setaffinity(0, sizeof(set), &set) != 0) {
+    LOG(QFATAL) << "Failed to run on processors " << cpus;
+  }
+}
+
+BenchmarkMachineInfo CollectMachineInfo() {
+  BenchmarkMachineInfo machine;
+  struct utsname name;
+  if (uname(&name) == 0) {
+    machine.set_hostname(name.nodename);
+    machine.set_kernel(absl::StrCat(name.sysname, " ", name.release));
+  }
+  ParseCpuInfo(ReadFile("/proc/cpuinfo"), &machine);
+  std::string governor(absl::StripAsciiWhitespace(
+      ReadFile("/sys/devices/system/cpu/cpu0/cpufreq/scaling_governor")));
+  if (!governor.empty()) {
+    machine.set_cpu_governor(governor);
+  }
+  machine.set_cpu_affinity(FLAGS_cpus);
+  return machine;
+}
+
+// Runs |suite| and reads its results into |report|. Returns false if the suite
+// fails.
+bool RunSuite(const Suite &suite, BenchmarkSuiteReport *report) {
+  std::string json_path =
+      absl::StrCat(FLAGS_work_dir, "/asylo_benchmark_", suite.name, "_",
+                   getpid(), ".json");
+  std::vector<std::string> args = {
+      suite.runner, absl::StrCat("--enclave_label=", FLAGS_enclave_label),
+      absl::StrCat("--json_output=", json_path)};
+  if (suite.takes_modes) {
+    args.push_back(absl::StrCat("--modes=", FLAGS_modes));
+  }
+
+  printf("\n==== %s\n", suite.name);
+  fflush(stdout);
+  pid_t pid = fork();
+  if (pid == 0) {
+    std::vector<char *> argv;
+    for (std::string &arg : args) {
+      argv.push_back(&arg[0]);
+    }
+    argv.push_back(nullptr);
+    execv(argv[0], argv.data());
+    perror(argv[0]);
+    _exit(127);
+  }
+  int status = 0;
+  if (pid < 0 || waitpid(pid, &status, 0) != pid || !WIFEXITED(status) ||
+      WEXITSTATUS(status) != 0) {
+    LOG(ERROR) << "Suite " << suite.name << " failed";
+    return false;
+  }
+
+  Status read_status = ReadJsonFile(json_path, report);
+  unlink(json_path.c_str());
+  if (!read_status.ok()) {
+    LOG(ERROR) << "Suite " << suite.name << " wrote no results: "
+               << read_status;
+    return false;
+  }
+  return true;
+}
+
+// Prints the changes of |report| from the report in |baseline_path|, and
+// returns the number of regressions.
+int CompareWithBaseline(const BenchmarkReport &report,
+                        const std::string &baseline_path) {
+  BenchmarkReport baseline;
+  Status status = ReadJsonFile(baseline_path, &baseline);
+  if (!status.ok()) {
+    LOG(QFATAL) << status;
+  }
+  if (baseline.machine().cpu_model() != report.machine().cpu_model() ||
+      baseline.machine().microcode() != report.machine().microcode()) {
+    LOG(WARNING) << "The baseline ran on a different processor or microcode";
+  }
+
+  std::vector<BenchmarkChange> changes =
+      CompareBenchmarkReports(baseline, report, FLAGS_regression_threshold);
+  int regressions = 0;
+  printf("\n%-10s %-10s %-64s %-16s %12s %12s %8s\n", "change", "suite",
+         "result", "metric", "baseline", "current", "delta");
+  for (const BenchmarkChange &change : changes) {
+    if (change.regression) {
+      ++regressions;
+    }
+    if (change.missing) {
+      printf("%-10s %-10s %-64s\n", "MISSING", change.suite.c_str(),
+             change.result.c_str());
+      continue;
+    }
+    printf("%-10s %-10s %-64s %-16s %12.1f %12.1f %7.1f%%\n",
+           change.regression ? "REGRESSED" : "improved", change.suite.c_str(),
+           change.result.c_str(), change.metric.c_str(), change.baseline,
+           change.current, change.relative_change * 100);
+  }
+  printf("%d of %zu changed metrics regressed beyond %.0f%%\n", regressions,
+         changes.size(), FLAGS_regression_threshold * 100);
+  return regressions;
+}
+
+}  // namespace
+}  // namespace asylo
+
+int main(int argc, char *argv[]) {
+  ::google::ParseCommandLineFlags(&argc, &argv, /*remove_flags=*/true);
+
+  std::vector<const asylo::Suite *> suites;
+  for (const auto &name : absl::StrSplit(FLAGS_suites, ',')) {
+    const asylo::Suite *found = nullptr;
+    for (const asylo::Suite &suite : asylo::kSuites) {
+      if (name == suite.name) {
+        found = &suite;
+      }
+    }
+    if (!found) {
+      LOG(QFATAL) << "Unknown suite: " << name;
+    }
+    suites.push_back(found);
+  }
+  if (!FLAGS_cpus.empty()) {
+    asylo::SetAffinity(FLAGS_cpus);
+  }
+
+  asylo::BenchmarkReport report;
+  report.set_start_time_seconds(time(nullptr));
+  *report.mutable_machine() = asylo::CollectMachineInfo();
+  asylo::BenchmarkEnclaveConfig *enclave = report.mutable_enclave();
+  enclave->set_label(FLAGS_enclave_label);
+  if (!FLAGS_enclave_config.empty()) {
+    asylo::Status status = asylo::ParseEnclaveConfig(
+        asylo::ReadFile(FLAGS_enclave_config), enclave);
+    if (!status.ok()) {
+      LOG(QFATAL) << FLAGS_enclave_config << ": " << status;
+    }
+  }
+
+  int failed_suites = 0;
+  for (const asylo::Suite *suite : suites) {
+    if (!asylo::RunSuite(*suite, report.add_suites())) {
+      report.mutable_suites()->RemoveLast();
+      ++failed_suites;
+    }
+  }
+
+  asylo::Status status = asylo::WriteJsonFile(FLAGS_output, report);
+  if (!status.ok()) {
+    LOG(QFATAL) << status;
+  }
+  printf("\nWrote %s\n", FLAGS_output.c_str());
+
+  int regressions = 0;
+  if (!FLAGS_baseline.empty()) {
+    regressions = asylo::CompareWithBaseline(report, FLAGS_baseline);
+  }
+  return failed_suites > 0 || regressions > 0 ? 1 : 0;
+}
@@ -18,21 +18,164 @@
 
 #include "asylo/crypto/aes_gcm_siv.h"
 
-#include <openssl/rand.h>
+#include <openssl/mem.h>
+#include <openssl/sha.h>
+#include <memory>
 #include <string>
+#include <utility>
 
 #include "absl/strings/str_cat.h"
 #include "asylo/crypto/util/bssl_util.h"
+#include "asylo/crypto/util/hardware_random.h"
 #include "asylo/util/status.h"
 
 namespace asylo {
+namespace internal {
+
+StatusOr<EVP_AEAD const *> AesGcmSivEvpAead(size_t key_size) {
+  // Pick the appropriate EVP_AEAD based on the key length.
+  EVP_AEAD const *const aead_128 = EVP_aead_aes_128_gcm_siv();
+  EVP_AEAD const *const aead_256 = EVP_aead_aes_256_gcm_siv();
+
+  if (key_size == EVP_AEAD_key_length(aead_128)) {
+    return aead_128;
+  } else if (key_size == EVP_AEAD_key_length(aead_256)) {
+    return aead_256;
+  } else {
+    return Status(error::GoogleError::INVALID_ARGUMENT,
+                  absl::StrCat("Key size ", key_size, " is invalid"));
+  }
+}
+
+}  // namespace internal
 
 Status AesGcmSivNonceGenerator::NextNonce(
     const std::vector<uint8_t> &key_id,
     AesGcmSivNonceGenerator::AesGcmSivNonce *nonce) {
-  if (RAND_bytes(nonce->data(), nonce->size()) != 1) {
+  if (!GetHardwareRandBytes(nonce->data(), nonce->size())) {
+    return Status(error::GoogleError::INTERNAL,
+                  absl::StrCat("Failed to generate nonce: ",
+                               BsslLastErrorString()));
+  }
+  return Status::OkStatus();
+}
+
+constexpr size_t AesGcmSivKeyedCryptor::kTagSize;
+
+StatusOr<std::unique_ptr<AesGcmSivKeyedCryptor>> AesGcmSivKeyedCryptor::Create(
+    ByteContainerView key, size_t message_size_limit,
+    NonceGenerator<kAesGcmSivNonceSize> *nonce_generator) {
+  std::unique_ptr<AesGcmSivKeyedCryptor> cryptor(
+      new AesGcmSivKeyedCryptor(message_size_limit, nonce_generator));
+
+  StatusOr<EVP_AEAD const *> aead_result =
+      internal::AesGcmSivEvpAead(key.size());
+  if (!aead_result.ok()) {
+    return aead_result.status();
+  }
+  EVP_AEAD const *const aead = aead_result.ValueOrDie();
+
+  if (nonce_generator->nonce_size() != EVP_AEAD_nonce_length(aead)) {
+    return Status(error::GoogleError::INVALID_ARGUMENT,
+                  "NonceGenerator produces nonces of incorrect length");
+  }
+  if (EVP_AEAD_max_tag_len(aead) != kTagSize) {
+    return Status(error::GoogleError::INTERNAL,
+                  "Unexpected AES GCM SIV tag length");
+  }
+
+  // Expand the key once. Both seal and open only read from the context, so it
+  // may be shared by concurrent callers.
+  if (EVP_AEAD_CTX_init(&cryptor->context_, aead, key.data(), key.size(),
+                        kTagSize, nullptr) != 1) {
+    return Status(
+        error::GoogleError::INTERNAL,
+        absl::StrCat("EVP_AEAD_CTX_init failed: ", BsslLastErrorString()));
+  }
+  cryptor->context_initialized_ = true;
+
+  if (nonce_generator->uses_key_id()) {
+    SHA256(key.data(), key.size(), cryptor->key_id_.data());
+  }
+  return std::move(cryptor);
+}
+
+AesGcmSivKeyedCryptor::AesGcmSivKeyedCryptor(
+    size_t message_size_limit,
+    NonceGenerator<kAesGcmSivNonceSize> *nonce_generator)
+    : message_size_limit_{message_size_limit},
+      nonce_generator_{nonce_generator},
+      key_id_(SHA256_DIGEST_LENGTH) {
+  EVP_AEAD_CTX_zero(&context_);
+}
+
+AesGcmSivKeyedCryptor::~AesGcmSivKeyedCryptor() {
+  if (context_initialized_) {
+    EVP_AEAD_CTX_cleanup(&context_);
+  }
+  OPENSSL_cleanse(&context_, sizeof(context_));
+}
+
+Status AesGcmSivKeyedCryptor::Seal(ByteContainerView additional_data,
+                                   ByteContainerView plaintext,
+                                   UnsafeBytes<kAesGcmSivNonceSize> *nonce,
+                                   uint8_t *ciphertext, uint8_t *tag) {
+  if (additional_data.size() + plaintext.size() > message_size_limit_) {
+    return Status(error::GoogleError::INVALID_ARGUMENT,
+                  "Message size is too large");
+  }
+
+  // Keep a private copy of the nonce so that an entity outside this function
+  // would not be able to change its value while it is being used.
+  UnsafeBytes<kAesGcmSivNonceSize> nonce_copy;
+  Status status = nonce_generator_->NextNonce(key_id_, &nonce_copy);
+  if (!status.ok()) {
+    return status;
+  }
+
+  size_t tag_length = 0;
+  if (EVP_AEAD_CTX_seal_scatter(
+          &context_, ciphertext, tag, &tag_length, kTagSize, nonce_copy.data(),
+          nonce_copy.size(), plaintext.data(), plaintext.size(),
+          /*extra_in=*/nullptr, /*extra_in_len=*/0, additional_data.data(),
+          additional_data.size()) != 1 ||
+      tag_length != kTagSize) {
+    return Status(error::GoogleError::INTERNAL,
+                  absl::StrCat("EVP_AEAD_CTX_seal_scatter failed: ",
+                               BsslLastErrorString()));
+  }
+
+  *nonce = nonce_copy;
+  return Status::OkStatus();
+}
+
+Status AesGcmSivKeyedCryptor::Open(ByteContainerView additional_data,
+                                   ByteContainerView ciphertext,
+                                   ByteContainerView tag,
+                                   ByteContainerView nonce,
+                                   uint8_t *plaintext) {
+  if (nonce.size() != kAesGcmSivNonceSize) {
+    return Status(error::GoogleError::INVALID_ARGUMENT,
+                  "|nonce| has incorrect length");
+  }
+  if (tag.size() != kTagSize) {
+    return Status(error::GoogleError::INVALID_ARGUMENT,
+                  "|tag| has incorrect length");
+  }
+
+  // Copy the supplied nonce and tag so that an entity outside this function
+  // would not be able to change their values while they are being used.
+  UnsafeBytes<kAesGcmSivNonceSize> nonce_copy(nonce.data(), nonce.size());
+  UnsafeBytes<kTagSize> tag_copy(tag.data(), tag.size());
+
+  if (EVP_AEAD_CTX_open_gather(
+          &context_, plaintext, nonce_copy.data(), nonce_copy.size(),
+          ciphertext.data(), ciphertext.size(), tag_copy.data(),
+          tag_copy.size(), additional_data.data(),
+          additional_data.size()) != 1) {
     return Status(error::GoogleError::INTERNAL,
-                  absl::StrCat("RAND_bytes failed", BsslLastErrorString()));
+                  absl::StrCat("EVP_AEAD_CTX_open_gather failed: ",
+                               BsslLastErrorString()));
   }
   return Status::OkStatus();
 }
@@ -19,6 +19,7 @@
 #ifndef ASYLO_CRYPTO_AES_GCM_SIV_H_
 #define ASYLO_CRYPTO_AES_GCM_SIV_H_
 
+#include <openssl/aead.h>
 #include <openssl/evp.h>
 #include <openssl/sha.h>
 #include <memory>
@@ -26,6 +27,7 @@
 
 #include "absl/strings/str_cat.h"
 #include "asylo/crypto/nonce_generator.h"
+#include "asylo/crypto/util/byte_container_view.h"
 #include "asylo/crypto/util/bssl_util.h"
 #include "asylo/crypto/util/bytes.h"
 #include "asylo/util/logging.h"
@@ -37,6 +39,14 @@ namespace asylo {
 
 constexpr size_t kAesGcmSivNonceSize = 12;
 
+namespace internal {
+
+// Returns the AES GCM SIV EVP_AEAD matching a key of |key_size| bytes, or an
+// INVALID_ARGUMENT error if no such EVP_AEAD exists.
+StatusOr<EVP_AEAD const *> AesGcmSivEvpAead(size_t key_size);
+
+}  // namespace internal
+
 /// A 96-bit NonceGenerator that returns a uniformly distributed random nonce on
 /// each invocation of NextNonce().
 class AesGcmSivNonceGenerator : public NonceGenerator<kAesGcmSivNonceSize> {
@@ -326,24 +336,96 @@ class AesGcmSivCryptor {
 
  private:
   StatusOr<EVP_AEAD const *> EvpAead(size_t key_size) {
-    // Pick the appropriate EVP_AEAD based on the key length.
-    EVP_AEAD const *const aead_128 = EVP_aead_aes_128_gcm_siv();
-    EVP_AEAD const *const aead_256 = EVP_aead_aes_256_gcm_siv();
-
-    if (key_size == EVP_AEAD_key_length(aead_128)) {
-      return aead_128;
-    } else if (key_size == EVP_AEAD_key_length(aead_256)) {
-      return aead_256;
-    } else {
-      return Status(error::GoogleError::INVALID_ARGUMENT,
-                    absl::StrCat("Key size ", key_size, " is invalid"));
-    }
+    return internal::AesGcmSivEvpAead(key_size);
   }
 
   const size_t message_size_limit_;
   std::unique_ptr<NonceGenerator<kAesGcmSivNonceSize>> nonce_generator_;
 };
 
+/// An AEAD cryptor that is bound to a single AES GCM SIV key. The AES key
+/// schedule and POLYVAL state are computed once, when the cryptor is created,
+/// and are shared by all subsequent Seal() and Open() calls.
+///
+/// Unlike AesGcmSivCryptor, the Seal() and Open() methods of this class operate
+/// directly on caller-provided buffers and keep the authentication tag separate
+/// from the ciphertext, so no temporary buffers are allocated per message. The
+/// ciphertext produced by Seal() is always the same size as the plaintext.
+///
+/// If the NonceGenerator the cryptor is created with is thread-safe, then the
+/// cryptor is also thread-safe.
+class AesGcmSivKeyedCryptor {
+ public:
+  /// Size of the authentication tag produced by Seal() and consumed by Open().
+  static constexpr size_t kTagSize = 16;
+
+  /// Creates a cryptor bound to `key` that enforces the input
+  /// `message_size_limit` and utilizes `nonce_generator` to generate nonces.
+  ///
+  /// \param key A 128-bit or 256-bit AES GCM SIV key. The cryptor does not
+  ///        retain a reference to `key`.
+  /// \param message_size_limit Maximum message size supported by this cryptor.
+  /// \param nonce_generator A NonceGenerator that is used by the cryptor for
+  ///        generating nonces. The cryptor takes ownership of
+  ///        `nonce_generator`, even if creation fails.
+  /// \return The created cryptor, or a non-OK Status if `key` is invalid.
+  static StatusOr<std::unique_ptr<AesGcmSivKeyedCryptor>> Create(
+      ByteContainerView key, size_t message_size_limit,
+      NonceGenerator<kAesGcmSivNonceSize> *nonce_generator);
+
+  AesGcmSivKeyedCryptor(const AesGcmSivKeyedCryptor &) = delete;
+  AesGcmSivKeyedCryptor &operator=(const AesGcmSivKeyedCryptor &) = delete;
+
+  ~AesGcmSivKeyedCryptor();
+
+  /// Implements AEAD Authenticated Encryption (a.k.a.\ seal) functionality.
+  ///
+  /// \param additional_data Authenticated data for the seal operation.
+  /// \param plaintext The plaintext to be encrypted.
+  /// \param[out] nonce Nonce used in this sealing operation. The cryptor
+  ///             samples the nonce value from the NonceGenerator it was created
+  ///             with.
+  /// \param[out] ciphertext A buffer of at least `plaintext.size()` bytes that
+  ///             receives the ciphertext. The buffer may alias `plaintext`
+  ///             exactly, but must not otherwise overlap it.
+  /// \param[out] tag A buffer of `kTagSize` bytes that receives the
+  ///             authentication tag.
+  /// \return A non-OK Status if an error is encountered.
+  Status Seal(ByteContainerView additional_data, ByteContainerView plaintext,
+              UnsafeBytes<kAesGcmSivNonceSize> *nonce, uint8_t *ciphertext,
+              uint8_t *tag);
+
+  /// Implements AEAD Authenticated Decryption (a.k.a.\ open) functionality.
+  ///
+  /// \param additional_data Authenticated data for the open operation.
+  /// \param ciphertext The ciphertext to be decrypted.
+  /// \param tag The `kTagSize`-byte authentication tag produced by Seal().
+  /// \param nonce Nonce used in this open operation.
+  /// \param[out] plaintext A buffer of at least `ciphertext.size()` bytes that
+  ///             receives the plaintext. The buffer may alias `ciphertext`
+  ///             exactly, but must not otherwise overlap it. The contents of
+  ///             the buffer are unspecified if authentication fails.
+  /// \return A non-OK Status if an error is encountered.
+  Status Open(ByteContainerView additional_data, ByteContainerView ciphertext,
+              ByteContainerView tag, ByteContainerView nonce,
+              uint8_t *plaintext);
+
+ private:
+  AesGcmSivKeyedCryptor(size_t message_size_limit,
+                        NonceGenerator<kAesGcmSivNonceSize> *nonce_generator);
+
+  const size_t message_size_limit_;
+  std::unique_ptr<NonceGenerator<kAesGcmSivNonceSize>> nonce_generator_;
+
+  // Identifier passed to the nonce generator. Computed once from the key if
+  // the nonce generator uses key identifiers.
+  std::vector<uint8_t> key_id_;
+
+  // AEAD context holding the expanded key.
+  EVP_AEAD_CTX context_;
+  bool context_initialized_ = false;
+};
+
 }  // namespace asylo
 
 #endif  // ASYLO_CRYPTO_AES_GCM_SIV_H_
@@ -18,6 +18,7 @@
 
 #include "asylo/crypto/aes_gcm_siv.h"
 
+#include <memory>
 #include <string>
 #include <utility>
 #include <vector>
@@ -35,6 +36,8 @@
 namespace asylo {
 namespace {
 
+using ::testing::Not;
+
 // Test vector with a 128-bit key from the AES GCM SIV spec
 // (https://tools.ietf.org/html/draft-irtf-cfrg-gcmsiv-05).
 const char plaintext1_hex[] =
@@ -207,5 +210,87 @@ TYPED_TEST(TypedAesGcmSivTest, KeySize256) {
       std::equal(plaintext.cbegin(), plaintext.cend(), decrypted.cbegin()));
 }
 
+// Verifies that a keyed cryptor produces the same ciphertext as the spec test
+// vectors, with the tag written separately from the ciphertext.
+TEST(AesGcmSivKeyedCryptorTest, AesGcmSivTestVectors) {
+  const std::vector<std::pair<std::string, std::string>> inputs = {
+      {absl::HexStringToBytes(key1_hex), absl::HexStringToBytes(nonce1_hex)},
+      {absl::HexStringToBytes(key2_hex), absl::HexStringToBytes(nonce2_hex)}};
+  const std::vector<std::pair<std::string, std::string>> outputs = {
+      {absl::HexStringToBytes(plaintext1_hex),
+       absl::HexStringToBytes(ciphertext1_hex)},
+      {absl::HexStringToBytes(plaintext2_hex),
+       absl::HexStringToBytes(ciphertext2_hex)}};
+  const std::string aad = absl::HexStringToBytes(aad1_hex);
+
+  for (size_t i = 0; i < inputs.size(); ++i) {
+    const std::string &key = inputs[i].first;
+    const std::string &nonce = inputs[i].second;
+    const std::string &plaintext = outputs[i].first;
+    const std::string &expected = outputs[i].second;
+
+    auto cryptor_result = AesGcmSivKeyedCryptor::Create(
+        key, kMessageSizeLimit, new FixedNonceGenerator(nonce));
+    ASSERT_THAT(cryptor_result, IsOk());
+    std::unique_ptr<AesGcmSivKeyedCryptor> cryptor =
+        std::move(cryptor_result).ValueOrDie();
+
+    UnsafeBytes<kAesGcmSivNonceSize> tmp_nonce;
+    std::vector<uint8_t> ciphertext(plaintext.size());
+    std::vector<uint8_t> tag(AesGcmSivKeyedCryptor::kTagSize);
+    ASSERT_THAT(cryptor->Seal(aad, plaintext, &tmp_nonce, ciphertext.data(),
+                              tag.data()),
+                IsOk());
+    EXPECT_EQ(std::string(tmp_nonce.cbegin(), tmp_nonce.cend()), nonce);
+    EXPECT_EQ(std::string(ciphertext.cbegin(), ciphertext.cend()) +
+                  std::string(tag.cbegin(), tag.cend()),
+              expected);
+
+    std::vector<uint8_t> decrypted(ciphertext.size());
+    ASSERT_THAT(
+        cryptor->Open(aad, ciphertext, tag, tmp_nonce, decrypted.data()),
+        IsOk());
+    EXPECT_EQ(std::string(decrypted.cbegin(), decrypted.cend()), plaintext);
+  }
+}
+
+// Verifies that a keyed cryptor can be reused across messages, seals in place,
+// and rejects tampered tags and invalid keys.
+TEST(AesGcmSivKeyedCryptorTest, ReuseInPlaceAndTamper) {
+  const std::string bad_key(24, 'k');
+  EXPECT_THAT(AesGcmSivKeyedCryptor::Create(bad_key, kMessageSizeLimit,
+                                            new AesGcmSivNonceGenerator()),
+              Not(IsOk()));
+
+  const std::string key(32, 'k');
+  auto cryptor_result = AesGcmSivKeyedCryptor::Create(
+      key, kMessageSizeLimit, new AesGcmSivNonceGenerator());
+  ASSERT_THAT(cryptor_result, IsOk());
+  std::unique_ptr<AesGcmSivKeyedCryptor> cryptor =
+      std::move(cryptor_result).ValueOrDie();
+
+  const std::string aad(kAdditionalDataSize, 'a');
+  for (int i = 0; i < 4; ++i) {
+    const std::string plaintext(kPlaintextSize + i,
+                                static_cast<char>('p' + i));
+    std::vector<uint8_t> buffer(plaintext.cbegin(), plaintext.cend());
+    std::vector<uint8_t> tag(AesGcmSivKeyedCryptor::kTagSize);
+    UnsafeBytes<kAesGcmSivNonceSize> nonce;
+    ASSERT_THAT(cryptor->Seal(aad, buffer, &nonce, buffer.data(), tag.data()),
+                IsOk());
+    EXPECT_NE(std::string(buffer.cbegin(), buffer.cend()), plaintext);
+
+    std::vector<uint8_t> bad_tag = tag;
+    bad_tag[0] ^= 1;
+    std::vector<uint8_t> scratch(buffer.size());
+    EXPECT_THAT(cryptor->Open(aad, buffer, bad_tag, nonce, scratch.data()),
+                Not(IsOk()));
+
+    ASSERT_THAT(cryptor->Open(aad, buffer, tag, nonce, buffer.data()),
+                IsOk());
+    EXPECT_EQ(std::string(buffer.cbegin(), buffer.cend()), plaintext);
+  }
+}
+
 }  // namespace
 }  // namespace asylo
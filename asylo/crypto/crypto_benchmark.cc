@@ -0,0 +1,316 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/crypto/crypto_benchmark.h"
+
+#include <openssl/curve25519.h>
+#include <openssl/rand.h>
+#include <time.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "asylo/crypto/aes_gcm_siv.h"
+#include "asylo/crypto/ecdsa_p256_sha256_signing_key.h"
+#include "asylo/crypto/sha256_hash.h"
+#include "asylo/crypto/util/bytes.h"
+#include "asylo/crypto/util/trivial_object_util.h"
+#include "asylo/grpc/auth/core/ekep_crypto.h"
+#include "asylo/grpc/auth/core/handshake.pb.h"
+#include "asylo/platform/crypto/gcmlib/gcm_cryptor.h"
+#include "asylo/util/cleansing_types.h"
+#include "asylo/util/status_macros.h"
+
+namespace asylo {
+namespace {
+
+using platform::crypto::gcmlib::GcmCryptor;
+using platform::crypto::gcmlib::GcmCryptorKey;
+using platform::crypto::gcmlib::kTokenLength;
+
+constexpr int64_t kNanosecondsPerSecond = 1000000000;
+constexpr size_t kAesGcmSivKeySize = 32;
+constexpr size_t kTranscriptHashSize = 32;
+
+// Upper bound on the number of operations run between two clock reads, so
+// that slow primitives do not overshoot the requested duration by much.
+constexpr int64_t kMaxBatch = 1 << 16;
+
+// A single operation under measurement.
+using Operation = std::function<Status()>;
+
+int64_t MonotonicNanoseconds() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return static_cast<int64_t>(ts.tv_sec) * kNanosecondsPerSecond + ts.tv_nsec;
+}
+
+Status FailedStatus(const std::string &operation) {
+  return Status(error::GoogleError::INTERNAL,
+                absl::StrCat(operation, " failed"));
+}
+
+// Returns |size| random bytes in a container of type ContainerT.
+template <typename ContainerT>
+ContainerT RandomBytes(size_t size) {
+  ContainerT bytes(size);
+  RAND_bytes(bytes.data(), bytes.size());
+  return bytes;
+}
+
+// Runs |operation| as described by |input| and records the measurement in
+// |output|. The clock is read once per batch of operations, and batches grow
+// geometrically, so clock reads, which leave the enclave, do not dominate the
+// measurement of fast primitives.
+Status Measure(const CryptoBenchmarkInput &input, const Operation &operation,
+               CryptoBenchmarkOutput *output) {
+  for (int i = 0; i < input.warmup_ops(); ++i) {
+    ASYLO_RETURN_IF_ERROR(operation());
+  }
+
+  int64_t ops = 0;
+  int64_t batch = 1;
+  int64_t start = MonotonicNanoseconds();
+  int64_t elapsed = 0;
+  do {
+    for (int64_t i = 0; i < batch; ++i) {
+      ASYLO_RETURN_IF_ERROR(operation());
+    }
+    ops += batch;
+    batch = std::min(batch * 2, kMaxBatch);
+    elapsed = MonotonicNanoseconds() - start;
+  } while (elapsed < input.min_duration_ns());
+
+  output->set_ops(ops);
+  output->set_elapsed_ns(elapsed);
+  output->set_ops_per_second(
+      elapsed > 0 ? static_cast<double>(ops) * kNanosecondsPerSecond / elapsed
+                  : 0.0);
+  return Status::OkStatus();
+}
+
+Status BenchmarkAesGcmSiv(const CryptoBenchmarkInput &input,
+                          CryptoBenchmarkOutput *output) {
+  size_t size = input.message_size();
+  AesGcmSivCryptor cryptor(std::max<size_t>(size, 1),
+                           new AesGcmSivNonceGenerator());
+  CleansingVector<uint8_t> key =
+      RandomBytes<CleansingVector<uint8_t>>(kAesGcmSivKeySize);
+  std::vector<uint8_t> additional_data;
+  std::vector<uint8_t> plaintext = RandomBytes<std::vector<uint8_t>>(size);
+  std::vector<uint8_t> nonce;
+  std::vector<uint8_t> ciphertext;
+
+  if (input.primitive() == CryptoBenchmarkInput::AES_GCM_SIV_SEAL) {
+    return Measure(
+        input,
+        [&] {
+          return cryptor.Seal(key, additional_data, plaintext, &nonce,
+                              &ciphertext);
+        },
+        output);
+  }
+
+  ASYLO_RETURN_IF_ERROR(
+      cryptor.Seal(key, additional_data, plaintext, &nonce, &ciphertext));
+  CleansingVector<uint8_t> decrypted;
+  return Measure(
+      input,
+      [&] {
+        return cryptor.Open(key, additional_data, ciphertext, nonce,
+                            &decrypted);
+      },
+      output);
+}
+
+Status BenchmarkAesGcmSivKeyed(const CryptoBenchmarkInput &input,
+                               CryptoBenchmarkOutput *output) {
+  size_t size = input.message_size();
+  CleansingVector<uint8_t> key =
+      RandomBytes<CleansingVector<uint8_t>>(kAesGcmSivKeySize);
+  std::unique_ptr<AesGcmSivKeyedCryptor> cryptor;
+  ASYLO_ASSIGN_OR_RETURN(
+      cryptor,
+      AesGcmSivKeyedCryptor::Create(key, std::max<size_t>(size, 1),
+                                    new AesGcmSivNonceGenerator()));
+  std::vector<uint8_t> plaintext = RandomBytes<std::vector<uint8_t>>(size);
+  std::vector<uint8_t> ciphertext(size);
+  UnsafeBytes<kAesGcmSivNonceSize> nonce;
+  uint8_t tag[AesGcmSivKeyedCryptor::kTagSize];
+  return Measure(input,
+                 [&] {
+                   return cryptor->Seal(ByteContainerView(nullptr, 0),
+                                        plaintext, &nonce, ciphertext.data(),
+                                        tag);
+                 },
+                 output);
+}
+
+Status BenchmarkGcmCryptor(const CryptoBenchmarkInput &input,
+                           CryptoBenchmarkOutput *output) {
+  size_t size = input.message_size();
+  GcmCryptorKey key = TrivialRandomObject<GcmCryptorKey>();
+  std::unique_ptr<GcmCryptor> cryptor = GcmCryptor::Create(size, key);
+  if (!cryptor) {
+    return Status(error::GoogleError::INVALID_ARGUMENT,
+                  absl::StrCat("Cannot create GcmCryptor for blocks of ", size,
+                               " bytes"));
+  }
+  std::vector<uint8_t> plaintext = RandomBytes<std::vector<uint8_t>>(size);
+  std::vector<uint8_t> ciphertext(size);
+  uint8_t token[kTokenLength];
+
+  if (input.primitive() == CryptoBenchmarkInput::GCM_ENCRYPT_BLOCK) {
+    return Measure(input,
+                   [&] {
+                     return cryptor->EncryptBlock(plaintext.data(), token,
+                                                  ciphertext.data())
+                                ? Status::OkStatus()
+                                : FailedStatus("EncryptBlock");
+                   },
+                   output);
+  }
+
+  if (!cryptor->EncryptBlock(plaintext.data(), token, ciphertext.data())) {
+    return FailedStatus("EncryptBlock");
+  }
+  std::vector<uint8_t> decrypted(size);
+  return Measure(input,
+                 [&] {
+                   return cryptor->DecryptBlock(ciphertext.data(), token,
+                                                decrypted.data())
+                              ? Status::OkStatus()
+                              : FailedStatus("DecryptBlock");
+                 },
+                 output);
+}
+
+Status BenchmarkSha256(const CryptoBenchmarkInput &input,
+                       CryptoBenchmarkOutput *output) {
+  std::vector<uint8_t> message =
+      RandomBytes<std::vector<uint8_t>>(input.message_size());
+  Sha256Hash hash;
+  std::string digest;
+  return Measure(input,
+                 [&] {
+                   hash.Init();
+                   hash.Update(message.data(), message.size());
+                   digest = hash.CumulativeHash();
+                   return Status::OkStatus();
+                 },
+                 output);
+}
+
+Status BenchmarkEcdsa(const CryptoBenchmarkInput &input,
+                      CryptoBenchmarkOutput *output) {
+  std::unique_ptr<EcdsaP256Sha256SigningKey> signing_key;
+  ASYLO_ASSIGN_OR_RETURN(signing_key, EcdsaP256Sha256SigningKey::Create());
+  std::vector<uint8_t> message =
+      RandomBytes<std::vector<uint8_t>>(input.message_size());
+  std::vector<uint8_t> signature;
+
+  if (input.primitive() == CryptoBenchmarkInput::ECDSA_P256_SIGN) {
+    return Measure(input,
+                   [&] { return signing_key->Sign(message, &signature); },
+                   output);
+  }
+
+  std::unique_ptr<VerifyingKey> verifying_key;
+  ASYLO_ASSIGN_OR_RETURN(verifying_key, signing_key->GetVerifyingKey());
+  ASYLO_RETURN_IF_ERROR(signing_key->Sign(message, &signature));
+  return Measure(input,
+                 [&] { return verifying_key->Verify(message, signature); },
+                 output);
+}
+
+Status BenchmarkEkep(const CryptoBenchmarkInput &input,
+                     CryptoBenchmarkOutput *output) {
+  UnsafeBytes<X25519_PUBLIC_VALUE_LEN> peer_public_key;
+  SafeBytes<X25519_PRIVATE_KEY_LEN> peer_private_key;
+  X25519_keypair(peer_public_key.data(), peer_private_key.data());
+  UnsafeBytes<X25519_PUBLIC_VALUE_LEN> self_public_key;
+  SafeBytes<X25519_PRIVATE_KEY_LEN> self_private_key;
+  X25519_keypair(self_public_key.data(), self_private_key.data());
+  std::vector<uint8_t> transcript_hash =
+      RandomBytes<std::vector<uint8_t>>(kTranscriptHashSize);
+  CleansingVector<uint8_t> master_secret;
+  CleansingVector<uint8_t> authenticator_secret;
+
+  if (input.primitive() == CryptoBenchmarkInput::EKEP_DERIVE_SECRETS) {
+    return Measure(input,
+                   [&] {
+                     return DeriveSecrets(CURVE25519_SHA256, transcript_hash,
+                                          peer_public_key, self_private_key,
+                                          &master_secret,
+                                          &authenticator_secret);
+                   },
+                   output);
+  }
+
+  ASYLO_RETURN_IF_ERROR(DeriveSecrets(CURVE25519_SHA256, transcript_hash,
+                                      peer_public_key, self_private_key,
+                                      &master_secret, &authenticator_secret));
+  CleansingVector<uint8_t> record_protocol_key;
+  return Measure(input,
+                 [&] {
+                   return DeriveRecordProtocolKey(
+                       CURVE25519_SHA256, SEAL_AES128_GCM, transcript_hash,
+                       master_secret, &record_protocol_key);
+                 },
+                 output);
+}
+
+}  // namespace
+
+Status RunCryptoBenchmark(const CryptoBenchmarkInput &input,
+                          CryptoBenchmarkOutput *output) {
+  if (input.message_size() < 0 || input.min_duration_ns() < 0 ||
+      input.warmup_ops() < 0) {
+    return Status(error::GoogleError::INVALID_ARGUMENT,
+                  "Benchmark parameters must not be negative");
+  }
+
+  switch (input.primitive()) {
+    case CryptoBenchmarkInput::AES_GCM_SIV_SEAL:
+    case CryptoBenchmarkInput::AES_GCM_SIV_OPEN:
+      return BenchmarkAesGcmSiv(input, output);
+    case CryptoBenchmarkInput::AES_GCM_SIV_KEYED_SEAL:
+      return BenchmarkAesGcmSivKeyed(input, output);
+    case CryptoBenchmarkInput::GCM_ENCRYPT_BLOCK:
+    case CryptoBenchmarkInput::GCM_DECRYPT_BLOCK:
+      return BenchmarkGcmCryptor(input, output);
+    case CryptoBenchmarkInput::SHA256:
+      return BenchmarkSha256(input, output);
+    case CryptoBenchmarkInput::ECDSA_P256_SIGN:
+    case CryptoBenchmarkInput::ECDSA_P256_VERIFY:
+      return BenchmarkEcdsa(input, output);
+    case CryptoBenchmarkInput::EKEP_DERIVE_SECRETS:
+    case CryptoBenchmarkInput::EKEP_DERIVE_RECORD_KEY:
+      return BenchmarkEkep(input, output);
+    default:
+      return Status(error::GoogleError::INVALID_ARGUMENT,
+                    absl::StrCat("Unsupported primitive: ", input.primitive()));
+  }
+}
+
+}  // namespace asylo
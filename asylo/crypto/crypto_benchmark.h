@@ -0,0 +1,41 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_CRYPTO_CRYPTO_BENCHMARK_H_
+#define ASYLO_CRYPTO_CRYPTO_BENCHMARK_H_
+
+#include "asylo/crypto/crypto_benchmark.pb.h"
+#include "asylo/util/status.h"
+
+namespace asylo {
+
+// Sets up the primitive named by |input.primitive()| with random keys and a
+// random message of |input.message_size()| bytes, performs
+// |input.warmup_ops()| unmeasured operations, and then repeats the operation
+// until at least |input.min_duration_ns()| have elapsed. The number of
+// operations and the elapsed time are stored in |output|. Setup, such as key
+// generation and cryptor creation, is not measured.
+//
+// The same code runs natively and inside an enclave so that both columns of a
+// comparison measure identical work.
+Status RunCryptoBenchmark(const CryptoBenchmarkInput &input,
+                          CryptoBenchmarkOutput *output);
+
+}  // namespace asylo
+
+#endif  // ASYLO_CRYPTO_CRYPTO_BENCHMARK_H_
@@ -0,0 +1,217 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+// Measures throughput of the primitives in asylo/crypto and gcmlib, and of the
+// EKEP key derivation functions, inside an enclave and natively with the same
+// code. Comparing the two columns separates the cost of running in the enclave
+// from the cost of the primitive itself. Whether the enclave runs in hardware
+// or simulation mode is decided when it is built; pass --enclave_label to tell
+// the two apart in the report.
+
+#include <stdio.h>
+#include <time.h>
+#include <x86intrin.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "absl/strings/ascii.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_split.h"
+#include "asylo/benchmarks/benchmark_report.h"
+#include "asylo/client.h"
+#include "asylo/crypto/crypto_benchmark.h"
+#include "asylo/crypto/crypto_benchmark.pb.h"
+#include "asylo/util/logging.h"
+#include "gflags/gflags.h"
+
+DEFINE_string(enclave_path, "", "Path to the benchmark enclave");
+DEFINE_string(primitives,
+              "aes_gcm_siv_seal,aes_gcm_siv_open,aes_gcm_siv_keyed_seal,"
+              "gcm_encrypt_block,gcm_decrypt_block,sha256,ecdsa_p256_sign,"
+              "ecdsa_p256_verify,ekep_derive_secrets,ekep_derive_record_key",
+              "Comma-separated primitives to measure, named as in "
+              "CryptoBenchmarkInput::Primitive");
+DEFINE_string(message_sizes, "16,256,4096,65536",
+              "Comma-separated message sizes in bytes");
+DEFINE_string(modes, "native,enclave",
+              "Comma-separated locations: native and enclave");
+DEFINE_string(enclave_label, "enclave",
+              "Name reported for the enclave mode, e.g. sim or hw");
+DEFINE_int64(min_duration_ms, 200, "Minimum measured time per run");
+DEFINE_int32(warmup_ops, 10, "Unmeasured operations per run");
+DEFINE_string(json_output, "", "File to also write the results to as JSON");
+
+namespace asylo {
+namespace {
+
+constexpr char kEnclaveName[] = "crypto_benchmark";
+constexpr int64_t kNanosecondsPerMillisecond = 1000000;
+
+// Returns true if the cost of |primitive| does not depend on the message size.
+// Such primitives are measured once, and no cycles per byte are reported.
+bool IsSizeIndependent(CryptoBenchmarkInput::Primitive primitive) {
+  return primitive == CryptoBenchmarkInput::EKEP_DERIVE_SECRETS ||
+         primitive == CryptoBenchmarkInput::EKEP_DERIVE_RECORD_KEY;
+}
+
+int64_t MonotonicNanoseconds() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+// Returns the number of TSC cycles per nanosecond, measured on the host. The
+// benchmark itself only reads the clock, because rdtsc may fault inside an
+// enclave.
+double MeasureCyclesPerNanosecond() {
+  struct timespec delay = {0, 100 * kNanosecondsPerMillisecond};
+  int64_t start_ns = MonotonicNanoseconds();
+  uint64_t start_cycles = __rdtsc();
+  nanosleep(&delay, nullptr);
+  uint64_t cycles = __rdtsc() - start_cycles;
+  int64_t elapsed_ns = MonotonicNanoseconds() - start_ns;
+  return static_cast<double>(cycles) / elapsed_ns;
+}
+
+}  // namespace
+}  // namespace asylo
+
+int main(int argc, char *argv[]) {
+  ::google::ParseCommandLineFlags(&argc, &argv, /*remove_flags=*/true);
+
+  std::vector<asylo::CryptoBenchmarkInput::Primitive> primitives;
+  for (const auto &name : absl::StrSplit(FLAGS_primitives, ',')) {
+    asylo::CryptoBenchmarkInput::Primitive primitive;
+    if (!asylo::CryptoBenchmarkInput::Primitive_Parse(
+            absl::AsciiStrToUpper(name), &primitive) ||
+        primitive == asylo::CryptoBenchmarkInput::UNKNOWN) {
+      LOG(QFATAL) << "Unknown primitive: " << name;
+    }
+    primitives.push_back(primitive);
+  }
+  std::vector<int64_t> message_sizes;
+  for (const auto &size : absl::StrSplit(FLAGS_message_sizes, ',')) {
+    int64_t value;
+    if (!absl::SimpleAtoi(size, &value) || value <= 0) {
+      LOG(QFATAL) << "Invalid message size: " << size;
+    }
+    message_sizes.push_back(value);
+  }
+  std::vector<std::string> modes = absl::StrSplit(FLAGS_modes, ',');
+
+  asylo::EnclaveClient *client = nullptr;
+  asylo::EnclaveManager *manager = nullptr;
+  for (const auto &mode : modes) {
+    if (mode == "enclave") {
+      asylo::EnclaveManager::Configure(asylo::EnclaveManagerOptions());
+      auto manager_result = asylo::EnclaveManager::Instance();
+      if (!manager_result.ok()) {
+        LOG(QFATAL) << "EnclaveManager unavailable: "
+                    << manager_result.status();
+      }
+      manager = manager_result.ValueOrDie();
+      asylo::SGXLoader loader(FLAGS_enclave_path, /*debug=*/true);
+      asylo::Status status = manager->LoadEnclave(asylo::kEnclaveName, loader);
+      if (!status.ok()) {
+        LOG(QFATAL) << "Load " << FLAGS_enclave_path << " failed: " << status;
+      }
+      client = manager->GetClient(asylo::kEnclaveName);
+    } else if (mode != "native") {
+      LOG(QFATAL) << "Unknown mode: " << mode;
+    }
+  }
+
+  asylo::BenchmarkRecorder recorder("crypto");
+  double cycles_per_ns = asylo::MeasureCyclesPerNanosecond();
+  printf("%-24s %-10s %8s %12s %12s %12s\n", "primitive", "mode", "bytes",
+         "ops/s", "cycles/op", "cycles/byte");
+  for (asylo::CryptoBenchmarkInput::Primitive primitive : primitives) {
+    std::vector<int64_t> run_message_sizes = message_sizes;
+    if (asylo::IsSizeIndependent(primitive)) {
+      run_message_sizes = {0};
+    }
+    for (int64_t message_size : run_message_sizes) {
+      for (const auto &mode : modes) {
+        asylo::CryptoBenchmarkInput input;
+        input.set_primitive(primitive);
+        input.set_message_size(message_size);
+        input.set_min_duration_ns(FLAGS_min_duration_ms *
+                                  asylo::kNanosecondsPerMillisecond);
+        input.set_warmup_ops(FLAGS_warmup_ops);
+
+        asylo::CryptoBenchmarkOutput result;
+        asylo::Status status;
+        if (mode == "native") {
+          status = asylo::RunCryptoBenchmark(input, &result);
+        } else {
+          asylo::EnclaveInput enclave_input;
+          *enclave_input.MutableExtension(asylo::crypto_benchmark_input) =
+              input;
+          asylo::EnclaveOutput enclave_output;
+          status = client->EnterAndRun(enclave_input, &enclave_output);
+          result = enclave_output.GetExtension(asylo::crypto_benchmark_output);
+        }
+        if (!status.ok()) {
+          LOG(QFATAL) << "Benchmark run failed: " << status;
+        }
+
+        double cycles_per_op =
+            result.ops() > 0
+                ? result.elapsed_ns() * cycles_per_ns / result.ops()
+                : 0.0;
+        char cycles_per_byte[32] = "-";
+        if (message_size > 0) {
+          snprintf(cycles_per_byte, sizeof(cycles_per_byte), "%.2f",
+                   cycles_per_op / message_size);
+        }
+        printf("%-24s %-10s %8lld %12.0f %12.0f %12s\n",
+               asylo::CryptoBenchmarkInput::Primitive_Name(primitive).c_str(),
+               mode == "native" ? "native" : FLAGS_enclave_label.c_str(),
+               static_cast<long long>(message_size), result.ops_per_second(),
+               cycles_per_op, cycles_per_byte);
+
+        asylo::BenchmarkResult *recorded = recorder.AddResult(
+            {{"primitive",
+              asylo::CryptoBenchmarkInput::Primitive_Name(primitive)},
+             {"mode", mode == "native" ? "native" : FLAGS_enclave_label},
+             {"bytes", absl::StrCat(message_size)}});
+        asylo::AddMetric("ops/s", result.ops_per_second(),
+                         asylo::BenchmarkMetric::HIGHER_IS_BETTER, recorded);
+        asylo::AddMetric("cycles/op", cycles_per_op,
+                         asylo::BenchmarkMetric::LOWER_IS_BETTER, recorded);
+      }
+    }
+  }
+
+  if (client) {
+    asylo::EnclaveFinal final_input;
+    asylo::Status status = manager->DestroyEnclave(client, final_input);
+    if (!status.ok()) {
+      LOG(QFATAL) << "Destroy " << FLAGS_enclave_path << " failed: " << status;
+    }
+  }
+
+  asylo::Status status = recorder.WriteJson(FLAGS_json_output);
+  if (!status.ok()) {
+    LOG(QFATAL) << status;
+  }
+  return 0;
+}
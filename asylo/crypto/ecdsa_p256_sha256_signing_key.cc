@@ -21,10 +21,19 @@
 #include <openssl/bytestring.h>
 #include <openssl/crypto.h>
 #include <openssl/ecdsa.h>
+#include <openssl/evp.h>
 #include <openssl/mem.h>
 #include <openssl/nid.h>
+#include <openssl/sha.h>
+
+#include <functional>
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <vector>
 
 #include "absl/memory/memory.h"
+#include "absl/synchronization/mutex.h"
 #include "asylo/crypto/sha256_hash.h"
 #include "asylo/crypto/util/bssl_util.h"
 #include "asylo/util/status.h"
@@ -32,6 +41,13 @@
 namespace asylo {
 namespace {
 
+// Batches with at most this many signatures are verified on the calling
+// thread, since handing them to an executor costs more than it saves.
+constexpr size_t kMinParallelBatchSize = 16;
+
+// Number of signatures verified by each task of a parallel batch.
+constexpr size_t kBatchVerifyGrain = 8;
+
 // Returns an EC_KEY containing the public key corresponding to |private_key|.
 StatusOr<bssl::UniquePtr<EC_KEY>> CreatePublicKeyFromPrivateKey(
     const EC_KEY *private_key) {
@@ -48,10 +64,158 @@ StatusOr<bssl::UniquePtr<EC_KEY>> CreatePublicKeyFromPrivateKey(
   return std::move(public_key);
 }
 
+// A bounded cache of parsed public keys, keyed by their encoding. Entries are
+// evicted in least-recently-used order. Cached keys are shared by reference
+// and are never modified, so they may be used by many verifying keys at once.
+class PublicKeyCache {
+ public:
+  explicit PublicKeyCache(size_t capacity) : capacity_(capacity) {}
+
+  // Returns a new reference to the key cached for |encoding|, or nullptr if
+  // there is none.
+  bssl::UniquePtr<EC_KEY> Lookup(const std::string &encoding)
+      LOCKS_EXCLUDED(mu_) {
+    absl::MutexLock lock(&mu_);
+    auto it = entries_.find(encoding);
+    if (it == entries_.end()) {
+      return nullptr;
+    }
+    lru_.splice(lru_.begin(), lru_, it->second.position);
+    EC_KEY_up_ref(it->second.key.get());
+    return bssl::UniquePtr<EC_KEY>(it->second.key.get());
+  }
+
+  // Caches a new reference to |key| for |encoding|.
+  void Insert(const std::string &encoding, EC_KEY *key) LOCKS_EXCLUDED(mu_) {
+    absl::MutexLock lock(&mu_);
+    if (entries_.count(encoding) > 0) {
+      return;
+    }
+    if (entries_.size() >= capacity_) {
+      entries_.erase(lru_.back());
+      lru_.pop_back();
+    }
+    lru_.push_front(encoding);
+    EC_KEY_up_ref(key);
+    entries_.emplace(encoding, Entry{bssl::UniquePtr<EC_KEY>(key),
+                                     lru_.begin()});
+  }
+
+ private:
+  struct Entry {
+    bssl::UniquePtr<EC_KEY> key;
+    std::list<std::string>::iterator position;
+  };
+
+  const size_t capacity_;
+  absl::Mutex mu_;
+
+  // Encodings of the cached keys, most recently used first.
+  std::list<std::string> lru_ GUARDED_BY(mu_);
+  std::unordered_map<std::string, Entry> entries_ GUARDED_BY(mu_);
+};
+
+PublicKeyCache *GetPublicKeyCache() {
+  static PublicKeyCache *cache =
+      new PublicKeyCache(EcdsaP256Sha256VerifyingKey::kKeyCacheCapacity);
+  return cache;
+}
+
+// Tags that keep the cache entries for different encodings apart.
+constexpr char kPointEncodingTag = 'P';
+constexpr char kDerEncodingTag = 'D';
+
+using PublicKeyParser =
+    std::function<StatusOr<bssl::UniquePtr<EC_KEY>>(ByteContainerView)>;
+
+// Returns the P-256 public key with the given |tag| and |encoding| from the
+// cache, parsing it with |parse| and caching it if it is not there yet.
+StatusOr<bssl::UniquePtr<EC_KEY>> LookupOrParsePublicKey(
+    char tag, ByteContainerView encoding, const PublicKeyParser &parse) {
+  std::string cache_key(1, tag);
+  cache_key.append(reinterpret_cast<const char *>(encoding.data()),
+                   encoding.size());
+  bssl::UniquePtr<EC_KEY> key = GetPublicKeyCache()->Lookup(cache_key);
+  if (key) {
+    return std::move(key);
+  }
+
+  auto key_result = parse(encoding);
+  if (!key_result.ok()) {
+    return key_result.status();
+  }
+  key = std::move(key_result).ValueOrDie();
+  if (EC_GROUP_get_curve_name(EC_KEY_get0_group(key.get())) !=
+      NID_X9_62_prime256v1) {
+    return Status(error::GoogleError::INVALID_ARGUMENT,
+                  "Public key must be a point on the NIST P256 curve");
+  }
+  GetPublicKeyCache()->Insert(cache_key, key.get());
+  return std::move(key);
+}
+
+StatusOr<bssl::UniquePtr<EC_KEY>> ParsePublicKeyPoint(
+    ByteContainerView encoded_point) {
+  bssl::UniquePtr<EC_KEY> key(EC_KEY_new_by_curve_name(NID_X9_62_prime256v1));
+  if (!key) {
+    return Status(error::GoogleError::INTERNAL, BsslLastErrorString());
+  }
+  const EC_GROUP *group = EC_KEY_get0_group(key.get());
+  bssl::UniquePtr<EC_POINT> point(EC_POINT_new(group));
+  if (!point) {
+    return Status(error::GoogleError::INTERNAL, BsslLastErrorString());
+  }
+  // EC_POINT_oct2point() rejects points that are not on the curve.
+  if (!EC_POINT_oct2point(group, point.get(), encoded_point.data(),
+                          encoded_point.size(), /*ctx=*/nullptr) ||
+      !EC_KEY_set_public_key(key.get(), point.get())) {
+    return Status(error::GoogleError::INVALID_ARGUMENT, BsslLastErrorString());
+  }
+  return std::move(key);
+}
+
+StatusOr<bssl::UniquePtr<EC_KEY>> ParsePublicKeyDer(
+    ByteContainerView serialized_key) {
+  CBS buffer;
+  CBS_init(&buffer, serialized_key.data(), serialized_key.size());
+  bssl::UniquePtr<EVP_PKEY> evp_key(EVP_parse_public_key(&buffer));
+  if (!evp_key || CBS_len(&buffer) != 0) {
+    return Status(error::GoogleError::INVALID_ARGUMENT, BsslLastErrorString());
+  }
+  bssl::UniquePtr<EC_KEY> key(EVP_PKEY_get1_EC_KEY(evp_key.get()));
+  if (!key) {
+    return Status(error::GoogleError::INVALID_ARGUMENT,
+                  "Public key is not an elliptic curve key");
+  }
+  return std::move(key);
+}
+
 }  // namespace
 
 // EcdsaP256Sha256VerifyingKey
 
+constexpr size_t EcdsaP256Sha256VerifyingKey::kKeyCacheCapacity;
+
+StatusOr<std::unique_ptr<EcdsaP256Sha256VerifyingKey>>
+EcdsaP256Sha256VerifyingKey::CreateFromPoint(ByteContainerView encoded_point) {
+  auto key_result = LookupOrParsePublicKey(kPointEncodingTag, encoded_point,
+                                           ParsePublicKeyPoint);
+  if (!key_result.ok()) {
+    return key_result.status();
+  }
+  return Create(std::move(key_result).ValueOrDie());
+}
+
+StatusOr<std::unique_ptr<EcdsaP256Sha256VerifyingKey>>
+EcdsaP256Sha256VerifyingKey::CreateFromDer(ByteContainerView serialized_key) {
+  auto key_result = LookupOrParsePublicKey(kDerEncodingTag, serialized_key,
+                                           ParsePublicKeyDer);
+  if (!key_result.ok()) {
+    return key_result.status();
+  }
+  return Create(std::move(key_result).ValueOrDie());
+}
+
 StatusOr<std::unique_ptr<EcdsaP256Sha256VerifyingKey>>
 EcdsaP256Sha256VerifyingKey::Create(bssl::UniquePtr<EC_KEY> public_key) {
   if (EC_GROUP_get_curve_name(EC_KEY_get0_group(public_key.get())) !=
@@ -85,6 +249,45 @@ Status EcdsaP256Sha256VerifyingKey::Verify(ByteContainerView message,
   return Status::OkStatus();
 }
 
+Status EcdsaP256Sha256VerifyingKey::BatchVerify(
+    const std::vector<ByteContainerView> &messages,
+    const std::vector<ByteContainerView> &signatures,
+    std::vector<Status> *results) const {
+  if (messages.size() != signatures.size()) {
+    return Status(error::GoogleError::INVALID_ARGUMENT,
+                  "Number of messages and signatures do not match");
+  }
+  results->assign(messages.size(), Status::OkStatus());
+  if (messages.empty()) {
+    return Status::OkStatus();
+  }
+
+  std::vector<uint8_t> digests(messages.size() * SHA256_DIGEST_LENGTH);
+  Sha256Hash::HashMany(messages.data(), messages.size(), digests.data());
+
+  // Each index is written by exactly one invocation, so invocations may run
+  // concurrently. ECDSA_verify() only reads from the key.
+  auto verify_range = [this, &digests, &signatures, results](size_t begin,
+                                                              size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      if (!ECDSA_verify(/*type=*/0, &digests[i * SHA256_DIGEST_LENGTH],
+                        SHA256_DIGEST_LENGTH, signatures[i].data(),
+                        signatures[i].size(), public_key_.get())) {
+        (*results)[i] =
+            Status(error::GoogleError::INTERNAL, BsslLastErrorString());
+      }
+    }
+  };
+
+  if (batch_executor_ && messages.size() > kMinParallelBatchSize) {
+    batch_executor_->ParallelFor(0, messages.size(), kBatchVerifyGrain,
+                                 verify_range);
+  } else {
+    verify_range(0, messages.size());
+  }
+  return Status::OkStatus();
+}
+
 EcdsaP256Sha256VerifyingKey::EcdsaP256Sha256VerifyingKey(
     bssl::UniquePtr<EC_KEY> public_key)
     : public_key_(std::move(public_key)) {}
@@ -23,9 +23,11 @@
 #include <openssl/ec.h>
 
 #include <memory>
+#include <vector>
 
 #include "asylo/crypto/signing_key.h"
 #include "asylo/crypto/util/byte_container_view.h"
+#include "asylo/platform/posix/threading/work_stealing_executor.h"
 #include "asylo/util/statusor.h"
 
 namespace asylo {
@@ -34,10 +36,30 @@ namespace asylo {
 // signature verification and SHA256 for message hashing.
 class EcdsaP256Sha256VerifyingKey : public VerifyingKey {
  public:
+  // Maximum number of parsed public keys kept by the process-wide cache used
+  // by CreateFromPoint() and CreateFromDer().
+  static constexpr size_t kKeyCacheCapacity = 64;
+
   // Creates a new EcdsaP56VerifyingKey from the given |public_key|.
   static StatusOr<std::unique_ptr<EcdsaP256Sha256VerifyingKey>> Create(
       bssl::UniquePtr<EC_KEY> public_key);
 
+  // Creates a new EcdsaP256Sha256VerifyingKey from the X9.62 encoding of a
+  // public key point, which may be compressed or uncompressed.
+  //
+  // Parsed keys are shared through a process-wide cache keyed by their
+  // encoding and holding up to kKeyCacheCapacity keys in least-recently-used
+  // order, so creating a key again from the same encoding skips parsing and
+  // point validation.
+  static StatusOr<std::unique_ptr<EcdsaP256Sha256VerifyingKey>>
+  CreateFromPoint(ByteContainerView encoded_point);
+
+  // Creates a new EcdsaP256Sha256VerifyingKey from a DER-encoded
+  // SubjectPublicKeyInfo structure. Parsed keys are cached as by
+  // CreateFromPoint().
+  static StatusOr<std::unique_ptr<EcdsaP256Sha256VerifyingKey>> CreateFromDer(
+      ByteContainerView serialized_key);
+
   // From VerifyingKey.
   SignatureScheme GetSignatureScheme() const override;
 
@@ -45,11 +67,29 @@ class EcdsaP256Sha256VerifyingKey : public VerifyingKey {
   Status Verify(ByteContainerView message,
                 ByteContainerView signature) const override;
 
+  // From VerifyingKey. The messages of the batch are hashed together with
+  // Sha256Hash::HashMany(). If an executor has been set with
+  // set_batch_executor(), large batches are verified in parallel on its
+  // workers.
+  Status BatchVerify(const std::vector<ByteContainerView> &messages,
+                     const std::vector<ByteContainerView> &signatures,
+                     std::vector<Status> *results) const override;
+
+  // Sets the executor used to verify large batches in parallel, or nullptr to
+  // verify them on the calling thread. The executor is not owned, and must
+  // outlive any BatchVerify() call that uses it.
+  void set_batch_executor(WorkStealingExecutor *executor) {
+    batch_executor_ = executor;
+  }
+
  private:
   EcdsaP256Sha256VerifyingKey(bssl::UniquePtr<EC_KEY> public_key);
 
   // An ECDSA P256 public key.
   bssl::UniquePtr<EC_KEY> public_key_;
+
+  // Executor for parallel batch verification, or nullptr.
+  WorkStealingExecutor *batch_executor_ = nullptr;
 };
 
 // An implementation of the SigningKey interface that uses ECDSA-P256 keys for
@@ -19,7 +19,10 @@
 #include "asylo/crypto/ecdsa_p256_sha256_signing_key.h"
 
 #include <openssl/base.h>
+#include <openssl/bytestring.h>
 #include <openssl/ec.h>
+#include <openssl/evp.h>
+#include <openssl/mem.h>
 #include <openssl/nid.h>
 #include <openssl/rand.h>
 
@@ -32,6 +35,7 @@
 #include "absl/strings/string_view.h"
 #include "gflags/gflags.h"
 #include "asylo/util/logging.h"
+#include "asylo/platform/posix/threading/work_stealing_executor.h"
 #include "asylo/test/util/status_matchers.h"
 #include "asylo/util/cleansing_types.h"
 
@@ -139,6 +143,70 @@ TEST_F(EcdsaP256Sha256SigningKeyTest, SignAndVerify) {
   EXPECT_THAT(verifying_key->Verify(message, signature), Not(IsOk()));
 }
 
+// Verify that BatchVerify() reports the result of each signature separately,
+// both when verifying on the calling thread and on an executor.
+TEST_F(EcdsaP256Sha256SigningKeyTest, BatchVerify) {
+  bssl::UniquePtr<EC_KEY> key(EC_KEY_new_by_curve_name(NID_X9_62_prime256v1));
+  ASSERT_TRUE(EC_KEY_generate_key(key.get()));
+  bssl::UniquePtr<EC_KEY> public_key(EC_KEY_dup(key.get()));
+  ASSERT_TRUE(public_key);
+
+  auto signing_key_result = EcdsaP256Sha256SigningKey::Create(std::move(key));
+  ASSERT_THAT(signing_key_result, IsOk());
+  std::unique_ptr<EcdsaP256Sha256SigningKey> signing_key =
+      std::move(signing_key_result).ValueOrDie();
+  auto verifying_key_result =
+      EcdsaP256Sha256VerifyingKey::Create(std::move(public_key));
+  ASSERT_THAT(verifying_key_result, IsOk());
+  std::unique_ptr<EcdsaP256Sha256VerifyingKey> verifying_key =
+      std::move(verifying_key_result).ValueOrDie();
+
+  // Every fifth signature has one bit flipped.
+  constexpr int kBatchSize = 40;
+  std::vector<std::vector<uint8_t>> message_data(kBatchSize);
+  std::vector<std::vector<uint8_t>> signature_data(kBatchSize);
+  std::vector<ByteContainerView> messages;
+  std::vector<ByteContainerView> signatures;
+  for (int i = 0; i < kBatchSize; ++i) {
+    message_data[i].resize(i + 1);
+    ASSERT_TRUE(RAND_bytes(message_data[i].data(), message_data[i].size()));
+    ASSERT_THAT(signing_key->Sign(message_data[i], &signature_data[i]), IsOk());
+    if (i % 5 == 0) {
+      signature_data[i].back() ^= 1;
+    }
+    messages.emplace_back(message_data[i]);
+    signatures.emplace_back(signature_data[i]);
+  }
+
+  auto executor_result = WorkStealingExecutor::Create(/*num_workers=*/2);
+  ASSERT_THAT(executor_result, IsOk());
+  std::unique_ptr<WorkStealingExecutor> executor =
+      std::move(executor_result).ValueOrDie();
+
+  std::vector<WorkStealingExecutor *> batch_executors = {nullptr,
+                                                         executor.get()};
+  for (WorkStealingExecutor *batch_executor : batch_executors) {
+    verifying_key->set_batch_executor(batch_executor);
+    std::vector<Status> results;
+    ASSERT_THAT(verifying_key->BatchVerify(messages, signatures, &results),
+                IsOk());
+    ASSERT_EQ(results.size(), kBatchSize);
+    for (int i = 0; i < kBatchSize; ++i) {
+      if (i % 5 == 0) {
+        EXPECT_THAT(results[i], Not(IsOk())) << i;
+      } else {
+        EXPECT_THAT(results[i], IsOk()) << i;
+      }
+    }
+  }
+
+  // A batch whose messages and signatures do not match up is rejected.
+  signatures.pop_back();
+  std::vector<Status> results;
+  EXPECT_THAT(verifying_key->BatchVerify(messages, signatures, &results),
+              Not(IsOk()));
+}
+
 // Verify that SerializeToDer() and CreateFromDer() from a serialized key are
 // working correctly, and that an EcdsaP256Sha256SigningKey restored from a
 // serialized version of another EcdsaP256Sha256SigningKey can verify a
@@ -193,6 +261,116 @@ TEST_F(EcdsaP256Sha256SigningKeyTest, RestoreFromAndSerializeToDerSigningKey) {
   EXPECT_EQ(serialized_key_bin_expected, serialized_key_bin_actual);
 }
 
+// Returns the X9.62 encoding of the public key of |key| in the given |form|.
+std::vector<uint8_t> EncodePublicKeyPoint(const EC_KEY *key,
+                                          point_conversion_form_t form) {
+  const EC_GROUP *group = EC_KEY_get0_group(key);
+  const EC_POINT *point = EC_KEY_get0_public_key(key);
+  std::vector<uint8_t> encoded(
+      EC_POINT_point2oct(group, point, form, nullptr, 0, /*ctx=*/nullptr));
+  EC_POINT_point2oct(group, point, form, encoded.data(), encoded.size(),
+                     /*ctx=*/nullptr);
+  return encoded;
+}
+
+// Returns the DER-encoded SubjectPublicKeyInfo of the public key of |key|.
+std::vector<uint8_t> EncodePublicKeyDer(EC_KEY *key) {
+  bssl::UniquePtr<EVP_PKEY> evp_key(EVP_PKEY_new());
+  EVP_PKEY_set1_EC_KEY(evp_key.get(), key);
+  bssl::ScopedCBB cbb;
+  uint8_t *der = nullptr;
+  size_t der_size = 0;
+  if (!CBB_init(cbb.get(), 0) ||
+      !EVP_marshal_public_key(cbb.get(), evp_key.get()) ||
+      !CBB_finish(cbb.get(), &der, &der_size)) {
+    return {};
+  }
+  std::vector<uint8_t> encoded(der, der + der_size);
+  OPENSSL_free(der);
+  return encoded;
+}
+
+// Verify that EcdsaP256Sha256VerifyingKeys created from each encoding of a
+// public key, including repeated creations served from the key cache, verify
+// signatures made with the corresponding signing key.
+TEST_F(EcdsaP256Sha256SigningKeyTest, CreateVerifyingKeyFromEncodings) {
+  bssl::UniquePtr<EC_KEY> key(EC_KEY_new_by_curve_name(NID_X9_62_prime256v1));
+  ASSERT_TRUE(EC_KEY_generate_key(key.get()));
+  std::vector<std::vector<uint8_t>> points = {
+      EncodePublicKeyPoint(key.get(), POINT_CONVERSION_COMPRESSED),
+      EncodePublicKeyPoint(key.get(), POINT_CONVERSION_UNCOMPRESSED)};
+  std::vector<uint8_t> der = EncodePublicKeyDer(key.get());
+  ASSERT_FALSE(der.empty());
+
+  bssl::UniquePtr<EC_KEY> private_key(EC_KEY_dup(key.get()));
+  auto signing_key_result =
+      EcdsaP256Sha256SigningKey::Create(std::move(private_key));
+  ASSERT_THAT(signing_key_result, IsOk());
+  std::vector<uint8_t> message(kMessageSize);
+  ASSERT_TRUE(RAND_bytes(message.data(), kMessageSize));
+  std::vector<uint8_t> signature;
+  ASSERT_THAT(signing_key_result.ValueOrDie()->Sign(message, &signature),
+              IsOk());
+
+  for (int i = 0; i < 2; ++i) {
+    for (const std::vector<uint8_t> &point : points) {
+      auto verifying_key_result =
+          EcdsaP256Sha256VerifyingKey::CreateFromPoint(point);
+      ASSERT_THAT(verifying_key_result, IsOk());
+      EXPECT_THAT(verifying_key_result.ValueOrDie()->Verify(message, signature),
+                  IsOk());
+    }
+    auto verifying_key_result = EcdsaP256Sha256VerifyingKey::CreateFromDer(der);
+    ASSERT_THAT(verifying_key_result, IsOk());
+    EXPECT_THAT(verifying_key_result.ValueOrDie()->Verify(message, signature),
+                IsOk());
+  }
+}
+
+// Verify that invalid public key encodings are rejected every time they are
+// presented, and that keys evicted from the key cache can be created again.
+TEST_F(EcdsaP256Sha256SigningKeyTest, CreateVerifyingKeyFromInvalidEncodings) {
+  bssl::UniquePtr<EC_KEY> key(EC_KEY_new_by_curve_name(NID_X9_62_prime256v1));
+  ASSERT_TRUE(EC_KEY_generate_key(key.get()));
+  std::vector<uint8_t> point =
+      EncodePublicKeyPoint(key.get(), POINT_CONVERSION_UNCOMPRESSED);
+  // Move the point off the curve.
+  point.back() ^= 1;
+  std::vector<uint8_t> bad_key(kBadKey, kBadKey + sizeof(kBadKey));
+
+  bssl::UniquePtr<EC_KEY> bad_group_key(EC_KEY_new_by_curve_name(kBadGroup));
+  ASSERT_TRUE(EC_KEY_generate_key(bad_group_key.get()));
+  std::vector<uint8_t> bad_group_der = EncodePublicKeyDer(bad_group_key.get());
+  ASSERT_FALSE(bad_group_der.empty());
+
+  for (int i = 0; i < 2; ++i) {
+    EXPECT_THAT(EcdsaP256Sha256VerifyingKey::CreateFromPoint(point),
+                Not(IsOk()));
+    EXPECT_THAT(EcdsaP256Sha256VerifyingKey::CreateFromPoint(bad_key),
+                Not(IsOk()));
+    EXPECT_THAT(EcdsaP256Sha256VerifyingKey::CreateFromDer(bad_key),
+                Not(IsOk()));
+    EXPECT_THAT(EcdsaP256Sha256VerifyingKey::CreateFromDer(bad_group_der),
+                Not(IsOk()));
+  }
+
+  std::vector<uint8_t> first_point =
+      EncodePublicKeyPoint(key.get(), POINT_CONVERSION_COMPRESSED);
+  ASSERT_THAT(EcdsaP256Sha256VerifyingKey::CreateFromPoint(first_point),
+              IsOk());
+  for (size_t i = 0; i < EcdsaP256Sha256VerifyingKey::kKeyCacheCapacity; ++i) {
+    bssl::UniquePtr<EC_KEY> other_key(
+        EC_KEY_new_by_curve_name(NID_X9_62_prime256v1));
+    ASSERT_TRUE(EC_KEY_generate_key(other_key.get()));
+    ASSERT_THAT(EcdsaP256Sha256VerifyingKey::CreateFromPoint(
+                    EncodePublicKeyPoint(other_key.get(),
+                                         POINT_CONVERSION_COMPRESSED)),
+                IsOk());
+  }
+  EXPECT_THAT(EcdsaP256Sha256VerifyingKey::CreateFromPoint(first_point),
+              IsOk());
+}
+
 // Verify that creating an EcdsaP256Sha256SigningKey from an invalid DER
 // serialization fails.
 TEST_F(EcdsaP256Sha256SigningKeyTest, CreateFromInvalidSerializationFails) {
@@ -19,8 +19,343 @@
 #include "asylo/crypto/sha256_hash.h"
 
 #include <openssl/sha.h>
+#include <string.h>
+
+#include <algorithm>
+
+#if defined(__x86_64__)
+#include <cpuid.h>
+#include <immintrin.h>
+#endif
 
 namespace asylo {
+namespace {
+
+using internal::Sha256Implementation;
+
+constexpr size_t kBlockSize = 64;
+
+// Maximum length of the padded tail of a message.
+constexpr size_t kMaxTailSize = 2 * kBlockSize;
+
+constexpr uint32_t kInitialState[8] = {0x6a09e667, 0xbb67ae85, 0x3c6ef372,
+                                       0xa54ff53a, 0x510e527f, 0x9b05688c,
+                                       0x1f83d9ab, 0x5be0cd19};
+
+// Writes the final partial block of the |size|-byte message at |data| to
+// |tail|, followed by the SHA-256 padding. Returns the number of blocks
+// written to |tail|, which is either one or two.
+size_t PadTail(const uint8_t *data, size_t size, uint8_t tail[kMaxTailSize]) {
+  const size_t remainder = size % kBlockSize;
+  const size_t tail_blocks = remainder < kBlockSize - 8 ? 1 : 2;
+  const size_t tail_size = tail_blocks * kBlockSize;
+  if (remainder > 0) {
+    memcpy(tail, data + size - remainder, remainder);
+  }
+  tail[remainder] = 0x80;
+  memset(tail + remainder + 1, 0, tail_size - remainder - 1);
+  const uint64_t bit_length = static_cast<uint64_t>(size) * 8;
+  for (int i = 0; i < 8; ++i) {
+    tail[tail_size - 1 - i] = static_cast<uint8_t>(bit_length >> (8 * i));
+  }
+  return tail_blocks;
+}
+
+void StoreDigest(const uint32_t state[8], uint8_t *digest) {
+  for (int i = 0; i < 8; ++i) {
+    digest[4 * i] = static_cast<uint8_t>(state[i] >> 24);
+    digest[4 * i + 1] = static_cast<uint8_t>(state[i] >> 16);
+    digest[4 * i + 2] = static_cast<uint8_t>(state[i] >> 8);
+    digest[4 * i + 3] = static_cast<uint8_t>(state[i]);
+  }
+}
+
+void HashManyPortable(const ByteContainerView *inputs, size_t count,
+                      uint8_t *digests) {
+  for (size_t i = 0; i < count; ++i) {
+    ::SHA256(inputs[i].data(), inputs[i].size(),
+             digests + i * SHA256_DIGEST_LENGTH);
+  }
+}
+
+#if defined(__x86_64__)
+
+constexpr uint32_t kRoundConstants[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1,
+    0x923f82a4, 0xab1c5ed5, 0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+    0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174, 0xe49b69c1, 0xefbe4786,
+    0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147,
+    0x06ca6351, 0x14292967, 0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+    0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85, 0xa2bfe8a1, 0xa81a664b,
+    0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a,
+    0x5b9cca4f, 0x682e6ff3, 0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+    0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
+
+struct CpuFeatures {
+  bool sha_ni = false;
+  bool avx2 = false;
+};
+
+// Queries the processor for the features used by HashMany(). Inside an SGX
+// enclave CPUID is emulated from values reported by the host. A host that
+// misreports them can at worst make the enclave fault, which it can always do.
+CpuFeatures DetectCpuFeatures() {
+  CpuFeatures features;
+  unsigned int eax, ebx, ecx, edx;
+  if (__get_cpuid_max(0, nullptr) < 7 ||
+      !__get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
+    return features;
+  }
+  const bool ssse3 = (ecx & bit_SSSE3) != 0;
+  const bool sse41 = (ecx & bit_SSE4_1) != 0;
+  const bool osxsave = (ecx & bit_OSXSAVE) != 0;
+  const bool avx = (ecx & bit_AVX) != 0;
+
+  __cpuid_count(7, 0, eax, ebx, ecx, edx);
+  features.sha_ni = ssse3 && sse41 && (ebx & bit_SHA) != 0;
+
+  if (osxsave && avx && (ebx & bit_AVX2) != 0) {
+    // Check that the OS saves the YMM registers on context switches.
+    uint32_t xcr0_low, xcr0_high;
+    __asm__("xgetbv" : "=a"(xcr0_low), "=d"(xcr0_high) : "c"(0));
+    features.avx2 = (xcr0_low & 0x6) == 0x6;
+  }
+  return features;
+}
+
+const CpuFeatures &GetCpuFeatures() {
+  static const CpuFeatures features = DetectCpuFeatures();
+  return features;
+}
+
+// Runs the SHA-256 compression function over |blocks| consecutive blocks at
+// |data| using the SHA extensions.
+__attribute__((target("sha,sse4.1"))) void CompressShaNi(uint32_t state[8],
+                                                          const uint8_t *data,
+                                                          size_t blocks) {
+  const __m128i byte_swap =
+      _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+
+  // The SHA-NI round instructions operate on the state as ABEF and CDGH.
+  __m128i tmp = _mm_loadu_si128(reinterpret_cast<const __m128i *>(state));
+  __m128i state1 =
+      _mm_loadu_si128(reinterpret_cast<const __m128i *>(state + 4));
+  tmp = _mm_shuffle_epi32(tmp, 0xB1);
+  state1 = _mm_shuffle_epi32(state1, 0x1B);
+  __m128i state0 = _mm_alignr_epi8(tmp, state1, 8);
+  state1 = _mm_blend_epi16(state1, tmp, 0xF0);
+
+  for (; blocks > 0; --blocks, data += kBlockSize) {
+    const __m128i abef_save = state0;
+    const __m128i cdgh_save = state1;
+
+    // Holds the message schedule for the last four groups of four rounds.
+    __m128i schedule[4];
+    for (int group = 0; group < 16; ++group) {
+      __m128i words;
+      if (group < 4) {
+        words = _mm_shuffle_epi8(
+            _mm_loadu_si128(
+                reinterpret_cast<const __m128i *>(data + 16 * group)),
+            byte_swap);
+      } else {
+        const __m128i &w4 = schedule[group % 4];
+        const __m128i &w3 = schedule[(group + 1) % 4];
+        const __m128i &w2 = schedule[(group + 2) % 4];
+        const __m128i &w1 = schedule[(group + 3) % 4];
+        words = _mm_sha256msg2_epu32(
+            _mm_add_epi32(_mm_sha256msg1_epu32(w4, w3),
+                          _mm_alignr_epi8(w1, w2, 4)),
+            w1);
+      }
+      schedule[group % 4] = words;
+
+      __m128i message = _mm_add_epi32(
+          words, _mm_loadu_si128(reinterpret_cast<const __m128i *>(
+                     kRoundConstants + 4 * group)));
+      state1 = _mm_sha256rnds2_epu32(state1, state0, message);
+      message = _mm_shuffle_epi32(message, 0x0E);
+      state0 = _mm_sha256rnds2_epu32(state0, state1, message);
+    }
+
+    state0 = _mm_add_epi32(state0, abef_save);
+    state1 = _mm_add_epi32(state1, cdgh_save);
+  }
+
+  tmp = _mm_shuffle_epi32(state0, 0x1B);
+  state1 = _mm_shuffle_epi32(state1, 0xB1);
+  state0 = _mm_blend_epi16(tmp, state1, 0xF0);
+  state1 = _mm_alignr_epi8(state1, tmp, 8);
+  _mm_storeu_si128(reinterpret_cast<__m128i *>(state), state0);
+  _mm_storeu_si128(reinterpret_cast<__m128i *>(state + 4), state1);
+}
+
+void HashManyShaNi(const ByteContainerView *inputs, size_t count,
+                   uint8_t *digests) {
+  uint8_t tail[kMaxTailSize];
+  for (size_t i = 0; i < count; ++i) {
+    uint32_t state[8];
+    std::copy(kInitialState, kInitialState + 8, state);
+    CompressShaNi(state, inputs[i].data(), inputs[i].size() / kBlockSize);
+    size_t tail_blocks = PadTail(inputs[i].data(), inputs[i].size(), tail);
+    CompressShaNi(state, tail, tail_blocks);
+    StoreDigest(state, digests + i * SHA256_DIGEST_LENGTH);
+  }
+}
+
+constexpr size_t kLanes = 8;
+
+__attribute__((target("avx2"))) inline __m256i Rotr(__m256i x, int n) {
+  return _mm256_or_si256(_mm256_srli_epi32(x, n), _mm256_slli_epi32(x, 32 - n));
+}
+
+// Loads the big-endian word at byte |offset| of each lane's block.
+__attribute__((target("avx2"))) inline __m256i LoadWords(
+    const uint8_t *const blocks[kLanes], size_t offset) {
+  uint32_t words[kLanes];
+  for (size_t lane = 0; lane < kLanes; ++lane) {
+    const uint8_t *p = blocks[lane] + offset;
+    words[lane] = (static_cast<uint32_t>(p[0]) << 24) |
+                  (static_cast<uint32_t>(p[1]) << 16) |
+                  (static_cast<uint32_t>(p[2]) << 8) | p[3];
+  }
+  return _mm256_loadu_si256(reinterpret_cast<const __m256i *>(words));
+}
+
+// Runs the SHA-256 compression function over one block per lane. Each vector
+// in |state| holds one state word for all eight lanes.
+__attribute__((target("avx2"))) void CompressAvx2(
+    __m256i state[8], const uint8_t *const blocks[kLanes]) {
+  __m256i w[16];
+  for (int t = 0; t < 16; ++t) {
+    w[t] = LoadWords(blocks, 4 * t);
+  }
+
+  __m256i a = state[0], b = state[1], c = state[2], d = state[3];
+  __m256i e = state[4], f = state[5], g = state[6], h = state[7];
+  for (int t = 0; t < 64; ++t) {
+    if (t >= 16) {
+      const __m256i w15 = w[(t - 15) & 15];
+      const __m256i w2 = w[(t - 2) & 15];
+      const __m256i s0 = _mm256_xor_si256(
+          _mm256_xor_si256(Rotr(w15, 7), Rotr(w15, 18)),
+          _mm256_srli_epi32(w15, 3));
+      const __m256i s1 = _mm256_xor_si256(
+          _mm256_xor_si256(Rotr(w2, 17), Rotr(w2, 19)),
+          _mm256_srli_epi32(w2, 10));
+      w[t & 15] = _mm256_add_epi32(
+          _mm256_add_epi32(w[t & 15], s0),
+          _mm256_add_epi32(w[(t - 7) & 15], s1));
+    }
+
+    const __m256i sigma1 = _mm256_xor_si256(
+        _mm256_xor_si256(Rotr(e, 6), Rotr(e, 11)), Rotr(e, 25));
+    const __m256i choose =
+        _mm256_xor_si256(_mm256_and_si256(e, f), _mm256_andnot_si256(e, g));
+    const __m256i t1 = _mm256_add_epi32(
+        _mm256_add_epi32(_mm256_add_epi32(h, sigma1),
+                         _mm256_add_epi32(
+                             choose, _mm256_set1_epi32(static_cast<int>(
+                                         kRoundConstants[t])))),
+        w[t & 15]);
+    const __m256i sigma0 = _mm256_xor_si256(
+        _mm256_xor_si256(Rotr(a, 2), Rotr(a, 13)), Rotr(a, 22));
+    const __m256i majority = _mm256_xor_si256(
+        _mm256_and_si256(a, _mm256_xor_si256(b, c)), _mm256_and_si256(b, c));
+    const __m256i t2 = _mm256_add_epi32(sigma0, majority);
+
+    h = g;
+    g = f;
+    f = e;
+    e = _mm256_add_epi32(d, t1);
+    d = c;
+    c = b;
+    b = a;
+    a = _mm256_add_epi32(t1, t2);
+  }
+
+  state[0] = _mm256_add_epi32(state[0], a);
+  state[1] = _mm256_add_epi32(state[1], b);
+  state[2] = _mm256_add_epi32(state[2], c);
+  state[3] = _mm256_add_epi32(state[3], d);
+  state[4] = _mm256_add_epi32(state[4], e);
+  state[5] = _mm256_add_epi32(state[5], f);
+  state[6] = _mm256_add_epi32(state[6], g);
+  state[7] = _mm256_add_epi32(state[7], h);
+}
+
+// Hashes up to kLanes messages in parallel. Lanes are stepped together one
+// block at a time; a lane whose message has no more blocks is fed a dummy
+// block, and its digest is captured after its own last block.
+__attribute__((target("avx2"))) void HashLanesAvx2(
+    const ByteContainerView *inputs, size_t count, uint8_t *digests) {
+  static const uint8_t kDummyBlock[kBlockSize] = {};
+  uint8_t tails[kLanes][kMaxTailSize];
+  size_t full_blocks[kLanes];
+  size_t total_blocks[kLanes];
+  size_t max_blocks = 0;
+  for (size_t lane = 0; lane < count; ++lane) {
+    full_blocks[lane] = inputs[lane].size() / kBlockSize;
+    total_blocks[lane] = full_blocks[lane] +
+                         PadTail(inputs[lane].data(), inputs[lane].size(),
+                                 tails[lane]);
+    max_blocks = std::max(max_blocks, total_blocks[lane]);
+  }
+
+  __m256i state[8];
+  for (int i = 0; i < 8; ++i) {
+    state[i] = _mm256_set1_epi32(static_cast<int>(kInitialState[i]));
+  }
+
+  const uint8_t *blocks[kLanes];
+  for (size_t block = 0; block < max_blocks; ++block) {
+    for (size_t lane = 0; lane < kLanes; ++lane) {
+      if (lane >= count || block >= total_blocks[lane]) {
+        blocks[lane] = kDummyBlock;
+      } else if (block < full_blocks[lane]) {
+        blocks[lane] = inputs[lane].data() + block * kBlockSize;
+      } else {
+        blocks[lane] = tails[lane] + (block - full_blocks[lane]) * kBlockSize;
+      }
+    }
+    CompressAvx2(state, blocks);
+
+    bool lane_finished = false;
+    for (size_t lane = 0; lane < count; ++lane) {
+      lane_finished |= total_blocks[lane] == block + 1;
+    }
+    if (!lane_finished) {
+      continue;
+    }
+    uint32_t words[8][kLanes];
+    for (int i = 0; i < 8; ++i) {
+      _mm256_storeu_si256(reinterpret_cast<__m256i *>(words[i]), state[i]);
+    }
+    for (size_t lane = 0; lane < count; ++lane) {
+      if (total_blocks[lane] == block + 1) {
+        uint32_t lane_state[8];
+        for (int i = 0; i < 8; ++i) {
+          lane_state[i] = words[i][lane];
+        }
+        StoreDigest(lane_state, digests + lane * SHA256_DIGEST_LENGTH);
+      }
+    }
+  }
+}
+
+void HashManyAvx2(const ByteContainerView *inputs, size_t count,
+                  uint8_t *digests) {
+  for (size_t first = 0; first < count; first += kLanes) {
+    HashLanesAvx2(inputs + first, std::min(kLanes, count - first),
+                  digests + first * SHA256_DIGEST_LENGTH);
+  }
+}
+
+#endif  // defined(__x86_64__)
+
+}  // namespace
 
 Sha256Hash::Sha256Hash() { Init(); }
 
@@ -44,4 +379,52 @@ std::string Sha256Hash::CumulativeHash() const {
   return std::string(reinterpret_cast<char *>(digest_bytes), SHA256_DIGEST_LENGTH);
 }
 
+void Sha256Hash::HashMany(const ByteContainerView *inputs, size_t count,
+                          uint8_t *digests) {
+  Sha256Implementation implementation = Sha256Implementation::kPortable;
+  if (internal::Sha256ImplementationSupported(Sha256Implementation::kShaNi)) {
+    implementation = Sha256Implementation::kShaNi;
+  } else if (count > 1 && internal::Sha256ImplementationSupported(
+                              Sha256Implementation::kAvx2)) {
+    implementation = Sha256Implementation::kAvx2;
+  }
+  internal::Sha256HashMany(implementation, inputs, count, digests);
+}
+
+namespace internal {
+
+bool Sha256ImplementationSupported(Sha256Implementation implementation) {
+  switch (implementation) {
+    case Sha256Implementation::kPortable:
+      return true;
+#if defined(__x86_64__)
+    case Sha256Implementation::kAvx2:
+      return GetCpuFeatures().avx2;
+    case Sha256Implementation::kShaNi:
+      return GetCpuFeatures().sha_ni;
+#endif
+    default:
+      return false;
+  }
+}
+
+void Sha256HashMany(Sha256Implementation implementation,
+                    const ByteContainerView *inputs, size_t count,
+                    uint8_t *digests) {
+  switch (implementation) {
+#if defined(__x86_64__)
+    case Sha256Implementation::kAvx2:
+      HashManyAvx2(inputs, count, digests);
+      return;
+    case Sha256Implementation::kShaNi:
+      HashManyShaNi(inputs, count, digests);
+      return;
+#endif
+    default:
+      HashManyPortable(inputs, count, digests);
+      return;
+  }
+}
+
+}  // namespace internal
 }  // namespace asylo
@@ -21,9 +21,12 @@
 
 #include <openssl/sha.h>
 
+#include <cstddef>
+#include <cstdint>
 #include <string>
 
 #include "asylo/crypto/hash_interface.h"
+#include "asylo/crypto/util/byte_container_view.h"
 
 namespace asylo {
 
@@ -39,10 +42,36 @@ class Sha256Hash final : public HashInterface {
   void Update(const void *data, size_t len) override;
   std::string CumulativeHash() const override;
 
+  // Computes the SHA-256 digests of |count| independent messages, writing the
+  // digest of |inputs|[i] to the SHA256_DIGEST_LENGTH bytes at
+  // |digests| + i * SHA256_DIGEST_LENGTH.
+  //
+  // On x86-64 processors with the SHA extensions, each message is hashed with
+  // SHA-NI instructions. Otherwise, on processors with AVX2, messages are
+  // hashed eight at a time, one per vector lane. Batches of messages of equal
+  // length, such as Merkle tree nodes, benefit the most from the latter.
+  static void HashMany(const ByteContainerView *inputs, size_t count,
+                       uint8_t *digests);
+
  private:
   SHA256_CTX context_;
 };
 
+namespace internal {
+
+// Implementations available to Sha256Hash::HashMany().
+enum class Sha256Implementation { kPortable, kAvx2, kShaNi };
+
+// Returns true if |implementation| can be used on the current processor.
+bool Sha256ImplementationSupported(Sha256Implementation implementation);
+
+// Implements Sha256Hash::HashMany() with a specific |implementation|, which
+// must be supported on the current processor.
+void Sha256HashMany(Sha256Implementation implementation,
+                    const ByteContainerView *inputs, size_t count,
+                    uint8_t *digests);
+
+}  // namespace internal
 }  // namespace asylo
 
 #endif  // ASYLO_CRYPTO_SHA256_HASH_H_
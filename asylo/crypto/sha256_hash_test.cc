@@ -20,6 +20,9 @@
 
 #include <openssl/sha.h>
 
+#include <string>
+#include <vector>
+
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 #include "absl/strings/escaping.h"
@@ -91,5 +94,55 @@ TEST(Sha256HashTest, MultipleUpdates) {
   EXPECT_EQ(absl::BytesToHexString(hash.CumulativeHash()), kResult2);
 }
 
+// Verify that every HashMany() implementation supported on this processor
+// matches SHA256() on batches of messages of many different lengths,
+// including lengths that need one or two padding blocks.
+TEST(Sha256HashTest, HashManyMatchesSha256) {
+  std::vector<std::string> messages;
+  for (size_t size = 0; size < 300; ++size) {
+    std::string message;
+    for (size_t i = 0; i < size; ++i) {
+      message.push_back(static_cast<char>(size * 31 + i));
+    }
+    messages.push_back(message);
+  }
+  messages.push_back(kTestVector1);
+  messages.push_back(kTestVector2);
+
+  std::vector<ByteContainerView> inputs;
+  std::vector<uint8_t> expected(messages.size() * SHA256_DIGEST_LENGTH);
+  for (size_t i = 0; i < messages.size(); ++i) {
+    inputs.emplace_back(messages[i]);
+    ::SHA256(reinterpret_cast<const uint8_t *>(messages[i].data()),
+             messages[i].size(), &expected[i * SHA256_DIGEST_LENGTH]);
+  }
+
+  std::vector<uint8_t> digests(expected.size());
+  Sha256Hash::HashMany(inputs.data(), inputs.size(), digests.data());
+  EXPECT_EQ(digests, expected);
+
+  for (internal::Sha256Implementation implementation :
+       {internal::Sha256Implementation::kPortable,
+        internal::Sha256Implementation::kAvx2,
+        internal::Sha256Implementation::kShaNi}) {
+    if (!internal::Sha256ImplementationSupported(implementation)) {
+      continue;
+    }
+    // Hash the messages in batches of several sizes, so that the lanes of
+    // multi-buffer implementations are both full and partially filled.
+    for (size_t batch : {1, 3, 8, 13}) {
+      std::fill(digests.begin(), digests.end(), 0);
+      for (size_t first = 0; first < inputs.size(); first += batch) {
+        size_t count = std::min(batch, inputs.size() - first);
+        internal::Sha256HashMany(implementation, &inputs[first], count,
+                                 &digests[first * SHA256_DIGEST_LENGTH]);
+      }
+      EXPECT_EQ(digests, expected)
+          << "implementation " << static_cast<int>(implementation)
+          << ", batch " << batch;
+    }
+  }
+}
+
 }  // namespace
 }  // namespace asylo
@@ -20,6 +20,7 @@
 #define ASYLO_CRYPTO_SIGNING_KEY_H_
 
 #include <cstdint>
+#include <vector>
 
 #include "asylo/crypto/algorithms.pb.h"
 #include "asylo/crypto/util/byte_container_view.h"
@@ -43,6 +44,28 @@ class VerifyingKey {
   // verification.
   virtual Status Verify(ByteContainerView message,
                         ByteContainerView signature) const = 0;
+
+  // Verifies each of |signatures| against the message at the same index in
+  // |messages|, and stores the result of each verification, as Verify() would
+  // return it, at the same index in |results|. Returns a non-OK Status without
+  // verifying anything if |messages| and |signatures| differ in size.
+  //
+  // The default implementation calls Verify() on each item in turn.
+  // Implementations may amortize work across the items of a batch.
+  virtual Status BatchVerify(const std::vector<ByteContainerView> &messages,
+                             const std::vector<ByteContainerView> &signatures,
+                             std::vector<Status> *results) const {
+    if (messages.size() != signatures.size()) {
+      return Status(error::GoogleError::INVALID_ARGUMENT,
+                    "Number of messages and signatures do not match");
+    }
+    results->clear();
+    results->reserve(messages.size());
+    for (size_t i = 0; i < messages.size(); ++i) {
+      results->push_back(Verify(messages[i], signatures[i]));
+    }
+    return Status::OkStatus();
+  }
 };
 
 // SigningKey abstracts a signing key from an asymmetric key-pair.
@@ -26,6 +26,7 @@
 
 #include "absl/base/attributes.h"
 #include "asylo/crypto/util/byte_container_view.h"
+#include "asylo/crypto/util/bytes_kernels.h"
 #include "asylo/crypto/util/trivial_object_util.h"
 #include "asylo/util/logging.h"
 #include "asylo/util/cleansing_allocator.h"
@@ -220,28 +221,22 @@ class Bytes {
     return this->operator[](pos);
   }
 
-  // Cleanse the internal buffer using OPENSSL_cleanse. OPENSSL_cleanse
-  // (per documentation) cleanses memory by overwriting it with zeros.
-  // This behavior is specifically expected, and is verified through a test.
-  void Cleanse() { OPENSSL_cleanse(data_, Size); }
+  // Cleanse the internal buffer by overwriting it with zeros. This behavior is
+  // specifically expected, and is verified through a test. The size-specialized
+  // kernel is used instead of OPENSSL_cleanse so that cleansing small objects
+  // compiles to a few vector stores instead of a library call.
+  void Cleanse() { internal::Cleanse<Size>(data_); }
 
   // Determine whether the data held by this object equals the data pointed to
-  // a const void pointer. The method performs a side-channel-safe comparison
-  // if the Policy parameter is set to DataSafety::SAFE, otherwise it uses
-  // memcmp for fast comparison.
+  // a const void pointer. The comparison is performed in constant time by a
+  // size-specialized vector kernel regardless of the Policy parameter; for
+  // fixed-size objects this is no slower than memcmp.
   bool Equals(const void *data, size_t size) const {
     if (Size != size) {
       return false;
     }
-    if (Policy::policy == DataSafety::SAFE) {
-      // Since Policy parameter is set to SAFE, perform constant-time comparison
-      // to defend against side-channel leakage.
-      return (CRYPTO_memcmp(data_, data, Size) == 0);
-    } else {
-      // Since Policy parameter is set to UNSAFE, use memcmp for fast
-      // comparison.
-      return (memcmp(data_, data, Size) == 0);
-    }
+    return internal::ConstantTimeEquals<Size>(
+        data_, reinterpret_cast<const uint8_t *>(data));
   }
 
   // The resize method is included to provide API compatibility with other
@@ -383,6 +378,17 @@ class UnsafeBytes final : public Bytes<Size, UnsafePolicy, UnsafeBytes<Size>> {
   }
 } ABSL_ATTRIBUTE_PACKED;
 
+// XORs the contents of |src| into |dest|, i.e., sets each byte of |dest| to its
+// XOR with the corresponding byte of |src|. Both objects must have the same
+// size, but may have different policies. |src| and |dest| may be the same
+// object.
+template <size_t Size, typename PolicyT, typename BytesT, typename PolicyU,
+          typename BytesU>
+inline void XorInto(const Bytes<Size, PolicyT, BytesT> &src,
+                    Bytes<Size, PolicyU, BytesU> *dest) {
+  internal::XorInto<Size>(src.data(), dest->data());
+}
+
 // Stream-insertion operator for SafeBytes. Writes the hex representation of
 // |bytes| into the given |os| stream.
 template <size_t Size>
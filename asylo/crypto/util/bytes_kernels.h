@@ -0,0 +1,167 @@
+/*
+ *
+ * Copyright 2017 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_CRYPTO_UTIL_BYTES_KERNELS_H_
+#define ASYLO_CRYPTO_UTIL_BYTES_KERNELS_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+namespace asylo {
+namespace internal {
+
+// Kernels over byte buffers whose size is known at compile time. They back the
+// Equals(), Cleanse() and XorInto() operations of the Bytes template, whose
+// objects are typically 16 to 64 bytes long.
+//
+// Each kernel walks its buffers in 32-byte AVX2 chunks when the translation
+// unit is compiled with AVX2 enabled, then in 16-byte SSE2 chunks, then in
+// 8-byte words, and finally byte by byte. Because |Size| is a compile-time
+// constant, the chunk selection is resolved by the compiler and the loops are
+// fully unrolled for the small sizes that matter. All loads and stores are
+// unaligned, since Bytes objects are packed.
+//
+// ConstantTimeEquals() reads every byte of both buffers and accumulates the
+// differences without data-dependent branches, so its running time depends
+// only on |Size|.
+
+// Returns true if the |Size| bytes at |lhs| and |rhs| are equal. Runs in time
+// independent of the contents of the buffers.
+template <size_t Size>
+inline bool ConstantTimeEquals(const uint8_t *lhs, const uint8_t *rhs) {
+  size_t offset = 0;
+  uint64_t difference = 0;
+#if defined(__AVX2__)
+  if (Size >= 32) {
+    __m256i accumulator = _mm256_setzero_si256();
+    for (; offset + 32 <= Size; offset += 32) {
+      __m256i a =
+          _mm256_loadu_si256(reinterpret_cast<const __m256i *>(lhs + offset));
+      __m256i b =
+          _mm256_loadu_si256(reinterpret_cast<const __m256i *>(rhs + offset));
+      accumulator = _mm256_or_si256(accumulator, _mm256_xor_si256(a, b));
+    }
+    difference |= _mm256_testz_si256(accumulator, accumulator) ^ 1;
+  }
+#endif
+#if defined(__SSE2__)
+  if (Size - offset >= 16) {
+    __m128i accumulator = _mm_setzero_si128();
+    for (; offset + 16 <= Size; offset += 16) {
+      __m128i a =
+          _mm_loadu_si128(reinterpret_cast<const __m128i *>(lhs + offset));
+      __m128i b =
+          _mm_loadu_si128(reinterpret_cast<const __m128i *>(rhs + offset));
+      accumulator = _mm_or_si128(accumulator, _mm_xor_si128(a, b));
+    }
+    difference |= static_cast<uint32_t>(_mm_movemask_epi8(
+                      _mm_cmpeq_epi8(accumulator, _mm_setzero_si128()))) ^
+                  0xffff;
+  }
+#endif
+  for (; offset + 8 <= Size; offset += 8) {
+    uint64_t a;
+    uint64_t b;
+    memcpy(&a, lhs + offset, sizeof(a));
+    memcpy(&b, rhs + offset, sizeof(b));
+    difference |= a ^ b;
+  }
+  for (; offset < Size; ++offset) {
+    difference |= lhs[offset] ^ rhs[offset];
+  }
+  return difference == 0;
+}
+
+// Overwrites the |Size| bytes at |data| with zeros. The stores are followed by
+// a compiler barrier, so they are not elided even if |data| is never read
+// again, e.g. in a destructor.
+template <size_t Size>
+inline void Cleanse(uint8_t *data) {
+  size_t offset = 0;
+#if defined(__AVX2__)
+  for (; offset + 32 <= Size; offset += 32) {
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(data + offset),
+                        _mm256_setzero_si256());
+  }
+#endif
+#if defined(__SSE2__)
+  for (; offset + 16 <= Size; offset += 16) {
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(data + offset),
+                     _mm_setzero_si128());
+  }
+#endif
+  for (; offset + 8 <= Size; offset += 8) {
+    const uint64_t zero = 0;
+    memcpy(data + offset, &zero, sizeof(zero));
+  }
+  for (; offset < Size; ++offset) {
+    data[offset] = 0;
+  }
+  __asm__ __volatile__("" : : "r"(data) : "memory");
+}
+
+// Sets each of the |Size| bytes at |dest| to its XOR with the corresponding
+// byte at |src|. |src| and |dest| may be equal, but must not otherwise overlap.
+template <size_t Size>
+inline void XorInto(const uint8_t *src, uint8_t *dest) {
+  size_t offset = 0;
+#if defined(__AVX2__)
+  for (; offset + 32 <= Size; offset += 32) {
+    __m256i a =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + offset));
+    __m256i b =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(dest + offset));
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(dest + offset),
+                        _mm256_xor_si256(a, b));
+  }
+#endif
+#if defined(__SSE2__)
+  for (; offset + 16 <= Size; offset += 16) {
+    __m128i a =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + offset));
+    __m128i b =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(dest + offset));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(dest + offset),
+                     _mm_xor_si128(a, b));
+  }
+#endif
+  for (; offset + 8 <= Size; offset += 8) {
+    uint64_t a;
+    uint64_t b;
+    memcpy(&a, src + offset, sizeof(a));
+    memcpy(&b, dest + offset, sizeof(b));
+    b ^= a;
+    memcpy(dest + offset, &b, sizeof(b));
+  }
+  for (; offset < Size; ++offset) {
+    dest[offset] ^= src[offset];
+  }
+}
+
+}  // namespace internal
+}  // namespace asylo
+
+#endif  // ASYLO_CRYPTO_UTIL_BYTES_KERNELS_H_
@@ -278,8 +278,8 @@ TYPED_TEST(TypedBytesTest, Cleanse) {
   EXPECT_TRUE(bytes.Equals(kValue1, kSize));
   bytes.Cleanse();
   uint8_t buffer[kSize];
-  // The object uses OPENSSL_cleanse for its cleansing needs, which zeros out
-  // the data. The test ensures that the zeroing was actually performed.
+  // Cleansing zeros out the data. The test ensures that the zeroing was
+  // actually performed.
   memset(buffer, 0, kSize);
   EXPECT_TRUE(bytes.Equals(buffer, kSize));
 }
@@ -294,9 +294,8 @@ TYPED_TEST(TypedBytesTest, Destructor) {
   bytes->~TypeParam();
 
   if (TypeParam::policy() == DataSafety::SAFE) {
-    // A SAFE object's destructor uses OPENSSL_cleanse for its cleansing needs,
-    // which zeros out the data. The test ensures that the zeroing was actually
-    // performed.
+    // A SAFE object's destructor cleanses the object, which zeros out the
+    // data. The test ensures that the zeroing was actually performed.
     uint8_t buffer2[kSize];
     memset(buffer2, 0, kSize);
     EXPECT_EQ(0, memcmp(buffer1, buffer2, kSize));
@@ -631,6 +630,67 @@ TEST(BytesTest, UnsafeInequalityOperatorPositive1) {
   EXPECT_TRUE(bytes1 != bytes2);
 }
 
+// A typed test fixture for the size-specialized kernels. The sizes cover
+// every combination of vector, word and byte tails.
+template <typename T>
+class KernelBytesTest : public ::testing::Test {};
+
+typedef ::testing::Types<SafeBytes<1>, UnsafeBytes<7>, SafeBytes<8>,
+                         UnsafeBytes<15>, SafeBytes<16>, UnsafeBytes<31>,
+                         SafeBytes<32>, UnsafeBytes<33>, SafeBytes<48>,
+                         UnsafeBytes<64>, SafeBytes<95>>
+    KernelTypes;
+TYPED_TEST_CASE(KernelBytesTest, KernelTypes);
+
+// Verify that a difference in any single byte is detected.
+TYPED_TEST(KernelBytesTest, EqualsDetectsEveryByte) {
+  TypeParam bytes1 = TrivialRandomObject<TypeParam>();
+  for (size_t i = 0; i < TypeParam::size(); ++i) {
+    TypeParam bytes2 = bytes1;
+    EXPECT_TRUE(bytes1.Equals(bytes2.data(), bytes2.size()));
+    bytes2[i] ^= 0x80;
+    EXPECT_FALSE(bytes1.Equals(bytes2.data(), bytes2.size())) << i;
+  }
+}
+
+TYPED_TEST(KernelBytesTest, CleanseZerosEveryByte) {
+  TypeParam bytes;
+  bytes.fill(0xff);
+  bytes.Cleanse();
+  for (size_t i = 0; i < TypeParam::size(); ++i) {
+    EXPECT_EQ(bytes[i], 0) << i;
+  }
+}
+
+TYPED_TEST(KernelBytesTest, XorInto) {
+  TypeParam src = TrivialRandomObject<TypeParam>();
+  TypeParam dest = TrivialRandomObject<TypeParam>();
+  TypeParam original = dest;
+
+  XorInto(src, &dest);
+  for (size_t i = 0; i < TypeParam::size(); ++i) {
+    EXPECT_EQ(dest[i], src[i] ^ original[i]) << i;
+  }
+
+  // XORing the same value in again restores the original.
+  XorInto(src, &dest);
+  EXPECT_TRUE(dest.Equals(original.data(), original.size()));
+
+  // XORing an object into itself zeros it.
+  XorInto(dest, &dest);
+  for (size_t i = 0; i < TypeParam::size(); ++i) {
+    EXPECT_EQ(dest[i], 0) << i;
+  }
+}
+
+TEST(BytesTest, XorIntoMixedPolicies) {
+  SafeBytes<kSize> dest(kValue1, kSize);
+  UnsafeBytes<kSize> src(kValue1, kSize);
+  XorInto(src, &dest);
+  uint8_t zeros[kSize] = {};
+  EXPECT_TRUE(dest.Equals(zeros, kSize));
+}
+
 TEST(BytesTest, SafeParams) {
   EXPECT_EQ(SafeBytes<kSize>::size(), kSize);
   EXPECT_EQ(SafeBytes<kSize>::policy(), DataSafety::SAFE);
@@ -0,0 +1,69 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/crypto/util/cleansing_arena.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include <openssl/mem.h>
+
+namespace asylo {
+
+uint8_t *CleansingArenaBase::Allocate(size_t size, size_t alignment) {
+  uintptr_t current = reinterpret_cast<uintptr_t>(buffer_) + used_;
+  size_t padding = (alignment - (current % alignment)) % alignment;
+
+  // Check for int overflow as well as for exhaustion.
+  size_t start = used_ + padding;
+  if (start < used_ || start > capacity_ || size > capacity_ - start) {
+    return nullptr;
+  }
+
+  used_ = start + size;
+  high_water_mark_ = std::max(high_water_mark_, used_);
+  return buffer_ + start;
+}
+
+bool CleansingArenaBase::Release(const void *ptr, size_t size) {
+  const uint8_t *byte_ptr = reinterpret_cast<const uint8_t *>(ptr);
+  if (!Contains(ptr) || size > used_ || byte_ptr != buffer_ + used_ - size) {
+    return false;
+  }
+
+  used_ -= size;
+  OPENSSL_cleanse(buffer_ + used_, size);
+  return true;
+}
+
+ByteContainerView CleansingArenaBase::Copy(ByteContainerView view) {
+  uint8_t *ptr = Allocate(view.size());
+  if (ptr == nullptr) {
+    return ByteContainerView(nullptr, 0);
+  }
+  memcpy(ptr, view.data(), view.size());
+  return ByteContainerView(ptr, view.size());
+}
+
+void CleansingArenaBase::Reset() {
+  OPENSSL_cleanse(buffer_, high_water_mark_);
+  used_ = 0;
+  high_water_mark_ = 0;
+}
+
+}  // namespace asylo
@@ -0,0 +1,229 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_CRYPTO_UTIL_CLEANSING_ARENA_H_
+#define ASYLO_CRYPTO_UTIL_CLEANSING_ARENA_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+#include "asylo/crypto/util/byte_container_view.h"
+#include "asylo/crypto/util/bytes.h"
+#include "asylo/util/cleansing_allocator.h"
+
+namespace asylo {
+
+// CleansingArenaBase implements a bump allocator over a caller-provided buffer
+// whose contents are cleansed in bulk when the arena is reset. It is intended
+// for short-lived key material (e.g., keys derived during a handshake) that
+// would otherwise require one heap allocation and one cleanse per buffer.
+//
+// Memory handed out by the arena is never individually freed, with one
+// exception: releasing the most recent allocation returns that memory to the
+// arena and cleanses it immediately. Everything else is reclaimed by Reset(),
+// which cleanses every byte that the arena has handed out since the previous
+// reset.
+//
+// Users normally instantiate CleansingArena, which owns its storage.
+// CleansingArenaBase is the capacity-independent type that
+// CleansingArenaAllocator refers to.
+class CleansingArenaBase {
+ public:
+  CleansingArenaBase(const CleansingArenaBase &other) = delete;
+  CleansingArenaBase &operator=(const CleansingArenaBase &other) = delete;
+
+  // Returns a pointer to |size| bytes of storage aligned to |alignment|, which
+  // must be a power of two. Returns nullptr if the arena does not have enough
+  // remaining capacity.
+  uint8_t *Allocate(size_t size, size_t alignment = 1);
+
+  // Returns the |size| bytes at |ptr| to the arena if they form the most recent
+  // allocation, cleansing them. Otherwise does nothing; the memory is cleansed
+  // on the next call to Reset(). Returns true if the memory was returned.
+  bool Release(const void *ptr, size_t size);
+
+  // Creates a new SafeBytes<Size> object in the arena by forwarding |args| to
+  // its constructor. Returns nullptr if the arena does not have enough
+  // remaining capacity. The returned object must not be deleted, and its
+  // destructor is never run; its memory is cleansed on Reset().
+  template <size_t Size, typename... Args>
+  SafeBytes<Size> *NewSafeBytes(Args &&... args) {
+    return New<SafeBytes<Size>>(std::forward<Args>(args)...);
+  }
+
+  // Same as NewSafeBytes(), but creates an UnsafeBytes<Size> object. Although
+  // UnsafeBytes objects do not cleanse themselves, memory allocated for them
+  // from the arena is still cleansed on Reset().
+  template <size_t Size, typename... Args>
+  UnsafeBytes<Size> *NewUnsafeBytes(Args &&... args) {
+    return New<UnsafeBytes<Size>>(std::forward<Args>(args)...);
+  }
+
+  // Copies |view| into the arena and returns a view of the copy. Returns a
+  // view with null data if the arena does not have enough remaining capacity.
+  ByteContainerView Copy(ByteContainerView view);
+
+  // Returns true if |ptr| points into the arena's storage.
+  bool Contains(const void *ptr) const {
+    const uint8_t *byte_ptr = reinterpret_cast<const uint8_t *>(ptr);
+    return byte_ptr >= buffer_ && byte_ptr < buffer_ + capacity_;
+  }
+
+  // Cleanses all memory handed out since the last reset and makes the full
+  // capacity of the arena available again. Any pointers previously returned
+  // by the arena must not be used after this call.
+  void Reset();
+
+  // Returns the number of bytes currently allocated from the arena.
+  size_t used() const { return used_; }
+
+  // Returns the total number of bytes the arena can hand out.
+  size_t capacity() const { return capacity_; }
+
+ protected:
+  CleansingArenaBase(uint8_t *buffer, size_t capacity)
+      : buffer_{buffer}, capacity_{capacity}, used_{0}, high_water_mark_{0} {}
+
+  // Derived classes that own the arena's storage must call Reset() from their
+  // destructor, before the storage goes away.
+  ~CleansingArenaBase() = default;
+
+ private:
+  template <typename BytesT, typename... Args>
+  BytesT *New(Args &&... args) {
+    uint8_t *ptr = Allocate(sizeof(BytesT), alignof(BytesT));
+    if (ptr == nullptr) {
+      return nullptr;
+    }
+    return new (ptr) BytesT(std::forward<Args>(args)...);
+  }
+
+  uint8_t *const buffer_;
+  const size_t capacity_;
+
+  // Number of bytes currently allocated.
+  size_t used_;
+
+  // Largest value of |used_| since the last reset. Reset() cleanses the
+  // first |high_water_mark_| bytes of the buffer.
+  size_t high_water_mark_;
+};
+
+// CleansingArena is a CleansingArenaBase whose storage, |Capacity| bytes, is
+// held inline. A CleansingArena declared as a local variable therefore keeps
+// all of its allocations on the stack.
+//
+// Example:
+//
+//   CleansingArena<256> arena;
+//   SafeBytes<32> *key = arena.NewSafeBytes<32>();
+//   CleansingArenaVector<uint8_t> okm(
+//       CleansingArenaAllocator<uint8_t>(&arena));
+//   ...
+//   arena.Reset();  // Cleanses |key| and |okm| in one pass.
+template <size_t Capacity>
+class CleansingArena final : public CleansingArenaBase {
+ public:
+  CleansingArena() : CleansingArenaBase(storage_, Capacity) {}
+  ~CleansingArena() { Reset(); }
+
+ private:
+  alignas(std::max_align_t) uint8_t storage_[Capacity];
+};
+
+// CleansingArenaAllocator is a C++11
+// [allocator](http://en.cppreference.com/w/cpp/concept/Allocator) that serves
+// allocations from a CleansingArenaBase. Containers backed by this allocator
+// can be used anywhere a byte container is expected, including as the source
+// of a ByteContainerView.
+//
+// If the arena is exhausted, the allocator falls back to a CleansingAllocator,
+// so that a container that outgrows its arena still cleanses its memory when
+// the memory is freed. The arena must outlive every container that uses it.
+template <typename T>
+class CleansingArenaAllocator {
+ public:
+  using value_type = T;
+  using pointer = T *;
+  using const_pointer = const T *;
+  using reference = T &;
+  using const_reference = const T &;
+  using size_type = size_t;
+  using difference_type = ptrdiff_t;
+
+  explicit CleansingArenaAllocator(CleansingArenaBase *arena) : arena_{arena} {}
+  template <typename U>
+  CleansingArenaAllocator(const CleansingArenaAllocator<U> &other)
+      : arena_{other.arena_} {}
+
+  template <typename U>
+  struct rebind {
+    using other = CleansingArenaAllocator<U>;
+  };
+
+  pointer allocate(size_type n) {
+    uint8_t *ptr = arena_->Allocate(n * sizeof(T), alignof(T));
+    if (ptr == nullptr) {
+      return fallback_.allocate(n);
+    }
+    return reinterpret_cast<pointer>(ptr);
+  }
+
+  void deallocate(pointer ptr, size_type n) {
+    if (!arena_->Contains(ptr)) {
+      fallback_.deallocate(ptr, n);
+      return;
+    }
+    arena_->Release(ptr, n * sizeof(T));
+  }
+
+  template <typename U>
+  friend class CleansingArenaAllocator;
+
+  template <typename U, typename V>
+  friend bool operator==(const CleansingArenaAllocator<U> &lhs,
+                         const CleansingArenaAllocator<V> &rhs);
+
+ private:
+  CleansingArenaBase *arena_;
+  CleansingAllocator<T> fallback_;
+};
+
+template <typename T, typename U>
+bool operator==(const CleansingArenaAllocator<T> &lhs,
+                const CleansingArenaAllocator<U> &rhs) {
+  return lhs.arena_ == rhs.arena_;
+}
+
+template <typename T, typename U>
+bool operator!=(const CleansingArenaAllocator<T> &lhs,
+                const CleansingArenaAllocator<U> &rhs) {
+  return !(lhs == rhs);
+}
+
+// A vector whose storage comes from a CleansingArena.
+template <typename T>
+using CleansingArenaVector = std::vector<T, CleansingArenaAllocator<T>>;
+
+}  // namespace asylo
+
+#endif  // ASYLO_CRYPTO_UTIL_CLEANSING_ARENA_H_
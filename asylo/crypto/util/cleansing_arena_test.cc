@@ -0,0 +1,142 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/crypto/util/cleansing_arena.h"
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include "asylo/crypto/util/byte_container_view.h"
+#include "asylo/crypto/util/bytes.h"
+
+namespace asylo {
+namespace {
+
+constexpr size_t kArenaSize = 128;
+constexpr char kSecret[] = "super secret key material";
+
+// Returns true if the first |size| bytes of |arena|'s storage are all zero.
+// The storage is reached through a fresh allocation, which is valid because
+// the arena hands out memory from the start of its buffer after a reset.
+bool ArenaPrefixIsZero(CleansingArenaBase *arena, size_t size) {
+  uint8_t *ptr = arena->Allocate(size);
+  bool is_zero = true;
+  for (size_t i = 0; i < size; ++i) {
+    is_zero = is_zero && ptr[i] == 0;
+  }
+  arena->Reset();
+  return is_zero;
+}
+
+TEST(CleansingArenaTest, AllocateRespectsCapacity) {
+  CleansingArena<kArenaSize> arena;
+  EXPECT_EQ(arena.capacity(), kArenaSize);
+  EXPECT_NE(arena.Allocate(kArenaSize / 2), nullptr);
+  EXPECT_NE(arena.Allocate(kArenaSize / 2), nullptr);
+  EXPECT_EQ(arena.used(), kArenaSize);
+  EXPECT_EQ(arena.Allocate(1), nullptr);
+}
+
+TEST(CleansingArenaTest, AllocateAligns) {
+  CleansingArena<kArenaSize> arena;
+  ASSERT_NE(arena.Allocate(1), nullptr);
+  uint8_t *ptr = arena.Allocate(8, 8);
+  ASSERT_NE(ptr, nullptr);
+  EXPECT_EQ(reinterpret_cast<uintptr_t>(ptr) % 8, 0);
+  EXPECT_EQ(arena.used(), 16);
+}
+
+TEST(CleansingArenaTest, ResetCleansesAllAllocations) {
+  CleansingArena<kArenaSize> arena;
+  SafeBytes<16> *key = arena.NewSafeBytes<16>();
+  ASSERT_NE(key, nullptr);
+  key->fill('k');
+  UnsafeBytes<16> *iv = arena.NewUnsafeBytes<16>();
+  ASSERT_NE(iv, nullptr);
+  iv->fill('i');
+
+  arena.Reset();
+  EXPECT_EQ(arena.used(), 0);
+  EXPECT_TRUE(ArenaPrefixIsZero(&arena, 32));
+}
+
+TEST(CleansingArenaTest, ReleaseOfLastAllocationCleanses) {
+  CleansingArena<kArenaSize> arena;
+  uint8_t *first = arena.Allocate(8);
+  uint8_t *second = arena.Allocate(8);
+  memset(second, 0xff, 8);
+
+  EXPECT_FALSE(arena.Release(first, 8));
+  EXPECT_TRUE(arena.Release(second, 8));
+  EXPECT_EQ(arena.used(), 8);
+  for (int i = 0; i < 8; ++i) {
+    EXPECT_EQ(second[i], 0);
+  }
+}
+
+TEST(CleansingArenaTest, NewSafeBytesForwardsArguments) {
+  CleansingArena<kArenaSize> arena;
+  SafeBytes<sizeof(kSecret)> *secret =
+      arena.NewSafeBytes<sizeof(kSecret)>(
+          ByteContainerView(kSecret, sizeof(kSecret)));
+  ASSERT_NE(secret, nullptr);
+  EXPECT_TRUE(secret->Equals(kSecret, sizeof(kSecret)));
+  EXPECT_TRUE(arena.Contains(secret));
+}
+
+TEST(CleansingArenaTest, CopyReturnsViewIntoArena) {
+  CleansingArena<kArenaSize> arena;
+  ByteContainerView copy = arena.Copy(kSecret);
+  ASSERT_NE(copy.data(), nullptr);
+  EXPECT_TRUE(arena.Contains(copy.data()));
+  EXPECT_EQ(std::string(copy.begin(), copy.end()), kSecret);
+
+  CleansingArena<4> small_arena;
+  EXPECT_EQ(small_arena.Copy(kSecret).data(), nullptr);
+}
+
+TEST(CleansingArenaTest, VectorUsesArenaStorage) {
+  CleansingArena<kArenaSize> arena;
+  {
+    CleansingArenaVector<uint8_t> vec{
+        CleansingArenaAllocator<uint8_t>(&arena)};
+    vec.reserve(32);
+    vec.assign(kSecret, kSecret + sizeof(kSecret));
+    EXPECT_TRUE(arena.Contains(vec.data()));
+
+    ByteContainerView view(vec);
+    EXPECT_EQ(view.size(), sizeof(kSecret));
+  }
+  // The vector held the only allocation, so destroying it returns the memory.
+  EXPECT_EQ(arena.used(), 0);
+  EXPECT_TRUE(ArenaPrefixIsZero(&arena, 32));
+}
+
+TEST(CleansingArenaTest, VectorFallsBackToHeapWhenArenaIsExhausted) {
+  CleansingArena<8> arena;
+  CleansingArenaVector<uint8_t> vec{CleansingArenaAllocator<uint8_t>(&arena)};
+  vec.resize(64, 'x');
+  EXPECT_FALSE(arena.Contains(vec.data()));
+  EXPECT_EQ(vec.size(), 64);
+}
+
+}  // namespace
+}  // namespace asylo
@@ -0,0 +1,140 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/crypto/util/hardware_random.h"
+
+#include <cpuid.h>
+#include <immintrin.h>
+#include <openssl/mem.h>
+#include <openssl/rand.h>
+
+#include <algorithm>
+#include <cstring>
+
+namespace asylo {
+namespace {
+
+// Number of times RDRAND is executed before giving up, as recommended by
+// Intel for transient failures.
+constexpr int kRdrandRetries = 10;
+
+// Number of RDRAND instructions issued back to back.
+constexpr size_t kBatchWords = 4;
+
+// Queries the processor for RDRAND. Inside an SGX enclave CPUID is emulated
+// from values reported by the host. A host that misreports it can at worst
+// make the enclave fault, which it can always do.
+bool DetectRdrand() {
+  unsigned int eax, ebx, ecx, edx;
+  return __get_cpuid(1, &eax, &ebx, &ecx, &edx) && (ecx & bit_RDRND) != 0;
+}
+
+bool HasRdrand() {
+  static const bool has_rdrand = DetectRdrand();
+  return has_rdrand;
+}
+
+__attribute__((target("rdrnd"))) bool Rdrand64WithRetries(uint64_t *value) {
+  unsigned long long result;
+  for (int i = 0; i < kRdrandRetries; ++i) {
+    if (_rdrand64_step(&result)) {
+      *value = result;
+      return true;
+    }
+  }
+  return false;
+}
+
+// Fills |words| with |count| RDRAND outputs, where |count| is at most
+// kBatchWords. The first attempts are issued without waiting on one another,
+// and words whose first attempt failed are retried one at a time.
+__attribute__((target("rdrnd"))) bool RdrandBatch(uint64_t *words,
+                                                   size_t count) {
+  unsigned long long results[kBatchWords];
+  int ok[kBatchWords];
+  for (size_t i = 0; i < count; ++i) {
+    ok[i] = _rdrand64_step(&results[i]);
+  }
+  bool success = true;
+  for (size_t i = 0; i < count && success; ++i) {
+    if (ok[i]) {
+      words[i] = results[i];
+    } else {
+      success = Rdrand64WithRetries(&words[i]);
+    }
+  }
+  OPENSSL_cleanse(results, sizeof(results));
+  return success;
+}
+
+// Fills |buffer| with |size| bytes from RDRAND. Returns false if RDRAND fails
+// or its output fails the health test, leaving |buffer| partially filled.
+bool FillFromRdrand(uint8_t *buffer, size_t size) {
+  // words[0] holds the last output of the previous batch, so that the health
+  // test also compares outputs across batches.
+  uint64_t words[kBatchWords + 1];
+  bool first_batch = true;
+  bool success = true;
+  while (size > 0 && success) {
+    size_t count = std::min(kBatchWords, (size + 7) / 8);
+    size_t length = std::min(size, count * 8);
+    success = RdrandBatch(&words[1], count) &&
+              (first_batch
+                   ? internal::RdrandOutputsHealthy(&words[1], count)
+                   : internal::RdrandOutputsHealthy(words, count + 1));
+    if (success) {
+      memcpy(buffer, &words[1], length);
+      words[0] = words[count];
+      buffer += length;
+      size -= length;
+      first_batch = false;
+    }
+  }
+  OPENSSL_cleanse(words, sizeof(words));
+  return success;
+}
+
+}  // namespace
+
+bool GetRdrand64(uint64_t *value) {
+  return HasRdrand() && Rdrand64WithRetries(value);
+}
+
+bool GetHardwareRandBytes(uint8_t *buffer, size_t size) {
+  if (size == 0) {
+    return true;
+  }
+  if (HasRdrand() && FillFromRdrand(buffer, size)) {
+    return true;
+  }
+  return RAND_bytes(buffer, size) == 1;
+}
+
+namespace internal {
+
+bool RdrandOutputsHealthy(const uint64_t *values, size_t count) {
+  for (size_t i = 0; i < count; ++i) {
+    if (values[i] == UINT64_MAX || (i > 0 && values[i] == values[i - 1])) {
+      return false;
+    }
+  }
+  return true;
+}
+
+}  // namespace internal
+}  // namespace asylo
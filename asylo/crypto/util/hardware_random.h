@@ -0,0 +1,54 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_CRYPTO_UTIL_HARDWARE_RANDOM_H_
+#define ASYLO_CRYPTO_UTIL_HARDWARE_RANDOM_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include "absl/base/attributes.h"
+
+namespace asylo {
+
+// Stores a 64-bit random value from the RDRAND instruction in |value|,
+// executing it at most 10 times as Intel recommends. Returns false if the
+// processor does not support RDRAND or every attempt failed.
+ABSL_MUST_USE_RESULT bool GetRdrand64(uint64_t *value);
+
+// Fills |buffer| with |size| random bytes, for values such as nonces and
+// handshake challenges which are drawn a few bytes at a time.
+//
+// The bytes are drawn from RDRAND, issued four at a time so that the latencies
+// of the instructions overlap. Every output is health tested: an output with
+// all bits set, a known failure mode of RDRAND, or equal to the previous
+// output fails the request. If RDRAND is not supported, fails or fails the
+// health test, the whole buffer is filled by BoringSSL's DRBG instead. Returns
+// false only if that fails as well.
+ABSL_MUST_USE_RESULT bool GetHardwareRandBytes(uint8_t *buffer, size_t size);
+
+namespace internal {
+
+// Returns whether the |count| consecutive RDRAND outputs in |values| pass the
+// health test of GetHardwareRandBytes().
+bool RdrandOutputsHealthy(const uint64_t *values, size_t count);
+
+}  // namespace internal
+}  // namespace asylo
+
+#endif  // ASYLO_CRYPTO_UTIL_HARDWARE_RANDOM_H_
@@ -0,0 +1,78 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/crypto/util/hardware_random.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace asylo {
+namespace {
+
+using internal::RdrandOutputsHealthy;
+
+TEST(HardwareRandomTest, FillsRequestsOfAnySize) {
+  for (size_t size : {0, 1, 7, 8, 9, 31, 32, 33, 100, 4096}) {
+    std::vector<uint8_t> first(size, 0);
+    std::vector<uint8_t> second(size, 0);
+    ASSERT_TRUE(GetHardwareRandBytes(first.data(), first.size())) << size;
+    ASSERT_TRUE(GetHardwareRandBytes(second.data(), second.size())) << size;
+    if (size >= 16) {
+      EXPECT_NE(first, std::vector<uint8_t>(size, 0)) << size;
+      EXPECT_NE(first, second) << size;
+    }
+  }
+}
+
+TEST(HardwareRandomTest, DoesNotWritePastBuffer) {
+  std::vector<uint8_t> buffer(16, 0xa5);
+  ASSERT_TRUE(GetHardwareRandBytes(buffer.data(), 5));
+  EXPECT_EQ(std::vector<uint8_t>(buffer.begin() + 5, buffer.end()),
+            std::vector<uint8_t>(11, 0xa5));
+}
+
+TEST(HardwareRandomTest, Rdrand64ReturnsDistinctValues) {
+  uint64_t first;
+  uint64_t second;
+  if (!GetRdrand64(&first)) {
+    // The processor does not support RDRAND.
+    return;
+  }
+  ASSERT_TRUE(GetRdrand64(&second));
+  EXPECT_NE(first, second);
+}
+
+TEST(HardwareRandomTest, HealthTestRejectsStuckOutputs) {
+  const uint64_t distinct[] = {1, 2, 3, 4};
+  EXPECT_TRUE(RdrandOutputsHealthy(distinct, 4));
+  EXPECT_TRUE(RdrandOutputsHealthy(distinct, 0));
+
+  const uint64_t all_ones[] = {1, UINT64_MAX};
+  EXPECT_FALSE(RdrandOutputsHealthy(all_ones, 2));
+  EXPECT_FALSE(RdrandOutputsHealthy(&all_ones[1], 1));
+
+  const uint64_t repeated[] = {5, 7, 7, 9};
+  EXPECT_FALSE(RdrandOutputsHealthy(repeated, 4));
+  EXPECT_TRUE(RdrandOutputsHealthy(repeated, 2));
+}
+
+}  // namespace
+}  // namespace asylo
@@ -26,9 +26,54 @@ namespace daemon {
 ::grpc::Status AttestationDomainServiceImpl::GetAttestationDomain(
     ::grpc::ServerContext *context, const GetAttestationDomainRequest *request,
     GetAttestationDomainResponse *response) {
-  return ::asylo::daemon::GetAttestationDomain(
-             domain_file_path_.c_str(), response->mutable_attestation_domain())
-      .ToOtherStatus<::grpc::Status>();
+  absl::MutexLock lock(&mu_);
+
+  // Serve the cached name while the file is unchanged. The file is normally
+  // written once, so this saves a file read for every enclave load.
+  FileVersion version;
+  bool has_version = GetFileVersion(&version);
+  if (has_cached_domain_ && has_version &&
+      IsSameVersion(version, cached_version_)) {
+    response->set_attestation_domain(cached_domain_);
+    return ::grpc::Status::OK;
+  }
+
+  has_cached_domain_ = false;
+  Status status = ::asylo::daemon::GetAttestationDomain(
+      domain_file_path_.c_str(), response->mutable_attestation_domain());
+  if (!status.ok()) {
+    return status.ToOtherStatus<::grpc::Status>();
+  }
+
+  // The version is taken before reading the file, so a change made while the
+  // file is read is noticed on the next call. If the file did not exist, it
+  // was just created and is cached on the next call.
+  if (has_version) {
+    cached_version_ = version;
+    cached_domain_ = response->attestation_domain();
+    has_cached_domain_ = true;
+  }
+  return ::grpc::Status::OK;
+}
+
+bool AttestationDomainServiceImpl::GetFileVersion(FileVersion *version) const {
+  struct stat file_stat;
+  if (stat(domain_file_path_.c_str(), &file_stat) != 0) {
+    return false;
+  }
+  version->device = file_stat.st_dev;
+  version->inode = file_stat.st_ino;
+  version->size = file_stat.st_size;
+  version->modification_time = file_stat.st_mtim;
+  return true;
+}
+
+bool AttestationDomainServiceImpl::IsSameVersion(const FileVersion &lhs,
+                                                 const FileVersion &rhs) {
+  return lhs.device == rhs.device && lhs.inode == rhs.inode &&
+         lhs.size == rhs.size &&
+         lhs.modification_time.tv_sec == rhs.modification_time.tv_sec &&
+         lhs.modification_time.tv_nsec == rhs.modification_time.tv_nsec;
 }
 
 }  // namespace daemon
@@ -19,9 +19,12 @@
 #ifndef ASYLO_DAEMON_IDENTITY_ATTESTATION_DOMAIN_SERVICE_IMPL_H_
 #define ASYLO_DAEMON_IDENTITY_ATTESTATION_DOMAIN_SERVICE_IMPL_H_
 
+#include <sys/stat.h>
 #include <string>
 
+#include "absl/synchronization/mutex.h"
 #include "asylo/daemon/identity/attestation_domain.grpc.pb.h"
+#include "asylo/util/status.h"
 #include "include/grpcpp/grpcpp.h"
 
 namespace asylo {
@@ -36,14 +39,38 @@ class AttestationDomainServiceImpl final
       : domain_file_path_{std::move(domain_file_path)} {}
 
   // Retrieves the attestation-domain name from domain_file_path_ and sets
-  // |response| accordingly.
+  // |response| accordingly. The name is read from the file once and served
+  // from memory until the file is replaced or modified.
   ::grpc::Status GetAttestationDomain(
       ::grpc::ServerContext *context,
       const GetAttestationDomainRequest *request,
       GetAttestationDomainResponse *response) override;
 
  private:
+  // Identifies a version of the attestation-domain file.
+  struct FileVersion {
+    dev_t device;
+    ino_t inode;
+    off_t size;
+    struct timespec modification_time;
+  };
+
+  // Gets the version of the file at domain_file_path_ and writes it to
+  // |version|. Returns false if the file cannot be stat'ed.
+  bool GetFileVersion(FileVersion *version) const;
+
+  // Returns true if |lhs| and |rhs| identify the same version of the file.
+  static bool IsSameVersion(const FileVersion &lhs, const FileVersion &rhs);
+
   const std::string domain_file_path_;
+
+  absl::Mutex mu_;
+
+  // Whether |cached_domain_| holds the name read from |cached_version_| of the
+  // file.
+  bool has_cached_domain_ GUARDED_BY(mu_) = false;
+  std::string cached_domain_ GUARDED_BY(mu_);
+  FileVersion cached_version_ GUARDED_BY(mu_);
 };
 
 }  // namespace daemon
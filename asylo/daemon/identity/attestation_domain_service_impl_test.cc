@@ -18,10 +18,13 @@
 
 #include "asylo/daemon/identity/attestation_domain_service_impl.h"
 
+#include <stdio.h>
+#include <fstream>
 #include <string>
 
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
+#include "absl/strings/escaping.h"
 #include "absl/strings/str_cat.h"
 #include "asylo/daemon/identity/attestation_domain.h"
 #include "asylo/test/util/status_matchers.h"
@@ -61,6 +64,39 @@ TEST(AttestationDomainServiceImplTest, GetAttestationDomain) {
   EXPECT_EQ(domain1, domain2);
 }
 
+// Verifies that AttestationDomainServiceImpl notices when the attestation
+// domain file is replaced.
+TEST(AttestationDomainServiceImplTest, GetAttestationDomainAfterFileChange) {
+  std::string domain_file_path = absl::StrCat(
+      FLAGS_test_tmpdir, "/", kAttestationDomainFileName, "-replaced");
+  AttestationDomainServiceImpl impl(domain_file_path);
+
+  GetAttestationDomainRequest request;
+  GetAttestationDomainResponse response;
+  ::grpc::ServerContext *server_context = nullptr;
+  ASSERT_THAT(
+      Status(impl.GetAttestationDomain(server_context, &request, &response)),
+      IsOk());
+  std::string domain1 = response.attestation_domain();
+
+  // Replace the file with one holding a different domain. Renaming a new file
+  // over the old one gives it a new inode, regardless of timestamp precision.
+  std::string domain2(kAttestationDomainNameSize, '\x5a');
+  ASSERT_NE(domain1, domain2);
+  std::string new_file_path = absl::StrCat(domain_file_path, ".new");
+  {
+    std::ofstream new_file(new_file_path);
+    new_file << absl::BytesToHexString(domain2);
+  }
+  ASSERT_EQ(rename(new_file_path.c_str(), domain_file_path.c_str()), 0);
+
+  response.Clear();
+  ASSERT_THAT(
+      Status(impl.GetAttestationDomain(server_context, &request, &response)),
+      IsOk());
+  EXPECT_EQ(response.attestation_domain(), domain2);
+}
+
 }  // namespace
 }  // namespace daemon
 }  // namespace asylo
@@ -188,6 +188,30 @@ class GrpcServerTest : public ::testing::Test {
     return asylo::Status(status);
   }
 
+  // Sends each of |input_words| on a StreamTranslations RPC, appending the
+  // translations received to |*translated_words|. Returns the status with
+  // which the server ends the stream.
+  asylo::Status MakeStreamingRpc(const std::vector<std::string> &input_words,
+                                 std::vector<std::string> *translated_words) {
+    ::grpc::ClientContext context;
+    std::unique_ptr<::grpc::ClientReaderWriter<GetTranslationRequest,
+                                               GetTranslationResponse>>
+        stream = stub_->StreamTranslations(&context);
+
+    GetTranslationRequest request;
+    GetTranslationResponse response;
+    for (const std::string &input_word : input_words) {
+      request.set_input_word(input_word);
+      if (!stream->Write(request) || !stream->Read(&response)) {
+        break;
+      }
+      translated_words->push_back(response.translated_word());
+    }
+    stream->WritesDone();
+
+    return asylo::Status(stream->Finish());
+  }
+
  private:
   // Waits for server_thread_ to either set server_port_ or terminate, then
   // returns the value of server_port_.
@@ -245,6 +269,24 @@ TEST_F(GrpcServerTest, OrkutTranslationNotFound) {
   EXPECT_EQ(status.error_message(), "No known translation for \"orkut\"");
 }
 
+TEST_F(GrpcServerTest, StreamTranslatesEachWordInOrder) {
+  std::vector<std::string> translations;
+  ASSERT_THAT(MakeStreamingRpc({"asylo", "istio", "kubernetes", "asylo"},
+                               &translations),
+              IsOk());
+  EXPECT_THAT(translations, ::testing::ElementsAre("sanctuary", "sail",
+                                                   "helmsman", "sanctuary"));
+}
+
+TEST_F(GrpcServerTest, StreamEndsAtUnknownWord) {
+  std::vector<std::string> translations;
+  asylo::Status status =
+      MakeStreamingRpc({"istio", "orkut", "asylo"}, &translations);
+  ASSERT_THAT(status, StatusIs(asylo::error::INVALID_ARGUMENT));
+  EXPECT_EQ(status.error_message(), "No known translation for \"orkut\"");
+  EXPECT_THAT(translations, ::testing::ElementsAre("sail"));
+}
+
 }  // namespace
 }  // namespace grpc_server
 }  // namespace examples
@@ -0,0 +1,452 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+// Load generator for the translation service, served by an EnclaveServer and
+// by the same service in a native gRPC server. Client threads each open their
+// own channel and issue RPCs back to back, each choosing between a unary
+// GetTranslation call and a StreamTranslations call of --messages_per_stream
+// round trips according to --streaming_percent.
+//
+// For each mode, the report gives RPCs per second and latency percentiles by
+// RPC kind, and for all RPCs together:
+//   * host_calls/rpc: host calls made by the enclave per RPC, each of which
+//   exits and re-enters the enclave. These are only counted if the enclave was
+//   built with --define=ASYLO_INSTRUMENT_HOST_CALLS=1, and are shown as n/a
+//   otherwise.
+//   * cpu_us/rpc: user and system CPU time of the whole process per RPC. The
+//   client and the server share the process in both modes, so the difference
+//   between the modes is the cost of serving from the enclave.
+// Whether the enclave runs in hardware or simulation mode is decided when it is
+// built; pass --enclave_label to tell the two apart in the report.
+
+#include <stdio.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_split.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "asylo/benchmarks/benchmark_report.h"
+#include "asylo/client.h"
+#include "asylo/examples/grpc_server/translator_server.grpc.pb.h"
+#include "asylo/examples/grpc_server/translator_server.h"
+#include "asylo/grpc/util/enclave_server.pb.h"
+#include "asylo/util/logging.h"
+#include "gflags/gflags.h"
+#include "include/grpcpp/grpcpp.h"
+#include "include/grpcpp/security/credentials.h"
+#include "include/grpcpp/security/server_credentials.h"
+#include "include/grpcpp/server_builder.h"
+
+DEFINE_string(enclave_path, "", "Path to the benchmark enclave");
+DEFINE_string(modes, "native,enclave",
+              "Comma-separated locations of the server: native and enclave");
+DEFINE_string(enclave_label, "enclave",
+              "Name reported for the enclave mode, e.g. sim or hw");
+DEFINE_int32(concurrency, 8,
+             "Client threads, each with its own channel and one RPC in flight");
+DEFINE_int32(duration_s, 10, "Measured seconds per mode");
+DEFINE_int32(warmup_s, 2, "Unmeasured seconds per mode");
+DEFINE_int32(streaming_percent, 0,
+             "Percentage of RPCs that are StreamTranslations calls rather "
+             "than unary GetTranslation calls");
+DEFINE_int32(messages_per_stream, 100,
+             "Round trips in each StreamTranslations call");
+DEFINE_int32(poller_threads, 0,
+             "Maximum server polling threads, or 0 for gRPC's default");
+DEFINE_int32(listener_shards, 1,
+             "SO_REUSEPORT listeners of the enclave server");
+DEFINE_string(json_output, "", "File to also write the results to as JSON");
+
+namespace examples {
+namespace grpc_server {
+namespace {
+
+constexpr char kEnclaveName[] = "translator_benchmark";
+constexpr char kServerHost[] = "[::1]";
+constexpr double kNanosecondsPerMicrosecond = 1000.0;
+
+// Words with a known translation, sent in turn.
+const char *const kWords[] = {"asylo", "istio", "kubernetes"};
+
+// RPCs completed by one client thread.
+struct LoadResult {
+  // Latencies of the successful RPCs of each kind, in nanoseconds.
+  std::vector<int64_t> unary_latencies_ns;
+  std::vector<int64_t> streaming_latencies_ns;
+
+  // RPCs which failed.
+  int64_t failed = 0;
+};
+
+// Makes one GetTranslation call. Returns true on success.
+bool UnaryRpc(Translator::Stub *stub, const GetTranslationRequest &request) {
+  ::grpc::ClientContext context;
+  GetTranslationResponse response;
+  return stub->GetTranslation(&context, request, &response).ok();
+}
+
+// Makes one StreamTranslations call of |messages| round trips. Returns true on
+// success.
+bool StreamingRpc(Translator::Stub *stub, const GetTranslationRequest &request,
+                  int messages) {
+  ::grpc::ClientContext context;
+  std::unique_ptr<
+      ::grpc::ClientReaderWriter<GetTranslationRequest, GetTranslationResponse>>
+      stream = stub->StreamTranslations(&context);
+  GetTranslationResponse response;
+  bool ok = true;
+  for (int i = 0; i < messages; ++i) {
+    if (!stream->Write(request) || !stream->Read(&response)) {
+      ok = false;
+      break;
+    }
+  }
+  stream->WritesDone();
+  return stream->Finish().ok() && ok;
+}
+
+// Issues RPCs to |stub| one after another until |deadline|, recording them in
+// |result|.
+void RunClient(Translator::Stub *stub, absl::Time deadline, uint32_t seed,
+               LoadResult *result) {
+  std::minstd_rand random(seed);
+  std::uniform_int_distribution<int> percent(0, 99);
+  GetTranslationRequest request;
+  for (size_t i = 0; absl::Now() < deadline; ++i) {
+    request.set_input_word(kWords[i % (sizeof(kWords) / sizeof(kWords[0]))]);
+    bool streaming = percent(random) < FLAGS_streaming_percent;
+    absl::Time start = absl::Now();
+    bool ok = streaming
+                  ? StreamingRpc(stub, request, FLAGS_messages_per_stream)
+                  : UnaryRpc(stub, request);
+    int64_t latency_ns = absl::ToInt64Nanoseconds(absl::Now() - start);
+    if (!ok) {
+      ++result->failed;
+    } else if (streaming) {
+      result->streaming_latencies_ns.push_back(latency_ns);
+    } else {
+      result->unary_latencies_ns.push_back(latency_ns);
+    }
+  }
+}
+
+// Runs one client thread per stub for |duration| and merges their results.
+LoadResult RunLoad(
+    const std::vector<std::unique_ptr<Translator::Stub>> &stubs,
+    absl::Duration duration) {
+  absl::Time deadline = absl::Now() + duration;
+  std::vector<LoadResult> results(stubs.size());
+  std::vector<std::thread> threads;
+  for (size_t i = 0; i < stubs.size(); ++i) {
+    threads.emplace_back(RunClient, stubs[i].get(), deadline,
+                         static_cast<uint32_t>(i + 1), &results[i]);
+  }
+  LoadResult total;
+  for (size_t i = 0; i < threads.size(); ++i) {
+    threads[i].join();
+    total.unary_latencies_ns.insert(total.unary_latencies_ns.end(),
+                                    results[i].unary_latencies_ns.begin(),
+                                    results[i].unary_latencies_ns.end());
+    total.streaming_latencies_ns.insert(
+        total.streaming_latencies_ns.end(),
+        results[i].streaming_latencies_ns.begin(),
+        results[i].streaming_latencies_ns.end());
+    total.failed += results[i].failed;
+  }
+  return total;
+}
+
+// Returns the user and system CPU time used by the process, in microseconds.
+int64_t ProcessCpuMicros() {
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000LL +
+         usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+}
+
+// Returns the number of calls of each host call in |snapshot|.
+std::map<std::string, uint64_t> HostCallCounts(
+    const asylo::HostCallStatsSnapshot &snapshot) {
+  std::map<std::string, uint64_t> counts;
+  for (const asylo::HostCallStats &stats : snapshot.host_calls()) {
+    counts[stats.name()] = stats.calls();
+  }
+  return counts;
+}
+
+// Returns the |quantile| of the sorted |latencies_ns| in microseconds.
+double PercentileMicros(const std::vector<int64_t> &latencies_ns,
+                        double quantile) {
+  if (latencies_ns.empty()) {
+    return 0;
+  }
+  size_t index = std::min(latencies_ns.size() - 1,
+                          static_cast<size_t>(latencies_ns.size() * quantile));
+  return latencies_ns[index] / kNanosecondsPerMicrosecond;
+}
+
+void PrintHeader() {
+  printf("\n%-10s %-10s %10s %8s %10s %10s %10s %10s %10s %14s %10s\n", "mode",
+         "rpc", "rpcs", "failed", "rpcs/s", "p50_us", "p90_us", "p99_us",
+         "p99.9_us", "host_calls/rpc", "cpu_us/rpc");
+}
+
+// Prints a row of results and adds it to |recorder|, returning the recorded
+// result. Failures, host calls and CPU time are only known for all RPCs
+// together, so the rows of one kind of RPC leave them out.
+asylo::BenchmarkResult *PrintRow(const std::string &mode,
+                                 const std::string &rpc,
+                                 std::vector<int64_t> *latencies_ns,
+                                 int64_t failed, absl::Duration duration,
+                                 const std::string &host_calls_per_rpc,
+                                 const std::string &cpu_per_rpc,
+                                 asylo::BenchmarkRecorder *recorder) {
+  std::sort(latencies_ns->begin(), latencies_ns->end());
+  printf("%-10s %-10s %10lld %8lld %10.1f %10.1f %10.1f %10.1f %10.1f %14s "
+         "%10s\n",
+         mode.c_str(), rpc.c_str(),
+         static_cast<long long>(latencies_ns->size()),
+         static_cast<long long>(failed),
+         latencies_ns->size() / absl::ToDoubleSeconds(duration),
+         PercentileMicros(*latencies_ns, 0.5),
+         PercentileMicros(*latencies_ns, 0.9),
+         PercentileMicros(*latencies_ns, 0.99),
+         PercentileMicros(*latencies_ns, 0.999), host_calls_per_rpc.c_str(),
+         cpu_per_rpc.c_str());
+
+  asylo::BenchmarkResult *recorded =
+      recorder->AddResult({{"mode", mode}, {"rpc", rpc}});
+  asylo::AddMetric("rpcs/s",
+                   latencies_ns->size() / absl::ToDoubleSeconds(duration),
+                   asylo::BenchmarkMetric::HIGHER_IS_BETTER, recorded);
+  asylo::AddMetric("failed", failed, asylo::BenchmarkMetric::LOWER_IS_BETTER,
+                   recorded);
+  const std::pair<const char *, double> kPercentiles[] = {
+      {"p50_us", 0.5}, {"p90_us", 0.9}, {"p99_us", 0.99}, {"p99.9_us", 0.999}};
+  for (const auto &percentile : kPercentiles) {
+    asylo::AddMetric(percentile.first,
+                     PercentileMicros(*latencies_ns, percentile.second),
+                     asylo::BenchmarkMetric::LOWER_IS_BETTER, recorded);
+  }
+  return recorded;
+}
+
+// Starts a native server hosting |service| on an available port, which it
+// writes to |port|.
+std::unique_ptr<::grpc::Server> StartNativeServer(TranslatorServer *service,
+                                                  int *port) {
+  ::grpc::ServerBuilder builder;
+  builder.AddListeningPort(absl::StrCat(kServerHost, ":0"),
+                           ::grpc::InsecureServerCredentials(), port);
+  builder.RegisterService(service);
+  if (FLAGS_poller_threads > 0) {
+    builder.SetSyncServerOption(::grpc::ServerBuilder::MAX_POLLERS,
+                                FLAGS_poller_threads);
+  }
+  return builder.BuildAndStart();
+}
+
+// Loads the benchmark enclave, which starts serving on an available port, and
+// returns its client. Writes the port to |port|.
+asylo::EnclaveClient *LoadEnclaveServer(asylo::EnclaveManager *manager,
+                                        int *port) {
+  asylo::EnclaveConfig config;
+  asylo::ServerConfig *server_config =
+      config.MutableExtension(asylo::server_input_config);
+  server_config->set_host(kServerHost);
+  server_config->set_port(0);
+  server_config->set_poller_threads(FLAGS_poller_threads);
+  server_config->set_listener_shards(FLAGS_listener_shards);
+
+  asylo::SGXLoader loader(FLAGS_enclave_path, /*debug=*/true);
+  asylo::Status status = manager->LoadEnclave(kEnclaveName, loader, config);
+  if (!status.ok()) {
+    LOG(QFATAL) << "Load " << FLAGS_enclave_path << " failed: " << status;
+  }
+  asylo::EnclaveClient *client = manager->GetClient(kEnclaveName);
+
+  asylo::EnclaveInput input;
+  asylo::EnclaveOutput output;
+  status = client->EnterAndRun(input, &output);
+  if (!status.ok()) {
+    LOG(QFATAL) << "Failed to get the enclave server's address: " << status;
+  }
+  *port = output.GetExtension(asylo::server_output_config).port();
+  return client;
+}
+
+// Opens one channel per client thread to |port|. Each channel has a distinct
+// argument so that gRPC gives it its own connection.
+std::vector<std::unique_ptr<Translator::Stub>> CreateStubs(int port) {
+  std::vector<std::unique_ptr<Translator::Stub>> stubs;
+  for (int i = 0; i < FLAGS_concurrency; ++i) {
+    ::grpc::ChannelArguments args;
+    args.SetInt("examples.translator_benchmark.channel", i);
+    stubs.push_back(Translator::NewStub(::grpc::CreateCustomChannel(
+        absl::StrCat(kServerHost, ":", port),
+        ::grpc::InsecureChannelCredentials(), args)));
+  }
+  return stubs;
+}
+
+// Runs the load against the server on |port|, and prints the results and adds
+// them to |recorder|. If |client| is not null, it is the enclave hosting the
+// server, and its host calls are counted.
+void Benchmark(const std::string &mode, int port, asylo::EnclaveClient *client,
+               asylo::BenchmarkRecorder *recorder) {
+  std::vector<std::unique_ptr<Translator::Stub>> stubs = CreateStubs(port);
+  RunLoad(stubs, absl::Seconds(FLAGS_warmup_s));
+
+  asylo::HostCallStatsSnapshot host_calls_before;
+  if (client) {
+    client->GetHostCallStats(&host_calls_before);
+  }
+  int64_t cpu_before = ProcessCpuMicros();
+  absl::Duration duration = absl::Seconds(FLAGS_duration_s);
+  LoadResult result = RunLoad(stubs, duration);
+  int64_t cpu_micros = ProcessCpuMicros() - cpu_before;
+  asylo::HostCallStatsSnapshot host_calls_after;
+  if (client) {
+    client->GetHostCallStats(&host_calls_after);
+  }
+
+  int64_t rpcs = result.unary_latencies_ns.size() +
+                 result.streaming_latencies_ns.size() + result.failed;
+  if (rpcs == 0) {
+    LOG(QFATAL) << "No RPCs completed in " << mode << " mode";
+  }
+
+  // The snapshot of an enclave built without instrumentation is empty.
+  std::string host_calls_per_rpc = "-";
+  std::map<std::string, uint64_t> host_call_deltas;
+  bool host_calls_counted = client && host_calls_after.host_calls_size() > 0;
+  uint64_t total_host_calls = 0;
+  if (client) {
+    host_calls_per_rpc = "n/a";
+    if (host_calls_counted) {
+      std::map<std::string, uint64_t> before =
+          HostCallCounts(host_calls_before);
+      for (const auto &entry : HostCallCounts(host_calls_after)) {
+        uint64_t delta = entry.second - before[entry.first];
+        if (delta > 0) {
+          host_call_deltas[entry.first] = delta;
+          total_host_calls += delta;
+        }
+      }
+      host_calls_per_rpc = absl::StrCat(
+          absl::SixDigits(static_cast<double>(total_host_calls) / rpcs));
+    }
+  }
+  std::string cpu_per_rpc =
+      absl::StrCat(absl::SixDigits(static_cast<double>(cpu_micros) / rpcs));
+
+  if (!result.unary_latencies_ns.empty()) {
+    PrintRow(mode, "unary", &result.unary_latencies_ns, 0, duration, "", "",
+             recorder);
+  }
+  if (!result.streaming_latencies_ns.empty()) {
+    PrintRow(mode, "streaming", &result.streaming_latencies_ns, 0, duration,
+             "", "", recorder);
+  }
+  std::vector<int64_t> all_latencies_ns = result.unary_latencies_ns;
+  all_latencies_ns.insert(all_latencies_ns.end(),
+                          result.streaming_latencies_ns.begin(),
+                          result.streaming_latencies_ns.end());
+  asylo::BenchmarkResult *recorded =
+      PrintRow(mode, "all", &all_latencies_ns, result.failed, duration,
+               host_calls_per_rpc, cpu_per_rpc, recorder);
+  asylo::AddMetric("cpu_us/rpc", static_cast<double>(cpu_micros) / rpcs,
+                   asylo::BenchmarkMetric::LOWER_IS_BETTER, recorded);
+  if (host_calls_counted) {
+    asylo::AddMetric("host_calls/rpc",
+                     static_cast<double>(total_host_calls) / rpcs,
+                     asylo::BenchmarkMetric::LOWER_IS_BETTER, recorded);
+  }
+  for (const auto &entry : host_call_deltas) {
+    printf("    %-32s %10.2f\n", entry.first.c_str(),
+           static_cast<double>(entry.second) / rpcs);
+  }
+}
+
+}  // namespace
+}  // namespace grpc_server
+}  // namespace examples
+
+int main(int argc, char *argv[]) {
+  ::google::ParseCommandLineFlags(&argc, &argv, /*remove_flags=*/true);
+
+  std::vector<std::string> modes = absl::StrSplit(FLAGS_modes, ',');
+  for (const auto &mode : modes) {
+    if (mode != "native" && mode != "enclave") {
+      LOG(QFATAL) << "Unknown mode: " << mode;
+    }
+  }
+
+  asylo::BenchmarkRecorder recorder("translator");
+  examples::grpc_server::PrintHeader();
+  for (const auto &mode : modes) {
+    int port = 0;
+    if (mode == "native") {
+      examples::grpc_server::TranslatorServer service;
+      std::unique_ptr<::grpc::Server> server =
+          examples::grpc_server::StartNativeServer(&service, &port);
+      if (!server) {
+        LOG(QFATAL) << "Failed to start the native server";
+      }
+      examples::grpc_server::Benchmark(mode, port, /*client=*/nullptr,
+                                       &recorder);
+      server->Shutdown();
+      continue;
+    }
+
+    asylo::EnclaveManager::Configure(asylo::EnclaveManagerOptions());
+    auto manager_result = asylo::EnclaveManager::Instance();
+    if (!manager_result.ok()) {
+      LOG(QFATAL) << "EnclaveManager unavailable: " << manager_result.status();
+    }
+    asylo::EnclaveManager *manager = manager_result.ValueOrDie();
+    asylo::EnclaveClient *client =
+        examples::grpc_server::LoadEnclaveServer(manager, &port);
+    examples::grpc_server::Benchmark(FLAGS_enclave_label, port, client,
+                                     &recorder);
+
+    asylo::EnclaveFinal final_input;
+    asylo::Status status = manager->DestroyEnclave(client, final_input);
+    if (!status.ok()) {
+      LOG(QFATAL) << "Destroy " << FLAGS_enclave_path << " failed: " << status;
+    }
+  }
+
+  asylo::Status status = recorder.WriteJson(FLAGS_json_output);
+  if (!status.ok()) {
+    LOG(QFATAL) << status;
+  }
+  return 0;
+}
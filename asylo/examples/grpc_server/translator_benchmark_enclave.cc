@@ -0,0 +1,41 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <memory>
+
+#include "absl/memory/memory.h"
+#include "asylo/examples/grpc_server/translator_server.h"
+#include "asylo/grpc/util/enclave_server.h"
+#include "asylo/trusted_application.h"
+#include "include/grpcpp/security/server_credentials.h"
+
+namespace asylo {
+
+// Hosts the translation service in an EnclaveServer for the translator
+// benchmark. Each listener shard gets its own TranslatorServer. The server
+// uses InsecureServerCredentials so that the benchmark compares the cost of
+// serving RPCs inside the enclave, not of securing the channel.
+TrustedApplication *BuildTrustedApplication() {
+  return new EnclaveServer(
+      [] {
+        return absl::make_unique<examples::grpc_server::TranslatorServer>();
+      },
+      ::grpc::InsecureServerCredentials());
+}
+
+}  // namespace asylo
@@ -37,19 +37,45 @@ TranslatorServer::TranslatorServer()
 ::grpc::Status TranslatorServer::GetTranslation(
     ::grpc::ServerContext *context, const GetTranslationRequest *request,
     GetTranslationResponse *response) {
-  // Confirm that |*request| has an |input_word| field.
-  if (!request->has_input_word()) {
+  return Translate(*request, response);
+}
+
+::grpc::Status TranslatorServer::StreamTranslations(
+    ::grpc::ServerContext *context,
+    ::grpc::ServerReaderWriter<GetTranslationResponse, GetTranslationRequest>
+        *stream) {
+  GetTranslationRequest request;
+  GetTranslationResponse response;
+  while (stream->Read(&request)) {
+    response.Clear();
+    ::grpc::Status status = Translate(request, &response);
+    if (!status.ok()) {
+      return status;
+    }
+    if (!stream->Write(response)) {
+      // The client has gone away.
+      break;
+    }
+  }
+  return ::grpc::Status::OK;
+}
+
+::grpc::Status TranslatorServer::Translate(
+    const GetTranslationRequest &request,
+    GetTranslationResponse *response) const {
+  // Confirm that |request| has an |input_word| field.
+  if (!request.has_input_word()) {
     return ::grpc::Status(::grpc::StatusCode::INVALID_ARGUMENT,
                           "No input word given");
   }
 
   // Confirm that the translation map has a translation for the input word.
   auto response_iterator =
-      translation_map_.find(absl::AsciiStrToLower(request->input_word()));
+      translation_map_.find(absl::AsciiStrToLower(request.input_word()));
   if (response_iterator == translation_map_.end()) {
     return ::grpc::Status(::grpc::StatusCode::INVALID_ARGUMENT,
                           absl::StrCat("No known translation for \"",
-                                       request->input_word(), "\""));
+                                       request.input_word(), "\""));
   }
 
   // Return the translation.
@@ -37,6 +37,15 @@ class TranslatorServer final : public Translator::Service {
                                 const GetTranslationRequest *query,
                                 GetTranslationResponse *response) override;
 
+  ::grpc::Status StreamTranslations(
+      ::grpc::ServerContext *context,
+      ::grpc::ServerReaderWriter<GetTranslationResponse, GetTranslationRequest>
+          *stream) override;
+
+  // Translates the input word of |request| into |response|.
+  ::grpc::Status Translate(const GetTranslationRequest &request,
+                           GetTranslationResponse *response) const;
+
   // A map from words to their translations.
   std::unordered_map<std::string, std::string> translation_map_;
 };
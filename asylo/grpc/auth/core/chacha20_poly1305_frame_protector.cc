@@ -0,0 +1,638 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/grpc/auth/core/chacha20_poly1305_frame_protector.h"
+
+#include <openssl/aead.h>
+#include <openssl/mem.h>
+#include <time.h>
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <unordered_set>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/memory/memory.h"
+#include "absl/synchronization/mutex.h"
+#include "asylo/crypto/util/bytes.h"
+#include "asylo/platform/arch/include/trusted/resource_usage.h"
+#include "asylo/util/cleansing_types.h"
+#include "include/grpc/support/log.h"
+
+namespace asylo {
+namespace {
+
+// Frame layout. These values match the SEAL framing used by the ALTS frame
+// protector.
+constexpr size_t kFrameLengthFieldSize = 4;
+constexpr size_t kFrameMessageTypeFieldSize = 4;
+constexpr size_t kFrameHeaderSize =
+    kFrameLengthFieldSize + kFrameMessageTypeFieldSize;
+constexpr uint32_t kFrameMessageType = 0x06;
+
+constexpr size_t kNonceSize = 12;
+constexpr size_t kTagSize = 16;
+
+// Set in the last byte of the nonce of frames sent by the server, so that the
+// two directions never share a nonce.
+constexpr uint8_t kServerNonceFlag = 0x80;
+
+void StoreLittleEndian32(uint32_t value, uint8_t *output) {
+  for (int i = 0; i < 4; ++i) {
+    output[i] = static_cast<uint8_t>(value >> (8 * i));
+  }
+}
+
+uint32_t LoadLittleEndian32(const uint8_t *input) {
+  uint32_t value = 0;
+  for (int i = 0; i < 4; ++i) {
+    value |= static_cast<uint32_t>(input[i]) << (8 * i);
+  }
+  return value;
+}
+
+// Returns the value of CLOCK_MONOTONIC in nanoseconds. Reading it does not
+// leave the enclave.
+int64_t MonotonicNanoseconds() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return static_cast<int64_t>(now.tv_sec) * 1000000000 + now.tv_nsec;
+}
+
+// Shortest interval between the releases of idle buffers started by calls to
+// protectors.
+constexpr int64_t kMinReleaseIntervalNs = 10 * 1000000;
+
+class FrameProtector;
+
+// The live frame protectors of the process, for releasing the buffers of idle
+// ones and reporting their memory.
+struct FrameProtectorRegistry {
+  absl::Mutex mu;
+  std::unordered_set<FrameProtector *> protectors GUARDED_BY(mu);
+
+  // Earliest time at which a call to a protector releases idle buffers.
+  std::atomic<int64_t> next_release_ns{0};
+
+  static FrameProtectorRegistry *GetInstance() {
+    static FrameProtectorRegistry *instance = new FrameProtectorRegistry;
+    return instance;
+  }
+};
+
+// Frame protection state for one connection.
+//
+// The protector holds a buffer of up to a frame in each direction. If
+// |idle_release_ns| is positive, the buffers are freed once the protector has
+// been idle for that long, and allocated again when it is next used. The AEAD
+// context, which holds the key, is kept, so that the connection resumes
+// without any setup.
+class FrameProtector {
+ public:
+  FrameProtector(bool is_client, size_t max_frame_size, int64_t idle_release_ns)
+      : is_client_(is_client),
+        max_plaintext_size_(max_frame_size - kFrameHeaderSize - kTagSize),
+        idle_release_ns_(idle_release_ns),
+        context_initialized_(false),
+        protect_counter_(0),
+        unprotect_counter_(0),
+        frame_out_offset_(0),
+        unprotect_offset_(0),
+        last_used_ns_(idle_release_ns > 0 ? MonotonicNanoseconds() : 0),
+        held_bytes_(0),
+        released_(true) {
+    FrameProtectorRegistry *registry = FrameProtectorRegistry::GetInstance();
+    absl::MutexLock lock(&registry->mu);
+    registry->protectors.insert(this);
+  }
+
+  ~FrameProtector() {
+    {
+      FrameProtectorRegistry *registry = FrameProtectorRegistry::GetInstance();
+      absl::MutexLock lock(&registry->mu);
+      registry->protectors.erase(this);
+    }
+    if (context_initialized_) {
+      EVP_AEAD_CTX_cleanup(&context_);
+    }
+  }
+
+  FrameProtector(const FrameProtector &other) = delete;
+  FrameProtector &operator=(const FrameProtector &other) = delete;
+
+  // Initializes the AEAD context with |key|. Returns false on failure.
+  bool Init(ByteContainerView key) {
+    context_initialized_ =
+        EVP_AEAD_CTX_init(&context_, EVP_aead_chacha20_poly1305(), key.data(),
+                          key.size(), kTagSize, /*impl=*/nullptr) == 1;
+    return context_initialized_;
+  }
+
+  tsi_result Protect(const unsigned char *unprotected_bytes,
+                     size_t *unprotected_bytes_size,
+                     unsigned char *protected_output_frames,
+                     size_t *protected_output_frames_size) {
+    tsi_result result;
+    {
+      absl::MutexLock lock(&mu_);
+      result = ProtectLocked(unprotected_bytes, unprotected_bytes_size,
+                             protected_output_frames,
+                             protected_output_frames_size);
+      MarkUsed();
+    }
+    MaybeReleaseIdleBuffers();
+    return result;
+  }
+
+  tsi_result ProtectFlush(unsigned char *protected_output_frames,
+                          size_t *protected_output_frames_size,
+                          size_t *still_pending_size) {
+    tsi_result result;
+    {
+      absl::MutexLock lock(&mu_);
+      result = ProtectFlushLocked(protected_output_frames,
+                                  protected_output_frames_size,
+                                  still_pending_size);
+      MarkUsed();
+    }
+    MaybeReleaseIdleBuffers();
+    return result;
+  }
+
+  tsi_result Unprotect(const unsigned char *protected_frames_bytes,
+                       size_t *protected_frames_bytes_size,
+                       unsigned char *unprotected_bytes,
+                       size_t *unprotected_bytes_size) {
+    tsi_result result;
+    {
+      absl::MutexLock lock(&mu_);
+      result = UnprotectLocked(protected_frames_bytes,
+                               protected_frames_bytes_size, unprotected_bytes,
+                               unprotected_bytes_size);
+      MarkUsed();
+    }
+    MaybeReleaseIdleBuffers();
+    return result;
+  }
+
+  // Frees the buffers of the protector if it has been idle for its release
+  // time at |now_ns|, unless a call to it is in progress. Buffers still
+  // holding data of a partially sent or received frame are kept.
+  void ReleaseBuffersIfIdle(int64_t now_ns) {
+    if (idle_release_ns_ <= 0 || released_.load(std::memory_order_relaxed) ||
+        now_ns - last_used_ns_.load(std::memory_order_relaxed) <
+            idle_release_ns_ ||
+        !mu_.TryLock()) {
+      return;
+    }
+    if (protect_buffer_.empty()) {
+      CleansingVector<uint8_t>().swap(protect_buffer_);
+    }
+    if (frame_out_offset_ == frame_out_.size()) {
+      std::vector<uint8_t>().swap(frame_out_);
+      frame_out_offset_ = 0;
+    }
+    if (frame_in_.empty()) {
+      std::vector<uint8_t>().swap(frame_in_);
+    }
+    if (unprotect_offset_ == unprotect_buffer_.size()) {
+      CleansingVector<uint8_t>().swap(unprotect_buffer_);
+      unprotect_offset_ = 0;
+    }
+    UpdateHeldBytes();
+    released_.store(true, std::memory_order_relaxed);
+    mu_.Unlock();
+  }
+
+  // Bytes held by the buffers of the protector, and whether they are released.
+  size_t held_bytes() const {
+    return held_bytes_.load(std::memory_order_relaxed);
+  }
+  bool released() const { return released_.load(std::memory_order_relaxed); }
+
+ private:
+  tsi_result ProtectLocked(const unsigned char *unprotected_bytes,
+                           size_t *unprotected_bytes_size,
+                           unsigned char *protected_output_frames,
+                           size_t *protected_output_frames_size)
+      EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+    if (protect_buffer_.capacity() == 0) {
+      protect_buffer_.reserve(max_plaintext_size_);
+    }
+    size_t capacity = *protected_output_frames_size;
+    size_t written = WritePendingFrame(protected_output_frames, capacity);
+    size_t consumed = 0;
+
+    // Only buffer more data once the previous frame has been written out.
+    if (frame_out_offset_ == frame_out_.size()) {
+      consumed = std::min(*unprotected_bytes_size,
+                          max_plaintext_size_ - protect_buffer_.size());
+      protect_buffer_.insert(protect_buffer_.end(), unprotected_bytes,
+                             unprotected_bytes + consumed);
+      if (protect_buffer_.size() == max_plaintext_size_) {
+        if (!SealFrame()) {
+          return TSI_INTERNAL_ERROR;
+        }
+        written += WritePendingFrame(protected_output_frames + written,
+                                     capacity - written);
+      }
+    }
+
+    *unprotected_bytes_size = consumed;
+    *protected_output_frames_size = written;
+    return TSI_OK;
+  }
+
+  tsi_result ProtectFlushLocked(unsigned char *protected_output_frames,
+                                size_t *protected_output_frames_size,
+                                size_t *still_pending_size)
+      EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+    if (frame_out_offset_ == frame_out_.size() && !protect_buffer_.empty()) {
+      if (!SealFrame()) {
+        return TSI_INTERNAL_ERROR;
+      }
+    }
+    *protected_output_frames_size = WritePendingFrame(
+        protected_output_frames, *protected_output_frames_size);
+    *still_pending_size = frame_out_.size() - frame_out_offset_;
+    return TSI_OK;
+  }
+
+  tsi_result UnprotectLocked(const unsigned char *protected_frames_bytes,
+                             size_t *protected_frames_bytes_size,
+                             unsigned char *unprotected_bytes,
+                             size_t *unprotected_bytes_size)
+      EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+    size_t capacity = *unprotected_bytes_size;
+    size_t written = WritePendingPlaintext(unprotected_bytes, capacity);
+    size_t available = *protected_frames_bytes_size;
+    size_t consumed = 0;
+
+    // Only read the next frame once the plaintext of the previous frame has
+    // been handed out.
+    if (unprotect_offset_ == unprotect_buffer_.size()) {
+      if (frame_in_.size() < kFrameHeaderSize) {
+        consumed = std::min(kFrameHeaderSize - frame_in_.size(), available);
+        frame_in_.insert(frame_in_.end(), protected_frames_bytes,
+                         protected_frames_bytes + consumed);
+      }
+
+      if (frame_in_.size() >= kFrameHeaderSize) {
+        uint32_t length = LoadLittleEndian32(frame_in_.data());
+        if (length < kFrameMessageTypeFieldSize + kTagSize ||
+            length > kChaCha20Poly1305MaxFrameSize - kFrameLengthFieldSize ||
+            LoadLittleEndian32(frame_in_.data() + kFrameLengthFieldSize) !=
+                kFrameMessageType) {
+          gpr_log(GPR_ERROR, "Received a malformed frame header");
+          return TSI_DATA_CORRUPTED;
+        }
+
+        size_t frame_size = kFrameLengthFieldSize + length;
+        size_t remaining =
+            std::min(frame_size - frame_in_.size(), available - consumed);
+        frame_in_.insert(frame_in_.end(), protected_frames_bytes + consumed,
+                         protected_frames_bytes + consumed + remaining);
+        consumed += remaining;
+
+        if (frame_in_.size() == frame_size) {
+          if (!OpenFrame()) {
+            gpr_log(GPR_ERROR, "Failed to authenticate frame");
+            return TSI_DATA_CORRUPTED;
+          }
+          written += WritePendingPlaintext(unprotected_bytes + written,
+                                           capacity - written);
+        }
+      }
+    }
+
+    *protected_frames_bytes_size = consumed;
+    *unprotected_bytes_size = written;
+    return TSI_OK;
+  }
+
+  // Records a call to the protector.
+  void MarkUsed() EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+    UpdateHeldBytes();
+    released_.store(false, std::memory_order_relaxed);
+    if (idle_release_ns_ > 0) {
+      last_used_ns_.store(MonotonicNanoseconds(), std::memory_order_relaxed);
+    }
+  }
+
+  void UpdateHeldBytes() EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+    held_bytes_.store(protect_buffer_.capacity() + frame_out_.capacity() +
+                          frame_in_.capacity() + unprotect_buffer_.capacity(),
+                      std::memory_order_relaxed);
+  }
+
+  // Releases the buffers of idle protectors if the protector has an idle
+  // release time and no call to a protector has done so recently. Idle
+  // connections are thereby released by the traffic of the others.
+  void MaybeReleaseIdleBuffers() {
+    if (idle_release_ns_ <= 0) {
+      return;
+    }
+    FrameProtectorRegistry *registry = FrameProtectorRegistry::GetInstance();
+    int64_t now_ns = last_used_ns_.load(std::memory_order_relaxed);
+    int64_t next_ns = registry->next_release_ns.load(std::memory_order_relaxed);
+    int64_t interval_ns =
+        std::max(idle_release_ns_ / 2, kMinReleaseIntervalNs);
+    if (now_ns < next_ns ||
+        !registry->next_release_ns.compare_exchange_strong(
+            next_ns, now_ns + interval_ns, std::memory_order_relaxed)) {
+      return;
+    }
+    ReleaseIdleChaCha20Poly1305FrameProtectorBuffers();
+  }
+
+  // Sets |nonce| to the nonce of frame number |*counter| in the direction
+  // indicated by |from_client|, and advances |*counter|. Returns false if the
+  // counter is exhausted.
+  static bool NextNonce(bool from_client, uint64_t *counter,
+                        UnsafeBytes<kNonceSize> *nonce) {
+    if (*counter == std::numeric_limits<uint64_t>::max()) {
+      return false;
+    }
+    nonce->fill(0);
+    for (int i = 0; i < 8; ++i) {
+      (*nonce)[i] = static_cast<uint8_t>(*counter >> (8 * i));
+    }
+    if (!from_client) {
+      (*nonce)[kNonceSize - 1] = kServerNonceFlag;
+    }
+    ++*counter;
+    return true;
+  }
+
+  // Seals the buffered plaintext into |frame_out_|.
+  bool SealFrame() EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+    UnsafeBytes<kNonceSize> nonce;
+    if (!NextNonce(is_client_, &protect_counter_, &nonce)) {
+      return false;
+    }
+
+    size_t payload_size = protect_buffer_.size() + kTagSize;
+    frame_out_.resize(kFrameHeaderSize + payload_size);
+    StoreLittleEndian32(kFrameMessageTypeFieldSize + payload_size,
+                        frame_out_.data());
+    StoreLittleEndian32(kFrameMessageType,
+                        frame_out_.data() + kFrameLengthFieldSize);
+
+    size_t sealed_size = 0;
+    bool sealed =
+        EVP_AEAD_CTX_seal(&context_, frame_out_.data() + kFrameHeaderSize,
+                          &sealed_size, payload_size, nonce.data(),
+                          nonce.size(), protect_buffer_.data(),
+                          protect_buffer_.size(), frame_out_.data(),
+                          kFrameHeaderSize) == 1 &&
+        sealed_size == payload_size;
+    OPENSSL_cleanse(protect_buffer_.data(), protect_buffer_.size());
+    protect_buffer_.clear();
+    frame_out_offset_ = 0;
+    if (!sealed) {
+      frame_out_.clear();
+    }
+    return sealed;
+  }
+
+  // Opens the complete frame in |frame_in_| into |unprotect_buffer_|.
+  bool OpenFrame() EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+    UnsafeBytes<kNonceSize> nonce;
+    if (!NextNonce(!is_client_, &unprotect_counter_, &nonce)) {
+      return false;
+    }
+
+    size_t payload_size = frame_in_.size() - kFrameHeaderSize;
+    unprotect_buffer_.resize(payload_size - kTagSize);
+    size_t opened_size = 0;
+    bool opened =
+        EVP_AEAD_CTX_open(&context_, unprotect_buffer_.data(), &opened_size,
+                          unprotect_buffer_.size(), nonce.data(), nonce.size(),
+                          frame_in_.data() + kFrameHeaderSize, payload_size,
+                          frame_in_.data(), kFrameHeaderSize) == 1;
+    frame_in_.clear();
+    unprotect_offset_ = 0;
+    unprotect_buffer_.resize(opened ? opened_size : 0);
+    return opened;
+  }
+
+  // Copies as much of the pending outgoing frame as fits in |size| bytes to
+  // |output|. Returns the number of bytes copied.
+  size_t WritePendingFrame(unsigned char *output, size_t size)
+      EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+    size_t count = std::min(size, frame_out_.size() - frame_out_offset_);
+    memcpy(output, frame_out_.data() + frame_out_offset_, count);
+    frame_out_offset_ += count;
+    return count;
+  }
+
+  // Copies as much of the pending plaintext as fits in |size| bytes to
+  // |output|. Returns the number of bytes copied.
+  size_t WritePendingPlaintext(unsigned char *output, size_t size)
+      EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+    size_t count =
+        std::min(size, unprotect_buffer_.size() - unprotect_offset_);
+    memcpy(output, unprotect_buffer_.data() + unprotect_offset_, count);
+    unprotect_offset_ += count;
+    return count;
+  }
+
+  const bool is_client_;
+  const size_t max_plaintext_size_;
+  const int64_t idle_release_ns_;
+
+  EVP_AEAD_CTX context_;
+  bool context_initialized_;
+
+  // Serializes calls to the protector with the release of its buffers.
+  absl::Mutex mu_;
+
+  // Counters of frames sealed and opened.
+  uint64_t protect_counter_ GUARDED_BY(mu_);
+  uint64_t unprotect_counter_ GUARDED_BY(mu_);
+
+  // Plaintext buffered for the next outgoing frame.
+  CleansingVector<uint8_t> protect_buffer_ GUARDED_BY(mu_);
+
+  // The last sealed frame, and the number of its bytes handed to the caller.
+  std::vector<uint8_t> frame_out_ GUARDED_BY(mu_);
+  size_t frame_out_offset_ GUARDED_BY(mu_);
+
+  // The bytes of the incoming frame received so far.
+  std::vector<uint8_t> frame_in_ GUARDED_BY(mu_);
+
+  // The plaintext of the last opened frame, and the number of its bytes handed
+  // to the caller.
+  CleansingVector<uint8_t> unprotect_buffer_ GUARDED_BY(mu_);
+  size_t unprotect_offset_ GUARDED_BY(mu_);
+
+  // Time of the last call to the protector, if it has an idle release time.
+  std::atomic<int64_t> last_used_ns_;
+
+  // Capacity of the buffers, and whether they were released since the last
+  // call, read without |mu_| for reporting.
+  std::atomic<size_t> held_bytes_;
+  std::atomic<bool> released_;
+};
+
+// C-compatible wrapper that gRPC sees as a tsi_frame_protector.
+struct ChaCha20Poly1305FrameProtector {
+  tsi_frame_protector base;
+  FrameProtector *impl;
+};
+
+FrameProtector *GetImpl(tsi_frame_protector *self) {
+  return reinterpret_cast<ChaCha20Poly1305FrameProtector *>(self)->impl;
+}
+
+tsi_result Protect(tsi_frame_protector *self,
+                   const unsigned char *unprotected_bytes,
+                   size_t *unprotected_bytes_size,
+                   unsigned char *protected_output_frames,
+                   size_t *protected_output_frames_size) {
+  if (self == nullptr || unprotected_bytes == nullptr ||
+      unprotected_bytes_size == nullptr || protected_output_frames == nullptr ||
+      protected_output_frames_size == nullptr) {
+    return TSI_INVALID_ARGUMENT;
+  }
+  return GetImpl(self)->Protect(unprotected_bytes, unprotected_bytes_size,
+                                protected_output_frames,
+                                protected_output_frames_size);
+}
+
+tsi_result ProtectFlush(tsi_frame_protector *self,
+                        unsigned char *protected_output_frames,
+                        size_t *protected_output_frames_size,
+                        size_t *still_pending_size) {
+  if (self == nullptr || protected_output_frames == nullptr ||
+      protected_output_frames_size == nullptr ||
+      still_pending_size == nullptr) {
+    return TSI_INVALID_ARGUMENT;
+  }
+  return GetImpl(self)->ProtectFlush(protected_output_frames,
+                                     protected_output_frames_size,
+                                     still_pending_size);
+}
+
+tsi_result Unprotect(tsi_frame_protector *self,
+                     const unsigned char *protected_frames_bytes,
+                     size_t *protected_frames_bytes_size,
+                     unsigned char *unprotected_bytes,
+                     size_t *unprotected_bytes_size) {
+  if (self == nullptr || protected_frames_bytes == nullptr ||
+      protected_frames_bytes_size == nullptr || unprotected_bytes == nullptr ||
+      unprotected_bytes_size == nullptr) {
+    return TSI_INVALID_ARGUMENT;
+  }
+  return GetImpl(self)->Unprotect(protected_frames_bytes,
+                                  protected_frames_bytes_size,
+                                  unprotected_bytes, unprotected_bytes_size);
+}
+
+void Destroy(tsi_frame_protector *self) {
+  if (self == nullptr) {
+    return;
+  }
+  ChaCha20Poly1305FrameProtector *protector =
+      reinterpret_cast<ChaCha20Poly1305FrameProtector *>(self);
+  delete protector->impl;
+  delete protector;
+}
+
+const tsi_frame_protector_vtable kChaCha20Poly1305FrameProtectorVtable = {
+    Protect, ProtectFlush, Unprotect, Destroy};
+
+}  // namespace
+
+tsi_result CreateChaCha20Poly1305FrameProtector(
+    ByteContainerView key, bool is_client,
+    size_t *max_output_protected_frame_size, int idle_release_ms,
+    tsi_frame_protector **protector) {
+  if (protector == nullptr) {
+    gpr_log(GPR_ERROR, "Invalid nullptr arguments to protector create");
+    return TSI_INVALID_ARGUMENT;
+  }
+
+  size_t max_frame_size = kChaCha20Poly1305DefaultFrameSize;
+  if (max_output_protected_frame_size != nullptr) {
+    if (*max_output_protected_frame_size != 0) {
+      max_frame_size = std::min(
+          std::max(*max_output_protected_frame_size,
+                   kChaCha20Poly1305MinFrameSize),
+          kChaCha20Poly1305MaxFrameSize);
+    }
+    *max_output_protected_frame_size = max_frame_size;
+  }
+
+  auto impl = absl::make_unique<FrameProtector>(
+      is_client, max_frame_size,
+      static_cast<int64_t>(std::max(idle_release_ms, 0)) * 1000000);
+  if (!impl->Init(key)) {
+    gpr_log(GPR_ERROR, "Failed to initialize ChaCha20-Poly1305 context");
+    return TSI_INTERNAL_ERROR;
+  }
+
+  ChaCha20Poly1305FrameProtector *chacha_protector =
+      new ChaCha20Poly1305FrameProtector;
+  chacha_protector->base.vtable = &kChaCha20Poly1305FrameProtectorVtable;
+  chacha_protector->impl = impl.release();
+  *protector = &chacha_protector->base;
+  return TSI_OK;
+}
+
+void ReleaseIdleChaCha20Poly1305FrameProtectorBuffers() {
+  int64_t now_ns = MonotonicNanoseconds();
+  FrameProtectorRegistry *registry = FrameProtectorRegistry::GetInstance();
+  absl::MutexLock lock(&registry->mu);
+  for (FrameProtector *protector : registry->protectors) {
+    protector->ReleaseBuffersIfIdle(now_ns);
+  }
+}
+
+FrameProtectorMemoryStats GetChaCha20Poly1305FrameProtectorMemoryStats() {
+  FrameProtectorMemoryStats stats;
+  FrameProtectorRegistry *registry = FrameProtectorRegistry::GetInstance();
+  absl::MutexLock lock(&registry->mu);
+  for (const FrameProtector *protector : registry->protectors) {
+    size_t held_bytes = protector->held_bytes();
+    stats.protectors++;
+    if (protector->released()) {
+      stats.idle_protectors++;
+    }
+    stats.buffer_bytes += held_bytes;
+    stats.max_protector_buffer_bytes =
+        std::max(stats.max_protector_buffer_bytes, held_bytes);
+  }
+  return stats;
+}
+
+}  // namespace asylo
+
+extern "C" void enc_get_frame_protector_usage(
+    struct enc_frame_protector_usage *usage) {
+  asylo::FrameProtectorMemoryStats stats =
+      asylo::GetChaCha20Poly1305FrameProtectorMemoryStats();
+  usage->protectors = stats.protectors;
+  usage->idle_protectors = stats.idle_protectors;
+  usage->buffer_bytes = stats.buffer_bytes;
+  usage->max_protector_buffer_bytes = stats.max_protector_buffer_bytes;
+}
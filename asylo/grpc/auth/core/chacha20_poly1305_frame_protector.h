@@ -0,0 +1,85 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_GRPC_AUTH_CORE_CHACHA20_POLY1305_FRAME_PROTECTOR_H_
+#define ASYLO_GRPC_AUTH_CORE_CHACHA20_POLY1305_FRAME_PROTECTOR_H_
+
+#include <cstddef>
+
+#include "asylo/crypto/util/byte_container_view.h"
+#include "src/core/tsi/transport_security_interface.h"
+
+namespace asylo {
+
+// The bounds and the default of the maximum protected frame size.
+constexpr size_t kChaCha20Poly1305MinFrameSize = 1024;
+constexpr size_t kChaCha20Poly1305DefaultFrameSize = 16 * 1024;
+constexpr size_t kChaCha20Poly1305MaxFrameSize = 1024 * 1024;
+
+// Creates a frame protector for the SEAL_CHACHA20_POLY1305 record protocol and
+// places the result in |protector|. The protector uses |key|, which must be a
+// 32-byte ChaCha20-Poly1305 key, in both directions; |is_client| selects the
+// half of the nonce space used for outgoing frames.
+//
+// Frames use the SEAL framing: a 4-byte little-endian length of the rest of the
+// frame, a 4-byte little-endian message type, and the sealed payload. Each
+// frame's nonce is a 64-bit frame counter, and the frame header is
+// authenticated as additional data.
+//
+// If |max_output_protected_frame_size| is non-null, it is clamped to
+// [kChaCha20Poly1305MinFrameSize, kChaCha20Poly1305MaxFrameSize], or set to
+// kChaCha20Poly1305DefaultFrameSize if zero, and the result is the size of the
+// frames produced by the protector.
+//
+// If |idle_release_ms| is positive, the protector frees its frame buffers once
+// it has been idle for that many milliseconds, and allocates them again when
+// the connection is next used. See
+// ReleaseIdleChaCha20Poly1305FrameProtectorBuffers().
+tsi_result CreateChaCha20Poly1305FrameProtector(
+    ByteContainerView key, bool is_client,
+    size_t *max_output_protected_frame_size, int idle_release_ms,
+    tsi_frame_protector **protector);
+
+// Frees the frame buffers of the protectors which have been idle for longer
+// than their idle release time. Calls to protectors with an idle release time
+// do this at most once per half of that time, so the buffers of idle
+// connections are freed as long as some connection is in use. Processes whose
+// connections may all be idle at once can also call this periodically.
+void ReleaseIdleChaCha20Poly1305FrameProtectorBuffers();
+
+// Memory held by the live ChaCha20-Poly1305 frame protectors, one per
+// connection.
+struct FrameProtectorMemoryStats {
+  // Live protectors, and those whose buffers are released.
+  size_t protectors = 0;
+  size_t idle_protectors = 0;
+
+  // Bytes held by the frame buffers of all protectors, and of the protector
+  // holding the most.
+  size_t buffer_bytes = 0;
+  size_t max_protector_buffer_bytes = 0;
+};
+
+// Returns the memory held by the live ChaCha20-Poly1305 frame protectors. The
+// same totals are reported in the frame protector fields of
+// EnclaveResourceStats.
+FrameProtectorMemoryStats GetChaCha20Poly1305FrameProtectorMemoryStats();
+
+}  // namespace asylo
+
+#endif  // ASYLO_GRPC_AUTH_CORE_CHACHA20_POLY1305_FRAME_PROTECTOR_H_
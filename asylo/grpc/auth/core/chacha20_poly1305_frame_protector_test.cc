@@ -0,0 +1,228 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/grpc/auth/core/chacha20_poly1305_frame_protector.h"
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include "asylo/crypto/util/bytes.h"
+#include "asylo/crypto/util/trivial_object_util.h"
+
+namespace asylo {
+namespace {
+
+constexpr size_t kKeySize = 32;
+
+// The size of the output buffer passed to the protector. It is deliberately
+// smaller than a frame, so that frames are handed out in several pieces.
+constexpr size_t kBufferSize = 100;
+
+class ChaCha20Poly1305FrameProtectorTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    key_ = TrivialRandomObject<SafeBytes<kKeySize>>();
+    CreateProtectors(/*idle_release_ms=*/0);
+  }
+
+  // Replaces |client_| and |server_| with protectors that release their
+  // buffers after |idle_release_ms|.
+  void CreateProtectors(int idle_release_ms) {
+    tsi_frame_protector_destroy(client_);
+    tsi_frame_protector_destroy(server_);
+    client_ = nullptr;
+    server_ = nullptr;
+    size_t frame_size = kChaCha20Poly1305MinFrameSize;
+    ASSERT_EQ(CreateChaCha20Poly1305FrameProtector(key_, /*is_client=*/true,
+                                                   &frame_size,
+                                                   idle_release_ms, &client_),
+              TSI_OK);
+    ASSERT_EQ(CreateChaCha20Poly1305FrameProtector(key_, /*is_client=*/false,
+                                                   &frame_size,
+                                                   idle_release_ms, &server_),
+              TSI_OK);
+  }
+
+  void TearDown() override {
+    tsi_frame_protector_destroy(client_);
+    tsi_frame_protector_destroy(server_);
+  }
+
+  // Protects |message| with |protector| and returns the protected frames.
+  std::vector<uint8_t> Protect(tsi_frame_protector *protector,
+                               const std::string &message) {
+    std::vector<uint8_t> frames;
+    unsigned char buffer[kBufferSize];
+    const unsigned char *input =
+        reinterpret_cast<const unsigned char *>(message.data());
+    size_t remaining = message.size();
+    while (remaining > 0) {
+      size_t consumed = remaining;
+      size_t written = sizeof(buffer);
+      EXPECT_EQ(tsi_frame_protector_protect(protector, input, &consumed,
+                                            buffer, &written),
+                TSI_OK);
+      frames.insert(frames.end(), buffer, buffer + written);
+      input += consumed;
+      remaining -= consumed;
+    }
+
+    size_t still_pending = 0;
+    do {
+      size_t written = sizeof(buffer);
+      EXPECT_EQ(tsi_frame_protector_protect_flush(protector, buffer, &written,
+                                                  &still_pending),
+                TSI_OK);
+      frames.insert(frames.end(), buffer, buffer + written);
+    } while (still_pending > 0);
+    return frames;
+  }
+
+  // Unprotects |frames| with |protector| and places the result in |message|.
+  tsi_result Unprotect(tsi_frame_protector *protector,
+                       const std::vector<uint8_t> &frames,
+                       std::string *message) {
+    message->clear();
+    unsigned char buffer[kBufferSize];
+    const unsigned char *input = frames.data();
+    size_t remaining = frames.size();
+    size_t written = 0;
+    do {
+      size_t consumed = remaining;
+      written = sizeof(buffer);
+      tsi_result result = tsi_frame_protector_unprotect(
+          protector, input, &consumed, buffer, &written);
+      if (result != TSI_OK) {
+        return result;
+      }
+      message->append(reinterpret_cast<char *>(buffer), written);
+      input += consumed;
+      remaining -= consumed;
+    } while (remaining > 0 || written > 0);
+    return TSI_OK;
+  }
+
+  SafeBytes<kKeySize> key_;
+  tsi_frame_protector *client_ = nullptr;
+  tsi_frame_protector *server_ = nullptr;
+};
+
+// Verify that messages larger than a frame round-trip in both directions.
+TEST_F(ChaCha20Poly1305FrameProtectorTest, RoundTrip) {
+  std::string message(5 * kChaCha20Poly1305MinFrameSize + 17, 'm');
+  for (size_t i = 0; i < message.size(); ++i) {
+    message[i] = static_cast<char>(i);
+  }
+
+  std::string unprotected;
+  ASSERT_EQ(Unprotect(server_, Protect(client_, message), &unprotected),
+            TSI_OK);
+  EXPECT_EQ(unprotected, message);
+
+  ASSERT_EQ(Unprotect(client_, Protect(server_, message), &unprotected),
+            TSI_OK);
+  EXPECT_EQ(unprotected, message);
+}
+
+// Verify that a modified frame is rejected.
+TEST_F(ChaCha20Poly1305FrameProtectorTest, TamperedFrameIsRejected) {
+  std::vector<uint8_t> frames = Protect(client_, "Hello, enclave");
+  frames.back() ^= 1;
+
+  std::string unprotected;
+  EXPECT_EQ(Unprotect(server_, frames, &unprotected), TSI_DATA_CORRUPTED);
+}
+
+// Verify that a frame cannot be reflected back to its sender.
+TEST_F(ChaCha20Poly1305FrameProtectorTest, ReflectedFrameIsRejected) {
+  std::string unprotected;
+  EXPECT_EQ(Unprotect(client_, Protect(client_, "Hello, enclave"),
+                      &unprotected),
+            TSI_DATA_CORRUPTED);
+}
+
+// Verify that a replayed frame is rejected.
+TEST_F(ChaCha20Poly1305FrameProtectorTest, ReplayedFrameIsRejected) {
+  std::vector<uint8_t> frames = Protect(client_, "Hello, enclave");
+
+  std::string unprotected;
+  ASSERT_EQ(Unprotect(server_, frames, &unprotected), TSI_OK);
+  EXPECT_EQ(Unprotect(server_, frames, &unprotected), TSI_DATA_CORRUPTED);
+}
+
+// Verify that idle protectors release their buffers, and that the connection
+// continues where it left off once they are used again.
+TEST_F(ChaCha20Poly1305FrameProtectorTest, IdleProtectorsReleaseBuffers) {
+  CreateProtectors(/*idle_release_ms=*/1);
+  std::string message(3 * kChaCha20Poly1305MinFrameSize, 'm');
+  std::string unprotected;
+  ASSERT_EQ(Unprotect(server_, Protect(client_, message), &unprotected),
+            TSI_OK);
+  FrameProtectorMemoryStats busy =
+      GetChaCha20Poly1305FrameProtectorMemoryStats();
+  EXPECT_GE(busy.protectors, 2);
+  EXPECT_GT(busy.buffer_bytes, 0);
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  ReleaseIdleChaCha20Poly1305FrameProtectorBuffers();
+  FrameProtectorMemoryStats idle =
+      GetChaCha20Poly1305FrameProtectorMemoryStats();
+  EXPECT_GE(idle.idle_protectors, 2);
+  EXPECT_LT(idle.buffer_bytes, busy.buffer_bytes);
+
+  ASSERT_EQ(Unprotect(server_, Protect(client_, message), &unprotected),
+            TSI_OK);
+  EXPECT_EQ(unprotected, message);
+  ASSERT_EQ(Unprotect(client_, Protect(server_, message), &unprotected),
+            TSI_OK);
+  EXPECT_EQ(unprotected, message);
+}
+
+// Verify that the maximum frame size is clamped to the supported range.
+TEST(ChaCha20Poly1305FrameProtectorCreateTest, ClampsMaxFrameSize) {
+  SafeBytes<kKeySize> key = TrivialRandomObject<SafeBytes<kKeySize>>();
+  for (size_t requested : {size_t{0}, size_t{1}, size_t{1} << 30}) {
+    size_t frame_size = requested;
+    tsi_frame_protector *protector = nullptr;
+    ASSERT_EQ(CreateChaCha20Poly1305FrameProtector(
+                  key, /*is_client=*/true, &frame_size,
+                  /*idle_release_ms=*/0, &protector),
+              TSI_OK);
+    EXPECT_GE(frame_size, kChaCha20Poly1305MinFrameSize);
+    EXPECT_LE(frame_size, kChaCha20Poly1305MaxFrameSize);
+    tsi_frame_protector_destroy(protector);
+  }
+}
+
+// Verify that a key of the wrong size is rejected.
+TEST(ChaCha20Poly1305FrameProtectorCreateTest, BadKeySize) {
+  SafeBytes<16> key = TrivialRandomObject<SafeBytes<16>>();
+  tsi_frame_protector *protector = nullptr;
+  EXPECT_NE(CreateChaCha20Poly1305FrameProtector(
+                key, /*is_client=*/true,
+                /*max_output_protected_frame_size=*/nullptr,
+                /*idle_release_ms=*/0, &protector),
+            TSI_OK);
+}
+
+}  // namespace
+}  // namespace asylo
@@ -19,14 +19,15 @@
 #include "asylo/grpc/auth/core/client_ekep_handshaker.h"
 
 #include <openssl/curve25519.h>
-#include <openssl/rand.h>
 
 #include <algorithm>
 
-#include <google/protobuf/io/zero_copy_stream_impl_lite.h>
 #include "absl/memory/memory.h"
 #include "absl/strings/str_cat.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
 #include "asylo/crypto/sha256_hash.h"
+#include "asylo/crypto/util/hardware_random.h"
 #include "asylo/util/logging.h"
 #include "asylo/grpc/auth/core/ekep_crypto.h"
 #include "asylo/grpc/auth/core/ekep_error_space.h"
@@ -52,9 +53,17 @@ ClientEkepHandshaker::ClientEkepHandshaker(const EkepHandshakerOptions &options)
       self_assertions_(options.self_assertions),
       accepted_peer_assertions_(options.accepted_peer_assertions),
       available_cipher_suites_({CURVE25519_SHA256}),
-      available_record_protocols_({SEAL_AES128_GCM}),
+      available_record_protocols_(SupportedRecordProtocols()),
       available_ekep_versions_({"EKEP v1"}),
       additional_authenticated_data_(options.additional_authenticated_data),
+      session_cache_(options.session_cache),
+      session_cache_key_(options.session_cache_key),
+      negotiation_cache_(options.negotiation_cache),
+      verified_assertion_cache_(options.verified_assertion_cache),
+      ephemeral_key_pool_(options.ephemeral_key_pool),
+      client_precommit_cache_(options.client_precommit_cache),
+      resumed_session_(false),
+      early_client_id_cipher_suite_(UNKNOWN_HANDSHAKE_CIPHER),
       selected_cipher_suite_(UNKNOWN_HANDSHAKE_CIPHER),
       selected_record_protocol_(UNKNOWN_RECORD_PROTOCOL),
       expected_message_type_(SERVER_PRECOMMIT),
@@ -102,8 +111,7 @@ void ClientEkepHandshaker::AbortHandshake(const Status &abort_status,
   abort.set_message(std::string(abort_status.error_message().data(),
                            abort_status.error_message().size()));
 
-  google::protobuf::io::StringOutputStream outgoing_frame(output);
-  Status status = EncodeFrame(ABORT, abort, &outgoing_frame);
+  Status status = EncodeFrame(ABORT, abort, output);
   if (!status.ok()) {
     // An error occurred while attempting to notify the peer of another error.
     // There is nothing left to do at this point.
@@ -119,8 +127,9 @@ ClientEkepHandshaker::Result ClientEkepHandshaker::HandleHandshakeMessage(
   Status status = Status::OkStatus();
   switch (message_type) {
     case SERVER_PRECOMMIT:
-      expected_message_type_ = SERVER_ID;
       status = HandleServerPrecommit(handshake_message, output);
+      // An abbreviated handshake skips the ServerId message.
+      expected_message_type_ = resumed_session_ ? SERVER_FINISH : SERVER_ID;
       break;
     case SERVER_ID:
       expected_message_type_ = SERVER_FINISH;
@@ -255,6 +264,22 @@ Status ClientEkepHandshaker::HandleServerPrecommit(
     }
   }
 
+  if (server_precommit.early_client_id_accepted()) {
+    if (early_client_id_cipher_suite_ == UNKNOWN_HANDSHAKE_CIPHER) {
+      return Status(Abort_ErrorCode_PROTOCOL_ERROR,
+                    "Server accepted an early ClientId that was not sent");
+    }
+    if (selected_cipher_suite_ != early_client_id_cipher_suite_) {
+      return Status(Abort_ErrorCode_PROTOCOL_ERROR,
+                    "Server accepted an early ClientId for a different cipher "
+                    "suite");
+    }
+  }
+
+  if (server_precommit.resumption_accepted()) {
+    return ResumeSession(server_precommit);
+  }
+
   // Save a description of each assertion that is offered by the server. This
   // information is used later to validate the ServerId message.
   std::transform(
@@ -264,9 +289,41 @@ Status ClientEkepHandshaker::HandleServerPrecommit(
       [](const AssertionOffer &offer) -> const AssertionDescription & {
         return offer.description();
       });
+  server_requests_ = server_precommit.server_requests();
+
+  std::string transcript_hash;
+  Status status = GetTranscriptHash(&transcript_hash);
+  if (!status.ok()) {
+    return status;
+  }
+
+  if (server_precommit.early_client_id_accepted()) {
+    // The server sends its ServerId next. At this stage in the protocol, the
+    // transcript is:
+    //   hash(ClientPrecommit || ClientId || ServerPrecommit)
+    //
+    // The server binds its assertions to this transcript.
+    server_assertion_transcript_ = transcript_hash;
+    return Status::OkStatus();
+  }
 
-  return WriteClientId(server_precommit.server_requests().cbegin(),
-                       server_precommit.server_requests().cend(), output);
+  // At this stage in the protocol, the transcript is:
+  //   hash(ClientPrecommit || ServerPrecommit)
+  // or, if the server rejected an early ClientId:
+  //   hash(ClientPrecommit || ClientId || ServerPrecommit)
+  //
+  // The client binds its assertions to this transcript.
+  status = WriteClientId(selected_cipher_suite_,
+                         server_precommit.server_requests().cbegin(),
+                         server_precommit.server_requests().cend(),
+                         transcript_hash, output);
+  if (!status.ok()) {
+    return status;
+  }
+
+  // The server will bind its assertions to the transcript that includes the
+  // ClientId so the client must save a snapshot of the transcript at this time.
+  return GetTranscriptHash(&server_assertion_transcript_);
 }
 
 Status ClientEkepHandshaker::HandleServerId(const google::protobuf::Message &message) {
@@ -300,15 +357,22 @@ Status ClientEkepHandshaker::HandleServerId(const google::protobuf::Message &mes
     // Note that assertion verifiers were verified during creation of the
     // handshaker so there is no need to check whether the call to
     // GetEnclaveAssertionVerifier() returns nullptr.
+    const EnclaveAssertionVerifier *verifier =
+        GetEnclaveAssertionVerifier(assertion.description());
     Status status =
-        GetEnclaveAssertionVerifier(assertion.description())
-            ->Verify(/*user_data=*/ekep_context, assertion, &identity);
+        verified_assertion_cache_
+            ? verified_assertion_cache_->Verify(
+                  *verifier, /*user_data=*/ekep_context, assertion, &identity,
+                  message_arena())
+            : verifier->Verify(/*user_data=*/ekep_context, assertion,
+                               &identity, message_arena());
     if (!status.ok()) {
       LOG(ERROR) << "Assertion could not be verified: " << status;
       return Status(Abort_ErrorCode_BAD_ASSERTION,
                     "Assertion could not be verified");
     }
     AddPeerIdentity(identity);
+    verified_peer_assertions_.push_back(*desc_it);
     expected_peer_assertions_.erase(desc_it);
   }
 
@@ -366,44 +430,119 @@ Status ClientEkepHandshaker::HandleServerFinish(const google::protobuf::Message
                   "Server handshake authenticator value is incorrect");
   }
 
-  return WriteClientFinish(output);
+  status = WriteClientFinish(output);
+  if (!status.ok()) {
+    return status;
+  }
+
+  // Failure to store the session only prevents its later resumption, so it
+  // does not abort the handshake.
+  if (session_cache_ && !server_finish.resumption_ticket().empty()) {
+    Status store_status = StoreSession(server_finish);
+    if (!store_status.ok()) {
+      LOG(WARNING) << "Failed to store EKEP session: " << store_status;
+    }
+  }
+
+  // Only a full handshake reveals which assertions the server requests.
+  if (negotiation_cache_ && !resumed_session_) {
+    EkepNegotiation negotiation;
+    negotiation.cipher_suite = selected_cipher_suite_;
+    negotiation.server_requests = server_requests_;
+    negotiation_cache_->Put(session_cache_key_, std::move(negotiation));
+  }
+  return Status::OkStatus();
 }
 
-Status ClientEkepHandshaker::WriteClientPrecommit(std::string *output) {
-  ClientPrecommit client_precommit;
+Status ClientEkepHandshaker::ResumeSession(
+    const ServerPrecommit &server_precommit) {
+  if (!offered_session_) {
+    return Status(Abort_ErrorCode_PROTOCOL_ERROR,
+                  "Server accepted a resumption ticket that was not offered");
+  }
+  if (selected_cipher_suite_ != offered_session_->cipher_suite) {
+    return Status(Abort_ErrorCode_PROTOCOL_ERROR,
+                  "Server resumed a session with a different cipher suite");
+  }
+
+  // Every assertion the server offers must have been verified when the session
+  // was established. Otherwise the server would be claiming identities that the
+  // client never checked.
+  for (const AssertionOffer &offer : server_precommit.server_offers()) {
+    if (FindAssertionDescription(offered_session_->peer_assertions,
+                                 offer.description()) ==
+        offered_session_->peer_assertions.cend()) {
+      return Status(Abort_ErrorCode_BAD_ASSERTION,
+                    "Resumed session lacks an assertion offered by the server");
+    }
+  }
+
+  for (const EnclaveIdentity &identity :
+       offered_session_->peer_identities.identities()) {
+    AddPeerIdentity(identity);
+  }
+  verified_peer_assertions_ = offered_session_->peer_assertions;
+  resumed_session_ = true;
+
+  // In an abbreviated handshake, the EKEP secrets are derived from the
+  // resumption secret and the transcript:
+  //   hash(ClientPrecommit || ServerPrecommit)
+  std::string transcript_hash;
+  Status status = GetTranscriptHash(&transcript_hash);
+  if (!status.ok()) {
+    return status;
+  }
+  return DeriveResumedSecrets(selected_cipher_suite_, transcript_hash,
+                              offered_session_->resumption_secret,
+                              &master_secret_, &authenticator_secret_);
+}
+
+Status ClientEkepHandshaker::StoreSession(const ServerFinish &server_finish) {
+  EkepSession session;
+  Status status = DeriveResumptionSecret(
+      selected_cipher_suite_, master_secret_, &session.resumption_secret);
+  if (!status.ok()) {
+    return status;
+  }
+
+  session.ticket = server_finish.resumption_ticket();
+  session.cipher_suite = selected_cipher_suite_;
+  session.peer_assertions = verified_peer_assertions_;
+  session.peer_identities = PeerIdentities();
+  session.expiration =
+      absl::Now() + absl::Seconds(server_finish.resumption_ticket_lifetime());
+  session_cache_->Put(session_cache_key_, std::move(session));
+  return Status::OkStatus();
+}
 
+Status ClientEkepHandshaker::BuildClientPrecommitPrefix(
+    ClientPrecommit *client_precommit) const {
   std::copy(available_cipher_suites_.begin(), available_cipher_suites_.end(),
             google::protobuf::RepeatedFieldBackInserter(
-                client_precommit.mutable_available_cipher_suites()));
+                client_precommit->mutable_available_cipher_suites()));
 
   std::copy(available_record_protocols_.begin(),
             available_record_protocols_.end(),
             google::protobuf::RepeatedFieldBackInserter(
-                client_precommit.mutable_available_record_protocols()));
+                client_precommit->mutable_available_record_protocols()));
 
   for (const std::string &version_name : available_ekep_versions_) {
-    EkepVersion *ekep_version = client_precommit.add_available_ekep_versions();
+    EkepVersion *ekep_version = client_precommit->add_available_ekep_versions();
     ekep_version->set_name(version_name);
   }
 
   if (!additional_authenticated_data_.empty()) {
-    client_precommit.mutable_options()->set_data(
+    client_precommit->mutable_options()->set_data(
         additional_authenticated_data_);
   }
 
-  std::vector<uint8_t> challenge(kEkepChallengeSize);
-  if (RAND_bytes(challenge.data(), kEkepChallengeSize) != 1) {
-    return Status(Abort_ErrorCode_INTERNAL_ERROR, "Internal error");
-  }
-  client_precommit.set_challenge(challenge.data(), challenge.size());
-
   for (const AssertionDescription &description : self_assertions_) {
     // Note that assertion generators were verified during creation of the
     // handshaker so there is no need to check whether the call to
     // GetEnclaveAssertionGenerator() returns nullptr.
     Status status =
         GetEnclaveAssertionGenerator(description)
-            ->CreateAssertionOffer(client_precommit.add_client_offers());
+            ->CreateAssertionOffer(client_precommit->add_client_offers());
     if (!status.ok()) {
       LOG(ERROR) << "Failed to create assertion offer: " << status;
       return Status(Abort_ErrorCode_INTERNAL_ERROR,
@@ -417,30 +556,125 @@ Status ClientEkepHandshaker::WriteClientPrecommit(std::string *output) {
     // GetEnclaveAssertionVerifier() returns nullptr.
     Status status =
         GetEnclaveAssertionVerifier(description)
-            ->CreateAssertionRequest(client_precommit.add_client_requests());
+            ->CreateAssertionRequest(client_precommit->add_client_requests());
     if (!status.ok()) {
       LOG(ERROR) << "Failed to create assertion request: " << status;
       return Status(Abort_ErrorCode_INTERNAL_ERROR,
                     "Failed to create assertion request");
     }
   }
+  return Status::OkStatus();
+}
+
+Status ClientEkepHandshaker::WriteClientPrecommit(std::string *output) {
+  // The fields that are the same in every handshake precede the others in
+  // field-number order, so the ClientPrecommit is serialized as those fields,
+  // which may come from |client_precommit_cache_|, followed by the rest.
+  std::string serialized_precommit;
+  if (client_precommit_cache_) {
+    Status status = client_precommit_cache_->AppendTo(
+        [this](ClientPrecommit *prefix) {
+          return BuildClientPrecommitPrefix(prefix);
+        },
+        &serialized_precommit);
+    if (!status.ok()) {
+      return status;
+    }
+  } else {
+    ClientPrecommit prefix;
+    Status status = BuildClientPrecommitPrefix(&prefix);
+    if (!status.ok()) {
+      return status;
+    }
+    prefix.AppendToString(&serialized_precommit);
+  }
+
+  ClientPrecommit client_precommit;
+  std::vector<uint8_t> challenge(kEkepChallengeSize);
+  if (!GetHardwareRandBytes(challenge.data(), kEkepChallengeSize)) {
+    return Status(Abort_ErrorCode_INTERNAL_ERROR, "Internal error");
+  }
+  client_precommit.set_challenge(challenge.data(), challenge.size());
+
+  // Sessions are taken out of the cache when offered, so that each ticket is
+  // presented at most once. A successful handshake stores a fresh session.
+  if (session_cache_) {
+    auto session = absl::make_unique<EkepSession>();
+    if (session_cache_->Take(session_cache_key_, session.get())) {
+      client_precommit.set_resumption_ticket(session->ticket);
+      offered_session_ = std::move(session);
+    }
+  }
+
+  // A client that offers a ticket expects an abbreviated handshake, in which
+  // there is no ClientId to send early.
+  EkepNegotiation negotiation;
+  bool send_early_client_id =
+      negotiation_cache_ && !offered_session_ &&
+      negotiation_cache_->Get(session_cache_key_, &negotiation) &&
+      std::find(available_cipher_suites_.cbegin(),
+                available_cipher_suites_.cend(),
+                negotiation.cipher_suite) != available_cipher_suites_.cend();
+  if (send_early_client_id) {
+    client_precommit.set_early_client_id_cipher_suite(negotiation.cipher_suite);
+  }
+
+  client_precommit.AppendToString(&serialized_precommit);
 
   // There is no need to save the transcript at this point in the handshake.
-  return WriteFrameAndUpdateTranscript(CLIENT_PRECOMMIT, client_precommit,
-                                       output);
+  size_t offset = output->size();
+  Status status = WriteSerializedFrameAndUpdateTranscript(
+      CLIENT_PRECOMMIT, serialized_precommit, output);
+  if (!status.ok() || !send_early_client_id) {
+    return status;
+  }
+  return WriteEarlyClientId(negotiation, output->substr(offset), output);
+}
+
+Status ClientEkepHandshaker::WriteEarlyClientId(
+    const EkepNegotiation &negotiation,
+    const std::string &client_precommit_frame, std::string *output) {
+  // The transcript hash function is set only once the server selects a cipher
+  // suite, so the early ClientId binds its assertions to a hash of the
+  // ClientPrecommit frame computed with the anticipated cipher suite:
+  //   hash(ClientPrecommit)
+  std::unique_ptr<HashInterface> hash;
+  switch (negotiation.cipher_suite) {
+    case CURVE25519_SHA256:
+      hash = absl::make_unique<Sha256Hash>();
+      break;
+    default:
+      LOG(ERROR) << "Client handshaker has bad cipher suite configuration"
+                 << HandshakeCipher_Name(negotiation.cipher_suite);
+      return Status(Abort_ErrorCode_INTERNAL_ERROR,
+                    "Error using anticipated cipher suite");
+  }
+  hash->Update(client_precommit_frame.data(), client_precommit_frame.size());
+
+  Status status = WriteClientId(
+      negotiation.cipher_suite, negotiation.server_requests.cbegin(),
+      negotiation.server_requests.cend(), hash->CumulativeHash(), output);
+  if (!status.ok()) {
+    return status;
+  }
+  early_client_id_cipher_suite_ = negotiation.cipher_suite;
+  return Status::OkStatus();
 }
 
 Status ClientEkepHandshaker::WriteClientId(
+    HandshakeCipher cipher_suite,
     google::protobuf::RepeatedPtrField<AssertionRequest>::const_iterator requests_first,
     google::protobuf::RepeatedPtrField<AssertionRequest>::const_iterator requests_last,
-    std::string *output) {
-  // Generate an ephemeral Diffie-Hellman key-pair for the negotiated cipher
-  // suite.
-  switch (selected_cipher_suite_) {
+    const std::string &transcript_hash, std::string *output) {
+  // Generate an ephemeral Diffie-Hellman key-pair for the cipher suite.
+  switch (cipher_suite) {
     case CURVE25519_SHA256:
-      dh_public_key_.resize(X25519_PUBLIC_VALUE_LEN);
-      dh_private_key_.resize(X25519_PRIVATE_KEY_LEN);
-      X25519_keypair(dh_public_key_.data(), dh_private_key_.data());
+      if (!ephemeral_key_pool_ ||
+          !ephemeral_key_pool_->Take(&dh_public_key_, &dh_private_key_)) {
+        dh_public_key_.resize(X25519_PUBLIC_VALUE_LEN);
+        dh_private_key_.resize(X25519_PRIVATE_KEY_LEN);
+        X25519_keypair(dh_public_key_.data(), dh_private_key_.data());
+      }
       break;
     default:
       LOG(ERROR) << "Client handshaker has bad cipher suite configuration";
@@ -454,16 +688,6 @@ Status ClientEkepHandshaker::WriteClientId(
   std::string public_key(reinterpret_cast<const char *>(dh_public_key_.data()),
                     dh_public_key_.size());
 
-  // At this stage in the protocol, the transcript is:
-  //   hash(ClientPrecommit || ServerPrecommit)
-  //
-  // The client binds its assertions to this transcript.
-  std::string transcript_hash;
-  Status status = GetTranscriptHash(&transcript_hash);
-  if (!status.ok()) {
-    return status;
-  }
-
   // Each assertion generated by the client is bound to a data blob containing
   // a hash of the current transcript and the client's public key.
   std::string ekep_context;
@@ -478,8 +702,10 @@ Status ClientEkepHandshaker::WriteClientId(
     // Note that assertion generators were verified during creation of the
     // handshaker so there is no need to check whether the call to
     // GetEnclaveAssertionGenerator() returns nullptr.
-    status = GetEnclaveAssertionGenerator(request.description())
-                 ->Generate(ekep_context, request, client_id.add_assertions());
+    Status status =
+        GetEnclaveAssertionGenerator(request.description())
+            ->Generate(ekep_context, request, client_id.add_assertions(),
+                       message_arena());
     if (!status.ok()) {
       LOG(ERROR) << "Assertion generation failed: " << status;
       return Status(Abort_ErrorCode_INTERNAL_ERROR,
@@ -487,17 +713,7 @@ Status ClientEkepHandshaker::WriteClientId(
     }
   }
 
-  status = WriteFrameAndUpdateTranscript(CLIENT_ID, client_id, output);
-  if (!status.ok()) {
-    return status;
-  }
-
-  // At this stage in the protocol, the transcript is:
-  //   hash(ClientPrecommit || ServerPrecommit || ClientId)
-  //
-  // The server will bind its assertions to this transcript so the client must
-  // save a snapshot of the transcript at this time.
-  return GetTranscriptHash(&server_assertion_transcript_);
+  return WriteFrameAndUpdateTranscript(CLIENT_ID, client_id, output);
 }
 
 Status ClientEkepHandshaker::WriteClientFinish(std::string *output) {
@@ -26,8 +26,13 @@
 
 #include <google/protobuf/io/zero_copy_stream.h>
 #include <google/protobuf/message.h>
+#include "asylo/grpc/auth/core/client_precommit_cache.h"
 #include "asylo/grpc/auth/core/ekep_handshaker.h"
 #include "asylo/grpc/auth/core/ekep_handshaker_util.h"
+#include "asylo/grpc/auth/core/ekep_negotiation_cache.h"
+#include "asylo/grpc/auth/core/ekep_resumption.h"
+#include "asylo/grpc/auth/core/ephemeral_key_pool.h"
+#include "asylo/identity/verified_assertion_cache.h"
 #include "asylo/util/cleansing_types.h"
 
 namespace asylo {
@@ -36,6 +41,20 @@ namespace asylo {
 // handshake. It handles ServerPrecommit, ServerId, and ServerFinish messages
 // from the server and sends ClientPrecommit, ClientId, and ClientFinish
 // messages to the server.
+//
+// If configured with an EkepSessionCache, the client stores every session for
+// which the server issues a resumption ticket, and offers the stored ticket the
+// next time it connects to the same server. If the server accepts the ticket,
+// the client expects a ServerFinish right after the ServerPrecommit, and the
+// peer identities are those recorded when the session was first established.
+//
+// If configured with an EkepNegotiationCache, the client remembers the cipher
+// suite and the assertion requests of each server it completes a full
+// handshake with. When it next connects to the same server without a
+// resumption ticket, it sends an early ClientId for those parameters right
+// after its ClientPrecommit. If the server accepts the early ClientId, its
+// ServerPrecommit is followed immediately by ServerId and ServerFinish, saving
+// a round trip. Otherwise, the client sends a ClientId as in a full handshake.
 class ClientEkepHandshaker final : public EkepHandshaker {
  public:
   // Creates a ClientEkepHandshaker configured with the given |options|, if
@@ -77,7 +96,9 @@ class ClientEkepHandshaker final : public EkepHandshaker {
 
   // Validates the ServerPrecommit handshake message contained in |message|. If
   // validation succeeds, writes the ClientId message to |output| and updates
-  // the handshake transcript with the outgoing ClientId frame.
+  // the handshake transcript with the outgoing ClientId frame. If the server
+  // accepted the client's resumption ticket, derives the EKEP secrets instead.
+  // If the server accepted the client's early ClientId, writes nothing.
   Status HandleServerPrecommit(const google::protobuf::Message &message, std::string *output);
 
   // Validates the ServerId handshake message contained in |message|.
@@ -88,17 +109,41 @@ class ClientEkepHandshaker final : public EkepHandshaker {
   // updates the handshake transcript with the outgoing ClientFinish frame.
   Status HandleServerFinish(const google::protobuf::Message &message, std::string *output);
 
-  // Writes the ClientPrecommit frame to |output| and updates the transcript.
+  // Resumes the session in |offered_session_| after the server has accepted its
+  // ticket in |server_precommit|. Adds the session's peer identities and
+  // derives the EKEP secrets.
+  Status ResumeSession(const ServerPrecommit &server_precommit);
+
+  // Stores the session established by this handshake in |session_cache_|,
+  // using the resumption ticket from |server_finish|.
+  Status StoreSession(const ServerFinish &server_finish);
+
+  // Sets the fields of |client_precommit| that are the same in every
+  // handshake, up to and including the assertion requests.
+  Status BuildClientPrecommitPrefix(ClientPrecommit *client_precommit) const;
+
+  // Writes the ClientPrecommit frame to |output| and updates the transcript. If
+  // |negotiation_cache_| holds the parameters of a previous handshake with the
+  // server, also writes an early ClientId frame.
   Status WriteClientPrecommit(std::string *output);
 
-  // Generates an assertion for each assertion request in the range
-  // [|requests_first|, |requests_last|) and adds the resulting assertions to a
-  // ClientId frame that is written to |output|. Updates the handshake
-  // transcript.
+  // Writes an early ClientId frame for |negotiation| to |output| and updates
+  // the transcript. |client_precommit_frame| is the ClientPrecommit frame, the
+  // only frame in the transcript so far.
+  Status WriteEarlyClientId(const EkepNegotiation &negotiation,
+                            const std::string &client_precommit_frame,
+                            std::string *output);
+
+  // Generates an ephemeral Diffie-Hellman key-pair for |cipher_suite| and an
+  // assertion for each assertion request in the range [|requests_first|,
+  // |requests_last|), binding the assertions to |transcript_hash|. Adds the
+  // resulting assertions to a ClientId frame that is written to |output|.
+  // Updates the handshake transcript.
   Status WriteClientId(
+      HandshakeCipher cipher_suite,
       google::protobuf::RepeatedPtrField<AssertionRequest>::const_iterator requests_first,
       google::protobuf::RepeatedPtrField<AssertionRequest>::const_iterator requests_last,
-      std::string *output);
+      const std::string &transcript_hash, std::string *output);
 
   // Writes the ClientFinish frame to |output| and updates the handshake
   // transcript.
@@ -138,10 +183,52 @@ class ClientEkepHandshaker final : public EkepHandshaker {
   // Additional data that is authenticated during the handshake.
   const std::string additional_authenticated_data_;
 
+  // Cache of resumable sessions, or nullptr if session resumption is disabled.
+  const std::shared_ptr<EkepSessionCache> session_cache_;
+
+  // Key of the server's entries in |session_cache_| and |negotiation_cache_|.
+  const std::string session_cache_key_;
+
+  // Cache of the parameters negotiated with servers, or nullptr if the client
+  // never sends an early ClientId.
+  const std::shared_ptr<EkepNegotiationCache> negotiation_cache_;
+
+  // Cache of identities extracted from verified peer assertions, or nullptr if
+  // every peer assertion is verified in full.
+  const std::shared_ptr<VerifiedAssertionCache> verified_assertion_cache_;
+
+  // Pool of precomputed ephemeral key pairs, or nullptr if key pairs are
+  // generated during the handshake.
+  const std::shared_ptr<EphemeralKeyPool> ephemeral_key_pool_;
+
+  // Cache of the serialized fields of the ClientPrecommit that are the same in
+  // every handshake, or nullptr if they are built for each handshake.
+  const std::shared_ptr<ClientPrecommitCache> client_precommit_cache_;
+
+  // The session whose ticket was offered in the ClientPrecommit, if any.
+  std::unique_ptr<EkepSession> offered_session_;
+
+  // Whether the server accepted the offered session. This field is populated
+  // after validation of the ServerPrecommit message.
+  bool resumed_session_;
+
+  // Descriptions of the server assertions backing the peer identities, either
+  // verified in this handshake or recorded in a resumed session.
+  std::vector<AssertionDescription> verified_peer_assertions_;
+
   // Assertions expected from the peer. This field is populated after validation
   // of the ServerPrecommit message.
   std::vector<AssertionDescription> expected_peer_assertions_;
 
+  // The cipher suite for which the client sent an early ClientId, or
+  // UNKNOWN_HANDSHAKE_CIPHER if it did not send one.
+  HandshakeCipher early_client_id_cipher_suite_;
+
+  // Assertions requested by the server. This field is populated after
+  // validation of the ServerPrecommit message, and is stored in
+  // |negotiation_cache_| once the handshake completes.
+  google::protobuf::RepeatedPtrField<AssertionRequest> server_requests_;
+
   // The selected cipher suite for the handshake. This field is populated after
   // validation of the ServerPrecommit message.
   HandshakeCipher selected_cipher_suite_;
@@ -165,6 +252,8 @@ class ClientEkepHandshaker final : public EkepHandshaker {
 
   // A snapshot of the transcript to which the server's assertions are bound:
   //   hash(ClientPrecommit || ServerPrecommit || ClientId)
+  // or, if the server accepted an early ClientId:
+  //   hash(ClientPrecommit || ClientId || ServerPrecommit)
   std::string server_assertion_transcript_;
 
   // Type of the next message expected by this handshaker.
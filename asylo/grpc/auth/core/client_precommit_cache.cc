@@ -0,0 +1,45 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/grpc/auth/core/client_precommit_cache.h"
+
+#include "asylo/identity/init.h"
+
+namespace asylo {
+
+ClientPrecommitCache::ClientPrecommitCache() : valid_(false), generation_(0) {}
+
+Status ClientPrecommitCache::AppendTo(const Builder &build,
+                                      std::string *output) {
+  uint64_t generation = AssertionAuthorityGeneration();
+  absl::MutexLock lock(&mu_);
+  if (!valid_ || generation_ != generation) {
+    ClientPrecommit client_precommit;
+    Status status = build(&client_precommit);
+    if (!status.ok()) {
+      return status;
+    }
+    serialized_ = client_precommit.SerializeAsString();
+    generation_ = generation;
+    valid_ = true;
+  }
+  output->append(serialized_);
+  return Status::OkStatus();
+}
+
+}  // namespace asylo
@@ -0,0 +1,77 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_GRPC_AUTH_CORE_CLIENT_PRECOMMIT_CACHE_H_
+#define ASYLO_GRPC_AUTH_CORE_CLIENT_PRECOMMIT_CACHE_H_
+
+#include <cstdint>
+#include <functional>
+#include <string>
+
+#include "absl/synchronization/mutex.h"
+#include "asylo/grpc/auth/core/handshake.pb.h"
+#include "asylo/util/status.h"
+
+namespace asylo {
+
+// ClientPrecommitCache holds the serialized fields of a ClientPrecommit that
+// are the same in every handshake of a client: its EKEP versions, cipher
+// suites, record protocols, additional authenticated data, and the assertion
+// offers and requests created by its assertion authorities. Handshakers that
+// share the cache copy these bytes and serialize only the fields that follow
+// them, such as the challenge, instead of asking every authority for a new
+// offer and request in each handshake.
+//
+// Since the cached fields precede the per-handshake fields in field-number
+// order, the cached bytes followed by the serialized per-handshake fields are
+// the same bytes as the serialized ClientPrecommit.
+//
+// The cached fields are rebuilt whenever AssertionAuthorityGeneration()
+// changes, that is, whenever an assertion authority is initialized.
+// ClientPrecommitCache is thread-safe.
+class ClientPrecommitCache {
+ public:
+  // Sets the cached fields of |client_precommit|.
+  using Builder = std::function<Status(ClientPrecommit *client_precommit)>;
+
+  ClientPrecommitCache();
+
+  ClientPrecommitCache(const ClientPrecommitCache &other) = delete;
+  ClientPrecommitCache &operator=(const ClientPrecommitCache &other) = delete;
+
+  // Appends the serialized cached fields to |output|, first building them with
+  // |build| if they are missing or out of date. Every caller must pass a
+  // |build| that sets the same fields. Returns the error from |build|, if any,
+  // and leaves |output| unchanged in that case.
+  Status AppendTo(const Builder &build, std::string *output)
+      LOCKS_EXCLUDED(mu_);
+
+ private:
+  absl::Mutex mu_;
+
+  // The serialized cached fields, valid if |valid_| is true.
+  std::string serialized_ GUARDED_BY(mu_);
+  bool valid_ GUARDED_BY(mu_);
+
+  // The AssertionAuthorityGeneration() at which |serialized_| was built.
+  uint64_t generation_ GUARDED_BY(mu_);
+};
+
+}  // namespace asylo
+
+#endif  // ASYLO_GRPC_AUTH_CORE_CLIENT_PRECOMMIT_CACHE_H_
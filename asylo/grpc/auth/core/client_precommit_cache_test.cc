@@ -0,0 +1,116 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/grpc/auth/core/client_precommit_cache.h"
+
+#include <string>
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include "asylo/grpc/auth/core/handshake.pb.h"
+#include "asylo/identity/enclave_assertion_authority_config.pb.h"
+#include "asylo/identity/init.h"
+#include "asylo/test/util/status_matchers.h"
+#include "asylo/util/status.h"
+
+namespace asylo {
+namespace {
+
+using ::testing::Not;
+
+class ClientPrecommitCacheTest : public ::testing::Test {
+ protected:
+  ClientPrecommitCacheTest() : build_count_(0) {}
+
+  // Returns a builder that sets |data| as the additional authenticated data
+  // and counts its calls in |build_count_|.
+  ClientPrecommitCache::Builder Builder(const std::string &data) {
+    return [this, data](ClientPrecommit *client_precommit) {
+      ++build_count_;
+      client_precommit->add_available_cipher_suites(CURVE25519_SHA256);
+      client_precommit->mutable_options()->set_data(data);
+      return Status::OkStatus();
+    };
+  }
+
+  ClientPrecommitCache cache_;
+  int build_count_;
+};
+
+TEST_F(ClientPrecommitCacheTest, BuildsFieldsOnce) {
+  std::string first;
+  ASSERT_THAT(cache_.AppendTo(Builder("data"), &first), IsOk());
+  std::string second = "prefix";
+  ASSERT_THAT(cache_.AppendTo(Builder("data"), &second), IsOk());
+
+  EXPECT_EQ(build_count_, 1);
+  EXPECT_EQ(second, "prefix" + first);
+
+  ClientPrecommit parsed;
+  ASSERT_TRUE(parsed.ParseFromString(first));
+  EXPECT_EQ(parsed.options().data(), "data");
+}
+
+TEST_F(ClientPrecommitCacheTest, DoesNotCacheBuildError) {
+  std::string output;
+  EXPECT_THAT(cache_.AppendTo(
+                  [](ClientPrecommit *client_precommit) {
+                    return Status(error::GoogleError::INTERNAL, "failed");
+                  },
+                  &output),
+              Not(IsOk()));
+  EXPECT_TRUE(output.empty());
+
+  ASSERT_THAT(cache_.AppendTo(Builder("data"), &output), IsOk());
+  EXPECT_EQ(build_count_, 1);
+}
+
+// Tests that the cached fields followed by the per-handshake fields are the
+// bytes of the whole ClientPrecommit.
+TEST_F(ClientPrecommitCacheTest, CachedFieldsPrecedePerHandshakeFields) {
+  std::string serialized;
+  ASSERT_THAT(cache_.AppendTo(Builder("data"), &serialized), IsOk());
+  ClientPrecommit suffix;
+  suffix.set_challenge(std::string(32, 'c'));
+  suffix.AppendToString(&serialized);
+
+  ClientPrecommit whole;
+  ASSERT_THAT(Builder("data")(&whole), IsOk());
+  whole.set_challenge(std::string(32, 'c'));
+  EXPECT_EQ(serialized, whole.SerializeAsString());
+}
+
+TEST_F(ClientPrecommitCacheTest, RebuildsWhenAuthorityIsInitialized) {
+  std::string output;
+  ASSERT_THAT(cache_.AppendTo(Builder("data"), &output), IsOk());
+  ASSERT_EQ(build_count_, 1);
+
+  uint64_t generation = AssertionAuthorityGeneration();
+  std::vector<EnclaveAssertionAuthorityConfig> configs;
+  ASSERT_THAT(
+      InitializeEnclaveAssertionAuthorities(configs.begin(), configs.end()),
+      IsOk());
+  ASSERT_NE(AssertionAuthorityGeneration(), generation);
+
+  ASSERT_THAT(cache_.AppendTo(Builder("data"), &output), IsOk());
+  EXPECT_EQ(build_count_, 2);
+}
+
+}  // namespace
+}  // namespace asylo
@@ -43,6 +43,8 @@ constexpr size_t kEkepSecretSize =
 
 constexpr char kEkepHkdfSalt[] = "EKEP Handshake v1";
 constexpr char kEkepHkdfSaltRecordProtocol[] = "EKEP Record Protocol v1";
+constexpr char kEkepHkdfSaltResumption[] = "EKEP Resumption v1";
+constexpr char kEkepHkdfSaltResumedHandshake[] = "EKEP Resumed Handshake v1";
 constexpr char kServerAuthenticatedText[] = "EKEP Handshake v1: Server Finish";
 constexpr char kClientAuthenticatedText[] = "EKEP Handshake v1: Client Finish";
 
@@ -161,18 +163,27 @@ Status DeriveRecordProtocolKey(const HandshakeCipher &ciphersuite,
   }
 
   // Resize the output vector to an appropriate size for the selected record
-  // protocol.
+  // protocol. Record protocols other than SEAL_AES128_GCM use a salt that names
+  // the protocol, so that keys for different protocols are never related.
+  std::string salt(kEkepHkdfSaltRecordProtocol);
   switch (record_protocol) {
     case SEAL_AES128_GCM:
       record_protocol_key->resize(kSealAes128GcmKeySize);
       break;
+    case SEAL_AES128_GCM_REKEY:
+      record_protocol_key->resize(kSealAes128GcmRekeyKeySize);
+      salt.append(" " + RecordProtocol_Name(record_protocol));
+      break;
+    case SEAL_CHACHA20_POLY1305:
+      record_protocol_key->resize(kSealChaCha20Poly1305KeySize);
+      salt.append(" " + RecordProtocol_Name(record_protocol));
+      break;
     default:
       return Status(Abort_ErrorCode_BAD_RECORD_PROTOCOL,
                     "Record protocol not supported " +
                         RecordProtocol_Name(record_protocol));
   }
 
-  std::string salt(kEkepHkdfSaltRecordProtocol);
   if (!HKDF(record_protocol_key->data(), record_protocol_key->size(), digest,
             master_secret.data(), master_secret.size(),
             reinterpret_cast<const uint8_t *>(salt.data()), salt.size(),
@@ -183,6 +194,76 @@ Status DeriveRecordProtocolKey(const HandshakeCipher &ciphersuite,
   return Status::OkStatus();
 }
 
+Status DeriveResumptionSecret(const HandshakeCipher &ciphersuite,
+                              ByteContainerView master_secret,
+                              CleansingVector<uint8_t> *resumption_secret) {
+  resumption_secret->clear();
+  const EVP_MD *digest = nullptr;
+  switch (ciphersuite) {
+    case CURVE25519_SHA256:
+      digest = EVP_sha256();
+      break;
+    default:
+      return Status(
+          Abort_ErrorCode_BAD_HANDSHAKE_CIPHER,
+          "Ciphersuite not supported: " + HandshakeCipher_Name(ciphersuite));
+  }
+
+  std::string salt(kEkepHkdfSaltResumption);
+  resumption_secret->resize(kEkepResumptionSecretSize);
+  if (!HKDF(resumption_secret->data(), resumption_secret->size(), digest,
+            master_secret.data(), master_secret.size(),
+            reinterpret_cast<const uint8_t *>(salt.data()), salt.size(),
+            /*info=*/nullptr, /*info_len=*/0)) {
+    LOG(ERROR) << "HKDF failed: " << BsslLastErrorString();
+    return Status(Abort_ErrorCode_INTERNAL_ERROR, "Internal error");
+  }
+  return Status::OkStatus();
+}
+
+Status DeriveResumedSecrets(const HandshakeCipher &ciphersuite,
+                            ByteContainerView transcript_hash,
+                            ByteContainerView resumption_secret,
+                            CleansingVector<uint8_t> *master_secret,
+                            CleansingVector<uint8_t> *authenticator_secret) {
+  const EVP_MD *digest = nullptr;
+  switch (ciphersuite) {
+    case CURVE25519_SHA256:
+      digest = EVP_sha256();
+      break;
+    default:
+      return Status(
+          Abort_ErrorCode_BAD_HANDSHAKE_CIPHER,
+          "Ciphersuite not supported: " + HandshakeCipher_Name(ciphersuite));
+  }
+
+  if (resumption_secret.size() != kEkepResumptionSecretSize) {
+    return Status(Abort_ErrorCode_INTERNAL_ERROR,
+                  absl::StrCat("Resumption secret has incorrect size: ",
+                               resumption_secret.size()));
+  }
+
+  // Derive the master and authenticator secrets using HKDF, with the
+  // resumption secret in place of the Diffie-Hellman shared secret.
+  std::string salt(kEkepHkdfSaltResumedHandshake);
+  CleansingVector<uint8_t> output_key;
+  output_key.resize(kEkepSecretSize);
+  if (!HKDF(output_key.data(), kEkepSecretSize, digest,
+            resumption_secret.data(), resumption_secret.size(),
+            reinterpret_cast<const uint8_t *>(salt.data()), salt.size(),
+            transcript_hash.data(), transcript_hash.size())) {
+    LOG(ERROR) << "HKDF failed: " << BsslLastErrorString();
+    return Status(Abort_ErrorCode_INTERNAL_ERROR, "Internal error");
+  }
+
+  std::copy(output_key.cbegin(), output_key.cbegin() + kEkepMasterSecretSize,
+            std::back_inserter(*master_secret));
+  std::copy(output_key.cbegin() + kEkepMasterSecretSize, output_key.cend(),
+            std::back_inserter(*authenticator_secret));
+
+  return Status::OkStatus();
+}
+
 Status ComputeClientHandshakeAuthenticator(
     const HandshakeCipher &ciphersuite, ByteContainerView authenticator_secret,
     CleansingVector<uint8_t> *authenticator) {
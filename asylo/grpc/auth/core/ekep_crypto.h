@@ -33,6 +33,9 @@ namespace asylo {
 constexpr size_t kEkepMasterSecretSize = 64;
 constexpr size_t kEkepAuthenticatorSecretSize = 64;
 constexpr size_t kSealAes128GcmKeySize = 16;
+constexpr size_t kSealAes128GcmRekeyKeySize = 44;
+constexpr size_t kSealChaCha20Poly1305KeySize = 32;
+constexpr size_t kEkepResumptionSecretSize = 32;
 
 // Derives EKEP secrets based on the selected |ciphersuite| and the input
 // |transcript_hash|, |peer_dh_public_key|, and |self_dh_private_key|. On
@@ -73,6 +76,40 @@ Status DeriveRecordProtocolKey(const HandshakeCipher &ciphersuite,
                                ByteContainerView master_secret,
                                CleansingVector<uint8_t> *record_protocol_key);
 
+// Derives a resumption secret using HKDF initialized with the hash function
+// from |ciphersuite| and the input key material |master_secret|. On success,
+// writes the resumption secret to |resumption_secret|. The resumption secret
+// is placed in a resumption ticket and replaces the Diffie-Hellman shared
+// secret in a later, abbreviated handshake.
+//
+// Note that |master_secret| is a ByteContainerView, which does not enforce
+// any data safety policy on the underlying container. The caller should take
+// care to pass their master secret using a self-cleansing container.
+//
+// If the ciphersuite is unsupported, returns BAD_HANDSHAKE_CIPHER.
+// Returns INTERNAL_ERROR on other errors.
+Status DeriveResumptionSecret(const HandshakeCipher &ciphersuite,
+                              ByteContainerView master_secret,
+                              CleansingVector<uint8_t> *resumption_secret);
+
+// Derives EKEP secrets for an abbreviated handshake based on the selected
+// |ciphersuite|, the input |transcript_hash|, and the |resumption_secret| from
+// the accepted resumption ticket. On success, writes the master secret to
+// |master_secret| and the authenticator secret to |authenticator_secret|.
+//
+// The transcript of an abbreviated handshake covers fresh challenges from both
+// participants, so the derived secrets are unique to each resumed session even
+// though the resumption secret is reused.
+//
+// If the ciphersuite is unsupported, returns BAD_HANDSHAKE_CIPHER.
+// If the resumption secret has an invalid size, returns INTERNAL_ERROR.
+// Returns INTERNAL_ERROR on other errors.
+Status DeriveResumedSecrets(const HandshakeCipher &ciphersuite,
+                            ByteContainerView transcript_hash,
+                            ByteContainerView resumption_secret,
+                            CleansingVector<uint8_t> *master_secret,
+                            CleansingVector<uint8_t> *authenticator_secret);
+
 // The following two methods compute the handshake authenticator for the
 // client and the server using HMAC initialized with the hash function from
 // |ciphersuite|, and the key in |authenticator_secret|. On success they write
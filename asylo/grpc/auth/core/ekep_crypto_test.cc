@@ -71,6 +71,19 @@ constexpr char kTestAuthenticatorSecret[] =
 //     kTestRecordProtocolKey
 constexpr char kTestRecordProtocolKey[] = "c7e0f5436c0fe4efdb6327469651b9fe";
 
+// Test vectors for record protocol key derivation with SEAL_AES128_GCM_REKEY
+// and SEAL_CHACHA20_POLY1305.
+//   Inputs:
+//     kTestMasterSecret, kTestTranscriptHash
+//   Outputs:
+//     kTestRekeyRecordProtocolKey, kTestChaChaRecordProtocolKey
+constexpr char kTestRekeyRecordProtocolKey[] =
+    "8327c36620d3024edb73f7bea28a5124e79e2c0808588eaf66bd7a373fd840ed"
+    "195012af4083fa06b4067ab8";
+
+constexpr char kTestChaChaRecordProtocolKey[] =
+    "70aba5b7c889b0127db5f92a7aed11047f816bf3b49e252d89244ecfc4468b00";
+
 // Test vector for server handshake-authenticator computation.
 //   Inputs:
 //     kTestAuthenticatorSecret
@@ -87,6 +100,27 @@ constexpr char kTestServerHandshakeAuthenticator[] =
 constexpr char kTestClientHandshakeAuthenticator[] =
     "d43f4ef069507d34afee16b475c54cdca87d21daa04309f38deb7b01bd092ac9";
 
+// Test vector for resumption secret derivation.
+//   Inputs:
+//     kTestMasterSecret
+//   Outputs:
+//     kTestResumptionSecret
+constexpr char kTestResumptionSecret[] =
+    "2d2568b24e8f9037396039d1284d0dea823c87233861ceadc01a85c5bafceedf";
+
+// Test vector for resumed-handshake secret derivation.
+//   Inputs:
+//     kTestResumptionSecret, kTestTranscriptHash
+//   Outputs:
+//     kTestResumedMasterSecret, kTestResumedAuthenticatorSecret
+constexpr char kTestResumedMasterSecret[] =
+    "414b401f2c5370952755cae3ec6f7c3ac3b929698c02abfde04e05a872ca320b"
+    "aed307369f300f823595288ba1d4bd603c14279f3f82cfd73e391601f12d09d5";
+
+constexpr char kTestResumedAuthenticatorSecret[] =
+    "66f44b4d97d7ca411680a4cd025f21d51eaee4b4a5ee8b4a449a1ee66754fe82"
+    "ea2f8d50e98ef5ff7a1d61ce354bf57a401416ed65824b4edc83ef1293ce5dde";
+
 // Verify that DeriveSecrets fails and returns BAD_HANDSHAKE_CIPHER when passed
 // an unsupported ciphersuite.
 TEST(EkepCryptoTest, DeriveSecretsBadCiphersuite) {
@@ -237,6 +271,144 @@ TEST(EkepCryptoTest, DeriveRecordProtocolKeySealAes128Gcm) {
   EXPECT_EQ(*actual_key, expected_key);
 }
 
+// Verify success of DeriveRecordProtocolKey when using the ciphersuite
+// consisting of Curve25519 and SHA256, and the rekeying SEAL record protocol.
+TEST(EkepCryptoTest, DeriveRecordProtocolKeySealAes128GcmRekey) {
+  UnsafeBytes<SHA256_DIGEST_LENGTH> transcript_hash;
+  SetTrivialObjectFromHexString(kTestTranscriptHash, &transcript_hash);
+
+  SafeBytes<kEkepMasterSecretSize> master_secret;
+  SetTrivialObjectFromHexString(kTestMasterSecret, &master_secret);
+
+  SafeBytes<kSealAes128GcmRekeyKeySize> expected_key;
+  SetTrivialObjectFromHexString(kTestRekeyRecordProtocolKey, &expected_key);
+
+  CleansingVector<uint8_t> key;
+  ASSERT_TRUE(DeriveRecordProtocolKey(CURVE25519_SHA256, SEAL_AES128_GCM_REKEY,
+                                      transcript_hash, master_secret, &key)
+                  .ok());
+
+  ASSERT_EQ(key.size(), kSealAes128GcmRekeyKeySize);
+  SafeBytes<kSealAes128GcmRekeyKeySize> *actual_key =
+      SafeBytes<kSealAes128GcmRekeyKeySize>::Place(&key, /*offset=*/0);
+  EXPECT_EQ(*actual_key, expected_key);
+}
+
+// Verify success of DeriveRecordProtocolKey when using the ciphersuite
+// consisting of Curve25519 and SHA256, and the ChaCha20-Poly1305 record
+// protocol.
+TEST(EkepCryptoTest, DeriveRecordProtocolKeySealChaCha20Poly1305) {
+  UnsafeBytes<SHA256_DIGEST_LENGTH> transcript_hash;
+  SetTrivialObjectFromHexString(kTestTranscriptHash, &transcript_hash);
+
+  SafeBytes<kEkepMasterSecretSize> master_secret;
+  SetTrivialObjectFromHexString(kTestMasterSecret, &master_secret);
+
+  SafeBytes<kSealChaCha20Poly1305KeySize> expected_key;
+  SetTrivialObjectFromHexString(kTestChaChaRecordProtocolKey, &expected_key);
+
+  CleansingVector<uint8_t> key;
+  ASSERT_TRUE(DeriveRecordProtocolKey(CURVE25519_SHA256,
+                                      SEAL_CHACHA20_POLY1305, transcript_hash,
+                                      master_secret, &key)
+                  .ok());
+
+  ASSERT_EQ(key.size(), kSealChaCha20Poly1305KeySize);
+  SafeBytes<kSealChaCha20Poly1305KeySize> *actual_key =
+      SafeBytes<kSealChaCha20Poly1305KeySize>::Place(&key, /*offset=*/0);
+  EXPECT_EQ(*actual_key, expected_key);
+}
+
+// Verify that DeriveResumptionSecret fails and returns BAD_HANDSHAKE_CIPHER
+// when passed an unsupported ciphersuite.
+TEST(EkepCryptoTest, DeriveResumptionSecretBadCiphersuite) {
+  std::vector<uint8_t> master_secret;
+  CleansingVector<uint8_t> resumption_secret;
+
+  Status status = DeriveResumptionSecret(UNKNOWN_HANDSHAKE_CIPHER,
+                                         master_secret, &resumption_secret);
+  EXPECT_THAT(status, Not(IsOk()));
+  EXPECT_THAT(status, StatusIs(Abort_ErrorCode_BAD_HANDSHAKE_CIPHER));
+}
+
+// Verify success of DeriveResumptionSecret when using the ciphersuite
+// consisting of Curve25519 and SHA256.
+TEST(EkepCryptoTest, DeriveResumptionSecretWithCurve25519Sha256) {
+  SafeBytes<kEkepMasterSecretSize> master_secret;
+  SetTrivialObjectFromHexString(kTestMasterSecret, &master_secret);
+
+  SafeBytes<kEkepResumptionSecretSize> expected_resumption_secret;
+  SetTrivialObjectFromHexString(kTestResumptionSecret,
+                                &expected_resumption_secret);
+
+  CleansingVector<uint8_t> resumption_secret;
+
+  ASSERT_TRUE(DeriveResumptionSecret(CURVE25519_SHA256, master_secret,
+                                     &resumption_secret)
+                  .ok());
+
+  // Verify that the resumption secret is as expected.
+  SafeBytes<kEkepResumptionSecretSize> *actual_resumption_secret =
+      SafeBytes<kEkepResumptionSecretSize>::Place(&resumption_secret,
+                                                  /*offset=*/0);
+  EXPECT_EQ(*actual_resumption_secret, expected_resumption_secret);
+}
+
+// Verify that DeriveResumedSecrets fails and returns INTERNAL_ERROR when passed
+// a resumption secret that has an invalid size.
+TEST(EkepCryptoTest, DeriveResumedSecretsBadResumptionSecretSize) {
+  std::string transcript_hash;
+
+  // Resumption secret is empty.
+  CleansingVector<uint8_t> resumption_secret;
+
+  CleansingVector<uint8_t> authenticator_secret;
+  CleansingVector<uint8_t> master_secret;
+
+  Status status =
+      DeriveResumedSecrets(CURVE25519_SHA256, transcript_hash,
+                           resumption_secret, &master_secret,
+                           &authenticator_secret);
+  EXPECT_THAT(status, Not(IsOk()));
+  EXPECT_THAT(status, StatusIs(Abort_ErrorCode_INTERNAL_ERROR));
+}
+
+// Verify success of DeriveResumedSecrets using the ciphersuite consisting of
+// Curve25519 and SHA256.
+TEST(EkepCryptoTest, DeriveResumedSecretsWithCurve25519Sha256) {
+  UnsafeBytes<SHA256_DIGEST_LENGTH> transcript_hash;
+  SetTrivialObjectFromHexString(kTestTranscriptHash, &transcript_hash);
+
+  SafeBytes<kEkepResumptionSecretSize> resumption_secret;
+  SetTrivialObjectFromHexString(kTestResumptionSecret, &resumption_secret);
+
+  SafeBytes<kEkepMasterSecretSize> expected_master_secret;
+  SetTrivialObjectFromHexString(kTestResumedMasterSecret,
+                                &expected_master_secret);
+
+  SafeBytes<kEkepAuthenticatorSecretSize> expected_authenticator_secret;
+  SetTrivialObjectFromHexString(kTestResumedAuthenticatorSecret,
+                                &expected_authenticator_secret);
+
+  CleansingVector<uint8_t> authenticator_secret;
+  CleansingVector<uint8_t> master_secret;
+
+  ASSERT_TRUE(DeriveResumedSecrets(CURVE25519_SHA256, transcript_hash,
+                                   resumption_secret, &master_secret,
+                                   &authenticator_secret)
+                  .ok());
+
+  SafeBytes<kEkepMasterSecretSize> *actual_master_secret =
+      SafeBytes<kEkepMasterSecretSize>::Place(&master_secret,
+                                              /*offset=*/0);
+  EXPECT_EQ(*actual_master_secret, expected_master_secret);
+
+  SafeBytes<kEkepAuthenticatorSecretSize> *actual_authenticator_secret =
+      SafeBytes<kEkepAuthenticatorSecretSize>::Place(&authenticator_secret,
+                                                     /*offset=*/0);
+  EXPECT_EQ(*actual_authenticator_secret, expected_authenticator_secret);
+}
+
 // Verify that ComputeClientHandshakeAuthenticator fails and returns
 // BAD_HANDSHAKER_CIPHER when passed an unsupported ciphersuite.
 TEST(EkepCryptoTest, ComputeClientHandshakeAuthenticatorBadCipherSuite) {
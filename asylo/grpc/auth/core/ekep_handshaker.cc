@@ -19,8 +19,10 @@
 #include "asylo/grpc/auth/core/ekep_handshaker.h"
 
 #include <cstdint>
+#include <cstring>
 #include <memory>
 
+#include <google/protobuf/arena.h>
 #include <google/protobuf/io/coded_stream.h>
 #include <google/protobuf/io/zero_copy_stream_impl.h>
 #include <google/protobuf/io/zero_copy_stream_impl_lite.h>
@@ -37,24 +39,30 @@
 namespace asylo {
 namespace {
 
-// Creates and returns a handshake message of type |message_type|.
-std::unique_ptr<google::protobuf::Message> CreateHandshakeMessage(
-    HandshakeMessageType message_type) {
+// The size of the first block of the arena on which incoming handshake
+// messages are parsed. It holds the messages of a typical handshake, whose
+// largest frames carry a few assertions.
+constexpr size_t kArenaBlockSize = 4096;
+
+// Creates a handshake message of type |message_type| on |arena| and returns a
+// pointer to it. The message is owned by |arena|.
+google::protobuf::Message *CreateHandshakeMessage(
+    HandshakeMessageType message_type, google::protobuf::Arena *arena) {
   switch (message_type) {
     case CLIENT_PRECOMMIT:
-      return absl::make_unique<ClientPrecommit>();
+      return google::protobuf::Arena::CreateMessage<ClientPrecommit>(arena);
     case SERVER_PRECOMMIT:
-      return absl::make_unique<ServerPrecommit>();
+      return google::protobuf::Arena::CreateMessage<ServerPrecommit>(arena);
     case CLIENT_ID:
-      return absl::make_unique<ClientId>();
+      return google::protobuf::Arena::CreateMessage<ClientId>(arena);
     case SERVER_ID:
-      return absl::make_unique<ServerId>();
+      return google::protobuf::Arena::CreateMessage<ServerId>(arena);
     case CLIENT_FINISH:
-      return absl::make_unique<ClientFinish>();
+      return google::protobuf::Arena::CreateMessage<ClientFinish>(arena);
     case SERVER_FINISH:
-      return absl::make_unique<ServerFinish>();
+      return google::protobuf::Arena::CreateMessage<ServerFinish>(arena);
     case ABORT:
-      return absl::make_unique<Abort>();
+      return google::protobuf::Arena::CreateMessage<Abort>(arena);
     default:
       return nullptr;
   }
@@ -93,19 +101,27 @@ EkepHandshaker::Result EkepHandshaker::NextHandshakeStep(
 
     result = StartHandshake(outgoing_bytes);
   } else {
-    // Process bytes from the peer.
-    input_stream_.AddBuffer(incoming_bytes, incoming_bytes_size);
+    // Process bytes from the peer. Frames are parsed directly from
+    // |incoming_bytes| and any bytes cached from earlier calls, without first
+    // copying them into a contiguous buffer.
+    input_stream_.AddBufferView(
+        ByteContainerView(incoming_bytes, incoming_bytes_size));
 
     do {
       result = DecodeAndHandleFrame(outgoing_bytes);
-      if (result != Result::IN_PROGRESS) {
-        return result;
-      }
       // Continue processing data from the peer while there are still leftover
       // bytes from the peer and the handshaker has not encoded a response
       // frame.
-    } while (input_stream_.RemainingByteCount() != 0 &&
+    } while (result == Result::IN_PROGRESS &&
+             input_stream_.RemainingByteCount() != 0 &&
              outgoing_bytes->empty());
+
+    // |incoming_bytes| is only valid for the duration of this call, so the
+    // bytes of it that have not been consumed are cached now.
+    input_stream_.CopyBufferViews();
+    if (result != Result::IN_PROGRESS) {
+      return result;
+    }
   }
 
   if (!outgoing_bytes->empty() && input_stream_.RemainingByteCount() != 0) {
@@ -122,12 +138,9 @@ EkepHandshaker::Result EkepHandshaker::NextHandshakeStep(
   return result;
 }
 
-Status EkepHandshaker::EncodeFrame(
-    HandshakeMessageType message_type, const google::protobuf::Message &handshake_message,
-    google::protobuf::io::ZeroCopyOutputStream *output) const {
-  google::protobuf::io::CodedOutputStream encoded_frame(output);
-
-  size_t message_size = handshake_message.ByteSizeLong();
+StatusOr<uint8_t *> EkepHandshaker::AppendFrameHeader(
+    HandshakeMessageType message_type, size_t message_size,
+    std::string *output) const {
   if (message_size > max_frame_size_ ||
       sizeof(message_type) + message_size > max_frame_size_) {
     return Status(
@@ -143,16 +156,46 @@ Status EkepHandshaker::EncodeFrame(
         "Cannot create a frame with message type UNKNOWN_HANDSHAKE_MESSAGE");
   }
 
+  // Grow |output| once to hold the whole frame, and write the frame in place.
+  size_t offset = output->size();
+  output->resize(offset + kEkepFrameHeaderSize + message_size);
+  uint8_t *target = reinterpret_cast<uint8_t *>(&(*output)[offset]);
+
   // Write the frame size.
   uint32_t frame_size = sizeof(message_type) + message_size;
-  encoded_frame.WriteLittleEndian32(frame_size);
+  target = google::protobuf::io::CodedOutputStream::WriteLittleEndian32ToArray(
+      frame_size, target);
 
   // Write the message type.
-  encoded_frame.WriteLittleEndian32(message_type);
+  return google::protobuf::io::CodedOutputStream::WriteLittleEndian32ToArray(
+      message_type, target);
+}
+
+Status EkepHandshaker::EncodeFrame(
+    HandshakeMessageType message_type,
+    const google::protobuf::Message &handshake_message,
+    std::string *output) const {
+  StatusOr<uint8_t *> target_result = AppendFrameHeader(
+      message_type, handshake_message.ByteSizeLong(), output);
+  if (!target_result.ok()) {
+    return target_result.status();
+  }
 
   // Write the serialized message.
-  handshake_message.SerializeWithCachedSizes(&encoded_frame);
+  handshake_message.SerializeWithCachedSizesToArray(target_result.ValueOrDie());
+  return Status::OkStatus();
+}
 
+Status EkepHandshaker::EncodeSerializedFrame(
+    HandshakeMessageType message_type, const std::string &serialized_message,
+    std::string *output) const {
+  StatusOr<uint8_t *> target_result =
+      AppendFrameHeader(message_type, serialized_message.size(), output);
+  if (!target_result.ok()) {
+    return target_result.status();
+  }
+  memcpy(target_result.ValueOrDie(), serialized_message.data(),
+         serialized_message.size());
   return Status::OkStatus();
 }
 
@@ -243,7 +286,9 @@ StatusOr<CleansingVector<uint8_t>> EkepHandshaker::GetRecordProtocolKey() {
 }
 
 EkepHandshaker::EkepHandshaker(int max_frame_size)
-    : max_frame_size_(max_frame_size) {
+    : max_frame_size_(max_frame_size),
+      arena_block_(new char[kArenaBlockSize]),
+      message_arena_(nullptr) {
   peer_identities_ = absl::make_unique<EnclaveIdentities>();
 }
 
@@ -280,12 +325,20 @@ EkepHandshaker::Result EkepHandshaker::DecodeAndHandleFrame(std::string *output)
     input_stream_.Rewind();
     return Result::NOT_ENOUGH_DATA;
   }
-  std::unique_ptr<google::protobuf::Message> message =
-      CreateHandshakeMessage(message_type);
+
+  // The message lives on an arena that starts in |arena_block_|, so parsing it
+  // does not allocate each of its submessages. The arena, and with it the
+  // message, is destroyed once the message has been handled.
+  google::protobuf::ArenaOptions arena_options;
+  arena_options.initial_block = arena_block_.get();
+  arena_options.initial_block_size = kArenaBlockSize;
+  google::protobuf::Arena arena(arena_options);
+  google::protobuf::Message *message =
+      CreateHandshakeMessage(message_type, &arena);
 
   // There are enough bytes to parse the frame message. Any errors that occur
   // during deserialization are fatal.
-  status = ParseFrameMessage(message_size, &input_stream_, message.get());
+  status = ParseFrameMessage(message_size, &input_stream_, message);
   if (!status.ok()) {
     if (message_type == ABORT) {
       // The peer sent an Abort message that could not be parsed. There is not
@@ -301,7 +354,7 @@ EkepHandshaker::Result EkepHandshaker::DecodeAndHandleFrame(std::string *output)
   VLOG(2) << message->DebugString();
 
   if (message_type == ABORT) {
-    const Abort *abort_message = dynamic_cast<const Abort *>(message.get());
+    const Abort *abort_message = dynamic_cast<const Abort *>(message);
     LOG_IF(DFATAL, !abort_message) << "dynamic_cast from google::protobuf::Message * "
                                    << "to Abort * failed";
     HandleAbortMessage(abort_message);
@@ -312,23 +365,38 @@ EkepHandshaker::Result EkepHandshaker::DecodeAndHandleFrame(std::string *output)
   UpdateTranscriptWithIncomingBytes();
   input_stream_.TrimFront();
 
-  return HandleHandshakeMessage(message_type, *message, output);
+  message_arena_ = &arena;
+  Result result = HandleHandshakeMessage(message_type, *message, output);
+  message_arena_ = nullptr;
+  return result;
 }
 
 Status EkepHandshaker::WriteFrameAndUpdateTranscript(
     HandshakeMessageType message_type, const google::protobuf::Message &handshake_message,
     std::string *output) {
-  int offset = output->size();
-  google::protobuf::io::StringOutputStream outgoing_frame(output);
-  Status status = EncodeFrame(message_type, handshake_message, &outgoing_frame);
+  size_t offset = output->size();
+  Status status = EncodeFrame(message_type, handshake_message, output);
   if (!status.ok()) {
     return status;
   }
 
   // There may be outgoing frames already written to |output|. Only add bytes
-  // from the most recently-written frame to the transcript.
-  UpdateTranscriptWithOutgoingBytes(output->data() + offset,
-                                    output->size() - offset);
+  // from the most recently-written frame to the transcript. They are hashed
+  // where they were serialized.
+  transcript_.Add(output->data() + offset, output->size() - offset);
+  return Status::OkStatus();
+}
+
+Status EkepHandshaker::WriteSerializedFrameAndUpdateTranscript(
+    HandshakeMessageType message_type, const std::string &serialized_message,
+    std::string *output) {
+  size_t offset = output->size();
+  Status status =
+      EncodeSerializedFrame(message_type, serialized_message, output);
+  if (!status.ok()) {
+    return status;
+  }
+  transcript_.Add(output->data() + offset, output->size() - offset);
   return Status::OkStatus();
 }
 
@@ -336,6 +404,10 @@ void EkepHandshaker::AddPeerIdentity(const EnclaveIdentity &identity) {
   *peer_identities_->add_identities() = identity;
 }
 
+const EnclaveIdentities &EkepHandshaker::PeerIdentities() const {
+  return *peer_identities_;
+}
+
 void EkepHandshaker::SetRecordProtocol(RecordProtocol record_protocol) {
   record_protocol_ = record_protocol;
 }
@@ -368,15 +440,6 @@ Status EkepHandshaker::GetTranscriptHash(std::string *transcript_hash) {
   return Status::OkStatus();
 }
 
-void EkepHandshaker::UpdateTranscriptWithOutgoingBytes(
-    const char *outgoing_bytes, int outgoing_bytes_size) {
-  if (outgoing_bytes_size > 0) {
-    google::protobuf::io::ArrayInputStream sent_bytes(outgoing_bytes,
-                                            outgoing_bytes_size);
-    transcript_.Add(&sent_bytes);
-  }
-}
-
 void EkepHandshaker::UpdateTranscriptWithIncomingBytes() {
   int64_t bytes_read = input_stream_.ByteCount();
   if (bytes_read != 0) {
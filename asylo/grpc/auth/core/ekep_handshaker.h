@@ -20,7 +20,10 @@
 #define ASYLO_GRPC_AUTH_CORE_EKEP_HANDSHAKER_H_
 
 #include <cstdint>
+#include <memory>
+#include <string>
 
+#include <google/protobuf/arena.h>
 #include <google/protobuf/io/zero_copy_stream.h>
 #include <google/protobuf/message.h>
 #include "asylo/crypto/hash_interface.h"
@@ -109,13 +112,20 @@ class EkepHandshaker {
   Result NextHandshakeStep(const char *incoming_bytes,
                            size_t incoming_bytes_size, std::string *outgoing_bytes);
 
-  // Encodes |handshake_message| into an EKEP frame and writes the encoded frame
-  // to the |output| stream. |message_type| indicates the message type of
-  // |handshake_message|. On failure, returns a status with an INTERNAL_ERROR
-  // error code.
+  // Encodes |handshake_message| into an EKEP frame and appends the encoded
+  // frame to |output|. |message_type| indicates the message type of
+  // |handshake_message|. The message is serialized in place, so |output| grows
+  // at most once. On failure, returns a status with an INTERNAL_ERROR error
+  // code and leaves |output| unchanged.
   Status EncodeFrame(HandshakeMessageType message_type,
                      const google::protobuf::Message &handshake_message,
-                     google::protobuf::io::ZeroCopyOutputStream *output) const;
+                     std::string *output) const;
+
+  // As EncodeFrame(), but for a handshake message already serialized to
+  // |serialized_message|.
+  Status EncodeSerializedFrame(HandshakeMessageType message_type,
+                               const std::string &serialized_message,
+                               std::string *output) const;
 
   // Parses an EKEP frame header from the |input| stream. On success, sets
   // |message_size| to the message size computed from the header and sets
@@ -185,6 +195,12 @@ class EkepHandshaker {
                                        const google::protobuf::Message &handshake_message,
                                        std::string *output);
 
+  // As WriteFrameAndUpdateTranscript(), but for a handshake message already
+  // serialized to |serialized_message|.
+  Status WriteSerializedFrameAndUpdateTranscript(
+      HandshakeMessageType message_type, const std::string &serialized_message,
+      std::string *output);
+
   // Sets the transcript hash function for this handshaker.
   bool SetTranscriptHashFunction(HashInterface *hash);
 
@@ -197,6 +213,16 @@ class EkepHandshaker {
   // Adds an identity to the list of peer identities.
   void AddPeerIdentity(const EnclaveIdentity &identity);
 
+  // Returns the list of peer identities added so far.
+  const EnclaveIdentities &PeerIdentities() const;
+
+  // Returns the arena on which the incoming handshake message that is being
+  // handled was parsed, or nullptr if no message is being handled. Temporary
+  // messages created while handling a message, such as those of assertion
+  // generators and verifiers, can be allocated on it so that they are freed
+  // together with the incoming message.
+  google::protobuf::Arena *message_arena() const { return message_arena_; }
+
   // Sets the record protocol to use after the handshake completes.
   void SetRecordProtocol(RecordProtocol record_protocol);
 
@@ -257,15 +283,18 @@ class EkepHandshaker {
   virtual void HandleAbortMessage(const Abort *abort_message) = 0;
 
  private:
-  // Updates the transcript with |outgoing_bytes_size| bytes from
-  // |outgoing_bytes|.
-  void UpdateTranscriptWithOutgoingBytes(const char *outgoing_bytes,
-                                         int outgoing_bytes_size);
-
   // Updates the transcript with all consumed bytes from the internal
   // input_stream_.
   void UpdateTranscriptWithIncomingBytes();
 
+  // Grows |output| to hold a frame of |message_type| with a message of
+  // |message_size| bytes and writes the frame header. Returns where the
+  // message is to be written. On failure, returns a status with an
+  // INTERNAL_ERROR error code and leaves |output| unchanged.
+  StatusOr<uint8_t *> AppendFrameHeader(HandshakeMessageType message_type,
+                                        size_t message_size,
+                                        std::string *output) const;
+
   // The maximum frame size of frames that are encoded and decoded by this
   // handshaker.
   const int max_frame_size_;
@@ -273,6 +302,14 @@ class EkepHandshaker {
   // A stream of unconsumed handshake bytes.
   MultiBufferInputStream input_stream_;
 
+  // The first block of the arena on which each incoming handshake message is
+  // parsed. It is reused for every frame, so a message that fits in it is
+  // parsed without allocating its submessages separately.
+  std::unique_ptr<char[]> arena_block_;
+
+  // The arena of the incoming handshake message that is being handled, if any.
+  google::protobuf::Arena *message_arena_;
+
   // A running hash of the handshake transcript.
   Transcript transcript_;
 
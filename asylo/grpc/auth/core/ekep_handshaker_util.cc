@@ -18,16 +18,28 @@
 
 #include "asylo/grpc/auth/core/ekep_handshaker_util.h"
 
+#include <openssl/cipher.h>
+
+#include <utility>
+
 #include "absl/strings/str_cat.h"
 #include "absl/strings/string_view.h"
 #include "asylo/grpc/auth/core/ekep_handshaker.h"
 #include "asylo/identity/enclave_assertion_authority.h"
 #include "asylo/identity/enclave_assertion_generator.h"
 #include "asylo/identity/enclave_assertion_verifier.h"
+#include "asylo/identity/init.h"
 #include "asylo/util/status.h"
 
 namespace asylo {
 
+std::vector<RecordProtocol> SupportedRecordProtocols() {
+  if (!EVP_has_aes_hardware()) {
+    return {SEAL_CHACHA20_POLY1305, SEAL_AES128_GCM_REKEY, SEAL_AES128_GCM};
+  }
+  return {SEAL_AES128_GCM_REKEY, SEAL_AES128_GCM, SEAL_CHACHA20_POLY1305};
+}
+
 const EnclaveAssertionGenerator *GetEnclaveAssertionGenerator(
     const AssertionDescription &description) {
   std::string authority_id =
@@ -35,7 +47,14 @@ const EnclaveAssertionGenerator *GetEnclaveAssertionGenerator(
           description.identity_type(), description.authority_type())
           .ValueOrDie();
   auto it = AssertionGeneratorMap::GetValue(authority_id);
-  return (it == AssertionGeneratorMap::value_end()) ? nullptr : &*it;
+  if (it == AssertionGeneratorMap::value_end()) {
+    return nullptr;
+  }
+
+  // Callers check whether the authority is initialized, so a failure here is
+  // reported through IsInitialized().
+  InitializeDeferredAssertionAuthority(&*it);
+  return &*it;
 }
 
 const EnclaveAssertionVerifier *GetEnclaveAssertionVerifier(
@@ -45,7 +64,14 @@ const EnclaveAssertionVerifier *GetEnclaveAssertionVerifier(
           description.identity_type(), description.authority_type())
           .ValueOrDie();
   auto it = AssertionVerifierMap::GetValue(authority_id);
-  return (it == AssertionVerifierMap::value_end()) ? nullptr : &*it;
+  if (it == AssertionVerifierMap::value_end()) {
+    return nullptr;
+  }
+
+  // Callers check whether the authority is initialized, so a failure here is
+  // reported through IsInitialized().
+  InitializeDeferredAssertionAuthority(&*it);
+  return &*it;
 }
 
 Status EkepHandshakerOptions::Validate() const {
@@ -61,6 +87,16 @@ Status EkepHandshakerOptions::Validate() const {
                   "max_frame_size");
   }
 
+  if (session_cache && session_cache_key.empty()) {
+    return Status(asylo::error::GoogleError::INVALID_ARGUMENT,
+                  "Must supply a session_cache_key with a session_cache");
+  }
+
+  if (negotiation_cache && session_cache_key.empty()) {
+    return Status(asylo::error::GoogleError::INVALID_ARGUMENT,
+                  "Must supply a session_cache_key with a negotiation_cache");
+  }
+
   if (self_assertions.empty()) {
     return Status(asylo::error::GoogleError::INVALID_ARGUMENT,
                   "Must supply at least one self assertion");
@@ -79,7 +115,7 @@ Status EkepHandshakerOptions::Validate() const {
                     "Failed to generate authority id");
     }
 
-    std::string authority_id = authority_id_result.ValueOrDie();
+    std::string authority_id = std::move(authority_id_result).ValueOrDie();
     if (AssertionGeneratorMap::GetValue(authority_id) ==
         AssertionGeneratorMap::value_end()) {
       return Status(
@@ -99,7 +135,7 @@ Status EkepHandshakerOptions::Validate() const {
                     "Failed to generate authority id");
     }
 
-    std::string authority_id = authority_id_result.ValueOrDie();
+    std::string authority_id = std::move(authority_id_result).ValueOrDie();
     if (AssertionVerifierMap::GetValue(authority_id) ==
         AssertionVerifierMap::value_end()) {
       return Status(
@@ -19,12 +19,21 @@
 #ifndef ASYLO_GRPC_AUTH_CORE_EKEP_HANDSHAKER_UTIL_H_
 #define ASYLO_GRPC_AUTH_CORE_EKEP_HANDSHAKER_UTIL_H_
 
+#include <memory>
 #include <string>
+#include <unordered_set>
 #include <vector>
 
+#include "asylo/grpc/auth/core/client_precommit_cache.h"
+#include "asylo/grpc/auth/core/ekep_negotiation_cache.h"
+#include "asylo/grpc/auth/core/ekep_resumption.h"
+#include "asylo/grpc/auth/core/ephemeral_key_pool.h"
+#include "asylo/grpc/auth/core/handshake.pb.h"
+#include "asylo/identity/assertion_description_util.h"
 #include "asylo/identity/enclave_assertion_generator.h"
 #include "asylo/identity/enclave_assertion_verifier.h"
 #include "asylo/identity/identity.pb.h"
+#include "asylo/identity/verified_assertion_cache.h"
 #include "asylo/util/status.h"
 
 namespace asylo {
@@ -45,6 +54,42 @@ struct EkepHandshakerOptions {
   // Additional data presented by the EKEP participant during the handshake.
   std::string additional_authenticated_data;
 
+  // Server only. If set, the server issues a resumption ticket sealed by
+  // |ticket_sealer| at the end of each successful handshake, and accepts such
+  // tickets in place of the client's assertions.
+  std::shared_ptr<ResumptionTicketSealer> ticket_sealer;
+
+  // Client only. If set, the client stores the sessions it establishes with a
+  // server in |session_cache| under |session_cache_key|, and attempts to resume
+  // a stored session instead of performing a full handshake.
+  std::shared_ptr<EkepSessionCache> session_cache;
+  std::string session_cache_key;
+
+  // Client only. If set, the client remembers the parameters negotiated with a
+  // server in |negotiation_cache| under |session_cache_key|. When it connects
+  // to the same server again without offering a resumption ticket, it sends its
+  // ClientId together with its ClientPrecommit, saving a round trip if the
+  // server accepts it.
+  std::shared_ptr<EkepNegotiationCache> negotiation_cache;
+
+  // If set, the EKEP participant remembers the identities extracted from peer
+  // assertions in |verified_assertion_cache|. A later assertion with the same
+  // identity is still verified against the current handshake transcript, but
+  // its identity is taken from the cache.
+  std::shared_ptr<VerifiedAssertionCache> verified_assertion_cache;
+
+  // If set, the EKEP participant takes its ephemeral Diffie-Hellman key pair
+  // from |ephemeral_key_pool| when one is available, instead of generating it
+  // during the handshake.
+  std::shared_ptr<EphemeralKeyPool> ephemeral_key_pool;
+
+  // Client only. If set, the client copies the assertion offers and requests
+  // and the other fields of its ClientPrecommit that do not change between
+  // handshakes from |client_precommit_cache|. Every client sharing the cache
+  // must have the same self_assertions, accepted_peer_assertions, and
+  // additional_authenticated_data.
+  std::shared_ptr<ClientPrecommitCache> client_precommit_cache;
+
   // Validates the handshaker options. All of the following conditions must
   // hold, otherwise returns INVALID_ARGUMENT:
   //   * max_frame_size is non-zero and does not exceed
@@ -57,9 +102,16 @@ struct EkepHandshakerOptions {
   //   appropriate assertion-verification library available
   //   * The size of additional_authenticated_data is less than or equal to
   //   max_frame_size
+  //   * session_cache_key is non-empty if session_cache or negotiation_cache
+  //   is set
   Status Validate() const;
 };
 
+// Returns the record protocols supported by EKEP handshakers, in order of
+// preference. SEAL_CHACHA20_POLY1305 is preferred on hosts without AES hardware
+// acceleration, and is least preferred otherwise.
+std::vector<RecordProtocol> SupportedRecordProtocols();
+
 // Returns a pointer to the EnclaveAssertionGenerator corresponding to identity
 // type |description|.identity_type() and authority type
 // |description|.authority_type() from the AssertionGenerator static map, or
@@ -74,6 +126,11 @@ const EnclaveAssertionGenerator *GetEnclaveAssertionGenerator(
 const EnclaveAssertionVerifier *GetEnclaveAssertionVerifier(
     const AssertionDescription &description);
 
+// A set of assertion descriptions, keyed on identity type and authority type.
+using AssertionDescriptionSet =
+    std::unordered_set<AssertionDescription, AssertionDescriptionHasher,
+                       AssertionDescriptionEq>;
+
 // Searches |list| for the given |description| and, if found, returns an
 // iterator to the element. Return a past-the-end iterator if |description| is
 // not found.
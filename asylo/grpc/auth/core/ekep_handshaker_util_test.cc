@@ -18,9 +18,14 @@
 
 #include "asylo/grpc/auth/core/ekep_handshaker_util.h"
 
+#include <memory>
+
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 #include "asylo/grpc/auth/core/ekep_handshaker.h"
+#include "asylo/grpc/auth/core/ekep_negotiation_cache.h"
+#include "asylo/grpc/auth/core/ekep_resumption.h"
+#include "asylo/grpc/auth/core/handshake.pb.h"
 #include "asylo/identity/identity.pb.h"
 #include "asylo/identity/null_identity/null_identity_util.h"
 #include "asylo/test/util/status_matchers.h"
@@ -29,6 +34,7 @@ namespace asylo {
 namespace {
 
 using ::testing::Not;
+using ::testing::UnorderedElementsAre;
 
 const char kBadAuthorityType[] = "unknown authority";
 
@@ -60,6 +66,14 @@ TEST_F(EkepHandshakerUtilTest, GetInvalidEnclaveAssertionGenerator) {
   EXPECT_EQ(GetEnclaveAssertionGenerator(bad_assertion_description), nullptr);
 }
 
+// Verify that SupportedRecordProtocols returns every record protocol that a
+// record protocol key can be derived for, each exactly once.
+TEST_F(EkepHandshakerUtilTest, SupportedRecordProtocols) {
+  EXPECT_THAT(SupportedRecordProtocols(),
+              UnorderedElementsAre(SEAL_AES128_GCM, SEAL_AES128_GCM_REKEY,
+                                   SEAL_CHACHA20_POLY1305));
+}
+
 // Verify that GetEnclaveAssertionVerifier can retrieve a pointer to an instance
 // of the NullAssertionVerifier.
 TEST_F(EkepHandshakerUtilTest, GetNullEnclaveAssertionVerifier) {
@@ -103,6 +117,31 @@ TEST_F(EkepHandshakerUtilTest, ValidateBadAadSize) {
   EXPECT_THAT(options.Validate(), Not(IsOk()));
 }
 
+// Verify that Validate fails on a set of options with a session cache but no
+// session cache key.
+TEST_F(EkepHandshakerUtilTest, ValidateMissingSessionCacheKey) {
+  EkepHandshakerOptions options = default_options_;
+  options.session_cache = std::make_shared<EkepSessionCache>(/*capacity=*/1);
+
+  EXPECT_THAT(options.Validate(), Not(IsOk()));
+
+  options.session_cache_key = "server";
+  EXPECT_THAT(options.Validate(), IsOk());
+}
+
+// Verify that Validate fails on a set of options with a negotiation cache but
+// no session cache key.
+TEST_F(EkepHandshakerUtilTest, ValidateMissingNegotiationCacheKey) {
+  EkepHandshakerOptions options = default_options_;
+  options.negotiation_cache =
+      std::make_shared<EkepNegotiationCache>(/*capacity=*/1);
+
+  EXPECT_THAT(options.Validate(), Not(IsOk()));
+
+  options.session_cache_key = "server";
+  EXPECT_THAT(options.Validate(), IsOk());
+}
+
 // Verify that Validate fails on a set of options with an empty list of self
 // assertions.
 TEST_F(EkepHandshakerUtilTest, ValidateMissingSelfIdentities) {
@@ -0,0 +1,75 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+
+#include "asylo/grpc/auth/core/ekep_negotiation_cache.h"
+
+#include <iterator>
+
+namespace asylo {
+
+EkepNegotiationCache::EkepNegotiationCache(size_t capacity)
+    : capacity_(capacity) {}
+
+void EkepNegotiationCache::Put(const std::string &key,
+                               EkepNegotiation negotiation) {
+  absl::MutexLock lock(&mu_);
+  auto index_it = index_.find(key);
+  if (index_it != index_.end()) {
+    entries_.erase(index_it->second);
+    index_.erase(index_it);
+  }
+
+  if (capacity_ == 0) {
+    return;
+  }
+  while (entries_.size() >= capacity_) {
+    index_.erase(entries_.front().first);
+    entries_.pop_front();
+  }
+
+  entries_.emplace_back(key, std::move(negotiation));
+  index_[key] = std::prev(entries_.end());
+}
+
+bool EkepNegotiationCache::Get(const std::string &key,
+                               EkepNegotiation *negotiation) const {
+  absl::MutexLock lock(&mu_);
+  auto index_it = index_.find(key);
+  if (index_it == index_.end()) {
+    return false;
+  }
+  *negotiation = index_it->second->second;
+  return true;
+}
+
+void EkepNegotiationCache::Remove(const std::string &key) {
+  absl::MutexLock lock(&mu_);
+  auto index_it = index_.find(key);
+  if (index_it != index_.end()) {
+    entries_.erase(index_it->second);
+    index_.erase(index_it);
+  }
+}
+
+size_t EkepNegotiationCache::size() const {
+  absl::MutexLock lock(&mu_);
+  return entries_.size();
+}
+
+}  // namespace asylo
@@ -0,0 +1,90 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+
+#ifndef ASYLO_GRPC_AUTH_CORE_EKEP_NEGOTIATION_CACHE_H_
+#define ASYLO_GRPC_AUTH_CORE_EKEP_NEGOTIATION_CACHE_H_
+
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+#include <google/protobuf/repeated_field.h>
+#include "absl/synchronization/mutex.h"
+#include "asylo/grpc/auth/core/handshake.pb.h"
+#include "asylo/identity/identity.pb.h"
+
+namespace asylo {
+
+// The parameters that a server selected in a completed EKEP handshake, as
+// remembered by the client.
+struct EkepNegotiation {
+  // The cipher suite selected by the server.
+  HandshakeCipher cipher_suite = UNKNOWN_HANDSHAKE_CIPHER;
+
+  // The assertions requested by the server.
+  google::protobuf::RepeatedPtrField<AssertionRequest> server_requests;
+};
+
+// EkepNegotiationCache stores, on the client side, the parameters negotiated in
+// the last completed handshake with each server, keyed by a caller-chosen
+// string that identifies the server (e.g., its target name). A client uses the
+// cached parameters to send its ClientId together with its ClientPrecommit,
+// anticipating the server's ServerPrecommit.
+//
+// The cache holds at most |capacity| entries. When full, storing a new entry
+// evicts the least-recently stored one. EkepNegotiationCache is thread-safe.
+class EkepNegotiationCache {
+ public:
+  explicit EkepNegotiationCache(size_t capacity);
+
+  EkepNegotiationCache(const EkepNegotiationCache &other) = delete;
+  EkepNegotiationCache &operator=(const EkepNegotiationCache &other) = delete;
+
+  // Stores |negotiation| under |key|, replacing any entry previously stored
+  // under |key|.
+  void Put(const std::string &key, EkepNegotiation negotiation);
+
+  // Copies the entry stored under |key| to |negotiation|. Returns false if
+  // there is no entry for |key|.
+  bool Get(const std::string &key, EkepNegotiation *negotiation) const;
+
+  // Removes the entry stored under |key|, if any.
+  void Remove(const std::string &key);
+
+  // Returns the number of entries held by the cache.
+  size_t size() const;
+
+ private:
+  using EntryList = std::list<std::pair<std::string, EkepNegotiation>>;
+
+  const size_t capacity_;
+
+  mutable absl::Mutex mu_;
+
+  // Entries in the order in which they were stored, oldest first.
+  EntryList entries_ GUARDED_BY(mu_);
+
+  // An index into |entries_|.
+  std::unordered_map<std::string, EntryList::iterator> index_ GUARDED_BY(mu_);
+};
+
+}  // namespace asylo
+
+#endif  // ASYLO_GRPC_AUTH_CORE_EKEP_NEGOTIATION_CACHE_H_
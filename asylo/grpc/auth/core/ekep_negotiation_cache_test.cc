@@ -0,0 +1,82 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+
+#include "asylo/grpc/auth/core/ekep_negotiation_cache.h"
+
+#include <string>
+
+#include <gtest/gtest.h>
+#include "asylo/grpc/auth/core/handshake.pb.h"
+#include "asylo/identity/identity.pb.h"
+
+namespace asylo {
+namespace {
+
+constexpr char kServerKey[] = "server";
+
+EkepNegotiation MakeNegotiation(const std::string &authority_type) {
+  EkepNegotiation negotiation;
+  negotiation.cipher_suite = CURVE25519_SHA256;
+  AssertionDescription *description =
+      negotiation.server_requests.Add()->mutable_description();
+  description->set_identity_type(CODE_IDENTITY);
+  description->set_authority_type(authority_type);
+  return negotiation;
+}
+
+// Verify that Get returns a copy of the stored entry, and that the entry stays
+// in the cache until it is removed.
+TEST(EkepNegotiationCacheTest, GetReturnsStoredEntry) {
+  EkepNegotiationCache cache(/*capacity=*/4);
+  cache.Put(kServerKey, MakeNegotiation("Any"));
+
+  for (int i = 0; i < 2; ++i) {
+    EkepNegotiation negotiation;
+    ASSERT_TRUE(cache.Get(kServerKey, &negotiation));
+    EXPECT_EQ(negotiation.cipher_suite, CURVE25519_SHA256);
+    ASSERT_EQ(negotiation.server_requests.size(), 1);
+    EXPECT_EQ(negotiation.server_requests.Get(0).description().authority_type(),
+              "Any");
+  }
+
+  cache.Remove(kServerKey);
+  EkepNegotiation negotiation;
+  EXPECT_FALSE(cache.Get(kServerKey, &negotiation));
+  EXPECT_EQ(cache.size(), 0);
+}
+
+// Verify that the cache evicts the oldest entry when full, and that storing an
+// entry under an existing key replaces the old entry.
+TEST(EkepNegotiationCacheTest, PutEvictsOldestEntry) {
+  EkepNegotiationCache cache(/*capacity=*/2);
+  for (const char *key : {"a", "b", "b", "c"}) {
+    cache.Put(key, MakeNegotiation(key));
+  }
+  EXPECT_EQ(cache.size(), 2);
+
+  EkepNegotiation negotiation;
+  EXPECT_FALSE(cache.Get("a", &negotiation));
+  ASSERT_TRUE(cache.Get("b", &negotiation));
+  EXPECT_EQ(negotiation.server_requests.Get(0).description().authority_type(),
+            "b");
+  EXPECT_TRUE(cache.Get("c", &negotiation));
+}
+
+}  // namespace
+}  // namespace asylo
@@ -0,0 +1,181 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/grpc/auth/core/ekep_resumption.h"
+
+#include <openssl/mem.h>
+
+#include "absl/memory/memory.h"
+#include "absl/time/clock.h"
+#include "asylo/crypto/util/bytes.h"
+#include "asylo/util/status.h"
+
+namespace asylo {
+namespace {
+
+// Additional authenticated data for ticket encryption. This binds sealed
+// tickets to their purpose, so that a ticket key shared with other uses by
+// mistake cannot be used to forge tickets.
+constexpr char kTicketAssociatedData[] = "EKEP Resumption Ticket v1";
+
+// The maximum size of a serialized ResumptionTicket.
+constexpr size_t kTicketSizeLimit = 1 << 16;
+
+}  // namespace
+
+constexpr absl::Duration ResumptionTicketSealer::kMaxTicketLifetime;
+
+StatusOr<std::unique_ptr<ResumptionTicketSealer>>
+ResumptionTicketSealer::Create(ByteContainerView ticket_key,
+                               absl::Duration ticket_lifetime) {
+  if (ticket_lifetime <= absl::ZeroDuration() ||
+      ticket_lifetime > kMaxTicketLifetime) {
+    return Status(error::GoogleError::INVALID_ARGUMENT,
+                  "Ticket lifetime is out of range");
+  }
+
+  auto cryptor_result = AesGcmSivKeyedCryptor::Create(
+      ticket_key, kTicketSizeLimit, new AesGcmSivNonceGenerator());
+  if (!cryptor_result.ok()) {
+    return cryptor_result.status();
+  }
+  return absl::WrapUnique(new ResumptionTicketSealer(
+      std::move(cryptor_result).ValueOrDie(), ticket_lifetime));
+}
+
+ResumptionTicketSealer::ResumptionTicketSealer(
+    std::unique_ptr<AesGcmSivKeyedCryptor> cryptor,
+    absl::Duration ticket_lifetime)
+    : cryptor_(std::move(cryptor)), ticket_lifetime_(ticket_lifetime) {}
+
+Status ResumptionTicketSealer::Seal(const ResumptionTicket &ticket,
+                                    std::string *sealed_ticket) {
+  ResumptionTicket issued_ticket = ticket;
+  issued_ticket.set_expiration_time(
+      absl::ToUnixSeconds(absl::Now() + ticket_lifetime_));
+
+  CleansingVector<uint8_t> plaintext(issued_ticket.ByteSizeLong());
+  bool serialized =
+      issued_ticket.SerializeToArray(plaintext.data(), plaintext.size());
+  OPENSSL_cleanse(&(*issued_ticket.mutable_resumption_secret())[0],
+                  issued_ticket.resumption_secret().size());
+  if (!serialized) {
+    return Status(error::GoogleError::INTERNAL,
+                  "Failed to serialize resumption ticket");
+  }
+
+  // The sealed ticket is laid out as nonce || ciphertext || tag.
+  UnsafeBytes<kAesGcmSivNonceSize> nonce;
+  sealed_ticket->resize(nonce.size() + plaintext.size() +
+                        AesGcmSivKeyedCryptor::kTagSize);
+  uint8_t *ciphertext =
+      reinterpret_cast<uint8_t *>(&(*sealed_ticket)[0]) + nonce.size();
+  Status status =
+      cryptor_->Seal(kTicketAssociatedData, plaintext, &nonce, ciphertext,
+                     ciphertext + plaintext.size());
+  if (!status.ok()) {
+    sealed_ticket->clear();
+    return status;
+  }
+  sealed_ticket->replace(0, nonce.size(),
+                         reinterpret_cast<const char *>(nonce.data()),
+                         nonce.size());
+  return Status::OkStatus();
+}
+
+Status ResumptionTicketSealer::Open(ByteContainerView sealed_ticket,
+                                    ResumptionTicket *ticket) {
+  constexpr size_t kOverhead =
+      kAesGcmSivNonceSize + AesGcmSivKeyedCryptor::kTagSize;
+  if (sealed_ticket.size() <= kOverhead) {
+    return Status(error::GoogleError::UNAUTHENTICATED,
+                  "Resumption ticket is too short");
+  }
+
+  const size_t ciphertext_size = sealed_ticket.size() - kOverhead;
+  ByteContainerView nonce(sealed_ticket.data(), kAesGcmSivNonceSize);
+  ByteContainerView ciphertext(sealed_ticket.data() + kAesGcmSivNonceSize,
+                               ciphertext_size);
+  ByteContainerView tag(ciphertext.data() + ciphertext_size,
+                        AesGcmSivKeyedCryptor::kTagSize);
+
+  CleansingVector<uint8_t> plaintext(ciphertext_size);
+  Status status = cryptor_->Open(kTicketAssociatedData, ciphertext, tag, nonce,
+                                 plaintext.data());
+  if (!status.ok()) {
+    return Status(error::GoogleError::UNAUTHENTICATED,
+                  "Resumption ticket could not be authenticated");
+  }
+
+  if (!ticket->ParseFromArray(plaintext.data(), plaintext.size())) {
+    return Status(error::GoogleError::UNAUTHENTICATED,
+                  "Failed to deserialize resumption ticket");
+  }
+
+  if (absl::FromUnixSeconds(ticket->expiration_time()) <= absl::Now()) {
+    return Status(error::GoogleError::FAILED_PRECONDITION,
+                  "Resumption ticket has expired");
+  }
+  return Status::OkStatus();
+}
+
+EkepSessionCache::EkepSessionCache(size_t capacity) : capacity_(capacity) {}
+
+void EkepSessionCache::Put(const std::string &key, EkepSession session) {
+  absl::MutexLock lock(&mu_);
+  auto index_it = index_.find(key);
+  if (index_it != index_.end()) {
+    sessions_.erase(index_it->second);
+    index_.erase(index_it);
+  }
+
+  if (capacity_ == 0) {
+    return;
+  }
+  while (sessions_.size() >= capacity_) {
+    index_.erase(sessions_.front().first);
+    sessions_.pop_front();
+  }
+
+  sessions_.emplace_back(key, std::move(session));
+  index_[key] = std::prev(sessions_.end());
+}
+
+bool EkepSessionCache::Take(const std::string &key, EkepSession *session) {
+  absl::MutexLock lock(&mu_);
+  auto index_it = index_.find(key);
+  if (index_it == index_.end()) {
+    return false;
+  }
+
+  SessionList::iterator session_it = index_it->second;
+  bool expired = session_it->second.expiration <= absl::Now();
+  if (!expired) {
+    *session = std::move(session_it->second);
+  }
+  sessions_.erase(session_it);
+  index_.erase(index_it);
+  return !expired;
+}
+
+size_t EkepSessionCache::size() const {
+  absl::MutexLock lock(&mu_);
+  return sessions_.size();
+}
+
+}  // namespace asylo
@@ -0,0 +1,145 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_GRPC_AUTH_CORE_EKEP_RESUMPTION_H_
+#define ASYLO_GRPC_AUTH_CORE_EKEP_RESUMPTION_H_
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+#include "asylo/crypto/aes_gcm_siv.h"
+#include "asylo/crypto/util/byte_container_view.h"
+#include "asylo/grpc/auth/core/handshake.pb.h"
+#include "asylo/identity/identity.pb.h"
+#include "asylo/util/cleansing_types.h"
+#include "asylo/util/status.h"
+#include "asylo/util/statusor.h"
+
+namespace asylo {
+
+// ResumptionTicketSealer encrypts and authenticates EKEP resumption tickets
+// under a key that never leaves the server. A server handshaker uses it to
+// issue a ticket at the end of every successful handshake, and to recover the
+// ResumptionTicket when a client later presents that ticket.
+//
+// A ResumptionTicketSealer is thread-safe and is meant to be shared by all
+// server handshakers that accept each other's tickets.
+class ResumptionTicketSealer {
+ public:
+  // Creates a sealer that encrypts tickets under |ticket_key|, which must be a
+  // 128-bit or 256-bit AES-GCM-SIV key, and issues tickets that are valid for
+  // |ticket_lifetime|. |ticket_lifetime| must be positive and must not exceed
+  // kMaxTicketLifetime.
+  static StatusOr<std::unique_ptr<ResumptionTicketSealer>> Create(
+      ByteContainerView ticket_key, absl::Duration ticket_lifetime);
+
+  // The longest lifetime a ticket may be issued with.
+  static constexpr absl::Duration kMaxTicketLifetime = absl::Hours(24);
+
+  // Sets the expiration time of a copy of |ticket|, and encrypts the copy.
+  // Writes the opaque ticket to |sealed_ticket|.
+  Status Seal(const ResumptionTicket &ticket, std::string *sealed_ticket);
+
+  // Decrypts |sealed_ticket| and writes the result to |ticket|. Returns
+  // UNAUTHENTICATED if |sealed_ticket| was not produced by a sealer with the
+  // same key, and FAILED_PRECONDITION if the ticket has expired.
+  Status Open(ByteContainerView sealed_ticket, ResumptionTicket *ticket);
+
+  // Returns the lifetime of issued tickets.
+  absl::Duration ticket_lifetime() const { return ticket_lifetime_; }
+
+ private:
+  ResumptionTicketSealer(std::unique_ptr<AesGcmSivKeyedCryptor> cryptor,
+                         absl::Duration ticket_lifetime);
+
+  std::unique_ptr<AesGcmSivKeyedCryptor> cryptor_;
+  const absl::Duration ticket_lifetime_;
+};
+
+// A resumable EKEP session, as remembered by the client.
+struct EkepSession {
+  // The opaque ticket to present to the server.
+  std::string ticket;
+
+  // The cipher suite of the session. The server must select the same cipher
+  // suite to resume the session.
+  HandshakeCipher cipher_suite = UNKNOWN_HANDSHAKE_CIPHER;
+
+  // The resumption secret that the ticket binds to.
+  CleansingVector<uint8_t> resumption_secret;
+
+  // Descriptions of the server assertions verified by the client.
+  std::vector<AssertionDescription> peer_assertions;
+
+  // The server identities extracted from the verified assertions.
+  EnclaveIdentities peer_identities;
+
+  // The time after which the server no longer accepts the ticket.
+  absl::Time expiration;
+};
+
+// EkepSessionCache stores resumable sessions on the client side, keyed by a
+// caller-chosen string that identifies the server (e.g., its target name).
+// Each session may be taken from the cache only once, so a ticket is never
+// presented on two connections.
+//
+// The cache holds at most |capacity| sessions. When full, storing a new session
+// evicts the least-recently stored one. EkepSessionCache is thread-safe.
+class EkepSessionCache {
+ public:
+  explicit EkepSessionCache(size_t capacity);
+
+  EkepSessionCache(const EkepSessionCache &other) = delete;
+  EkepSessionCache &operator=(const EkepSessionCache &other) = delete;
+
+  // Stores |session| under |key|, replacing any session previously stored
+  // under |key|.
+  void Put(const std::string &key, EkepSession session);
+
+  // Removes the session stored under |key| from the cache and moves it to
+  // |session|. Returns false if there is no unexpired session for |key|.
+  bool Take(const std::string &key, EkepSession *session);
+
+  // Returns the number of sessions held by the cache, including expired ones
+  // that have not been evicted yet.
+  size_t size() const;
+
+ private:
+  using SessionList = std::list<std::pair<std::string, EkepSession>>;
+
+  const size_t capacity_;
+
+  mutable absl::Mutex mu_;
+
+  // Sessions in the order in which they were stored, oldest first.
+  SessionList sessions_ GUARDED_BY(mu_);
+
+  // An index into |sessions_|.
+  std::unordered_map<std::string, SessionList::iterator> index_ GUARDED_BY(mu_);
+};
+
+}  // namespace asylo
+
+#endif  // ASYLO_GRPC_AUTH_CORE_EKEP_RESUMPTION_H_
@@ -0,0 +1,169 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/grpc/auth/core/ekep_resumption.h"
+
+#include <memory>
+#include <string>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "asylo/crypto/util/bytes.h"
+#include "asylo/crypto/util/trivial_object_util.h"
+#include "asylo/grpc/auth/core/handshake.pb.h"
+#include "asylo/test/util/status_matchers.h"
+
+namespace asylo {
+namespace {
+
+using ::testing::Not;
+
+constexpr char kResumptionSecret[] = "0123456789abcdef0123456789abcdef";
+constexpr char kServerKey[] = "server";
+
+class ResumptionTicketSealerTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    ticket_key_ = TrivialRandomObject<SafeBytes<32>>();
+    auto sealer_result =
+        ResumptionTicketSealer::Create(ticket_key_, absl::Hours(1));
+    ASSERT_THAT(sealer_result, IsOk());
+    sealer_ = std::move(sealer_result).ValueOrDie();
+
+    ticket_.set_cipher_suite(CURVE25519_SHA256);
+    ticket_.set_resumption_secret(kResumptionSecret);
+    AssertionDescription *description = ticket_.add_peer_assertions();
+    description->set_identity_type(CODE_IDENTITY);
+    description->set_authority_type("Any");
+  }
+
+  SafeBytes<32> ticket_key_;
+  std::unique_ptr<ResumptionTicketSealer> sealer_;
+  ResumptionTicket ticket_;
+};
+
+// Verify that Create rejects ticket lifetimes that are not positive or that
+// exceed the maximum lifetime.
+TEST_F(ResumptionTicketSealerTest, CreateBadLifetime) {
+  EXPECT_THAT(ResumptionTicketSealer::Create(ticket_key_, absl::ZeroDuration()),
+              Not(IsOk()));
+  EXPECT_THAT(
+      ResumptionTicketSealer::Create(
+          ticket_key_,
+          ResumptionTicketSealer::kMaxTicketLifetime + absl::Seconds(1)),
+      Not(IsOk()));
+}
+
+// Verify that a sealed ticket opens to the original ticket with an expiration
+// time set.
+TEST_F(ResumptionTicketSealerTest, SealOpenRoundTrip) {
+  std::string sealed_ticket;
+  ASSERT_THAT(sealer_->Seal(ticket_, &sealed_ticket), IsOk());
+  EXPECT_EQ(sealed_ticket.find(kResumptionSecret), std::string::npos);
+
+  ResumptionTicket opened_ticket;
+  ASSERT_THAT(sealer_->Open(sealed_ticket, &opened_ticket), IsOk());
+  EXPECT_EQ(opened_ticket.resumption_secret(), kResumptionSecret);
+  EXPECT_EQ(opened_ticket.cipher_suite(), CURVE25519_SHA256);
+  ASSERT_EQ(opened_ticket.peer_assertions_size(), 1);
+  EXPECT_GT(absl::FromUnixSeconds(opened_ticket.expiration_time()),
+            absl::Now());
+}
+
+// Verify that Open rejects a ticket that has been modified.
+TEST_F(ResumptionTicketSealerTest, OpenTamperedTicket) {
+  std::string sealed_ticket;
+  ASSERT_THAT(sealer_->Seal(ticket_, &sealed_ticket), IsOk());
+
+  for (size_t i = 0; i < sealed_ticket.size(); ++i) {
+    std::string tampered_ticket = sealed_ticket;
+    tampered_ticket[i] ^= 1;
+    ResumptionTicket opened_ticket;
+    EXPECT_THAT(sealer_->Open(tampered_ticket, &opened_ticket),
+                StatusIs(error::GoogleError::UNAUTHENTICATED));
+  }
+
+  ResumptionTicket opened_ticket;
+  EXPECT_THAT(sealer_->Open(sealed_ticket.substr(0, 16), &opened_ticket),
+              StatusIs(error::GoogleError::UNAUTHENTICATED));
+}
+
+// Verify that Open rejects a ticket sealed under a different key.
+TEST_F(ResumptionTicketSealerTest, OpenTicketFromOtherServer) {
+  auto other_sealer_result = ResumptionTicketSealer::Create(
+      TrivialRandomObject<SafeBytes<32>>(), absl::Hours(1));
+  ASSERT_THAT(other_sealer_result, IsOk());
+
+  std::string sealed_ticket;
+  ASSERT_THAT(other_sealer_result.ValueOrDie()->Seal(ticket_, &sealed_ticket),
+              IsOk());
+
+  ResumptionTicket opened_ticket;
+  EXPECT_THAT(sealer_->Open(sealed_ticket, &opened_ticket),
+              StatusIs(error::GoogleError::UNAUTHENTICATED));
+}
+
+// Verify that Take returns a stored session exactly once.
+TEST(EkepSessionCacheTest, TakeIsSingleUse) {
+  EkepSessionCache cache(/*capacity=*/4);
+  EkepSession session;
+  session.ticket = "ticket";
+  session.expiration = absl::Now() + absl::Hours(1);
+  cache.Put(kServerKey, std::move(session));
+
+  EkepSession taken_session;
+  ASSERT_TRUE(cache.Take(kServerKey, &taken_session));
+  EXPECT_EQ(taken_session.ticket, "ticket");
+  EXPECT_FALSE(cache.Take(kServerKey, &taken_session));
+  EXPECT_EQ(cache.size(), 0);
+}
+
+// Verify that Take does not return expired sessions.
+TEST(EkepSessionCacheTest, TakeSkipsExpiredSessions) {
+  EkepSessionCache cache(/*capacity=*/4);
+  EkepSession session;
+  session.expiration = absl::Now() - absl::Seconds(1);
+  cache.Put(kServerKey, std::move(session));
+
+  EkepSession taken_session;
+  EXPECT_FALSE(cache.Take(kServerKey, &taken_session));
+  EXPECT_EQ(cache.size(), 0);
+}
+
+// Verify that the cache evicts the oldest session when full, and that storing a
+// session under an existing key replaces the old session.
+TEST(EkepSessionCacheTest, PutEvictsOldestSession) {
+  EkepSessionCache cache(/*capacity=*/2);
+  for (const char *key : {"a", "b", "b", "c"}) {
+    EkepSession session;
+    session.ticket = key;
+    session.expiration = absl::Now() + absl::Hours(1);
+    cache.Put(key, std::move(session));
+  }
+  EXPECT_EQ(cache.size(), 2);
+
+  EkepSession taken_session;
+  EXPECT_FALSE(cache.Take("a", &taken_session));
+  EXPECT_TRUE(cache.Take("b", &taken_session));
+  EXPECT_TRUE(cache.Take("c", &taken_session));
+}
+
+}  // namespace
+}  // namespace asylo
@@ -20,6 +20,9 @@
 
 #include <string.h>
 
+#include <utility>
+
+#include "absl/time/time.h"
 #include "asylo/grpc/auth/core/assertion_description.h"
 #include "asylo/grpc/auth/core/enclave_security_connector.h"
 #include "asylo/grpc/auth/util/safe_string.h"
@@ -28,6 +31,37 @@
 #include "src/core/lib/channel/channel_args.h"
 #include "src/core/lib/security/credentials/credentials.h"
 
+/* Creates a pool of |size| ephemeral key pairs, or returns nullptr if |size| is
+ * zero or the pool cannot be created. */
+static asylo::EphemeralKeyPool *ephemeral_key_pool_create(size_t size) {
+  if (size == 0) {
+    return nullptr;
+  }
+  auto pool_result = asylo::EphemeralKeyPool::Create(size);
+  if (!pool_result.ok()) {
+    gpr_log(GPR_ERROR, "Failed to create ephemeral key pool: %s",
+            pool_result.status().ToString().c_str());
+    return nullptr;
+  }
+  return std::move(pool_result).ValueOrDie().release();
+}
+
+/* Creates the admission control for server handshakes described by |options|,
+ * or returns nullptr if handshakes are not limited. */
+static asylo::HandshakeAdmission *handshake_admission_create(
+    const grpc_enclave_credentials_options *options) {
+  if (options->max_concurrent_handshakes == 0) {
+    return nullptr;
+  }
+  absl::Duration pending_timeout =
+      options->pending_handshake_timeout_ms > 0
+          ? absl::Milliseconds(options->pending_handshake_timeout_ms)
+          : absl::InfiniteDuration();
+  return new asylo::HandshakeAdmission(options->max_concurrent_handshakes,
+                                       options->max_pending_handshakes,
+                                       pending_timeout);
+}
+
 /* Frees any memory allocated by this channel credentials object.
  * Note that this function does not destroy the credentials object itself. */
 static void enclave_channel_credentials_destruct(
@@ -37,6 +71,8 @@ static void enclave_channel_credentials_destruct(
   safe_string_free(&credentials->additional_authenticated_data);
   assertion_description_array_free(&credentials->self_assertions);
   assertion_description_array_free(&credentials->accepted_peer_assertions);
+  delete credentials->ephemeral_key_pool;
+  delete credentials->client_precommit_cache;
 }
 
 /* Frees any memory allocated by this server credentials object.
@@ -48,6 +84,8 @@ static void enclave_server_credentials_destruct(
   safe_string_free(&credentials->additional_authenticated_data);
   assertion_description_array_free(&credentials->self_assertions);
   assertion_description_array_free(&credentials->accepted_peer_assertions);
+  delete credentials->ephemeral_key_pool;
+  delete credentials->handshake_admission;
 }
 
 /* Creates an enclave channel security connector. */
@@ -56,8 +94,12 @@ static grpc_security_status enclave_channel_security_connector_create(
     const char *target, const grpc_channel_args *args,
     grpc_channel_security_connector **security_connector,
     grpc_channel_args **new_args) {
+  grpc_enclave_channel_credentials *credentials =
+      reinterpret_cast<grpc_enclave_channel_credentials *>(channel_creds);
   *security_connector = grpc_enclave_channel_security_connector_create(
       channel_creds, call_creds, target);
+  *new_args = grpc_enclave_transport_options_add_to_args(
+      &credentials->transport_options, args);
   return GRPC_SECURITY_OK;
 }
 
@@ -105,6 +147,12 @@ grpc_channel_credentials *grpc_enclave_channel_credentials_create(
   assertion_description_array_copy(
       /*src=*/&options->accepted_peer_assertions,
       /*dest=*/&credentials->accepted_peer_assertions);
+  credentials->max_protected_frame_size = options->max_protected_frame_size;
+  credentials->idle_buffer_release_ms = options->idle_buffer_release_ms;
+  credentials->ephemeral_key_pool =
+      ephemeral_key_pool_create(options->ephemeral_key_pool_size);
+  credentials->client_precommit_cache = new asylo::ClientPrecommitCache();
+  credentials->transport_options = options->transport_options;
 
   // Initialize the base credentials object
   credentials->base.type = GRPC_CREDENTIALS_TYPE_ENCLAVE;
@@ -134,6 +182,11 @@ grpc_server_credentials *grpc_enclave_server_credentials_create(
   assertion_description_array_copy(
       /*src=*/&options->accepted_peer_assertions,
       /*dest=*/&credentials->accepted_peer_assertions);
+  credentials->max_protected_frame_size = options->max_protected_frame_size;
+  credentials->idle_buffer_release_ms = options->idle_buffer_release_ms;
+  credentials->ephemeral_key_pool =
+      ephemeral_key_pool_create(options->ephemeral_key_pool_size);
+  credentials->handshake_admission = handshake_admission_create(options);
 
   // Initialize the base credentials object.
   credentials->base.type = GRPC_CREDENTIALS_TYPE_ENCLAVE;
@@ -20,7 +20,10 @@
 #define ASYLO_GRPC_AUTH_CORE_ENCLAVE_CREDENTIALS_H_
 
 #include "asylo/grpc/auth/core/assertion_description.h"
+#include "asylo/grpc/auth/core/client_precommit_cache.h"
 #include "asylo/grpc/auth/core/enclave_credentials_options.h"
+#include "asylo/grpc/auth/core/ephemeral_key_pool.h"
+#include "asylo/grpc/auth/core/handshake_admission.h"
 #include "asylo/grpc/auth/util/safe_string.h"
 #include "src/core/lib/security/credentials/credentials.h"
 
@@ -48,12 +51,32 @@ typedef struct {
   /* Additional authenticated data provided by the client. */
   safe_string additional_authenticated_data;
 
+  /* The size of frames produced by the client's record protocol, or zero to use
+   * the record protocol's default. */
+  size_t max_protected_frame_size;
+
+  /* The time in milliseconds after which the client's idle connections release
+   * their frame buffers, or zero to keep them. */
+  int idle_buffer_release_ms;
+
+  /* Ephemeral key pairs shared by the client's handshakers, or nullptr if each
+   * handshake generates its own key pair. */
+  asylo::EphemeralKeyPool *ephemeral_key_pool;
+
+  /* The serialized ClientPrecommit fields shared by the client's handshakers,
+   * including the assertion offers and requests. */
+  asylo::ClientPrecommitCache *client_precommit_cache;
+
   /* Assertions offered by the client. */
   assertion_description_array self_assertions;
 
   /* Server assertions accepted by the client. */
   assertion_description_array accepted_peer_assertions;
 
+  /* Socket and HTTP/2 tunables added to the arguments of the client's
+   * channels. */
+  grpc_enclave_transport_options transport_options;
+
 } grpc_enclave_channel_credentials;
 
 typedef struct {
@@ -62,6 +85,22 @@ typedef struct {
   /* Additional authenticated data provided by the server. */
   safe_string additional_authenticated_data;
 
+  /* The size of frames produced by the server's record protocol, or zero to use
+   * the record protocol's default. */
+  size_t max_protected_frame_size;
+
+  /* The time in milliseconds after which the server's idle connections release
+   * their frame buffers, or zero to keep them. */
+  int idle_buffer_release_ms;
+
+  /* Ephemeral key pairs shared by the server's handshakers, or nullptr if each
+   * handshake generates its own key pair. */
+  asylo::EphemeralKeyPool *ephemeral_key_pool;
+
+  /* Bounds the server's concurrent handshakes, or nullptr if they are not
+   * limited. */
+  asylo::HandshakeAdmission *handshake_admission;
+
   /* Assertions offered by the server. */
   assertion_description_array self_assertions;
 
@@ -24,6 +24,13 @@ void grpc_enclave_credentials_options_init(
   assertion_description_array_init(/*count=*/0, &options->self_assertions);
   assertion_description_array_init(/*count=*/0,
                                    &options->accepted_peer_assertions);
+  options->max_protected_frame_size = 0;
+  options->idle_buffer_release_ms = 0;
+  options->ephemeral_key_pool_size = 0;
+  options->max_concurrent_handshakes = 0;
+  options->max_pending_handshakes = 0;
+  options->pending_handshake_timeout_ms = 0;
+  grpc_enclave_transport_options_init(&options->transport_options);
 }
 
 void grpc_enclave_credentials_options_destroy(
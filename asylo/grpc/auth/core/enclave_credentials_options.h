@@ -19,7 +19,10 @@
 #ifndef ASYLO_GRPC_AUTH_CORE_ENCLAVE_CREDENTIALS_OPTIONS_H_
 #define ASYLO_GRPC_AUTH_CORE_ENCLAVE_CREDENTIALS_OPTIONS_H_
 
+#include <stddef.h>
+
 #include "asylo/grpc/auth/core/assertion_description.h"
+#include "asylo/grpc/auth/core/enclave_transport_options.h"
 #include "asylo/grpc/auth/util/safe_string.h"
 
 typedef struct {
@@ -31,6 +34,31 @@ typedef struct {
   /* The credential holder's accepted peer assertions. */
   assertion_description_array accepted_peer_assertions;
 
+  /* The size of frames produced by the record protocol, or zero to use the
+   * record protocol's default. */
+  size_t max_protected_frame_size;
+
+  /* The time in milliseconds after which an idle connection releases its frame
+   * buffers, or zero to keep them. */
+  int idle_buffer_release_ms;
+
+  /* The number of precomputed ephemeral Diffie-Hellman key pairs kept for
+   * handshakes, or zero to generate key pairs during each handshake. */
+  size_t ephemeral_key_pool_size;
+
+  /* The number of handshakes a server runs at once, or zero for no limit,
+   * the number of further handshakes that wait for a slot, and how long they
+   * wait in milliseconds, or zero to wait indefinitely. Handshakes that find
+   * the queue full or time out fail. Channel credentials ignore these. */
+  size_t max_concurrent_handshakes;
+  size_t max_pending_handshakes;
+  int pending_handshake_timeout_ms;
+
+  /* Socket and HTTP/2 tunables. Channel credentials add them to the arguments
+   * of their channels. Server credentials cannot change the arguments of their
+   * server, so servers apply them when the server is built. */
+  grpc_enclave_transport_options transport_options;
+
 } grpc_enclave_credentials_options;
 
 /* Initializes an options object. This should be called before assigning to or
@@ -25,6 +25,9 @@
 #define GRPC_ENCLAVE_RECORD_PROTOCOL_PROPERTY_NAME \
   "enclave_security.record_protocol"
 
+// The largest frame that the enclave record protocols produce or accept.
+#define GRPC_ENCLAVE_MAX_PROTECTED_FRAME_SIZE (1024 * 1024)
+
 // Enclave transport security type. This is the auth context value for the
 // GRPC_TRANSPORT_SECURITY_TYPE_PROPERTY_NAME property.
 #define GRPC_ENCLAVE_TRANSPORT_SECURITY_TYPE "enclave_security"
@@ -184,7 +184,11 @@ static void enclave_channel_security_connector_add_handshaker(
   tsi_result result = tsi_enclave_handshaker_create(
       /*is_client=*/true, &channel_creds->self_assertions,
       &channel_creds->accepted_peer_assertions,
-      &channel_creds->additional_authenticated_data, &tsi_handshaker);
+      &channel_creds->additional_authenticated_data,
+      channel_creds->max_protected_frame_size,
+      channel_creds->idle_buffer_release_ms, channel_creds->ephemeral_key_pool,
+      channel_creds->client_precommit_cache,
+      /*handshake_admission=*/nullptr, &tsi_handshaker);
   if (result != TSI_OK) {
     gpr_log(GPR_ERROR, "Enclave handshaker creation failed with error %s.",
             tsi_result_to_string(result));
@@ -206,7 +210,11 @@ static void enclave_server_security_connector_add_handshakers(
   tsi_result result = tsi_enclave_handshaker_create(
       /*is_client=*/false, &server_creds->self_assertions,
       &server_creds->accepted_peer_assertions,
-      &server_creds->additional_authenticated_data, &tsi_handshaker);
+      &server_creds->additional_authenticated_data,
+      server_creds->max_protected_frame_size,
+      server_creds->idle_buffer_release_ms, server_creds->ephemeral_key_pool,
+      /*client_precommit_cache=*/nullptr, server_creds->handshake_admission,
+      &tsi_handshaker);
   if (result != TSI_OK) {
     gpr_log(GPR_ERROR, "Enclave handshaker creation failed with error %s.",
             tsi_result_to_string(result));
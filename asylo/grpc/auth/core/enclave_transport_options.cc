@@ -0,0 +1,185 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/grpc/auth/core/enclave_transport_options.h"
+
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <string.h>
+#include <sys/socket.h>
+
+#include "include/grpc/support/alloc.h"
+#include "src/core/lib/channel/channel_args.h"
+#include "src/core/lib/iomgr/socket_mutator.h"
+
+#ifdef __ASYLO__
+#include "asylo/platform/arch/include/trusted/host_calls.h"
+#include "asylo/platform/posix/io/io_manager.h"
+#endif  // __ASYLO__
+
+/* The most socket options a mutator sets. */
+#define ENCLAVE_MAX_SOCKET_OPTIONS 3
+
+/* The most channel arguments added for a set of options. */
+#define ENCLAVE_MAX_TRANSPORT_ARGS 7
+
+typedef struct {
+  int level;
+  int option_name;
+  int value;
+} enclave_socket_option;
+
+/* A socket mutator setting a fixed list of integer socket options. */
+typedef struct {
+  grpc_socket_mutator base;
+  enclave_socket_option options[ENCLAVE_MAX_SOCKET_OPTIONS];
+  size_t count;
+} enclave_socket_mutator;
+
+/* Sets the |count| socket options |options| on |fd|. Returns true on
+ * success. */
+static bool set_socket_options(int fd, const enclave_socket_option *options,
+                               size_t count) {
+#ifdef __ASYLO__
+  /* gRPC's sockets are enclave file descriptors, on which each setsockopt() is
+   * a host call, so the options are passed to the host together. */
+  struct enc_int_sockopt batch[ENCLAVE_MAX_SOCKET_OPTIONS];
+  for (size_t i = 0; i < count; ++i) {
+    batch[i].level = options[i].level;
+    batch[i].option_name = options[i].option_name;
+    batch[i].value = options[i].value;
+  }
+  return asylo::io::IOManager::GetInstance().SetIntSockOpts(fd, batch,
+                                                            count) == 0;
+#else
+  for (size_t i = 0; i < count; ++i) {
+    if (setsockopt(fd, options[i].level, options[i].option_name,
+                   &options[i].value, sizeof(options[i].value)) != 0) {
+      return false;
+    }
+  }
+  return true;
+#endif  // __ASYLO__
+}
+
+static bool enclave_socket_mutator_mutate_fd(int fd,
+                                             grpc_socket_mutator *mutator) {
+  enclave_socket_mutator *self =
+      reinterpret_cast<enclave_socket_mutator *>(mutator);
+  return set_socket_options(fd, self->options, self->count);
+}
+
+static int enclave_socket_mutator_compare(grpc_socket_mutator *a,
+                                          grpc_socket_mutator *b) {
+  enclave_socket_mutator *first = reinterpret_cast<enclave_socket_mutator *>(a);
+  enclave_socket_mutator *second =
+      reinterpret_cast<enclave_socket_mutator *>(b);
+  if (first->count != second->count) {
+    return first->count < second->count ? -1 : 1;
+  }
+  return memcmp(first->options, second->options,
+                first->count * sizeof(first->options[0]));
+}
+
+static void enclave_socket_mutator_destroy(grpc_socket_mutator *mutator) {
+  gpr_free(mutator);
+}
+
+static const grpc_socket_mutator_vtable enclave_socket_mutator_vtable = {
+    enclave_socket_mutator_mutate_fd, enclave_socket_mutator_compare,
+    enclave_socket_mutator_destroy};
+
+/* Creates a socket mutator applying the socket options in |options|, or
+ * returns nullptr if they are all defaults. */
+static grpc_socket_mutator *enclave_socket_mutator_create(
+    const grpc_enclave_transport_options *options) {
+  enclave_socket_option socket_options[ENCLAVE_MAX_SOCKET_OPTIONS];
+  size_t count = 0;
+  if (options->socket_send_buffer_size > 0) {
+    socket_options[count++] = {SOL_SOCKET, SO_SNDBUF,
+                               options->socket_send_buffer_size};
+  }
+  if (options->socket_receive_buffer_size > 0) {
+    socket_options[count++] = {SOL_SOCKET, SO_RCVBUF,
+                               options->socket_receive_buffer_size};
+  }
+  if (!options->tcp_nodelay) {
+    socket_options[count++] = {IPPROTO_TCP, TCP_NODELAY, 0};
+  }
+  if (count == 0) {
+    return nullptr;
+  }
+
+  enclave_socket_mutator *mutator = static_cast<enclave_socket_mutator *>(
+      gpr_zalloc(sizeof(enclave_socket_mutator)));
+  memcpy(mutator->options, socket_options, count * sizeof(socket_options[0]));
+  mutator->count = count;
+  grpc_socket_mutator_init(&mutator->base, &enclave_socket_mutator_vtable);
+  return &mutator->base;
+}
+
+void grpc_enclave_transport_options_init(
+    grpc_enclave_transport_options *options) {
+  options->socket_send_buffer_size = 0;
+  options->socket_receive_buffer_size = 0;
+  options->tcp_nodelay = 1;
+  options->http2_initial_window_size = 0;
+  options->keepalive_time_ms = 0;
+  options->keepalive_timeout_ms = 0;
+}
+
+grpc_channel_args *grpc_enclave_transport_options_add_to_args(
+    const grpc_enclave_transport_options *options,
+    const grpc_channel_args *args) {
+  grpc_arg to_add[ENCLAVE_MAX_TRANSPORT_ARGS];
+  size_t count = 0;
+
+  grpc_socket_mutator *mutator = enclave_socket_mutator_create(options);
+  if (mutator != nullptr) {
+    to_add[count++] = grpc_socket_mutator_to_arg(mutator);
+  }
+  if (options->http2_initial_window_size > 0) {
+    to_add[count++] = grpc_channel_arg_integer_create(
+        const_cast<char *>(GRPC_ARG_HTTP2_STREAM_LOOKAHEAD_BYTES),
+        options->http2_initial_window_size);
+    to_add[count++] = grpc_channel_arg_integer_create(
+        const_cast<char *>(GRPC_ARG_HTTP2_BDP_PROBE), 0);
+  }
+  if (options->keepalive_time_ms > 0) {
+    to_add[count++] = grpc_channel_arg_integer_create(
+        const_cast<char *>(GRPC_ARG_KEEPALIVE_TIME_MS),
+        options->keepalive_time_ms);
+    to_add[count++] = grpc_channel_arg_integer_create(
+        const_cast<char *>(
+            GRPC_ARG_HTTP2_MIN_RECV_PING_INTERVAL_WITHOUT_DATA_MS),
+        options->keepalive_time_ms);
+  }
+  if (options->keepalive_timeout_ms > 0) {
+    to_add[count++] = grpc_channel_arg_integer_create(
+        const_cast<char *>(GRPC_ARG_KEEPALIVE_TIMEOUT_MS),
+        options->keepalive_timeout_ms);
+  }
+
+  grpc_channel_args *result =
+      grpc_channel_args_copy_and_add(args, to_add, count);
+  if (mutator != nullptr) {
+    /* The copied arguments hold their own reference. */
+    grpc_socket_mutator_unref(mutator);
+  }
+  return result;
+}
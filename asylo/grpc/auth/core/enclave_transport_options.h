@@ -0,0 +1,62 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_GRPC_AUTH_CORE_ENCLAVE_TRANSPORT_OPTIONS_H_
+#define ASYLO_GRPC_AUTH_CORE_ENCLAVE_TRANSPORT_OPTIONS_H_
+
+#include "include/grpc/grpc.h"
+
+typedef struct {
+  /* The sizes in bytes of the socket send and receive buffers (SO_SNDBUF and
+   * SO_RCVBUF), or zero to keep the host's defaults. */
+  int socket_send_buffer_size;
+  int socket_receive_buffer_size;
+
+  /* Whether TCP_NODELAY is set on connections. gRPC sets it by default. */
+  int tcp_nodelay;
+
+  /* The initial HTTP/2 flow-control window of each stream in bytes, or zero
+   * for gRPC's adaptive window. A fixed window disables gRPC's bandwidth-delay
+   * probing, which would otherwise resize it. */
+  int http2_initial_window_size;
+
+  /* The interval between keepalive pings and the time to wait for their
+   * acknowledgement in milliseconds, or zero for gRPC's defaults. Peers
+   * configured with the same interval accept pings at that rate. */
+  int keepalive_time_ms;
+  int keepalive_timeout_ms;
+
+} grpc_enclave_transport_options;
+
+/* Initializes an options object to gRPC's defaults. */
+void grpc_enclave_transport_options_init(
+    grpc_enclave_transport_options *options);
+
+/* Returns a copy of |args|, which may be null, extended with the channel
+ * arguments that apply |options|. Arguments already in |args| take precedence.
+ * The caller takes ownership of the result and destroys it with
+ * grpc_channel_args_destroy().
+ *
+ * Socket options are applied by a socket mutator to every connection. Inside an
+ * enclave, all of a connection's socket options are set in a single host
+ * call. */
+grpc_channel_args *grpc_enclave_transport_options_add_to_args(
+    const grpc_enclave_transport_options *options,
+    const grpc_channel_args *args);
+
+#endif  // ASYLO_GRPC_AUTH_CORE_ENCLAVE_TRANSPORT_OPTIONS_H_
@@ -25,10 +25,13 @@
 
 #include <google/protobuf/io/coded_stream.h>
 #include "absl/memory/memory.h"
+#include "asylo/grpc/auth/core/chacha20_poly1305_frame_protector.h"
 #include "asylo/grpc/auth/core/client_ekep_handshaker.h"
 #include "asylo/grpc/auth/core/ekep_handshaker.h"
 #include "asylo/grpc/auth/core/ekep_handshaker_util.h"
+#include "asylo/grpc/auth/core/enclave_grpc_security_constants.h"
 #include "asylo/grpc/auth/core/handshake.pb.h"
+#include "asylo/grpc/auth/core/handshake_executor.h"
 #include "asylo/grpc/auth/core/server_ekep_handshaker.h"
 #include "asylo/identity/identity.pb.h"
 #include "asylo/util/cleansing_types.h"
@@ -37,6 +40,7 @@
 #include "src/core/lib/gpr/string.h"
 #include "src/core/lib/surface/api_trace.h"
 #include "src/core/tsi/alts/frame_protector/alts_frame_protector.h"
+#include "src/core/tsi/alts/zero_copy_frame_protector/alts_zero_copy_grpc_protector.h"
 #include "src/core/tsi/transport_security.h"
 
 namespace asylo {
@@ -73,31 +77,80 @@ std::vector<AssertionDescription> CreateAssertionDescriptionVector(
 class TsiEnclaveHandshakerResult {
  public:
   TsiEnclaveHandshakerResult(
-      bool is_client, RecordProtocol record_protocol,
-      const CleansingVector<uint8_t> &record_protocol_key,
+      bool is_client, size_t max_protected_frame_size,
+      int idle_buffer_release_ms, RecordProtocol record_protocol,
+      CleansingVector<uint8_t> record_protocol_key,
       std::unique_ptr<EnclaveIdentities> peer_identities, std::string unused_bytes)
       : is_client_(is_client),
+        max_protected_frame_size_(max_protected_frame_size),
+        idle_buffer_release_ms_(idle_buffer_release_ms),
         record_protocol_(record_protocol),
-        record_protocol_key_(record_protocol_key),
+        record_protocol_key_(std::move(record_protocol_key)),
         peer_identities_(std::move(peer_identities)),
         unused_bytes_(std::move(unused_bytes)) {}
 
   // Creates a frame protector that uses a max frame size of
   // |max_output_protected_frame_size|, if non-null, and places the result in
-  // |protector|.
+  // |protector|. If |max_output_protected_frame_size| is null, the protector
+  // uses the configured frame size.
   tsi_result CreateFrameProtector(size_t *max_output_protected_frame_size,
                                   tsi_frame_protector **protector) {
+    size_t configured_frame_size = max_protected_frame_size_;
+    if (max_output_protected_frame_size == nullptr &&
+        configured_frame_size != 0) {
+      max_output_protected_frame_size = &configured_frame_size;
+    }
     switch (record_protocol_) {
       case SEAL_AES128_GCM:
         return alts_create_frame_protector(
             record_protocol_key_.data(), record_protocol_key_.size(),
             is_client_, /*is_rekey=*/false, max_output_protected_frame_size,
             protector);
+      case SEAL_AES128_GCM_REKEY:
+        return alts_create_frame_protector(
+            record_protocol_key_.data(), record_protocol_key_.size(),
+            is_client_, /*is_rekey=*/true, max_output_protected_frame_size,
+            protector);
+      case SEAL_CHACHA20_POLY1305:
+        return CreateChaCha20Poly1305FrameProtector(
+            record_protocol_key_, is_client_, max_output_protected_frame_size,
+            idle_buffer_release_ms_, protector);
       default:
         return TSI_INTERNAL_ERROR;
     }
   }
 
+  // Creates a zero-copy frame protector that uses a max frame size of
+  // |max_output_protected_frame_size|, if non-null, and places the result in
+  // |protector|. The protector seals and opens frames in place in gRPC slice
+  // buffers, and produces the same frames as the protector returned by
+  // CreateFrameProtector(). Returns TSI_UNIMPLEMENTED for record protocols
+  // without a zero-copy protector, in which case gRPC falls back to
+  // CreateFrameProtector().
+  tsi_result CreateZeroCopyGrpcProtector(
+      size_t *max_output_protected_frame_size,
+      tsi_zero_copy_grpc_protector **protector) {
+    size_t configured_frame_size = max_protected_frame_size_;
+    if (max_output_protected_frame_size == nullptr &&
+        configured_frame_size != 0) {
+      max_output_protected_frame_size = &configured_frame_size;
+    }
+    switch (record_protocol_) {
+      case SEAL_AES128_GCM:
+        return alts_zero_copy_grpc_protector_create(
+            record_protocol_key_.data(), record_protocol_key_.size(),
+            /*is_rekey=*/false, is_client_, /*is_integrity_only=*/false,
+            max_output_protected_frame_size, protector);
+      case SEAL_AES128_GCM_REKEY:
+        return alts_zero_copy_grpc_protector_create(
+            record_protocol_key_.data(), record_protocol_key_.size(),
+            /*is_rekey=*/true, is_client_, /*is_integrity_only=*/false,
+            max_output_protected_frame_size, protector);
+      default:
+        return TSI_UNIMPLEMENTED;
+    }
+  }
+
   // Sets |bytes| to the unused bytes from the handshake, if any, and sets
   // |bytes_size| to the number of unused bytes.
   tsi_result GetUnusedBytes(const unsigned char **bytes, size_t *bytes_size) {
@@ -161,6 +214,14 @@ class TsiEnclaveHandshakerResult {
   // the frame protector.
   bool is_client_;
 
+  // The size of frames produced by the frame protector if gRPC does not ask for
+  // a particular size, or zero to use the frame protector's default.
+  size_t max_protected_frame_size_;
+
+  // The time after which a copying frame protector releases its buffers while
+  // idle, or zero to keep them.
+  int idle_buffer_release_ms_;
+
   // The record protocol to use for frame protection.
   RecordProtocol record_protocol_;
 
@@ -189,6 +250,16 @@ tsi_result enclave_handshaker_result_extract_peer(
   return result->impl->ExtractPeer(peer);
 }
 
+tsi_result enclave_handshaker_result_create_zero_copy_grpc_protector(
+    const tsi_handshaker_result *self, size_t *max_output_protected_frame_size,
+    tsi_zero_copy_grpc_protector **protector) {
+  const tsi_enclave_handshaker_result *result =
+      reinterpret_cast<const tsi_enclave_handshaker_result *>(self);
+
+  return result->impl->CreateZeroCopyGrpcProtector(
+      max_output_protected_frame_size, protector);
+}
+
 tsi_result enclave_handshaker_result_create_frame_protector(
     const tsi_handshaker_result *self, size_t *max_output_protected_frame_size,
     tsi_frame_protector **protector) {
@@ -216,7 +287,7 @@ void enclave_handshaker_result_destroy(tsi_handshaker_result *self) {
 
 const tsi_handshaker_result_vtable handshaker_result_vtable = {
     enclave_handshaker_result_extract_peer,
-    nullptr /* create_zero_copy_grpc_protector */,
+    enclave_handshaker_result_create_zero_copy_grpc_protector,
     enclave_handshaker_result_create_frame_protector,
     enclave_handshaker_result_get_unused_bytes,
     enclave_handshaker_result_destroy,
@@ -244,43 +315,45 @@ tsi_result enclave_handshaker_result_create(
 struct tsi_enclave_handshaker {
   tsi_handshaker base;
   bool is_client;
+  size_t max_protected_frame_size;
+  int idle_buffer_release_ms;
   std::unique_ptr<EkepHandshaker> handshaker;
+  std::string incoming_bytes;
   std::string outgoing_bytes;
 
-  tsi_enclave_handshaker(bool is_client,
+  // Bounds the number of handshakes that run at once, or nullptr. |admitted|
+  // is set once the handshaker holds a slot, which it releases when it is
+  // destroyed.
+  HandshakeAdmission *admission;
+  bool admitted;
+
+  tsi_enclave_handshaker(bool is_client, size_t max_protected_frame_size,
+                         int idle_buffer_release_ms,
+                         HandshakeAdmission *admission,
                          std::unique_ptr<EkepHandshaker> ekep_handshaker);
 };
 
 void enclave_handshaker_destroy(tsi_handshaker *self) {
   tsi_enclave_handshaker *impl =
       reinterpret_cast<tsi_enclave_handshaker *>(self);
+  if (impl->admitted) {
+    impl->admission->Release();
+  }
   delete (impl);
 }
 
-tsi_result enclave_handshaker_next(
-    tsi_handshaker *self, const unsigned char *received_bytes,
+// Runs the next step of the handshake on |received_bytes| and writes the
+// outgoing bytes and the handshaker result, if any, to the output parameters.
+tsi_result enclave_handshaker_next_step(
+    tsi_enclave_handshaker *tsi_handshaker, const char *received_bytes,
     size_t received_bytes_size, const unsigned char **bytes_to_send,
-    size_t *bytes_to_send_size, tsi_handshaker_result **handshaker_result,
-    tsi_handshaker_on_next_done_cb cb, void *user_data) {
-  if ((received_bytes_size > 0 && !received_bytes) || !bytes_to_send ||
-      !bytes_to_send_size || !handshaker_result) {
-    return TSI_INVALID_ARGUMENT;
-  }
-  gpr_log(GPR_INFO,
-          "enclave_handshaker_next(self=%p, received_bytes=%p, "
-          "received_bytes_size=%zu, bytes_to_send=%p, bytes_to_send_size=%p "
-          "handshaker_result=%p, cb=%p, user_data=%p)",
-          self, received_bytes, received_bytes_size, bytes_to_send,
-          bytes_to_send_size, handshaker_result, cb, user_data);
-
-  tsi_enclave_handshaker *tsi_handshaker =
-      reinterpret_cast<tsi_enclave_handshaker *>(self);
+    size_t *bytes_to_send_size, tsi_handshaker_result **handshaker_result) {
+  tsi_handshaker *self = &tsi_handshaker->base;
   EkepHandshaker *handshaker = tsi_handshaker->handshaker.get();
 
   // Run the next step of the handshake.
   EkepHandshaker::Result handshake_step_result = handshaker->NextHandshakeStep(
-      reinterpret_cast<const char *>(received_bytes), received_bytes_size,
-      &tsi_handshaker->outgoing_bytes);
+      received_bytes, received_bytes_size, &tsi_handshaker->outgoing_bytes);
 
   // Write the outgoing bytes.
   if (!tsi_handshaker->outgoing_bytes.empty()) {
@@ -332,10 +405,13 @@ tsi_result enclave_handshaker_next(
       // Create the handshaker result object.
       tsi_result result = enclave_handshaker_result_create(
           absl::make_unique<TsiEnclaveHandshakerResult>(
-              tsi_handshaker->is_client, record_protocol_result.ValueOrDie(),
-              key_result.ValueOrDie(),
+              tsi_handshaker->is_client,
+              tsi_handshaker->max_protected_frame_size,
+              tsi_handshaker->idle_buffer_release_ms,
+              record_protocol_result.ValueOrDie(),
+              std::move(key_result).ValueOrDie(),
               std::move(identities_result).ValueOrDie(),
-              unused_bytes_result.ValueOrDie()),
+              std::move(unused_bytes_result).ValueOrDie()),
           handshaker_result);
       if (result == TSI_OK) {
         self->handshaker_result_created = true;
@@ -348,6 +424,96 @@ tsi_result enclave_handshaker_next(
   }
 }
 
+// Schedules the next step of the handshake on |executor| on the bytes in
+// |tsi_handshaker->incoming_bytes|, passing the outcome to |cb|.
+void enclave_handshaker_schedule_step(HandshakeExecutor *executor,
+                                      tsi_enclave_handshaker *tsi_handshaker,
+                                      tsi_handshaker_on_next_done_cb cb,
+                                      void *user_data) {
+  executor->Schedule([tsi_handshaker, cb, user_data] {
+    const unsigned char *bytes_to_send = nullptr;
+    size_t bytes_to_send_size = 0;
+    tsi_handshaker_result *handshaker_result = nullptr;
+    tsi_result result = enclave_handshaker_next_step(
+        tsi_handshaker, tsi_handshaker->incoming_bytes.data(),
+        tsi_handshaker->incoming_bytes.size(), &bytes_to_send,
+        &bytes_to_send_size, &handshaker_result);
+    cb(result, user_data, bytes_to_send, bytes_to_send_size,
+       handshaker_result);
+  });
+}
+
+tsi_result enclave_handshaker_next(
+    tsi_handshaker *self, const unsigned char *received_bytes,
+    size_t received_bytes_size, const unsigned char **bytes_to_send,
+    size_t *bytes_to_send_size, tsi_handshaker_result **handshaker_result,
+    tsi_handshaker_on_next_done_cb cb, void *user_data) {
+  if ((received_bytes_size > 0 && !received_bytes) || !bytes_to_send ||
+      !bytes_to_send_size || !handshaker_result) {
+    return TSI_INVALID_ARGUMENT;
+  }
+  gpr_log(GPR_INFO,
+          "enclave_handshaker_next(self=%p, received_bytes=%p, "
+          "received_bytes_size=%zu, bytes_to_send=%p, bytes_to_send_size=%p "
+          "handshaker_result=%p, cb=%p, user_data=%p)",
+          self, received_bytes, received_bytes_size, bytes_to_send,
+          bytes_to_send_size, handshaker_result, cb, user_data);
+
+  tsi_enclave_handshaker *tsi_handshaker =
+      reinterpret_cast<tsi_enclave_handshaker *>(self);
+
+  // Without a callback, the caller expects the step to complete synchronously.
+  if (!cb) {
+    return enclave_handshaker_next_step(
+        tsi_handshaker, reinterpret_cast<const char *>(received_bytes),
+        received_bytes_size, bytes_to_send, bytes_to_send_size,
+        handshaker_result);
+  }
+
+  // Otherwise, run the step on the handshake executor so that generating and
+  // verifying assertions does not block the caller's thread. The caller does
+  // not invoke the handshaker again until |cb| runs, and keeps the handshaker
+  // alive until then. The received bytes are copied because the caller's
+  // buffer is only guaranteed to be valid for the duration of this call.
+  tsi_handshaker->incoming_bytes.assign(
+      reinterpret_cast<const char *>(received_bytes), received_bytes_size);
+  HandshakeExecutor *executor = HandshakeExecutor::Default();
+  if (!executor) {
+    gpr_log(GPR_ERROR, "Handshake executor is unavailable");
+    return TSI_INTERNAL_ERROR;
+  }
+  if (!tsi_handshaker->admission || tsi_handshaker->admitted) {
+    enclave_handshaker_schedule_step(executor, tsi_handshaker, cb, user_data);
+    return TSI_ASYNC;
+  }
+
+  // A handshake that has not yet run a step needs a slot. A queued handshake
+  // is scheduled by whichever thread admits it. |cb| must not run before this
+  // function returns, so a handshake rejected here fails synchronously.
+  switch (tsi_handshaker->admission->Admit(
+      [executor, tsi_handshaker, cb, user_data](bool admitted) {
+        if (!admitted) {
+          gpr_log(GPR_ERROR, "Handshake was not admitted");
+          cb(TSI_OUT_OF_RESOURCES, user_data, nullptr, 0, nullptr);
+          return;
+        }
+        tsi_handshaker->admitted = true;
+        enclave_handshaker_schedule_step(executor, tsi_handshaker, cb,
+                                         user_data);
+      })) {
+    case HandshakeAdmission::Result::ADMITTED:
+      tsi_handshaker->admitted = true;
+      enclave_handshaker_schedule_step(executor, tsi_handshaker, cb, user_data);
+      return TSI_ASYNC;
+    case HandshakeAdmission::Result::QUEUED:
+      return TSI_ASYNC;
+    case HandshakeAdmission::Result::REJECTED:
+    default:
+      gpr_log(GPR_ERROR, "Handshake rejected: too many pending handshakes");
+      return TSI_OUT_OF_RESOURCES;
+  }
+}
+
 const tsi_handshaker_vtable handshaker_vtable = {
     nullptr /* get_bytes_to_send_to_peer -- deprecated */,
     nullptr /* process_bytes_from_peer   -- deprecated */,
@@ -359,8 +525,15 @@ const tsi_handshaker_vtable handshaker_vtable = {
 };
 
 tsi_enclave_handshaker::tsi_enclave_handshaker(
-    bool is_client, std::unique_ptr<EkepHandshaker> ekep_handshaker)
-    : is_client(is_client), handshaker(std::move(ekep_handshaker)) {
+    bool is_client, size_t max_protected_frame_size,
+    int idle_buffer_release_ms, HandshakeAdmission *admission,
+    std::unique_ptr<EkepHandshaker> ekep_handshaker)
+    : is_client(is_client),
+      max_protected_frame_size(max_protected_frame_size),
+      idle_buffer_release_ms(idle_buffer_release_ms),
+      handshaker(std::move(ekep_handshaker)),
+      admission(admission),
+      admitted(false) {
   base.handshaker_result_created = false;
   base.handshake_shutdown = false;
   base.vtable = &handshaker_vtable;
@@ -372,14 +545,32 @@ tsi_result tsi_enclave_handshaker_create(
     int is_client, const assertion_description_array *self_assertions,
     const assertion_description_array *accepted_peer_assertions,
     const safe_string *additional_authenticated_data,
+    size_t max_protected_frame_size, int idle_buffer_release_ms,
+    asylo::EphemeralKeyPool *ephemeral_key_pool,
+    asylo::ClientPrecommitCache *client_precommit_cache,
+    asylo::HandshakeAdmission *handshake_admission,
     tsi_handshaker **handshaker) {
   GRPC_API_TRACE(
       "tsi_enclave_handshaker_create(is_client=%d, self_assertions=%p, "
       "accepted_peer_assertions=%p, additional_authenticated_data=%p, "
-      "handshaker=%p)",
-      5,
+      "max_protected_frame_size=%zu, idle_buffer_release_ms=%d, "
+      "ephemeral_key_pool=%p, client_precommit_cache=%p, "
+      "handshake_admission=%p, handshaker=%p)",
+      10,
       (is_client, self_assertions, accepted_peer_assertions,
-       additional_authenticated_data, handshaker));
+       additional_authenticated_data, max_protected_frame_size,
+       idle_buffer_release_ms, ephemeral_key_pool, client_precommit_cache,
+       handshake_admission, handshaker));
+
+  if (max_protected_frame_size > GRPC_ENCLAVE_MAX_PROTECTED_FRAME_SIZE) {
+    gpr_log(GPR_ERROR, "max_protected_frame_size cannot exceed %d",
+            GRPC_ENCLAVE_MAX_PROTECTED_FRAME_SIZE);
+    return TSI_INVALID_ARGUMENT;
+  }
+  if (idle_buffer_release_ms < 0) {
+    gpr_log(GPR_ERROR, "idle_buffer_release_ms cannot be negative");
+    return TSI_INVALID_ARGUMENT;
+  }
 
   // Convert arguments to handshaker options.
   asylo::EkepHandshakerOptions options;
@@ -390,6 +581,19 @@ tsi_result tsi_enclave_handshaker_create(
   options.accepted_peer_assertions =
       asylo::CreateAssertionDescriptionVector(*accepted_peer_assertions);
 
+  // The pool is owned by the credentials, which outlive every handshaker
+  // created from them, so the handshaker holds a non-owning reference.
+  if (ephemeral_key_pool) {
+    options.ephemeral_key_pool = std::shared_ptr<asylo::EphemeralKeyPool>(
+        std::shared_ptr<asylo::EphemeralKeyPool>(), ephemeral_key_pool);
+  }
+  if (is_client && client_precommit_cache) {
+    options.client_precommit_cache =
+        std::shared_ptr<asylo::ClientPrecommitCache>(
+            std::shared_ptr<asylo::ClientPrecommitCache>(),
+            client_precommit_cache);
+  }
+
   if (!options.additional_authenticated_data.empty()) {
     gpr_log(GPR_DEBUG, "additional authenticated data: %s",
             options.additional_authenticated_data.c_str());
@@ -411,7 +615,10 @@ tsi_result tsi_enclave_handshaker_create(
     return TSI_INTERNAL_ERROR;
   }
   asylo::tsi_enclave_handshaker *tsi_handshaker =
-      new asylo::tsi_enclave_handshaker(is_client, std::move(ekep_handshaker));
+      new asylo::tsi_enclave_handshaker(is_client, max_protected_frame_size,
+                                        idle_buffer_release_ms,
+                                        handshake_admission,
+                                        std::move(ekep_handshaker));
 
   *handshaker = &tsi_handshaker->base;
   return TSI_OK;
@@ -19,7 +19,12 @@
 #ifndef ASYLO_GRPC_AUTH_CORE_ENCLAVE_TRANSPORT_SECURITY_H_
 #define ASYLO_GRPC_AUTH_CORE_ENCLAVE_TRANSPORT_SECURITY_H_
 
+#include <stddef.h>
+
 #include "asylo/grpc/auth/core/assertion_description.h"
+#include "asylo/grpc/auth/core/client_precommit_cache.h"
+#include "asylo/grpc/auth/core/ephemeral_key_pool.h"
+#include "asylo/grpc/auth/core/handshake_admission.h"
 #include "asylo/grpc/auth/util/safe_string.h"
 #include "src/core/tsi/transport_security_interface.h"
 
@@ -42,10 +47,29 @@
 //   is willing to accept from the peer during the handshake
 //   * |additional_authenticated_data| is data to be authenticated as part of
 //   the handshake
+//   * |max_protected_frame_size| is the size of frames produced by the record
+//   protocol, or zero to use the record protocol's default. It must not exceed
+//   GRPC_ENCLAVE_MAX_PROTECTED_FRAME_SIZE
+//   * |idle_buffer_release_ms| is the time after which the frame protector of
+//   an idle connection releases its buffers, or zero to keep them
+//   * |ephemeral_key_pool| supplies precomputed ephemeral key pairs, or is
+//   nullptr to generate the key pair during the handshake. If set, it must
+//   outlive the handshaker
+//   * |client_precommit_cache| supplies a client's serialized assertion offers
+//   and requests, or is nullptr to create them during the handshake. It is
+//   ignored by servers. If set, it must outlive the handshaker and be used
+//   only with the same assertions and additional authenticated data
+//   * |handshake_admission| bounds the number of handshakes that run at once,
+//   or is nullptr to run every handshake as it arrives. It applies only to
+//   steps that run asynchronously. If set, it must outlive the handshaker
 tsi_result tsi_enclave_handshaker_create(
     int is_client, const assertion_description_array *self_assertions,
     const assertion_description_array *accepted_peer_assertions,
     const safe_string *additional_authenticated_data,
+    size_t max_protected_frame_size, int idle_buffer_release_ms,
+    asylo::EphemeralKeyPool *ephemeral_key_pool,
+    asylo::ClientPrecommitCache *client_precommit_cache,
+    asylo::HandshakeAdmission *handshake_admission,
     tsi_handshaker **handshaker);
 
 #endif  // ASYLO_GRPC_AUTH_CORE_ENCLAVE_TRANSPORT_SECURITY_H_
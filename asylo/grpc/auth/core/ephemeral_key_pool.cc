@@ -0,0 +1,97 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+
+#include "asylo/grpc/auth/core/ephemeral_key_pool.h"
+
+#include <utility>
+
+#include "absl/memory/memory.h"
+#include "asylo/util/status.h"
+
+namespace asylo {
+
+constexpr size_t EphemeralKeyPool::kMaxCapacity;
+
+StatusOr<std::unique_ptr<EphemeralKeyPool>> EphemeralKeyPool::Create(
+    size_t capacity) {
+  if (capacity == 0 || capacity > kMaxCapacity) {
+    return Status(error::GoogleError::INVALID_ARGUMENT,
+                  "Key pool capacity is out of range");
+  }
+  return absl::WrapUnique(new EphemeralKeyPool(capacity));
+}
+
+EphemeralKeyPool::EphemeralKeyPool(size_t capacity)
+    : capacity_(capacity), shutting_down_(false) {
+  filler_ = std::thread(&EphemeralKeyPool::FillLoop, this);
+}
+
+EphemeralKeyPool::~EphemeralKeyPool() {
+  {
+    absl::MutexLock lock(&mu_);
+    shutting_down_ = true;
+  }
+  filler_.join();
+}
+
+bool EphemeralKeyPool::Take(std::vector<uint8_t> *public_key,
+                            CleansingVector<uint8_t> *private_key) {
+  absl::MutexLock lock(&mu_);
+  if (key_pairs_.empty()) {
+    return false;
+  }
+
+  const KeyPair &key_pair = key_pairs_.front();
+  public_key->assign(key_pair.public_key.cbegin(), key_pair.public_key.cend());
+  private_key->assign(key_pair.private_key.cbegin(),
+                      key_pair.private_key.cend());
+  key_pairs_.pop_front();
+  return true;
+}
+
+size_t EphemeralKeyPool::size() const {
+  absl::MutexLock lock(&mu_);
+  return key_pairs_.size();
+}
+
+bool EphemeralKeyPool::NeedsFill() const {
+  return shutting_down_ || key_pairs_.size() < capacity_;
+}
+
+void EphemeralKeyPool::FillLoop() {
+  while (true) {
+    {
+      absl::MutexLock lock(&mu_);
+      mu_.Await(absl::Condition(this, &EphemeralKeyPool::NeedsFill));
+      if (shutting_down_) {
+        return;
+      }
+    }
+
+    // Generate the key pair without holding the lock, so that handshakers are
+    // not blocked on key generation.
+    KeyPair key_pair;
+    X25519_keypair(key_pair.public_key.data(), key_pair.private_key.data());
+
+    absl::MutexLock lock(&mu_);
+    key_pairs_.push_back(std::move(key_pair));
+  }
+}
+
+}  // namespace asylo
@@ -0,0 +1,98 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+
+#ifndef ASYLO_GRPC_AUTH_CORE_EPHEMERAL_KEY_POOL_H_
+#define ASYLO_GRPC_AUTH_CORE_EPHEMERAL_KEY_POOL_H_
+
+#include <openssl/curve25519.h>
+
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "absl/synchronization/mutex.h"
+#include "asylo/crypto/util/bytes.h"
+#include "asylo/util/cleansing_types.h"
+#include "asylo/util/statusor.h"
+
+namespace asylo {
+
+// EphemeralKeyPool holds Curve25519 key pairs that are generated ahead of time
+// by a background thread, so that EKEP handshakers can take an ephemeral
+// Diffie-Hellman key pair without generating one on the handshake's critical
+// path.
+//
+// Each key pair is handed out exactly once. The pool holds at most |capacity|
+// key pairs, and the background thread replaces key pairs as they are taken.
+// When the pool is empty, Take() fails and the handshaker generates a key pair
+// itself. EphemeralKeyPool is thread-safe.
+class EphemeralKeyPool {
+ public:
+  // The largest number of key pairs a pool may hold.
+  static constexpr size_t kMaxCapacity = 1024;
+
+  // Creates a pool that holds at most |capacity| key pairs, and starts filling
+  // it. |capacity| must be positive and must not exceed kMaxCapacity.
+  static StatusOr<std::unique_ptr<EphemeralKeyPool>> Create(size_t capacity);
+
+  EphemeralKeyPool(const EphemeralKeyPool &other) = delete;
+  EphemeralKeyPool &operator=(const EphemeralKeyPool &other) = delete;
+
+  // Stops the background thread and cleanses any key pairs left in the pool.
+  ~EphemeralKeyPool();
+
+  // Removes a key pair from the pool and writes it to |public_key| and
+  // |private_key|. Returns false if the pool is empty.
+  bool Take(std::vector<uint8_t> *public_key,
+            CleansingVector<uint8_t> *private_key) LOCKS_EXCLUDED(mu_);
+
+  // Returns the number of key pairs currently held by the pool.
+  size_t size() const LOCKS_EXCLUDED(mu_);
+
+  // Returns the maximum number of key pairs held by the pool.
+  size_t capacity() const { return capacity_; }
+
+ private:
+  struct KeyPair {
+    UnsafeBytes<X25519_PUBLIC_VALUE_LEN> public_key;
+    SafeBytes<X25519_PRIVATE_KEY_LEN> private_key;
+  };
+
+  explicit EphemeralKeyPool(size_t capacity);
+
+  // Returns true if the background thread should generate a key pair or exit.
+  bool NeedsFill() const EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  // Top level loop run by the background thread.
+  void FillLoop() LOCKS_EXCLUDED(mu_);
+
+  const size_t capacity_;
+
+  mutable absl::Mutex mu_;
+  std::deque<KeyPair> key_pairs_ GUARDED_BY(mu_);
+  bool shutting_down_ GUARDED_BY(mu_);
+
+  std::thread filler_;
+};
+
+}  // namespace asylo
+
+#endif  // ASYLO_GRPC_AUTH_CORE_EPHEMERAL_KEY_POOL_H_
@@ -0,0 +1,106 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+
+#include "asylo/grpc/auth/core/ephemeral_key_pool.h"
+
+#include <openssl/curve25519.h>
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "asylo/test/util/status_matchers.h"
+#include "asylo/util/cleansing_types.h"
+
+namespace asylo {
+namespace {
+
+using ::testing::Not;
+
+constexpr size_t kCapacity = 4;
+
+// Waits up to ten seconds for |pool| to fill up. Returns true if it did.
+bool WaitUntilFull(const EphemeralKeyPool &pool) {
+  absl::Time deadline = absl::Now() + absl::Seconds(10);
+  while (pool.size() < pool.capacity()) {
+    if (absl::Now() > deadline) {
+      return false;
+    }
+    absl::SleepFor(absl::Milliseconds(1));
+  }
+  return true;
+}
+
+// Verify that Create rejects capacities that are zero or too large.
+TEST(EphemeralKeyPoolTest, CreateBadCapacity) {
+  EXPECT_THAT(EphemeralKeyPool::Create(0), Not(IsOk()));
+  EXPECT_THAT(EphemeralKeyPool::Create(EphemeralKeyPool::kMaxCapacity + 1),
+              Not(IsOk()));
+}
+
+// Verify that the pool fills up to, and not beyond, its capacity.
+TEST(EphemeralKeyPoolTest, FillsToCapacity) {
+  auto pool_result = EphemeralKeyPool::Create(kCapacity);
+  ASSERT_THAT(pool_result, IsOk());
+  std::unique_ptr<EphemeralKeyPool> pool = std::move(pool_result).ValueOrDie();
+
+  ASSERT_TRUE(WaitUntilFull(*pool));
+  absl::SleepFor(absl::Milliseconds(10));
+  EXPECT_EQ(pool->size(), kCapacity);
+}
+
+// Verify that taken key pairs are valid and distinct, and that the pool refills
+// after key pairs are taken.
+TEST(EphemeralKeyPoolTest, TakeReturnsUniqueValidKeyPairs) {
+  auto pool_result = EphemeralKeyPool::Create(kCapacity);
+  ASSERT_THAT(pool_result, IsOk());
+  std::unique_ptr<EphemeralKeyPool> pool = std::move(pool_result).ValueOrDie();
+  ASSERT_TRUE(WaitUntilFull(*pool));
+
+  std::vector<std::vector<uint8_t>> public_keys;
+  for (size_t i = 0; i < kCapacity; ++i) {
+    std::vector<uint8_t> public_key;
+    CleansingVector<uint8_t> private_key;
+    ASSERT_TRUE(pool->Take(&public_key, &private_key));
+    ASSERT_EQ(public_key.size(), X25519_PUBLIC_VALUE_LEN);
+    ASSERT_EQ(private_key.size(), X25519_PRIVATE_KEY_LEN);
+
+    // The public key must be the public value of the private key.
+    uint8_t expected_public_key[X25519_PUBLIC_VALUE_LEN];
+    X25519_public_from_private(expected_public_key, private_key.data());
+    EXPECT_EQ(public_key,
+              std::vector<uint8_t>(expected_public_key,
+                                   expected_public_key +
+                                       X25519_PUBLIC_VALUE_LEN));
+
+    for (const std::vector<uint8_t> &other_public_key : public_keys) {
+      EXPECT_NE(public_key, other_public_key);
+    }
+    public_keys.push_back(public_key);
+  }
+
+  EXPECT_TRUE(WaitUntilFull(*pool));
+}
+
+}  // namespace
+}  // namespace asylo
@@ -77,13 +77,17 @@ func deriveSecrets() ([]byte, []byte) {
 	return masterSecret, authSecret
 }
 
-// DeriveRecordProtocolKey generates a SEAL AES128 GCM record protocol key
-// using the given master secret.
-func deriveRecordProtocolKey(masterSecret []byte) []byte {
+// DeriveRecordProtocolKey generates a record protocol key of size keySize
+// using the given master secret. The salt is "EKEP Record Protocol v1" for
+// SEAL_AES128_GCM, and is suffixed with the record protocol name otherwise.
+func deriveRecordProtocolKey(masterSecret []byte, protocolName string, keySize int) []byte {
 	hash := sha256.New
 	salt := []byte("EKEP Record Protocol v1")
+	if protocolName != "SEAL_AES128_GCM" {
+		salt = append(salt, []byte(" "+protocolName)...)
+	}
 	hkdf := hkdf.New(hash, masterSecret, salt, info[:])
-	key := make([]byte, 16)
+	key := make([]byte, keySize)
 
 	n, err := io.ReadFull(hkdf, key)
 	if n != len(key) || err != nil {
@@ -130,12 +134,21 @@ func main() {
 	fmt.Printf("Authenticator secret:\n%s\n\n", hex.EncodeToString(authSecret))
 
 	// EKEP record protocol secrets
-	key := deriveRecordProtocolKey(masterSecret)
-
 	fmt.Println(">>EKEP Record Protocol Key<<")
 	fmt.Printf("Master secret:\n%s\n", hex.EncodeToString(masterSecret[:]))
 	fmt.Printf("HKDF info:\n%s\n", hex.EncodeToString(info[:]))
-	fmt.Printf("Record protocol key:\n%s\n\n", hex.EncodeToString(key[:]))
+	for _, protocol := range []struct {
+		name    string
+		keySize int
+	}{
+		{"SEAL_AES128_GCM", 16},
+		{"SEAL_AES128_GCM_REKEY", 44},
+		{"SEAL_CHACHA20_POLY1305", 32},
+	} {
+		key := deriveRecordProtocolKey(masterSecret, protocol.name, protocol.keySize)
+		fmt.Printf("%s record protocol key:\n%s\n", protocol.name, hex.EncodeToString(key[:]))
+	}
+	fmt.Println()
 
 	// EKEP server handshake authenticator
 	serverAuthn := computeServerHandshakeAuthenticator(authSecret)
@@ -0,0 +1,143 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/grpc/auth/core/handshake_admission.h"
+
+#include <utility>
+#include <vector>
+
+namespace asylo {
+namespace {
+
+// Runs each of |callbacks| with |admitted|.
+void RunCallbacks(std::vector<HandshakeAdmission::Callback> *callbacks,
+                  bool admitted) {
+  for (HandshakeAdmission::Callback &callback : *callbacks) {
+    callback(admitted);
+  }
+  callbacks->clear();
+}
+
+}  // namespace
+
+HandshakeAdmission::HandshakeAdmission(size_t max_concurrent,
+                                       size_t max_pending,
+                                       absl::Duration pending_timeout)
+    : max_concurrent_(max_concurrent),
+      max_pending_(max_pending),
+      pending_timeout_(pending_timeout),
+      active_(0),
+      shutting_down_(false) {
+  if (pending_timeout_ != absl::InfiniteDuration() && max_pending_ > 0) {
+    expiry_thread_ = std::thread(&HandshakeAdmission::ExpireLoop, this);
+  }
+}
+
+HandshakeAdmission::~HandshakeAdmission() {
+  std::vector<Callback> rejected;
+  {
+    absl::MutexLock lock(&mu_);
+    shutting_down_ = true;
+    for (PendingHandshake &handshake : pending_) {
+      rejected.push_back(std::move(handshake.callback));
+    }
+    pending_.clear();
+    wake_.Signal();
+  }
+  if (expiry_thread_.joinable()) {
+    expiry_thread_.join();
+  }
+  RunCallbacks(&rejected, /*admitted=*/false);
+}
+
+HandshakeAdmission::Result HandshakeAdmission::Admit(Callback callback) {
+  absl::MutexLock lock(&mu_);
+  if (active_ < max_concurrent_ && pending_.empty()) {
+    ++active_;
+    return Result::ADMITTED;
+  }
+  if (pending_.size() >= max_pending_) {
+    return Result::REJECTED;
+  }
+  if (pending_.empty()) {
+    wake_.Signal();
+  }
+  pending_.push_back({absl::Now() + pending_timeout_, std::move(callback)});
+  return Result::QUEUED;
+}
+
+void HandshakeAdmission::Release() {
+  std::vector<Callback> expired;
+  Callback admitted;
+  {
+    absl::MutexLock lock(&mu_);
+    // Hand the slot to the longest-waiting handshake whose wait has not timed
+    // out, since the expiry thread may not have rejected it yet.
+    absl::Time now = absl::Now();
+    while (!pending_.empty() && !admitted) {
+      PendingHandshake &handshake = pending_.front();
+      if (handshake.deadline <= now) {
+        expired.push_back(std::move(handshake.callback));
+      } else {
+        admitted = std::move(handshake.callback);
+      }
+      pending_.pop_front();
+    }
+    if (!admitted) {
+      --active_;
+    }
+  }
+  RunCallbacks(&expired, /*admitted=*/false);
+  if (admitted) {
+    admitted(/*admitted=*/true);
+  }
+}
+
+size_t HandshakeAdmission::active() const {
+  absl::MutexLock lock(&mu_);
+  return active_;
+}
+
+size_t HandshakeAdmission::pending() const {
+  absl::MutexLock lock(&mu_);
+  return pending_.size();
+}
+
+void HandshakeAdmission::ExpireLoop() {
+  std::vector<Callback> expired;
+  absl::MutexLock lock(&mu_);
+  while (!shutting_down_) {
+    // Handshakes are queued with the same timeout, so the front of the queue
+    // is always the next to expire.
+    absl::Time now = absl::Now();
+    while (!pending_.empty() && pending_.front().deadline <= now) {
+      expired.push_back(std::move(pending_.front().callback));
+      pending_.pop_front();
+    }
+    if (!expired.empty()) {
+      mu_.Unlock();
+      RunCallbacks(&expired, /*admitted=*/false);
+      mu_.Lock();
+      continue;
+    }
+    wake_.WaitWithDeadline(&mu_, pending_.empty() ? absl::InfiniteFuture()
+                                                  : pending_.front().deadline);
+  }
+}
+
+}  // namespace asylo
@@ -0,0 +1,114 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_GRPC_AUTH_CORE_HANDSHAKE_ADMISSION_H_
+#define ASYLO_GRPC_AUTH_CORE_HANDSHAKE_ADMISSION_H_
+
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <thread>
+
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+
+namespace asylo {
+
+// HandshakeAdmission bounds the number of handshakes a server runs at once.
+// When many clients reconnect together, running every handshake concurrently
+// shares the handshake executor among all of them, so each takes longer and
+// many exceed the client's deadline. Admitting a bounded number keeps the
+// admitted handshakes fast and leaves the enclave's threads and memory to
+// established connections.
+//
+// A handshake that arrives while the limit is reached waits in a bounded
+// queue, in arrival order, until a slot is released or its wait times out.
+// HandshakeAdmission is thread-safe.
+class HandshakeAdmission {
+ public:
+  // The outcome of a request for a slot.
+  enum class Result {
+    // The handshake holds a slot and may proceed.
+    ADMITTED,
+    // The handshake is waiting for a slot. Its callback runs once it is
+    // admitted or rejected.
+    QUEUED,
+    // The handshake was rejected because the queue is full.
+    REJECTED,
+  };
+
+  // Called with true once a queued handshake is admitted, or with false if
+  // its wait times out or the HandshakeAdmission is destroyed. It runs on the
+  // thread that releases a slot or on an internal thread, and must not call
+  // back into the HandshakeAdmission.
+  using Callback = std::function<void(bool admitted)>;
+
+  // Admits up to |max_concurrent| handshakes at once, which must be positive,
+  // and queues up to |max_pending| more. A queued handshake is rejected after
+  // waiting for |pending_timeout|, unless it is absl::InfiniteDuration().
+  HandshakeAdmission(size_t max_concurrent, size_t max_pending,
+                     absl::Duration pending_timeout);
+
+  HandshakeAdmission(const HandshakeAdmission &) = delete;
+  HandshakeAdmission &operator=(const HandshakeAdmission &) = delete;
+
+  // Rejects all queued handshakes.
+  ~HandshakeAdmission();
+
+  // Requests a slot for a handshake. If the result is QUEUED, |callback| is
+  // invoked later on another thread; otherwise it is not invoked.
+  Result Admit(Callback callback) LOCKS_EXCLUDED(mu_);
+
+  // Releases the slot of an admitted handshake, admitting the longest-waiting
+  // queued handshake, if any.
+  void Release() LOCKS_EXCLUDED(mu_);
+
+  // Returns the number of handshakes holding a slot.
+  size_t active() const LOCKS_EXCLUDED(mu_);
+
+  // Returns the number of handshakes waiting for a slot.
+  size_t pending() const LOCKS_EXCLUDED(mu_);
+
+ private:
+  struct PendingHandshake {
+    absl::Time deadline;
+    Callback callback;
+  };
+
+  // Rejects queued handshakes as their waits time out, until shutdown.
+  void ExpireLoop() LOCKS_EXCLUDED(mu_);
+
+  const size_t max_concurrent_;
+  const size_t max_pending_;
+  const absl::Duration pending_timeout_;
+
+  mutable absl::Mutex mu_;
+  size_t active_ GUARDED_BY(mu_);
+  std::deque<PendingHandshake> pending_ GUARDED_BY(mu_);
+  bool shutting_down_ GUARDED_BY(mu_);
+
+  // Signalled when the queue becomes non-empty and on shutdown.
+  absl::CondVar wake_;
+
+  // Runs ExpireLoop() if |pending_timeout_| is finite.
+  std::thread expiry_thread_;
+};
+
+}  // namespace asylo
+
+#endif  // ASYLO_GRPC_AUTH_CORE_HANDSHAKE_ADMISSION_H_
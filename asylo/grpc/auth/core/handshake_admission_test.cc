@@ -0,0 +1,112 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/grpc/auth/core/handshake_admission.h"
+
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include "absl/synchronization/notification.h"
+#include "absl/time/time.h"
+
+namespace asylo {
+namespace {
+
+using ::testing::ElementsAre;
+
+// Verify that handshakes beyond the limit are queued up to the queue size and
+// rejected after that.
+TEST(HandshakeAdmissionTest, QueuesThenRejectsBeyondLimit) {
+  HandshakeAdmission admission(/*max_concurrent=*/2, /*max_pending=*/1,
+                               absl::InfiniteDuration());
+  auto unused = [](bool admitted) {};
+  EXPECT_EQ(admission.Admit(unused), HandshakeAdmission::Result::ADMITTED);
+  EXPECT_EQ(admission.Admit(unused), HandshakeAdmission::Result::ADMITTED);
+  EXPECT_EQ(admission.Admit(unused), HandshakeAdmission::Result::QUEUED);
+  EXPECT_EQ(admission.Admit(unused), HandshakeAdmission::Result::REJECTED);
+  EXPECT_EQ(admission.active(), 2);
+  EXPECT_EQ(admission.pending(), 1);
+}
+
+// Verify that released slots go to queued handshakes in arrival order.
+TEST(HandshakeAdmissionTest, ReleaseAdmitsQueuedInOrder) {
+  HandshakeAdmission admission(/*max_concurrent=*/1, /*max_pending=*/2,
+                               absl::InfiniteDuration());
+  std::vector<int> admitted;
+  ASSERT_EQ(admission.Admit([](bool admitted) {}),
+            HandshakeAdmission::Result::ADMITTED);
+  for (int i = 0; i < 2; ++i) {
+    auto callback = [&admitted, i](bool result) {
+      EXPECT_TRUE(result);
+      admitted.push_back(i);
+    };
+    ASSERT_EQ(admission.Admit(callback), HandshakeAdmission::Result::QUEUED);
+  }
+
+  admission.Release();
+  EXPECT_THAT(admitted, ElementsAre(0));
+  admission.Release();
+  EXPECT_THAT(admitted, ElementsAre(0, 1));
+  EXPECT_EQ(admission.active(), 1);
+  admission.Release();
+  EXPECT_EQ(admission.active(), 0);
+  EXPECT_EQ(admission.pending(), 0);
+}
+
+// Verify that a queued handshake is rejected once its wait times out, and that
+// its place in the queue is freed.
+TEST(HandshakeAdmissionTest, RejectsQueuedHandshakeAfterTimeout) {
+  HandshakeAdmission admission(/*max_concurrent=*/1, /*max_pending=*/1,
+                               absl::Milliseconds(10));
+  ASSERT_EQ(admission.Admit([](bool admitted) {}),
+            HandshakeAdmission::Result::ADMITTED);
+  absl::Notification done;
+  bool result = true;
+  auto callback = [&done, &result](bool admitted) {
+    result = admitted;
+    done.Notify();
+  };
+  ASSERT_EQ(admission.Admit(callback), HandshakeAdmission::Result::QUEUED);
+  done.WaitForNotification();
+  EXPECT_FALSE(result);
+  EXPECT_EQ(admission.pending(), 0);
+  EXPECT_EQ(admission.active(), 1);
+}
+
+// Verify that destroying the admission rejects queued handshakes.
+TEST(HandshakeAdmissionTest, DestructorRejectsQueuedHandshakes) {
+  bool called = false;
+  bool result = true;
+  {
+    HandshakeAdmission admission(/*max_concurrent=*/1, /*max_pending=*/1,
+                                 absl::InfiniteDuration());
+    ASSERT_EQ(admission.Admit([](bool admitted) {}),
+              HandshakeAdmission::Result::ADMITTED);
+    auto callback = [&called, &result](bool admitted) {
+      called = true;
+      result = admitted;
+    };
+    ASSERT_EQ(admission.Admit(callback), HandshakeAdmission::Result::QUEUED);
+  }
+  EXPECT_TRUE(called);
+  EXPECT_FALSE(result);
+}
+
+}  // namespace
+}  // namespace asylo
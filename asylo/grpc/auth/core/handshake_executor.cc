@@ -0,0 +1,86 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+
+#include "asylo/grpc/auth/core/handshake_executor.h"
+
+#include <utility>
+
+#include "asylo/platform/common/singleton.h"
+
+namespace asylo {
+namespace {
+
+struct DefaultHandshakeExecutorFactory {
+  using value_type = HandshakeExecutor;
+  static HandshakeExecutor *Construct() {
+    return new HandshakeExecutor(HandshakeExecutor::kDefaultWorkerCount);
+  }
+  static void Destruct(HandshakeExecutor *executor) { delete executor; }
+};
+
+}  // namespace
+
+constexpr int HandshakeExecutor::kDefaultWorkerCount;
+
+HandshakeExecutor::HandshakeExecutor(int num_workers) : shutting_down_(false) {
+  for (int i = 0; i < num_workers; ++i) {
+    workers_.emplace_back(&HandshakeExecutor::WorkerLoop, this);
+  }
+}
+
+HandshakeExecutor::~HandshakeExecutor() {
+  {
+    absl::MutexLock lock(&mu_);
+    shutting_down_ = true;
+  }
+  for (std::thread &worker : workers_) {
+    worker.join();
+  }
+}
+
+HandshakeExecutor *HandshakeExecutor::Default() {
+  return Singleton<HandshakeExecutor, DefaultHandshakeExecutorFactory>::get();
+}
+
+void HandshakeExecutor::Schedule(std::function<void()> task) {
+  absl::MutexLock lock(&mu_);
+  tasks_.push_back(std::move(task));
+}
+
+bool HandshakeExecutor::HasWork() {
+  return shutting_down_ || !tasks_.empty();
+}
+
+void HandshakeExecutor::WorkerLoop() {
+  while (true) {
+    std::function<void()> task;
+    {
+      absl::MutexLock lock(&mu_);
+      mu_.Await(absl::Condition(this, &HandshakeExecutor::HasWork));
+      if (tasks_.empty()) {
+        return;
+      }
+      task = std::move(tasks_.front());
+      tasks_.pop_front();
+    }
+    task();
+  }
+}
+
+}  // namespace asylo
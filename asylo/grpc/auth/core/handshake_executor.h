@@ -0,0 +1,74 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+
+#ifndef ASYLO_GRPC_AUTH_CORE_HANDSHAKE_EXECUTOR_H_
+#define ASYLO_GRPC_AUTH_CORE_HANDSHAKE_EXECUTOR_H_
+
+#include <deque>
+#include <functional>
+#include <thread>
+#include <vector>
+
+#include "absl/synchronization/mutex.h"
+
+namespace asylo {
+
+// HandshakeExecutor runs handshake steps on a fixed pool of worker threads so
+// that expensive work, such as generating and verifying assertions, does not
+// block the gRPC thread that drives the handshake.
+//
+// Tasks are started in the order in which they are scheduled. HandshakeExecutor
+// is thread-safe.
+class HandshakeExecutor {
+ public:
+  // The number of worker threads used by the process-wide executor.
+  static constexpr int kDefaultWorkerCount = 2;
+
+  // Starts |num_workers| worker threads. |num_workers| must be positive.
+  explicit HandshakeExecutor(int num_workers);
+
+  HandshakeExecutor(const HandshakeExecutor &) = delete;
+  HandshakeExecutor &operator=(const HandshakeExecutor &) = delete;
+
+  // Runs any tasks that are already scheduled and joins all worker threads.
+  ~HandshakeExecutor();
+
+  // Returns the process-wide executor shared by all enclave handshakers.
+  static HandshakeExecutor *Default();
+
+  // Schedules |task| to run on a worker thread.
+  void Schedule(std::function<void()> task) LOCKS_EXCLUDED(mu_);
+
+ private:
+  // Returns true if a worker has a task to run or should exit.
+  bool HasWork() EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  // Top level loop run by each worker thread.
+  void WorkerLoop() LOCKS_EXCLUDED(mu_);
+
+  absl::Mutex mu_;
+  std::deque<std::function<void()>> tasks_ GUARDED_BY(mu_);
+  bool shutting_down_ GUARDED_BY(mu_);
+
+  std::vector<std::thread> workers_;
+};
+
+}  // namespace asylo
+
+#endif  // ASYLO_GRPC_AUTH_CORE_HANDSHAKE_EXECUTOR_H_
@@ -0,0 +1,73 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+
+#include "asylo/grpc/auth/core/handshake_executor.h"
+
+#include <thread>
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include "absl/synchronization/mutex.h"
+#include "absl/synchronization/notification.h"
+
+namespace asylo {
+namespace {
+
+using ::testing::ElementsAre;
+
+// Verify that scheduled tasks run on a thread other than the caller's.
+TEST(HandshakeExecutorTest, RunsTasksOnWorkerThread) {
+  HandshakeExecutor executor(/*num_workers=*/1);
+  absl::Notification done;
+  std::thread::id task_thread;
+  executor.Schedule([&done, &task_thread] {
+    task_thread = std::this_thread::get_id();
+    done.Notify();
+  });
+  done.WaitForNotification();
+  EXPECT_NE(task_thread, std::this_thread::get_id());
+}
+
+// Verify that a single worker runs tasks in the order they were scheduled, and
+// that destroying the executor runs tasks that are still pending.
+TEST(HandshakeExecutorTest, DestructorRunsPendingTasksInOrder) {
+  absl::Mutex mu;
+  std::vector<int> order;
+  {
+    HandshakeExecutor executor(/*num_workers=*/1);
+    for (int i = 0; i < 5; ++i) {
+      executor.Schedule([&mu, &order, i] {
+        absl::MutexLock lock(&mu);
+        order.push_back(i);
+      });
+    }
+  }
+  EXPECT_THAT(order, ElementsAre(0, 1, 2, 3, 4));
+}
+
+// Verify that the default executor is shared.
+TEST(HandshakeExecutorTest, DefaultIsShared) {
+  HandshakeExecutor *executor = HandshakeExecutor::Default();
+  ASSERT_NE(executor, nullptr);
+  EXPECT_EQ(executor, HandshakeExecutor::Default());
+}
+
+}  // namespace
+}  // namespace asylo
@@ -0,0 +1,241 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/grpc/auth/core/record_channel.h"
+
+#include <cstring>
+
+#include "absl/memory/memory.h"
+#include "absl/strings/str_cat.h"
+
+namespace asylo {
+namespace {
+
+// Size of the message length prefix.
+constexpr size_t kLengthSize = 4;
+
+// Size of the staging buffers, one default-sized record.
+constexpr size_t kBufferSize = 16 * 1024;
+
+}  // namespace
+
+StatusOr<std::unique_ptr<RecordChannel>> RecordChannel::Create(
+    RecordRing *ring, const tsi_handshaker_result *result) {
+  tsi_frame_protector *protector = nullptr;
+  tsi_result tsi_status = tsi_handshaker_result_create_frame_protector(
+      result, /*max_output_protected_frame_size=*/nullptr, &protector);
+  if (tsi_status != TSI_OK) {
+    return Status(error::GoogleError::INTERNAL,
+                  absl::StrCat("Failed to create frame protector: ",
+                               tsi_result_to_string(tsi_status)));
+  }
+  return absl::make_unique<RecordChannel>(ring, protector);
+}
+
+RecordChannel::RecordChannel(RecordRing *ring, tsi_frame_protector *protector)
+    : RecordChannel(&ring->inbound, &ring->outbound, protector) {}
+
+RecordChannel::RecordChannel(RecordRingBuffer *inbound,
+                             RecordRingBuffer *outbound,
+                             tsi_frame_protector *protector)
+    : inbound_(inbound),
+      outbound_(outbound),
+      protector_(protector),
+      buffer_(kBufferSize),
+      unprotected_(kBufferSize),
+      plaintext_offset_(0) {}
+
+RecordChannel::~RecordChannel() { tsi_frame_protector_destroy(protector_); }
+
+StatusOr<bool> RecordChannel::ReadRecords() {
+  RecordRingBuffer &inbound = *inbound_;
+  size_t size;
+  for (uint32_t attempt = 0;; ++attempt) {
+    // Check whether the ring is closed before looking for records, since the
+    // host may write its last records and close the ring in between.
+    bool closed = inbound.is_closed_for_write();
+    size = buffer_.size();
+    const uint8_t *records = inbound.PeekRead(&size);
+    if (size > 0) {
+      // Copy the records into the enclave before unprotecting them.
+      memcpy(buffer_.data(), records, size);
+      inbound.ConsumeRead(size);
+      break;
+    }
+    if (closed) {
+      return false;
+    }
+    BackoffWaitStrategy::Wait(attempt);
+  }
+
+  // Each call consumes records, hands out plaintext, or both. Calls continue
+  // once the records are consumed, to drain the plaintext of the last record.
+  size_t offset = 0;
+  while (true) {
+    size_t consumed = size - offset;
+    size_t written = unprotected_.size();
+    if (tsi_frame_protector_unprotect(protector_, buffer_.data() + offset,
+                                      &consumed, unprotected_.data(),
+                                      &written) != TSI_OK) {
+      return Status(error::GoogleError::DATA_LOSS,
+                    "Failed to unprotect record");
+    }
+    plaintext_.append(reinterpret_cast<const char *>(unprotected_.data()),
+                      written);
+    offset += consumed;
+    if (consumed == 0 && written == 0) {
+      return true;
+    }
+  }
+}
+
+StatusOr<bool> RecordChannel::ReadMessage(std::string *message) {
+  // Drop the messages already returned.
+  plaintext_.erase(0, plaintext_offset_);
+  plaintext_offset_ = 0;
+
+  size_t length = 0;
+  bool have_length = false;
+  while (true) {
+    if (!have_length && plaintext_.size() >= kLengthSize) {
+      const uint8_t *prefix =
+          reinterpret_cast<const uint8_t *>(plaintext_.data());
+      length = static_cast<size_t>(prefix[0]) |
+               static_cast<size_t>(prefix[1]) << 8 |
+               static_cast<size_t>(prefix[2]) << 16 |
+               static_cast<size_t>(prefix[3]) << 24;
+      if (length > kRecordChannelMaxMessageSize) {
+        return Status(error::GoogleError::RESOURCE_EXHAUSTED,
+                      absl::StrCat("Message of ", length,
+                                   " bytes exceeds the limit of ",
+                                   kRecordChannelMaxMessageSize));
+      }
+      have_length = true;
+    }
+    if (have_length && plaintext_.size() >= kLengthSize + length) {
+      message->assign(plaintext_, kLengthSize, length);
+      plaintext_offset_ = kLengthSize + length;
+      return true;
+    }
+
+    StatusOr<bool> read_result = ReadRecords();
+    if (!read_result.ok()) {
+      return read_result.status();
+    }
+    if (!read_result.ValueOrDie()) {
+      if (plaintext_.empty()) {
+        return false;
+      }
+      return Status(error::GoogleError::DATA_LOSS,
+                    "Record ring closed within a message");
+    }
+  }
+}
+
+Status RecordChannel::WriteRecords(size_t size) {
+  if (outbound_->Write(buffer_.data(), size) != size) {
+    return Status(error::GoogleError::UNAVAILABLE,
+                  "Record ring closed for reading");
+  }
+  return Status::OkStatus();
+}
+
+Status RecordChannel::Protect(const uint8_t *data, size_t size) {
+  while (size > 0) {
+    size_t consumed = size;
+    size_t written = buffer_.size();
+    if (tsi_frame_protector_protect(protector_, data, &consumed,
+                                    buffer_.data(), &written) != TSI_OK) {
+      return Status(error::GoogleError::INTERNAL, "Failed to protect record");
+    }
+    Status status = WriteRecords(written);
+    if (!status.ok()) {
+      return status;
+    }
+    data += consumed;
+    size -= consumed;
+  }
+  return Status::OkStatus();
+}
+
+Status RecordChannel::Flush() {
+  size_t still_pending;
+  do {
+    size_t written = buffer_.size();
+    if (tsi_frame_protector_protect_flush(protector_, buffer_.data(), &written,
+                                          &still_pending) != TSI_OK) {
+      return Status(error::GoogleError::INTERNAL, "Failed to protect record");
+    }
+    Status status = WriteRecords(written);
+    if (!status.ok()) {
+      return status;
+    }
+  } while (still_pending > 0);
+  return Status::OkStatus();
+}
+
+Status RecordChannel::WriteMessage(ByteContainerView message) {
+  if (message.size() > kRecordChannelMaxMessageSize) {
+    return Status(error::GoogleError::RESOURCE_EXHAUSTED,
+                  absl::StrCat("Message of ", message.size(),
+                               " bytes exceeds the limit of ",
+                               kRecordChannelMaxMessageSize));
+  }
+  uint8_t prefix[kLengthSize] = {
+      static_cast<uint8_t>(message.size()),
+      static_cast<uint8_t>(message.size() >> 8),
+      static_cast<uint8_t>(message.size() >> 16),
+      static_cast<uint8_t>(message.size() >> 24)};
+  Status status = Protect(prefix, sizeof(prefix));
+  if (!status.ok()) {
+    return status;
+  }
+  status = Protect(message.data(), message.size());
+  if (!status.ok()) {
+    return status;
+  }
+  return Flush();
+}
+
+Status RecordChannel::Serve(const Handler &handler) {
+  std::string request;
+  std::string response;
+  while (true) {
+    StatusOr<bool> read_result = ReadMessage(&request);
+    if (!read_result.ok()) {
+      outbound_->close_for_write();
+      return read_result.status();
+    }
+    if (!read_result.ValueOrDie()) {
+      break;
+    }
+    response.clear();
+    Status status = handler(request, &response);
+    if (status.ok()) {
+      status = WriteMessage(response);
+    }
+    if (!status.ok()) {
+      outbound_->close_for_write();
+      return status;
+    }
+  }
+  outbound_->close_for_write();
+  return Status::OkStatus();
+}
+
+}  // namespace asylo
@@ -0,0 +1,141 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_GRPC_AUTH_CORE_RECORD_CHANNEL_H_
+#define ASYLO_GRPC_AUTH_CORE_RECORD_CHANNEL_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "asylo/crypto/util/byte_container_view.h"
+#include "asylo/platform/common/ring_buffer.h"
+#include "asylo/util/status.h"
+#include "asylo/util/statusor.h"
+#include "src/core/tsi/transport_security_interface.h"
+
+namespace asylo {
+
+// Number of bytes each direction of a RecordRing holds.
+constexpr size_t kRecordRingCapacity = 256 * 1024;
+
+// Largest message a RecordChannel accepts, gRPC's default receive limit.
+constexpr size_t kRecordChannelMaxMessageSize = 4 * 1024 * 1024;
+
+// One direction of a shared-memory record transport.
+using RecordRingBuffer = RingBuffer<kRecordRingCapacity, BackoffWaitStrategy>;
+
+// Shared memory carrying the protected records of one connection between an
+// untrusted host, which owns the socket and does all network polling, and the
+// enclave, which holds the record protocol keys. The host writes the bytes it
+// receives from the peer to |inbound| and sends the bytes it reads from
+// |outbound|, without parsing either. It closes |inbound| for writing when the
+// peer disconnects.
+//
+// A RecordRing is allocated by the host, so every byte of it is untrusted.
+struct RecordRing {
+  RecordRingBuffer inbound;
+  RecordRingBuffer outbound;
+};
+
+// The trusted end of a RecordRing, or of any pair of RecordRingBuffers. It
+// unprotects the records the host passes in, splits the plaintext into
+// messages, and protects the messages it sends back, so only the record
+// protocol and the message handler run inside the enclave.
+//
+// Each message is a 4-byte little-endian length followed by that many bytes.
+// Records are copied into enclave memory before they are unprotected, so the
+// host cannot change a record while it is authenticated. A RecordChannel is
+// used by one thread at a time.
+class RecordChannel {
+ public:
+  // Handles the message |request|, placing the reply in |response|.
+  using Handler =
+      std::function<Status(ByteContainerView request, std::string *response)>;
+
+  // Creates a channel over |ring|, protecting records with the frame protector
+  // of the EKEP handshake |result|. |ring| must lie outside the enclave and
+  // outlive the channel.
+  static StatusOr<std::unique_ptr<RecordChannel>> Create(
+      RecordRing *ring, const tsi_handshaker_result *result);
+
+  // Creates a channel over |ring| which takes ownership of |protector|.
+  RecordChannel(RecordRing *ring, tsi_frame_protector *protector);
+
+  // Creates a channel reading records from |inbound| and writing them to
+  // |outbound|, which takes ownership of |protector|. Both buffers must lie
+  // outside the enclave and outlive the channel.
+  RecordChannel(RecordRingBuffer *inbound, RecordRingBuffer *outbound,
+                tsi_frame_protector *protector);
+  ~RecordChannel();
+
+  RecordChannel(const RecordChannel &) = delete;
+  RecordChannel &operator=(const RecordChannel &) = delete;
+
+  // Reads the next message into |message|, waiting for the host to supply
+  // enough records. Returns false if the host closed the ring between
+  // messages, or an error if a record fails to unprotect or the ring closes
+  // within a message.
+  StatusOr<bool> ReadMessage(std::string *message);
+
+  // Protects |message| and writes the records to the ring, waiting for room.
+  Status WriteMessage(ByteContainerView message);
+
+  // Answers each message read from the ring with |handler| until the host
+  // closes the ring, then closes the outbound ring. Returns the first error
+  // from the ring or from |handler|.
+  Status Serve(const Handler &handler);
+
+ private:
+  // Unprotects the next batch of records from the ring into |plaintext_|.
+  // Returns false if the ring is closed and drained.
+  StatusOr<bool> ReadRecords();
+
+  // Protects |size| bytes at |data|, writing any completed records to the
+  // ring.
+  Status Protect(const uint8_t *data, size_t size);
+
+  // Writes the records of any buffered plaintext to the ring.
+  Status Flush();
+
+  // Writes |size| bytes of records from |buffer_| to the ring.
+  Status WriteRecords(size_t size);
+
+  RecordRingBuffer *const inbound_;
+  RecordRingBuffer *const outbound_;
+  tsi_frame_protector *const protector_;
+
+  // Staging space for records copied from the ring and for records produced
+  // by |protector_|.
+  std::vector<uint8_t> buffer_;
+
+  // Output space for unprotected bytes.
+  std::vector<uint8_t> unprotected_;
+
+  // Unprotected bytes not yet returned as a message, starting at
+  // |plaintext_offset_|.
+  std::string plaintext_;
+  size_t plaintext_offset_;
+};
+
+}  // namespace asylo
+
+#endif  // ASYLO_GRPC_AUTH_CORE_RECORD_CHANNEL_H_
@@ -0,0 +1,228 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/grpc/auth/core/record_channel.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include "absl/memory/memory.h"
+#include "asylo/crypto/util/bytes.h"
+#include "asylo/crypto/util/trivial_object_util.h"
+#include "asylo/grpc/auth/core/chacha20_poly1305_frame_protector.h"
+
+namespace asylo {
+namespace {
+
+constexpr size_t kKeySize = 32;
+
+// Returns |message| with its 4-byte little-endian length prefix.
+std::string Frame(const std::string &message) {
+  std::string framed(4, '\0');
+  for (int i = 0; i < 4; ++i) {
+    framed[i] = static_cast<char>(message.size() >> (8 * i));
+  }
+  return framed + message;
+}
+
+// Protects |plaintext| with |protector| and returns the records.
+std::vector<uint8_t> Protect(tsi_frame_protector *protector,
+                             const std::string &plaintext) {
+  std::vector<uint8_t> records;
+  unsigned char buffer[1024];
+  const unsigned char *input =
+      reinterpret_cast<const unsigned char *>(plaintext.data());
+  size_t remaining = plaintext.size();
+  while (remaining > 0) {
+    size_t consumed = remaining;
+    size_t written = sizeof(buffer);
+    EXPECT_EQ(tsi_frame_protector_protect(protector, input, &consumed, buffer,
+                                          &written),
+              TSI_OK);
+    records.insert(records.end(), buffer, buffer + written);
+    input += consumed;
+    remaining -= consumed;
+  }
+  size_t still_pending = 0;
+  do {
+    size_t written = sizeof(buffer);
+    EXPECT_EQ(tsi_frame_protector_protect_flush(protector, buffer, &written,
+                                                &still_pending),
+              TSI_OK);
+    records.insert(records.end(), buffer, buffer + written);
+  } while (still_pending > 0);
+  return records;
+}
+
+// Tests the trusted end of a RecordRing, with the test acting as both the host
+// and the remote peer.
+class RecordChannelTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    auto key = TrivialRandomObject<SafeBytes<kKeySize>>();
+    tsi_frame_protector *server;
+    ASSERT_EQ(CreateChaCha20Poly1305FrameProtector(
+                  key, /*is_client=*/true, nullptr,
+                  /*idle_release_ms=*/0, &peer_),
+              TSI_OK);
+    ASSERT_EQ(CreateChaCha20Poly1305FrameProtector(
+                  key, /*is_client=*/false, nullptr,
+                  /*idle_release_ms=*/0, &server),
+              TSI_OK);
+    ring_ = absl::make_unique<RecordRing>();
+    channel_ = absl::make_unique<RecordChannel>(ring_.get(), server);
+  }
+
+  void TearDown() override { tsi_frame_protector_destroy(peer_); }
+
+  // Sends |records| from the peer, as the host does when they arrive.
+  void HostWrite(const std::vector<uint8_t> &records) {
+    ASSERT_EQ(ring_->inbound.Write(records.data(), records.size()),
+              records.size());
+  }
+
+  // Sends |message| from the peer.
+  void PeerSend(const std::string &message) {
+    HostWrite(Protect(peer_, Frame(message)));
+  }
+
+  // Receives the next message at the peer, or returns false if the outbound
+  // ring is closed first.
+  bool PeerReceive(std::string *message) {
+    unsigned char buffer[1024];
+    while (true) {
+      if (peer_plaintext_.size() >= 4) {
+        size_t length = 0;
+        for (int i = 0; i < 4; ++i) {
+          length |= static_cast<size_t>(
+                        static_cast<uint8_t>(peer_plaintext_[i]))
+                    << (8 * i);
+        }
+        if (peer_plaintext_.size() >= 4 + length) {
+          message->assign(peer_plaintext_, 4, length);
+          peer_plaintext_.erase(0, 4 + length);
+          return true;
+        }
+      }
+
+      size_t size = sizeof(buffer);
+      const uint8_t *records = ring_->outbound.PeekRead(&size);
+      if (size == 0) {
+        if (ring_->outbound.is_closed_for_write() && ring_->outbound.empty()) {
+          return false;
+        }
+        std::this_thread::yield();
+        continue;
+      }
+      memcpy(buffer, records, size);
+      ring_->outbound.ConsumeRead(size);
+      size_t offset = 0;
+      while (true) {
+        size_t consumed = size - offset;
+        unsigned char plaintext[1024];
+        size_t written = sizeof(plaintext);
+        EXPECT_EQ(tsi_frame_protector_unprotect(peer_, buffer + offset,
+                                                &consumed, plaintext, &written),
+                  TSI_OK);
+        peer_plaintext_.append(reinterpret_cast<char *>(plaintext), written);
+        offset += consumed;
+        if (consumed == 0 && written == 0) {
+          break;
+        }
+      }
+    }
+  }
+
+  tsi_frame_protector *peer_;
+  std::string peer_plaintext_;
+  std::unique_ptr<RecordRing> ring_;
+  std::unique_ptr<RecordChannel> channel_;
+};
+
+// Tests that messages of any size are answered by the handler, and that
+// serving stops when the host closes the ring.
+TEST_F(RecordChannelTest, ServesUntilRingCloses) {
+  Status serve_status;
+  std::thread server([this, &serve_status] {
+    serve_status = channel_->Serve(
+        [](ByteContainerView request, std::string *response) {
+          response->assign(request.rbegin(), request.rend());
+          return Status::OkStatus();
+        });
+  });
+
+  std::vector<std::string> messages = {"", "hello",
+                                       std::string(100 * 1024, 'x') + "y"};
+  for (const std::string &message : messages) {
+    PeerSend(message);
+    std::string response;
+    ASSERT_TRUE(PeerReceive(&response));
+    EXPECT_EQ(response, std::string(message.rbegin(), message.rend()));
+  }
+
+  ring_->inbound.close_for_write();
+  server.join();
+  EXPECT_TRUE(serve_status.ok()) << serve_status;
+  std::string response;
+  EXPECT_FALSE(PeerReceive(&response));
+}
+
+TEST_F(RecordChannelTest, ReadsPipelinedMessages) {
+  std::vector<uint8_t> records = Protect(peer_, Frame("one") + Frame("two"));
+  HostWrite(records);
+  ring_->inbound.close_for_write();
+
+  std::string message;
+  StatusOr<bool> result = channel_->ReadMessage(&message);
+  ASSERT_TRUE(result.ok() && result.ValueOrDie());
+  EXPECT_EQ(message, "one");
+  result = channel_->ReadMessage(&message);
+  ASSERT_TRUE(result.ok() && result.ValueOrDie());
+  EXPECT_EQ(message, "two");
+  result = channel_->ReadMessage(&message);
+  ASSERT_TRUE(result.ok());
+  EXPECT_FALSE(result.ValueOrDie());
+}
+
+TEST_F(RecordChannelTest, RejectsTamperedRecord) {
+  std::vector<uint8_t> records = Protect(peer_, Frame("secret"));
+  records.back() ^= 1;
+  HostWrite(records);
+
+  std::string message;
+  EXPECT_FALSE(channel_->ReadMessage(&message).ok());
+}
+
+TEST_F(RecordChannelTest, RejectsRingClosedWithinMessage) {
+  std::string framed = Frame("truncated");
+  framed.resize(framed.size() - 1);
+  HostWrite(Protect(peer_, framed));
+  ring_->inbound.close_for_write();
+
+  std::string message;
+  EXPECT_FALSE(channel_->ReadMessage(&message).ok());
+}
+
+}  // namespace
+}  // namespace asylo
@@ -19,16 +19,20 @@
 #include "asylo/grpc/auth/core/server_ekep_handshaker.h"
 
 #include <openssl/curve25519.h>
-#include <openssl/rand.h>
+#include <openssl/mem.h>
+
+#include <unordered_set>
 
-#include <google/protobuf/io/zero_copy_stream_impl_lite.h>
 #include "absl/memory/memory.h"
+#include "absl/time/time.h"
 #include "asylo/crypto/sha256_hash.h"
+#include "asylo/crypto/util/hardware_random.h"
 #include "asylo/util/logging.h"
 #include "asylo/grpc/auth/core/ekep_crypto.h"
 #include "asylo/grpc/auth/core/ekep_error_space.h"
 #include "asylo/grpc/auth/core/ekep_handshaker_util.h"
 #include "asylo/grpc/auth/core/handshake.pb.h"
+#include "asylo/identity/assertion_description_util.h"
 #include "asylo/identity/identity.pb.h"
 #include "asylo/util/cleansing_types.h"
 
@@ -41,6 +45,24 @@ bool CheckEkepVersionEquality(const EkepVersion &ekep_version,
   return ekep_version.name() == version_name;
 }
 
+// Returns true if |client_id| carries exactly one assertion for each of the
+// |expected_assertions|.
+bool ProvidesExpectedAssertions(
+    const ClientId &client_id,
+    const std::vector<AssertionDescription> &expected_assertions) {
+  std::unordered_multiset<AssertionDescription, AssertionDescriptionHasher,
+                          AssertionDescriptionEq>
+      remaining(expected_assertions.cbegin(), expected_assertions.cend());
+  for (const Assertion &assertion : client_id.assertions()) {
+    auto desc_it = remaining.find(assertion.description());
+    if (desc_it == remaining.end()) {
+      return false;
+    }
+    remaining.erase(desc_it);
+  }
+  return remaining.empty();
+}
+
 }  // namespace
 
 std::unique_ptr<EkepHandshaker> ServerEkepHandshaker::Create(
@@ -55,14 +77,23 @@ std::unique_ptr<EkepHandshaker> ServerEkepHandshaker::Create(
 
 ServerEkepHandshaker::ServerEkepHandshaker(const EkepHandshakerOptions &options)
     : EkepHandshaker(options.max_frame_size),
-      self_assertions_(options.self_assertions),
-      accepted_peer_assertions_(options.accepted_peer_assertions),
+      self_assertions_(options.self_assertions.cbegin(),
+                       options.self_assertions.cend()),
+      accepted_peer_assertions_(options.accepted_peer_assertions.cbegin(),
+                                options.accepted_peer_assertions.cend()),
       available_cipher_suites_({CURVE25519_SHA256}),
-      available_record_protocols_({SEAL_AES128_GCM}),
+      available_record_protocols_(SupportedRecordProtocols()),
       available_ekep_versions_({"EKEP v1"}),
       additional_authenticated_data_(options.additional_authenticated_data),
+      ticket_sealer_(options.ticket_sealer),
+      verified_assertion_cache_(options.verified_assertion_cache),
+      ephemeral_key_pool_(options.ephemeral_key_pool),
       selected_cipher_suite_(UNKNOWN_HANDSHAKE_CIPHER),
       selected_record_protocol_(UNKNOWN_RECORD_PROTOCOL),
+      resumed_session_(false),
+      awaiting_early_client_id_(false),
+      early_client_id_cipher_suite_(UNKNOWN_HANDSHAKE_CIPHER),
+      early_client_id_accepted_(false),
       expected_message_type_(CLIENT_PRECOMMIT),
       // The handshake is in progress for the server because it relies on the
       // client to act first.
@@ -107,8 +138,7 @@ void ServerEkepHandshaker::AbortHandshake(const Status &abort_status,
   abort.set_message(std::string(abort_status.error_message().data(),
                            abort_status.error_message().size()));
 
-  google::protobuf::io::StringOutputStream outgoing_frame(output);
-  Status status = EncodeFrame(ABORT, abort, &outgoing_frame);
+  Status status = EncodeFrame(ABORT, abort, output);
   if (!status.ok()) {
     // An error occurred while attempting to notify the peer of another error.
     // There is nothing left to do at this point.
@@ -125,12 +155,20 @@ ServerEkepHandshaker::Result ServerEkepHandshaker::HandleHandshakeMessage(
 
   switch (message_type) {
     case CLIENT_PRECOMMIT:
-      expected_message_type_ = CLIENT_ID;
       status = HandleClientPrecommit(handshake_message, output);
+      // An abbreviated handshake skips the ClientId message.
+      expected_message_type_ = resumed_session_ ? CLIENT_FINISH : CLIENT_ID;
       break;
     case CLIENT_ID:
-      expected_message_type_ = CLIENT_FINISH;
-      status = HandleClientId(handshake_message, output);
+      if (awaiting_early_client_id_) {
+        status = HandleEarlyClientId(handshake_message, output);
+        // If the server rejected the early ClientId, the client sends another.
+        expected_message_type_ =
+            early_client_id_accepted_ ? CLIENT_FINISH : CLIENT_ID;
+      } else {
+        expected_message_type_ = CLIENT_FINISH;
+        status = HandleClientId(handshake_message, output);
+      }
       break;
     case CLIENT_FINISH:
       expected_message_type_ = UNKNOWN_HANDSHAKE_MESSAGE;
@@ -235,8 +273,7 @@ Status ServerEkepHandshaker::HandleClientPrecommit(
     const AssertionDescription &offer_desc = offer.description();
     // Request any assertion that the peer offered and that this handshaker is
     // capable of verifying.
-    if (FindAssertionDescription(self_assertions_, offer_desc) !=
-        self_assertions_.cend()) {
+    if (self_assertions_.count(offer_desc) != 0) {
       auto result = GetEnclaveAssertionVerifier(offer_desc)->CanVerify(offer);
       if (result.ok() && result.ValueOrDie()) {
         expected_peer_assertions_.push_back(offer_desc);
@@ -254,8 +291,7 @@ Status ServerEkepHandshaker::HandleClientPrecommit(
     // capable of generating. Note that assertion generators were verified
     // during creation of the handshaker so there is no need to check whether
     // the call to GetEnclaveAssertionGenerator() returns nullptr.
-    if (FindAssertionDescription(accepted_peer_assertions_, request_desc) !=
-        accepted_peer_assertions_.cend()) {
+    if (accepted_peer_assertions_.count(request_desc) != 0) {
       auto result =
           GetEnclaveAssertionGenerator(request_desc)->CanGenerate(request);
       if (result.ok() && result.ValueOrDie()) {
@@ -268,7 +304,53 @@ Status ServerEkepHandshaker::HandleClientPrecommit(
                   "No acceptable client assertion requests");
   }
 
-  return WriteServerPrecommit(output);
+  if (client_precommit.early_client_id_cipher_suite() !=
+      UNKNOWN_HANDSHAKE_CIPHER) {
+    if (!client_precommit.resumption_ticket().empty()) {
+      return Status(Abort_ErrorCode_PROTOCOL_ERROR,
+                    "Client sent an early ClientId with a resumption ticket");
+    }
+
+    // The ServerPrecommit is deferred until the early ClientId arrives. At this
+    // stage in the protocol, the transcript is:
+    //   hash(ClientPrecommit)
+    //
+    // The client binds the assertions in its early ClientId to this transcript
+    // so the server must save a snapshot of the transcript at this time.
+    awaiting_early_client_id_ = true;
+    early_client_id_cipher_suite_ =
+        client_precommit.early_client_id_cipher_suite();
+    return GetTranscriptHash(&client_assertion_transcript_);
+  }
+
+  // A ticket that cannot be used is not an error. The server simply falls back
+  // to a full handshake.
+  if (ticket_sealer_ && !client_precommit.resumption_ticket().empty()) {
+    resumed_session_ = ResumeSession(client_precommit.resumption_ticket());
+  }
+
+  Status status = WriteServerPrecommit(output);
+  if (!status.ok() || !resumed_session_) {
+    return status;
+  }
+
+  // In an abbreviated handshake, the EKEP secrets are derived from the
+  // resumption secret and the transcript:
+  //   hash(ClientPrecommit || ServerPrecommit)
+  std::string transcript_hash;
+  status = GetTranscriptHash(&transcript_hash);
+  if (!status.ok()) {
+    return status;
+  }
+
+  status = DeriveResumedSecrets(selected_cipher_suite_, transcript_hash,
+                                resumption_secret_, &master_secret_,
+                                &authenticator_secret_);
+  if (!status.ok()) {
+    return status;
+  }
+
+  return WriteServerFinish(output);
 }
 
 Status ServerEkepHandshaker::HandleClientId(const google::protobuf::Message &message,
@@ -279,11 +361,48 @@ Status ServerEkepHandshaker::HandleClientId(const google::protobuf::Message &mes
                 << "message";
     return Status(Abort_ErrorCode_INTERNAL_ERROR, "Internal error");
   }
+  Status status = VerifyClientId(*client_id_ptr);
+  if (!status.ok()) {
+    return status;
+  }
+  return WriteServerId(output);
+}
+
+Status ServerEkepHandshaker::HandleEarlyClientId(
+    const google::protobuf::Message &message, std::string *output) {
+  const auto *client_id_ptr = dynamic_cast<const ClientId *>(&message);
+  if (!client_id_ptr) {
+    LOG(QFATAL) << "HandleEarlyClientId() was passed a non-ClientId handshake "
+                << "message";
+    return Status(Abort_ErrorCode_INTERNAL_ERROR, "Internal error");
+  }
   const ClientId &client_id = *client_id_ptr;
+  awaiting_early_client_id_ = false;
+
+  // A rejected early ClientId is not an error. The server simply falls back to
+  // a full handshake, and the early ClientId remains part of the transcript.
+  early_client_id_accepted_ =
+      early_client_id_cipher_suite_ == selected_cipher_suite_ &&
+      ProvidesExpectedAssertions(client_id, expected_peer_assertions_);
+  if (early_client_id_accepted_) {
+    Status status = VerifyClientId(client_id);
+    if (!status.ok()) {
+      return status;
+    }
+  }
 
+  Status status = WriteServerPrecommit(output);
+  if (!status.ok() || !early_client_id_accepted_) {
+    return status;
+  }
+  return WriteServerId(output);
+}
+
+Status ServerEkepHandshaker::VerifyClientId(const ClientId &client_id) {
   // The client's assertions should all be bound to a data blob containing a
-  // hash of the transcript up to and including the ServerPrecommit message, and
-  // the server's public key.
+  // hash of the transcript up to and including the ServerPrecommit message (or
+  // the ClientPrecommit message, for an early ClientId), and the client's
+  // public key.
   std::string ekep_context;
   if (!MakeEkepContextBlob(client_id.dh_public_key(),
                            client_assertion_transcript_, &ekep_context)) {
@@ -303,14 +422,22 @@ Status ServerEkepHandshaker::HandleClientId(const google::protobuf::Message &mes
     // Note that assertion verifiers were verified during creation of the
     // handshaker so there is no need to check whether the call to
     // GetEnclaveAssertionVerifier() returns nullptr.
-    Status status = GetEnclaveAssertionVerifier(assertion.description())
-                        ->Verify(ekep_context, assertion, &identity);
+    const EnclaveAssertionVerifier *verifier =
+        GetEnclaveAssertionVerifier(assertion.description());
+    Status status =
+        verified_assertion_cache_
+            ? verified_assertion_cache_->Verify(*verifier, ekep_context,
+                                                assertion, &identity,
+                                                message_arena())
+            : verifier->Verify(ekep_context, assertion, &identity,
+                               message_arena());
     if (!status.ok()) {
       LOG(ERROR) << "Assertion could not be verified: " << status;
       return Status(Abort_ErrorCode_BAD_ASSERTION,
                     "Assertion could not be verified");
     }
     AddPeerIdentity(identity);
+    verified_peer_assertions_.push_back(*desc_it);
     expected_peer_assertions_.erase(desc_it);
   }
 
@@ -323,8 +450,7 @@ Status ServerEkepHandshaker::HandleClientId(const google::protobuf::Message &mes
   std::copy(client_id.dh_public_key().cbegin(),
             client_id.dh_public_key().cend(),
             std::back_inserter(client_public_key_));
-
-  return WriteServerId(output);
+  return Status::OkStatus();
 }
 
 Status ServerEkepHandshaker::HandleClientFinish(
@@ -367,6 +493,12 @@ Status ServerEkepHandshaker::WriteServerPrecommit(std::string *output) {
       selected_ekep_version_);
   server_precommit.set_selected_cipher_suite(selected_cipher_suite_);
   server_precommit.set_selected_record_protocol(selected_record_protocol_);
+  if (resumed_session_) {
+    server_precommit.set_resumption_accepted(true);
+  }
+  if (early_client_id_accepted_) {
+    server_precommit.set_early_client_id_accepted(true);
+  }
 
   if (!additional_authenticated_data_.empty()) {
     server_precommit.mutable_options()->set_data(
@@ -374,7 +506,7 @@ Status ServerEkepHandshaker::WriteServerPrecommit(std::string *output) {
   }
 
   std::vector<uint8_t> challenge(kEkepChallengeSize);
-  if (RAND_bytes(challenge.data(), kEkepChallengeSize) != 1) {
+  if (!GetHardwareRandBytes(challenge.data(), kEkepChallengeSize)) {
     return Status(Abort_ErrorCode_INTERNAL_ERROR, "Internal error");
   }
   server_precommit.set_challenge(challenge.data(), challenge.size());
@@ -404,6 +536,8 @@ Status ServerEkepHandshaker::WriteServerPrecommit(std::string *output) {
 
   // At this stage in the protocol, the transcript is:
   //   hash(ClientPrecommit || ServerPrecommit)
+  // or, if the server rejected an early ClientId:
+  //   hash(ClientPrecommit || ClientId || ServerPrecommit)
   //
   // The client will bind its assertions to this transcript so the server must
   // save a snapshot of the transcript at this time.
@@ -415,9 +549,12 @@ Status ServerEkepHandshaker::WriteServerId(std::string *output) {
   // suite.
   switch (selected_cipher_suite_) {
     case CURVE25519_SHA256:
-      dh_public_key_.resize(X25519_PUBLIC_VALUE_LEN);
-      dh_private_key_.resize(X25519_PRIVATE_KEY_LEN);
-      X25519_keypair(dh_public_key_.data(), dh_private_key_.data());
+      if (!ephemeral_key_pool_ ||
+          !ephemeral_key_pool_->Take(&dh_public_key_, &dh_private_key_)) {
+        dh_public_key_.resize(X25519_PUBLIC_VALUE_LEN);
+        dh_private_key_.resize(X25519_PRIVATE_KEY_LEN);
+        X25519_keypair(dh_public_key_.data(), dh_private_key_.data());
+      }
       break;
     default:
       LOG(ERROR) << "Server handshaker has bad cipher suite configuration";
@@ -433,6 +570,8 @@ Status ServerEkepHandshaker::WriteServerId(std::string *output) {
 
   // At this stage in the protocol, the transcript is:
   //   hash(ClientPrecommit || ServerPrecommit || ClientId)
+  // or, if the server accepted an early ClientId:
+  //   hash(ClientPrecommit || ClientId || ServerPrecommit)
   //
   // The server binds its assertions to this transcript.
   std::string transcript_hash;
@@ -456,7 +595,8 @@ Status ServerEkepHandshaker::WriteServerId(std::string *output) {
     // handshaker so there is no need to check whether the call to
     // GetEnclaveAssertionGenerator() returns nullptr.
     status = GetEnclaveAssertionGenerator(request.description())
-                 ->Generate(ekep_context, request, server_id.add_assertions());
+                 ->Generate(ekep_context, request, server_id.add_assertions(),
+                            message_arena());
     if (!status.ok()) {
       LOG(ERROR) << "Assertion generation failed: " << status;
       return Status(Abort_ErrorCode_INTERNAL_ERROR,
@@ -469,17 +609,12 @@ Status ServerEkepHandshaker::WriteServerId(std::string *output) {
     return status;
   }
 
-  return WriteServerFinish(output);
-}
-
-Status ServerEkepHandshaker::WriteServerFinish(std::string *output) {
   // At this stage in the protocol, the transcript is:
   //   hash(ClientPrecommit || ServerPrecommit || ClientId || ServerId)
   //
   // This transcript is used by both the client and server to derive the EKEP
   // secrets.
-  std::string transcript_hash;
-  Status status = GetTranscriptHash(&transcript_hash);
+  status = GetTranscriptHash(&transcript_hash);
   if (!status.ok()) {
     return status;
   }
@@ -491,8 +626,12 @@ Status ServerEkepHandshaker::WriteServerFinish(std::string *output) {
     return status;
   }
 
+  return WriteServerFinish(output);
+}
+
+Status ServerEkepHandshaker::WriteServerFinish(std::string *output) {
   CleansingVector<uint8_t> authenticator;
-  status = ComputeServerHandshakeAuthenticator(
+  Status status = ComputeServerHandshakeAuthenticator(
       selected_cipher_suite_, authenticator_secret_, &authenticator);
   if (!status.ok()) {
     return status;
@@ -502,9 +641,90 @@ Status ServerEkepHandshaker::WriteServerFinish(std::string *output) {
   server_finish.set_handshake_authenticator(authenticator.data(),
                                             authenticator.size());
 
+  // Failure to issue a ticket only prevents the client from resuming this
+  // session later, so it does not abort the handshake.
+  if (ticket_sealer_) {
+    status = IssueResumptionTicket(&server_finish);
+    if (!status.ok()) {
+      LOG(WARNING) << "Failed to issue resumption ticket: " << status;
+      server_finish.clear_resumption_ticket();
+    }
+  }
+
   return WriteFrameAndUpdateTranscript(SERVER_FINISH, server_finish, output);
 }
 
+bool ServerEkepHandshaker::ResumeSession(const std::string &sealed_ticket) {
+  ResumptionTicket ticket;
+  Status status = ticket_sealer_->Open(sealed_ticket, &ticket);
+  if (!status.ok()) {
+    VLOG(1) << "Declining resumption ticket: " << status;
+    return false;
+  }
+
+  CleansingVector<uint8_t> resumption_secret(
+      ticket.resumption_secret().cbegin(), ticket.resumption_secret().cend());
+  OPENSSL_cleanse(&(*ticket.mutable_resumption_secret())[0],
+                  ticket.resumption_secret().size());
+  if (ticket.cipher_suite() != selected_cipher_suite_ ||
+      resumption_secret.size() != kEkepResumptionSecretSize) {
+    VLOG(1) << "Declining resumption ticket for a different cipher suite";
+    return false;
+  }
+
+  // The ticket must vouch for every assertion that the server would otherwise
+  // request from the client.
+  std::vector<AssertionDescription> ticket_assertions(
+      ticket.peer_assertions().cbegin(), ticket.peer_assertions().cend());
+  const AssertionDescriptionSet ticket_assertion_set(ticket_assertions.cbegin(),
+                                                     ticket_assertions.cend());
+  for (const AssertionDescription &description : expected_peer_assertions_) {
+    if (ticket_assertion_set.count(description) == 0) {
+      VLOG(1) << "Declining resumption ticket that lacks an expected assertion";
+      return false;
+    }
+  }
+
+  for (const EnclaveIdentity &identity :
+       ticket.peer_identities().identities()) {
+    AddPeerIdentity(identity);
+  }
+  verified_peer_assertions_ = std::move(ticket_assertions);
+  resumption_secret_ = std::move(resumption_secret);
+  return true;
+}
+
+Status ServerEkepHandshaker::IssueResumptionTicket(
+    ServerFinish *server_finish) {
+  CleansingVector<uint8_t> resumption_secret;
+  Status status = DeriveResumptionSecret(selected_cipher_suite_,
+                                         master_secret_, &resumption_secret);
+  if (!status.ok()) {
+    return status;
+  }
+
+  ResumptionTicket ticket;
+  ticket.set_cipher_suite(selected_cipher_suite_);
+  ticket.set_resumption_secret(resumption_secret.data(),
+                               resumption_secret.size());
+  for (const AssertionDescription &description : verified_peer_assertions_) {
+    *ticket.add_peer_assertions() = description;
+  }
+  *ticket.mutable_peer_identities() = PeerIdentities();
+
+  status = ticket_sealer_->Seal(ticket,
+                                server_finish->mutable_resumption_ticket());
+  OPENSSL_cleanse(&(*ticket.mutable_resumption_secret())[0],
+                  ticket.resumption_secret().size());
+  if (!status.ok()) {
+    return status;
+  }
+
+  server_finish->set_resumption_ticket_lifetime(
+      absl::ToInt64Seconds(ticket_sealer_->ticket_lifetime()));
+  return Status::OkStatus();
+}
+
 bool ServerEkepHandshaker::SetSelectedEkepVersion(
     const google::protobuf::RepeatedPtrField<EkepVersion> &ekep_versions) {
   // Choose the first compatible EKEP version available.
@@ -28,6 +28,9 @@
 #include <google/protobuf/message.h>
 #include "asylo/grpc/auth/core/ekep_handshaker.h"
 #include "asylo/grpc/auth/core/ekep_handshaker_util.h"
+#include "asylo/grpc/auth/core/ekep_resumption.h"
+#include "asylo/grpc/auth/core/ephemeral_key_pool.h"
+#include "asylo/identity/verified_assertion_cache.h"
 #include "asylo/util/cleansing_types.h"
 
 namespace asylo {
@@ -36,6 +39,20 @@ namespace asylo {
 // handshake. It handles ClientPrecommit, ClientId, and ClientFinish messages
 // from the client and sends ServerPrecommit, ServerId, and ServerFinish
 // messages to the client.
+//
+// If configured with a ResumptionTicketSealer, the server issues a resumption
+// ticket in every ServerFinish message. When a client presents a valid ticket
+// in its ClientPrecommit, the server performs an abbreviated handshake: it
+// responds with ServerPrecommit and ServerFinish, and expects a ClientFinish.
+// No ClientId or ServerId messages are exchanged, so neither peer generates or
+// verifies any assertions.
+//
+// A client may send an early ClientId right after its ClientPrecommit. The
+// server then defers its ServerPrecommit until the early ClientId arrives. If
+// the early ClientId was made for the selected cipher suite and carries exactly
+// the assertions that the server requests, the server accepts it and sends the
+// ServerPrecommit, ServerId, and ServerFinish messages together. Otherwise, it
+// sends the ServerPrecommit alone and expects another ClientId.
 class ServerEkepHandshaker final : public EkepHandshaker {
  public:
   // Creates a ServerEkepHandshaker configured with the given |options|, if
@@ -78,6 +95,9 @@ class ServerEkepHandshaker final : public EkepHandshaker {
   // Validates the ClientPrecommit handshake message contained in |message|. If
   // validation succeeds, writes the ServerPrecommit message to |output| and
   // updates the handshake transcript with the outgoing ServerPrecommit frame.
+  // If the server accepts the client's resumption ticket, also writes the
+  // ServerFinish message to |output|. If the client announced an early
+  // ClientId, writes nothing and waits for the early ClientId instead.
   Status HandleClientPrecommit(const google::protobuf::Message &message, std::string *output);
 
   // Validates the ClientId handshake message contained in |message|. If
@@ -85,6 +105,18 @@ class ServerEkepHandshaker final : public EkepHandshaker {
   // |output| and updates the handshake transcript with both outgoing frames.
   Status HandleClientId(const google::protobuf::Message &message, std::string *output);
 
+  // Decides whether to accept the early ClientId handshake message contained in
+  // |message|, and writes the ServerPrecommit message to |output|. If the
+  // server accepts the early ClientId and validation succeeds, also writes the
+  // ServerId and ServerFinish messages to |output|.
+  Status HandleEarlyClientId(const google::protobuf::Message &message,
+                             std::string *output);
+
+  // Verifies the assertions in |client_id| against the expected peer
+  // assertions, adds the resulting peer identities, and saves the client's
+  // public key.
+  Status VerifyClientId(const ClientId &client_id);
+
   // Validates the ClientFinish handshake message contained in |message|.
   Status HandleClientFinish(const google::protobuf::Message &message);
 
@@ -92,13 +124,25 @@ class ServerEkepHandshaker final : public EkepHandshaker {
   // transcript.
   Status WriteServerPrecommit(std::string *output);
 
-  // Writes the ServerId frame to |output| and updates the handshake transcript.
+  // Writes the ServerId frame to |output|, updates the handshake transcript,
+  // and derives the EKEP secrets.
   Status WriteServerId(std::string *output);
 
   // Writes the ServerFinish frame to |output| and updates the handshake
-  // transcript.
+  // transcript. The EKEP secrets must have been derived.
   Status WriteServerFinish(std::string *output);
 
+  // Attempts to resume the session bound to |sealed_ticket|. The ticket is
+  // accepted if it was issued by |ticket_sealer_|, has not expired, uses the
+  // selected cipher suite, and vouches for every assertion that the server
+  // expects from the client. On success, adds the peer identities from the
+  // ticket, saves the ticket's resumption secret, and returns true.
+  bool ResumeSession(const std::string &sealed_ticket);
+
+  // Seals a resumption ticket for the current session and adds it to
+  // |server_finish|. The EKEP secrets must have been derived.
+  Status IssueResumptionTicket(ServerFinish *server_finish);
+
   // Sets the handshaker's selected EKEP version to first compatible EKEP
   // version in |ekep_versions|. Returns false if there is no compatible EKEP
   // version in |ekep_versions|.
@@ -116,11 +160,13 @@ class ServerEkepHandshaker final : public EkepHandshaker {
   bool SetSelectedRecordProtocol(
       const google::protobuf::RepeatedField<int> &record_protocols);
 
-  // A list of assertions offered by the server.
-  const std::vector<AssertionDescription> self_assertions_;
+  // The assertions offered by the server. A set, as client offers are looked up
+  // in it.
+  const AssertionDescriptionSet self_assertions_;
 
-  // A list of peer assertions accepted by the server.
-  const std::vector<AssertionDescription> accepted_peer_assertions_;
+  // The peer assertions accepted by the server. A set, as client requests are
+  // looked up in it.
+  const AssertionDescriptionSet accepted_peer_assertions_;
 
   // A list of supported cipher_suites.
   const std::vector<HandshakeCipher> available_cipher_suites_;
@@ -135,6 +181,18 @@ class ServerEkepHandshaker final : public EkepHandshaker {
   // Additional data that is authenticated during the handshake.
   const std::string additional_authenticated_data_;
 
+  // Sealer for resumption tickets, or nullptr if session resumption is
+  // disabled.
+  const std::shared_ptr<ResumptionTicketSealer> ticket_sealer_;
+
+  // Cache of identities extracted from verified peer assertions, or nullptr if
+  // every peer assertion is verified in full.
+  const std::shared_ptr<VerifiedAssertionCache> verified_assertion_cache_;
+
+  // Pool of precomputed ephemeral key pairs, or nullptr if key pairs are
+  // generated during the handshake.
+  const std::shared_ptr<EphemeralKeyPool> ephemeral_key_pool_;
+
   // Assertions requested by the client that the server is willing to offer.
   // This field is populated after validation of the ClientPrecommit message.
   std::vector<AssertionRequest> promised_assertions_;
@@ -168,8 +226,31 @@ class ServerEkepHandshaker final : public EkepHandshaker {
   CleansingVector<uint8_t> master_secret_;
   CleansingVector<uint8_t> authenticator_secret_;
 
+  // Descriptions of the client assertions backing the peer identities, either
+  // verified in this handshake or vouched for by a resumption ticket.
+  std::vector<AssertionDescription> verified_peer_assertions_;
+
+  // Whether the handshake resumes a previous session. This field is populated
+  // after validation of the ClientPrecommit message.
+  bool resumed_session_;
+
+  // The resumption secret from the client's resumption ticket, if accepted.
+  CleansingVector<uint8_t> resumption_secret_;
+
+  // Whether the client announced an early ClientId that has not arrived yet.
+  bool awaiting_early_client_id_;
+
+  // The cipher suite for which the client made its early ClientId.
+  HandshakeCipher early_client_id_cipher_suite_;
+
+  // Whether the server accepted the client's early ClientId. This field is
+  // populated after validation of the early ClientId message.
+  bool early_client_id_accepted_;
+
   // A snapshot of the transcript to which the client's assertions are bound:
   //   hash(ClientPrecommit || ServerPrecommit)
+  // or, for an early ClientId:
+  //   hash(ClientPrecommit)
   std::string client_assertion_transcript_;
 
   // Type of the next message expected by this handshaker.
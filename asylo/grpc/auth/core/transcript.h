@@ -53,6 +53,10 @@ class Transcript {
   // Adds the entire contents of |input| to the transcript hash.
   void Add(google::protobuf::io::ZeroCopyInputStream *input);
 
+  // Adds |len| bytes from |data| to the transcript hash. Once a hash function
+  // is set, the bytes are hashed in place without being copied.
+  void Add(const void *data, size_t len);
+
   // Sets |hasher| as the hash function to use for hashing the transcript.
   // Returns false if a hash function has already been set. Takes ownership of
   // |hasher|.
@@ -64,9 +68,6 @@ class Transcript {
   bool Hash(std::string *digest);
 
  private:
-  // Adds |len| bytes from |data| to the transcript hash.
-  void Add(const void *data, size_t len);
-
   // An internal buffer of bytes to hash. Once |hasher_| is set, all bytes from
   // this buffer are added to the hashing object and the buffer is cleared.
   std::string bytes_to_hash_;
@@ -21,6 +21,7 @@
 #include <google/protobuf/io/coded_stream.h>
 #include "absl/strings/str_cat.h"
 #include "asylo/grpc/auth/core/enclave_grpc_security_constants.h"
+#include "asylo/identity/sgx/code_identity_util.h"
 #include "asylo/util/status.h"
 #include "src/core/lib/security/context/security_context.h"
 
@@ -79,7 +80,25 @@ StatusOr<EnclaveAuthContext> EnclaveAuthContext::CreateFromAuthContext(
 
 EnclaveAuthContext::EnclaveAuthContext(EnclaveIdentities identities,
                                        RecordProtocol record_protocol)
-    : identities_(std::move(identities)), record_protocol_(record_protocol) {}
+    : identities_(std::move(identities)), record_protocol_(record_protocol) {
+  for (int i = 0; i < identities_.identities_size(); ++i) {
+    const EnclaveIdentityDescription &description =
+        identities_.identities(i).description();
+    identity_index_[description.identity_type()].emplace_back(
+        description.authority_type(), i);
+  }
+
+  EnclaveIdentityDescription sgx_description;
+  sgx::SetSgxIdentityDescription(&sgx_description);
+  StatusOr<const EnclaveIdentity *> sgx_identity_result =
+      FindEnclaveIdentity(sgx_description);
+  if (sgx_identity_result.ok()) {
+    sgx_code_identity_status_ = sgx::ParseSgxIdentity(
+        *sgx_identity_result.ValueOrDie(), &sgx_code_identity_);
+  } else {
+    sgx_code_identity_status_ = sgx_identity_result.status();
+  }
+}
 
 RecordProtocol EnclaveAuthContext::GetRecordProtocol() const {
   return record_protocol_;
@@ -92,18 +111,24 @@ bool EnclaveAuthContext::HasEnclaveIdentity(
 
 StatusOr<const EnclaveIdentity *> EnclaveAuthContext::FindEnclaveIdentity(
     const EnclaveIdentityDescription &description) const {
-  auto it = std::find_if(
-      identities_.identities().cbegin(), identities_.identities().cend(),
-      [&description](const EnclaveIdentity &identity) -> bool {
-        return identity.description().identity_type() ==
-                   description.identity_type() &&
-               identity.description().authority_type() ==
-                   description.authority_type();
-      });
-  if (it == identities_.identities().cend()) {
-    return Status(error::GoogleError::NOT_FOUND, "No matching identity");
+  auto index_it = identity_index_.find(description.identity_type());
+  if (index_it != identity_index_.end()) {
+    for (const auto &entry : index_it->second) {
+      if (entry.first == description.authority_type()) {
+        return &identities_.identities(entry.second);
+      }
+    }
+  }
+  return Status(error::GoogleError::NOT_FOUND,
+                Status::StaticMessage("No matching identity"));
+}
+
+StatusOr<const sgx::CodeIdentity *> EnclaveAuthContext::GetSgxCodeIdentity()
+    const {
+  if (!sgx_code_identity_status_.ok()) {
+    return sgx_code_identity_status_;
   }
-  return &*it;
+  return &sgx_code_identity_;
 }
 
 }  // namespace asylo
@@ -20,9 +20,14 @@
 #define ASYLO_GRPC_AUTH_ENCLAVE_AUTH_CONTEXT_H_
 
 #include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
 #include "asylo/grpc/auth/core/handshake.pb.h"
 #include "asylo/identity/identity.pb.h"
+#include "asylo/identity/sgx/code_identity.pb.h"
+#include "asylo/util/status.h"
 #include "asylo/util/statusor.h"
 #include "include/grpcpp/server_context.h"
 
@@ -31,7 +36,10 @@ namespace asylo {
 /// Encapsulates the authentication properties of an EKEP-based gRPC connection.
 ///
 /// The authentication properties in an EnclaveAuthContext object include the
-/// secure transport protocol and the peer's enclave identities.
+/// secure transport protocol and the peer's enclave identities. The identities
+/// are indexed by description, and the peer's SGX code identity is parsed, when
+/// the EnclaveAuthContext is created, so that per-call authorization checks do
+/// neither.
 class EnclaveAuthContext {
  public:
   /// Constructs an EnclaveAuthContext using the authentication properties from
@@ -72,6 +80,15 @@ class EnclaveAuthContext {
   StatusOr<const EnclaveIdentity *> FindEnclaveIdentity(
       const EnclaveIdentityDescription &description) const;
 
+  /// Returns the peer's SGX code identity, as parsed when this
+  /// EnclaveAuthContext was created.
+  ///
+  /// \return A pointer to the SGX code identity on success, a StatusOr with a
+  ///         `GoogleError::NOT_FOUND` Status if the peer has no SGX code
+  ///         identity, and the parsing error if the peer's SGX code identity is
+  ///         malformed.
+  StatusOr<const sgx::CodeIdentity *> GetSgxCodeIdentity() const;
+
  private:
   // Creates an EnclaveAuthContext for the given peer's |identities| and the
   // session |record_protocol|.
@@ -83,6 +100,17 @@ class EnclaveAuthContext {
 
   // Secure transport record protocol.
   const RecordProtocol record_protocol_;
+
+  // For each identity type, the authority types and positions in |identities_|
+  // of the identities of that type, in the order in which they appear. An
+  // index, rather than pointers, keeps EnclaveAuthContext copyable.
+  std::unordered_map<int, std::vector<std::pair<std::string, int>>>
+      identity_index_;
+
+  // The peer's SGX code identity, which is valid only if
+  // |sgx_code_identity_status_| is OK.
+  sgx::CodeIdentity sgx_code_identity_;
+  Status sgx_code_identity_status_;
 };
 
 }  // namespace asylo
@@ -25,6 +25,9 @@
 #include "absl/memory/memory.h"
 #include "asylo/grpc/auth/core/enclave_grpc_security_constants.h"
 #include "asylo/grpc/auth/core/handshake.pb.h"
+#include "asylo/identity/sgx/code_identity.pb.h"
+#include "asylo/identity/sgx/code_identity_test_util.h"
+#include "asylo/identity/sgx/code_identity_util.h"
 #include "asylo/test/util/proto_matchers.h"
 #include "asylo/test/util/status_matchers.h"
 #include "src/core/lib/security/context/security_context.h"
@@ -33,6 +36,8 @@
 namespace asylo {
 namespace {
 
+using ::testing::Not;
+
 constexpr char kIdentity[] = "Identity";
 constexpr char kAuthorityType1[] = "Good Authority";
 constexpr char kAuthorityType2[] = "Bad Authority";
@@ -234,5 +239,73 @@ TEST_F(EnclaveAuthContextTest, GetRecordProtocol) {
   EXPECT_EQ(auth_context.GetRecordProtocol(), RecordProtocol::SEAL_AES128_GCM);
 }
 
+// Verify that FindEnclaveIdentity() retrieves the first identity with the
+// requested description when the peer holds several identities of the same
+// type.
+TEST_F(EnclaveAuthContextTest, FindEnclaveIdentityAmongSeveral) {
+  EnclaveIdentities identities;
+  EnclaveIdentity *other_identity = identities.add_identities();
+  other_identity->set_identity("Other");
+  other_identity->mutable_description()->set_identity_type(
+      EnclaveIdentityType::CODE_IDENTITY);
+  other_identity->mutable_description()->set_authority_type(kAuthorityType2);
+  *identities.add_identities() = identities_.identities(0);
+  EnclaveIdentity *duplicate_identity = identities.add_identities();
+  *duplicate_identity = identities_.identities(0);
+  duplicate_identity->set_identity("Duplicate");
+
+  AddEnclaveIdentitiesProperty(identities, secure_auth_context_.get());
+  StatusOr<EnclaveAuthContext> auth_context_result =
+      EnclaveAuthContext::CreateFromAuthContext(*secure_auth_context_);
+  ASSERT_THAT(auth_context_result, IsOk());
+  EnclaveAuthContext auth_context = auth_context_result.ValueOrDie();
+
+  StatusOr<const EnclaveIdentity *> identity_result =
+      auth_context.FindEnclaveIdentity(good_identity_description_);
+  ASSERT_THAT(identity_result, IsOk());
+  EXPECT_EQ(identity_result.ValueOrDie()->identity(), kIdentity);
+  EXPECT_FALSE(auth_context.HasEnclaveIdentity(bad_identity_description_));
+}
+
+// Verify that GetSgxCodeIdentity() returns the parsed SGX code identity of the
+// peer.
+TEST_F(EnclaveAuthContextTest, GetSgxCodeIdentitySuccess) {
+  EnclaveIdentities identities = identities_;
+  sgx::CodeIdentity expected_identity;
+  sgx::SetRandomValidGenericIdentity(identities.add_identities(),
+                                     &expected_identity);
+
+  AddEnclaveIdentitiesProperty(identities, secure_auth_context_.get());
+  StatusOr<EnclaveAuthContext> auth_context_result =
+      EnclaveAuthContext::CreateFromAuthContext(*secure_auth_context_);
+  ASSERT_THAT(auth_context_result, IsOk());
+  EnclaveAuthContext auth_context = auth_context_result.ValueOrDie();
+
+  StatusOr<const sgx::CodeIdentity *> sgx_identity_result =
+      auth_context.GetSgxCodeIdentity();
+  ASSERT_THAT(sgx_identity_result, IsOk());
+  EXPECT_THAT(*sgx_identity_result.ValueOrDie(),
+              EqualsProto(expected_identity));
+}
+
+// Verify that GetSgxCodeIdentity() returns NOT_FOUND if the peer has no SGX
+// code identity, and an error if the SGX code identity is malformed.
+TEST_F(EnclaveAuthContextTest, GetSgxCodeIdentityFailure) {
+  StatusOr<EnclaveAuthContext> auth_context_result =
+      EnclaveAuthContext::CreateFromAuthContext(*secure_auth_context_);
+  ASSERT_THAT(auth_context_result, IsOk());
+  EXPECT_THAT(auth_context_result.ValueOrDie().GetSgxCodeIdentity().status(),
+              StatusIs(error::GoogleError::NOT_FOUND));
+
+  EnclaveIdentities identities;
+  sgx::SetRandomInvalidGenericIdentity(identities.add_identities());
+  AddEnclaveIdentitiesProperty(identities, secure_auth_context_.get());
+  auth_context_result =
+      EnclaveAuthContext::CreateFromAuthContext(*secure_auth_context_);
+  ASSERT_THAT(auth_context_result, IsOk());
+  EXPECT_THAT(auth_context_result.ValueOrDie().GetSgxCodeIdentity(),
+              Not(IsOk()));
+}
+
 }  // namespace
 }  // namespace asylo
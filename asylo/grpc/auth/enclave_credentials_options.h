@@ -19,6 +19,7 @@
 #ifndef ASYLO_GRPC_AUTH_ENCLAVE_CREDENTIALS_OPTIONS_H_
 #define ASYLO_GRPC_AUTH_ENCLAVE_CREDENTIALS_OPTIONS_H_
 
+#include <cstddef>
 #include <string>
 #include <vector>
 
@@ -26,6 +27,36 @@
 
 namespace asylo {
 
+/// Socket and HTTP/2 tunables of the connections beneath an enclave gRPC
+/// channel or server. The defaults leave every setting to the host or to gRPC.
+/// Clients and servers of a deployment should use the same options, so that,
+/// for instance, each side accepts the other's keepalive pings.
+struct EnclaveTransportOptions {
+  /// Size in bytes of each connection's socket send buffer (`SO_SNDBUF`), or
+  /// zero to keep the host's default.
+  int socket_send_buffer_size = 0;
+
+  /// Size in bytes of each connection's socket receive buffer (`SO_RCVBUF`),
+  /// or zero to keep the host's default.
+  int socket_receive_buffer_size = 0;
+
+  /// Whether `TCP_NODELAY` is set on connections, as gRPC does by default.
+  bool tcp_nodelay = true;
+
+  /// Initial HTTP/2 flow-control window of each stream in bytes, or zero for
+  /// gRPC's adaptive window. A fixed window disables gRPC's bandwidth-delay
+  /// probing.
+  int http2_initial_window_size = 0;
+
+  /// Interval in milliseconds between keepalive pings, or zero for gRPC's
+  /// default. A server accepts pings from clients at this interval.
+  int keepalive_time_ms = 0;
+
+  /// Time in milliseconds to wait for a keepalive ping to be acknowledged, or
+  /// zero for gRPC's default.
+  int keepalive_timeout_ms = 0;
+};
+
 /// Options used to configure a `::grpc::ChannelCredentials` object or a
 /// `::grpc::ServerCredentials` object for use in an enclave system.
 struct EnclaveCredentialsOptions {
@@ -38,6 +69,50 @@ struct EnclaveCredentialsOptions {
 
   /// Peer assertions accepted by the credential holder.
   std::vector<AssertionDescription> accepted_peer_assertions;
+
+  /// Size of the frames produced by the record protocol once the channel is
+  /// established, up to 1 MiB. Larger frames amortize per-frame header, tag,
+  /// and cipher-call overhead over more payload, which benefits bulk-transfer
+  /// RPCs. Zero selects the record protocol's default of 16 KiB. Peers accept
+  /// frames of any size up to 1 MiB, so the two ends need not agree.
+  size_t max_protected_frame_size = 0;
+
+  /// Time in milliseconds after which an idle connection releases the buffers
+  /// its record protocol holds for sealing and opening frames, or zero to keep
+  /// them for the life of the connection. Buffers are allocated again when the
+  /// connection is next used, so enclaves holding many mostly idle connections
+  /// keep little memory for them. Applies to the ChaCha20-Poly1305 record
+  /// protocol; AES-GCM connections protect frames in place and hold no buffers.
+  int idle_buffer_release_ms = 0;
+
+  /// Number of ephemeral Diffie-Hellman key pairs that are generated ahead of
+  /// time, up to 1024. A background thread keeps the pool full, and each key
+  /// pair is used for a single handshake, so handshake latency does not include
+  /// key generation. Handshakes that find the pool empty generate their own key
+  /// pair. Zero disables the pool.
+  size_t ephemeral_key_pool_size = 0;
+
+  /// Number of handshakes a server runs at once, or zero for no limit. When
+  /// many clients reconnect together, a limit lets the admitted handshakes
+  /// finish within the clients' deadlines instead of slowing all of them, and
+  /// leaves enclave threads and memory to established connections. Channel
+  /// credentials ignore this setting.
+  size_t max_concurrent_handshakes = 0;
+
+  /// Number of handshakes that wait for a slot once `max_concurrent_handshakes`
+  /// are running. Handshakes that arrive while the queue is full fail at once,
+  /// so their clients can back off and retry.
+  size_t max_pending_handshakes = 0;
+
+  /// Time in milliseconds that a handshake waits for a slot before it fails,
+  /// or zero to wait indefinitely.
+  int pending_handshake_timeout_ms = 0;
+
+  /// Socket and HTTP/2 tunables. Channel credentials apply them to every
+  /// channel they create. gRPC server credentials cannot change the settings of
+  /// their server, so servers must also pass them to
+  /// `ApplyEnclaveTransportOptions()` when building the server.
+  EnclaveTransportOptions transport_options;
 };
 
 }  // namespace asylo
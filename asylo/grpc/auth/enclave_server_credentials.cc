@@ -18,11 +18,57 @@
 
 #include "asylo/grpc/auth/enclave_server_credentials.h"
 
+#include <memory>
+#include <vector>
+
+#include "asylo/grpc/auth/core/enclave_transport_options.h"
 #include "asylo/grpc/auth/enclave_credentials_options.h"
 #include "asylo/grpc/auth/util/bridge_cpp_to_c.h"
+#include "include/grpcpp/impl/server_builder_option.h"
+#include "src/core/lib/channel/channel_args.h"
 #include "src/cpp/server/secure_server_credentials.h"
 
 namespace asylo {
+namespace {
+
+// Adds the channel arguments of a set of transport options to a server.
+class TransportOptionsBuilderOption : public ::grpc::ServerBuilderOption {
+ public:
+  explicit TransportOptionsBuilderOption(const EnclaveTransportOptions &options)
+      : options_(options) {}
+
+  void UpdateArguments(::grpc::ChannelArguments *args) override {
+    grpc_enclave_transport_options c_opts;
+    grpc_enclave_transport_options_init(&c_opts);
+    CopyEnclaveTransportOptions(options_, &c_opts);
+    grpc_channel_args *transport_args =
+        grpc_enclave_transport_options_add_to_args(&c_opts, nullptr);
+    for (size_t i = 0; i < transport_args->num_args; ++i) {
+      const grpc_arg &arg = transport_args->args[i];
+      switch (arg.type) {
+        case GRPC_ARG_INTEGER:
+          args->SetInt(arg.key, arg.value.integer);
+          break;
+        case GRPC_ARG_STRING:
+          args->SetString(arg.key, arg.value.string);
+          break;
+        case GRPC_ARG_POINTER:
+          args->SetPointerWithVtable(arg.key, arg.value.pointer.p,
+                                     arg.value.pointer.vtable);
+          break;
+      }
+    }
+    grpc_channel_args_destroy(transport_args);
+  }
+
+  void UpdatePlugins(std::vector<std::unique_ptr<::grpc::ServerBuilderPlugin>>
+                         *plugins) override {}
+
+ private:
+  const EnclaveTransportOptions options_;
+};
+
+}  // namespace
 
 std::shared_ptr<::grpc::ServerCredentials> EnclaveServerCredentials(
     const EnclaveCredentialsOptions &options) {
@@ -39,4 +85,10 @@ std::shared_ptr<::grpc::ServerCredentials> EnclaveServerCredentials(
   return creds;
 }
 
+void ApplyEnclaveTransportOptions(const EnclaveTransportOptions &options,
+                                  ::grpc::ServerBuilder *builder) {
+  builder->SetOption(std::unique_ptr<::grpc::ServerBuilderOption>(
+      new TransportOptionsBuilderOption(options)));
+}
+
 }  // namespace asylo
@@ -23,6 +23,7 @@
 
 #include "asylo/grpc/auth/enclave_credentials_options.h"
 #include "include/grpcpp/security/server_credentials.h"
+#include "include/grpcpp/server_builder.h"
 
 namespace asylo {
 
@@ -42,6 +43,18 @@ namespace asylo {
 std::shared_ptr<::grpc::ServerCredentials> EnclaveServerCredentials(
     const EnclaveCredentialsOptions &options);
 
+/// Applies the socket and HTTP/2 tunables `options` to the server built by
+/// `builder`.
+///
+/// Server credentials cannot change the settings of the server they are added
+/// to, so servers using `EnclaveServerCredentials()` apply the
+/// `transport_options` of their `EnclaveCredentialsOptions` with this function.
+///
+/// \param options The transport options to apply.
+/// \param builder The builder of the server.
+void ApplyEnclaveTransportOptions(const EnclaveTransportOptions &options,
+                                  ::grpc::ServerBuilder *builder);
+
 }  // namespace asylo
 
 #endif  // ASYLO_GRPC_AUTH_ENCLAVE_SERVER_CREDENTIALS_H_
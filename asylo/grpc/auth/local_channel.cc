@@ -0,0 +1,325 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/grpc/auth/local_channel.h"
+
+#include <cstdint>
+#include <cstring>
+
+#include "absl/memory/memory.h"
+#include "absl/strings/str_cat.h"
+#include "asylo/grpc/auth/core/enclave_credentials_options.h"
+#include "asylo/grpc/auth/core/enclave_transport_security.h"
+#include "asylo/grpc/auth/util/bridge_cpp_to_c.h"
+#include "src/core/tsi/transport_security_interface.h"
+
+#ifdef __ASYLO__
+#include "asylo/platform/arch/include/trusted/enclave_interface.h"
+#include "asylo/platform/arch/include/trusted/host_calls.h"
+#endif  // __ASYLO__
+
+namespace asylo {
+namespace {
+
+// Size of the length prefix of handshake messages.
+constexpr size_t kLengthSize = 4;
+
+// Largest handshake message accepted from the peer.
+constexpr size_t kMaxHandshakeMessageSize = 64 * 1024;
+
+// Most handshake steps taken by either end before giving up.
+constexpr int kMaxHandshakeSteps = 16;
+
+// Owns a tsi_handshaker.
+struct TsiHandshakerDeleter {
+  void operator()(tsi_handshaker *handshaker) const {
+    tsi_handshaker_destroy(handshaker);
+  }
+};
+using TsiHandshakerPtr = std::unique_ptr<tsi_handshaker, TsiHandshakerDeleter>;
+
+// Owns a tsi_handshaker_result.
+struct TsiHandshakerResultDeleter {
+  void operator()(tsi_handshaker_result *result) const {
+    tsi_handshaker_result_destroy(result);
+  }
+};
+using TsiHandshakerResultPtr =
+    std::unique_ptr<tsi_handshaker_result, TsiHandshakerResultDeleter>;
+
+Status TsiStatus(const std::string &operation, tsi_result result) {
+  return Status(error::GoogleError::INTERNAL,
+                absl::StrCat(operation, " failed: ",
+                             tsi_result_to_string(result)));
+}
+
+// Writes the handshake message of |size| bytes at |data| to |outbound| with a
+// 4-byte little-endian length prefix.
+Status WriteHandshakeMessage(RecordRingBuffer *outbound,
+                             const unsigned char *data, size_t size) {
+  uint8_t prefix[kLengthSize] = {
+      static_cast<uint8_t>(size), static_cast<uint8_t>(size >> 8),
+      static_cast<uint8_t>(size >> 16), static_cast<uint8_t>(size >> 24)};
+  if (outbound->Write(prefix, sizeof(prefix)) != sizeof(prefix) ||
+      outbound->Write(data, size) != size) {
+    return Status(error::GoogleError::UNAVAILABLE,
+                  "Peer closed the channel during the handshake");
+  }
+  return Status::OkStatus();
+}
+
+// Reads the next length-prefixed handshake message from |inbound| into
+// |message|. The message is copied out of the ring before it is used.
+Status ReadHandshakeMessage(RecordRingBuffer *inbound, std::string *message) {
+  uint8_t prefix[kLengthSize];
+  if (inbound->Read(prefix, sizeof(prefix)) != sizeof(prefix)) {
+    return Status(error::GoogleError::UNAVAILABLE,
+                  "Peer closed the channel during the handshake");
+  }
+  size_t size = static_cast<size_t>(prefix[0]) |
+                static_cast<size_t>(prefix[1]) << 8 |
+                static_cast<size_t>(prefix[2]) << 16 |
+                static_cast<size_t>(prefix[3]) << 24;
+  if (size > kMaxHandshakeMessageSize) {
+    return Status(error::GoogleError::RESOURCE_EXHAUSTED,
+                  absl::StrCat("Handshake message of ", size,
+                               " bytes exceeds the limit of ",
+                               kMaxHandshakeMessageSize));
+  }
+  message->resize(size);
+  if (inbound->Read(reinterpret_cast<uint8_t *>(&(*message)[0]), size) !=
+      size) {
+    return Status(error::GoogleError::UNAVAILABLE,
+                  "Peer closed the channel during the handshake");
+  }
+  return Status::OkStatus();
+}
+
+// Runs |handshaker| to completion over |inbound| and |outbound|, placing its
+// result in |result|. The client speaks first.
+Status RunHandshake(tsi_handshaker *handshaker, bool is_client,
+                    RecordRingBuffer *inbound, RecordRingBuffer *outbound,
+                    TsiHandshakerResultPtr *result) {
+  std::string received;
+  bool receive = !is_client;
+  for (int step = 0; step < kMaxHandshakeSteps; ++step) {
+    if (receive) {
+      Status status = ReadHandshakeMessage(inbound, &received);
+      if (!status.ok()) {
+        return status;
+      }
+    }
+    receive = true;
+
+    // The step runs synchronously because no callback is passed.
+    const unsigned char *bytes_to_send = nullptr;
+    size_t bytes_to_send_size = 0;
+    tsi_handshaker_result *handshaker_result = nullptr;
+    tsi_result tsi_status = tsi_handshaker_next(
+        handshaker, reinterpret_cast<const unsigned char *>(received.data()),
+        received.size(), &bytes_to_send, &bytes_to_send_size,
+        &handshaker_result, /*cb=*/nullptr, /*user_data=*/nullptr);
+    if (tsi_status != TSI_OK) {
+      return TsiStatus("Handshake step", tsi_status);
+    }
+    result->reset(handshaker_result);
+    if (bytes_to_send_size > 0) {
+      Status status =
+          WriteHandshakeMessage(outbound, bytes_to_send, bytes_to_send_size);
+      if (!status.ok()) {
+        return status;
+      }
+    }
+    if (*result) {
+      return Status::OkStatus();
+    }
+  }
+  return Status(error::GoogleError::INTERNAL, "Handshake did not complete");
+}
+
+// Extracts the peer's identities from the handshake |result|.
+Status ExtractPeerIdentities(const tsi_handshaker_result *result,
+                             EnclaveIdentities *identities) {
+  tsi_peer peer;
+  tsi_result tsi_status = tsi_handshaker_result_extract_peer(result, &peer);
+  if (tsi_status != TSI_OK) {
+    return TsiStatus("Peer extraction", tsi_status);
+  }
+  Status status(error::GoogleError::INTERNAL, "Missing peer identities");
+  for (size_t i = 0; i < peer.property_count; ++i) {
+    const tsi_peer_property &property = peer.properties[i];
+    if (strcmp(property.name, TSI_ENCLAVE_IDENTITIES_PROTO_PEER_PROPERTY) ==
+        0) {
+      status = identities->ParseFromArray(property.value.data,
+                                          property.value.length)
+                   ? Status::OkStatus()
+                   : Status(error::GoogleError::INTERNAL,
+                            "Ill-formed peer identities");
+      break;
+    }
+  }
+  tsi_peer_destruct(&peer);
+  return status;
+}
+
+}  // namespace
+
+StatusOr<std::unique_ptr<LocalChannel>> LocalChannel::CreateEnd(
+    LocalChannelRing *ring, bool is_client,
+    const EnclaveCredentialsOptions &options,
+    const std::string &resource_name) {
+  RecordRingBuffer *inbound =
+      is_client ? &ring->server_to_client : &ring->client_to_server;
+  RecordRingBuffer *outbound =
+      is_client ? &ring->client_to_server : &ring->server_to_client;
+
+  grpc_enclave_credentials_options c_options;
+  grpc_enclave_credentials_options_init(&c_options);
+  CopyEnclaveCredentialsOptions(options, &c_options);
+  tsi_handshaker *raw_handshaker = nullptr;
+  tsi_result tsi_status = tsi_enclave_handshaker_create(
+      is_client, &c_options.self_assertions,
+      &c_options.accepted_peer_assertions,
+      &c_options.additional_authenticated_data,
+      c_options.max_protected_frame_size, c_options.idle_buffer_release_ms,
+      /*ephemeral_key_pool=*/nullptr,
+      /*client_precommit_cache=*/nullptr, /*handshake_admission=*/nullptr,
+      &raw_handshaker);
+  grpc_enclave_credentials_options_destroy(&c_options);
+  if (tsi_status != TSI_OK) {
+    return TsiStatus("Handshaker creation", tsi_status);
+  }
+  TsiHandshakerPtr handshaker(raw_handshaker);
+
+  TsiHandshakerResultPtr result;
+  Status status =
+      RunHandshake(handshaker.get(), is_client, inbound, outbound, &result);
+  if (!status.ok()) {
+    // Let the peer's handshake fail rather than wait.
+    outbound->close_for_write();
+    return status;
+  }
+
+  EnclaveIdentities peer_identities;
+  status = ExtractPeerIdentities(result.get(), &peer_identities);
+  if (!status.ok()) {
+    outbound->close_for_write();
+    return status;
+  }
+
+  tsi_frame_protector *protector = nullptr;
+  tsi_status = tsi_handshaker_result_create_frame_protector(
+      result.get(), /*max_output_protected_frame_size=*/nullptr, &protector);
+  if (tsi_status != TSI_OK) {
+    outbound->close_for_write();
+    return TsiStatus("Frame protector creation", tsi_status);
+  }
+  return absl::WrapUnique(new LocalChannel(
+      resource_name, inbound, outbound,
+      absl::make_unique<RecordChannel>(inbound, outbound, protector),
+      std::move(peer_identities)));
+}
+
+StatusOr<std::unique_ptr<LocalChannel>> LocalChannel::Connect(
+    const std::string &name, bool is_client,
+    const EnclaveCredentialsOptions &options) {
+#ifdef __ASYLO__
+  SharedName shared_name = LocalChannelRingName(name);
+  void *address = enc_untrusted_acquire_shared_resource(
+      shared_name.kind(), shared_name.name().c_str());
+  if (!address) {
+    return Status(error::GoogleError::NOT_FOUND,
+                  absl::StrCat("No local channel ring named ", name));
+  }
+  LocalChannelRing *ring = static_cast<LocalChannelRing *>(address);
+  Status status;
+  if (!enc_is_outside_enclave(address, sizeof(LocalChannelRing))) {
+    status = Status(error::GoogleError::INVALID_ARGUMENT,
+                    "Local channel ring is not in untrusted memory");
+  } else if (ring->client_to_server.InstanceVersion() !=
+                 RecordRingBuffer::TypeVersion() ||
+             ring->server_to_client.InstanceVersion() !=
+                 RecordRingBuffer::TypeVersion()) {
+    status = Status(error::GoogleError::FAILED_PRECONDITION,
+                    "Local channel ring has an unexpected layout");
+  }
+  if (!status.ok()) {
+    enc_untrusted_release_shared_resource(shared_name.kind(),
+                                          shared_name.name().c_str());
+    return status;
+  }
+
+  StatusOr<std::unique_ptr<LocalChannel>> result =
+      CreateEnd(ring, is_client, options, shared_name.name());
+  if (!result.ok()) {
+    enc_untrusted_release_shared_resource(shared_name.kind(),
+                                          shared_name.name().c_str());
+  }
+  return result;
+#else
+  return Status(error::GoogleError::UNIMPLEMENTED,
+                "Local channels can only be connected by name inside an "
+                "enclave");
+#endif  // __ASYLO__
+}
+
+StatusOr<std::unique_ptr<LocalChannel>> LocalChannel::Create(
+    LocalChannelRing *ring, bool is_client,
+    const EnclaveCredentialsOptions &options) {
+  return CreateEnd(ring, is_client, options, /*resource_name=*/"");
+}
+
+LocalChannel::LocalChannel(std::string resource_name,
+                           RecordRingBuffer *inbound,
+                           RecordRingBuffer *outbound,
+                           std::unique_ptr<RecordChannel> record_channel,
+                           EnclaveIdentities peer_identities)
+    : resource_name_(std::move(resource_name)),
+      inbound_(inbound),
+      outbound_(outbound),
+      record_channel_(std::move(record_channel)),
+      peer_identities_(std::move(peer_identities)) {}
+
+LocalChannel::~LocalChannel() {
+  Close();
+#ifdef __ASYLO__
+  if (!resource_name_.empty()) {
+    enc_untrusted_release_shared_resource(kAddressName,
+                                          resource_name_.c_str());
+  }
+#endif  // __ASYLO__
+}
+
+StatusOr<bool> LocalChannel::ReadMessage(std::string *message) {
+  return record_channel_->ReadMessage(message);
+}
+
+Status LocalChannel::WriteMessage(ByteContainerView message) {
+  return record_channel_->WriteMessage(message);
+}
+
+Status LocalChannel::Serve(const RecordChannel::Handler &handler) {
+  return record_channel_->Serve(handler);
+}
+
+void LocalChannel::Close() {
+  outbound_->close_for_write();
+  inbound_->close_for_read();
+}
+
+}  // namespace asylo
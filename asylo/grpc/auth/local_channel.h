@@ -0,0 +1,139 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_GRPC_AUTH_LOCAL_CHANNEL_H_
+#define ASYLO_GRPC_AUTH_LOCAL_CHANNEL_H_
+
+#include <memory>
+#include <string>
+
+#include "asylo/crypto/util/byte_container_view.h"
+#include "asylo/grpc/auth/core/record_channel.h"
+#include "asylo/grpc/auth/enclave_credentials_options.h"
+#include "asylo/grpc/auth/local_channel_ring.h"
+#include "asylo/identity/identity.pb.h"
+#include "asylo/util/status.h"
+#include "asylo/util/statusor.h"
+
+namespace asylo {
+
+/// A message channel between two enclaves in the same process over a
+/// LocalChannelRing in shared memory.
+///
+/// Both enclaves authenticate each other with an EKEP handshake over the ring
+/// when the channel is created, and every message is then protected with the
+/// handshake's record protocol. Unlike a gRPC channel between the enclaves, no
+/// message passes through a socket, so exchanging one makes no host calls.
+/// Each end waits for data by polling the ring, which suits enclaves that
+/// exchange messages frequently.
+///
+/// One enclave creates the client end and the other the server end. Messages
+/// are read and written in order, and a LocalChannel is used by one thread at
+/// a time.
+///
+/// Sample usage, with the host having called
+/// `RegisterLocalChannelRing("kv", manager->shared_resources())`:
+///
+/// ```
+/// auto channel_result = LocalChannel::Connect(
+///     "kv", /*is_client=*/true, BidirectionalSgxLocalCredentialsOptions());
+/// ```
+class LocalChannel {
+ public:
+  /// Connects to the LocalChannelRing that the host registered under `name`.
+  /// Only available inside an enclave.
+  ///
+  /// \param name The name of the ring.
+  /// \param is_client Whether this is the client end of the channel.
+  /// \param options The assertions to present and accept in the handshake.
+  /// \return The channel once the handshake completes, or an error if the ring
+  ///         cannot be found or the handshake fails.
+  static StatusOr<std::unique_ptr<LocalChannel>> Connect(
+      const std::string &name, bool is_client,
+      const EnclaveCredentialsOptions &options);
+
+  /// Creates an end of a channel over `ring`, which must outlive it.
+  ///
+  /// \param ring The shared memory of the channel.
+  /// \param is_client Whether this is the client end of the channel.
+  /// \param options The assertions to present and accept in the handshake.
+  /// \return The channel once the handshake completes, or an error if the
+  ///         handshake fails.
+  static StatusOr<std::unique_ptr<LocalChannel>> Create(
+      LocalChannelRing *ring, bool is_client,
+      const EnclaveCredentialsOptions &options);
+
+  LocalChannel(const LocalChannel &) = delete;
+  LocalChannel &operator=(const LocalChannel &) = delete;
+
+  /// Closes this end of the channel.
+  ~LocalChannel();
+
+  /// Reads the next message from the peer.
+  ///
+  /// \param[out] message The message.
+  /// \return False if the peer closed the channel between messages, or an
+  ///         error if a message fails authentication.
+  StatusOr<bool> ReadMessage(std::string *message);
+
+  /// Sends `message` to the peer.
+  ///
+  /// \param message The message.
+  /// \return An error if the peer has closed the channel.
+  Status WriteMessage(ByteContainerView message);
+
+  /// Answers each message from the peer with `handler` until the peer closes
+  /// the channel, then closes this end.
+  ///
+  /// \param handler The handler of each message.
+  /// \return The first error of the channel or of `handler`.
+  Status Serve(const RecordChannel::Handler &handler);
+
+  /// Closes this end of the channel. The peer reads the messages already sent,
+  /// then sees the channel closed, and its further writes fail.
+  void Close();
+
+  /// Returns the identities that the peer proved in the handshake.
+  const EnclaveIdentities &peer_identities() const { return peer_identities_; }
+
+ private:
+  // Creates an end of a channel over |ring| as Create() does. The end holds a
+  // reference to the shared resource |resource_name| if it is not empty.
+  static StatusOr<std::unique_ptr<LocalChannel>> CreateEnd(
+      LocalChannelRing *ring, bool is_client,
+      const EnclaveCredentialsOptions &options,
+      const std::string &resource_name);
+
+  // Creates an end of a channel which exchanges messages through
+  // |record_channel| over |inbound| and |outbound|. If |resource_name| is not
+  // empty, the end holds a reference to the shared resource of that name.
+  LocalChannel(std::string resource_name, RecordRingBuffer *inbound,
+               RecordRingBuffer *outbound,
+               std::unique_ptr<RecordChannel> record_channel,
+               EnclaveIdentities peer_identities);
+
+  const std::string resource_name_;
+  RecordRingBuffer *const inbound_;
+  RecordRingBuffer *const outbound_;
+  const std::unique_ptr<RecordChannel> record_channel_;
+  const EnclaveIdentities peer_identities_;
+};
+
+}  // namespace asylo
+
+#endif  // ASYLO_GRPC_AUTH_LOCAL_CHANNEL_H_
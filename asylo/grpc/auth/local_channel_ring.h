@@ -0,0 +1,77 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_GRPC_AUTH_LOCAL_CHANNEL_RING_H_
+#define ASYLO_GRPC_AUTH_LOCAL_CHANNEL_RING_H_
+
+#include <memory>
+#include <string>
+
+#include "absl/memory/memory.h"
+#include "absl/strings/str_cat.h"
+#include "asylo/grpc/auth/core/record_channel.h"
+#include "asylo/platform/core/shared_name.h"
+#include "asylo/platform/core/shared_resource_manager.h"
+#include "asylo/util/status.h"
+
+namespace asylo {
+
+/// Prefix of the shared resource names of LocalChannelRings.
+constexpr char kLocalChannelResourcePrefix[] = "asylo_local_channel:";
+
+/// Untrusted shared memory connecting two enclaves in the same process, over
+/// which they run a LocalChannel. Neither direction passes through the host or
+/// the kernel once the enclaves are connected.
+struct LocalChannelRing {
+  RecordRingBuffer client_to_server;
+  RecordRingBuffer server_to_client;
+};
+
+/// Returns the shared resource name of the LocalChannelRing named `name`.
+inline SharedName LocalChannelRingName(const std::string &name) {
+  return SharedName::Address(absl::StrCat(kLocalChannelResourcePrefix, name));
+}
+
+/// Allocates a LocalChannelRing and registers it with `resources` under
+/// `name`, so that two enclaves can connect to it with LocalChannel::Connect().
+///
+/// The ring is reference counted. Each connected enclave holds a reference
+/// until its LocalChannel is destroyed, and the host holds the reference taken
+/// here until it releases it with
+/// `resources->ReleaseResource(LocalChannelRingName(name))`, which it may do
+/// once both enclaves are connected.
+///
+/// \param name The name by which the enclaves find the ring.
+/// \param resources The shared resources of the EnclaveManager that loads both
+///                  enclaves.
+/// \return An error if a ring is already registered under `name`.
+inline Status RegisterLocalChannelRing(const std::string &name,
+                                       SharedResourceManager *resources) {
+  auto ring = absl::make_unique<LocalChannelRing>();
+  Status status = resources->RegisterManagedResource(
+      LocalChannelRingName(name), ring.get());
+  if (status.ok()) {
+    // The SharedResourceManager owns the ring once it is registered.
+    ring.release();
+  }
+  return status;
+}
+
+}  // namespace asylo
+
+#endif  // ASYLO_GRPC_AUTH_LOCAL_CHANNEL_RING_H_
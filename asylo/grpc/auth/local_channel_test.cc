@@ -0,0 +1,120 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/grpc/auth/local_channel.h"
+
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include "absl/memory/memory.h"
+#include "asylo/grpc/auth/null_credentials_options.h"
+#include "asylo/identity/enclave_assertion_authority_config.pb.h"
+#include "asylo/identity/init.h"
+#include "asylo/test/util/status_matchers.h"
+
+namespace asylo {
+namespace {
+
+class LocalChannelTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    std::vector<EnclaveAssertionAuthorityConfig> configs;
+    ASSERT_THAT(
+        InitializeEnclaveAssertionAuthorities(configs.begin(), configs.end()),
+        IsOk());
+    ring_ = absl::make_unique<LocalChannelRing>();
+  }
+
+  // Creates both ends of a channel over |ring_|, running the server's
+  // handshake on another thread.
+  void Connect(std::unique_ptr<LocalChannel> *client,
+               std::unique_ptr<LocalChannel> *server) {
+    StatusOr<std::unique_ptr<LocalChannel>> server_result;
+    std::thread server_thread([this, &server_result] {
+      server_result = LocalChannel::Create(
+          ring_.get(), /*is_client=*/false,
+          BidirectionalNullCredentialsOptions());
+    });
+    StatusOr<std::unique_ptr<LocalChannel>> client_result =
+        LocalChannel::Create(ring_.get(), /*is_client=*/true,
+                             BidirectionalNullCredentialsOptions());
+    server_thread.join();
+    ASSERT_THAT(client_result, IsOk());
+    ASSERT_THAT(server_result, IsOk());
+    *client = std::move(client_result.ValueOrDie());
+    *server = std::move(server_result.ValueOrDie());
+  }
+
+  std::unique_ptr<LocalChannelRing> ring_;
+};
+
+TEST_F(LocalChannelTest, ExchangesMessagesUntilClientCloses) {
+  std::unique_ptr<LocalChannel> client;
+  std::unique_ptr<LocalChannel> server;
+  ASSERT_NO_FATAL_FAILURE(Connect(&client, &server));
+  EXPECT_EQ(client->peer_identities().identities_size(), 1);
+  EXPECT_EQ(server->peer_identities().identities_size(), 1);
+
+  Status serve_status;
+  std::thread server_thread([&server, &serve_status] {
+    serve_status = server->Serve(
+        [](ByteContainerView request, std::string *response) {
+          response->assign(request.rbegin(), request.rend());
+          return Status::OkStatus();
+        });
+  });
+
+  for (const std::string &message :
+       {std::string("ping"), std::string(), std::string(64 * 1024, 'x')}) {
+    ASSERT_THAT(client->WriteMessage(message), IsOk());
+    std::string response;
+    StatusOr<bool> read_result = client->ReadMessage(&response);
+    ASSERT_THAT(read_result, IsOk());
+    ASSERT_TRUE(read_result.ValueOrDie());
+    EXPECT_EQ(response, std::string(message.rbegin(), message.rend()));
+  }
+
+  client->Close();
+  server_thread.join();
+  EXPECT_THAT(serve_status, IsOk());
+  std::string response;
+  StatusOr<bool> read_result = client->ReadMessage(&response);
+  ASSERT_THAT(read_result, IsOk());
+  EXPECT_FALSE(read_result.ValueOrDie());
+}
+
+TEST_F(LocalChannelTest, HandshakeFailsIfPeerCloses) {
+  ring_->client_to_server.close_for_write();
+  EXPECT_THAT(LocalChannel::Create(ring_.get(), /*is_client=*/false,
+                                   BidirectionalNullCredentialsOptions())
+                  .status(),
+              StatusIs(error::GoogleError::UNAVAILABLE));
+}
+
+TEST_F(LocalChannelTest, ConnectByNameRequiresAnEnclave) {
+  EXPECT_THAT(LocalChannel::Connect("ring", /*is_client=*/true,
+                                    BidirectionalNullCredentialsOptions())
+                  .status(),
+              StatusIs(error::GoogleError::UNIMPLEMENTED));
+}
+
+}  // namespace
+}  // namespace asylo
@@ -0,0 +1,673 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/grpc/auth/test/handshake_benchmark.h"
+
+#include <time.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_join.h"
+#include "absl/time/time.h"
+#include "asylo/crypto/util/bytes.h"
+#include "asylo/crypto/util/trivial_object_util.h"
+#include "asylo/grpc/auth/core/client_ekep_handshaker.h"
+#include "asylo/grpc/auth/core/ekep_handshaker.h"
+#include "asylo/grpc/auth/core/ekep_handshaker_util.h"
+#include "asylo/grpc/auth/core/ekep_negotiation_cache.h"
+#include "asylo/grpc/auth/core/ekep_resumption.h"
+#include "asylo/grpc/auth/core/enclave_credentials_options.h"
+#include "asylo/grpc/auth/core/enclave_transport_security.h"
+#include "asylo/grpc/auth/core/ephemeral_key_pool.h"
+#include "asylo/grpc/auth/core/handshake.pb.h"
+#include "asylo/grpc/auth/core/server_ekep_handshaker.h"
+#include "asylo/grpc/auth/enclave_channel_credentials.h"
+#include "asylo/grpc/auth/enclave_credentials_options.h"
+#include "asylo/grpc/auth/enclave_server_credentials.h"
+#include "asylo/grpc/auth/null_credentials_options.h"
+#include "asylo/grpc/auth/sgx_local_credentials_options.h"
+#include "asylo/grpc/auth/util/bridge_cpp_to_c.h"
+#include "asylo/identity/verified_assertion_cache.h"
+#include "asylo/util/status_macros.h"
+#include "include/grpcpp/channel.h"
+#include "include/grpcpp/completion_queue.h"
+#include "include/grpcpp/create_channel.h"
+#include "include/grpcpp/server.h"
+#include "include/grpcpp/server_builder.h"
+#include "include/grpcpp/support/channel_arguments.h"
+#include "src/core/tsi/transport_security_interface.h"
+
+namespace asylo {
+namespace {
+
+constexpr int64_t kNanosecondsPerSecond = 1000000000;
+
+// Key under which the client caches the benchmark server's sessions and
+// negotiated parameters.
+constexpr char kSessionCacheKey[] = "handshake_benchmark";
+
+// Channel argument that is unique to each channel. It keeps gRPC from sharing
+// one connection among the benchmark's channels.
+constexpr char kChannelIdArg[] = "asylo.handshake_benchmark.channel_id";
+
+// Capacity and lifetime of the identities in verified assertion caches.
+constexpr size_t kVerifiedAssertionCacheCapacity = 16;
+constexpr absl::Duration kVerifiedAssertionCacheTtl = absl::Minutes(10);
+
+// Upper bound on the number of steps of an in-memory handshake. EKEP takes at
+// most five; the bound keeps a misbehaving handshaker from looping forever.
+constexpr int kMaxHandshakeSteps = 16;
+
+// Size of the buffer that receives the output of a frame protector call.
+constexpr size_t kProtectorBufferSize = 1 << 16;
+
+int64_t MonotonicNanoseconds() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return static_cast<int64_t>(ts.tv_sec) * kNanosecondsPerSecond + ts.tv_nsec;
+}
+
+// Returns the value at |fraction| of the sorted |values|, using the
+// nearest-rank method, or zero if |values| is empty.
+int64_t Percentile(const std::vector<int64_t> &values, double fraction) {
+  if (values.empty()) {
+    return 0;
+  }
+  size_t rank = static_cast<size_t>(fraction * values.size());
+  return values[std::min(rank, values.size() - 1)];
+}
+
+// Records the handshake counts and rate, and the latencies from
+// |latencies_ns|, in |output|. Sorts |latencies_ns|.
+void SummarizeHandshakes(int64_t failed_handshakes, int64_t elapsed_ns,
+                         std::vector<int64_t> *latencies_ns,
+                         HandshakeBenchmarkOutput *output) {
+  std::sort(latencies_ns->begin(), latencies_ns->end());
+  output->set_handshakes(latencies_ns->size());
+  output->set_failed_handshakes(failed_handshakes);
+  output->set_elapsed_ns(elapsed_ns);
+  output->set_handshakes_per_second(
+      elapsed_ns > 0 ? static_cast<double>(latencies_ns->size()) *
+                           kNanosecondsPerSecond / elapsed_ns
+                     : 0.0);
+  output->set_p50_latency_ns(Percentile(*latencies_ns, 0.5));
+  output->set_p99_latency_ns(Percentile(*latencies_ns, 0.99));
+}
+
+StatusOr<EnclaveCredentialsOptions> GetCredentialsOptions(
+    const HandshakeBenchmarkInput &input) {
+  EnclaveCredentialsOptions options;
+  switch (input.assertion()) {
+    case HandshakeBenchmarkInput::NULL_ASSERTION:
+      options = BidirectionalNullCredentialsOptions();
+      break;
+    case HandshakeBenchmarkInput::SGX_LOCAL:
+      options = BidirectionalSgxLocalCredentialsOptions();
+      break;
+    default:
+      return Status(error::GoogleError::INVALID_ARGUMENT,
+                    "Unknown assertion type");
+  }
+  options.max_protected_frame_size = input.max_protected_frame_size();
+  options.ephemeral_key_pool_size = input.ephemeral_key_pool_size();
+  return options;
+}
+
+// --- CHANNEL ---
+
+// A channel whose connection is being measured.
+struct PendingChannel {
+  std::shared_ptr<::grpc::Channel> channel;
+  int64_t start_ns;
+  std::chrono::system_clock::time_point deadline;
+};
+
+// Creates a channel to |address| that does not share its connection with the
+// channels created for other values of |id|.
+std::shared_ptr<::grpc::Channel> CreateBenchmarkChannel(
+    const std::string &address,
+    const std::shared_ptr<::grpc::ChannelCredentials> &credentials, int id) {
+  ::grpc::ChannelArguments args;
+  args.SetInt(kChannelIdArg, id);
+  return ::grpc::CreateCustomChannel(address, credentials, args);
+}
+
+Status BenchmarkChannels(const HandshakeBenchmarkInput &input,
+                         HandshakeBenchmarkOutput *output) {
+  EnclaveCredentialsOptions options;
+  ASYLO_ASSIGN_OR_RETURN(options, GetCredentialsOptions(input));
+  std::chrono::nanoseconds timeout(input.timeout_ns());
+
+  int port = 0;
+  ::grpc::ServerBuilder builder;
+  builder.AddListeningPort("localhost:0", EnclaveServerCredentials(options),
+                           &port);
+  std::unique_ptr<::grpc::Server> server = builder.BuildAndStart();
+  if (!server || port == 0) {
+    return Status(error::GoogleError::INTERNAL,
+                  "Failed to start the benchmark server");
+  }
+  std::string address = absl::StrCat("localhost:", port);
+  std::shared_ptr<::grpc::ChannelCredentials> credentials =
+      EnclaveChannelCredentials(options);
+
+  // Warm-up channels connect one at a time. All channels stay open until the
+  // end of the run, so the server holds as many connections as it accepted.
+  std::vector<std::shared_ptr<::grpc::Channel>> warmup_channels;
+  for (int i = 0; i < input.warmup_handshakes(); ++i) {
+    warmup_channels.push_back(CreateBenchmarkChannel(address, credentials, i));
+    if (!warmup_channels.back()->WaitForConnected(
+            std::chrono::system_clock::now() + timeout)) {
+      return Status(error::GoogleError::INTERNAL,
+                    "Warm-up channel failed to connect");
+    }
+  }
+
+  // Channels are opened on schedule, and their state changes are collected on
+  // |cq|. The tag of each state change is the index of its channel.
+  ::grpc::CompletionQueue cq;
+  std::vector<PendingChannel> channels(input.handshakes());
+  int64_t interval_ns =
+      input.handshakes_per_second() > 0
+          ? static_cast<int64_t>(kNanosecondsPerSecond /
+                                 input.handshakes_per_second())
+          : 0;
+  std::vector<int64_t> latencies_ns;
+  int64_t failed_handshakes = 0;
+  size_t opened = 0;
+  size_t finished = 0;
+  int64_t start_ns = MonotonicNanoseconds();
+  int64_t end_ns = start_ns;
+  while (finished < channels.size()) {
+    int64_t now_ns = MonotonicNanoseconds();
+    int64_t next_open_ns = start_ns + opened * interval_ns;
+    bool open_next = opened < channels.size() &&
+                     (interval_ns > 0 ? now_ns >= next_open_ns
+                                      : opened == finished);
+    if (open_next) {
+      PendingChannel &pending = channels[opened];
+      pending.channel = CreateBenchmarkChannel(
+          address, credentials, input.warmup_handshakes() + opened);
+      pending.start_ns = now_ns;
+      pending.deadline = std::chrono::system_clock::now() + timeout;
+      pending.channel->NotifyOnStateChange(
+          pending.channel->GetState(/*try_to_connect=*/true), pending.deadline,
+          &cq, reinterpret_cast<void *>(opened));
+      ++opened;
+      continue;
+    }
+
+    // Wait for a state change, but no longer than until the next channel is
+    // due to be opened.
+    std::chrono::system_clock::time_point wait_deadline =
+        std::chrono::system_clock::now() + timeout;
+    if (opened < channels.size() && interval_ns > 0) {
+      wait_deadline = std::chrono::system_clock::now() +
+                      std::chrono::nanoseconds(next_open_ns - now_ns);
+    }
+    void *tag = nullptr;
+    bool ok = false;
+    ::grpc::CompletionQueue::NextStatus next_status =
+        cq.AsyncNext(&tag, &ok, wait_deadline);
+    if (next_status == ::grpc::CompletionQueue::TIMEOUT) {
+      continue;
+    }
+    if (next_status == ::grpc::CompletionQueue::SHUTDOWN) {
+      return Status(error::GoogleError::INTERNAL,
+                    "Completion queue shut down unexpectedly");
+    }
+
+    now_ns = MonotonicNanoseconds();
+    PendingChannel &pending = channels[reinterpret_cast<uintptr_t>(tag)];
+    grpc_connectivity_state state =
+        pending.channel->GetState(/*try_to_connect=*/false);
+    if (state == GRPC_CHANNEL_READY) {
+      latencies_ns.push_back(now_ns - pending.start_ns);
+    } else if (!ok || state == GRPC_CHANNEL_TRANSIENT_FAILURE ||
+               state == GRPC_CHANNEL_SHUTDOWN) {
+      // The deadline expired, or the connection or handshake failed.
+      ++failed_handshakes;
+    } else {
+      pending.channel->NotifyOnStateChange(state, pending.deadline, &cq, tag);
+      continue;
+    }
+    ++finished;
+    end_ns = now_ns;
+  }
+
+  SummarizeHandshakes(failed_handshakes, end_ns - start_ns, &latencies_ns,
+                      output);
+
+  channels.clear();
+  warmup_channels.clear();
+  server->Shutdown();
+  cq.Shutdown();
+  void *tag;
+  bool ok;
+  while (cq.Next(&tag, &ok)) {
+  }
+  return Status::OkStatus();
+}
+
+// --- EKEP_STEPS ---
+
+// Durations of one kind of handshake step.
+struct StepSamples {
+  std::string step;
+  std::vector<int64_t> durations_ns;
+};
+
+// Returns the names of the message types of the EKEP frames in |bytes|, joined
+// with "+", or "-" if |bytes| holds no frame.
+std::string FrameTypes(const std::string &bytes) {
+  std::vector<std::string> names;
+  size_t offset = 0;
+  while (bytes.size() - offset >= kEkepFrameHeaderSize) {
+    // Both header fields are little-endian, as is every platform that Asylo
+    // supports.
+    uint32_t frame_size;
+    uint32_t message_type;
+    memcpy(&frame_size, bytes.data() + offset, sizeof(frame_size));
+    memcpy(&message_type, bytes.data() + offset + sizeof(frame_size),
+           sizeof(message_type));
+    names.push_back(HandshakeMessageType_IsValid(message_type)
+                        ? HandshakeMessageType_Name(
+                              static_cast<HandshakeMessageType>(message_type))
+                        : "UNKNOWN");
+    if (frame_size > bytes.size() - offset - sizeof(frame_size)) {
+      break;
+    }
+    offset += sizeof(frame_size) + frame_size;
+  }
+  return names.empty() ? "-" : absl::StrJoin(names, "+");
+}
+
+void RecordStep(const std::string &step, int64_t duration_ns,
+                std::vector<StepSamples> *steps) {
+  auto it = std::find_if(
+      steps->begin(), steps->end(),
+      [&step](const StepSamples &samples) { return samples.step == step; });
+  if (it == steps->end()) {
+    steps->push_back({step, {}});
+    it = std::prev(steps->end());
+  }
+  it->durations_ns.push_back(duration_ns);
+}
+
+// Runs an EKEP handshake between a client configured with |client_options| and
+// a server configured with |server_options|, passing the frames written by each
+// directly to the other. If |steps| is not nullptr, records the duration of
+// each handshake step in |steps|.
+Status RunEkepHandshake(const EkepHandshakerOptions &client_options,
+                        const EkepHandshakerOptions &server_options,
+                        std::vector<StepSamples> *steps) {
+  std::unique_ptr<EkepHandshaker> handshakers[] = {
+      ClientEkepHandshaker::Create(client_options),
+      ServerEkepHandshaker::Create(server_options)};
+  const char *roles[] = {"client", "server"};
+  if (!handshakers[0] || !handshakers[1]) {
+    return Status(error::GoogleError::INTERNAL,
+                  "Failed to create EKEP handshakers");
+  }
+
+  // The client starts the handshake with no incoming bytes.
+  EkepHandshaker::Result results[] = {EkepHandshaker::Result::IN_PROGRESS,
+                                      EkepHandshaker::Result::IN_PROGRESS};
+  std::string incoming;
+  int turn = 0;
+  for (int i = 0; i < kMaxHandshakeSteps; ++i) {
+    std::string outgoing;
+    int64_t start_ns = MonotonicNanoseconds();
+    results[turn] = handshakers[turn]->NextHandshakeStep(
+        incoming.data(), incoming.size(), &outgoing);
+    int64_t duration_ns = MonotonicNanoseconds() - start_ns;
+
+    if (steps) {
+      RecordStep(absl::StrCat(roles[turn], ": ", FrameTypes(incoming), " -> ",
+                              FrameTypes(outgoing)),
+                 duration_ns, steps);
+    }
+    if (results[turn] == EkepHandshaker::Result::ABORTED) {
+      return Status(error::GoogleError::INTERNAL,
+                    absl::StrCat("EKEP handshake aborted by ", roles[turn]));
+    }
+    if (results[0] == EkepHandshaker::Result::COMPLETED &&
+        results[1] == EkepHandshaker::Result::COMPLETED) {
+      return Status::OkStatus();
+    }
+    incoming = std::move(outgoing);
+    turn = 1 - turn;
+  }
+  return Status(error::GoogleError::INTERNAL,
+                "EKEP handshake did not complete");
+}
+
+// Sets |options|.ephemeral_key_pool and |options|.verified_assertion_cache as
+// requested by |input|.
+Status AddSharedCaches(const HandshakeBenchmarkInput &input,
+                       EkepHandshakerOptions *options) {
+  if (input.ephemeral_key_pool_size() > 0) {
+    ASYLO_ASSIGN_OR_RETURN(
+        options->ephemeral_key_pool,
+        EphemeralKeyPool::Create(input.ephemeral_key_pool_size()));
+  }
+  if (input.verified_assertion_cache()) {
+    ASYLO_ASSIGN_OR_RETURN(
+        options->verified_assertion_cache,
+        VerifiedAssertionCache::Create(kVerifiedAssertionCacheCapacity,
+                                       kVerifiedAssertionCacheTtl));
+  }
+  return Status::OkStatus();
+}
+
+Status BenchmarkEkepSteps(const HandshakeBenchmarkInput &input,
+                          HandshakeBenchmarkOutput *output) {
+  EnclaveCredentialsOptions credentials_options;
+  ASYLO_ASSIGN_OR_RETURN(credentials_options, GetCredentialsOptions(input));
+
+  EkepHandshakerOptions client_options;
+  client_options.self_assertions = credentials_options.self_assertions;
+  client_options.accepted_peer_assertions =
+      credentials_options.accepted_peer_assertions;
+  client_options.additional_authenticated_data =
+      credentials_options.additional_authenticated_data;
+  EkepHandshakerOptions server_options = client_options;
+
+  ASYLO_RETURN_IF_ERROR(AddSharedCaches(input, &client_options));
+  ASYLO_RETURN_IF_ERROR(AddSharedCaches(input, &server_options));
+  if (input.session_resumption()) {
+    ASYLO_ASSIGN_OR_RETURN(
+        server_options.ticket_sealer,
+        ResumptionTicketSealer::Create(TrivialRandomObject<SafeBytes<32>>(),
+                                       absl::Hours(1)));
+    client_options.session_cache = std::make_shared<EkepSessionCache>(1);
+    client_options.session_cache_key = kSessionCacheKey;
+  }
+  if (input.early_client_id()) {
+    client_options.negotiation_cache =
+        std::make_shared<EkepNegotiationCache>(1);
+    client_options.session_cache_key = kSessionCacheKey;
+  }
+  ASYLO_RETURN_IF_ERROR(client_options.Validate());
+  ASYLO_RETURN_IF_ERROR(server_options.Validate());
+
+  for (int i = 0; i < input.warmup_handshakes(); ++i) {
+    ASYLO_RETURN_IF_ERROR(
+        RunEkepHandshake(client_options, server_options, /*steps=*/nullptr));
+  }
+
+  std::vector<StepSamples> steps;
+  std::vector<int64_t> latencies_ns;
+  int64_t failed_handshakes = 0;
+  int64_t start_ns = MonotonicNanoseconds();
+  for (int i = 0; i < input.handshakes(); ++i) {
+    int64_t handshake_start_ns = MonotonicNanoseconds();
+    Status status = RunEkepHandshake(client_options, server_options, &steps);
+    if (status.ok()) {
+      latencies_ns.push_back(MonotonicNanoseconds() - handshake_start_ns);
+    } else {
+      ++failed_handshakes;
+    }
+  }
+  SummarizeHandshakes(failed_handshakes, MonotonicNanoseconds() - start_ns,
+                      &latencies_ns, output);
+
+  for (StepSamples &samples : steps) {
+    std::sort(samples.durations_ns.begin(), samples.durations_ns.end());
+    int64_t total_ns = 0;
+    for (int64_t duration_ns : samples.durations_ns) {
+      total_ns += duration_ns;
+    }
+    HandshakeStepTiming *timing = output->add_steps();
+    timing->set_step(samples.step);
+    timing->set_count(samples.durations_ns.size());
+    timing->set_mean_ns(total_ns / samples.durations_ns.size());
+    timing->set_p99_ns(Percentile(samples.durations_ns, 0.99));
+  }
+  return Status::OkStatus();
+}
+
+// --- FRAME_PROTECTOR ---
+
+// Owns a tsi_handshaker.
+struct TsiHandshakerDeleter {
+  void operator()(tsi_handshaker *handshaker) const {
+    tsi_handshaker_destroy(handshaker);
+  }
+};
+using TsiHandshakerPtr = std::unique_ptr<tsi_handshaker, TsiHandshakerDeleter>;
+
+// Owns a tsi_handshaker_result.
+struct TsiHandshakerResultDeleter {
+  void operator()(tsi_handshaker_result *result) const {
+    tsi_handshaker_result_destroy(result);
+  }
+};
+using TsiHandshakerResultPtr =
+    std::unique_ptr<tsi_handshaker_result, TsiHandshakerResultDeleter>;
+
+// Owns a tsi_frame_protector.
+struct TsiFrameProtectorDeleter {
+  void operator()(tsi_frame_protector *protector) const {
+    tsi_frame_protector_destroy(protector);
+  }
+};
+using TsiFrameProtectorPtr =
+    std::unique_ptr<tsi_frame_protector, TsiFrameProtectorDeleter>;
+
+Status TsiStatus(const std::string &operation, tsi_result result) {
+  return Status(error::GoogleError::INTERNAL,
+                absl::StrCat(operation, " failed: ",
+                             tsi_result_to_string(result)));
+}
+
+// Creates the frame protectors of a client and a server that complete an
+// in-memory handshake configured with |options|, and stores them in |client|
+// and |server|.
+Status CreateFrameProtectors(const EnclaveCredentialsOptions &options,
+                             TsiFrameProtectorPtr *client,
+                             TsiFrameProtectorPtr *server) {
+  grpc_enclave_credentials_options c_options;
+  grpc_enclave_credentials_options_init(&c_options);
+  CopyEnclaveCredentialsOptions(options, &c_options);
+  // Index 0 holds the client and index 1 the server.
+  TsiHandshakerPtr handshakers[2];
+  for (int i = 0; i < 2; ++i) {
+    tsi_handshaker *handshaker = nullptr;
+    tsi_result result = tsi_enclave_handshaker_create(
+        /*is_client=*/i == 0, &c_options.self_assertions,
+        &c_options.accepted_peer_assertions,
+        &c_options.additional_authenticated_data,
+        c_options.max_protected_frame_size, c_options.idle_buffer_release_ms,
+        /*ephemeral_key_pool=*/nullptr,
+        /*client_precommit_cache=*/nullptr,
+        /*handshake_admission=*/nullptr, &handshaker);
+    if (result != TSI_OK) {
+      grpc_enclave_credentials_options_destroy(&c_options);
+      return TsiStatus("Handshaker creation", result);
+    }
+    handshakers[i].reset(handshaker);
+  }
+  grpc_enclave_credentials_options_destroy(&c_options);
+
+  // Steps run synchronously because no callback is passed.
+  TsiHandshakerResultPtr results[2];
+  std::string incoming;
+  int turn = 0;
+  for (int i = 0; i < kMaxHandshakeSteps && !(results[0] && results[1]);
+       ++i) {
+    const unsigned char *bytes_to_send = nullptr;
+    size_t bytes_to_send_size = 0;
+    if (!results[turn]) {
+      tsi_handshaker_result *handshaker_result = nullptr;
+      tsi_result result = tsi_handshaker_next(
+          handshakers[turn].get(),
+          reinterpret_cast<const unsigned char *>(incoming.data()),
+          incoming.size(), &bytes_to_send, &bytes_to_send_size,
+          &handshaker_result, /*cb=*/nullptr, /*user_data=*/nullptr);
+      if (result != TSI_OK) {
+        return TsiStatus("Handshake step", result);
+      }
+      results[turn].reset(handshaker_result);
+    }
+    incoming.assign(reinterpret_cast<const char *>(bytes_to_send),
+                    bytes_to_send_size);
+    turn = 1 - turn;
+  }
+  if (!results[0] || !results[1]) {
+    return Status(error::GoogleError::INTERNAL,
+                  "TSI handshake did not complete");
+  }
+
+  TsiFrameProtectorPtr *protectors[] = {client, server};
+  for (int i = 0; i < 2; ++i) {
+    tsi_frame_protector *protector = nullptr;
+    tsi_result result = tsi_handshaker_result_create_frame_protector(
+        results[i].get(), /*max_output_protected_frame_size=*/nullptr,
+        &protector);
+    if (result != TSI_OK) {
+      return TsiStatus("Frame protector creation", result);
+    }
+    protectors[i]->reset(protector);
+  }
+  return Status::OkStatus();
+}
+
+// Protects |size| bytes at |data| with |protector|, flushes the protector, and
+// appends the resulting frames to |frames|.
+Status Protect(tsi_frame_protector *protector, const unsigned char *data,
+               size_t size, std::vector<unsigned char> *buffer,
+               std::string *frames) {
+  while (size > 0) {
+    size_t consumed = size;
+    size_t written = buffer->size();
+    tsi_result result = tsi_frame_protector_protect(
+        protector, data, &consumed, buffer->data(), &written);
+    if (result != TSI_OK) {
+      return TsiStatus("Protect", result);
+    }
+    frames->append(reinterpret_cast<const char *>(buffer->data()), written);
+    data += consumed;
+    size -= consumed;
+  }
+
+  size_t still_pending = 0;
+  do {
+    size_t written = buffer->size();
+    tsi_result result = tsi_frame_protector_protect_flush(
+        protector, buffer->data(), &written, &still_pending);
+    if (result != TSI_OK) {
+      return TsiStatus("Protect flush", result);
+    }
+    frames->append(reinterpret_cast<const char *>(buffer->data()), written);
+  } while (still_pending > 0);
+  return Status::OkStatus();
+}
+
+// Unprotects |frames| with |protector| and adds the number of payload bytes
+// recovered to |payload_size|.
+Status Unprotect(tsi_frame_protector *protector, const std::string &frames,
+                 std::vector<unsigned char> *buffer, int64_t *payload_size) {
+  const unsigned char *data =
+      reinterpret_cast<const unsigned char *>(frames.data());
+  size_t size = frames.size();
+  size_t written = 0;
+  do {
+    size_t consumed = size;
+    written = buffer->size();
+    tsi_result result = tsi_frame_protector_unprotect(
+        protector, data, &consumed, buffer->data(), &written);
+    if (result != TSI_OK) {
+      return TsiStatus("Unprotect", result);
+    }
+    if (consumed == 0 && written == 0 && size > 0) {
+      return Status(error::GoogleError::INTERNAL,
+                    "Unprotect made no progress");
+    }
+    *payload_size += written;
+    data += consumed;
+    size -= consumed;
+  } while (size > 0 || written > 0);
+  return Status::OkStatus();
+}
+
+Status BenchmarkFrameProtector(const HandshakeBenchmarkInput &input,
+                               HandshakeBenchmarkOutput *output) {
+  if (input.write_size() <= 0 || input.stream_bytes() <= 0) {
+    return Status(error::GoogleError::INVALID_ARGUMENT,
+                  "Write size and stream size must be positive");
+  }
+  EnclaveCredentialsOptions options;
+  ASYLO_ASSIGN_OR_RETURN(options, GetCredentialsOptions(input));
+  TsiFrameProtectorPtr client;
+  TsiFrameProtectorPtr server;
+  ASYLO_RETURN_IF_ERROR(CreateFrameProtectors(options, &client, &server));
+
+  std::vector<unsigned char> payload(input.write_size(), 'x');
+  std::vector<unsigned char> buffer(kProtectorBufferSize);
+  std::string frames;
+  int64_t received = 0;
+  int64_t start_ns = MonotonicNanoseconds();
+  for (int64_t sent = 0; sent < input.stream_bytes(); sent += payload.size()) {
+    frames.clear();
+    ASYLO_RETURN_IF_ERROR(Protect(client.get(), payload.data(), payload.size(),
+                                  &buffer, &frames));
+    ASYLO_RETURN_IF_ERROR(Unprotect(server.get(), frames, &buffer, &received));
+  }
+  int64_t elapsed_ns = MonotonicNanoseconds() - start_ns;
+
+  if (received % payload.size() != 0 || received < input.stream_bytes()) {
+    return Status(error::GoogleError::INTERNAL,
+                  "Frame protectors lost payload bytes");
+  }
+  output->set_stream_bytes(received);
+  output->set_elapsed_ns(elapsed_ns);
+  output->set_bytes_per_second(
+      elapsed_ns > 0
+          ? static_cast<double>(received) * kNanosecondsPerSecond / elapsed_ns
+          : 0.0);
+  return Status::OkStatus();
+}
+
+}  // namespace
+
+Status RunHandshakeBenchmark(const HandshakeBenchmarkInput &input,
+                             HandshakeBenchmarkOutput *output) {
+  switch (input.benchmark()) {
+    case HandshakeBenchmarkInput::CHANNEL:
+      return BenchmarkChannels(input, output);
+    case HandshakeBenchmarkInput::EKEP_STEPS:
+      return BenchmarkEkepSteps(input, output);
+    case HandshakeBenchmarkInput::FRAME_PROTECTOR:
+      return BenchmarkFrameProtector(input, output);
+    default:
+      return Status(error::GoogleError::INVALID_ARGUMENT,
+                    "Unknown handshake benchmark");
+  }
+}
+
+}  // namespace asylo
@@ -0,0 +1,44 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_GRPC_AUTH_TEST_HANDSHAKE_BENCHMARK_H_
+#define ASYLO_GRPC_AUTH_TEST_HANDSHAKE_BENCHMARK_H_
+
+#include "asylo/grpc/auth/test/handshake_benchmark.pb.h"
+#include "asylo/util/status.h"
+
+namespace asylo {
+
+// Runs the benchmark named by |input.benchmark()| with the credentials named by
+// |input.assertion()| and stores the measurements in |output|:
+//   * CHANNEL opens |input.handshakes()| gRPC channels to a server in the same
+//   process and reports the connection rate and latency.
+//   * EKEP_STEPS runs |input.handshakes()| EKEP handshakes in memory and also
+//   reports the time spent in each kind of handshake step.
+//   * FRAME_PROTECTOR streams |input.stream_bytes()| through the frame
+//   protectors produced by an in-memory handshake and reports the throughput.
+//
+// The assertion authorities named by |input.assertion()| must be initialized.
+// The same code runs natively and inside an enclave so that both columns of a
+// comparison measure identical work.
+Status RunHandshakeBenchmark(const HandshakeBenchmarkInput &input,
+                             HandshakeBenchmarkOutput *output);
+
+}  // namespace asylo
+
+#endif  // ASYLO_GRPC_AUTH_TEST_HANDSHAKE_BENCHMARK_H_
@@ -0,0 +1,336 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+// Measures the enclave gRPC credentials, natively and from inside an enclave
+// with the same code:
+//   * channel: gRPC channels connected per second, and their p50 and p99
+//   connection latency, when opened at a fixed rate or one after another
+//   * ekep_steps: in-memory EKEP handshakes per second, with the time spent in
+//   each kind of handshake step, optionally with session resumption, early
+//   ClientId, verified assertion caching, and an ephemeral key pool
+//   * frame_protector: throughput of the frame protectors that the handshake
+//   produces
+// SGX local assertions only work inside the enclave, so native runs skip them.
+// Whether the enclave runs in hardware or simulation mode is decided when it is
+// built; pass --enclave_label to tell the two apart in the report.
+
+#include <stdio.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "absl/strings/ascii.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_split.h"
+#include "asylo/benchmarks/benchmark_report.h"
+#include "asylo/client.h"
+#include "asylo/grpc/auth/test/handshake_benchmark.h"
+#include "asylo/grpc/auth/test/handshake_benchmark.pb.h"
+#include "asylo/identity/enclave_assertion_authority_config.pb.h"
+#include "asylo/identity/init.h"
+#include "asylo/util/logging.h"
+#include "gflags/gflags.h"
+
+DEFINE_string(enclave_path, "", "Path to the benchmark enclave");
+DEFINE_string(benchmarks, "channel,ekep_steps,frame_protector",
+              "Comma-separated benchmarks to run, named as in "
+              "HandshakeBenchmarkInput::Benchmark");
+DEFINE_string(assertions, "null_assertion,sgx_local",
+              "Comma-separated assertion types, named as in "
+              "HandshakeBenchmarkInput::Assertion");
+DEFINE_string(modes, "native,enclave",
+              "Comma-separated locations: native and enclave");
+DEFINE_string(enclave_label, "enclave",
+              "Name reported for the enclave mode, e.g. sim or hw");
+DEFINE_int32(handshakes, 200,
+             "Measured channels or handshakes per run. Every channel of a run "
+             "stays open until the run ends");
+DEFINE_int32(warmup_handshakes, 2, "Unmeasured handshakes per run");
+DEFINE_string(channel_rates, "0",
+              "Comma-separated rates, in channels per second, at which the "
+              "channel benchmark opens channels. 0 opens each channel once "
+              "the previous one is connected");
+DEFINE_int64(timeout_ms, 10000, "Time a channel may take to connect");
+DEFINE_int64(max_protected_frame_size, 0,
+             "Record protocol frame size, or 0 for the default");
+DEFINE_int64(ephemeral_key_pool_size, 0,
+             "Precomputed ephemeral key pairs, or 0 to disable the pool");
+DEFINE_bool(session_resumption, false,
+            "Resume sessions in the ekep_steps benchmark");
+DEFINE_bool(early_client_id, false,
+            "Send an early ClientId in the ekep_steps benchmark");
+DEFINE_bool(verified_assertion_cache, false,
+            "Cache verified assertions in the ekep_steps benchmark");
+DEFINE_int64(stream_bytes, 64 << 20,
+             "Bytes streamed through the frame protectors per run");
+DEFINE_string(write_sizes, "1024,16384,65536",
+              "Comma-separated bytes per protect call");
+DEFINE_string(json_output, "", "File to also write the results to as JSON");
+
+namespace asylo {
+namespace {
+
+constexpr char kEnclaveName[] = "handshake_benchmark";
+constexpr int64_t kNanosecondsPerMillisecond = 1000000;
+constexpr double kNanosecondsPerMicrosecond = 1000.0;
+constexpr double kBytesPerMegabyte = 1 << 20;
+
+// Parses the comma-separated enum names in |names| with |parse|, which is the
+// generated Parse function of the enum.
+template <typename EnumT, typename ParseT>
+std::vector<EnumT> ParseEnumList(const std::string &names, ParseT parse) {
+  std::vector<EnumT> values;
+  for (const auto &name : absl::StrSplit(names, ',')) {
+    EnumT value;
+    if (!parse(absl::AsciiStrToUpper(name), &value) ||
+        static_cast<int>(value) == 0) {
+      LOG(QFATAL) << "Unknown value: " << name;
+    }
+    values.push_back(value);
+  }
+  return values;
+}
+
+std::vector<int64_t> ParseNumberList(const std::string &numbers) {
+  std::vector<int64_t> values;
+  for (const auto &number : absl::StrSplit(numbers, ',')) {
+    int64_t value;
+    if (!absl::SimpleAtoi(number, &value) || value < 0) {
+      LOG(QFATAL) << "Invalid number: " << number;
+    }
+    values.push_back(value);
+  }
+  return values;
+}
+
+void PrintHeader(HandshakeBenchmarkInput::Benchmark benchmark) {
+  if (benchmark == HandshakeBenchmarkInput::FRAME_PROTECTOR) {
+    printf("\n%-16s %-10s %-16s %10s %12s\n", "benchmark", "mode",
+           "assertion", "write_size", "MiB/s");
+    return;
+  }
+  printf("\n%-16s %-10s %-16s %8s %8s %8s %12s %10s %10s\n", "benchmark",
+         "mode", "assertion", "rate", "ok", "failed", "handshakes/s", "p50_us",
+         "p99_us");
+  if (benchmark == HandshakeBenchmarkInput::EKEP_STEPS) {
+    printf("    %-56s %8s %10s %10s\n", "step", "count", "mean_us", "p99_us");
+  }
+}
+
+// Returns the labels shared by the results of |input| run in |mode|.
+BenchmarkRecorder::Labels ResultLabels(const HandshakeBenchmarkInput &input,
+                                       const std::string &mode) {
+  return {{"benchmark", HandshakeBenchmarkInput::Benchmark_Name(
+                            input.benchmark())},
+          {"mode", mode},
+          {"assertion",
+           HandshakeBenchmarkInput::Assertion_Name(input.assertion())}};
+}
+
+void PrintHandshakeResult(const HandshakeBenchmarkInput &input,
+                          const std::string &mode,
+                          const HandshakeBenchmarkOutput &result,
+                          BenchmarkRecorder *recorder) {
+  printf("%-16s %-10s %-16s %8.0f %8lld %8lld %12.1f %10.1f %10.1f\n",
+         HandshakeBenchmarkInput::Benchmark_Name(input.benchmark()).c_str(),
+         mode.c_str(),
+         HandshakeBenchmarkInput::Assertion_Name(input.assertion()).c_str(),
+         input.handshakes_per_second(),
+         static_cast<long long>(result.handshakes()),
+         static_cast<long long>(result.failed_handshakes()),
+         result.handshakes_per_second(),
+         result.p50_latency_ns() / kNanosecondsPerMicrosecond,
+         result.p99_latency_ns() / kNanosecondsPerMicrosecond);
+  BenchmarkRecorder::Labels labels = ResultLabels(input, mode);
+  labels.emplace_back("rate", absl::StrCat(input.handshakes_per_second()));
+  BenchmarkResult *recorded = recorder->AddResult(labels);
+  AddMetric("handshakes/s", result.handshakes_per_second(),
+            BenchmarkMetric::HIGHER_IS_BETTER, recorded);
+  AddMetric("failed", result.failed_handshakes(),
+            BenchmarkMetric::LOWER_IS_BETTER, recorded);
+  AddMetric("p50_us", result.p50_latency_ns() / kNanosecondsPerMicrosecond,
+            BenchmarkMetric::LOWER_IS_BETTER, recorded);
+  AddMetric("p99_us", result.p99_latency_ns() / kNanosecondsPerMicrosecond,
+            BenchmarkMetric::LOWER_IS_BETTER, recorded);
+
+  for (const HandshakeStepTiming &step : result.steps()) {
+    printf("    %-56s %8lld %10.1f %10.1f\n", step.step().c_str(),
+           static_cast<long long>(step.count()),
+           step.mean_ns() / kNanosecondsPerMicrosecond,
+           step.p99_ns() / kNanosecondsPerMicrosecond);
+    BenchmarkRecorder::Labels step_labels = labels;
+    step_labels.emplace_back("step", step.step());
+    BenchmarkResult *step_recorded = recorder->AddResult(step_labels);
+    AddMetric("mean_us", step.mean_ns() / kNanosecondsPerMicrosecond,
+              BenchmarkMetric::LOWER_IS_BETTER, step_recorded);
+    AddMetric("p99_us", step.p99_ns() / kNanosecondsPerMicrosecond,
+              BenchmarkMetric::LOWER_IS_BETTER, step_recorded);
+  }
+}
+
+void PrintStreamResult(const HandshakeBenchmarkInput &input,
+                       const std::string &mode,
+                       const HandshakeBenchmarkOutput &result,
+                       BenchmarkRecorder *recorder) {
+  printf("%-16s %-10s %-16s %10lld %12.1f\n",
+         HandshakeBenchmarkInput::Benchmark_Name(input.benchmark()).c_str(),
+         mode.c_str(),
+         HandshakeBenchmarkInput::Assertion_Name(input.assertion()).c_str(),
+         static_cast<long long>(input.write_size()),
+         result.bytes_per_second() / kBytesPerMegabyte);
+  BenchmarkRecorder::Labels labels = ResultLabels(input, mode);
+  labels.emplace_back("write_size", absl::StrCat(input.write_size()));
+  AddMetric("MiB/s", result.bytes_per_second() / kBytesPerMegabyte,
+            BenchmarkMetric::HIGHER_IS_BETTER, recorder->AddResult(labels));
+}
+
+}  // namespace
+}  // namespace asylo
+
+int main(int argc, char *argv[]) {
+  ::google::ParseCommandLineFlags(&argc, &argv, /*remove_flags=*/true);
+
+  auto benchmarks =
+      asylo::ParseEnumList<asylo::HandshakeBenchmarkInput::Benchmark>(
+          FLAGS_benchmarks, asylo::HandshakeBenchmarkInput::Benchmark_Parse);
+  auto assertions =
+      asylo::ParseEnumList<asylo::HandshakeBenchmarkInput::Assertion>(
+          FLAGS_assertions, asylo::HandshakeBenchmarkInput::Assertion_Parse);
+  std::vector<int64_t> channel_rates =
+      asylo::ParseNumberList(FLAGS_channel_rates);
+  std::vector<int64_t> write_sizes = asylo::ParseNumberList(FLAGS_write_sizes);
+  std::vector<std::string> modes = absl::StrSplit(FLAGS_modes, ',');
+
+  asylo::EnclaveClient *client = nullptr;
+  asylo::EnclaveManager *manager = nullptr;
+  for (const auto &mode : modes) {
+    if (mode == "native") {
+      // Initialize every assertion authority that needs no config. Those that
+      // need an enclave, such as SGX local, fail and are skipped below.
+      std::vector<asylo::EnclaveAssertionAuthorityConfig> authority_configs;
+      asylo::Status status = asylo::InitializeEnclaveAssertionAuthorities(
+          authority_configs.begin(), authority_configs.end());
+      if (!status.ok()) {
+        LOG(INFO) << "Some assertion authorities are unavailable natively: "
+                  << status;
+      }
+    } else if (mode == "enclave") {
+      asylo::EnclaveManager::Configure(asylo::EnclaveManagerOptions());
+      auto manager_result = asylo::EnclaveManager::Instance();
+      if (!manager_result.ok()) {
+        LOG(QFATAL) << "EnclaveManager unavailable: "
+                    << manager_result.status();
+      }
+      manager = manager_result.ValueOrDie();
+      asylo::SGXLoader loader(FLAGS_enclave_path, /*debug=*/true);
+      asylo::Status status = manager->LoadEnclave(asylo::kEnclaveName, loader);
+      if (!status.ok()) {
+        LOG(QFATAL) << "Load " << FLAGS_enclave_path << " failed: " << status;
+      }
+      client = manager->GetClient(asylo::kEnclaveName);
+    } else {
+      LOG(QFATAL) << "Unknown mode: " << mode;
+    }
+  }
+
+  asylo::BenchmarkRecorder recorder("handshake");
+  for (asylo::HandshakeBenchmarkInput::Benchmark benchmark : benchmarks) {
+    asylo::PrintHeader(benchmark);
+
+    // Each benchmark sweeps the parameter that it alone depends on.
+    std::vector<asylo::HandshakeBenchmarkInput> inputs;
+    asylo::HandshakeBenchmarkInput base_input;
+    base_input.set_benchmark(benchmark);
+    base_input.set_handshakes(FLAGS_handshakes);
+    base_input.set_warmup_handshakes(FLAGS_warmup_handshakes);
+    base_input.set_timeout_ns(FLAGS_timeout_ms *
+                              asylo::kNanosecondsPerMillisecond);
+    base_input.set_max_protected_frame_size(FLAGS_max_protected_frame_size);
+    base_input.set_ephemeral_key_pool_size(FLAGS_ephemeral_key_pool_size);
+    base_input.set_session_resumption(FLAGS_session_resumption);
+    base_input.set_early_client_id(FLAGS_early_client_id);
+    base_input.set_verified_assertion_cache(FLAGS_verified_assertion_cache);
+    base_input.set_stream_bytes(FLAGS_stream_bytes);
+    if (benchmark == asylo::HandshakeBenchmarkInput::CHANNEL) {
+      for (int64_t rate : channel_rates) {
+        inputs.push_back(base_input);
+        inputs.back().set_handshakes_per_second(rate);
+      }
+    } else if (benchmark == asylo::HandshakeBenchmarkInput::FRAME_PROTECTOR) {
+      for (int64_t write_size : write_sizes) {
+        inputs.push_back(base_input);
+        inputs.back().set_write_size(write_size);
+      }
+    } else {
+      inputs.push_back(base_input);
+    }
+
+    for (asylo::HandshakeBenchmarkInput input : inputs) {
+      for (asylo::HandshakeBenchmarkInput::Assertion assertion : assertions) {
+        input.set_assertion(assertion);
+        for (const auto &mode : modes) {
+          if (mode == "native" &&
+              assertion == asylo::HandshakeBenchmarkInput::SGX_LOCAL) {
+            continue;
+          }
+
+          asylo::HandshakeBenchmarkOutput result;
+          asylo::Status status;
+          if (mode == "native") {
+            status = asylo::RunHandshakeBenchmark(input, &result);
+          } else {
+            asylo::EnclaveInput enclave_input;
+            *enclave_input.MutableExtension(
+                asylo::handshake_benchmark_input) = input;
+            asylo::EnclaveOutput enclave_output;
+            status = client->EnterAndRun(enclave_input, &enclave_output);
+            result =
+                enclave_output.GetExtension(asylo::handshake_benchmark_output);
+          }
+          if (!status.ok()) {
+            LOG(QFATAL) << "Benchmark run failed: " << status;
+          }
+
+          const std::string &label =
+              mode == "native" ? mode : FLAGS_enclave_label;
+          if (benchmark == asylo::HandshakeBenchmarkInput::FRAME_PROTECTOR) {
+            asylo::PrintStreamResult(input, label, result, &recorder);
+          } else {
+            asylo::PrintHandshakeResult(input, label, result, &recorder);
+          }
+        }
+      }
+    }
+  }
+
+  if (client) {
+    asylo::EnclaveFinal final_input;
+    asylo::Status status = manager->DestroyEnclave(client, final_input);
+    if (!status.ok()) {
+      LOG(QFATAL) << "Destroy " << FLAGS_enclave_path << " failed: " << status;
+    }
+  }
+
+  asylo::Status status = recorder.WriteJson(FLAGS_json_output);
+  if (!status.ok()) {
+    LOG(QFATAL) << status;
+  }
+  return 0;
+}
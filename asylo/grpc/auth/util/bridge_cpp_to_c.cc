@@ -60,6 +60,23 @@ void CopyEnclaveCredentialsOptions(const EnclaveCredentialsOptions &src,
                        src.additional_authenticated_data.size(),
                        src.additional_authenticated_data.data());
   }
+  dest->max_protected_frame_size = src.max_protected_frame_size;
+  dest->idle_buffer_release_ms = src.idle_buffer_release_ms;
+  dest->ephemeral_key_pool_size = src.ephemeral_key_pool_size;
+  dest->max_concurrent_handshakes = src.max_concurrent_handshakes;
+  dest->max_pending_handshakes = src.max_pending_handshakes;
+  dest->pending_handshake_timeout_ms = src.pending_handshake_timeout_ms;
+  CopyEnclaveTransportOptions(src.transport_options, &dest->transport_options);
+}
+
+void CopyEnclaveTransportOptions(const EnclaveTransportOptions &src,
+                                 grpc_enclave_transport_options *dest) {
+  dest->socket_send_buffer_size = src.socket_send_buffer_size;
+  dest->socket_receive_buffer_size = src.socket_receive_buffer_size;
+  dest->tcp_nodelay = src.tcp_nodelay ? 1 : 0;
+  dest->http2_initial_window_size = src.http2_initial_window_size;
+  dest->keepalive_time_ms = src.keepalive_time_ms;
+  dest->keepalive_timeout_ms = src.keepalive_timeout_ms;
 }
 
 }  // namespace asylo
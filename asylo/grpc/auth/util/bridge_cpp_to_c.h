@@ -36,6 +36,11 @@ namespace asylo {
 // from C++ layers of gRPC to C layers.
 void CopyEnclaveCredentialsOptions(const EnclaveCredentialsOptions &src,
                                    grpc_enclave_credentials_options *dest);
+
+// Copies the transport options in |src| to a corresponding C structure in
+// |dest|.
+void CopyEnclaveTransportOptions(const EnclaveTransportOptions &src,
+                                 grpc_enclave_transport_options *dest);
 }  // namespace asylo
 
 #endif  // ASYLO_GRPC_AUTH_UTIL_BRIDGE_CPP_TO_C_H_
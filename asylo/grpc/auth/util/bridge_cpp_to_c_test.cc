@@ -68,6 +68,19 @@ bool AdditionalAuthenticatedDataIsEqual(const std::string &expected,
   return strncmp(expected.c_str(), actual.data, actual.size) == 0;
 }
 
+// Returns true if |expected| contains the same transport options as |actual|.
+bool TransportOptionsAreEqual(const EnclaveTransportOptions &expected,
+                              const grpc_enclave_transport_options &actual) {
+  return expected.socket_send_buffer_size == actual.socket_send_buffer_size &&
+         expected.socket_receive_buffer_size ==
+             actual.socket_receive_buffer_size &&
+         expected.tcp_nodelay == (actual.tcp_nodelay != 0) &&
+         expected.http2_initial_window_size ==
+             actual.http2_initial_window_size &&
+         expected.keepalive_time_ms == actual.keepalive_time_ms &&
+         expected.keepalive_timeout_ms == actual.keepalive_timeout_ms;
+}
+
 // Returns true if |expected| contains the same credentials options as |actual|.
 bool CredentialsOptionsAreEqual(
     const EnclaveCredentialsOptions &expected,
@@ -80,6 +93,19 @@ bool CredentialsOptionsAreEqual(
                                      actual.accepted_peer_assertions)) {
     return false;
   }
+  if (expected.max_protected_frame_size != actual.max_protected_frame_size) {
+    return false;
+  }
+  if (expected.idle_buffer_release_ms != actual.idle_buffer_release_ms) {
+    return false;
+  }
+  if (expected.ephemeral_key_pool_size != actual.ephemeral_key_pool_size) {
+    return false;
+  }
+  if (!TransportOptionsAreEqual(expected.transport_options,
+                                actual.transport_options)) {
+    return false;
+  }
   return AdditionalAuthenticatedDataIsEqual(
       expected.additional_authenticated_data,
       actual.additional_authenticated_data);
@@ -104,6 +130,15 @@ class BridgeCppToCTest : public ::testing::Test {
 // EnclaveCredentialsOptions struct into a grpc_enclave_credentials_options.
 TEST_F(BridgeCppToCTest, CopyEnclaveCredentialsOptionsNonEmpty) {
   EnclaveCredentialsOptions options = BidirectionalNullCredentialsOptions();
+  options.max_protected_frame_size = 64 * 1024;
+  options.idle_buffer_release_ms = 30000;
+  options.ephemeral_key_pool_size = 16;
+  options.transport_options.socket_send_buffer_size = 1 << 20;
+  options.transport_options.socket_receive_buffer_size = 1 << 21;
+  options.transport_options.tcp_nodelay = false;
+  options.transport_options.http2_initial_window_size = 8 << 20;
+  options.transport_options.keepalive_time_ms = 10000;
+  options.transport_options.keepalive_timeout_ms = 2000;
   CopyEnclaveCredentialsOptions(options, &bridge_options_);
 
   ASSERT_NO_FATAL_FAILURE(CredentialsOptionsAreEqual(options, bridge_options_));
@@ -0,0 +1,181 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/grpc/auth/util/enclave_channel_pool.h"
+
+#include <algorithm>
+#include <utility>
+
+#include "absl/strings/str_cat.h"
+#include "asylo/grpc/auth/enclave_channel_credentials.h"
+#include "include/grpc/grpc.h"
+#include "include/grpcpp/create_channel.h"
+#include "include/grpcpp/support/channel_arguments.h"
+
+namespace asylo {
+namespace {
+
+// Channel argument holding the index of a channel within its key.
+constexpr char kChannelIndexArg[] = "asylo.enclave_channel_pool.index";
+
+// Appends |field| to |key| with a length prefix, so that fields cannot run
+// into each other.
+void AppendKeyField(const std::string &field, std::string *key) {
+  absl::StrAppend(key, field.size(), ":", field);
+}
+
+// Returns a key identifying |target| and every field of |options|.
+std::string PoolKey(const std::string &target,
+                    const EnclaveCredentialsOptions &options) {
+  std::string key;
+  AppendKeyField(target, &key);
+  AppendKeyField(options.additional_authenticated_data, &key);
+  absl::StrAppend(&key, options.self_assertions.size(), ";");
+  for (const AssertionDescription &description : options.self_assertions) {
+    AppendKeyField(description.SerializeAsString(), &key);
+  }
+  absl::StrAppend(&key, options.accepted_peer_assertions.size(), ";");
+  for (const AssertionDescription &description :
+       options.accepted_peer_assertions) {
+    AppendKeyField(description.SerializeAsString(), &key);
+  }
+  const EnclaveTransportOptions &transport = options.transport_options;
+  absl::StrAppend(&key, options.max_protected_frame_size, ",",
+                  options.idle_buffer_release_ms, ",",
+                  options.ephemeral_key_pool_size, ",",
+                  options.max_concurrent_handshakes, ",",
+                  options.max_pending_handshakes, ",",
+                  options.pending_handshake_timeout_ms, ",",
+                  transport.socket_send_buffer_size, ",",
+                  transport.socket_receive_buffer_size, ",",
+                  transport.tcp_nodelay, ",",
+                  transport.http2_initial_window_size, ",",
+                  transport.keepalive_time_ms, ",",
+                  transport.keepalive_timeout_ms);
+  return key;
+}
+
+}  // namespace
+
+EnclaveChannelPool::EnclaveChannelPool(const Options &options)
+    : options_(options), shutting_down_(false) {
+  if (options_.maintenance_interval > absl::ZeroDuration()) {
+    maintenance_thread_ =
+        std::thread(&EnclaveChannelPool::MaintenanceLoop, this);
+  }
+}
+
+EnclaveChannelPool::~EnclaveChannelPool() {
+  {
+    absl::MutexLock lock(&mu_);
+    shutting_down_ = true;
+  }
+  if (maintenance_thread_.joinable()) {
+    maintenance_thread_.join();
+  }
+}
+
+std::shared_ptr<::grpc::Channel> EnclaveChannelPool::GetChannel(
+    const std::string &target, const EnclaveCredentialsOptions &options) {
+  absl::MutexLock lock(&mu_);
+  Entry *entry = FindOrCreateEntry(target, options);
+  std::shared_ptr<::grpc::Channel> channel =
+      entry->channels[entry->next_channel];
+  entry->next_channel = (entry->next_channel + 1) % entry->channels.size();
+  return channel;
+}
+
+void EnclaveChannelPool::Prewarm(const std::string &target,
+                                 const EnclaveCredentialsOptions &options) {
+  absl::MutexLock lock(&mu_);
+  FindOrCreateEntry(target, options);
+}
+
+void EnclaveChannelPool::Maintain() {
+  // Evicted channels are destroyed after the lock is released.
+  std::vector<std::shared_ptr<::grpc::Channel>> retired;
+  {
+    absl::MutexLock lock(&mu_);
+    absl::Time now = absl::Now();
+    for (auto it = entries_.begin(); it != entries_.end();) {
+      Entry &entry = it->second;
+      if (now - entry.last_used >= options_.idle_timeout) {
+        retired.insert(retired.end(), entry.channels.begin(),
+                       entry.channels.end());
+        it = entries_.erase(it);
+        continue;
+      }
+      for (size_t i = 0; i < entry.channels.size(); ++i) {
+        if (entry.channels[i]->GetState(/*try_to_connect=*/true) ==
+            GRPC_CHANNEL_TRANSIENT_FAILURE) {
+          retired.push_back(std::move(entry.channels[i]));
+          entry.channels[i] = CreateChannel(entry, i);
+        }
+      }
+      ++it;
+    }
+  }
+}
+
+size_t EnclaveChannelPool::size() const {
+  absl::MutexLock lock(&mu_);
+  return entries_.size();
+}
+
+EnclaveChannelPool::Entry *EnclaveChannelPool::FindOrCreateEntry(
+    const std::string &target, const EnclaveCredentialsOptions &options) {
+  Entry &entry = entries_[PoolKey(target, options)];
+  entry.last_used = absl::Now();
+  if (entry.channels.empty()) {
+    entry.target = target;
+    entry.credentials = EnclaveChannelCredentials(options);
+    entry.next_channel = 0;
+    size_t count = std::max<size_t>(options_.channels_per_key, 1);
+    for (size_t i = 0; i < count; ++i) {
+      entry.channels.push_back(CreateChannel(entry, i));
+    }
+  }
+  return &entry;
+}
+
+std::shared_ptr<::grpc::Channel> EnclaveChannelPool::CreateChannel(
+    const Entry &entry, size_t index) const {
+  // Distinct arguments keep gRPC from sharing one connection between the
+  // channels of a key.
+  ::grpc::ChannelArguments args;
+  args.SetInt(kChannelIndexArg, static_cast<int>(index));
+  std::shared_ptr<::grpc::Channel> channel =
+      ::grpc::CreateCustomChannel(entry.target, entry.credentials, args);
+  channel->GetState(/*try_to_connect=*/true);
+  return channel;
+}
+
+void EnclaveChannelPool::MaintenanceLoop() {
+  while (true) {
+    {
+      absl::MutexLock lock(&mu_);
+      if (mu_.AwaitWithTimeout(absl::Condition(&shutting_down_),
+                               options_.maintenance_interval)) {
+        return;
+      }
+    }
+    Maintain();
+  }
+}
+
+}  // namespace asylo
@@ -0,0 +1,135 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_GRPC_AUTH_UTIL_ENCLAVE_CHANNEL_POOL_H_
+#define ASYLO_GRPC_AUTH_UTIL_ENCLAVE_CHANNEL_POOL_H_
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+#include "asylo/grpc/auth/enclave_credentials_options.h"
+#include "include/grpcpp/channel.h"
+#include "include/grpcpp/security/credentials.h"
+
+namespace asylo {
+
+// A pool of enclave gRPC channels shared by the callers of other enclave
+// services, so that each RPC does not pay for a new channel's EKEP handshake.
+//
+// Channels are keyed by target and credentials options. Each key holds a fixed
+// number of channels, handed out in turn, which share one credentials object
+// and so one ephemeral key pool. New channels start connecting as soon as they
+// are created, so their handshakes run on gRPC's threads rather than on the
+// first RPC's path.
+//
+// A maintenance thread periodically:
+//   * evicts the keys that have not been used within the idle timeout
+//   * asks every other channel to connect, which reconnects channels that gRPC
+//   has let go idle
+//   * replaces the channels that are in TRANSIENT_FAILURE with new ones, which
+//   start a fresh handshake instead of waiting out gRPC's reconnect backoff
+//
+// Channels already handed out stay usable after they are evicted or replaced.
+// EnclaveChannelPool is thread-safe.
+class EnclaveChannelPool {
+ public:
+  struct Options {
+    // Number of channels kept for each target and credentials options. More
+    // than one spreads RPCs over several connections.
+    size_t channels_per_key = 1;
+
+    // Time after its last use at which a key's channels are evicted.
+    absl::Duration idle_timeout = absl::Minutes(5);
+
+    // Interval between maintenance passes, or zero to run no maintenance
+    // thread. Callers without the thread may call Maintain() themselves.
+    absl::Duration maintenance_interval = absl::Seconds(10);
+  };
+
+  explicit EnclaveChannelPool(const Options &options);
+  EnclaveChannelPool() : EnclaveChannelPool(Options()) {}
+
+  EnclaveChannelPool(const EnclaveChannelPool &) = delete;
+  EnclaveChannelPool &operator=(const EnclaveChannelPool &) = delete;
+
+  // Stops the maintenance thread.
+  ~EnclaveChannelPool();
+
+  // Returns a channel to |target| with credentials configured by |options|,
+  // creating the key's channels if it has none. Does not wait for the channel
+  // to connect.
+  std::shared_ptr<::grpc::Channel> GetChannel(
+      const std::string &target, const EnclaveCredentialsOptions &options)
+      LOCKS_EXCLUDED(mu_);
+
+  // Creates the channels of |target| and |options| if there are none, so that
+  // their handshakes complete before the first RPC. Counts as a use of the key.
+  void Prewarm(const std::string &target,
+               const EnclaveCredentialsOptions &options) LOCKS_EXCLUDED(mu_);
+
+  // Runs one maintenance pass.
+  void Maintain() LOCKS_EXCLUDED(mu_);
+
+  // Returns the number of keys with channels.
+  size_t size() const LOCKS_EXCLUDED(mu_);
+
+ private:
+  // The channels of one target and credentials options.
+  struct Entry {
+    std::string target;
+    std::shared_ptr<::grpc::ChannelCredentials> credentials;
+    std::vector<std::shared_ptr<::grpc::Channel>> channels;
+
+    // Index of the channel handed out next.
+    size_t next_channel;
+
+    absl::Time last_used;
+  };
+
+  // Returns the entry of |target| and |options|, creating it if needed, and
+  // marks it used.
+  Entry *FindOrCreateEntry(const std::string &target,
+                           const EnclaveCredentialsOptions &options)
+      EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  // Creates channel |index| of |entry| and starts connecting it.
+  std::shared_ptr<::grpc::Channel> CreateChannel(const Entry &entry,
+                                                 size_t index) const;
+
+  // Runs Maintain() every |options_.maintenance_interval| until the pool is
+  // destroyed.
+  void MaintenanceLoop() LOCKS_EXCLUDED(mu_);
+
+  const Options options_;
+
+  mutable absl::Mutex mu_;
+  std::unordered_map<std::string, Entry> entries_ GUARDED_BY(mu_);
+  bool shutting_down_ GUARDED_BY(mu_);
+
+  std::thread maintenance_thread_;
+};
+
+}  // namespace asylo
+
+#endif  // ASYLO_GRPC_AUTH_UTIL_ENCLAVE_CHANNEL_POOL_H_
@@ -0,0 +1,112 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/grpc/auth/util/enclave_channel_pool.h"
+
+#include <memory>
+#include <thread>
+
+#include <gtest/gtest.h>
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "asylo/grpc/auth/null_credentials_options.h"
+
+namespace asylo {
+namespace {
+
+// Targets with no server behind them. Channels to them never connect, which
+// the pool does not need.
+constexpr char kTarget[] = "[::1]:1";
+constexpr char kOtherTarget[] = "[::1]:2";
+
+EnclaveChannelPool::Options NoMaintenanceOptions() {
+  EnclaveChannelPool::Options options;
+  options.maintenance_interval = absl::ZeroDuration();
+  return options;
+}
+
+TEST(EnclaveChannelPoolTest, ReusesChannelOfTargetAndOptions) {
+  EnclaveChannelPool pool(NoMaintenanceOptions());
+  std::shared_ptr<::grpc::Channel> channel =
+      pool.GetChannel(kTarget, BidirectionalNullCredentialsOptions());
+  ASSERT_NE(channel, nullptr);
+  EXPECT_EQ(pool.GetChannel(kTarget, BidirectionalNullCredentialsOptions()),
+            channel);
+  EXPECT_EQ(pool.size(), 1);
+}
+
+TEST(EnclaveChannelPoolTest, KeysChannelsByTargetAndOptions) {
+  EnclaveChannelPool pool(NoMaintenanceOptions());
+  EnclaveCredentialsOptions options = BidirectionalNullCredentialsOptions();
+  EnclaveCredentialsOptions other_options = options;
+  other_options.additional_authenticated_data = "other";
+
+  std::shared_ptr<::grpc::Channel> channel = pool.GetChannel(kTarget, options);
+  EXPECT_NE(pool.GetChannel(kOtherTarget, options), channel);
+  EXPECT_NE(pool.GetChannel(kTarget, other_options), channel);
+  EXPECT_EQ(pool.size(), 3);
+}
+
+TEST(EnclaveChannelPoolTest, HandsOutChannelsOfKeyInTurn) {
+  EnclaveChannelPool::Options pool_options = NoMaintenanceOptions();
+  pool_options.channels_per_key = 2;
+  EnclaveChannelPool pool(pool_options);
+  EnclaveCredentialsOptions options = BidirectionalNullCredentialsOptions();
+
+  std::shared_ptr<::grpc::Channel> first = pool.GetChannel(kTarget, options);
+  std::shared_ptr<::grpc::Channel> second = pool.GetChannel(kTarget, options);
+  EXPECT_NE(first, second);
+  EXPECT_EQ(pool.GetChannel(kTarget, options), first);
+  EXPECT_EQ(pool.GetChannel(kTarget, options), second);
+}
+
+TEST(EnclaveChannelPoolTest, EvictsIdleKeys) {
+  EnclaveChannelPool::Options pool_options = NoMaintenanceOptions();
+  pool_options.idle_timeout = absl::Milliseconds(1);
+  EnclaveChannelPool pool(pool_options);
+
+  std::shared_ptr<::grpc::Channel> channel =
+      pool.GetChannel(kTarget, BidirectionalNullCredentialsOptions());
+  absl::SleepFor(absl::Milliseconds(10));
+  pool.Maintain();
+  EXPECT_EQ(pool.size(), 0);
+  EXPECT_NE(pool.GetChannel(kTarget, BidirectionalNullCredentialsOptions()),
+            channel);
+}
+
+TEST(EnclaveChannelPoolTest, KeepsRecentlyUsedKeys) {
+  EnclaveChannelPool pool(NoMaintenanceOptions());
+  pool.Prewarm(kTarget, BidirectionalNullCredentialsOptions());
+  pool.Maintain();
+  EXPECT_EQ(pool.size(), 1);
+}
+
+TEST(EnclaveChannelPoolTest, StopsMaintenanceThreadOnDestruction) {
+  EnclaveChannelPool::Options pool_options;
+  pool_options.idle_timeout = absl::Milliseconds(1);
+  pool_options.maintenance_interval = absl::Milliseconds(1);
+  EnclaveChannelPool pool(pool_options);
+  pool.Prewarm(kTarget, BidirectionalNullCredentialsOptions());
+  for (int i = 0; i < 1000 && pool.size() > 0; ++i) {
+    absl::SleepFor(absl::Milliseconds(5));
+  }
+  EXPECT_EQ(pool.size(), 0);
+}
+
+}  // namespace
+}  // namespace asylo
@@ -36,24 +36,24 @@ bool MultiBufferInputStream::Next(const void **data, int *size) {
     return false;
   }
 
-  std::vector<char> *buffer = current_->get();
-  if (buffer->size() == offset_) {
+  const Buffer *buffer = &*current_;
+  if (buffer->size == offset_) {
     // Advance to the next buffer, if one exists.
     if (++current_ == buffers_.cend()) {
       // Don't let the caller back up.
       last_returned_size_ = 0;
       return false;
     }
-    buffer = current_->get();
+    buffer = &*current_;
     offset_ = 0;
   }
 
-  *data = buffer->data() + offset_;
-  *size = buffer->size() - offset_;
+  *data = buffer->data + offset_;
+  *size = buffer->size - offset_;
 
-  last_returned_size_ = buffer->size() - offset_;
+  last_returned_size_ = buffer->size - offset_;
   bytes_read_ += last_returned_size_;
-  offset_ = buffer->size();
+  offset_ = buffer->size;
 
   return true;
 }
@@ -92,7 +92,7 @@ bool MultiBufferInputStream::Skip(int count) {
   last_returned_size_ = 0;
 
   while (count > 0) {
-    if (current_->get()->size() == offset_) {
+    if (current_->size == offset_) {
       // Advance to the next buffer, if one exists.
       if (++current_ == buffers_.cend()) {
         return false;
@@ -100,7 +100,7 @@ bool MultiBufferInputStream::Skip(int count) {
       offset_ = 0;
     }
 
-    int bytes_remaining = current_->get()->size() - offset_;
+    int bytes_remaining = current_->size - offset_;
     int bytes_to_skip = (count <= bytes_remaining) ? count : bytes_remaining;
 
     offset_ += bytes_to_skip;
@@ -116,8 +116,11 @@ auto MultiBufferInputStream::ByteCount() const
 }
 
 void MultiBufferInputStream::AddBuffer(const char *data, size_t size) {
-  std::vector<char> *buffer = new std::vector<char>(data, data + size);
-  buffers_.emplace_back(std::unique_ptr<std::vector<char>>(buffer));
+  buffers_.emplace_back();
+  Buffer &buffer = buffers_.back();
+  buffer.storage.assign(data, data + size);
+  buffer.data = buffer.storage.data();
+  buffer.size = size;
 
   // Adjust the current_ pointer in case it was pointing at the end of the list.
   if (current_ == buffers_.cend()) {
@@ -128,6 +131,46 @@ void MultiBufferInputStream::AddBuffer(const char *data, size_t size) {
   size_ += size;
 }
 
+void MultiBufferInputStream::AddBufferView(ByteContainerView data) {
+  buffers_.emplace_back();
+  Buffer &buffer = buffers_.back();
+  buffer.data = reinterpret_cast<const char *>(data.data());
+  buffer.size = data.size();
+
+  // Adjust the current_ pointer in case it was pointing at the end of the list.
+  if (current_ == buffers_.cend()) {
+    current_--;
+  }
+
+  // Update the stream size.
+  size_ += data.size();
+}
+
+void MultiBufferInputStream::CopyBufferViews() {
+  if (buffers_.empty()) {
+    return;
+  }
+
+  // Bytes of the first buffer before trim_offset_ are not part of the stream.
+  // Drop them from a view rather than copying them.
+  Buffer &first = buffers_.front();
+  if (first.storage.empty() && trim_offset_ != 0) {
+    first.data += trim_offset_;
+    first.size -= trim_offset_;
+    if (current_ == buffers_.cbegin()) {
+      offset_ -= trim_offset_;
+    }
+    trim_offset_ = 0;
+  }
+
+  for (Buffer &buffer : buffers_) {
+    if (buffer.storage.empty() && buffer.size != 0) {
+      buffer.storage.assign(buffer.data, buffer.data + buffer.size);
+      buffer.data = buffer.storage.data();
+    }
+  }
+}
+
 void MultiBufferInputStream::TrimFront() {
   // Remove all buffers up to the current buffer.
   while (buffers_.cbegin() != current_) {
@@ -138,7 +181,7 @@ void MultiBufferInputStream::TrimFront() {
     // The entire stream has been consumed.
     offset_ = 0;
     trim_offset_ = 0;
-  } else if (current_->get()->size() == offset_) {
+  } else if (current_->size == offset_) {
     // The current buffer has been entirely consumed. Remove it.
     current_++;
     buffers_.pop_front();
@@ -178,12 +221,10 @@ std::string MultiBufferInputStream::RemainingBytes() const {
   }
 
   // The first buffer may be partially consumed.
-  std::vector<char> *buffer = it->get();
-  contents.append(buffer->data() + offset_, buffer->size() - offset_);
+  contents.append(it->data + offset_, it->size - offset_);
 
   while (++it != buffers_.cend()) {
-    buffer = it->get();
-    contents.append(buffer->data(), buffer->size());
+    contents.append(it->data, it->size);
   }
   return contents;
 }
@@ -20,10 +20,11 @@
 #define ASYLO_GRPC_AUTH_UTIL_MULTI_BUFFER_INPUT_STREAM_H_
 
 #include <list>
-#include <memory>
+#include <string>
 #include <vector>
 
 #include <google/protobuf/io/zero_copy_stream.h>
+#include "asylo/crypto/util/byte_container_view.h"
 
 namespace asylo {
 
@@ -48,8 +49,11 @@ using google::protobuf::io::ZeroCopyInputStream;
 //
 // Unlike most ZeroCopyInputStream implementations, MultiBufferInputStream's
 // constructor does not accept parameters that initialize the stream contents.
-// Instead, buffers are added to the stream via the AddBuffer() method. This is
-// the only time that data is copied.
+// Instead, buffers are added to the stream via the AddBuffer() method, which
+// copies them, or the AddBufferView() method, which does not. Bytes of a view
+// are copied only if they are still part of the stream when
+// CopyBufferViews() is called, which is the only other time that data is
+// copied.
 //
 // This class is thread-compatible.
 class MultiBufferInputStream : public ZeroCopyInputStream {
@@ -67,6 +71,16 @@ class MultiBufferInputStream : public ZeroCopyInputStream {
   // Adds a new buffer containing |size| bytes from |data| to the stream.
   void AddBuffer(const char *data, size_t size);
 
+  // Adds the bytes viewed by |data| to the stream without copying them. They
+  // must remain valid until the next call to CopyBufferViews().
+  void AddBufferView(ByteContainerView data);
+
+  // Copies the bytes of buffers added with AddBufferView() that are still part
+  // of the stream into the stream's own storage, so that the viewed memory may
+  // be released. Bytes trimmed from the front of the stream are not copied.
+  // The state of the stream is otherwise unchanged.
+  void CopyBufferViews();
+
   // Trims the first ByteCount() bytes from the front of the stream. All
   // unconsumed data in the stream is unaffected. After calling TrimFront(),
   // ByteCount() will return 0 until more data is consumed through a call to
@@ -92,7 +106,16 @@ class MultiBufferInputStream : public ZeroCopyInputStream {
   int RemainingByteCount() const;
 
  private:
-  using BufferList = std::list<std::unique_ptr<std::vector<char>>>;
+  // A buffer of the stream. |data| points either into |storage| or, for a
+  // buffer added with AddBufferView(), into memory owned by the caller, in
+  // which case |storage| is empty.
+  struct Buffer {
+    std::vector<char> storage;
+    const char *data;
+    int size;
+  };
+
+  using BufferList = std::list<Buffer>;
 
   BufferList buffers_;
 
@@ -0,0 +1,112 @@
+/*
+ *
+ * Copyright 2017 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/grpc/auth/util/multi_buffer_input_stream.h"
+
+#include <algorithm>
+#include <string>
+
+#include <gtest/gtest.h>
+#include "asylo/crypto/util/byte_container_view.h"
+
+namespace asylo {
+namespace {
+
+// Returns the next |count| bytes of |stream|, read through Next() and BackUp().
+std::string ReadBytes(MultiBufferInputStream *stream, int count) {
+  std::string bytes;
+  while (count > 0) {
+    const void *data;
+    int size;
+    if (!stream->Next(&data, &size)) {
+      break;
+    }
+    int used = std::min(size, count);
+    bytes.append(static_cast<const char *>(data), used);
+    stream->BackUp(size - used);
+    count -= used;
+  }
+  return bytes;
+}
+
+TEST(MultiBufferInputStreamTest, ReadsAcrossBuffers) {
+  MultiBufferInputStream stream;
+  stream.AddBuffer("abc", 3);
+  stream.AddBufferView(ByteContainerView("defg", 4));
+  stream.AddBuffer("hi", 2);
+  EXPECT_EQ(stream.RemainingByteCount(), 9);
+
+  EXPECT_EQ(ReadBytes(&stream, 5), "abcde");
+  EXPECT_EQ(stream.ByteCount(), 5);
+  EXPECT_EQ(stream.RemainingBytes(), "fghi");
+
+  stream.Rewind();
+  EXPECT_EQ(ReadBytes(&stream, 9), "abcdefghi");
+  EXPECT_EQ(stream.RemainingByteCount(), 0);
+}
+
+TEST(MultiBufferInputStreamTest, ViewIsNotCopied) {
+  char view[] = "abcdef";
+  MultiBufferInputStream stream;
+  stream.AddBufferView(ByteContainerView(view, 6));
+
+  const void *data;
+  int size;
+  ASSERT_TRUE(stream.Next(&data, &size));
+  EXPECT_EQ(data, view);
+  EXPECT_EQ(size, 6);
+}
+
+TEST(MultiBufferInputStreamTest, CopyBufferViewsKeepsUnconsumedBytes) {
+  std::string first = "0123456789";
+  std::string second = "abcdef";
+  MultiBufferInputStream stream;
+  stream.AddBufferView(ByteContainerView(first));
+  stream.AddBufferView(ByteContainerView(second));
+
+  // Consume a frame and trim it, then start reading the next one.
+  ASSERT_TRUE(stream.Skip(4));
+  stream.TrimFront();
+  EXPECT_EQ(ReadBytes(&stream, 3), "456");
+
+  stream.CopyBufferViews();
+  first.assign(first.size(), 'x');
+  second.assign(second.size(), 'y');
+
+  EXPECT_EQ(stream.ByteCount(), 3);
+  EXPECT_EQ(stream.RemainingBytes(), "789abcdef");
+  stream.Rewind();
+  EXPECT_EQ(stream.RemainingByteCount(), 12);
+  EXPECT_EQ(ReadBytes(&stream, 12), "456789abcdef");
+}
+
+TEST(MultiBufferInputStreamTest, CopyBufferViewsAfterAllBytesAreConsumed) {
+  std::string bytes = "abc";
+  MultiBufferInputStream stream;
+  stream.AddBufferView(ByteContainerView(bytes));
+  ASSERT_TRUE(stream.Skip(3));
+  stream.TrimFront();
+  stream.CopyBufferViews();
+  EXPECT_EQ(stream.RemainingByteCount(), 0);
+
+  stream.AddBuffer("de", 2);
+  EXPECT_EQ(ReadBytes(&stream, 2), "de");
+}
+
+}  // namespace
+}  // namespace asylo
@@ -0,0 +1,222 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_GRPC_UTIL_ASYNC_ENCLAVE_SERVER_H_
+#define ASYLO_GRPC_UTIL_ASYNC_ENCLAVE_SERVER_H_
+
+#include <unistd.h>
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "absl/synchronization/mutex.h"
+#include "asylo/grpc/util/enclave_memory_quota.h"
+#include "asylo/grpc/util/enclave_server.h"
+#include "asylo/grpc/util/enclave_server.pb.h"
+#include "asylo/trusted_application.h"
+#include "asylo/util/logging.h"
+#include "asylo/util/status.h"
+#include "include/grpcpp/security/server_credentials.h"
+#include "include/grpcpp/server.h"
+#include "include/grpcpp/server_builder.h"
+
+namespace asylo {
+
+// A call in progress on an AsyncEnclaveServer. The address of each call is the
+// tag of the operations it starts on its completion queue, and the poller
+// thread of that queue calls Proceed() as each operation completes. A call
+// owns itself, and deletes itself once finished or once Proceed() is passed
+// false because the server is shutting down.
+class AsyncEnclaveCall {
+ public:
+  virtual ~AsyncEnclaveCall() = default;
+
+  // Advances the call after its last operation completed, successfully if |ok|
+  // is true.
+  virtual void Proceed(bool ok) = 0;
+};
+
+// Enclave for hosting an asynchronous gRPC service on a fixed number of
+// threads.
+//
+// gRPC's synchronous server, used by EnclaveServer, grows and shrinks its
+// thread pool with load, and every thread it creates inside the enclave is a
+// host thread donated to the enclave. AsyncEnclaveServer instead runs exactly
+// ServerConfig.poller_threads threads for the life of the server, each
+// polling its own completion queue, so the number of enclave threads is known
+// when choosing the enclave's TCS count.
+//
+// |AsyncServiceT| is a generated AsyncService type, or a WithAsyncMethod_
+// wrapper of one. The |request_calls| callback passed to the constructor
+// requests the first call of each method of the service on a completion
+// queue, by creating an AsyncEnclaveCall for each. It is run once for each
+// completion queue before polling starts, and each call requests its
+// successor when it starts being served.
+//
+// Configuration, Run() and Finalize() behave as for EnclaveServer.
+template <typename AsyncServiceT>
+class AsyncEnclaveServer final : public TrustedApplication {
+ public:
+  using RequestCallsCallback = std::function<void(
+      AsyncServiceT *service, ::grpc::ServerCompletionQueue *queue)>;
+
+  AsyncEnclaveServer(std::unique_ptr<AsyncServiceT> service,
+                     std::shared_ptr<::grpc::ServerCredentials> credentials,
+                     RequestCallsCallback request_calls)
+      : service_{std::move(service)},
+        credentials_{credentials},
+        request_calls_{std::move(request_calls)} {}
+  ~AsyncEnclaveServer() = default;
+
+  // From TrustedApplication.
+
+  Status Initialize(const EnclaveConfig &config) {
+    server_config_ = config.GetExtension(server_input_config);
+    host_ = server_config_.host();
+    port_ = server_config_.port();
+    LOG(INFO) << "gRPC server configured with address: " << host_ << ":"
+              << port_;
+    return InitializeServer();
+  }
+
+  Status Run(const EnclaveInput &input, EnclaveOutput *output) {
+    absl::MutexLock lock(&server_mutex_);
+    ServerConfig *config = output->MutableExtension(server_output_config);
+    config->set_host(host_);
+    config->set_port(port_);
+    return Status::OkStatus();
+  }
+
+  Status Finalize(const EnclaveFinal &enclave_final) {
+    FinalizeServer();
+    return Status::OkStatus();
+  }
+
+ private:
+  // Returns the number of poller threads to run.
+  int PollerThreadCount() const {
+    if (server_config_.poller_threads() > 0) {
+      return server_config_.poller_threads();
+    }
+    long processors = sysconf(_SC_NPROCESSORS_ONLN);
+    return processors > 0 ? static_cast<int>(processors) : 1;
+  }
+
+  // Builds and starts the server, then starts its poller threads. If the
+  // server is already initialized, does nothing.
+  Status InitializeServer() LOCKS_EXCLUDED(server_mutex_) {
+    absl::MutexLock lock(&server_mutex_);
+    if (server_) {
+      return Status::OkStatus();
+    }
+    if (!service_ || !request_calls_) {
+      return Status(error::GoogleError::INTERNAL, "No gRPC service configured");
+    }
+
+    int port;
+    ::grpc::ServerBuilder builder;
+    builder.AddListeningPort(absl::StrCat(host_, ":", port_), credentials_,
+                             &port);
+    builder.RegisterService(service_.get());
+    ApplyServerConfig(server_config_, &builder);
+    memory_quota_ = EnclaveMemoryQuota::Create(server_config_);
+    if (memory_quota_) {
+      builder.SetResourceQuota(memory_quota_->resource_quota());
+    }
+    int thread_count = PollerThreadCount();
+    for (int i = 0; i < thread_count; ++i) {
+      queues_.push_back(builder.AddCompletionQueue());
+    }
+    server_ = builder.BuildAndStart();
+    if (!server_) {
+      queues_.clear();
+      memory_quota_ = nullptr;
+      return Status(error::GoogleError::INTERNAL,
+                    "Failed to start gRPC server");
+    }
+    port_ = port;
+    LOG(INFO) << "gRPC server is listening on " << host_ << ":" << port_
+              << " with " << thread_count << " poller threads";
+
+    for (auto &queue : queues_) {
+      request_calls_(service_.get(), queue.get());
+    }
+    for (auto &queue : queues_) {
+      threads_.emplace_back(&AsyncEnclaveServer::Poll, queue.get());
+    }
+    return Status::OkStatus();
+  }
+
+  // Serves the calls of |queue| until it is shut down and drained.
+  static void Poll(::grpc::ServerCompletionQueue *queue) {
+    void *tag;
+    bool ok;
+    while (queue->Next(&tag, &ok)) {
+      static_cast<AsyncEnclaveCall *>(tag)->Proceed(ok);
+    }
+  }
+
+  // Shuts down the server, then its completion queues, and waits for the
+  // poller threads to drain them.
+  void FinalizeServer() LOCKS_EXCLUDED(server_mutex_) {
+    absl::MutexLock lock(&server_mutex_);
+    if (!server_) {
+      return;
+    }
+    LOG(INFO) << "Shutting down...";
+    server_->Shutdown();
+    for (auto &queue : queues_) {
+      queue->Shutdown();
+    }
+    for (std::thread &thread : threads_) {
+      thread.join();
+    }
+    threads_.clear();
+    server_ = nullptr;
+    queues_.clear();
+    memory_quota_ = nullptr;
+  }
+
+  // Guards state related to the gRPC server.
+  absl::Mutex server_mutex_;
+
+  std::unique_ptr<::grpc::Server> server_ GUARDED_BY(server_mutex_);
+  std::vector<std::unique_ptr<::grpc::ServerCompletionQueue>> queues_
+      GUARDED_BY(server_mutex_);
+  std::vector<std::thread> threads_ GUARDED_BY(server_mutex_);
+  std::unique_ptr<EnclaveMemoryQuota> memory_quota_ GUARDED_BY(server_mutex_);
+
+  // The host and port of the server's address.
+  std::string host_;
+  int port_;
+
+  // Limits and thread counts of the server.
+  ServerConfig server_config_;
+
+  std::unique_ptr<AsyncServiceT> service_;
+  std::shared_ptr<::grpc::ServerCredentials> credentials_;
+  RequestCallsCallback request_calls_;
+};
+
+}  // namespace asylo
+
+#endif  // ASYLO_GRPC_UTIL_ASYNC_ENCLAVE_SERVER_H_
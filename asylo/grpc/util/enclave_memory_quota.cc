@@ -0,0 +1,145 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/grpc/util/enclave_memory_quota.h"
+
+#include <algorithm>
+
+#include "asylo/util/logging.h"
+
+#ifdef __ASYLO__
+#include "asylo/platform/arch/include/trusted/heap.h"
+#endif  // __ASYLO__
+
+namespace asylo {
+namespace {
+
+// Name under which the quota appears in gRPC's traces.
+constexpr char kResourceQuotaName[] = "asylo_enclave_memory_quota";
+
+// Stores the size of the enclave heap and the bytes allocated from it in
+// |heap_size| and |in_use|. Returns false outside an enclave.
+bool GetHeapUsage(size_t *heap_size, size_t *in_use) {
+#ifdef __ASYLO__
+  enc_heap_usage usage;
+  enc_get_heap_usage(&usage);
+  *heap_size = usage.max_size;
+  *in_use = usage.in_use;
+  return true;
+#else
+  return false;
+#endif  // __ASYLO__
+}
+
+}  // namespace
+
+size_t ComputeEnclaveMemoryQuotaSize(size_t heap_size, size_t in_use,
+                                     size_t baseline_in_use,
+                                     size_t current_size, int percent,
+                                     int64_t max_bytes) {
+  size_t others_in_use = baseline_in_use;
+  if (in_use > current_size) {
+    others_in_use = std::max(others_in_use, in_use - current_size);
+  }
+  size_t headroom = heap_size > others_in_use ? heap_size - others_in_use : 0;
+  size_t size = headroom * std::min(std::max(percent, 0), 100) / 100;
+  if (max_bytes > 0) {
+    size = std::min(size, static_cast<size_t>(max_bytes));
+  }
+  return std::max(size, kMinEnclaveMemoryQuotaSize);
+}
+
+std::unique_ptr<EnclaveMemoryQuota> EnclaveMemoryQuota::Create(
+    const ServerConfig &config) {
+  if (config.memory_quota_percent() <= 0) {
+    return nullptr;
+  }
+  size_t heap_size;
+  size_t in_use;
+  if (!GetHeapUsage(&heap_size, &in_use)) {
+    LOG(WARNING) << "Enclave heap usage unavailable, no memory quota applied";
+    return nullptr;
+  }
+  std::unique_ptr<EnclaveMemoryQuota> quota(new EnclaveMemoryQuota(
+      config.memory_quota_percent(), config.memory_quota_max_bytes(), in_use,
+      absl::Milliseconds(config.memory_quota_refresh_ms())));
+  LOG(INFO) << "gRPC memory quota is " << quota->size() << " bytes of a "
+            << heap_size << "-byte heap with " << in_use << " bytes in use";
+  return quota;
+}
+
+EnclaveMemoryQuota::EnclaveMemoryQuota(int percent, int64_t max_bytes,
+                                       size_t baseline_in_use,
+                                       absl::Duration refresh_interval)
+    : percent_(percent),
+      max_bytes_(max_bytes),
+      baseline_in_use_(baseline_in_use),
+      refresh_interval_(refresh_interval),
+      resource_quota_(kResourceQuotaName),
+      size_(0),
+      shutting_down_(false) {
+  Refresh();
+  if (refresh_interval_ > absl::ZeroDuration()) {
+    refresh_thread_ = std::thread(&EnclaveMemoryQuota::RefreshLoop, this);
+  }
+}
+
+EnclaveMemoryQuota::~EnclaveMemoryQuota() {
+  {
+    absl::MutexLock lock(&mu_);
+    shutting_down_ = true;
+  }
+  if (refresh_thread_.joinable()) {
+    refresh_thread_.join();
+  }
+}
+
+void EnclaveMemoryQuota::Refresh() {
+  size_t heap_size;
+  size_t in_use;
+  if (!GetHeapUsage(&heap_size, &in_use)) {
+    return;
+  }
+  absl::MutexLock lock(&mu_);
+  size_t size = ComputeEnclaveMemoryQuotaSize(
+      heap_size, in_use, baseline_in_use_, size_, percent_, max_bytes_);
+  if (size != size_) {
+    resource_quota_.Resize(size);
+    size_ = size;
+  }
+}
+
+size_t EnclaveMemoryQuota::size() const {
+  absl::MutexLock lock(&mu_);
+  return size_;
+}
+
+void EnclaveMemoryQuota::RefreshLoop() {
+  while (true) {
+    {
+      absl::MutexLock lock(&mu_);
+      if (mu_.AwaitWithTimeout(absl::Condition(&shutting_down_),
+                               refresh_interval_)) {
+        return;
+      }
+    }
+    Refresh();
+  }
+}
+
+}  // namespace asylo
@@ -0,0 +1,110 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_GRPC_UTIL_ENCLAVE_MEMORY_QUOTA_H_
+#define ASYLO_GRPC_UTIL_ENCLAVE_MEMORY_QUOTA_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <thread>
+
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+#include "asylo/grpc/util/enclave_server.pb.h"
+#include "include/grpcpp/resource_quota.h"
+
+namespace asylo {
+
+// Smallest size of an EnclaveMemoryQuota, so that calls already in progress
+// can still finish when the heap is nearly exhausted.
+constexpr size_t kMinEnclaveMemoryQuotaSize = 256 * 1024;
+
+// Returns the size in bytes of a memory quota granting |percent| percent of
+// the heap not used by the rest of the enclave, capped at |max_bytes| if it is
+// positive.
+//
+// The heap has |heap_size| bytes of which |in_use| are allocated. Since the
+// gRPC buffers counted against the quota are part of |in_use|, the rest of the
+// enclave is taken to use the larger of |baseline_in_use|, the heap in use
+// when the quota was created, and |in_use| less the |current_size| of the
+// quota. The quota therefore stays the same while gRPC's buffers grow within
+// it, and shrinks as the rest of the enclave's memory grows.
+size_t ComputeEnclaveMemoryQuotaSize(size_t heap_size, size_t in_use,
+                                     size_t baseline_in_use,
+                                     size_t current_size, int percent,
+                                     int64_t max_bytes);
+
+// A grpc::ResourceQuota bounding the memory gRPC's buffers take from the
+// enclave heap, which is fixed in size when the enclave is built. When the
+// quota is used up, gRPC stops reading from connections until buffers are
+// released, so a burst of calls is throttled instead of exhausting the heap,
+// which would abort the enclave.
+//
+// The quota is sized from the heap usage when it is created and, if the
+// configuration sets a refresh interval, re-sized from the live heap usage on
+// a background thread. Outside an enclave the heap usage is unknown and no
+// quota is created.
+class EnclaveMemoryQuota {
+ public:
+  // Returns the quota configured by |config|, or nullptr if |config| sets no
+  // memory_quota_percent or the heap usage is unavailable.
+  static std::unique_ptr<EnclaveMemoryQuota> Create(const ServerConfig &config);
+
+  EnclaveMemoryQuota(const EnclaveMemoryQuota &) = delete;
+  EnclaveMemoryQuota &operator=(const EnclaveMemoryQuota &) = delete;
+
+  // Stops the refresh thread. Servers using the quota keep their reference to
+  // it and its last size.
+  ~EnclaveMemoryQuota();
+
+  // The quota to pass to grpc::ServerBuilder::SetResourceQuota().
+  const ::grpc::ResourceQuota &resource_quota() const {
+    return resource_quota_;
+  }
+
+  // Re-sizes the quota from the current heap usage.
+  void Refresh() LOCKS_EXCLUDED(mu_);
+
+  // Returns the current size of the quota in bytes.
+  size_t size() const LOCKS_EXCLUDED(mu_);
+
+ private:
+  EnclaveMemoryQuota(int percent, int64_t max_bytes, size_t baseline_in_use,
+                     absl::Duration refresh_interval);
+
+  // Runs Refresh() every |refresh_interval_| until the quota is destroyed.
+  void RefreshLoop() LOCKS_EXCLUDED(mu_);
+
+  const int percent_;
+  const int64_t max_bytes_;
+  const size_t baseline_in_use_;
+  const absl::Duration refresh_interval_;
+
+  ::grpc::ResourceQuota resource_quota_;
+
+  mutable absl::Mutex mu_;
+  size_t size_ GUARDED_BY(mu_);
+  bool shutting_down_ GUARDED_BY(mu_);
+
+  std::thread refresh_thread_;
+};
+
+}  // namespace asylo
+
+#endif  // ASYLO_GRPC_UTIL_ENCLAVE_MEMORY_QUOTA_H_
@@ -0,0 +1,70 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/grpc/util/enclave_memory_quota.h"
+
+#include <gtest/gtest.h>
+
+namespace asylo {
+namespace {
+
+constexpr size_t kMiB = 1024 * 1024;
+
+TEST(EnclaveMemoryQuotaTest, GrantsPercentOfFreeHeap) {
+  EXPECT_EQ(ComputeEnclaveMemoryQuotaSize(
+                /*heap_size=*/100 * kMiB, /*in_use=*/20 * kMiB,
+                /*baseline_in_use=*/20 * kMiB, /*current_size=*/0,
+                /*percent=*/50, /*max_bytes=*/0),
+            40 * kMiB);
+}
+
+TEST(EnclaveMemoryQuotaTest, KeepsSizeWhileBuffersGrowWithinQuota) {
+  // gRPC's buffers account for the 30 MiB allocated since the quota was
+  // sized, which is within its 40 MiB.
+  EXPECT_EQ(ComputeEnclaveMemoryQuotaSize(100 * kMiB, 50 * kMiB, 20 * kMiB,
+                                          40 * kMiB, 50, 0),
+            40 * kMiB);
+}
+
+TEST(EnclaveMemoryQuotaTest, ShrinksAsRestOfEnclaveGrows) {
+  // 80 MiB in use with a 40 MiB quota leaves at least 40 MiB to the rest of
+  // the enclave, which had 20 MiB.
+  EXPECT_EQ(ComputeEnclaveMemoryQuotaSize(100 * kMiB, 80 * kMiB, 20 * kMiB,
+                                          40 * kMiB, 50, 0),
+            30 * kMiB);
+}
+
+TEST(EnclaveMemoryQuotaTest, AppliesMaxBytes) {
+  EXPECT_EQ(ComputeEnclaveMemoryQuotaSize(100 * kMiB, 20 * kMiB, 20 * kMiB, 0,
+                                          50, 8 * kMiB),
+            8 * kMiB);
+}
+
+TEST(EnclaveMemoryQuotaTest, NeverFallsBelowMinimum) {
+  EXPECT_EQ(ComputeEnclaveMemoryQuotaSize(100 * kMiB, 100 * kMiB, 100 * kMiB,
+                                          0, 50, 0),
+            kMinEnclaveMemoryQuotaSize);
+}
+
+TEST(EnclaveMemoryQuotaTest, CreatesNoQuotaWhenDisabled) {
+  ServerConfig config;
+  EXPECT_EQ(EnclaveMemoryQuota::Create(config), nullptr);
+}
+
+}  // namespace
+}  // namespace asylo
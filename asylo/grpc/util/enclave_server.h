@@ -19,16 +19,23 @@
 #ifndef ASYLO_GRPC_UTIL_ENCLAVE_SERVER_H_
 #define ASYLO_GRPC_UTIL_ENCLAVE_SERVER_H_
 
+#include <algorithm>
+#include <functional>
 #include <memory>
 #include <string>
+#include <vector>
 
 #include "absl/strings/str_cat.h"
 #include "absl/synchronization/mutex.h"
+#include "asylo/grpc/auth/enclave_credentials_options.h"
+#include "asylo/grpc/auth/enclave_server_credentials.h"
 #include "asylo/util/logging.h"
+#include "asylo/grpc/util/enclave_memory_quota.h"
 #include "asylo/grpc/util/enclave_server.pb.h"
 #include "asylo/trusted_application.h"
 #include "asylo/util/status.h"
 #include "asylo/util/statusor.h"
+#include "include/grpc/grpc.h"
 #include "include/grpcpp/impl/codegen/service_type.h"
 #include "include/grpcpp/security/server_credentials.h"
 #include "include/grpcpp/server.h"
@@ -36,6 +43,33 @@
 
 namespace asylo {
 
+// Applies the stream and message limits and the transport tunables of |config|
+// to |builder|.
+inline void ApplyServerConfig(const ServerConfig &config,
+                              ::grpc::ServerBuilder *builder) {
+  if (config.max_concurrent_streams() > 0) {
+    builder->AddChannelArgument(GRPC_ARG_MAX_CONCURRENT_STREAMS,
+                                config.max_concurrent_streams());
+  }
+  if (config.max_receive_message_size() != 0) {
+    builder->SetMaxReceiveMessageSize(config.max_receive_message_size());
+  }
+  if (config.max_send_message_size() != 0) {
+    builder->SetMaxSendMessageSize(config.max_send_message_size());
+  }
+
+  EnclaveTransportOptions transport_options;
+  transport_options.socket_send_buffer_size = config.socket_send_buffer_size();
+  transport_options.socket_receive_buffer_size =
+      config.socket_receive_buffer_size();
+  transport_options.tcp_nodelay = config.tcp_nodelay();
+  transport_options.http2_initial_window_size =
+      config.http2_initial_window_size();
+  transport_options.keepalive_time_ms = config.keepalive_time_ms();
+  transport_options.keepalive_timeout_ms = config.keepalive_timeout_ms();
+  ApplyEnclaveTransportOptions(transport_options, builder);
+}
+
 // Enclave for hosting a gRPC service.
 //
 // The gRPC service and credentials are configurable in the constructor.
@@ -49,16 +83,34 @@ namespace asylo {
 // if the EnclaveConfig specified a port of 0 (indicates that the operating
 // system should select an available port).
 //
+// If the ServerConfig sets listener_shards above one, the enclave runs that
+// many servers bound to the same address with SO_REUSEPORT, each with its own
+// completion queue and pollers. Since a service can only be registered with
+// one server, sharding requires the constructor taking a service factory,
+// which is called once per shard.
+//
+// If the ServerConfig sets memory_quota_percent, the buffers of all shards
+// share one EnclaveMemoryQuota sized from the enclave heap.
+//
 // The server is shut down during Finalize(). To ensure proper server shutdown,
 // users of this class are expected to trigger enclave finalization by calling
 // EnclaveManager::DestroyEnclave() at some point during lifetime of their
 // application.
 class EnclaveServer final : public TrustedApplication {
  public:
+  // Creates a new instance of the service for one listener shard.
+  using ServiceFactory = std::function<std::unique_ptr<::grpc::Service>()>;
+
   EnclaveServer(std::unique_ptr<::grpc::Service> service,
                 std::shared_ptr<::grpc::ServerCredentials> credentials)
+      : running_{false}, credentials_{credentials} {
+    services_.push_back(std::move(service));
+  }
+
+  EnclaveServer(ServiceFactory service_factory,
+                std::shared_ptr<::grpc::ServerCredentials> credentials)
       : running_{false},
-        service_{std::move(service)},
+        service_factory_{std::move(service_factory)},
         credentials_{credentials} {}
   ~EnclaveServer() = default;
 
@@ -69,6 +121,7 @@ class EnclaveServer final : public TrustedApplication {
         config.GetExtension(server_input_config);
     host_ = config_server_proto.host();
     port_ = config_server_proto.port();
+    server_config_ = config_server_proto;
     LOG(INFO) << "gRPC server configured with address: " << host_ << ":"
               << port_;
     return InitializeServer();
@@ -85,44 +138,74 @@ class EnclaveServer final : public TrustedApplication {
   }
 
  private:
-  // Initializes a gRPC server. If the server is already initialized, does
-  // nothing.
+  // Initializes the gRPC servers of all listener shards. If the servers are
+  // already initialized, does nothing.
   Status InitializeServer() LOCKS_EXCLUDED(server_mutex_) {
-    // Ensure that the server is only created and initialized once.
+    // Ensure that the servers are only created and initialized once.
     absl::MutexLock lock(&server_mutex_);
-    if (server_) {
+    if (!servers_.empty()) {
       return Status::OkStatus();
     }
 
-    StatusOr<std::unique_ptr<::grpc::Server>> server_result = CreateServer();
-    if (!server_result.ok()) {
-      return server_result.status();
+    memory_quota_ = EnclaveMemoryQuota::Create(server_config_);
+    int shards = std::max(server_config_.listener_shards(), 1);
+    if (shards > 1 && !service_factory_) {
+      return Status(error::GoogleError::INVALID_ARGUMENT,
+                    "Listener shards require a service factory");
+    }
+    for (int shard = 0; shard < shards; ++shard) {
+      StatusOr<std::unique_ptr<::grpc::Server>> server_result =
+          CreateServer(shard, shards);
+      if (!server_result.ok()) {
+        ShutdownServers();
+        if (service_factory_) {
+          services_.clear();
+        }
+        return server_result.status();
+      }
+      servers_.push_back(std::move(server_result.ValueOrDie()));
     }
-
-    server_ = std::move(server_result.ValueOrDie());
     return Status::OkStatus();
   }
 
-  // Creates a gRPC server that hosts service_ on host_ and port_ with
-  // credentials_.
-  StatusOr<std::unique_ptr<::grpc::Server>> CreateServer()
+  // Creates the gRPC server of listener shard |shard| out of |shards|, hosting
+  // a service on host_ and port_ with credentials_. The first shard resolves
+  // port_ if it is zero, and later shards bind to the same port.
+  StatusOr<std::unique_ptr<::grpc::Server>> CreateServer(int shard, int shards)
       EXCLUSIVE_LOCKS_REQUIRED(server_mutex_) {
+    if (service_factory_) {
+      services_.push_back(service_factory_());
+    }
+    if (services_.size() <= static_cast<size_t>(shard) || !services_[shard]) {
+      return Status(error::GoogleError::INTERNAL, "No gRPC service configured");
+    }
+
     int port;
     ::grpc::ServerBuilder builder;
     builder.AddListeningPort(absl::StrCat(host_, ":", port_), credentials_,
                              &port);
-    if (!service_.get()) {
-      return Status(error::GoogleError::INTERNAL, "No gRPC service configured");
+    builder.RegisterService(services_[shard].get());
+    ApplyServerConfig(server_config_, &builder);
+    if (memory_quota_) {
+      builder.SetResourceQuota(memory_quota_->resource_quota());
+    }
+    if (server_config_.poller_threads() > 0) {
+      builder.SetSyncServerOption(::grpc::ServerBuilder::MAX_POLLERS,
+                                  server_config_.poller_threads());
+    }
+    if (shards > 1) {
+      builder.AddChannelArgument(GRPC_ARG_ALLOW_REUSEPORT, 1);
+      builder.SetSyncServerOption(::grpc::ServerBuilder::NUM_CQS, 1);
     }
-    builder.RegisterService(service_.get());
     std::unique_ptr<::grpc::Server> server = builder.BuildAndStart();
     if (!server) {
       return Status(error::GoogleError::INTERNAL,
-                    "Failed to start gRPC server");
+                    absl::StrCat("Failed to start gRPC server shard ", shard));
     }
 
     port_ = port;
-    LOG(INFO) << "gRPC server is listening on " << host_ << ":" << port_;
+    LOG(INFO) << "gRPC server shard " << shard << " is listening on " << host_
+              << ":" << port_;
 
     return std::move(server);
   }
@@ -136,21 +219,34 @@ class EnclaveServer final : public TrustedApplication {
     config->set_port(port_);
   }
 
-  // Finalizes the gRPC server by calling ::gprc::Server::Shutdown().
+  // Finalizes the gRPC servers by calling ::gprc::Server::Shutdown().
   void FinalizeServer() LOCKS_EXCLUDED(server_mutex_) {
     absl::MutexLock lock(&server_mutex_);
-    if (server_) {
+    if (!servers_.empty()) {
       LOG(INFO) << "Shutting down...";
-      server_->Shutdown();
-      server_ = nullptr;
+      ShutdownServers();
     }
   }
 
-  // Guards state related to the gRPC server (|server_| and |port_|).
+  // Shuts down and destroys all started servers and their memory quota.
+  void ShutdownServers() EXCLUSIVE_LOCKS_REQUIRED(server_mutex_) {
+    for (auto &server : servers_) {
+      server->Shutdown();
+    }
+    servers_.clear();
+    memory_quota_ = nullptr;
+  }
+
+  // Guards state related to the gRPC servers (|servers_| and |port_|).
   absl::Mutex server_mutex_;
 
-  // A gRPC server hosting |messenger_|.
-  std::unique_ptr<::grpc::Server> server_ GUARDED_BY(server_mutex);
+  // The gRPC servers of the listener shards, each hosting the service of the
+  // same index in |services_|.
+  std::vector<std::unique_ptr<::grpc::Server>> servers_
+      GUARDED_BY(server_mutex_);
+
+  // Bounds the memory of the servers' buffers, if configured.
+  std::unique_ptr<EnclaveMemoryQuota> memory_quota_ GUARDED_BY(server_mutex_);
 
   // Indicates whether the server has been started.
   bool running_;
@@ -159,7 +255,14 @@ class EnclaveServer final : public TrustedApplication {
   std::string host_;
   int port_;
 
-  std::unique_ptr<::grpc::Service> service_;
+  // Limits and thread counts of the server.
+  ServerConfig server_config_;
+
+  // Creates the service of each shard, if the server was constructed with a
+  // factory.
+  ServiceFactory service_factory_;
+
+  std::vector<std::unique_ptr<::grpc::Service>> services_;
   std::shared_ptr<::grpc::ServerCredentials> credentials_;
 };
 
@@ -17,10 +17,29 @@
  */
 
 #include "asylo/grpc/util/grpc_server_launcher.h"
+
+#include "absl/strings/numbers.h"
 #include "absl/synchronization/mutex.h"
 #include "asylo/util/logging.h"
+#include "include/grpc/grpc.h"
 
 namespace asylo {
+namespace {
+
+// Returns |address| with its port replaced by |port| if it specifies port 0,
+// or |address| unchanged otherwise.
+std::string BindSelectedPort(const std::string &address, int port) {
+  size_t colon = address.rfind(':');
+  int address_port;
+  if (colon == std::string::npos ||
+      !absl::SimpleAtoi(address.substr(colon + 1), &address_port) ||
+      address_port != 0) {
+    return address;
+  }
+  return absl::StrCat(address.substr(0, colon + 1), port);
+}
+
+}  // namespace
 
 Status GrpcServerLauncher::RegisterService(
     std::unique_ptr<::grpc::Service> service) {
@@ -29,11 +48,34 @@ Status GrpcServerLauncher::RegisterService(
     return MakeStatus(error::GoogleError::FAILED_PRECONDITION,
                       "Cannot add services after the server has started");
   }
-  builder_.RegisterService(service.get());
   services_.emplace_back(std::move(service));
   return Status::OkStatus();
 }
 
+Status GrpcServerLauncher::RegisterServiceFactory(ServiceFactory factory) {
+  absl::MutexLock lock(&mu_);
+  if (state_ != State::NOT_LAUNCHED) {
+    return MakeStatus(error::GoogleError::FAILED_PRECONDITION,
+                      "Cannot add services after the server has started");
+  }
+  service_factories_.emplace_back(std::move(factory));
+  return Status::OkStatus();
+}
+
+Status GrpcServerLauncher::SetListenerShards(int shards) {
+  absl::MutexLock lock(&mu_);
+  if (state_ != State::NOT_LAUNCHED) {
+    return MakeStatus(error::GoogleError::FAILED_PRECONDITION,
+                      "Cannot shard the server after it has started");
+  }
+  if (shards < 1) {
+    return MakeStatus(error::GoogleError::INVALID_ARGUMENT,
+                      "The server needs at least one shard");
+  }
+  shard_count_ = shards;
+  return Status::OkStatus();
+}
+
 Status GrpcServerLauncher::AddListeningPort(
     const std::string &address, std::shared_ptr<::grpc::ServerCredentials> creds,
     int *selected_port) {
@@ -43,22 +85,71 @@ Status GrpcServerLauncher::AddListeningPort(
         error::GoogleError::FAILED_PRECONDITION,
         "Cannot add address and creds after the server has started");
   }
-  builder_.AddListeningPort(address, std::move(creds), selected_port);
+  ports_.push_back({address, std::move(creds), selected_port});
   LOG(INFO) << "Added listening port \"" << address << "\" to the server";
   return Status::OkStatus();
 }
 
+Status GrpcServerLauncher::StartShard(int index) {
+  Shard shard;
+  shard.ports.resize(ports_.size(), 0);
+  ::grpc::ServerBuilder builder;
+  if (shard_count_ > 1) {
+    builder.AddChannelArgument(GRPC_ARG_ALLOW_REUSEPORT, 1);
+    builder.SetSyncServerOption(::grpc::ServerBuilder::NUM_CQS, 1);
+  }
+  for (size_t i = 0; i < ports_.size(); ++i) {
+    std::string address = ports_[i].address;
+    if (index > 0) {
+      address = BindSelectedPort(address, shards_[0].ports[i]);
+    }
+    builder.AddListeningPort(address, ports_[i].creds, &shard.ports[i]);
+  }
+  if (index == 0) {
+    for (auto &service : services_) {
+      builder.RegisterService(service.get());
+    }
+  }
+  for (const ServiceFactory &factory : service_factories_) {
+    shard.services.push_back(factory());
+    builder.RegisterService(shard.services.back().get());
+  }
+  shard.server = builder.BuildAndStart();
+  if (!shard.server) {
+    return MakeStatus(error::GoogleError::INTERNAL,
+                      absl::StrCat("Failed to start shard ", index));
+  }
+  shards_.push_back(std::move(shard));
+  return Status::OkStatus();
+}
+
 Status GrpcServerLauncher::Start() {
   absl::MutexLock lock(&mu_);
   if (state_ != State::NOT_LAUNCHED) {
     return MakeStatus(error::GoogleError::FAILED_PRECONDITION,
                       "Cannot start server more than once");
   }
-  server_ = builder_.BuildAndStart();
-  if (!server_) {
+  if (shard_count_ > 1 && !services_.empty()) {
     state_ = State::TERMINATED;
-    return MakeStatus(error::GoogleError::INTERNAL,
-                      "Failed to start the server ");
+    return MakeStatus(error::GoogleError::FAILED_PRECONDITION,
+                      "Services of a sharded server must be registered "
+                      "through RegisterServiceFactory");
+  }
+  for (int i = 0; i < shard_count_; ++i) {
+    Status status = StartShard(i);
+    if (!status.ok()) {
+      for (Shard &shard : shards_) {
+        shard.server->Shutdown();
+      }
+      shards_.clear();
+      state_ = State::TERMINATED;
+      return status;
+    }
+  }
+  for (size_t i = 0; i < ports_.size(); ++i) {
+    if (ports_[i].selected_port) {
+      *ports_[i].selected_port = shards_[0].ports[i];
+    }
   }
   state_ = State::LAUNCHED;
   return Status::OkStatus();
@@ -74,7 +165,9 @@ Status GrpcServerLauncher::Shutdown() {
                       "Cannot shutdown, the server has not started");
   }
 
-  server_->Shutdown();
+  for (Shard &shard : shards_) {
+    shard.server->Shutdown();
+  }
   state_ = State::TERMINATED;
 
   return Status::OkStatus();
@@ -83,8 +176,8 @@ Status GrpcServerLauncher::Shutdown() {
 Status GrpcServerLauncher::Wait() const {
   {
     // Grab the mutex mu_ only while checking the current state, but release it
-    // before calling server_->Wait(). Keeping mu_ locked while calling
-    // server_->Wait() makes it impossible to shut down the server.
+    // before calling server->Wait(). Keeping mu_ locked while calling
+    // server->Wait() makes it impossible to shut down the server.
     absl::MutexLock lock(&mu_);
     if (state_ != State::LAUNCHED) {
       return MakeStatus(error::GoogleError::FAILED_PRECONDITION,
@@ -93,8 +186,11 @@ Status GrpcServerLauncher::Wait() const {
   }
 
   // The ::grpc::Server object itself is thread-safe, and as a result, it is OK
-  // to call the Wait() method on this object without grabbing |mu_|.
-  server_->Wait();
+  // to call the Wait() method on this object without grabbing |mu_|. The set
+  // of shards does not change once the server has launched.
+  for (const Shard &shard : shards_) {
+    shard.server->Wait();
+  }
   return Status::OkStatus();
 }
 
@@ -105,4 +201,18 @@ GrpcServerLauncher::State GrpcServerLauncher::GetState() {
   return state_;
 }
 
+std::vector<GrpcServerLauncher::ShardStats> GrpcServerLauncher::GetShardStats()
+    const {
+  absl::MutexLock lock(&mu_);
+  std::vector<ShardStats> stats;
+  for (size_t i = 0; i < shards_.size(); ++i) {
+    int services = static_cast<int>(shards_[i].services.size());
+    if (i == 0) {
+      services += static_cast<int>(services_.size());
+    }
+    stats.push_back({static_cast<int>(i), shards_[i].ports, services});
+  }
+  return stats;
+}
+
 }  // namespace asylo
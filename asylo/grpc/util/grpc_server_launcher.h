@@ -19,6 +19,7 @@
 #ifndef ASYLO_GRPC_UTIL_GRPC_SERVER_LAUNCHER_H_
 #define ASYLO_GRPC_UTIL_GRPC_SERVER_LAUNCHER_H_
 
+#include <functional>
 #include <memory>
 #include <string>
 #include <vector>
@@ -76,6 +77,17 @@ namespace asylo {
 //  destroyed. Keeping the server running while the launcher is being destroyed
 //  may lead to unexpected/undesired behavior.
 //
+//  The launcher can also run several shards of the server, each a separate
+//  ::grpc::Server with its own completion queue and threads, listening on the
+//  same ports through SO_REUSEPORT. The host kernel then spreads incoming
+//  connections, and so their accept and handshake work, across the shards. A
+//  gRPC service object can only be hosted by one server, so each service of a
+//  sharded launcher is registered as a factory creating one instance per
+//  shard:
+//   launcher.SetListenerShards(4);
+//   launcher.RegisterServiceFactory(
+//       [] { return absl::make_unique<MyService>(); });
+//
 //  This class is thread-safe. The various methods of this class can be called
 //  from different threads without leaving the class in an internally
 //  inconsistent state. However, if callers do not follow the basic sanity
@@ -85,12 +97,36 @@ class GrpcServerLauncher {
  public:
   enum class State { NOT_LAUNCHED, LAUNCHED, TERMINATED };
 
+  // Creates an instance of a gRPC service for one shard.
+  using ServiceFactory = std::function<std::unique_ptr<::grpc::Service>()>;
+
+  // Describes one shard of a running server.
+  struct ShardStats {
+    // Index of the shard, from 0.
+    int shard;
+
+    // The ports the shard listens on, in the order they were added.
+    std::vector<int> ports;
+
+    // Number of gRPC services the shard hosts.
+    int services;
+  };
+
   GrpcServerLauncher(std::string name)
       : name_{std::move(name)}, state_{State::NOT_LAUNCHED} {}
 
   // Registers a gRPC service with the server. Takes ownership of |service|.
+  // Services registered this way can only be hosted by an unsharded server.
   Status RegisterService(std::unique_ptr<::grpc::Service> service);
 
+  // Registers a gRPC service with the server, created by calling |factory|
+  // once for each shard.
+  Status RegisterServiceFactory(ServiceFactory factory);
+
+  // Sets the number of shards the server runs, which defaults to 1. Each
+  // shard listens on every added port.
+  Status SetListenerShards(int shards);
+
   // Adds a listening port and associated credentials to the server. If
   // |selected_port| is not nullptr, then populates this value with the port
   // used once the server is started (i.e. via a call to Start()). The value of
@@ -119,7 +155,28 @@ class GrpcServerLauncher {
   // being modified.
   State GetState();
 
+  // Returns the state of each shard of a launched server.
+  std::vector<ShardStats> GetShardStats() const;
+
  private:
+  // A listening port added through AddListeningPort.
+  struct ListeningPort {
+    std::string address;
+    std::shared_ptr<::grpc::ServerCredentials> creds;
+    int *selected_port;
+  };
+
+  // A running shard of the server.
+  struct Shard {
+    std::vector<std::unique_ptr<::grpc::Service>> services;
+    std::vector<int> ports;
+    std::unique_ptr<::grpc::Server> server;
+  };
+
+  // Builds and starts shard |index|. Ports listed as 0 in |ports_| are bound
+  // to the ports selected by shard 0.
+  Status StartShard(int index) EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
   Status MakeStatus(error::GoogleError code, const std::string &message) const {
     return Status(code, absl::StrCat("Server ", name_, ": ", message));
   }
@@ -127,12 +184,14 @@ class GrpcServerLauncher {
   // Identifier for the server which is used for logging and debugging purposes.
   std::string name_;
 
-  // Mutex to protect server_, state_, services_, and builder_.
+  // Mutex to protect the state of the launcher and its shards.
   mutable absl::Mutex mu_;
   State state_;
+  int shard_count_ = 1;
   std::vector<std::unique_ptr<::grpc::Service>> services_;
-  std::unique_ptr<::grpc::Server> server_;
-  ::grpc::ServerBuilder builder_;
+  std::vector<ServiceFactory> service_factories_;
+  std::vector<ListeningPort> ports_;
+  std::vector<Shard> shards_;
 };
 
 }  // namespace asylo
@@ -39,7 +39,11 @@
 namespace asylo {
 namespace {
 
+using ::testing::Each;
+using ::testing::ElementsAre;
+using ::testing::Field;
 using ::testing::Not;
+using ::testing::SizeIs;
 
 constexpr char kMessengerClientName[] = "GrpcServerLauncherTest";
 constexpr char kLocalhostAddress[] = "[::1]";
@@ -121,6 +125,38 @@ class GrpcServerLauncherTest : public ::testing::Test {
     return status;
   }
 
+  // Launches a server like LaunchServer(), but as |shards| shards each
+  // hosting their own instances of the services.
+  Status LaunchShardedServer(int shards) {
+    Status status = launcher_.SetListenerShards(shards);
+    if (!status.ok()) {
+      return status;
+    }
+    status = launcher_.RegisterServiceFactory(
+        [] { return absl::make_unique<test::MessengerServer1>(); });
+    if (!status.ok()) {
+      return status;
+    }
+    status = launcher_.RegisterServiceFactory(
+        [] { return absl::make_unique<test::MessengerServer2>(); });
+    if (!status.ok()) {
+      return status;
+    }
+
+    int port;
+    status = launcher_.AddListeningPort(
+        server_address_, ::grpc::InsecureServerCredentials(), &port);
+    if (!status.ok()) {
+      return status;
+    }
+    status = launcher_.Start();
+    if (!status.ok()) {
+      return status;
+    }
+    server_address_ = absl::StrCat(kLocalhostAddress, ":", port);
+    return status;
+  }
+
   // Connects channel_ to the server listening on server_address_.
   bool ConnectChannel() {
     channel_ = ::grpc::CreateChannel(server_address_,
@@ -172,6 +208,44 @@ TEST_F(GrpcServerLauncherTest, TwoServiceSanityTest) {
   ASSERT_EQ(launcher_.GetState(), GrpcServerLauncher::State::TERMINATED);
 }
 
+// Verifies that a sharded server runs every shard on the port selected for the
+// first, and serves calls.
+TEST_F(GrpcServerLauncherTest, ShardedServer) {
+  ASSERT_THAT(LaunchShardedServer(3), IsOk());
+  std::vector<GrpcServerLauncher::ShardStats> stats =
+      launcher_.GetShardStats();
+  ASSERT_THAT(stats, SizeIs(3));
+  int port = stats[0].ports[0];
+  EXPECT_NE(port, 0);
+  EXPECT_THAT(stats, Each(Field(&GrpcServerLauncher::ShardStats::ports,
+                                ElementsAre(port))));
+  EXPECT_THAT(stats,
+              Each(Field(&GrpcServerLauncher::ShardStats::services, 2)));
+
+  // Each channel is a new connection, which may land on any shard.
+  for (int i = 0; i < 6; ++i) {
+    ASSERT_TRUE(ConnectChannel());
+    EXPECT_THAT(CallServices(), IsOk());
+  }
+
+  AsyncDelayedShutdownInvoker shutdown_invoker(&launcher_);
+  EXPECT_THAT(launcher_.Wait(), IsOk());
+}
+
+// Verifies that a sharded server refuses services which cannot be instantiated
+// for each shard.
+TEST_F(GrpcServerLauncherTest, ShardedServerNeedsServiceFactories) {
+  ASSERT_THAT(launcher_.SetListenerShards(2), IsOk());
+  ASSERT_THAT(
+      launcher_.RegisterService(absl::make_unique<test::MessengerServer1>()),
+      IsOk());
+  ASSERT_THAT(launcher_.AddListeningPort(server_address_,
+                                         ::grpc::InsecureServerCredentials()),
+              IsOk());
+  EXPECT_THAT(launcher_.Start(), Not(IsOk()));
+  EXPECT_THAT(launcher_.SetListenerShards(0), Not(IsOk()));
+}
+
 // Verifies that any attempt to register a service or to add a listening port to
 // a GrpcServerLauncher fails once the server has started.
 TEST_F(GrpcServerLauncherTest, ModifyAfterStart) {
@@ -29,8 +29,10 @@ namespace asylo {
 
 size_t AssertionDescriptionHasher::operator()(
     const AssertionDescription &description) const {
-  return std::hash<std::string>()(
-      SerializeAssertionDescription(description).ValueOrDie());
+  // Hash the two fields directly rather than their serialization, as this is
+  // called for every lookup in a hashed set of descriptions.
+  return std::hash<std::string>()(description.authority_type()) * 31 +
+         static_cast<size_t>(description.identity_type());
 }
 
 bool AssertionDescriptionEq::operator()(const AssertionDescription &lhs,
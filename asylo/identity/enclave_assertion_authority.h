@@ -20,6 +20,7 @@
 #define ASYLO_IDENTITY_ENCLAVE_ASSERTION_AUTHORITY_H_
 
 #include <string>
+#include <vector>
 
 #include "asylo/crypto/util/byte_container_util.h"
 #include "asylo/identity/identity.pb.h"
@@ -65,6 +66,28 @@ class EnclaveAssertionAuthority {
   /// \return The type of this authority.
   virtual std::string AuthorityType() const = 0;
 
+  /// Gets the descriptions of the assertion authorities that must be
+  /// initialized before this authority. A description names both the generator
+  /// and the verifier with its identity type and authority type, if they exist.
+  ///
+  /// InitializeEnclaveAssertionAuthorities() does not start initializing this
+  /// authority until all of its dependencies are initialized, and fails this
+  /// authority if any of them cannot be initialized. The default
+  /// implementation returns no dependencies.
+  ///
+  /// \return The descriptions of the authorities this authority depends on.
+  virtual std::vector<AssertionDescription> InitializationDependencies() const {
+    return {};
+  }
+
+  /// Indicates whether initialization of this assertion authority may be
+  /// deferred until it is first used, so that an authority that is slow to
+  /// initialize does not delay enclave startup. The default implementation
+  /// returns false.
+  ///
+  /// \return True if initialization of this authority may be deferred.
+  virtual bool IsInitializationDeferrable() const { return false; }
+
   /// Gets a unique identifier for an EnclaveAssertionAuthority with the given
   /// `identity_type` and `authority_type`.
   ///
@@ -21,6 +21,7 @@
 
 #include <string>
 
+#include <google/protobuf/arena.h>
 #include "asylo/identity/enclave_assertion_authority.h"
 #include "asylo/identity/identity.pb.h"
 #include "asylo/platform/common/static_map.h"
@@ -80,6 +81,27 @@ class EnclaveAssertionGenerator : public EnclaveAssertionAuthority {
   virtual Status Generate(const std::string &user_data,
                           const AssertionRequest &request,
                           Assertion *assertion) const = 0;
+
+  /// Generates an assertion as Generate() does, but allocates the protobuf
+  /// messages that are used only while generating the assertion on `arena`.
+  /// This lets a caller that generates several assertions, such as a
+  /// handshaker, free all of them together.
+  ///
+  /// The default implementation ignores `arena`.
+  ///
+  /// \param user_data User-provided binding data.
+  /// \param request A request to fulfill.
+  /// \param[out] assertion The generated assertion. It is not allocated on
+  ///                       `arena`.
+  /// \param arena The arena for temporary messages. May be null, in which case
+  ///              temporary messages are allocated on the heap.
+  /// \return A Status indicating whether an assertion was generated
+  ///         successfully.
+  virtual Status Generate(const std::string &user_data,
+                          const AssertionRequest &request, Assertion *assertion,
+                          google::protobuf::Arena *arena) const {
+    return Generate(user_data, request, assertion);
+  }
 };
 
 // \cond Internal
@@ -21,6 +21,7 @@
 
 #include <string>
 
+#include <google/protobuf/arena.h>
 #include "asylo/identity/enclave_assertion_authority.h"
 #include "asylo/identity/identity.pb.h"
 #include "asylo/platform/common/static_map.h"
@@ -80,6 +81,77 @@ class EnclaveAssertionVerifier : public EnclaveAssertionAuthority {
   ///         operation.
   virtual Status Verify(const std::string &user_data, const Assertion &assertion,
                         EnclaveIdentity *peer_identity) const = 0;
+
+  /// Verifies an assertion as Verify() does, but allocates the protobuf
+  /// messages that are used only while verifying the assertion on `arena`.
+  ///
+  /// The default implementation ignores `arena`.
+  ///
+  /// \param user_data User-provided binding data.
+  /// \param assertion An assertion to verify.
+  /// \param[out] peer_identity The identity extracted from the assertion. It
+  ///                           is not allocated on `arena`.
+  /// \param arena The arena for temporary messages. May be null, in which case
+  ///              temporary messages are allocated on the heap.
+  /// \return A Status indicating whether the assertion was verified
+  ///         successfully.
+  virtual Status Verify(const std::string &user_data,
+                        const Assertion &assertion,
+                        EnclaveIdentity *peer_identity,
+                        google::protobuf::Arena *arena) const {
+    return Verify(user_data, assertion, peer_identity);
+  }
+
+  /// Computes a digest of the portion of `assertion` that determines the
+  /// peer's identity, independent of the user data that the assertion is bound
+  /// to. Any two authentic assertions with the same digest must yield the same
+  /// identity from Verify().
+  ///
+  /// A verifier that implements both this method and VerifyBinding() allows
+  /// callers to cache the identity extracted by Verify() and to skip identity
+  /// extraction for later assertions from the same peer. The default
+  /// implementation returns UNIMPLEMENTED, which opts the verifier out of
+  /// caching.
+  ///
+  /// \param assertion An assertion compatible with this verifier.
+  /// \return The identity digest, or a non-OK Status if the digest could not
+  ///         be computed.
+  virtual StatusOr<std::string> GetIdentityDigest(
+      const Assertion &assertion) const {
+    return Status(error::GoogleError::UNIMPLEMENTED,
+                  "Verifier does not support identity caching");
+  }
+
+  /// Verifies that `assertion` is authentic, including the portion covered by
+  /// GetIdentityDigest(), and that it is bound to `user_data`, without
+  /// extracting the peer's identity. The caller is responsible for obtaining
+  /// the identity from a previous successful Verify() of an assertion with the
+  /// same identity digest.
+  ///
+  /// \param user_data User-provided binding data.
+  /// \param assertion An assertion to verify.
+  /// \return A Status indicating whether the assertion was verified
+  ///         successfully. The default implementation returns UNIMPLEMENTED.
+  virtual Status VerifyBinding(const std::string &user_data,
+                               const Assertion &assertion) const {
+    return Status(error::GoogleError::UNIMPLEMENTED,
+                  "Verifier does not support identity caching");
+  }
+
+  /// Verifies the binding of `assertion` as VerifyBinding() does, but
+  /// allocates temporary protobuf messages on `arena`, which may be null. The
+  /// default implementation ignores `arena`.
+  ///
+  /// \param user_data User-provided binding data.
+  /// \param assertion An assertion to verify.
+  /// \param arena The arena for temporary messages.
+  /// \return A Status indicating whether the assertion was verified
+  ///         successfully.
+  virtual Status VerifyBinding(const std::string &user_data,
+                               const Assertion &assertion,
+                               google::protobuf::Arena *arena) const {
+    return VerifyBinding(user_data, assertion);
+  }
 };
 
 // \cond Internal
@@ -20,6 +20,7 @@
 
 #include <google/protobuf/repeated_field.h>
 #include "absl/strings/str_cat.h"
+#include "asylo/identity/named_identity_expectation_matcher.h"
 #include "asylo/util/status.h"
 
 namespace asylo {
@@ -27,6 +28,14 @@ namespace {
 
 using google::protobuf::RepeatedPtrField;
 
+// Returns true if |lhs| and |rhs| describe the same kind of identity. Unlike
+// a MessageDifferencer comparison, this does not allocate.
+bool DescriptionsEqual(const EnclaveIdentityDescription &lhs,
+                       const EnclaveIdentityDescription &rhs) {
+  return lhs.identity_type() == rhs.identity_type() &&
+         lhs.authority_type() == rhs.authority_type();
+}
+
 // Uses |matcher| to evaluate |predicates| and returns true if any predicates
 // are fulfilled by |identities|.
 StatusOr<bool> EvaluateAclOrPredicateGroup(
@@ -156,4 +165,168 @@ StatusOr<bool> EvaluateIdentityAcl(
   }
 }
 
+StatusOr<std::unique_ptr<IdentityAclEvaluator>> IdentityAclEvaluator::Create(
+    const IdentityAclPredicate &acl) {
+  std::unique_ptr<IdentityAclEvaluator> evaluator(new IdentityAclEvaluator());
+  for (auto it = IdentityExpectationMatcherMap::value_begin();
+       it != IdentityExpectationMatcherMap::value_end(); ++it) {
+    evaluator->known_descriptions_.push_back(it->Description());
+  }
+
+  Status status = evaluator->Compile(acl);
+  if (!status.ok()) {
+    return status;
+  }
+  return std::move(evaluator);
+}
+
+StatusOr<bool> IdentityAclEvaluator::Evaluate(
+    const EnclaveIdentities &identities) const {
+  return EvaluateNode(0, identities);
+}
+
+Status IdentityAclEvaluator::Compile(const IdentityAclPredicate &acl) {
+  size_t index = nodes_.size();
+  nodes_.emplace_back();
+
+  switch (acl.item_case()) {
+    case IdentityAclPredicate::kAclGroup: {
+      const IdentityAclGroup &acl_group = acl.acl_group();
+      if (acl_group.predicates().empty()) {
+        return Status(error::GoogleError::INVALID_ARGUMENT,
+                      "ACL predicate groups cannot be empty");
+      }
+
+      switch (acl_group.type()) {
+        case IdentityAclGroup::OR:
+          nodes_[index].type = Node::OR;
+          break;
+        case IdentityAclGroup::AND:
+          nodes_[index].type = Node::AND;
+          break;
+        case IdentityAclGroup::NOT:
+          if (acl_group.predicates_size() != 1) {
+            return Status(error::GoogleError::INVALID_ARGUMENT,
+                          "NOT predicate groups must have exactly one element");
+          }
+          nodes_[index].type = Node::NOT;
+          break;
+        default:
+          return Status(
+              error::GoogleError::INVALID_ARGUMENT,
+              absl::StrCat("Unknown acl_group type: ", acl_group.type()));
+      }
+
+      for (const IdentityAclPredicate &predicate : acl_group.predicates()) {
+        Status status = Compile(predicate);
+        if (!status.ok()) {
+          return status;
+        }
+      }
+      break;
+    }
+    case IdentityAclPredicate::kExpectation: {
+      const EnclaveIdentityDescription &description =
+          acl.expectation().reference_identity().description();
+      StatusOr<std::string> name_result =
+          NamedIdentityExpectationMatcher::GetMatcherName(description);
+      if (!name_result.ok()) {
+        return name_result.status();
+      }
+      auto matcher_it =
+          IdentityExpectationMatcherMap::GetValue(name_result.ValueOrDie());
+      if (matcher_it == IdentityExpectationMatcherMap::value_end()) {
+        return Status(error::GoogleError::INTERNAL,
+                      absl::StrCat("No matcher exists for matching expectation "
+                                   "with reference-identity description ",
+                                   description.ShortDebugString()));
+      }
+
+      auto prepare_result = matcher_it->PrepareExpectation(acl.expectation());
+      if (!prepare_result.ok()) {
+        return prepare_result.status();
+      }
+      nodes_[index].type = Node::EXPECTATION;
+      nodes_[index].expectation = std::move(prepare_result).ValueOrDie();
+      nodes_[index].description = description;
+      break;
+    }
+    case IdentityAclPredicate::ITEM_NOT_SET:
+      return Status(
+          error::GoogleError::INVALID_ARGUMENT,
+          "Invalid ACL predicate: must be either a group or an expectation.");
+    default:
+      return Status(error::GoogleError::INVALID_ARGUMENT,
+                    absl::StrCat("Unknown acl item: ", acl.item_case()));
+  }
+
+  nodes_[index].end = nodes_.size();
+  return Status::OkStatus();
+}
+
+StatusOr<bool> IdentityAclEvaluator::EvaluateNode(
+    size_t index, const EnclaveIdentities &identities) const {
+  const Node &node = nodes_[index];
+  if (node.type == Node::EXPECTATION) {
+    return EvaluateExpectation(node, identities);
+  }
+
+  // OR groups are satisfied by their first true child, AND groups are
+  // falsified by their first false child, and NOT groups have one child.
+  const bool short_circuit_value = node.type == Node::OR;
+  for (size_t child = index + 1; child < node.end; child = nodes_[child].end) {
+    StatusOr<bool> result = EvaluateNode(child, identities);
+    if (!result.ok()) {
+      return result;
+    }
+
+    if (node.type == Node::NOT) {
+      return !result.ValueOrDie();
+    }
+    if (result.ValueOrDie() == short_circuit_value) {
+      return short_circuit_value;
+    }
+  }
+  return !short_circuit_value;
+}
+
+StatusOr<bool> IdentityAclEvaluator::EvaluateExpectation(
+    const Node &node, const EnclaveIdentities &identities) const {
+  for (const EnclaveIdentity &identity : identities.identities()) {
+    if (!DescriptionsEqual(identity.description(), node.description)) {
+      // As with DelegatingIdentityExpectationMatcher, an identity that no
+      // matcher can handle is an error, while an identity of another known
+      // kind simply does not match.
+      if (!IsKnownDescription(identity.description())) {
+        return Status(
+            error::GoogleError::INTERNAL,
+            absl::StrCat("No matcher exists for identity with description ",
+                         identity.description().ShortDebugString()));
+      }
+      continue;
+    }
+
+    StatusOr<bool> result = node.expectation->Match(identity);
+    if (!result.ok()) {
+      return result;
+    }
+
+    if (result.ValueOrDie()) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+bool IdentityAclEvaluator::IsKnownDescription(
+    const EnclaveIdentityDescription &description) const {
+  for (const EnclaveIdentityDescription &known : known_descriptions_) {
+    if (DescriptionsEqual(description, known)) {
+      return true;
+    }
+  }
+  return false;
+}
+
 }  // namespace asylo
@@ -19,9 +19,13 @@
 #ifndef ASYLO_IDENTITY_IDENTITY_ACL_EVALUATOR_H_
 #define ASYLO_IDENTITY_IDENTITY_ACL_EVALUATOR_H_
 
+#include <memory>
+#include <vector>
+
 #include "asylo/identity/identity.pb.h"
 #include "asylo/identity/identity_acl.pb.h"
 #include "asylo/identity/identity_expectation_matcher.h"
+#include "asylo/identity/named_identity_expectation_matcher.h"
 #include "asylo/util/statusor.h"
 
 namespace asylo {
@@ -50,6 +54,84 @@ StatusOr<bool> EvaluateIdentityAcl(
     const std::vector<EnclaveIdentity> &identities,
     const IdentityAclPredicate &acl, const IdentityExpectationMatcher &matcher);
 
+/// An ACL that has been compiled once for repeated evaluation, such as for
+/// authorizing every RPC on a connection.
+///
+/// An `IdentityAclEvaluator` flattens the predicate tree of an ACL, resolves
+/// the matcher of each expectation from the program-wide map of
+/// `NamedIdentityExpectationMatcher`s, and has each matcher prepare its
+/// expectations in advance. Evaluate() then walks the flattened tree without
+/// allocating, apart from whatever the matchers allocate to interpret the
+/// identities themselves.
+///
+/// Evaluate() returns the same results as EvaluateIdentityAcl() with a
+/// `DelegatingIdentityExpectationMatcher`, except that malformed ACLs and
+/// expectations that no linked-in matcher can handle are rejected by Create().
+///
+/// An `IdentityAclEvaluator` is immutable, and is thread-safe.
+class IdentityAclEvaluator {
+ public:
+  /// Compiles `acl`, which must conform to the constraints documented for
+  /// EvaluateIdentityAcl().
+  ///
+  /// \param acl The ACL to compile.
+  /// \return The evaluator, or a non-OK Status if `acl` is malformed or
+  ///         refers to an expectation that no matcher can handle.
+  static StatusOr<std::unique_ptr<IdentityAclEvaluator>> Create(
+      const IdentityAclPredicate &acl);
+
+  IdentityAclEvaluator(const IdentityAclEvaluator &other) = delete;
+  IdentityAclEvaluator &operator=(const IdentityAclEvaluator &other) = delete;
+
+  /// Evaluates whether `identities` satisfies the ACL.
+  ///
+  /// \param identities The identities to match against the ACL.
+  /// \return A bool indicating whether the ACL evaluated to true, or a non-OK
+  ///         Status if any of `identities` cannot be handled by any matcher or
+  ///         if a matcher fails.
+  StatusOr<bool> Evaluate(const EnclaveIdentities &identities) const;
+
+ private:
+  // A node of the flattened predicate tree. The children of a group node are
+  // stored after it, each followed by its own subtree.
+  struct Node {
+    enum Type { EXPECTATION, AND, OR, NOT };
+
+    Type type;
+
+    // The index one past the last node of the subtree rooted at this node.
+    size_t end;
+
+    // For an EXPECTATION node, the expectation as prepared by its matcher, and
+    // the description of the identities that it can match.
+    std::unique_ptr<NamedIdentityExpectationMatcher::PreparedExpectation>
+        expectation;
+    EnclaveIdentityDescription description;
+  };
+
+  IdentityAclEvaluator() = default;
+
+  // Appends the nodes of |acl| to |nodes_|.
+  Status Compile(const IdentityAclPredicate &acl);
+
+  // Evaluates the subtree rooted at |nodes_|[|index|] against |identities|.
+  StatusOr<bool> EvaluateNode(size_t index,
+                              const EnclaveIdentities &identities) const;
+
+  // Evaluates the EXPECTATION node |node| against |identities|.
+  StatusOr<bool> EvaluateExpectation(const Node &node,
+                                     const EnclaveIdentities &identities) const;
+
+  // Returns true if some registered matcher handles identities with
+  // |description|.
+  bool IsKnownDescription(const EnclaveIdentityDescription &description) const;
+
+  std::vector<Node> nodes_;
+
+  // The descriptions handled by the registered matchers.
+  std::vector<EnclaveIdentityDescription> known_descriptions_;
+};
+
 }  // namespace asylo
 
 #endif  // ASYLO_IDENTITY_IDENTITY_ACL_EVALUATOR_H_
@@ -0,0 +1,192 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/identity/identity_acl_evaluator.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <google/protobuf/util/message_differencer.h>
+#include <gtest/gtest.h>
+#include "asylo/identity/delegating_identity_expectation_matcher.h"
+#include "asylo/identity/identity.pb.h"
+#include "asylo/identity/identity_acl.pb.h"
+#include "asylo/identity/named_identity_expectation_matcher.h"
+#include "asylo/platform/common/static_map.h"
+#include "asylo/test/util/status_matchers.h"
+#include "asylo/util/statusor.h"
+
+namespace asylo {
+namespace {
+
+using ::testing::Not;
+
+// Makes an identity description whose authority_type string is constructed
+// based on the template parameter |C|.
+template <char C>
+EnclaveIdentityDescription MakeDescription() {
+  EnclaveIdentityDescription description;
+  description.set_identity_type(UNKNOWN_IDENTITY);
+  description.set_authority_type(std::string(4, C));
+  return description;
+}
+
+template <char C>
+EnclaveIdentity MakeIdentity(std::string id) {
+  EnclaveIdentity identity;
+  *identity.mutable_description() = MakeDescription<C>();
+  identity.set_identity(std::move(id));
+  return identity;
+}
+
+template <char C>
+IdentityAclPredicate MakeExpectationPredicate(std::string id) {
+  IdentityAclPredicate predicate;
+  *predicate.mutable_expectation()->mutable_reference_identity() =
+      MakeIdentity<C>(std::move(id));
+  return predicate;
+}
+
+IdentityAclPredicate MakeGroupPredicate(
+    IdentityAclGroup::GroupType type,
+    const std::vector<IdentityAclPredicate> &predicates) {
+  IdentityAclPredicate predicate;
+  predicate.mutable_acl_group()->set_type(type);
+  for (const IdentityAclPredicate &child : predicates) {
+    *predicate.mutable_acl_group()->add_predicates() = child;
+  }
+  return predicate;
+}
+
+// Matcher whose Description().authority_type() string is constructed based on
+// the template parameter |C|, and which considers an identity to match an
+// expectation if the identity simply equals the expectation's reference
+// identity.
+template <char C>
+class TestMatcher final : public NamedIdentityExpectationMatcher {
+ public:
+  TestMatcher() = default;
+  ~TestMatcher() override = default;
+
+  EnclaveIdentityDescription Description() const override {
+    return MakeDescription<C>();
+  }
+
+  StatusOr<bool> Match(
+      const EnclaveIdentity &identity,
+      const EnclaveIdentityExpectation &expectation) const override {
+    if (!::google::protobuf::util::MessageDifferencer::Equivalent(
+            identity.description(), Description()) ||
+        !::google::protobuf::util::MessageDifferencer::Equivalent(
+            expectation.reference_identity().description(), Description())) {
+      return Status(error::GoogleError::INTERNAL, "Incorrect description");
+    }
+    return identity.identity() == expectation.reference_identity().identity();
+  }
+};
+
+using TestMatcherA = TestMatcher<'A'>;
+using TestMatcherB = TestMatcher<'B'>;
+
+SET_STATIC_MAP_VALUE_OF_DERIVED_TYPE(IdentityExpectationMatcherMap,
+                                     TestMatcherA);
+SET_STATIC_MAP_VALUE_OF_DERIVED_TYPE(IdentityExpectationMatcherMap,
+                                     TestMatcherB);
+
+// Returns an ACL that is satisfied by identity A "foo", or by identity B "bar"
+// together with anything other than identity A "baz".
+IdentityAclPredicate MakeTestAcl() {
+  return MakeGroupPredicate(
+      IdentityAclGroup::OR,
+      {MakeExpectationPredicate<'A'>("foo"),
+       MakeGroupPredicate(
+           IdentityAclGroup::AND,
+           {MakeExpectationPredicate<'B'>("bar"),
+            MakeGroupPredicate(IdentityAclGroup::NOT,
+                               {MakeExpectationPredicate<'A'>("baz")})})});
+}
+
+// Verify that the compiled ACL agrees with EvaluateIdentityAcl() on various
+// sets of identities.
+TEST(IdentityAclEvaluatorTest, AgreesWithEvaluateIdentityAcl) {
+  IdentityAclPredicate acl = MakeTestAcl();
+  auto evaluator_result = IdentityAclEvaluator::Create(acl);
+  ASSERT_THAT(evaluator_result, IsOk());
+  std::unique_ptr<IdentityAclEvaluator> evaluator =
+      std::move(evaluator_result).ValueOrDie();
+
+  const std::vector<std::vector<EnclaveIdentity>> identity_sets = {
+      {},
+      {MakeIdentity<'A'>("foo")},
+      {MakeIdentity<'B'>("bar")},
+      {MakeIdentity<'B'>("bar"), MakeIdentity<'A'>("baz")},
+      {MakeIdentity<'A'>("baz"), MakeIdentity<'A'>("foo")},
+      {MakeIdentity<'B'>("foo"), MakeIdentity<'A'>("bar")},
+  };
+  const std::vector<bool> expected_results = {false, true,  true,
+                                              false, true,  false};
+
+  DelegatingIdentityExpectationMatcher matcher;
+  for (size_t i = 0; i < identity_sets.size(); ++i) {
+    EnclaveIdentities identities;
+    for (const EnclaveIdentity &identity : identity_sets[i]) {
+      *identities.add_identities() = identity;
+    }
+
+    StatusOr<bool> result = evaluator->Evaluate(identities);
+    ASSERT_THAT(result, IsOk());
+    EXPECT_EQ(result.ValueOrDie(), expected_results[i]) << "at index " << i;
+
+    StatusOr<bool> reference_result =
+        EvaluateIdentityAcl(identity_sets[i], acl, matcher);
+    ASSERT_THAT(reference_result, IsOk());
+    EXPECT_EQ(result.ValueOrDie(), reference_result.ValueOrDie())
+        << "at index " << i;
+  }
+}
+
+// Verify that Create() rejects malformed ACLs and expectations that no matcher
+// can handle.
+TEST(IdentityAclEvaluatorTest, CreateFailsOnInvalidAcl) {
+  const std::vector<IdentityAclPredicate> invalid_acls = {
+      IdentityAclPredicate(),
+      MakeGroupPredicate(IdentityAclGroup::OR, {}),
+      MakeGroupPredicate(IdentityAclGroup::NOT,
+                         {MakeExpectationPredicate<'A'>("foo"),
+                          MakeExpectationPredicate<'A'>("bar")}),
+      MakeExpectationPredicate<'C'>("foo"),
+  };
+  for (const IdentityAclPredicate &acl : invalid_acls) {
+    EXPECT_THAT(IdentityAclEvaluator::Create(acl), Not(IsOk()))
+        << acl.ShortDebugString();
+  }
+}
+
+// Verify that evaluating an identity that no matcher can handle fails.
+TEST(IdentityAclEvaluatorTest, EvaluateFailsOnUnknownIdentity) {
+  auto evaluator_result = IdentityAclEvaluator::Create(MakeTestAcl());
+  ASSERT_THAT(evaluator_result, IsOk());
+
+  EnclaveIdentities identities;
+  *identities.add_identities() = MakeIdentity<'C'>("foo");
+  EXPECT_THAT(evaluator_result.ValueOrDie()->Evaluate(identities), Not(IsOk()));
+}
+
+}  // namespace
+}  // namespace asylo
@@ -0,0 +1,430 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/identity/init.h"
+
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <thread>
+#include <unordered_map>
+
+#include "absl/synchronization/mutex.h"
+#include "absl/time/clock.h"
+#include "asylo/util/statusor.h"
+
+namespace asylo {
+namespace {
+
+// An authority whose initialization was deferred until first use, along with
+// the authorities it depends on.
+struct DeferredAuthority {
+  internal::AssertionAuthorityInitTask task;
+  std::vector<EnclaveAssertionAuthority *> dependencies;
+};
+
+// Guards the deferred authorities.
+absl::Mutex *DeferredAuthoritiesMutex() {
+  static absl::Mutex *mu = new absl::Mutex();
+  return mu;
+}
+
+// Returns the authorities whose initialization is deferred. Must be accessed
+// with DeferredAuthoritiesMutex() held.
+std::vector<DeferredAuthority> *DeferredAuthorities() {
+  static std::vector<DeferredAuthority> *authorities =
+      new std::vector<DeferredAuthority>();
+  return authorities;
+}
+
+// The number of deferred authorities, which lets the common case of no
+// deferred authorities avoid taking DeferredAuthoritiesMutex().
+std::atomic<int> num_deferred_authorities(0);
+
+// The number of authorities initialized so far. See
+// AssertionAuthorityGeneration().
+std::atomic<uint64_t> authority_generation(0);
+
+// Initializes |task|.authority with each of |task|.configs in turn until it is
+// initialized. Returns the last error that occurred, if any.
+Status RunInitializationTask(const internal::AssertionAuthorityInitTask &task) {
+  Status result = Status::OkStatus();
+  bool was_initialized = task.authority->IsInitialized();
+  for (const std::string &config : task.configs) {
+    Status status = internal::TryInitialize(config, task.authority);
+    if (!status.ok()) {
+      result = status;
+    }
+  }
+  if (!was_initialized && task.authority->IsInitialized()) {
+    authority_generation.fetch_add(1, std::memory_order_release);
+  }
+  return result;
+}
+
+// Returns the identifiers of the authorities that |authority| depends on.
+StatusOr<std::vector<std::string>> GetDependencyIds(
+    const EnclaveAssertionAuthority &authority) {
+  std::vector<std::string> dependency_ids;
+  for (const AssertionDescription &description :
+       authority.InitializationDependencies()) {
+    StatusOr<std::string> authority_id_result =
+        EnclaveAssertionAuthority::GenerateAuthorityId(
+            description.identity_type(), description.authority_type());
+    if (!authority_id_result.ok()) {
+      return authority_id_result.status();
+    }
+    dependency_ids.push_back(std::move(authority_id_result).ValueOrDie());
+  }
+  return dependency_ids;
+}
+
+// Adds |authority| and |dependencies| to the deferred authorities, unless
+// |authority| is already deferred.
+void DeferAuthority(const internal::AssertionAuthorityInitTask &task,
+                    std::vector<EnclaveAssertionAuthority *> dependencies) {
+  absl::MutexLock lock(DeferredAuthoritiesMutex());
+  std::vector<DeferredAuthority> *deferred = DeferredAuthorities();
+  for (const DeferredAuthority &entry : *deferred) {
+    if (entry.task.authority == task.authority) {
+      return;
+    }
+  }
+  deferred->push_back({task, std::move(dependencies)});
+  num_deferred_authorities.fetch_add(1, std::memory_order_release);
+}
+
+// Initializes |authority| and the deferred authorities it depends on if
+// |authority| is deferred. Each deferred authority is only attempted once.
+Status InitializeDeferredAuthorityLocked(EnclaveAssertionAuthority *authority)
+    EXCLUSIVE_LOCKS_REQUIRED(*DeferredAuthoritiesMutex()) {
+  std::vector<DeferredAuthority> *deferred = DeferredAuthorities();
+  auto it = std::find_if(deferred->begin(), deferred->end(),
+                         [authority](const DeferredAuthority &entry) {
+                           return entry.task.authority == authority;
+                         });
+  if (it == deferred->end()) {
+    return Status::OkStatus();
+  }
+
+  DeferredAuthority entry = std::move(*it);
+  deferred->erase(it);
+  num_deferred_authorities.fetch_sub(1, std::memory_order_release);
+
+  for (EnclaveAssertionAuthority *dependency : entry.dependencies) {
+    InitializeDeferredAuthorityLocked(dependency);
+    if (!dependency->IsInitialized()) {
+      Status status(error::GoogleError::FAILED_PRECONDITION,
+                    "Assertion authority depends on an assertion authority "
+                    "that is not initialized");
+      LOG(ERROR) << status;
+      return status;
+    }
+  }
+
+  absl::Time start = absl::Now();
+  Status status = RunInitializationTask(entry.task);
+  VLOG(1) << "Deferred initialization of assertion "
+          << (entry.task.is_generator ? "generator " : "verifier ")
+          << entry.task.authority->IdentityType() << "/"
+          << entry.task.authority->AuthorityType() << " took "
+          << absl::FormatDuration(absl::Now() - start) << ": " << status;
+  return status;
+}
+
+// Runs initialization tasks on one or more threads, starting each task once
+// all of the tasks it depends on are done.
+class InitializationScheduler {
+ public:
+  InitializationScheduler(
+      const std::vector<internal::AssertionAuthorityInitTask> *tasks,
+      std::vector<Status> *statuses,
+      const std::vector<std::vector<size_t>> *dependencies,
+      const std::vector<std::vector<size_t>> *dependents,
+      std::vector<size_t> *num_pending_dependencies)
+      : tasks_(tasks),
+        dependencies_(dependencies),
+        dependents_(dependents),
+        statuses_(statuses),
+        num_pending_dependencies_(num_pending_dependencies),
+        done_(tasks->size(), false),
+        durations_(tasks->size(), absl::ZeroDuration()) {}
+
+  // Marks task |index| as ready to run. Must not be called concurrently with
+  // Work().
+  void AddReadyTask(size_t index) {
+    absl::MutexLock lock(&mu_);
+    ready_.push_back(index);
+  }
+
+  // Runs ready tasks until no task is ready or running.
+  void Work() {
+    absl::MutexLock lock(&mu_);
+    while (true) {
+      mu_.Await(
+          absl::Condition(this, &InitializationScheduler::HasWorkOrIsIdle));
+      if (ready_.empty()) {
+        return;
+      }
+      size_t index = ready_.front();
+      ready_.pop_front();
+      ++num_running_;
+
+      // A task whose dependencies failed is not attempted.
+      Status status = (*statuses_)[index];
+      if (status.ok()) {
+        for (size_t dependency : (*dependencies_)[index]) {
+          if (!(*tasks_)[dependency].authority->IsInitialized()) {
+            status = Status(error::GoogleError::FAILED_PRECONDITION,
+                            "Assertion authority depends on an assertion "
+                            "authority that could not be initialized");
+            break;
+          }
+        }
+      }
+
+      absl::Duration duration = absl::ZeroDuration();
+      if (status.ok()) {
+        mu_.Unlock();
+        absl::Time start = absl::Now();
+        status = RunInitializationTask((*tasks_)[index]);
+        duration = absl::Now() - start;
+        mu_.Lock();
+      }
+
+      (*statuses_)[index] = status;
+      durations_[index] = duration;
+      done_[index] = true;
+      --num_running_;
+      for (size_t dependent : (*dependents_)[index]) {
+        if (--(*num_pending_dependencies_)[dependent] == 0) {
+          ready_.push_back(dependent);
+        }
+      }
+    }
+  }
+
+  // Returns whether task |index| ran. Must not be called concurrently with
+  // Work().
+  bool IsDone(size_t index) const {
+    absl::MutexLock lock(&mu_);
+    return done_[index];
+  }
+
+  // Returns the time spent initializing task |index|. Must not be called
+  // concurrently with Work().
+  absl::Duration Duration(size_t index) const {
+    absl::MutexLock lock(&mu_);
+    return durations_[index];
+  }
+
+ private:
+  bool HasWorkOrIsIdle() const EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+    return !ready_.empty() || num_running_ == 0;
+  }
+
+  const std::vector<internal::AssertionAuthorityInitTask> *const tasks_;
+  const std::vector<std::vector<size_t>> *const dependencies_;
+  const std::vector<std::vector<size_t>> *const dependents_;
+
+  mutable absl::Mutex mu_;
+  std::vector<Status> *const statuses_ GUARDED_BY(mu_);
+  std::vector<size_t> *const num_pending_dependencies_ GUARDED_BY(mu_);
+  std::deque<size_t> ready_ GUARDED_BY(mu_);
+  std::vector<bool> done_ GUARDED_BY(mu_);
+  std::vector<absl::Duration> durations_ GUARDED_BY(mu_);
+  int num_running_ GUARDED_BY(mu_) = 0;
+};
+
+}  // namespace
+
+namespace internal {
+
+void AddAssertionAuthorityConfig(
+    EnclaveAssertionAuthority *authority, const std::string &authority_id,
+    bool is_generator, const std::string &config,
+    std::vector<AssertionAuthorityInitTask> *tasks) {
+  for (AssertionAuthorityInitTask &task : *tasks) {
+    if (task.authority == authority) {
+      task.configs.push_back(config);
+      return;
+    }
+  }
+  tasks->push_back({authority, authority_id, is_generator, {config}});
+}
+
+bool InitializeAssertionAuthorities(
+    std::vector<AssertionAuthorityInitTask> tasks,
+    const AssertionAuthorityInitOptions &options,
+    std::vector<AssertionAuthorityInitRecord> *records) {
+  const size_t num_tasks = tasks.size();
+
+  // Index the tasks by authority identifier. A generator and a verifier may
+  // share an identifier, in which case a dependency on that identifier is a
+  // dependency on both.
+  std::unordered_map<std::string, std::vector<size_t>> tasks_by_id;
+  for (size_t i = 0; i < num_tasks; ++i) {
+    tasks_by_id[tasks[i].authority_id].push_back(i);
+  }
+
+  std::vector<bool> already_initialized(num_tasks);
+  std::vector<Status> statuses(num_tasks, Status::OkStatus());
+  std::vector<std::vector<size_t>> dependencies(num_tasks);
+  for (size_t i = 0; i < num_tasks; ++i) {
+    already_initialized[i] = tasks[i].authority->IsInitialized();
+    if (already_initialized[i]) {
+      continue;
+    }
+
+    StatusOr<std::vector<std::string>> dependency_ids_result =
+        GetDependencyIds(*tasks[i].authority);
+    if (!dependency_ids_result.ok()) {
+      statuses[i] = dependency_ids_result.status();
+      continue;
+    }
+    for (const std::string &dependency_id :
+         dependency_ids_result.ValueOrDie()) {
+      auto id_it = tasks_by_id.find(dependency_id);
+      if (id_it == tasks_by_id.end()) {
+        statuses[i] =
+            Status(error::GoogleError::FAILED_PRECONDITION,
+                   "Assertion authority depends on an unknown assertion "
+                   "authority");
+        break;
+      }
+      for (size_t j : id_it->second) {
+        if (j != i) {
+          dependencies[i].push_back(j);
+        }
+      }
+    }
+  }
+
+  // Defer the authorities that allow it, except those that an authority that
+  // is initialized now depends on.
+  std::vector<bool> deferred(num_tasks, false);
+  if (options.defer_deferrable_authorities) {
+    for (size_t i = 0; i < num_tasks; ++i) {
+      deferred[i] = !already_initialized[i] && statuses[i].ok() &&
+                    tasks[i].authority->IsInitializationDeferrable();
+    }
+    std::vector<size_t> worklist;
+    for (size_t i = 0; i < num_tasks; ++i) {
+      if (!deferred[i]) {
+        worklist.push_back(i);
+      }
+    }
+    while (!worklist.empty()) {
+      size_t i = worklist.back();
+      worklist.pop_back();
+      for (size_t j : dependencies[i]) {
+        if (deferred[j]) {
+          deferred[j] = false;
+          worklist.push_back(j);
+        }
+      }
+    }
+  }
+
+  for (size_t i = 0; i < num_tasks; ++i) {
+    if (deferred[i]) {
+      std::vector<EnclaveAssertionAuthority *> deferred_dependencies;
+      for (size_t j : dependencies[i]) {
+        deferred_dependencies.push_back(tasks[j].authority);
+      }
+      DeferAuthority(tasks[i], std::move(deferred_dependencies));
+    }
+  }
+
+  // Initialize the remaining authorities once their dependencies are done.
+  std::vector<std::vector<size_t>> dependents(num_tasks);
+  std::vector<size_t> num_pending_dependencies(num_tasks, 0);
+  for (size_t i = 0; i < num_tasks; ++i) {
+    if (already_initialized[i] || deferred[i]) {
+      continue;
+    }
+    for (size_t j : dependencies[i]) {
+      if (!already_initialized[j]) {
+        dependents[j].push_back(i);
+        ++num_pending_dependencies[i];
+      }
+    }
+  }
+
+  InitializationScheduler scheduler(&tasks, &statuses, &dependencies,
+                                    &dependents, &num_pending_dependencies);
+  for (size_t i = 0; i < num_tasks; ++i) {
+    if (!already_initialized[i] && !deferred[i] &&
+        num_pending_dependencies[i] == 0) {
+      scheduler.AddReadyTask(i);
+    }
+  }
+
+  std::vector<std::thread> threads;
+  for (int i = 1; i < options.num_threads; ++i) {
+    threads.emplace_back(&InitializationScheduler::Work, &scheduler);
+  }
+  scheduler.Work();
+  for (std::thread &thread : threads) {
+    thread.join();
+  }
+
+  bool ok = true;
+  for (size_t i = 0; i < num_tasks; ++i) {
+    if (already_initialized[i]) {
+      continue;
+    }
+    if (!deferred[i] && !scheduler.IsDone(i)) {
+      statuses[i] = Status(error::GoogleError::FAILED_PRECONDITION,
+                           "Assertion authority dependencies form a cycle");
+    }
+    if (!statuses[i].ok()) {
+      ok = false;
+      LOG(ERROR) << statuses[i];
+    }
+    if (records) {
+      AssertionAuthorityInitRecord record;
+      record.description.set_identity_type(tasks[i].authority->IdentityType());
+      record.description.set_authority_type(
+          tasks[i].authority->AuthorityType());
+      record.is_generator = tasks[i].is_generator;
+      record.deferred = deferred[i];
+      record.status = statuses[i];
+      record.duration = scheduler.Duration(i);
+      records->push_back(std::move(record));
+    }
+  }
+  return ok;
+}
+
+}  // namespace internal
+
+Status InitializeDeferredAssertionAuthority(
+    EnclaveAssertionAuthority *authority) {
+  if (num_deferred_authorities.load(std::memory_order_acquire) == 0) {
+    return Status::OkStatus();
+  }
+  absl::MutexLock lock(DeferredAuthoritiesMutex());
+  return InitializeDeferredAuthorityLocked(authority);
+}
+
+uint64_t AssertionAuthorityGeneration() {
+  return authority_generation.load(std::memory_order_acquire);
+}
+
+}  // namespace asylo
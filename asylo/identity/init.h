@@ -19,8 +19,12 @@
 #ifndef ASYLO_IDENTITY_INIT_H_
 #define ASYLO_IDENTITY_INIT_H_
 
+#include <cstdint>
 #include <string>
+#include <utility>
+#include <vector>
 
+#include "absl/time/time.h"
 #include "asylo/util/logging.h"
 #include "asylo/identity/enclave_assertion_authority.h"
 #include "asylo/identity/enclave_assertion_authority_config.pb.h"
@@ -31,6 +35,67 @@
 
 namespace asylo {
 
+// Controls how InitializeEnclaveAssertionAuthorities() initializes assertion
+// authorities.
+struct AssertionAuthorityInitOptions {
+  // The number of threads that initialize independent authorities
+  // concurrently. When zero or one, authorities are initialized one at a time
+  // on the calling thread.
+  int num_threads = 0;
+
+  // Whether authorities that allow it are left uninitialized until they are
+  // first used. See InitializeDeferredAssertionAuthority().
+  bool defer_deferrable_authorities = false;
+};
+
+// Reports the initialization of one assertion generator or verifier.
+struct AssertionAuthorityInitRecord {
+  // The identity type and authority type of the authority.
+  AssertionDescription description;
+
+  // True for an EnclaveAssertionGenerator, false for an
+  // EnclaveAssertionVerifier.
+  bool is_generator = false;
+
+  // True if initialization was deferred until first use. Deferred authorities
+  // have an OK |status| and a zero |duration|.
+  bool deferred = false;
+
+  // The result of initializing the authority.
+  Status status;
+
+  // The time spent initializing the authority.
+  absl::Duration duration;
+};
+
+namespace internal {
+
+// An assertion authority to initialize, with the configs to try, in order,
+// until one of them succeeds.
+struct AssertionAuthorityInitTask {
+  EnclaveAssertionAuthority *authority;
+  std::string authority_id;
+  bool is_generator;
+  std::vector<std::string> configs;
+};
+
+// Adds |config| to the configs to try for |authority| in |tasks|, adding a task
+// for |authority| if there is none yet.
+void AddAssertionAuthorityConfig(
+    EnclaveAssertionAuthority *authority, const std::string &authority_id,
+    bool is_generator, const std::string &config,
+    std::vector<AssertionAuthorityInitTask> *tasks);
+
+// Initializes the authorities in |tasks| according to |options|, and appends a
+// record for each authority that was not already initialized to |records| if
+// it is not null. Returns false if any authority could not be initialized.
+bool InitializeAssertionAuthorities(
+    std::vector<AssertionAuthorityInitTask> tasks,
+    const AssertionAuthorityInitOptions &options,
+    std::vector<AssertionAuthorityInitRecord> *records);
+
+}  // namespace internal
+
 // Initializes every EnclaveAssertionGenerator and EnclaveAssertionVerifier that
 // has been statically-registered into the program static maps using the
 // configs provided in the range [|configs_begin|, |configs_end|). If a config
@@ -38,6 +103,15 @@ namespace asylo {
 // that authority. Each authority will be initialized at most once between all
 // calls to this function.
 //
+// Authorities are initialized after the authorities named by their
+// InitializationDependencies(). With |options|.num_threads greater than one,
+// authorities that do not depend on each other are initialized concurrently.
+// With |options|.defer_deferrable_authorities set, authorities whose
+// IsInitializationDeferrable() returns true are only initialized when they are
+// first used, unless an authority that is not deferred depends on them. If
+// |records| is not null, a record of each authority that was not already
+// initialized is appended to it.
+//
 // ConfigIteratorT must be an iterator type that satisfies the following
 // constraints:
 //   * It provides a dereference operator, which returns an immutable reference
@@ -51,15 +125,20 @@ namespace asylo {
 //   * An authority could not be initialized with either a provided config or an
 //     empty config string
 //   * An authority identifier could not be generated from a provided config
+//   * An authority depends on an authority that does not exist or could not be
+//     initialized, or the dependencies of an authority form a cycle
 //
 // Note that if this method has already been called successfully, future calls
 // will have no effect.
 template <class ConfigIteratorT>
-Status InitializeEnclaveAssertionAuthorities(ConfigIteratorT configs_begin,
-                                             ConfigIteratorT configs_end) {
+Status InitializeEnclaveAssertionAuthorities(
+    ConfigIteratorT configs_begin, ConfigIteratorT configs_end,
+    const AssertionAuthorityInitOptions &options,
+    std::vector<AssertionAuthorityInitRecord> *records) {
   bool ok = true;
+  std::vector<internal::AssertionAuthorityInitTask> tasks;
 
-  // Initialize assertion authorities with provided configs.
+  // Queue the provided configs for the matching assertion authorities.
   for (auto it = configs_begin; it != configs_end; ++it) {
     const EnclaveAssertionAuthorityConfig &config = *it;
 
@@ -77,9 +156,9 @@ Status InitializeEnclaveAssertionAuthorities(ConfigIteratorT configs_begin,
 
     auto generator_it = AssertionGeneratorMap::GetValue(authority_id);
     if (generator_it != AssertionGeneratorMap::value_end()) {
-      if (!internal::TryInitialize(config.config(), generator_it).ok()) {
-        ok = false;
-      }
+      internal::AddAssertionAuthorityConfig(&*generator_it, authority_id,
+                                            /*is_generator=*/true,
+                                            config.config(), &tasks);
     } else {
       ok = false;
       LOG(WARNING) << "Config for " << description.ShortDebugString()
@@ -88,9 +167,9 @@ Status InitializeEnclaveAssertionAuthorities(ConfigIteratorT configs_begin,
 
     auto verifier_it = AssertionVerifierMap::GetValue(authority_id);
     if (verifier_it != AssertionVerifierMap::value_end()) {
-      if (!internal::TryInitialize(config.config(), verifier_it).ok()) {
-        ok = false;
-      }
+      internal::AddAssertionAuthorityConfig(&*verifier_it, authority_id,
+                                            /*is_generator=*/false,
+                                            config.config(), &tasks);
     } else {
       ok = false;
       LOG(WARNING) << "Config for " << description.ShortDebugString()
@@ -98,16 +177,21 @@ Status InitializeEnclaveAssertionAuthorities(ConfigIteratorT configs_begin,
     }
   }
 
-  // Initialize all remaining assertion authorities with an empty config string.
+  // Fall back to an empty config string for all assertion authorities.
   for (auto &generator : AssertionGeneratorMap::Values()) {
-    if (!internal::TryInitialize(/*config=*/"", &generator).ok()) {
-      ok = false;
-    }
+    internal::AddAssertionAuthorityConfig(
+        &generator, Namer<EnclaveAssertionGenerator>()(generator),
+        /*is_generator=*/true, /*config=*/"", &tasks);
   }
   for (auto &verifier : AssertionVerifierMap::Values()) {
-    if (!internal::TryInitialize(/*config=*/"", &verifier).ok()) {
-      ok = false;
-    }
+    internal::AddAssertionAuthorityConfig(
+        &verifier, Namer<EnclaveAssertionVerifier>()(verifier),
+        /*is_generator=*/false, /*config=*/"", &tasks);
+  }
+
+  if (!internal::InitializeAssertionAuthorities(std::move(tasks), options,
+                                                records)) {
+    ok = false;
   }
 
   return ok ? Status::OkStatus()
@@ -117,6 +201,28 @@ Status InitializeEnclaveAssertionAuthorities(ConfigIteratorT configs_begin,
                   "assertion generators and assertion verifiers");
 }
 
+// Initializes all assertion authorities one at a time, as above.
+template <class ConfigIteratorT>
+Status InitializeEnclaveAssertionAuthorities(ConfigIteratorT configs_begin,
+                                             ConfigIteratorT configs_end) {
+  return InitializeEnclaveAssertionAuthorities(
+      configs_begin, configs_end, AssertionAuthorityInitOptions(),
+      /*records=*/nullptr);
+}
+
+// Initializes |authority| if InitializeEnclaveAssertionAuthorities() deferred
+// its initialization, after initializing any deferred authorities it depends
+// on. Returns a non-OK status if initialization was attempted and failed, and
+// an OK status otherwise. Cheap when no authority is deferred.
+Status InitializeDeferredAssertionAuthority(
+    EnclaveAssertionAuthority *authority);
+
+// Returns a number that changes whenever an assertion authority is initialized,
+// including a deferred authority on first use. Callers that cache the output of
+// authorities, such as assertion offers and requests, rebuild it when the
+// number changes.
+uint64_t AssertionAuthorityGeneration();
+
 }  // namespace asylo
 
 #endif  // ASYLO_IDENTITY_INIT_H_
@@ -18,6 +18,8 @@
 
 #include "asylo/identity/init.h"
 
+#include <atomic>
+#include <string>
 #include <vector>
 
 #include <google/protobuf/text_format.h>
@@ -31,6 +33,71 @@ namespace {
 
 using ::testing::Not;
 
+// Every initialization of a FakeAuthority gets the next value of this counter,
+// which records the order in which authorities are initialized.
+std::atomic<int> initialization_counter(0);
+
+// A fake assertion authority with configurable dependencies, deferral and
+// initialization failure.
+class FakeAuthority : public EnclaveAssertionAuthority {
+ public:
+  explicit FakeAuthority(std::string authority_type)
+      : authority_type_(std::move(authority_type)) {}
+
+  Status Initialize(const std::string &config) override {
+    if (config == "fail") {
+      return Status(error::GoogleError::INTERNAL, "Initialization failed");
+    }
+    order_ = ++initialization_counter;
+    initialized_ = true;
+    return Status::OkStatus();
+  }
+
+  bool IsInitialized() const override { return initialized_; }
+
+  EnclaveIdentityType IdentityType() const override { return CODE_IDENTITY; }
+
+  std::string AuthorityType() const override { return authority_type_; }
+
+  std::vector<AssertionDescription> InitializationDependencies()
+      const override {
+    return dependencies_;
+  }
+
+  bool IsInitializationDeferrable() const override { return deferrable_; }
+
+  void AddDependency(const FakeAuthority &authority) {
+    AssertionDescription description;
+    description.set_identity_type(authority.IdentityType());
+    description.set_authority_type(authority.AuthorityType());
+    dependencies_.push_back(description);
+  }
+
+  void set_deferrable(bool deferrable) { deferrable_ = deferrable; }
+
+  // Returns the value of the initialization counter when this authority was
+  // initialized.
+  int order() const { return order_; }
+
+ private:
+  const std::string authority_type_;
+  std::vector<AssertionDescription> dependencies_;
+  bool deferrable_ = false;
+  std::atomic<bool> initialized_{false};
+  int order_ = 0;
+};
+
+// Adds a task that initializes |authority| with |config| to |tasks|.
+void AddTask(FakeAuthority *authority, const std::string &config,
+             std::vector<internal::AssertionAuthorityInitTask> *tasks) {
+  std::string authority_id =
+      EnclaveAssertionAuthority::GenerateAuthorityId(
+          authority->IdentityType(), authority->AuthorityType())
+          .ValueOrDie();
+  internal::AddAssertionAuthorityConfig(authority, authority_id,
+                                        /*is_generator=*/true, config, tasks);
+}
+
 // Verify that InitializeEnclaveAssertionAuthorities succeeds with no input.
 TEST(InitTest, InitializeSucceedsWithoutConfigs) {
   std::vector<EnclaveAssertionAuthorityConfig> configs;
@@ -92,6 +159,122 @@ TEST(InitTest, InitializeFailsWithNonMatchingConfigs) {
       Not(IsOk()));
 }
 
+// Verify that authorities are initialized after their dependencies, on one
+// thread and on several threads.
+TEST(InitTest, InitializeRespectsDependencies) {
+  for (int num_threads : {1, 4}) {
+    FakeAuthority a("A"), b("B"), c("C"), d("D");
+    b.AddDependency(a);
+    c.AddDependency(a);
+    d.AddDependency(b);
+    d.AddDependency(c);
+
+    std::vector<internal::AssertionAuthorityInitTask> tasks;
+    AddTask(&d, "", &tasks);
+    AddTask(&c, "", &tasks);
+    AddTask(&b, "", &tasks);
+    AddTask(&a, "", &tasks);
+
+    AssertionAuthorityInitOptions options;
+    options.num_threads = num_threads;
+    std::vector<AssertionAuthorityInitRecord> records;
+    EXPECT_TRUE(
+        internal::InitializeAssertionAuthorities(tasks, options, &records));
+
+    EXPECT_LT(a.order(), b.order());
+    EXPECT_LT(a.order(), c.order());
+    EXPECT_LT(b.order(), d.order());
+    EXPECT_LT(c.order(), d.order());
+    ASSERT_EQ(records.size(), 4);
+    for (const AssertionAuthorityInitRecord &record : records) {
+      EXPECT_THAT(record.status, IsOk());
+      EXPECT_FALSE(record.deferred);
+    }
+  }
+}
+
+// Verify that an authority is not initialized if an authority it depends on
+// cannot be initialized or is unknown, or if its dependencies form a cycle.
+TEST(InitTest, InitializeFailsDependentsOfFailedAuthorities) {
+  FakeAuthority failing("Failing"), dependent("Dependent"), unknown("Unknown"),
+      orphan("Orphan"), cycle_a("CycleA"), cycle_b("CycleB"),
+      independent("Independent");
+  dependent.AddDependency(failing);
+  orphan.AddDependency(unknown);
+  cycle_a.AddDependency(cycle_b);
+  cycle_b.AddDependency(cycle_a);
+
+  std::vector<internal::AssertionAuthorityInitTask> tasks;
+  AddTask(&failing, "fail", &tasks);
+  AddTask(&dependent, "", &tasks);
+  AddTask(&orphan, "", &tasks);
+  AddTask(&cycle_a, "", &tasks);
+  AddTask(&cycle_b, "", &tasks);
+  AddTask(&independent, "", &tasks);
+
+  std::vector<AssertionAuthorityInitRecord> records;
+  EXPECT_FALSE(internal::InitializeAssertionAuthorities(
+      tasks, AssertionAuthorityInitOptions(), &records));
+
+  EXPECT_FALSE(failing.IsInitialized());
+  EXPECT_FALSE(dependent.IsInitialized());
+  EXPECT_FALSE(orphan.IsInitialized());
+  EXPECT_FALSE(cycle_a.IsInitialized());
+  EXPECT_FALSE(cycle_b.IsInitialized());
+  EXPECT_TRUE(independent.IsInitialized());
+
+  ASSERT_EQ(records.size(), 6);
+  EXPECT_THAT(records[0].status, StatusIs(error::GoogleError::INTERNAL));
+  for (int i = 1; i < 5; ++i) {
+    EXPECT_THAT(records[i].status,
+                StatusIs(error::GoogleError::FAILED_PRECONDITION));
+  }
+  EXPECT_THAT(records[5].status, IsOk());
+}
+
+// Verify that deferrable authorities are initialized on first use, together
+// with the deferred authorities they depend on, unless an authority that is
+// not deferred depends on them.
+TEST(InitTest, InitializeDefersDeferrableAuthorities) {
+  FakeAuthority base("DeferredBase"), deferred("Deferred"),
+      needed("NeededByEager"), eager("Eager");
+  base.set_deferrable(true);
+  deferred.set_deferrable(true);
+  deferred.AddDependency(base);
+  needed.set_deferrable(true);
+  eager.AddDependency(needed);
+
+  std::vector<internal::AssertionAuthorityInitTask> tasks;
+  AddTask(&base, "", &tasks);
+  AddTask(&deferred, "", &tasks);
+  AddTask(&needed, "", &tasks);
+  AddTask(&eager, "", &tasks);
+
+  AssertionAuthorityInitOptions options;
+  options.defer_deferrable_authorities = true;
+  std::vector<AssertionAuthorityInitRecord> records;
+  EXPECT_TRUE(
+      internal::InitializeAssertionAuthorities(tasks, options, &records));
+
+  EXPECT_FALSE(base.IsInitialized());
+  EXPECT_FALSE(deferred.IsInitialized());
+  EXPECT_TRUE(needed.IsInitialized());
+  EXPECT_TRUE(eager.IsInitialized());
+  ASSERT_EQ(records.size(), 4);
+  EXPECT_TRUE(records[0].deferred);
+  EXPECT_TRUE(records[1].deferred);
+  EXPECT_FALSE(records[2].deferred);
+  EXPECT_FALSE(records[3].deferred);
+
+  EXPECT_THAT(InitializeDeferredAssertionAuthority(&deferred), IsOk());
+  EXPECT_TRUE(base.IsInitialized());
+  EXPECT_TRUE(deferred.IsInitialized());
+  EXPECT_LT(base.order(), deferred.order());
+
+  // Authorities that are not deferred are left alone.
+  EXPECT_THAT(InitializeDeferredAssertionAuthority(&eager), IsOk());
+}
+
 }  // namespace
 }  // namespace grpc_auth
 }  // namespace asylo
@@ -20,10 +20,45 @@
 
 #include <vector>
 
+#include <google/protobuf/util/message_differencer.h>
+#include "absl/memory/memory.h"
 #include "asylo/crypto/util/byte_container_util.h"
 #include "asylo/crypto/util/byte_container_view.h"
 
 namespace asylo {
+namespace {
+
+// A PreparedExpectation that holds a copy of an expectation and matches
+// identities against it with the Match() method of its matcher.
+class DeferredExpectation final
+    : public NamedIdentityExpectationMatcher::PreparedExpectation {
+ public:
+  DeferredExpectation(const NamedIdentityExpectationMatcher *matcher,
+                      const EnclaveIdentityExpectation &expectation)
+      : matcher_(matcher), expectation_(expectation) {}
+
+  StatusOr<bool> Match(const EnclaveIdentity &identity) const override {
+    return matcher_->Match(identity, expectation_);
+  }
+
+ private:
+  const NamedIdentityExpectationMatcher *matcher_;
+  const EnclaveIdentityExpectation expectation_;
+};
+
+}  // namespace
+
+StatusOr<std::unique_ptr<NamedIdentityExpectationMatcher::PreparedExpectation>>
+NamedIdentityExpectationMatcher::PrepareExpectation(
+    const EnclaveIdentityExpectation &expectation) const {
+  if (!::google::protobuf::util::MessageDifferencer::Equivalent(
+          expectation.reference_identity().description(), Description())) {
+    return Status(error::GoogleError::INVALID_ARGUMENT,
+                  "Expectation has an incorrect description");
+  }
+  return std::unique_ptr<PreparedExpectation>(
+      absl::make_unique<DeferredExpectation>(this, expectation));
+}
 
 StatusOr<std::string> NamedIdentityExpectationMatcher::GetMatcherName(
     const EnclaveIdentityDescription &description) {
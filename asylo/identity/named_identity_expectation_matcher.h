@@ -19,6 +19,7 @@
 #ifndef ASYLO_IDENTITY_NAMED_IDENTITY_EXPECTATION_MATCHER_H_
 #define ASYLO_IDENTITY_NAMED_IDENTITY_EXPECTATION_MATCHER_H_
 
+#include <memory>
 #include <string>
 
 #include "asylo/identity/identity.pb.h"
@@ -55,6 +56,26 @@ class NamedIdentityExpectationMatcher : public IdentityExpectationMatcher {
   // description, the matcher returns a non-ok status.
   virtual EnclaveIdentityDescription Description() const = 0;
 
+  // An expectation that has been prepared for matching by a particular
+  // matcher, so that the work of interpreting the expectation is done only
+  // once.
+  class PreparedExpectation {
+   public:
+    virtual ~PreparedExpectation() = default;
+
+    // Returns whether |identity| matches the prepared expectation. |identity|
+    // must have the description of the matcher that prepared the expectation.
+    virtual StatusOr<bool> Match(const EnclaveIdentity &identity) const = 0;
+  };
+
+  // Prepares |expectation| for repeated matching against identities with the
+  // description of this matcher. The default implementation keeps a copy of
+  // |expectation| and defers to Match(). Matchers that parse expectations
+  // should override it to parse |expectation| once. Returns a non-ok status if
+  // |expectation| has a different description or is malformed.
+  virtual StatusOr<std::unique_ptr<PreparedExpectation>> PrepareExpectation(
+      const EnclaveIdentityExpectation &expectation) const;
+
   // Converts |description| to a name that can be used as a unique identifier
   // for a NamedIdentityExpectationMatcher that handles identities/expectations
   // of this description.
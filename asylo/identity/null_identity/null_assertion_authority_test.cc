@@ -16,6 +16,7 @@
  *
  */
 
+#include <google/protobuf/arena.h>
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 #include "asylo/identity/enclave_assertion_authority.h"
@@ -210,6 +211,29 @@ TEST_F(NullAssertionAuthorityTest, VerifySuceedsValidAssertion) {
   EXPECT_EQ(peer_identity.identity(), kNullIdentity);
 }
 
+// Verify that an assertion generated with its temporary messages on an arena
+// can be verified on the same arena, and that the arena does not own the
+// results.
+TEST_F(NullAssertionAuthorityTest, GenerateAndVerifyOnArena) {
+  AssertionRequest request;
+  ASSERT_THAT(verifier_->CreateAssertionRequest(&request), IsOk());
+
+  Assertion assertion;
+  EnclaveIdentity peer_identity;
+  {
+    google::protobuf::Arena arena;
+    ASSERT_THAT(
+        generator_->Generate(kEkepContext, request, &assertion, &arena),
+        IsOk());
+    ASSERT_THAT(
+        verifier_->Verify(kEkepContext, assertion, &peer_identity, &arena),
+        IsOk());
+  }
+  EXPECT_THAT(verifier_->Verify(kEkepContext, assertion, &peer_identity),
+              IsOk());
+  EXPECT_EQ(peer_identity.identity(), kNullIdentity);
+}
+
 // Verify that a NullAssertionVerifier cannot verify an empty assertion.
 TEST_F(NullAssertionAuthorityTest, VerifyFailsEmptyAssertion) {
   EnclaveIdentity peer_identity;
@@ -18,6 +18,7 @@
 
 #include "asylo/identity/null_identity/null_assertion_generator.h"
 
+#include <google/protobuf/arena.h>
 #include "absl/synchronization/mutex.h"
 #include "asylo/util/logging.h"
 #include "asylo/identity/null_identity/null_assertion.pb.h"
@@ -86,6 +87,13 @@ StatusOr<bool> NullAssertionGenerator::CanGenerate(
 Status NullAssertionGenerator::Generate(const std::string &user_data,
                                         const AssertionRequest &request,
                                         Assertion *assertion) const {
+  return Generate(user_data, request, assertion, /*arena=*/nullptr);
+}
+
+Status NullAssertionGenerator::Generate(const std::string &user_data,
+                                        const AssertionRequest &request,
+                                        Assertion *assertion,
+                                        google::protobuf::Arena *arena) const {
   // Verify that this generator has been initialized.
   if (!IsInitialized()) {
     return Status(error::GoogleError::FAILED_PRECONDITION, "Not initialized");
@@ -111,9 +119,12 @@ Status NullAssertionGenerator::Generate(const std::string &user_data,
   // the blob is stored in its raw form and there is no associated identity
   // binding. In non-trivial assertion types, the user-data should be
   // cryptographically bound to the assertion.
-  NullAssertion null_assertion;
-  null_assertion.set_user_data(user_data);
-  if (!null_assertion.SerializeToString(assertion->mutable_assertion())) {
+  google::protobuf::Arena local_arena;
+  NullAssertion *null_assertion =
+      google::protobuf::Arena::CreateMessage<NullAssertion>(
+          arena == nullptr ? &local_arena : arena);
+  null_assertion->set_user_data(user_data);
+  if (!null_assertion->SerializeToString(assertion->mutable_assertion())) {
     return Status(error::GoogleError::INTERNAL,
                   "Assertion serialization failed");
   }
@@ -21,6 +21,7 @@
 
 #include <string>
 
+#include <google/protobuf/arena.h>
 #include "absl/synchronization/mutex.h"
 #include "asylo/identity/enclave_assertion_generator.h"
 
@@ -62,6 +63,10 @@ class NullAssertionGenerator final : public EnclaveAssertionGenerator {
   Status Generate(const std::string &user_data, const AssertionRequest &request,
                   Assertion *assertion) const override;
 
+  Status Generate(const std::string &user_data, const AssertionRequest &request,
+                  Assertion *assertion,
+                  google::protobuf::Arena *arena) const override;
+
  private:
   // Returns true if the given |request| is a valid AssertionRequest for this
   // generator.
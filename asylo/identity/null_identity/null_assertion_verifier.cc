@@ -18,6 +18,7 @@
 
 #include "asylo/identity/null_identity/null_assertion_verifier.h"
 
+#include <google/protobuf/arena.h>
 #include "absl/synchronization/mutex.h"
 #include "asylo/util/logging.h"
 #include "asylo/identity/null_identity/null_assertion.pb.h"
@@ -90,6 +91,13 @@ StatusOr<bool> NullAssertionVerifier::CanVerify(
 Status NullAssertionVerifier::Verify(const std::string &user_data,
                                      const Assertion &assertion,
                                      EnclaveIdentity *peer_identity) const {
+  return Verify(user_data, assertion, peer_identity, /*arena=*/nullptr);
+}
+
+Status NullAssertionVerifier::Verify(const std::string &user_data,
+                                     const Assertion &assertion,
+                                     EnclaveIdentity *peer_identity,
+                                     google::protobuf::Arena *arena) const {
   // Verify that this verifier has been initialized.
   if (!IsInitialized()) {
     return Status(error::GoogleError::FAILED_PRECONDITION, "Not initialized");
@@ -104,12 +112,15 @@ Status NullAssertionVerifier::Verify(const std::string &user_data,
 
   // Verify that the body of the assertion is a serialized NullAssertion
   // containing the user-provided data blob.
-  NullAssertion null_assertion;
-  if (!null_assertion.ParseFromString(assertion.assertion())) {
+  google::protobuf::Arena local_arena;
+  NullAssertion *null_assertion =
+      google::protobuf::Arena::CreateMessage<NullAssertion>(
+          arena == nullptr ? &local_arena : arena);
+  if (!null_assertion->ParseFromString(assertion.assertion())) {
     return Status(error::GoogleError::INTERNAL,
                   "Assertion deserialization failed");
   }
-  if (null_assertion.user_data() != user_data) {
+  if (null_assertion->user_data() != user_data) {
     return Status(
         error::GoogleError::INVALID_ARGUMENT,
         "Assertion verification failed: assertion is not bound to user_data");
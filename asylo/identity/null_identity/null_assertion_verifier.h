@@ -21,6 +21,7 @@
 
 #include <string>
 
+#include <google/protobuf/arena.h>
 #include "absl/synchronization/mutex.h"
 #include "asylo/identity/enclave_assertion_verifier.h"
 
@@ -65,6 +66,10 @@ class NullAssertionVerifier final : public EnclaveAssertionVerifier {
   Status Verify(const std::string &user_data, const Assertion &assertion,
                 EnclaveIdentity *peer_identity) const override;
 
+  Status Verify(const std::string &user_data, const Assertion &assertion,
+                EnclaveIdentity *peer_identity,
+                google::protobuf::Arena *arena) const override;
+
  private:
   // Indicates whether this verifier has been initialized.
   bool initialized_ GUARDED_BY(initialized_mu_);
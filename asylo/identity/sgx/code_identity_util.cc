@@ -19,15 +19,20 @@
 #include "asylo/identity/sgx/code_identity_util.h"
 
 #include <openssl/cmac.h>
+#include <openssl/sha.h>
+#include <array>
+#include <cstring>
 #include <string>
 
 #include "absl/strings/str_cat.h"
+#include "absl/synchronization/mutex.h"
 #include "asylo/crypto/util/bssl_util.h"
 #include "asylo/crypto/util/bytes.h"
 #include "asylo/identity/identity.pb.h"
 #include "asylo/identity/sgx/code_identity.pb.h"
 #include "asylo/identity/sgx/hardware_interface.h"
 #include "asylo/identity/sgx/identity_key_management_structs.h"
+#include "asylo/identity/sgx/secs_attributes.h"
 #include "asylo/identity/sgx/self_identity.h"
 #include "asylo/identity/util/bit_vector_128.pb.h"
 #include "asylo/identity/util/bit_vector_128_util.h"
@@ -51,7 +56,7 @@ Status GetReportKey(const UnsafeBytes<kKeyrequestKeyidSize> &keyid,
 
   // Set KEYREQUEST to request the REPORT_KEY with the KEYID value specified in
   // the report to be verified.
-  AlignedKeyrequestPtr request;
+  AlignedKeyrequest request;
 
   request->keyname = KeyrequestKeyname::REPORT_KEY;
   request->keyid = keyid;
@@ -77,6 +82,98 @@ Status GetReportKey(const UnsafeBytes<kKeyrequestKeyidSize> &keyid,
   return Status::OkStatus();
 }
 
+// A small cache of the report keys derived by the current enclave, indexed by
+// KEYID. A report key depends only on its KEYID and on the identity of the
+// enclave that derives it, so a cached key stays valid for the lifetime of the
+// enclave. The cache lives in enclave memory, and its keys are cleansed when
+// they are evicted.
+class ReportKeyCache {
+ public:
+  // Copies the cached report key for |keyid| to |key|, if there is one.
+  bool Get(const UnsafeBytes<kKeyrequestKeyidSize> &keyid, HardwareKey *key) {
+    absl::MutexLock lock(&mu_);
+    for (size_t i = 0; i < size_; ++i) {
+      if (entries_[i].keyid == keyid) {
+        *key = entries_[i].key;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // Caches |key| as the report key for |keyid|, evicting the oldest cached key
+  // if the cache is full.
+  void Put(const UnsafeBytes<kKeyrequestKeyidSize> &keyid,
+           const HardwareKey &key) {
+    absl::MutexLock lock(&mu_);
+    Entry *entry = &entries_[next_];
+    entry->keyid = keyid;
+    entry->key = key;
+    next_ = (next_ + 1) % kCapacity;
+    if (size_ < kCapacity) {
+      ++size_;
+    }
+  }
+
+ private:
+  // The number of cached keys. Reports are usually generated with the KEYID of
+  // the current platform, so only a handful of KEYIDs are ever seen.
+  static constexpr size_t kCapacity = 4;
+
+  struct Entry {
+    UnsafeBytes<kKeyrequestKeyidSize> keyid;
+    HardwareKey key;
+  };
+
+  absl::Mutex mu_;
+  std::array<Entry, kCapacity> entries_ GUARDED_BY(mu_);
+  size_t size_ GUARDED_BY(mu_) = 0;
+  size_t next_ GUARDED_BY(mu_) = 0;
+};
+
+// Retrieves the report key associated with |keyid| for the current enclave,
+// consulting the report-key cache first, and writes it to |key|.
+Status GetCachedReportKey(const UnsafeBytes<kKeyrequestKeyidSize> &keyid,
+                          HardwareKey *key) {
+#ifdef __ASYLO__
+  static ReportKeyCache *cache = new ReportKeyCache();
+  if (cache->Get(keyid, key)) {
+    return Status::OkStatus();
+  }
+
+  Status status = GetReportKey(keyid, key);
+  if (status.ok()) {
+    cache->Put(keyid, *key);
+  }
+  return status;
+#else
+  // Outside an SGX enclave, enclave identity is simulated by the FakeEnclave
+  // object and can change from one call to the next, so report keys are not
+  // cached.
+  return GetReportKey(keyid, key);
+#endif  // __ASYLO__
+}
+
+static_assert(sizeof(PackedCodeIdentity::mrenclave) == SHA256_DIGEST_LENGTH &&
+                  sizeof(PackedCodeIdentity::mrsigner) == SHA256_DIGEST_LENGTH,
+              "Packed measurements must hold a SHA-256 digest");
+
+// Copies the SHA-256 digest held in |hash| to |words|. Returns false if |hash|
+// does not hold a SHA-256 digest.
+bool PackSha256Hash(const Sha256HashProto &hash, uint64_t words[4]) {
+  if (hash.hash().size() != SHA256_DIGEST_LENGTH) {
+    return false;
+  }
+  memcpy(words, hash.hash().data(), SHA256_DIGEST_LENGTH);
+  return true;
+}
+
+// Returns a non-zero value if the 256-bit values |lhs| and |rhs| differ.
+uint64_t Diff256(const uint64_t lhs[4], const uint64_t rhs[4]) {
+  return (lhs[0] ^ rhs[0]) | (lhs[1] ^ rhs[1]) | (lhs[2] ^ rhs[2]) |
+         (lhs[3] ^ rhs[3]);
+}
+
 }  // namespace
 
 namespace internal {
@@ -139,14 +236,114 @@ StatusOr<bool> MatchIdentityToExpectation(
     return false;
   }
 
-  if ((spec.attributes_match_mask() & identity.attributes()) !=
-      (spec.attributes_match_mask() & expected.attributes())) {
+  SecsAttributeSet attributes_mismatch =
+      (MakeSecsAttributeSet(identity.attributes()) ^
+       MakeSecsAttributeSet(expected.attributes())) &
+      MakeSecsAttributeSet(spec.attributes_match_mask());
+  if (attributes_mismatch != SecsAttributeSet{0, 0}) {
     return false;
   }
 
   return true;
 }
 
+Status PackCodeIdentity(const CodeIdentity &identity,
+                        PackedCodeIdentity *packed_identity) {
+  if (!IsValidCodeIdentity(identity)) {
+    return Status(::asylo::error::GoogleError::INVALID_ARGUMENT,
+                  "Identity parameter is invalid");
+  }
+
+  memset(packed_identity, 0, sizeof(*packed_identity));
+  const SignerAssignedIdentity &signer_id = identity.signer_assigned_identity();
+  packed_identity->has_mrenclave = identity.has_mrenclave();
+  packed_identity->has_mrsigner = signer_id.has_mrsigner();
+  if ((packed_identity->has_mrenclave &&
+       !PackSha256Hash(identity.mrenclave(), packed_identity->mrenclave)) ||
+      (packed_identity->has_mrsigner &&
+       !PackSha256Hash(signer_id.mrsigner(), packed_identity->mrsigner))) {
+    return Status(::asylo::error::GoogleError::INVALID_ARGUMENT,
+                  "Identity measurement is not a SHA-256 digest");
+  }
+  packed_identity->isvprodid = signer_id.isvprodid();
+  packed_identity->isvsvn = signer_id.isvsvn();
+  packed_identity->miscselect = identity.miscselect();
+  packed_identity->attributes_low = identity.attributes().low();
+  packed_identity->attributes_high = identity.attributes().high();
+  return Status::OkStatus();
+}
+
+Status PackCodeIdentityExpectation(
+    const CodeIdentityExpectation &expectation,
+    PackedCodeIdentityExpectation *packed_expectation) {
+  if (!IsValidExpectation(expectation)) {
+    return Status(::asylo::error::GoogleError::INVALID_ARGUMENT,
+                  "Expectation parameter is invalid");
+  }
+
+  Status status = PackCodeIdentity(expectation.reference_identity(),
+                                   &packed_expectation->reference_identity);
+  if (!status.ok()) {
+    return status;
+  }
+  const CodeIdentityMatchSpec &spec = expectation.match_spec();
+  packed_expectation->is_mrenclave_match_required =
+      spec.is_mrenclave_match_required();
+  packed_expectation->is_mrsigner_match_required =
+      spec.is_mrsigner_match_required();
+  packed_expectation->miscselect_match_mask = spec.miscselect_match_mask();
+  packed_expectation->attributes_match_mask_low =
+      spec.attributes_match_mask().low();
+  packed_expectation->attributes_match_mask_high =
+      spec.attributes_match_mask().high();
+  return Status::OkStatus();
+}
+
+void PackIdentityFromHardwareReport(const Report &report,
+                                    PackedCodeIdentity *packed_identity) {
+  memset(packed_identity, 0, sizeof(*packed_identity));
+  memcpy(packed_identity->mrenclave, report.mrenclave.data(),
+         SHA256_DIGEST_LENGTH);
+  memcpy(packed_identity->mrsigner, report.mrsigner.data(),
+         SHA256_DIGEST_LENGTH);
+  packed_identity->attributes_low = report.attributes.flags;
+  packed_identity->attributes_high = report.attributes.xfrm;
+  packed_identity->miscselect = report.miscselect;
+  packed_identity->isvprodid = report.isvprodid;
+  packed_identity->isvsvn = report.isvsvn;
+  packed_identity->has_mrenclave = true;
+  packed_identity->has_mrsigner = true;
+}
+
+StatusOr<bool> MatchPackedIdentityToExpectation(
+    const PackedCodeIdentity &identity,
+    const PackedCodeIdentityExpectation &expectation) {
+  if ((expectation.is_mrenclave_match_required && !identity.has_mrenclave) ||
+      (expectation.is_mrsigner_match_required && !identity.has_mrsigner)) {
+    return Status(::asylo::error::GoogleError::INVALID_ARGUMENT,
+                  "Identity is not compatible with specified match spec");
+  }
+
+  // Accumulate the differences in all compared fields, so that the match is
+  // decided by a single test rather than a chain of branches.
+  const PackedCodeIdentity &expected = expectation.reference_identity;
+  uint64_t mismatch = 0;
+  if (expectation.is_mrenclave_match_required) {
+    mismatch |= Diff256(identity.mrenclave, expected.mrenclave);
+  }
+  if (expectation.is_mrsigner_match_required) {
+    mismatch |= Diff256(identity.mrsigner, expected.mrsigner);
+  }
+  mismatch |= identity.isvprodid ^ expected.isvprodid;
+  mismatch |= (identity.miscselect ^ expected.miscselect) &
+              expectation.miscselect_match_mask;
+  mismatch |= (identity.attributes_low ^ expected.attributes_low) &
+              expectation.attributes_match_mask_low;
+  mismatch |= (identity.attributes_high ^ expected.attributes_high) &
+              expectation.attributes_match_mask_high;
+  return mismatch == 0 && identity.isvsvn >= expected.isvsvn;
+}
+
 Status SetExpectation(const CodeIdentityMatchSpec &match_spec,
                       const CodeIdentity &identity,
                       CodeIdentityExpectation *expectation) {
@@ -360,18 +557,13 @@ Status SerializeSgxExpectation(
 }
 
 void SetTargetinfoFromSelfIdentity(Targetinfo *tinfo) {
-  const SelfIdentity *self_identity = GetSelfIdentity();
-  tinfo->measurement = self_identity->mrenclave;
-  tinfo->attributes = self_identity->attributes;
-  tinfo->miscselect = self_identity->miscselect;
-  tinfo->reserved1.fill(0);
-  tinfo->reserved2.fill(0);
+  *tinfo = GetSelfIdentity()->targetinfo;
 }
 
 Status VerifyHardwareReport(const Report &report) {
-  AlignedHardwareKeyPtr report_key;
+  AlignedHardwareKey report_key;
 
-  Status status = GetReportKey(report.keyid, report_key.get());
+  Status status = GetCachedReportKey(report.keyid, report_key.get());
   if (!status.ok()) {
     return status;
   }
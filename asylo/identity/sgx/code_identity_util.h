@@ -19,6 +19,8 @@
 #ifndef ASYLO_IDENTITY_SGX_CODE_IDENTITY_UTIL_H_
 #define ASYLO_IDENTITY_SGX_CODE_IDENTITY_UTIL_H_
 
+#include <cstdint>
+
 #include "asylo/identity/identity.pb.h"
 #include "asylo/identity/sgx/code_identity.pb.h"
 #include "asylo/identity/sgx/code_identity_constants.h"
@@ -55,6 +57,56 @@ inline void SetSgxIdentityDescription(
 StatusOr<bool> MatchIdentityToExpectation(
     const CodeIdentity &identity, const CodeIdentityExpectation &expectation);
 
+// A flat, trivially-copyable form of a valid CodeIdentity. Measurements are
+// held as 64-bit words so that matching is a handful of masked word compares.
+// Absent measurements are zero-filled, and the corresponding |has_*| field is
+// false.
+struct PackedCodeIdentity {
+  uint64_t mrenclave[4];
+  uint64_t mrsigner[4];
+  uint64_t attributes_low;
+  uint64_t attributes_high;
+  uint32_t miscselect;
+  uint32_t isvprodid;
+  uint32_t isvsvn;
+  bool has_mrenclave;
+  bool has_mrsigner;
+};
+
+// A flat, trivially-copyable form of a valid CodeIdentityExpectation.
+struct PackedCodeIdentityExpectation {
+  PackedCodeIdentity reference_identity;
+  uint64_t attributes_match_mask_low;
+  uint64_t attributes_match_mask_high;
+  uint32_t miscselect_match_mask;
+  bool is_mrenclave_match_required;
+  bool is_mrsigner_match_required;
+};
+
+// Packs |identity| into |packed_identity|. Returns INVALID_ARGUMENT if
+// |identity| is invalid, or if any of its measurements is not a SHA-256 digest.
+Status PackCodeIdentity(const CodeIdentity &identity,
+                        PackedCodeIdentity *packed_identity);
+
+// Packs |expectation| into |packed_expectation|. Returns INVALID_ARGUMENT if
+// |expectation| is invalid, or if any of its reference measurements is not a
+// SHA-256 digest.
+Status PackCodeIdentityExpectation(
+    const CodeIdentityExpectation &expectation,
+    PackedCodeIdentityExpectation *packed_expectation);
+
+// Packs the identity in |report| into |packed_identity| without going through
+// the CodeIdentity proto. Does not verify |report|.
+void PackIdentityFromHardwareReport(const Report &report,
+                                    PackedCodeIdentity *packed_identity);
+
+// Matches |identity| to |expectation| with the same semantics as
+// MatchIdentityToExpectation(). Returns an INVALID_ARGUMENT error if
+// |identity| lacks a measurement that |expectation| requires to match.
+StatusOr<bool> MatchPackedIdentityToExpectation(
+    const PackedCodeIdentity &identity,
+    const PackedCodeIdentityExpectation &expectation);
+
 // Sets |expectation| based on |identity| and |match_spec|. Returns true on
 // success (no error), else returns false.
 Status SetExpectation(const CodeIdentityMatchSpec &match_spec,
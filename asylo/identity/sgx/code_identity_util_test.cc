@@ -18,6 +18,8 @@
 
 #include "asylo/identity/sgx/code_identity_util.h"
 
+#include <algorithm>
+#include <iterator>
 #include <string>
 #include <vector>
 
@@ -691,6 +693,83 @@ TEST_F(CodeIdentityUtilTest, ParseIdentityFromHardwareReport) {
   EXPECT_EQ(report->miscselect, identity.miscselect());
 }
 
+// Make sure that matching packed identities gives the same results as
+// matching their proto representations.
+TEST_F(CodeIdentityUtilTest, PackedMatchAgreesWithProtoMatch) {
+  for (int i = 0; i < 1000; i++) {
+    CodeIdentityExpectation expectation = GetRandomValidExpectation();
+    PackedCodeIdentityExpectation packed_expectation;
+    ASSERT_THAT(PackCodeIdentityExpectation(expectation, &packed_expectation),
+                IsOk());
+
+    // Random identities exercise the mismatch and incompatibility paths, and
+    // the reference identity exercises the match path.
+    for (const CodeIdentity &id :
+         {GetRandomValidCodeIdentity(), expectation.reference_identity()}) {
+      PackedCodeIdentity packed_id;
+      ASSERT_THAT(PackCodeIdentity(id, &packed_id), IsOk());
+
+      StatusOr<bool> result = MatchIdentityToExpectation(id, expectation);
+      StatusOr<bool> packed_result =
+          MatchPackedIdentityToExpectation(packed_id, packed_expectation);
+      ASSERT_EQ(packed_result.ok(), result.ok());
+      if (result.ok()) {
+        EXPECT_EQ(packed_result.ValueOrDie(), result.ValueOrDie());
+      }
+    }
+  }
+}
+
+// Make sure that PackCodeIdentity and PackCodeIdentityExpectation reject
+// invalid inputs.
+TEST_F(CodeIdentityUtilTest, PackCodeIdentityFailure) {
+  PackedCodeIdentity packed_id;
+  EXPECT_THAT(PackCodeIdentity(CodeIdentity(), &packed_id), Not(IsOk()));
+
+  CodeIdentity id = GetRandomValidCodeIdentity();
+  id.mutable_mrenclave()->set_hash(kInvalidString);
+  EXPECT_THAT(PackCodeIdentity(id, &packed_id), Not(IsOk()));
+
+  PackedCodeIdentityExpectation packed_expectation;
+  EXPECT_THAT(PackCodeIdentityExpectation(CodeIdentityExpectation(),
+                                          &packed_expectation),
+              Not(IsOk()));
+}
+
+// Make sure that packing an identity straight from a hardware report gives the
+// same result as packing the parsed identity.
+TEST_F(CodeIdentityUtilTest, PackIdentityFromHardwareReport) {
+  AlignedTargetinfoPtr tinfo;
+  AlignedReportdataPtr reportdata;
+  AlignedReportPtr report;
+
+  *tinfo = TrivialZeroObject<Targetinfo>();
+  *reportdata = TrivialRandomObject<Reportdata>();
+
+  EXPECT_TRUE(GetHardwareReport(*tinfo, *reportdata, report.get()));
+
+  CodeIdentity identity;
+  ASSERT_THAT(ParseIdentityFromHardwareReport(*report, &identity), IsOk());
+  PackedCodeIdentity expected;
+  ASSERT_THAT(PackCodeIdentity(identity, &expected), IsOk());
+
+  PackedCodeIdentity packed_id;
+  PackIdentityFromHardwareReport(*report, &packed_id);
+  EXPECT_TRUE(std::equal(std::begin(packed_id.mrenclave),
+                         std::end(packed_id.mrenclave),
+                         std::begin(expected.mrenclave)));
+  EXPECT_TRUE(std::equal(std::begin(packed_id.mrsigner),
+                         std::end(packed_id.mrsigner),
+                         std::begin(expected.mrsigner)));
+  EXPECT_EQ(packed_id.attributes_low, expected.attributes_low);
+  EXPECT_EQ(packed_id.attributes_high, expected.attributes_high);
+  EXPECT_EQ(packed_id.miscselect, expected.miscselect);
+  EXPECT_EQ(packed_id.isvprodid, expected.isvprodid);
+  EXPECT_EQ(packed_id.isvsvn, expected.isvsvn);
+  EXPECT_TRUE(packed_id.has_mrenclave);
+  EXPECT_TRUE(packed_id.has_mrsigner);
+}
+
 TEST_F(CodeIdentityUtilTest, SetDefaultMatchSpec) {
   CodeIdentityMatchSpec spec;
   EXPECT_THAT(SetDefaultMatchSpec(&spec), IsOk());
@@ -18,7 +18,7 @@
 
 #include "asylo/identity/sgx/hardware_interface.h"
 
-#include "asylo/util/logging.h"
+#include "asylo/crypto/util/hardware_random.h"
 #include "asylo/identity/sgx/identity_key_management_structs.h"
 #include "common/inc/sgx.h"
 
@@ -54,10 +54,7 @@ int do_egetkey(const sgx_key_request_t *key_request, sgx_key_128bit_t *key);
 namespace asylo {
 namespace sgx {
 
-bool GetHardwareRand64(uint64_t *value) {
-  LOG(ERROR) << "This function is not yet implemented.";
-  return false;
-}
+bool GetHardwareRand64(uint64_t *value) { return GetRdrand64(value); }
 
 bool GetHardwareKey(const Keyrequest &request, HardwareKey *key) {
   return (do_egetkey(reinterpret_cast<const sgx_key_request_t *>(&request),
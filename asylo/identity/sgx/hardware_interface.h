@@ -41,6 +41,7 @@ static_assert(sizeof(HardwareKey) == kHardwareKeySize,
 // The SGX architecture requires that the output memory address passed into the
 // EGETKEY instruction must be aligned on a 16-byte boundary.
 using AlignedHardwareKeyPtr = AlignedObjectPtr<HardwareKey, 16>;
+using AlignedHardwareKey = AlignedObject<HardwareKey, 16>;
 
 // Gets a 64-bit random number using the RDRAND instruction. The function
 // attempts to obtain the desired entropy by executing the RDRAND instruction
@@ -54,8 +55,8 @@ ABSL_MUST_USE_RESULT bool GetHardwareRand64(uint64_t *value);
 // checks, and consequently, the caller must ensure that this structure
 // well-formed. Additionally, the caller must ensure that the input KEYREQUEST
 // and HardwareKey structures are correctly aligned (as specified by the SGX
-// architecture). The caller can use the AlignedKeyrequestPtr and
-// AlignedHardwareKeyPtr objects to correctly align the input structures.
+// architecture). The caller can use the AlignedKeyrequest and
+// AlignedHardwareKey objects to correctly align the input structures.
 ABSL_MUST_USE_RESULT bool GetHardwareKey(const Keyrequest &request,
                                          HardwareKey *key);
 
@@ -0,0 +1,349 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/identity/sgx/identity_benchmark.h"
+
+#include <openssl/rand.h>
+#include <time.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "asylo/identity/delegating_identity_expectation_matcher.h"
+#include "asylo/identity/enclave_assertion_authority.h"
+#include "asylo/identity/enclave_assertion_generator.h"
+#include "asylo/identity/enclave_assertion_verifier.h"
+#include "asylo/identity/identity.pb.h"
+#include "asylo/identity/identity_acl.pb.h"
+#include "asylo/identity/identity_acl_evaluator.h"
+#include "asylo/identity/sealed_secret.pb.h"
+#include "asylo/identity/sgx/code_identity.pb.h"
+#include "asylo/identity/sgx/code_identity_constants.h"
+#include "asylo/identity/sgx/code_identity_util.h"
+#include "asylo/identity/sgx/self_identity.h"
+#include "asylo/identity/sgx/sgx_local_secret_sealer.h"
+#include "asylo/util/cleansing_types.h"
+#include "asylo/util/status_macros.h"
+
+namespace asylo {
+namespace {
+
+constexpr int64_t kNanosecondsPerSecond = 1000000000;
+constexpr size_t kSha256DigestSize = 32;
+constexpr char kUserData[] = "EKEP transcript hash stand-in";
+
+// Upper bound on the number of operations run between two clock reads, so
+// that slow operations do not overshoot the requested duration by much.
+constexpr int64_t kMaxBatch = 1 << 16;
+
+// A single operation under measurement.
+using Operation = std::function<Status()>;
+
+int64_t MonotonicNanoseconds() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return static_cast<int64_t>(ts.tv_sec) * kNanosecondsPerSecond + ts.tv_nsec;
+}
+
+// Returns |size| random bytes.
+std::string RandomBytes(size_t size) {
+  std::string bytes(size, '\0');
+  RAND_bytes(reinterpret_cast<uint8_t *>(&bytes[0]), bytes.size());
+  return bytes;
+}
+
+// Runs |operation| as described by |input| and records the measurement in
+// |output|. The clock is read once per batch of operations, and batches grow
+// geometrically, so clock reads, which leave the enclave, do not dominate the
+// measurement of fast operations.
+Status Measure(const IdentityBenchmarkInput &input, const Operation &operation,
+               IdentityBenchmarkOutput *output) {
+  for (int i = 0; i < input.warmup_ops(); ++i) {
+    ASYLO_RETURN_IF_ERROR(operation());
+  }
+
+  int64_t ops = 0;
+  int64_t batch = 1;
+  int64_t start = MonotonicNanoseconds();
+  int64_t elapsed = 0;
+  do {
+    for (int64_t i = 0; i < batch; ++i) {
+      ASYLO_RETURN_IF_ERROR(operation());
+    }
+    ops += batch;
+    batch = std::min(batch * 2, kMaxBatch);
+    elapsed = MonotonicNanoseconds() - start;
+  } while (elapsed < input.min_duration_ns());
+
+  output->set_ops(ops);
+  output->set_elapsed_ns(elapsed);
+  output->set_ops_per_second(
+      elapsed > 0 ? static_cast<double>(ops) * kNanosecondsPerSecond / elapsed
+                  : 0.0);
+  return Status::OkStatus();
+}
+
+// Returns a Status for a match that unexpectedly failed.
+Status MismatchStatus(const std::string &operation) {
+  return Status(error::GoogleError::INTERNAL,
+                absl::StrCat(operation, " did not match"));
+}
+
+// Gets the authority registered under the SGX local assertion authority type
+// in the static map MapT, initializing it if necessary.
+template <class MapT, class AuthorityT>
+StatusOr<AuthorityT *> GetSgxLocalAuthority() {
+  std::string authority_id;
+  ASYLO_ASSIGN_OR_RETURN(authority_id,
+                         EnclaveAssertionAuthority::GenerateAuthorityId(
+                             CODE_IDENTITY, sgx::kSgxLocalAssertionAuthority));
+  auto it = MapT::GetValue(authority_id);
+  if (it == MapT::value_end()) {
+    return Status(error::GoogleError::FAILED_PRECONDITION,
+                  "SGX local assertion authority is not linked in");
+  }
+  if (!it->IsInitialized()) {
+    ASYLO_RETURN_IF_ERROR(it->Initialize(/*config=*/""));
+  }
+  return &*it;
+}
+
+Status BenchmarkSgxLocalAssertion(const IdentityBenchmarkInput &input,
+                                  IdentityBenchmarkOutput *output) {
+  EnclaveAssertionGenerator *generator;
+  ASYLO_ASSIGN_OR_RETURN(
+      generator,
+      (GetSgxLocalAuthority<AssertionGeneratorMap,
+                            EnclaveAssertionGenerator>()));
+  EnclaveAssertionVerifier *verifier;
+  ASYLO_ASSIGN_OR_RETURN(
+      verifier,
+      (GetSgxLocalAuthority<AssertionVerifierMap,
+                            EnclaveAssertionVerifier>()));
+
+  // The generator and the verifier run in the same enclave, which is a valid
+  // local attestation target for itself.
+  AssertionRequest request;
+  ASYLO_RETURN_IF_ERROR(verifier->CreateAssertionRequest(&request));
+  Assertion assertion;
+
+  if (input.operation() == IdentityBenchmarkInput::SGX_LOCAL_GENERATE) {
+    return Measure(
+        input,
+        [&] { return generator->Generate(kUserData, request, &assertion); },
+        output);
+  }
+
+  ASYLO_RETURN_IF_ERROR(generator->Generate(kUserData, request, &assertion));
+  EnclaveIdentity peer_identity;
+  return Measure(
+      input,
+      [&] { return verifier->Verify(kUserData, assertion, &peer_identity); },
+      output);
+}
+
+Status BenchmarkSgxLocalSealer(const IdentityBenchmarkInput &input,
+                               IdentityBenchmarkOutput *output) {
+  std::unique_ptr<SgxLocalSecretSealer> sealer =
+      SgxLocalSecretSealer::CreateMrsignerSecretSealer();
+  SealedSecretHeader header;
+  ASYLO_RETURN_IF_ERROR(sealer->SetDefaultHeader(&header));
+  std::string secret = RandomBytes(input.size());
+  SealedSecret sealed_secret;
+
+  if (input.operation() == IdentityBenchmarkInput::SGX_LOCAL_SEAL) {
+    return Measure(input,
+                   [&] {
+                     return sealer->Seal(header, ByteContainerView(nullptr, 0),
+                                         secret, &sealed_secret);
+                   },
+                   output);
+  }
+
+  ASYLO_RETURN_IF_ERROR(sealer->Seal(header, ByteContainerView(nullptr, 0),
+                                     secret, &sealed_secret));
+  CleansingVector<uint8_t> unsealed;
+  return Measure(
+      input, [&] { return sealer->Unseal(sealed_secret, &unsealed); }, output);
+}
+
+// Writes to |expectation| an expectation that matches |identity| with the
+// default match spec, which matches the signer of the enclave. If
+// |match_mrenclave| is true, the expectation also matches the exact build.
+Status MakeExpectation(const sgx::CodeIdentity &identity, bool match_mrenclave,
+                       EnclaveIdentityExpectation *expectation) {
+  sgx::CodeIdentityMatchSpec match_spec;
+  ASYLO_RETURN_IF_ERROR(sgx::SetDefaultMatchSpec(&match_spec));
+  match_spec.set_is_mrenclave_match_required(match_mrenclave);
+  sgx::CodeIdentityExpectation sgx_expectation;
+  ASYLO_RETURN_IF_ERROR(
+      sgx::SetExpectation(match_spec, identity, &sgx_expectation));
+  return sgx::SerializeSgxExpectation(sgx_expectation, expectation);
+}
+
+// Builds an ACL in the shape of a service allow-list: an OR over |size|
+// allowed signers, each of which is an AND of the signer and the NOT of a
+// revoked build from that signer. Only the last signer is the signer of the
+// current enclave, so evaluation visits the whole tree. Writes the identities
+// of the current enclave to |identities|.
+Status BuildAllowListAcl(int64_t size, IdentityAclPredicate *acl,
+                         EnclaveIdentities *identities) {
+  if (size <= 0) {
+    return Status(error::GoogleError::INVALID_ARGUMENT,
+                  "ACL size must be positive");
+  }
+  const sgx::CodeIdentity &self = sgx::GetSelfIdentity()->identity;
+  ASYLO_RETURN_IF_ERROR(
+      sgx::SerializeSgxIdentity(self, identities->add_identities()));
+
+  IdentityAclGroup *allow_list = acl->mutable_acl_group();
+  allow_list->set_type(IdentityAclGroup::OR);
+  for (int64_t i = 0; i < size; ++i) {
+    sgx::CodeIdentity allowed = self;
+    if (i != size - 1) {
+      allowed.mutable_signer_assigned_identity()->mutable_mrsigner()->set_hash(
+          RandomBytes(kSha256DigestSize));
+    }
+    sgx::CodeIdentity revoked = allowed;
+    revoked.mutable_mrenclave()->set_hash(RandomBytes(kSha256DigestSize));
+
+    IdentityAclGroup *entry = allow_list->add_predicates()->mutable_acl_group();
+    entry->set_type(IdentityAclGroup::AND);
+    ASYLO_RETURN_IF_ERROR(
+        MakeExpectation(allowed, /*match_mrenclave=*/false,
+                        entry->add_predicates()->mutable_expectation()));
+    IdentityAclGroup *not_revoked =
+        entry->add_predicates()->mutable_acl_group();
+    not_revoked->set_type(IdentityAclGroup::NOT);
+    ASYLO_RETURN_IF_ERROR(
+        MakeExpectation(revoked, /*match_mrenclave=*/true,
+                        not_revoked->add_predicates()->mutable_expectation()));
+  }
+  return Status::OkStatus();
+}
+
+Status BenchmarkIdentityAcl(const IdentityBenchmarkInput &input,
+                            IdentityBenchmarkOutput *output) {
+  IdentityAclPredicate acl;
+  EnclaveIdentities identities;
+  ASYLO_RETURN_IF_ERROR(BuildAllowListAcl(input.size(), &acl, &identities));
+
+  if (input.operation() == IdentityBenchmarkInput::EVALUATE_IDENTITY_ACL) {
+    std::vector<EnclaveIdentity> identity_list(
+        identities.identities().begin(), identities.identities().end());
+    DelegatingIdentityExpectationMatcher matcher;
+    return Measure(input,
+                   [&]() -> Status {
+                     bool result;
+                     ASYLO_ASSIGN_OR_RETURN(
+                         result,
+                         EvaluateIdentityAcl(identity_list, acl, matcher));
+                     return result ? Status::OkStatus()
+                                   : MismatchStatus("EvaluateIdentityAcl");
+                   },
+                   output);
+  }
+
+  std::unique_ptr<IdentityAclEvaluator> evaluator;
+  ASYLO_ASSIGN_OR_RETURN(evaluator, IdentityAclEvaluator::Create(acl));
+  return Measure(input,
+                 [&]() -> Status {
+                   bool result;
+                   ASYLO_ASSIGN_OR_RETURN(result,
+                                          evaluator->Evaluate(identities));
+                   return result ? Status::OkStatus()
+                                 : MismatchStatus("IdentityAclEvaluator");
+                 },
+                 output);
+}
+
+Status BenchmarkSgxMatch(const IdentityBenchmarkInput &input,
+                         IdentityBenchmarkOutput *output) {
+  const sgx::CodeIdentity &self = sgx::GetSelfIdentity()->identity;
+  sgx::CodeIdentityMatchSpec match_spec;
+  ASYLO_RETURN_IF_ERROR(sgx::SetDefaultMatchSpec(&match_spec));
+  sgx::CodeIdentityExpectation expectation;
+  ASYLO_RETURN_IF_ERROR(sgx::SetExpectation(match_spec, self, &expectation));
+
+  if (input.operation() == IdentityBenchmarkInput::SGX_MATCH_IDENTITY) {
+    return Measure(input,
+                   [&]() -> Status {
+                     bool result;
+                     ASYLO_ASSIGN_OR_RETURN(
+                         result,
+                         sgx::MatchIdentityToExpectation(self, expectation));
+                     return result
+                                ? Status::OkStatus()
+                                : MismatchStatus("MatchIdentityToExpectation");
+                   },
+                   output);
+  }
+
+  sgx::PackedCodeIdentity packed_identity;
+  ASYLO_RETURN_IF_ERROR(sgx::PackCodeIdentity(self, &packed_identity));
+  sgx::PackedCodeIdentityExpectation packed_expectation;
+  ASYLO_RETURN_IF_ERROR(
+      sgx::PackCodeIdentityExpectation(expectation, &packed_expectation));
+  return Measure(input,
+                 [&]() -> Status {
+                   bool result;
+                   ASYLO_ASSIGN_OR_RETURN(
+                       result, sgx::MatchPackedIdentityToExpectation(
+                                   packed_identity, packed_expectation));
+                   return result ? Status::OkStatus()
+                                 : MismatchStatus(
+                                       "MatchPackedIdentityToExpectation");
+                 },
+                 output);
+}
+
+}  // namespace
+
+Status RunIdentityBenchmark(const IdentityBenchmarkInput &input,
+                            IdentityBenchmarkOutput *output) {
+  if (input.size() < 0 || input.min_duration_ns() < 0 ||
+      input.warmup_ops() < 0) {
+    return Status(error::GoogleError::INVALID_ARGUMENT,
+                  "Benchmark parameters must not be negative");
+  }
+
+  switch (input.operation()) {
+    case IdentityBenchmarkInput::SGX_LOCAL_GENERATE:
+    case IdentityBenchmarkInput::SGX_LOCAL_VERIFY:
+      return BenchmarkSgxLocalAssertion(input, output);
+    case IdentityBenchmarkInput::SGX_LOCAL_SEAL:
+    case IdentityBenchmarkInput::SGX_LOCAL_UNSEAL:
+      return BenchmarkSgxLocalSealer(input, output);
+    case IdentityBenchmarkInput::EVALUATE_IDENTITY_ACL:
+    case IdentityBenchmarkInput::IDENTITY_ACL_EVALUATOR:
+      return BenchmarkIdentityAcl(input, output);
+    case IdentityBenchmarkInput::SGX_MATCH_IDENTITY:
+    case IdentityBenchmarkInput::SGX_MATCH_PACKED_IDENTITY:
+      return BenchmarkSgxMatch(input, output);
+    default:
+      return Status(error::GoogleError::INVALID_ARGUMENT,
+                    absl::StrCat("Unsupported operation: ", input.operation()));
+  }
+}
+
+}  // namespace asylo
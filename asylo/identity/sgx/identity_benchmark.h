@@ -0,0 +1,42 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_IDENTITY_SGX_IDENTITY_BENCHMARK_H_
+#define ASYLO_IDENTITY_SGX_IDENTITY_BENCHMARK_H_
+
+#include "asylo/identity/sgx/identity_benchmark.pb.h"
+#include "asylo/util/status.h"
+
+namespace asylo {
+
+// Sets up the operation named by |input.operation()|, performs
+// |input.warmup_ops()| unmeasured operations, and then repeats the operation
+// until at least |input.min_duration_ns()| have elapsed. The number of
+// operations and the elapsed time are stored in |output|. Setup, such as
+// creating the assertion request or building the ACL, is not measured.
+//
+// The SGX operations run against the identity of the calling enclave. Outside
+// an enclave, the caller must enter a sgx::FakeEnclave and set an EnclaveConfig
+// with a local attestation domain first. The SGX local assertion authorities
+// are initialized with an empty config if they are not yet initialized.
+Status RunIdentityBenchmark(const IdentityBenchmarkInput &input,
+                            IdentityBenchmarkOutput *output);
+
+}  // namespace asylo
+
+#endif  // ASYLO_IDENTITY_SGX_IDENTITY_BENCHMARK_H_
@@ -0,0 +1,251 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+// Measures the per-handshake and per-record cost of the identity libraries:
+// SGX local assertion generation and verification, SGX local sealing and
+// unsealing, identity ACL evaluation and SGX expectation matching. The same
+// code runs natively, on a sgx::FakeEnclave, and inside a real enclave, so the
+// two columns separate the cost of the enclave from the cost of the identity
+// code. Whether the enclave runs in hardware or simulation mode is decided
+// when it is built; pass --enclave_label to tell the two apart in the report.
+
+#include <stdio.h>
+#include <time.h>
+#include <x86intrin.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "absl/strings/ascii.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_split.h"
+#include "asylo/benchmarks/benchmark_report.h"
+#include "asylo/client.h"
+#include "asylo/enclave.pb.h"
+#include "asylo/identity/sgx/identity_benchmark.h"
+#include "asylo/identity/sgx/identity_benchmark.pb.h"
+#include "asylo/identity/sgx/fake_enclave.h"
+#include "asylo/platform/core/trusted_global_state.h"
+#include "asylo/util/logging.h"
+#include "gflags/gflags.h"
+
+DEFINE_string(enclave_path, "", "Path to the benchmark enclave");
+DEFINE_string(operations,
+              "sgx_local_generate,sgx_local_verify,sgx_local_seal,"
+              "sgx_local_unseal,evaluate_identity_acl,identity_acl_evaluator,"
+              "sgx_match_identity,sgx_match_packed_identity",
+              "Comma-separated operations to measure, named as in "
+              "IdentityBenchmarkInput::Operation");
+DEFINE_string(secret_sizes, "16,256,4096,65536",
+              "Comma-separated secret sizes in bytes for sealing");
+DEFINE_string(acl_sizes, "1,8,64",
+              "Comma-separated numbers of allowed enclaves for ACLs");
+DEFINE_string(modes, "native,enclave",
+              "Comma-separated locations: native (on a FakeEnclave) and "
+              "enclave");
+DEFINE_string(enclave_label, "enclave",
+              "Name reported for the enclave mode, e.g. sim or hw");
+DEFINE_int64(min_duration_ms, 200, "Minimum measured time per run");
+DEFINE_int32(warmup_ops, 10, "Unmeasured operations per run");
+DEFINE_string(json_output, "", "File to also write the results to as JSON");
+
+namespace asylo {
+namespace {
+
+constexpr char kEnclaveName[] = "identity_benchmark";
+constexpr char kLocalAttestationDomain[] = "A 16-byte domain";
+constexpr int64_t kNanosecondsPerMillisecond = 1000000;
+
+int64_t MonotonicNanoseconds() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+// Returns the number of TSC cycles per nanosecond, measured on the host. The
+// benchmark itself only reads the clock, because rdtsc may fault inside an
+// enclave.
+double MeasureCyclesPerNanosecond() {
+  struct timespec delay = {0, 100 * kNanosecondsPerMillisecond};
+  int64_t start_ns = MonotonicNanoseconds();
+  uint64_t start_cycles = __rdtsc();
+  nanosleep(&delay, nullptr);
+  uint64_t cycles = __rdtsc() - start_cycles;
+  int64_t elapsed_ns = MonotonicNanoseconds() - start_ns;
+  return static_cast<double>(cycles) / elapsed_ns;
+}
+
+// Parses a comma-separated list of positive sizes.
+std::vector<int64_t> ParseSizes(const std::string &flag) {
+  std::vector<int64_t> sizes;
+  for (const auto &size : absl::StrSplit(flag, ',')) {
+    int64_t value;
+    if (!absl::SimpleAtoi(size, &value) || value <= 0) {
+      LOG(QFATAL) << "Invalid size: " << size;
+    }
+    sizes.push_back(value);
+  }
+  return sizes;
+}
+
+// Returns the sizes at which |operation| is measured. Operations whose cost
+// does not depend on a size are measured once, at size zero.
+std::vector<int64_t> GetSizes(IdentityBenchmarkInput::Operation operation,
+                              const std::vector<int64_t> &secret_sizes,
+                              const std::vector<int64_t> &acl_sizes) {
+  switch (operation) {
+    case IdentityBenchmarkInput::SGX_LOCAL_SEAL:
+    case IdentityBenchmarkInput::SGX_LOCAL_UNSEAL:
+      return secret_sizes;
+    case IdentityBenchmarkInput::EVALUATE_IDENTITY_ACL:
+    case IdentityBenchmarkInput::IDENTITY_ACL_EVALUATOR:
+      return acl_sizes;
+    default:
+      return {0};
+  }
+}
+
+}  // namespace
+}  // namespace asylo
+
+int main(int argc, char *argv[]) {
+  ::google::ParseCommandLineFlags(&argc, &argv, /*remove_flags=*/true);
+
+  std::vector<asylo::IdentityBenchmarkInput::Operation> operations;
+  for (const auto &name : absl::StrSplit(FLAGS_operations, ',')) {
+    asylo::IdentityBenchmarkInput::Operation operation;
+    if (!asylo::IdentityBenchmarkInput::Operation_Parse(
+            absl::AsciiStrToUpper(name), &operation) ||
+        operation == asylo::IdentityBenchmarkInput::UNKNOWN) {
+      LOG(QFATAL) << "Unknown operation: " << name;
+    }
+    operations.push_back(operation);
+  }
+  std::vector<int64_t> secret_sizes = asylo::ParseSizes(FLAGS_secret_sizes);
+  std::vector<int64_t> acl_sizes = asylo::ParseSizes(FLAGS_acl_sizes);
+  std::vector<std::string> modes = absl::StrSplit(FLAGS_modes, ',');
+
+  asylo::HostConfig host_config;
+  host_config.set_local_attestation_domain(asylo::kLocalAttestationDomain);
+
+  asylo::EnclaveClient *client = nullptr;
+  asylo::EnclaveManager *manager = nullptr;
+  for (const auto &mode : modes) {
+    if (mode == "native") {
+      // Run the native measurements on a FakeEnclave with a random identity.
+      asylo::EnclaveConfig config;
+      *config.mutable_host_config() = host_config;
+      asylo::Status status = asylo::SetEnclaveConfig(config);
+      if (!status.ok()) {
+        LOG(QFATAL) << "SetEnclaveConfig failed: " << status;
+      }
+      asylo::sgx::FakeEnclave enclave;
+      enclave.SetRandomIdentity();
+      asylo::sgx::FakeEnclave::EnterEnclave(enclave);
+    } else if (mode == "enclave") {
+      asylo::EnclaveManager::Configure(
+          asylo::EnclaveManagerOptions().set_host_config(host_config));
+      auto manager_result = asylo::EnclaveManager::Instance();
+      if (!manager_result.ok()) {
+        LOG(QFATAL) << "EnclaveManager unavailable: "
+                    << manager_result.status();
+      }
+      manager = manager_result.ValueOrDie();
+      asylo::SGXLoader loader(FLAGS_enclave_path, /*debug=*/true);
+      asylo::Status status = manager->LoadEnclave(asylo::kEnclaveName, loader);
+      if (!status.ok()) {
+        LOG(QFATAL) << "Load " << FLAGS_enclave_path << " failed: " << status;
+      }
+      client = manager->GetClient(asylo::kEnclaveName);
+    } else {
+      LOG(QFATAL) << "Unknown mode: " << mode;
+    }
+  }
+
+  asylo::BenchmarkRecorder recorder("identity");
+  double cycles_per_ns = asylo::MeasureCyclesPerNanosecond();
+  printf("%-26s %-10s %8s %12s %12s\n", "operation", "mode", "size", "ops/s",
+         "cycles/op");
+  for (asylo::IdentityBenchmarkInput::Operation operation : operations) {
+    for (int64_t size :
+         asylo::GetSizes(operation, secret_sizes, acl_sizes)) {
+      for (const auto &mode : modes) {
+        asylo::IdentityBenchmarkInput input;
+        input.set_operation(operation);
+        input.set_size(size);
+        input.set_min_duration_ns(FLAGS_min_duration_ms *
+                                  asylo::kNanosecondsPerMillisecond);
+        input.set_warmup_ops(FLAGS_warmup_ops);
+
+        asylo::IdentityBenchmarkOutput result;
+        asylo::Status status;
+        if (mode == "native") {
+          status = asylo::RunIdentityBenchmark(input, &result);
+        } else {
+          asylo::EnclaveInput enclave_input;
+          *enclave_input.MutableExtension(asylo::identity_benchmark_input) =
+              input;
+          asylo::EnclaveOutput enclave_output;
+          status = client->EnterAndRun(enclave_input, &enclave_output);
+          result =
+              enclave_output.GetExtension(asylo::identity_benchmark_output);
+        }
+        if (!status.ok()) {
+          LOG(QFATAL) << "Benchmark run failed: " << status;
+        }
+
+        double cycles_per_op =
+            result.ops() > 0
+                ? result.elapsed_ns() * cycles_per_ns / result.ops()
+                : 0.0;
+        printf("%-26s %-10s %8lld %12.0f %12.0f\n",
+               asylo::IdentityBenchmarkInput::Operation_Name(operation)
+                   .c_str(),
+               mode == "native" ? "native" : FLAGS_enclave_label.c_str(),
+               static_cast<long long>(size), result.ops_per_second(),
+               cycles_per_op);
+
+        asylo::BenchmarkResult *recorded = recorder.AddResult(
+            {{"operation",
+              asylo::IdentityBenchmarkInput::Operation_Name(operation)},
+             {"mode", mode == "native" ? "native" : FLAGS_enclave_label},
+             {"size", absl::StrCat(size)}});
+        asylo::AddMetric("ops/s", result.ops_per_second(),
+                         asylo::BenchmarkMetric::HIGHER_IS_BETTER, recorded);
+        asylo::AddMetric("cycles/op", cycles_per_op,
+                         asylo::BenchmarkMetric::LOWER_IS_BETTER, recorded);
+      }
+    }
+  }
+
+  if (client) {
+    asylo::EnclaveFinal final_input;
+    asylo::Status status = manager->DestroyEnclave(client, final_input);
+    if (!status.ok()) {
+      LOG(QFATAL) << "Destroy " << FLAGS_enclave_path << " failed: " << status;
+    }
+  }
+
+  asylo::Status status = recorder.WriteJson(FLAGS_json_output);
+  if (!status.ok()) {
+    LOG(QFATAL) << status;
+  }
+  return 0;
+}
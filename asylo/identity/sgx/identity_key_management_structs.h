@@ -22,6 +22,7 @@
 #include "absl/base/attributes.h"
 #include "asylo/crypto/util/bytes.h"
 #include "asylo/identity/sgx/secs_attributes.h"
+#include "asylo/identity/util/aligned_object.h"
 #include "asylo/identity/util/aligned_object_ptr.h"
 #include <openssl/aes.h>
 #include <openssl/sha.h>
@@ -165,6 +166,7 @@ static_assert(sizeof(Keyrequest) == 512,
 // Aligned KEYREQUEST structure. SGX architecture requires this structure
 // to be aligned on a 512-byte boundary.
 using AlignedKeyrequestPtr = AlignedObjectPtr<Keyrequest, 512>;
+using AlignedKeyrequest = AlignedObject<Keyrequest, 512>;
 
 // TARGETINFO structure is used by software to define the identity of the
 // enclave to which an enclave identity report should be targeted. This
@@ -187,6 +189,8 @@ static_assert(sizeof(Targetinfo) == 512,
 // Aligned TARGETINFO structure. SGX architecture requires this structure
 // to be aligned on a 512-byte boundary.
 using AlignedTargetinfoPtr = AlignedObjectPtr<Targetinfo, 512>;
+using AlignedTargetinfo = AlignedObject<Targetinfo, 512>;
+using PooledTargetinfo = PooledAlignedObject<Targetinfo, 512>;
 
 // Size of REPORTDATA field in the REPORT and REPORTDATA structs defined below.
 constexpr int kReportdataSize = 64;
@@ -206,6 +210,8 @@ static_assert(sizeof(Reportdata) == kReportdataSize,
 // Aligned REPORTDATA structure. SGX architecture requires this structure to be
 // aligned on a 128-byte boundary.
 using AlignedReportdataPtr = AlignedObjectPtr<Reportdata, 128>;
+using AlignedReportdata = AlignedObject<Reportdata, 128>;
+using PooledReportdata = PooledAlignedObject<Reportdata, 128>;
 
 // Size of KEYID field in the REPORT struct defined below.
 constexpr int kReportKeyidSize = 32;
@@ -241,6 +247,8 @@ static_assert(sizeof(Report) == 432, "Size of struct Report is incorrect");
 // Aligned REPORT structure. SGX architecture requires this structure
 // to be aligned on a 512-byte boundary.
 using AlignedReportPtr = AlignedObjectPtr<Report, 512>;
+using AlignedReport = AlignedObject<Report, 512>;
+using PooledReport = PooledAlignedObject<Report, 512>;
 
 }  // namespace sgx
 }  // namespace asylo
@@ -114,7 +114,7 @@ Status GenerateCryptorKey(CipherSuite cipher_suite, const std::string &key_id,
   // the GetHardwareKey() calls.
 
   // Create and populate an aligned KEYREQUEST structure.
-  AlignedKeyrequestPtr req;
+  AlignedKeyrequest req;
   req->keyname = KeyrequestKeyname::SEAL_KEY;
   req->keypolicy = ConvertMatchSpecToKeypolicy(sgx_expectation.match_spec());
   req->isvsvn =
@@ -164,7 +164,7 @@ Status GenerateCryptorKey(CipherSuite cipher_suite, const std::string &key_id,
 
     SHA256(key_info.data(), key_info.size(), req->keyid.data());
 
-    AlignedHardwareKeyPtr hardware_key;
+    AlignedHardwareKey hardware_key;
     if (!GetHardwareKey(*req, hardware_key.get())) {
       return Status(::asylo::error::GoogleError::INTERNAL,
                     "Could not get required hardware key");
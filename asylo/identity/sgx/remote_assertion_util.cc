@@ -65,7 +65,44 @@ Status VerifyRemoteAssertion(const std::string &user_data,
                              const std::vector<Certificate> &root_certificates,
                              const RemoteAssertion &assertion,
                              CodeIdentity *identity) {
-  return Status(error::GoogleError::UNIMPLEMENTED, "Not implemented");
+  if (!root_certificates.empty()) {
+    return Status(error::GoogleError::UNIMPLEMENTED,
+                  "Certificate chain verification is not implemented");
+  }
+
+  // The signature is checked against the caller's parsed key before anything
+  // else, so verifying an assertion costs a single signature check.
+  if (assertion.signature_scheme() != verifying_key.GetSignatureScheme()) {
+    return Status(error::GoogleError::INVALID_ARGUMENT,
+                  "Assertion signature scheme does not match verifying key");
+  }
+  Status status =
+      verifying_key.Verify(assertion.payload(), assertion.signature());
+  if (!status.ok()) {
+    return status;
+  }
+
+  RemoteAssertionPayload payload;
+  if (!payload.ParseFromString(assertion.payload())) {
+    return Status(error::GoogleError::INVALID_ARGUMENT,
+                  "Failed to parse assertion payload");
+  }
+  if (payload.version() != kRemoteAssertionVersion) {
+    return Status(error::GoogleError::INVALID_ARGUMENT,
+                  absl::StrCat("Unsupported assertion version: ",
+                               payload.version()));
+  }
+  if (payload.signature_scheme() != assertion.signature_scheme()) {
+    return Status(error::GoogleError::INVALID_ARGUMENT,
+                  "Payload signature scheme does not match assertion");
+  }
+  if (payload.user_data() != user_data) {
+    return Status(error::GoogleError::INVALID_ARGUMENT,
+                  "Assertion is not bound to the provided user data");
+  }
+
+  *identity = payload.identity();
+  return Status::OkStatus();
 }
 
 }  // namespace sgx
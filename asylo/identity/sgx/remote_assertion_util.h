@@ -47,6 +47,11 @@ Status MakeRemoteAssertion(const std::string &user_data,
 //   root certificate in |root_certificates|.
 //
 // On success, extracts the peer's verified CodeIdentity to |identity|.
+//
+// The signature is checked with |verifying_key| as given, so callers
+// verifying many assertions from the same signer should parse the key once and
+// reuse it. Certificate chain verification is not yet implemented: a non-empty
+// |root_certificates| results in an UNIMPLEMENTED error.
 Status VerifyRemoteAssertion(const std::string &user_data,
                              const VerifyingKey &verifying_key,
                              const std::vector<Certificate> &root_certificates,
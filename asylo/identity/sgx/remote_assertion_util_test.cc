@@ -34,6 +34,8 @@ namespace asylo {
 namespace sgx {
 namespace {
 
+using ::testing::Not;
+
 constexpr char kUserData[] = "User Data";
 constexpr char kCertificate[] = "Certificate";
 
@@ -76,6 +78,78 @@ TEST(RemoteAssertionUtilTest, MakeRemoteAssertionSucceeds) {
               IsOk());
 }
 
+class VerifyRemoteAssertionTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    auto signing_key_result = EcdsaP256Sha256SigningKey::Create();
+    ASSERT_THAT(signing_key_result, IsOk());
+    signing_key_ = std::move(signing_key_result).ValueOrDie();
+    auto verifying_key_result = signing_key_->GetVerifyingKey();
+    ASSERT_THAT(verifying_key_result, IsOk());
+    verifying_key_ = std::move(verifying_key_result).ValueOrDie();
+
+    SetDefaultCodeIdentity(&identity_);
+    ASSERT_THAT(MakeRemoteAssertion(kUserData, identity_, *signing_key_,
+                                    /*cert_chains=*/{}, &assertion_),
+                IsOk());
+  }
+
+  std::unique_ptr<EcdsaP256Sha256SigningKey> signing_key_;
+  std::unique_ptr<VerifyingKey> verifying_key_;
+  CodeIdentity identity_;
+  RemoteAssertion assertion_;
+};
+
+TEST_F(VerifyRemoteAssertionTest, VerifySucceeds) {
+  CodeIdentity identity;
+  ASSERT_THAT(VerifyRemoteAssertion(kUserData, *verifying_key_,
+                                    /*root_certificates=*/{}, assertion_,
+                                    &identity),
+              IsOk());
+  EXPECT_THAT(identity, EqualsProto(identity_));
+}
+
+TEST_F(VerifyRemoteAssertionTest, WrongUserDataFails) {
+  CodeIdentity identity;
+  EXPECT_THAT(VerifyRemoteAssertion("Other User Data", *verifying_key_,
+                                    /*root_certificates=*/{}, assertion_,
+                                    &identity),
+              Not(IsOk()));
+}
+
+TEST_F(VerifyRemoteAssertionTest, ModifiedPayloadFails) {
+  assertion_.mutable_payload()->back() ^= 1;
+  CodeIdentity identity;
+  EXPECT_THAT(VerifyRemoteAssertion(kUserData, *verifying_key_,
+                                    /*root_certificates=*/{}, assertion_,
+                                    &identity),
+              Not(IsOk()));
+}
+
+TEST_F(VerifyRemoteAssertionTest, OtherSignerFails) {
+  auto other_key_result = EcdsaP256Sha256SigningKey::Create();
+  ASSERT_THAT(other_key_result, IsOk());
+  auto other_verifying_key_result =
+      other_key_result.ValueOrDie()->GetVerifyingKey();
+  ASSERT_THAT(other_verifying_key_result, IsOk());
+  CodeIdentity identity;
+  EXPECT_THAT(VerifyRemoteAssertion(kUserData,
+                                    *other_verifying_key_result.ValueOrDie(),
+                                    /*root_certificates=*/{}, assertion_,
+                                    &identity),
+              Not(IsOk()));
+}
+
+TEST_F(VerifyRemoteAssertionTest, RootCertificatesAreUnimplemented) {
+  std::vector<Certificate> root_certificates(1);
+  root_certificates[0].set_format(Certificate_CertificateFormat_X509_DER);
+  root_certificates[0].set_data(kCertificate);
+  CodeIdentity identity;
+  EXPECT_THAT(VerifyRemoteAssertion(kUserData, *verifying_key_,
+                                    root_certificates, assertion_, &identity),
+              StatusIs(error::GoogleError::UNIMPLEMENTED));
+}
+
 }  // namespace
 }  // namespace sgx
 }  // namespace asylo
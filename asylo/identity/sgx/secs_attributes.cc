@@ -100,6 +100,36 @@ constexpr SecsAttributeBit kAllSecsAttributes[] = {
 constexpr SecsAttributeBit kMustBeSetAttributes[] = {
     SecsAttributeBit::INIT, SecsAttributeBit::FPU, SecsAttributeBit::SSE};
 
+// Returns the SecsAttributeSet holding the bits of |attributes| from position
+// |index| on.
+template <size_t N>
+constexpr SecsAttributeSet MaskFromList(const SecsAttributeBit (&attributes)[N],
+                                        size_t index = 0) {
+  return index == N ? SecsAttributeSet{0, 0}
+                    : MakeSecsAttributeSet(attributes[index]) |
+                          MaskFromList(attributes, index + 1);
+}
+
+// The above lists as masks, so that callers do not convert the lists on every
+// call.
+constexpr SecsAttributeSet kDefaultDoNotCareSecsAttributeSet =
+    MaskFromList(kDefaultDoNotCareSecsAttributes);
+constexpr SecsAttributeSet kAllSecsAttributeSet =
+    MaskFromList(kAllSecsAttributes);
+constexpr SecsAttributeSet kMustBeSetSecsAttributeSet =
+    MaskFromList(kMustBeSetAttributes);
+
+// Appends the attributes set in |word|, whose bit 0 is attribute |base|, to
+// |attribute_list|.
+void AppendAttributesInWord(uint64_t word, size_t base,
+                            std::vector<SecsAttributeBit> *attribute_list) {
+  while (word != 0) {
+    attribute_list->push_back(
+        static_cast<SecsAttributeBit>(base + __builtin_ctzll(word)));
+    word &= word - 1;
+  }
+}
+
 std::pair<SecsAttributeBit, const char *> kPrintableSecsAttributeBitNames[] = {
     {SecsAttributeBit::INIT, "INIT"},
     {SecsAttributeBit::DEBUG, "DEBUG"},
@@ -134,39 +164,6 @@ void ClearSecsAttributeSet(SecsAttributeSet *attributes) {
   attributes->xfrm = 0;
 }
 
-SecsAttributeSet operator|(const SecsAttributeSet &lhs,
-                           const SecsAttributeSet &rhs) {
-  SecsAttributeSet result;
-  result.flags = lhs.flags | rhs.flags;
-  result.xfrm = lhs.xfrm | rhs.xfrm;
-
-  return result;
-}
-
-SecsAttributeSet operator&(const SecsAttributeSet &lhs,
-                           const SecsAttributeSet &rhs) {
-  SecsAttributeSet result;
-  result.flags = lhs.flags & rhs.flags;
-  result.xfrm = lhs.xfrm & rhs.xfrm;
-
-  return result;
-}
-
-SecsAttributeSet operator~(const SecsAttributeSet &value) {
-  SecsAttributeSet tmp;
-  tmp.flags = ~value.flags;
-  tmp.xfrm = ~value.xfrm;
-  return tmp;
-}
-
-bool operator==(const SecsAttributeSet &lhs, const SecsAttributeSet &rhs) {
-  return memcmp(&lhs, &rhs, sizeof(lhs)) == 0;
-}
-
-bool operator!=(const SecsAttributeSet &lhs, const SecsAttributeSet &rhs) {
-  return !(lhs == rhs);
-}
-
 bool ConvertSecsAttributeRepresentation(
     const std::vector<SecsAttributeBit> &attribute_list,
     SecsAttributeSet *attributes) {
@@ -192,17 +189,8 @@ bool ConvertSecsAttributeRepresentation(
     const SecsAttributeSet &attributes,
     std::vector<SecsAttributeBit> *attribute_list) {
   attribute_list->clear();
-  for (uint32_t i = 0; i < kNumFlagsBits; i++) {
-    if (attributes.flags & (1ULL << i)) {
-      attribute_list->push_back(static_cast<SecsAttributeBit>(i));
-    }
-  }
-  for (uint32_t i = 0; i < kNumXfrmBits; i++) {
-    if (attributes.xfrm & (1ULL << i)) {
-      attribute_list->push_back(
-          static_cast<SecsAttributeBit>(i + kNumFlagsBits));
-    }
-  }
+  AppendAttributesInWord(attributes.flags, 0, attribute_list);
+  AppendAttributesInWord(attributes.xfrm, kNumFlagsBits, attribute_list);
   return true;
 }
 
@@ -232,17 +220,8 @@ bool ConvertSecsAttributeRepresentation(
     const BitVector128 &bit_vector,
     std::vector<SecsAttributeBit> *attribute_list) {
   attribute_list->clear();
-  for (uint32_t i = 0; i < kNumFlagsBits; i++) {
-    if (bit_vector.low() & (1ULL << i)) {
-      attribute_list->push_back(static_cast<SecsAttributeBit>(i));
-    }
-  }
-  for (uint32_t i = 0; i < kNumXfrmBits; i++) {
-    if (bit_vector.high() & (1ULL << i)) {
-      attribute_list->push_back(
-          static_cast<SecsAttributeBit>(i + kNumFlagsBits));
-    }
-  }
+  AppendAttributesInWord(bit_vector.low(), 0, attribute_list);
+  AppendAttributesInWord(bit_vector.high(), kNumFlagsBits, attribute_list);
   return true;
 }
 
@@ -303,45 +282,32 @@ bool GetDefaultDoNotCareSecsAttributes(
 }
 
 bool GetAllSecsAttributes(SecsAttributeSet *attributes) {
-  std::vector<SecsAttributeBit> attribute_list(
-      kAllSecsAttributes, kAllSecsAttributes + arraysize(kAllSecsAttributes));
-  return ConvertSecsAttributeRepresentation(attribute_list, attributes);
+  *attributes = kAllSecsAttributeSet;
+  return true;
 }
 
 bool GetAllSecsAttributes(BitVector128 *bit_vector) {
-  std::vector<SecsAttributeBit> attribute_list(
-      kAllSecsAttributes, kAllSecsAttributes + arraysize(kAllSecsAttributes));
-  return ConvertSecsAttributeRepresentation(attribute_list, bit_vector);
+  return ConvertSecsAttributeRepresentation(kAllSecsAttributeSet, bit_vector);
 }
 
 bool GetMustBeSetSecsAttributes(SecsAttributeSet *attributes) {
-  std::vector<SecsAttributeBit> attribute_list(
-      kMustBeSetAttributes,
-      kMustBeSetAttributes + arraysize(kMustBeSetAttributes));
-  return ConvertSecsAttributeRepresentation(attribute_list, attributes);
+  *attributes = kMustBeSetSecsAttributeSet;
+  return true;
 }
 
 bool GetMustBeSetSecsAttributes(BitVector128 *bit_vector) {
-  std::vector<SecsAttributeBit> attribute_list(
-      kMustBeSetAttributes,
-      kMustBeSetAttributes + arraysize(kMustBeSetAttributes));
-  return ConvertSecsAttributeRepresentation(attribute_list, bit_vector);
+  return ConvertSecsAttributeRepresentation(kMustBeSetSecsAttributeSet,
+                                            bit_vector);
 }
 
 bool GetDefaultDoNotCareSecsAttributes(SecsAttributeSet *attributes) {
-  std::vector<SecsAttributeBit> attribute_list(
-      kDefaultDoNotCareSecsAttributes,
-      kDefaultDoNotCareSecsAttributes +
-          arraysize(kDefaultDoNotCareSecsAttributes));
-  return ConvertSecsAttributeRepresentation(attribute_list, attributes);
+  *attributes = kDefaultDoNotCareSecsAttributeSet;
+  return true;
 }
 
 bool GetDefaultDoNotCareSecsAttributes(BitVector128 *bit_vector) {
-  std::vector<SecsAttributeBit> attribute_list(
-      kDefaultDoNotCareSecsAttributes,
-      kDefaultDoNotCareSecsAttributes +
-          arraysize(kDefaultDoNotCareSecsAttributes));
-  return ConvertSecsAttributeRepresentation(attribute_list, bit_vector);
+  return ConvertSecsAttributeRepresentation(kDefaultDoNotCareSecsAttributeSet,
+                                            bit_vector);
 }
 
 void GetPrintableAttributeList(
@@ -82,21 +82,53 @@ enum class SecsAttributeBit {
 void ClearSecsAttributeSet(SecsAttributeSet *attributes);
 
 // Computes bitwise OR of two SecsAttributeSet values.
-SecsAttributeSet operator|(const SecsAttributeSet &lhs,
-                           const SecsAttributeSet &rhs);
+constexpr SecsAttributeSet operator|(const SecsAttributeSet &lhs,
+                                     const SecsAttributeSet &rhs) {
+  return {lhs.flags | rhs.flags, lhs.xfrm | rhs.xfrm};
+}
 
 // Computes bitwise AND of two SecsAttributeSet values.
-SecsAttributeSet operator&(const SecsAttributeSet &lhs,
-                           const SecsAttributeSet &rhs);
+constexpr SecsAttributeSet operator&(const SecsAttributeSet &lhs,
+                                     const SecsAttributeSet &rhs) {
+  return {lhs.flags & rhs.flags, lhs.xfrm & rhs.xfrm};
+}
+
+// Computes bitwise XOR of two SecsAttributeSet values.
+constexpr SecsAttributeSet operator^(const SecsAttributeSet &lhs,
+                                     const SecsAttributeSet &rhs) {
+  return {lhs.flags ^ rhs.flags, lhs.xfrm ^ rhs.xfrm};
+}
 
 // Computes bitwise negation of an SecsAttributeSet value.
-SecsAttributeSet operator~(const SecsAttributeSet &value);
+constexpr SecsAttributeSet operator~(const SecsAttributeSet &value) {
+  return {~value.flags, ~value.xfrm};
+}
 
 // Checks two SecsAttributeSet values for equality.
-bool operator==(const SecsAttributeSet &lhs, const SecsAttributeSet &rhs);
+constexpr bool operator==(const SecsAttributeSet &lhs,
+                          const SecsAttributeSet &rhs) {
+  return lhs.flags == rhs.flags && lhs.xfrm == rhs.xfrm;
+}
 
 // Checks two SecsAttributeSet values for inequality.
-bool operator!=(const SecsAttributeSet &lhs, const SecsAttributeSet &rhs);
+constexpr bool operator!=(const SecsAttributeSet &lhs,
+                          const SecsAttributeSet &rhs) {
+  return !(lhs == rhs);
+}
+
+// Returns an SecsAttributeSet with only |attribute| set. |attribute| must be
+// less than 128.
+constexpr SecsAttributeSet MakeSecsAttributeSet(SecsAttributeBit attribute) {
+  return static_cast<size_t>(attribute) < 64
+             ? SecsAttributeSet{1ULL << static_cast<size_t>(attribute), 0}
+             : SecsAttributeSet{
+                   0, 1ULL << (static_cast<size_t>(attribute) - 64)};
+}
+
+// Returns the SecsAttributeSet held in |bit_vector|.
+inline SecsAttributeSet MakeSecsAttributeSet(const BitVector128 &bit_vector) {
+  return {bit_vector.low(), bit_vector.high()};
+}
 
 // Converts a list of SecsAttributeBit values to an SecsAttributeSet.
 bool ConvertSecsAttributeRepresentation(
@@ -175,6 +175,53 @@ TEST_F(SecsAttributesTest, BitwiseNegation) {
   }
 }
 
+// Verify the correctness of bit-wise XOR operator.
+TEST_F(SecsAttributesTest, BitwiseXor) {
+  SecsAttributeSet zeros = TrivialZeroObject<SecsAttributeSet>();
+  for (const SecsAttributeSet &set : attribute_sets_) {
+    EXPECT_EQ(set ^ set, zeros);
+    EXPECT_EQ(set ^ zeros, set);
+    EXPECT_EQ(all_attributes_ ^ set, all_attributes_ & ~set);
+  }
+}
+
+// Verify the correctness of single-attribute sets.
+TEST_F(SecsAttributesTest, MakeSecsAttributeSet) {
+  for (int i = 0; i < attributes_.size(); i++) {
+    EXPECT_EQ(MakeSecsAttributeSet(attributes_[i]), attribute_sets_[i]);
+  }
+
+  BitVector128 bit_vector;
+  bit_vector.set_low(all_attributes_.flags);
+  bit_vector.set_high(all_attributes_.xfrm);
+  EXPECT_EQ(MakeSecsAttributeSet(bit_vector), all_attributes_);
+}
+
+// Verify that the attribute masks match their list forms.
+TEST_F(SecsAttributesTest, AttributeMasks) {
+  SecsAttributeSet set;
+  BitVector128 bit_vector;
+
+  ASSERT_TRUE(GetAllSecsAttributes(&set));
+  EXPECT_EQ(set, all_attributes_);
+  ASSERT_TRUE(GetAllSecsAttributes(&bit_vector));
+  EXPECT_EQ(MakeSecsAttributeSet(bit_vector), all_attributes_);
+
+  ASSERT_TRUE(GetMustBeSetSecsAttributes(&set));
+  EXPECT_EQ(set, (SecsAttributeSet{0x1, 0x3}));
+  ASSERT_TRUE(GetMustBeSetSecsAttributes(&bit_vector));
+  EXPECT_EQ(MakeSecsAttributeSet(bit_vector), (SecsAttributeSet{0x1, 0x3}));
+
+  std::vector<SecsAttributeBit> attribute_list;
+  SecsAttributeSet list_set;
+  ASSERT_TRUE(GetDefaultDoNotCareSecsAttributes(&attribute_list));
+  ASSERT_TRUE(ConvertSecsAttributeRepresentation(attribute_list, &list_set));
+  ASSERT_TRUE(GetDefaultDoNotCareSecsAttributes(&set));
+  EXPECT_EQ(set, list_set);
+  ASSERT_TRUE(GetDefaultDoNotCareSecsAttributes(&bit_vector));
+  EXPECT_EQ(MakeSecsAttributeSet(bit_vector), list_set);
+}
+
 // Verify the correctness of conversion from attribute list to attribute set.
 TEST_F(SecsAttributesTest, ListToSet) {
   for (int i = 0; i < attributes_.size(); i++) {
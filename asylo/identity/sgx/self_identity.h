@@ -45,6 +45,9 @@ struct SelfIdentity {
 
   // Protobuf represenation of the enclave identity.
   CodeIdentity identity;
+
+  // A TARGETINFO that targets the current enclave, built from the raw fields.
+  Targetinfo targetinfo;
 };
 
 // Returns a pointer to a SelfIdentity object that holds identity of the current
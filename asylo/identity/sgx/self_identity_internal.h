@@ -36,9 +36,9 @@ namespace sgx {
 // The following constructor is defined in a header file so that it could be
 // used across self_identity.cc and fake_self_identity.cc.
 SelfIdentity::SelfIdentity() {
-  AlignedTargetinfoPtr tinfo;
-  AlignedReportdataPtr reportdata;
-  AlignedReportPtr report;
+  AlignedTargetinfo tinfo;
+  AlignedReportdata reportdata;
+  AlignedReport report;
 
   *tinfo = TrivialZeroObject<Targetinfo>();
   *reportdata = TrivialZeroObject<Reportdata>();
@@ -59,6 +59,11 @@ SelfIdentity::SelfIdentity() {
   if (!status.ok()) {
     LOG(FATAL) << status;
   }
+
+  targetinfo = TrivialZeroObject<Targetinfo>();
+  targetinfo.measurement = mrenclave;
+  targetinfo.attributes = attributes;
+  targetinfo.miscselect = miscselect;
 }
 
 }  // namespace sgx
@@ -18,9 +18,52 @@
 
 #include "asylo/identity/sgx/sgx_code_identity_expectation_matcher.h"
 
+#include "absl/memory/memory.h"
+#include "asylo/identity/sgx/code_identity.pb.h"
 #include "asylo/identity/sgx/code_identity_util.h"
 
 namespace asylo {
+namespace {
+
+// An SGX code-identity expectation that has been parsed and packed once, so
+// that matching an identity against it only parses the identity and compares a
+// few machine words.
+class PreparedSgxExpectation final
+    : public NamedIdentityExpectationMatcher::PreparedExpectation {
+ public:
+  explicit PreparedSgxExpectation(
+      const sgx::CodeIdentityExpectation &expectation)
+      : expectation_(expectation) {
+    is_packed_ =
+        sgx::PackCodeIdentityExpectation(expectation_, &packed_expectation_)
+            .ok();
+  }
+
+  StatusOr<bool> Match(const EnclaveIdentity &identity) const override {
+    sgx::CodeIdentity code_identity;
+    Status status = sgx::ParseSgxIdentity(identity, &code_identity);
+    if (!status.ok()) {
+      return status;
+    }
+
+    // Identities and expectations that cannot be packed are left to the proto
+    // matcher, which reports the same errors as an unprepared match.
+    sgx::PackedCodeIdentity packed_identity;
+    if (is_packed_ &&
+        sgx::PackCodeIdentity(code_identity, &packed_identity).ok()) {
+      return sgx::MatchPackedIdentityToExpectation(packed_identity,
+                                                   packed_expectation_);
+    }
+    return sgx::MatchIdentityToExpectation(code_identity, expectation_);
+  }
+
+ private:
+  const sgx::CodeIdentityExpectation expectation_;
+  sgx::PackedCodeIdentityExpectation packed_expectation_;
+  bool is_packed_;
+};
+
+}  // namespace
 
 StatusOr<bool> SgxCodeIdentityExpectationMatcher::Match(
     const EnclaveIdentity &identity,
@@ -51,6 +94,19 @@ EnclaveIdentityDescription SgxCodeIdentityExpectationMatcher::Description()
   return description;
 }
 
+StatusOr<std::unique_ptr<NamedIdentityExpectationMatcher::PreparedExpectation>>
+SgxCodeIdentityExpectationMatcher::PrepareExpectation(
+    const EnclaveIdentityExpectation &expectation) const {
+  sgx::CodeIdentityExpectation code_identity_expectation;
+  Status status =
+      sgx::ParseSgxExpectation(expectation, &code_identity_expectation);
+  if (!status.ok()) {
+    return status;
+  }
+  return std::unique_ptr<PreparedExpectation>(
+      absl::make_unique<PreparedSgxExpectation>(code_identity_expectation));
+}
+
 // Static registration of the CodeIdentityExpectationMatcher library.
 SET_STATIC_MAP_VALUE_OF_DERIVED_TYPE(IdentityExpectationMatcherMap,
                                      SgxCodeIdentityExpectationMatcher);
@@ -19,6 +19,8 @@
 #ifndef ASYLO_IDENTITY_SGX_SGX_CODE_IDENTITY_EXPECTATION_MATCHER_H_
 #define ASYLO_IDENTITY_SGX_SGX_CODE_IDENTITY_EXPECTATION_MATCHER_H_
 
+#include <memory>
+
 #include "asylo/identity/identity.pb.h"
 #include "asylo/identity/named_identity_expectation_matcher.h"
 
@@ -39,6 +41,8 @@ class SgxCodeIdentityExpectationMatcher final
 
   // From the NamedIdentityExpectationMatcher interface.
   EnclaveIdentityDescription Description() const override;
+  StatusOr<std::unique_ptr<PreparedExpectation>> PrepareExpectation(
+      const EnclaveIdentityExpectation &expectation) const override;
 };
 
 }  // namespace asylo
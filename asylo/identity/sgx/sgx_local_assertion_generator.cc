@@ -20,6 +20,7 @@
 
 #include <string>
 
+#include <google/protobuf/arena.h>
 #include "absl/synchronization/mutex.h"
 #include "asylo/crypto/sha256_hash.h"
 #include "asylo/crypto/util/bytes.h"
@@ -28,6 +29,7 @@
 #include "asylo/identity/sgx/hardware_interface.h"
 #include "asylo/identity/sgx/identity_key_management_structs.h"
 #include "asylo/identity/sgx/local_assertion.pb.h"
+#include "asylo/identity/sgx/self_identity.h"
 #include "asylo/platform/core/trusted_global_state.h"
 
 namespace asylo {
@@ -103,42 +105,56 @@ StatusOr<bool> SgxLocalAssertionGenerator::CanGenerate(
     return Status(error::GoogleError::FAILED_PRECONDITION, "Not initialized");
   }
 
-  StatusOr<sgx::LocalAssertionRequestAdditionalInfo> additional_info_result =
-      ParseAdditionalInfo(request);
-
-  if (!additional_info_result.ok()) {
-    return additional_info_result.status();
+  sgx::LocalAssertionRequestAdditionalInfo additional_info;
+  Status status = ParseAdditionalInfo(request, &additional_info);
+  if (!status.ok()) {
+    return status;
   }
 
-  sgx::LocalAssertionRequestAdditionalInfo additional_info =
-      additional_info_result.ValueOrDie();
-
   return additional_info.local_attestation_domain() == attestation_domain_;
 }
 
 Status SgxLocalAssertionGenerator::Generate(const std::string &user_data,
                                             const AssertionRequest &request,
                                             Assertion *assertion) const {
+  return Generate(user_data, request, assertion, /*arena=*/nullptr);
+}
+
+Status SgxLocalAssertionGenerator::Generate(
+    const std::string &user_data, const AssertionRequest &request,
+    Assertion *assertion, google::protobuf::Arena *arena) const {
   if (!IsInitialized()) {
     return Status(error::GoogleError::FAILED_PRECONDITION, "Not initialized");
   }
 
-  StatusOr<sgx::LocalAssertionRequestAdditionalInfo> additional_info_result =
-      ParseAdditionalInfo(request);
-  if (!additional_info_result.ok()) {
-    return additional_info_result.status();
+  // Temporary messages are allocated on |arena|, or on an arena that is local
+  // to this call if the caller did not provide one.
+  google::protobuf::Arena local_arena;
+  if (arena == nullptr) {
+    arena = &local_arena;
   }
 
-  sgx::LocalAssertionRequestAdditionalInfo additional_info =
-      additional_info_result.ValueOrDie();
+  sgx::LocalAssertionRequestAdditionalInfo *additional_info =
+      google::protobuf::Arena::CreateMessage<
+          sgx::LocalAssertionRequestAdditionalInfo>(arena);
+  Status status = ParseAdditionalInfo(request, additional_info);
+  if (!status.ok()) {
+    return status;
+  }
 
-  if (additional_info.local_attestation_domain() != attestation_domain_) {
+  if (additional_info->local_attestation_domain() != attestation_domain_) {
     return Status(error::GoogleError::INVALID_ARGUMENT,
                   "AssertionRequest specifies non-local attestation domain");
   }
 
-  sgx::AlignedTargetinfoPtr tinfo;
-  if (additional_info.targetinfo().size() != sizeof(*tinfo)) {
+  // The REPORT is generated in buffers recycled by this thread, so that
+  // assertion generation does not allocate them anew, and the strictly aligned
+  // structures are kept off the stack of the handshake.
+  sgx::PooledTargetinfo pooled_tinfo;
+  sgx::PooledReportdata pooled_reportdata;
+  sgx::PooledReport pooled_report;
+  sgx::Targetinfo *tinfo = pooled_tinfo.get();
+  if (additional_info->targetinfo().size() != sizeof(*tinfo)) {
     return Status(error::GoogleError::INVALID_ARGUMENT,
                   "TARGETINFO from AssertionRequest has incorrect size");
   }
@@ -152,7 +168,7 @@ Status SgxLocalAssertionGenerator::Generate(const std::string &user_data,
   // LocalAssertionGenerator runs inside an SGX enclave, it is safe to restore
   // the TARGETINFO structure directly from the request.
   *tinfo = TrivialObjectFromBinaryString<sgx::Targetinfo>(
-      additional_info.targetinfo());
+      additional_info->targetinfo());
 
   // The REPORTDATA is a user-provided input to the hardware report that is
   // included in the report's MAC. Use a SHA256 hash of |user_data| as the
@@ -160,7 +176,7 @@ Status SgxLocalAssertionGenerator::Generate(const std::string &user_data,
   // to this user-provided data. Note that the SHA256 hash only occupies the
   // lower 32 bytes of the 64-byte REPORTDATA structure so the structure is
   // pre-filled with an additional 32 zeros.
-  sgx::AlignedReportdataPtr reportdata;
+  sgx::Reportdata *reportdata = pooled_reportdata.get();
   Sha256Hash hash;
   hash.Update(user_data.data(), user_data.size());
   reportdata->data = TrivialZeroObject<UnsafeBytes<sgx::kReportdataSize>>();
@@ -168,8 +184,8 @@ Status SgxLocalAssertionGenerator::Generate(const std::string &user_data,
 
   // Generate a REPORT that is bound to the provided |user_data| and is targeted
   // at the enclave described in the request.
-  sgx::AlignedReportPtr report;
-  if (!sgx::GetHardwareReport(*tinfo, *reportdata, report.get())) {
+  sgx::Report *report = pooled_report.get();
+  if (!sgx::GetHardwareReport(*tinfo, *reportdata, report)) {
     return Status(error::GoogleError::INTERNAL, "Failed to generate a REPORT");
   }
 
@@ -179,11 +195,12 @@ Status SgxLocalAssertionGenerator::Generate(const std::string &user_data,
   // the raw bytes of the report is sufficient when the structure is sent
   // between two SGX-enabled machines. An SGX-enabled assertion verifier should
   // be able to restore these bytes into a valid REPORT structure.
-  sgx::LocalAssertion local_assertion;
-  local_assertion.set_report(reinterpret_cast<const char *>(report.get()),
-                             sizeof(*report));
+  sgx::LocalAssertion *local_assertion =
+      google::protobuf::Arena::CreateMessage<sgx::LocalAssertion>(arena);
+  local_assertion->set_report(reinterpret_cast<const char *>(report),
+                              sizeof(*report));
 
-  if (!local_assertion.SerializeToString(assertion->mutable_assertion())) {
+  if (!local_assertion->SerializeToString(assertion->mutable_assertion())) {
     return Status(error::GoogleError::INTERNAL,
                   "Failed to serialize local assertion");
   }
@@ -193,21 +210,20 @@ Status SgxLocalAssertionGenerator::Generate(const std::string &user_data,
   return Status::OkStatus();
 }
 
-StatusOr<sgx::LocalAssertionRequestAdditionalInfo>
-SgxLocalAssertionGenerator::ParseAdditionalInfo(
-    const AssertionRequest &request) const {
+Status SgxLocalAssertionGenerator::ParseAdditionalInfo(
+    const AssertionRequest &request,
+    sgx::LocalAssertionRequestAdditionalInfo *additional_info) const {
   if (!IsCompatibleAssertionDescription(request.description())) {
     return Status(error::GoogleError::INVALID_ARGUMENT,
                   "Incompatible assertion description");
   }
 
-  sgx::LocalAssertionRequestAdditionalInfo additional_info;
-  if (!additional_info.ParseFromString(request.additional_information())) {
+  if (!additional_info->ParseFromString(request.additional_information())) {
     return Status(error::GoogleError::INTERNAL,
                   "Failed to parse request additional information");
   }
 
-  return additional_info;
+  return Status::OkStatus();
 }
 
 // Static registration of the LocalAssertionGenerator library.
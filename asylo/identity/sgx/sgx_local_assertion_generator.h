@@ -21,6 +21,7 @@
 
 #include "asylo/identity/enclave_assertion_generator.h"
 
+#include <google/protobuf/arena.h>
 #include "absl/synchronization/mutex.h"
 #include "asylo/identity/sgx/local_assertion.pb.h"
 
@@ -62,12 +63,16 @@ class SgxLocalAssertionGenerator final : public EnclaveAssertionGenerator {
   Status Generate(const std::string &user_data, const AssertionRequest &request,
                   Assertion *assertion) const override;
 
+  Status Generate(const std::string &user_data, const AssertionRequest &request,
+                  Assertion *assertion,
+                  google::protobuf::Arena *arena) const override;
+
  private:
-  // Parses additional information from the given |request|. Returns the
-  // LocalAssertionRequestAdditionalInfo on success. Returns a non-OK status on
-  // parsing failure.
-  StatusOr<sgx::LocalAssertionRequestAdditionalInfo> ParseAdditionalInfo(
-      const AssertionRequest &request) const;
+  // Parses additional information from the given |request| into
+  // |additional_info|. Returns a non-OK status on parsing failure.
+  Status ParseAdditionalInfo(
+      const AssertionRequest &request,
+      sgx::LocalAssertionRequestAdditionalInfo *additional_info) const;
 
   // The identity type handled by this generator.
   static constexpr EnclaveIdentityType identity_type_ = CODE_IDENTITY;
@@ -18,8 +18,10 @@
 
 #include "asylo/identity/sgx/sgx_local_assertion_verifier.h"
 
+#include <cstddef>
 #include <string>
 
+#include <google/protobuf/arena.h>
 #include "absl/synchronization/mutex.h"
 #include "asylo/crypto/sha256_hash.h"
 #include "asylo/crypto/util/bytes.h"
@@ -132,10 +134,47 @@ StatusOr<bool> SgxLocalAssertionVerifier::CanVerify(
 Status SgxLocalAssertionVerifier::Verify(const std::string &user_data,
                                          const Assertion &assertion,
                                          EnclaveIdentity *peer_identity) const {
-  if (!IsInitialized()) {
-    return Status(error::GoogleError::FAILED_PRECONDITION, "Not initialized");
+  return Verify(user_data, assertion, peer_identity, /*arena=*/nullptr);
+}
+
+Status SgxLocalAssertionVerifier::Verify(const std::string &user_data,
+                                         const Assertion &assertion,
+                                         EnclaveIdentity *peer_identity,
+                                         google::protobuf::Arena *arena) const {
+  // Temporary messages are allocated on |arena|, or on an arena that is local
+  // to this call if the caller did not provide one.
+  google::protobuf::Arena local_arena;
+  if (arena == nullptr) {
+    arena = &local_arena;
+  }
+
+  sgx::Report report;
+  Status status = VerifyReport(user_data, assertion, arena, &report);
+  if (!status.ok()) {
+    return status;
+  }
+
+  // Serialize the protobuf representation of the peer's SGX code identity and
+  // save it in |peer_identity|.
+  sgx::CodeIdentity *code_identity =
+      google::protobuf::Arena::CreateMessage<sgx::CodeIdentity>(arena);
+  status = sgx::ParseIdentityFromHardwareReport(report, code_identity);
+  if (!status.ok()) {
+    return status;
+  }
+
+  if (!code_identity->SerializeToString(peer_identity->mutable_identity())) {
+    return Status(error::GoogleError::INTERNAL,
+                  "Failed to serialize CodeIdentity");
   }
 
+  sgx::SetSgxIdentityDescription(peer_identity->mutable_description());
+
+  return Status::OkStatus();
+}
+
+StatusOr<std::string> SgxLocalAssertionVerifier::GetIdentityDigest(
+    const Assertion &assertion) const {
   if (!IsCompatibleAssertionDescription(assertion.description())) {
     return Status(error::GoogleError::INVALID_ARGUMENT,
                   "Assertion has incompatible assertion description");
@@ -146,9 +185,58 @@ Status SgxLocalAssertionVerifier::Verify(const std::string &user_data,
     return Status(error::GoogleError::INTERNAL,
                   "Failed to parse LocalAssertion");
   }
+  if (local_assertion.report().size() != sizeof(sgx::Report)) {
+    return Status(error::GoogleError::INVALID_ARGUMENT,
+                  "REPORT from Assertion has incorrect size");
+  }
+
+  // Everything in the REPORT that precedes REPORTDATA describes the enclave
+  // that produced it. REPORTDATA, KEYID, and the MAC vary from one REPORT to
+  // the next and are excluded.
+  Sha256Hash hash;
+  hash.Update(local_assertion.report().data(),
+              offsetof(sgx::Report, reportdata));
+  return hash.CumulativeHash();
+}
+
+Status SgxLocalAssertionVerifier::VerifyBinding(
+    const std::string &user_data, const Assertion &assertion) const {
+  return VerifyBinding(user_data, assertion, /*arena=*/nullptr);
+}
+
+Status SgxLocalAssertionVerifier::VerifyBinding(
+    const std::string &user_data, const Assertion &assertion,
+    google::protobuf::Arena *arena) const {
+  google::protobuf::Arena local_arena;
+  if (arena == nullptr) {
+    arena = &local_arena;
+  }
 
   sgx::Report report;
-  if (local_assertion.report().size() != sizeof(report)) {
+  return VerifyReport(user_data, assertion, arena, &report);
+}
+
+Status SgxLocalAssertionVerifier::VerifyReport(const std::string &user_data,
+                                               const Assertion &assertion,
+                                               google::protobuf::Arena *arena,
+                                               sgx::Report *report) const {
+  if (!IsInitialized()) {
+    return Status(error::GoogleError::FAILED_PRECONDITION, "Not initialized");
+  }
+
+  if (!IsCompatibleAssertionDescription(assertion.description())) {
+    return Status(error::GoogleError::INVALID_ARGUMENT,
+                  "Assertion has incompatible assertion description");
+  }
+
+  sgx::LocalAssertion *local_assertion =
+      google::protobuf::Arena::CreateMessage<sgx::LocalAssertion>(arena);
+  if (!local_assertion->ParseFromString(assertion.assertion())) {
+    return Status(error::GoogleError::INTERNAL,
+                  "Failed to parse LocalAssertion");
+  }
+
+  if (local_assertion->report().size() != sizeof(*report)) {
     return Status(error::GoogleError::INVALID_ARGUMENT,
                   "REPORT from Assertion has incorrect size");
   }
@@ -161,8 +249,9 @@ Status SgxLocalAssertionVerifier::Verify(const std::string &user_data,
   // assertion originates from a machine that supports the Intel SGX
   // architecture and was copied into the assertion byte-for-byte, so is safe to
   // restore the REPORT structure directly from the deserialized LocalAssertion.
-  report = TrivialObjectFromBinaryString<sgx::Report>(local_assertion.report());
-  Status status = sgx::VerifyHardwareReport(report);
+  *report =
+      TrivialObjectFromBinaryString<sgx::Report>(local_assertion->report());
+  Status status = sgx::VerifyHardwareReport(*report);
   if (!status.ok()) {
     return status;
   }
@@ -178,26 +267,11 @@ Status SgxLocalAssertionVerifier::Verify(const std::string &user_data,
       TrivialZeroObject<UnsafeBytes<sgx::kReportdataSize>>();
   expected_reportdata.data.replace(/*pos=*/0, hash.CumulativeHash());
 
-  if (expected_reportdata.data != report.reportdata.data) {
+  if (expected_reportdata.data != report->reportdata.data) {
     return Status(error::GoogleError::INTERNAL,
                   "Assertion is not bound to the provided user-data");
   }
 
-  // Serialize the protobuf representation of the peer's SGX code identity and
-  // save it in |peer_identity|.
-  sgx::CodeIdentity code_identity;
-  status = sgx::ParseIdentityFromHardwareReport(report, &code_identity);
-  if (!status.ok()) {
-    return status;
-  }
-
-  if (!code_identity.SerializeToString(peer_identity->mutable_identity())) {
-    return Status(error::GoogleError::INTERNAL,
-                  "Failed to serialize CodeIdentity");
-  }
-
-  sgx::SetSgxIdentityDescription(peer_identity->mutable_description());
-
   return Status::OkStatus();
 }
 
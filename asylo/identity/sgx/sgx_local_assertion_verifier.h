@@ -21,7 +21,11 @@
 
 #include "asylo/identity/enclave_assertion_verifier.h"
 
+#include <string>
+
+#include <google/protobuf/arena.h>
 #include "absl/synchronization/mutex.h"
+#include "asylo/identity/sgx/identity_key_management_structs.h"
 
 namespace asylo {
 
@@ -61,7 +65,27 @@ class SgxLocalAssertionVerifier final : public EnclaveAssertionVerifier {
   Status Verify(const std::string &user_data, const Assertion &assertion,
                 EnclaveIdentity *peer_identity) const override;
 
+  Status Verify(const std::string &user_data, const Assertion &assertion,
+                EnclaveIdentity *peer_identity,
+                google::protobuf::Arena *arena) const override;
+
+  StatusOr<std::string> GetIdentityDigest(
+      const Assertion &assertion) const override;
+
+  Status VerifyBinding(const std::string &user_data,
+                       const Assertion &assertion) const override;
+
+  Status VerifyBinding(const std::string &user_data, const Assertion &assertion,
+                       google::protobuf::Arena *arena) const override;
+
  private:
+  // Parses the hardware REPORT from |assertion| into |report|, verifies the
+  // REPORT, and checks that it is bound to |user_data|. Temporary messages are
+  // allocated on |arena|, which must not be null.
+  Status VerifyReport(const std::string &user_data, const Assertion &assertion,
+                      google::protobuf::Arena *arena,
+                      sgx::Report *report) const;
+
   // The identity type handled by this verifier.
   static constexpr EnclaveIdentityType identity_type_ = CODE_IDENTITY;
 
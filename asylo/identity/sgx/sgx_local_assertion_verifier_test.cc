@@ -18,9 +18,13 @@
 
 #include "asylo/identity/sgx/sgx_local_assertion_verifier.h"
 
+#include <string>
+#include <vector>
+
 #include <google/protobuf/util/message_differencer.h>
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
+#include "absl/strings/str_cat.h"
 #include "absl/strings/string_view.h"
 #include "asylo/crypto/sha256_hash.h"
 #include "asylo/crypto/util/trivial_object_util.h"
@@ -377,5 +381,48 @@ TEST_F(SgxLocalAssertionVerifierTest, VerifySuccess) {
       << expected_identity.DebugString();
 }
 
+
+// Verify that assertions from the same enclave have the same identity digest
+// regardless of their user data, and that VerifyBinding() checks the binding
+// to the user data.
+TEST_F(SgxLocalAssertionVerifierTest, IdentityDigestIgnoresUserData) {
+  SgxLocalAssertionVerifier verifier;
+  ASSERT_THAT(verifier.Initialize(config_), IsOk());
+
+  sgx::AlignedTargetinfoPtr targetinfo;
+  sgx::SetTargetinfoFromSelfIdentity(targetinfo.get());
+
+  std::vector<Assertion> assertions(2);
+  for (int i = 0; i < assertions.size(); ++i) {
+    Assertion &assertion = assertions[i];
+    SetAssertionDescription(assertion.mutable_description());
+
+    std::string user_data = absl::StrCat(kUserData, i);
+    Sha256Hash hash;
+    hash.Update(user_data.data(), user_data.size());
+    sgx::AlignedReportdataPtr reportdata;
+    *reportdata = TrivialZeroObject<sgx::Reportdata>();
+    reportdata->data.replace(/*pos=*/0, hash.CumulativeHash());
+
+    sgx::AlignedReportPtr report;
+    ASSERT_TRUE(
+        sgx::GetHardwareReport(*targetinfo, *reportdata, report.get()));
+    sgx::LocalAssertion local_assertion;
+    local_assertion.set_report(reinterpret_cast<const char *>(report.get()),
+                               sizeof(*report));
+    ASSERT_TRUE(
+        local_assertion.SerializeToString(assertion.mutable_assertion()));
+
+    EXPECT_THAT(verifier.VerifyBinding(user_data, assertion), IsOk());
+    EXPECT_THAT(verifier.VerifyBinding(kUserData, assertion), Not(IsOk()));
+  }
+
+  auto first_digest = verifier.GetIdentityDigest(assertions[0]);
+  ASSERT_THAT(first_digest, IsOk());
+  auto second_digest = verifier.GetIdentityDigest(assertions[1]);
+  ASSERT_THAT(second_digest, IsOk());
+  EXPECT_EQ(first_digest.ValueOrDie(), second_digest.ValueOrDie());
+}
+
 }  // namespace
 }  // namespace asylo
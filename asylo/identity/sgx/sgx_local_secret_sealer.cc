@@ -18,11 +18,18 @@
 
 #include "asylo/identity/sgx/sgx_local_secret_sealer.h"
 
+#include <openssl/rand.h>
+#include <openssl/sha.h>
+#include <algorithm>
+#include <cstring>
 #include <memory>
 #include <vector>
 
 #include "absl/memory/memory.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
 #include "asylo/crypto/aes_gcm_siv.h"
+#include "asylo/crypto/util/bssl_util.h"
 #include "asylo/crypto/util/byte_container_util.h"
 #include "asylo/crypto/util/byte_container_view.h"
 #include "asylo/crypto/util/bytes.h"
@@ -31,12 +38,157 @@
 #include "asylo/identity/sgx/code_identity_util.h"
 #include "asylo/identity/sgx/identity_key_management_structs.h"
 #include "asylo/identity/sgx/local_secret_sealer_helpers.h"
+#include "asylo/identity/sgx/secs_attributes.h"
 #include "asylo/identity/sgx/self_identity.h"
 
 namespace asylo {
+namespace {
+
+using google::protobuf::io::ZeroCopyInputStream;
+using google::protobuf::io::ZeroCopyOutputStream;
 
 constexpr size_t kAes256GcmSivKeySize = 32;
 
+// Each chunk written by SealStream() is laid out as a 4-byte little-endian
+// length word, the chunk nonce, the chunk ciphertext, and the chunk tag. The
+// length word has kFinalChunkFlag set on the last chunk of the stream.
+constexpr uint32_t kFinalChunkFlag = 0x80000000;
+constexpr size_t kChunkHeaderSize = sizeof(uint32_t) + kAesGcmSivNonceSize;
+constexpr size_t kChunkTagSize = AesGcmSivKeyedCryptor::kTagSize;
+
+// Size of the random identifier that binds the chunks to a single stream.
+constexpr size_t kStreamIdSize = kAesGcmSivNonceSize;
+
+// Reads up to |size| bytes from |input| into |buffer|. Returns the number of
+// bytes read, which is less than |size| only if |input| is exhausted.
+size_t ReadFromStream(ZeroCopyInputStream *input, uint8_t *buffer,
+                      size_t size) {
+  size_t total = 0;
+  const void *data;
+  int data_size;
+  while (total < size && input->Next(&data, &data_size)) {
+    size_t count = std::min(size - total, static_cast<size_t>(data_size));
+    memcpy(buffer + total, data, count);
+    total += count;
+    if (count < static_cast<size_t>(data_size)) {
+      input->BackUp(data_size - count);
+    }
+  }
+  return total;
+}
+
+// Returns true if no more bytes can be read from |input|.
+bool StreamAtEnd(ZeroCopyInputStream *input) {
+  const void *data;
+  int data_size;
+  while (input->Next(&data, &data_size)) {
+    if (data_size > 0) {
+      input->BackUp(data_size);
+      return false;
+    }
+  }
+  return true;
+}
+
+// Writes |size| bytes from |buffer| to |output|. Returns false on failure.
+bool WriteToStream(const uint8_t *buffer, size_t size,
+                   ZeroCopyOutputStream *output) {
+  void *data;
+  int data_size;
+  while (size > 0) {
+    if (!output->Next(&data, &data_size)) {
+      return false;
+    }
+    size_t count = std::min(size, static_cast<size_t>(data_size));
+    memcpy(data, buffer, count);
+    buffer += count;
+    size -= count;
+    if (count < static_cast<size_t>(data_size)) {
+      output->BackUp(data_size - count);
+    }
+  }
+  return true;
+}
+
+void AppendLittleEndian(uint64_t value, size_t size,
+                        std::vector<uint8_t> *output) {
+  for (size_t i = 0; i < size; ++i) {
+    output->push_back(static_cast<uint8_t>(value >> (8 * i)));
+  }
+}
+
+// Builds the additional data that authenticates chunk |index| of a stream.
+// Every chunk commits to the digest of the secret's additional data, the
+// stream identifier, its own position, whether it is the last chunk, and the
+// tag of the previous chunk. Consequently chunks cannot be reordered, dropped,
+// or spliced in from another stream, and the stream cannot be truncated.
+void ChunkAdditionalData(ByteContainerView stream_digest,
+                         ByteContainerView stream_id, uint64_t index,
+                         bool is_final, ByteContainerView previous_tag,
+                         std::vector<uint8_t> *additional_data) {
+  additional_data->clear();
+  additional_data->insert(additional_data->end(), stream_digest.cbegin(),
+                          stream_digest.cend());
+  additional_data->insert(additional_data->end(), stream_id.cbegin(),
+                          stream_id.cend());
+  AppendLittleEndian(index, sizeof(index), additional_data);
+  additional_data->push_back(is_final ? 1 : 0);
+  additional_data->insert(additional_data->end(), previous_tag.cbegin(),
+                          previous_tag.cend());
+}
+
+// Returns a string that identifies the sealing key derived from |cipher_suite|,
+// |cpusvn|, and |sgx_expectation|. It covers every KEYREQUEST field that
+// GenerateCryptorKey() sets from these parameters.
+std::string KeyCacheIndex(sgx::CipherSuite cipher_suite,
+                          const UnsafeBytes<sgx::kCpusvnSize> &cpusvn,
+                          const sgx::CodeIdentityExpectation &sgx_expectation) {
+  const sgx::CodeIdentityMatchSpec &spec = sgx_expectation.match_spec();
+  sgx::SecsAttributeSet attributemask;
+  sgx::ConvertSecsAttributeRepresentation(spec.attributes_match_mask(),
+                                          &attributemask);
+  std::string fields = absl::StrCat(
+      cipher_suite, ",", sgx::internal::ConvertMatchSpecToKeypolicy(spec), ",",
+      sgx_expectation.reference_identity().signer_assigned_identity().isvsvn(),
+      ",", attributemask.flags, ",", attributemask.xfrm, ",",
+      spec.miscselect_match_mask());
+  return absl::StrCat(
+      fields, ",",
+      absl::string_view(reinterpret_cast<const char *>(cpusvn.data()),
+                        cpusvn.size()));
+}
+
+// Creates a cryptor bound to |key|, and computes the digest of |header_bytes|
+// and the additional authenticated data that every chunk of the stream commits
+// to.
+Status PrepareStream(const CleansingVector<uint8_t> &key,
+                     ByteContainerView header_bytes,
+                     ByteContainerView additional_authenticated_data,
+                     size_t message_size_limit,
+                     std::unique_ptr<AesGcmSivKeyedCryptor> *cryptor,
+                     UnsafeBytes<SHA256_DIGEST_LENGTH> *stream_digest) {
+  std::string final_additional_data;
+  std::vector<ByteContainerView> views{header_bytes,
+                                       additional_authenticated_data};
+  SerializeByteContainers(views, &final_additional_data);
+  SHA256(reinterpret_cast<const uint8_t *>(final_additional_data.data()),
+         final_additional_data.size(), stream_digest->data());
+
+  StatusOr<std::unique_ptr<AesGcmSivKeyedCryptor>> cryptor_result =
+      AesGcmSivKeyedCryptor::Create(key, message_size_limit,
+                                    new AesGcmSivNonceGenerator());
+  if (!cryptor_result.ok()) {
+    return cryptor_result.status();
+  }
+  *cryptor = std::move(cryptor_result).ValueOrDie();
+  return Status::OkStatus();
+}
+
+}  // namespace
+
+constexpr size_t SgxLocalSecretSealer::kStreamChunkSize;
+constexpr size_t SgxLocalSecretSealer::kKeyCacheCapacity;
+
 std::unique_ptr<SgxLocalSecretSealer>
 SgxLocalSecretSealer::CreateMrenclaveSecretSealer() {
   sgx::CodeIdentityMatchSpec spec;
@@ -110,15 +262,106 @@ Status SgxLocalSecretSealer::Seal(
     const SealedSecretHeader &header,
     ByteContainerView additional_authenticated_data, ByteContainerView secret,
     SealedSecret *sealed_secret) {
-  UnsafeBytes<sgx::kCpusvnSize> cpusvn;
-  sgx::CipherSuite cipher_suite;
-  sgx::CodeIdentityExpectation sgx_expectation;
-  Status status = sgx::internal::ParseKeyGenerationParamsFromSealedSecretHeader(
-      header, &cpusvn, &cipher_suite, &sgx_expectation);
+  CleansingVector<uint8_t> key;
+  Status status = GetSealingKey(header, &key);
+  if (!status.ok()) {
+    return status;
+  }
+
+  std::string serialized_header;
+  if (!header.SerializeToString(&serialized_header)) {
+    return Status(error::GoogleError::INTERNAL,
+                  "Header serialization to std::string failed");
+  }
+  return SealWithKey(key, serialized_header, additional_authenticated_data,
+                     secret, sealed_secret);
+}
+
+Status SgxLocalSecretSealer::Unseal(const SealedSecret &sealed_secret,
+                                    CleansingVector<uint8_t> *secret) {
+  SealedSecretHeader header;
+  if (!header.ParseFromString(sealed_secret.sealed_secret_header())) {
+    return Status(error::GoogleError::INVALID_ARGUMENT,
+                  "Could not parse the sealed secret header");
+  }
+
+  CleansingVector<uint8_t> key;
+  Status status = GetSealingKey(header, &key);
   if (!status.ok()) {
     return status;
   }
+  return UnsealWithKey(key, sealed_secret, secret);
+}
 
+Status SgxLocalSecretSealer::SealBatch(
+    const SealedSecretHeader &header,
+    ByteContainerView additional_authenticated_data,
+    const std::vector<ByteContainerView> &secrets,
+    std::vector<SealedSecret> *sealed_secrets) {
+  CleansingVector<uint8_t> key;
+  Status status = GetSealingKey(header, &key);
+  if (!status.ok()) {
+    return status;
+  }
+
+  std::string serialized_header;
+  if (!header.SerializeToString(&serialized_header)) {
+    return Status(error::GoogleError::INTERNAL,
+                  "Header serialization to std::string failed");
+  }
+
+  sealed_secrets->resize(secrets.size());
+  for (size_t i = 0; i < secrets.size(); ++i) {
+    status = SealWithKey(key, serialized_header, additional_authenticated_data,
+                         secrets[i], &(*sealed_secrets)[i]);
+    if (!status.ok()) {
+      return status;
+    }
+  }
+  return Status::OkStatus();
+}
+
+Status SgxLocalSecretSealer::UnsealBatch(
+    const std::vector<SealedSecret> &sealed_secrets,
+    std::vector<CleansingVector<uint8_t>> *secrets) {
+  secrets->resize(sealed_secrets.size());
+
+  // The header that |key| was derived from. Consecutive sealed secrets with
+  // the same header share the key, and the header has already been checked.
+  const std::string *key_header = nullptr;
+  CleansingVector<uint8_t> key;
+  for (size_t i = 0; i < sealed_secrets.size(); ++i) {
+    const SealedSecret &sealed_secret = sealed_secrets[i];
+    if (key_header == nullptr ||
+        *key_header != sealed_secret.sealed_secret_header()) {
+      SealedSecretHeader header;
+      if (!header.ParseFromString(sealed_secret.sealed_secret_header())) {
+        secrets->clear();
+        return Status(error::GoogleError::INVALID_ARGUMENT,
+                      "Could not parse the sealed secret header");
+      }
+      Status status = GetSealingKey(header, &key);
+      if (!status.ok()) {
+        secrets->clear();
+        return status;
+      }
+      key_header = &sealed_secret.sealed_secret_header();
+    }
+
+    Status status = UnsealWithKey(key, sealed_secret, &(*secrets)[i]);
+    if (!status.ok()) {
+      secrets->clear();
+      return status;
+    }
+  }
+  return Status::OkStatus();
+}
+
+Status SgxLocalSecretSealer::SealStream(
+    const SealedSecretHeader &header,
+    ByteContainerView additional_authenticated_data,
+    ZeroCopyInputStream *secret, SealedSecret *sealed_secret,
+    ZeroCopyOutputStream *ciphertext) {
   if (!header.SerializeToString(
           sealed_secret->mutable_sealed_secret_header())) {
     return Status(error::GoogleError::INTERNAL,
@@ -127,33 +370,164 @@ Status SgxLocalSecretSealer::Seal(
   sealed_secret->set_additional_authenticated_data(
       reinterpret_cast<const char *>(additional_authenticated_data.data()),
       additional_authenticated_data.size());
-
-  std::string final_additional_data;
-  std::vector<ByteContainerView> views{sealed_secret->sealed_secret_header(),
-                                       additional_authenticated_data};
-  SerializeByteContainers(views, &final_additional_data);
+  sealed_secret->clear_secret_ciphertext();
 
   CleansingVector<uint8_t> key;
-  status = sgx::internal::GenerateCryptorKey(cipher_suite, "default_key_id",
-                                             cpusvn, sgx_expectation,
-                                             kAes256GcmSivKeySize, &key);
+  Status status = GetSealingKey(header, &key);
   if (!status.ok()) {
     return status;
   }
 
-  return cryptor_->Seal(key, final_additional_data, secret,
-                        sealed_secret->mutable_iv(),
-                        sealed_secret->mutable_secret_ciphertext());
+  std::unique_ptr<AesGcmSivKeyedCryptor> cryptor;
+  UnsafeBytes<SHA256_DIGEST_LENGTH> stream_digest;
+  status = PrepareStream(key, sealed_secret->sealed_secret_header(),
+                         additional_authenticated_data,
+                         kMaxAesGcmSivMessageSize, &cryptor, &stream_digest);
+  if (!status.ok()) {
+    return status;
+  }
+
+  UnsafeBytes<kStreamIdSize> stream_id;
+  if (RAND_bytes(stream_id.data(), stream_id.size()) != 1) {
+    return Status(error::GoogleError::INTERNAL,
+                  absl::StrCat("RAND_bytes failed: ", BsslLastErrorString()));
+  }
+  sealed_secret->set_iv(reinterpret_cast<const char *>(stream_id.data()),
+                        stream_id.size());
+
+  // The plaintext of the current chunk, and the serialized chunk that is sealed
+  // from it. These are the only buffers whose size depends on the chunk size.
+  CleansingVector<uint8_t> plaintext(kStreamChunkSize);
+  std::vector<uint8_t> chunk(kChunkHeaderSize + kStreamChunkSize +
+                             kChunkTagSize);
+  std::vector<uint8_t> chunk_additional_data;
+  UnsafeBytes<kChunkTagSize> previous_tag;
+  previous_tag.fill(0);
+  UnsafeBytes<kAesGcmSivNonceSize> nonce;
+
+  // A stream always contains at least one chunk, and its last chunk is marked
+  // final, even if that chunk is empty.
+  bool is_final = false;
+  for (uint64_t index = 0; !is_final; ++index) {
+    size_t size = ReadFromStream(secret, plaintext.data(), kStreamChunkSize);
+    is_final = size < kStreamChunkSize || StreamAtEnd(secret);
+
+    ChunkAdditionalData(stream_digest, stream_id, index, is_final,
+                        previous_tag, &chunk_additional_data);
+    uint8_t *chunk_ciphertext = chunk.data() + kChunkHeaderSize;
+    uint8_t *chunk_tag = chunk_ciphertext + size;
+    status = cryptor->Seal(chunk_additional_data,
+                           ByteContainerView(plaintext.data(), size), &nonce,
+                           chunk_ciphertext, chunk_tag);
+    if (!status.ok()) {
+      return status;
+    }
+
+    uint32_t length_word = size | (is_final ? kFinalChunkFlag : 0);
+    for (size_t i = 0; i < sizeof(length_word); ++i) {
+      chunk[i] = static_cast<uint8_t>(length_word >> (8 * i));
+    }
+    std::copy(nonce.cbegin(), nonce.cend(), chunk.begin() + sizeof(uint32_t));
+    previous_tag.assign(chunk_tag, kChunkTagSize);
+
+    if (!WriteToStream(chunk.data(), kChunkHeaderSize + size + kChunkTagSize,
+                       ciphertext)) {
+      return Status(error::GoogleError::INTERNAL,
+                    "Could not write to the ciphertext stream");
+    }
+  }
+  return Status::OkStatus();
 }
 
-Status SgxLocalSecretSealer::Unseal(const SealedSecret &sealed_secret,
-                                    CleansingVector<uint8_t> *secret) {
+Status SgxLocalSecretSealer::UnsealStream(const SealedSecret &sealed_secret,
+                                          ZeroCopyInputStream *ciphertext,
+                                          ZeroCopyOutputStream *secret) {
   SealedSecretHeader header;
   if (!header.ParseFromString(sealed_secret.sealed_secret_header())) {
     return Status(error::GoogleError::INVALID_ARGUMENT,
                   "Could not parse the sealed secret header");
   }
+  if (sealed_secret.iv().size() != kStreamIdSize) {
+    return Status(error::GoogleError::INVALID_ARGUMENT,
+                  "Sealed secret has an invalid stream identifier");
+  }
+
+  CleansingVector<uint8_t> key;
+  Status status = GetSealingKey(header, &key);
+  if (!status.ok()) {
+    return status;
+  }
+
+  std::unique_ptr<AesGcmSivKeyedCryptor> cryptor;
+  UnsafeBytes<SHA256_DIGEST_LENGTH> stream_digest;
+  status = PrepareStream(key, sealed_secret.sealed_secret_header(),
+                         sealed_secret.additional_authenticated_data(),
+                         kMaxAesGcmSivMessageSize, &cryptor, &stream_digest);
+  if (!status.ok()) {
+    return status;
+  }
+
+  CleansingVector<uint8_t> plaintext(kStreamChunkSize);
+  std::vector<uint8_t> chunk(kChunkHeaderSize + kStreamChunkSize +
+                             kChunkTagSize);
+  std::vector<uint8_t> chunk_additional_data;
+  UnsafeBytes<kChunkTagSize> previous_tag;
+  previous_tag.fill(0);
+
+  bool is_final = false;
+  for (uint64_t index = 0; !is_final; ++index) {
+    if (ReadFromStream(ciphertext, chunk.data(), kChunkHeaderSize) !=
+        kChunkHeaderSize) {
+      return Status(error::GoogleError::INVALID_ARGUMENT,
+                    "Sealed stream is truncated");
+    }
+    uint32_t length_word = 0;
+    for (size_t i = 0; i < sizeof(length_word); ++i) {
+      length_word |= static_cast<uint32_t>(chunk[i]) << (8 * i);
+    }
+    is_final = (length_word & kFinalChunkFlag) != 0;
+    size_t size = length_word & ~kFinalChunkFlag;
+    if (size > kStreamChunkSize) {
+      return Status(error::GoogleError::INVALID_ARGUMENT,
+                    "Sealed stream has an oversized chunk");
+    }
+
+    uint8_t *chunk_ciphertext = chunk.data() + kChunkHeaderSize;
+    uint8_t *chunk_tag = chunk_ciphertext + size;
+    if (ReadFromStream(ciphertext, chunk_ciphertext, size + kChunkTagSize) !=
+        size + kChunkTagSize) {
+      return Status(error::GoogleError::INVALID_ARGUMENT,
+                    "Sealed stream is truncated");
+    }
+
+    ChunkAdditionalData(stream_digest, sealed_secret.iv(), index, is_final,
+                        previous_tag, &chunk_additional_data);
+    status = cryptor->Open(
+        chunk_additional_data, ByteContainerView(chunk_ciphertext, size),
+        ByteContainerView(chunk_tag, kChunkTagSize),
+        ByteContainerView(chunk.data() + sizeof(uint32_t),
+                          kAesGcmSivNonceSize),
+        plaintext.data());
+    if (!status.ok()) {
+      return status;
+    }
+    previous_tag.assign(chunk_tag, kChunkTagSize);
+
+    if (!WriteToStream(plaintext.data(), size, secret)) {
+      return Status(error::GoogleError::INTERNAL,
+                    "Could not write to the secret stream");
+    }
+  }
+
+  if (!StreamAtEnd(ciphertext)) {
+    return Status(error::GoogleError::INVALID_ARGUMENT,
+                  "Sealed stream has data after its final chunk");
+  }
+  return Status::OkStatus();
+}
 
+Status SgxLocalSecretSealer::GetSealingKey(const SealedSecretHeader &header,
+                                           CleansingVector<uint8_t> *key) {
   UnsafeBytes<sgx::kCpusvnSize> cpusvn;
   sgx::CipherSuite cipher_suite;
   sgx::CodeIdentityExpectation sgx_expectation;
@@ -163,20 +537,60 @@ Status SgxLocalSecretSealer::Unseal(const SealedSecret &sealed_secret,
     return status;
   }
 
-  std::string final_additional_data;
-  std::vector<ByteContainerView> views{
-      sealed_secret.sealed_secret_header(),
-      sealed_secret.additional_authenticated_data()};
-  SerializeByteContainers(views, &final_additional_data);
+  std::string index = KeyCacheIndex(cipher_suite, cpusvn, sgx_expectation);
+  {
+    absl::MutexLock lock(&key_cache_mu_);
+    for (const auto &entry : key_cache_) {
+      if (entry.first == index) {
+        *key = entry.second;
+        return Status::OkStatus();
+      }
+    }
+  }
 
-  CleansingVector<uint8_t> key;
   status = sgx::internal::GenerateCryptorKey(cipher_suite, "default_key_id",
                                              cpusvn, sgx_expectation,
-                                             kAes256GcmSivKeySize, &key);
+                                             kAes256GcmSivKeySize, key);
   if (!status.ok()) {
     return status;
   }
 
+  absl::MutexLock lock(&key_cache_mu_);
+  if (key_cache_.size() >= kKeyCacheCapacity) {
+    key_cache_.pop_front();
+  }
+  key_cache_.emplace_back(std::move(index), *key);
+  return Status::OkStatus();
+}
+
+Status SgxLocalSecretSealer::SealWithKey(
+    const CleansingVector<uint8_t> &key, const std::string &serialized_header,
+    ByteContainerView additional_authenticated_data, ByteContainerView secret,
+    SealedSecret *sealed_secret) {
+  sealed_secret->set_sealed_secret_header(serialized_header);
+  sealed_secret->set_additional_authenticated_data(
+      reinterpret_cast<const char *>(additional_authenticated_data.data()),
+      additional_authenticated_data.size());
+
+  std::string final_additional_data;
+  std::vector<ByteContainerView> views{serialized_header,
+                                       additional_authenticated_data};
+  SerializeByteContainers(views, &final_additional_data);
+
+  return cryptor_->Seal(key, final_additional_data, secret,
+                        sealed_secret->mutable_iv(),
+                        sealed_secret->mutable_secret_ciphertext());
+}
+
+Status SgxLocalSecretSealer::UnsealWithKey(const CleansingVector<uint8_t> &key,
+                                           const SealedSecret &sealed_secret,
+                                           CleansingVector<uint8_t> *secret) {
+  std::string final_additional_data;
+  std::vector<ByteContainerView> views{
+      sealed_secret.sealed_secret_header(),
+      sealed_secret.additional_authenticated_data()};
+  SerializeByteContainers(views, &final_additional_data);
+
   return cryptor_->Open(key, final_additional_data,
                         sealed_secret.secret_ciphertext(), sealed_secret.iv(),
                         secret);
@@ -19,8 +19,14 @@
 #ifndef ASYLO_IDENTITY_SGX_SGX_LOCAL_SECRET_SEALER_H_
 #define ASYLO_IDENTITY_SGX_SGX_LOCAL_SECRET_SEALER_H_
 
+#include <deque>
 #include <memory>
+#include <string>
+#include <utility>
+#include <vector>
 
+#include <google/protobuf/io/zero_copy_stream.h>
+#include "absl/synchronization/mutex.h"
 #include "asylo/crypto/aes_gcm_siv.h"
 #include "asylo/crypto/util/byte_container_view.h"
 #include "asylo/identity/identity.pb.h"
@@ -109,6 +115,11 @@ namespace asylo {
 /// generated default header. A sealer in either MRENCLAVE or MRSIGNER
 /// configuration can unseal secrets that are sealed by a sealer in either
 /// configuration.
+///
+/// A sealer caches the sealing keys that it derives, so sealing or unsealing
+/// many secrets under the same policy issues EGETKEY only once per policy.
+/// SealBatch() and UnsealBatch() additionally parse each header only once for
+/// a whole batch of secrets.
 class SgxLocalSecretSealer : public SecretSealer {
  public:
   /// Creates an SgxLocalSecretSealer that seals secrets to the MRENCLAVE part
@@ -139,6 +150,81 @@ class SgxLocalSecretSealer : public SecretSealer {
   Status Unseal(const SealedSecret &sealed_secret,
                 CleansingVector<uint8_t> *secret) override;
 
+  /// Seals a secret of arbitrary size read from `secret`, writing the sealed
+  /// chunks to `ciphertext`. The secret is processed in chunks of
+  /// kStreamChunkSize bytes, so the enclave memory used does not depend on the
+  /// size of the secret.
+  ///
+  /// On success, `sealed_secret` holds the header and the additional
+  /// authenticated data of the secret, and must be supplied together with the
+  /// contents of `ciphertext` to UnsealStream(). Its `secret_ciphertext` field
+  /// is left empty, so it cannot be passed to Unseal().
+  ///
+  /// \param header The header of the sealed secret.
+  /// \param additional_authenticated_data Data to authenticate with the secret.
+  /// \param secret The stream from which the secret is read until its end.
+  /// \param[out] sealed_secret The sealed secret descriptor.
+  /// \param[out] ciphertext The stream to which the sealed chunks are written.
+  /// \return A non-OK Status if an error is encountered.
+  Status SealStream(const SealedSecretHeader &header,
+                    ByteContainerView additional_authenticated_data,
+                    google::protobuf::io::ZeroCopyInputStream *secret,
+                    SealedSecret *sealed_secret,
+                    google::protobuf::io::ZeroCopyOutputStream *ciphertext);
+
+  /// Unseals a secret sealed by SealStream(), writing it to `secret` one chunk
+  /// at a time.
+  ///
+  /// Each chunk is authenticated before it is written, and the chunks are
+  /// chained so that reordering, dropping, or truncating them is detected.
+  /// Because the secret is produced incrementally, however, a failure may be
+  /// detected after some chunks have already been written to `secret`. Callers
+  /// must discard everything written to `secret` if a non-OK Status is
+  /// returned.
+  ///
+  /// \param sealed_secret The sealed secret descriptor produced by
+  ///        SealStream().
+  /// \param ciphertext The stream from which the sealed chunks are read.
+  /// \param[out] secret The stream to which the unsealed secret is written.
+  /// \return A non-OK Status if an error is encountered.
+  Status UnsealStream(const SealedSecret &sealed_secret,
+                      google::protobuf::io::ZeroCopyInputStream *ciphertext,
+                      google::protobuf::io::ZeroCopyOutputStream *secret);
+
+  /// Seals each of `secrets` under the same `header` and
+  /// `additional_authenticated_data`, and writes the sealed secrets to
+  /// `sealed_secrets` in the same order. The header is checked and the sealing
+  /// key is derived only once for the whole batch.
+  ///
+  /// \param header The header of the sealed secrets.
+  /// \param additional_authenticated_data Data to authenticate with each
+  ///        secret.
+  /// \param secrets The secrets to seal.
+  /// \param[out] sealed_secrets The sealed secrets.
+  /// \return A non-OK Status if an error is encountered, in which case the
+  ///         contents of `sealed_secrets` are unspecified.
+  Status SealBatch(const SealedSecretHeader &header,
+                   ByteContainerView additional_authenticated_data,
+                   const std::vector<ByteContainerView> &secrets,
+                   std::vector<SealedSecret> *sealed_secrets);
+
+  /// Unseals each of `sealed_secrets`, and writes the secrets to `secrets` in
+  /// the same order. The header is checked and the sealing key is derived only
+  /// once for each run of consecutive sealed secrets with identical headers.
+  ///
+  /// \param sealed_secrets The sealed secrets to unseal.
+  /// \param[out] secrets The unsealed secrets.
+  /// \return A non-OK Status if any of the secrets fails to unseal, in which
+  ///         case `secrets` is cleared.
+  Status UnsealBatch(const std::vector<SealedSecret> &sealed_secrets,
+                     std::vector<CleansingVector<uint8_t>> *secrets);
+
+  /// Maximum number of secret bytes held in a single chunk by SealStream().
+  static constexpr size_t kStreamChunkSize = (1 << 16);
+
+  /// Maximum number of derived sealing keys cached by a sealer.
+  static constexpr size_t kKeyCacheCapacity = 16;
+
  private:
   // Maximum size (in bytes) of each protected message (including authenticated
   // data). A protected message may not be larger than 32MB.
@@ -155,11 +241,37 @@ class SgxLocalSecretSealer : public SecretSealer {
   // secret header per |default_client_acl|.
   SgxLocalSecretSealer(const sgx::CodeIdentityExpectation &default_client_acl);
 
+  // Checks that |header| can be used by the current enclave, and writes the
+  // sealing key described by |header| to |key|. The key is taken from
+  // |key_cache_| if it was derived before.
+  Status GetSealingKey(const SealedSecretHeader &header,
+                       CleansingVector<uint8_t> *key);
+
+  // Seals |secret| under |key|, and writes it to |sealed_secret| along with
+  // |serialized_header| and |additional_authenticated_data|.
+  Status SealWithKey(const CleansingVector<uint8_t> &key,
+                     const std::string &serialized_header,
+                     ByteContainerView additional_authenticated_data,
+                     ByteContainerView secret, SealedSecret *sealed_secret);
+
+  // Unseals |sealed_secret| under |key|, and writes the secret to |secret|.
+  Status UnsealWithKey(const CleansingVector<uint8_t> &key,
+                       const SealedSecret &sealed_secret,
+                       CleansingVector<uint8_t> *secret);
+
   // Cryptor to perform AEAD operations.
   std::unique_ptr<AesGcmSivCryptor> cryptor_;
 
   // The default client ACL for this SecretSealer.
   sgx::CodeIdentityExpectation default_client_acl_;
+
+  absl::Mutex key_cache_mu_;
+
+  // Sealing keys derived by this sealer, oldest first, indexed by the
+  // KEYREQUEST parameters that they were derived from. An evicted key is
+  // cleansed when it is destroyed.
+  std::deque<std::pair<std::string, CleansingVector<uint8_t>>> key_cache_
+      GUARDED_BY(key_cache_mu_);
 };
 
 }  // namespace asylo
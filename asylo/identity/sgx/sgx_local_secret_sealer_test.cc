@@ -19,7 +19,10 @@
 #include "asylo/identity/sgx/sgx_local_secret_sealer.h"
 
 #include <memory>
+#include <string>
+#include <vector>
 
+#include <google/protobuf/io/zero_copy_stream_impl_lite.h>
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 #include "absl/memory/memory.h"
@@ -593,5 +596,192 @@ TEST_F(SgxLocalSecretSealerTest,
   EXPECT_THAT(sealer2->Unseal(sealed_secret, &output_secret), Not(IsOk()));
 }
 
+// Returns a secret that spans several stream chunks and ends in a partial one.
+std::string MakeStreamSecret() {
+  std::string secret;
+  for (size_t i = 0; i < 2 * SgxLocalSecretSealer::kStreamChunkSize + 1000;
+       ++i) {
+    secret.push_back(static_cast<char>(i * 7));
+  }
+  return secret;
+}
+
+// Verify that a secret sealed as a stream can be unsealed as a stream, reading
+// the input in blocks that do not align with the chunk boundaries.
+TEST_F(SgxLocalSecretSealerTest, SealUnsealStreamSuccess) {
+  std::string input_aad(kTestAad);
+
+  std::unique_ptr<SgxLocalSecretSealer> sealer =
+      SgxLocalSecretSealer::CreateMrenclaveSecretSealer();
+  SealedSecretHeader header;
+  PrepareSealedSecretHeader(*sealer, &header);
+
+  for (const std::string &input_secret : {std::string(), MakeStreamSecret()}) {
+    google::protobuf::io::ArrayInputStream secret_stream(
+        input_secret.data(), input_secret.size(), /*block_size=*/1000);
+    SealedSecret sealed_secret;
+    std::string ciphertext;
+    google::protobuf::io::StringOutputStream ciphertext_stream(&ciphertext);
+    ASSERT_THAT(sealer->SealStream(header, input_aad, &secret_stream,
+                                   &sealed_secret, &ciphertext_stream),
+                IsOk());
+
+    std::unique_ptr<SgxLocalSecretSealer> sealer2 =
+        SgxLocalSecretSealer::CreateMrenclaveSecretSealer();
+    google::protobuf::io::ArrayInputStream sealed_stream(
+        ciphertext.data(), ciphertext.size(), /*block_size=*/333);
+    std::string output_secret;
+    google::protobuf::io::StringOutputStream output_stream(&output_secret);
+    ASSERT_THAT(
+        sealer2->UnsealStream(sealed_secret, &sealed_stream, &output_stream),
+        IsOk());
+    EXPECT_EQ(input_secret, output_secret);
+  }
+}
+
+// Verify that a stream fails to unseal if it is truncated at a chunk boundary,
+// if its chunks are reordered, or if it is unsealed with a different AAD.
+TEST_F(SgxLocalSecretSealerTest, SealUnsealStreamFailureModifiedStream) {
+  std::string input_secret = MakeStreamSecret();
+  std::string input_aad(kTestAad);
+
+  std::unique_ptr<SgxLocalSecretSealer> sealer =
+      SgxLocalSecretSealer::CreateMrenclaveSecretSealer();
+  SealedSecretHeader header;
+  PrepareSealedSecretHeader(*sealer, &header);
+
+  google::protobuf::io::ArrayInputStream secret_stream(input_secret.data(),
+                                                       input_secret.size());
+  SealedSecret sealed_secret;
+  std::string ciphertext;
+  {
+    google::protobuf::io::StringOutputStream ciphertext_stream(&ciphertext);
+    ASSERT_THAT(sealer->SealStream(header, input_aad, &secret_stream,
+                                   &sealed_secret, &ciphertext_stream),
+                IsOk());
+  }
+
+  // Each full chunk consists of a 16-byte chunk header, the chunk ciphertext,
+  // and a 16-byte tag.
+  const size_t full_chunk_size = SgxLocalSecretSealer::kStreamChunkSize + 32;
+  ASSERT_GT(ciphertext.size(), 2 * full_chunk_size);
+
+  std::vector<std::string> modified_ciphertexts = {
+      ciphertext.substr(0, 2 * full_chunk_size),
+      ciphertext.substr(full_chunk_size, full_chunk_size) +
+          ciphertext.substr(0, full_chunk_size) +
+          ciphertext.substr(2 * full_chunk_size),
+      ciphertext + std::string(1, '\0')};
+  for (const std::string &modified : modified_ciphertexts) {
+    google::protobuf::io::ArrayInputStream sealed_stream(modified.data(),
+                                                         modified.size());
+    std::string output_secret;
+    google::protobuf::io::StringOutputStream output_stream(&output_secret);
+    EXPECT_THAT(
+        sealer->UnsealStream(sealed_secret, &sealed_stream, &output_stream),
+        Not(IsOk()));
+  }
+
+  SealedSecret modified_secret = sealed_secret;
+  modified_secret.set_additional_authenticated_data(kTestString);
+  google::protobuf::io::ArrayInputStream sealed_stream(ciphertext.data(),
+                                                       ciphertext.size());
+  std::string output_secret;
+  google::protobuf::io::StringOutputStream output_stream(&output_secret);
+  EXPECT_THAT(
+      sealer->UnsealStream(modified_secret, &sealed_stream, &output_stream),
+      Not(IsOk()));
+}
+
+// Verify that a batch of secrets sealed by SealBatch() can be unsealed both by
+// UnsealBatch() and one at a time by Unseal().
+TEST_F(SgxLocalSecretSealerTest, SealUnsealBatchSuccess) {
+  std::vector<std::string> input_secrets = {kTestSecret, kTestString, ""};
+  std::vector<ByteContainerView> secret_views(input_secrets.begin(),
+                                              input_secrets.end());
+
+  std::unique_ptr<SgxLocalSecretSealer> sealer =
+      SgxLocalSecretSealer::CreateMrenclaveSecretSealer();
+  SealedSecretHeader header;
+  PrepareSealedSecretHeader(*sealer, &header);
+
+  std::vector<SealedSecret> sealed_secrets;
+  ASSERT_THAT(
+      sealer->SealBatch(header, kTestAad, secret_views, &sealed_secrets),
+      IsOk());
+  ASSERT_EQ(sealed_secrets.size(), input_secrets.size());
+
+  std::unique_ptr<SgxLocalSecretSealer> sealer2 =
+      SgxLocalSecretSealer::CreateMrenclaveSecretSealer();
+  std::vector<CleansingVector<uint8_t>> output_secrets;
+  ASSERT_THAT(sealer2->UnsealBatch(sealed_secrets, &output_secrets), IsOk());
+  ASSERT_EQ(output_secrets.size(), input_secrets.size());
+  for (size_t i = 0; i < input_secrets.size(); ++i) {
+    EXPECT_EQ(std::string(output_secrets[i].begin(), output_secrets[i].end()),
+              input_secrets[i]);
+
+    CleansingVector<uint8_t> output_secret;
+    ASSERT_THAT(sealer->Unseal(sealed_secrets[i], &output_secret), IsOk());
+    EXPECT_EQ(output_secret, output_secrets[i]);
+  }
+}
+
+// Verify that UnsealBatch() fails and clears its output if any of the secrets
+// fails to unseal.
+TEST_F(SgxLocalSecretSealerTest, UnsealBatchFailureModifiedSecret) {
+  std::vector<ByteContainerView> secret_views = {kTestSecret, kTestString};
+
+  std::unique_ptr<SgxLocalSecretSealer> sealer =
+      SgxLocalSecretSealer::CreateMrenclaveSecretSealer();
+  SealedSecretHeader header;
+  PrepareSealedSecretHeader(*sealer, &header);
+
+  std::vector<SealedSecret> sealed_secrets;
+  ASSERT_THAT(
+      sealer->SealBatch(header, kTestAad, secret_views, &sealed_secrets),
+      IsOk());
+  sealed_secrets[1].set_additional_authenticated_data(kTestString);
+
+  std::vector<CleansingVector<uint8_t>> output_secrets;
+  EXPECT_THAT(sealer->UnsealBatch(sealed_secrets, &output_secrets),
+              Not(IsOk()));
+  EXPECT_TRUE(output_secrets.empty());
+}
+
+// Verify that a sealer that has cached the key for one sealing policy derives
+// the right key for another policy.
+TEST_F(SgxLocalSecretSealerTest, SealUnsealDifferentPoliciesSameSealer) {
+  CleansingVector<uint8_t> input_secret(kTestSecret,
+                                        kTestSecret + kTestSecretSize);
+  std::unique_ptr<SgxLocalSecretSealer> mrenclave_sealer =
+      SgxLocalSecretSealer::CreateMrenclaveSecretSealer();
+  std::unique_ptr<SgxLocalSecretSealer> mrsigner_sealer =
+      SgxLocalSecretSealer::CreateMrsignerSecretSealer();
+
+  SealedSecretHeader mrenclave_header;
+  PrepareSealedSecretHeader(*mrenclave_sealer, &mrenclave_header);
+  SealedSecretHeader mrsigner_header;
+  PrepareSealedSecretHeader(*mrsigner_sealer, &mrsigner_header);
+
+  SealedSecret mrenclave_secret;
+  ASSERT_THAT(mrenclave_sealer->Seal(mrenclave_header, kTestAad, input_secret,
+                                     &mrenclave_secret),
+              IsOk());
+  SealedSecret mrsigner_secret;
+  ASSERT_THAT(mrenclave_sealer->Seal(mrsigner_header, kTestAad, input_secret,
+                                     &mrsigner_secret),
+              IsOk());
+
+  // The secrets are unsealed by a sealer with an empty key cache, which
+  // derives the key of each policy anew.
+  CleansingVector<uint8_t> output_secret;
+  ASSERT_THAT(mrsigner_sealer->Unseal(mrsigner_secret, &output_secret),
+              IsOk());
+  EXPECT_EQ(output_secret, input_secret);
+  ASSERT_THAT(mrsigner_sealer->Unseal(mrenclave_secret, &output_secret),
+              IsOk());
+  EXPECT_EQ(output_secret, input_secret);
+}
+
 }  // namespace
 }  // namespace asylo
@@ -0,0 +1,147 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_IDENTITY_UTIL_ALIGNED_OBJECT_H_
+#define ASYLO_IDENTITY_UTIL_ALIGNED_OBJECT_H_
+
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "asylo/identity/util/aligned_object_ptr.h"
+
+namespace asylo {
+
+// An AlignedObject holds one instance of the object in aligned storage within
+// itself, and presents a pointer-like interface (*, ->) to it, like
+// AlignedObjectPtr but without allocating. Align must be a power of two.
+//
+// The alignment is only guaranteed for AlignedObjects on the stack, in static
+// or thread storage, or in members of such objects. In C++11, operator new does
+// not honor alignments larger than that of std::max_align_t, so objects
+// allocated on the heap should use AlignedObjectPtr or PooledAlignedObject
+// instead.
+//
+// An AlignedObject cannot be copied or moved, so that the object stays at its
+// aligned address.
+template <class T, size_t Align>
+class AlignedObject {
+ public:
+  template <typename... Args>
+  explicit AlignedObject(Args &&... args)
+      : object_(std::forward<Args>(args)...) {
+    static_assert(Align != 0 && (Align & (Align - 1)) == 0,
+                  "Template parameter Align must be a power of two.");
+    static_assert(!std::is_array<T>::value,
+                  "Template parameter T must not be an array type.");
+  }
+
+  AlignedObject(const AlignedObject &) = delete;
+  AlignedObject &operator=(const AlignedObject &) = delete;
+
+  // Returns a pointer to the object.
+  T *get() { return &object_; }
+  const T *get() const { return &object_; }
+
+  T *operator->() { return get(); }
+  const T *operator->() const { return get(); }
+  T &operator*() { return *get(); }
+  const T &operator*() const { return *get(); }
+
+  // Check if the input address is aligned.
+  static bool IsAligned(const void *addr) {
+    return reinterpret_cast<uintptr_t>(addr) % Align == 0;
+  }
+
+ private:
+  alignas(Align) T object_;
+};
+
+// A PooledAlignedObject holds one instance of the object in aligned heap
+// memory that is recycled through a free list of the calling thread. The
+// object is constructed when the PooledAlignedObject is created and destroyed
+// when it is, and its memory is then kept for the next PooledAlignedObject of
+// the same type created by the thread. Once a thread has created as many
+// PooledAlignedObjects of a type at once as it ever will, creating them does
+// not allocate.
+//
+// This suits objects too large, or too strictly aligned, to be placed on the
+// stack of a deep call path. The memory is never freed, so the free lists hold
+// at most the largest number of objects of each type a thread has used at once.
+// A PooledAlignedObject must be destroyed by the thread that created it.
+template <class T, size_t Align>
+class PooledAlignedObject {
+ public:
+  template <typename... Args>
+  explicit PooledAlignedObject(Args &&... args) : buffer_(AcquireBuffer()) {
+    object_ = new (buffer_->bytes) T(std::forward<Args>(args)...);
+  }
+
+  PooledAlignedObject(const PooledAlignedObject &) = delete;
+  PooledAlignedObject &operator=(const PooledAlignedObject &) = delete;
+
+  ~PooledAlignedObject() {
+    object_->~T();
+    FreeBuffers()->push_back(std::move(buffer_));
+  }
+
+  // Returns a pointer to the object.
+  T *get() { return object_; }
+  const T *get() const { return object_; }
+
+  T *operator->() { return get(); }
+  const T *operator->() const { return get(); }
+  T &operator*() { return *get(); }
+  const T &operator*() const { return *get(); }
+
+ private:
+  // Uninitialized memory for one object.
+  struct Storage {
+    uint8_t bytes[sizeof(T)];
+  };
+
+  using Buffer = AlignedObjectPtr<Storage, Align>;
+
+  // Returns the free buffers of the calling thread. Each thread keeps its list
+  // for the lifetime of the program.
+  static std::vector<Buffer> *FreeBuffers() {
+    thread_local std::vector<Buffer> *buffers = new std::vector<Buffer>();
+    return buffers;
+  }
+
+  // Returns a free buffer of the calling thread, or a new one if it has none.
+  static Buffer AcquireBuffer() {
+    std::vector<Buffer> *buffers = FreeBuffers();
+    if (buffers->empty()) {
+      return Buffer();
+    }
+    Buffer buffer = std::move(buffers->back());
+    buffers->pop_back();
+    return buffer;
+  }
+
+  Buffer buffer_;
+  T *object_;
+};
+
+}  // namespace asylo
+
+#endif  // ASYLO_IDENTITY_UTIL_ALIGNED_OBJECT_H_
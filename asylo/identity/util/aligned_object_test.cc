@@ -0,0 +1,108 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/identity/util/aligned_object.h"
+
+#include <cstdint>
+#include <set>
+
+#include <gtest/gtest.h>
+
+namespace asylo {
+namespace {
+
+struct TestStruct {
+  uint64_t a;
+  uint32_t b;
+};
+
+// Counts the live instances of the class.
+class CountedClass {
+ public:
+  explicit CountedClass(int value) : value_(value) { ++live_count; }
+  ~CountedClass() { --live_count; }
+
+  int value() const { return value_; }
+
+  static int live_count;
+
+ private:
+  int value_;
+};
+
+int CountedClass::live_count = 0;
+
+template <typename AlignedType>
+bool IsAlignedTo(const AlignedType &object, size_t align) {
+  return reinterpret_cast<uintptr_t>(object.get()) % align == 0;
+}
+
+TEST(AlignedObjectTest, ObjectIsAlignedAndValueInitialized) {
+  AlignedObject<TestStruct, 512> object512;
+  uint8_t unaligned_padding[3];
+  AlignedObject<TestStruct, 4096> object4096;
+  (void)unaligned_padding;
+
+  EXPECT_TRUE(IsAlignedTo(object512, 512));
+  EXPECT_TRUE(IsAlignedTo(object4096, 4096));
+  EXPECT_TRUE((AlignedObject<TestStruct, 512>::IsAligned(object512.get())));
+  EXPECT_EQ(object512->a, 0);
+  EXPECT_EQ((*object4096).b, 0);
+}
+
+TEST(AlignedObjectTest, ForwardsConstructorArguments) {
+  AlignedObject<CountedClass, 64> object(7);
+  EXPECT_EQ(object->value(), 7);
+  EXPECT_TRUE(IsAlignedTo(object, 64));
+}
+
+TEST(PooledAlignedObjectTest, ObjectIsAlignedAndDestroyed) {
+  {
+    PooledAlignedObject<CountedClass, 512> object(3);
+    EXPECT_EQ(object->value(), 3);
+    EXPECT_TRUE(IsAlignedTo(object, 512));
+    EXPECT_EQ(CountedClass::live_count, 1);
+  }
+  EXPECT_EQ(CountedClass::live_count, 0);
+}
+
+TEST(PooledAlignedObjectTest, RecyclesMemoryOfDestroyedObjects) {
+  const TestStruct *first_address;
+  {
+    PooledAlignedObject<TestStruct, 1024> object;
+    first_address = object.get();
+    object->a = 5;
+  }
+  {
+    PooledAlignedObject<TestStruct, 1024> object;
+    EXPECT_EQ(object.get(), first_address);
+    EXPECT_EQ(object->a, 0);
+  }
+
+  // Objects alive at the same time have distinct memory.
+  PooledAlignedObject<TestStruct, 1024> object1;
+  PooledAlignedObject<TestStruct, 1024> object2;
+  PooledAlignedObject<TestStruct, 1024> object3;
+  std::set<const TestStruct *> addresses = {object1.get(), object2.get(),
+                                            object3.get()};
+  EXPECT_EQ(addresses.size(), 3);
+  EXPECT_TRUE(IsAlignedTo(object2, 1024));
+}
+
+}  // namespace
+}  // namespace asylo
@@ -21,7 +21,6 @@
 
 #include "asylo/identity/util/bit_vector_128_util.h"
 
-#include <google/protobuf/util/message_differencer.h>
 #include "asylo/identity/util/bit_vector_128.pb.h"
 
 namespace asylo {
@@ -37,7 +36,7 @@ BitVector128 operator&(const BitVector128 &left, const BitVector128 &right) {
 }
 
 bool operator==(const BitVector128 &left, const BitVector128 &right) {
-  return ::google::protobuf::util::MessageDifferencer::Equivalent(left, right);
+  return left.low() == right.low() && left.high() == right.high();
 }
 
 bool operator!=(const BitVector128 &left, const BitVector128 &right) {
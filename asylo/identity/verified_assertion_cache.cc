@@ -0,0 +1,127 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/identity/verified_assertion_cache.h"
+
+#include <iterator>
+
+#include "absl/memory/memory.h"
+#include "absl/time/clock.h"
+#include "asylo/identity/assertion_description_util.h"
+
+namespace asylo {
+
+constexpr absl::Duration VerifiedAssertionCache::kMaxTtl;
+
+StatusOr<std::unique_ptr<VerifiedAssertionCache>>
+VerifiedAssertionCache::Create(size_t capacity, absl::Duration ttl) {
+  if (ttl <= absl::ZeroDuration() || ttl > kMaxTtl) {
+    return Status(error::GoogleError::INVALID_ARGUMENT,
+                  "Cache time-to-live is out of range");
+  }
+  return absl::WrapUnique(new VerifiedAssertionCache(capacity, ttl));
+}
+
+VerifiedAssertionCache::VerifiedAssertionCache(size_t capacity,
+                                               absl::Duration ttl)
+    : capacity_(capacity), ttl_(ttl) {}
+
+Status VerifiedAssertionCache::Verify(const EnclaveAssertionVerifier &verifier,
+                                      const std::string &user_data,
+                                      const Assertion &assertion,
+                                      EnclaveIdentity *peer_identity,
+                                      google::protobuf::Arena *arena) {
+  StatusOr<std::string> digest_result = verifier.GetIdentityDigest(assertion);
+  if (!digest_result.ok()) {
+    return verifier.Verify(user_data, assertion, peer_identity, arena);
+  }
+
+  StatusOr<std::string> description_result =
+      SerializeAssertionDescription(assertion.description());
+  if (!description_result.ok()) {
+    return description_result.status();
+  }
+
+  // The serialized description is unique, so it can be used as a prefix
+  // without a separator.
+  std::string key = std::move(description_result).ValueOrDie();
+  key.append(digest_result.ValueOrDie());
+
+  EnclaveIdentity cached_identity;
+  if (Lookup(key, &cached_identity)) {
+    Status status = verifier.VerifyBinding(user_data, assertion, arena);
+    if (!status.ok()) {
+      return status;
+    }
+    *peer_identity = std::move(cached_identity);
+    return Status::OkStatus();
+  }
+
+  Status status = verifier.Verify(user_data, assertion, peer_identity, arena);
+  if (!status.ok()) {
+    return status;
+  }
+  Insert(key, *peer_identity);
+  return Status::OkStatus();
+}
+
+size_t VerifiedAssertionCache::size() const {
+  absl::MutexLock lock(&mu_);
+  return entries_.size();
+}
+
+bool VerifiedAssertionCache::Lookup(const std::string &key,
+                                    EnclaveIdentity *identity) {
+  absl::MutexLock lock(&mu_);
+  auto index_it = index_.find(key);
+  if (index_it == index_.end()) {
+    return false;
+  }
+
+  EntryList::iterator entry_it = index_it->second;
+  if (entry_it->second.expiration <= absl::Now()) {
+    entries_.erase(entry_it);
+    index_.erase(index_it);
+    return false;
+  }
+  *identity = entry_it->second.identity;
+  return true;
+}
+
+void VerifiedAssertionCache::Insert(const std::string &key,
+                                    const EnclaveIdentity &identity) {
+  absl::MutexLock lock(&mu_);
+  auto index_it = index_.find(key);
+  if (index_it != index_.end()) {
+    entries_.erase(index_it->second);
+    index_.erase(index_it);
+  }
+
+  if (capacity_ == 0) {
+    return;
+  }
+  while (entries_.size() >= capacity_) {
+    index_.erase(entries_.front().first);
+    entries_.pop_front();
+  }
+
+  entries_.emplace_back(key, Entry{identity, absl::Now() + ttl_});
+  index_[key] = std::prev(entries_.end());
+}
+
+}  // namespace asylo
@@ -0,0 +1,110 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_IDENTITY_VERIFIED_ASSERTION_CACHE_H_
+#define ASYLO_IDENTITY_VERIFIED_ASSERTION_CACHE_H_
+
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+#include <google/protobuf/arena.h>
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+#include "asylo/identity/enclave_assertion_verifier.h"
+#include "asylo/identity/identity.pb.h"
+#include "asylo/util/status.h"
+#include "asylo/util/statusor.h"
+
+namespace asylo {
+
+// VerifiedAssertionCache remembers the identities extracted from verified
+// assertions, keyed by the assertion description and the identity digest
+// reported by the verifier. When a peer presents another assertion with the
+// same identity digest, the cache authenticates the assertion and its binding
+// to the new user data with EnclaveAssertionVerifier::VerifyBinding(), and
+// returns the cached identity instead of extracting it again.
+//
+// Verifiers that do not implement EnclaveAssertionVerifier::GetIdentityDigest()
+// are always sent through a full Verify().
+//
+// Cached identities expire after a fixed time-to-live. The cache holds at most
+// |capacity| identities; when full, inserting a new identity evicts the least
+// recently inserted one. VerifiedAssertionCache is thread-safe.
+class VerifiedAssertionCache {
+ public:
+  // Creates a cache holding at most |capacity| identities, each for at most
+  // |ttl|. |ttl| must be positive and must not exceed kMaxTtl.
+  static StatusOr<std::unique_ptr<VerifiedAssertionCache>> Create(
+      size_t capacity, absl::Duration ttl);
+
+  // The longest time-to-live a cache may be created with.
+  static constexpr absl::Duration kMaxTtl = absl::Hours(1);
+
+  VerifiedAssertionCache(const VerifiedAssertionCache &other) = delete;
+  VerifiedAssertionCache &operator=(const VerifiedAssertionCache &other) =
+      delete;
+
+  // Verifies |assertion| with |verifier| and writes the peer's identity to
+  // |peer_identity|. Has the same semantics as calling
+  // |verifier|.Verify(|user_data|, |assertion|, |peer_identity|, |arena|).
+  // Temporary messages of |verifier| are allocated on |arena| if it is not
+  // null.
+  Status Verify(const EnclaveAssertionVerifier &verifier,
+                const std::string &user_data, const Assertion &assertion,
+                EnclaveIdentity *peer_identity,
+                google::protobuf::Arena *arena = nullptr);
+
+  // Returns the number of identities held by the cache, including expired ones
+  // that have not been evicted yet.
+  size_t size() const;
+
+ private:
+  struct Entry {
+    EnclaveIdentity identity;
+    absl::Time expiration;
+  };
+
+  using EntryList = std::list<std::pair<std::string, Entry>>;
+
+  VerifiedAssertionCache(size_t capacity, absl::Duration ttl);
+
+  // Copies the unexpired identity cached under |key| to |identity|. Returns
+  // false if there is no such identity.
+  bool Lookup(const std::string &key, EnclaveIdentity *identity);
+
+  // Caches |identity| under |key|.
+  void Insert(const std::string &key, const EnclaveIdentity &identity);
+
+  const size_t capacity_;
+  const absl::Duration ttl_;
+
+  mutable absl::Mutex mu_;
+
+  // Cached identities in the order in which they were inserted, oldest first.
+  EntryList entries_ GUARDED_BY(mu_);
+
+  // An index into |entries_|.
+  std::unordered_map<std::string, EntryList::iterator> index_ GUARDED_BY(mu_);
+};
+
+}  // namespace asylo
+
+#endif  // ASYLO_IDENTITY_VERIFIED_ASSERTION_CACHE_H_
@@ -0,0 +1,202 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/identity/verified_assertion_cache.h"
+
+#include <memory>
+#include <string>
+#include <utility>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "asylo/test/util/status_matchers.h"
+
+namespace asylo {
+namespace {
+
+using ::testing::Not;
+
+constexpr char kAuthorityType[] = "Fake";
+constexpr char kUserData[] = "user data";
+constexpr char kOtherUserData[] = "other user data";
+
+// A verifier whose assertions are of the form <identity>:<user data>. It counts
+// calls to Verify() and VerifyBinding(), and optionally opts out of caching.
+class FakeAssertionVerifier final : public EnclaveAssertionVerifier {
+ public:
+  explicit FakeAssertionVerifier(bool supports_caching)
+      : supports_caching_(supports_caching) {}
+
+  Status Initialize(const std::string &config) override {
+    return Status::OkStatus();
+  }
+  bool IsInitialized() const override { return true; }
+  EnclaveIdentityType IdentityType() const override { return CODE_IDENTITY; }
+  std::string AuthorityType() const override { return kAuthorityType; }
+
+  Status CreateAssertionRequest(AssertionRequest *request) const override {
+    return Status(error::GoogleError::UNIMPLEMENTED, "Not implemented");
+  }
+  StatusOr<bool> CanVerify(const AssertionOffer &offer) const override {
+    return true;
+  }
+
+  Status Verify(const std::string &user_data, const Assertion &assertion,
+                EnclaveIdentity *peer_identity) const override {
+    ++verify_calls_;
+    Status status = VerifyBinding(user_data, assertion);
+    if (!status.ok()) {
+      return status;
+    }
+    peer_identity->mutable_description()->set_identity_type(CODE_IDENTITY);
+    peer_identity->mutable_description()->set_authority_type(kAuthorityType);
+    peer_identity->set_identity(Split(assertion).first);
+    return Status::OkStatus();
+  }
+
+  StatusOr<std::string> GetIdentityDigest(
+      const Assertion &assertion) const override {
+    if (!supports_caching_) {
+      return EnclaveAssertionVerifier::GetIdentityDigest(assertion);
+    }
+    return Split(assertion).first;
+  }
+
+  Status VerifyBinding(const std::string &user_data,
+                       const Assertion &assertion) const override {
+    ++verify_binding_calls_;
+    if (Split(assertion).second != user_data) {
+      return Status(error::GoogleError::INTERNAL,
+                    "Assertion is not bound to the provided user-data");
+    }
+    return Status::OkStatus();
+  }
+
+  int verify_calls() const { return verify_calls_; }
+  int verify_binding_calls() const { return verify_binding_calls_; }
+
+ private:
+  static std::pair<std::string, std::string> Split(const Assertion &assertion) {
+    const std::string &body = assertion.assertion();
+    size_t pos = body.find(':');
+    return {body.substr(0, pos), body.substr(pos + 1)};
+  }
+
+  const bool supports_caching_;
+  mutable int verify_calls_ = 0;
+  mutable int verify_binding_calls_ = 0;
+};
+
+Assertion MakeAssertion(const std::string &identity,
+                        const std::string &user_data) {
+  Assertion assertion;
+  assertion.mutable_description()->set_identity_type(CODE_IDENTITY);
+  assertion.mutable_description()->set_authority_type(kAuthorityType);
+  assertion.set_assertion(identity + ":" + user_data);
+  return assertion;
+}
+
+std::unique_ptr<VerifiedAssertionCache> CreateCache(size_t capacity) {
+  return VerifiedAssertionCache::Create(capacity, absl::Minutes(5))
+      .ValueOrDie();
+}
+
+// Verify that Create rejects time-to-live values that are not positive or that
+// exceed the maximum.
+TEST(VerifiedAssertionCacheTest, CreateBadTtl) {
+  EXPECT_THAT(VerifiedAssertionCache::Create(4, absl::ZeroDuration()),
+              Not(IsOk()));
+  EXPECT_THAT(VerifiedAssertionCache::Create(
+                  4, VerifiedAssertionCache::kMaxTtl + absl::Seconds(1)),
+              Not(IsOk()));
+}
+
+// Verify that a second assertion with the same identity skips Verify() but is
+// still checked against its own user data.
+TEST(VerifiedAssertionCacheTest, CachedIdentityStillVerifiesBinding) {
+  FakeAssertionVerifier verifier(/*supports_caching=*/true);
+  std::unique_ptr<VerifiedAssertionCache> cache = CreateCache(4);
+
+  EnclaveIdentity identity;
+  ASSERT_THAT(cache->Verify(verifier, kUserData,
+                            MakeAssertion("peer", kUserData), &identity),
+              IsOk());
+  EXPECT_EQ(identity.identity(), "peer");
+  EXPECT_EQ(verifier.verify_calls(), 1);
+  EXPECT_EQ(cache->size(), 1);
+
+  EnclaveIdentity cached_identity;
+  ASSERT_THAT(
+      cache->Verify(verifier, kOtherUserData,
+                    MakeAssertion("peer", kOtherUserData), &cached_identity),
+      IsOk());
+  EXPECT_EQ(cached_identity.identity(), "peer");
+  EXPECT_EQ(verifier.verify_calls(), 1);
+
+  EXPECT_THAT(cache->Verify(verifier, kOtherUserData,
+                            MakeAssertion("peer", kUserData), &cached_identity),
+              Not(IsOk()));
+  EXPECT_EQ(verifier.verify_calls(), 1);
+}
+
+// Verify that failed verifications are not cached.
+TEST(VerifiedAssertionCacheTest, FailedVerificationIsNotCached) {
+  FakeAssertionVerifier verifier(/*supports_caching=*/true);
+  std::unique_ptr<VerifiedAssertionCache> cache = CreateCache(4);
+
+  EnclaveIdentity identity;
+  EXPECT_THAT(cache->Verify(verifier, kUserData,
+                            MakeAssertion("peer", kOtherUserData), &identity),
+              Not(IsOk()));
+  EXPECT_EQ(cache->size(), 0);
+}
+
+// Verify that verifiers without identity digests always go through Verify().
+TEST(VerifiedAssertionCacheTest, VerifierWithoutDigestIsNotCached) {
+  FakeAssertionVerifier verifier(/*supports_caching=*/false);
+  std::unique_ptr<VerifiedAssertionCache> cache = CreateCache(4);
+
+  EnclaveIdentity identity;
+  for (int i = 0; i < 2; ++i) {
+    ASSERT_THAT(cache->Verify(verifier, kUserData,
+                              MakeAssertion("peer", kUserData), &identity),
+                IsOk());
+  }
+  EXPECT_EQ(verifier.verify_calls(), 2);
+  EXPECT_EQ(cache->size(), 0);
+}
+
+// Verify that the cache evicts the oldest identity when full.
+TEST(VerifiedAssertionCacheTest, InsertEvictsOldestIdentity) {
+  FakeAssertionVerifier verifier(/*supports_caching=*/true);
+  std::unique_ptr<VerifiedAssertionCache> cache = CreateCache(2);
+
+  EnclaveIdentity identity;
+  for (const char *peer : {"a", "b", "c", "a"}) {
+    ASSERT_THAT(cache->Verify(verifier, kUserData,
+                              MakeAssertion(peer, kUserData), &identity),
+                IsOk());
+  }
+  EXPECT_EQ(verifier.verify_calls(), 4);
+  EXPECT_EQ(cache->size(), 2);
+}
+
+}  // namespace
+}  // namespace asylo
@@ -0,0 +1,104 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_PLATFORM_ARCH_INCLUDE_TRUSTED_ASYNC_IO_H_
+#define ASYLO_PLATFORM_ARCH_INCLUDE_TRUSTED_ASYNC_IO_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/socket.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Name prefix under which the untrusted runtime publishes the asynchronous I/O
+// queue of an enclave as a kAddressName shared resource. The full resource name
+// is the prefix followed by the enclave name.
+#define ENC_ASYNC_IO_QUEUE_RESOURCE_PREFIX "async_io_queue/"
+
+// Operations accepted by enc_async_io_submit.
+#define ENC_ASYNC_IO_READ 1
+#define ENC_ASYNC_IO_WRITE 2
+#define ENC_ASYNC_IO_FSYNC 3
+#define ENC_ASYNC_IO_SENDMSG 4
+
+// An asynchronous operation on a host file descriptor.
+struct enc_async_io_request {
+  // One of the ENC_ASYNC_IO_* operations.
+  int opcode;
+
+  // Host file descriptor the operation applies to.
+  int host_fd;
+
+  // Buffer read into or written from by ENC_ASYNC_IO_READ and
+  // ENC_ASYNC_IO_WRITE. A read buffer must remain valid until the operation is
+  // reaped.
+  void *buf;
+
+  // Size of |buf| in bytes.
+  size_t count;
+
+  // File offset for reads and writes, or -1 to use the current file position.
+  int64_t offset;
+
+  // Message sent by ENC_ASYNC_IO_SENDMSG. Its contents are copied at
+  // submission. Ancillary data is not supported.
+  const struct msghdr *msg;
+
+  // Flags passed to sendmsg.
+  int flags;
+
+  // Value identifying the operation in its completion.
+  uint64_t user_data;
+};
+
+// The outcome of an asynchronous operation.
+struct enc_async_io_completion {
+  // |user_data| of the completed request.
+  uint64_t user_data;
+
+  // Return value of the operation, or -1 on failure.
+  int64_t result;
+
+  // errno value describing a failed operation, or 0 on success.
+  int error;
+};
+
+// Attaches the enclave to the asynchronous I/O queue published by the host for
+// the enclave named |enclave_name|. Returns 0 on success, or -1 if no valid
+// queue was published.
+int enc_enable_async_io(const char *enclave_name);
+
+// Submits |request| to the host workers without waiting for it to be serviced.
+// Transfers are limited to 64 KiB. Returns 0 on success, or -1 with errno set
+// to ENOSYS if asynchronous I/O is not enabled, EAGAIN if too many operations
+// are already in flight, or EINVAL if |request| is malformed.
+int enc_async_io_submit(const struct enc_async_io_request *request);
+
+// Stores up to |max_completions| completed operations in |completions|
+// without blocking, copying data received by reads into their buffers. Returns
+// the number of completions stored.
+int enc_async_io_reap(struct enc_async_io_completion *completions,
+                      int max_completions);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
+#endif  // ASYLO_PLATFORM_ARCH_INCLUDE_TRUSTED_ASYNC_IO_H_
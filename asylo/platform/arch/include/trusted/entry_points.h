@@ -42,7 +42,8 @@ extern "C" {
 // User-defined enclave initialization routine.
 //
 // The input type is asylo::EnclaveConfig.
-// The output type is asylo::StatusProto.
+// The output type is asylo::EnclaveOutput, with its status and startup timing
+// set.
 int __asylo_user_init(const char *name, const char *config, size_t config_len,
                       char **output, size_t *output_len);
 
@@ -53,6 +54,41 @@ int __asylo_user_init(const char *name, const char *config, size_t config_len,
 int __asylo_user_run(const char *input, size_t input_len, char **output,
                      size_t *output_len);
 
+// User-defined enclave execution routine on a batch of inputs, which are run
+// in order within a single call.
+//
+// The input type is asylo::EnclaveInputBatch.
+// The output type is asylo::EnclaveOutputBatch.
+int __asylo_user_run_batch(const char *input, size_t input_len, char **output,
+                           size_t *output_len);
+
+// User-defined enclave execution routine on caller-owned untrusted buffers.
+//
+// |input| points to untrusted memory and is parsed in place. The output is
+// written to |output_buffer| if it fits in |output_capacity| bytes, in which
+// case *|output| is set to |output_buffer| and the caller keeps ownership of
+// it. Otherwise the output is allocated outside the enclave as for
+// __asylo_user_run. |output_buffer| may be null.
+//
+// The input type is asylo::EnclaveInput.
+// The output type is asylo::EnclaveOutput.
+int __asylo_user_run_with_buffers(const char *input, size_t input_len,
+                                  char *output_buffer, size_t output_capacity,
+                                  char **output, size_t *output_len);
+
+// User-defined enclave execution routine on raw bytes.
+//
+// The input and output are opaque to the runtime, and no protobuf message is
+// involved. The output is written to |output_buffer| if it fits in
+// |output_capacity| bytes, or allocated outside the enclave otherwise, as for
+// __asylo_user_run_with_buffers. *|status_code| is set to the canonical error
+// code of the status returned by TrustedApplication::RunRaw. If it is not
+// zero, the output holds the error message of that status instead of output
+// from the application.
+int __asylo_user_run_raw(const char *input, size_t input_len,
+                         char *output_buffer, size_t output_capacity,
+                         char **output, size_t *output_len, int *status_code);
+
 // User-defined enclave finalization routine.
 //
 // The input type is asylo::EnclaveFinal.
@@ -60,6 +96,24 @@ int __asylo_user_run(const char *input, size_t input_len, char **output,
 int __asylo_user_fini(const char *final_input, size_t len, char **output,
                       size_t *output_len);
 
+// Enclave reset routine.
+//
+// The input type is asylo::EnclaveFinal.
+// The output type is asylo::StatusProto.
+int __asylo_user_reset(const char *final_input, size_t len, char **output,
+                       size_t *output_len);
+
+// Enclave snapshot routine.
+//
+// The output type is asylo::EnclaveSnapshot.
+int __asylo_user_snapshot(char **output, size_t *output_len);
+
+// Enclave resource usage routine.
+//
+// The output type is asylo::EnclaveResourceStats. Returns a non-zero error
+// code if the stats could not be serialized.
+int __asylo_get_resource_stats(char **output, size_t *output_len);
+
 // Threading-implementation defined enclave thread donate routine.
 int __asylo_threading_donate();
 
@@ -26,6 +26,10 @@
 extern "C" {
 #endif
 
+// Fills |buf| with |count| random bytes and returns |count|. On SGX hardware,
+// output is drawn from a per-thread DRBG that is seeded from the processor's
+// entropy source, so callers may request small amounts frequently without
+// paying the cost of an rdrand per request.
 ssize_t enc_hardware_random(uint8_t *buf, size_t count);
 
 #ifdef __cplusplus
@@ -0,0 +1,78 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_PLATFORM_ARCH_INCLUDE_TRUSTED_HEAP_H_
+#define ASYLO_PLATFORM_ARCH_INCLUDE_TRUSTED_HEAP_H_
+
+// Low-level access to the enclave heap, for use by memory allocators. Ranges
+// handed out by these functions are carved from the same region as sbrk(2)
+// and are never returned to it.
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Reserves |size| bytes of the enclave heap, starting at an address which is a
+// multiple of |alignment|, a power of two. Returns nullptr if the heap cannot
+// accommodate the request.
+void *enc_reserve_heap_range(size_t size, size_t alignment);
+
+// Stores the start address and maximum size in bytes of the region from which
+// the enclave heap is allocated.
+void enc_get_heap_region(void **base, size_t *size);
+
+// Reserves |size| bytes of address space, rounded up to a whole number of
+// pages, from the top of the enclave heap region, below any range previously
+// reserved this way. The range is placed out of reach of sbrk(2) but is not
+// backed by memory until committed with enc_commit_heap_pages. Returns
+// nullptr if the heap cannot accommodate the request.
+void *enc_reserve_heap_address_space(size_t size);
+
+// Backs the pages of a range reserved by enc_reserve_heap_address_space with
+// zero-filled memory. |address| and |size| must be page-aligned. Returns 0 on
+// success and -1 on failure. Without SGX2 dynamic memory management the whole
+// heap is committed at load time, and the pages are only cleared.
+int enc_commit_heap_pages(void *address, size_t size);
+
+// Releases the memory backing the committed pages in a range reserved by
+// enc_reserve_heap_address_space. The address space remains reserved.
+void enc_decommit_heap_pages(void *address, size_t size);
+
+// Usage of the enclave heap, in bytes.
+struct enc_heap_usage {
+  // Size of the region from which the heap is allocated.
+  size_t max_size;
+  // Bytes handed out by sbrk(2) and enc_reserve_heap_range, and the peak.
+  size_t in_use;
+  size_t peak_in_use;
+  // Bytes backed by EPC pages, and the peak. Without SGX2 dynamic memory
+  // management this is the whole heap.
+  size_t committed;
+  size_t peak_committed;
+};
+
+// Stores the current usage of the enclave heap in |usage|.
+void enc_get_heap_usage(struct enc_heap_usage *usage);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
+#endif  // ASYLO_PLATFORM_ARCH_INCLUDE_TRUSTED_HEAP_H_
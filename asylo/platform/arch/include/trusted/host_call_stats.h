@@ -0,0 +1,47 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_PLATFORM_ARCH_INCLUDE_TRUSTED_HOST_CALL_STATS_H_
+#define ASYLO_PLATFORM_ARCH_INCLUDE_TRUSTED_HOST_CALL_STATS_H_
+
+#include <cstdint>
+
+#include "asylo/enclave.pb.h"
+
+namespace asylo {
+
+// Fills |snapshot| with the counters of the host calls made by all enclave
+// threads so far. Counters are only kept if the host call wrappers were
+// generated with instrumentation, which is enabled by building with
+// --define=ASYLO_INSTRUMENT_HOST_CALLS=1. Otherwise |snapshot| is left empty.
+void GetHostCallStats(HostCallStatsSnapshot *snapshot);
+
+// Host calls made by one enclave thread, and their total latency.
+struct ThreadHostCallCounts {
+  uint64_t calls;
+  uint64_t total_latency_ns;
+};
+
+// Sets |counts| to the host calls made by the calling thread so far. Returns
+// false, leaving |counts| unchanged, if the host call wrappers were generated
+// without instrumentation.
+bool GetThreadHostCallCounts(ThreadHostCallCounts *counts);
+
+}  // namespace asylo
+
+#endif  // ASYLO_PLATFORM_ARCH_INCLUDE_TRUSTED_HOST_CALL_STATS_H_
@@ -26,9 +26,11 @@
 #include <arpa/inet.h>
 #include <ifaddrs.h>
 #include <poll.h>
+#include <pthread.h>
 #include <sched.h>
 #include <stddef.h>
 #include <stdint.h>
+#include <sys/epoll.h>
 #include <sys/socket.h>
 #include <sys/types.h>
 #include <time.h>
@@ -52,12 +54,29 @@ extern "C" {
 //   * If the host call fails for any reason (this may be backend-specific)
 void *enc_untrusted_malloc(size_t size);
 
+// Reserves |size| bytes of zeroed untrusted memory for the life of the
+// enclave, or returns nullptr on failure. The memory is carved from huge-page
+// mappings on the host, away from the heap used by enc_untrusted_malloc(), and
+// is never freed. It suits buffers that a thread reserves once and
+// sub-allocates from without further host calls.
+void *enc_untrusted_reserve(size_t size);
+
 // Reallocates memory on the untrusted heap.
 void *enc_untrusted_realloc(void *ptr, size_t size);
 
 // Releases memory on the untrusted heap.
 void enc_untrusted_free(void *ptr);
 
+// Queues |ptr| to be released on the untrusted heap. Each thread releases its
+// queued pointers together in a single host call once enough of them have
+// accumulated, when it returns from the ecall it entered the enclave through,
+// or when it calls enc_untrusted_flush_deferred_frees(). The memory must not
+// be used once it is queued.
+void enc_untrusted_free_deferred(void *ptr);
+
+// Releases the pointers queued by the calling thread.
+void enc_untrusted_flush_deferred_frees();
+
 //////////////////////////////////////
 //          Error Handling          //
 //////////////////////////////////////
@@ -90,11 +109,61 @@ int enc_untrusted_isatty(int file);
 ssize_t enc_untrusted_writev(int fd, const struct iovec *iov, int iovcnt);
 ssize_t enc_untrusted_readv(int fd, const struct iovec *iov, int iovcnt);
 
+// Reads and writes at |offset| without using or moving the file offset of the
+// host file descriptor.
+ssize_t enc_untrusted_pread(int fd, void *buf, size_t count, off_t offset);
+ssize_t enc_untrusted_pwrite(int fd, const void *buf, size_t count,
+                             off_t offset);
+
+// Reads and writes of up to SSIZE_MAX bytes which stream the data in chunks
+// through a per-thread untrusted staging buffer, so that a multi-megabyte
+// transfer costs one copy across the enclave boundary per chunk and no
+// allocation of its full size. A read stops early at the first short chunk,
+// and a write at the first short or failed chunk; in both cases the number of
+// bytes transferred so far is returned. Returns -1 if no bytes were
+// transferred and a host call failed. After a full chunk a read waits for the
+// next one, so reads of pipes and sockets should use enc_untrusted_read().
+// Small transfers are also cheaper through enc_untrusted_read() and
+// enc_untrusted_write().
+ssize_t enc_untrusted_read_large(int fd, void *buf, size_t count);
+ssize_t enc_untrusted_write_large(int fd, const void *buf, size_t count);
+
+// Transfers directly between the host file descriptor |fd| and |buf|, which
+// must lie entirely outside the enclave; no bytes cross the enclave boundary.
+// Fails with EFAULT if any part of |buf| is inside the enclave. The caller
+// copies any data it needs into the enclave and must validate the result.
+ssize_t enc_untrusted_read_with_untrusted_ptr(int fd, void *buf, size_t size);
+ssize_t enc_untrusted_write_with_untrusted_ptr(int fd, const void *buf,
+                                               size_t size);
+ssize_t enc_untrusted_pread_with_untrusted_ptr(int fd, void *buf, size_t count,
+                                               int64_t offset);
+ssize_t enc_untrusted_pwrite_with_untrusted_ptr(int fd, const void *buf,
+                                                size_t count, int64_t offset);
+
+// Reads as many records of the directory open on |fd| as fit in |count| bytes
+// into |buf|, in the layout of the Linux getdents64 system call, so that a
+// large directory is listed in a few host calls. Returns the number of bytes
+// read, 0 at the end of the directory, or -1 on error.
+ssize_t enc_untrusted_getdents64(int fd, void *buf, size_t count);
+
+// Transfers data between two host file descriptors entirely on the host. When
+// an offset pointer is non-null, the offset is advanced by the number of bytes
+// transferred as computed inside the enclave.
+ssize_t enc_untrusted_sendfile(int out_fd, int in_fd, off_t *offset,
+                               size_t count);
+ssize_t enc_untrusted_splice(int fd_in, off_t *off_in, int fd_out,
+                             off_t *off_out, size_t len, unsigned int flags);
+ssize_t enc_untrusted_copy_file_range(int fd_in, off_t *off_in, int fd_out,
+                                      off_t *off_out, size_t len,
+                                      unsigned int flags);
+
 //////////////////////////////////////
 //            Sockets               //
 //////////////////////////////////////
 
 int enc_untrusted_accept(int sockfd, struct sockaddr *addr, socklen_t *addrlen);
+int enc_untrusted_accept4(int sockfd, struct sockaddr *addr, socklen_t *addrlen,
+                          int flags);
 int enc_untrusted_bind(int sockfd, const struct sockaddr *addr,
                        socklen_t addrlen);
 int enc_untrusted_connect(int sockfd, const struct sockaddr *addr,
@@ -102,6 +171,19 @@ int enc_untrusted_connect(int sockfd, const struct sockaddr *addr,
 int enc_untrusted_listen(int sockfd, int backlog);
 int enc_untrusted_setsockopt(int socket, int level, int option_name,
                              const void *option_value, socklen_t option_len);
+
+// An integer-valued socket option, as passed to enc_untrusted_setsockopts.
+struct enc_int_sockopt {
+  int level;
+  int option_name;
+  int value;
+};
+
+// Sets the |count| integer socket options |options| on |socket| in order, in a
+// single host call. Returns 0, or -1 with errno set for the first option the
+// host fails to set, in which case the later options are not set.
+int enc_untrusted_setsockopts(int socket, const struct enc_int_sockopt *options,
+                              size_t count);
 int enc_untrusted_shutdown(int sockfd, int how);
 int enc_untrusted_socket(int domain, int type, int protocol);
 const char *enc_untrusted_inet_ntop(int af, const void *src, char *dst,
@@ -110,6 +192,14 @@ int enc_untrusted_inet_pton(int af, const char *src, void *dst);
 ssize_t enc_untrusted_send(int sockfd, const void *buf, size_t len, int flags);
 ssize_t enc_untrusted_sendmsg(int sockfd, const struct msghdr *msg, int flags);
 ssize_t enc_untrusted_recvmsg(int sockfd, struct msghdr *msg, int flags);
+
+// Moves up to |vlen| messages across the enclave boundary through a single
+// untrusted arena and a single host call.
+int enc_untrusted_sendmmsg(int sockfd, struct mmsghdr *msgvec,
+                           unsigned int vlen, int flags);
+int enc_untrusted_recvmmsg(int sockfd, struct mmsghdr *msgvec,
+                           unsigned int vlen, int flags,
+                           struct timespec *timeout);
 int enc_untrusted_getaddrinfo(const char *node, const char *service,
                               const struct addrinfo *hints,
                               struct addrinfo **res);
@@ -129,12 +219,40 @@ int enc_untrusted_getpeername(int sockfd, struct sockaddr *addr,
 // of the named enclave.
 int enc_untrusted_create_thread(const char *name);
 
+// Suspends the calling thread on the host until another thread wakes it with
+// enc_untrusted_thread_wake. A wake posted to a thread which is not waiting is
+// remembered, causing its next wait to return immediately. Since the host is
+// untrusted, a wait may also return spuriously, so callers must re-check the
+// condition they are waiting for. Returns 0 on success.
+int enc_untrusted_thread_wait();
+
+// Like enc_untrusted_thread_wait, but also returns once |timeout_ns|
+// nanoseconds have passed. A negative timeout waits indefinitely.
+int enc_untrusted_thread_wait_timeout(int64_t timeout_ns);
+
+// Wakes |thread| if it is waiting in enc_untrusted_thread_wait, or makes its
+// next wait return immediately. Returns 0 on success.
+int enc_untrusted_thread_wake(pthread_t thread);
+
 //////////////////////////////////////
 //            poll.h                //
 //////////////////////////////////////
 
 int enc_untrusted_poll(struct pollfd *fds, nfds_t nfds, int timeout);
 
+//////////////////////////////////////
+//          sys/epoll.h             //
+//////////////////////////////////////
+
+int enc_untrusted_epoll_create1(int flags);
+int enc_untrusted_epoll_ctl(int epfd, int op, int fd,
+                            struct epoll_event *event);
+
+// Waits on the host epoll instance |epfd|. Only the ready events are copied
+// back into the enclave.
+int enc_untrusted_epoll_wait(int epfd, struct epoll_event *events,
+                             int maxevents, int timeout);
+
 //////////////////////////////////////
 //            ifaddrs.h             //
 //////////////////////////////////////
@@ -149,6 +267,11 @@ void enc_untrusted_freeifaddrs(struct ifaddrs *ifa);
 // |sizeof(/*enclave-native*/ cpu_set_t)|.
 int enc_untrusted_sched_getaffinity(pid_t pid, size_t cpusetsize,
                                     cpu_set_t *mask);
+// Returns -1 and sets |errno| to |EINVAL| if |cpusetsize| is less than
+// |sizeof(/*enclave-native*/ cpu_set_t)|. A |pid| of zero is the host thread
+// making the call.
+int enc_untrusted_sched_setaffinity(pid_t pid, size_t cpusetsize,
+                                    const cpu_set_t *mask);
 int enc_untrusted_sched_yield();
 
 //////////////////////////////////////
@@ -176,6 +299,11 @@ mode_t enc_untrusted_umask(mode_t mask);
 void enc_untrusted_openlog(const char *ident, int option, int facility);
 void enc_untrusted_syslog(int priority, const char *message);
 
+// Logs the |size| bytes of messages at |records|, serialized as described in
+// asylo/platform/common/syslog_batch.h, with a single host call. Returns 0 on
+// success and -1 on failure.
+int enc_untrusted_syslog_batch(const uint8_t *records, size_t size);
+
 //////////////////////////////////////
 //            time.h                //
 //////////////////////////////////////
@@ -206,6 +334,16 @@ pid_t enc_untrusted_getppid();
 int enc_untrusted_wait(int *wstatus);
 pid_t enc_untrusted_wait3(int *wstatus, int options, struct rusage *rusage);
 
+//////////////////////////////////////
+//           spawn.h                //
+//////////////////////////////////////
+
+// Spawns a host process as described by the |size|-byte |request|, serialized
+// as described in asylo/platform/common/spawn_request.h, with a single host
+// call. Stores the id of the process in |pid| and returns 0 on success, or
+// returns -1 and sets errno on failure.
+int enc_untrusted_posix_spawn(const char *request, size_t size, pid_t *pid);
+
 //////////////////////////////////////
 //            Runtime support       //
 //////////////////////////////////////
@@ -223,6 +361,28 @@ void *enc_untrusted_acquire_shared_resource(enum SharedNameKind kind,
 int enc_untrusted_release_shared_resource(enum SharedNameKind kind,
                                           const char *name);
 
+//////////////////////////////////////
+//          Batched Calls           //
+//////////////////////////////////////
+
+// A set of independent host calls run on the host in a single enclave exit.
+// Calls are queued with the generated enc_untrusted_batch_<name> functions,
+// which exist for every host call whose arguments can be marshalled by value,
+// and run in the order they were queued when the batch is submitted.
+struct enc_untrusted_batch;
+
+// Creates an empty batch.
+struct enc_untrusted_batch *enc_untrusted_batch_create();
+
+// Runs every call queued in |batch| and stores their results. The batch is
+// left empty and may be reused. Returns 0 on success, even if individual calls
+// failed, or -1 if the batch could not be run, in which case no results are
+// stored.
+int enc_untrusted_batch_submit(struct enc_untrusted_batch *batch);
+
+// Destroys |batch|, discarding any calls that have not been submitted.
+void enc_untrusted_batch_destroy(struct enc_untrusted_batch *batch);
+
 //////////////////////////////////////
 //            Debugging             //
 //////////////////////////////////////
@@ -26,9 +26,10 @@
 namespace asylo {
 
 // Deleter for untrusted memory for use with std::unique_ptr. Calls
-// enc_untrusted_free() internally.
+// enc_untrusted_free_deferred() internally, so that memory released by many
+// objects is returned to the host in a few host calls.
 struct UntrustedDeleter {
-  inline void operator()(void *ptr) const { enc_untrusted_free(ptr); }
+  inline void operator()(void *ptr) const { enc_untrusted_free_deferred(ptr); }
 };
 
 template <typename T>
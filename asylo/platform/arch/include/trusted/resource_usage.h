@@ -0,0 +1,82 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_PLATFORM_ARCH_INCLUDE_TRUSTED_RESOURCE_USAGE_H_
+#define ASYLO_PLATFORM_ARCH_INCLUDE_TRUSTED_RESOURCE_USAGE_H_
+
+// Counters of the enclave resources held by threads and allocators, for
+// reporting in asylo::EnclaveResourceStats. Heap usage is reported by
+// enc_get_heap_usage in heap.h.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Stores the number of threads currently inside the enclave, each of which
+// occupies a TCS, in |in_use| and the highest number inside it at once in
+// |peak_in_use|.
+void enc_get_tcs_usage(int *in_use, int *peak_in_use);
+
+// Returns the number of untrusted pointers queued for release by
+// enc_untrusted_free_deferred() on all threads and not released yet.
+size_t enc_get_untrusted_frees_pending(void);
+
+// Number of malloc calls served by allocations of at most |max_size| bytes.
+struct enc_malloc_class_calls {
+  size_t max_size;
+  uint64_t calls;
+};
+
+// Defined only when a malloc which counts its calls, such as
+// //asylo/platform/posix/malloc:thread_caching_malloc, is linked into the
+// enclave, and null otherwise. Stores the number of calls served by each size
+// class of the allocator in |entries| by increasing size, followed by an entry
+// with a |max_size| of SIZE_MAX for larger requests. Returns the number of
+// entries stored, which is at most |capacity|.
+size_t enc_get_malloc_calls(struct enc_malloc_class_calls *entries,
+                            size_t capacity) __attribute__((weak));
+
+// Defined along with enc_get_malloc_calls, and null otherwise. Returns the
+// number of malloc calls made so far by the calling thread.
+uint64_t enc_get_thread_malloc_calls(void) __attribute__((weak));
+
+// Memory held by the frame protectors of the enclave's secure gRPC connections
+// which buffer frames in the enclave, one per connection: the number of
+// protectors, those whose buffers are released while idle, and the bytes held
+// by their buffers in total and by the protector holding the most.
+struct enc_frame_protector_usage {
+  size_t protectors;
+  size_t idle_protectors;
+  size_t buffer_bytes;
+  size_t max_protector_buffer_bytes;
+};
+
+// Defined only when the enclave links
+// //asylo/grpc/auth/core:chacha20_poly1305_frame_protector, and null
+// otherwise. Stores the memory held by the live frame protectors in |usage|.
+void enc_get_frame_protector_usage(struct enc_frame_protector_usage *usage)
+    __attribute__((weak));
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
+#endif  // ASYLO_PLATFORM_ARCH_INCLUDE_TRUSTED_RESOURCE_USAGE_H_
@@ -0,0 +1,39 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_PLATFORM_ARCH_INCLUDE_TRUSTED_SAMPLING_PROFILER_H_
+#define ASYLO_PLATFORM_ARCH_INCLUDE_TRUSTED_SAMPLING_PROFILER_H_
+
+#include "asylo/enclave.pb.h"
+#include "asylo/util/status.h"
+
+namespace asylo {
+
+// Installs a SIGPROF handler which records the stack of the interrupted
+// enclave thread, keeping up to |capacity| stacks in a buffer allocated up
+// front. Stacks are walked through frame pointers, so code built without them
+// only contributes its innermost frame. The interrupted state is only readable
+// in debug enclaves and in simulation.
+Status StartSamplingProfiler(int capacity);
+
+// Fills |profile| with the stacks recorded so far.
+void GetSamplingProfile(EnclaveProfile *profile);
+
+}  // namespace asylo
+
+#endif  // ASYLO_PLATFORM_ARCH_INCLUDE_TRUSTED_SAMPLING_PROFILER_H_
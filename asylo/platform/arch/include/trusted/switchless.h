@@ -0,0 +1,62 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_PLATFORM_ARCH_INCLUDE_TRUSTED_SWITCHLESS_H_
+#define ASYLO_PLATFORM_ARCH_INCLUDE_TRUSTED_SWITCHLESS_H_
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Name prefix under which the untrusted runtime publishes the switchless
+// request queue of an enclave as a kAddressName shared resource. The full
+// resource name is the prefix followed by the enclave name.
+#define ENC_SWITCHLESS_QUEUE_RESOURCE_PREFIX "switchless_queue/"
+
+// Attaches the enclave to the switchless request queue published by the host
+// for the enclave named |enclave_name|. Once attached, host calls generated
+// with the switchless option are serviced by host worker threads without
+// exiting the enclave. Returns 0 on success, or -1 if no valid queue was
+// published, in which case all host calls continue to use the classic path.
+int enc_enable_switchless_host_calls(const char *enclave_name);
+
+// Costs measured by enc_calibrate_switchless_host_calls().
+struct enc_switchless_costs {
+  // Round trip of a classic ocall, including the enclave exit and re-entry.
+  int64_t exit_ns;
+
+  // Round trip of an empty request through the switchless queue.
+  int64_t request_ns;
+
+  // Cost of copying one byte of arguments to untrusted memory.
+  int64_t copy_ps_per_byte;
+};
+
+// Measures the costs used to route host calls generated with the adaptive
+// switchless policy, and stores them in |costs| if it is not null. Until this
+// is called, adaptive host calls always use classic ocalls. Returns 0 on
+// success, or -1 if switchless host calls are not enabled.
+int enc_calibrate_switchless_host_calls(struct enc_switchless_costs *costs);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
+#endif  // ASYLO_PLATFORM_ARCH_INCLUDE_TRUSTED_SWITCHLESS_H_
@@ -19,6 +19,8 @@
 #ifndef ASYLO_PLATFORM_ARCH_INCLUDE_TRUSTED_TIME_H_
 #define ASYLO_PLATFORM_ARCH_INCLUDE_TRUSTED_TIME_H_
 
+#include <stdint.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -32,6 +34,26 @@ void get_time_view();
 // the a monotonic timer. The value is expected to change, but not the location.
 void get_monotime_view();
 
+// Switches the enclave clocks to reading the time stamp counter, converted
+// with the calibration published by the host, instead of the values ticked by
+// the host. Clocks keep using the host ticks while the host has not published
+// a calibration. Must only be called if RDTSC may be executed in the enclave.
+void enc_enable_tsc_clock();
+
+// Sets the duration in nanoseconds above which nanosleep leaves the enclave to
+// sleep on the host. Shorter sleeps busy wait inside the enclave.
+void enc_set_nanosleep_exit_threshold(int64_t threshold);
+
+// Returns the duration in nanoseconds above which nanosleep leaves the enclave.
+// Other waits with a deadline use it to decide between polling the enclave
+// clock and sleeping on the host.
+int64_t enc_nanosleep_exit_threshold();
+
+// Measures the cost of sleeping on the host and sets the nanosleep exit
+// threshold to it, between 10 microseconds and 3 milliseconds. Returns the new
+// threshold.
+int64_t enc_calibrate_nanosleep_exit_threshold();
+
 #ifdef __cplusplus
 }  // extern "C"
 #endif
@@ -25,15 +25,21 @@ go/asylo-system-calls
 
 The input files required by the code generator are:
   1. host_calls.textproto (the specification for which to generate code)
-  2. templates/* (the set of template files to use for code generation)
+  2. bridge_structs.textproto (the structs to translate across the boundary)
+  3. templates/* (the set of template files to use for code generation)
+  4. ../errno.edl (the errno values translated across the enclave boundary)
 
 The files generated and output by the code generator are:
   1. generated_bridge.edl
   2. generated_host_calls.cc
   3. generated_ocalls.cc
+  4. generated_host_call_batch.h
+  5. generated_bridge_structs.h
+  6. generated_bridge_structs.cc
 """
 
 import os
+import re
 from absl import app
 from absl import flags
 from jinja2 import Template
@@ -44,6 +50,9 @@ FLAGS = flags.FLAGS
 
 flags.DEFINE_string('output_dir', None,
                     'Absolute file path to dump the generated output files.')
+flags.DEFINE_bool('instrument_host_calls', False,
+                  'Whether the generated host calls count their invocations, '
+                  'marshalled bytes and latencies.')
 
 # Relative path to the code generator.
 CODEGEN_PATH = os.path.dirname(os.path.realpath(__file__))
@@ -51,15 +60,27 @@ CODEGEN_PATH = os.path.dirname(os.path.realpath(__file__))
 # Input host call configuration file.
 HOST_CALLS_TEXTPROTO_FILE = 'host_calls.textproto'
 
+# Input bridge struct configuration file.
+BRIDGE_STRUCTS_TEXTPROTO_FILE = 'bridge_structs.textproto'
+
+# List of errnos translated by the bridge, shared with the edger8r tool.
+ERRNO_EDL_FILE = '../errno.edl'
+
 # Template files to use for code generation.
 BRIDGE_EDL_TEMPLATE = 'templates/bridge_edl_template.txt'
 HOST_CALLS_TEMPLATE = 'templates/host_calls_template.txt'
 OCALLS_TEMPLATE = 'templates/ocalls_template.txt'
+HOST_CALL_BATCH_TEMPLATE = 'templates/host_call_batch_template.txt'
+BRIDGE_STRUCTS_HEADER_TEMPLATE = 'templates/bridge_structs_header_template.txt'
+BRIDGE_STRUCTS_TEMPLATE = 'templates/bridge_structs_template.txt'
 
 # Output files to generate.
 BRIDGE_EDL_FILE = 'generated_bridge.edl'
 HOST_CALLS_FILE = 'generated_host_calls.cc'
 OCALLS_FILE = 'generated_ocalls.cc'
+HOST_CALL_BATCH_FILE = 'generated_host_call_batch.h'
+BRIDGE_STRUCTS_HEADER_FILE = 'generated_bridge_structs.h'
+BRIDGE_STRUCTS_FILE = 'generated_bridge_structs.cc'
 
 GENERATED_FILE_WARNING = (
     '// This is a generated file. For more details about '
@@ -72,6 +93,10 @@ OUT = host_calls_pb2.PointerAttributeProto.OUT
 STRING = host_calls_pb2.PointerAttributeProto.STRING
 SIZE = host_calls_pb2.PointerAttributeProto.SIZE
 USER_CHECK = host_calls_pb2.PointerAttributeProto.USER_CHECK
+UNTRUSTED = host_calls_pb2.PointerAttributeProto.UNTRUSTED
+
+# Switchless policy enum aliases.
+ADAPTIVE = host_calls_pb2.HostCallProto.ADAPTIVE
 
 # Map from pointer attributes to strings.
 ATTRIBUTE_STRING_MAP = {
@@ -79,7 +104,8 @@ ATTRIBUTE_STRING_MAP = {
     OUT: 'out',
     STRING: 'string',
     SIZE: 'size',
-    USER_CHECK: 'user_check'
+    USER_CHECK: 'user_check',
+    UNTRUSTED: 'user_check'
 }
 
 
@@ -131,7 +157,8 @@ def validate_pointer_attributes(parameter_proto):
   parameter to identify potentially conflicting attributes. For example,
   labelling a pointer as IN and USER_CHECK is inconsistent, IN will attempt
   to copy the pointer's memory out of the enclave, while USER_CHECK prevents
-  copying memory entirely.
+  copying memory entirely. UNTRUSTED pointers are passed as user_check with a
+  trusted range check, so they must be sized and may not be copied.
 
   Args:
     parameter_proto: a single parameter protocol buffer to validate.
@@ -143,7 +170,8 @@ def validate_pointer_attributes(parameter_proto):
   if len(all_attributes) != len(set(all_attributes)):
     raise ValueError('Duplicate attributes given for parameter "%s"!' %
                      (parameter_proto.name))
-  if not any(attr in [IN, OUT, USER_CHECK] for attr in all_attributes):
+  if not any(attr in [IN, OUT, USER_CHECK, UNTRUSTED]
+             for attr in all_attributes):
     raise ValueError('Pointer copy annotation missing for parameter "%s"!' %
                      (parameter_proto.name))
   if (USER_CHECK in all_attributes and
@@ -153,6 +181,59 @@ def validate_pointer_attributes(parameter_proto):
   if STRING in all_attributes and SIZE in all_attributes:
     raise ValueError('Conflicting length and string annotations given for '
                      'parameter "%s"!' % (parameter_proto.name))
+  if UNTRUSTED in all_attributes:
+    if any(attr in [IN, OUT, STRING, USER_CHECK] for attr in all_attributes):
+      raise ValueError('Invalid combination of pointer copy annotations given '
+                       'for parameter "%s"!' % (parameter_proto.name))
+    if SIZE not in all_attributes:
+      raise ValueError('Untrusted pointer requires a size annotation for '
+                       'parameter "%s"!' % (parameter_proto.name))
+
+
+def validate_switchless_host_call(host_call_proto):
+  """Check that a host call marked switchless can be marshalled inline.
+
+  Switchless host calls copy their arguments into a fixed-size request payload
+  in untrusted memory, so the number of bytes behind every pointer parameter
+  must be computable on the trusted side before the call is made.
+
+  Args:
+    host_call_proto: a single host call protocol buffer to validate.
+
+  Raises:
+    ValueError: Host call cannot be serviced through the switchless queue.
+  """
+  if is_pointer_type(host_call_proto.return_type):
+    raise ValueError('Switchless host calls may not return a pointer!')
+  for parameter_proto in host_call_proto.parameters:
+    if not is_pointer_type(parameter_proto.type):
+      continue
+    attributes = [p.attribute for p in parameter_proto.pointer_attributes]
+    if USER_CHECK in attributes or UNTRUSTED in attributes:
+      raise ValueError('Switchless host calls may not take user_check '
+                       'parameter "%s"!' % (parameter_proto.name))
+    if STRING in attributes and (OUT in attributes or IN not in attributes):
+      raise ValueError('Switchless host calls only support input strings for '
+                       'parameter "%s"!' % (parameter_proto.name))
+    if STRING not in attributes and SIZE not in attributes:
+      raise ValueError('Switchless host calls require a size annotation for '
+                       'parameter "%s"!' % (parameter_proto.name))
+
+
+def is_marshallable_host_call(host_call_proto):
+  """Whether a host call can be serialized into a self-contained request.
+
+  Marshallable host calls may be serviced through the switchless queue and
+  queued in an enc_untrusted_batch.
+
+  Args:
+    host_call_proto: a single, otherwise valid, host call protocol buffer.
+  """
+  try:
+    validate_switchless_host_call(host_call_proto)
+  except ValueError:
+    return False
+  return True
 
 
 def validate_host_calls_proto(host_calls_proto):
@@ -181,6 +262,38 @@ def validate_host_calls_proto(host_calls_proto):
         raise_host_call_error(
             host_call_proto.name, 'Pointer attributes given '
             'for non-pointer parameter "%s"!' % (parameter_proto.name))
+    if host_call_proto.switchless:
+      try:
+        validate_switchless_host_call(host_call_proto)
+      except ValueError as error:
+        raise_host_call_error(host_call_proto.name, error.message)
+    elif host_call_proto.HasField('switchless_policy'):
+      raise_host_call_error(
+          host_call_proto.name,
+          'Switchless policy given for host call not marked switchless!')
+
+
+def validate_bridge_structs_proto(bridge_structs_proto):
+  """Check the given bridge structs proto for semantic errors."""
+  if not bridge_structs_proto.IsInitialized():
+    raise ValueError('Textproto file "%s" has missing required fields!' %
+                     (BRIDGE_STRUCTS_TEXTPROTO_FILE))
+  names = [s.name for s in bridge_structs_proto.bridge_structs]
+  if len(names) != len(set(names)):
+    raise ValueError('Duplicate bridge struct names given!')
+  for bridge_struct_proto in bridge_structs_proto.bridge_structs:
+    if not bridge_struct_proto.fields:
+      raise ValueError(
+          'No fields given for bridge struct "%s"!' % (bridge_struct_proto.name))
+    field_names = [f.name for f in bridge_struct_proto.fields]
+    if len(field_names) != len(set(field_names)):
+      raise ValueError('Duplicate fields given for bridge struct "%s"!' %
+                       (bridge_struct_proto.name))
+
+
+def native_field(field_proto):
+  """The expression naming a bridge struct field in the native struct."""
+  return field_proto.native_name or field_proto.name
 
 
 def comma_delimit_items(items):
@@ -189,8 +302,13 @@ def comma_delimit_items(items):
 
 def get_attributes_string(parameter_proto):
   attribute_strings = []
+  untrusted = has_pointer_attribute(parameter_proto, UNTRUSTED)
   for attribute_proto in parameter_proto.pointer_attributes:
     attribute = attribute_proto.attribute
+    # The size of an untrusted pointer is only checked in the trusted wrapper,
+    # since edger8r rejects a size on user_check pointers.
+    if untrusted and attribute == SIZE:
+      continue
     attribute_string = ATTRIBUTE_STRING_MAP[attribute]
     if attribute == SIZE:
       attribute_string += '=' + attribute_proto.attribute_expression
@@ -219,6 +337,117 @@ def comma_separate_arguments(parameters_proto):
   return comma_delimit_items(name_list)
 
 
+def has_pointer_attribute(parameter_proto, attribute):
+  return any(
+      p.attribute == attribute for p in parameter_proto.pointer_attributes)
+
+
+def untrusted_pointers(parameters_proto):
+  """Pointer parameters whose untrusted range is checked before a host call."""
+  return [
+      p for p in parameters_proto
+      if is_pointer_type(p.type) and has_pointer_attribute(p, UNTRUSTED)
+  ]
+
+
+def is_adaptive_switchless(host_call_proto):
+  """Whether a switchless host call chooses its path from the cost model."""
+  return (host_call_proto.switchless and
+          host_call_proto.switchless_policy == ADAPTIVE)
+
+
+def host_function(host_call_proto):
+  """The host function called by the generated ocall of a host call."""
+  return host_call_proto.host_function or host_call_proto.name
+
+
+def switchless_in_pointers(parameters_proto):
+  """Pointer parameters copied into the switchless request payload."""
+  return [
+      p for p in parameters_proto
+      if is_pointer_type(p.type) and has_pointer_attribute(p, IN)
+  ]
+
+
+def switchless_out_pointers(parameters_proto):
+  """Pointer parameters copied out of the switchless request payload."""
+  return [
+      p for p in parameters_proto
+      if is_pointer_type(p.type) and has_pointer_attribute(p, OUT)
+  ]
+
+
+def switchless_size_expression(parameter_proto):
+  """The trusted expression for the payload bytes of a pointer parameter."""
+  if has_pointer_attribute(parameter_proto, STRING):
+    return 'strlen(%s) + 1' % (parameter_proto.name)
+  for attribute_proto in parameter_proto.pointer_attributes:
+    if attribute_proto.attribute == SIZE:
+      return 'static_cast<size_t>(%s)' % (attribute_proto.attribute_expression)
+  raise ValueError('No size available for parameter "%s"!' %
+                   (parameter_proto.name))
+
+
+def marshalled_bytes_expression(parameters_proto):
+  """The trusted expression for the bytes a host call marshals to the host.
+
+  Used by host call instrumentation. Value parameters are counted by size, and
+  pointer parameters by the number of bytes copied across the boundary. Output
+  strings and user_check pointers are not counted, since their size is not
+  known before the call is made, nor are untrusted pointers, which are not
+  copied.
+
+  Args:
+    parameters_proto: the parameters of a host call.
+  """
+  terms = []
+  for parameter_proto in parameters_proto:
+    if not is_pointer_type(parameter_proto.type):
+      terms.append('sizeof(%s)' % (parameter_proto.name))
+    elif (has_pointer_attribute(parameter_proto, USER_CHECK) or
+          has_pointer_attribute(parameter_proto, UNTRUSTED)):
+      continue
+    elif has_pointer_attribute(parameter_proto, STRING):
+      if has_pointer_attribute(parameter_proto, IN):
+        terms.append('(%s ? strlen(%s) + 1 : 0)' %
+                     (parameter_proto.name, parameter_proto.name))
+    elif has_pointer_attribute(parameter_proto, SIZE):
+      terms.append('(%s ? %s : 0)' %
+                   (parameter_proto.name,
+                    switchless_size_expression(parameter_proto)))
+  if not terms:
+    return '0'
+  return ' + '.join(terms)
+
+
+def comma_separate_switchless_arguments(parameters_proto):
+  """Arguments to a host function, unpacked from a switchless request."""
+  name_list = [
+      p.name if is_pointer_type(p.type) else 'args.' + p.name
+      for p in parameters_proto
+  ]
+  return comma_delimit_items(name_list)
+
+
+def parse_errno_names(errno_edl):
+  """Returns the sorted, de-duplicated errno names listed in an EDL file.
+
+  Switchless host calls send an errno across the boundary as the 1-based
+  position of its name in the returned list.
+
+  Args:
+    errno_edl: the contents of an EDL file containing an errno_list block.
+
+  Raises:
+    ValueError: No errno_list block was found.
+  """
+  match = re.search(r'errno_list\s*{([^}]*)}', errno_edl)
+  if not match:
+    raise ValueError('No errno_list found in "%s"!' % (ERRNO_EDL_FILE))
+  names = re.findall(r'\b(E[A-Z0-9]+)\b', match.group(1))
+  return sorted(set(names))
+
+
 def read_input_file(file_name):
   file_path = os.path.join(CODEGEN_PATH, file_name)
   with open(file_path, 'r') as file:
@@ -233,6 +462,19 @@ def fill_template(dictionary, template_file_name):
       'comma_separate_bridge_parameters'] = comma_separate_bridge_parameters
   template.globals['comma_separate_parameters'] = comma_separate_parameters
   template.globals['comma_separate_arguments'] = comma_separate_arguments
+  template.globals['comma_separate_switchless_arguments'] = (
+      comma_separate_switchless_arguments)
+  template.globals['is_pointer_type'] = is_pointer_type
+  template.globals['has_string_attribute'] = (
+      lambda parameter: has_pointer_attribute(parameter, STRING))
+  template.globals['untrusted_pointers'] = untrusted_pointers
+  template.globals['host_function'] = host_function
+  template.globals['is_adaptive_switchless'] = is_adaptive_switchless
+  template.globals['switchless_in_pointers'] = switchless_in_pointers
+  template.globals['switchless_out_pointers'] = switchless_out_pointers
+  template.globals['switchless_size_expression'] = switchless_size_expression
+  template.globals['marshalled_bytes_expression'] = marshalled_bytes_expression
+  template.globals['native_field'] = native_field
   return template.render(dictionary)
 
 
@@ -242,11 +484,39 @@ def write_output_file(contents, output_file_name):
     f.write(contents)
 
 
-def get_host_calls_dictionary(host_calls_textproto):
+def get_host_calls_dictionary(host_calls_textproto, errno_edl='',
+                              instrument=False):
   host_calls_proto = text_format.Parse(host_calls_textproto,
                                        host_calls_pb2.HostCallsProto())
   validate_host_calls_proto(host_calls_proto)
-  return {'host_calls': host_calls_proto.host_calls}
+  dictionary = {
+      'host_calls':
+          host_calls_proto.host_calls,
+      'marshalled_host_calls': [
+          host_call for host_call in host_calls_proto.host_calls
+          if is_marshallable_host_call(host_call)
+      ],
+      'errno_names': [],
+      'instrument': instrument,
+  }
+  if errno_edl or any(
+      host_call.switchless for host_call in host_calls_proto.host_calls):
+    dictionary['errno_names'] = parse_errno_names(errno_edl)
+  return dictionary
+
+
+def get_bridge_structs_dictionary(bridge_structs_textproto):
+  bridge_structs_proto = text_format.Parse(
+      bridge_structs_textproto, host_calls_pb2.BridgeStructsProto())
+  validate_bridge_structs_proto(bridge_structs_proto)
+  return {
+      'bridge_structs':
+          bridge_structs_proto.bridge_structs,
+      'native_headers':
+          sorted(
+              set(s.native_header
+                  for s in bridge_structs_proto.bridge_structs)),
+  }
 
 
 def main(unused_argv):
@@ -255,15 +525,29 @@ def main(unused_argv):
                        'files (use --output_dir).')
 
   host_calls_textproto = read_input_file(HOST_CALLS_TEXTPROTO_FILE)
-  host_calls_dictionary = get_host_calls_dictionary(host_calls_textproto)
+  errno_edl = read_input_file(ERRNO_EDL_FILE)
+  host_calls_dictionary = get_host_calls_dictionary(
+      host_calls_textproto, errno_edl, FLAGS.instrument_host_calls)
 
   bridge_edl = fill_template(host_calls_dictionary, BRIDGE_EDL_TEMPLATE)
   host_calls = fill_template(host_calls_dictionary, HOST_CALLS_TEMPLATE)
   ocalls = fill_template(host_calls_dictionary, OCALLS_TEMPLATE)
+  host_call_batch = fill_template(host_calls_dictionary,
+                                  HOST_CALL_BATCH_TEMPLATE)
 
   write_output_file(bridge_edl, BRIDGE_EDL_FILE)
   write_output_file(host_calls, HOST_CALLS_FILE)
   write_output_file(ocalls, OCALLS_FILE)
+  write_output_file(host_call_batch, HOST_CALL_BATCH_FILE)
+
+  bridge_structs_dictionary = get_bridge_structs_dictionary(
+      read_input_file(BRIDGE_STRUCTS_TEXTPROTO_FILE))
+  bridge_structs_header = fill_template(bridge_structs_dictionary,
+                                        BRIDGE_STRUCTS_HEADER_TEMPLATE)
+  bridge_structs = fill_template(bridge_structs_dictionary,
+                                 BRIDGE_STRUCTS_TEMPLATE)
+  write_output_file(bridge_structs_header, BRIDGE_STRUCTS_HEADER_FILE)
+  write_output_file(bridge_structs, BRIDGE_STRUCTS_FILE)
 
 
 if __name__ == '__main__':
@@ -172,6 +172,250 @@ class CodeGeneratorTest(TestCase):
     with self.assertRaises(ValueError):
       code_generator.get_host_calls_dictionary(textproto)
 
+  def test_switchless_host_call_arguments(self):
+    textproto = ('host_calls { name: "write" return_type: "int32_t" '
+                 'parameters { name: "fd" type: "int" } '
+                 'parameters { name: "buf" type: "const void *" '
+                 'pointer_attributes { attribute: IN } '
+                 'pointer_attributes { attribute: SIZE '
+                 'attribute_expression: "len" }} '
+                 'parameters { name: "len" type: "size_t" } '
+                 'switchless: true }')
+    host_calls = code_generator.get_host_calls_dictionary(
+        textproto, 'enclave { errno_list { EBADF, EAGAIN, EBADF }};')
+    write_parameters = _get_parameters_proto(host_calls)
+    self.assertEqual(['EAGAIN', 'EBADF'], host_calls['errno_names'])
+    self.assertEqual(
+        'args.fd, buf, args.len',
+        code_generator.comma_separate_switchless_arguments(write_parameters))
+    self.assertEqual(
+        'static_cast<size_t>(len)',
+        code_generator.switchless_size_expression(write_parameters[1]))
+    self.assertEqual(
+        ['buf'],
+        [p.name for p in code_generator.switchless_in_pointers(
+            write_parameters)])
+    self.assertEqual([],
+                     code_generator.switchless_out_pointers(write_parameters))
+
+  def test_marshalled_host_calls(self):
+    textproto = ('host_calls { name: "fsync" return_type: "int" '
+                 'parameters { name: "fd" type: "int" }} '
+                 'host_calls { name: "free" return_type: "void" '
+                 'parameters { name: "ptr" type: "void *" '
+                 'pointer_attributes { attribute: USER_CHECK }}} '
+                 'host_calls { name: "getpid" return_type: "pid_t" }')
+    host_calls = code_generator.get_host_calls_dictionary(textproto)
+    self.assertEqual(
+        ['fsync', 'getpid'],
+        [h.name for h in host_calls['marshalled_host_calls']])
+
+  def test_marshalled_bytes_expression(self):
+    textproto = ('host_calls { name: "readlink" return_type: "ssize_t" '
+                 'parameters { name: "path" type: "const char *" '
+                 'pointer_attributes { attribute: IN } '
+                 'pointer_attributes { attribute: STRING }} '
+                 'parameters { name: "buf" type: "char *" '
+                 'pointer_attributes { attribute: OUT } '
+                 'pointer_attributes { attribute: SIZE '
+                 'attribute_expression: "bufsize" }} '
+                 'parameters { name: "bufsize" type: "size_t" }} '
+                 'host_calls { name: "free" return_type: "void" '
+                 'parameters { name: "ptr" type: "void *" '
+                 'pointer_attributes { attribute: USER_CHECK }}}')
+    host_calls = code_generator.get_host_calls_dictionary(
+        textproto, instrument=True)
+    self.assertTrue(host_calls['instrument'])
+    self.assertEqual(
+        '(path ? strlen(path) + 1 : 0) + '
+        '(buf ? static_cast<size_t>(bufsize) : 0) + sizeof(bufsize)',
+        code_generator.marshalled_bytes_expression(
+            host_calls['host_calls'][0].parameters))
+    self.assertEqual(
+        '0',
+        code_generator.marshalled_bytes_expression(
+            host_calls['host_calls'][1].parameters))
+
+  def test_untrusted_pointer_parameter(self):
+    textproto = ('host_calls { name: "read_with_untrusted_ptr" '
+                 'host_function: "read" return_type: "bridge_ssize_t" '
+                 'parameters { name: "fd" type: "int" } '
+                 'parameters { name: "buf" type: "void *" '
+                 'pointer_attributes { attribute: UNTRUSTED } '
+                 'pointer_attributes { attribute: SIZE '
+                 'attribute_expression: "size" }} '
+                 'parameters { name: "size" type: "bridge_size_t" }}')
+    host_calls = code_generator.get_host_calls_dictionary(textproto)
+    host_call = host_calls['host_calls'][0]
+    self.assertEqual(
+        'int fd, [user_check] void * buf, bridge_size_t size',
+        code_generator.comma_separate_bridge_parameters(host_call.parameters))
+    self.assertEqual(
+        ['buf'],
+        [p.name for p in code_generator.untrusted_pointers(
+            host_call.parameters)])
+    self.assertEqual('read', code_generator.host_function(host_call))
+    self.assertEqual(
+        'sizeof(fd) + sizeof(size)',
+        code_generator.marshalled_bytes_expression(host_call.parameters))
+    self.assertEqual([], host_calls['marshalled_host_calls'])
+
+  def test_untrusted_pointer_missing_size(self):
+    textproto = ('host_calls { name: "free" return_type: "void" '
+                 'parameters { name: "ptr" type: "void *" '
+                 'pointer_attributes { attribute: UNTRUSTED }}}')
+    with self.assertRaises(ValueError):
+      code_generator.get_host_calls_dictionary(textproto)
+
+  def test_untrusted_pointer_conflicting_copy_attributes(self):
+    textproto = ('host_calls { name: "write" return_type: "int" '
+                 'parameters { name: "buf" type: "const void *" '
+                 'pointer_attributes { attribute: IN } '
+                 'pointer_attributes { attribute: UNTRUSTED } '
+                 'pointer_attributes { attribute: SIZE '
+                 'attribute_expression: "len" }} '
+                 'parameters { name: "len" type: "size_t" }}')
+    with self.assertRaises(ValueError):
+      code_generator.get_host_calls_dictionary(textproto)
+
+  def test_switchless_host_call_untrusted_parameter(self):
+    textproto = ('host_calls { name: "write" return_type: "int" '
+                 'parameters { name: "buf" type: "const void *" '
+                 'pointer_attributes { attribute: UNTRUSTED } '
+                 'pointer_attributes { attribute: SIZE '
+                 'attribute_expression: "len" }} '
+                 'parameters { name: "len" type: "size_t" } '
+                 'switchless: true }')
+    with self.assertRaises(ValueError):
+      code_generator.get_host_calls_dictionary(textproto)
+
+  def test_switchless_host_call_policy(self):
+    textproto = ('host_calls { name: "lseek" return_type: "int64_t" '
+                 'parameters { name: "fd" type: "int" } switchless: true } '
+                 'host_calls { name: "read" return_type: "int32_t" '
+                 'parameters { name: "fd" type: "int" } switchless: true '
+                 'switchless_policy: ADAPTIVE } '
+                 'host_calls { name: "fsync" return_type: "int" '
+                 'parameters { name: "fd" type: "int" }}')
+    host_calls = code_generator.get_host_calls_dictionary(
+        textproto, 'enclave { errno_list { EBADF }};')
+    self.assertEqual(
+        [False, True, False],
+        [code_generator.is_adaptive_switchless(h)
+         for h in host_calls['host_calls']])
+
+  def test_switchless_policy_without_switchless(self):
+    textproto = ('host_calls { name: "fsync" return_type: "int" '
+                 'parameters { name: "fd" type: "int" } '
+                 'switchless_policy: ADAPTIVE }')
+    with self.assertRaises(ValueError):
+      code_generator.get_host_calls_dictionary(textproto)
+
+  def test_switchless_host_call_string_size(self):
+    textproto = ('host_calls { name: "unlink" return_type: "int" '
+                 'parameters { name: "path" type: "const char *" '
+                 'pointer_attributes { attribute: IN } '
+                 'pointer_attributes { attribute: STRING }} '
+                 'switchless: true }')
+    host_calls = code_generator.get_host_calls_dictionary(
+        textproto, 'enclave { errno_list { ENOENT }};')
+    unlink_parameters = _get_parameters_proto(host_calls)
+    self.assertEqual(
+        'strlen(path) + 1',
+        code_generator.switchless_size_expression(unlink_parameters[0]))
+
+  def test_switchless_host_call_missing_errno_list(self):
+    textproto = ('host_calls { name: "fsync" return_type: "int" '
+                 'parameters { name: "fd" type: "int" } switchless: true }')
+    with self.assertRaises(ValueError):
+      code_generator.get_host_calls_dictionary(textproto, 'enclave {};')
+
+  def test_switchless_host_call_pointer_return(self):
+    textproto = ('host_calls { name: "malloc" return_type: "void *" '
+                 'parameters { name: "size" type: "size_t" } '
+                 'switchless: true }')
+    with self.assertRaises(ValueError):
+      code_generator.get_host_calls_dictionary(textproto)
+
+  def test_switchless_host_call_user_check_parameter(self):
+    textproto = ('host_calls { name: "free" return_type: "int" '
+                 'parameters { name: "ptr" type: "void *" '
+                 'pointer_attributes { attribute: USER_CHECK }} '
+                 'switchless: true }')
+    with self.assertRaises(ValueError):
+      code_generator.get_host_calls_dictionary(textproto)
+
+  def test_switchless_host_call_output_string(self):
+    textproto = ('host_calls { name: "getcwd" return_type: "int" '
+                 'parameters { name: "buf" type: "char *" '
+                 'pointer_attributes { attribute: OUT } '
+                 'pointer_attributes { attribute: STRING }} '
+                 'switchless: true }')
+    with self.assertRaises(ValueError):
+      code_generator.get_host_calls_dictionary(textproto)
+
+  def test_switchless_host_call_unsized_pointer(self):
+    textproto = ('host_calls { name: "stat" return_type: "int" '
+                 'parameters { name: "buf" type: "void *" '
+                 'pointer_attributes { attribute: OUT }} '
+                 'switchless: true }')
+    with self.assertRaises(ValueError):
+      code_generator.get_host_calls_dictionary(textproto)
+
+  def test_bridge_structs(self):
+    textproto = ('bridge_structs { name: "EpollEvent" '
+                 'native_type: "struct epoll_event" '
+                 'bridge_type: "struct bridge_epoll_event" '
+                 'native_header: "sys/epoll.h" '
+                 'fields { name: "events" } '
+                 'fields { name: "data" native_name: "data.u64" } '
+                 'identical_layout: true } '
+                 'bridge_structs { name: "Pollfd" '
+                 'native_type: "struct pollfd" '
+                 'bridge_type: "struct bridge_pollfd" '
+                 'native_header: "poll.h" '
+                 'fields { name: "fd" } } '
+                 'bridge_structs { name: "EpollData" '
+                 'native_type: "epoll_data_t" '
+                 'bridge_type: "uint64_t" '
+                 'native_header: "sys/epoll.h" '
+                 'fields { name: "u64" } }')
+    bridge_structs = code_generator.get_bridge_structs_dictionary(textproto)
+    self.assertEqual(['poll.h', 'sys/epoll.h'],
+                     bridge_structs['native_headers'])
+    fields = bridge_structs['bridge_structs'][0].fields
+    self.assertEqual('events', code_generator.native_field(fields[0]))
+    self.assertEqual('data.u64', code_generator.native_field(fields[1]))
+
+  def test_bridge_struct_missing_fields(self):
+    textproto = ('bridge_structs { name: "Pollfd" '
+                 'native_type: "struct pollfd" '
+                 'bridge_type: "struct bridge_pollfd" '
+                 'native_header: "poll.h" }')
+    with self.assertRaises(ValueError):
+      code_generator.get_bridge_structs_dictionary(textproto)
+
+  def test_bridge_struct_duplicate_fields(self):
+    textproto = ('bridge_structs { name: "Pollfd" '
+                 'native_type: "struct pollfd" '
+                 'bridge_type: "struct bridge_pollfd" '
+                 'native_header: "poll.h" '
+                 'fields { name: "fd" } fields { name: "fd" } }')
+    with self.assertRaises(ValueError):
+      code_generator.get_bridge_structs_dictionary(textproto)
+
+  def test_bridge_struct_duplicate_names(self):
+    textproto = ('bridge_structs { name: "Pollfd" '
+                 'native_type: "struct pollfd" '
+                 'bridge_type: "struct bridge_pollfd" '
+                 'native_header: "poll.h" fields { name: "fd" } } '
+                 'bridge_structs { name: "Pollfd" '
+                 'native_type: "struct pollfd" '
+                 'bridge_type: "struct bridge_pollfd" '
+                 'native_header: "poll.h" fields { name: "fd" } }')
+    with self.assertRaises(ValueError):
+      code_generator.get_bridge_structs_dictionary(textproto)
+
 
 if __name__ == '__main__':
   main()
@@ -0,0 +1,238 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/arch/sgx/transition_benchmark.h"
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "asylo/platform/storage/utils/fd_closer.h"
+#include "asylo/util/status_macros.h"
+
+#ifdef __ASYLO__
+#include "asylo/platform/arch/include/trusted/host_calls.h"
+#endif  // __ASYLO__
+
+namespace asylo {
+namespace {
+
+using platform::storage::FdCloser;
+
+constexpr int64_t kNanosecondsPerSecond = 1000000000;
+
+// Upper bound on the number of operations run between two clock reads, so
+// that slow operations do not overshoot the requested duration by much.
+constexpr int64_t kMaxBatch = 1 << 16;
+
+int64_t MonotonicNanoseconds() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return static_cast<int64_t>(ts.tv_sec) * kNanosecondsPerSecond + ts.tv_nsec;
+}
+
+Status FailedStatus(const std::string &operation) {
+  return Status(error::GoogleError::INTERNAL,
+                absl::StrCat(operation, " failed"));
+}
+
+pid_t HostGetpid() {
+#ifdef __ASYLO__
+  return enc_untrusted_getpid();
+#else
+  return getpid();
+#endif  // __ASYLO__
+}
+
+// Opens and closes a file on the host directly, bypassing the enclave's file
+// descriptor table.
+int HostOpen(const char *path, int flags) {
+#ifdef __ASYLO__
+  return enc_untrusted_open(path, flags);
+#else
+  return open(path, flags);
+#endif  // __ASYLO__
+}
+
+int HostClose(int fd) {
+#ifdef __ASYLO__
+  return enc_untrusted_close(fd);
+#else
+  return close(fd);
+#endif  // __ASYLO__
+}
+
+ssize_t HostWrite(int fd, const void *buf, size_t count) {
+#ifdef __ASYLO__
+  return enc_untrusted_write(fd, buf, count);
+#else
+  return write(fd, buf, count);
+#endif  // __ASYLO__
+}
+
+void *EmptyThread(void *arg) { return arg; }
+
+Status BenchmarkFile(const TransitionBenchmarkInput &input,
+                     TransitionBenchmarkOutput *output) {
+  bool is_read = input.operation() == TransitionBenchmarkInput::READ;
+  int fd = open(is_read ? "/dev/zero" : "/dev/null",
+                is_read ? O_RDONLY : O_WRONLY);
+  if (fd < 0) {
+    return FailedStatus("open");
+  }
+  FdCloser closer(fd);
+  std::vector<char> buffer(input.payload_size());
+  if (is_read) {
+    return MeasureTransitions(
+        input,
+        [fd, &buffer] {
+          return read(fd, buffer.data(), buffer.size()) ==
+                         static_cast<ssize_t>(buffer.size())
+                     ? Status::OkStatus()
+                     : FailedStatus("read");
+        },
+        output);
+  }
+  return MeasureTransitions(
+      input,
+      [fd, &buffer] {
+        return write(fd, buffer.data(), buffer.size()) ==
+                       static_cast<ssize_t>(buffer.size())
+                   ? Status::OkStatus()
+                   : FailedStatus("write");
+      },
+      output);
+}
+
+Status BenchmarkHostWrite(const TransitionBenchmarkInput &input,
+                          TransitionBenchmarkOutput *output) {
+  int fd = HostOpen("/dev/null", O_WRONLY);
+  if (fd < 0) {
+    return FailedStatus("open");
+  }
+  FdCloser closer(fd, HostClose);
+  std::vector<char> buffer(input.payload_size());
+  return MeasureTransitions(
+      input,
+      [fd, &buffer] {
+        return HostWrite(fd, buffer.data(), buffer.size()) ==
+                       static_cast<ssize_t>(buffer.size())
+                   ? Status::OkStatus()
+                   : FailedStatus("write");
+      },
+      output);
+}
+
+}  // namespace
+
+bool IsEnclaveCall(TransitionBenchmarkInput::Operation operation) {
+  return operation == TransitionBenchmarkInput::ECALL_RUN ||
+         operation == TransitionBenchmarkInput::ECALL_RUN_RAW ||
+         operation == TransitionBenchmarkInput::ECALL_RUN_BATCH;
+}
+
+// The clock is read once per batch of operations, and batches grow
+// geometrically, so clock reads do not dominate the measurement of fast
+// operations.
+Status MeasureTransitions(const TransitionBenchmarkInput &input,
+                          const std::function<Status()> &operation,
+                          TransitionBenchmarkOutput *output) {
+  for (int i = 0; i < input.warmup_ops(); ++i) {
+    ASYLO_RETURN_IF_ERROR(operation());
+  }
+
+  int64_t ops = 0;
+  int64_t batch = 1;
+  int64_t start = MonotonicNanoseconds();
+  int64_t elapsed = 0;
+  do {
+    for (int64_t i = 0; i < batch; ++i) {
+      ASYLO_RETURN_IF_ERROR(operation());
+    }
+    ops += batch;
+    batch = std::min(batch * 2, kMaxBatch);
+    elapsed = MonotonicNanoseconds() - start;
+  } while (elapsed < input.min_duration_ns());
+
+  output->set_ops(ops);
+  output->set_elapsed_ns(elapsed);
+  output->set_ops_per_second(
+      elapsed > 0 ? static_cast<double>(ops) * kNanosecondsPerSecond / elapsed
+                  : 0.0);
+  return Status::OkStatus();
+}
+
+Status RunTransitionBenchmark(const TransitionBenchmarkInput &input,
+                              TransitionBenchmarkOutput *output) {
+  if (input.payload_size() < 0 || input.min_duration_ns() < 0 ||
+      input.warmup_ops() < 0) {
+    return Status(error::GoogleError::INVALID_ARGUMENT,
+                  "Benchmark parameters must not be negative");
+  }
+
+  switch (input.operation()) {
+    case TransitionBenchmarkInput::OCALL_GETPID:
+      return MeasureTransitions(
+          input,
+          [] {
+            return HostGetpid() > 0 ? Status::OkStatus()
+                                    : FailedStatus("getpid");
+          },
+          output);
+    case TransitionBenchmarkInput::OCALL_WRITE:
+      return BenchmarkHostWrite(input, output);
+    case TransitionBenchmarkInput::THREAD_CREATE_JOIN:
+      return MeasureTransitions(
+          input,
+          [] {
+            pthread_t thread;
+            if (pthread_create(&thread, nullptr, EmptyThread, nullptr) != 0) {
+              return FailedStatus("pthread_create");
+            }
+            return pthread_join(thread, nullptr) == 0
+                       ? Status::OkStatus()
+                       : FailedStatus("pthread_join");
+          },
+          output);
+    case TransitionBenchmarkInput::CLOCK_GETTIME:
+      return MeasureTransitions(
+          input,
+          [] {
+            struct timespec ts;
+            return clock_gettime(CLOCK_MONOTONIC, &ts) == 0
+                       ? Status::OkStatus()
+                       : FailedStatus("clock_gettime");
+          },
+          output);
+    case TransitionBenchmarkInput::READ:
+    case TransitionBenchmarkInput::WRITE:
+      return BenchmarkFile(input, output);
+    default:
+      return Status(error::GoogleError::INVALID_ARGUMENT,
+                    absl::StrCat("Unsupported operation: ", input.operation()));
+  }
+}
+
+}  // namespace asylo
@@ -0,0 +1,48 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_PLATFORM_ARCH_SGX_TRANSITION_BENCHMARK_H_
+#define ASYLO_PLATFORM_ARCH_SGX_TRANSITION_BENCHMARK_H_
+
+#include <functional>
+
+#include "asylo/platform/arch/sgx/transition_benchmark.pb.h"
+#include "asylo/util/status.h"
+
+namespace asylo {
+
+// Returns true if |operation| enters the enclave, and so is run by the host.
+bool IsEnclaveCall(TransitionBenchmarkInput::Operation operation);
+
+// Performs |input.warmup_ops()| unmeasured calls to |operation|, and then
+// repeats it until at least |input.min_duration_ns()| have elapsed. The number
+// of operations and the elapsed time are stored in |output|.
+Status MeasureTransitions(const TransitionBenchmarkInput &input,
+                          const std::function<Status()> &operation,
+                          TransitionBenchmarkOutput *output);
+
+// Measures the operation named by |input.operation()|, which must not be an
+// enclave call, with a payload of |input.payload_size()| bytes. Inside an
+// enclave, host calls leave the enclave; natively, they are the corresponding
+// system calls, so that the two columns of a comparison measure the same work.
+Status RunTransitionBenchmark(const TransitionBenchmarkInput &input,
+                              TransitionBenchmarkOutput *output);
+
+}  // namespace asylo
+
+#endif  // ASYLO_PLATFORM_ARCH_SGX_TRANSITION_BENCHMARK_H_
@@ -0,0 +1,260 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+// Measures the raw cost of crossing the enclave boundary: ecalls through
+// EnterAndRun and EnterAndRunRaw, host calls, thread creation, which donates a
+// host thread through ecall_donate_thread, and the common POSIX wrappers.
+// Operations run from inside the enclave are also run natively with the same
+// code, so the two columns separate the cost of the transitions from that of
+// the work. Whether the enclave runs in hardware or simulation mode is decided
+// when it is built; pass --enclave_label to tell the two apart in the report.
+
+#include <stdio.h>
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "absl/strings/ascii.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_split.h"
+#include "asylo/benchmarks/benchmark_report.h"
+#include "asylo/client.h"
+#include "asylo/platform/arch/sgx/transition_benchmark.h"
+#include "asylo/platform/arch/sgx/transition_benchmark.pb.h"
+#include "asylo/util/logging.h"
+#include "gflags/gflags.h"
+
+DEFINE_string(enclave_path, "", "Path to the benchmark enclave");
+DEFINE_string(operations,
+              "ecall_run,ecall_run_raw,ecall_run_batch,ocall_getpid,"
+              "ocall_write,thread_create_join,clock_gettime,read,write",
+              "Comma-separated operations to measure, named as in "
+              "TransitionBenchmarkInput::Operation");
+DEFINE_string(payload_sizes, "0,64,4096",
+              "Comma-separated payload sizes in bytes");
+DEFINE_string(modes, "native,enclave",
+              "Comma-separated locations: native and enclave");
+DEFINE_string(enclave_label, "enclave",
+              "Name reported for the enclave mode, e.g. sim or hw");
+DEFINE_int64(min_duration_ms, 200, "Minimum measured time per run");
+DEFINE_int32(warmup_ops, 10, "Unmeasured operations per run");
+DEFINE_int32(batch_size, 16, "Inputs per enclave entry of ecall_run_batch");
+DEFINE_string(json_output, "", "File to also write the results to as JSON");
+DEFINE_int64(sim_enter_ns, 0,
+             "Nanoseconds added to each enclave entry of a simulated enclave");
+DEFINE_int64(sim_exit_ns, 0,
+             "Nanoseconds added to each enclave exit of a simulated enclave");
+
+namespace asylo {
+namespace {
+
+constexpr char kEnclaveName[] = "transition_benchmark";
+constexpr int64_t kNanosecondsPerMillisecond = 1000000;
+
+// Returns true if the cost of |operation| depends on the payload size. Other
+// operations are measured once.
+bool IsSized(TransitionBenchmarkInput::Operation operation) {
+  return operation != TransitionBenchmarkInput::OCALL_GETPID &&
+         operation != TransitionBenchmarkInput::THREAD_CREATE_JOIN &&
+         operation != TransitionBenchmarkInput::CLOCK_GETTIME;
+}
+
+// Measures the enclave call described by |input| on |client|.
+Status MeasureEnclaveCall(EnclaveClient *client,
+                          const TransitionBenchmarkInput &input,
+                          TransitionBenchmarkOutput *output) {
+  std::string payload(input.payload_size(), 'x');
+  if (input.operation() == TransitionBenchmarkInput::ECALL_RUN_RAW) {
+    std::string raw_output;
+    return MeasureTransitions(
+        input,
+        [client, &payload, &raw_output] {
+          raw_output.clear();
+          return client->EnterAndRunRaw(payload, &raw_output);
+        },
+        output);
+  }
+  EnclaveInput enclave_input;
+  TransitionBenchmarkInput *run_input =
+      enclave_input.MutableExtension(transition_benchmark_input);
+  *run_input = input;
+  run_input->set_payload(payload);
+  if (input.operation() == TransitionBenchmarkInput::ECALL_RUN_BATCH) {
+    std::vector<EnclaveInput> inputs(input.batch_size(), enclave_input);
+    std::vector<EnclaveOutput> outputs;
+    Status status = MeasureTransitions(
+        input,
+        [client, &inputs, &outputs] {
+          return client->EnterAndRunBatch(inputs, &outputs);
+        },
+        output);
+    // Report the rate of inputs, to compare with ECALL_RUN.
+    output->set_ops(output->ops() * input.batch_size());
+    output->set_ops_per_second(output->ops_per_second() * input.batch_size());
+    return status;
+  }
+  EnclaveOutput enclave_output;
+  return MeasureTransitions(
+      input,
+      [client, &enclave_input, &enclave_output] {
+        return client->EnterAndRun(enclave_input, &enclave_output);
+      },
+      output);
+}
+
+}  // namespace
+}  // namespace asylo
+
+int main(int argc, char *argv[]) {
+  ::google::ParseCommandLineFlags(&argc, &argv, /*remove_flags=*/true);
+
+  std::vector<asylo::TransitionBenchmarkInput::Operation> operations;
+  for (const auto &name : absl::StrSplit(FLAGS_operations, ',')) {
+    asylo::TransitionBenchmarkInput::Operation operation;
+    if (!asylo::TransitionBenchmarkInput::Operation_Parse(
+            absl::AsciiStrToUpper(name), &operation) ||
+        operation == asylo::TransitionBenchmarkInput::UNKNOWN) {
+      LOG(QFATAL) << "Unknown operation: " << name;
+    }
+    operations.push_back(operation);
+  }
+  std::vector<int64_t> payload_sizes;
+  for (const auto &size : absl::StrSplit(FLAGS_payload_sizes, ',')) {
+    int64_t value;
+    if (!absl::SimpleAtoi(size, &value) || value < 0) {
+      LOG(QFATAL) << "Invalid payload size: " << size;
+    }
+    payload_sizes.push_back(value);
+  }
+  if (FLAGS_batch_size <= 0) {
+    LOG(QFATAL) << "Invalid batch size: " << FLAGS_batch_size;
+  }
+  std::vector<std::string> modes = absl::StrSplit(FLAGS_modes, ',');
+
+  asylo::EnclaveClient *client = nullptr;
+  asylo::EnclaveManager *manager = nullptr;
+  for (const auto &mode : modes) {
+    if (mode == "enclave") {
+      asylo::EnclaveManager::Configure(asylo::EnclaveManagerOptions());
+      auto manager_result = asylo::EnclaveManager::Instance();
+      if (!manager_result.ok()) {
+        LOG(QFATAL) << "EnclaveManager unavailable: "
+                    << manager_result.status();
+      }
+      manager = manager_result.ValueOrDie();
+      asylo::EnclaveConfig config;
+      if (FLAGS_sim_enter_ns > 0 || FLAGS_sim_exit_ns > 0) {
+        asylo::SimTransitionProfile *profile =
+            config.mutable_sim_transition_profile();
+        profile->set_enter_ns(FLAGS_sim_enter_ns);
+        profile->set_exit_ns(FLAGS_sim_exit_ns);
+      }
+      asylo::SGXLoader loader(FLAGS_enclave_path, /*debug=*/true);
+      asylo::Status status =
+          manager->LoadEnclave(asylo::kEnclaveName, loader, config);
+      if (!status.ok()) {
+        LOG(QFATAL) << "Load " << FLAGS_enclave_path << " failed: " << status;
+      }
+      client = manager->GetClient(asylo::kEnclaveName);
+    } else if (mode != "native") {
+      LOG(QFATAL) << "Unknown mode: " << mode;
+    }
+  }
+
+  asylo::BenchmarkRecorder recorder("transition");
+  printf("%-20s %-10s %8s %12s %12s\n", "operation", "mode", "bytes", "ops/s",
+         "ns/op");
+  for (asylo::TransitionBenchmarkInput::Operation operation : operations) {
+    std::vector<int64_t> run_payload_sizes = payload_sizes;
+    if (!asylo::IsSized(operation)) {
+      run_payload_sizes = {0};
+    }
+    for (int64_t payload_size : run_payload_sizes) {
+      for (const auto &mode : modes) {
+        bool is_enclave_call = asylo::IsEnclaveCall(operation);
+        if (mode == "native" && is_enclave_call) {
+          continue;
+        }
+        asylo::TransitionBenchmarkInput input;
+        input.set_operation(operation);
+        input.set_payload_size(payload_size);
+        input.set_min_duration_ns(FLAGS_min_duration_ms *
+                                  asylo::kNanosecondsPerMillisecond);
+        input.set_warmup_ops(FLAGS_warmup_ops);
+        input.set_batch_size(FLAGS_batch_size);
+
+        asylo::TransitionBenchmarkOutput result;
+        asylo::Status status;
+        if (mode == "native") {
+          status = asylo::RunTransitionBenchmark(input, &result);
+        } else if (is_enclave_call) {
+          status = asylo::MeasureEnclaveCall(client, input, &result);
+        } else {
+          asylo::EnclaveInput enclave_input;
+          *enclave_input.MutableExtension(
+              asylo::transition_benchmark_input) = input;
+          asylo::EnclaveOutput enclave_output;
+          status = client->EnterAndRun(enclave_input, &enclave_output);
+          result = enclave_output.GetExtension(
+              asylo::transition_benchmark_output);
+        }
+        if (!status.ok()) {
+          LOG(QFATAL) << "Benchmark run failed: " << status;
+        }
+
+        double ns_per_op =
+            result.ops() > 0
+                ? static_cast<double>(result.elapsed_ns()) / result.ops()
+                : 0.0;
+        printf("%-20s %-10s %8lld %12.0f %12.1f\n",
+               asylo::TransitionBenchmarkInput::Operation_Name(operation)
+                   .c_str(),
+               mode == "native" ? "native" : FLAGS_enclave_label.c_str(),
+               static_cast<long long>(payload_size), result.ops_per_second(),
+               ns_per_op);
+
+        asylo::BenchmarkResult *recorded = recorder.AddResult(
+            {{"operation",
+              asylo::TransitionBenchmarkInput::Operation_Name(operation)},
+             {"mode", mode == "native" ? "native" : FLAGS_enclave_label},
+             {"bytes", absl::StrCat(payload_size)}});
+        asylo::AddMetric("ops/s", result.ops_per_second(),
+                         asylo::BenchmarkMetric::HIGHER_IS_BETTER, recorded);
+        asylo::AddMetric("ns/op", ns_per_op,
+                         asylo::BenchmarkMetric::LOWER_IS_BETTER, recorded);
+      }
+    }
+  }
+
+  if (client) {
+    asylo::EnclaveFinal final_input;
+    asylo::Status status = manager->DestroyEnclave(client, final_input);
+    if (!status.ok()) {
+      LOG(QFATAL) << "Destroy " << FLAGS_enclave_path << " failed: " << status;
+    }
+  }
+
+  asylo::Status status = recorder.WriteJson(FLAGS_json_output);
+  if (!status.ok()) {
+    LOG(QFATAL) << status;
+  }
+  return 0;
+}
@@ -0,0 +1,60 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <string>
+
+#include "asylo/crypto/util/byte_container_view.h"
+#include "asylo/platform/arch/sgx/transition_benchmark.h"
+#include "asylo/platform/arch/sgx/transition_benchmark.pb.h"
+#include "asylo/trusted_application.h"
+#include "asylo/util/status.h"
+
+namespace asylo {
+
+// Runs the transition microbenchmark inside the enclave with parameters chosen
+// by the driver. Enclave calls measured by the driver return immediately.
+class TransitionBenchmarkApplication : public TrustedApplication {
+ public:
+  Status Run(const EnclaveInput &input, EnclaveOutput *output) override {
+    if (!input.HasExtension(transition_benchmark_input)) {
+      return Status(error::GoogleError::INVALID_ARGUMENT,
+                    "Missing transition benchmark input");
+    }
+    const TransitionBenchmarkInput &benchmark_input =
+        input.GetExtension(transition_benchmark_input);
+    if (IsEnclaveCall(benchmark_input.operation())) {
+      return Status::OkStatus();
+    }
+    TransitionBenchmarkOutput result;
+    Status status = RunTransitionBenchmark(benchmark_input, &result);
+    if (status.ok() && output) {
+      *output->MutableExtension(transition_benchmark_output) = result;
+    }
+    return status;
+  }
+
+  Status RunRaw(ByteContainerView input, std::string *output) override {
+    return Status::OkStatus();
+  }
+};
+
+TrustedApplication *BuildTrustedApplication() {
+  return new TransitionBenchmarkApplication;
+}
+
+}  // namespace asylo
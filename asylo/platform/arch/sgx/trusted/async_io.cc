@@ -0,0 +1,249 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/arch/include/trusted/async_io.h"
+
+#include <errno.h>
+#include <string.h>
+
+#include <array>
+#include <atomic>
+#include <string>
+
+#include "asylo/platform/arch/include/trusted/enclave_interface.h"
+#include "asylo/platform/arch/include/trusted/host_calls.h"
+#include "asylo/platform/arch/sgx/trusted/bridge_errno.h"
+#include "asylo/platform/common/async_io_queue.h"
+#include "asylo/platform/common/boundary_copy.h"
+#include "asylo/platform/common/spin_lock.h"
+
+namespace asylo {
+namespace {
+
+// Trusted record of a request slot. Everything needed to complete a request is
+// kept here rather than read back from untrusted memory.
+struct AsyncIoSlot {
+  // Whether the slot is owned by an in-flight request.
+  std::atomic<bool> in_use{false};
+
+  // Operation, caller buffer and expected transfer size of the request.
+  int opcode = 0;
+  void *buf = nullptr;
+  size_t count = 0;
+  uint64_t user_data = 0;
+};
+
+// The queue shared with the host, or nullptr if asynchronous I/O is disabled.
+std::atomic<AsyncIoQueue *> async_io_queue(nullptr);
+
+std::array<AsyncIoSlot, kAsyncIoSlotCount> slots;
+
+// Serializes writers to the submission ring.
+SpinLock submit_lock;
+
+// Serializes readers of the completion ring.
+SpinLock reap_lock;
+
+// Returns the index of a free slot after marking it in use, or -1 if every
+// slot is in use.
+int AcquireSlot() {
+  for (uint32_t i = 0; i < kAsyncIoSlotCount; ++i) {
+    bool expected = false;
+    if (slots[i].in_use.compare_exchange_strong(expected, true,
+                                                std::memory_order_acquire)) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+void ReleaseSlot(uint32_t index) {
+  slots[index].in_use.store(false, std::memory_order_release);
+}
+
+// Copies the destination address and payload of |msg| into |request|.
+// Returns false if the message is not supported or does not fit.
+bool PackMessage(const struct msghdr *msg, AsyncIoRequest *request) {
+  if (!msg || msg->msg_controllen != 0 ||
+      msg->msg_namelen > kAsyncIoMaxTransfer) {
+    return false;
+  }
+  size_t size = msg->msg_namelen;
+  for (size_t i = 0; i < msg->msg_iovlen; ++i) {
+    if (msg->msg_iov[i].iov_len > kAsyncIoMaxTransfer - size) {
+      return false;
+    }
+    size += msg->msg_iov[i].iov_len;
+  }
+
+  uint8_t *data = request->data;
+  if (msg->msg_namelen > 0) {
+    memcpy(data, msg->msg_name, msg->msg_namelen);
+    data += msg->msg_namelen;
+  }
+  for (size_t i = 0; i < msg->msg_iovlen; ++i) {
+    BoundaryCopyOut(data, msg->msg_iov[i].iov_base, msg->msg_iov[i].iov_len);
+    data += msg->msg_iov[i].iov_len;
+  }
+  request->name_length = msg->msg_namelen;
+  request->length = size - msg->msg_namelen;
+  return true;
+}
+
+}  // namespace
+}  // namespace asylo
+
+using asylo::AsyncIoQueue;
+using asylo::AsyncIoRequest;
+using asylo::AsyncIoSlot;
+
+extern "C" int enc_enable_async_io(const char *enclave_name) {
+  std::string name =
+      std::string(ENC_ASYNC_IO_QUEUE_RESOURCE_PREFIX) + enclave_name;
+  void *addr =
+      enc_untrusted_acquire_shared_resource(kAddressName, name.c_str());
+  if (!addr || !enc_is_outside_enclave(addr, sizeof(AsyncIoQueue))) {
+    return -1;
+  }
+  // The queue is owned by the enclave client and outlives the enclave, so the
+  // reference taken above is not needed to keep it alive.
+  enc_untrusted_release_shared_resource(kAddressName, name.c_str());
+  auto *queue = static_cast<AsyncIoQueue *>(addr);
+  if (queue->InstanceVersion() != AsyncIoQueue::TypeVersion()) {
+    return -1;
+  }
+  asylo::async_io_queue.store(queue, std::memory_order_release);
+  return 0;
+}
+
+extern "C" int enc_async_io_submit(const struct enc_async_io_request *request) {
+  AsyncIoQueue *queue = asylo::async_io_queue.load(std::memory_order_acquire);
+  if (!queue || queue->is_shutdown()) {
+    errno = ENOSYS;
+    return -1;
+  }
+  switch (request->opcode) {
+    case ENC_ASYNC_IO_READ:
+    case ENC_ASYNC_IO_WRITE:
+      if (request->count > asylo::kAsyncIoMaxTransfer ||
+          (request->count > 0 && !request->buf)) {
+        errno = EINVAL;
+        return -1;
+      }
+      break;
+    case ENC_ASYNC_IO_FSYNC:
+    case ENC_ASYNC_IO_SENDMSG:
+      break;
+    default:
+      errno = EINVAL;
+      return -1;
+  }
+
+  int index = asylo::AcquireSlot();
+  if (index < 0) {
+    errno = EAGAIN;
+    return -1;
+  }
+  AsyncIoSlot *slot = &asylo::slots[index];
+  AsyncIoRequest *untrusted_request = queue->slot(index);
+  untrusted_request->opcode = request->opcode;
+  untrusted_request->host_fd = request->host_fd;
+  untrusted_request->flags = request->flags;
+  untrusted_request->name_length = 0;
+  untrusted_request->offset = request->offset;
+  untrusted_request->length = 0;
+
+  slot->opcode = request->opcode;
+  slot->buf = nullptr;
+  slot->count = 0;
+  slot->user_data = request->user_data;
+  switch (request->opcode) {
+    case ENC_ASYNC_IO_READ:
+      slot->buf = request->buf;
+      slot->count = request->count;
+      untrusted_request->length = request->count;
+      break;
+    case ENC_ASYNC_IO_WRITE:
+      slot->count = request->count;
+      untrusted_request->length = request->count;
+      asylo::BoundaryCopyOut(untrusted_request->data, request->buf,
+                             request->count);
+      break;
+    case ENC_ASYNC_IO_SENDMSG:
+      if (!asylo::PackMessage(request->msg, untrusted_request)) {
+        asylo::ReleaseSlot(index);
+        errno = EINVAL;
+        return -1;
+      }
+      slot->count = untrusted_request->length;
+      break;
+  }
+
+  asylo::submit_lock.Acquire();
+  bool submitted = queue->Submit(index);
+  asylo::submit_lock.Release();
+  if (!submitted) {
+    asylo::ReleaseSlot(index);
+    errno = ENOSYS;
+    return -1;
+  }
+  return 0;
+}
+
+extern "C" int enc_async_io_reap(struct enc_async_io_completion *completions,
+                                 int max_completions) {
+  AsyncIoQueue *queue = asylo::async_io_queue.load(std::memory_order_acquire);
+  if (!queue) {
+    return 0;
+  }
+
+  asylo::reap_lock.Acquire();
+  int count = 0;
+  uint32_t index;
+  while (count < max_completions && queue->PollCompletion(&index)) {
+    index %= asylo::kAsyncIoSlotCount;
+    AsyncIoSlot *slot = &asylo::slots[index];
+
+    // Ignore completions posted for slots which are not in flight.
+    if (!slot->in_use.load(std::memory_order_acquire)) {
+      continue;
+    }
+    AsyncIoRequest *untrusted_request = queue->slot(index);
+    int64_t result = untrusted_request->result;
+    int error = 0;
+    if (result < 0) {
+      result = -1;
+      error = asylo::ErrnoFromBridge(untrusted_request->bridge_errno);
+    } else if (slot->opcode != ENC_ASYNC_IO_FSYNC &&
+               static_cast<uint64_t>(result) > slot->count) {
+      // The host claims to have transferred more than was requested.
+      result = -1;
+      error = EIO;
+    } else if (slot->opcode == ENC_ASYNC_IO_READ) {
+      asylo::BoundaryCopyIn(slot->buf, untrusted_request->data, result);
+    }
+
+    completions[count].user_data = slot->user_data;
+    completions[count].result = result;
+    completions[count].error = error;
+    ++count;
+    asylo::ReleaseSlot(index);
+  }
+  asylo::reap_lock.Release();
+  return count;
+}
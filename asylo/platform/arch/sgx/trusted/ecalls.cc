@@ -19,6 +19,7 @@
 // Stubs invoked by edger8r-generated code for calls into the enclave.
 
 
+#include <atomic>
 #include <cerrno>
 #include <cstring>
 #include <string>
@@ -27,14 +28,63 @@
 #include "asylo/enclave.pb.h"
 #include "asylo/util/logging.h"
 #include "asylo/platform/arch/include/trusted/entry_points.h"
+#include "asylo/platform/arch/include/trusted/host_call_stats.h"
 #include "asylo/platform/arch/include/trusted/host_calls.h"
+#include "asylo/platform/arch/include/trusted/resource_usage.h"
+#include "asylo/platform/arch/include/trusted/sampling_profiler.h"
 #include "asylo/platform/arch/sgx/trusted/generated_bridge_t.h"
+#include "asylo/platform/arch/sgx/trusted/untrusted_buffer_pool.h"
+#include "asylo/platform/common/boundary_copy.h"
 #include "asylo/platform/common/bridge_types.h"
 #include "asylo/util/posix_error_space.h"
 #include "asylo/util/status.h"
 #include "asylo/util/status.pb.h"
 #include "common/inc/sgx_trts.h"
 
+namespace {
+
+// Number of threads inside the enclave through an ecall, and the highest
+// number seen at once.
+std::atomic<int> tcs_in_use(0);
+std::atomic<int> peak_tcs_in_use(0);
+
+// Number of ecalls the calling thread is inside, which exceeds one for ecalls
+// made during a host call.
+thread_local int ecall_depth = 0;
+
+// Counts the calling thread as occupying a TCS for the lifetime of the object.
+// The untrusted memory queued for release by the thread is released when it
+// leaves the enclave, since its TCS may not enter the enclave again for a long
+// time.
+class ScopedTcsUse {
+ public:
+  ScopedTcsUse() {
+    ++ecall_depth;
+    int in_use = tcs_in_use.fetch_add(1, std::memory_order_relaxed) + 1;
+    int peak = peak_tcs_in_use.load(std::memory_order_relaxed);
+    while (peak < in_use && !peak_tcs_in_use.compare_exchange_weak(
+                                peak, in_use, std::memory_order_relaxed)) {
+    }
+  }
+
+  ~ScopedTcsUse() {
+    // A nested ecall leaves the queue to the outer one, which may be in the
+    // middle of releasing it.
+    if (ecall_depth == 1) {
+      enc_untrusted_flush_deferred_frees();
+    }
+    --ecall_depth;
+    tcs_in_use.fetch_sub(1, std::memory_order_relaxed);
+  }
+};
+
+}  // namespace
+
+extern "C" void enc_get_tcs_usage(int *in_use, int *peak_in_use) {
+  *in_use = tcs_in_use.load(std::memory_order_relaxed);
+  *peak_in_use = peak_tcs_in_use.load(std::memory_order_relaxed);
+}
+
 // Edger8r does basic sanity checks for input and output pointers. The
 // parameters passed by the untrusted caller are copied by the edger8r-generated
 // code into trusted memory and then passed here. Consequently, there is no
@@ -45,6 +95,7 @@
 int ecall_initialize(const char *name, const char *input,
                      bridge_size_t input_len, char **output,
                      bridge_size_t *output_len) {
+  ScopedTcsUse tcs_use;
   int result = 0;
   try {
     result =
@@ -61,6 +112,7 @@ int ecall_initialize(const char *name, const char *input,
 // failure.
 int ecall_run(const char *input, bridge_size_t input_len, char **output,
               bridge_size_t *output_len) {
+  ScopedTcsUse tcs_use;
   int result = 0;
   try {
     result = asylo::__asylo_user_run(input, static_cast<size_t>(input_len),
@@ -72,11 +124,176 @@ int ecall_run(const char *input, bridge_size_t input_len, char **output,
   return result;
 }
 
-int ecall_donate_thread() { return asylo::__asylo_threading_donate(); }
+// Invokes the enclave batch run entry-point. Returns a non-zero error code on
+// failure.
+int ecall_run_batch(const char *input, bridge_size_t input_len, char **output,
+                    bridge_size_t *output_len) {
+  ScopedTcsUse tcs_use;
+  int result = 0;
+  try {
+    result = asylo::__asylo_user_run_batch(
+        input, static_cast<size_t>(input_len), output,
+        static_cast<size_t *>(output_len));
+  } catch (...) {
+    LOG(FATAL) << "Uncaught exception in enclave";
+  }
+
+  return result;
+}
+
+// Invokes the enclave run entry-point on caller-owned untrusted buffers.
+// Unlike the other entry-points, |input| and |output_buffer| are not copied by
+// the edger8r-generated code, so they are checked here to lie entirely outside
+// the enclave. Returns a non-zero error code on failure.
+int ecall_run_with_buffers(const char *input, bridge_size_t input_len,
+                           char *output_buffer, bridge_size_t output_capacity,
+                           char **output, bridge_size_t *output_len) {
+  ScopedTcsUse tcs_use;
+  if (!input || !sgx_is_outside_enclave(input, input_len) ||
+      (output_buffer &&
+       !sgx_is_outside_enclave(output_buffer, output_capacity))) {
+    return 1;
+  }
+
+  int result = 0;
+  try {
+    result = asylo::__asylo_user_run_with_buffers(
+        input, static_cast<size_t>(input_len), output_buffer,
+        static_cast<size_t>(output_capacity), output,
+        static_cast<size_t *>(output_len));
+  } catch (...) {
+    LOG(FATAL) << "Uncaught exception in enclave";
+  }
+
+  return result;
+}
+
+// Invokes the enclave raw run entry-point. |output_buffer| is not copied by the
+// edger8r-generated code, so it is checked here to lie entirely outside the
+// enclave. Returns a non-zero error code on failure.
+int ecall_run_raw(const char *input, bridge_size_t input_len,
+                  char *output_buffer, bridge_size_t output_capacity,
+                  char **output, bridge_size_t *output_len, int *status_code) {
+  ScopedTcsUse tcs_use;
+  if (output_buffer &&
+      !sgx_is_outside_enclave(output_buffer, output_capacity)) {
+    return 1;
+  }
+
+  int result = 0;
+  try {
+    result = asylo::__asylo_user_run_raw(
+        input, static_cast<size_t>(input_len), output_buffer,
+        static_cast<size_t>(output_capacity), output,
+        static_cast<size_t *>(output_len), status_code);
+  } catch (...) {
+    LOG(FATAL) << "Uncaught exception in enclave";
+  }
+
+  return result;
+}
+
+int ecall_reset(const char *input, bridge_size_t input_len, char **output,
+                bridge_size_t *output_len) {
+  ScopedTcsUse tcs_use;
+  int result = 0;
+  try {
+    result =
+        asylo::__asylo_user_reset(input, static_cast<size_t>(input_len), output,
+                                  static_cast<size_t *>(output_len));
+  } catch (...) {
+    LOG(FATAL) << "Uncaught exception in enclave";
+  }
+
+  return result;
+}
+
+int ecall_snapshot(char **output, bridge_size_t *output_len) {
+  ScopedTcsUse tcs_use;
+  int result = 0;
+  try {
+    result = asylo::__asylo_user_snapshot(output,
+                                          static_cast<size_t *>(output_len));
+  } catch (...) {
+    LOG(FATAL) << "Uncaught exception in enclave";
+  }
+
+  return result;
+}
+
+int ecall_get_host_call_stats(char **output, bridge_size_t *output_len) {
+  ScopedTcsUse tcs_use;
+  asylo::HostCallStatsSnapshot snapshot;
+  asylo::GetHostCallStats(&snapshot);
+
+  // Serialize to a trusted buffer first, since the host may modify untrusted
+  // memory concurrently.
+  std::string serialized;
+  if (!snapshot.SerializeToString(&serialized)) {
+    return 1;
+  }
+  *output = nullptr;
+  *output_len = static_cast<bridge_size_t>(serialized.size());
+  if (serialized.empty()) {
+    return 0;
+  }
+  *output = reinterpret_cast<char *>(enc_untrusted_malloc(serialized.size()));
+  if (!*output) {
+    return 1;
+  }
+  asylo::BoundaryCopyOut(*output, serialized.data(), serialized.size());
+  return 0;
+}
+
+int ecall_get_profile(char **output, bridge_size_t *output_len) {
+  ScopedTcsUse tcs_use;
+  asylo::EnclaveProfile profile;
+  asylo::GetSamplingProfile(&profile);
+
+  // Serialize to a trusted buffer first, since the host may modify untrusted
+  // memory concurrently.
+  std::string serialized;
+  if (!profile.SerializeToString(&serialized)) {
+    return 1;
+  }
+  *output = nullptr;
+  *output_len = static_cast<bridge_size_t>(serialized.size());
+  if (serialized.empty()) {
+    return 0;
+  }
+  *output = reinterpret_cast<char *>(enc_untrusted_malloc(serialized.size()));
+  if (!*output) {
+    return 1;
+  }
+  asylo::BoundaryCopyOut(*output, serialized.data(), serialized.size());
+  return 0;
+}
+
+int ecall_get_resource_stats(char **output, bridge_size_t *output_len) {
+  ScopedTcsUse tcs_use;
+  int result = 0;
+  try {
+    result = asylo::__asylo_get_resource_stats(
+        output, static_cast<size_t *>(output_len));
+  } catch (...) {
+    LOG(FATAL) << "Uncaught exception in enclave";
+  }
+
+  return result;
+}
+
+int ecall_donate_thread() {
+  ScopedTcsUse tcs_use;
+  // Reserve the untrusted marshalling slab up front so that host calls made by
+  // this thread do not pay for it.
+  asylo::ReserveUntrustedSlab();
+  return asylo::__asylo_threading_donate();
+}
 
 // Invokes the enclave signal handling entry-point. Returns a non-zero error
 // code on failure.
 int ecall_handle_signal(const char *input, bridge_size_t input_len) {
+  ScopedTcsUse tcs_use;
   int result = 0;
   try {
     result =
@@ -94,6 +311,7 @@ int ecall_handle_signal(const char *input, bridge_size_t input_len) {
 // on failure.
 int ecall_finalize(const char *input, bridge_size_t input_len, char **output,
                    bridge_size_t *output_len) {
+  ScopedTcsUse tcs_use;
   int result = 0;
   try {
     result =
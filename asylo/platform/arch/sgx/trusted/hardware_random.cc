@@ -26,6 +26,21 @@
 namespace asylo {
 namespace {
 
+// Size of an AES block, and therefore of each DRBG output block.
+constexpr size_t kBlockSize = 16;
+
+// Number of AES rounds for a 128-bit key.
+constexpr int kAesRounds = 10;
+
+// Size of the per-thread buffer that small requests are served from. Refilling
+// the buffer amortizes the cost of rekeying across many small requests, such
+// as nonce and UUID generation.
+constexpr size_t kBufferSize = 32 * kBlockSize;
+
+// Number of output bytes after which the DRBG mixes in fresh entropy from the
+// hardware.
+constexpr uint64_t kReseedInterval = 1 << 20;
+
 static void rdrand64(void *out) {
   // Spec recommends retrying for transient failures.
   constexpr int kRandRetries = 10;
@@ -38,56 +53,199 @@ static void rdrand64(void *out) {
   abort();
 }
 
-static uint64_t rdrand64() {
-  uint64_t temp;
-  rdrand64(&temp);
+// Fills |out| with 8 bytes of entropy from the rdseed instruction. Unlike
+// rdrand, rdseed may fail repeatedly while the entropy source is exhausted, in
+// which case this function falls back to rdrand.
+__attribute__((target("rdseed"))) static void rdseed64(void *out) {
+  constexpr int kSeedRetries = 100;
+  for (int i = 0; i < kSeedRetries; ++i) {
+    if (_rdseed64_step(static_cast<unsigned long long *>(out))) {
+      return;
+    }
+    _mm_pause();
+  }
 
-  return temp;
+  rdrand64(out);
 }
 
-// Compute alignment properties of given buffer.
-static void CalculateAlignment(const void *buf, size_t size, size_t align_size,
-                               size_t *unaligned_bytes, size_t *aligned_count,
-                               size_t *partial_bytes) {
-  // The number of unaligned bytes is the 2s complement, modulo alignment.
-  *unaligned_bytes = (~reinterpret_cast<uintptr_t>(buf) + 1) % align_size;
-  *unaligned_bytes = std::min(*unaligned_bytes, size);
-  *aligned_count = (size - *unaligned_bytes) / align_size;
-  *partial_bytes = size - *unaligned_bytes - (*aligned_count * align_size);
+// Overwrites |size| bytes at |ptr| with zeros in a way the compiler cannot
+// elide.
+static void Cleanse(void *ptr, size_t size) {
+  volatile uint8_t *bytes = static_cast<volatile uint8_t *>(ptr);
+  for (size_t i = 0; i < size; ++i) {
+    bytes[i] = 0;
+  }
 }
 
-}  // namespace
+template <int kRcon>
+__attribute__((target("aes,sse4.1"))) static __m128i ExpandRoundKey(
+    __m128i key) {
+  __m128i assist = _mm_shuffle_epi32(_mm_aeskeygenassist_si128(key, kRcon),
+                                     _MM_SHUFFLE(3, 3, 3, 3));
+  key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+  key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+  key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+  return _mm_xor_si128(key, assist);
+}
 
-// Fills given buffer with random values generated with the rdrand instruction.
-extern "C" ssize_t enc_hardware_random(uint8_t *buf, size_t count) {
-  size_t unaligned_bytes;
-  size_t aligned_count;
-  size_t partial_bytes;
-  CalculateAlignment(buf, count, sizeof(uint64_t), &unaligned_bytes,
-                     &aligned_count, &partial_bytes);
-
-  // Cast to make offsetting easier.
-  uint8_t *byte_buf = static_cast<uint8_t *>(buf);
-
-  // Copy random bytes into any unaligned portion at the start.
-  if (unaligned_bytes) {
-    uint64_t temp = rdrand64();
-    memcpy(&byte_buf[0], &temp, unaligned_bytes);
+// A per-thread AES-128-CTR deterministic random bit generator.
+//
+// The generator is seeded from rdseed and uses fast key erasure: every time it
+// produces output, it also produces a replacement key and discards the old
+// one, so a later compromise of the thread's state does not reveal earlier
+// output. Every kReseedInterval bytes, it mixes fresh hardware entropy into the
+// key.
+//
+// AES-NI is available on every processor that supports SGX, so no runtime
+// check is performed before using it.
+class Drbg {
+ public:
+  ~Drbg() { Cleanse(this, sizeof(*this)); }
+
+  void Generate(uint8_t *buf, size_t count) {
+    if (!seeded_ || bytes_since_reseed_ >= kReseedInterval) {
+      Reseed();
+    }
+    bytes_since_reseed_ += count;
+
+    // Requests that would drain the buffer are served directly, block by
+    // block, and only the tail goes through the buffer.
+    if (count >= kBufferSize) {
+      size_t blocks = count / kBlockSize;
+      Keystream(buf, blocks);
+      Rekey();
+      buf += blocks * kBlockSize;
+      count -= blocks * kBlockSize;
+    }
+
+    while (count > 0) {
+      if (available_ == 0) {
+        Refill();
+      }
+      size_t length = std::min(count, available_);
+      uint8_t *source = &buffer_[kBufferSize - available_];
+      memcpy(buf, source, length);
+      Cleanse(source, length);
+      available_ -= length;
+      buf += length;
+      count -= length;
+    }
   }
 
-  // Copy random bytes directly into buffer for the aligned portion.
-  uint8_t *aligned_end = &byte_buf[count - partial_bytes];
-  for (uint8_t *aligned_buf = &byte_buf[unaligned_bytes];
-       aligned_buf < aligned_end; aligned_buf += sizeof(uint64_t)) {
-    rdrand64(aligned_buf);
+ private:
+  // Expands |key| into the AES-128 key schedule.
+  __attribute__((target("aes,sse4.1"))) void SetKey(__m128i key) {
+    round_keys_[0] = key;
+    round_keys_[1] = ExpandRoundKey<0x01>(round_keys_[0]);
+    round_keys_[2] = ExpandRoundKey<0x02>(round_keys_[1]);
+    round_keys_[3] = ExpandRoundKey<0x04>(round_keys_[2]);
+    round_keys_[4] = ExpandRoundKey<0x08>(round_keys_[3]);
+    round_keys_[5] = ExpandRoundKey<0x10>(round_keys_[4]);
+    round_keys_[6] = ExpandRoundKey<0x20>(round_keys_[5]);
+    round_keys_[7] = ExpandRoundKey<0x40>(round_keys_[6]);
+    round_keys_[8] = ExpandRoundKey<0x80>(round_keys_[7]);
+    round_keys_[9] = ExpandRoundKey<0x1b>(round_keys_[8]);
+    round_keys_[10] = ExpandRoundKey<0x36>(round_keys_[9]);
+    counter_ = _mm_setzero_si128();
   }
 
-  // Copy random bytes into any partial portion at the end.
-  if (partial_bytes) {
-    uint64_t temp = rdrand64();
-    memcpy(aligned_end, &temp, partial_bytes);
+  // Writes |blocks| blocks of keystream to |out|. Four counter blocks are
+  // encrypted at a time to keep the AES units busy.
+  __attribute__((target("aes,sse4.1"))) void Keystream(uint8_t *out,
+                                                         size_t blocks) {
+    const __m128i one = _mm_set_epi64x(0, 1);
+    for (; blocks >= 4; blocks -= 4, out += 4 * kBlockSize) {
+      __m128i b0 = counter_;
+      __m128i b1 = _mm_add_epi64(b0, one);
+      __m128i b2 = _mm_add_epi64(b1, one);
+      __m128i b3 = _mm_add_epi64(b2, one);
+      counter_ = _mm_add_epi64(b3, one);
+      b0 = _mm_xor_si128(b0, round_keys_[0]);
+      b1 = _mm_xor_si128(b1, round_keys_[0]);
+      b2 = _mm_xor_si128(b2, round_keys_[0]);
+      b3 = _mm_xor_si128(b3, round_keys_[0]);
+      for (int round = 1; round < kAesRounds; ++round) {
+        b0 = _mm_aesenc_si128(b0, round_keys_[round]);
+        b1 = _mm_aesenc_si128(b1, round_keys_[round]);
+        b2 = _mm_aesenc_si128(b2, round_keys_[round]);
+        b3 = _mm_aesenc_si128(b3, round_keys_[round]);
+      }
+      b0 = _mm_aesenclast_si128(b0, round_keys_[kAesRounds]);
+      b1 = _mm_aesenclast_si128(b1, round_keys_[kAesRounds]);
+      b2 = _mm_aesenclast_si128(b2, round_keys_[kAesRounds]);
+      b3 = _mm_aesenclast_si128(b3, round_keys_[kAesRounds]);
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(out), b0);
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(out + kBlockSize), b1);
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(out + 2 * kBlockSize), b2);
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(out + 3 * kBlockSize), b3);
+    }
+    for (; blocks > 0; --blocks, out += kBlockSize) {
+      __m128i b = _mm_xor_si128(counter_, round_keys_[0]);
+      counter_ = _mm_add_epi64(counter_, one);
+      for (int round = 1; round < kAesRounds; ++round) {
+        b = _mm_aesenc_si128(b, round_keys_[round]);
+      }
+      b = _mm_aesenclast_si128(b, round_keys_[kAesRounds]);
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(out), b);
+    }
+  }
+
+  // Replaces the key with the next block of keystream.
+  __attribute__((target("aes,sse4.1"))) void Rekey() {
+    alignas(16) uint8_t next_key[kBlockSize];
+    Keystream(next_key, 1);
+    SetKey(_mm_load_si128(reinterpret_cast<__m128i *>(next_key)));
+    Cleanse(next_key, sizeof(next_key));
   }
 
+  // Refills the buffer. The first block becomes the next key and is never
+  // handed out.
+  __attribute__((target("aes,sse4.1"))) void Refill() {
+    Keystream(buffer_, kBufferSize / kBlockSize);
+    SetKey(_mm_loadu_si128(reinterpret_cast<__m128i *>(buffer_)));
+    Cleanse(buffer_, kBlockSize);
+    available_ = kBufferSize - kBlockSize;
+  }
+
+  // Derives a new key from hardware entropy. On reseeds after the first, the
+  // entropy is combined with output of the current key, so the state never
+  // depends solely on a single read of the entropy source.
+  __attribute__((target("aes,sse4.1"))) void Reseed() {
+    alignas(16) uint64_t seed[kBlockSize / sizeof(uint64_t)];
+    for (uint64_t &word : seed) {
+      rdseed64(&word);
+    }
+    __m128i key = _mm_load_si128(reinterpret_cast<__m128i *>(seed));
+    if (seeded_) {
+      alignas(16) uint8_t mix[kBlockSize];
+      Keystream(mix, 1);
+      key = _mm_xor_si128(
+          key, _mm_load_si128(reinterpret_cast<__m128i *>(mix)));
+      Cleanse(mix, sizeof(mix));
+    }
+    SetKey(key);
+    Cleanse(seed, sizeof(seed));
+    Cleanse(&key, sizeof(key));
+    bytes_since_reseed_ = 0;
+    seeded_ = true;
+  }
+
+  __m128i round_keys_[kAesRounds + 1];
+  __m128i counter_;
+  uint8_t buffer_[kBufferSize];
+  size_t available_ = 0;
+  uint64_t bytes_since_reseed_ = 0;
+  bool seeded_ = false;
+};
+
+thread_local Drbg drbg;
+
+}  // namespace
+
+// Fills given buffer with output of the calling thread's DRBG, which is seeded
+// from the rdseed instruction.
+extern "C" ssize_t enc_hardware_random(uint8_t *buf, size_t count) {
+  drbg.Generate(buf, count);
   return count;
 }
 
@@ -0,0 +1,98 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/arch/sgx/trusted/host_call_batch.h"
+
+#include <errno.h>
+#include <cstring>
+#include <utility>
+
+#include "asylo/platform/arch/sgx/trusted/generated_bridge_t.h"
+#include "asylo/platform/arch/sgx/trusted/untrusted_buffer_pool.h"
+#include "asylo/platform/common/host_call_batch.h"
+
+namespace asylo {
+
+uint8_t *HostCallBatch::AddCall(uint32_t call_id, size_t payload_size,
+                                Completion completion) {
+  size_t offset = records_.size();
+  records_.resize(offset + HostCallRecordSize(payload_size));
+  HostCallRecord record = {};
+  record.call_id = call_id;
+  record.payload_size = static_cast<uint32_t>(payload_size);
+  memcpy(records_.data() + offset, &record, sizeof(record));
+  calls_.push_back({offset, std::move(completion)});
+  return records_.data() + offset + sizeof(record);
+}
+
+bool HostCallBatch::Submit() {
+  std::vector<uint8_t> records;
+  std::vector<PendingCall> calls;
+  records.swap(records_);
+  calls.swap(calls_);
+  if (calls.empty()) {
+    return true;
+  }
+
+  UntrustedScratch scratch;
+  auto *untrusted_records =
+      static_cast<uint8_t *>(scratch.Allocate(records.size()));
+  if (!untrusted_records) {
+    return false;
+  }
+  memcpy(untrusted_records, records.data(), records.size());
+
+  int result;
+  sgx_status_t status = ocall_enc_untrusted_batch(
+      &result, untrusted_records, static_cast<bridge_size_t>(records.size()));
+  if (status != SGX_SUCCESS || result != 0) {
+    return false;
+  }
+
+  // Locate records by the offsets computed inside the enclave rather than by
+  // walking the untrusted copy.
+  for (PendingCall &call : calls) {
+    HostCallRecord record;
+    memcpy(&record, untrusted_records + call.offset, sizeof(record));
+    call.completion(untrusted_records + call.offset + sizeof(record),
+                    record.result, record.bridge_errno);
+  }
+  return true;
+}
+
+}  // namespace asylo
+
+extern "C" {
+
+struct enc_untrusted_batch *enc_untrusted_batch_create() {
+  return new enc_untrusted_batch();
+}
+
+int enc_untrusted_batch_submit(struct enc_untrusted_batch *batch) {
+  if (!batch->Submit()) {
+    errno = EINTR;
+    return -1;
+  }
+  return 0;
+}
+
+void enc_untrusted_batch_destroy(struct enc_untrusted_batch *batch) {
+  delete batch;
+}
+
+}  // extern "C"
@@ -0,0 +1,71 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_PLATFORM_ARCH_SGX_TRUSTED_HOST_CALL_BATCH_H_
+#define ASYLO_PLATFORM_ARCH_SGX_TRUSTED_HOST_CALL_BATCH_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "asylo/platform/arch/include/trusted/host_calls.h"
+
+namespace asylo {
+
+// A sequence of marshalled host calls staged in trusted memory and run on the
+// host in a single enclave exit. Calls are added by the generated
+// enc_untrusted_batch_<name> functions.
+class HostCallBatch {
+ public:
+  // Invoked for each call once the batch has been serviced, with the output
+  // payload, return value and bridge errno of the call.
+  using Completion = std::function<void(const uint8_t *payload, int64_t result,
+                                        int32_t bridge_errno)>;
+
+  HostCallBatch() = default;
+  HostCallBatch(const HostCallBatch &) = delete;
+  HostCallBatch &operator=(const HostCallBatch &) = delete;
+
+  // Appends a call to |call_id| with |payload_size| bytes of arguments and
+  // returns the staging buffer to fill them in. The buffer is only valid until
+  // the next call to AddCall or Submit.
+  uint8_t *AddCall(uint32_t call_id, size_t payload_size,
+                   Completion completion);
+
+  // Copies the batch to untrusted memory, runs every call on the host in the
+  // order it was added, and invokes the completions. The batch is emptied
+  // whether or not it succeeds. Returns false if the host could not service
+  // the batch, in which case no completion is invoked.
+  bool Submit();
+
+ private:
+  struct PendingCall {
+    size_t offset;
+    Completion completion;
+  };
+
+  std::vector<uint8_t> records_;
+  std::vector<PendingCall> calls_;
+};
+
+}  // namespace asylo
+
+struct enc_untrusted_batch : public asylo::HostCallBatch {};
+
+#endif  // ASYLO_PLATFORM_ARCH_SGX_TRUSTED_HOST_CALL_BATCH_H_
@@ -0,0 +1,164 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/arch/sgx/trusted/host_call_stats.h"
+
+#include <time.h>
+#include <atomic>
+
+#include "asylo/platform/arch/include/trusted/host_call_stats.h"
+
+namespace asylo {
+namespace {
+
+// Counters of one host call made by one thread. Only the owning thread writes
+// them, so they are updated with plain loads and stores, and are atomic only so
+// that snapshots may read them concurrently.
+struct HostCallCounters {
+  std::atomic<uint64_t> calls;
+  std::atomic<uint64_t> bytes;
+  std::atomic<uint64_t> total_latency_ns;
+  std::atomic<uint64_t> latency_histogram[kHostCallLatencyBuckets];
+};
+
+// Host call counters of one thread. Records are never freed once registered,
+// so that the calls of exited threads remain counted.
+struct ThreadHostCallStats {
+  HostCallCounters counters[kMaxInstrumentedHostCalls];
+  ThreadHostCallStats *next;
+};
+
+// Head of the list of all thread records.
+std::atomic<ThreadHostCallStats *> thread_stats(nullptr);
+
+thread_local ThreadHostCallStats *current_stats = nullptr;
+
+// Names of the host calls, indexed by host call number. Set on first call.
+std::atomic<const char *> host_call_names[kMaxInstrumentedHostCalls];
+
+ThreadHostCallStats *CurrentStats() {
+  if (!current_stats) {
+    ThreadHostCallStats *stats = new ThreadHostCallStats();
+    stats->next = thread_stats.load(std::memory_order_relaxed);
+    while (!thread_stats.compare_exchange_weak(stats->next, stats)) {
+    }
+    current_stats = stats;
+  }
+  return current_stats;
+}
+
+void Add(std::atomic<uint64_t> *counter, uint64_t value) {
+  counter->store(counter->load(std::memory_order_relaxed) + value,
+                 std::memory_order_relaxed);
+}
+
+int64_t MonotonicNanoseconds() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return static_cast<int64_t>(now.tv_sec) * 1000000000 + now.tv_nsec;
+}
+
+int LatencyBucket(uint64_t nanoseconds) {
+  if (nanoseconds == 0) {
+    return 0;
+  }
+  int bucket = 63 - __builtin_clzll(nanoseconds);
+  return bucket < kHostCallLatencyBuckets ? bucket
+                                          : kHostCallLatencyBuckets - 1;
+}
+
+}  // namespace
+
+HostCallTimer::HostCallTimer(uint32_t index, const char *name, uint64_t bytes)
+    : index_(index), bytes_(bytes) {
+  if (!host_call_names[index].load(std::memory_order_relaxed)) {
+    host_call_names[index].store(name, std::memory_order_relaxed);
+  }
+  start_ = MonotonicNanoseconds();
+}
+
+HostCallTimer::~HostCallTimer() {
+  int64_t latency = MonotonicNanoseconds() - start_;
+  if (latency < 0) {
+    latency = 0;
+  }
+  HostCallCounters *counters = &CurrentStats()->counters[index_];
+  Add(&counters->calls, 1);
+  Add(&counters->bytes, bytes_);
+  Add(&counters->total_latency_ns, latency);
+  Add(&counters->latency_histogram[LatencyBucket(latency)], 1);
+}
+
+void GetHostCallStats(HostCallStatsSnapshot *snapshot) {
+  snapshot->Clear();
+  for (uint32_t index = 0; index < kMaxInstrumentedHostCalls; ++index) {
+    const char *name = host_call_names[index].load(std::memory_order_relaxed);
+    if (!name) {
+      continue;
+    }
+    uint64_t calls = 0;
+    uint64_t bytes = 0;
+    uint64_t total_latency_ns = 0;
+    uint64_t latency_histogram[kHostCallLatencyBuckets] = {};
+    for (ThreadHostCallStats *stats =
+             thread_stats.load(std::memory_order_acquire);
+         stats; stats = stats->next) {
+      const HostCallCounters &counters = stats->counters[index];
+      calls += counters.calls.load(std::memory_order_relaxed);
+      bytes += counters.bytes.load(std::memory_order_relaxed);
+      total_latency_ns +=
+          counters.total_latency_ns.load(std::memory_order_relaxed);
+      for (int bucket = 0; bucket < kHostCallLatencyBuckets; ++bucket) {
+        latency_histogram[bucket] +=
+            counters.latency_histogram[bucket].load(std::memory_order_relaxed);
+      }
+    }
+    if (calls == 0) {
+      continue;
+    }
+
+    HostCallStats *host_call = snapshot->add_host_calls();
+    host_call->set_name(name);
+    host_call->set_calls(calls);
+    host_call->set_bytes(bytes);
+    host_call->set_total_latency_ns(total_latency_ns);
+    for (uint64_t count : latency_histogram) {
+      host_call->add_latency_histogram(count);
+    }
+  }
+}
+
+bool GetThreadHostCallCounts(ThreadHostCallCounts *counts) {
+#ifdef ASYLO_INSTRUMENT_HOST_CALLS
+  counts->calls = 0;
+  counts->total_latency_ns = 0;
+  if (!current_stats) {
+    return true;
+  }
+  for (const HostCallCounters &counters : current_stats->counters) {
+    counts->calls += counters.calls.load(std::memory_order_relaxed);
+    counts->total_latency_ns +=
+        counters.total_latency_ns.load(std::memory_order_relaxed);
+  }
+  return true;
+#else
+  return false;
+#endif
+}
+
+}  // namespace asylo
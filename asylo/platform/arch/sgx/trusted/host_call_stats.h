@@ -0,0 +1,56 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_PLATFORM_ARCH_SGX_TRUSTED_HOST_CALL_STATS_H_
+#define ASYLO_PLATFORM_ARCH_SGX_TRUSTED_HOST_CALL_STATS_H_
+
+// Trusted side of host call instrumentation. The timer is intended for use by
+// the generated host call wrappers only, which create one when generated with
+// --instrument_host_calls.
+
+#include <cstdint>
+
+namespace asylo {
+
+// The largest number of host calls which can be instrumented.
+constexpr uint32_t kMaxInstrumentedHostCalls = 64;
+
+// The number of buckets of the latency histogram of a host call.
+constexpr int kHostCallLatencyBuckets = 32;
+
+// Counts a call to the host call numbered |index| and named |name| which
+// marshals |bytes| bytes, and records its latency when destroyed. Counters are
+// kept per thread, so that recording a call does not contend with other
+// threads.
+class HostCallTimer {
+ public:
+  HostCallTimer(uint32_t index, const char *name, uint64_t bytes);
+  ~HostCallTimer();
+
+  HostCallTimer(const HostCallTimer &) = delete;
+  HostCallTimer &operator=(const HostCallTimer &) = delete;
+
+ private:
+  uint32_t index_;
+  uint64_t bytes_;
+  int64_t start_;
+};
+
+}  // namespace asylo
+
+#endif  // ASYLO_PLATFORM_ARCH_SGX_TRUSTED_HOST_CALL_STATS_H_
@@ -34,23 +34,31 @@
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <limits>
 #include <string>
 #include <vector>
 
 #include "absl/memory/memory.h"
+#include "absl/strings/string_view.h"
+#include "asylo/platform/arch/include/trusted/enclave_interface.h"
 #include "asylo/platform/arch/include/trusted/memory.h"
 #include "asylo/platform/arch/sgx/trusted/generated_bridge_t.h"
-#include "asylo/platform/common/bridge_proto_serializer.h"
+#include "asylo/platform/arch/sgx/trusted/untrusted_buffer_pool.h"
+#include "asylo/platform/common/boundary_copy.h"
+#include "asylo/platform/common/bridge_flat_serializer.h"
 #include "asylo/platform/common/bridge_types.h"
 #include "common/inc/sgx_trts.h"
 
 namespace asylo {
 namespace {
 
-// Allocates untrusted memory and copies the buffer |data| of size |size| to it.
-// |addr| is updated to point to the address of the copied memory. It is the
-// responsibility of the caller to free the memory pointed to by |addr|.
-bool CopyToUntrustedMemory(void **addr, void *data, size_t size) {
+// Allocates untrusted memory from |scratch| and copies the buffer |data| of
+// size |size| to it. |addr| is updated to point to the address of the copied
+// memory, which remains valid for the lifetime of |scratch|.
+bool CopyToUntrustedMemory(UntrustedScratch *scratch, void **addr, void *data,
+                           size_t size) {
   if (data && !addr) {
     return false;
   }
@@ -58,14 +66,17 @@ bool CopyToUntrustedMemory(void **addr, void *data, size_t size) {
   if (!data) {
     return true;
   }
-  void *outside_enclave = enc_untrusted_malloc(size);
-  memcpy(outside_enclave, data, size);
+  void *outside_enclave = scratch->Allocate(size);
+  if (!outside_enclave) {
+    return false;
+  }
+  asylo::BoundaryCopyOut(outside_enclave, data, size);
   *addr = outside_enclave;
   return true;
 }
 
 // This helper class wraps a bridge_msghdr and does a deep copy of all the
-// buffers to untrusted memory.
+// buffers to untrusted memory borrowed from the thread's untrusted slab.
 class BridgeMsghdrWrapper {
  public:
   BridgeMsghdrWrapper(const struct msghdr *in);
@@ -78,37 +89,33 @@ class BridgeMsghdrWrapper {
   bool CopyMsgIovBase();
   bool CopyMsgControl();
 
+  UntrustedScratch scratch_;
   const msghdr *msg_in_;
-  UntrustedUniquePtr<bridge_msghdr> msg_out_;
-  UntrustedUniquePtr<void> msg_name_ptr_;
-  UntrustedUniquePtr<void> msg_iov_ptr_;
-  UntrustedUniquePtr<void> msg_control_ptr_;
-  std::vector<UntrustedUniquePtr<void>> msg_iov_base_ptrs_;
+  bridge_msghdr *msg_out_ = nullptr;
 };
 
 BridgeMsghdrWrapper::BridgeMsghdrWrapper(const struct msghdr *in) {
   struct bridge_msghdr tmp;
   ToBridgeMsgHdr(in, &tmp);
   struct bridge_msghdr *tmp_bridge_msghdr(nullptr);
-  bool ret =
-      CopyToUntrustedMemory(reinterpret_cast<void **>(&tmp_bridge_msghdr), &tmp,
-                            sizeof(struct bridge_msghdr));
+  bool ret = CopyToUntrustedMemory(
+      &scratch_, reinterpret_cast<void **>(&tmp_bridge_msghdr), &tmp,
+      sizeof(struct bridge_msghdr));
   if (ret && tmp_bridge_msghdr) {
-    msg_out_.reset(tmp_bridge_msghdr);
+    msg_out_ = tmp_bridge_msghdr;
   }
   msg_in_ = in;
 }
 
-bridge_msghdr *BridgeMsghdrWrapper::get_msg() { return msg_out_.get(); }
+bridge_msghdr *BridgeMsghdrWrapper::get_msg() { return msg_out_; }
 
 bool BridgeMsghdrWrapper::CopyMsgName() {
   void *tmp_name_ptr(nullptr);
-  if (!CopyToUntrustedMemory(&tmp_name_ptr, msg_in_->msg_name,
+  if (!CopyToUntrustedMemory(&scratch_, &tmp_name_ptr, msg_in_->msg_name,
                              msg_in_->msg_namelen)) {
     return false;
   }
   if (tmp_name_ptr) {
-    msg_name_ptr_.reset(tmp_name_ptr);
     msg_out_->msg_name = tmp_name_ptr;
   }
   return true;
@@ -116,11 +123,11 @@ bool BridgeMsghdrWrapper::CopyMsgName() {
 
 bool BridgeMsghdrWrapper::CopyMsgIov() {
   struct bridge_iovec *tmp_iov_ptr = reinterpret_cast<struct bridge_iovec *>(
-      enc_untrusted_malloc(msg_in_->msg_iovlen * sizeof(struct bridge_iovec)));
-  if (tmp_iov_ptr) {
-    msg_iov_ptr_.reset(tmp_iov_ptr);
-    msg_out_->msg_iov = tmp_iov_ptr;
+      scratch_.Allocate(msg_in_->msg_iovlen * sizeof(struct bridge_iovec)));
+  if (!tmp_iov_ptr) {
+    return false;
   }
+  msg_out_->msg_iov = tmp_iov_ptr;
   for (int i = 0; i < msg_in_->msg_iovlen; ++i) {
     if (!ToBridgeIovec(&msg_in_->msg_iov[i], &msg_out_->msg_iov[i])) {
       return false;
@@ -131,14 +138,13 @@ bool BridgeMsghdrWrapper::CopyMsgIov() {
 
 bool BridgeMsghdrWrapper::CopyMsgIovBase() {
   for (int i = 0; i < msg_in_->msg_iovlen; ++i) {
-    msg_iov_base_ptrs_.push_back(nullptr);
     void *tmp_iov_base_ptr(nullptr);
-    if (!CopyToUntrustedMemory(&tmp_iov_base_ptr, msg_in_->msg_iov[i].iov_base,
+    if (!CopyToUntrustedMemory(&scratch_, &tmp_iov_base_ptr,
+                               msg_in_->msg_iov[i].iov_base,
                                msg_in_->msg_iov[i].iov_len)) {
       return false;
     }
     if (tmp_iov_base_ptr) {
-      msg_iov_base_ptrs_[i].reset(tmp_iov_base_ptr);
       msg_out_->msg_iov[i].iov_base = tmp_iov_base_ptr;
     }
   }
@@ -147,25 +153,39 @@ bool BridgeMsghdrWrapper::CopyMsgIovBase() {
 
 bool BridgeMsghdrWrapper::CopyMsgControl() {
   void *tmp_control_ptr(nullptr);
-  if (!CopyToUntrustedMemory(&tmp_control_ptr, msg_in_->msg_control,
+  if (!CopyToUntrustedMemory(&scratch_, &tmp_control_ptr, msg_in_->msg_control,
                              msg_in_->msg_controllen)) {
     return false;
   }
   if (tmp_control_ptr) {
-    msg_control_ptr_.reset(tmp_control_ptr);
     msg_out_->msg_control = tmp_control_ptr;
   }
   return true;
 }
 
 bool BridgeMsghdrWrapper::CopyAllBuffers() {
-  if (!CopyMsgName() || !CopyMsgIov() || !CopyMsgIovBase() ||
+  if (!msg_out_ || !CopyMsgName() || !CopyMsgIov() || !CopyMsgIovBase() ||
       !CopyMsgControl()) {
     return false;
   }
   return true;
 }
 
+// Number of untrusted pointers a thread queues before releasing them.
+constexpr size_t kDeferredFreeBatchSize = 64;
+
+// Untrusted pointers queued by enc_untrusted_free_deferred() on the calling
+// thread.
+struct DeferredFrees {
+  void *ptrs[kDeferredFreeBatchSize];
+  size_t count;
+};
+
+thread_local DeferredFrees deferred_frees = {{}, 0};
+
+// Number of untrusted pointers queued on all threads.
+std::atomic<size_t> deferred_frees_pending(0);
+
 }  // namespace
 }  // namespace asylo
 
@@ -195,6 +215,65 @@ void *enc_untrusted_malloc(size_t size) {
   return result;
 }
 
+void *enc_untrusted_reserve(size_t size) {
+  void *result;
+  sgx_status_t status =
+      ocall_enc_untrusted_reserve(&result, static_cast<bridge_size_t>(size));
+  if (status != SGX_SUCCESS) {
+    errno = EINTR;
+    return nullptr;
+  }
+  if (result &&
+      !sgx_is_outside_enclave(result, static_cast<bridge_size_t>(size))) {
+    abort();
+  }
+  return result;
+}
+
+void enc_untrusted_free_deferred(void *ptr) {
+  if (!ptr) {
+    return;
+  }
+  asylo::DeferredFrees &queue = asylo::deferred_frees;
+  queue.ptrs[queue.count++] = ptr;
+  asylo::deferred_frees_pending.fetch_add(1, std::memory_order_relaxed);
+  if (queue.count == asylo::kDeferredFreeBatchSize) {
+    enc_untrusted_flush_deferred_frees();
+  }
+}
+
+void enc_untrusted_flush_deferred_frees() {
+  asylo::DeferredFrees &queue = asylo::deferred_frees;
+  size_t count = queue.count;
+  if (count == 0) {
+    return;
+  }
+  // Empty the queue first, since marshalling may itself release memory.
+  void *ptrs[asylo::kDeferredFreeBatchSize];
+  memcpy(ptrs, queue.ptrs, count * sizeof(ptrs[0]));
+  queue.count = 0;
+  asylo::deferred_frees_pending.fetch_sub(count, std::memory_order_relaxed);
+
+  asylo::UntrustedScratch scratch;
+  void **untrusted_ptrs =
+      static_cast<void **>(scratch.Allocate(count * sizeof(ptrs[0])));
+  if (untrusted_ptrs) {
+    memcpy(untrusted_ptrs, ptrs, count * sizeof(ptrs[0]));
+    if (ocall_enc_untrusted_free_batch(
+            untrusted_ptrs, static_cast<bridge_size_t>(count)) ==
+        SGX_SUCCESS) {
+      return;
+    }
+  }
+  for (size_t i = 0; i < count; ++i) {
+    enc_untrusted_free(ptrs[i]);
+  }
+}
+
+size_t enc_get_untrusted_frees_pending() {
+  return asylo::deferred_frees_pending.load(std::memory_order_relaxed);
+}
+
 int enc_untrusted_open(const char *path_name, int flags, ...) {
   uint32_t mode = 0;
   if (flags & O_CREAT) {
@@ -311,65 +390,74 @@ int enc_untrusted_lstat(const char *pathname, struct stat *stat_buffer) {
   return result;
 }
 
-bool create_untrusted_buffer(const struct iovec *iov, int iovcnt, char **buf,
-                             int *size) {
-  int tmp_size = 0;
+// Maximum number of elements accepted by readv and writev, matching the Linux
+// host's UIO_MAXIOV.
+constexpr int kMaxIovecCount = 1024;
+
+// Maximum number of bytes which may be described by a single iovec array.
+constexpr size_t kMaxIovecBytes = std::numeric_limits<ssize_t>::max();
+
+// Builds an untrusted iovec array mirroring |iov|, with each element pointing
+// at its own region of a single untrusted buffer drawn from |scratch|. Stores
+// the array in |untrusted_iov|, the start of the data buffer in |buf| and the
+// total number of bytes described by |iov| in |size|. Element i's region starts
+// at |buf| plus the lengths of the elements before it, so callers never need to
+// read buffer addresses back from untrusted memory.
+bool create_untrusted_iov(asylo::UntrustedScratch *scratch,
+                          const struct iovec *iov, int iovcnt,
+                          struct bridge_iovec **untrusted_iov, char **buf,
+                          size_t *size) {
+  size_t total_size = 0;
   for (int i = 0; i < iovcnt; ++i) {
-    tmp_size += iov[i].iov_len;
-  }
-  char *tmp =
-      reinterpret_cast<char *>(enc_untrusted_malloc(tmp_size * sizeof(char)));
-  if (!tmp) {
-    return false;
+    if (iov[i].iov_len > kMaxIovecBytes - total_size) {
+      errno = EINVAL;
+      return false;
+    }
+    total_size += iov[i].iov_len;
   }
-  *size = tmp_size;
-  *buf = tmp;
-  return true;
-}
 
-bool serialize_iov(const struct iovec *iov, int iovcnt, char **buf, int *size) {
-  char *tmp;
-  if (!create_untrusted_buffer(iov, iovcnt, &tmp, size)) {
+  auto tmp_iov = reinterpret_cast<struct bridge_iovec *>(
+      scratch->Allocate(iovcnt * sizeof(struct bridge_iovec)));
+  char *tmp_buf = reinterpret_cast<char *>(scratch->Allocate(total_size));
+  if (!tmp_iov || !tmp_buf) {
+    errno = ENOMEM;
     return false;
   }
-  int copied_bytes = 0;
-  for (int i = 0; i < iovcnt; ++i) {
-    memcpy(tmp + copied_bytes, iov[i].iov_base, iov[i].iov_len);
-    copied_bytes += iov[i].iov_len;
-  }
-  *buf = tmp;
-  return true;
-}
 
-void fill_iov(const char *buf, int size, const struct iovec *iov, int iovcnt) {
-  size_t bytes_left = size;
+  size_t offset = 0;
   for (int i = 0; i < iovcnt; ++i) {
-    if (bytes_left == 0) {
-      break;
-    }
-    int bytes_to_copy = std::min(bytes_left, iov[i].iov_len);
-    memcpy(iov[i].iov_base, buf, bytes_to_copy);
-    buf += bytes_to_copy;
-    bytes_left -= bytes_to_copy;
+    tmp_iov[i].iov_base = tmp_buf + offset;
+    tmp_iov[i].iov_len = iov[i].iov_len;
+    offset += iov[i].iov_len;
   }
+  *untrusted_iov = tmp_iov;
+  *buf = tmp_buf;
+  *size = total_size;
+  return true;
 }
 
 ssize_t enc_untrusted_writev(int fd, const struct iovec *iov, int iovcnt) {
-  if (iovcnt <= 0) {
+  if (iovcnt <= 0 || iovcnt > kMaxIovecCount) {
     errno = EINVAL;
     return -1;
   }
 
+  asylo::UntrustedScratch scratch;
+  struct bridge_iovec *untrusted_iov;
   char *buf;
-  int size;
-  if (!serialize_iov(iov, iovcnt, &buf, &size)) {
+  size_t size;
+  if (!create_untrusted_iov(&scratch, iov, iovcnt, &untrusted_iov, &buf,
+                            &size)) {
     return -1;
   }
-  asylo::UntrustedUniquePtr<char> tmp(buf);
-  bridge_ssize_t ret;
+  for (int i = 0; i < iovcnt; ++i) {
+    asylo::BoundaryCopyOut(buf, iov[i].iov_base, iov[i].iov_len);
+    buf += iov[i].iov_len;
+  }
 
-  sgx_status_t status =
-      ocall_enc_untrusted_write_with_untrusted_ptr(&ret, fd, buf, size);
+  bridge_ssize_t ret;
+  sgx_status_t status = ocall_enc_untrusted_writev_with_untrusted_ptrs(
+      &ret, fd, untrusted_iov, iovcnt);
   if (status != SGX_SUCCESS) {
     errno = EINTR;
     return -1;
@@ -378,28 +466,246 @@ ssize_t enc_untrusted_writev(int fd, const struct iovec *iov, int iovcnt) {
 }
 
 ssize_t enc_untrusted_readv(int fd, const struct iovec *iov, int iovcnt) {
-  if (iovcnt <= 0) {
+  if (iovcnt <= 0 || iovcnt > kMaxIovecCount) {
     errno = EINVAL;
     return -1;
   }
+
+  asylo::UntrustedScratch scratch;
+  struct bridge_iovec *untrusted_iov;
   char *buf;
-  int size;
-  if (!create_untrusted_buffer(iov, iovcnt, &buf, &size)) {
+  size_t size;
+  if (!create_untrusted_iov(&scratch, iov, iovcnt, &untrusted_iov, &buf,
+                            &size)) {
     return -1;
   }
 
-  asylo::UntrustedUniquePtr<char> tmp(buf);
   bridge_ssize_t ret;
-  sgx_status_t status =
-      ocall_enc_untrusted_read_with_untrusted_ptr(&ret, fd, buf, size);
+  sgx_status_t status = ocall_enc_untrusted_readv_with_untrusted_ptrs(
+      &ret, fd, untrusted_iov, iovcnt);
+  if (status != SGX_SUCCESS) {
+    errno = EINTR;
+    return -1;
+  }
+  if (ret < 0) {
+    return -1;
+  }
+  if (static_cast<size_t>(ret) > size) {
+    errno = EIO;
+    return -1;
+  }
+
+  // Scatter the received bytes directly into the caller's buffers.
+  size_t bytes_left = ret;
+  for (int i = 0; i < iovcnt && bytes_left > 0; ++i) {
+    size_t bytes_to_copy = std::min(bytes_left, iov[i].iov_len);
+    asylo::BoundaryCopyIn(iov[i].iov_base, buf, bytes_to_copy);
+    buf += iov[i].iov_len;
+    bytes_left -= bytes_to_copy;
+  }
+  return static_cast<ssize_t>(ret);
+}
+
+ssize_t enc_untrusted_pread(int fd, void *buf, size_t count, off_t offset) {
+  asylo::UntrustedScratch scratch;
+  void *untrusted_buf = scratch.Allocate(count);
+  if (count > 0 && !untrusted_buf) {
+    errno = ENOMEM;
+    return -1;
+  }
+
+  ssize_t ret =
+      enc_untrusted_pread_with_untrusted_ptr(fd, untrusted_buf, count, offset);
+  if (ret < 0) {
+    return -1;
+  }
+  if (static_cast<size_t>(ret) > count) {
+    errno = EIO;
+    return -1;
+  }
+  asylo::BoundaryCopyIn(buf, untrusted_buf, ret);
+  return static_cast<ssize_t>(ret);
+}
+
+ssize_t enc_untrusted_pwrite(int fd, const void *buf, size_t count,
+                             off_t offset) {
+  asylo::UntrustedScratch scratch;
+  void *untrusted_buf = scratch.Allocate(count);
+  if (count > 0 && !untrusted_buf) {
+    errno = ENOMEM;
+    return -1;
+  }
+  asylo::BoundaryCopyOut(untrusted_buf, buf, count);
+
+  ssize_t ret =
+      enc_untrusted_pwrite_with_untrusted_ptr(fd, untrusted_buf, count, offset);
+  if (ret < 0) {
+    return -1;
+  }
+  if (static_cast<size_t>(ret) > count) {
+    errno = EIO;
+    return -1;
+  }
+  return static_cast<ssize_t>(ret);
+}
+
+ssize_t enc_untrusted_getdents64(int fd, void *buf, size_t count) {
+  asylo::UntrustedScratch scratch;
+  void *untrusted_buf = scratch.Allocate(count);
+  if (count > 0 && !untrusted_buf) {
+    errno = ENOMEM;
+    return -1;
+  }
+
+  bridge_ssize_t ret;
+  sgx_status_t status = ocall_enc_untrusted_getdents64_with_untrusted_ptr(
+      &ret, fd, untrusted_buf, static_cast<bridge_size_t>(count));
   if (status != SGX_SUCCESS) {
     errno = EINTR;
     return -1;
   }
-  fill_iov(buf, ret, iov, iovcnt);
+  if (ret < 0) {
+    return -1;
+  }
+  if (static_cast<size_t>(ret) > count) {
+    errno = EIO;
+    return -1;
+  }
+  // The records are copied in once, so the host cannot change them while the
+  // caller parses them.
+  asylo::BoundaryCopyIn(buf, untrusted_buf, ret);
+  return static_cast<ssize_t>(ret);
+}
+
+ssize_t enc_untrusted_read_large(int fd, void *buf, size_t count) {
+  uint8_t *staging = static_cast<uint8_t *>(asylo::UntrustedStagingBuffer());
+  if (!staging) {
+    errno = ENOMEM;
+    return -1;
+  }
+  count = std::min(count,
+                   static_cast<size_t>(std::numeric_limits<ssize_t>::max()));
+  size_t total = 0;
+  while (total < count) {
+    size_t chunk = std::min(count - total, asylo::kUntrustedStagingBufferSize);
+    ssize_t ret = enc_untrusted_read_with_untrusted_ptr(fd, staging, chunk);
+    if (ret < 0) {
+      return total > 0 ? static_cast<ssize_t>(total) : -1;
+    }
+    if (static_cast<size_t>(ret) > chunk) {
+      errno = EIO;
+      return -1;
+    }
+    asylo::BoundaryCopyIn(static_cast<uint8_t *>(buf) + total, staging, ret);
+    total += ret;
+    if (static_cast<size_t>(ret) < chunk) {
+      break;
+    }
+  }
+  return static_cast<ssize_t>(total);
+}
+
+ssize_t enc_untrusted_write_large(int fd, const void *buf, size_t count) {
+  uint8_t *staging = static_cast<uint8_t *>(asylo::UntrustedStagingBuffer());
+  if (!staging) {
+    errno = ENOMEM;
+    return -1;
+  }
+  count = std::min(count,
+                   static_cast<size_t>(std::numeric_limits<ssize_t>::max()));
+  size_t total = 0;
+  while (total < count) {
+    size_t chunk = std::min(count - total, asylo::kUntrustedStagingBufferSize);
+    asylo::BoundaryCopyOut(staging, static_cast<const uint8_t *>(buf) + total,
+                           chunk);
+    ssize_t ret = enc_untrusted_write_with_untrusted_ptr(fd, staging, chunk);
+    if (ret < 0) {
+      return total > 0 ? static_cast<ssize_t>(total) : -1;
+    }
+    if (static_cast<size_t>(ret) > chunk) {
+      errno = EIO;
+      return -1;
+    }
+    total += ret;
+    if (static_cast<size_t>(ret) < chunk) {
+      break;
+    }
+  }
+  return static_cast<ssize_t>(total);
+}
+
+namespace {
+
+// Validates the result |ret| of a host-side transfer of at most |count| bytes,
+// then advances each non-null offset by the number of bytes transferred. The
+// host never writes the offsets, so they are updated from trusted state only.
+ssize_t FinishHostTransfer(bridge_ssize_t ret, size_t count, off_t *offset1,
+                           off_t *offset2) {
+  if (ret < 0) {
+    return -1;
+  }
+  if (static_cast<size_t>(ret) > count) {
+    errno = EIO;
+    return -1;
+  }
+  if (offset1) {
+    *offset1 += ret;
+  }
+  if (offset2) {
+    *offset2 += ret;
+  }
   return static_cast<ssize_t>(ret);
 }
 
+}  // namespace
+
+ssize_t enc_untrusted_sendfile(int out_fd, int in_fd, off_t *offset,
+                               size_t count) {
+  bridge_ssize_t ret;
+  int64_t tmp_offset = offset ? *offset : 0;
+  sgx_status_t status = ocall_enc_untrusted_sendfile(
+      &ret, out_fd, in_fd, offset ? &tmp_offset : nullptr,
+      static_cast<bridge_size_t>(count));
+  if (status != SGX_SUCCESS) {
+    errno = EINTR;
+    return -1;
+  }
+  return FinishHostTransfer(ret, count, offset, nullptr);
+}
+
+ssize_t enc_untrusted_splice(int fd_in, off_t *off_in, int fd_out,
+                             off_t *off_out, size_t len, unsigned int flags) {
+  bridge_ssize_t ret;
+  int64_t tmp_off_in = off_in ? *off_in : 0;
+  int64_t tmp_off_out = off_out ? *off_out : 0;
+  sgx_status_t status = ocall_enc_untrusted_splice(
+      &ret, fd_in, off_in ? &tmp_off_in : nullptr, fd_out,
+      off_out ? &tmp_off_out : nullptr, static_cast<bridge_size_t>(len),
+      flags);
+  if (status != SGX_SUCCESS) {
+    errno = EINTR;
+    return -1;
+  }
+  return FinishHostTransfer(ret, len, off_in, off_out);
+}
+
+ssize_t enc_untrusted_copy_file_range(int fd_in, off_t *off_in, int fd_out,
+                                      off_t *off_out, size_t len,
+                                      unsigned int flags) {
+  bridge_ssize_t ret;
+  int64_t tmp_off_in = off_in ? *off_in : 0;
+  int64_t tmp_off_out = off_out ? *off_out : 0;
+  sgx_status_t status = ocall_enc_untrusted_copy_file_range(
+      &ret, fd_in, off_in ? &tmp_off_in : nullptr, fd_out,
+      off_out ? &tmp_off_out : nullptr, static_cast<bridge_size_t>(len),
+      flags);
+  if (status != SGX_SUCCESS) {
+    errno = EINTR;
+    return -1;
+  }
+  return FinishHostTransfer(ret, len, off_in, off_out);
+}
+
 //////////////////////////////////////
 //             Sockets              //
 //////////////////////////////////////
@@ -425,6 +731,27 @@ int enc_untrusted_accept(int sockfd, struct sockaddr *addr,
   return ret;
 }
 
+int enc_untrusted_accept4(int sockfd, struct sockaddr *addr,
+                          socklen_t *addrlen, int flags) {
+  int ret;
+  struct bridge_sockaddr tmp;
+  bridge_size_t tmp_len = static_cast<bridge_size_t>(sizeof(tmp));
+  sgx_status_t status =
+      ocall_enc_untrusted_accept4(&ret, sockfd, &tmp, &tmp_len, flags);
+  if (status != SGX_SUCCESS) {
+    errno = EINTR;
+    return -1;
+  }
+  if (ret == -1) {
+    return ret;
+  }
+  if (addr && addrlen) {
+    FromBridgeSockaddr(&tmp, addr);
+    *addrlen = static_cast<socklen_t>(tmp_len);
+  }
+  return ret;
+}
+
 int enc_untrusted_bind(int sockfd, const struct sockaddr *addr,
                        socklen_t addrlen) {
   int ret;
@@ -491,6 +818,229 @@ ssize_t enc_untrusted_recvmsg(int sockfd, struct msghdr *msg, int flags) {
   return static_cast<ssize_t>(ret);
 }
 
+namespace {
+
+// Maximum number of messages accepted by sendmmsg and recvmmsg, matching the
+// Linux UIO_MAXIOV limit.
+constexpr unsigned int kMaxMmsgCount = 1024;
+
+// Location of the regions of one message within an untrusted mmsghdr arena,
+// as computed inside the enclave.
+struct UntrustedMmsgLayout {
+  char *name;
+  size_t name_size;
+  char *control;
+  size_t control_size;
+  char *data;
+  size_t data_size;
+};
+
+// Rounds |size| up to keep arena regions 8-byte aligned.
+size_t AlignArenaSize(size_t size) {
+  return (size + 7) & ~static_cast<size_t>(7);
+}
+
+// Builds an untrusted mirror of |msgvec| in a single allocation from
+// |scratch|. Each message gets its own iovec array, address, control and data
+// regions, whose locations are recorded in |layouts| so that callers never
+// read buffer addresses back from untrusted memory. No data is copied.
+bool create_untrusted_mmsg(asylo::UntrustedScratch *scratch,
+                           const struct mmsghdr *msgvec, unsigned int vlen,
+                           struct bridge_mmsghdr **untrusted_msgvec,
+                           std::vector<UntrustedMmsgLayout> *layouts) {
+  layouts->resize(vlen);
+  size_t total_size = AlignArenaSize(vlen * sizeof(struct bridge_mmsghdr));
+  for (unsigned int i = 0; i < vlen; ++i) {
+    const struct msghdr &msg = msgvec[i].msg_hdr;
+    UntrustedMmsgLayout &layout = (*layouts)[i];
+    if (msg.msg_iovlen > kMaxIovecCount) {
+      errno = EINVAL;
+      return false;
+    }
+    layout.name_size = msg.msg_name ? msg.msg_namelen : 0;
+    layout.control_size = msg.msg_control ? msg.msg_controllen : 0;
+    layout.data_size = 0;
+    for (size_t j = 0; j < msg.msg_iovlen; ++j) {
+      if (msg.msg_iov[j].iov_len > kMaxIovecBytes - layout.data_size) {
+        errno = EINVAL;
+        return false;
+      }
+      layout.data_size += msg.msg_iov[j].iov_len;
+    }
+    size_t size = AlignArenaSize(msg.msg_iovlen * sizeof(struct bridge_iovec)) +
+                  AlignArenaSize(layout.name_size) +
+                  AlignArenaSize(layout.control_size);
+    if (layout.data_size > kMaxIovecBytes - size ||
+        AlignArenaSize(size + layout.data_size) > kMaxIovecBytes - total_size) {
+      errno = EINVAL;
+      return false;
+    }
+    total_size += AlignArenaSize(size + layout.data_size);
+  }
+
+  char *arena = reinterpret_cast<char *>(scratch->Allocate(total_size));
+  if (!arena) {
+    errno = ENOMEM;
+    return false;
+  }
+  auto bridge_msgvec = reinterpret_cast<struct bridge_mmsghdr *>(arena);
+  char *next = arena + AlignArenaSize(vlen * sizeof(struct bridge_mmsghdr));
+  for (unsigned int i = 0; i < vlen; ++i) {
+    const struct msghdr &msg = msgvec[i].msg_hdr;
+    UntrustedMmsgLayout &layout = (*layouts)[i];
+    auto bridge_iov = reinterpret_cast<struct bridge_iovec *>(next);
+    next += AlignArenaSize(msg.msg_iovlen * sizeof(struct bridge_iovec));
+    layout.name = layout.name_size > 0 ? next : nullptr;
+    next += AlignArenaSize(layout.name_size);
+    layout.control = layout.control_size > 0 ? next : nullptr;
+    next += AlignArenaSize(layout.control_size);
+    layout.data = next;
+    size_t offset = 0;
+    for (size_t j = 0; j < msg.msg_iovlen; ++j) {
+      bridge_iov[j].iov_base = layout.data + offset;
+      bridge_iov[j].iov_len = msg.msg_iov[j].iov_len;
+      offset += msg.msg_iov[j].iov_len;
+    }
+    next += AlignArenaSize(layout.data_size);
+
+    struct bridge_msghdr *bridge_msg = &bridge_msgvec[i].msg_hdr;
+    bridge_msg->msg_name = layout.name;
+    bridge_msg->msg_namelen = layout.name_size;
+    bridge_msg->msg_iov = bridge_iov;
+    bridge_msg->msg_iovlen = msg.msg_iovlen;
+    bridge_msg->msg_control = layout.control;
+    bridge_msg->msg_controllen = layout.control_size;
+    bridge_msg->msg_flags = 0;
+    bridge_msgvec[i].msg_len = 0;
+  }
+  *untrusted_msgvec = bridge_msgvec;
+  return true;
+}
+
+}  // namespace
+
+int enc_untrusted_sendmmsg(int sockfd, struct mmsghdr *msgvec,
+                           unsigned int vlen, int flags) {
+  if (vlen > kMaxMmsgCount) {
+    vlen = kMaxMmsgCount;
+  }
+  asylo::UntrustedScratch scratch;
+  struct bridge_mmsghdr *untrusted_msgvec;
+  std::vector<UntrustedMmsgLayout> layouts;
+  if (!create_untrusted_mmsg(&scratch, msgvec, vlen, &untrusted_msgvec,
+                             &layouts)) {
+    return -1;
+  }
+  for (unsigned int i = 0; i < vlen; ++i) {
+    const struct msghdr &msg = msgvec[i].msg_hdr;
+    const UntrustedMmsgLayout &layout = layouts[i];
+    if (layout.name) {
+      memcpy(layout.name, msg.msg_name, layout.name_size);
+    }
+    if (layout.control) {
+      memcpy(layout.control, msg.msg_control, layout.control_size);
+    }
+    char *data = layout.data;
+    for (size_t j = 0; j < msg.msg_iovlen; ++j) {
+      asylo::BoundaryCopyOut(data, msg.msg_iov[j].iov_base,
+                             msg.msg_iov[j].iov_len);
+      data += msg.msg_iov[j].iov_len;
+    }
+  }
+
+  int ret;
+  sgx_status_t status = ocall_enc_untrusted_sendmmsg(
+      &ret, sockfd, untrusted_msgvec, vlen, flags);
+  if (status != SGX_SUCCESS) {
+    errno = EINTR;
+    return -1;
+  }
+  if (ret < 0) {
+    return ret;
+  }
+  if (static_cast<unsigned int>(ret) > vlen) {
+    errno = EIO;
+    return -1;
+  }
+  for (int i = 0; i < ret; ++i) {
+    uint32_t msg_len = untrusted_msgvec[i].msg_len;
+    if (msg_len > layouts[i].data_size) {
+      errno = EIO;
+      return -1;
+    }
+    msgvec[i].msg_len = msg_len;
+  }
+  return ret;
+}
+
+int enc_untrusted_recvmmsg(int sockfd, struct mmsghdr *msgvec,
+                           unsigned int vlen, int flags,
+                           struct timespec *timeout) {
+  if (vlen > kMaxMmsgCount) {
+    vlen = kMaxMmsgCount;
+  }
+  asylo::UntrustedScratch scratch;
+  struct bridge_mmsghdr *untrusted_msgvec;
+  std::vector<UntrustedMmsgLayout> layouts;
+  if (!create_untrusted_mmsg(&scratch, msgvec, vlen, &untrusted_msgvec,
+                             &layouts)) {
+    return -1;
+  }
+
+  int ret;
+  struct bridge_timespec bridge_timeout;
+  sgx_status_t status = ocall_enc_untrusted_recvmmsg(
+      &ret, sockfd, untrusted_msgvec, vlen, flags,
+      timeout ? ToBridgeTimespec(timeout, &bridge_timeout) : nullptr);
+  if (status != SGX_SUCCESS) {
+    errno = EINTR;
+    return -1;
+  }
+  if (ret < 0) {
+    return ret;
+  }
+  if (static_cast<unsigned int>(ret) > vlen) {
+    errno = EIO;
+    return -1;
+  }
+
+  // Every length reported by the host is checked against the regions laid out
+  // above before anything is copied into the enclave.
+  for (int i = 0; i < ret; ++i) {
+    struct msghdr *msg = &msgvec[i].msg_hdr;
+    const UntrustedMmsgLayout &layout = layouts[i];
+    const struct bridge_msghdr &bridge_msg = untrusted_msgvec[i].msg_hdr;
+    uint32_t msg_len = untrusted_msgvec[i].msg_len;
+    uint64_t name_size = bridge_msg.msg_namelen;
+    uint64_t control_size = bridge_msg.msg_controllen;
+    if (msg_len > layout.data_size || name_size > layout.name_size ||
+        control_size > layout.control_size) {
+      errno = EIO;
+      return -1;
+    }
+    if (layout.name) {
+      memcpy(msg->msg_name, layout.name, name_size);
+      msg->msg_namelen = name_size;
+    }
+    if (layout.control) {
+      memcpy(msg->msg_control, layout.control, control_size);
+      msg->msg_controllen = control_size;
+    }
+    msg->msg_flags = bridge_msg.msg_flags;
+
+    const char *data = layout.data;
+    size_t bytes_left = msg_len;
+    for (size_t j = 0; j < msg->msg_iovlen && bytes_left > 0; ++j) {
+      size_t bytes_to_copy = std::min(bytes_left, msg->msg_iov[j].iov_len);
+      asylo::BoundaryCopyIn(msg->msg_iov[j].iov_base, data, bytes_to_copy);
+      data += msg->msg_iov[j].iov_len;
+      bytes_left -= bytes_to_copy;
+    }
+    msgvec[i].msg_len = msg_len;
+  }
+  return ret;
+}
+
 const char *enc_untrusted_inet_ntop(int af, const void *src, char *dst,
                                     socklen_t size) {
   char *ret;
@@ -515,15 +1065,16 @@ const char *enc_untrusted_inet_ntop(int af, const void *src, char *dst,
 int enc_untrusted_getaddrinfo(const char *node, const char *service,
                               const struct addrinfo *hints,
                               struct addrinfo **res) {
-  std::string serialized_hints;
   struct addrinfo bridge_hints;
   if (hints) {
     bridge_hints = *hints;
     bridge_hints.ai_flags = ToBridgeAddressInfoFlags(bridge_hints.ai_flags);
   }
   // Serialize an empty addrinfo if |hints| is nullptr.
+  char *serialized_hints;
+  size_t serialized_hints_len;
   if (!asylo::SerializeAddrinfo(hints ? &bridge_hints : nullptr,
-                                &serialized_hints)) {
+                                &serialized_hints, &serialized_hints_len)) {
     return -1;
   }
 
@@ -531,9 +1082,10 @@ int enc_untrusted_getaddrinfo(const char *node, const char *service,
   char *tmp_serialized_res_start;
   bridge_size_t tmp_serialized_res_len;
   sgx_status_t status = ocall_enc_untrusted_getaddrinfo(
-      &ret, node, service, serialized_hints.c_str(),
-      static_cast<bridge_size_t>(serialized_hints.length()),
+      &ret, node, service, serialized_hints,
+      static_cast<bridge_size_t>(serialized_hints_len),
       &tmp_serialized_res_start, &tmp_serialized_res_len);
+  free(serialized_hints);
   if (status != SGX_SUCCESS) {
     errno = EINTR;
     return -1;
@@ -545,15 +1097,15 @@ int enc_untrusted_getaddrinfo(const char *node, const char *service,
     return -1;
   }
 
-  // Copy then free serialized res from untrusted memory
-  char tmp_serialized_res[tmp_serialized_res_len];
-  memcpy(tmp_serialized_res, tmp_serialized_res_start,
-         static_cast<size_t>(tmp_serialized_res_len));
-  enc_untrusted_free(tmp_serialized_res_start);
-
-  std::string serialized_res(tmp_serialized_res,
-                        static_cast<size_t>(tmp_serialized_res_len));
-  if (!asylo::DeserializeAddrinfo(&serialized_res, res)) return -1;
+  // DeserializeAddrinfo copies the untrusted result into trusted memory once
+  // before validating it, so it may be read in place.
+  asylo::UntrustedUniquePtr<char> serialized_res_ptr(tmp_serialized_res_start);
+  if (!asylo::DeserializeAddrinfo(
+          absl::string_view(tmp_serialized_res_start,
+                            static_cast<size_t>(tmp_serialized_res_len)),
+          res)) {
+    return -1;
+  }
   return ret;
 }
 
@@ -589,6 +1141,33 @@ int enc_untrusted_setsockopt(int sockfd, int level, int optname,
   return ret;
 }
 
+int enc_untrusted_setsockopts(int sockfd,
+                              const struct enc_int_sockopt *options,
+                              size_t count) {
+  // The options are marshalled through the enclave stack, so their number is
+  // bounded.
+  constexpr size_t kMaxSockopts = 32;
+  if (count > kMaxSockopts) {
+    errno = EINVAL;
+    return -1;
+  }
+  struct bridge_int_sockopt bridge_options[kMaxSockopts];
+  for (size_t i = 0; i < count; ++i) {
+    bridge_options[i].level = options[i].level;
+    bridge_options[i].option_name =
+        ToBridgeOptionName(options[i].level, options[i].option_name);
+    bridge_options[i].value = options[i].value;
+  }
+  int ret;
+  sgx_status_t status = ocall_enc_untrusted_setsockopts(
+      &ret, sockfd, bridge_options, static_cast<bridge_size_t>(count));
+  if (status != SGX_SUCCESS) {
+    errno = EINTR;
+    return -1;
+  }
+  return ret;
+}
+
 int enc_untrusted_getsockname(int sockfd, struct sockaddr *addr,
                               socklen_t *addrlen) {
   int ret;
@@ -635,6 +1214,30 @@ int enc_untrusted_create_thread(const char *name) {
   return 0;
 }
 
+int enc_untrusted_thread_wait() {
+  return enc_untrusted_thread_wait_timeout(/*timeout_ns=*/-1);
+}
+
+int enc_untrusted_thread_wait_timeout(int64_t timeout_ns) {
+  int ret;
+  sgx_status_t status = ocall_enc_untrusted_thread_wait(
+      &ret, static_cast<uint64_t>(enc_thread_self()), timeout_ns);
+  if (status != SGX_SUCCESS) {
+    return -1;
+  }
+  return ret;
+}
+
+int enc_untrusted_thread_wake(pthread_t thread) {
+  int ret;
+  sgx_status_t status =
+      ocall_enc_untrusted_thread_wake(&ret, static_cast<uint64_t>(thread));
+  if (status != SGX_SUCCESS) {
+    return -1;
+  }
+  return ret;
+}
+
 //////////////////////////////////////
 //           poll.h                 //
 //////////////////////////////////////
@@ -642,11 +1245,9 @@ int enc_untrusted_create_thread(const char *name) {
 int enc_untrusted_poll(struct pollfd *fds, nfds_t nfds, int timeout) {
   int ret;
   auto tmp = absl::make_unique<bridge_pollfd[]>(nfds);
-  for (int i = 0; i < nfds; ++i) {
-    if (!ToBridgePollfd(&fds[i], &tmp[i])) {
-      errno = EFAULT;
-      return -1;
-    }
+  if (nfds > 0 && !ToBridgePollfds(fds, nfds, tmp.get())) {
+    errno = EFAULT;
+    return -1;
   }
   sgx_status_t status =
       ocall_enc_untrusted_poll(&ret, tmp.get(), nfds, timeout);
@@ -654,11 +1255,72 @@ int enc_untrusted_poll(struct pollfd *fds, nfds_t nfds, int timeout) {
     errno = EINTR;
     return -1;
   }
-  for (int i = 0; i < nfds; ++i) {
-    if (!FromBridgePollfd(&tmp[i], &fds[i])) {
-      errno = EFAULT;
-      return -1;
-    }
+  if (nfds > 0 && !FromBridgePollfds(tmp.get(), nfds, fds)) {
+    errno = EFAULT;
+    return -1;
+  }
+  return ret;
+}
+
+//////////////////////////////////////
+//          sys/epoll.h             //
+//////////////////////////////////////
+
+int enc_untrusted_epoll_create1(int flags) {
+  int ret;
+  sgx_status_t status = ocall_enc_untrusted_epoll_create1(&ret, flags);
+  if (status != SGX_SUCCESS) {
+    errno = EINTR;
+    return -1;
+  }
+  return ret;
+}
+
+int enc_untrusted_epoll_ctl(int epfd, int op, int fd,
+                            struct epoll_event *event) {
+  int ret;
+  struct bridge_epoll_event bridge_event;
+  sgx_status_t status = ocall_enc_untrusted_epoll_ctl(
+      &ret, epfd, op, fd,
+      event ? ToBridgeEpollEvent(event, &bridge_event) : nullptr);
+  if (status != SGX_SUCCESS) {
+    errno = EINTR;
+    return -1;
+  }
+  return ret;
+}
+
+int enc_untrusted_epoll_wait(int epfd, struct epoll_event *events,
+                             int maxevents, int timeout) {
+  if (maxevents <= 0) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  // The host fills an untrusted array directly, so that only the |ret| ready
+  // events are copied into the enclave rather than all |maxevents| slots.
+  asylo::UntrustedScratch scratch;
+  auto bridge_events = reinterpret_cast<struct bridge_epoll_event *>(
+      scratch.Allocate(maxevents * sizeof(struct bridge_epoll_event)));
+  if (!bridge_events) {
+    errno = ENOMEM;
+    return -1;
+  }
+
+  int ret;
+  sgx_status_t status = ocall_enc_untrusted_epoll_wait(
+      &ret, epfd, bridge_events, maxevents, timeout);
+  if (status != SGX_SUCCESS) {
+    errno = EINTR;
+    return -1;
+  }
+  if (ret > maxevents) {
+    errno = EIO;
+    return -1;
+  }
+  // Each event is read from untrusted memory exactly once.
+  if (ret > 0) {
+    FromBridgeEpollEvents(bridge_events, ret, events);
   }
   return ret;
 }
@@ -685,7 +1347,8 @@ int enc_untrusted_getifaddrs(struct ifaddrs **ifap) {
     return -1;
   }
   asylo::UntrustedUniquePtr<char> ifaddrs_str_ptr(serialized_ifaddrs);
-  std::string ifaddrs_str(serialized_ifaddrs, serialized_ifaddrs_len);
+  absl::string_view ifaddrs_str(serialized_ifaddrs,
+                                static_cast<size_t>(serialized_ifaddrs_len));
   if (!asylo::DeserializeIfAddrs(ifaddrs_str, ifap)) return -1;
   return ret;
 }
@@ -725,6 +1388,33 @@ int enc_untrusted_sched_getaffinity(pid_t pid, size_t cpusetsize,
   return ret;
 }
 
+int enc_untrusted_sched_setaffinity(pid_t pid, size_t cpusetsize,
+                                    const cpu_set_t *mask) {
+  if (cpusetsize < sizeof(cpu_set_t)) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  // Translate from enclave cpu_set_t to bridge_cpu_set_t.
+  cpu_set_t enclave_mask = *mask;
+  BridgeCpuSet bridge_mask;
+  BridgeCpuSetZero(&bridge_mask);
+  for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+    if (CPU_ISSET(cpu, &enclave_mask)) {
+      BridgeCpuSetAddBit(cpu, &bridge_mask);
+    }
+  }
+
+  int ret;
+  sgx_status_t status = ocall_enc_untrusted_sched_setaffinity(
+      &ret, static_cast<int64_t>(pid), &bridge_mask);
+  if (status != SGX_SUCCESS) {
+    errno = EINTR;
+    return -1;
+  }
+  return ret;
+}
+
 //////////////////////////////////////
 //           signal.h               //
 //////////////////////////////////////
@@ -778,6 +1468,18 @@ void enc_untrusted_syslog(int priority, const char *message) {
   ocall_enc_untrusted_syslog(ToBridgeSysLogPriority(priority), message);
 }
 
+int enc_untrusted_syslog_batch(const uint8_t *records, size_t size) {
+  int ret;
+  sgx_status_t status = ocall_enc_untrusted_syslog_batch(
+      &ret, reinterpret_cast<const char *>(records),
+      static_cast<bridge_size_t>(size));
+  if (status != SGX_SUCCESS) {
+    errno = EINTR;
+    return -1;
+  }
+  return ret;
+}
+
 //////////////////////////////////////
 //           time.h                 //
 //////////////////////////////////////
@@ -876,6 +1578,21 @@ pid_t enc_untrusted_wait3(int *wstatus, int options, struct rusage *rusage) {
   return ret;
 }
 
+//////////////////////////////////////
+//             spawn.h              //
+//////////////////////////////////////
+
+int enc_untrusted_posix_spawn(const char *request, size_t size, pid_t *pid) {
+  int ret;
+  sgx_status_t status = ocall_enc_untrusted_posix_spawn(
+      &ret, request, static_cast<bridge_size_t>(size), pid);
+  if (status != SGX_SUCCESS) {
+    errno = EINTR;
+    return -1;
+  }
+  return ret;
+}
+
 //////////////////////////////////////
 //           Runtime support        //
 //////////////////////////////////////
@@ -0,0 +1,200 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/arch/include/trusted/sampling_profiler.h"
+
+#include <signal.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/ucontext.h>
+
+#include <atomic>
+#include <new>
+
+#include "common/inc/internal/arch.h"
+#include "common/inc/internal/global_data.h"
+#include "common/inc/internal/thread_data.h"
+#include "common/inc/sgx_trts.h"
+
+namespace asylo {
+namespace {
+
+// Maximum number of frames recorded per stack.
+constexpr int kMaxStackDepth = 64;
+
+// Indices of the frame pointer, stack pointer and instruction pointer in
+// ucontext_t gregs, which are passed in the order of the x86-64 Linux ABI.
+constexpr int kRegRbp = 10;
+constexpr int kRegRsp = 15;
+constexpr int kRegRip = 16;
+
+// Written to the exit information of a TCS's first SSA frame once the state
+// saved there has been sampled. Every asynchronous exit overwrites it, and it
+// is not a value an exit stores, so finding it means the thread has not been
+// interrupted inside the enclave since.
+constexpr uint32_t kSampledExitInfo = 0xffffffff;
+
+struct Sample {
+  std::atomic<bool> ready;
+  int depth;
+  uint64_t pcs[kMaxStackDepth];
+};
+
+// The sample buffer. Slots are claimed in order by the signal handler and
+// never reused.
+Sample *samples = nullptr;
+int sample_capacity = 0;
+std::atomic<int> next_sample(0);
+
+std::atomic<uint64_t> samples_outside_enclave(0);
+std::atomic<uint64_t> dropped_samples(0);
+
+uintptr_t ImageBase() { return reinterpret_cast<uintptr_t>(&__ImageBase); }
+
+bool IsEnclaveAddress(uint64_t address, size_t size) {
+  return address != 0 &&
+         sgx_is_within_enclave(reinterpret_cast<void *>(address), size);
+}
+
+// Stores the interrupted instruction, frame and stack pointers in |pc|, |fp|
+// and |sp|, and the end of the interrupted stack in |stack_base|, or 0 if it
+// is unknown. Returns false if the thread was not running enclave code.
+bool GetInterruptedState(const ucontext_t *ucontext, uint64_t *pc,
+                         uint64_t *fp, uint64_t *sp, uint64_t *stack_base) {
+  // In simulation, a signal which interrupts enclave code is handled on the
+  // interrupted stack, with the enclave registers in |ucontext|.
+  const greg_t *gregs = ucontext ? ucontext->uc_mcontext.gregs : nullptr;
+  if (gregs && IsEnclaveAddress(gregs[kRegRip], 1)) {
+    *pc = gregs[kRegRip];
+    *fp = gregs[kRegRbp];
+    *sp = gregs[kRegRsp];
+    *stack_base = 0;
+    return true;
+  }
+
+  // On hardware, the enclave was exited asynchronously and the signal handler
+  // entered it again on the same TCS, so the interrupted registers are in the
+  // first SSA frame.
+  thread_data_t *thread_data = get_thread_data();
+  ssa_gpr_t *ssa = reinterpret_cast<ssa_gpr_t *>(thread_data->first_ssa_gpr);
+  uint32_t exit_info;
+  memcpy(&exit_info, &ssa->exit_info, sizeof(exit_info));
+  if (exit_info == kSampledExitInfo || !IsEnclaveAddress(ssa->rip, 1)) {
+    return false;
+  }
+  *pc = ssa->rip;
+  *fp = ssa->rbp;
+  *sp = ssa->rsp;
+  *stack_base = thread_data->stack_base_addr;
+  memcpy(&ssa->exit_info, &kSampledExitInfo, sizeof(kSampledExitInfo));
+  return true;
+}
+
+// Records the stack starting at |pc| in |sample| by following the chain of
+// frame pointers from |fp|, which must lie between |sp| and |stack_base|.
+void WalkStack(uint64_t pc, uint64_t fp, uint64_t sp, uint64_t stack_base,
+               Sample *sample) {
+  uintptr_t image_base = ImageBase();
+  int depth = 0;
+  sample->pcs[depth++] = pc - image_base;
+  while (depth < kMaxStackDepth && fp >= sp && fp % sizeof(uint64_t) == 0 &&
+         (stack_base == 0 || fp + 2 * sizeof(uint64_t) <= stack_base) &&
+         IsEnclaveAddress(fp, 2 * sizeof(uint64_t))) {
+    const uint64_t *frame = reinterpret_cast<const uint64_t *>(fp);
+    uint64_t return_address = frame[1];
+    if (!IsEnclaveAddress(return_address, 1)) {
+      break;
+    }
+    sample->pcs[depth++] = return_address - image_base;
+    if (frame[0] <= fp) {
+      break;
+    }
+    fp = frame[0];
+  }
+  sample->depth = depth;
+}
+
+void HandleProfilingSignal(int signum, siginfo_t *info, void *ucontext) {
+  uint64_t pc, fp, sp, stack_base;
+  if (!GetInterruptedState(reinterpret_cast<ucontext_t *>(ucontext), &pc, &fp,
+                           &sp, &stack_base)) {
+    samples_outside_enclave.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+  int index = next_sample.fetch_add(1, std::memory_order_relaxed);
+  if (index >= sample_capacity) {
+    dropped_samples.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+  Sample *sample = &samples[index];
+  WalkStack(pc, fp, sp, stack_base, sample);
+  sample->ready.store(true, std::memory_order_release);
+}
+
+}  // namespace
+
+Status StartSamplingProfiler(int capacity) {
+  if (samples) {
+    return Status(error::GoogleError::FAILED_PRECONDITION,
+                  "The sampling profiler is already started");
+  }
+  if (capacity <= 0) {
+    return Status(error::GoogleError::INVALID_ARGUMENT,
+                  "The sampling profiler needs a positive capacity");
+  }
+  samples = new (std::nothrow) Sample[capacity]();
+  if (!samples) {
+    return Status(error::GoogleError::RESOURCE_EXHAUSTED,
+                  "Failed to allocate the sampling profiler buffer");
+  }
+  sample_capacity = capacity;
+
+  struct sigaction action;
+  memset(&action, 0, sizeof(action));
+  action.sa_sigaction = &HandleProfilingSignal;
+  action.sa_flags = SA_SIGINFO;
+  sigemptyset(&action.sa_mask);
+  if (sigaction(SIGPROF, &action, nullptr) != 0) {
+    return Status(error::GoogleError::INTERNAL,
+                  "Failed to install the SIGPROF handler");
+  }
+  return Status::OkStatus();
+}
+
+void GetSamplingProfile(EnclaveProfile *profile) {
+  int recorded = next_sample.load(std::memory_order_relaxed);
+  if (recorded > sample_capacity) {
+    recorded = sample_capacity;
+  }
+  for (int i = 0; i < recorded; ++i) {
+    const Sample &sample = samples[i];
+    // A sample claimed by a handler still running is skipped.
+    if (!sample.ready.load(std::memory_order_acquire)) {
+      continue;
+    }
+    EnclaveProfileSample *stack = profile->add_samples();
+    for (int frame = 0; frame < sample.depth; ++frame) {
+      stack->add_pcs(sample.pcs[frame]);
+    }
+  }
+  profile->set_samples_outside_enclave(
+      samples_outside_enclave.load(std::memory_order_relaxed));
+  profile->set_dropped_samples(dropped_samples.load(std::memory_order_relaxed));
+}
+
+}  // namespace asylo
@@ -19,12 +19,35 @@
 #include <enclave/enclave_syscalls.h>
 
 #include <errno.h>
+#include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 
+#include "asylo/platform/arch/include/trusted/heap.h"
+#include "asylo/platform/common/spin_lock.h"
 #include "common/inc/internal/global_data.h"
 
+extern "C" {
+
+// Heap usage statistics, reported alongside those of the SGX SDK tRTS.
+size_t g_peak_heap_used __attribute__((visibility("default"))) = 0;
+size_t g_committed_heap_size __attribute__((visibility("default"))) = 0;
+size_t g_peak_heap_committed __attribute__((visibility("default"))) = 0;
+
+// Adds and removes EPC pages through the SGX2 dynamic memory management
+// (EDMM) support of the tRTS. These are weak so that enclaves built against a
+// tRTS without EDMM fall back to committing the whole heap at load time.
+int apply_EPC_pages(void *start_address, size_t page_number)
+    __attribute__((weak));
+int trim_EPC_pages(void *start_address, size_t page_number)
+    __attribute__((weak));
+
+}  // extern "C"
+
 namespace {
 
+constexpr size_t kPageSize = 4096;
+
 // Pointer to start of the heap.
 void *heap_base = nullptr;
 
@@ -34,30 +57,96 @@ size_t heap_max_size = 0;
 // Current size of the heap in bytes.
 size_t heap_size = 0;
 
-}  // namespace
+// Number of bytes at the start of the heap committed at load time, which are
+// never trimmed.
+size_t heap_min_size = 0;
 
-extern "C" {
+// True if pages beyond |heap_min_size| are added and removed on demand.
+bool heap_edmm_enabled = false;
 
-size_t g_peak_heap_used __attribute__((visibility("default"))) = 0;
+// Number of bytes of address space reserved at the top of the heap by
+// enc_reserve_heap_address_space, which sbrk may not grow into.
+size_t heap_top_reserved = 0;
 
-int heap_init(void *_heap_base, size_t _heap_max_size, size_t _heap_min_size,
-              int _is_edmm_supported) {
-  heap_base = _heap_base;
-  heap_max_size = _heap_max_size;
-  // EDDM not supported so _heap_min_size and _is_edmm_supported are unused.
-  return 0;
+// Number of bytes at the start of the heap currently committed.
+size_t heap_committed_prefix = 0;
+
+// Number of bytes reserved at the top of the heap currently committed.
+size_t heap_committed_top = 0;
+
+// Serializes changes to the heap size. sbrk is normally called with the
+// allocator lock held, but ranges may be reserved concurrently.
+SpinLock heap_lock;
+
+// Holds heap_lock for the lifetime of the object.
+class HeapLockGuard {
+ public:
+  HeapLockGuard() { heap_lock.Acquire(); }
+  ~HeapLockGuard() { heap_lock.Release(); }
+};
+
+size_t round_up_to_page(size_t size) {
+  return (size + kPageSize - 1) & ~(kPageSize - 1);
 }
 
-// sbrk implementation for SGX enclaves.
-void *enclave_sbrk(int n) {
-  if (!heap_base) {
-    heap_init(&__ImageBase + g_global_data.heap_offset, g_global_data.heap_size,
-              0, 0);
+uint8_t *heap_address(size_t offset) {
+  return reinterpret_cast<uint8_t *>(heap_base) + offset;
+}
+
+void update_commit_stats() {
+  g_committed_heap_size = heap_committed_prefix + heap_committed_top;
+  if (g_peak_heap_committed < g_committed_heap_size) {
+    g_peak_heap_committed = g_committed_heap_size;
+  }
+}
+
+// Returns true if the |size| bytes at |address| form a page-aligned range
+// within the address space reserved at the top of the heap.
+bool in_heap_top(void *address, size_t size) {
+  uintptr_t start = reinterpret_cast<uintptr_t>(address);
+  uintptr_t top_end = reinterpret_cast<uintptr_t>(heap_address(heap_max_size));
+  uintptr_t top_start = top_end - heap_top_reserved;
+  return heap_base && (start % kPageSize) == 0 && (size % kPageSize) == 0 &&
+         start >= top_start && start <= top_end && size <= top_end - start;
+}
+
+// Commits or trims EPC pages so that the first |size| bytes of the heap are
+// backed. Returns false if pages could not be added. Requires heap_lock to be
+// held.
+bool commit_heap(size_t size) {
+  if (!heap_edmm_enabled) {
+    return true;
+  }
+  size_t target = round_up_to_page(size);
+  if (target < heap_min_size) {
+    target = heap_min_size;
   }
 
+  if (target > heap_committed_prefix) {
+    if (apply_EPC_pages(heap_address(heap_committed_prefix),
+                        (target - heap_committed_prefix) / kPageSize) != 0) {
+      return false;
+    }
+  } else if (target < heap_committed_prefix) {
+    // A failed trim leaves the pages committed and usable, so it is not
+    // reported to the caller.
+    if (trim_EPC_pages(heap_address(target),
+                       (heap_committed_prefix - target) / kPageSize) != 0) {
+      return true;
+    }
+  }
+  heap_committed_prefix = target;
+  update_commit_stats();
+  return true;
+}
+
+// Grows the heap by |n| bytes, or shrinks it if |n| is negative. Requires
+// heap_lock to be held.
+void *grow_heap(ssize_t n) {
   ssize_t new_heap_size = heap_size + n;
   if (heap_base == nullptr || new_heap_size < 0 ||
-      new_heap_size > heap_max_size) {
+      new_heap_size > heap_max_size - heap_top_reserved ||
+      !commit_heap(new_heap_size)) {
     errno = ENOMEM;
     return reinterpret_cast<void *>(-1);
   }
@@ -71,4 +160,125 @@ void *enclave_sbrk(int n) {
   return reinterpret_cast<void *>(prev_heap_end);
 }
 
+}  // namespace
+
+extern "C" {
+
+int heap_init(void *_heap_base, size_t _heap_max_size, size_t _heap_min_size,
+              int _is_edmm_supported) {
+  heap_base = _heap_base;
+  heap_max_size = _heap_max_size;
+  heap_edmm_enabled = _is_edmm_supported && apply_EPC_pages && trim_EPC_pages &&
+                      _heap_min_size < _heap_max_size;
+  // Without EDMM the whole heap is committed when the enclave is loaded.
+  heap_min_size =
+      heap_edmm_enabled ? round_up_to_page(_heap_min_size) : heap_max_size;
+  heap_committed_prefix = heap_min_size;
+  update_commit_stats();
+  return 0;
+}
+
+// Initializes the heap bounds on first use. Requires heap_lock to be held.
+static void heap_init_once() {
+  if (!heap_base) {
+    heap_init(&__ImageBase + g_global_data.heap_offset, g_global_data.heap_size,
+              0, 0);
+  }
+}
+
+// sbrk implementation for SGX enclaves.
+void *enclave_sbrk(int n) {
+  HeapLockGuard lock;
+  heap_init_once();
+  return grow_heap(n);
+}
+
+void *enc_reserve_heap_range(size_t size, size_t alignment) {
+  HeapLockGuard lock;
+  heap_init_once();
+  if (heap_base == nullptr || alignment == 0 ||
+      (alignment & (alignment - 1)) != 0) {
+    return nullptr;
+  }
+
+  // Pad the current break up to the requested alignment and grow the heap by
+  // the padding and the range together, so a failure leaves the heap as is.
+  uintptr_t heap_end = reinterpret_cast<uintptr_t>(heap_base) + heap_size;
+  size_t padding = -heap_end & (alignment - 1);
+  if (size > heap_max_size || padding > heap_max_size - size) {
+    return nullptr;
+  }
+  void *range_start = grow_heap(padding + size);
+  if (range_start == reinterpret_cast<void *>(-1)) {
+    return nullptr;
+  }
+  return reinterpret_cast<uint8_t *>(range_start) + padding;
+}
+
+void enc_get_heap_region(void **base, size_t *size) {
+  HeapLockGuard lock;
+  heap_init_once();
+  *base = heap_base;
+  *size = heap_max_size;
+}
+
+void enc_get_heap_usage(struct enc_heap_usage *usage) {
+  HeapLockGuard lock;
+  heap_init_once();
+  usage->max_size = heap_max_size;
+  usage->in_use = heap_size;
+  usage->peak_in_use = g_peak_heap_used;
+  usage->committed = g_committed_heap_size;
+  usage->peak_committed = g_peak_heap_committed;
+}
+
+void *enc_reserve_heap_address_space(size_t size) {
+  HeapLockGuard lock;
+  heap_init_once();
+  size = round_up_to_page(size);
+
+  // The range may not overlap the pages sbrk has handed out, nor, with EDMM,
+  // those committed for the bottom of the heap.
+  size_t floor = round_up_to_page(heap_size);
+  if (heap_edmm_enabled && floor < heap_committed_prefix) {
+    floor = heap_committed_prefix;
+  }
+  size_t top_start = heap_max_size - heap_top_reserved;
+  if (heap_base == nullptr || size == 0 || top_start < floor ||
+      size > top_start - floor) {
+    return nullptr;
+  }
+  heap_top_reserved += size;
+  return heap_address(top_start - size);
+}
+
+int enc_commit_heap_pages(void *address, size_t size) {
+  HeapLockGuard lock;
+  if (!in_heap_top(address, size)) {
+    return -1;
+  }
+  if (!heap_edmm_enabled) {
+    memset(address, 0, size);
+    return 0;
+  }
+  // Pages added through EDMM are zero-filled by the processor.
+  if (apply_EPC_pages(address, size / kPageSize) != 0) {
+    return -1;
+  }
+  heap_committed_top += size;
+  update_commit_stats();
+  return 0;
+}
+
+void enc_decommit_heap_pages(void *address, size_t size) {
+  HeapLockGuard lock;
+  if (!heap_edmm_enabled || !in_heap_top(address, size)) {
+    return;
+  }
+  if (trim_EPC_pages(address, size / kPageSize) == 0) {
+    heap_committed_top -= size;
+    update_commit_stats();
+  }
+}
+
 }  //  extern "C"
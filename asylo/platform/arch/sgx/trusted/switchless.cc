@@ -0,0 +1,237 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/arch/sgx/trusted/switchless.h"
+
+#include <time.h>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstring>
+#include <string>
+
+#include "asylo/platform/arch/include/trusted/enclave_interface.h"
+#include "asylo/platform/arch/include/trusted/host_calls.h"
+#include "asylo/platform/arch/include/trusted/switchless.h"
+#include "asylo/platform/arch/sgx/trusted/generated_bridge_t.h"
+#include "asylo/platform/common/spin_lock.h"
+
+namespace asylo {
+namespace {
+
+// The queue shared with the host, or nullptr if switchless mode is disabled.
+std::atomic<SwitchlessQueue *> switchless_queue(nullptr);
+
+// Trusted record of which request slots are in use. Slot ownership is never
+// read back from untrusted memory.
+std::array<std::atomic<bool>, kSwitchlessSlotCount> slot_in_use;
+
+// Serializes writers to the single-writer submission ring.
+SpinLock submit_lock;
+
+// Returns the index of |request| within |queue|.
+uint32_t SlotIndex(SwitchlessQueue *queue, SwitchlessRequest *request) {
+  return static_cast<uint32_t>(request - queue->slot(0));
+}
+
+// Calibrated costs of the two host call paths. Adaptive host calls use classic
+// ocalls while |exit_cost_ns| is zero.
+std::atomic<int64_t> exit_cost_ns(0);
+std::atomic<int64_t> request_cost_ns(0);
+std::atomic<int64_t> copy_cost_ps_per_byte(0);
+
+// Time of the last adaptive host call, and a moving average of the gaps
+// between adaptive host calls, in nanoseconds. Both are updated without
+// synchronization by all threads, which makes the average approximate but
+// keeps it off the critical path.
+std::atomic<int64_t> last_adaptive_call_ns(0);
+std::atomic<int64_t> mean_adaptive_gap_ns(kSwitchlessWorkerIdleNs * 2);
+
+// Gaps are capped before averaging, so that a burst of calls after an idle
+// period moves the average below kSwitchlessWorkerIdleNs within a few calls.
+constexpr int64_t kMaxAdaptiveGapNs = kSwitchlessWorkerIdleNs * 4;
+
+// Each gap moves the average by 1/kAdaptiveGapWeight of its distance.
+constexpr int64_t kAdaptiveGapWeight = 8;
+
+// Number of round trips timed to calibrate the costs of each path. The costs
+// are averaged, since the monotonic clock may only advance in steps of tens of
+// microseconds.
+constexpr int kRoundTripCalibrationRounds = 64;
+
+// Number of full payload copies timed to calibrate the per-byte copy cost.
+constexpr int kCopyCalibrationRounds = 256;
+
+int64_t MonotonicNanoseconds() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return static_cast<int64_t>(now.tv_sec) * 1000000000 + now.tv_nsec;
+}
+
+// Sends an empty request through the queue and waits for a worker to fail it.
+bool ProbeSwitchlessRequest() {
+  SwitchlessRequest *request = AcquireSwitchlessRequest(kSwitchlessProbeCallId);
+  if (!request) {
+    return false;
+  }
+  request->payload_size = 0;
+  bool serviced = SubmitSwitchlessRequestAndWait(request);
+  ReleaseSwitchlessRequest(request);
+  return serviced;
+}
+
+}  // namespace
+
+SwitchlessRequest *AcquireSwitchlessRequest(uint32_t call_id) {
+  SwitchlessQueue *queue = switchless_queue.load(std::memory_order_acquire);
+  if (!queue || queue->is_shutdown()) {
+    return nullptr;
+  }
+  for (uint32_t i = 0; i < kSwitchlessSlotCount; ++i) {
+    bool expected = false;
+    if (slot_in_use[i].compare_exchange_strong(expected, true,
+                                               std::memory_order_acquire)) {
+      SwitchlessRequest *request = queue->slot(i);
+      request->call_id = call_id;
+      return request;
+    }
+  }
+  return nullptr;
+}
+
+bool SubmitSwitchlessRequestAndWait(SwitchlessRequest *request) {
+  SwitchlessQueue *queue = switchless_queue.load(std::memory_order_acquire);
+  request->state.store(kSwitchlessSlotSubmitted, std::memory_order_release);
+
+  submit_lock.Acquire();
+  bool submitted = queue->Submit(SlotIndex(queue, request));
+  submit_lock.Release();
+  if (!submitted) {
+    return false;
+  }
+
+  // Requests already taken by a worker are serviced even after the host shuts
+  // down the queue, so it is safe to wait unconditionally here.
+  while (request->state.load(std::memory_order_acquire) !=
+         kSwitchlessSlotComplete) {
+    enc_pause();
+  }
+  return true;
+}
+
+void ReleaseSwitchlessRequest(SwitchlessRequest *request) {
+  SwitchlessQueue *queue = switchless_queue.load(std::memory_order_acquire);
+  slot_in_use[SlotIndex(queue, request)].store(false,
+                                               std::memory_order_release);
+}
+
+bool PreferSwitchlessRequest(size_t payload_size) {
+  int64_t now = MonotonicNanoseconds();
+  int64_t gap =
+      now - last_adaptive_call_ns.exchange(now, std::memory_order_relaxed);
+  gap = std::min(std::max(gap, int64_t{0}), kMaxAdaptiveGapNs);
+  int64_t mean = mean_adaptive_gap_ns.load(std::memory_order_relaxed);
+  mean += (gap - mean) / kAdaptiveGapWeight;
+  mean_adaptive_gap_ns.store(mean, std::memory_order_relaxed);
+
+  // Rare calls would wait for a sleeping worker, and leave the workers
+  // sleeping between them.
+  if (mean > kSwitchlessWorkerIdleNs) {
+    return false;
+  }
+  int64_t switchless_cost =
+      request_cost_ns.load(std::memory_order_relaxed) +
+      static_cast<int64_t>(payload_size) *
+          copy_cost_ps_per_byte.load(std::memory_order_relaxed) / 1000;
+  return switchless_cost < exit_cost_ns.load(std::memory_order_relaxed);
+}
+
+}  // namespace asylo
+
+extern "C" int enc_enable_switchless_host_calls(const char *enclave_name) {
+  std::string name =
+      std::string(ENC_SWITCHLESS_QUEUE_RESOURCE_PREFIX) + enclave_name;
+  void *addr =
+      enc_untrusted_acquire_shared_resource(kAddressName, name.c_str());
+  if (!addr || !enc_is_outside_enclave(addr, sizeof(asylo::SwitchlessQueue))) {
+    return -1;
+  }
+  // The queue is owned by the enclave client and outlives the enclave, so the
+  // reference taken above is not needed to keep it alive.
+  enc_untrusted_release_shared_resource(kAddressName, name.c_str());
+  auto *queue = static_cast<asylo::SwitchlessQueue *>(addr);
+  if (queue->InstanceVersion() != asylo::SwitchlessQueue::TypeVersion()) {
+    return -1;
+  }
+  asylo::switchless_queue.store(queue, std::memory_order_release);
+  return 0;
+}
+
+extern "C" int enc_calibrate_switchless_host_calls(
+    struct enc_switchless_costs *costs) {
+  // The first request wakes the workers, which may be sleeping.
+  if (!asylo::ProbeSwitchlessRequest()) {
+    return -1;
+  }
+  int64_t start = asylo::MonotonicNanoseconds();
+  for (int i = 0; i < asylo::kRoundTripCalibrationRounds; ++i) {
+    if (!asylo::ProbeSwitchlessRequest()) {
+      return -1;
+    }
+  }
+  int64_t request_ns = (asylo::MonotonicNanoseconds() - start) /
+                       asylo::kRoundTripCalibrationRounds;
+
+  // getpid() is about the cheapest host function, so its classic ocall is
+  // almost entirely the cost of leaving and re-entering the enclave.
+  start = asylo::MonotonicNanoseconds();
+  for (int i = 0; i < asylo::kRoundTripCalibrationRounds; ++i) {
+    pid_t pid;
+    ocall_enc_untrusted_getpid(&pid);
+  }
+  int64_t exit_ns = (asylo::MonotonicNanoseconds() - start) /
+                    asylo::kRoundTripCalibrationRounds;
+
+  asylo::SwitchlessRequest *request =
+      asylo::AcquireSwitchlessRequest(asylo::kSwitchlessProbeCallId);
+  if (!request) {
+    return -1;
+  }
+  static uint8_t payload[asylo::kSwitchlessPayloadSize];
+  start = asylo::MonotonicNanoseconds();
+  for (int i = 0; i < asylo::kCopyCalibrationRounds; ++i) {
+    memcpy(request->payload, payload, sizeof(payload));
+    // Keep the copies from being merged.
+    asm volatile("" : : : "memory");
+  }
+  int64_t copy_ps_per_byte =
+      (asylo::MonotonicNanoseconds() - start) * 1000 /
+      static_cast<int64_t>(asylo::kCopyCalibrationRounds * sizeof(payload));
+  asylo::ReleaseSwitchlessRequest(request);
+
+  asylo::request_cost_ns.store(request_ns, std::memory_order_relaxed);
+  asylo::copy_cost_ps_per_byte.store(copy_ps_per_byte,
+                                     std::memory_order_relaxed);
+  asylo::exit_cost_ns.store(exit_ns, std::memory_order_relaxed);
+  if (costs) {
+    costs->exit_ns = exit_ns;
+    costs->request_ns = request_ns;
+    costs->copy_ps_per_byte = copy_ps_per_byte;
+  }
+  return 0;
+}
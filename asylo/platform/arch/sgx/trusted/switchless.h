@@ -0,0 +1,55 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_PLATFORM_ARCH_SGX_TRUSTED_SWITCHLESS_H_
+#define ASYLO_PLATFORM_ARCH_SGX_TRUSTED_SWITCHLESS_H_
+
+// Trusted side of the switchless host call mechanism. These functions are
+// intended for use by the generated host call wrappers only.
+
+#include <cstddef>
+#include <cstdint>
+
+#include "asylo/platform/common/switchless_queue.h"
+
+namespace asylo {
+
+// Reserves a request slot for a host call identified by |call_id|. Returns
+// nullptr if switchless mode is not enabled or every slot is in use, in which
+// case the caller should make a classic ocall instead.
+SwitchlessRequest *AcquireSwitchlessRequest(uint32_t call_id);
+
+// Publishes a filled |request| to the host workers and waits for it to be
+// serviced. Returns false if the request could not be submitted because the
+// host has shut down the queue.
+bool SubmitSwitchlessRequestAndWait(SwitchlessRequest *request);
+
+// Returns a request slot obtained from AcquireSwitchlessRequest().
+void ReleaseSwitchlessRequest(SwitchlessRequest *request);
+
+// Records a call to a host call with the adaptive switchless policy, and
+// returns true if the call, marshalling |payload_size| bytes, should be made
+// through the switchless queue. It should if a switchless request and the
+// copy of its payload cost less than an enclave exit, and adaptive host calls
+// are being made often enough to keep the host workers awake. Returns false
+// until the costs are calibrated by enc_calibrate_switchless_host_calls().
+bool PreferSwitchlessRequest(size_t payload_size);
+
+}  // namespace asylo
+
+#endif  // ASYLO_PLATFORM_ARCH_SGX_TRUSTED_SWITCHLESS_H_
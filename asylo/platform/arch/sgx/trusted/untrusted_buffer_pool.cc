@@ -0,0 +1,81 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/arch/sgx/trusted/untrusted_buffer_pool.h"
+
+#include <cstdint>
+
+#include "asylo/platform/arch/include/trusted/host_calls.h"
+
+namespace asylo {
+namespace {
+
+// Alignment of every allocation carved out of a slab.
+constexpr size_t kSlabAlignment = 16;
+
+// The untrusted slab of the calling thread. Enclave threads are bound to a
+// TCS for the lifetime of the enclave, so slabs are never released.
+struct UntrustedSlab {
+  uint8_t *base;
+  size_t used;
+};
+
+thread_local UntrustedSlab slab = {nullptr, 0};
+
+// The untrusted staging buffer of the calling thread, which is likewise never
+// released.
+thread_local void *staging_buffer = nullptr;
+
+}  // namespace
+
+bool ReserveUntrustedSlab() {
+  if (!slab.base) {
+    slab.base =
+        static_cast<uint8_t *>(enc_untrusted_reserve(kUntrustedSlabSize));
+    slab.used = 0;
+  }
+  return slab.base != nullptr;
+}
+
+void *UntrustedStagingBuffer() {
+  if (!staging_buffer) {
+    staging_buffer = enc_untrusted_reserve(kUntrustedStagingBufferSize);
+  }
+  return staging_buffer;
+}
+
+UntrustedScratch::UntrustedScratch() : mark_(slab.used) {}
+
+UntrustedScratch::~UntrustedScratch() { slab.used = mark_; }
+
+void *UntrustedScratch::Allocate(size_t size) {
+  size_t aligned_size = (size + kSlabAlignment - 1) & ~(kSlabAlignment - 1);
+  if (aligned_size >= size && ReserveUntrustedSlab() &&
+      aligned_size <= kUntrustedSlabSize - slab.used) {
+    void *result = slab.base + slab.used;
+    slab.used += aligned_size;
+    return result;
+  }
+  void *result = enc_untrusted_malloc(size);
+  if (result) {
+    overflow_.emplace_back(result);
+  }
+  return result;
+}
+
+}  // namespace asylo
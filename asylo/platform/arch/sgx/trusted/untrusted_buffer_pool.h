@@ -0,0 +1,78 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_PLATFORM_ARCH_SGX_TRUSTED_UNTRUSTED_BUFFER_POOL_H_
+#define ASYLO_PLATFORM_ARCH_SGX_TRUSTED_UNTRUSTED_BUFFER_POOL_H_
+
+#include <cstddef>
+#include <vector>
+
+#include "asylo/platform/arch/include/trusted/memory.h"
+
+namespace asylo {
+
+// Size in bytes of the untrusted slab reserved for each enclave thread.
+constexpr size_t kUntrustedSlabSize = 64 * 1024;
+
+// Reserves the untrusted slab for the calling thread if it has not been
+// reserved yet. Costs a single ocall the first time it is called on a thread
+// and is free afterwards. Returns false if the allocation failed.
+bool ReserveUntrustedSlab();
+
+// Size in bytes of the untrusted staging buffer used by each enclave thread
+// for large reads and writes.
+constexpr size_t kUntrustedStagingBufferSize = 1024 * 1024;
+
+// Returns the calling thread's untrusted staging buffer of
+// kUntrustedStagingBufferSize bytes, allocating it the first time it is
+// requested on the thread, or nullptr if the allocation failed. Large
+// transfers stream through it chunk by chunk, so they reuse one buffer
+// instead of allocating a buffer of their full size for each host call.
+void *UntrustedStagingBuffer();
+
+// Scratch untrusted memory for marshalling the arguments of a single host
+// call. Allocations are carved out of the calling thread's untrusted slab by
+// bumping a pointer, and are all returned to the slab when the scratch object
+// is destroyed. Requests which do not fit in the remainder of the slab fall
+// back to enc_untrusted_malloc.
+//
+// Scratch objects on a thread must be destroyed in the reverse order of their
+// construction, which is naturally the case when they are used as locals.
+class UntrustedScratch {
+ public:
+  UntrustedScratch();
+  ~UntrustedScratch();
+
+  UntrustedScratch(const UntrustedScratch &) = delete;
+  UntrustedScratch &operator=(const UntrustedScratch &) = delete;
+
+  // Returns a pointer to |size| bytes of untrusted memory which remains valid
+  // for the lifetime of this object, or nullptr on failure.
+  void *Allocate(size_t size);
+
+ private:
+  // Offset into the thread's slab at which this scratch object started.
+  size_t mark_;
+
+  // Allocations which did not fit in the slab.
+  std::vector<UntrustedUniquePtr<void>> overflow_;
+};
+
+}  // namespace asylo
+
+#endif  // ASYLO_PLATFORM_ARCH_SGX_TRUSTED_UNTRUSTED_BUFFER_POOL_H_
@@ -0,0 +1,107 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/arch/sgx/untrusted/async_io_worker_pool.h"
+
+#include <errno.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#include "asylo/platform/arch/sgx/untrusted/host_call_dispatch.h"
+
+namespace asylo {
+namespace {
+
+// Performs the operation described by |request| and returns its result.
+int64_t PerformRequest(AsyncIoRequest *request) {
+  size_t name_length =
+      std::min<size_t>(request->name_length, kAsyncIoMaxTransfer);
+  size_t length = std::min<size_t>(request->length,
+                                   kAsyncIoMaxTransfer - name_length);
+  switch (request->opcode) {
+    case kAsyncIoRead:
+      return request->offset < 0
+                 ? read(request->host_fd, request->data, length)
+                 : pread(request->host_fd, request->data, length,
+                         request->offset);
+    case kAsyncIoWrite:
+      return request->offset < 0
+                 ? write(request->host_fd, request->data, length)
+                 : pwrite(request->host_fd, request->data, length,
+                          request->offset);
+    case kAsyncIoFsync:
+      return fsync(request->host_fd);
+    case kAsyncIoSendmsg: {
+      struct iovec iov;
+      iov.iov_base = request->data + name_length;
+      iov.iov_len = length;
+      struct msghdr msg = {};
+      msg.msg_name = name_length > 0 ? request->data : nullptr;
+      msg.msg_namelen = name_length;
+      msg.msg_iov = &iov;
+      msg.msg_iovlen = 1;
+      return sendmsg(request->host_fd, &msg, request->flags);
+    }
+    default:
+      errno = EINVAL;
+      return -1;
+  }
+}
+
+}  // namespace
+
+AsyncIoWorkerPool::AsyncIoWorkerPool(int num_workers)
+    : queue_(new AsyncIoQueue()) {
+  for (int i = 0; i < num_workers; ++i) {
+    workers_.emplace_back(&AsyncIoWorkerPool::WorkerLoop, this);
+  }
+}
+
+AsyncIoWorkerPool::~AsyncIoWorkerPool() { Stop(); }
+
+void AsyncIoWorkerPool::Stop() {
+  queue_->Shutdown();
+  for (std::thread &worker : workers_) {
+    worker.join();
+  }
+  workers_.clear();
+}
+
+void AsyncIoWorkerPool::WorkerLoop() {
+  while (true) {
+    uint32_t index;
+    {
+      std::lock_guard<std::mutex> lock(take_mutex_);
+      if (!queue_->TakeSubmission(&index)) {
+        return;
+      }
+    }
+    AsyncIoRequest *request = queue_->slot(index);
+    request->result = PerformRequest(request);
+    request->bridge_errno = request->result < 0 ? ErrnoToBridge(errno) : 0;
+    {
+      std::lock_guard<std::mutex> lock(complete_mutex_);
+      queue_->Complete(index);
+    }
+  }
+}
+
+}  // namespace asylo
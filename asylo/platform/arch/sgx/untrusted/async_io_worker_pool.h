@@ -0,0 +1,68 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_PLATFORM_ARCH_SGX_UNTRUSTED_ASYNC_IO_WORKER_POOL_H_
+#define ASYLO_PLATFORM_ARCH_SGX_UNTRUSTED_ASYNC_IO_WORKER_POOL_H_
+
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "asylo/platform/common/async_io_queue.h"
+
+namespace asylo {
+
+// A pool of host threads performing the asynchronous I/O operations submitted
+// by a single enclave.
+class AsyncIoWorkerPool {
+ public:
+  // Starts |num_workers| threads servicing a newly allocated queue.
+  explicit AsyncIoWorkerPool(int num_workers);
+
+  AsyncIoWorkerPool(const AsyncIoWorkerPool &) = delete;
+  AsyncIoWorkerPool &operator=(const AsyncIoWorkerPool &) = delete;
+
+  // Stops the pool if it is still running.
+  ~AsyncIoWorkerPool();
+
+  // Shuts down the queue, performs any operations already submitted, and joins
+  // all worker threads.
+  void Stop();
+
+  // Returns the queue serviced by this pool.
+  AsyncIoQueue *queue() { return queue_.get(); }
+
+ private:
+  // Top level loop run by each worker thread.
+  void WorkerLoop();
+
+  std::unique_ptr<AsyncIoQueue> queue_;
+
+  // Serializes readers of the single-reader submission ring.
+  std::mutex take_mutex_;
+
+  // Serializes writers to the single-writer completion ring.
+  std::mutex complete_mutex_;
+
+  std::vector<std::thread> workers_;
+};
+
+}  // namespace asylo
+
+#endif  // ASYLO_PLATFORM_ARCH_SGX_UNTRUSTED_ASYNC_IO_WORKER_POOL_H_
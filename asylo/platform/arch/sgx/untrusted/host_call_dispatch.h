@@ -0,0 +1,41 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_PLATFORM_ARCH_SGX_UNTRUSTED_HOST_CALL_DISPATCH_H_
+#define ASYLO_PLATFORM_ARCH_SGX_UNTRUSTED_HOST_CALL_DISPATCH_H_
+
+#include <cstddef>
+#include <cstdint>
+
+namespace asylo {
+
+// Invokes the generated host call |call_id| with the arguments marshalled in
+// the |payload_size| bytes at |payload|, and stores its return value and
+// errno, in bridge representation, in |result| and |bridge_errno|. Output
+// buffers are written back into |payload|. Malformed requests fail with
+// EFAULT. Defined by the host call code generator.
+void DispatchHostCall(uint32_t call_id, uint8_t *payload, size_t payload_size,
+                      int64_t *result, int32_t *bridge_errno);
+
+// Translates a host errno value to the bridge representation understood by
+// ErrnoFromBridge inside the enclave. Defined by the host call code generator.
+int ErrnoToBridge(int value);
+
+}  // namespace asylo
+
+#endif  // ASYLO_PLATFORM_ARCH_SGX_UNTRUSTED_HOST_CALL_DISPATCH_H_
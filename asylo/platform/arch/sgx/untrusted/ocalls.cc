@@ -22,26 +22,43 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <ifaddrs.h>
+#include <limits.h>
 #include <netdb.h>
 #include <poll.h>
 #include <sched.h>
 #include <signal.h>
+#include <spawn.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <sys/epoll.h>
+#include <sys/sendfile.h>
 #include <sys/socket.h>
 #include <sys/stat.h>
+#include <sys/syscall.h>
 #include <sys/time.h>
+#include <sys/uio.h>
 #include <sys/wait.h>
 #include <syslog.h>
 #include <time.h>
 #include <unistd.h>
 #include <algorithm>
+#include <memory>
+#include <unordered_map>
+#include <vector>
 
 #include "absl/memory/memory.h"
+#include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
 #include "asylo/platform/arch/sgx/untrusted/generated_bridge_u.h"
+#include "asylo/platform/arch/sgx/untrusted/host_call_dispatch.h"
 #include "asylo/platform/arch/sgx/untrusted/sgx_client.h"
-#include "asylo/platform/common/bridge_proto_serializer.h"
+#include "asylo/platform/common/bridge_flat_serializer.h"
 #include "asylo/platform/common/bridge_types.h"
+#include "asylo/platform/common/host_call_batch.h"
+#include "asylo/platform/common/huge_page_arena.h"
+#include "asylo/platform/common/spawn_request.h"
+#include "asylo/platform/common/syslog_batch.h"
 #include "asylo/platform/core/enclave_manager.h"
 #include "asylo/platform/core/shared_name.h"
 #include "asylo/util/status.h"
@@ -68,7 +85,11 @@ void TranslateToBridgeAndHandleSignal(int signum, siginfo_t *info,
   struct bridge_siginfo_t bridge_siginfo;
   ToBridgeSigInfo(info, &bridge_siginfo);
   if (handle_signal_inside_enclave) {
-    handle_signal_inside_enclave(bridge_signum, &bridge_siginfo, ucontext);
+    // The enclave's ucontext_t holds only the general registers, so pass it a
+    // pointer to those of the host context, which are laid out the same way.
+    handle_signal_inside_enclave(
+        bridge_signum, &bridge_siginfo,
+        reinterpret_cast<ucontext_t *>(ucontext)->uc_mcontext.gregs);
   }
 }
 
@@ -103,6 +124,51 @@ void HandleSignalInSim(int signum, siginfo_t *info, void *ucontext) {
   }
 }
 
+// An event an enclave thread sleeps on while it waits on the host. A wake
+// posted while the thread is not waiting is remembered, so its next wait
+// returns immediately.
+class ThreadEvent {
+ public:
+  // Waits until the event is woken or |timeout_ns| nanoseconds pass, waiting
+  // indefinitely if |timeout_ns| is negative.
+  void Wait(int64_t timeout_ns) {
+    absl::MutexLock lock(&mu_);
+    if (!signaled_) {
+      if (timeout_ns < 0) {
+        cv_.Wait(&mu_);
+      } else {
+        cv_.WaitWithTimeout(&mu_, absl::Nanoseconds(timeout_ns));
+      }
+    }
+    signaled_ = false;
+  }
+
+  void Wake() {
+    absl::MutexLock lock(&mu_);
+    signaled_ = true;
+    cv_.Signal();
+  }
+
+ private:
+  absl::Mutex mu_;
+  absl::CondVar cv_;
+  bool signaled_ GUARDED_BY(mu_) = false;
+};
+
+// Returns the event of the enclave thread with id |thread|. Thread ids are
+// reused by the enclave, so events are created on first use and never freed.
+ThreadEvent *GetThreadEvent(uint64_t thread) {
+  static absl::Mutex *events_mu = new absl::Mutex;
+  static auto *events =
+      new std::unordered_map<uint64_t, std::unique_ptr<ThreadEvent>>;
+  absl::MutexLock lock(events_mu);
+  std::unique_ptr<ThreadEvent> &event = (*events)[thread];
+  if (!event) {
+    event = absl::make_unique<ThreadEvent>();
+  }
+  return event.get();
+}
+
 }  // namespace
 
 // Threading implementation-defined untrusted thread donate routine.
@@ -125,6 +191,16 @@ void *ocall_enc_untrusted_malloc(bridge_size_t size) {
   return ret;
 }
 
+void *ocall_enc_untrusted_reserve(bridge_size_t size) {
+  return asylo::HugePageArena::Default()->Allocate(static_cast<size_t>(size));
+}
+
+void ocall_enc_untrusted_free_batch(void **ptrs, bridge_size_t count) {
+  for (bridge_size_t i = 0; i < count; ++i) {
+    free(ptrs[i]);
+  }
+}
+
 int ocall_enc_untrusted_open(const char *path_name, int flags, uint32_t mode) {
   int host_flags = FromBridgeFileFlags(flags);
   int ret = open(path_name, host_flags, mode);
@@ -181,15 +257,57 @@ int ocall_enc_untrusted_lstat(const char *pathname,
   return ret;
 }
 
-bridge_ssize_t ocall_enc_untrusted_write_with_untrusted_ptr(int fd,
-                                                            const void *buf,
-                                                            int size) {
-  return static_cast<bridge_ssize_t>(write(fd, buf, size));
+bridge_ssize_t ocall_enc_untrusted_writev_with_untrusted_ptrs(
+    int fd, const struct bridge_iovec *iov, int iovcnt) {
+  auto buf = absl::make_unique<struct iovec[]>(iovcnt);
+  if (iovcnt > 0 && !FromBridgeIovecs(iov, iovcnt, buf.get())) {
+    errno = EFAULT;
+    return -1;
+  }
+  return static_cast<bridge_ssize_t>(writev(fd, buf.get(), iovcnt));
 }
 
-bridge_ssize_t ocall_enc_untrusted_read_with_untrusted_ptr(int fd, void *buf,
-                                                           int size) {
-  return static_cast<bridge_ssize_t>(read(fd, buf, size));
+bridge_ssize_t ocall_enc_untrusted_readv_with_untrusted_ptrs(
+    int fd, const struct bridge_iovec *iov, int iovcnt) {
+  auto buf = absl::make_unique<struct iovec[]>(iovcnt);
+  if (iovcnt > 0 && !FromBridgeIovecs(iov, iovcnt, buf.get())) {
+    errno = EFAULT;
+    return -1;
+  }
+  return static_cast<bridge_ssize_t>(readv(fd, buf.get(), iovcnt));
+}
+
+bridge_ssize_t ocall_enc_untrusted_getdents64_with_untrusted_ptr(
+    int fd, void *buf, bridge_size_t count) {
+  return static_cast<bridge_ssize_t>(syscall(SYS_getdents64, fd, buf, count));
+}
+
+bridge_ssize_t ocall_enc_untrusted_sendfile(int out_fd, int in_fd,
+                                           int64_t *offset,
+                                           bridge_size_t count) {
+  off_t tmp_offset = offset ? *offset : 0;
+  return sendfile(out_fd, in_fd, offset ? &tmp_offset : nullptr, count);
+}
+
+bridge_ssize_t ocall_enc_untrusted_splice(int fd_in, int64_t *off_in,
+                                          int fd_out, int64_t *off_out,
+                                          bridge_size_t len,
+                                          unsigned int flags) {
+  loff_t tmp_off_in = off_in ? *off_in : 0;
+  loff_t tmp_off_out = off_out ? *off_out : 0;
+  return splice(fd_in, off_in ? &tmp_off_in : nullptr, fd_out,
+                off_out ? &tmp_off_out : nullptr, len, flags);
+}
+
+bridge_ssize_t ocall_enc_untrusted_copy_file_range(int fd_in, int64_t *off_in,
+                                                   int fd_out,
+                                                   int64_t *off_out,
+                                                   bridge_size_t len,
+                                                   unsigned int flags) {
+  loff_t tmp_off_in = off_in ? *off_in : 0;
+  loff_t tmp_off_out = off_out ? *off_out : 0;
+  return copy_file_range(fd_in, off_in ? &tmp_off_in : nullptr, fd_out,
+                         off_out ? &tmp_off_out : nullptr, len, flags);
 }
 
 //////////////////////////////////////
@@ -229,6 +347,20 @@ int ocall_enc_untrusted_accept(int sockfd, struct bridge_sockaddr *addr,
   return ret;
 }
 
+int ocall_enc_untrusted_accept4(int sockfd, struct bridge_sockaddr *addr,
+                                bridge_size_t *addrlen, int flags) {
+  struct sockaddr_storage tmp;
+  socklen_t tmp_len = sizeof(tmp);
+  int ret = accept4(sockfd, reinterpret_cast<struct sockaddr *>(&tmp),
+                    &tmp_len, flags);
+  if (ret == -1) {
+    return ret;
+  }
+  ToBridgeSockaddr(reinterpret_cast<struct sockaddr *>(&tmp), addr);
+  *addrlen = static_cast<bridge_size_t>(tmp_len);
+  return ret;
+}
+
 bridge_ssize_t ocall_enc_untrusted_sendmsg(int sockfd,
                                            const struct bridge_msghdr *msg,
                                            int flags) {
@@ -286,15 +418,101 @@ char *ocall_enc_untrusted_inet_ntop(int af, const void *src,
   return const_cast<char *>(ret);
 }
 
+namespace {
+
+// Maximum number of messages accepted by sendmmsg and recvmmsg.
+constexpr unsigned int kMaxMmsgCount = 1024;
+
+// Host-side views of an untrusted bridge_mmsghdr array.
+struct HostMmsgArray {
+  std::vector<struct mmsghdr> msgvec;
+  std::vector<std::vector<struct iovec>> iovs;
+};
+
+// Converts |bridge_msgvec| into |array|. Returns false if a message is
+// malformed.
+bool FromBridgeMmsgArray(const struct bridge_mmsghdr *bridge_msgvec,
+                         unsigned int vlen, HostMmsgArray *array) {
+  array->msgvec.resize(vlen);
+  array->iovs.resize(vlen);
+  for (unsigned int i = 0; i < vlen; ++i) {
+    const struct bridge_msghdr *bridge_msg = &bridge_msgvec[i].msg_hdr;
+    struct msghdr *msg = &array->msgvec[i].msg_hdr;
+    if (!FromBridgeMsgHdr(bridge_msg, msg) || msg->msg_iovlen > IOV_MAX) {
+      return false;
+    }
+    std::vector<struct iovec> &iov = array->iovs[i];
+    iov.resize(msg->msg_iovlen);
+    for (size_t j = 0; j < iov.size(); ++j) {
+      if (!FromBridgeIovec(&bridge_msg->msg_iov[j], &iov[j])) {
+        return false;
+      }
+    }
+    msg->msg_iov = iov.data();
+    array->msgvec[i].msg_len = 0;
+  }
+  return true;
+}
+
+// Copies the per-message results of the first |count| messages of |array|
+// back to |bridge_msgvec|.
+void ToBridgeMmsgResults(const HostMmsgArray &array, int count,
+                         struct bridge_mmsghdr *bridge_msgvec) {
+  for (int i = 0; i < count; ++i) {
+    const struct mmsghdr &mmsg = array.msgvec[i];
+    bridge_msgvec[i].msg_len = mmsg.msg_len;
+    bridge_msgvec[i].msg_hdr.msg_namelen = mmsg.msg_hdr.msg_namelen;
+    bridge_msgvec[i].msg_hdr.msg_controllen = mmsg.msg_hdr.msg_controllen;
+    bridge_msgvec[i].msg_hdr.msg_flags = mmsg.msg_hdr.msg_flags;
+  }
+}
+
+}  // namespace
+
+int ocall_enc_untrusted_sendmmsg(int sockfd,
+                                 struct bridge_mmsghdr *msgvec,
+                                 unsigned int vlen, int flags) {
+  HostMmsgArray array;
+  if (vlen > kMaxMmsgCount || !FromBridgeMmsgArray(msgvec, vlen, &array)) {
+    errno = EFAULT;
+    return -1;
+  }
+  int ret = sendmmsg(sockfd, array.msgvec.data(), vlen, flags);
+  if (ret > 0) {
+    ToBridgeMmsgResults(array, ret, msgvec);
+  }
+  return ret;
+}
+
+int ocall_enc_untrusted_recvmmsg(int sockfd,
+                                 struct bridge_mmsghdr *msgvec,
+                                 unsigned int vlen, int flags,
+                                 struct bridge_timespec *timeout) {
+  HostMmsgArray array;
+  if (vlen > kMaxMmsgCount || !FromBridgeMmsgArray(msgvec, vlen, &array)) {
+    errno = EFAULT;
+    return -1;
+  }
+  struct timespec tmp_timeout;
+  int ret = recvmmsg(sockfd, array.msgvec.data(), vlen, flags,
+                     timeout ? FromBridgeTimespec(timeout, &tmp_timeout)
+                             : nullptr);
+  if (ret > 0) {
+    ToBridgeMmsgResults(array, ret, msgvec);
+  }
+  return ret;
+}
+
 int ocall_enc_untrusted_getaddrinfo(const char *node, const char *service,
                                     const char *serialized_hints,
                                     bridge_size_t serialized_hints_len,
                                     char **serialized_res_start,
                                     bridge_size_t *serialized_res_len) {
   struct addrinfo *hints;
-  std::string tmp_serialized_hints(serialized_hints,
-                              static_cast<size_t>(serialized_hints_len));
-  if (!asylo::DeserializeAddrinfo(&tmp_serialized_hints, &hints)) {
+  if (!asylo::DeserializeAddrinfo(
+          absl::string_view(serialized_hints,
+                            static_cast<size_t>(serialized_hints_len)),
+          &hints)) {
     return -1;
   }
   if (hints) {
@@ -303,22 +521,20 @@ int ocall_enc_untrusted_getaddrinfo(const char *node, const char *service,
 
   struct addrinfo *res;
   int ret = getaddrinfo(node, service, hints, &res);
+  asylo::FreeDeserializedAddrinfo(hints);
   if (ret != 0) {
     return ret;
   }
-  asylo::FreeDeserializedAddrinfo(hints);
 
-  std::string tmp_serialized_res;
-  if (!asylo::SerializeAddrinfo(res, &tmp_serialized_res)) {
+  // The serialized result is allocated in a single buffer for the enclave to
+  // copy; enclave will free this.
+  size_t tmp_serialized_res_len;
+  bool serialized = asylo::SerializeAddrinfo(res, serialized_res_start,
+                                             &tmp_serialized_res_len);
+  freeaddrinfo(res);
+  if (!serialized) {
     return -1;
   }
-  freeaddrinfo(res);
-
-  // Allocate memory for the enclave to copy the result; enclave will free this.
-  size_t tmp_serialized_res_len = tmp_serialized_res.length();
-  char *serialized_res = static_cast<char *>(malloc(tmp_serialized_res_len));
-  memcpy(serialized_res, tmp_serialized_res.c_str(), tmp_serialized_res_len);
-  *serialized_res_start = serialized_res;
   *serialized_res_len = static_cast<bridge_size_t>(tmp_serialized_res_len);
   return ret;
 }
@@ -338,6 +554,21 @@ int ocall_enc_untrusted_setsockopt(int sockfd, int level, int optname,
                     static_cast<socklen_t>(optlen));
 }
 
+int ocall_enc_untrusted_setsockopts(int sockfd,
+                                    const struct bridge_int_sockopt *options,
+                                    bridge_size_t count) {
+  for (bridge_size_t i = 0; i < count; ++i) {
+    int value = options[i].value;
+    if (setsockopt(sockfd, options[i].level,
+                   FromBridgeOptionName(options[i].level,
+                                        options[i].option_name),
+                   &value, sizeof(value)) != 0) {
+      return -1;
+    }
+  }
+  return 0;
+}
+
 int ocall_enc_untrusted_getsockname(int sockfd, struct bridge_sockaddr *addr,
                                     bridge_size_t *addrlen) {
   struct sockaddr_storage tmp;
@@ -367,18 +598,43 @@ int ocall_enc_untrusted_getpeername(int sockfd, struct bridge_sockaddr *addr,
 int ocall_enc_untrusted_poll(struct bridge_pollfd *fds, unsigned int nfds,
                              int timeout) {
   auto tmp = absl::make_unique<pollfd[]>(nfds);
-  for (int i = 0; i < nfds; ++i) {
-    if (!FromBridgePollfd(&fds[i], &tmp[i])) {
-      errno = EFAULT;
-      return -1;
-    }
+  if (nfds > 0 && !FromBridgePollfds(fds, nfds, tmp.get())) {
+    errno = EFAULT;
+    return -1;
   }
   int ret = poll(tmp.get(), nfds, timeout);
-  for (int i = 0; i < nfds; ++i) {
-    if (!ToBridgePollfd(&tmp[i], &fds[i])) {
-      errno = EFAULT;
-      return -1;
-    }
+  if (nfds > 0 && !ToBridgePollfds(tmp.get(), nfds, fds)) {
+    errno = EFAULT;
+    return -1;
+  }
+  return ret;
+}
+
+//////////////////////////////////////
+//          sys/epoll.h             //
+//////////////////////////////////////
+
+int ocall_enc_untrusted_epoll_create1(int flags) {
+  return epoll_create1(flags);
+}
+
+int ocall_enc_untrusted_epoll_ctl(int epfd, int op, int fd,
+                                  struct bridge_epoll_event *event) {
+  struct epoll_event tmp;
+  return epoll_ctl(epfd, op, fd,
+                   event ? FromBridgeEpollEvent(event, &tmp) : nullptr);
+}
+
+int ocall_enc_untrusted_epoll_wait(int epfd, struct bridge_epoll_event *events,
+                                   int maxevents, int timeout) {
+  if (maxevents <= 0) {
+    errno = EINVAL;
+    return -1;
+  }
+  auto tmp = absl::make_unique<struct epoll_event[]>(maxevents);
+  int ret = epoll_wait(epfd, tmp.get(), maxevents, timeout);
+  if (ret > 0) {
+    ToBridgeEpollEvents(tmp.get(), ret, events);
   }
   return ret;
 }
@@ -433,6 +689,21 @@ int ocall_enc_untrusted_sched_getaffinity(int64_t pid, BridgeCpuSet *mask) {
   return ret;
 }
 
+int ocall_enc_untrusted_sched_setaffinity(int64_t pid,
+                                          struct BridgeCpuSet *mask) {
+  // Translate from bridge_cpu_set_t to host cpu_set_t.
+  cpu_set_t host_mask;
+  CPU_ZERO(&host_mask);
+  for (int cpu = 0; cpu < BRIDGE_CPU_SET_MAX_CPUS && cpu < CPU_SETSIZE;
+       ++cpu) {
+    if (BridgeCpuSetCheckBit(cpu, mask)) {
+      CPU_SET(cpu, &host_mask);
+    }
+  }
+  return sched_setaffinity(static_cast<pid_t>(pid), sizeof(cpu_set_t),
+                           &host_mask);
+}
+
 //////////////////////////////////////
 //          signal.h                //
 //////////////////////////////////////
@@ -500,6 +771,16 @@ void ocall_enc_untrusted_syslog(int priority, const char *message) {
   syslog(FromBridgeSysLogPriority(priority), "%s", message);
 }
 
+int ocall_enc_untrusted_syslog_batch(const char *records, bridge_size_t size) {
+  bool well_formed = asylo::ForEachSyslogRecord(
+      reinterpret_cast<const uint8_t *>(records), size,
+      [](int32_t priority, const char *message, size_t length) {
+        syslog(FromBridgeSysLogPriority(priority), "%.*s",
+               static_cast<int>(length), message);
+      });
+  return well_formed ? 0 : -1;
+}
+
 //////////////////////////////////////
 //           time.h                 //
 //////////////////////////////////////
@@ -562,6 +843,60 @@ pid_t ocall_enc_untrusted_wait3(struct BridgeWStatus *wstatus, int options,
   return ret;
 }
 
+//////////////////////////////////////
+//             spawn.h              //
+//////////////////////////////////////
+
+int ocall_enc_untrusted_posix_spawn(const char *request, bridge_size_t size,
+                                    pid_t *pid) {
+  asylo::SpawnRequest spawn_request;
+  if (!asylo::DeserializeSpawnRequest(request, size, &spawn_request)) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  posix_spawn_file_actions_t file_actions;
+  int ret = posix_spawn_file_actions_init(&file_actions);
+  if (ret != 0) {
+    errno = ret;
+    return -1;
+  }
+  for (const asylo::SpawnFileAction &action : spawn_request.file_actions) {
+    switch (action.type) {
+      case asylo::SpawnFileAction::kClose:
+        ret = posix_spawn_file_actions_addclose(&file_actions, action.fd);
+        break;
+      case asylo::SpawnFileAction::kDup2:
+        ret = posix_spawn_file_actions_adddup2(&file_actions, action.fd,
+                                               action.new_fd);
+        break;
+      case asylo::SpawnFileAction::kOpen:
+        ret = posix_spawn_file_actions_addopen(
+            &file_actions, action.fd, action.path,
+            FromBridgeFileFlags(action.flags), action.mode);
+        break;
+    }
+    if (ret != 0) {
+      break;
+    }
+  }
+  if (ret == 0) {
+    ret = spawn_request.search_path
+              ? posix_spawnp(pid, spawn_request.path, &file_actions,
+                             /*attrp=*/nullptr, spawn_request.argv.data(),
+                             spawn_request.envp.data())
+              : posix_spawn(pid, spawn_request.path, &file_actions,
+                            /*attrp=*/nullptr, spawn_request.argv.data(),
+                            spawn_request.envp.data());
+  }
+  posix_spawn_file_actions_destroy(&file_actions);
+  if (ret != 0) {
+    errno = ret;
+    return -1;
+  }
+  return 0;
+}
+
 //////////////////////////////////////
 //           Runtime support        //
 //////////////////////////////////////
@@ -590,6 +925,17 @@ int ocall_enc_untrusted_release_shared_resource(SharedNameKind kind,
   return false;
 }
 
+int ocall_enc_untrusted_batch(void *records, bridge_size_t size) {
+  bool well_formed = asylo::ForEachHostCallRecord(
+      static_cast<uint8_t *>(records), static_cast<size_t>(size),
+      [](asylo::HostCallRecord *record, uint8_t *payload,
+         size_t payload_size) {
+        asylo::DispatchHostCall(record->call_id, payload, payload_size,
+                                &record->result, &record->bridge_errno);
+      });
+  return well_formed ? 0 : -1;
+}
+
 //////////////////////////////////////
 //           Debugging              //
 //////////////////////////////////////
@@ -610,3 +956,13 @@ int ocall_enc_untrusted_thread_create(const char *name) {
   __asylo_donate_thread(name);
   return 0;
 }
+
+int ocall_enc_untrusted_thread_wait(uint64_t self, int64_t timeout_ns) {
+  GetThreadEvent(self)->Wait(timeout_ns);
+  return 0;
+}
+
+int ocall_enc_untrusted_thread_wake(uint64_t thread) {
+  GetThreadEvent(thread)->Wake();
+  return 0;
+}
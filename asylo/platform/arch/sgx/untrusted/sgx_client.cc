@@ -18,20 +18,39 @@
 
 #include "asylo/platform/arch/sgx/untrusted/sgx_client.h"
 
+#include <pthread.h>
+#include <string.h>
+
+#include <algorithm>
+#include <map>
 #include <string>
+#include <vector>
 
 #include "absl/strings/str_cat.h"
 #include "asylo/enclave.pb.h"
 #include "asylo/util/logging.h"
 #include "asylo/platform/arch/sgx/untrusted/generated_bridge_u.h"
 #include "asylo/platform/arch/sgx/untrusted/sgx_error_space.h"
+#include "asylo/platform/arch/include/trusted/async_io.h"
+#include "asylo/platform/arch/include/trusted/switchless.h"
+#include "asylo/platform/arch/sgx_sim/untrusted/transition_costs.h"
 #include "asylo/platform/common/bridge_types.h"
+#include "asylo/platform/common/cpu_topology.h"
+#include "asylo/platform/core/shared_name.h"
+#include "asylo/platform/core/startup_timing.h"
 #include "asylo/util/posix_error_space.h"
 
 namespace asylo {
 
 constexpr int kMaxEnclaveCreateAttempts = 5;
 
+// Initial size of the output buffer registered for EnterAndRun.
+constexpr size_t kInitialRunBufferSize = 4096;
+
+// Size above which EnterAndRun does not grow its registered buffers, and
+// transfers the message through buffers allocated for the call instead.
+constexpr size_t kMaxRunBufferSize = 1 << 20;
+
 
 // Enters the enclave and invokes the initialization entry-point. If the ecall
 // fails, or the enclave does not return any output, returns a non-OK status. In
@@ -81,6 +100,81 @@ static Status run(sgx_enclave_id_t eid, const char *input, size_t input_len,
   return Status::OkStatus();
 }
 
+// Enters the enclave and invokes the batch execution entry-point. If the ecall
+// fails, or the enclave does not return any output, returns a non-OK status.
+// Otherwise, |output| points to a buffer of length *|output_len| that contains
+// output from the enclave.
+static Status run_batch(sgx_enclave_id_t eid, const char *input,
+                        size_t input_len, char **output, size_t *output_len) {
+  int result;
+  sgx_status_t sgx_status = ecall_run_batch(
+      eid, &result, input, static_cast<bridge_size_t>(input_len), output,
+      static_cast<bridge_size_t *>(output_len));
+  if (sgx_status != SGX_SUCCESS) {
+    // Return a Status object in the SGX error space.
+    return Status(sgx_status, "Call to ecall_run_batch failed");
+  } else if (result || *output_len == 0) {
+    // Ecall succeeded but did not return a value. The indicates that the
+    // trusted code failed to propagate error information over the enclave
+    // boundary (e.g. serialization failure).
+    return Status(error::GoogleError::INTERNAL, "No output from enclave");
+  }
+
+  return Status::OkStatus();
+}
+
+// Enters the enclave and invokes the execution entry-point on caller-owned
+// untrusted buffers. If the ecall fails, or the enclave does not return any
+// output, returns a non-OK status. Otherwise, |output| points to a buffer of
+// length *|output_len| that contains output from the enclave. That buffer is
+// |output_buffer| if the output fit in it, and is allocated by the enclave
+// otherwise.
+static Status run_with_buffers(sgx_enclave_id_t eid, const char *input,
+                               size_t input_len, char *output_buffer,
+                               size_t output_capacity, char **output,
+                               size_t *output_len) {
+  int result;
+  sgx_status_t sgx_status = ecall_run_with_buffers(
+      eid, &result, input, static_cast<bridge_size_t>(input_len),
+      output_buffer, static_cast<bridge_size_t>(output_capacity), output,
+      static_cast<bridge_size_t *>(output_len));
+  if (sgx_status != SGX_SUCCESS) {
+    // Return a Status object in the SGX error space.
+    return Status(sgx_status, "Call to ecall_run_with_buffers failed");
+  } else if (result || *output_len == 0) {
+    // Ecall succeeded but did not return a value. The indicates that the
+    // trusted code failed to propagate error information over the enclave
+    // boundary (e.g. serialization failure).
+    return Status(error::GoogleError::INTERNAL, "No output from enclave");
+  }
+
+  return Status::OkStatus();
+}
+
+// Enters the enclave and invokes the raw execution entry-point. If the ecall
+// fails, returns a non-OK status. Otherwise, |output| points to a buffer of
+// length *|output_len|, which is |output_buffer| if the output fit in it and is
+// allocated by the enclave otherwise, and *|status_code| is the canonical error
+// code returned by the enclave.
+static Status run_raw(sgx_enclave_id_t eid, const char *input,
+                      size_t input_len, char *output_buffer,
+                      size_t output_capacity, char **output,
+                      size_t *output_len, int *status_code) {
+  int result;
+  sgx_status_t sgx_status = ecall_run_raw(
+      eid, &result, input, static_cast<bridge_size_t>(input_len),
+      output_buffer, static_cast<bridge_size_t>(output_capacity), output,
+      static_cast<bridge_size_t *>(output_len), status_code);
+  if (sgx_status != SGX_SUCCESS) {
+    // Return a Status object in the SGX error space.
+    return Status(sgx_status, "Call to ecall_run_raw failed");
+  } else if (result) {
+    return Status(error::GoogleError::INTERNAL, "No output from enclave");
+  }
+
+  return Status::OkStatus();
+}
+
 // Enters the enclave and invokes the finalization entry-point. If the ecall
 // fails, or the enclave does not return any output, returns a non-OK status. In
 // this case, the caller cannot make any assumptions about the contents of
@@ -104,6 +198,41 @@ static Status finalize(sgx_enclave_id_t eid, const char *input,
   return Status::OkStatus();
 }
 
+static Status reset(sgx_enclave_id_t eid, const char *input, size_t input_len,
+                    char **output, size_t *output_len) {
+  int result;
+  sgx_status_t sgx_status =
+      ecall_reset(eid, &result, input, static_cast<bridge_size_t>(input_len),
+                  output, static_cast<bridge_size_t *>(output_len));
+  if (sgx_status != SGX_SUCCESS) {
+    // Return a Status object in the SGX error space.
+    return Status(sgx_status, "Call to ecall_reset failed");
+  } else if (result || *output_len == 0) {
+    // Non-zero return code indicates that the enclave was not able to return
+    // any output from Reset().
+    return Status(error::GoogleError::INTERNAL, "No output from enclave");
+  }
+
+  return Status::OkStatus();
+}
+
+static Status snapshot(sgx_enclave_id_t eid, char **output,
+                       size_t *output_len) {
+  int result;
+  sgx_status_t sgx_status = ecall_snapshot(
+      eid, &result, output, static_cast<bridge_size_t *>(output_len));
+  if (sgx_status != SGX_SUCCESS) {
+    // Return a Status object in the SGX error space.
+    return Status(sgx_status, "Call to ecall_snapshot failed");
+  } else if (result || *output_len == 0) {
+    // Non-zero return code indicates that the enclave was not able to return
+    // any output from Snapshot().
+    return Status(error::GoogleError::INTERNAL, "No output from enclave");
+  }
+
+  return Status::OkStatus();
+}
+
 static int donate_thread(sgx_enclave_id_t eid, sgx_status_t *status) {
   int result;
   sgx_status_t local_status = ecall_donate_thread(eid, &result);
@@ -154,14 +283,17 @@ StatusOr<std::unique_ptr<EnclaveClient>> SGXLoader::LoadEnclave(
   int updated;
   sgx_status_t rc;
   int attempts = kMaxEnclaveCreateAttempts;
+  StartupPhaseTimer timer(client->mutable_startup_timing());
   do {
     rc = sgx_create_enclave(path_.c_str(), debug_ ? 1 : 0, &client->token_,
                             &updated, &client->id_, nullptr);
   } while (rc == SGX_INTERNAL_ERROR_ENCLAVE_CREATE_INTERRUPTED &&
            --attempts > 0);
+  timer.EndPhase("sgx_create_enclave");
   if (rc != SGX_SUCCESS) {
     return Status(rc, "Failed to create an enclave");
   }
+  client->debug_ = debug_;
   return std::unique_ptr<EnclaveClient>(client.release());
 }
 
@@ -172,6 +304,56 @@ Status SGXClient::EnterAndInitialize(const EnclaveConfig &config) {
                   "Failed to serialize EnclaveConfig");
   }
 
+  // The profiler reads the state saved by asynchronous exits, which is only
+  // meaningful to expose from debug enclaves.
+  if (config.profiler_sample_capacity() > 0 && !debug_) {
+    return Status(error::GoogleError::FAILED_PRECONDITION,
+                  "The sampling profiler requires a debug enclave");
+  }
+
+  if (config.has_donated_thread_affinity()) {
+    Status status = SetDonatedThreadAffinity(config.donated_thread_affinity());
+    if (!status.ok()) {
+      return status;
+    }
+  }
+
+  if (config.has_sim_transition_profile()) {
+    ConfigureSimTransitionCosts(config.sim_transition_profile());
+  }
+
+  StartupPhaseTimer timer(mutable_startup_timing());
+  if (config.switchless_worker_threads() > 0) {
+    Status status = StartSwitchlessWorkers(config.switchless_worker_threads());
+    if (!status.ok()) {
+      return status;
+    }
+    timer.EndPhase("switchless_workers");
+  }
+
+  if (config.run_slots() > 0) {
+    run_dispatcher_.reset(new SlotDispatcher(config.run_slots()));
+  }
+
+  if (config.async_run_queue_capacity() > 0) {
+    // One worker per run slot keeps asynchronous calls from ever waiting on
+    // the dispatcher for a TCS.
+    if (config.run_slots() <= 0) {
+      return Status(error::GoogleError::INVALID_ARGUMENT,
+                    "async_run_queue_capacity requires positive run_slots");
+    }
+    async_run_pool_.reset(new BoundedWorkerPool(
+        config.run_slots(), config.async_run_queue_capacity()));
+  }
+
+  if (config.async_io_worker_threads() > 0) {
+    Status status = StartAsyncIoWorkers(config.async_io_worker_threads());
+    if (!status.ok()) {
+      return status;
+    }
+    timer.EndPhase("async_io_workers");
+  }
+
   char *output = nullptr;
   size_t output_len = 0;
   Status status = initialize(id_, get_name().c_str(), buf.data(), buf.size(),
@@ -182,22 +364,116 @@ Status SGXClient::EnterAndInitialize(const EnclaveConfig &config) {
 
   // Enclave entry-point was successfully invoked. |output| is guaranteed to
   // have a value.
-  StatusProto status_proto;
-  if (!status_proto.ParseFromArray(output, output_len)) {
-    return Status(error::GoogleError::INTERNAL,
-                  "Failed to deserialize StatusProto");
-  }
-  status.RestoreFrom(status_proto);
+  EnclaveOutput local_output;
+  bool parsed = local_output.ParseFromArray(output, output_len);
 
   // |output| points to an untrusted memory buffer allocated by the enclave. It
   // is the untrusted caller's responsibility to free this buffer.
   free(output);
 
+  if (!parsed) {
+    return Status(error::GoogleError::INTERNAL,
+                  "Failed to deserialize EnclaveOutput");
+  }
+  status.RestoreFrom(local_output.status());
+  mutable_startup_timing()->MergeFrom(local_output.startup_timing());
+  timer.EndPhase("initialize_ecall");
+
+  if (status.ok() && config.thread_pool_size() > 0) {
+    DonateThreadPool(config.thread_pool_size());
+    timer.EndPhase("donate_thread_pool");
+  }
   return status;
 }
 
 Status SGXClient::EnterAndRun(const EnclaveInput &input,
                               EnclaveOutput *output) {
+  // The registered buffers serve one call at a time. Calls made while they are
+  // in use by another thread fall back to buffers allocated for the call.
+  if (!run_buffers_mutex_.TryLock()) {
+    return EnterAndRunWithCopies(input, output);
+  }
+  Status status = EnterAndRunWithBuffers(input, output);
+  run_buffers_mutex_.Unlock();
+  return status;
+}
+
+Status SGXClient::EnterAndRunAsync(const EnclaveInput &input,
+                                   RunCallback callback) {
+  if (!async_run_pool_) {
+    return Status(error::GoogleError::FAILED_PRECONDITION,
+                  "Asynchronous calls are not enabled for this enclave");
+  }
+  bool submitted = async_run_pool_->TrySubmit([this, input, callback] {
+    EnclaveOutput output;
+    Status status = EnterAndRun(input, &output);
+    callback(status, output);
+  });
+  if (!submitted) {
+    return Status(error::GoogleError::RESOURCE_EXHAUSTED,
+                  "The queue of asynchronous calls is full or the enclave "
+                  "is being finalized");
+  }
+  return Status::OkStatus();
+}
+
+Status SGXClient::EnterAndRunWithBuffers(const EnclaveInput &input,
+                                         EnclaveOutput *output) {
+  size_t input_len = input.ByteSizeLong();
+  if (input_len > kMaxRunBufferSize) {
+    return EnterAndRunWithCopies(input, output);
+  }
+  if (run_input_buffer_.size() < input_len) {
+    run_input_buffer_.resize(input_len);
+  }
+  if (!input.SerializeToArray(run_input_buffer_.data(), input_len)) {
+    return Status(error::GoogleError::INVALID_ARGUMENT,
+                  "Failed to serialize EnclaveInput");
+  }
+  if (run_output_buffer_.empty()) {
+    run_output_buffer_.resize(kInitialRunBufferSize);
+  }
+
+  char *output_buf = nullptr;
+  size_t output_len = 0;
+  Status status = DispatchRun([&] {
+    return run_with_buffers(id_, run_input_buffer_.data(), input_len,
+                            run_output_buffer_.data(),
+                            run_output_buffer_.size(), &output_buf,
+                            &output_len);
+  });
+  if (!status.ok()) {
+    return status;
+  }
+
+  // Enclave entry-point was successfully invoked. |output_buf| is guaranteed to
+  // have a value.
+  EnclaveOutput local_output;
+  local_output.ParseFromArray(output_buf, output_len);
+  status.RestoreFrom(local_output.status());
+
+  // If the output did not fit in the registered buffer, |output_buf| points to
+  // a memory buffer allocated inside the enclave using enc_untrusted_malloc().
+  // It is the caller's responsibility to free this buffer. The registered
+  // buffer is grown so that outputs of this size fit in it from now on.
+  if (output_buf != run_output_buffer_.data()) {
+    free(output_buf);
+    if (output_len <= kMaxRunBufferSize) {
+      run_output_buffer_.resize(output_len);
+    }
+  }
+
+  // Set the output parameter if necessary. |local_output| is heap-allocated, so
+  // swapping it into a heap-allocated |output| exchanges pointers only.
+  if (output) {
+    output->Swap(&local_output);
+  }
+
+  return status;
+}
+
+Status SGXClient::EnterAndRunWithCopies(const EnclaveInput &input,
+                                        EnclaveOutput *output) {
   std::string buf;
   if (!input.SerializeToString(&buf)) {
     return Status(error::GoogleError::INVALID_ARGUMENT,
@@ -206,7 +482,9 @@ Status SGXClient::EnterAndRun(const EnclaveInput &input,
 
   char *output_buf = nullptr;
   size_t output_len = 0;
-  Status status = run(id_, buf.data(), buf.size(), &output_buf, &output_len);
+  Status status = DispatchRun([&] {
+    return run(id_, buf.data(), buf.size(), &output_buf, &output_len);
+  });
   if (!status.ok()) {
     return status;
   }
@@ -224,13 +502,104 @@ Status SGXClient::EnterAndRun(const EnclaveInput &input,
 
   // Set the output parameter if necessary.
   if (output) {
-    *output = local_output;
+    output->Swap(&local_output);
   }
 
   return status;
 }
 
+Status SGXClient::EnterAndRunBatch(const std::vector<EnclaveInput> &inputs,
+                                   std::vector<EnclaveOutput> *outputs) {
+  EnclaveInputBatch input_batch;
+  input_batch.mutable_inputs()->Reserve(inputs.size());
+  for (const EnclaveInput &input : inputs) {
+    *input_batch.add_inputs() = input;
+  }
+  std::string buf;
+  if (!input_batch.SerializeToString(&buf)) {
+    return Status(error::GoogleError::INVALID_ARGUMENT,
+                  "Failed to serialize EnclaveInputBatch");
+  }
+
+  char *output_buf = nullptr;
+  size_t output_len = 0;
+  Status status = DispatchRun([&] {
+    return run_batch(id_, buf.data(), buf.size(), &output_buf, &output_len);
+  });
+  if (!status.ok()) {
+    return status;
+  }
+
+  // |output_buf| points to a memory buffer allocated inside the enclave using
+  // enc_untrusted_malloc(). It is the caller's responsibility to free this
+  // buffer.
+  EnclaveOutputBatch output_batch;
+  bool parsed = output_batch.ParseFromArray(output_buf, output_len);
+  free(output_buf);
+  if (!parsed) {
+    return Status(error::GoogleError::INTERNAL,
+                  "Failed to parse EnclaveOutputBatch");
+  }
+  status.RestoreFrom(output_batch.status());
+  if (!status.ok()) {
+    return status;
+  }
+  if (static_cast<size_t>(output_batch.outputs_size()) != inputs.size()) {
+    return Status(error::GoogleError::INTERNAL,
+                  absl::StrCat("Enclave returned ", output_batch.outputs_size(),
+                               " outputs for ", inputs.size(), " inputs"));
+  }
+
+  outputs->clear();
+  outputs->resize(inputs.size());
+  for (int i = 0; i < output_batch.outputs_size(); ++i) {
+    (*outputs)[i].Swap(output_batch.mutable_outputs(i));
+  }
+  return Status::OkStatus();
+}
+
+Status SGXClient::EnterAndRunRaw(ByteContainerView input,
+                                 std::string *output) {
+  // Let the enclave write straight into the capacity of |output|.
+  output->resize(std::max(output->capacity(), kInitialRunBufferSize));
+
+  char *output_buf = nullptr;
+  size_t output_len = 0;
+  int status_code = 0;
+  Status status = DispatchRun([&] {
+    return run_raw(id_, reinterpret_cast<const char *>(input.data()),
+                   input.size(), &(*output)[0], output->size(), &output_buf,
+                   &output_len, &status_code);
+  });
+  if (!status.ok()) {
+    output->clear();
+    return status;
+  }
+
+  // If the output did not fit in |output|, |output_buf| points to a memory
+  // buffer allocated inside the enclave using enc_untrusted_malloc(). It is the
+  // caller's responsibility to free this buffer.
+  if (output_len > 0 && output_buf != output->data()) {
+    output->assign(output_buf, output_len);
+    free(output_buf);
+  } else {
+    output->resize(output_len);
+  }
+
+  if (status_code != error::GoogleError::OK) {
+    status = Status(static_cast<error::GoogleError>(status_code), *output);
+    output->clear();
+  }
+  return status;
+}
+
 Status SGXClient::EnterAndFinalize(const EnclaveFinal &final_input) {
+  // Asynchronous calls already queued complete before the enclave is
+  // finalized. Later calls are rejected.
+  if (async_run_pool_) {
+    async_run_pool_->Stop();
+  }
+
   std::string buf;
   if (!final_input.SerializeToString(&buf)) {
     return Status(error::GoogleError::INVALID_ARGUMENT,
@@ -255,10 +624,216 @@ Status SGXClient::EnterAndFinalize(const EnclaveFinal &final_input) {
   // is the untrusted caller's responsibility to free this buffer.
   free(output);
 
+  if (status.ok()) {
+    // Finalization releases the parked threads, which now leave the enclave.
+    for (std::thread &thread : donated_threads_) {
+      thread.join();
+    }
+    donated_threads_.clear();
+  }
+  return status;
+}
+
+Status SGXClient::EnterAndReset(const EnclaveFinal &final_input) {
+  std::string buf;
+  if (!final_input.SerializeToString(&buf)) {
+    return Status(error::GoogleError::INVALID_ARGUMENT,
+                  "Failed to serialize EnclaveFinal");
+  }
+
+  char *output = nullptr;
+  size_t output_len = 0;
+
+  Status status = reset(id_, buf.data(), buf.size(), &output, &output_len);
+  if (!status.ok()) {
+    return status;
+  }
+
+  // Enclave entry-point was successfully invoked. |output| is guaranteed to
+  // have a value.
+  StatusProto status_proto;
+  status_proto.ParseFromArray(output, output_len);
+  status.RestoreFrom(status_proto);
+
+  // |output| points to an untrusted memory buffer allocated by the enclave. It
+  // is the untrusted caller's responsibility to free this buffer.
+  free(output);
   return status;
 }
 
+Status SGXClient::EnterAndSnapshot(std::string *sealed_state) {
+  char *output = nullptr;
+  size_t output_len = 0;
+
+  Status status = snapshot(id_, &output, &output_len);
+  if (!status.ok()) {
+    return status;
+  }
+
+  // Enclave entry-point was successfully invoked. |output| is guaranteed to
+  // have a value.
+  EnclaveSnapshot enclave_snapshot;
+  enclave_snapshot.ParseFromArray(output, output_len);
+  status.RestoreFrom(enclave_snapshot.status());
+
+  // |output| points to an untrusted memory buffer allocated by the enclave. It
+  // is the untrusted caller's responsibility to free this buffer.
+  free(output);
+  if (status.ok()) {
+    enclave_snapshot.mutable_sealed_state()->swap(*sealed_state);
+  }
+  return status;
+}
+
+Status SGXClient::GetHostCallStats(HostCallStatsSnapshot *snapshot) {
+  int result;
+  char *output = nullptr;
+  bridge_size_t output_len = 0;
+  sgx_status_t sgx_status =
+      ecall_get_host_call_stats(id_, &result, &output, &output_len);
+  if (sgx_status != SGX_SUCCESS) {
+    // Return a Status object in the SGX error space.
+    return Status(sgx_status, "Call to ecall_get_host_call_stats failed");
+  } else if (result) {
+    return Status(error::GoogleError::INTERNAL,
+                  "Failed to snapshot host call stats");
+  }
+
+  bool parsed = snapshot->ParseFromArray(output, output_len);
+  // |output| points to an untrusted memory buffer allocated by the enclave. It
+  // is the untrusted caller's responsibility to free this buffer.
+  free(output);
+  if (!parsed) {
+    return Status(error::GoogleError::INTERNAL,
+                  "Failed to parse HostCallStatsSnapshot");
+  }
+  return Status::OkStatus();
+}
+
+Status SGXClient::GetResourceStats(EnclaveResourceStats *stats) {
+  int result;
+  char *output = nullptr;
+  bridge_size_t output_len = 0;
+  sgx_status_t sgx_status =
+      ecall_get_resource_stats(id_, &result, &output, &output_len);
+  if (sgx_status != SGX_SUCCESS) {
+    // Return a Status object in the SGX error space.
+    return Status(sgx_status, "Call to ecall_get_resource_stats failed");
+  } else if (result) {
+    return Status(error::GoogleError::INTERNAL,
+                  "Failed to snapshot enclave resource stats");
+  }
+
+  bool parsed = stats->ParseFromArray(output, output_len);
+  // |output| points to an untrusted memory buffer allocated by the enclave. It
+  // is the untrusted caller's responsibility to free this buffer.
+  free(output);
+  if (!parsed) {
+    return Status(error::GoogleError::INTERNAL,
+                  "Failed to parse EnclaveResourceStats");
+  }
+  return Status::OkStatus();
+}
+
+Status SGXClient::GetProfile(EnclaveProfile *profile) {
+  int result;
+  char *output = nullptr;
+  bridge_size_t output_len = 0;
+  sgx_status_t sgx_status =
+      ecall_get_profile(id_, &result, &output, &output_len);
+  if (sgx_status != SGX_SUCCESS) {
+    // Return a Status object in the SGX error space.
+    return Status(sgx_status, "Call to ecall_get_profile failed");
+  } else if (result) {
+    return Status(error::GoogleError::INTERNAL,
+                  "Failed to copy the enclave profile");
+  }
+
+  bool parsed = profile->ParseFromArray(output, output_len);
+  // |output| points to an untrusted memory buffer allocated by the enclave. It
+  // is the untrusted caller's responsibility to free this buffer.
+  free(output);
+  if (!parsed) {
+    return Status(error::GoogleError::INTERNAL,
+                  "Failed to parse EnclaveProfile");
+  }
+  return Status::OkStatus();
+}
+
+Status SGXClient::SetDonatedThreadAffinity(
+    const ThreadAffinityConfig &config) {
+  std::vector<std::vector<int>> node_cpus = ReadNumaNodeCpus();
+  std::vector<int> selected(config.cpus().begin(), config.cpus().end());
+  for (int node : config.numa_nodes()) {
+    if (node < 0 || static_cast<size_t>(node) >= node_cpus.size() ||
+        node_cpus[node].empty()) {
+      return Status(error::GoogleError::INVALID_ARGUMENT,
+                    absl::StrCat("NUMA node ", node, " has no CPUs"));
+    }
+    selected.insert(selected.end(), node_cpus[node].begin(),
+                    node_cpus[node].end());
+  }
+  if (config.cpus_size() == 0 && config.numa_nodes_size() == 0) {
+    for (const std::vector<int> &cpus : node_cpus) {
+      selected.insert(selected.end(), cpus.begin(), cpus.end());
+    }
+  }
+
+  // Group the selected CPUs into the masks handed out in turn.
+  std::map<int, cpu_set_t> masks;
+  std::map<int, int> cpu_nodes;
+  for (size_t node = 0; node < node_cpus.size(); ++node) {
+    for (int cpu : node_cpus[node]) {
+      cpu_nodes[cpu] = static_cast<int>(node);
+    }
+  }
+  for (int cpu : selected) {
+    if (cpu < 0 || cpu >= CPU_SETSIZE) {
+      return Status(error::GoogleError::INVALID_ARGUMENT,
+                    absl::StrCat("CPU ", cpu, " is out of range"));
+    }
+    int key = 0;
+    if (config.placement() == ThreadAffinityConfig::PER_CPU) {
+      key = cpu;
+    } else if (config.placement() == ThreadAffinityConfig::PER_NUMA_NODE) {
+      auto node = cpu_nodes.find(cpu);
+      if (node == cpu_nodes.end()) {
+        return Status(error::GoogleError::FAILED_PRECONDITION,
+                      absl::StrCat("NUMA node of CPU ", cpu, " is unknown"));
+      }
+      key = node->second;
+    }
+    auto mask = masks.find(key);
+    if (mask == masks.end()) {
+      mask = masks.emplace(key, cpu_set_t()).first;
+      CPU_ZERO(&mask->second);
+    }
+    CPU_SET(cpu, &mask->second);
+  }
+  if (masks.empty()) {
+    return Status(error::GoogleError::FAILED_PRECONDITION,
+                  "No CPUs selected for donated threads");
+  }
+
+  donated_thread_masks_.clear();
+  for (const auto &mask : masks) {
+    donated_thread_masks_.push_back(mask.second);
+  }
+  return Status::OkStatus();
+}
+
 Status SGXClient::EnterAndDonateThread() {
+  if (!donated_thread_masks_.empty()) {
+    const cpu_set_t &mask =
+        donated_thread_masks_[next_donated_thread_.fetch_add(1) %
+                              donated_thread_masks_.size()];
+    int result = pthread_setaffinity_np(pthread_self(), sizeof(mask), &mask);
+    if (result != 0) {
+      LOG(WARNING) << "Failed to set the affinity of a donated thread: "
+                   << strerror(result);
+    }
+  }
+
   sgx_status_t sgx_status;
   int result = donate_thread(id_, &sgx_status);
   Status status;
@@ -292,14 +867,106 @@ Status SGXClient::EnterAndHandleSignal(const EnclaveSignal &signal) {
                        serialized_enclave_signal.size());
 }
 
+Status SGXClient::StartSwitchlessWorkers(int num_workers) {
+  auto manager_result = EnclaveManager::Instance();
+  if (!manager_result.ok()) {
+    return manager_result.status();
+  }
+  switchless_pool_.reset(new SwitchlessWorkerPool(num_workers));
+  EnclaveManager *manager = manager_result.ValueOrDie();
+  Status status = manager->shared_resources()->RegisterUnmanagedResource(
+      SharedName::Address(
+          absl::StrCat(ENC_SWITCHLESS_QUEUE_RESOURCE_PREFIX, get_name())),
+      switchless_pool_->queue());
+  if (!status.ok()) {
+    switchless_pool_.reset();
+  }
+  return status;
+}
+
+Status SGXClient::StartAsyncIoWorkers(int num_workers) {
+  auto manager_result = EnclaveManager::Instance();
+  if (!manager_result.ok()) {
+    return manager_result.status();
+  }
+  async_io_pool_.reset(new AsyncIoWorkerPool(num_workers));
+  EnclaveManager *manager = manager_result.ValueOrDie();
+  Status status = manager->shared_resources()->RegisterUnmanagedResource(
+      SharedName::Address(
+          absl::StrCat(ENC_ASYNC_IO_QUEUE_RESOURCE_PREFIX, get_name())),
+      async_io_pool_->queue());
+  if (!status.ok()) {
+    async_io_pool_.reset();
+  }
+  return status;
+}
+
+void SGXClient::DonateThreadPool(int num_threads) {
+  for (int i = 0; i < num_threads; ++i) {
+    donated_threads_.emplace_back([this] { EnterAndDonateThread(); });
+  }
+}
+
 Status SGXClient::DestroyEnclave() {
+  // Threads still parked in an enclave destroyed without finalization are
+  // never released.
+  for (std::thread &thread : donated_threads_) {
+    thread.detach();
+  }
+  donated_threads_.clear();
+  if (async_run_pool_) {
+    async_run_pool_->Stop();
+  }
   sgx_status_t rc = sgx_destroy_enclave(id_);
   if (rc != SGX_SUCCESS) {
     return Status(rc, "Failed to destroy an enclave");
   }
+  if (switchless_pool_) {
+    // No trusted thread can be waiting on the queue once the enclave is gone.
+    switchless_pool_->Stop();
+    auto manager_result = EnclaveManager::Instance();
+    if (manager_result.ok()) {
+      manager_result.ValueOrDie()->shared_resources()->ReleaseResource(
+          SharedName::Address(
+              absl::StrCat(ENC_SWITCHLESS_QUEUE_RESOURCE_PREFIX, get_name())));
+    }
+    switchless_pool_.reset();
+  }
+  if (async_io_pool_) {
+    // Operations still in flight complete into a queue nobody reaps.
+    async_io_pool_->Stop();
+    auto manager_result = EnclaveManager::Instance();
+    if (manager_result.ok()) {
+      manager_result.ValueOrDie()->shared_resources()->ReleaseResource(
+          SharedName::Address(
+              absl::StrCat(ENC_ASYNC_IO_QUEUE_RESOURCE_PREFIX, get_name())));
+    }
+    async_io_pool_.reset();
+  }
   return Status::OkStatus();
 }
 
+Status SGXClient::DispatchRun(const std::function<Status()> &enter) {
+  if (!run_dispatcher_) {
+    return enter();
+  }
+
+  run_dispatcher_->Acquire();
+  Status status = enter();
+  // Threads outside the dispatcher, such as those handling signals, may still
+  // take the TCS a slot was counting on.
+  while (status.Is(SGX_ERROR_OUT_OF_TCS) &&
+         run_dispatcher_->AwaitOtherRelease()) {
+    status = enter();
+  }
+  run_dispatcher_->Release();
+  return status;
+}
+
+SlotDispatcherStats SGXClient::GetRunDispatchStats() const {
+  return run_dispatcher_ ? run_dispatcher_->GetStats() : SlotDispatcherStats();
+}
+
 bool SGXClient::IsTcsActive() { return (sgx_is_tcs_active(id_) != 0); }
 
 }  //  namespace asylo
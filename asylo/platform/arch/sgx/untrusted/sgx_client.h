@@ -19,6 +19,21 @@
 #ifndef ASYLO_PLATFORM_ARCH_SGX_UNTRUSTED_SGX_CLIENT_H_
 #define ASYLO_PLATFORM_ARCH_SGX_UNTRUSTED_SGX_CLIENT_H_
 
+#include <sched.h>
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "absl/synchronization/mutex.h"
+#include "asylo/crypto/util/byte_container_view.h"
+#include "asylo/platform/arch/sgx/untrusted/async_io_worker_pool.h"
+#include "asylo/platform/arch/sgx/untrusted/switchless_worker_pool.h"
+#include "asylo/platform/common/bounded_worker_pool.h"
+#include "asylo/platform/common/slot_dispatcher.h"
 #include "asylo/platform/core/enclave_client.h"
 #include "asylo/platform/core/enclave_manager.h"
 #include "asylo/util/status.h"
@@ -32,6 +47,20 @@ class SGXClient : public EnclaveClient {
  public:
   explicit SGXClient(const std::string &name) : EnclaveClient(name) {}
   Status EnterAndRun(const EnclaveInput &input, EnclaveOutput *output) override;
+  Status EnterAndRunRaw(ByteContainerView input, std::string *output) override;
+  Status EnterAndRunBatch(const std::vector<EnclaveInput> &inputs,
+                          std::vector<EnclaveOutput> *outputs) override;
+  Status EnterAndRunAsync(const EnclaveInput &input,
+                          RunCallback callback) override;
+  using EnclaveClient::EnterAndRunAsync;
+  Status GetHostCallStats(HostCallStatsSnapshot *snapshot) override;
+  Status GetResourceStats(EnclaveResourceStats *stats) override;
+  Status GetProfile(EnclaveProfile *profile) override;
+
+  // Returns counters of the queue of EnterAndRun and EnterAndRunRaw callers
+  // waiting for a TCS. All counters are zero unless the enclave was
+  // initialized with a positive EnclaveConfig.run_slots.
+  SlotDispatcherStats GetRunDispatchStats() const;
 
   // Returns true when a TCS is active in simulation mode. Always returns false
   // in hardware mode, since TCS active/inactive state is only set and used in
@@ -43,12 +72,75 @@ class SGXClient : public EnclaveClient {
   SGXClient() = default;
   Status EnterAndInitialize(const EnclaveConfig &config) override;
   Status EnterAndFinalize(const EnclaveFinal &final_input) override;
+  Status EnterAndReset(const EnclaveFinal &final_input) override;
+  Status EnterAndSnapshot(std::string *snapshot) override;
   Status EnterAndDonateThread() override;
   Status EnterAndHandleSignal(const EnclaveSignal &signal) override;
   Status DestroyEnclave() override;
+
+  // Invokes |enter|, which makes an ecall, while holding a run slot if run
+  // slots are configured. If the ecall fails with SGX_ERROR_OUT_OF_TCS while
+  // other callers hold slots, waits for one of them to return and tries again.
+  Status DispatchRun(const std::function<Status()> &enter);
+
+  // Runs the enclave through the untrusted buffers registered with this client.
+  // The input is serialized to |run_input_buffer_|, which the enclave parses in
+  // place, and the enclave writes its output to |run_output_buffer_|.
+  Status EnterAndRunWithBuffers(const EnclaveInput &input,
+                                EnclaveOutput *output)
+      EXCLUSIVE_LOCKS_REQUIRED(run_buffers_mutex_);
+
+  // Runs the enclave through buffers allocated for the call, which are copied
+  // across the enclave boundary.
+  Status EnterAndRunWithCopies(const EnclaveInput &input,
+                               EnclaveOutput *output);
+
+  // Starts a pool of |num_workers| host threads servicing switchless host
+  // calls and publishes its queue to the enclave.
+  Status StartSwitchlessWorkers(int num_workers);
+
+  // Starts a pool of |num_workers| host threads performing asynchronous I/O
+  // and publishes its queue to the enclave.
+  Status StartAsyncIoWorkers(int num_workers);
+
+  // Donates |num_threads| host threads to the enclave, to be parked inside it
+  // until needed by pthread_create.
+  void DonateThreadPool(int num_threads);
+
+  // Computes the CPU masks applied to donated threads from |config|.
+  Status SetDonatedThreadAffinity(const ThreadAffinityConfig &config);
+
   std::string path_;               // Path to enclave object file.
   sgx_launch_token_t token_;  // SGX SDK launch token.
   sgx_enclave_id_t id_;       // SGX SDK enclave identifier.
+  bool debug_ = false;        // Whether the enclave was loaded in debug mode.
+
+  // Host workers servicing switchless host calls, if enabled.
+  std::unique_ptr<SwitchlessWorkerPool> switchless_pool_;
+
+  // Host workers performing asynchronous I/O, if enabled.
+  std::unique_ptr<AsyncIoWorkerPool> async_io_pool_;
+
+  // Queue of EnterAndRun and EnterAndRunRaw callers, if run slots are
+  // configured.
+  std::unique_ptr<SlotDispatcher> run_dispatcher_;
+
+  // Host workers running EnterAndRunAsync calls, if enabled.
+  std::unique_ptr<BoundedWorkerPool> async_run_pool_;
+
+  // Host threads donated to the enclave at initialization.
+  std::vector<std::thread> donated_threads_;
+
+  // CPU masks applied in turn to the host threads donated to the enclave.
+  // Empty if donated threads keep the affinity of the process.
+  std::vector<cpu_set_t> donated_thread_masks_;
+  std::atomic<size_t> next_donated_thread_{0};
+
+  // Untrusted buffers reused by EnterAndRun to pass input to and receive
+  // output from the enclave. They grow to fit the largest message seen.
+  absl::Mutex run_buffers_mutex_;
+  std::vector<char> run_input_buffer_ GUARDED_BY(run_buffers_mutex_);
+  std::vector<char> run_output_buffer_ GUARDED_BY(run_buffers_mutex_);
 };
 
 /// Enclave loader for Intel Software Guard Extension (SGX) based enclaves.
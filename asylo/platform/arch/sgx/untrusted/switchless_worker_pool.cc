@@ -0,0 +1,62 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/arch/sgx/untrusted/switchless_worker_pool.h"
+
+#include <algorithm>
+
+#include "asylo/platform/arch/sgx/untrusted/host_call_dispatch.h"
+
+namespace asylo {
+
+SwitchlessWorkerPool::SwitchlessWorkerPool(int num_workers)
+    : queue_(new SwitchlessQueue()) {
+  for (int i = 0; i < num_workers; ++i) {
+    workers_.emplace_back(&SwitchlessWorkerPool::WorkerLoop, this);
+  }
+}
+
+SwitchlessWorkerPool::~SwitchlessWorkerPool() { Stop(); }
+
+void SwitchlessWorkerPool::Stop() {
+  queue_->Shutdown();
+  for (std::thread &worker : workers_) {
+    worker.join();
+  }
+  workers_.clear();
+}
+
+void SwitchlessWorkerPool::WorkerLoop() {
+  while (true) {
+    uint32_t index;
+    {
+      std::lock_guard<std::mutex> lock(take_mutex_);
+      if (!queue_->Take(&index)) {
+        return;
+      }
+    }
+    SwitchlessRequest *request = queue_->slot(index);
+    size_t payload_size =
+        std::min<size_t>(request->payload_size, kSwitchlessPayloadSize);
+    DispatchHostCall(request->call_id, request->payload, payload_size,
+                     &request->result, &request->bridge_errno);
+    request->state.store(kSwitchlessSlotComplete, std::memory_order_release);
+  }
+}
+
+}  // namespace asylo
@@ -41,12 +41,6 @@ void TranslateAndHandleSignal(int bridge_signum,
     return;
   }
   SignalManager *signal_manager = SignalManager::GetInstance();
-  sigset_t mask = signal_manager->GetSignalMask();
-  // If the signal is blocked and still passed into the enclave. The signal
-  // masks inside the enclave is out of sync with the untrusted signal mask.
-  if (sigismember(&mask, signum)) {
-    return;
-  }
   Status status = signal_manager->HandleSignal(signum, &info, ucontext);
   if (!status.ok()) {
     LOG(ERROR) << status;
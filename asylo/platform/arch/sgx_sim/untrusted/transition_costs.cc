@@ -0,0 +1,109 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/arch/sgx_sim/untrusted/transition_costs.h"
+
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+#include "asylo/enclave.pb.h"
+
+namespace asylo {
+namespace {
+
+constexpr int64_t kPageSize = 4096;
+
+// The configured costs, in nanoseconds unless noted.
+std::atomic<int64_t> enter_ns(0);
+std::atomic<int64_t> exit_ns(0);
+std::atomic<int64_t> epc_pages(0);
+std::atomic<int64_t> epc_page_fault_ns(0);
+
+// Pages touched inside enclave calls since paging was configured.
+std::atomic<int64_t> touched_pages(0);
+
+// Busy waits for |duration| nanoseconds, as a transition occupies its thread.
+void Charge(int64_t duration) {
+  if (duration <= 0) {
+    return;
+  }
+  auto deadline =
+      std::chrono::steady_clock::now() + std::chrono::nanoseconds(duration);
+  while (std::chrono::steady_clock::now() < deadline) {
+  }
+}
+
+// Returns the number of minor faults taken by the calling thread.
+int64_t ThreadMinorFaults() {
+  struct rusage usage;
+  if (getrusage(RUSAGE_THREAD, &usage) != 0) {
+    return 0;
+  }
+  return usage.ru_minflt;
+}
+
+}  // namespace
+
+void ConfigureSimTransitionCosts(const SimTransitionProfile &profile) {
+  enter_ns.store(profile.enter_ns(), std::memory_order_relaxed);
+  exit_ns.store(profile.exit_ns(), std::memory_order_relaxed);
+  epc_pages.store(profile.epc_bytes() / kPageSize, std::memory_order_relaxed);
+  epc_page_fault_ns.store(profile.epc_page_fault_ns(),
+                          std::memory_order_relaxed);
+  touched_pages.store(0, std::memory_order_relaxed);
+}
+
+}  // namespace asylo
+
+extern "C" sgx_status_t asylo_sim_sgx_ecall(sgx_enclave_id_t eid, int index,
+                                            const void *ocall_table,
+                                            void *ms) {
+  using asylo::Charge;
+  int64_t fault_cost =
+      asylo::epc_page_fault_ns.load(std::memory_order_relaxed);
+  int64_t faults = fault_cost > 0 ? asylo::ThreadMinorFaults() : 0;
+
+  Charge(asylo::enter_ns.load(std::memory_order_relaxed));
+  sgx_status_t status = sgx_ecall(eid, index, ocall_table, ms);
+  Charge(asylo::exit_ns.load(std::memory_order_relaxed));
+
+  if (fault_cost > 0) {
+    // Charge the pages touched beyond the EPC, each of which evicts another.
+    int64_t touched = asylo::ThreadMinorFaults() - faults;
+    if (touched > 0) {
+      int64_t total = asylo::touched_pages.fetch_add(
+                          touched, std::memory_order_relaxed) +
+                      touched;
+      int64_t evicting = std::min(
+          touched, total - asylo::epc_pages.load(std::memory_order_relaxed));
+      if (evicting > 0) {
+        Charge(evicting * fault_cost);
+      }
+    }
+  }
+  return status;
+}
+
+extern "C" void asylo_sim_charge_host_call(void) {
+  asylo::Charge(asylo::exit_ns.load(std::memory_order_relaxed) +
+                asylo::enter_ns.load(std::memory_order_relaxed));
+}
@@ -0,0 +1,57 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_PLATFORM_ARCH_SGX_SIM_UNTRUSTED_TRANSITION_COSTS_H_
+#define ASYLO_PLATFORM_ARCH_SGX_SIM_UNTRUSTED_TRANSITION_COSTS_H_
+
+// Transition costs injected into simulated enclaves. The bridge code generated
+// by edger8r is rewritten at build time to make its ecalls through
+// asylo_sim_sgx_ecall and to call asylo_sim_charge_host_call at the start of
+// each ocall, so this header is also included from C.
+
+#include "common/inc/sgx_edger8r.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Makes the ecall numbered |index| through sgx_ecall, charging the configured
+// costs of entering and exiting the enclave and of the EPC paging the call is
+// deemed to cause.
+sgx_status_t asylo_sim_sgx_ecall(sgx_enclave_id_t eid, int index,
+                                 const void *ocall_table, void *ms);
+
+// Charges the configured costs of exiting and re-entering the enclave for a
+// host call.
+void asylo_sim_charge_host_call(void);
+
+#ifdef __cplusplus
+}  // extern "C"
+
+namespace asylo {
+
+class SimTransitionProfile;
+
+// Sets the costs charged to the transitions of all enclaves of the process.
+// All costs are zero until configured.
+void ConfigureSimTransitionCosts(const SimTransitionProfile &profile);
+
+}  // namespace asylo
+#endif  // __cplusplus
+
+#endif  // ASYLO_PLATFORM_ARCH_SGX_SIM_UNTRUSTED_TRANSITION_COSTS_H_
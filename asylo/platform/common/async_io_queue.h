@@ -0,0 +1,163 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_PLATFORM_COMMON_ASYNC_IO_QUEUE_H_
+#define ASYLO_PLATFORM_COMMON_ASYNC_IO_QUEUE_H_
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include "asylo/platform/common/ring_buffer.h"
+
+namespace asylo {
+
+// Number of request slots in an asynchronous I/O queue. This bounds the number
+// of asynchronous operations which may be in flight at any one time.
+constexpr size_t kAsyncIoSlotCount = 64;
+
+// Maximum number of bytes transferred by a single asynchronous operation,
+// including the socket address of a sendmsg request.
+constexpr size_t kAsyncIoMaxTransfer = 64 * 1024;
+
+// Operations which may be performed asynchronously.
+enum AsyncIoOpcode : uint32_t {
+  kAsyncIoRead = 1,
+  kAsyncIoWrite = 2,
+  kAsyncIoFsync = 3,
+  kAsyncIoSendmsg = 4,
+};
+
+// A single asynchronous I/O request. Requests live in untrusted memory and are
+// filled by the enclave before submission, then owned by one host worker until
+// their index is posted to the completion ring.
+struct AsyncIoRequest {
+  // AsyncIoOpcode of the operation.
+  uint32_t opcode;
+
+  // Host file descriptor the operation applies to.
+  int32_t host_fd;
+
+  // Flags passed to sendmsg.
+  int32_t flags;
+
+  // Number of bytes at the start of |data| holding the destination socket
+  // address of a sendmsg request.
+  uint32_t name_length;
+
+  // File offset for reads and writes, or -1 to use the current file position.
+  int64_t offset;
+
+  // Number of bytes to transfer, not counting |name_length|.
+  uint64_t length;
+
+  // Return value of the operation on the host.
+  int64_t result;
+
+  // Value of errno on the host after a failed operation, in bridge
+  // representation.
+  int32_t bridge_errno;
+
+  // Data written by, or read for, the operation.
+  alignas(8) uint8_t data[kAsyncIoMaxTransfer];
+};
+
+// A pair of rings shared between an enclave and the host workers servicing its
+// asynchronous I/O. The enclave fills a request slot and publishes its index
+// on the submission ring; a host worker performs the operation and publishes
+// the same index on the completion ring for the enclave to reap at its
+// convenience.
+//
+// Each ring supports a single reader and a single writer, so both sides are
+// expected to serialize their own producers and consumers. As with RingBuffer,
+// nothing read from an instance is assumed to be trustworthy: slot indices are
+// always reduced modulo kAsyncIoSlotCount before use.
+class AsyncIoQueue {
+ public:
+  AsyncIoQueue() : instance_version_(TypeVersion()) {}
+
+  AsyncIoQueue(const AsyncIoQueue &) = delete;
+  AsyncIoQueue &operator=(const AsyncIoQueue &) = delete;
+
+  // Returns the request slot at |index|.
+  AsyncIoRequest *slot(uint32_t index) {
+    return &slots_[index % kAsyncIoSlotCount];
+  }
+
+  // Publishes the request slot at |index| to the host workers. Returns false
+  // if the queue has been shut down.
+  bool Submit(uint32_t index) {
+    return submissions_.Write(reinterpret_cast<const uint8_t *>(&index),
+                              sizeof(index)) == sizeof(index);
+  }
+
+  // Blocks until a submitted slot index is available and stores it in
+  // |index|. Returns false once the queue has been shut down and drained.
+  bool TakeSubmission(uint32_t *index) {
+    return submissions_.Read(reinterpret_cast<uint8_t *>(index),
+                             sizeof(*index)) == sizeof(*index);
+  }
+
+  // Publishes the serviced request slot at |index| to the enclave.
+  void Complete(uint32_t index) {
+    completions_.Write(reinterpret_cast<const uint8_t *>(&index),
+                       sizeof(index));
+  }
+
+  // Stores the index of a serviced request slot in |index| and returns true,
+  // or returns false without blocking if no completion is pending.
+  bool PollCompletion(uint32_t *index) {
+    if (completions_.size() < sizeof(*index)) {
+      return false;
+    }
+    return completions_.Read(reinterpret_cast<uint8_t *>(index),
+                             sizeof(*index)) == sizeof(*index);
+  }
+
+  // Stops accepting new submissions. Indices already submitted remain
+  // available to TakeSubmission().
+  void Shutdown() { submissions_.close_for_write(); }
+
+  // Returns true if the queue has been shut down.
+  bool is_shutdown() const { return submissions_.is_closed_for_write(); }
+
+  // Returns a signature reflecting the layout of this concrete instance.
+  uint64_t InstanceVersion() const { return instance_version_; }
+
+  // Returns a signature reflecting the layout of this abstract type.
+  static uint64_t TypeVersion() {
+    return IndexRing::TypeVersion() ^
+           (offsetof(AsyncIoQueue, slots_) << 8 |
+            sizeof(AsyncIoRequest) << 24 |
+            offsetof(AsyncIoRequest, data) << 48);
+  }
+
+ private:
+  // Each ring holds every slot index at most once.
+  using IndexRing = RingBuffer<kAsyncIoSlotCount * sizeof(uint32_t)>;
+
+  const uint64_t instance_version_;
+  IndexRing submissions_;
+  IndexRing completions_;
+  std::array<AsyncIoRequest, kAsyncIoSlotCount> slots_;
+};
+
+}  // namespace asylo
+
+#endif  // ASYLO_PLATFORM_COMMON_ASYNC_IO_QUEUE_H_
@@ -0,0 +1,108 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/common/async_io_queue.h"
+
+#include <cstdint>
+#include <memory>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+namespace asylo {
+namespace {
+
+constexpr int kRequestCount = 10000;
+
+TEST(AsyncIoQueueTest, VersionMatching) {
+  auto queue = std::unique_ptr<AsyncIoQueue>(new AsyncIoQueue());
+  EXPECT_EQ(queue->InstanceVersion(), AsyncIoQueue::TypeVersion());
+}
+
+TEST(AsyncIoQueueTest, SlotIndexIsBounded) {
+  auto queue = std::unique_ptr<AsyncIoQueue>(new AsyncIoQueue());
+  EXPECT_EQ(queue->slot(0), queue->slot(kAsyncIoSlotCount));
+  EXPECT_EQ(queue->slot(3), queue->slot(kAsyncIoSlotCount + 3));
+}
+
+TEST(AsyncIoQueueTest, PollCompletionDoesNotBlock) {
+  auto queue = std::unique_ptr<AsyncIoQueue>(new AsyncIoQueue());
+  uint32_t index = 0;
+  EXPECT_FALSE(queue->PollCompletion(&index));
+  queue->Complete(5);
+  ASSERT_TRUE(queue->PollCompletion(&index));
+  EXPECT_EQ(index, 5);
+  EXPECT_FALSE(queue->PollCompletion(&index));
+}
+
+TEST(AsyncIoQueueTest, ShutdownRejectsSubmissionsAndDrains) {
+  auto queue = std::unique_ptr<AsyncIoQueue>(new AsyncIoQueue());
+  EXPECT_TRUE(queue->Submit(7));
+  queue->Shutdown();
+  EXPECT_TRUE(queue->is_shutdown());
+  EXPECT_FALSE(queue->Submit(8));
+
+  uint32_t index = 0;
+  EXPECT_TRUE(queue->TakeSubmission(&index));
+  EXPECT_EQ(index, 7);
+  EXPECT_FALSE(queue->TakeSubmission(&index));
+}
+
+// Keeps every slot in flight while a worker thread services submissions,
+// checking that each submitted request is completed exactly once.
+TEST(AsyncIoQueueTest, SubmitAndReap) {
+  auto queue = std::unique_ptr<AsyncIoQueue>(new AsyncIoQueue());
+
+  std::thread worker([&queue] {
+    uint32_t index;
+    while (queue->TakeSubmission(&index)) {
+      AsyncIoRequest *request = queue->slot(index);
+      request->result = static_cast<int64_t>(request->length) * 2;
+      queue->Complete(index);
+    }
+  });
+
+  int submitted = 0;
+  int reaped = 0;
+  int in_flight = 0;
+  while (reaped < kRequestCount) {
+    while (submitted < kRequestCount &&
+           in_flight < static_cast<int>(kAsyncIoSlotCount)) {
+      uint32_t index = submitted % kAsyncIoSlotCount;
+      queue->slot(index)->length = submitted;
+      ASSERT_TRUE(queue->Submit(index));
+      ++submitted;
+      ++in_flight;
+    }
+    uint32_t index;
+    if (queue->PollCompletion(&index)) {
+      AsyncIoRequest *request = queue->slot(index);
+      EXPECT_EQ(request->result, static_cast<int64_t>(request->length) * 2);
+      ++reaped;
+      --in_flight;
+    } else {
+      std::this_thread::yield();
+    }
+  }
+
+  queue->Shutdown();
+  worker.join();
+}
+
+}  // namespace
+}  // namespace asylo
@@ -0,0 +1,188 @@
+/*
+ *
+ * Copyright 2017 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/common/boundary_copy.h"
+
+#include <cpuid.h>
+#include <emmintrin.h>
+#include <immintrin.h>
+
+#include <cstdint>
+#include <cstring>
+
+namespace asylo {
+namespace {
+
+// Returns whether the processor and OS support AVX2. Inside an SGX enclave
+// CPUID is emulated from values reported by the host. A host that misreports
+// them can at worst make the enclave fault, which it can always do.
+bool DetectAvx2() {
+  unsigned int eax, ebx, ecx, edx;
+  if (__get_cpuid_max(0, nullptr) < 7 ||
+      !__get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
+    return false;
+  }
+  if ((ecx & bit_OSXSAVE) == 0 || (ecx & bit_AVX) == 0) {
+    return false;
+  }
+  __cpuid_count(7, 0, eax, ebx, ecx, edx);
+  if ((ebx & bit_AVX2) == 0) {
+    return false;
+  }
+  // Check that the OS saves the YMM registers on context switches.
+  uint32_t xcr0_low, xcr0_high;
+  __asm__("xgetbv" : "=a"(xcr0_low), "=d"(xcr0_high) : "c"(0));
+  return (xcr0_low & 0x6) == 0x6;
+}
+
+bool HasAvx2() {
+  static const bool avx2 = DetectAvx2();
+  return avx2;
+}
+
+// Copies |size| bytes, at least 32, in 32-byte chunks with regular stores. The
+// last chunk overlaps the one before it rather than being copied bytewise.
+__attribute__((target("avx2"))) void CopyAvx2(uint8_t *dest,
+                                              const uint8_t *src,
+                                              size_t size) {
+  size_t offset = 0;
+  for (; offset + 128 <= size; offset += 128) {
+    __m256i a = _mm256_loadu_si256(
+        reinterpret_cast<const __m256i *>(src + offset));
+    __m256i b = _mm256_loadu_si256(
+        reinterpret_cast<const __m256i *>(src + offset + 32));
+    __m256i c = _mm256_loadu_si256(
+        reinterpret_cast<const __m256i *>(src + offset + 64));
+    __m256i d = _mm256_loadu_si256(
+        reinterpret_cast<const __m256i *>(src + offset + 96));
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(dest + offset), a);
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(dest + offset + 32), b);
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(dest + offset + 64), c);
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(dest + offset + 96), d);
+  }
+  for (; offset + 32 <= size; offset += 32) {
+    _mm256_storeu_si256(
+        reinterpret_cast<__m256i *>(dest + offset),
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + offset)));
+  }
+  if (offset < size) {
+    _mm256_storeu_si256(
+        reinterpret_cast<__m256i *>(dest + size - 32),
+        _mm256_loadu_si256(
+            reinterpret_cast<const __m256i *>(src + size - 32)));
+  }
+}
+
+// Copies |size| bytes, at least 64, with non-temporal stores to the 32-byte
+// aligned chunks of |dest|. The unaligned head and tail use regular stores.
+__attribute__((target("avx2"))) void CopyNonTemporalAvx2(uint8_t *dest,
+                                                         const uint8_t *src,
+                                                         size_t size) {
+  _mm256_storeu_si256(
+      reinterpret_cast<__m256i *>(dest),
+      _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src)));
+  size_t offset = 32 - (reinterpret_cast<uintptr_t>(dest) & 31);
+  for (; offset + 128 <= size; offset += 128) {
+    __m256i a = _mm256_loadu_si256(
+        reinterpret_cast<const __m256i *>(src + offset));
+    __m256i b = _mm256_loadu_si256(
+        reinterpret_cast<const __m256i *>(src + offset + 32));
+    __m256i c = _mm256_loadu_si256(
+        reinterpret_cast<const __m256i *>(src + offset + 64));
+    __m256i d = _mm256_loadu_si256(
+        reinterpret_cast<const __m256i *>(src + offset + 96));
+    _mm256_stream_si256(reinterpret_cast<__m256i *>(dest + offset), a);
+    _mm256_stream_si256(reinterpret_cast<__m256i *>(dest + offset + 32), b);
+    _mm256_stream_si256(reinterpret_cast<__m256i *>(dest + offset + 64), c);
+    _mm256_stream_si256(reinterpret_cast<__m256i *>(dest + offset + 96), d);
+  }
+  for (; offset + 32 <= size; offset += 32) {
+    _mm256_stream_si256(
+        reinterpret_cast<__m256i *>(dest + offset),
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + offset)));
+  }
+  // Order the non-temporal stores before any later store, such as one
+  // publishing the buffer to the other side.
+  _mm_sfence();
+  if (offset < size) {
+    _mm256_storeu_si256(
+        reinterpret_cast<__m256i *>(dest + size - 32),
+        _mm256_loadu_si256(
+            reinterpret_cast<const __m256i *>(src + size - 32)));
+  }
+}
+
+// Copies |size| bytes, at least 32, with non-temporal stores to the 16-byte
+// aligned chunks of |dest|, for processors without AVX2.
+void CopyNonTemporalSse2(uint8_t *dest, const uint8_t *src, size_t size) {
+  _mm_storeu_si128(reinterpret_cast<__m128i *>(dest),
+                   _mm_loadu_si128(reinterpret_cast<const __m128i *>(src)));
+  size_t offset = 16 - (reinterpret_cast<uintptr_t>(dest) & 15);
+  for (; offset + 64 <= size; offset += 64) {
+    __m128i a =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + offset));
+    __m128i b =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + offset + 16));
+    __m128i c =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + offset + 32));
+    __m128i d =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + offset + 48));
+    _mm_stream_si128(reinterpret_cast<__m128i *>(dest + offset), a);
+    _mm_stream_si128(reinterpret_cast<__m128i *>(dest + offset + 16), b);
+    _mm_stream_si128(reinterpret_cast<__m128i *>(dest + offset + 32), c);
+    _mm_stream_si128(reinterpret_cast<__m128i *>(dest + offset + 48), d);
+  }
+  for (; offset + 16 <= size; offset += 16) {
+    _mm_stream_si128(
+        reinterpret_cast<__m128i *>(dest + offset),
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + offset)));
+  }
+  _mm_sfence();
+  if (offset < size) {
+    _mm_storeu_si128(
+        reinterpret_cast<__m128i *>(dest + size - 16),
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + size - 16)));
+  }
+}
+
+}  // namespace
+
+void BoundaryCopyOut(void *dest, const void *src, size_t size) {
+  if (size < kBoundaryCopyNonTemporalThreshold) {
+    BoundaryCopyIn(dest, src, size);
+    return;
+  }
+  if (HasAvx2()) {
+    CopyNonTemporalAvx2(static_cast<uint8_t *>(dest),
+                        static_cast<const uint8_t *>(src), size);
+  } else {
+    CopyNonTemporalSse2(static_cast<uint8_t *>(dest),
+                        static_cast<const uint8_t *>(src), size);
+  }
+}
+
+void BoundaryCopyIn(void *dest, const void *src, size_t size) {
+  if (size < kBoundaryCopySmallSize || !HasAvx2()) {
+    memcpy(dest, src, size);
+    return;
+  }
+  CopyAvx2(static_cast<uint8_t *>(dest), static_cast<const uint8_t *>(src),
+           size);
+}
+
+}  // namespace asylo
@@ -0,0 +1,49 @@
+/*
+ *
+ * Copyright 2017 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_PLATFORM_COMMON_BOUNDARY_COPY_H_
+#define ASYLO_PLATFORM_COMMON_BOUNDARY_COPY_H_
+
+#include <cstddef>
+
+namespace asylo {
+
+// Copies of at least this many bytes made by BoundaryCopyOut() use
+// non-temporal stores.
+constexpr size_t kBoundaryCopyNonTemporalThreshold = 256 * 1024;
+
+// Copies of fewer than this many bytes are passed to memcpy.
+constexpr size_t kBoundaryCopySmallSize = 256;
+
+// Copies |size| bytes from |src| to |dest| for data leaving the copying side of
+// the enclave boundary, such as buffers an enclave passes to the host or
+// outputs it returns to it. Copies of at least
+// kBoundaryCopyNonTemporalThreshold bytes use non-temporal stores, so that data
+// the copying side does not read again does not evict its working set from the
+// cache. The buffers must not overlap.
+void BoundaryCopyOut(void *dest, const void *src, size_t size);
+
+// Copies |size| bytes from |src| to |dest| for data entering the copying side
+// of the enclave boundary, such as the results of host calls. The stores go
+// through the cache, since the copying side typically reads the data next. The
+// buffers must not overlap.
+void BoundaryCopyIn(void *dest, const void *src, size_t size);
+
+}  // namespace asylo
+
+#endif  // ASYLO_PLATFORM_COMMON_BOUNDARY_COPY_H_
@@ -0,0 +1,116 @@
+/*
+ *
+ * Copyright 2017 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+// Compares BoundaryCopyOut() and BoundaryCopyIn() with memcpy. Inside an
+// enclave, the destination of the outgoing copies and the source of the
+// incoming ones are in untrusted memory, so that the copies cross the
+// boundary as they do in host calls.
+
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+#include "asylo/platform/common/boundary_copy.h"
+
+#ifdef __ASYLO__
+#include "asylo/platform/arch/include/trusted/host_calls.h"
+#endif
+
+namespace asylo {
+namespace {
+
+// A buffer on the other side of the enclave boundary when running inside an
+// enclave, and on the heap otherwise.
+class OtherSideBuffer {
+ public:
+  explicit OtherSideBuffer(size_t size) {
+#ifdef __ASYLO__
+    data_ = enc_untrusted_malloc(size);
+#else
+    data_ = malloc(size);
+#endif
+    memset(data_, 1, size);
+  }
+
+  ~OtherSideBuffer() {
+#ifdef __ASYLO__
+    enc_untrusted_free(data_);
+#else
+    free(data_);
+#endif
+  }
+
+  void *data() { return data_; }
+
+ private:
+  void *data_;
+};
+
+void CopyArgs(benchmark::internal::Benchmark *benchmark) {
+  for (int64_t size : {256, 4096, 65536, 1 << 20, 8 << 20}) {
+    benchmark->Arg(size);
+  }
+}
+
+void BM_MemcpyOut(benchmark::State &state) {
+  std::vector<char> local(state.range(0), 2);
+  OtherSideBuffer remote(state.range(0));
+  for (auto _ : state) {
+    memcpy(remote.data(), local.data(), local.size());
+    benchmark::ClobberMemory();
+  }
+  state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_MemcpyOut)->Apply(CopyArgs);
+
+void BM_BoundaryCopyOut(benchmark::State &state) {
+  std::vector<char> local(state.range(0), 2);
+  OtherSideBuffer remote(state.range(0));
+  for (auto _ : state) {
+    BoundaryCopyOut(remote.data(), local.data(), local.size());
+    benchmark::ClobberMemory();
+  }
+  state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_BoundaryCopyOut)->Apply(CopyArgs);
+
+void BM_MemcpyIn(benchmark::State &state) {
+  std::vector<char> local(state.range(0), 2);
+  OtherSideBuffer remote(state.range(0));
+  for (auto _ : state) {
+    memcpy(local.data(), remote.data(), local.size());
+    benchmark::ClobberMemory();
+  }
+  state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_MemcpyIn)->Apply(CopyArgs);
+
+void BM_BoundaryCopyIn(benchmark::State &state) {
+  std::vector<char> local(state.range(0), 2);
+  OtherSideBuffer remote(state.range(0));
+  for (auto _ : state) {
+    BoundaryCopyIn(local.data(), remote.data(), local.size());
+    benchmark::ClobberMemory();
+  }
+  state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_BoundaryCopyIn)->Apply(CopyArgs);
+
+}  // namespace
+}  // namespace asylo
@@ -0,0 +1,79 @@
+/*
+ *
+ * Copyright 2017 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/common/boundary_copy.h"
+
+#include <cstdint>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace asylo {
+namespace {
+
+// Sizes around each kernel's chunk sizes and thresholds.
+std::vector<size_t> TestSizes() {
+  std::vector<size_t> sizes;
+  for (size_t base :
+       {size_t{0}, size_t{16}, size_t{32}, size_t{64}, size_t{128},
+        kBoundaryCopySmallSize, size_t{4096},
+        kBoundaryCopyNonTemporalThreshold}) {
+    for (size_t delta : {0, 1, 15, 31, 33}) {
+      sizes.push_back(base + delta);
+      if (base >= delta) {
+        sizes.push_back(base - delta);
+      }
+    }
+  }
+  return sizes;
+}
+
+// Copies with |copy| at every combination of source and destination
+// misalignment, and checks that exactly the destination range is written.
+void CheckCopies(void (*copy)(void *, const void *, size_t)) {
+  constexpr size_t kGuard = 64;
+  for (size_t size : TestSizes()) {
+    std::vector<uint8_t> source(size + kGuard);
+    for (size_t i = 0; i < source.size(); ++i) {
+      source[i] = static_cast<uint8_t>(i * 7 + size);
+    }
+    for (size_t src_offset : {0, 1, 17}) {
+      for (size_t dest_offset : {0, 3, 16, 31}) {
+        std::vector<uint8_t> dest(size + 2 * kGuard, 0xee);
+        copy(dest.data() + kGuard + dest_offset, source.data() + src_offset,
+             size);
+        for (size_t i = 0; i < dest.size(); ++i) {
+          size_t start = kGuard + dest_offset;
+          uint8_t expected = (i >= start && i < start + size)
+                                 ? source[src_offset + i - start]
+                                 : 0xee;
+          ASSERT_EQ(dest[i], expected)
+              << "size " << size << " src offset " << src_offset
+              << " dest offset " << dest_offset << " index " << i;
+        }
+      }
+    }
+  }
+}
+
+TEST(BoundaryCopyTest, CopyOut) { CheckCopies(&BoundaryCopyOut); }
+
+TEST(BoundaryCopyTest, CopyIn) { CheckCopies(&BoundaryCopyIn); }
+
+}  // namespace
+}  // namespace asylo
@@ -0,0 +1,83 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/common/bounded_worker_pool.h"
+
+#include <utility>
+
+namespace asylo {
+
+BoundedWorkerPool::BoundedWorkerPool(int num_workers, int queue_capacity)
+    : queue_capacity_(queue_capacity) {
+  absl::MutexLock lock(&stop_mu_);
+  workers_.reserve(num_workers);
+  for (int i = 0; i < num_workers; ++i) {
+    workers_.emplace_back(&BoundedWorkerPool::WorkerLoop, this);
+  }
+}
+
+BoundedWorkerPool::~BoundedWorkerPool() { Stop(); }
+
+bool BoundedWorkerPool::TrySubmit(std::function<void()> task) {
+  absl::MutexLock lock(&mu_);
+  if (stopping_ || tasks_.size() >= static_cast<size_t>(queue_capacity_)) {
+    return false;
+  }
+  tasks_.push_back(std::move(task));
+  return true;
+}
+
+void BoundedWorkerPool::Stop() {
+  absl::MutexLock stop_lock(&stop_mu_);
+  {
+    absl::MutexLock lock(&mu_);
+    stopping_ = true;
+  }
+  for (std::thread &worker : workers_) {
+    worker.join();
+  }
+  workers_.clear();
+}
+
+int BoundedWorkerPool::queue_depth() const {
+  absl::MutexLock lock(&mu_);
+  return tasks_.size();
+}
+
+bool BoundedWorkerPool::HasTaskOrStopping() const {
+  return !tasks_.empty() || stopping_;
+}
+
+void BoundedWorkerPool::WorkerLoop() {
+  while (true) {
+    std::function<void()> task;
+    {
+      absl::MutexLock lock(&mu_);
+      mu_.Await(absl::Condition(this, &BoundedWorkerPool::HasTaskOrStopping));
+      // Tasks queued before the pool was stopped still run.
+      if (tasks_.empty()) {
+        return;
+      }
+      task = std::move(tasks_.front());
+      tasks_.pop_front();
+    }
+    task();
+  }
+}
+
+}  // namespace asylo
@@ -0,0 +1,80 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_PLATFORM_COMMON_BOUNDED_WORKER_POOL_H_
+#define ASYLO_PLATFORM_COMMON_BOUNDED_WORKER_POOL_H_
+
+#include <deque>
+#include <functional>
+#include <thread>
+#include <vector>
+
+#include "absl/synchronization/mutex.h"
+
+namespace asylo {
+
+// BoundedWorkerPool runs tasks on a fixed number of threads, in the order they
+// are submitted. At most a fixed number of tasks wait for a thread, and
+// submitting a task to a full queue fails instead of blocking, so that callers
+// such as event loops can apply backpressure without being blocked themselves.
+//
+// BoundedWorkerPool is thread-safe.
+class BoundedWorkerPool {
+ public:
+  // Starts |num_workers| threads running tasks from a queue of at most
+  // |queue_capacity| tasks. Both must be positive.
+  BoundedWorkerPool(int num_workers, int queue_capacity);
+
+  BoundedWorkerPool(const BoundedWorkerPool &) = delete;
+  BoundedWorkerPool &operator=(const BoundedWorkerPool &) = delete;
+
+  // Stops the pool if it is still running.
+  ~BoundedWorkerPool();
+
+  // Queues |task| to run on a worker thread. Returns false without queuing
+  // |task| if the queue is full or the pool has been stopped.
+  bool TrySubmit(std::function<void()> task) LOCKS_EXCLUDED(mu_);
+
+  // Stops accepting tasks, runs the tasks already queued, and joins all worker
+  // threads. Must not be called from a task.
+  void Stop() LOCKS_EXCLUDED(mu_);
+
+  // Returns the number of tasks waiting for a worker thread.
+  int queue_depth() const LOCKS_EXCLUDED(mu_);
+
+ private:
+  // Top level loop run by each worker thread.
+  void WorkerLoop() LOCKS_EXCLUDED(mu_);
+
+  // Returns true if a worker has a task to run or should exit.
+  bool HasTaskOrStopping() const EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  const int queue_capacity_;
+
+  mutable absl::Mutex mu_;
+  std::deque<std::function<void()>> tasks_ GUARDED_BY(mu_);
+  bool stopping_ GUARDED_BY(mu_) = false;
+
+  // Serializes callers of Stop(), so that workers are joined once.
+  absl::Mutex stop_mu_;
+  std::vector<std::thread> workers_ GUARDED_BY(stop_mu_);
+};
+
+}  // namespace asylo
+
+#endif  // ASYLO_PLATFORM_COMMON_BOUNDED_WORKER_POOL_H_
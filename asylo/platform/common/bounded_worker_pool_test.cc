@@ -0,0 +1,93 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/common/bounded_worker_pool.h"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include "absl/synchronization/mutex.h"
+#include "absl/synchronization/notification.h"
+
+namespace asylo {
+namespace {
+
+TEST(BoundedWorkerPoolTest, RunsAllTasks) {
+  constexpr int kTaskCount = 1000;
+  std::atomic<int> runs(0);
+  BoundedWorkerPool pool(/*num_workers=*/4, /*queue_capacity=*/kTaskCount);
+  for (int i = 0; i < kTaskCount; ++i) {
+    ASSERT_TRUE(pool.TrySubmit([&runs] { ++runs; }));
+  }
+  pool.Stop();
+  EXPECT_EQ(runs.load(), kTaskCount);
+}
+
+// Checks that no more tasks run at once than there are workers.
+TEST(BoundedWorkerPoolTest, BoundsConcurrency) {
+  constexpr int kWorkerCount = 3;
+  constexpr int kTaskCount = 300;
+  std::atomic<int> running(0);
+  std::atomic<int> max_running(0);
+  BoundedWorkerPool pool(kWorkerCount, kTaskCount);
+  for (int i = 0; i < kTaskCount; ++i) {
+    ASSERT_TRUE(pool.TrySubmit([&running, &max_running] {
+      int now = ++running;
+      int max = max_running.load();
+      while (now > max && !max_running.compare_exchange_weak(max, now)) {
+      }
+      std::this_thread::yield();
+      --running;
+    }));
+  }
+  pool.Stop();
+  EXPECT_LE(max_running.load(), kWorkerCount);
+}
+
+TEST(BoundedWorkerPoolTest, FullQueueRejectsTasks) {
+  absl::Notification release;
+  absl::Notification started;
+  BoundedWorkerPool pool(/*num_workers=*/1, /*queue_capacity=*/2);
+
+  // Occupy the only worker, then fill the queue.
+  ASSERT_TRUE(pool.TrySubmit([&started, &release] {
+    started.Notify();
+    release.WaitForNotification();
+  }));
+  started.WaitForNotification();
+  EXPECT_TRUE(pool.TrySubmit([] {}));
+  EXPECT_TRUE(pool.TrySubmit([] {}));
+  EXPECT_EQ(pool.queue_depth(), 2);
+  EXPECT_FALSE(pool.TrySubmit([] {}));
+
+  release.Notify();
+  pool.Stop();
+  EXPECT_EQ(pool.queue_depth(), 0);
+}
+
+TEST(BoundedWorkerPoolTest, StoppedPoolRejectsTasks) {
+  BoundedWorkerPool pool(/*num_workers=*/2, /*queue_capacity=*/2);
+  pool.Stop();
+  EXPECT_FALSE(pool.TrySubmit([] {}));
+  pool.Stop();
+}
+
+}  // namespace
+}  // namespace asylo
@@ -0,0 +1,470 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/common/bridge_flat_serializer.h"
+
+#include <net/if.h>
+#include <netinet/in.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+
+#include <algorithm>
+#include <cstdint>
+
+namespace asylo {
+namespace {
+
+// Every record, sockaddr and name in a serialized list starts at a multiple of
+// kAlignment bytes from the start of the list.
+constexpr size_t kAlignment = 8;
+
+// Arbitrary max size of ai_canonname and ifa_name, including the terminating
+// NUL. This maximum is above anything we would expect for a non-malicious
+// input. POSIX does not specify any maximum length.
+constexpr size_t kMaxNameSize = 4097;
+
+constexpr uint32_t kAddrinfoListMagic = 0x41444931;  // "ADI1"
+constexpr uint32_t kIfAddrsListMagic = 0x49464131;   // "IFA1"
+
+struct ListHeader {
+  uint32_t magic;
+  uint32_t count;
+};
+
+// Followed by |addr_size| bytes of ai_addr and |canonname_size| bytes of
+// ai_canonname, each padded to kAlignment.
+struct AddrinfoRecord {
+  int32_t flags;
+  int32_t family;
+  int32_t socktype;
+  int32_t protocol;
+  uint32_t addrlen;
+  uint32_t addr_size;
+  uint32_t canonname_size;
+  uint32_t reserved;
+};
+
+// Followed by |name_size| bytes of ifa_name and the ifa_addr, ifa_netmask and
+// ifa_dstaddr sockaddrs, each padded to kAlignment.
+struct IfAddrRecord {
+  uint32_t flags;
+  uint32_t name_size;
+  uint32_t addr_size;
+  uint32_t netmask_size;
+  uint32_t dstaddr_size;
+  uint32_t reserved;
+};
+
+static_assert(sizeof(ListHeader) % kAlignment == 0,
+              "ListHeader must preserve alignment");
+static_assert(sizeof(AddrinfoRecord) % kAlignment == 0,
+              "AddrinfoRecord must preserve alignment");
+static_assert(sizeof(IfAddrRecord) % kAlignment == 0,
+              "IfAddrRecord must preserve alignment");
+
+// The interface flags which are serialized, with the bits which represent
+// them in a serialized list.
+constexpr struct {
+  int native;
+  uint32_t serialized;
+} kIffFlags[] = {
+    {IFF_UP, 1 << 0},          {IFF_BROADCAST, 1 << 1},
+    {IFF_DEBUG, 1 << 2},       {IFF_LOOPBACK, 1 << 3},
+    {IFF_POINTOPOINT, 1 << 4}, {IFF_NOTRAILERS, 1 << 5},
+    {IFF_RUNNING, 1 << 6},     {IFF_NOARP, 1 << 7},
+    {IFF_PROMISC, 1 << 8},     {IFF_ALLMULTI, 1 << 9},
+    {IFF_MULTICAST, 1 << 10},
+};
+
+uint32_t ToSerializedIffFlags(unsigned int flags) {
+  uint32_t serialized = 0;
+  for (const auto &flag : kIffFlags) {
+    if (flags & flag.native) serialized |= flag.serialized;
+  }
+  return serialized;
+}
+
+unsigned int FromSerializedIffFlags(uint32_t serialized) {
+  unsigned int flags = 0;
+  for (const auto &flag : kIffFlags) {
+    if (serialized & flag.serialized) flags |= flag.native;
+  }
+  return flags;
+}
+
+size_t Align(size_t size) {
+  return (size + kAlignment - 1) & ~(kAlignment - 1);
+}
+
+// Returns the size of a sockaddr of |family|, or 0 if it is not supported.
+size_t SockaddrSizeForFamily(sa_family_t family) {
+  switch (family) {
+    case AF_INET:
+      return sizeof(struct sockaddr_in);
+    case AF_INET6:
+      return sizeof(struct sockaddr_in6);
+    default:
+      return 0;
+  }
+}
+
+// Returns the size of |addr| when serialized, which is 0 if it is null.
+// Returns false if |addr| is not supported.
+bool SerializedSockaddrSize(const struct sockaddr *addr, size_t *size) {
+  if (!addr) {
+    *size = 0;
+    return true;
+  }
+  *size = SockaddrSizeForFamily(addr->sa_family);
+  return *size != 0;
+}
+
+// Returns the size of |name| when serialized, including its terminating NUL,
+// which is 0 if it is null. Longer names are truncated.
+size_t SerializedNameSize(const char *name) {
+  return name ? strnlen(name, kMaxNameSize - 1) + 1 : 0;
+}
+
+// Appends fields to a buffer which is large enough to hold them.
+class Writer {
+ public:
+  explicit Writer(char *buffer) : next_(buffer) {}
+
+  // Appends |size| bytes from |data|, padded to kAlignment.
+  void Append(const void *data, size_t size) {
+    memcpy(next_, data, size);
+    memset(next_ + size, 0, Align(size) - size);
+    next_ += Align(size);
+  }
+
+  // Appends the first |size| - 1 bytes of |name| and a NUL, padded to
+  // kAlignment.
+  void AppendName(const char *name, size_t size) {
+    if (size == 0) return;
+    char *start = next_;
+    Append(name, size - 1);
+    start[size - 1] = '\0';
+    next_ = start + Align(size);
+  }
+
+ private:
+  char *next_;
+};
+
+// Reads fields from a trusted copy of a serialized list, checking that each
+// lies within it.
+class Reader {
+ public:
+  Reader(char *buffer, size_t size) : next_(buffer), end_(buffer + size) {}
+
+  // Returns a pointer to the next |size| bytes and advances past them and
+  // their padding, or returns null if they are not within the buffer. A
+  // |size| of zero returns null without failing.
+  char *Read(size_t size) {
+    if (size == 0) return nullptr;
+    if (failed_ || Align(size) > static_cast<size_t>(end_ - next_)) {
+      failed_ = true;
+      return nullptr;
+    }
+    char *field = next_;
+    next_ += Align(size);
+    return field;
+  }
+
+  // Reads a record of type T into |record|.
+  template <typename T>
+  void ReadRecord(T *record) {
+    char *field = Read(sizeof(T));
+    if (field) {
+      memcpy(record, field, sizeof(T));
+    } else {
+      memset(record, 0, sizeof(T));
+    }
+  }
+
+  // Returns the next name of |size| bytes, or null if |size| is zero. Fails if
+  // the name is too large or not NUL-terminated.
+  char *ReadName(size_t size) {
+    if (size > kMaxNameSize) {
+      failed_ = true;
+      return nullptr;
+    }
+    char *name = Read(size);
+    if (name && name[size - 1] != '\0') {
+      failed_ = true;
+      return nullptr;
+    }
+    return name;
+  }
+
+  // Returns the next sockaddr of |size| bytes, or null if |size| is zero.
+  // Fails if the sockaddr is not supported or its size does not match its
+  // family.
+  struct sockaddr *ReadSockaddr(size_t size) {
+    char *addr = Read(size);
+    if (!addr) return nullptr;
+    sa_family_t family;
+    if (size < sizeof(family)) {
+      failed_ = true;
+      return nullptr;
+    }
+    memcpy(&family, addr + offsetof(struct sockaddr, sa_family),
+           sizeof(family));
+    if (SockaddrSizeForFamily(family) != size) {
+      failed_ = true;
+      return nullptr;
+    }
+    return reinterpret_cast<struct sockaddr *>(addr);
+  }
+
+  bool failed() const { return failed_; }
+
+ private:
+  char *next_;
+  char *const end_;
+  bool failed_ = false;
+};
+
+// Allocates a single buffer holding |count| nodes of type Node followed by a
+// copy of |in|. Returns the nodes, and a pointer to the copy in |*copy|, or
+// null on failure.
+template <typename Node>
+Node *AllocateList(absl::string_view in, uint32_t count, char **copy) {
+  size_t nodes_size = Align(count * sizeof(Node));
+  char *buffer = static_cast<char *>(malloc(nodes_size + in.size()));
+  if (!buffer) return nullptr;
+  memset(buffer, 0, nodes_size);
+  *copy = buffer + nodes_size;
+  memcpy(*copy, in.data(), in.size());
+  return reinterpret_cast<Node *>(buffer);
+}
+
+// Reads the header of a serialized list of elements of at least
+// |min_element_size| bytes from |in|, and returns the number of elements in
+// |*count|. Returns false if the header is invalid.
+bool ReadHeaderCount(absl::string_view in, uint32_t magic,
+                     size_t min_element_size, uint32_t *count) {
+  ListHeader header;
+  if (in.size() < sizeof(header)) return false;
+  memcpy(&header, in.data(), sizeof(header));
+  if (header.magic != magic ||
+      header.count > (in.size() - sizeof(header)) / min_element_size) {
+    return false;
+  }
+  *count = header.count;
+  return true;
+}
+
+}  // namespace
+
+bool SerializeAddrinfo(const struct addrinfo *in, char **out, size_t *len) {
+  if (!out || !len) return false;
+
+  uint32_t count = 0;
+  size_t size = sizeof(ListHeader);
+  for (const struct addrinfo *info = in; info; info = info->ai_next) {
+    size_t addr_size;
+    if (!SerializedSockaddrSize(info->ai_addr, &addr_size)) return false;
+    size += sizeof(AddrinfoRecord) + Align(addr_size) +
+            Align(SerializedNameSize(info->ai_canonname));
+    ++count;
+  }
+
+  char *buffer = static_cast<char *>(malloc(size));
+  if (!buffer) return false;
+  Writer writer(buffer);
+  ListHeader header = {kAddrinfoListMagic, count};
+  writer.Append(&header, sizeof(header));
+  for (const struct addrinfo *info = in; info; info = info->ai_next) {
+    size_t addr_size;
+    SerializedSockaddrSize(info->ai_addr, &addr_size);
+    AddrinfoRecord record = {};
+    record.flags = info->ai_flags;
+    record.family = info->ai_family;
+    record.socktype = info->ai_socktype;
+    record.protocol = info->ai_protocol;
+    record.addrlen = info->ai_addrlen;
+    record.addr_size = addr_size;
+    record.canonname_size = SerializedNameSize(info->ai_canonname);
+    writer.Append(&record, sizeof(record));
+    if (addr_size) writer.Append(info->ai_addr, addr_size);
+    writer.AppendName(info->ai_canonname, record.canonname_size);
+  }
+  *out = buffer;
+  *len = size;
+  return true;
+}
+
+bool DeserializeAddrinfo(absl::string_view in, struct addrinfo **out) {
+  if (!out) return false;
+
+  uint32_t count;
+  if (!ReadHeaderCount(in, kAddrinfoListMagic, sizeof(AddrinfoRecord),
+                       &count)) {
+    return false;
+  }
+  if (count == 0) {
+    *out = nullptr;
+    return true;
+  }
+
+  // Everything below reads only the trusted copy of |in|.
+  char *copy;
+  struct addrinfo *nodes = AllocateList<struct addrinfo>(in, count, &copy);
+  if (!nodes) return false;
+  Reader reader(copy, in.size());
+  ListHeader header;
+  reader.ReadRecord(&header);
+  if (header.count != count) {
+    free(nodes);
+    return false;
+  }
+  for (uint32_t i = 0; i < count; ++i) {
+    AddrinfoRecord record;
+    reader.ReadRecord(&record);
+    struct addrinfo *info = &nodes[i];
+    info->ai_flags = record.flags;
+    info->ai_family = record.family;
+    info->ai_socktype = record.socktype;
+    info->ai_protocol = record.protocol;
+    info->ai_addr = reader.ReadSockaddr(record.addr_size);
+    info->ai_addrlen = std::min(record.addrlen, record.addr_size);
+    info->ai_canonname = reader.ReadName(record.canonname_size);
+    info->ai_next = i + 1 < count ? &nodes[i + 1] : nullptr;
+  }
+  if (reader.failed()) {
+    free(nodes);
+    return false;
+  }
+  *out = nodes;
+  return true;
+}
+
+void FreeDeserializedAddrinfo(struct addrinfo *in) { free(in); }
+
+bool SerializeIfAddrs(const struct ifaddrs *in, char **out, size_t *len) {
+  if (!out || !len) return false;
+
+  uint32_t count = 0;
+  size_t size = sizeof(ListHeader);
+  for (const struct ifaddrs *curr = in; curr; curr = curr->ifa_next) {
+    // If the entry is of a format we don't support, don't include it.
+    if (!IfAddrSupported(curr)) continue;
+    size_t addr_size, netmask_size, dstaddr_size;
+    SerializedSockaddrSize(curr->ifa_addr, &addr_size);
+    SerializedSockaddrSize(curr->ifa_netmask, &netmask_size);
+    SerializedSockaddrSize(curr->ifa_ifu.ifu_dstaddr, &dstaddr_size);
+    size += sizeof(IfAddrRecord) + Align(SerializedNameSize(curr->ifa_name)) +
+            Align(addr_size) + Align(netmask_size) + Align(dstaddr_size);
+    ++count;
+  }
+
+  char *buffer = static_cast<char *>(malloc(size));
+  if (!buffer) return false;
+  Writer writer(buffer);
+  ListHeader header = {kIfAddrsListMagic, count};
+  writer.Append(&header, sizeof(header));
+  for (const struct ifaddrs *curr = in; curr; curr = curr->ifa_next) {
+    if (!IfAddrSupported(curr)) continue;
+    size_t addr_size, netmask_size, dstaddr_size;
+    SerializedSockaddrSize(curr->ifa_addr, &addr_size);
+    SerializedSockaddrSize(curr->ifa_netmask, &netmask_size);
+    SerializedSockaddrSize(curr->ifa_ifu.ifu_dstaddr, &dstaddr_size);
+    IfAddrRecord record = {};
+    record.flags = ToSerializedIffFlags(curr->ifa_flags);
+    record.name_size = SerializedNameSize(curr->ifa_name);
+    record.addr_size = addr_size;
+    record.netmask_size = netmask_size;
+    record.dstaddr_size = dstaddr_size;
+    writer.Append(&record, sizeof(record));
+    writer.AppendName(curr->ifa_name, record.name_size);
+    if (addr_size) writer.Append(curr->ifa_addr, addr_size);
+    if (netmask_size) writer.Append(curr->ifa_netmask, netmask_size);
+    if (dstaddr_size) writer.Append(curr->ifa_ifu.ifu_dstaddr, dstaddr_size);
+  }
+  *out = buffer;
+  *len = size;
+  return true;
+}
+
+bool DeserializeIfAddrs(absl::string_view in, struct ifaddrs **out) {
+  if (!out) return false;
+
+  uint32_t count;
+  if (!ReadHeaderCount(in, kIfAddrsListMagic, sizeof(IfAddrRecord), &count)) {
+    return false;
+  }
+  if (count == 0) {
+    *out = nullptr;
+    return true;
+  }
+
+  // Everything below reads only the trusted copy of |in|.
+  char *copy;
+  struct ifaddrs *nodes = AllocateList<struct ifaddrs>(in, count, &copy);
+  if (!nodes) return false;
+  Reader reader(copy, in.size());
+  ListHeader header;
+  reader.ReadRecord(&header);
+  if (header.count != count) {
+    free(nodes);
+    return false;
+  }
+  for (uint32_t i = 0; i < count; ++i) {
+    IfAddrRecord record;
+    reader.ReadRecord(&record);
+    struct ifaddrs *ifa = &nodes[i];
+    ifa->ifa_flags = FromSerializedIffFlags(record.flags);
+    ifa->ifa_name = reader.ReadName(record.name_size);
+    ifa->ifa_addr = reader.ReadSockaddr(record.addr_size);
+    ifa->ifa_netmask = reader.ReadSockaddr(record.netmask_size);
+    ifa->ifa_ifu.ifu_dstaddr = reader.ReadSockaddr(record.dstaddr_size);
+    ifa->ifa_data = nullptr;
+    ifa->ifa_next = i + 1 < count ? &nodes[i + 1] : nullptr;
+    // Every interface has a name.
+    if (!ifa->ifa_name) {
+      free(nodes);
+      return false;
+    }
+  }
+  if (reader.failed()) {
+    free(nodes);
+    return false;
+  }
+  *out = nodes;
+  return true;
+}
+
+void FreeDeserializedIfAddrs(struct ifaddrs *ifa) { free(ifa); }
+
+// Returns true if the sa_family is AF_INET or AF_INET6, false otherwise.
+static bool IpCompliant(const struct sockaddr *addr) {
+  return (addr->sa_family == AF_INET) || (addr->sa_family == AF_INET6);
+}
+
+bool IfAddrSupported(const struct ifaddrs *entry) {
+  if (entry->ifa_addr && !IpCompliant(entry->ifa_addr)) return false;
+  if (entry->ifa_netmask && !IpCompliant(entry->ifa_netmask)) return false;
+  if (entry->ifa_ifu.ifu_dstaddr && !IpCompliant(entry->ifa_ifu.ifu_dstaddr)) {
+    return false;
+  }
+  return true;
+}
+
+}  // namespace asylo
@@ -0,0 +1,75 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_PLATFORM_COMMON_BRIDGE_FLAT_SERIALIZER_H_
+#define ASYLO_PLATFORM_COMMON_BRIDGE_FLAT_SERIALIZER_H_
+
+// This file provides serializers for the linked lists returned by getaddrinfo
+// and getifaddrs, used both inside and outside the enclave.
+//
+// A serialized list is a single buffer holding a header and one fixed-layout
+// record per element, each followed by the sockaddrs and names of the
+// element. Deserializing a list copies the buffer once into a single
+// allocation which also holds the list nodes, validates it, and points the
+// nodes into it. A deserialized list is therefore released with a single
+// free(), by FreeDeserializedAddrinfo() or FreeDeserializedIfAddrs().
+//
+// Only AF_INET and AF_INET6 sockaddrs are supported, whose layouts are the
+// same inside and outside the enclave.
+
+#include <ifaddrs.h>
+#include <netdb.h>
+
+#include <cstddef>
+
+#include "absl/strings/string_view.h"
+
+namespace asylo {
+
+// Serializes the addrinfo list |in|, which may be null, into a buffer
+// allocated with malloc() in |*out| of |*len| bytes. Returns false if the list
+// holds a sockaddr which is not supported.
+bool SerializeAddrinfo(const struct addrinfo *in, char **out, size_t *len);
+
+// Deserializes the addrinfo list in |in| into |*out|, which is set to null if
+// the list is empty. Returns false if |in| is not a valid serialized list.
+bool DeserializeAddrinfo(absl::string_view in, struct addrinfo **out);
+
+// Releases a list returned by DeserializeAddrinfo().
+void FreeDeserializedAddrinfo(struct addrinfo *in);
+
+// Serializes the ifaddrs list |in|, which may be null, into a buffer allocated
+// with malloc() in |*out| of |*len| bytes. Elements which are not supported
+// by IfAddrSupported() are left out.
+bool SerializeIfAddrs(const struct ifaddrs *in, char **out, size_t *len);
+
+// Deserializes the ifaddrs list in |in| into |*out|, which is set to null if
+// the list is empty. Returns false if |in| is not a valid serialized list.
+bool DeserializeIfAddrs(absl::string_view in, struct ifaddrs **out);
+
+// Releases a list returned by DeserializeIfAddrs().
+void FreeDeserializedIfAddrs(struct ifaddrs *ifa);
+
+// Returns true if all sockaddr fields are compatible with IPv4 or IPv6, false
+// otherwise. The sockaddr fields in the ifaddrs struct may also be null.
+// IfAddrSupported is exposed here since it is used in tests.
+bool IfAddrSupported(const struct ifaddrs *entry);
+
+}  // namespace asylo
+
+#endif  // ASYLO_PLATFORM_COMMON_BRIDGE_FLAT_SERIALIZER_H_
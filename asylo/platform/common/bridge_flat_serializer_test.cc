@@ -0,0 +1,195 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/common/bridge_flat_serializer.h"
+
+#include <arpa/inet.h>
+#include <net/if.h>
+#include <netinet/in.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+
+#include <string>
+
+#include <gtest/gtest.h>
+#include "absl/strings/string_view.h"
+
+namespace asylo {
+namespace {
+
+// Serializes |in| with |serialize| and returns the result as a string.
+template <typename List>
+std::string Serialize(bool (*serialize)(const List *, char **, size_t *),
+                      const List *in) {
+  char *buffer = nullptr;
+  size_t len = 0;
+  EXPECT_TRUE(serialize(in, &buffer, &len));
+  std::string serialized(buffer, len);
+  free(buffer);
+  return serialized;
+}
+
+class BridgeFlatSerializerTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    memset(&addr4_, 0, sizeof(addr4_));
+    addr4_.sin_family = AF_INET;
+    addr4_.sin_port = htons(443);
+    inet_pton(AF_INET, "10.1.2.3", &addr4_.sin_addr);
+
+    memset(&addr6_, 0, sizeof(addr6_));
+    addr6_.sin6_family = AF_INET6;
+    addr6_.sin6_port = htons(80);
+    addr6_.sin6_scope_id = 2;
+    inet_pton(AF_INET6, "fe80::1", &addr6_.sin6_addr);
+
+    memset(info_, 0, sizeof(info_));
+    info_[0].ai_flags = AI_CANONNAME;
+    info_[0].ai_family = AF_INET;
+    info_[0].ai_socktype = SOCK_STREAM;
+    info_[0].ai_protocol = IPPROTO_TCP;
+    info_[0].ai_addrlen = sizeof(addr4_);
+    info_[0].ai_addr = reinterpret_cast<struct sockaddr *>(&addr4_);
+    info_[0].ai_canonname = const_cast<char *>("example.com");
+    info_[0].ai_next = &info_[1];
+    info_[1].ai_family = AF_INET6;
+    info_[1].ai_socktype = SOCK_DGRAM;
+    info_[1].ai_addrlen = sizeof(addr6_);
+    info_[1].ai_addr = reinterpret_cast<struct sockaddr *>(&addr6_);
+
+    memset(ifa_, 0, sizeof(ifa_));
+    ifa_[0].ifa_name = const_cast<char *>("eth0");
+    ifa_[0].ifa_flags = IFF_UP | IFF_BROADCAST | IFF_RUNNING;
+    ifa_[0].ifa_addr = reinterpret_cast<struct sockaddr *>(&addr4_);
+    ifa_[0].ifa_netmask = reinterpret_cast<struct sockaddr *>(&addr4_);
+    ifa_[0].ifa_next = &ifa_[1];
+    // An unsupported entry, which is left out.
+    memset(&unix_addr_, 0, sizeof(unix_addr_));
+    unix_addr_.sa_family = AF_UNIX;
+    ifa_[1].ifa_name = const_cast<char *>("unix0");
+    ifa_[1].ifa_addr = &unix_addr_;
+    ifa_[1].ifa_next = &ifa_[2];
+    ifa_[2].ifa_name = const_cast<char *>("lo");
+    ifa_[2].ifa_flags = IFF_UP | IFF_LOOPBACK;
+    ifa_[2].ifa_addr = reinterpret_cast<struct sockaddr *>(&addr6_);
+  }
+
+  struct sockaddr_in addr4_;
+  struct sockaddr_in6 addr6_;
+  struct sockaddr unix_addr_;
+  struct addrinfo info_[2];
+  struct ifaddrs ifa_[3];
+};
+
+TEST_F(BridgeFlatSerializerTest, AddrinfoRoundTrip) {
+  std::string serialized = Serialize(&SerializeAddrinfo, &info_[0]);
+  struct addrinfo *out = nullptr;
+  ASSERT_TRUE(DeserializeAddrinfo(serialized, &out));
+  ASSERT_NE(out, nullptr);
+
+  EXPECT_EQ(out->ai_flags, AI_CANONNAME);
+  EXPECT_EQ(out->ai_family, AF_INET);
+  EXPECT_EQ(out->ai_socktype, SOCK_STREAM);
+  EXPECT_EQ(out->ai_protocol, IPPROTO_TCP);
+  EXPECT_EQ(out->ai_addrlen, sizeof(addr4_));
+  EXPECT_EQ(memcmp(out->ai_addr, &addr4_, sizeof(addr4_)), 0);
+  EXPECT_STREQ(out->ai_canonname, "example.com");
+
+  struct addrinfo *next = out->ai_next;
+  ASSERT_NE(next, nullptr);
+  EXPECT_EQ(next->ai_family, AF_INET6);
+  EXPECT_EQ(next->ai_socktype, SOCK_DGRAM);
+  EXPECT_EQ(memcmp(next->ai_addr, &addr6_, sizeof(addr6_)), 0);
+  EXPECT_EQ(next->ai_canonname, nullptr);
+  EXPECT_EQ(next->ai_next, nullptr);
+  FreeDeserializedAddrinfo(out);
+}
+
+TEST_F(BridgeFlatSerializerTest, EmptyAddrinfo) {
+  std::string serialized = Serialize(&SerializeAddrinfo,
+                                     static_cast<struct addrinfo *>(nullptr));
+  struct addrinfo *out = &info_[0];
+  ASSERT_TRUE(DeserializeAddrinfo(serialized, &out));
+  EXPECT_EQ(out, nullptr);
+}
+
+TEST_F(BridgeFlatSerializerTest, AddrinfoWithUnsupportedSockaddrFails) {
+  info_[1].ai_addr = &unix_addr_;
+  char *buffer = nullptr;
+  size_t len = 0;
+  EXPECT_FALSE(SerializeAddrinfo(&info_[0], &buffer, &len));
+}
+
+TEST_F(BridgeFlatSerializerTest, IfAddrsRoundTrip) {
+  std::string serialized = Serialize(&SerializeIfAddrs, &ifa_[0]);
+  struct ifaddrs *out = nullptr;
+  ASSERT_TRUE(DeserializeIfAddrs(serialized, &out));
+  ASSERT_NE(out, nullptr);
+
+  EXPECT_STREQ(out->ifa_name, "eth0");
+  EXPECT_EQ(out->ifa_flags, IFF_UP | IFF_BROADCAST | IFF_RUNNING);
+  EXPECT_EQ(memcmp(out->ifa_addr, &addr4_, sizeof(addr4_)), 0);
+  EXPECT_EQ(memcmp(out->ifa_netmask, &addr4_, sizeof(addr4_)), 0);
+  EXPECT_EQ(out->ifa_ifu.ifu_dstaddr, nullptr);
+
+  struct ifaddrs *next = out->ifa_next;
+  ASSERT_NE(next, nullptr);
+  EXPECT_STREQ(next->ifa_name, "lo");
+  EXPECT_EQ(next->ifa_flags, IFF_UP | IFF_LOOPBACK);
+  EXPECT_EQ(memcmp(next->ifa_addr, &addr6_, sizeof(addr6_)), 0);
+  EXPECT_EQ(next->ifa_netmask, nullptr);
+  EXPECT_EQ(next->ifa_next, nullptr);
+  FreeDeserializedIfAddrs(out);
+}
+
+TEST_F(BridgeFlatSerializerTest, RejectsMalformedInput) {
+  std::string serialized = Serialize(&SerializeAddrinfo, &info_[0]);
+  struct addrinfo *info = nullptr;
+  struct ifaddrs *ifa = nullptr;
+
+  // Every truncation of a valid list is rejected.
+  for (size_t len = 0; len < serialized.size(); ++len) {
+    EXPECT_FALSE(
+        DeserializeAddrinfo(absl::string_view(serialized.data(), len), &info))
+        << len;
+  }
+
+  // A list of one kind is not accepted as the other.
+  EXPECT_FALSE(DeserializeIfAddrs(serialized, &ifa));
+
+  // A count larger than the buffer can hold is rejected.
+  std::string bad_count = serialized;
+  bad_count[4] = '\x7f';
+  EXPECT_FALSE(DeserializeAddrinfo(bad_count, &info));
+
+  // A sockaddr whose size does not match its family is rejected.
+  std::string bad_family = serialized;
+  struct sockaddr_in *addr = reinterpret_cast<struct sockaddr_in *>(
+      &bad_family[8 + 32]);
+  addr->sin_family = AF_INET6;
+  EXPECT_FALSE(DeserializeAddrinfo(bad_family, &info));
+
+  // A name which is not NUL-terminated is rejected.
+  std::string bad_name = serialized;
+  bad_name[8 + 32 + 16 + strlen("example.com")] = 'x';
+  EXPECT_FALSE(DeserializeAddrinfo(bad_name, &info));
+}
+
+}  // namespace
+}  // namespace asylo
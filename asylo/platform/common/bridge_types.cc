@@ -20,11 +20,9 @@
 
 #include <fcntl.h>
 #include <netinet/in.h>
-#include <poll.h>
 #include <signal.h>
 #include <stdint.h>
 #include <string.h>
-#include <sys/stat.h>
 #include <sys/un.h>
 #include <unistd.h>
 #include <algorithm>
@@ -441,44 +439,6 @@ int ToBridgeOptionName(int level, int option_name) {
   return -1;
 }
 
-struct stat *FromBridgeStat(const struct bridge_stat *bridge_statbuf,
-                            struct stat *statbuf) {
-  if (!bridge_statbuf || !statbuf) return nullptr;
-  statbuf->st_dev = bridge_statbuf->st_dev;
-  statbuf->st_ino = bridge_statbuf->st_ino;
-  statbuf->st_mode = bridge_statbuf->st_mode;
-  statbuf->st_nlink = bridge_statbuf->st_nlink;
-  statbuf->st_uid = bridge_statbuf->st_uid;
-  statbuf->st_gid = bridge_statbuf->st_gid;
-  statbuf->st_rdev = bridge_statbuf->st_rdev;
-  statbuf->st_size = bridge_statbuf->st_size;
-  statbuf->st_atime = bridge_statbuf->st_atime_enc;
-  statbuf->st_mtime = bridge_statbuf->st_mtime_enc;
-  statbuf->st_ctime = bridge_statbuf->st_ctime_enc;
-  statbuf->st_blksize = bridge_statbuf->st_blksize;
-  statbuf->st_blocks = bridge_statbuf->st_blocks;
-  return statbuf;
-}
-
-struct bridge_stat *ToBridgeStat(const struct stat *statbuf,
-                                 struct bridge_stat *bridge_statbuf) {
-  if (!statbuf || !bridge_statbuf) return nullptr;
-  bridge_statbuf->st_dev = statbuf->st_dev;
-  bridge_statbuf->st_ino = statbuf->st_ino;
-  bridge_statbuf->st_mode = statbuf->st_mode;
-  bridge_statbuf->st_nlink = statbuf->st_nlink;
-  bridge_statbuf->st_uid = statbuf->st_uid;
-  bridge_statbuf->st_gid = statbuf->st_gid;
-  bridge_statbuf->st_rdev = statbuf->st_rdev;
-  bridge_statbuf->st_size = statbuf->st_size;
-  bridge_statbuf->st_atime_enc = statbuf->st_atime;
-  bridge_statbuf->st_mtime_enc = statbuf->st_mtime;
-  bridge_statbuf->st_ctime_enc = statbuf->st_ctime;
-  bridge_statbuf->st_blksize = statbuf->st_blksize;
-  bridge_statbuf->st_blocks = statbuf->st_blocks;
-  return bridge_statbuf;
-}
-
 template <typename T, typename U>
 void ReinterpretCopySingle(T *dst, const U *src) {
   memcpy(dst, src, std::min(sizeof(T), sizeof(U)));
@@ -570,24 +530,6 @@ struct bridge_sockaddr *ToBridgeSockaddr(const struct sockaddr *addr,
   return bridge_addr;
 }
 
-struct pollfd *FromBridgePollfd(const struct bridge_pollfd *bridge_fd,
-                                struct pollfd *fd) {
-  if (!bridge_fd || !fd) return nullptr;
-  fd->fd = bridge_fd->fd;
-  fd->events = bridge_fd->events;
-  fd->revents = bridge_fd->revents;
-  return fd;
-}
-
-struct bridge_pollfd *ToBridgePollfd(const struct pollfd *fd,
-                                     struct bridge_pollfd *bridge_fd) {
-  if (!fd || !bridge_fd) return nullptr;
-  bridge_fd->fd = fd->fd;
-  bridge_fd->events = fd->events;
-  bridge_fd->revents = fd->revents;
-  return bridge_fd;
-}
-
 struct msghdr *FromBridgeMsgHdr(const struct bridge_msghdr *bridge_msg,
                                 struct msghdr *msg) {
   if (!bridge_msg || !msg) return nullptr;
@@ -634,52 +576,6 @@ struct bridge_msghdr *ToBridgeIovecArray(const struct msghdr *msg,
   return bridge_msg;
 }
 
-struct iovec *FromBridgeIovec(const struct bridge_iovec *bridge_iov,
-                              struct iovec *iov) {
-  if (!bridge_iov || !iov) return nullptr;
-  iov->iov_base = bridge_iov->iov_base;
-  iov->iov_len = bridge_iov->iov_len;
-  return iov;
-}
-
-struct bridge_iovec *ToBridgeIovec(const struct iovec *iov,
-                                   struct bridge_iovec *bridge_iov) {
-  if (!iov || !bridge_iov) return nullptr;
-  bridge_iov->iov_base = iov->iov_base;
-  bridge_iov->iov_len = iov->iov_len;
-  return bridge_iov;
-}
-
-struct timespec *FromBridgeTimespec(const struct bridge_timespec *bridge_tp,
-                                    struct timespec *tp) {
-  tp->tv_sec = bridge_tp->tv_sec;
-  tp->tv_nsec = bridge_tp->tv_nsec;
-  return tp;
-}
-
-struct bridge_timespec *ToBridgeTimespec(const struct timespec *tp,
-                                         struct bridge_timespec *bridge_tp) {
-  bridge_tp->tv_sec = tp->tv_sec;
-  bridge_tp->tv_nsec = tp->tv_nsec;
-  return bridge_tp;
-}
-
-struct timeval *FromBridgeTimeVal(const struct bridge_timeval *bridge_tv,
-                                  struct timeval *tv) {
-  if (!bridge_tv || !tv) return nullptr;
-  tv->tv_sec = bridge_tv->tv_sec;
-  tv->tv_usec = bridge_tv->tv_usec;
-  return tv;
-}
-
-struct bridge_timeval *ToBridgeTimeVal(const struct timeval *tv,
-                                       struct bridge_timeval *bridge_tv) {
-  if (!tv || !bridge_tv) return nullptr;
-  bridge_tv->tv_sec = tv->tv_sec;
-  bridge_tv->tv_usec = tv->tv_usec;
-  return bridge_tv;
-}
-
 int FromBridgeWStatus(struct BridgeWStatus bridge_wstatus) {
   int wstatus = static_cast<int>(bridge_wstatus.info) << 8;
   if (BridgeWIfExited(bridge_wstatus)) {
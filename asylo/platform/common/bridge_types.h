@@ -29,6 +29,7 @@
 #include <syslog.h>
 
 #include "absl/base/attributes.h"
+#include "asylo/platform/arch/sgx/host_calls_generator/generated_bridge_structs.h"
 
 // This file provides a set of type definitions used both inside and outside the
 // enclave.
@@ -283,6 +284,17 @@ struct bridge_pollfd {
   int16_t revents;
 };
 
+struct bridge_int_sockopt {
+  int32_t level;
+  int32_t option_name;
+  int32_t value;
+};
+
+struct bridge_epoll_event {
+  uint32_t events;
+  uint64_t data;
+} ABSL_ATTRIBUTE_PACKED;
+
 struct bridge_msghdr {
   void *msg_name;
   uint64_t msg_namelen;
@@ -298,6 +310,11 @@ struct bridge_iovec {
   uint64_t iov_len;
 };
 
+struct bridge_mmsghdr {
+  struct bridge_msghdr msg_hdr;
+  uint32_t msg_len;
+};
+
 struct bridge_siginfo_t {
   int32_t si_signo;
   int32_t si_code;
@@ -434,13 +451,9 @@ int FromBridgeOptionName(int level, int bridge_option_name);
 // Converts |option_name| to a bridge option name.
 int ToBridgeOptionName(int level, int option_name);
 
-// Converts |bridge_st| to a runtime stat. Returns nullptr if unsuccessful.
-struct stat *FromBridgeStat(const struct bridge_stat *bridge_statbuf,
-                            struct stat *statbuf);
-
-// Converts |st| to a bridge stat. Returns nullptr if unsuccessful.
-struct bridge_stat *ToBridgeStat(const struct stat *statbuf,
-                                 struct bridge_stat *bridge_statbuf);
+// Translations of the structs listed in
+// asylo/platform/arch/sgx/host_calls_generator/bridge_structs.textproto, such
+// as stat and pollfd, are declared in generated_bridge_structs.h.
 
 // Copies |bridge_addr| to a runtime sockaddr up to sizeof(struct
 // bridge_sockaddr). Returns nullptr if unsuccessful.
@@ -452,30 +465,6 @@ struct sockaddr *FromBridgeSockaddr(const struct bridge_sockaddr *bridge_addr,
 struct bridge_sockaddr *ToBridgeSockaddr(const struct sockaddr *addr,
                                          struct bridge_sockaddr *bridge_addr);
 
-// Converts |bridge_tp| to a runtime timespec.
-struct timespec *FromBridgeTimespec(const struct bridge_timespec *bridge_tp,
-                                    struct timespec *tp);
-
-// Converts |tp| to a bridge timespec.
-struct bridge_timespec *ToBridgeTimespec(const struct timespec *tp,
-                                         struct bridge_timespec *bridge_tp);
-
-// Converts |bridge_tv| to a runtime timeval.
-struct timeval *FromBridgeTimeVal(const struct bridge_timeval *bridge_tv,
-                                  struct timeval *tv);
-
-// Converts |tv| to a bridge timeval.
-struct bridge_timeval *ToBridgeTimeVal(const struct timeval *tv,
-                                       struct bridge_timeval *bridge_tv);
-
-// Converts |fd| to a bridge pollfd. Returns nullptr if unsuccessful.
-struct pollfd *FromBridgePollfd(const struct bridge_pollfd *bridge_fd,
-                                struct pollfd *fd);
-
-// Converts |bridge_fd| to a runtime pollfd. Returns nullptr if unsuccessful.
-struct bridge_pollfd *ToBridgePollfd(const struct pollfd *fd,
-                                     struct bridge_pollfd *bridge_fd);
-
 // Converts |bridge_msg| to a runtime msghdr. This only does a shallow copy of
 // the pointers. A deep copy of the |iovec| array is done in a helper class
 // |BridgeMsghdrWrapper| in host_calls. Returns nullptr if unsuccessful.
@@ -500,14 +489,6 @@ struct msghdr *FromBridgeIovecArray(const struct bridge_msghdr *bridge_msg,
 struct bridge_msghdr *ToBridgeIovecArray(const struct msghdr *msg,
                                          struct bridge_msghdr *bridge_msg);
 
-// Converts |bridge_iov| to a runtime iovec. Returns nullptr if unsuccessful.
-struct iovec *FromBridgeIovec(const struct bridge_iovec *bridge_iov,
-                              struct iovec *iov);
-
-// Converts |iov| to a bridge iovec. Returns nullptr if unsuccessful.
-struct bridge_iovec *ToBridgeIovec(const struct iovec *iov,
-                                   struct bridge_iovec *bridge_iov);
-
 // Converts |host_wstatus| to a runtime wstatus.
 // This only works when converting into an enclave runtime wstatus, not on host.
 int FromBridgeWStatus(struct BridgeWStatus bridge_wstatus);
@@ -0,0 +1,109 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/common/cpu_topology.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <string>
+
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_split.h"
+#include "absl/strings/strip.h"
+
+namespace asylo {
+namespace {
+
+constexpr char kNodeDirectory[] = "/sys/devices/system/node";
+
+// Largest number accepted in a list, which bounds the size of ranges.
+constexpr int kMaxListValue = 1 << 16;
+
+// Reads the contents of the small file at |path| into |contents|.
+bool ReadFile(const std::string &path, std::string *contents) {
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+  contents->clear();
+  char buffer[4096];
+  ssize_t bytes;
+  while ((bytes = read(fd, buffer, sizeof(buffer))) > 0) {
+    contents->append(buffer, bytes);
+  }
+  close(fd);
+  return bytes == 0;
+}
+
+bool ParseValue(absl::string_view text, int *value) {
+  return absl::SimpleAtoi(text, value) && *value >= 0 &&
+         *value <= kMaxListValue;
+}
+
+}  // namespace
+
+bool ParseCpuList(absl::string_view list, std::vector<int> *values) {
+  list = absl::StripAsciiWhitespace(list);
+  if (list.empty()) {
+    return true;
+  }
+  for (absl::string_view range : absl::StrSplit(list, ',')) {
+    std::pair<absl::string_view, absl::string_view> bounds =
+        absl::StrSplit(range, absl::MaxSplits('-', 1));
+    int first;
+    if (!ParseValue(bounds.first, &first)) {
+      return false;
+    }
+    int last = first;
+    if (range.find('-') != absl::string_view::npos &&
+        (!ParseValue(bounds.second, &last) || last < first)) {
+      return false;
+    }
+    for (int value = first; value <= last; ++value) {
+      values->push_back(value);
+    }
+  }
+  return true;
+}
+
+std::vector<std::vector<int>> ReadNumaNodeCpus() {
+  std::vector<std::vector<int>> node_cpus;
+  std::string contents;
+  std::vector<int> nodes;
+  if (!ReadFile(absl::StrCat(kNodeDirectory, "/online"), &contents) ||
+      !ParseCpuList(contents, &nodes)) {
+    return node_cpus;
+  }
+  for (int node : nodes) {
+    std::vector<int> cpus;
+    if (!ReadFile(absl::StrCat(kNodeDirectory, "/node", node, "/cpulist"),
+                  &contents) ||
+        !ParseCpuList(contents, &cpus)) {
+      return {};
+    }
+    if (node_cpus.size() <= static_cast<size_t>(node)) {
+      node_cpus.resize(node + 1);
+    }
+    node_cpus[node] = std::move(cpus);
+  }
+  return node_cpus;
+}
+
+}  // namespace asylo
@@ -0,0 +1,42 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_PLATFORM_COMMON_CPU_TOPOLOGY_H_
+#define ASYLO_PLATFORM_COMMON_CPU_TOPOLOGY_H_
+
+#include <vector>
+
+#include "absl/strings/string_view.h"
+
+namespace asylo {
+
+// Parses a list of CPUs or NUMA nodes in the format used by the kernel, such
+// as "0-3,8,10-11", appending the numbers to |values|. Surrounding whitespace
+// is ignored. Returns false if |list| is malformed.
+bool ParseCpuList(absl::string_view list, std::vector<int> *values);
+
+// Returns the CPUs of each online NUMA node of the host, indexed by node
+// number, as described under /sys/devices/system/node. Nodes which are not
+// online have no CPUs. Returns an empty vector if the topology is unavailable.
+// Inside an enclave the files are read from the host, so the result is
+// untrusted and should only guide placement decisions.
+std::vector<std::vector<int>> ReadNumaNodeCpus();
+
+}  // namespace asylo
+
+#endif  // ASYLO_PLATFORM_COMMON_CPU_TOPOLOGY_H_
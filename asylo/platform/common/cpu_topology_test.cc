@@ -0,0 +1,66 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/common/cpu_topology.h"
+
+#include <set>
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+namespace asylo {
+namespace {
+
+using ::testing::ElementsAre;
+using ::testing::IsEmpty;
+
+TEST(CpuTopologyTest, ParsesRangesAndSingleValues) {
+  std::vector<int> values;
+  ASSERT_TRUE(ParseCpuList("0-3,8,10-11\n", &values));
+  EXPECT_THAT(values, ElementsAre(0, 1, 2, 3, 8, 10, 11));
+}
+
+TEST(CpuTopologyTest, ParsesEmptyList) {
+  std::vector<int> values;
+  ASSERT_TRUE(ParseCpuList("\n", &values));
+  EXPECT_THAT(values, IsEmpty());
+}
+
+TEST(CpuTopologyTest, RejectsMalformedLists) {
+  std::vector<int> values;
+  EXPECT_FALSE(ParseCpuList("3-1", &values));
+  EXPECT_FALSE(ParseCpuList("1,,2", &values));
+  EXPECT_FALSE(ParseCpuList("a-b", &values));
+  EXPECT_FALSE(ParseCpuList("-1", &values));
+  EXPECT_FALSE(ParseCpuList("0-99999999", &values));
+}
+
+// Tests that each CPU of the host belongs to at most one node, if the host
+// describes its topology at all.
+TEST(CpuTopologyTest, NodesDoNotShareCpus) {
+  std::set<int> seen;
+  for (const std::vector<int> &cpus : ReadNumaNodeCpus()) {
+    for (int cpu : cpus) {
+      EXPECT_TRUE(seen.insert(cpu).second) << cpu;
+    }
+  }
+}
+
+}  // namespace
+}  // namespace asylo
@@ -0,0 +1,129 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/common/hazard_pointer.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <functional>
+#include <utility>
+
+namespace asylo {
+namespace {
+
+// Hazard slots of one thread. Records are shared by all domains, and are never
+// freed once registered.
+struct ThreadRecord {
+  std::atomic<const void *> slots[HazardPointerDomain::kSlotsPerThread];
+  ThreadRecord *next;
+};
+
+// Head of the list of all thread records.
+std::atomic<ThreadRecord *> thread_records(nullptr);
+
+// Number of registered thread records.
+std::atomic<size_t> thread_record_count(0);
+
+// Record and number of guards held by the calling thread.
+thread_local ThreadRecord *current_record = nullptr;
+thread_local int current_depth = 0;
+
+ThreadRecord *CurrentRecord() {
+  if (!current_record) {
+    ThreadRecord *record = new ThreadRecord();
+    for (std::atomic<const void *> &slot : record->slots) {
+      slot.store(nullptr, std::memory_order_relaxed);
+    }
+    record->next = thread_records.load(std::memory_order_relaxed);
+    while (!thread_records.compare_exchange_weak(record->next, record)) {
+    }
+    thread_record_count.fetch_add(1, std::memory_order_relaxed);
+    current_record = record;
+  }
+  return current_record;
+}
+
+}  // namespace
+
+constexpr int HazardPointerDomain::kSlotsPerThread;
+
+HazardPointerDomain::Guard::Guard() {
+  if (current_depth == kSlotsPerThread) {
+    abort();
+  }
+  slot_ = &CurrentRecord()->slots[current_depth++];
+}
+
+HazardPointerDomain::Guard::~Guard() {
+  slot_->store(nullptr, std::memory_order_release);
+  --current_depth;
+}
+
+HazardPointerDomain::~HazardPointerDomain() {
+  for (RetiredObject &object : retired_) {
+    object.reclaim();
+  }
+}
+
+void HazardPointerDomain::Retire(const void *pointer,
+                                 std::function<void()> reclaim) {
+  std::vector<std::function<void()>> reclaimed;
+  {
+    std::lock_guard<std::mutex> lock(lock_);
+    retired_.push_back({pointer, std::move(reclaim)});
+    // Scanning costs time proportional to the number of slots, so only scan
+    // once enough objects have been retired to pay for it.
+    size_t threshold =
+        2 * kSlotsPerThread *
+        thread_record_count.load(std::memory_order_relaxed);
+    if (retired_.size() > threshold) {
+      Scan(&reclaimed);
+    }
+  }
+  // Reclaim outside the lock, since reclamation may retire further objects.
+  for (std::function<void()> &reclaim_object : reclaimed) {
+    reclaim_object();
+  }
+}
+
+void HazardPointerDomain::Scan(std::vector<std::function<void()>> *reclaimed) {
+  std::vector<const void *> hazards;
+  for (ThreadRecord *record = thread_records.load(); record;
+       record = record->next) {
+    for (const std::atomic<const void *> &slot : record->slots) {
+      const void *hazard = slot.load();
+      if (hazard) {
+        hazards.push_back(hazard);
+      }
+    }
+  }
+  std::sort(hazards.begin(), hazards.end(), std::less<const void *>());
+
+  auto still_protected = [&hazards](const RetiredObject &object) {
+    return std::binary_search(hazards.begin(), hazards.end(), object.pointer,
+                              std::less<const void *>());
+  };
+  auto first_reclaimed = std::partition(retired_.begin(), retired_.end(),
+                                        still_protected);
+  for (auto it = first_reclaimed; it != retired_.end(); ++it) {
+    reclaimed->push_back(std::move(it->reclaim));
+  }
+  retired_.erase(first_reclaimed, retired_.end());
+}
+
+}  // namespace asylo
@@ -0,0 +1,101 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_PLATFORM_COMMON_HAZARD_POINTER_H_
+#define ASYLO_PLATFORM_COMMON_HAZARD_POINTER_H_
+
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+namespace asylo {
+
+// Safe memory reclamation for objects read without locks, after Michael's
+// hazard pointers. A reader publishes the pointer it is about to use in a slot
+// of its own; a writer which has unlinked an object retires it, and the object
+// is reclaimed once no slot holds its address.
+//
+// Readers never write shared cache lines, and a reader which blocks while
+// holding a pointer only delays reclamation of that one object.
+class HazardPointerDomain {
+ public:
+  // Maximum number of guards a thread may hold at once.
+  static constexpr int kSlotsPerThread = 4;
+
+  // Protects a single pointer for the lifetime of the guard. Guards must be
+  // destroyed in the reverse order of their creation.
+  class Guard {
+   public:
+    Guard();
+    ~Guard();
+
+    Guard(const Guard &) = delete;
+    Guard &operator=(const Guard &) = delete;
+
+    // Loads the pointer stored in |source| and protects it from reclamation
+    // until the guard is destroyed or Protect() is called again.
+    template <typename T>
+    T *Protect(const std::atomic<T *> &source) {
+      T *pointer = source.load(std::memory_order_relaxed);
+      while (true) {
+        slot_->store(pointer);
+        // The object cannot have been retired after the slot was published if
+        // |source| still holds it.
+        T *current = source.load();
+        if (current == pointer) {
+          return pointer;
+        }
+        pointer = current;
+      }
+    }
+
+   private:
+    std::atomic<const void *> *slot_;
+  };
+
+  HazardPointerDomain() = default;
+
+  HazardPointerDomain(const HazardPointerDomain &) = delete;
+  HazardPointerDomain &operator=(const HazardPointerDomain &) = delete;
+
+  // Reclaims all retired objects. No guard may protect any of them.
+  ~HazardPointerDomain();
+
+  // Arranges for |reclaim| to be called once no guard protects |pointer|,
+  // which must already be unreachable by new readers.
+  void Retire(const void *pointer, std::function<void()> reclaim);
+
+ private:
+  struct RetiredObject {
+    const void *pointer;
+    std::function<void()> reclaim;
+  };
+
+  // Reclaims the retired objects not currently protected by any guard.
+  // Requires lock_ to be held.
+  void Scan(std::vector<std::function<void()>> *reclaimed);
+
+  std::mutex lock_;
+  std::vector<RetiredObject> retired_;
+};
+
+}  // namespace asylo
+
+#endif  // ASYLO_PLATFORM_COMMON_HAZARD_POINTER_H_
@@ -0,0 +1,112 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/common/hazard_pointer.h"
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace asylo {
+namespace {
+
+constexpr int kNumReaders = 4;
+constexpr int kNumUpdates = 20000;
+
+// An object which records whether it is still alive.
+struct Tracked {
+  explicit Tracked(int value) : value(value), alive(true) {}
+  ~Tracked() { alive = false; }
+
+  int value;
+  std::atomic<bool> alive;
+};
+
+TEST(HazardPointerTest, ProtectedObjectIsNotReclaimed) {
+  HazardPointerDomain domain;
+  std::atomic<Tracked *> source(new Tracked(1));
+  bool reclaimed = false;
+  {
+    HazardPointerDomain::Guard guard;
+    Tracked *object = guard.Protect(source);
+    ASSERT_EQ(object->value, 1);
+
+    source.store(nullptr);
+    domain.Retire(object, [object, &reclaimed] {
+      delete object;
+      reclaimed = true;
+    });
+    // Retire enough other objects to force a scan.
+    for (int i = 0; i < 100; ++i) {
+      Tracked *other = new Tracked(i);
+      domain.Retire(other, [other] { delete other; });
+    }
+    EXPECT_FALSE(reclaimed);
+    EXPECT_TRUE(object->alive);
+  }
+  for (int i = 0; i < 100; ++i) {
+    Tracked *other = new Tracked(i);
+    domain.Retire(other, [other] { delete other; });
+  }
+  EXPECT_TRUE(reclaimed);
+}
+
+TEST(HazardPointerTest, DomainReclaimsOnDestruction) {
+  int reclaimed = 0;
+  {
+    HazardPointerDomain domain;
+    domain.Retire(&reclaimed, [&reclaimed] { ++reclaimed; });
+  }
+  EXPECT_EQ(reclaimed, 1);
+}
+
+// Replaces a shared object repeatedly while readers dereference it, checking
+// that no reader ever sees a reclaimed object.
+TEST(HazardPointerTest, ConcurrentReadersAndWriter) {
+  HazardPointerDomain domain;
+  std::atomic<Tracked *> source(new Tracked(0));
+  std::atomic<bool> done(false);
+
+  std::vector<std::thread> readers;
+  for (int i = 0; i < kNumReaders; ++i) {
+    readers.emplace_back([&] {
+      while (!done) {
+        HazardPointerDomain::Guard guard;
+        Tracked *object = guard.Protect(source);
+        ASSERT_TRUE(object->alive);
+        ASSERT_GE(object->value, 0);
+      }
+    });
+  }
+
+  for (int i = 1; i <= kNumUpdates; ++i) {
+    Tracked *old_object = source.exchange(new Tracked(i));
+    domain.Retire(old_object, [old_object] { delete old_object; });
+  }
+  done = true;
+  for (std::thread &reader : readers) {
+    reader.join();
+  }
+  delete source.load();
+}
+
+}  // namespace
+}  // namespace asylo
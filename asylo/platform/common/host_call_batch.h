@@ -0,0 +1,83 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_PLATFORM_COMMON_HOST_CALL_BATCH_H_
+#define ASYLO_PLATFORM_COMMON_HOST_CALL_BATCH_H_
+
+#include <cstddef>
+#include <cstdint>
+
+namespace asylo {
+
+// Header of a single host call in a serialized batch. A batch is a sequence of
+// records laid out back to back in untrusted memory, each followed by
+// |payload_size| bytes of marshalled arguments and padded to a multiple of
+// kHostCallRecordAlignment.
+struct HostCallRecord {
+  // Identifier of the host call, as assigned by the host call code generator.
+  uint32_t call_id;
+
+  // Number of bytes of marshalled arguments following this header.
+  uint32_t payload_size;
+
+  // Value of errno on the host after the call, in bridge representation.
+  int32_t bridge_errno;
+
+  uint32_t reserved;
+
+  // Return value of the host call, widened to 64 bits.
+  int64_t result;
+};
+
+constexpr size_t kHostCallRecordAlignment = 8;
+
+// Returns the number of bytes occupied in a batch by a record carrying
+// |payload_size| bytes of arguments.
+inline size_t HostCallRecordSize(size_t payload_size) {
+  return (sizeof(HostCallRecord) + payload_size + kHostCallRecordAlignment -
+          1) &
+         ~(kHostCallRecordAlignment - 1);
+}
+
+// Invokes |visit(record, payload, payload_size)| on each record of the batch
+// in the |size| bytes at |records|, in order. Returns false, without visiting
+// any further records, on reaching a record which is not contained in the
+// buffer. Each record's payload size is read exactly once, so a concurrent
+// writer cannot make |visit| exceed the bounds of the buffer.
+template <typename Visitor>
+bool ForEachHostCallRecord(uint8_t *records, size_t size, Visitor visit) {
+  size_t offset = 0;
+  while (offset < size) {
+    if (size - offset < sizeof(HostCallRecord)) {
+      return false;
+    }
+    auto *record = reinterpret_cast<HostCallRecord *>(records + offset);
+    size_t payload_size = *static_cast<volatile uint32_t *>(
+        &record->payload_size);
+    if (payload_size > size - offset - sizeof(HostCallRecord)) {
+      return false;
+    }
+    visit(record, records + offset + sizeof(HostCallRecord), payload_size);
+    offset += HostCallRecordSize(payload_size);
+  }
+  return true;
+}
+
+}  // namespace asylo
+
+#endif  // ASYLO_PLATFORM_COMMON_HOST_CALL_BATCH_H_
@@ -0,0 +1,100 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/common/host_call_batch.h"
+
+#include <cstring>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace asylo {
+namespace {
+
+// Appends a record for |call_id| carrying |payload| to |batch|.
+void AppendRecord(uint32_t call_id, const std::vector<uint8_t> &payload,
+                  std::vector<uint8_t> *batch) {
+  size_t offset = batch->size();
+  batch->resize(offset + HostCallRecordSize(payload.size()));
+  HostCallRecord record = {};
+  record.call_id = call_id;
+  record.payload_size = payload.size();
+  memcpy(batch->data() + offset, &record, sizeof(record));
+  if (!payload.empty()) {
+    memcpy(batch->data() + offset + sizeof(record), payload.data(),
+           payload.size());
+  }
+}
+
+TEST(HostCallBatchTest, RecordSizeIsAligned) {
+  EXPECT_EQ(HostCallRecordSize(0), sizeof(HostCallRecord));
+  EXPECT_EQ(HostCallRecordSize(1) % kHostCallRecordAlignment, 0);
+  EXPECT_GE(HostCallRecordSize(1), sizeof(HostCallRecord) + 1);
+  EXPECT_EQ(HostCallRecordSize(kHostCallRecordAlignment),
+            sizeof(HostCallRecord) + kHostCallRecordAlignment);
+}
+
+TEST(HostCallBatchTest, VisitsRecordsInOrder) {
+  std::vector<uint8_t> batch;
+  AppendRecord(3, {1, 2, 3}, &batch);
+  AppendRecord(5, {}, &batch);
+  AppendRecord(7, std::vector<uint8_t>(100, 9), &batch);
+
+  std::vector<uint32_t> call_ids;
+  std::vector<size_t> payload_sizes;
+  EXPECT_TRUE(ForEachHostCallRecord(
+      batch.data(), batch.size(),
+      [&](HostCallRecord *record, uint8_t *payload, size_t payload_size) {
+        call_ids.push_back(record->call_id);
+        payload_sizes.push_back(payload_size);
+        record->result = record->call_id * 2;
+      }));
+  EXPECT_EQ(call_ids, std::vector<uint32_t>({3, 5, 7}));
+  EXPECT_EQ(payload_sizes, std::vector<size_t>({3, 0, 100}));
+
+  HostCallRecord first;
+  memcpy(&first, batch.data(), sizeof(first));
+  EXPECT_EQ(first.result, 6);
+}
+
+TEST(HostCallBatchTest, RejectsTruncatedHeader) {
+  std::vector<uint8_t> batch;
+  AppendRecord(1, {1}, &batch);
+  batch.resize(batch.size() + sizeof(HostCallRecord) - 1);
+
+  int visited = 0;
+  EXPECT_FALSE(ForEachHostCallRecord(
+      batch.data(), batch.size(),
+      [&](HostCallRecord *, uint8_t *, size_t) { ++visited; }));
+  EXPECT_EQ(visited, 1);
+}
+
+TEST(HostCallBatchTest, RejectsPayloadOverrun) {
+  std::vector<uint8_t> batch;
+  AppendRecord(1, {1, 2, 3, 4}, &batch);
+  reinterpret_cast<HostCallRecord *>(batch.data())->payload_size = 1000;
+
+  int visited = 0;
+  EXPECT_FALSE(ForEachHostCallRecord(
+      batch.data(), batch.size(),
+      [&](HostCallRecord *, uint8_t *, size_t) { ++visited; }));
+  EXPECT_EQ(visited, 0);
+}
+
+}  // namespace
+}  // namespace asylo
@@ -0,0 +1,119 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/common/huge_page_arena.h"
+
+#include <sys/mman.h>
+
+#include "asylo/platform/common/singleton.h"
+
+namespace asylo {
+namespace {
+
+// Rounds |size| up to a multiple of |alignment|, a power of two. Returns zero
+// on overflow.
+size_t RoundUp(size_t size, size_t alignment) {
+  size_t rounded = (size + alignment - 1) & ~(alignment - 1);
+  return rounded < size ? 0 : rounded;
+}
+
+}  // namespace
+
+constexpr size_t HugePageArena::kHugePageSize;
+constexpr size_t HugePageArena::kAlignment;
+
+HugePageArena::HugePageArena() : next_(nullptr), remaining_(0) {}
+
+HugePageArena::~HugePageArena() {
+  absl::MutexLock lock(&mu_);
+  for (const Mapping &mapping : mappings_) {
+    munmap(mapping.address, mapping.size);
+  }
+}
+
+HugePageArena *HugePageArena::Default() {
+  return Singleton<HugePageArena>::get();
+}
+
+void *HugePageArena::Map(size_t size) {
+  // Over-allocate by a huge page and trim both ends, since mmap() only aligns
+  // to the base page size.
+  if (size > SIZE_MAX - kHugePageSize) {
+    return nullptr;
+  }
+  size_t padded_size = size + kHugePageSize;
+  void *padded = mmap(nullptr, padded_size, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (padded == MAP_FAILED) {
+    return nullptr;
+  }
+  uintptr_t start = reinterpret_cast<uintptr_t>(padded);
+  uintptr_t aligned = RoundUp(start, kHugePageSize);
+  if (aligned > start) {
+    munmap(padded, aligned - start);
+  }
+  uintptr_t end = start + padded_size;
+  if (end > aligned + size) {
+    munmap(reinterpret_cast<void *>(aligned + size), end - (aligned + size));
+  }
+
+  void *address = reinterpret_cast<void *>(aligned);
+#ifdef MADV_HUGEPAGE
+  // Huge pages are an optimization; the memory is usable without them.
+  madvise(address, size, MADV_HUGEPAGE);
+#endif  // MADV_HUGEPAGE
+  mappings_.push_back({address, size});
+  return address;
+}
+
+void *HugePageArena::Allocate(size_t size) {
+  size_t aligned_size = RoundUp(size, kAlignment);
+  if (aligned_size == 0) {
+    return nullptr;
+  }
+  absl::MutexLock lock(&mu_);
+  if (aligned_size > kHugePageSize / 2) {
+    size_t mapping_size = RoundUp(aligned_size, kHugePageSize);
+    return mapping_size == 0 ? nullptr : Map(mapping_size);
+  }
+  if (aligned_size > remaining_) {
+    // The rest of the current mapping is abandoned; it is less than the
+    // request, which is at most half a huge page.
+    void *mapping = Map(kHugePageSize);
+    if (!mapping) {
+      return nullptr;
+    }
+    next_ = static_cast<uint8_t *>(mapping);
+    remaining_ = kHugePageSize;
+  }
+  void *result = next_;
+  next_ += aligned_size;
+  remaining_ -= aligned_size;
+  return result;
+}
+
+size_t HugePageArena::mapped_bytes() const {
+  absl::MutexLock lock(&mu_);
+  size_t total = 0;
+  for (const Mapping &mapping : mappings_) {
+    total += mapping.size;
+  }
+  return total;
+}
+
+}  // namespace asylo
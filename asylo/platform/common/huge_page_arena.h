@@ -0,0 +1,87 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_PLATFORM_COMMON_HUGE_PAGE_ARENA_H_
+#define ASYLO_PLATFORM_COMMON_HUGE_PAGE_ARENA_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "absl/synchronization/mutex.h"
+
+namespace asylo {
+
+// HugePageArena hands out long-lived regions of host memory carved from
+// mappings aligned to, and sized in multiples of, a 2 MiB huge page, which the
+// kernel is asked to back with transparent huge pages. It serves buffers that
+// enclave threads reserve once and reuse for the life of the enclave, such as
+// their marshalling slabs, so they neither contend on the libc allocator's
+// arenas nor fragment its heap.
+//
+// Regions cannot be released individually; all of them are unmapped when the
+// arena is destroyed. HugePageArena is intended for use by untrusted code and
+// is thread-safe.
+class HugePageArena {
+ public:
+  // The size and alignment of each mapping.
+  static constexpr size_t kHugePageSize = 2 * 1024 * 1024;
+
+  // The alignment of every region.
+  static constexpr size_t kAlignment = 64;
+
+  HugePageArena();
+
+  HugePageArena(const HugePageArena &) = delete;
+  HugePageArena &operator=(const HugePageArena &) = delete;
+
+  // Unmaps every region.
+  ~HugePageArena();
+
+  // Returns the process-wide arena.
+  static HugePageArena *Default();
+
+  // Returns |size| bytes of zeroed memory, or nullptr if |size| is zero or the
+  // memory cannot be mapped. Requests of more than half a huge page are given
+  // mappings of their own.
+  void *Allocate(size_t size) LOCKS_EXCLUDED(mu_);
+
+  // Returns the number of bytes mapped by the arena.
+  size_t mapped_bytes() const LOCKS_EXCLUDED(mu_);
+
+ private:
+  struct Mapping {
+    void *address;
+    size_t size;
+  };
+
+  // Maps |size| bytes, a multiple of kHugePageSize, aligned to kHugePageSize.
+  // Returns nullptr on failure.
+  void *Map(size_t size) EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  mutable absl::Mutex mu_;
+  std::vector<Mapping> mappings_ GUARDED_BY(mu_);
+
+  // The unused tail of the mapping that small requests are carved from.
+  uint8_t *next_ GUARDED_BY(mu_);
+  size_t remaining_ GUARDED_BY(mu_);
+};
+
+}  // namespace asylo
+
+#endif  // ASYLO_PLATFORM_COMMON_HUGE_PAGE_ARENA_H_
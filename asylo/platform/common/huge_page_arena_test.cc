@@ -0,0 +1,107 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/common/huge_page_arena.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace asylo {
+namespace {
+
+// Verify that regions are aligned, zeroed, writable and disjoint.
+TEST(HugePageArenaTest, AllocatesDisjointAlignedRegions) {
+  HugePageArena arena;
+  std::vector<std::pair<uintptr_t, size_t>> regions;
+  for (size_t size : {1, 64, 100, 4096, 65536, 65536, 1 << 20, 1 << 20}) {
+    uint8_t *region = static_cast<uint8_t *>(arena.Allocate(size));
+    ASSERT_NE(region, nullptr);
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(region) % HugePageArena::kAlignment,
+              0);
+    EXPECT_TRUE(std::all_of(region, region + size,
+                            [](uint8_t byte) { return byte == 0; }));
+    memset(region, 0xff, size);
+    regions.emplace_back(reinterpret_cast<uintptr_t>(region), size);
+  }
+
+  std::sort(regions.begin(), regions.end());
+  for (size_t i = 1; i < regions.size(); ++i) {
+    EXPECT_LE(regions[i - 1].first + regions[i - 1].second, regions[i].first);
+  }
+}
+
+// Verify that small requests share huge-page mappings and large requests get
+// mappings of their own, all aligned to a huge page.
+TEST(HugePageArenaTest, MapsWholeHugePages) {
+  HugePageArena arena;
+  void *first = arena.Allocate(4096);
+  ASSERT_NE(first, nullptr);
+  EXPECT_EQ(reinterpret_cast<uintptr_t>(first) % HugePageArena::kHugePageSize,
+            0);
+  ASSERT_NE(arena.Allocate(4096), nullptr);
+  EXPECT_EQ(arena.mapped_bytes(), HugePageArena::kHugePageSize);
+
+  void *large = arena.Allocate(HugePageArena::kHugePageSize + 1);
+  ASSERT_NE(large, nullptr);
+  EXPECT_EQ(reinterpret_cast<uintptr_t>(large) % HugePageArena::kHugePageSize,
+            0);
+  EXPECT_EQ(arena.mapped_bytes(), 3 * HugePageArena::kHugePageSize);
+}
+
+TEST(HugePageArenaTest, RejectsEmptyAndOverflowingRequests) {
+  HugePageArena arena;
+  EXPECT_EQ(arena.Allocate(0), nullptr);
+  EXPECT_EQ(arena.Allocate(SIZE_MAX), nullptr);
+  EXPECT_EQ(arena.mapped_bytes(), 0);
+}
+
+// Verify that concurrent callers receive disjoint regions.
+TEST(HugePageArenaTest, IsThreadSafe) {
+  constexpr int kThreads = 4;
+  constexpr int kAllocations = 1000;
+  HugePageArena arena;
+  std::vector<std::vector<uintptr_t>> results(kThreads);
+  std::vector<std::thread> threads;
+  for (int i = 0; i < kThreads; ++i) {
+    threads.emplace_back([&arena, &results, i] {
+      for (int j = 0; j < kAllocations; ++j) {
+        results[i].push_back(reinterpret_cast<uintptr_t>(arena.Allocate(64)));
+      }
+    });
+  }
+  for (std::thread &thread : threads) {
+    thread.join();
+  }
+
+  std::vector<uintptr_t> all;
+  for (const std::vector<uintptr_t> &result : results) {
+    all.insert(all.end(), result.begin(), result.end());
+  }
+  std::sort(all.begin(), all.end());
+  EXPECT_NE(all.front(), 0);
+  EXPECT_EQ(std::adjacent_find(all.begin(), all.end()), all.end());
+}
+
+}  // namespace
+}  // namespace asylo
@@ -0,0 +1,117 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_PLATFORM_COMMON_MCS_LOCK_H_
+#define ASYLO_PLATFORM_COMMON_MCS_LOCK_H_
+
+#include <xmmintrin.h>
+#include <atomic>
+#include <cstddef>
+
+namespace asylo {
+
+// Size of a cache line, used to keep lock state of different threads apart.
+constexpr size_t kCacheLineSize = 64;
+
+// A fair queue lock after Mellor-Crummey and Scott. Threads acquire the lock
+// in FIFO order, and each waiting thread spins on a flag in its own queue node
+// rather than on the shared lock word, so a release only invalidates the cache
+// line of the next waiter.
+//
+// This implementation uses only synchronized instructions and does not depend
+// on operating system resources, so it may be used before the enclave runtime
+// is initialized.
+class McsLock {
+ public:
+  // The queue entry of a thread which holds or is waiting for the lock. A node
+  // must remain valid, and may not be used with any other lock, from the call
+  // to Acquire() until the matching call to Release().
+  struct alignas(kCacheLineSize) Node {
+    std::atomic<Node *> next;
+    std::atomic<bool> locked;
+  };
+
+  // Initializes an unlocked lock.
+  constexpr McsLock() : tail_(nullptr) {}
+
+  McsLock(const McsLock &) = delete;
+  McsLock &operator=(const McsLock &) = delete;
+
+  // Spins until the lock is acquired on behalf of |node|.
+  void Acquire(Node *node) {
+    node->next.store(nullptr, std::memory_order_relaxed);
+    node->locked.store(true, std::memory_order_relaxed);
+    Node *predecessor = tail_.exchange(node, std::memory_order_acq_rel);
+    if (!predecessor) {
+      return;
+    }
+    predecessor->next.store(node, std::memory_order_release);
+    while (node->locked.load(std::memory_order_acquire)) {
+      _mm_pause();
+    }
+  }
+
+  // Tries to acquire the lock on behalf of |node| without blocking. Returns
+  // true if the lock was acquired, otherwise false.
+  bool TryLock(Node *node) {
+    node->next.store(nullptr, std::memory_order_relaxed);
+    Node *expected = nullptr;
+    return tail_.compare_exchange_strong(expected, node,
+                                         std::memory_order_acq_rel);
+  }
+
+  // Releases the lock, which must be held on behalf of |node|.
+  void Release(Node *node) {
+    Node *successor = node->next.load(std::memory_order_acquire);
+    if (!successor) {
+      Node *expected = node;
+      if (tail_.compare_exchange_strong(expected, nullptr,
+                                        std::memory_order_acq_rel)) {
+        return;
+      }
+      // A successor has swapped itself in as the tail but has not linked
+      // itself to |node| yet.
+      while (!(successor = node->next.load(std::memory_order_acquire))) {
+        _mm_pause();
+      }
+    }
+    successor->locked.store(false, std::memory_order_release);
+  }
+
+ private:
+  alignas(kCacheLineSize) std::atomic<Node *> tail_;
+};
+
+// Holds an McsLock for the lifetime of the object, using a queue node on the
+// stack.
+class McsLockGuard {
+ public:
+  explicit McsLockGuard(McsLock *lock) : lock_(lock) { lock_->Acquire(&node_); }
+  ~McsLockGuard() { lock_->Release(&node_); }
+
+  McsLockGuard(const McsLockGuard &) = delete;
+  McsLockGuard &operator=(const McsLockGuard &) = delete;
+
+ private:
+  McsLock *const lock_;
+  McsLock::Node node_;
+};
+
+}  // namespace asylo
+
+#endif  // ASYLO_PLATFORM_COMMON_MCS_LOCK_H_
@@ -0,0 +1,72 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/common/mcs_lock.h"
+
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace asylo {
+namespace {
+
+constexpr int kThreadCount = 8;
+constexpr int kIterationCount = 20000;
+
+TEST(McsLockTest, TryLockFailsWhileHeld) {
+  McsLock lock;
+  McsLock::Node holder;
+  McsLock::Node contender;
+  EXPECT_TRUE(lock.TryLock(&holder));
+  EXPECT_FALSE(lock.TryLock(&contender));
+  lock.Release(&holder);
+  EXPECT_TRUE(lock.TryLock(&contender));
+  lock.Release(&contender);
+}
+
+TEST(McsLockTest, NodesArePadded) {
+  EXPECT_EQ(alignof(McsLock::Node), kCacheLineSize);
+  EXPECT_EQ(sizeof(McsLock::Node) % kCacheLineSize, 0);
+}
+
+// Increments a shared counter non-atomically from several threads and checks
+// that no increments were lost.
+TEST(McsLockTest, MutualExclusion) {
+  McsLock lock;
+  int counter = 0;
+  std::vector<std::thread> threads;
+  for (int i = 0; i < kThreadCount; ++i) {
+    threads.emplace_back([&lock, &counter] {
+      McsLock::Node node;
+      for (int j = 0; j < kIterationCount; ++j) {
+        lock.Acquire(&node);
+        int value = counter;
+        counter = value + 1;
+        lock.Release(&node);
+      }
+    });
+  }
+  for (std::thread &thread : threads) {
+    thread.join();
+  }
+  EXPECT_EQ(counter, kThreadCount * kIterationCount);
+}
+
+}  // namespace
+}  // namespace asylo
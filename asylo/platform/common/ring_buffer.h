@@ -19,6 +19,8 @@
 #ifndef ASYLO_PLATFORM_COMMON_RING_BUFFER_H_
 #define ASYLO_PLATFORM_COMMON_RING_BUFFER_H_
 
+#include <xmmintrin.h>
+#include <algorithm>
 #include <array>
 #include <atomic>
 #include <cstddef>
@@ -29,6 +31,35 @@
 
 namespace asylo {
 
+// Strategies for waiting in the blocking RingBuffer::Read and
+// RingBuffer::Write. Wait() is called with the number of times the caller has
+// already waited for the same condition.
+
+// Yields the processor between checks. This suits a peer which may not be
+// running.
+struct YieldWaitStrategy {
+  static void Wait(uint32_t attempt) { std::this_thread::yield(); }
+};
+
+// Spins between checks. This suits a peer known to be running on another
+// core, and avoids leaving an enclave to yield.
+struct SpinWaitStrategy {
+  static void Wait(uint32_t attempt) { _mm_pause(); }
+};
+
+// Spins for a while, then yields.
+struct BackoffWaitStrategy {
+  static constexpr uint32_t kSpins = 1024;
+
+  static void Wait(uint32_t attempt) {
+    if (attempt < kSpins) {
+      _mm_pause();
+    } else {
+      std::this_thread::yield();
+    }
+  }
+};
+
 // A synchronized queue of bytes supporting exactly one reader and exactly one
 // writer. The case of sharing a buffer between multiple simultaneous readers or
 // writers is not supported and will corrupt the buffer contents.
@@ -44,10 +75,19 @@ namespace asylo {
 // hardware. Only atomic instructions are used for synchronization and the
 // availability of mechanisms like condition variables is not assumed.
 //
-// All read and write operations address the buffer with indices modulo a buffer
-// size specified at compile time. This means that corruption of runtime data
-// cannot cause the calling thread to access memory outside the bounds of the
-// object itself.
+// The writer only ever stores the tail index and the reader only ever stores
+// the head index. The two indices are kept on separate cache lines, and each
+// side keeps a private copy of the other side's index, refreshed only when the
+// copy suggests the buffer is full or empty. A steady stream of operations
+// therefore does not move cache lines between the reader and the writer for
+// every call.
+//
+// Indices run modulo twice the capacity, which distinguishes a full buffer from
+// an empty one without a shared count. Every index read from the buffer is
+// reduced modulo a size specified at compile time and every length derived
+// from indices is clamped to the capacity. This means that corruption of
+// runtime data cannot cause the calling thread to access memory outside the
+// bounds of the object itself.
 //
 // A simple versioning scheme is supported to sanity check the compatibility of
 // objects and types at runtime, as this type is intended to remain compatible
@@ -61,7 +101,7 @@ namespace asylo {
 template <size_t kCapacity>
 class RingBufferForTest;
 
-template <size_t kCapacity>
+template <size_t kCapacity, typename WaitStrategy = YieldWaitStrategy>
 class RingBuffer {
  public:
   static_assert(kCapacity > 1, "Minimum supported size is two elements.");
@@ -74,20 +114,21 @@ class RingBuffer {
                 "std::atomic<size_t> is not lock free.");
 
   RingBuffer()
-      : instance_version_(RingBuffer<kCapacity>::TypeVersion()),
+      : instance_version_(RingBuffer::TypeVersion()),
         closed_for_read_(0),
         closed_for_write_(0),
-        count_(0),
-        read_pos_(0),
-        write_pos_(0) {}
+        tail_(0),
+        cached_head_(0),
+        head_(0),
+        cached_tail_(0) {}
 
-  RingBuffer(const RingBuffer<kCapacity> &) = delete;
+  RingBuffer(const RingBuffer &) = delete;
 
-  RingBuffer(RingBuffer<kCapacity> &&) = delete;
+  RingBuffer(RingBuffer &&) = delete;
 
-  RingBuffer<kCapacity> &operator=(const RingBuffer &) = delete;
+  RingBuffer &operator=(const RingBuffer &) = delete;
 
-  RingBuffer<kCapacity> &operator=(RingBuffer &&) = delete;
+  RingBuffer &operator=(RingBuffer &&) = delete;
 
   // Reads from the buffer, blocking if data is unavailable.
   size_t Read(uint8_t *buf, size_t nbyte) {
@@ -97,9 +138,14 @@ class RingBuffer {
 
     size_t already_read = 0;
     while (nbyte - already_read > 0) {
-      while (empty()) {
-        if (closed_for_write_) return already_read;
-        std::this_thread::yield();
+      for (uint32_t attempt = 0; empty(); ++attempt) {
+        // The writer may write its last bytes and close between the two
+        // checks, so the buffer is checked again once it is seen closed.
+        if (closed_for_write_.load(std::memory_order_acquire)) {
+          if (empty()) return already_read;
+          break;
+        }
+        WaitStrategy::Wait(attempt);
       }
       already_read += NonBlockingRead(buf + already_read, nbyte - already_read);
     }
@@ -114,9 +160,9 @@ class RingBuffer {
 
     size_t already_written = 0;
     while (nbyte - already_written > 0) {
-      while (full()) {
+      for (uint32_t attempt = 0; full(); ++attempt) {
         if (closed_for_read_) return already_written;
-        std::this_thread::yield();
+        WaitStrategy::Wait(attempt);
       }
       already_written +=
           NonBlockingWrite(buf + already_written, nbyte - already_written);
@@ -124,6 +170,47 @@ class RingBuffer {
     return already_written;
   }
 
+  // Reserves contiguous free space for the writer to fill in place. Returns a
+  // pointer to the space and stores its length, at most |*nbyte|, in |*nbyte|.
+  // The length is zero if the buffer is full. The space may be shorter than
+  // the free space in the buffer when it wraps around the end of the buffer.
+  uint8_t *ReserveWrite(size_t *nbyte) {
+    size_t tail = LoadIndex(tail_, std::memory_order_relaxed);
+    size_t index = tail % kCapacity;
+    size_t size = std::min({*nbyte, WritableBytes(tail, *nbyte),
+                            kCapacity - index});
+    *nbyte = size;
+    return buffer_.data() + index;
+  }
+
+  // Publishes |nbyte| bytes of space returned by ReserveWrite to the reader.
+  // |nbyte| must not exceed the length reserved.
+  void CommitWrite(size_t nbyte) {
+    size_t tail = LoadIndex(tail_, std::memory_order_relaxed);
+    nbyte = std::min(nbyte, WritableBytes(tail, nbyte));
+    tail_.store(Advance(tail, nbyte), std::memory_order_release);
+  }
+
+  // Returns a pointer to contiguous data for the reader to use in place, and
+  // stores its length, at most |*nbyte|, in |*nbyte|. The length is zero if the
+  // buffer is empty.
+  const uint8_t *PeekRead(size_t *nbyte) {
+    size_t head = LoadIndex(head_, std::memory_order_relaxed);
+    size_t index = head % kCapacity;
+    size_t size = std::min({*nbyte, ReadableBytes(head, *nbyte),
+                            kCapacity - index});
+    *nbyte = size;
+    return buffer_.data() + index;
+  }
+
+  // Releases |nbyte| bytes of data returned by PeekRead back to the writer.
+  // |nbyte| must not exceed the length returned.
+  void ConsumeRead(size_t nbyte) {
+    size_t head = LoadIndex(head_, std::memory_order_relaxed);
+    nbyte = std::min(nbyte, ReadableBytes(head, nbyte));
+    head_.store(Advance(head, nbyte), std::memory_order_release);
+  }
+
   // Sets the closed-for-write flag, indicating that no more writes to this
   // buffer are expected and the reader should not wait for more data.
   void close_for_write() { closed_for_write_ = 1; }
@@ -147,59 +234,109 @@ class RingBuffer {
   void UnsynchronizedClear() {
     closed_for_read_ = 0;
     closed_for_write_ = 0;
-    count_ = 0;
-    read_pos_ = 0;
-    write_pos_ = 0;
+    tail_ = 0;
+    cached_head_ = 0;
+    head_ = 0;
+    cached_tail_ = 0;
   }
 
   // Returns the number of bytes of empty space available for writing.
-  size_t available() const { return kCapacity - count_; }
+  size_t available() const { return kCapacity - size(); }
 
   // Returns number of bytes stored in the buffer for reading.
-  size_t size() const { return count_; }
+  size_t size() const {
+    return Distance(LoadIndex(head_, std::memory_order_acquire),
+                    LoadIndex(tail_, std::memory_order_acquire));
+  }
 
   // Returns true is the buffer is empty.
-  bool empty() const { return count_ == 0; }
+  bool empty() const { return size() == 0; }
 
   // Returns true is the buffer is full.
-  bool full() const { return count_ == kCapacity; }
+  bool full() const { return size() == kCapacity; }
 
   // Returns a signature reflecting the layout of this concrete instance.
   uint64_t InstanceVersion() const { return instance_version_; }
 
   // Returns a signature reflecting the layout of this abstract type.
   static const uint64_t TypeVersion() {
-    return offsetof(RingBuffer, count_) << 0 |
-           offsetof(RingBuffer, closed_for_read_) << 8 |
-           offsetof(RingBuffer, closed_for_write_) << 16 |
-           offsetof(RingBuffer, read_pos_) << 24 |
-           offsetof(RingBuffer, write_pos_) << 32 |
-           offsetof(RingBuffer, buffer_) << 40 | sizeof(RingBuffer) << 48;
+    return offsetof(RingBuffer, closed_for_read_) << 0 |
+           offsetof(RingBuffer, closed_for_write_) << 8 |
+           offsetof(RingBuffer, tail_) << 16 |
+           offsetof(RingBuffer, head_) << 24 |
+           offsetof(RingBuffer, buffer_) << 32 | kLayoutRevision << 40 |
+           sizeof(RingBuffer) << 48;
   }
 
  private:
   friend class RingBufferForTest<kCapacity>;
 
+  // Revision of the layout and index scheme, recorded in TypeVersion.
+  static constexpr uint64_t kLayoutRevision = 2;
+
+  // Indices run modulo kIndexRange.
+  static constexpr size_t kIndexRange = 2 * kCapacity;
+
+  // Padding placed after the fields of each side, so that the reader's and
+  // writer's fields never share a cache line.
+  static constexpr size_t kCacheLineSize = 64;
+
+  // Loads |index|, which may have been corrupted, and reduces it modulo
+  // kIndexRange.
+  static size_t LoadIndex(const std::atomic<size_t> &index,
+                          std::memory_order order) {
+    return index.load(order) % kIndexRange;
+  }
+
+  // Returns the number of bytes from |head| to |tail|, clamped to the
+  // capacity.
+  static size_t Distance(size_t head, size_t tail) {
+    return std::min((tail % kIndexRange + kIndexRange - head % kIndexRange) %
+                        kIndexRange,
+                    kCapacity);
+  }
+
+  // Returns |index| advanced by |nbyte|.
+  static size_t Advance(size_t index, size_t nbyte) {
+    return (index % kIndexRange + nbyte) % kIndexRange;
+  }
+
+  // Returns the free space the writer sees at |tail|, refreshing its copy of
+  // the head index if the copy shows less than |wanted| bytes free.
+  size_t WritableBytes(size_t tail, size_t wanted) {
+    size_t free_space = kCapacity - Distance(cached_head_, tail);
+    if (free_space < wanted) {
+      cached_head_ = LoadIndex(head_, std::memory_order_acquire);
+      free_space = kCapacity - Distance(cached_head_, tail);
+    }
+    return free_space;
+  }
+
+  // Returns the data the reader sees at |head|, refreshing its copy of the
+  // tail index if the copy shows less than |wanted| bytes.
+  size_t ReadableBytes(size_t head, size_t wanted) {
+    size_t data_size = Distance(head, cached_tail_);
+    if (data_size < wanted) {
+      cached_tail_ = LoadIndex(tail_, std::memory_order_acquire);
+      data_size = Distance(head, cached_tail_);
+    }
+    return data_size;
+  }
+
   // Reads up to |nbyte| bytes without blocking, returning the number
   // successfully read.
   size_t NonBlockingRead(uint8_t *buf, size_t nbyte) {
-    // Since there is only one reader, and since the writer will only ever add
-    // bytes to the buffer, we can read at least size bytes.
-    size_t size = std::min(nbyte, count_.load());
+    size_t head = LoadIndex(head_, std::memory_order_relaxed);
+    size_t size = std::min(nbyte, ReadableBytes(head, nbyte));
     if (size == 0) {
       return 0;
     }
 
     // There are two contiguous runs of bytes we can read from the buffer: one
-    // to the right of read_index, and potentially one on the left if the run
+    // to the right of the head, and potentially one on the left if the run
     // wraps around to zero. The following calls to memcpy read those bytes
     // into |buf|.
-    //
-    // Note that although read_pos_ should already be in bounds, we double
-    // check when reading it into right_index. This is required to avoid a
-    // time-of-use / time-of-check vulnerability in the event an attacker has
-    // corrupted the shared buffer.
-    size_t right_index = read_pos_ % kCapacity;
+    size_t right_index = head % kCapacity;
     size_t right_count = std::min(size, kCapacity - right_index);
     memcpy(buf, buffer_.data() + right_index, right_count);
     if (size - right_count > 0) {
@@ -207,32 +344,25 @@ class RingBuffer {
       memcpy(buf + right_count, buffer_.data(), size - right_count);
     }
 
-    // Decrement the count of bytes in the buffer atomically since the writer
-    // may be incrementing it concurrently.
-    count_.fetch_add(-size);
-    read_pos_ = (read_pos_ + size) % kCapacity;
-
+    // Publish the space to the writer only after the bytes are copied out.
+    head_.store(Advance(head, size), std::memory_order_release);
     return size;
   }
 
   // Writes up to |nbyte| bytes without blocking, returning the number
   // successfully written.
   size_t NonBlockingWrite(const uint8_t *buf, size_t nbyte) {
-    // Since there is only one writer, and since the reader will only ever
-    // remove bytes from the buffer, we can write at least size bytes.
-    size_t size = std::min(nbyte, kCapacity - count_);
+    size_t tail = LoadIndex(tail_, std::memory_order_relaxed);
+    size_t size = std::min(nbyte, WritableBytes(tail, nbyte));
     if (size == 0) {
       return 0;
     }
 
     // There are two contiguous empty gaps where we can write to in the
-    // buffer: one to the right of right_index, and potentially one on the
-    // left if the gap wraps around to zero. The following calls to memcpy
-    // fill those gaps from |buf|.
-    //
-    // The "% kCapacity" here is required and should not be removed. See
-    // NonBlockingRead for a discussion.
-    size_t right_index = write_pos_ % kCapacity;
+    // buffer: one to the right of the tail, and potentially one on the left if
+    // the gap wraps around to zero. The following calls to memcpy fill those
+    // gaps from |buf|.
+    size_t right_index = tail % kCapacity;
     size_t right_count = std::min(size, kCapacity - right_index);
     memcpy(buffer_.data() + right_index, buf, right_count);
     if (size - right_count > 0) {
@@ -240,20 +370,25 @@ class RingBuffer {
       memcpy(buffer_.data(), buf + right_count, size - right_count);
     }
 
-    // Increment the count of bytes in the buffer atomically since the reader
-    // may be decrementing it concurrently.
-    count_.fetch_add(size);
-    write_pos_ = (write_pos_ + size) % kCapacity;
-
+    // Publish the bytes to the reader only after they are copied in.
+    tail_.store(Advance(tail, size), std::memory_order_release);
     return size;
   }
 
   const uint64_t instance_version_;         // Layout of the struct.
   std::atomic<uint32_t> closed_for_read_;   // Reader is done reading.
   std::atomic<uint32_t> closed_for_write_;  // Writer is done writing.
-  std::atomic<size_t> count_;  // Number of bytes waiting in the queue.
-  volatile size_t read_pos_;   // Read index into buffer_.
-  volatile size_t write_pos_;  // Write index into buffer_.
+
+  // Fields of the writer.
+  std::atomic<size_t> tail_;  // Index of the next byte to write.
+  size_t cached_head_;        // The writer's copy of head_.
+  uint8_t writer_padding_[kCacheLineSize];
+
+  // Fields of the reader.
+  std::atomic<size_t> head_;  // Index of the next byte to read.
+  size_t cached_tail_;        // The reader's copy of tail_.
+  uint8_t reader_padding_[kCacheLineSize];
+
   std::array<uint8_t, kCapacity> buffer_;
 } __attribute__((aligned(8)));  // Ensure 64-bit alignment;
 
@@ -18,8 +18,10 @@
 
 #include "asylo/platform/common/ring_buffer.h"
 
+#include <algorithm>
 #include <cstdint>
 #include <cstdlib>
+#include <cstring>
 #include <thread>
 #include <vector>
 
@@ -40,6 +42,18 @@ class RingBufferForTest : public RingBuffer<Capacity> {
   size_t NonBlockingRead(uint8_t *buf, size_t nbyte) {
     return RingBuffer<Capacity>::NonBlockingRead(buf, nbyte);
   }
+
+  // Overwrites the shared indices, as a hostile peer might.
+  void CorruptIndices(size_t head, size_t tail) {
+    RingBuffer<Capacity>::head_ = head;
+    RingBuffer<Capacity>::tail_ = tail;
+  }
+
+  // Returns true if [|data|, |data| + |size|) lies within the buffer.
+  bool InBounds(const uint8_t *data, size_t size) {
+    const uint8_t *begin = RingBuffer<Capacity>::buffer_.data();
+    return data >= begin && data + size <= begin + Capacity;
+  }
 };
 
 // Generate a series of test data.
@@ -135,13 +149,15 @@ TEST_F(RingBufferTest, SingleThreadedStressTest) {
     switch (random() % 2) {
       // Write some bytes.
       case 0: {
-        size_t count = std::min(next_chunk_size, small_buf.available());
+        size_t count = std::min({next_chunk_size, small_buf.available(),
+                                 kDataSize - data_index});
         data_index +=
             small_buf.NonBlockingWrite(data_.data() + data_index, count);
       } break;
       // Read some bytes.
       case 1: {
-        size_t count = std::min(next_chunk_size, small_buf.size());
+        size_t count = std::min({next_chunk_size, small_buf.size(),
+                                 kDataSize - copy_index});
         copy_index +=
             small_buf.NonBlockingRead(copied_data.data() + copy_index, count);
       } break;
@@ -204,6 +220,85 @@ TEST_F(RingBufferTest, ReadNearlyEmpty) {
   EXPECT_TRUE(buf_.empty());
 }
 
+// Fill and drain the buffer in place through the zero-copy interface.
+TEST_F(RingBufferTest, ReserveAndCommit) {
+  RingBufferForTest<16> ring;
+  size_t size = 10;
+  uint8_t *space = ring.ReserveWrite(&size);
+  ASSERT_EQ(size, 10);
+  memcpy(space, data_.data(), size);
+  EXPECT_TRUE(ring.empty());
+  ring.CommitWrite(size);
+  EXPECT_EQ(ring.size(), 10);
+
+  size = 16;
+  const uint8_t *data = ring.PeekRead(&size);
+  ASSERT_EQ(size, 10);
+  EXPECT_EQ(memcmp(data, data_.data(), size), 0);
+  ring.ConsumeRead(size);
+  EXPECT_TRUE(ring.empty());
+
+  // Contiguous space ends where the buffer wraps around.
+  size = 16;
+  ring.ReserveWrite(&size);
+  EXPECT_EQ(size, 6);
+  ring.CommitWrite(size);
+  size = 16;
+  ring.ReserveWrite(&size);
+  EXPECT_EQ(size, 10);
+
+  // Commits beyond the free space are clamped.
+  ring.CommitWrite(100);
+  EXPECT_TRUE(ring.full());
+}
+
+// Arbitrary index values never lead to accesses outside the buffer.
+TEST_F(RingBufferTest, CorruptIndicesStayInBounds) {
+  RingBufferForTest<255> ring;
+  const size_t kValues[] = {0, 1, 254, 255, 256, 509, 510, 511, SIZE_MAX};
+  for (size_t head : kValues) {
+    for (size_t tail : kValues) {
+      ring.CorruptIndices(head, tail);
+      EXPECT_LE(ring.size(), ring.capacity());
+
+      size_t size = SIZE_MAX;
+      const uint8_t *data = ring.PeekRead(&size);
+      EXPECT_TRUE(ring.InBounds(data, size));
+      size = SIZE_MAX;
+      uint8_t *space = ring.ReserveWrite(&size);
+      EXPECT_TRUE(ring.InBounds(space, size));
+
+      ring.CorruptIndices(head, tail);
+      EXPECT_LE(ring.NonBlockingRead(scratch_.data(), kDataSize),
+                ring.capacity());
+      ring.CorruptIndices(head, tail);
+      EXPECT_LE(ring.NonBlockingWrite(data_.data(), kDataSize),
+                ring.capacity());
+    }
+  }
+}
+
+// Move data between threads through a small buffer with each wait strategy.
+template <typename WaitStrategy>
+void TransferWithWaitStrategy(const std::vector<uint8_t> &data) {
+  RingBuffer<257, WaitStrategy> ring;
+  std::vector<uint8_t> out(data.size());
+  std::thread writer([&] {
+    EXPECT_EQ(ring.Write(data.data(), data.size()), data.size());
+    ring.close_for_write();
+  });
+  EXPECT_EQ(ring.Read(out.data(), out.size()), out.size());
+  writer.join();
+  EXPECT_EQ(out, data);
+}
+
+TEST_F(RingBufferTest, WaitStrategies) {
+  std::vector<uint8_t> data(data_.begin(), data_.begin() + 64 * 1024);
+  TransferWithWaitStrategy<YieldWaitStrategy>(data);
+  TransferWithWaitStrategy<SpinWaitStrategy>(data);
+  TransferWithWaitStrategy<BackoffWaitStrategy>(data);
+}
+
 TEST_F(RingBufferTest, BlockingReadWriteTest) {
   std::vector<uint8_t> out;
   std::thread writer = std::thread([&]() { WriteTestData(); });
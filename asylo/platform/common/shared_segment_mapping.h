@@ -0,0 +1,41 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_PLATFORM_COMMON_SHARED_SEGMENT_MAPPING_H_
+#define ASYLO_PLATFORM_COMMON_SHARED_SEGMENT_MAPPING_H_
+
+#include <cstdint>
+
+namespace asylo {
+
+// A read-only segment file mapped by the host into untrusted memory, which the
+// host registers as a kMemBlockName shared resource so that every enclave it
+// loads reads the same pages. The contents are encrypted and authenticated by
+// the enclave, so the host is trusted with neither their confidentiality nor
+// their integrity.
+struct SharedSegmentMapping {
+  // Address of the first byte of the mapping.
+  uint64_t address;
+
+  // Length of the mapping in bytes.
+  uint64_t size;
+};
+
+}  // namespace asylo
+
+#endif  // ASYLO_PLATFORM_COMMON_SHARED_SEGMENT_MAPPING_H_
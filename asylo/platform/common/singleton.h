@@ -19,7 +19,10 @@
 #ifndef ASYLO_PLATFORM_COMMON_SINGLETON_H_
 #define ASYLO_PLATFORM_COMMON_SINGLETON_H_
 
-#include "absl/synchronization/mutex.h"
+#include <atomic>
+
+#include "absl/base/call_once.h"
+#include "absl/base/optimization.h"
 
 namespace asylo {
 
@@ -38,25 +41,30 @@ struct DefaultFactory {
 // |F|. |F| must be a factory class must provide |T| *Construct() and
 // Destruct(|T| *t) methods to enable construction and destruction of objects of
 // type |T|.
-template <typename T, typename F = DefaultFactory<T>>
+//
+// If the third template parameter |kEager| is true, the instance is created
+// during static initialization of the program rather than by the first call to
+// get(), which keeps construction out of the first caller's latency. Calls to
+// get() made earlier in static initialization still create it.
+//
+// Once the instance exists, get() is a single acquire load.
+template <typename T, typename F = DefaultFactory<T>, bool kEager = false>
 class Singleton {
  public:
   // Returns the pointer to the singleton of type |T|. Creates one using the
   // template parameter |F| if none exists. This method is thread-safe.
-  static T *get() LOCKS_EXCLUDED(mu_) {
-    if (instance_) {
-      return instance_;
-    }
-
-    absl::MutexLock lock(&mu_);
-    if (destroyed_) {
-      return nullptr;
-    }
-    if (instance_) {
-      return instance_;
+  static T *get() {
+    T *instance = instance_.load(std::memory_order_acquire);
+    if (ABSL_PREDICT_TRUE(instance != nullptr)) {
+      return instance;
     }
-    instance_ = F::Construct();
-    return instance_;
+    // Referencing eager_init_ instantiates its definition, which creates the
+    // instance during static initialization.
+    static_cast<void>(eager_init_);
+    absl::call_once(once_, [] {
+      instance_.store(F::Construct(), std::memory_order_release);
+    });
+    return instance_.load(std::memory_order_acquire);
   }
 
   // Destroys the singleton using the template parameter |F|. This method is
@@ -64,28 +72,39 @@ class Singleton {
   // once, and once destroyed, it cannot be recreated. However, the callers of
   // this method responsible for making sure that no other threads are accessing
   // (or plan to access) the singleton any longer.
-  static void Destruct() LOCKS_EXCLUDED(mu_) {
-    absl::MutexLock lock(&mu_);
-    T *tmp_ptr = instance_;
-    instance_ = nullptr;
-    F::Destruct(tmp_ptr);
-    destroyed_ = true;
+  static void Destruct() {
+    // Completing |once_| without constructing ensures that get() never
+    // creates an instance after this call.
+    absl::call_once(once_, [] {});
+    T *tmp_ptr = instance_.exchange(nullptr, std::memory_order_acq_rel);
+    if (tmp_ptr) {
+      F::Destruct(tmp_ptr);
+    }
   }
 
  private:
-  static T *instance_ GUARDED_BY(mu_);
-  static bool destroyed_ GUARDED_BY(mu_);
-  static absl::Mutex mu_;
+  // Creates the instance if |kEager| is true. Returns |kEager|.
+  static bool InitEagerly() {
+    if (kEager) {
+      get();
+    }
+    return kEager;
+  }
+
+  static std::atomic<T *> instance_;
+  static absl::once_flag once_;
+  static const bool eager_init_;
 };
 
-template <typename T, typename F>
-T *Singleton<T, F>::instance_ = nullptr;
+template <typename T, typename F, bool kEager>
+std::atomic<T *> Singleton<T, F, kEager>::instance_{nullptr};
 
-template <typename T, typename F>
-bool Singleton<T, F>::destroyed_ = false;
+template <typename T, typename F, bool kEager>
+absl::once_flag Singleton<T, F, kEager>::once_;
 
-template <typename T, typename F>
-absl::Mutex Singleton<T, F>::mu_;
+template <typename T, typename F, bool kEager>
+const bool Singleton<T, F, kEager>::eager_init_ =
+    Singleton<T, F, kEager>::InitEagerly();
 
 }  // namespace asylo
 
@@ -116,5 +116,48 @@ TYPED_TEST(TypedSingletonTest, SingletonCorrectness) {
   EXPECT_EQ(Singleton<TypeParam>::get(), nullptr);
 }
 
+// CountingFactory counts the instances it constructs. Each value of template
+// parameter |N| is a distinct factory.
+template <int N>
+struct CountingFactory {
+  using value_type = int;
+  static int *Construct() {
+    ++constructed;
+    return new int(N);
+  }
+  static void Destruct(int *t) { delete t; }
+  static int constructed;
+};
+
+template <int N>
+int CountingFactory<N>::constructed = 0;
+
+using EagerSingleton = Singleton<int, CountingFactory<1>, /*kEager=*/true>;
+using LazySingleton = Singleton<int, CountingFactory<2>>;
+using DestructedSingleton = Singleton<int, CountingFactory<3>>;
+
+TEST(SingletonTest, EagerSingletonIsCreatedBeforeFirstGet) {
+  // The instance was created during static initialization.
+  EXPECT_EQ(CountingFactory<1>::constructed, 1);
+  int *instance = EagerSingleton::get();
+  ASSERT_NE(instance, nullptr);
+  EXPECT_EQ(*instance, 1);
+  EXPECT_EQ(CountingFactory<1>::constructed, 1);
+}
+
+TEST(SingletonTest, LazySingletonIsCreatedByFirstGet) {
+  EXPECT_EQ(CountingFactory<2>::constructed, 0);
+  int *instance = LazySingleton::get();
+  EXPECT_EQ(CountingFactory<2>::constructed, 1);
+  EXPECT_EQ(LazySingleton::get(), instance);
+  EXPECT_EQ(CountingFactory<2>::constructed, 1);
+}
+
+TEST(SingletonTest, DestructBeforeGetPreventsConstruction) {
+  DestructedSingleton::Destruct();
+  EXPECT_EQ(DestructedSingleton::get(), nullptr);
+  EXPECT_EQ(CountingFactory<3>::constructed, 0);
+}
+
 }  // namespace
 }  // namespace asylo
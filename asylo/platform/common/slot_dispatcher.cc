@@ -0,0 +1,87 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/common/slot_dispatcher.h"
+
+#include <algorithm>
+
+#include "absl/time/clock.h"
+
+namespace asylo {
+
+SlotDispatcher::SlotDispatcher(int num_slots) { stats_.slots = num_slots; }
+
+void SlotDispatcher::Acquire() {
+  absl::MutexLock lock(&mu_);
+  ++stats_.acquisitions;
+  if (waiters_.empty() && stats_.in_use < stats_.slots) {
+    ++stats_.in_use;
+    return;
+  }
+
+  // Wait for a releasing caller to hand over its slot. The slot stays counted
+  // in |in_use| across the hand-over.
+  Waiter waiter;
+  waiters_.push_back(&waiter);
+  stats_.queue_depth = waiters_.size();
+  stats_.max_queue_depth = std::max(stats_.max_queue_depth, stats_.queue_depth);
+  absl::Time start = absl::Now();
+  while (!waiter.granted) {
+    waiter.granted_cv.Wait(&mu_);
+  }
+
+  absl::Duration wait = absl::Now() - start;
+  ++stats_.waited_acquisitions;
+  stats_.total_wait += wait;
+  stats_.max_wait = std::max(stats_.max_wait, wait);
+}
+
+void SlotDispatcher::Release() {
+  absl::MutexLock lock(&mu_);
+  ++releases_;
+  release_cv_.SignalAll();
+  if (waiters_.empty()) {
+    --stats_.in_use;
+    return;
+  }
+
+  Waiter *next = waiters_.front();
+  waiters_.pop_front();
+  stats_.queue_depth = waiters_.size();
+  next->granted = true;
+  next->granted_cv.Signal();
+}
+
+bool SlotDispatcher::AwaitOtherRelease() {
+  absl::MutexLock lock(&mu_);
+  if (stats_.in_use <= 1) {
+    return false;
+  }
+  uint64_t observed_releases = releases_;
+  while (releases_ == observed_releases) {
+    release_cv_.Wait(&mu_);
+  }
+  return true;
+}
+
+SlotDispatcherStats SlotDispatcher::GetStats() const {
+  absl::MutexLock lock(&mu_);
+  return stats_;
+}
+
+}  // namespace asylo
@@ -0,0 +1,105 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_PLATFORM_COMMON_SLOT_DISPATCHER_H_
+#define ASYLO_PLATFORM_COMMON_SLOT_DISPATCHER_H_
+
+#include <cstdint>
+#include <deque>
+
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+
+namespace asylo {
+
+// A snapshot of the counters of a SlotDispatcher.
+struct SlotDispatcherStats {
+  // Number of slots handed out by the dispatcher.
+  int slots = 0;
+
+  // Number of slots currently held.
+  int in_use = 0;
+
+  // Number of callers currently waiting for a slot.
+  int queue_depth = 0;
+
+  // Largest number of callers that have waited for a slot at once.
+  int max_queue_depth = 0;
+
+  // Number of slots acquired, and how many of those acquisitions waited.
+  uint64_t acquisitions = 0;
+  uint64_t waited_acquisitions = 0;
+
+  // Total and longest time callers spent waiting for a slot.
+  absl::Duration total_wait = absl::ZeroDuration();
+  absl::Duration max_wait = absl::ZeroDuration();
+};
+
+// SlotDispatcher hands out a fixed number of slots to concurrent callers, for
+// example to bound the number of host threads inside an enclave by the number
+// of thread control structures it has. Callers that find every slot taken wait
+// in FIFO order, and a released slot is handed directly to the longest waiting
+// caller, so waiters are neither starved nor woken in a herd.
+//
+// SlotDispatcher is thread-safe.
+class SlotDispatcher {
+ public:
+  // Creates a dispatcher with |num_slots| slots. |num_slots| must be positive.
+  explicit SlotDispatcher(int num_slots);
+
+  SlotDispatcher(const SlotDispatcher &) = delete;
+  SlotDispatcher &operator=(const SlotDispatcher &) = delete;
+
+  // Takes a slot, blocking until one is handed to the caller.
+  void Acquire() LOCKS_EXCLUDED(mu_);
+
+  // Returns a slot taken by Acquire().
+  void Release() LOCKS_EXCLUDED(mu_);
+
+  // Blocks a caller holding a slot until some other holder releases its slot,
+  // for callers that found the resource guarded by the slots exhausted despite
+  // holding one. Returns false without blocking if no other caller holds a
+  // slot, since no release may ever come.
+  bool AwaitOtherRelease() LOCKS_EXCLUDED(mu_);
+
+  // Returns a snapshot of the dispatcher's counters.
+  SlotDispatcherStats GetStats() const LOCKS_EXCLUDED(mu_);
+
+ private:
+  // A caller waiting for a slot.
+  struct Waiter {
+    absl::CondVar granted_cv;
+    bool granted = false;
+  };
+
+  mutable absl::Mutex mu_;
+
+  // Callers waiting for a slot, longest waiting first.
+  std::deque<Waiter *> waiters_ GUARDED_BY(mu_);
+
+  // Number of slots released so far, and a condition variable signaled on
+  // every release for AwaitOtherRelease().
+  uint64_t releases_ GUARDED_BY(mu_) = 0;
+  absl::CondVar release_cv_;
+
+  SlotDispatcherStats stats_ GUARDED_BY(mu_);
+};
+
+}  // namespace asylo
+
+#endif  // ASYLO_PLATFORM_COMMON_SLOT_DISPATCHER_H_
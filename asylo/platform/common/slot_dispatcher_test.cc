@@ -0,0 +1,151 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/common/slot_dispatcher.h"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include "absl/synchronization/mutex.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+
+namespace asylo {
+namespace {
+
+constexpr int kThreadCount = 8;
+constexpr int kIterationCount = 2000;
+
+// Waits until |dispatcher| has |queue_depth| callers waiting.
+void WaitForQueueDepth(const SlotDispatcher &dispatcher, int queue_depth) {
+  while (dispatcher.GetStats().queue_depth != queue_depth) {
+    absl::SleepFor(absl::Milliseconds(1));
+  }
+}
+
+TEST(SlotDispatcherTest, AcquireWithoutContentionDoesNotWait) {
+  SlotDispatcher dispatcher(/*num_slots=*/2);
+  dispatcher.Acquire();
+  dispatcher.Acquire();
+
+  SlotDispatcherStats stats = dispatcher.GetStats();
+  EXPECT_EQ(stats.slots, 2);
+  EXPECT_EQ(stats.in_use, 2);
+  EXPECT_EQ(stats.acquisitions, 2);
+  EXPECT_EQ(stats.waited_acquisitions, 0);
+
+  dispatcher.Release();
+  dispatcher.Release();
+  EXPECT_EQ(dispatcher.GetStats().in_use, 0);
+}
+
+// Checks that no more callers than there are slots hold one at once.
+TEST(SlotDispatcherTest, BoundsConcurrency) {
+  constexpr int kSlots = 3;
+  SlotDispatcher dispatcher(kSlots);
+  std::atomic<int> holders(0);
+  std::atomic<int> max_holders(0);
+  std::vector<std::thread> threads;
+  for (int i = 0; i < kThreadCount; ++i) {
+    threads.emplace_back([&] {
+      for (int j = 0; j < kIterationCount; ++j) {
+        dispatcher.Acquire();
+        int current = ++holders;
+        int observed = max_holders.load();
+        while (current > observed &&
+               !max_holders.compare_exchange_weak(observed, current)) {
+        }
+        --holders;
+        dispatcher.Release();
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+
+  EXPECT_LE(max_holders.load(), kSlots);
+  SlotDispatcherStats stats = dispatcher.GetStats();
+  EXPECT_EQ(stats.in_use, 0);
+  EXPECT_EQ(stats.queue_depth, 0);
+  EXPECT_EQ(stats.acquisitions, kThreadCount * kIterationCount);
+  EXPECT_LE(stats.max_queue_depth, kThreadCount);
+}
+
+// Checks that waiting callers are given slots in the order they arrived.
+TEST(SlotDispatcherTest, HandsOutSlotsInArrivalOrder) {
+  SlotDispatcher dispatcher(/*num_slots=*/1);
+  dispatcher.Acquire();
+
+  absl::Mutex order_mutex;
+  std::vector<int> order;
+  std::vector<std::thread> threads;
+  for (int i = 0; i < kThreadCount; ++i) {
+    threads.emplace_back([&, i] {
+      dispatcher.Acquire();
+      {
+        absl::MutexLock lock(&order_mutex);
+        order.push_back(i);
+      }
+      dispatcher.Release();
+    });
+    WaitForQueueDepth(dispatcher, i + 1);
+  }
+  EXPECT_EQ(dispatcher.GetStats().max_queue_depth, kThreadCount);
+
+  dispatcher.Release();
+  for (auto &thread : threads) {
+    thread.join();
+  }
+
+  ASSERT_EQ(order.size(), kThreadCount);
+  for (int i = 0; i < kThreadCount; ++i) {
+    EXPECT_EQ(order[i], i);
+  }
+  SlotDispatcherStats stats = dispatcher.GetStats();
+  EXPECT_EQ(stats.waited_acquisitions, kThreadCount);
+  EXPECT_GT(stats.total_wait, absl::ZeroDuration());
+  EXPECT_GE(stats.total_wait, stats.max_wait);
+}
+
+TEST(SlotDispatcherTest, AwaitOtherReleaseFailsForSoleHolder) {
+  SlotDispatcher dispatcher(/*num_slots=*/2);
+  dispatcher.Acquire();
+  EXPECT_FALSE(dispatcher.AwaitOtherRelease());
+  dispatcher.Release();
+}
+
+TEST(SlotDispatcherTest, AwaitOtherReleaseReturnsAfterRelease) {
+  SlotDispatcher dispatcher(/*num_slots=*/2);
+  dispatcher.Acquire();
+  dispatcher.Acquire();
+
+  std::thread releaser([&dispatcher] {
+    absl::SleepFor(absl::Milliseconds(10));
+    dispatcher.Release();
+  });
+  EXPECT_TRUE(dispatcher.AwaitOtherRelease());
+  releaser.join();
+  dispatcher.Release();
+  EXPECT_EQ(dispatcher.GetStats().in_use, 0);
+}
+
+}  // namespace
+}  // namespace asylo
@@ -0,0 +1,196 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/common/spawn_request.h"
+
+#include <cstring>
+
+namespace asylo {
+namespace {
+
+struct SpawnRequestHeader {
+  uint32_t search_path;
+  uint32_t argc;
+  uint32_t envc;
+  uint32_t num_file_actions;
+};
+
+struct SpawnFileActionRecord {
+  int32_t type;
+  int32_t fd;
+  int32_t new_fd;
+  int32_t flags;
+  uint32_t mode;
+};
+
+// Returns the number of strings in the null-terminated array |strings|, which
+// may be null.
+uint32_t CountStrings(char *const strings[]) {
+  uint32_t count = 0;
+  while (strings && strings[count]) {
+    ++count;
+  }
+  return count;
+}
+
+// Appends |value| to |out|.
+template <typename T>
+void Append(const T &value, std::string *out) {
+  out->append(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+// Appends |str| and its terminating null byte to |out|.
+void AppendString(const char *str, std::string *out) {
+  out->append(str, strlen(str) + 1);
+}
+
+// Reads from a serialized request, checking every read against its end.
+class Reader {
+ public:
+  Reader(const char *in, size_t size) : next_(in), end_(in + size) {}
+
+  bool at_end() const { return next_ == end_; }
+
+  // Copies the next sizeof(T) bytes to |value|.
+  template <typename T>
+  bool Read(T *value) {
+    if (static_cast<size_t>(end_ - next_) < sizeof(T)) {
+      return false;
+    }
+    memcpy(value, next_, sizeof(T));
+    next_ += sizeof(T);
+    return true;
+  }
+
+  // Points |str| to the next null-terminated string.
+  bool ReadString(const char **str) {
+    const void *null_byte = memchr(next_, '\0', end_ - next_);
+    if (!null_byte) {
+      return false;
+    }
+    *str = next_;
+    next_ = static_cast<const char *>(null_byte) + 1;
+    return true;
+  }
+
+  // Appends the next |count| null-terminated strings and a null pointer to
+  // |strings|.
+  bool ReadStrings(uint32_t count, std::vector<char *> *strings) {
+    // Every string takes at least one byte, which bounds the allocation by the
+    // size of the request.
+    if (count > static_cast<size_t>(end_ - next_)) {
+      return false;
+    }
+    strings->reserve(count + 1);
+    for (uint32_t i = 0; i < count; ++i) {
+      const char *str;
+      if (!ReadString(&str)) {
+        return false;
+      }
+      strings->push_back(const_cast<char *>(str));
+    }
+    strings->push_back(nullptr);
+    return true;
+  }
+
+  size_t remaining() const { return end_ - next_; }
+
+ private:
+  const char *next_;
+  const char *const end_;
+};
+
+}  // namespace
+
+void SerializeSpawnRequest(const char *path, bool search_path,
+                           const SpawnFileAction *file_actions,
+                           size_t num_file_actions, char *const argv[],
+                           char *const envp[], std::string *out) {
+  SpawnRequestHeader header;
+  header.search_path = search_path;
+  header.argc = CountStrings(argv);
+  header.envc = CountStrings(envp);
+  header.num_file_actions = num_file_actions;
+
+  out->clear();
+  Append(header, out);
+  AppendString(path, out);
+  for (uint32_t i = 0; i < header.argc; ++i) {
+    AppendString(argv[i], out);
+  }
+  for (uint32_t i = 0; i < header.envc; ++i) {
+    AppendString(envp[i], out);
+  }
+  for (size_t i = 0; i < num_file_actions; ++i) {
+    const SpawnFileAction &action = file_actions[i];
+    SpawnFileActionRecord record;
+    record.type = action.type;
+    record.fd = action.fd;
+    record.new_fd = action.new_fd;
+    record.flags = action.flags;
+    record.mode = action.mode;
+    Append(record, out);
+    AppendString(action.type == SpawnFileAction::kOpen ? action.path : "",
+                 out);
+  }
+}
+
+bool DeserializeSpawnRequest(const char *in, size_t size,
+                             SpawnRequest *request) {
+  Reader reader(in, size);
+  SpawnRequestHeader header;
+  if (!reader.Read(&header) || !reader.ReadString(&request->path)) {
+    return false;
+  }
+  request->search_path = header.search_path != 0;
+
+  request->argv.clear();
+  request->envp.clear();
+  if (!reader.ReadStrings(header.argc, &request->argv) ||
+      !reader.ReadStrings(header.envc, &request->envp)) {
+    return false;
+  }
+
+  request->file_actions.clear();
+  if (header.num_file_actions >
+      reader.remaining() / (sizeof(SpawnFileActionRecord) + 1)) {
+    return false;
+  }
+  request->file_actions.reserve(header.num_file_actions);
+  for (uint32_t i = 0; i < header.num_file_actions; ++i) {
+    SpawnFileActionRecord record;
+    SpawnFileAction action;
+    if (!reader.Read(&record) || !reader.ReadString(&action.path)) {
+      return false;
+    }
+    if (record.type != SpawnFileAction::kClose &&
+        record.type != SpawnFileAction::kDup2 &&
+        record.type != SpawnFileAction::kOpen) {
+      return false;
+    }
+    action.type = static_cast<SpawnFileAction::Type>(record.type);
+    action.fd = record.fd;
+    action.new_fd = record.new_fd;
+    action.flags = record.flags;
+    action.mode = record.mode;
+    request->file_actions.push_back(action);
+  }
+  return reader.at_end();
+}
+
+}  // namespace asylo
@@ -0,0 +1,91 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_PLATFORM_COMMON_SPAWN_REQUEST_H_
+#define ASYLO_PLATFORM_COMMON_SPAWN_REQUEST_H_
+
+// This file provides the format of a request to spawn a host process, which
+// carries the program, its arguments and environment, and the file actions
+// applied in the child in a single buffer, so that spawning a process takes a
+// single host call.
+//
+// A serialized request is a SpawnRequestHeader, followed by the path of the
+// program, the arguments and the environment strings, each terminated by a
+// null byte, and then one SpawnFileActionRecord per file action, each followed
+// by its path and a null byte. Records are not aligned.
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace asylo {
+
+// A file action applied in the child before it executes the program, as added
+// by posix_spawn_file_actions_addclose(), posix_spawn_file_actions_adddup2()
+// and posix_spawn_file_actions_addopen().
+struct SpawnFileAction {
+  enum Type : int32_t { kClose = 0, kDup2 = 1, kOpen = 2 };
+
+  Type type;
+
+  // The descriptor closed, duplicated or opened.
+  int32_t fd;
+
+  // kDup2 only. The descriptor |fd| is duplicated to.
+  int32_t new_fd;
+
+  // kOpen only. Flags in bridge representation, mode, and the null-terminated
+  // path of the file opened.
+  int32_t flags;
+  uint32_t mode;
+  const char *path;
+};
+
+// A request to spawn a process, as deserialized by DeserializeSpawnRequest().
+// All pointers point into the serialized request.
+struct SpawnRequest {
+  // The program to execute, and whether it is searched for in the PATH, as by
+  // posix_spawnp().
+  const char *path = nullptr;
+  bool search_path = false;
+
+  // Arguments and environment of the program. Both are terminated by a null
+  // pointer.
+  std::vector<char *> argv;
+  std::vector<char *> envp;
+
+  std::vector<SpawnFileAction> file_actions;
+};
+
+// Serializes a request to spawn |path| with the |num_file_actions|
+// |file_actions|, and the null-terminated arrays |argv| and |envp|, either of
+// which may be null, to |out|.
+void SerializeSpawnRequest(const char *path, bool search_path,
+                           const SpawnFileAction *file_actions,
+                           size_t num_file_actions, char *const argv[],
+                           char *const envp[], std::string *out);
+
+// Deserializes the |size|-byte request at |in| into |request|, whose pointers
+// point into |in|. Returns false if |in| is not a valid request.
+bool DeserializeSpawnRequest(const char *in, size_t size,
+                             SpawnRequest *request);
+
+}  // namespace asylo
+
+#endif  // ASYLO_PLATFORM_COMMON_SPAWN_REQUEST_H_
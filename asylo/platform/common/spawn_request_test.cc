@@ -0,0 +1,121 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/common/spawn_request.h"
+
+#include <string>
+
+#include <gtest/gtest.h>
+
+namespace asylo {
+namespace {
+
+TEST(SpawnRequestTest, RoundTrip) {
+  char *argv[] = {const_cast<char *>("ls"), const_cast<char *>("-l"),
+                  const_cast<char *>(""), nullptr};
+  char *envp[] = {const_cast<char *>("PATH=/bin"), nullptr};
+  SpawnFileAction actions[3] = {};
+  actions[0].type = SpawnFileAction::kOpen;
+  actions[0].fd = 0;
+  actions[0].flags = 1;
+  actions[0].mode = 0644;
+  actions[0].path = "/dev/null";
+  actions[1].type = SpawnFileAction::kDup2;
+  actions[1].fd = 7;
+  actions[1].new_fd = 1;
+  actions[2].type = SpawnFileAction::kClose;
+  actions[2].fd = 7;
+
+  std::string serialized;
+  SerializeSpawnRequest("/bin/ls", /*search_path=*/true, actions, 3, argv,
+                        envp, &serialized);
+  SpawnRequest request;
+  ASSERT_TRUE(
+      DeserializeSpawnRequest(serialized.data(), serialized.size(), &request));
+
+  EXPECT_STREQ(request.path, "/bin/ls");
+  EXPECT_TRUE(request.search_path);
+  ASSERT_EQ(request.argv.size(), 4);
+  EXPECT_STREQ(request.argv[0], "ls");
+  EXPECT_STREQ(request.argv[1], "-l");
+  EXPECT_STREQ(request.argv[2], "");
+  EXPECT_EQ(request.argv[3], nullptr);
+  ASSERT_EQ(request.envp.size(), 2);
+  EXPECT_STREQ(request.envp[0], "PATH=/bin");
+  EXPECT_EQ(request.envp[1], nullptr);
+
+  ASSERT_EQ(request.file_actions.size(), 3);
+  EXPECT_EQ(request.file_actions[0].type, SpawnFileAction::kOpen);
+  EXPECT_EQ(request.file_actions[0].fd, 0);
+  EXPECT_EQ(request.file_actions[0].flags, 1);
+  EXPECT_EQ(request.file_actions[0].mode, 0644);
+  EXPECT_STREQ(request.file_actions[0].path, "/dev/null");
+  EXPECT_EQ(request.file_actions[1].type, SpawnFileAction::kDup2);
+  EXPECT_EQ(request.file_actions[1].fd, 7);
+  EXPECT_EQ(request.file_actions[1].new_fd, 1);
+  EXPECT_EQ(request.file_actions[2].type, SpawnFileAction::kClose);
+  EXPECT_EQ(request.file_actions[2].fd, 7);
+}
+
+TEST(SpawnRequestTest, NullArgvAndEnvp) {
+  std::string serialized;
+  SerializeSpawnRequest("/bin/true", /*search_path=*/false, nullptr, 0,
+                        nullptr, nullptr, &serialized);
+  SpawnRequest request;
+  ASSERT_TRUE(
+      DeserializeSpawnRequest(serialized.data(), serialized.size(), &request));
+  EXPECT_FALSE(request.search_path);
+  ASSERT_EQ(request.argv.size(), 1);
+  EXPECT_EQ(request.argv[0], nullptr);
+  ASSERT_EQ(request.envp.size(), 1);
+  EXPECT_EQ(request.envp[0], nullptr);
+  EXPECT_TRUE(request.file_actions.empty());
+}
+
+TEST(SpawnRequestTest, RejectsMalformedInput) {
+  char *argv[] = {const_cast<char *>("sh"), const_cast<char *>("-c"),
+                  nullptr};
+  SpawnFileAction action = {};
+  action.type = SpawnFileAction::kClose;
+  action.fd = 3;
+  std::string serialized;
+  SerializeSpawnRequest("/bin/sh", false, &action, 1, argv, nullptr,
+                        &serialized);
+
+  SpawnRequest request;
+  // Every proper prefix is truncated.
+  for (size_t size = 0; size < serialized.size(); ++size) {
+    EXPECT_FALSE(DeserializeSpawnRequest(serialized.data(), size, &request))
+        << size;
+  }
+
+  // Trailing bytes are rejected.
+  std::string extended = serialized + "x";
+  EXPECT_FALSE(
+      DeserializeSpawnRequest(extended.data(), extended.size(), &request));
+
+  // So are counts larger than the request could hold.
+  std::string huge_count = serialized;
+  huge_count[4] = '\xff';
+  huge_count[7] = '\x7f';
+  EXPECT_FALSE(
+      DeserializeSpawnRequest(huge_count.data(), huge_count.size(), &request));
+}
+
+}  // namespace
+}  // namespace asylo
@@ -20,44 +20,110 @@
 #define ASYLO_PLATFORM_COMMON_SPIN_LOCK_H_
 
 #include <xmmintrin.h>
-#include <atomic>
 #include <cstddef>
+#include <cstdint>
+
+// States of a spin lock word. A lock is acquired by moving its word from
+// kSpinLockUnlocked to kSpinLockLocked, or to kSpinLockSleepers by a waiter
+// which is about to sleep, telling the releasing thread to wake it.
+constexpr uint32_t kSpinLockUnlocked = 0;
+constexpr uint32_t kSpinLockLocked = 1;
+constexpr uint32_t kSpinLockSleepers = 2;
+
+// Number of times a waiter polls a held lock before it sleeps, if it has a
+// SpinLockWaitHook to sleep with.
+constexpr int kSpinLockSpinBudget = 100;
+
+// Largest number of pause instructions a waiter executes between polls.
+constexpr int kSpinLockMaxBackoff = 1024;
+
+// Lets waiters for a spin lock sleep once their spin budget is exhausted, in
+// the manner of a futex. Each side of the enclave boundary supplies its own
+// hooks, so the hooks themselves are never kept in shared memory.
+struct SpinLockWaitHook {
+  // Sleeps while |*word| equals |value|. May return spuriously.
+  void (*wait)(volatile uint32_t *word, uint32_t value);
+
+  // Wakes at least one thread sleeping in |wait| on |word|.
+  void (*wake)(volatile uint32_t *word);
+};
+
+// Tries to acquire the lock word |word| without blocking. Returns true if the
+// lock was acquired, otherwise false.
+inline bool SpinLockTryAcquire(volatile uint32_t *word) {
+  uint32_t expected = kSpinLockUnlocked;
+  return __atomic_compare_exchange_n(word, &expected, kSpinLockLocked,
+                                     /*weak=*/false, __ATOMIC_ACQUIRE,
+                                     __ATOMIC_RELAXED);
+}
+
+// Acquires the lock word |word|. A waiter only attempts the atomic exchange
+// once it has read the lock as free, so waiters poll a shared copy of the
+// cache line rather than writing it, and backs off exponentially between
+// polls. If |hook| is not null, a waiter which exhausts its spin budget sleeps
+// until the lock is released.
+inline void SpinLockAcquire(volatile uint32_t *word,
+                            const SpinLockWaitHook *hook = nullptr) {
+  int backoff = 1;
+  for (int polls = 0; !hook || polls < kSpinLockSpinBudget; ++polls) {
+    if (__atomic_load_n(word, __ATOMIC_RELAXED) == kSpinLockUnlocked &&
+        SpinLockTryAcquire(word)) {
+      return;
+    }
+    for (int i = 0; i < backoff; ++i) {
+      _mm_pause();
+    }
+    if (backoff < kSpinLockMaxBackoff) {
+      backoff *= 2;
+    }
+  }
+
+  // Acquiring the lock in the sleepers state may cause one unneeded wake on
+  // release, but never misses one.
+  while (__atomic_exchange_n(word, kSpinLockSleepers, __ATOMIC_ACQUIRE) !=
+         kSpinLockUnlocked) {
+    hook->wait(word, kSpinLockSleepers);
+  }
+}
+
+// Releases the lock word |word|, which must be held by the calling thread.
+// |hook| must be the hook the lock is acquired with.
+inline void SpinLockRelease(volatile uint32_t *word,
+                            const SpinLockWaitHook *hook = nullptr) {
+  if (__atomic_exchange_n(word, kSpinLockUnlocked, __ATOMIC_RELEASE) ==
+          kSpinLockSleepers &&
+      hook) {
+    hook->wake(word);
+  }
+}
 
 // A spinlock in shared memory, suitable for sharing between trusted and
 // untrusted applications. This implementation uses only synchronized
-// instructions and does not depend on operating system resources.
+// instructions and does not depend on operating system resources, unless
+// waiters are given a SpinLockWaitHook to sleep with. All users of a lock must
+// pass the same kind of hook, or none.
 class SpinLock {
  public:
   // Initializes an unlocked spinlock.
-  SpinLock() : lock_word_(kUnlockedValue) {}
+  SpinLock() : lock_word_(kSpinLockUnlocked) {}
 
-  // Spins in a busy loop until the lock is acquired.
-  void Acquire() {
-    while (!TryLock()) {
-      _mm_pause();
-    }
+  // Spins until the lock is acquired, then sleeps with |hook| if it is given.
+  void Acquire(const SpinLockWaitHook *hook = nullptr) {
+    SpinLockAcquire(&lock_word_, hook);
   }
 
   // Tries to acquire the lock without blocking. Returns true if the lock was
   // acquired, otherwise false.
-  bool TryLock() {
-    uint64_t expected_value = kUnlockedValue;
-    return lock_word_.compare_exchange_strong(expected_value, kLockedValue,
-                                              std::memory_order_acq_rel);
-  }
+  bool TryLock() { return SpinLockTryAcquire(&lock_word_); }
 
   // Releases the lock, which must be held by the calling thread.
-  void Release() {
-    lock_word_.store(kUnlockedValue, std::memory_order_release);
+  void Release(const SpinLockWaitHook *hook = nullptr) {
+    SpinLockRelease(&lock_word_, hook);
   }
 
  private:
-  // Lock value when spinlock is unlocked.
-  static constexpr uint64_t kUnlockedValue = 0x0;
-  // Lock value when spinlock is locked.
-  static constexpr uint64_t kLockedValue = 0x1;
-
-  std::atomic<uint64_t> lock_word_;
+  // A 32-bit word, so that hooks may sleep on it with a futex.
+  volatile uint32_t lock_word_;
 };
 
 #endif  // ASYLO_PLATFORM_COMMON_SPIN_LOCK_H_
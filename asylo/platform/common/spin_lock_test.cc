@@ -0,0 +1,113 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/common/spin_lock.h"
+
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace {
+
+constexpr int kThreadCount = 8;
+constexpr int kIterationCount = 20000;
+
+std::atomic<int> wake_count(0);
+
+void FutexWait(volatile uint32_t *word, uint32_t value) {
+  syscall(SYS_futex, word, FUTEX_WAIT_PRIVATE, value, nullptr, nullptr, 0);
+}
+
+void FutexWake(volatile uint32_t *word) {
+  wake_count++;
+  syscall(SYS_futex, word, FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr, 0);
+}
+
+const SpinLockWaitHook kFutexHook = {FutexWait, FutexWake};
+
+// Increments a shared counter non-atomically from several threads and checks
+// that no increments were lost.
+void CheckMutualExclusion(const SpinLockWaitHook *hook) {
+  SpinLock lock;
+  int counter = 0;
+  std::vector<std::thread> threads;
+  for (int i = 0; i < kThreadCount; ++i) {
+    threads.emplace_back([&lock, &counter, hook] {
+      for (int j = 0; j < kIterationCount; ++j) {
+        lock.Acquire(hook);
+        int value = counter;
+        counter = value + 1;
+        lock.Release(hook);
+      }
+    });
+  }
+  for (std::thread &thread : threads) {
+    thread.join();
+  }
+  EXPECT_EQ(counter, kThreadCount * kIterationCount);
+}
+
+TEST(SpinLockTest, TryLockFailsWhileHeld) {
+  SpinLock lock;
+  EXPECT_TRUE(lock.TryLock());
+  EXPECT_FALSE(lock.TryLock());
+  lock.Release();
+  EXPECT_TRUE(lock.TryLock());
+  lock.Release();
+}
+
+TEST(SpinLockTest, LockWordIsFutexSized) {
+  EXPECT_EQ(sizeof(SpinLock), sizeof(uint32_t));
+}
+
+TEST(SpinLockTest, MutualExclusion) { CheckMutualExclusion(nullptr); }
+
+TEST(SpinLockTest, MutualExclusionWithSleepingWaiters) {
+  CheckMutualExclusion(&kFutexHook);
+}
+
+// Tests that a waiter sleeps once its spin budget is spent and is woken by
+// the release.
+TEST(SpinLockTest, ReleaseWakesSleepingWaiter) {
+  SpinLock lock;
+  lock.Acquire(&kFutexHook);
+  wake_count = 0;
+  std::atomic<bool> acquired(false);
+  std::thread waiter([&lock, &acquired] {
+    lock.Acquire(&kFutexHook);
+    acquired = true;
+    lock.Release(&kFutexHook);
+  });
+
+  // Sleep long enough for the waiter to spend its budget and mark the lock.
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  EXPECT_FALSE(acquired);
+  lock.Release(&kFutexHook);
+  waiter.join();
+  EXPECT_TRUE(acquired);
+  EXPECT_GE(wake_count, 1);
+}
+
+}  // namespace
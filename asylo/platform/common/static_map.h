@@ -108,10 +108,26 @@
 //   };
 //
 //   DEFINE_STATIC_MAP_OF_BASE_TYPE(BaseMap, Base, BaseNamer)
+//
+// Values are added during static initialization, after which the map is
+// typically only read. Calling Freeze() once static initialization is complete
+// makes the map immutable, and lookups and iteration on a frozen map do not
+// take any lock:
+//
+//   int main() {
+//     BaseMap::Freeze();
+//     auto element = BaseMap::GetValue("Derived");        // lock-free
+//     ...
+//   }
+//
+// Adding a value to a frozen map is a fatal error.
 
+#include <algorithm>
+#include <atomic>
 #include <string>
 #include <type_traits>
-#include <unordered_map>
+#include <utility>
+#include <vector>
 
 #include "absl/synchronization/mutex.h"
 #include "asylo/util/logging.h"
@@ -149,10 +165,13 @@ struct Namer;
 // type T. At most one instance of a particular type is allowed in the map, and
 // a unique key for each element is generated using N.
 //
-// The map used internally is dynamically allocated and is never destroyed
-// during the lifetime of the program (i.e. it is intentionally leaked).
+// The map used internally is an array of entries sorted by key. It is
+// dynamically allocated and is never destroyed during the lifetime of the
+// program (i.e. it is intentionally leaked).
 template <class MapName, class T, class N = Namer<T>>
 class StaticMap {
+  using Entries = std::vector<std::pair<std::string, T *>>;
+
  public:
   // ValueInserter is a helper class whose constructor inserts a pointer to an
   // instance of T into the static map.
@@ -174,9 +193,14 @@ class StaticMap {
       // Retrieve a unique string identifier for this object that can be used as
       // a key in the map.
       std::string key = StaticMap::namer_(*value);
-      if (!StaticMap::map_->emplace(key, value).second) {
+      if (StaticMap::frozen_.load(std::memory_order_relaxed)) {
+        LOG(FATAL) << "Adding key " << key << " to frozen static map";
+      }
+      auto it = StaticMap::LowerBound(key);
+      if (it != StaticMap::map_->end() && it->first == key) {
         LOG(FATAL) << "Adding duplicate key " << key << " to static map";
       }
+      StaticMap::map_->emplace(it, std::move(key), value);
     }
   };
 
@@ -185,12 +209,15 @@ class StaticMap {
   // generators that enable iterating over the collection of values.
   class ValueCollection {
    public:
-    using iterator = internal::ValueIterator<
-        T, typename std::unordered_map<std::string, T *>::iterator>;
-    using const_iterator = internal::ValueIterator<
-        const T, typename std::unordered_map<std::string, T *>::const_iterator>;
+    using iterator =
+        internal::ValueIterator<T, typename Entries::iterator>;
+    using const_iterator =
+        internal::ValueIterator<const T, typename Entries::const_iterator>;
 
     ValueCollection() {
+      if (StaticMap::frozen_.load(std::memory_order_acquire)) {
+        return;
+      }
       absl::MutexLock lock(&StaticMap::mu_);
 
       // First-time map initialization.
@@ -230,15 +257,21 @@ class StaticMap {
   // Returns the value_iterator pointing to the T value associated with |key|.
   // Returns value_end() if |key| is not present.
   static value_iterator GetValue(const std::string &key) {
+    if (frozen_.load(std::memory_order_acquire)) {
+      return Find(key);
+    }
     absl::MutexLock lock(&StaticMap::mu_);
 
     // First-time map initialization.
     Initialize();
 
-    return value_iterator(StaticMap::map_->find(key));
+    return Find(key);
   }
 
-  static size_t Size() {
+  static size_t Size() NO_THREAD_SAFETY_ANALYSIS {
+    if (frozen_.load(std::memory_order_acquire)) {
+      return StaticMap::map_->size();
+    }
     absl::MutexLock lock(&StaticMap::mu_);
 
     // First-time map initialization.
@@ -247,26 +280,70 @@ class StaticMap {
     return StaticMap::map_->size();
   }
 
+  // Makes the map immutable. Values can no longer be added, and lookups and
+  // iteration no longer lock the map. Should be called once static
+  // initialization is complete. Freezing a frozen map has no effect.
+  static void Freeze() {
+    absl::MutexLock lock(&StaticMap::mu_);
+
+    // First-time map initialization.
+    Initialize();
+
+    frozen_.store(true, std::memory_order_release);
+  }
+
+  // Returns whether Freeze() has been called.
+  static bool IsFrozen() { return frozen_.load(std::memory_order_acquire); }
+
  private:
   friend class StaticMap::ValueInserter;
   friend class StaticMap::ValueCollection;
 
   static void Initialize() EXCLUSIVE_LOCKS_REQUIRED(mu_) {
     if (map_ == nullptr) {
-      map_ = new std::unordered_map<std::string, T *>();
+      map_ = new Entries();
     }
   }
-  static std::unordered_map<std::string, T *> *map_ GUARDED_BY(mu_);
+
+  // Returns the first entry whose key is not less than |key|. The map must be
+  // frozen, or |mu_| held.
+  static typename Entries::iterator LowerBound(const std::string &key)
+      NO_THREAD_SAFETY_ANALYSIS {
+    return std::lower_bound(
+        map_->begin(), map_->end(), key,
+        [](const typename Entries::value_type &entry, const std::string &key) {
+          return entry.first < key;
+        });
+  }
+
+  // Returns the value_iterator pointing to the value associated with |key|, or
+  // value_end(). The map must be frozen, or |mu_| held.
+  static value_iterator Find(const std::string &key)
+      NO_THREAD_SAFETY_ANALYSIS {
+    auto it = LowerBound(key);
+    if (it == map_->end() || it->first != key) {
+      it = map_->end();
+    }
+    return value_iterator(std::move(it));
+  }
+
+  // Written under |mu_| until the map is frozen, and constant afterwards.
+  static Entries *map_ GUARDED_BY(mu_);
   static absl::Mutex mu_;
+  static std::atomic<bool> frozen_;
   static N namer_;
 };
 
 template <class MapName, class T, class N>
-std::unordered_map<std::string, T *> *StaticMap<MapName, T, N>::map_ = nullptr;
+typename StaticMap<MapName, T, N>::Entries *StaticMap<MapName, T, N>::map_ =
+    nullptr;
 
 template <class MapName, class T, class N>
 absl::Mutex StaticMap<MapName, T, N>::mu_;
 
+template <class MapName, class T, class N>
+std::atomic<bool> StaticMap<MapName, T, N>::frozen_(false);
+
 template <class MapName, class T, class N>
 N StaticMap<MapName, T, N>::namer_;
 
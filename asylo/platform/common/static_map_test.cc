@@ -63,6 +63,11 @@ SET_STATIC_MAP_VALUE_OF_DERIVED_TYPE(BarMap, Baz);
 // Empty static map.
 DEFINE_STATIC_MAP_OF_BASE_TYPE(BazMap, Baz);
 
+// Static map that is frozen by the tests.
+DEFINE_STATIC_MAP_OF_BASE_TYPE(FrozenMap, Foo);
+SET_STATIC_MAP_VALUE_OF_DERIVED_TYPE(FrozenMap, Bar);
+SET_STATIC_MAP_VALUE_OF_DERIVED_TYPE(FrozenMap, Baz);
+
 // Tests functionality of a StaticMap with default Namer specialization.
 TEST(StaticMapTest, TestStaticMapBasic) {
   EXPECT_EQ(FooMap::Size(), 2);
@@ -215,6 +220,33 @@ TEST(StaticMapTest, TestAlgorithmConstIterator) {
   EXPECT_EQ(yam_it, values.cend());
 }
 
+// Tests that a frozen static map holds the same values.
+TEST(StaticMapTest, TestFrozenMap) {
+  EXPECT_FALSE(FrozenMap::IsFrozen());
+  FrozenMap::Freeze();
+  EXPECT_TRUE(FrozenMap::IsFrozen());
+  FrozenMap::Freeze();
+  EXPECT_TRUE(FrozenMap::IsFrozen());
+  EXPECT_FALSE(FooMap::IsFrozen());
+
+  EXPECT_EQ(FrozenMap::Size(), 2);
+  auto bar = FrozenMap::GetValue("Bar");
+  ASSERT_NE(bar, FrozenMap::value_end());
+  EXPECT_EQ(bar->Name(), "Bar");
+  auto baz = FrozenMap::GetValue("Baz");
+  ASSERT_NE(baz, FrozenMap::value_end());
+  EXPECT_EQ(baz->Name(), "Baz");
+  EXPECT_EQ(FrozenMap::GetValue("Ba"), FrozenMap::value_end());
+  EXPECT_EQ(FrozenMap::GetValue("Bazz"), FrozenMap::value_end());
+
+  int count = 0;
+  for (const auto &item : FrozenMap::Values()) {
+    ++count;
+    EXPECT_NE(FrozenMap::GetValue(item.Name()), FrozenMap::value_end());
+  }
+  EXPECT_EQ(count, 2);
+}
+
 }  // namespace
 
 // In order to leave out the optional argument when creating a static map, the
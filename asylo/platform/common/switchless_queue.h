@@ -0,0 +1,173 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_PLATFORM_COMMON_SWITCHLESS_QUEUE_H_
+#define ASYLO_PLATFORM_COMMON_SWITCHLESS_QUEUE_H_
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <thread>
+
+#include "asylo/platform/common/ring_buffer.h"
+
+namespace asylo {
+
+// Number of request slots in a switchless queue. This bounds the number of
+// switchless host calls which may be in flight at any one time.
+constexpr size_t kSwitchlessSlotCount = 64;
+
+// Number of bytes of inline argument storage available to each request. Host
+// calls whose marshalled arguments do not fit take the classic ocall path.
+constexpr size_t kSwitchlessPayloadSize = 4096;
+
+// Size value recorded for a pointer argument that was passed as nullptr.
+constexpr uint64_t kSwitchlessNullPointer = UINT64_MAX;
+
+// Call identifier never assigned to a host call. Workers fail requests with an
+// unknown identifier without calling into the host, so a request with this
+// identifier times the queue alone.
+constexpr uint32_t kSwitchlessProbeCallId = UINT32_MAX;
+
+// Time in nanoseconds for which a host worker keeps polling the queue after
+// it runs out of requests, and then sleeps between polls. Switchless requests
+// made less often than this are likely to wait for a sleeping worker.
+constexpr int64_t kSwitchlessWorkerIdleNs = 200000;
+
+// Waits between polls of the submission ring. Workers yield until they have
+// waited for kSwitchlessWorkerIdleNs, then sleep, so that the workers of an
+// idle queue give up their cores. Trusted writers never wait, since the ring
+// holds an index for every request slot.
+struct SwitchlessWaitStrategy {
+  static void Wait(uint32_t attempt) {
+    thread_local std::chrono::steady_clock::time_point idle_since;
+    if (attempt == 0) {
+      idle_since = std::chrono::steady_clock::now();
+    }
+    if (std::chrono::steady_clock::now() - idle_since <
+        std::chrono::nanoseconds(kSwitchlessWorkerIdleNs)) {
+      std::this_thread::yield();
+    } else {
+      std::this_thread::sleep_for(
+          std::chrono::nanoseconds(kSwitchlessWorkerIdleNs));
+    }
+  }
+};
+
+// States of a switchless request slot.
+enum SwitchlessSlotState : uint32_t {
+  kSwitchlessSlotFree = 0,
+  kSwitchlessSlotSubmitted = 1,
+  kSwitchlessSlotComplete = 2,
+};
+
+// A single host call request. Requests live in untrusted memory and are
+// written by exactly one trusted thread and serviced by exactly one host
+// worker at a time.
+struct SwitchlessRequest {
+  // Current SwitchlessSlotState of the request.
+  std::atomic<uint32_t> state;
+
+  // Identifier of the host call, as assigned by the host call code generator.
+  uint32_t call_id;
+
+  // Number of meaningful bytes in |payload|.
+  uint32_t payload_size;
+
+  // Value of errno on the host after the call, in bridge representation.
+  int32_t bridge_errno;
+
+  // Return value of the host call, widened to 64 bits.
+  int64_t result;
+
+  // Marshalled arguments to the host call.
+  alignas(8) uint8_t payload[kSwitchlessPayloadSize];
+};
+
+// A queue of host call requests shared between an enclave and the pool of
+// host worker threads serving it. Trusted threads fill a request slot and
+// publish its index through a RingBuffer; host workers consume indices, invoke
+// the requested host call, and mark the slot complete.
+//
+// The submission ring supports a single reader and a single writer, so
+// trusted producers and host consumers are each expected to serialize access
+// on their own side of the boundary. As with RingBuffer, nothing read from an
+// instance is assumed to be trustworthy: slot indices are always reduced
+// modulo kSwitchlessSlotCount before use.
+class SwitchlessQueue {
+ public:
+  SwitchlessQueue() : instance_version_(TypeVersion()) {
+    for (SwitchlessRequest &request : slots_) {
+      request.state = kSwitchlessSlotFree;
+    }
+  }
+
+  SwitchlessQueue(const SwitchlessQueue &) = delete;
+  SwitchlessQueue &operator=(const SwitchlessQueue &) = delete;
+
+  // Returns the request slot at |index|.
+  SwitchlessRequest *slot(uint32_t index) {
+    return &slots_[index % kSwitchlessSlotCount];
+  }
+
+  // Publishes the request slot at |index| to the host workers. Returns false
+  // if the queue has been shut down.
+  bool Submit(uint32_t index) {
+    return submissions_.Write(reinterpret_cast<const uint8_t *>(&index),
+                              sizeof(index)) == sizeof(index);
+  }
+
+  // Blocks until a submitted slot index is available and stores it in
+  // |index|. Returns false once the queue has been shut down and drained.
+  bool Take(uint32_t *index) {
+    return submissions_.Read(reinterpret_cast<uint8_t *>(index),
+                             sizeof(*index)) == sizeof(*index);
+  }
+
+  // Stops accepting new submissions. Indices already submitted remain
+  // available to Take().
+  void Shutdown() { submissions_.close_for_write(); }
+
+  // Returns true if the queue has been shut down.
+  bool is_shutdown() const { return submissions_.is_closed_for_write(); }
+
+  // Returns a signature reflecting the layout of this concrete instance.
+  uint64_t InstanceVersion() const { return instance_version_; }
+
+  // Returns a signature reflecting the layout of this abstract type.
+  static uint64_t TypeVersion() {
+    return SubmissionRing::TypeVersion() ^
+           (offsetof(SwitchlessQueue, slots_) << 8 |
+            sizeof(SwitchlessRequest) << 24 |
+            offsetof(SwitchlessRequest, payload) << 48);
+  }
+
+ private:
+  using SubmissionRing = RingBuffer<kSwitchlessSlotCount * sizeof(uint32_t),
+                                    SwitchlessWaitStrategy>;
+
+  const uint64_t instance_version_;
+  SubmissionRing submissions_;
+  std::array<SwitchlessRequest, kSwitchlessSlotCount> slots_;
+};
+
+}  // namespace asylo
+
+#endif  // ASYLO_PLATFORM_COMMON_SWITCHLESS_QUEUE_H_
@@ -0,0 +1,122 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/common/switchless_queue.h"
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace asylo {
+namespace {
+
+constexpr int kRequestCount = 100000;
+
+TEST(SwitchlessQueueTest, VersionMatching) {
+  auto queue = std::unique_ptr<SwitchlessQueue>(new SwitchlessQueue());
+  EXPECT_EQ(queue->InstanceVersion(), SwitchlessQueue::TypeVersion());
+}
+
+TEST(SwitchlessQueueTest, SlotIndexIsBounded) {
+  auto queue = std::unique_ptr<SwitchlessQueue>(new SwitchlessQueue());
+  EXPECT_EQ(queue->slot(0), queue->slot(kSwitchlessSlotCount));
+  EXPECT_EQ(queue->slot(1), queue->slot(kSwitchlessSlotCount + 1));
+  for (uint32_t i = 0; i < kSwitchlessSlotCount; ++i) {
+    EXPECT_EQ(queue->slot(i)->state, kSwitchlessSlotFree);
+  }
+}
+
+TEST(SwitchlessQueueTest, ShutdownRejectsSubmissionsAndDrains) {
+  auto queue = std::unique_ptr<SwitchlessQueue>(new SwitchlessQueue());
+  EXPECT_TRUE(queue->Submit(7));
+  queue->Shutdown();
+  EXPECT_TRUE(queue->is_shutdown());
+  EXPECT_FALSE(queue->Submit(8));
+
+  uint32_t index = 0;
+  EXPECT_TRUE(queue->Take(&index));
+  EXPECT_EQ(index, 7);
+  EXPECT_FALSE(queue->Take(&index));
+}
+
+// Submits a long sequence of requests from one thread while another thread
+// services them, checking that every request is completed exactly once.
+TEST(SwitchlessQueueTest, ProducerConsumer) {
+  auto queue = std::unique_ptr<SwitchlessQueue>(new SwitchlessQueue());
+
+  std::thread worker([&queue] {
+    uint32_t index;
+    while (queue->Take(&index)) {
+      SwitchlessRequest *request = queue->slot(index);
+      EXPECT_EQ(request->state, kSwitchlessSlotSubmitted);
+      request->result = request->call_id * 2;
+      request->state.store(kSwitchlessSlotComplete,
+                           std::memory_order_release);
+    }
+  });
+
+  for (int i = 0; i < kRequestCount; ++i) {
+    uint32_t index = i % kSwitchlessSlotCount;
+    SwitchlessRequest *request = queue->slot(index);
+    request->call_id = i;
+    request->state.store(kSwitchlessSlotSubmitted, std::memory_order_release);
+    ASSERT_TRUE(queue->Submit(index));
+    while (request->state.load(std::memory_order_acquire) !=
+           kSwitchlessSlotComplete) {
+      std::this_thread::yield();
+    }
+    EXPECT_EQ(request->result, static_cast<int64_t>(i) * 2);
+  }
+
+  queue->Shutdown();
+  worker.join();
+}
+
+// Checks that a worker which has gone to sleep on an idle queue still services
+// the next request.
+TEST(SwitchlessQueueTest, ServicesRequestAfterIdle) {
+  auto queue = std::unique_ptr<SwitchlessQueue>(new SwitchlessQueue());
+
+  std::thread worker([&queue] {
+    uint32_t index;
+    while (queue->Take(&index)) {
+      queue->slot(index)->state.store(kSwitchlessSlotComplete,
+                                      std::memory_order_release);
+    }
+  });
+
+  std::this_thread::sleep_for(
+      std::chrono::nanoseconds(kSwitchlessWorkerIdleNs * 5));
+  SwitchlessRequest *request = queue->slot(0);
+  request->state.store(kSwitchlessSlotSubmitted, std::memory_order_release);
+  ASSERT_TRUE(queue->Submit(0));
+  while (request->state.load(std::memory_order_acquire) !=
+         kSwitchlessSlotComplete) {
+    std::this_thread::yield();
+  }
+
+  queue->Shutdown();
+  worker.join();
+}
+
+}  // namespace
+}  // namespace asylo
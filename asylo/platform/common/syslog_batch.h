@@ -0,0 +1,85 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_PLATFORM_COMMON_SYSLOG_BATCH_H_
+#define ASYLO_PLATFORM_COMMON_SYSLOG_BATCH_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace asylo {
+
+// Header of a single message in a serialized batch of syslog messages. A batch
+// is a sequence of records laid out back to back, each followed by the
+// |length| bytes of its message, without a terminating null byte, and padded
+// to a multiple of kSyslogRecordAlignment.
+struct SyslogRecord {
+  // Priority of the message, in bridge representation.
+  int32_t priority;
+
+  // Length of the message.
+  uint32_t length;
+};
+
+constexpr size_t kSyslogRecordAlignment = 4;
+
+// Returns the number of bytes occupied in a batch by a message of |length|
+// bytes.
+inline size_t SyslogRecordSize(size_t length) {
+  return (sizeof(SyslogRecord) + length + kSyslogRecordAlignment - 1) &
+         ~(kSyslogRecordAlignment - 1);
+}
+
+// Appends the |length|-byte |message| with |priority| to |batch|.
+inline void AppendSyslogRecord(int32_t priority, const char *message,
+                               size_t length, std::vector<uint8_t> *batch) {
+  size_t offset = batch->size();
+  batch->resize(offset + SyslogRecordSize(length));
+  SyslogRecord record = {priority, static_cast<uint32_t>(length)};
+  memcpy(batch->data() + offset, &record, sizeof(record));
+  memcpy(batch->data() + offset + sizeof(record), message, length);
+}
+
+// Invokes |visit(priority, message, length)| on each message of the batch in
+// the |size| bytes at |records|, in order. Returns false, without visiting any
+// further messages, on reaching a record which is not contained in the buffer.
+template <typename Visitor>
+bool ForEachSyslogRecord(const uint8_t *records, size_t size, Visitor visit) {
+  size_t offset = 0;
+  while (offset < size) {
+    if (size - offset < sizeof(SyslogRecord)) {
+      return false;
+    }
+    SyslogRecord record;
+    memcpy(&record, records + offset, sizeof(record));
+    if (record.length > size - offset - sizeof(SyslogRecord)) {
+      return false;
+    }
+    visit(record.priority,
+          reinterpret_cast<const char *>(records + offset + sizeof(record)),
+          static_cast<size_t>(record.length));
+    offset += SyslogRecordSize(record.length);
+  }
+  return true;
+}
+
+}  // namespace asylo
+
+#endif  // ASYLO_PLATFORM_COMMON_SYSLOG_BATCH_H_
@@ -0,0 +1,111 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_PLATFORM_COMMON_TSC_CLOCK_H_
+#define ASYLO_PLATFORM_COMMON_TSC_CLOCK_H_
+
+#include <atomic>
+#include <cstdint>
+
+namespace asylo {
+
+// Calibration of the time stamp counter against the host's CLOCK_MONOTONIC and
+// CLOCK_REALTIME. The host publishes it in shared memory, and enclaves which
+// may execute RDTSC use it to tell time without leaving the enclave.
+//
+// Updates are published as a sequence lock: |sequence| is odd while an update
+// is in progress, and readers retry if it changed while they read.
+struct TscClockCalibration {
+  std::atomic<uint64_t> sequence;
+
+  // TSC value at which the host sampled |monotonic_base| and |realtime_base|.
+  std::atomic<uint64_t> tsc_base;
+  std::atomic<int64_t> monotonic_base;
+  std::atomic<int64_t> realtime_base;
+
+  // Nanoseconds per TSC tick as an unsigned 32.32 fixed-point number. Zero
+  // until the host has published a calibration.
+  std::atomic<uint64_t> nanoseconds_per_tick;
+};
+
+// Returns the current value of the time stamp counter.
+inline uint64_t ReadTsc() {
+  uint32_t low, high;
+  asm volatile("rdtsc" : "=a"(low), "=d"(high));
+  return (static_cast<uint64_t>(high) << 32) | low;
+}
+
+// Returns the fixed-point number of nanoseconds per tick for a counter which
+// advanced by |ticks| while |nanoseconds| elapsed.
+inline uint64_t NanosecondsPerTick(int64_t nanoseconds, uint64_t ticks) {
+  return static_cast<uint64_t>(
+      (static_cast<unsigned __int128>(nanoseconds) << 32) / ticks);
+}
+
+// Publishes a calibration to |calibration|. Must not be called concurrently
+// with itself on the same calibration.
+inline void PublishTscClockCalibration(TscClockCalibration *calibration,
+                                       uint64_t tsc_base,
+                                       int64_t monotonic_base,
+                                       int64_t realtime_base,
+                                       uint64_t nanoseconds_per_tick) {
+  uint64_t sequence = calibration->sequence.load(std::memory_order_relaxed);
+  calibration->sequence.store(sequence + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  calibration->tsc_base.store(tsc_base, std::memory_order_relaxed);
+  calibration->monotonic_base.store(monotonic_base, std::memory_order_relaxed);
+  calibration->realtime_base.store(realtime_base, std::memory_order_relaxed);
+  calibration->nanoseconds_per_tick.store(nanoseconds_per_tick,
+                                          std::memory_order_relaxed);
+  calibration->sequence.store(sequence + 2, std::memory_order_release);
+}
+
+// Converts |tsc| to the host's monotonic and realtime clocks in nanoseconds
+// using |calibration|. Returns false if no calibration has been published.
+inline bool TscToClocks(const TscClockCalibration &calibration, uint64_t tsc,
+                        int64_t *monotonic, int64_t *realtime) {
+  uint64_t tsc_base, nanoseconds_per_tick;
+  int64_t monotonic_base, realtime_base;
+  uint64_t sequence;
+  do {
+    sequence = calibration.sequence.load(std::memory_order_acquire);
+    tsc_base = calibration.tsc_base.load(std::memory_order_relaxed);
+    monotonic_base = calibration.monotonic_base.load(std::memory_order_relaxed);
+    realtime_base = calibration.realtime_base.load(std::memory_order_relaxed);
+    nanoseconds_per_tick =
+        calibration.nanoseconds_per_tick.load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_acquire);
+  } while ((sequence & 1) ||
+           sequence != calibration.sequence.load(std::memory_order_relaxed));
+
+  if (nanoseconds_per_tick == 0) {
+    return false;
+  }
+
+  // |tsc| may predate |tsc_base| if the host recalibrated after it was read.
+  int64_t ticks = static_cast<int64_t>(tsc - tsc_base);
+  int64_t offset = static_cast<int64_t>(
+      (static_cast<__int128>(ticks) * nanoseconds_per_tick) >> 32);
+  *monotonic = monotonic_base + offset;
+  *realtime = realtime_base + offset;
+  return true;
+}
+
+}  // namespace asylo
+
+#endif  // ASYLO_PLATFORM_COMMON_TSC_CLOCK_H_
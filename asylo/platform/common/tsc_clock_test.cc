@@ -0,0 +1,55 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/common/tsc_clock.h"
+
+#include <gtest/gtest.h>
+
+namespace asylo {
+namespace {
+
+TEST(TscClockTest, UncalibratedClockFails) {
+  TscClockCalibration calibration = {};
+  int64_t monotonic, realtime;
+  EXPECT_FALSE(TscToClocks(calibration, ReadTsc(), &monotonic, &realtime));
+}
+
+// Checks conversion with a counter running at 2.5 GHz.
+TEST(TscClockTest, ConvertsTicksToNanoseconds) {
+  TscClockCalibration calibration = {};
+  uint64_t nanoseconds_per_tick = NanosecondsPerTick(
+      /*nanoseconds=*/1000000000, /*ticks=*/UINT64_C(2500000000));
+  PublishTscClockCalibration(&calibration, /*tsc_base=*/UINT64_C(10000000000),
+                             /*monotonic_base=*/1000, /*realtime_base=*/5000,
+                             nanoseconds_per_tick);
+  EXPECT_EQ(calibration.sequence.load() % 2, 0);
+
+  int64_t monotonic, realtime;
+  ASSERT_TRUE(TscToClocks(calibration, UINT64_C(12500000000), &monotonic,
+                          &realtime));
+  EXPECT_NEAR(monotonic, 1000 + 1000000000, 1);
+  EXPECT_NEAR(realtime, 5000 + 1000000000, 1);
+
+  // A counter value read before the base converts to an earlier time.
+  ASSERT_TRUE(TscToClocks(calibration, UINT64_C(9999997500), &monotonic,
+                          &realtime));
+  EXPECT_NEAR(monotonic, 0, 1);
+}
+
+}  // namespace
+}  // namespace asylo
@@ -19,12 +19,19 @@
 #ifndef ASYLO_PLATFORM_CORE_ENCLAVE_CLIENT_H_
 #define ASYLO_PLATFORM_CORE_ENCLAVE_CLIENT_H_
 
+#include <functional>
+#include <future>
+#include <memory>
+#include <string>
 #include <unordered_map>
+#include <vector>
 
 #include "absl/memory/memory.h"
+#include "asylo/crypto/util/byte_container_view.h"
 #include "asylo/enclave.pb.h"  // IWYU pragma: export
 #include "asylo/platform/core/shared_name.h"
 #include "asylo/util/status.h"  // IWYU pragma: export
+#include "asylo/util/statusor.h"
 
 namespace asylo {
 
@@ -50,12 +57,160 @@ class EnclaveClient {
   virtual Status EnterAndRun(const EnclaveInput &input,
                              EnclaveOutput *output) = 0;
 
+  /// Enters the enclave once and invokes its execution entry point on each of
+  /// |inputs| in order, through TrustedApplication::RunBatch.
+  ///
+  /// Amortizes the cost of the enclave transition, and of copying messages
+  /// across the enclave boundary, over request loops which issue many small
+  /// calls. The default implementation calls \ref enter-and-run "EnterAndRun"
+  /// on each input, for clients which have no batched entry point.
+  ///
+  /// \param inputs Protobuf messages passed to the enclave.
+  /// \param[out] outputs Set to one message for each input, in order, holding
+  ///                     the response to that input and the status of running
+  ///                     it in its status field.
+  /// \return OK status if the batch ran, even if some of its inputs failed,
+  ///         or the error which prevented the batch from running, in which
+  ///         case the contents of |outputs| are unspecified.
+  /// \anchor enter-and-run-batch
+  virtual Status EnterAndRunBatch(const std::vector<EnclaveInput> &inputs,
+                                  std::vector<EnclaveOutput> *outputs) {
+    outputs->clear();
+    outputs->resize(inputs.size());
+    for (size_t i = 0; i < inputs.size(); ++i) {
+      EnterAndRun(inputs[i], &(*outputs)[i])
+          .SaveTo((*outputs)[i].mutable_status());
+    }
+    return Status::OkStatus();
+  }
+
+  /// Enters the enclave and invokes its raw execution entry point.
+  ///
+  /// Passes opaque bytes to TrustedApplication::RunRaw without any protobuf
+  /// serialization, for request loops where serializing EnclaveInput and
+  /// EnclaveOutput would dominate the cost of a call. Errors returned by the
+  /// enclave are converted to the canonical error space.
+  ///
+  /// \param input The bytes passed to the enclave.
+  /// \param[out] output The bytes returned by the enclave. Its capacity is
+  ///                    reused to receive the output, so callers which reuse
+  ///                    the same string across calls avoid allocations. Its
+  ///                    contents are unspecified if the call fails.
+  /// \anchor enter-and-run-raw
+  virtual Status EnterAndRunRaw(ByteContainerView input, std::string *output) {
+    return Status(error::GoogleError::UNIMPLEMENTED,
+                  "EnterAndRunRaw is not supported by this enclave client");
+  }
+
+  /// Callback receiving the result of EnterAndRunAsync. |output| is only
+  /// meaningful if |status| is OK, and is only valid during the call.
+  using RunCallback =
+      std::function<void(const Status &status, const EnclaveOutput &output)>;
+
+  /// Enters the enclave and invokes its execution entry point on a host worker
+  /// thread, without blocking the caller.
+  ///
+  /// The workers are started when the enclave is initialized with a positive
+  /// EnclaveConfig.async_run_queue_capacity, one per run slot, so that
+  /// asynchronous calls never need more TCS than the enclave has.
+  ///
+  /// \param input A protobuf message passed to the enclave. It is copied, so
+  ///              the caller need not keep it alive.
+  /// \param callback Invoked on a worker thread when the call returns, with
+  ///                 the status of the call and the output of the enclave.
+  /// \return OK if the call was queued. RESOURCE_EXHAUSTED if the queue of
+  ///         calls waiting for a worker is full, in which case the caller
+  ///         should retry once some of its calls have completed.
+  ///         FAILED_PRECONDITION if the enclave was not initialized with
+  ///         asynchronous calls enabled, and UNIMPLEMENTED if the enclave
+  ///         client does not support them. The callback is not invoked unless
+  ///         OK is returned.
+  /// \anchor enter-and-run-async
+  virtual Status EnterAndRunAsync(const EnclaveInput &input,
+                                  RunCallback callback) {
+    return Status(error::GoogleError::UNIMPLEMENTED,
+                  "EnterAndRunAsync is not supported by this enclave client");
+  }
+
+  /// Enters the enclave and invokes its execution entry point on a host worker
+  /// thread, as \ref enter-and-run-async "EnterAndRunAsync", and returns the
+  /// result through a future.
+  ///
+  /// \param input A protobuf message passed to the enclave.
+  /// \param[out] result Set to a future holding the output of the enclave or
+  ///                    the status of the failed call, if the call was queued.
+  /// \return The status of queuing the call.
+  Status EnterAndRunAsync(const EnclaveInput &input,
+                          std::future<StatusOr<EnclaveOutput>> *result) {
+    auto promise = std::make_shared<std::promise<StatusOr<EnclaveOutput>>>();
+    std::future<StatusOr<EnclaveOutput>> future = promise->get_future();
+    Status status = EnterAndRunAsync(
+        input, [promise](const Status &status, const EnclaveOutput &output) {
+          if (status.ok()) {
+            promise->set_value(output);
+          } else {
+            promise->set_value(status);
+          }
+        });
+    if (status.ok()) {
+      *result = std::move(future);
+    }
+    return status;
+  }
+
+  /// Enters the enclave and takes a snapshot of the counters of the host calls
+  /// it has made, aggregated over all enclave threads.
+  ///
+  /// The counters are only kept if the enclave was built with host call
+  /// instrumentation. Otherwise the snapshot is empty.
+  ///
+  /// \param[out] snapshot The counters of each host call made at least once.
+  /// \return UNIMPLEMENTED if the enclave client does not support host call
+  ///         instrumentation.
+  virtual Status GetHostCallStats(HostCallStatsSnapshot *snapshot) {
+    return Status(error::GoogleError::UNIMPLEMENTED,
+                  "Host call stats are not supported by this enclave client");
+  }
+
+  /// Enters the enclave and takes a snapshot of the heap, threads and file
+  /// descriptors it uses.
+  ///
+  /// \param[out] stats The resources used by the enclave.
+  /// \return UNIMPLEMENTED if the enclave client does not support resource
+  ///         stats.
+  virtual Status GetResourceStats(EnclaveResourceStats *stats) {
+    return Status(error::GoogleError::UNIMPLEMENTED,
+                  "Resource stats are not supported by this enclave client");
+  }
+
+  /// Enters the enclave and copies the stacks recorded by its sampling
+  /// profiler, which is enabled by EnclaveConfig.profiler_sample_capacity.
+  ///
+  /// \param[out] profile The stacks recorded since the enclave was initialized.
+  /// \return UNIMPLEMENTED if the enclave client does not support profiling.
+  virtual Status GetProfile(EnclaveProfile *profile) {
+    return Status(error::GoogleError::UNIMPLEMENTED,
+                  "Profiling is not supported by this enclave client");
+  }
+
+  /// Returns the time spent in each phase of starting the enclave.
+  ///
+  /// \return The phases timed while the enclave was loaded and initialized.
+  ///         Complete once the enclave has been loaded by the EnclaveManager.
+  const EnclaveStartupTiming &startup_timing() const { return startup_timing_; }
+
  protected:
   /// Returns the name of the enclave.
   ///
   /// \return The name of the enclave.
   const std::string &get_name() const { return name_; }
 
+  /// Returns the startup timing of the enclave, which clients and loaders add
+  /// the phases they time to.
+  ///
+  /// \return A mutable pointer to the startup timing of the enclave.
+  EnclaveStartupTiming *mutable_startup_timing() { return &startup_timing_; }
+
   /// Called by the EnclaveManager to create a client instance.
   ///
   /// \param name The enclave name as registered with the EnclaveManager.
@@ -72,6 +227,19 @@ class EnclaveClient {
   // Enters the enclave and invokes its finalization entry point.
   virtual Status EnterAndFinalize(const EnclaveFinal &final_input) = 0;
 
+  // Enters the enclave and invokes its reset entry point.
+  virtual Status EnterAndReset(const EnclaveFinal &final_input) {
+    return Status(error::GoogleError::UNIMPLEMENTED,
+                  "Reset is not supported by this enclave client");
+  }
+
+  // Enters the enclave and invokes its snapshot entry point, which stores the
+  // sealed state of the trusted application in |snapshot|.
+  virtual Status EnterAndSnapshot(std::string *snapshot) {
+    return Status(error::GoogleError::UNIMPLEMENTED,
+                  "Snapshot is not supported by this enclave client");
+  }
+
   // Donates the invoking thread to the enclave runtime.
   virtual Status EnterAndDonateThread() = 0;
 
@@ -84,6 +252,7 @@ class EnclaveClient {
   virtual Status DestroyEnclave() = 0;
 
   std::string name_;
+  EnclaveStartupTiming startup_timing_;
 };
 
 }  // namespace asylo
@@ -19,6 +19,8 @@
 #include "asylo/platform/core/enclave_config_util.h"
 
 #include <errno.h>
+#include <sched.h>
+#include <sys/utsname.h>
 #include <unistd.h>
 
 #include "asylo/util/logging.h"
@@ -58,6 +60,42 @@ void SetDefaultCurrentWorkingDirectory(EnclaveConfig *config) {
   config->set_current_working_directory(buf);
 }
 
+// Retrieves processor, page size and uname(2) facts from the host, and sets the
+// host_config.system_info field of |config| accordingly.
+void SetDefaultHostSystemInfo(EnclaveConfig *config) {
+  // Do nothing if |system_info| field is set already.
+  if (config->host_config().has_system_info()) return;
+
+  HostSystemInfo *info = config->mutable_host_config()->mutable_system_info();
+  long value = sysconf(_SC_NPROCESSORS_CONF);
+  if (value > 0) info->set_processors_configured(value);
+  value = sysconf(_SC_NPROCESSORS_ONLN);
+  if (value > 0) info->set_processors_online(value);
+  value = sysconf(_SC_PAGESIZE);
+  if (value > 0) info->set_page_size(value);
+
+  cpu_set_t mask;
+  if (sched_getaffinity(/*pid=*/0, sizeof(mask), &mask) == 0) {
+    for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+      if (CPU_ISSET(cpu, &mask)) info->add_cpu_affinity(cpu);
+    }
+  } else {
+    LOG(ERROR) << "sched_getaffinity on host failed:" << strerror(errno);
+  }
+
+  struct utsname name;
+  if (uname(&name) != 0) {
+    LOG(ERROR) << "uname on host failed:" << strerror(errno);
+    return;
+  }
+  info->set_sysname(name.sysname);
+  info->set_nodename(name.nodename);
+  info->set_release(name.release);
+  info->set_version(name.version);
+  info->set_machine(name.machine);
+  info->set_domainname(name.domainname);
+}
+
 // Sets uninitialized fields in the HostConfig of |config| to values from
 // |host_config|, if those are set.
 void SetHostConfig(const HostConfig &host_config, EnclaveConfig *config) {
@@ -67,6 +105,10 @@ void SetHostConfig(const HostConfig &host_config, EnclaveConfig *config) {
     mutable_host_config->set_local_attestation_domain(
         host_config.local_attestation_domain());
   }
+  if (!mutable_host_config->has_system_info() &&
+      host_config.has_system_info()) {
+    *mutable_host_config->mutable_system_info() = host_config.system_info();
+  }
 }
 
 }  // namespace
@@ -76,6 +118,7 @@ void SetEnclaveConfigDefaults(const HostConfig &host_config,
   SetDefaultHostName(config);
   SetDefaultCurrentWorkingDirectory(config);
   SetHostConfig(host_config, config);
+  SetDefaultHostSystemInfo(config);
 }
 
 EnclaveConfig CreateDefaultEnclaveConfig(const HostConfig &host_config) {
@@ -18,21 +18,42 @@
 
 #include "asylo/platform/core/enclave_manager.h"
 
+#include <cpuid.h>
+#include <fcntl.h>
 #include <signal.h>
 #include <stdint.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <sys/ucontext.h>
 #include <time.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
 #include <thread>
 
 #include "absl/strings/str_cat.h"
 #include "absl/synchronization/mutex.h"
-
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "asylo/daemon/identity/attestation_domain_client.h"
 #include "asylo/util/logging.h"
+#include "asylo/platform/common/shared_segment_mapping.h"
 #include "asylo/platform/common/time_util.h"
+#include "asylo/util/posix_error_space.h"
+#include "include/grpcpp/create_channel.h"
+#include "include/grpcpp/security/credentials.h"
 
 namespace asylo {
 namespace {
 
+// Unmaps a shared segment once the last enclave using it has released it.
+struct SharedSegmentUnmapper {
+  void operator()(SharedSegmentMapping *mapping) const {
+    munmap(reinterpret_cast<void *>(mapping->address), mapping->size);
+    delete mapping;
+  }
+};
+
 // Returns the value of a monotonic clock as a number of nanoseconds.
 int64_t MonotonicClock() {
   struct timespec ts;
@@ -55,6 +76,16 @@ void Sleep(int64_t nanoseconds) {
   nanosleep(NanosecondsToTimeSpec(&req, nanoseconds), nullptr);
 }
 
+// Returns true if the TSC runs at a constant rate in all power states, as
+// reported by bit 8 of EDX for CPUID leaf 0x80000007.
+bool HasInvariantTsc() {
+  unsigned int eax, ebx, ecx, edx;
+  if (!__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx)) {
+    return false;
+  }
+  return (edx & (1u << 8)) != 0;
+}
+
 // Sleeps until a deadline, specified a value of MonotonicClock().
 void WaitUntil(int64_t deadline) {
   int64_t delta;
@@ -138,27 +169,125 @@ HostConfig EnclaveManager::GetHostConfig() {
     return config_result.ValueOrDie();
   }
 
+  // Fetch the host-wide configuration from the Asylo daemon. This happens once
+  // per EnclaveManager instance, so loading an enclave does not cost a round
+  // trip to the daemon.
   HostConfig config;
-  LOG(ERROR) << "Not implemented";
+  StatusOr<std::string> address_result = options_->get_config_server_address();
+  StatusOr<absl::Duration> timeout_result =
+      options_->get_config_server_connection_timeout();
+  if (!address_result.ok() || !timeout_result.ok()) {
+    LOG(ERROR) << "Invalid config-server connection attributes";
+    return config;
+  }
+
+  std::shared_ptr<::grpc::Channel> channel = ::grpc::CreateChannel(
+      address_result.ValueOrDie(), ::grpc::InsecureChannelCredentials());
+  gpr_timespec absolute_deadline = gpr_time_add(
+      gpr_now(GPR_CLOCK_REALTIME),
+      gpr_time_from_micros(
+          absl::ToInt64Microseconds(timeout_result.ValueOrDie()),
+          GPR_TIMESPAN));
+  if (!channel->WaitForConnected(absolute_deadline)) {
+    LOG(ERROR) << "Failed to connect to the config server at "
+               << address_result.ValueOrDie();
+    return config;
+  }
+
+  daemon::AttestationDomainClient client(channel);
+  StatusOr<std::string> domain_result = client.GetAttestationDomain();
+  if (!domain_result.ok()) {
+    LOG(ERROR) << "Failed to get the local attestation domain: "
+               << domain_result.status();
+    return config;
+  }
+  config.set_local_attestation_domain(domain_result.ValueOrDie());
   return config;
 }
 
-EnclaveManager::EnclaveManager() : host_config_(GetHostConfig()) {
-  Status rc = shared_resource_manager_.RegisterUnmanagedResource(
+EnclaveManager::EnclaveManager()
+    : tsc_clock_supported_(HasInvariantTsc()),
+      tsc_calibration_{},
+      tick_clock_client_count_(0),
+      host_config_(GetHostConfig()) {
+  Status rc = shared_resource_manager_.RegisterPermanentResource(
       SharedName::Address("clock_monotonic"), &clock_monotonic_);
   if (!rc.ok()) {
     LOG(FATAL) << "Could not register monotonic clock resource.";
   }
 
-  rc = shared_resource_manager_.RegisterUnmanagedResource(
+  rc = shared_resource_manager_.RegisterPermanentResource(
       SharedName::Address("clock_realtime"), &clock_realtime_);
   if (!rc.ok()) {
     LOG(FATAL) << "Could not register realtime clock resource.";
   }
 
+  rc = shared_resource_manager_.RegisterPermanentResource(
+      SharedName::Address("clock_tsc_calibration"), &tsc_calibration_);
+  if (!rc.ok()) {
+    LOG(FATAL) << "Could not register TSC calibration resource.";
+  }
+
+  rc = shared_resource_manager_.RegisterPermanentResource(
+      SharedName::Address("network_change_generation"),
+      network_change_monitor_.generation());
+  if (!rc.ok()) {
+    LOG(FATAL) << "Could not register network change resource.";
+  }
+
   SpawnWorkerThread();
 }
 
+Status EnclaveManager::RegisterSharedSegment(const std::string &name,
+                                             const std::string &path) {
+  int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return Status(static_cast<error::PosixError>(errno),
+                  absl::StrCat("Failed to open shared segment ", path));
+  }
+  struct stat stat_buffer;
+  if (fstat(fd, &stat_buffer) != 0) {
+    Status status(static_cast<error::PosixError>(errno),
+                  absl::StrCat("Failed to stat shared segment ", path));
+    close(fd);
+    return status;
+  }
+  if (stat_buffer.st_size == 0) {
+    close(fd);
+    return Status(error::GoogleError::INVALID_ARGUMENT,
+                  absl::StrCat("Shared segment ", path, " is empty"));
+  }
+  void *address =
+      mmap(nullptr, stat_buffer.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  // The mapping holds its own reference to the file.
+  close(fd);
+  if (address == MAP_FAILED) {
+    return Status(static_cast<error::PosixError>(errno),
+                  absl::StrCat("Failed to map shared segment ", path));
+  }
+
+  auto *mapping = new SharedSegmentMapping;
+  mapping->address = reinterpret_cast<uint64_t>(address);
+  mapping->size = stat_buffer.st_size;
+  Status status =
+      shared_resource_manager_
+          .RegisterManagedResource<SharedSegmentMapping, SharedSegmentUnmapper>(
+              SharedName::MemBlock(name), mapping);
+  if (!status.ok()) {
+    // The manager does not take ownership of a resource it fails to install.
+    SharedSegmentUnmapper()(mapping);
+  }
+  return status;
+}
+
+Status EnclaveManager::UnregisterSharedSegment(const std::string &name) {
+  if (!shared_resource_manager_.ReleaseResource(SharedName::MemBlock(name))) {
+    return Status(error::GoogleError::NOT_FOUND,
+                  absl::StrCat("No shared segment named ", name));
+  }
+  return Status::OkStatus();
+}
+
 Status EnclaveManager::DestroyEnclave(EnclaveClient *client,
                                       const EnclaveFinal &final_input,
                                       bool skip_finalize) {
@@ -179,15 +308,31 @@ Status EnclaveManager::DestroyEnclave(EnclaveClient *client,
     status =
         EnclaveSignalDispatcher::GetInstance()->DeregisterAllSignalsForClient(
             client);
-    const auto &name = name_by_client_[client];
-    client_by_name_.erase(name);
-    name_by_client_.erase(client);
+    absl::MutexLock lock(&clients_mu_);
+    RemoveClient(client);
   }
 
   return status;
 }
 
+Status EnclaveManager::ResetEnclave(EnclaveClient *client,
+                                    const EnclaveFinal &final_input) {
+  if (!client) {
+    return Status(error::GoogleError::INVALID_ARGUMENT, "Null enclave client");
+  }
+  return client->EnterAndReset(final_input);
+}
+
+Status EnclaveManager::SnapshotEnclave(EnclaveClient *client,
+                                       std::string *snapshot) {
+  if (!client) {
+    return Status(error::GoogleError::INVALID_ARGUMENT, "Null enclave client");
+  }
+  return client->EnterAndSnapshot(snapshot);
+}
+
 EnclaveClient *EnclaveManager::GetClient(const std::string &name) const {
+  absl::MutexLock lock(&clients_mu_);
   auto it = client_by_name_.find(name);
   if (it == client_by_name_.end()) {
     return nullptr;
@@ -197,6 +342,7 @@ EnclaveClient *EnclaveManager::GetClient(const std::string &name) const {
 }
 
 const std::string EnclaveManager::GetName(const EnclaveClient *client) const {
+  absl::MutexLock lock(&clients_mu_);
   auto it = name_by_client_.find(client);
   if (it == name_by_client_.end()) {
     return "";
@@ -256,30 +402,93 @@ Status EnclaveManager::LoadEnclave(const std::string &name,
   return LoadEnclaveInternal(name, loader, sanitized_config);
 }
 
+std::vector<EnclaveLoadResult> EnclaveManager::LoadEnclaves(
+    const std::vector<EnclaveLoadRequest> &requests, int num_threads) {
+  std::vector<EnclaveLoadResult> results(requests.size());
+  std::atomic<size_t> next_request(0);
+  auto load_requests = [this, &requests, &results, &next_request] {
+    for (size_t i = next_request++; i < requests.size(); i = next_request++) {
+      const EnclaveLoadRequest &request = requests[i];
+      EnclaveLoadResult *result = &results[i];
+      result->name = request.name;
+      if (!request.loader) {
+        result->status = Status(error::GoogleError::INVALID_ARGUMENT,
+                                "No loader for enclave: " + request.name);
+        continue;
+      }
+      EnclaveConfig sanitized_config = request.config;
+      SetEnclaveConfigDefaults(host_config_, &sanitized_config);
+      result->status = LoadEnclaveInternal(request.name, *request.loader,
+                                           sanitized_config, result);
+    }
+  };
+
+  size_t thread_count = num_threads > 0 ? num_threads : requests.size();
+  thread_count = std::min(thread_count, requests.size());
+  std::vector<std::thread> threads;
+  for (size_t i = 1; i < thread_count; ++i) {
+    threads.emplace_back(load_requests);
+  }
+  load_requests();
+  for (std::thread &thread : threads) {
+    thread.join();
+  }
+  return results;
+}
+
 Status EnclaveManager::LoadEnclaveInternal(const std::string &name,
                                            const EnclaveLoader &loader,
-                                           const EnclaveConfig &config) {
-  // Check whether a client with this name already exists.
-  if (client_by_name_.find(name) != client_by_name_.end()) {
-    Status status(error::GoogleError::ALREADY_EXISTS,
-                  "Name already exists: " + name);
-    LOG(ERROR) << "LoadEnclave failed: " << status;
-    return status;
+                                           const EnclaveConfig &config,
+                                           EnclaveLoadResult *timings) {
+  // Check whether a client with this name already exists or is being loaded,
+  // and reserve the name otherwise.
+  {
+    absl::MutexLock lock(&clients_mu_);
+    if (client_by_name_.find(name) != client_by_name_.end() ||
+        !loading_names_.insert(name).second) {
+      Status status(error::GoogleError::ALREADY_EXISTS,
+                    "Name already exists: " + name);
+      LOG(ERROR) << "LoadEnclave failed: " << status;
+      return status;
+    }
   }
 
   // Attempt to load the enclave.
+  absl::Time start = absl::Now();
   StatusOr<std::unique_ptr<EnclaveClient>> result = loader.LoadEnclave(name);
+  if (timings) {
+    timings->load_duration = absl::Now() - start;
+  }
   if (!result.ok()) {
+    absl::MutexLock lock(&clients_mu_);
+    loading_names_.erase(name);
     LOG(ERROR) << "LoadEnclave failed: " << result.status();
     return result.status();
   }
 
-  // Add the client to the lookup tables.
+  // Add the client to the lookup tables, where host calls made while it
+  // initializes can find it.
   EnclaveClient *client = result.ValueOrDie().get();
-  client_by_name_.emplace(name, std::move(result).ValueOrDie());
-  name_by_client_.emplace(client, name);
+  {
+    absl::MutexLock lock(&clients_mu_);
+    loading_names_.erase(name);
+    client_by_name_.emplace(name, std::move(result).ValueOrDie());
+    name_by_client_.emplace(client, name);
+
+    if (!config.use_tsc_clock() || !tsc_clock_supported_) {
+      tick_clock_clients_.insert(client);
+      ++tick_clock_client_count_;
+    }
+  }
 
+  start = absl::Now();
   Status status = client->EnterAndInitialize(config);
+  if (timings) {
+    timings->initialize_duration = absl::Now() - start;
+    timings->startup_timing = client->startup_timing();
+  }
+  VLOG(1) << "Startup timing of enclave " << name << ": "
+          << client->startup_timing().ShortDebugString();
   // If initialization fails, don't keep the enclave registered. GetClient will
   // return a nullptr rather than an enclave in a bad state.
   if (!status.ok()) {
@@ -288,8 +497,8 @@ Status EnclaveManager::LoadEnclaveInternal(const std::string &name,
       LOG(ERROR) << "DestroyEnclave failed after EnterAndInitialize failure: "
                  << destroy_status;
     }
-    client_by_name_.erase(name);
-    name_by_client_.erase(client);
+    absl::MutexLock lock(&clients_mu_);
+    RemoveClient(client);
   }
   return status;
 }
@@ -306,21 +515,74 @@ void EnclaveManager::SpawnWorkerThread() {
 }
 
 void EnclaveManager::Tick() {
-  clock_monotonic_ = MonotonicClock();
-  clock_realtime_ = RealTimeClock();
+  if (!tsc_clock_supported_) {
+    clock_monotonic_ = MonotonicClock();
+    clock_realtime_ = RealTimeClock();
+    return;
+  }
+
+  // Take the TSC sample halfway through reading the host clocks.
+  uint64_t tsc_before = ReadTsc();
+  int64_t monotonic = MonotonicClock();
+  int64_t realtime = RealTimeClock();
+  uint64_t tsc = tsc_before + (ReadTsc() - tsc_before) / 2;
+  clock_monotonic_ = monotonic;
+  clock_realtime_ = realtime;
+  CalibrateTsc(tsc, monotonic, realtime);
+}
+
+void EnclaveManager::CalibrateTsc(uint64_t tsc, int64_t monotonic,
+                                  int64_t realtime) {
+  if (tsc_reference_ == 0) {
+    tsc_reference_ = tsc;
+    monotonic_reference_ = monotonic;
+    return;
+  }
+  if (tsc <= tsc_reference_ || monotonic <= monotonic_reference_) {
+    return;
+  }
+
+  // The TSC rate is measured over the whole lifetime of the worker loop, which
+  // makes it more precise with every recalibration. The base is moved to the
+  // latest sample so that the host clocks being adjusted is followed.
+  PublishTscClockCalibration(
+      &tsc_calibration_, tsc, monotonic, realtime,
+      NanosecondsPerTick(monotonic - monotonic_reference_,
+                         tsc - tsc_reference_));
+}
+
+void EnclaveManager::RemoveClient(const EnclaveClient *client) {
+  if (tick_clock_clients_.erase(client) > 0) {
+    --tick_clock_client_count_;
+  }
+  auto it = name_by_client_.find(client);
+  if (it != name_by_client_.end()) {
+    client_by_name_.erase(it->second);
+    name_by_client_.erase(it);
+  }
 }
 
 void EnclaveManager::WorkerLoop(std::mutex *unlock_when_ready) {
-  // Tick each 70us ~ 14.29kHz
+  // Tick each 70us ~ 14.29kHz while an enclave reads the ticked clocks.
   const int64_t kClockPeriod = INT64_C(70000);
+  // Otherwise only recalibrate the TSC each 10ms.
+  const int64_t kTscRecalibrationPeriod = INT64_C(10000000);
+  // Interval over which the TSC rate is first measured.
+  const int64_t kInitialCalibrationPeriod = INT64_C(1000000);
   Tick();
+  if (tsc_clock_supported_) {
+    Sleep(kInitialCalibrationPeriod);
+    Tick();
+  }
   unlock_when_ready->unlock();
   unlock_when_ready = nullptr;
   int64_t next_tick = MonotonicClock();
   while (true) {
     WaitUntil(next_tick);
     Tick();
-    next_tick += kClockPeriod;
+    next_tick += (!tsc_clock_supported_ || tick_clock_client_count_ > 0)
+                     ? kClockPeriod
+                     : kTscRecalibrationPeriod;
   }
 }
 
@@ -329,15 +591,23 @@ EnclaveSignalDispatcher *EnclaveSignalDispatcher::GetInstance() {
   return instance;
 }
 
+EnclaveSignalDispatcher::EnclaveSignalDispatcher() {
+  for (std::atomic<EnclaveClient *> &client : signal_to_client_) {
+    client.store(nullptr, std::memory_order_relaxed);
+  }
+}
+
 StatusOr<EnclaveClient *> EnclaveSignalDispatcher::GetClientForSignal(
     int signum) const {
-  absl::MutexLock lock(&signal_enclave_map_lock_);
-  auto it = signal_to_client_map_.find(signum);
-  if (it == signal_to_client_map_.end()) {
+  EnclaveClient *client = nullptr;
+  if (signum > 0 && signum < NSIG) {
+    client = signal_to_client_[signum].load(std::memory_order_acquire);
+  }
+  if (!client) {
     return Status(error::GoogleError::INVALID_ARGUMENT,
                   absl::StrCat("No enclave has registered signal: ", signum));
   }
-  return it->second;
+  return client;
 }
 
 const EnclaveClient *EnclaveSignalDispatcher::RegisterSignal(
@@ -347,14 +617,11 @@ const EnclaveClient *EnclaveSignalDispatcher::RegisterSignal(
   sigfillset(&mask);
   sigprocmask(SIG_SETMASK, &mask, &oldmask);
   EnclaveClient *old_client = nullptr;
-  {
+  if (signum > 0 && signum < NSIG) {
     absl::MutexLock lock(&signal_enclave_map_lock_);
-    // If this signal is registered by another enclave, deregister it first.
-    auto client_iterator = signal_to_client_map_.find(signum);
-    if (client_iterator != signal_to_client_map_.end()) {
-      old_client = client_iterator->second;
-    }
-    signal_to_client_map_[signum] = client;
+    // If this signal is registered by another enclave, it is overwritten.
+    old_client =
+        signal_to_client_[signum].exchange(client, std::memory_order_acq_rel);
   }
   // Set the signal mask back to the original one to unblock the signals.
   sigprocmask(SIG_SETMASK, &oldmask, nullptr);
@@ -371,20 +638,19 @@ Status EnclaveSignalDispatcher::DeregisterAllSignalsForClient(
     absl::MutexLock lock(&signal_enclave_map_lock_);
     // If this enclave has registered any signals, deregister them and set the
     // signal handler to the default one.
-    for (auto iterator = signal_to_client_map_.begin();
-         iterator != signal_to_client_map_.end();) {
-      if (iterator->second == client) {
-        if (signal(iterator->first, SIG_DFL) == SIG_ERR) {
-          status = Status(
-              error::GoogleError::INVALID_ARGUMENT,
-              absl::StrCat(
-                  "Failed to deregister one or more handlers for signal: ",
-                  iterator->first));
-        }
-        iterator = signal_to_client_map_.erase(iterator);
-      } else {
-        ++iterator;
+    for (int signum = 1; signum < NSIG; ++signum) {
+      if (signal_to_client_[signum].load(std::memory_order_relaxed) !=
+          client) {
+        continue;
+      }
+      if (signal(signum, SIG_DFL) == SIG_ERR) {
+        status = Status(
+            error::GoogleError::INVALID_ARGUMENT,
+            absl::StrCat(
+                "Failed to deregister one or more handlers for signal: ",
+                signum));
       }
+      signal_to_client_[signum].store(nullptr, std::memory_order_release);
     }
   }
   sigprocmask(SIG_SETMASK, &oldmask, nullptr);
@@ -22,11 +22,15 @@
 // Declares the enclave client API, providing types and methods for loading,
 // accessing, and finalizing enclaves.
 
+#include <signal.h>
+#include <array>
+#include <atomic>
 #include <mutex>
 #include <string>
 #include <unordered_map>
 #include <unordered_set>
 #include <utility>
+#include <vector>
 
 #include "absl/memory/memory.h"
 #include "absl/strings/string_view.h"
@@ -34,8 +38,10 @@
 #include "absl/time/time.h"
 #include "absl/types/variant.h"
 #include "asylo/enclave.pb.h"  // IWYU pragma: export
+#include "asylo/platform/common/tsc_clock.h"
 #include "asylo/platform/core/enclave_client.h"
 #include "asylo/platform/core/enclave_config_util.h"
+#include "asylo/platform/core/network_change_monitor.h"
 #include "asylo/platform/core/shared_resource_manager.h"
 #include "asylo/util/status.h"  // IWYU pragma: export
 #include "asylo/util/statusor.h"
@@ -117,6 +123,38 @@ class EnclaveManagerOptions {
   absl::variant<ConfigServerConnectionAttributes, HostConfig> host_config_info_;
 };
 
+/// A request to load one enclave of a batch passed to
+/// EnclaveManager::LoadEnclaves.
+struct EnclaveLoadRequest {
+  /// Name to bind the loaded enclave under.
+  std::string name;
+
+  /// Configured enclave loader to load from. Must outlive the LoadEnclaves
+  /// call.
+  const EnclaveLoader *loader = nullptr;
+
+  /// Enclave configuration to launch the enclave with. Unset fields are
+  /// defaulted as by LoadEnclave.
+  EnclaveConfig config;
+};
+
+/// The outcome of loading one enclave of a batch.
+struct EnclaveLoadResult {
+  /// Name the enclave was to be bound under.
+  std::string name;
+
+  /// The status LoadEnclave would have returned for the enclave.
+  Status status;
+
+  /// Time spent creating the enclave with its loader, and running its
+  /// initialization entry point.
+  absl::Duration load_duration = absl::ZeroDuration();
+  absl::Duration initialize_duration = absl::ZeroDuration();
+
+  /// The phases of startup timed by the enclave client and inside the enclave.
+  EnclaveStartupTiming startup_timing;
+};
+
 /// A manager object responsible for creating and managing enclave instances.
 ///
 /// EnclaveManager is a singleton class that tracks the status of enclaves
@@ -203,13 +241,26 @@ class EnclaveManager {
   Status LoadEnclave(const std::string &name, const EnclaveLoader &loader,
                      EnclaveConfig config);
 
+  /// Loads a batch of enclaves in parallel.
+  ///
+  /// Each enclave is loaded as by LoadEnclave. The enclaves are loaded on
+  /// `num_threads` threads, or on one thread per request if `num_threads` is
+  /// not positive. A failure to load one enclave does not affect the others.
+  ///
+  /// \param requests The enclaves to load.
+  /// \param num_threads The number of enclaves to load at once.
+  /// \return The outcome of each request, in the order of `requests`.
+  std::vector<EnclaveLoadResult> LoadEnclaves(
+      const std::vector<EnclaveLoadRequest> &requests, int num_threads = 0);
+
   /// Fetches a client to a loaded enclave.
   ///
   /// \param name The name of an EnclaveClient that may be registered in the
   ///             EnclaveManager.
   /// \return A mutable pointer to the EnclaveClient if the name is
   ///         registered. Otherwise returns nullptr.
-  EnclaveClient *GetClient(const std::string &name) const;
+  EnclaveClient *GetClient(const std::string &name) const
+      LOCKS_EXCLUDED(clients_mu_);
 
   /// Returns the name of an enclave client.
   ///
@@ -217,7 +268,8 @@ class EnclaveManager {
   ///               EnclaveManager.
   /// \return The name of an enclave client. If no enclave matches `client` the
   ///         empty string will be returned.
-  const std::string GetName(const EnclaveClient *client) const;
+  const std::string GetName(const EnclaveClient *client) const
+      LOCKS_EXCLUDED(clients_mu_);
 
   /// Destroys an enclave.
   ///
@@ -234,6 +286,51 @@ class EnclaveManager {
   Status DestroyEnclave(EnclaveClient *client, const EnclaveFinal &final_input,
                         bool skip_finalize = false);
 
+  /// Resets an enclave for reuse.
+  ///
+  /// Calls `client's` reset entry point with final_input, which clears the
+  /// enclave application state without reloading the enclave. The client stays
+  /// registered under its name. If reset fails, the enclave must be destroyed
+  /// with `skip_finalize` set.
+  ///
+  /// \param client A client attached to the enclave to reset.
+  /// \param final_input Input to pass the enclave's reset entry point.
+  Status ResetEnclave(EnclaveClient *client, const EnclaveFinal &final_input);
+
+  /// Takes a snapshot of an initialized enclave.
+  ///
+  /// Calls `client's` snapshot entry point, which serializes the state of the
+  /// trusted application with TrustedApplication::Snapshot() and seals it to
+  /// the enclave's MRENCLAVE. An enclave loaded from the same enclave binary on
+  /// the same platform with the snapshot set in EnclaveConfig.snapshot is
+  /// restored from that state instead of running its Initialize method.
+  ///
+  /// \param client A client attached to the enclave to snapshot.
+  /// \param[out] snapshot The sealed snapshot of the enclave.
+  Status SnapshotEnclave(EnclaveClient *client, std::string *snapshot);
+
+  /// Maps a read-only segment file and shares it with enclaves.
+  ///
+  /// Maps the file at `path`, as written by
+  /// platform::storage::BuildSharedSegment(), read-only into untrusted memory
+  /// and registers it as a kMemBlockName shared resource named `name`. Every
+  /// enclave which opens the segment with platform::storage::SharedSegment
+  /// reads the same host pages, decrypting and authenticating them inside the
+  /// enclave, so N enclaves with the same read-only data map it once rather
+  /// than each loading its own copy.
+  ///
+  /// \param name The name enclaves open the segment by.
+  /// \param path The path of the segment file on the host.
+  Status RegisterSharedSegment(const std::string &name,
+                               const std::string &path);
+
+  /// Releases the reference to a shared segment taken by
+  /// RegisterSharedSegment(). The segment is unmapped once the enclaves which
+  /// opened it have closed it.
+  ///
+  /// \param name The name the segment was registered under.
+  Status UnregisterSharedSegment(const std::string &name);
+
   /// Fetches the shared resource manager object.
   ///
   /// \return The SharedResourceManager instance.
@@ -260,9 +357,12 @@ class EnclaveManager {
 
   // Loads a new enclave with custom enclave config settings and binds it to a
   // name. The actual work of opening the enclave is delegated to the passed
-  // loader object.
+  // loader object. If |timings| is not null, records in it how long loading
+  // and initializing the enclave took.
   Status LoadEnclaveInternal(const std::string &name, const EnclaveLoader &loader,
-                             const EnclaveConfig &config);
+                             const EnclaveConfig &config,
+                             EnclaveLoadResult *timings = nullptr)
+      LOCKS_EXCLUDED(clients_mu_);
 
   // Create a thread to periodically update logic.
   void SpawnWorkerThread();
@@ -273,6 +373,15 @@ class EnclaveManager {
   // Execute a single iteration of the work loop.
   void Tick();
 
+  // Publishes a calibration of the TSC from a sample of the TSC and the host
+  // clocks taken at the same time.
+  void CalibrateTsc(uint64_t tsc, int64_t monotonic, int64_t realtime);
+
+  // Removes |client| from the lookup tables and stops counting it among the
+  // enclaves reading the ticked clocks.
+  void RemoveClient(const EnclaveClient *client)
+      EXCLUSIVE_LOCKS_REQUIRED(clients_mu_);
+
   // Manager object for untrusted resources shared with enclaves.
   SharedResourceManager shared_resource_manager_;
 
@@ -282,8 +391,41 @@ class EnclaveManager {
   // Value synchronized to CLOCK_REALTIME by the worker loop.
   std::atomic<int64_t> clock_realtime_;
 
-  std::unordered_map<std::string, std::unique_ptr<EnclaveClient>> client_by_name_;
-  std::unordered_map<const EnclaveClient *, std::string> name_by_client_;
+  // Whether the host TSC is invariant, so that enclaves may tell time from it.
+  const bool tsc_clock_supported_;
+
+  // Calibration of the TSC against the host clocks, published by the worker
+  // loop if the TSC is supported.
+  TscClockCalibration tsc_calibration_;
+
+  // Counts changes to the host's network interfaces, published to enclaves so
+  // that they may cache getifaddrs.
+  NetworkChangeMonitor network_change_monitor_;
+
+  // The first sample fed to CalibrateTsc(), from which the TSC rate is
+  // measured.
+  uint64_t tsc_reference_ = 0;
+  int64_t monotonic_reference_ = 0;
+
+  // Enclaves reading clock_monotonic_ and clock_realtime_ rather than the TSC.
+  // The worker loop updates those clocks every 70 microseconds while there is
+  // any, and only recalibrates the TSC every 10 milliseconds otherwise.
+  std::unordered_set<const EnclaveClient *> tick_clock_clients_
+      GUARDED_BY(clients_mu_);
+  std::atomic<int> tick_clock_client_count_;
+
+  // Guards the lookup tables of loaded enclaves. It is not held while an
+  // enclave is created or initialized, so that enclaves load in parallel.
+  mutable absl::Mutex clients_mu_;
+
+  std::unordered_map<std::string, std::unique_ptr<EnclaveClient>> client_by_name_
+      GUARDED_BY(clients_mu_);
+  std::unordered_map<const EnclaveClient *, std::string> name_by_client_
+      GUARDED_BY(clients_mu_);
+
+  // Names of enclaves being created, which are reserved until their clients
+  // are added to the lookup tables.
+  std::unordered_set<std::string> loading_names_ GUARDED_BY(clients_mu_);
 
   // A part of the configuration for enclaves launched by the enclave manager
   // comes from the Asylo daemon. This member caches such configuration.
@@ -336,9 +478,10 @@ class EnclaveSignalDispatcher {
   const EnclaveClient *RegisterSignal(int signum, EnclaveClient *client)
       LOCKS_EXCLUDED(signal_enclave_map_lock_);
 
-  // Gets the enclave that registered a handler for |signum|.
-  StatusOr<EnclaveClient *> GetClientForSignal(int signum) const
-      LOCKS_EXCLUDED(signal_enclave_map_lock_);
+  // Gets the enclave that registered a handler for |signum|. Takes no lock and
+  // does not allocate unless |signum| is not registered, so it is safe to call
+  // from a signal handler.
+  StatusOr<EnclaveClient *> GetClientForSignal(int signum) const;
 
   // Deregisters all the signals registered by |client|.
   Status DeregisterAllSignalsForClient(EnclaveClient *client)
@@ -351,16 +494,16 @@ class EnclaveSignalDispatcher {
                                      void *ucontext);
 
  private:
-  EnclaveSignalDispatcher() = default;  // Private to enforce singleton.
+  EnclaveSignalDispatcher();  // Private to enforce singleton.
   EnclaveSignalDispatcher(EnclaveSignalDispatcher const &) = delete;
   void operator=(EnclaveSignalDispatcher const &) = delete;
 
-  // Mapping of signal number to the enclave client that registered it.
-  std::unordered_map<int, EnclaveClient *> signal_to_client_map_
-      GUARDED_BY(signal_enclave_map_lock_);
+  // The enclave client that registered each signal number, or nullptr. Read
+  // without a lock by signal handlers.
+  std::array<std::atomic<EnclaveClient *>, NSIG> signal_to_client_;
 
-  // A mutex that guards signal_to_client_map_ and client_to_signal_map_.
-  mutable absl::Mutex signal_enclave_map_lock_;
+  // A mutex that serializes updates to signal_to_client_.
+  absl::Mutex signal_enclave_map_lock_;
 };
 
 }  // namespace asylo
@@ -0,0 +1,154 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/core/enclave_pool.h"
+
+#include <utility>
+
+#include "absl/memory/memory.h"
+#include "absl/strings/str_cat.h"
+#include "asylo/util/logging.h"
+
+namespace asylo {
+
+StatusOr<std::unique_ptr<EnclavePool>> EnclavePool::Create(
+    EnclaveManager *manager, const std::string &name_prefix,
+    const EnclaveLoader &loader, EnclaveConfig config, size_t size) {
+  if (!manager) {
+    return Status(error::GoogleError::INVALID_ARGUMENT,
+                  "EnclavePool requires an EnclaveManager");
+  }
+  auto pool = absl::WrapUnique(
+      new EnclavePool(manager, name_prefix, loader, std::move(config), size));
+
+  std::vector<EnclaveLoadRequest> requests(size);
+  for (EnclaveLoadRequest &request : requests) {
+    request.name = pool->NextName();
+    request.loader = &loader;
+    request.config = pool->config_;
+  }
+  std::vector<EnclaveLoadResult> results = manager->LoadEnclaves(requests);
+
+  // Keep the enclaves that loaded so that the pool destroys them on failure.
+  Status status;
+  absl::MutexLock lock(&pool->mu_);
+  for (const EnclaveLoadResult &result : results) {
+    if (result.status.ok()) {
+      pool->idle_.push_back(manager->GetClient(result.name));
+    } else if (status.ok()) {
+      status = result.status;
+    }
+  }
+  if (!status.ok()) {
+    return status;
+  }
+  return std::move(pool);
+}
+
+EnclavePool::EnclavePool(EnclaveManager *manager,
+                         const std::string &name_prefix,
+                         const EnclaveLoader &loader, EnclaveConfig config,
+                         size_t size)
+    : manager_(manager),
+      name_prefix_(name_prefix),
+      loader_(loader),
+      config_(std::move(config)),
+      size_(size) {}
+
+EnclavePool::~EnclavePool() {
+  absl::MutexLock lock(&mu_);
+  for (EnclaveClient *client : leased_) {
+    idle_.push_back(client);
+  }
+  leased_.clear();
+  for (EnclaveClient *client : idle_) {
+    Status status = manager_->DestroyEnclave(client, EnclaveFinal());
+    if (!status.ok()) {
+      LOG(ERROR) << "Failed to destroy pooled enclave: " << status;
+    }
+  }
+}
+
+StatusOr<EnclaveClient *> EnclavePool::Acquire() {
+  {
+    absl::MutexLock lock(&mu_);
+    if (!idle_.empty()) {
+      EnclaveClient *client = idle_.back();
+      idle_.pop_back();
+      leased_.insert(client);
+      return client;
+    }
+  }
+
+  // Load outside the lock, so that other callers can lease returned enclaves
+  // in the meantime.
+  std::string name = NextName();
+  Status status = manager_->LoadEnclave(name, loader_, config_);
+  if (!status.ok()) {
+    return status;
+  }
+  EnclaveClient *client = manager_->GetClient(name);
+  absl::MutexLock lock(&mu_);
+  leased_.insert(client);
+  return client;
+}
+
+Status EnclavePool::Release(EnclaveClient *client,
+                            const EnclaveFinal &final_input) {
+  bool keep;
+  {
+    absl::MutexLock lock(&mu_);
+    if (leased_.erase(client) == 0) {
+      return Status(error::GoogleError::INVALID_ARGUMENT,
+                    "Enclave was not leased from this pool");
+    }
+    keep = idle_.size() < size_;
+  }
+
+  if (!keep) {
+    return manager_->DestroyEnclave(client, final_input);
+  }
+
+  Status status = manager_->ResetEnclave(client, final_input);
+  if (status.Is(error::GoogleError::UNIMPLEMENTED)) {
+    // The enclave cannot be reset, so is replaced on a later Acquire.
+    return manager_->DestroyEnclave(client, final_input);
+  }
+  if (!status.ok()) {
+    // A failed reset leaves the enclave unable to finalize.
+    LOG(ERROR) << "Failed to reset pooled enclave: " << status;
+    manager_->DestroyEnclave(client, final_input, /*skip_finalize=*/true);
+    return status;
+  }
+
+  absl::MutexLock lock(&mu_);
+  idle_.push_back(client);
+  return Status::OkStatus();
+}
+
+size_t EnclavePool::idle_size() const {
+  absl::MutexLock lock(&mu_);
+  return idle_.size();
+}
+
+std::string EnclavePool::NextName() {
+  absl::MutexLock lock(&mu_);
+  return absl::StrCat(name_prefix_, "/", next_index_++);
+}
+
+}  // namespace asylo
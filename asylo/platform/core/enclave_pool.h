@@ -0,0 +1,122 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_PLATFORM_CORE_ENCLAVE_POOL_H_
+#define ASYLO_PLATFORM_CORE_ENCLAVE_POOL_H_
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "absl/synchronization/mutex.h"
+#include "asylo/enclave.pb.h"
+#include "asylo/platform/core/enclave_client.h"
+#include "asylo/platform/core/enclave_manager.h"
+#include "asylo/util/status.h"
+#include "asylo/util/statusor.h"
+
+namespace asylo {
+
+/// A pool of identical, initialized enclaves that are leased out one at a time.
+///
+/// Loading an enclave takes far longer than resetting one, so an EnclavePool
+/// keeps enclaves loaded and resets them when they are returned instead of
+/// destroying them. This makes it cheap to use a fresh enclave for every
+/// session.
+///
+/// All enclaves of a pool are loaded from the same loader with the same
+/// configuration, and are registered with the EnclaveManager under the names
+/// `<name_prefix>/<n>`. EnclavePool is thread-safe.
+class EnclavePool {
+ public:
+  /// Creates a pool of `size` enclaves.
+  ///
+  /// \param manager The manager to load the enclaves with.
+  /// \param name_prefix The prefix of the names of the pooled enclaves.
+  /// \param loader The loader to load the enclaves with. Must outlive the pool.
+  /// \param config The configuration to load the enclaves with.
+  /// \param size The number of idle enclaves the pool keeps ready.
+  /// \return The pool, or the first error encountered while loading its
+  ///         enclaves.
+  static StatusOr<std::unique_ptr<EnclavePool>> Create(
+      EnclaveManager *manager, const std::string &name_prefix,
+      const EnclaveLoader &loader, EnclaveConfig config, size_t size);
+
+  EnclavePool(const EnclavePool &other) = delete;
+  EnclavePool &operator=(const EnclavePool &other) = delete;
+
+  /// Destroys all enclaves of the pool, including leased ones.
+  ~EnclavePool();
+
+  /// Leases an enclave from the pool.
+  ///
+  /// Returns an idle enclave if there is one, and otherwise loads a new one.
+  ///
+  /// \return A client to an initialized enclave, which must be returned with
+  ///         Release.
+  StatusOr<EnclaveClient *> Acquire() LOCKS_EXCLUDED(mu_);
+
+  /// Returns a leased enclave to the pool.
+  ///
+  /// The enclave is reset and kept for later leases, unless the pool already
+  /// holds `size` idle enclaves or the enclave cannot be reset, in which case
+  /// it is destroyed. `client` must not be used after this call.
+  ///
+  /// \param client A client returned by Acquire.
+  /// \param final_input Input to pass the enclave's reset or finalization
+  ///                    entry point.
+  /// \return An OK status, or an error if the enclave failed to reset. The
+  ///         enclave is destroyed in either case.
+  Status Release(EnclaveClient *client,
+                 const EnclaveFinal &final_input = EnclaveFinal())
+      LOCKS_EXCLUDED(mu_);
+
+  /// Returns the number of idle enclaves.
+  size_t idle_size() const LOCKS_EXCLUDED(mu_);
+
+ private:
+  EnclavePool(EnclaveManager *manager, const std::string &name_prefix,
+              const EnclaveLoader &loader, EnclaveConfig config, size_t size);
+
+  // Returns a name for a new enclave of the pool.
+  std::string NextName() LOCKS_EXCLUDED(mu_);
+
+  EnclaveManager *const manager_;
+  const std::string name_prefix_;
+  const EnclaveLoader &loader_;
+  const EnclaveConfig config_;
+  const size_t size_;
+
+  mutable absl::Mutex mu_;
+
+  // Number of enclaves named so far.
+  size_t next_index_ GUARDED_BY(mu_) = 0;
+
+  // Enclaves ready to be leased. The most recently returned enclave is leased
+  // first, since its pages are the most likely to be cached.
+  std::vector<EnclaveClient *> idle_ GUARDED_BY(mu_);
+
+  // Enclaves currently leased.
+  std::unordered_set<EnclaveClient *> leased_ GUARDED_BY(mu_);
+};
+
+}  // namespace asylo
+
+#endif  // ASYLO_PLATFORM_CORE_ENCLAVE_POOL_H_
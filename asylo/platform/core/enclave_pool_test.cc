@@ -0,0 +1,208 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/core/enclave_pool.h"
+
+#include <atomic>
+#include <memory>
+#include <string>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include "asylo/test/util/status_matchers.h"
+#include "asylo/util/status.h"
+#include "asylo/util/statusor.h"
+
+namespace asylo {
+namespace {
+
+using ::testing::Eq;
+using ::testing::IsEmpty;
+using ::testing::Ne;
+using ::testing::Not;
+
+// Counts of calls made to the clients of a TestLoader.
+struct CallCounts {
+  std::atomic<int> initializations{0};
+  std::atomic<int> resets{0};
+  std::atomic<int> finalizations{0};
+};
+
+// A client that counts its entries, and supports reset if |resettable|.
+class TestClient : public EnclaveClient {
+ public:
+  TestClient(const std::string &name, CallCounts *counts, bool resettable)
+      : EnclaveClient(name), counts_(counts), resettable_(resettable) {}
+
+  Status EnterAndRun(const EnclaveInput &input,
+                     EnclaveOutput *output) override {
+    return Status::OkStatus();
+  }
+
+ private:
+  Status EnterAndInitialize(const EnclaveConfig &config) override {
+    ++counts_->initializations;
+    return Status::OkStatus();
+  }
+
+  Status EnterAndFinalize(const EnclaveFinal &final_input) override {
+    ++counts_->finalizations;
+    return Status::OkStatus();
+  }
+
+  Status EnterAndReset(const EnclaveFinal &final_input) override {
+    if (!resettable_) {
+      return Status(error::GoogleError::UNIMPLEMENTED, "Reset not supported");
+    }
+    ++counts_->resets;
+    return Status::OkStatus();
+  }
+
+  Status EnterAndDonateThread() override { return Status::OkStatus(); }
+
+  Status EnterAndHandleSignal(const EnclaveSignal &signal) override {
+    return Status::OkStatus();
+  }
+
+  Status DestroyEnclave() override { return Status::OkStatus(); }
+
+  CallCounts *counts_;
+  bool resettable_;
+};
+
+class TestLoader : public EnclaveLoader {
+ public:
+  TestLoader(CallCounts *counts, bool resettable)
+      : counts_(counts), resettable_(resettable) {}
+
+ protected:
+  StatusOr<std::unique_ptr<EnclaveClient>> LoadEnclave(
+      const std::string &name) const override {
+    return std::unique_ptr<EnclaveClient>(
+        new TestClient(name, counts_, resettable_));
+  }
+
+ private:
+  CallCounts *counts_;
+  bool resettable_;
+};
+
+class EnclavePoolTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    EnclaveManager::Configure(EnclaveManagerOptions());
+    StatusOr<EnclaveManager *> manager_result = EnclaveManager::Instance();
+    ASSERT_THAT(manager_result, IsOk());
+    manager_ = manager_result.ValueOrDie();
+  }
+
+  std::unique_ptr<EnclavePool> CreatePool(const std::string &name_prefix,
+                                          const EnclaveLoader &loader,
+                                          size_t size) {
+    auto pool_result = EnclavePool::Create(manager_, name_prefix, loader,
+                                           EnclaveConfig(), size);
+    EXPECT_THAT(pool_result, IsOk());
+    return pool_result.ok() ? std::move(pool_result).ValueOrDie() : nullptr;
+  }
+
+  EnclaveManager *manager_;
+  CallCounts counts_;
+};
+
+// Verify that a released enclave is reset and leased again.
+TEST_F(EnclavePoolTest, ReleasedEnclaveIsReused) {
+  TestLoader loader(&counts_, /*resettable=*/true);
+  std::unique_ptr<EnclavePool> pool = CreatePool("/reuse", loader, 2);
+  ASSERT_THAT(pool, Ne(nullptr));
+  EXPECT_THAT(counts_.initializations, Eq(2));
+  EXPECT_THAT(pool->idle_size(), Eq(2));
+
+  auto client_result = pool->Acquire();
+  ASSERT_THAT(client_result, IsOk());
+  EnclaveClient *client = client_result.ValueOrDie();
+  EXPECT_THAT(pool->idle_size(), Eq(1));
+  ASSERT_THAT(pool->Release(client), IsOk());
+  EXPECT_THAT(counts_.resets, Eq(1));
+  EXPECT_THAT(pool->idle_size(), Eq(2));
+
+  client_result = pool->Acquire();
+  ASSERT_THAT(client_result, IsOk());
+  EXPECT_THAT(client_result.ValueOrDie(), Eq(client));
+  EXPECT_THAT(counts_.initializations, Eq(2));
+  ASSERT_THAT(pool->Release(client), IsOk());
+
+  pool.reset();
+  EXPECT_THAT(counts_.finalizations, Eq(2));
+  EXPECT_THAT(manager_->GetClient("/reuse/0"), Eq(nullptr));
+  EXPECT_THAT(manager_->GetClient("/reuse/1"), Eq(nullptr));
+}
+
+// Verify that the pool loads enclaves when it runs out, and keeps only as many
+// idle enclaves as its size.
+TEST_F(EnclavePoolTest, AcquireBeyondSizeLoadsEnclave) {
+  TestLoader loader(&counts_, /*resettable=*/true);
+  std::unique_ptr<EnclavePool> pool = CreatePool("/grow", loader, 1);
+  ASSERT_THAT(pool, Ne(nullptr));
+
+  auto first_result = pool->Acquire();
+  auto second_result = pool->Acquire();
+  ASSERT_THAT(first_result, IsOk());
+  ASSERT_THAT(second_result, IsOk());
+  EXPECT_THAT(first_result.ValueOrDie(), Ne(second_result.ValueOrDie()));
+  EXPECT_THAT(counts_.initializations, Eq(2));
+
+  ASSERT_THAT(pool->Release(first_result.ValueOrDie()), IsOk());
+  ASSERT_THAT(pool->Release(second_result.ValueOrDie()), IsOk());
+  EXPECT_THAT(counts_.resets, Eq(1));
+  EXPECT_THAT(counts_.finalizations, Eq(1));
+  EXPECT_THAT(pool->idle_size(), Eq(1));
+}
+
+// Verify that an enclave that cannot be reset is destroyed when released.
+TEST_F(EnclavePoolTest, UnresettableEnclaveIsReplaced) {
+  TestLoader loader(&counts_, /*resettable=*/false);
+  std::unique_ptr<EnclavePool> pool = CreatePool("/replace", loader, 1);
+  ASSERT_THAT(pool, Ne(nullptr));
+
+  auto client_result = pool->Acquire();
+  ASSERT_THAT(client_result, IsOk());
+  std::string name = manager_->GetName(client_result.ValueOrDie());
+  ASSERT_THAT(name, Not(IsEmpty()));
+  ASSERT_THAT(pool->Release(client_result.ValueOrDie()), IsOk());
+  EXPECT_THAT(counts_.finalizations, Eq(1));
+  EXPECT_THAT(manager_->GetClient(name), Eq(nullptr));
+  EXPECT_THAT(pool->idle_size(), Eq(0));
+
+  ASSERT_THAT(pool->Acquire(), IsOk());
+  EXPECT_THAT(counts_.initializations, Eq(2));
+}
+
+// Verify that a client not leased from the pool cannot be released to it.
+TEST_F(EnclavePoolTest, ReleaseUnleasedClientFails) {
+  TestLoader loader(&counts_, /*resettable=*/true);
+  std::unique_ptr<EnclavePool> pool = CreatePool("/unleased", loader, 1);
+  ASSERT_THAT(pool, Ne(nullptr));
+
+  EnclaveClient *client = manager_->GetClient("/unleased/0");
+  ASSERT_THAT(client, Ne(nullptr));
+  EXPECT_THAT(pool->Release(client),
+              StatusIs(error::GoogleError::INVALID_ARGUMENT));
+}
+
+}  // namespace
+}  // namespace asylo
@@ -0,0 +1,324 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/core/enclave_profiler.h"
+
+#include <cxxabi.h>
+#include <elf.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <unordered_map>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "asylo/platform/core/profile.pb.h"
+#include "asylo/util/posix_error_space.h"
+
+namespace asylo {
+namespace {
+
+using perftools::profiles::Profile;
+
+constexpr char kOutsideEnclaveFunction[] = "[outside enclave]";
+
+struct ElfFunction {
+  uint64_t address;
+  uint64_t size;
+  std::string name;
+};
+
+// Reads the function symbols of the ELF64 image at |path| into |functions|,
+// sorted by address. The static symbol table is preferred to the dynamic one.
+Status ReadElfFunctions(const std::string &path,
+                        std::vector<ElfFunction> *functions) {
+  std::ifstream file(path, std::ios::binary);
+  if (!file) {
+    return Status(error::GoogleError::NOT_FOUND,
+                  absl::StrCat("Failed to open enclave image ", path));
+  }
+  std::stringstream contents;
+  contents << file.rdbuf();
+  const std::string image = contents.str();
+
+  Elf64_Ehdr header;
+  if (image.size() < sizeof(header)) {
+    return Status(error::GoogleError::INVALID_ARGUMENT,
+                  absl::StrCat(path, " is not an ELF64 image"));
+  }
+  memcpy(&header, image.data(), sizeof(header));
+  if (memcmp(header.e_ident, ELFMAG, SELFMAG) != 0 ||
+      header.e_ident[EI_CLASS] != ELFCLASS64 ||
+      header.e_shentsize != sizeof(Elf64_Shdr) ||
+      header.e_shoff > image.size() ||
+      header.e_shnum > (image.size() - header.e_shoff) / sizeof(Elf64_Shdr)) {
+    return Status(error::GoogleError::INVALID_ARGUMENT,
+                  absl::StrCat(path, " is not an ELF64 image"));
+  }
+  std::vector<Elf64_Shdr> sections(header.e_shnum);
+  memcpy(sections.data(), image.data() + header.e_shoff,
+         sections.size() * sizeof(Elf64_Shdr));
+
+  auto find_table = [&sections](uint32_t type) -> const Elf64_Shdr * {
+    for (const Elf64_Shdr &section : sections) {
+      if (section.sh_type == type) {
+        return &section;
+      }
+    }
+    return nullptr;
+  };
+  const Elf64_Shdr *symbols = find_table(SHT_SYMTAB);
+  if (!symbols) {
+    symbols = find_table(SHT_DYNSYM);
+  }
+  functions->clear();
+  if (!symbols || symbols->sh_link >= sections.size()) {
+    return Status::OkStatus();
+  }
+  const Elf64_Shdr &names = sections[symbols->sh_link];
+  if (symbols->sh_offset > image.size() ||
+      symbols->sh_size > image.size() - symbols->sh_offset ||
+      names.sh_offset > image.size() ||
+      names.sh_size > image.size() - names.sh_offset) {
+    return Status(error::GoogleError::INVALID_ARGUMENT,
+                  absl::StrCat(path, " has a truncated symbol table"));
+  }
+
+  for (uint64_t offset = 0; offset + sizeof(Elf64_Sym) <= symbols->sh_size;
+       offset += sizeof(Elf64_Sym)) {
+    Elf64_Sym symbol;
+    memcpy(&symbol, image.data() + symbols->sh_offset + offset,
+           sizeof(symbol));
+    if (ELF64_ST_TYPE(symbol.st_info) != STT_FUNC || symbol.st_value == 0 ||
+        symbol.st_name >= names.sh_size) {
+      continue;
+    }
+    const char *name = image.data() + names.sh_offset + symbol.st_name;
+    size_t max_length = names.sh_size - symbol.st_name;
+    functions->push_back(ElfFunction{symbol.st_value, symbol.st_size,
+                                     std::string(name, strnlen(name,
+                                                               max_length))});
+  }
+  std::sort(functions->begin(), functions->end(),
+            [](const ElfFunction &a, const ElfFunction &b) {
+              return a.address < b.address;
+            });
+  return Status::OkStatus();
+}
+
+// Returns the function of |functions| containing |address|, or nullptr.
+// Functions of unknown size are taken to extend to the next function.
+const ElfFunction *FindFunction(const std::vector<ElfFunction> &functions,
+                                uint64_t address) {
+  auto next = std::upper_bound(
+      functions.begin(), functions.end(), address,
+      [](uint64_t address, const ElfFunction &function) {
+        return address < function.address;
+      });
+  if (next == functions.begin()) {
+    return nullptr;
+  }
+  const ElfFunction &function = *(next - 1);
+  if (function.size != 0 && address >= function.address + function.size) {
+    return nullptr;
+  }
+  return &function;
+}
+
+std::string Demangle(const std::string &name) {
+  int status = 0;
+  char *demangled =
+      abi::__cxa_demangle(name.c_str(), nullptr, nullptr, &status);
+  if (status != 0 || !demangled) {
+    return name;
+  }
+  std::string result(demangled);
+  free(demangled);
+  return result;
+}
+
+// Builds a perftools.profiles.Profile, interning strings, functions and
+// locations as they are added.
+class PprofBuilder {
+ public:
+  PprofBuilder() { profile_.add_string_table(""); }
+
+  Profile *profile() { return &profile_; }
+
+  int64_t String(const std::string &value) {
+    auto inserted = strings_.emplace(value, profile_.string_table_size());
+    if (inserted.second) {
+      profile_.add_string_table(value);
+    }
+    return inserted.first->second;
+  }
+
+  uint64_t Function(const std::string &system_name) {
+    auto inserted =
+        functions_.emplace(system_name, profile_.function_size() + 1);
+    if (inserted.second) {
+      perftools::profiles::Function *function = profile_.add_function();
+      function->set_id(inserted.first->second);
+      function->set_name(String(Demangle(system_name)));
+      function->set_system_name(String(system_name));
+    }
+    return inserted.first->second;
+  }
+
+  // Returns the location of |address| in the mapping |mapping_id|, which is
+  // attributed to |function|, a symbol name, unless it is null.
+  uint64_t Location(uint64_t mapping_id, uint64_t address,
+                    const std::string *function) {
+    auto inserted = locations_.emplace(std::make_pair(mapping_id, address),
+                                       profile_.location_size() + 1);
+    if (inserted.second) {
+      perftools::profiles::Location *location = profile_.add_location();
+      location->set_id(inserted.first->second);
+      location->set_mapping_id(mapping_id);
+      location->set_address(address);
+      if (function) {
+        location->add_line()->set_function_id(Function(*function));
+      }
+    }
+    return inserted.first->second;
+  }
+
+ private:
+  Profile profile_;
+  std::unordered_map<std::string, int64_t> strings_;
+  std::unordered_map<std::string, uint64_t> functions_;
+  std::map<std::pair<uint64_t, uint64_t>, uint64_t> locations_;
+};
+
+}  // namespace
+
+Status StartProfilingTimer(int frequency_hz) {
+  if (frequency_hz <= 0 || frequency_hz > 1000000) {
+    return Status(error::GoogleError::INVALID_ARGUMENT,
+                  "Profiling frequency must be between 1 and 1000000 Hz");
+  }
+  struct sigaction action;
+  if (sigaction(SIGPROF, nullptr, &action) != 0 ||
+      (!(action.sa_flags & SA_SIGINFO) && action.sa_handler == SIG_DFL)) {
+    return Status(error::GoogleError::FAILED_PRECONDITION,
+                  "No SIGPROF handler is installed");
+  }
+  struct itimerval timer;
+  timer.it_interval.tv_sec = 0;
+  timer.it_interval.tv_usec = 1000000 / frequency_hz;
+  if (frequency_hz == 1) {
+    timer.it_interval.tv_sec = 1;
+    timer.it_interval.tv_usec = 0;
+  }
+  timer.it_value = timer.it_interval;
+  if (setitimer(ITIMER_PROF, &timer, nullptr) != 0) {
+    return Status(static_cast<error::PosixError>(errno),
+                  "Failed to start the profiling timer");
+  }
+  return Status::OkStatus();
+}
+
+Status StopProfilingTimer() {
+  struct itimerval timer;
+  memset(&timer, 0, sizeof(timer));
+  if (setitimer(ITIMER_PROF, &timer, nullptr) != 0) {
+    return Status(static_cast<error::PosixError>(errno),
+                  "Failed to stop the profiling timer");
+  }
+  return Status::OkStatus();
+}
+
+Status ConvertEnclaveProfileToPprof(const EnclaveProfile &profile,
+                                    const std::string &enclave_path,
+                                    int64_t sampling_period_ns,
+                                    std::string *output) {
+  std::vector<ElfFunction> functions;
+  Status status = ReadElfFunctions(enclave_path, &functions);
+  if (!status.ok()) {
+    return status;
+  }
+
+  PprofBuilder builder;
+  Profile *pprof = builder.profile();
+  perftools::profiles::ValueType *samples_type = pprof->add_sample_type();
+  samples_type->set_type(builder.String("samples"));
+  samples_type->set_unit(builder.String("count"));
+  perftools::profiles::ValueType *cpu_type = pprof->add_sample_type();
+  cpu_type->set_type(builder.String("cpu"));
+  cpu_type->set_unit(builder.String("nanoseconds"));
+  *pprof->mutable_period_type() = *cpu_type;
+  pprof->set_period(sampling_period_ns);
+
+  // Count identical stacks once. Return addresses are looked up one byte
+  // earlier so that a call ending its function is attributed to the caller.
+  std::map<std::vector<uint64_t>, int64_t> stack_counts;
+  uint64_t highest_address = 0;
+  for (const EnclaveProfileSample &sample : profile.samples()) {
+    std::vector<uint64_t> stack;
+    for (int i = 0; i < sample.pcs_size(); ++i) {
+      uint64_t address = sample.pcs(i);
+      highest_address = std::max(highest_address, address);
+      const ElfFunction *function =
+          FindFunction(functions, i == 0 ? address : address - 1);
+      stack.push_back(builder.Location(
+          /*mapping_id=*/1, address, function ? &function->name : nullptr));
+    }
+    ++stack_counts[stack];
+  }
+  if (profile.samples_outside_enclave() > 0) {
+    const std::string outside_enclave = kOutsideEnclaveFunction;
+    stack_counts[{builder.Location(/*mapping_id=*/0, /*address=*/0,
+                                   &outside_enclave)}] +=
+        profile.samples_outside_enclave();
+  }
+  for (const auto &entry : stack_counts) {
+    perftools::profiles::Sample *sample = pprof->add_sample();
+    for (uint64_t location_id : entry.first) {
+      sample->add_location_id(location_id);
+    }
+    sample->add_value(entry.second);
+    sample->add_value(entry.second * sampling_period_ns);
+  }
+
+  perftools::profiles::Mapping *mapping = pprof->add_mapping();
+  mapping->set_id(1);
+  mapping->set_memory_start(0);
+  mapping->set_memory_limit(highest_address + 1);
+  mapping->set_filename(builder.String(enclave_path));
+  mapping->set_has_functions(!functions.empty());
+  if (profile.dropped_samples() > 0) {
+    pprof->add_comment(builder.String(absl::StrCat(
+        profile.dropped_samples(),
+        " samples were dropped because the enclave profiler was full")));
+  }
+
+  if (!pprof->SerializeToString(output)) {
+    return Status(error::GoogleError::INTERNAL,
+                  "Failed to serialize the pprof profile");
+  }
+  return Status::OkStatus();
+}
+
+}  // namespace asylo
@@ -0,0 +1,67 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_PLATFORM_CORE_ENCLAVE_PROFILER_H_
+#define ASYLO_PLATFORM_CORE_ENCLAVE_PROFILER_H_
+
+// Host side of the enclave sampling profiler. An enclave initialized with a
+// positive EnclaveConfig.profiler_sample_capacity registers a SIGPROF handler
+// which records the interrupted enclave stack. The host drives it with a
+// profiling timer, collects the stacks with EnclaveClient::GetProfile() and
+// converts them for pprof:
+//
+//   StartProfilingTimer(100);
+//   ... run the workload ...
+//   StopProfilingTimer();
+//   EnclaveProfile profile;
+//   client->GetProfile(&profile);
+//   std::string pprof_profile;
+//   ConvertEnclaveProfileToPprof(profile, enclave_path, 10000000,
+//                                &pprof_profile);
+
+#include <cstdint>
+#include <string>
+
+#include "asylo/enclave.pb.h"
+#include "asylo/util/status.h"
+
+namespace asylo {
+
+// Makes the process receive SIGPROF |frequency_hz| times per second of CPU
+// time it consumes, which is delivered to the enclave that registered a
+// handler for it. Fails if no SIGPROF handler is installed, since the default
+// action terminates the process.
+Status StartProfilingTimer(int frequency_hz);
+
+// Stops the timer started by StartProfilingTimer().
+Status StopProfilingTimer();
+
+// Converts |profile|, recorded by the enclave loaded from the image at
+// |enclave_path|, to a serialized perftools.profiles.Profile, the format read
+// by pprof, in |output|. Each stack is weighted by |sampling_period_ns|.
+// Addresses are symbolized against the symbol table of the image. Signals
+// received outside enclave code are attributed to a single
+// "[outside enclave]" frame.
+Status ConvertEnclaveProfileToPprof(const EnclaveProfile &profile,
+                                    const std::string &enclave_path,
+                                    int64_t sampling_period_ns,
+                                    std::string *output);
+
+}  // namespace asylo
+
+#endif  // ASYLO_PLATFORM_CORE_ENCLAVE_PROFILER_H_
@@ -0,0 +1,142 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/core/enclave_profiler.h"
+
+#include <link.h>
+#include <signal.h>
+
+#include <string>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include "asylo/platform/core/profile.pb.h"
+#include "asylo/test/util/status_matchers.h"
+
+namespace asylo {
+namespace {
+
+using perftools::profiles::Profile;
+using ::testing::HasSubstr;
+using ::testing::SizeIs;
+
+constexpr int64_t kPeriodNs = 10000000;
+
+__attribute__((noinline)) int ProfiledFunction(int value) {
+  return value * 3 + 1;
+}
+
+// Returns the offset of |address| from the load address of the test binary,
+// which is its address in the ELF image.
+uint64_t ImageOffset(const void *address) {
+  uintptr_t load_bias = 0;
+  dl_iterate_phdr(
+      [](struct dl_phdr_info *info, size_t size, void *data) {
+        *reinterpret_cast<uintptr_t *>(data) = info->dlpi_addr;
+        return 1;
+      },
+      &load_bias);
+  return reinterpret_cast<uintptr_t>(address) - load_bias;
+}
+
+// Returns the name of the function of the innermost location of |sample|.
+std::string InnermostFunction(const Profile &profile, int sample) {
+  uint64_t location_id = profile.sample(sample).location_id(0);
+  for (const auto &location : profile.location()) {
+    if (location.id() != location_id || location.line_size() == 0) {
+      continue;
+    }
+    for (const auto &function : profile.function()) {
+      if (function.id() == location.line(0).function_id()) {
+        return profile.string_table(function.name());
+      }
+    }
+  }
+  return "";
+}
+
+// Verify that addresses are symbolized against the image symbol table.
+TEST(EnclaveProfilerTest, SymbolizesAddresses) {
+  ASSERT_EQ(ProfiledFunction(1), 4);
+  EnclaveProfile profile;
+  profile.add_samples()->add_pcs(
+      ImageOffset(reinterpret_cast<const void *>(&ProfiledFunction)) + 1);
+
+  std::string serialized;
+  ASSERT_THAT(ConvertEnclaveProfileToPprof(profile, "/proc/self/exe",
+                                           kPeriodNs, &serialized),
+              IsOk());
+  Profile pprof;
+  ASSERT_TRUE(pprof.ParseFromString(serialized));
+  ASSERT_THAT(pprof.sample(), SizeIs(1));
+  EXPECT_THAT(InnermostFunction(pprof, 0), HasSubstr("ProfiledFunction"));
+  EXPECT_EQ(pprof.period(), kPeriodNs);
+}
+
+// Verify that identical stacks are counted once, and that signals received
+// outside enclave code are attributed to a single frame.
+TEST(EnclaveProfilerTest, AggregatesStacks) {
+  EnclaveProfile profile;
+  for (int i = 0; i < 2; ++i) {
+    EnclaveProfileSample *sample = profile.add_samples();
+    sample->add_pcs(0x1000);
+    sample->add_pcs(0x2000);
+  }
+  profile.set_samples_outside_enclave(3);
+
+  std::string serialized;
+  ASSERT_THAT(ConvertEnclaveProfileToPprof(profile, "/proc/self/exe",
+                                           kPeriodNs, &serialized),
+              IsOk());
+  Profile pprof;
+  ASSERT_TRUE(pprof.ParseFromString(serialized));
+  ASSERT_THAT(pprof.sample(), SizeIs(2));
+  int64_t total_samples = 0;
+  for (int i = 0; i < pprof.sample_size(); ++i) {
+    const auto &sample = pprof.sample(i);
+    ASSERT_THAT(sample.value(), SizeIs(2));
+    EXPECT_EQ(sample.value(1), sample.value(0) * kPeriodNs);
+    total_samples += sample.value(0);
+    if (sample.location_id_size() == 1) {
+      EXPECT_EQ(InnermostFunction(pprof, i), "[outside enclave]");
+      EXPECT_EQ(sample.value(0), 3);
+    } else {
+      EXPECT_EQ(sample.value(0), 2);
+    }
+  }
+  EXPECT_EQ(total_samples, 5);
+}
+
+// Verify that converting fails for an image which cannot be read.
+TEST(EnclaveProfilerTest, MissingImage) {
+  std::string serialized;
+  EXPECT_THAT(ConvertEnclaveProfileToPprof(EnclaveProfile(),
+                                           "/nonexistent/enclave.so",
+                                           kPeriodNs, &serialized),
+              StatusIs(error::GoogleError::NOT_FOUND));
+}
+
+// Verify that the timer is not started while SIGPROF would kill the process.
+TEST(EnclaveProfilerTest, TimerRequiresHandler) {
+  signal(SIGPROF, SIG_DFL);
+  EXPECT_THAT(StartProfilingTimer(100),
+              StatusIs(error::GoogleError::FAILED_PRECONDITION));
+}
+
+}  // namespace
+}  // namespace asylo
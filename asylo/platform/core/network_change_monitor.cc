@@ -0,0 +1,105 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/core/network_change_monitor.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cstring>
+
+#include "asylo/util/logging.h"
+
+namespace asylo {
+
+NetworkChangeMonitor::NetworkChangeMonitor() {
+  netlink_fd_ = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_ROUTE);
+  if (netlink_fd_ < 0) {
+    LOG(WARNING) << "Could not open a netlink socket, enclaves will not cache "
+                 << "network interfaces: " << strerror(errno);
+    return;
+  }
+
+  struct sockaddr_nl addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.nl_family = AF_NETLINK;
+  addr.nl_groups = RTMGRP_LINK | RTMGRP_IPV4_IFADDR | RTMGRP_IPV6_IFADDR;
+  if (bind(netlink_fd_, reinterpret_cast<struct sockaddr *>(&addr),
+           sizeof(addr)) != 0 ||
+      pipe2(stop_pipe_, O_CLOEXEC) != 0) {
+    LOG(WARNING) << "Could not monitor network changes, enclaves will not "
+                 << "cache network interfaces: " << strerror(errno);
+    close(netlink_fd_);
+    netlink_fd_ = -1;
+    return;
+  }
+
+  generation_.store(1, std::memory_order_release);
+  thread_ = std::thread([this] { Run(); });
+}
+
+NetworkChangeMonitor::~NetworkChangeMonitor() {
+  if (thread_.joinable()) {
+    char byte = 0;
+    while (write(stop_pipe_[1], &byte, 1) < 0 && errno == EINTR) {
+    }
+    thread_.join();
+  }
+  for (int fd : {netlink_fd_, stop_pipe_[0], stop_pipe_[1]}) {
+    if (fd >= 0) {
+      close(fd);
+    }
+  }
+}
+
+void NetworkChangeMonitor::Run() {
+  char buffer[8192];
+  struct pollfd fds[2] = {{netlink_fd_, POLLIN, 0}, {stop_pipe_[0], POLLIN, 0}};
+  while (true) {
+    if (poll(fds, 2, -1) < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      break;
+    }
+    if (fds[1].revents) {
+      return;
+    }
+    ssize_t length = recv(netlink_fd_, buffer, sizeof(buffer), MSG_DONTWAIT);
+    // ENOBUFS means notifications were dropped, so something changed.
+    if (length > 0 || (length < 0 && errno == ENOBUFS)) {
+      generation_.fetch_add(1, std::memory_order_acq_rel);
+      continue;
+    }
+    if (length < 0 && (errno == EINTR || errno == EAGAIN)) {
+      continue;
+    }
+    break;
+  }
+
+  LOG(WARNING) << "Stopped monitoring network changes, enclaves will no "
+               << "longer cache network interfaces";
+  generation_.store(0, std::memory_order_release);
+}
+
+}  // namespace asylo
@@ -0,0 +1,66 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_PLATFORM_CORE_NETWORK_CHANGE_MONITOR_H_
+#define ASYLO_PLATFORM_CORE_NETWORK_CHANGE_MONITOR_H_
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+
+namespace asylo {
+
+// Counts changes to the host's network interfaces and their addresses, as
+// reported by rtnetlink, in a generation counter which EnclaveManager
+// publishes to enclaves so that they may cache the result of getifaddrs.
+//
+// The generation is zero while changes can not be detected, because the
+// netlink socket could not be opened or has failed. Otherwise it starts at one
+// and advances on every notification, including when notifications were lost.
+class NetworkChangeMonitor {
+ public:
+  // Starts monitoring on a background thread.
+  NetworkChangeMonitor();
+
+  NetworkChangeMonitor(const NetworkChangeMonitor &) = delete;
+  NetworkChangeMonitor &operator=(const NetworkChangeMonitor &) = delete;
+
+  // Stops monitoring and joins the background thread.
+  ~NetworkChangeMonitor();
+
+  // Returns the generation counter, which outlives the monitor's thread and
+  // may be shared with enclaves.
+  std::atomic<uint64_t> *generation() { return &generation_; }
+
+ private:
+  // Advances the generation on each notification until the monitor is
+  // stopped or the netlink socket fails.
+  void Run();
+
+  int netlink_fd_ = -1;
+
+  // Written by the destructor to wake the background thread.
+  int stop_pipe_[2] = {-1, -1};
+
+  std::atomic<uint64_t> generation_{0};
+  std::thread thread_;
+};
+
+}  // namespace asylo
+
+#endif  // ASYLO_PLATFORM_CORE_NETWORK_CHANGE_MONITOR_H_
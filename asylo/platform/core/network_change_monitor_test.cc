@@ -0,0 +1,39 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/core/network_change_monitor.h"
+
+#include <cstdint>
+
+#include <gtest/gtest.h>
+
+namespace asylo {
+namespace {
+
+// Verify that a monitor starts at generation one if it can detect changes and
+// zero otherwise, and that it stops promptly when destroyed.
+TEST(NetworkChangeMonitorTest, StartsAndStops) {
+  for (int i = 0; i < 10; ++i) {
+    NetworkChangeMonitor monitor;
+    uint64_t generation = monitor.generation()->load();
+    EXPECT_LE(generation, 1);
+  }
+}
+
+}  // namespace
+}  // namespace asylo
@@ -0,0 +1,252 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/core/resource_stats_exporter.h"
+
+#include <cstdint>
+
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+
+namespace asylo {
+namespace {
+
+// A gauge with one sample per enclave.
+struct Gauge {
+  const char *name;
+  const char *help;
+  int64_t (*value)(const EnclaveResourceStats &stats);
+};
+
+const Gauge kGauges[] = {
+    {"heap_max_bytes",
+     "Size of the region from which the enclave heap is allocated.",
+     [](const EnclaveResourceStats &s) -> int64_t {
+       return s.heap_max_bytes();
+     }},
+    {"heap_in_use_bytes", "Bytes of the enclave heap handed out to allocators.",
+     [](const EnclaveResourceStats &s) -> int64_t {
+       return s.heap_in_use_bytes();
+     }},
+    {"heap_peak_in_use_bytes",
+     "Highest number of bytes of the enclave heap handed out to allocators.",
+     [](const EnclaveResourceStats &s) -> int64_t {
+       return s.heap_peak_in_use_bytes();
+     }},
+    {"heap_committed_bytes", "Bytes of the enclave heap backed by EPC pages.",
+     [](const EnclaveResourceStats &s) -> int64_t {
+       return s.heap_committed_bytes();
+     }},
+    {"heap_peak_committed_bytes",
+     "Highest number of bytes of the enclave heap backed by EPC pages.",
+     [](const EnclaveResourceStats &s) -> int64_t {
+       return s.heap_peak_committed_bytes();
+     }},
+    {"tcs_in_use", "Number of threads inside the enclave.",
+     [](const EnclaveResourceStats &s) -> int64_t { return s.tcs_in_use(); }},
+    {"tcs_peak_in_use", "Highest number of threads inside the enclave at once.",
+     [](const EnclaveResourceStats &s) -> int64_t {
+       return s.tcs_peak_in_use();
+     }},
+    {"parked_threads", "Number of donated threads parked inside the enclave.",
+     [](const EnclaveResourceStats &s) -> int64_t {
+       return s.parked_threads();
+     }},
+    {"running_threads",
+     "Number of enclave threads running or waiting to be joined.",
+     [](const EnclaveResourceStats &s) -> int64_t {
+       return s.running_threads();
+     }},
+    {"open_file_descriptors",
+     "Number of file descriptors open in the enclave.",
+     [](const EnclaveResourceStats &s) -> int64_t {
+       return s.open_file_descriptors();
+     }},
+    {"untrusted_frees_pending",
+     "Number of blocks of untrusted memory queued to be returned to the host.",
+     [](const EnclaveResourceStats &s) -> int64_t {
+       return s.untrusted_frees_pending();
+     }},
+    {"frame_protectors",
+     "Number of secure connections buffering frames in the enclave.",
+     [](const EnclaveResourceStats &s) -> int64_t {
+       return s.frame_protectors();
+     }},
+    {"idle_frame_protectors",
+     "Number of secure connections whose frame buffers are released.",
+     [](const EnclaveResourceStats &s) -> int64_t {
+       return s.idle_frame_protectors();
+     }},
+    {"frame_protector_buffer_bytes",
+     "Bytes held by the frame buffers of secure connections.",
+     [](const EnclaveResourceStats &s) -> int64_t {
+       return s.frame_protector_buffer_bytes();
+     }},
+    {"frame_protector_max_buffer_bytes",
+     "Most bytes held by the frame buffers of a single secure connection.",
+     [](const EnclaveResourceStats &s) -> int64_t {
+       return s.frame_protector_max_buffer_bytes();
+     }},
+};
+
+// A counter of EnclaveIOStats, reported per file descriptor and per path
+// handler. Counters of nanoseconds are reported in seconds.
+struct IOCounter {
+  const char *name;
+  const char *help;
+  bool nanoseconds;
+  uint64_t (*value)(const EnclaveIOStats &stats);
+};
+
+const IOCounter kIOCounters[] = {
+    {"read_ops_total", "Number of reads", false,
+     [](const EnclaveIOStats &s) -> uint64_t { return s.read_ops(); }},
+    {"read_bytes_total", "Bytes read", false,
+     [](const EnclaveIOStats &s) -> uint64_t { return s.read_bytes(); }},
+    {"write_ops_total", "Number of writes", false,
+     [](const EnclaveIOStats &s) -> uint64_t { return s.write_ops(); }},
+    {"write_bytes_total", "Bytes written", false,
+     [](const EnclaveIOStats &s) -> uint64_t { return s.write_bytes(); }},
+    {"short_reads_total", "Number of reads returning fewer bytes than asked",
+     false,
+     [](const EnclaveIOStats &s) -> uint64_t { return s.short_reads(); }},
+    {"short_writes_total", "Number of writes taking fewer bytes than given",
+     false,
+     [](const EnclaveIOStats &s) -> uint64_t { return s.short_writes(); }},
+    {"would_block_total", "Number of reads and writes failing with EAGAIN",
+     false,
+     [](const EnclaveIOStats &s) -> uint64_t { return s.would_block(); }},
+    {"errors_total", "Number of reads and writes failing with other errors",
+     false,
+     [](const EnclaveIOStats &s) -> uint64_t { return s.errors(); }},
+    {"seconds_total", "Time spent in reads and writes", true,
+     [](const EnclaveIOStats &s) -> uint64_t { return s.nanoseconds(); }},
+};
+
+constexpr char kMetricPrefix[] = "asylo_enclave_";
+
+// Appends |value| to |output| as a label value, escaping backslashes, double
+// quotes and line feeds.
+void AppendLabelValue(absl::string_view value, std::string *output) {
+  for (char c : value) {
+    switch (c) {
+      case '\\':
+        output->append("\\\\");
+        break;
+      case '"':
+        output->append("\\\"");
+        break;
+      case '\n':
+        output->append("\\n");
+        break;
+      default:
+        output->push_back(c);
+    }
+  }
+}
+
+void AppendHeader(absl::string_view name, absl::string_view help,
+                  absl::string_view type, std::string *output) {
+  absl::StrAppend(output, "# HELP ", kMetricPrefix, name, " ", help, "\n",
+                  "# TYPE ", kMetricPrefix, name, " ", type, "\n");
+}
+
+// Appends the start of a sample of metric |name| for |enclave_name|, up to and
+// excluding the closing brace of its labels.
+void AppendSampleStart(absl::string_view name, absl::string_view enclave_name,
+                       std::string *output) {
+  absl::StrAppend(output, kMetricPrefix, name, "{enclave=\"");
+  AppendLabelValue(enclave_name, output);
+  output->push_back('"');
+}
+
+// Appends the value of |counter| in |stats| to |output|, followed by a line
+// feed.
+void AppendIOCounterValue(const IOCounter &counter,
+                          const EnclaveIOStats &stats, std::string *output) {
+  uint64_t value = counter.value(stats);
+  if (counter.nanoseconds) {
+    absl::StrAppend(output, value / 1000000000, ".",
+                    absl::Dec(value % 1000000000, absl::kZeroPad9), "\n");
+  } else {
+    absl::StrAppend(output, value, "\n");
+  }
+}
+
+}  // namespace
+
+std::string FormatResourceStatsMetrics(
+    const std::map<std::string, EnclaveResourceStats> &stats_by_enclave) {
+  std::string output;
+  for (const Gauge &gauge : kGauges) {
+    AppendHeader(gauge.name, gauge.help, "gauge", &output);
+    for (const auto &entry : stats_by_enclave) {
+      AppendSampleStart(gauge.name, entry.first, &output);
+      absl::StrAppend(&output, "} ", gauge.value(entry.second), "\n");
+    }
+  }
+
+  AppendHeader("malloc_calls_total",
+               "Number of malloc calls made in the enclave by size class.",
+               "counter", &output);
+  for (const auto &entry : stats_by_enclave) {
+    for (const MallocSizeClassStats &size_class :
+         entry.second.malloc_size_classes()) {
+      AppendSampleStart("malloc_calls_total", entry.first, &output);
+      absl::StrAppend(&output, ",max_size=\"",
+                      size_class.has_max_size()
+                          ? absl::StrCat(size_class.max_size())
+                          : "+Inf",
+                      "\"} ", size_class.calls(), "\n");
+    }
+  }
+
+  for (const IOCounter &counter : kIOCounters) {
+    std::string fd_name = absl::StrCat("fd_io_", counter.name);
+    AppendHeader(fd_name, absl::StrCat(counter.help, " on each open file ",
+                                       "descriptor of the enclave."),
+                 "counter", &output);
+    for (const auto &entry : stats_by_enclave) {
+      for (const FileDescriptorIOStats &fd_io :
+           entry.second.file_descriptor_io()) {
+        AppendSampleStart(fd_name, entry.first, &output);
+        absl::StrAppend(&output, ",fd=\"", fd_io.fd(), "\"} ");
+        AppendIOCounterValue(counter, fd_io.stats(), &output);
+      }
+    }
+
+    std::string handler_name = absl::StrCat("path_handler_io_", counter.name);
+    AppendHeader(handler_name,
+                 absl::StrCat(counter.help, " on the files opened through ",
+                              "each path handler of the enclave."),
+                 "counter", &output);
+    for (const auto &entry : stats_by_enclave) {
+      for (const PathHandlerIOStats &handler_io :
+           entry.second.path_handler_io()) {
+        AppendSampleStart(handler_name, entry.first, &output);
+        output.append(",path_prefix=\"");
+        AppendLabelValue(handler_io.path_prefix(), &output);
+        output.append("\"} ");
+        AppendIOCounterValue(counter, handler_io.stats(), &output);
+      }
+    }
+  }
+  return output;
+}
+
+}  // namespace asylo
@@ -0,0 +1,40 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_PLATFORM_CORE_RESOURCE_STATS_EXPORTER_H_
+#define ASYLO_PLATFORM_CORE_RESOURCE_STATS_EXPORTER_H_
+
+#include <map>
+#include <string>
+
+#include "asylo/enclave.pb.h"
+
+namespace asylo {
+
+// Formats the resource stats of enclaves, keyed by enclave name, in the
+// Prometheus text exposition format. Metric names are prefixed with
+// "asylo_enclave_", and each sample is labelled with the name of its enclave.
+// Calls to malloc are exported as a counter labelled with the max_size of
+// their size class, which is "+Inf" for requests too large for the size
+// classes.
+std::string FormatResourceStatsMetrics(
+    const std::map<std::string, EnclaveResourceStats> &stats_by_enclave);
+
+}  // namespace asylo
+
+#endif  // ASYLO_PLATFORM_CORE_RESOURCE_STATS_EXPORTER_H_
@@ -0,0 +1,113 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/core/resource_stats_exporter.h"
+
+#include <map>
+#include <string>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+namespace asylo {
+namespace {
+
+using ::testing::HasSubstr;
+using ::testing::Not;
+
+// Verify that each gauge is written once with a sample per enclave.
+TEST(ResourceStatsExporterTest, GaugesHaveOneSamplePerEnclave) {
+  std::map<std::string, EnclaveResourceStats> stats_by_enclave;
+  stats_by_enclave["a"].set_heap_in_use_bytes(4096);
+  stats_by_enclave["b"].set_heap_in_use_bytes(8192);
+  stats_by_enclave["b"].set_open_file_descriptors(3);
+
+  std::string metrics = FormatResourceStatsMetrics(stats_by_enclave);
+  EXPECT_THAT(
+      metrics,
+      HasSubstr("# TYPE asylo_enclave_heap_in_use_bytes gauge\n"
+                "asylo_enclave_heap_in_use_bytes{enclave=\"a\"} 4096\n"
+                "asylo_enclave_heap_in_use_bytes{enclave=\"b\"} 8192\n"));
+  EXPECT_THAT(
+      metrics,
+      HasSubstr("asylo_enclave_open_file_descriptors{enclave=\"a\"} 0\n"
+                "asylo_enclave_open_file_descriptors{enclave=\"b\"} 3\n"));
+}
+
+// Verify that malloc calls are labelled with their size class, and that the
+// calls too large for the size classes are labelled +Inf.
+TEST(ResourceStatsExporterTest, MallocCallsAreLabelledBySizeClass) {
+  std::map<std::string, EnclaveResourceStats> stats_by_enclave;
+  EnclaveResourceStats *stats = &stats_by_enclave["a"];
+  MallocSizeClassStats *size_class = stats->add_malloc_size_classes();
+  size_class->set_max_size(16);
+  size_class->set_calls(10);
+  stats->add_malloc_size_classes()->set_calls(2);
+
+  std::string metrics = FormatResourceStatsMetrics(stats_by_enclave);
+  EXPECT_THAT(metrics,
+              HasSubstr("# TYPE asylo_enclave_malloc_calls_total counter\n"
+                        "asylo_enclave_malloc_calls_total{enclave=\"a\","
+                        "max_size=\"16\"} 10\n"
+                        "asylo_enclave_malloc_calls_total{enclave=\"a\","
+                        "max_size=\"+Inf\"} 2\n"));
+}
+
+// Verify that I/O counters are labelled with their file descriptor or path
+// prefix, and that time is reported in seconds.
+TEST(ResourceStatsExporterTest, IOCountersAreLabelledByFdAndPathPrefix) {
+  std::map<std::string, EnclaveResourceStats> stats_by_enclave;
+  EnclaveResourceStats *stats = &stats_by_enclave["a"];
+  FileDescriptorIOStats *fd_io = stats->add_file_descriptor_io();
+  fd_io->set_fd(5);
+  fd_io->mutable_stats()->set_read_bytes(100);
+  fd_io->mutable_stats()->set_nanoseconds(1500000000);
+  PathHandlerIOStats *handler_io = stats->add_path_handler_io();
+  handler_io->set_path_prefix("/data");
+  handler_io->mutable_stats()->set_short_reads(3);
+  handler_io->mutable_stats()->set_nanoseconds(7);
+
+  std::string metrics = FormatResourceStatsMetrics(stats_by_enclave);
+  EXPECT_THAT(metrics,
+              HasSubstr("# TYPE asylo_enclave_fd_io_read_bytes_total counter\n"
+                        "asylo_enclave_fd_io_read_bytes_total{enclave=\"a\","
+                        "fd=\"5\"} 100\n"));
+  EXPECT_THAT(metrics,
+              HasSubstr("asylo_enclave_fd_io_seconds_total{enclave=\"a\","
+                        "fd=\"5\"} 1.500000000\n"));
+  EXPECT_THAT(metrics,
+              HasSubstr("asylo_enclave_path_handler_io_short_reads_total{"
+                        "enclave=\"a\",path_prefix=\"/data\"} 3\n"));
+  EXPECT_THAT(metrics,
+              HasSubstr("asylo_enclave_path_handler_io_seconds_total{"
+                        "enclave=\"a\",path_prefix=\"/data\"} "
+                        "0.000000007\n"));
+}
+
+// Verify that enclave names are escaped in label values.
+TEST(ResourceStatsExporterTest, EnclaveNamesAreEscaped) {
+  std::map<std::string, EnclaveResourceStats> stats_by_enclave;
+  stats_by_enclave["a\"b\\c\nd"];
+
+  std::string metrics = FormatResourceStatsMetrics(stats_by_enclave);
+  EXPECT_THAT(metrics, HasSubstr("{enclave=\"a\\\"b\\\\c\\nd\"}"));
+  EXPECT_THAT(metrics, Not(HasSubstr("c\nd")));
+}
+
+}  // namespace
+}  // namespace asylo
@@ -24,10 +24,21 @@
 
 namespace asylo {
 
+SharedResourceManager::~SharedResourceManager() {
+  const PermanentResource *resource =
+      permanent_resources_.load(std::memory_order_relaxed);
+  while (resource) {
+    const PermanentResource *next = resource->next;
+    delete resource;
+    resource = next;
+  }
+}
+
 Status SharedResourceManager::InstallResource(ResourceHandle *handle) {
   mu_.AssertHeld();
   auto it = shared_resources_.find(handle->resource_name);
-  if (it != shared_resources_.end()) {
+  if (it != shared_resources_.end() ||
+      FindPermanentResource(handle->resource_name)) {
     // If we're not able to insert the resource, destroy the handle wrapper but
     // do not destroy the wrapped resource.
     std::string name = handle->resource_name.name();
@@ -41,7 +52,39 @@ Status SharedResourceManager::InstallResource(ResourceHandle *handle) {
   return Status::OkStatus();
 }
 
+Status SharedResourceManager::InstallPermanentResource(const SharedName &name,
+                                                       void *pointer) {
+  mu_.AssertHeld();
+  if (shared_resources_.find(name) != shared_resources_.end() ||
+      FindPermanentResource(name)) {
+    return Status(error::GoogleError::ALREADY_EXISTS,
+                  absl::StrCat("Cannot install resource \"", name.name(),
+                               "\": Resource already exists."));
+  }
+  permanent_resources_.store(
+      new PermanentResource(
+          name, pointer, permanent_resources_.load(std::memory_order_relaxed)),
+      std::memory_order_release);
+  return Status::OkStatus();
+}
+
+void *SharedResourceManager::FindPermanentResource(
+    const SharedName &name) const {
+  SharedName::Eq eq;
+  for (const PermanentResource *resource =
+           permanent_resources_.load(std::memory_order_acquire);
+       resource; resource = resource->next) {
+    if (eq(resource->resource_name, name)) {
+      return resource->resource;
+    }
+  }
+  return nullptr;
+}
+
 bool SharedResourceManager::ReleaseResource(const SharedName &name) {
+  if (FindPermanentResource(name)) {
+    return true;
+  }
   absl::MutexLock lock(&mu_);
   auto it = shared_resources_.find(name);
   if (it == shared_resources_.end()) {
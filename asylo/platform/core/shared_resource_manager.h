@@ -19,6 +19,7 @@
 #ifndef ASYLO_PLATFORM_CORE_SHARED_RESOURCE_MANAGER_H_
 #define ASYLO_PLATFORM_CORE_SHARED_RESOURCE_MANAGER_H_
 
+#include <atomic>
 #include <memory>
 #include <unordered_map>
 
@@ -34,6 +35,12 @@ namespace asylo {
 /// are shared between trusted and untrusted code.
 class SharedResourceManager {
  public:
+  SharedResourceManager() = default;
+  SharedResourceManager(const SharedResourceManager &other) = delete;
+  SharedResourceManager &operator=(const SharedResourceManager &other) =
+      delete;
+  ~SharedResourceManager();
+
   /// Registers a shared resource and passes ownership to the
   /// SharedResourceManager.
   ///
@@ -74,6 +81,23 @@ class SharedResourceManager {
     return InstallResource(resource);
   }
 
+  /// Registers a shared resource that stays registered for the lifetime of the
+  /// SharedResourceManager.
+  ///
+  /// Permanent resources remain owned by the caller, like unmanaged resources,
+  /// but are not reference counted. Acquiring one takes no lock, so this is
+  /// appropriate for resources that many enclaves and threads acquire, such as
+  /// clocks. ReleaseResource succeeds on a permanent resource but has no
+  /// effect.
+  /// \param name The name to register to this resource.
+  /// \param pointer A pointer to a value owned by the caller, which must
+  ///                outlive the SharedResourceManager.
+  template <typename T>
+  Status RegisterPermanentResource(const SharedName &name, T *pointer) {
+    absl::MutexLock lock(&mu_);
+    return InstallPermanentResource(name, static_cast<void *>(pointer));
+  }
+
   /// Acquires a named resource.
   ///
   /// Acquires a named resource by incrementing its reference count and
@@ -81,6 +105,10 @@ class SharedResourceManager {
   /// nullptr if the named resource does not exist.
   template <typename T>
   T *AcquireResource(const SharedName &name) {
+    void *permanent_resource = FindPermanentResource(name);
+    if (permanent_resource) {
+      return static_cast<T *>(permanent_resource);
+    }
     absl::MutexLock lock(&mu_);
     auto it = shared_resources_.find(name);
     if (it == shared_resources_.end()) {
@@ -138,14 +166,39 @@ class SharedResourceManager {
     T *resource;
   };
 
+  // A permanent resource. Entries are never modified once published, and are
+  // only deleted with the SharedResourceManager.
+  struct PermanentResource {
+    PermanentResource(const SharedName &name, void *pointer,
+                      const PermanentResource *next)
+        : resource_name(name), resource(pointer), next(next) {}
+
+    const SharedName resource_name;
+    void *const resource;
+    const PermanentResource *const next;
+  };
+
   // Installs a entry into shared_resources_. Returns failure and deletes the
   // passed resource handle if the provided name is already in use.
   Status InstallResource(ResourceHandle *handle) EXCLUSIVE_LOCKS_REQUIRED(mu_);
 
+  // Publishes an entry to permanent_resources_. Returns failure if the
+  // provided name is already in use.
+  Status InstallPermanentResource(const SharedName &name, void *pointer)
+      EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  // Returns the permanent resource registered under |name|, or nullptr. Takes
+  // no lock.
+  void *FindPermanentResource(const SharedName &name) const;
+
   absl::Mutex mu_;
   std::unordered_map<SharedName, std::unique_ptr<ResourceHandle>,
                      SharedName::Hash, SharedName::Eq>
       shared_resources_;
+
+  // Head of the list of permanent resources, most recently registered first.
+  // Updated under mu_, and read without it.
+  std::atomic<const PermanentResource *> permanent_resources_{nullptr};
 };
 
 }  // namespace asylo
@@ -0,0 +1,62 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_PLATFORM_CORE_STARTUP_TIMING_H_
+#define ASYLO_PLATFORM_CORE_STARTUP_TIMING_H_
+
+#include <string>
+
+#include "absl/strings/string_view.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "asylo/enclave.pb.h"
+
+namespace asylo {
+
+// Times consecutive phases of enclave startup and appends them to an
+// EnclaveStartupTiming. Does nothing if the timing is null.
+class StartupPhaseTimer {
+ public:
+  // Creates a timer whose first phase starts now, and which prefixes the names
+  // of the phases it records with |prefix|.
+  explicit StartupPhaseTimer(EnclaveStartupTiming *timing,
+                             absl::string_view prefix = "")
+      : timing_(timing), prefix_(prefix), phase_start_(absl::Now()) {}
+
+  // Records the time since the previous phase ended as the phase |name|, and
+  // starts the next phase.
+  void EndPhase(absl::string_view name) {
+    absl::Time now = absl::Now();
+    if (timing_) {
+      EnclaveStartupPhase *phase = timing_->add_phases();
+      phase->set_name(prefix_);
+      phase->mutable_name()->append(name.data(), name.size());
+      phase->set_duration_ns(absl::ToInt64Nanoseconds(now - phase_start_));
+    }
+    phase_start_ = now;
+  }
+
+ private:
+  EnclaveStartupTiming *timing_;
+  const std::string prefix_;
+  absl::Time phase_start_;
+};
+
+}  // namespace asylo
+
+#endif  // ASYLO_PLATFORM_CORE_STARTUP_TIMING_H_
@@ -35,27 +35,30 @@ namespace {
 class ClientApiTest : public EnclaveTest {};
 
 TEST_F(ClientApiTest, InputOutputTest) {
-  EnclaveInput enclave_input;
-  EnclaveApiTest *input_test =
-      enclave_input.MutableExtension(enclave_api_test_input);
-  input_test->set_test_string("test string");
-  input_test->set_test_int(1);
-  input_test->add_test_repeated("test repeated 1");
-  input_test->add_test_repeated("test repeated 2");
-  EnclaveOutput enclave_output;
-  Status status = client_->EnterAndRun(enclave_input, &enclave_output);
-  EXPECT_THAT(status, IsOk());
+  // Later calls reuse the request arena block kept by the enclave thread.
+  for (int i = 0; i < 3; ++i) {
+    EnclaveInput enclave_input;
+    EnclaveApiTest *input_test =
+        enclave_input.MutableExtension(enclave_api_test_input);
+    input_test->set_test_string("test string");
+    input_test->set_test_int(1);
+    input_test->add_test_repeated("test repeated 1");
+    input_test->add_test_repeated("test repeated 2");
+    EnclaveOutput enclave_output;
+    Status status = client_->EnterAndRun(enclave_input, &enclave_output);
+    EXPECT_THAT(status, IsOk());
 
-  ASSERT_TRUE(enclave_output.HasExtension(enclave_api_test_output));
-  EnclaveApiTest output_test =
-      enclave_output.GetExtension(enclave_api_test_output);
-  ASSERT_TRUE(output_test.has_test_string());
-  ASSERT_TRUE(output_test.has_test_int());
-  ASSERT_EQ(output_test.test_repeated_size(), 2);
-  EXPECT_EQ(output_test.test_string(), "output string");
-  EXPECT_EQ(output_test.test_int(), 1);
-  EXPECT_EQ(output_test.test_repeated(0), "output repeated 1");
-  EXPECT_EQ(output_test.test_repeated(1), "output repeated 2");
+    ASSERT_TRUE(enclave_output.HasExtension(enclave_api_test_output));
+    EnclaveApiTest output_test =
+        enclave_output.GetExtension(enclave_api_test_output);
+    ASSERT_TRUE(output_test.has_test_string());
+    ASSERT_TRUE(output_test.has_test_int());
+    ASSERT_EQ(output_test.test_repeated_size(), 2);
+    EXPECT_EQ(output_test.test_string(), "output string");
+    EXPECT_EQ(output_test.test_int(), 1);
+    EXPECT_EQ(output_test.test_repeated(0), "output repeated 1");
+    EXPECT_EQ(output_test.test_repeated(1), "output repeated 2");
+  }
 }
 
 }  // namespace
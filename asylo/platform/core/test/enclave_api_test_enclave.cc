@@ -18,8 +18,10 @@
 
 #include <string>
 
+#include <google/protobuf/arena.h>
 #include "asylo/util/logging.h"
 #include "asylo/platform/core/test/proto_test.pb.h"
+#include "asylo/platform/core/trusted_application.h"
 #include "asylo/test/util/enclave_test_application.h"
 
 namespace asylo {
@@ -46,12 +48,22 @@ class EnclaveApi : public EnclaveTestCase {
       return Status(error::GoogleError::INVALID_ARGUMENT,
                     "Field(s) of user_input doesn't match the value set");
     }
-    EnclaveApiTest output_test;
-    output_test.set_test_string("output string");
-    output_test.set_test_int(1);
-    output_test.add_test_repeated("output repeated 1");
-    output_test.add_test_repeated("output repeated 2");
-    output->MutableExtension(enclave_api_test_output)->CopyFrom(output_test);
+
+    // The messages of the call, and those the call allocates on the request
+    // arena, live until the call returns.
+    google::protobuf::Arena *arena = GetRequestArena();
+    if (arena == nullptr || input.GetArena() != arena ||
+        output->GetArena() != arena) {
+      return Status(error::GoogleError::INTERNAL,
+                    "Messages not allocated on the request arena");
+    }
+    EnclaveApiTest *output_test =
+        google::protobuf::Arena::CreateMessage<EnclaveApiTest>(arena);
+    output_test->set_test_string("output string");
+    output_test->set_test_int(1);
+    output_test->add_test_repeated("output repeated 1");
+    output_test->add_test_repeated("output repeated 2");
+    output->MutableExtension(enclave_api_test_output)->CopyFrom(*output_test);
 
     return Status::OkStatus();
   }
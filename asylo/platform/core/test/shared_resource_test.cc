@@ -119,5 +119,31 @@ TEST(EnclaveResourcesTest, CustomDeleter) {
   EXPECT_EQ(a_string_resource, "custom cleanup strategy was invoked");
 }
 
+TEST(EnclaveResourcesTest, PermanentResource) {
+  EnclaveManager::Configure(EnclaveManagerOptions());
+  SharedResourceManager *resources =
+      EnclaveManager::Instance().ValueOrDie()->shared_resources();
+
+  const SharedName name(kUnspecifiedName, "permanent resource");
+  bool is_resource_alive;
+  TestResource resource(&is_resource_alive);
+  resource.value = "permanent resource";
+  EXPECT_TRUE(resources->RegisterPermanentResource(name, &resource).ok());
+
+  // Ensure the name can't be reused by any kind of resource.
+  EXPECT_FALSE(resources->RegisterPermanentResource(name, &resource).ok());
+  EXPECT_FALSE(resources->RegisterUnmanagedResource(name, &resource).ok());
+  EXPECT_TRUE(is_resource_alive);
+
+  // Expect that releasing the resource never unregisters it.
+  for (int i = 0; i < 10; i++) {
+    EXPECT_EQ(resources->AcquireResource<TestResource>(name), &resource);
+    EXPECT_TRUE(resources->ReleaseResource(name));
+    EXPECT_TRUE(resources->ReleaseResource(name));
+  }
+  EXPECT_EQ(resources->AcquireResource<TestResource>(name), &resource);
+  EXPECT_TRUE(is_resource_alive);
+}
+
 }  // namespace
 }  // namespace asylo
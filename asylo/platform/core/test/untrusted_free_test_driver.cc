@@ -0,0 +1,56 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <cstdint>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include "absl/strings/str_cat.h"
+#include "asylo/enclave.pb.h"
+#include "asylo/test/util/enclave_test.h"
+#include "asylo/test/util/status_matchers.h"
+
+namespace asylo {
+namespace {
+
+class UntrustedFreeTest : public EnclaveTest {
+ protected:
+  uint64_t UntrustedFreesPending() {
+    EnclaveResourceStats stats;
+    EXPECT_THAT(client_->GetResourceStats(&stats), IsOk());
+    return stats.untrusted_frees_pending();
+  }
+};
+
+// Verify that untrusted memory released by an EnterAndRun call is returned to
+// the host when the call leaves the enclave, so that a TCS which only serves
+// EnterAndRun does not hold on to it. Each call releases fewer blocks than are
+// queued before being returned, 64.
+TEST_F(UntrustedFreeTest, ReleasedOnEachCall) {
+  for (int blocks : {1, 10, 63}) {
+    EnclaveInput enclave_input;
+    SetEnclaveInputTestString(&enclave_input, absl::StrCat(blocks));
+    for (int i = 0; i < 20; ++i) {
+      ASSERT_THAT(client_->EnterAndRun(enclave_input, nullptr), IsOk());
+      EXPECT_EQ(UntrustedFreesPending(), 0) << blocks << " blocks";
+    }
+  }
+}
+
+}  // namespace
+}  // namespace asylo
@@ -0,0 +1,58 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <string>
+
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_cat.h"
+#include "asylo/platform/arch/include/trusted/host_calls.h"
+#include "asylo/platform/arch/include/trusted/memory.h"
+#include "asylo/platform/arch/include/trusted/resource_usage.h"
+#include "asylo/test/util/enclave_test_application.h"
+
+namespace asylo {
+
+// Releases the number of untrusted blocks given in the test string, through
+// the queue of blocks which are returned to the host together.
+class UntrustedFreeTest : public EnclaveTestCase {
+ public:
+  UntrustedFreeTest() = default;
+
+  Status Run(const EnclaveInput &input, EnclaveOutput *) {
+    int blocks;
+    if (!absl::SimpleAtoi(GetEnclaveInputTestString(input), &blocks)) {
+      return Status(error::GoogleError::INVALID_ARGUMENT,
+                    "Expected the number of blocks to release");
+    }
+    for (int i = 0; i < blocks; ++i) {
+      UntrustedUniquePtr<void> block(enc_untrusted_malloc(4096));
+    }
+    // The blocks stay queued until this thread leaves the enclave.
+    size_t pending = enc_get_untrusted_frees_pending();
+    if (pending < static_cast<size_t>(blocks)) {
+      return Status(error::GoogleError::INTERNAL,
+                    absl::StrCat("Only ", pending, " of ", blocks,
+                                 " released blocks are queued"));
+    }
+    return Status::OkStatus();
+  }
+};
+
+TrustedApplication *BuildTrustedApplication() { return new UntrustedFreeTest; }
+
+}  // namespace asylo
@@ -18,30 +18,54 @@
 
 #include "asylo/platform/core/trusted_application.h"
 
+#include <openssl/mem.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <sys/ucontext.h>
 #include <unistd.h>
 #include <cerrno>
+#include <memory>
 #include <string>
+#include <utility>
+#include <vector>
 
+#include <google/protobuf/arena.h>
+#include "absl/base/attributes.h"
 #include "absl/memory/memory.h"
 #include "absl/strings/str_cat.h"
 #include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
 #include "asylo/util/logging.h"
 #include "asylo/identity/init.h"
+#include "asylo/identity/named_identity_expectation_matcher.h"
+#include "asylo/identity/secret_sealer.h"
+#include "asylo/identity/sgx/sgx_local_secret_sealer.h"
+#include "asylo/platform/arch/include/trusted/async_io.h"
+#include "asylo/platform/arch/include/trusted/heap.h"
 #include "asylo/platform/arch/include/trusted/host_calls.h"
+#include "asylo/platform/arch/include/trusted/resource_usage.h"
+#include "asylo/platform/arch/include/trusted/sampling_profiler.h"
+#include "asylo/platform/arch/include/trusted/switchless.h"
 #include "asylo/platform/arch/include/trusted/time.h"
+#include "asylo/platform/common/boundary_copy.h"
 #include "asylo/platform/common/bridge_types.h"
 #include "asylo/platform/core/shared_name_kind.h"
+#include "asylo/platform/core/startup_timing.h"
 #include "asylo/platform/core/trusted_global_state.h"
+#include "asylo/platform/posix/environment_table.h"
+#include "asylo/platform/posix/host_info_cache.h"
+#include "asylo/platform/posix/syslog_batcher.h"
 #include "asylo/platform/posix/io/io_manager.h"
 #include "asylo/platform/posix/io/native_paths.h"
 #include "asylo/platform/posix/io/random_devices.h"
 #include "asylo/platform/posix/signal/signal_manager.h"
+#include "asylo/platform/posix/sockets/addrinfo_cache.h"
 #include "asylo/platform/posix/threading/thread_manager.h"
+#include "asylo/platform/storage/secure/aead_handler.h"
+#include "asylo/util/cleansing_types.h"
 #include "asylo/util/posix_error_space.h"
 #include "asylo/util/status.h"
+#include "asylo/util/status_macros.h"
 
 using EnclaveState = ::asylo::TrustedApplication::State;
 using google::protobuf::RepeatedPtrField;
@@ -49,6 +73,45 @@ using google::protobuf::RepeatedPtrField;
 namespace asylo {
 namespace {
 
+// Size of the block that each thread keeps for the arenas of its Run() calls.
+constexpr size_t kRequestArenaBlockSize = 64 * 1024;
+
+// Arena of the Run() call in progress on the calling thread, or nullptr.
+ABSL_CONST_INIT thread_local google::protobuf::Arena *request_arena = nullptr;
+
+// Makes an arena the request arena of the calling thread for the lifetime of
+// the object. The arena starts in the thread's retained block, so that a call
+// whose allocations fit in it neither allocates nor frees memory. A call which
+// enters the enclave while another is in progress on the thread, such as from
+// a host call, uses an arena of its own blocks instead.
+class RequestArenaScope {
+ public:
+  RequestArenaScope() : previous_(request_arena), arena_(Options()) {
+    request_arena = &arena_;
+  }
+
+  RequestArenaScope(const RequestArenaScope &) = delete;
+  RequestArenaScope &operator=(const RequestArenaScope &) = delete;
+
+  ~RequestArenaScope() { request_arena = previous_; }
+
+  google::protobuf::Arena *arena() { return &arena_; }
+
+ private:
+  google::protobuf::ArenaOptions Options() const {
+    google::protobuf::ArenaOptions options;
+    if (previous_ == nullptr) {
+      static thread_local char *block = new char[kRequestArenaBlockSize];
+      options.initial_block = block;
+      options.initial_block_size = kRequestArenaBlockSize;
+    }
+    return options;
+  }
+
+  google::protobuf::Arena *const previous_;
+  google::protobuf::Arena arena_;
+};
+
 void LogError(const Status &status) {
   EnclaveState state = GetApplicationInstance()->GetState();
   if (state < EnclaveState::kUserInitializing) {
@@ -87,6 +150,19 @@ class StatusSerializer {
         output_{output},
         output_len_{output_len} {}
 
+  // Creates a new StatusSerializer as above which writes the serialized
+  // |output_proto| to |output_buffer| in untrusted memory if it fits in
+  // |output_capacity| bytes, instead of allocating an untrusted buffer.
+  StatusSerializer(const OutputProto *output_proto, StatusProto *status_proto,
+                   char *output_buffer, size_t output_capacity, char **output,
+                   size_t *output_len)
+      : output_proto_{output_proto},
+        status_proto_{status_proto},
+        output_buffer_{output_buffer},
+        output_capacity_{output_capacity},
+        output_{output},
+        output_len_{output_len} {}
+
   // Saves the given |status| into the StatusSerializer's status_proto_. Then
   // serializes its output_proto_ into a buffer. On success 0 is returned, else
   // 1 is returned and the StatusSerializer logs the error.
@@ -95,16 +171,29 @@ class StatusSerializer {
 
     // Serialize to a trusted buffer instead of an untrusted buffer because the
     // serialization routine may rely on read backs for correctness.
+    // During a Run() call the buffer is taken from its arena.
     *output_len_ = output_proto_->ByteSize();
-    std::unique_ptr<char[]> trusted_output(new char[*output_len_]);
-    if (!output_proto_->SerializeToArray(trusted_output.get(), *output_len_)) {
+    std::unique_ptr<char[]> heap_output;
+    char *trusted_output;
+    if (request_arena) {
+      trusted_output = google::protobuf::Arena::CreateArray<char>(
+          request_arena, *output_len_);
+    } else {
+      heap_output.reset(new char[*output_len_]);
+      trusted_output = heap_output.get();
+    }
+    if (!output_proto_->SerializeToArray(trusted_output, *output_len_)) {
       *output_ = nullptr;
       *output_len_ = 0;
       LogError(status);
       return 1;
     }
-    *output_ = reinterpret_cast<char *>(enc_untrusted_malloc(*output_len_));
-    memcpy(*output_, trusted_output.get(), *output_len_);
+    if (output_buffer_ && *output_len_ <= output_capacity_) {
+      *output_ = output_buffer_;
+    } else {
+      *output_ = reinterpret_cast<char *>(enc_untrusted_malloc(*output_len_));
+    }
+    BoundaryCopyOut(*output_, trusted_output, *output_len_);
     return 0;
   }
 
@@ -112,10 +201,83 @@ class StatusSerializer {
   OutputProto proto;
   const OutputProto *output_proto_;
   StatusProto *status_proto_;
+  char *output_buffer_ = nullptr;
+  size_t output_capacity_ = 0;
   char **output_;
   size_t *output_len_;
 };
 
+// Name and version of the sealed secret holding the application state in
+// enclave snapshots.
+constexpr char kSnapshotSecretName[] = "Asylo enclave snapshot";
+constexpr char kSnapshotSecretVersion[] = "1";
+
+// Seals |state| to the MRENCLAVE of the enclave and stores the serialized
+// SealedSecret in |snapshot|.
+Status SealSnapshot(ByteContainerView state, std::string *snapshot) {
+  std::unique_ptr<SgxLocalSecretSealer> sealer =
+      SgxLocalSecretSealer::CreateMrenclaveSecretSealer();
+  SealedSecretHeader header;
+  ASYLO_RETURN_IF_ERROR(sealer->SetDefaultHeader(&header));
+  header.set_secret_name(kSnapshotSecretName);
+  header.set_secret_version(kSnapshotSecretVersion);
+  header.set_secret_purpose("Trusted application state");
+
+  SealedSecret sealed_secret;
+  ASYLO_RETURN_IF_ERROR(sealer->Seal(
+      header, /*additional_authenticated_data=*/ByteContainerView(nullptr, 0),
+      state, &sealed_secret));
+  if (!sealed_secret.SerializeToString(snapshot)) {
+    return Status(error::GoogleError::INTERNAL,
+                  "Failed to serialize enclave snapshot");
+  }
+  return Status::OkStatus();
+}
+
+// Unseals the application state in |snapshot| into |state|.
+Status UnsealSnapshot(const std::string &snapshot,
+                      CleansingVector<uint8_t> *state) {
+  SealedSecret sealed_secret;
+  SealedSecretHeader header;
+  if (!sealed_secret.ParseFromString(snapshot) ||
+      !header.ParseFromString(sealed_secret.sealed_secret_header())) {
+    return Status(error::GoogleError::INVALID_ARGUMENT,
+                  "Failed to parse enclave snapshot");
+  }
+  if (header.secret_name() != kSnapshotSecretName ||
+      header.secret_version() != kSnapshotSecretVersion) {
+    return Status(error::GoogleError::INVALID_ARGUMENT,
+                  absl::StrCat("Unsupported enclave snapshot ",
+                               header.secret_name(), " version ",
+                               header.secret_version()));
+  }
+
+  std::unique_ptr<SgxLocalSecretSealer> sealer =
+      SgxLocalSecretSealer::CreateMrenclaveSecretSealer();
+  Status status = sealer->Unseal(sealed_secret, state);
+  if (!status.ok()) {
+    // A snapshot that fails to unseal was modified or sealed to another
+    // enclave, which is an error of the caller like a malformed snapshot.
+    return Status(error::GoogleError::INVALID_ARGUMENT,
+                  absl::StrCat("Failed to unseal enclave snapshot: ",
+                               status.error_message()));
+  }
+  return Status::OkStatus();
+}
+
+// Copies the I/O totals |snapshot| to |stats|.
+void CopyIOStats(const io::IOStatsSnapshot &snapshot, EnclaveIOStats *stats) {
+  stats->set_read_ops(snapshot.read_ops);
+  stats->set_read_bytes(snapshot.read_bytes);
+  stats->set_write_ops(snapshot.write_ops);
+  stats->set_write_bytes(snapshot.write_bytes);
+  stats->set_short_reads(snapshot.short_reads);
+  stats->set_short_writes(snapshot.short_writes);
+  stats->set_would_block(snapshot.would_block);
+  stats->set_errors(snapshot.errors);
+  stats->set_nanoseconds(snapshot.nanoseconds);
+}
+
 }  // namespace
 
 Status TrustedApplication::VerifyAndSetState(const EnclaveState &expected_state,
@@ -140,6 +302,27 @@ void TrustedApplication::SetState(const EnclaveState &state) {
   enclave_state_ = state;
 }
 
+Status TrustedApplication::RunBatch(const EnclaveInputBatch &inputs,
+                                    EnclaveOutputBatch *outputs) {
+  for (const EnclaveInput &input : inputs.inputs()) {
+    EnclaveOutput *output = outputs->add_outputs();
+    Run(input, output).SaveTo(output->mutable_status());
+  }
+  return Status::OkStatus();
+}
+
+Status TrustedApplication::Reset(const EnclaveFinal &final_input) {
+  Status status = Finalize(final_input);
+  if (!status.ok()) {
+    return status;
+  }
+  StatusOr<const EnclaveConfig *> config_result = GetEnclaveConfig();
+  if (!config_result.ok()) {
+    return config_result.status();
+  }
+  return Initialize(*config_result.ValueOrDie());
+}
+
 Status VerifyOutputArguments(char **output, size_t *output_len) {
   if (!output || !output_len) {
     Status status =
@@ -168,6 +351,8 @@ TrustedApplication *GetApplicationInstance() {
   return global_trusted_application;
 }
 
+google::protobuf::Arena *GetRequestArena() { return request_arena; }
+
 Status InitializeEnvironmentVariables(
     const RepeatedPtrField<EnvironmentVariable> &variables) {
   for (const auto &variable : variables) {
@@ -178,31 +363,139 @@ Status InitializeEnvironmentVariables(
     }
     setenv(variable.name().c_str(), variable.value().c_str(), /*overwrite=*/0);
   }
+  InstallEnvironmentTable(environ);
   return Status::OkStatus();
 }
 
-Status TrustedApplication::InitializeInternal(const EnclaveConfig &config) {
+Status TrustedApplication::InitializeInternal(const EnclaveConfig &config,
+                                              EnclaveStartupTiming *timing) {
+  StartupPhaseTimer timer(timing, "enclave/");
+  if (config.use_tsc_clock()) {
+    enc_enable_tsc_clock();
+  }
   InitializeIO(config);
+  timer.EndPhase("io");
   Status status =
       InitializeEnvironmentVariables(config.environment_variables());
+  timer.EndPhase("environment_variables");
   const char *log_directory = config.logging_config().log_directory().c_str();
   int vlog_level = config.logging_config().vlog_level();
   if(!InitLogging(log_directory, GetEnclaveName().c_str(), vlog_level)) {
     fprintf(stderr, "Initialization of enclave logging failed\n");
   }
+  if (!set_vmodule(config.logging_config().vmodule())) {
+    fprintf(stderr, "Invalid enclave vmodule: %s\n",
+            config.logging_config().vmodule().c_str());
+  }
+  if (config.logging_config().async_log_queue_capacity() > 0 &&
+      !EnableAsyncLogging(config.logging_config().async_log_queue_capacity())) {
+    fprintf(stderr, "Initialization of asynchronous enclave logging failed\n");
+  }
+  const LoggingConfig &logging_config = config.logging_config();
+  if (logging_config.syslog_batch_bytes() > 0 &&
+      !SyslogBatcher::GetInstance().Enable(
+          logging_config.syslog_batch_bytes(),
+          absl::Milliseconds(logging_config.syslog_flush_interval_ms()),
+          [](const uint8_t *records, size_t size) {
+            enc_untrusted_syslog_batch(records, size);
+          })) {
+    fprintf(stderr, "Initialization of syslog batching failed\n");
+  }
+  timer.EndPhase("logging");
   if (!status.ok()) {
     LOG(WARNING) << "Initialization of enclave environment variables failed: "
                  << status;
   }
   SetEnclaveConfig(config);
+  // Host calls fall back to classic ocalls if the switchless queue is missing.
+  if (config.switchless_worker_threads() > 0) {
+    struct enc_switchless_costs costs;
+    if (enc_enable_switchless_host_calls(GetEnclaveName().c_str()) != 0) {
+      LOG(WARNING) << "Initialization of switchless host calls failed";
+    } else if (enc_calibrate_switchless_host_calls(&costs) != 0) {
+      LOG(WARNING) << "Calibration of switchless host calls failed";
+    } else {
+      VLOG(1) << "Calibrated host call costs: exit " << costs.exit_ns
+              << "ns, switchless request " << costs.request_ns
+              << "ns, copy " << costs.copy_ps_per_byte << "ps/byte";
+    }
+  }
+  if (config.async_io_worker_threads() > 0 &&
+      enc_enable_async_io(GetEnclaveName().c_str()) != 0) {
+    LOG(WARNING) << "Initialization of asynchronous I/O failed";
+  }
+  ThreadManager::GetInstance()->SetParkedThreadLimit(config.thread_pool_size());
+  if (config.profiler_sample_capacity() > 0) {
+    Status profiler_status =
+        StartSamplingProfiler(config.profiler_sample_capacity());
+    if (!profiler_status.ok()) {
+      LOG(WARNING) << "Initialization of the sampling profiler failed: "
+                   << profiler_status;
+    }
+  }
+  timer.EndPhase("host_queues");
+  if (config.nanosleep_exit_threshold_ns() >= 0) {
+    enc_set_nanosleep_exit_threshold(config.nanosleep_exit_threshold_ns());
+  } else {
+    VLOG(1) << "Calibrated nanosleep exit threshold: "
+            << enc_calibrate_nanosleep_exit_threshold() << "ns";
+  }
+  timer.EndPhase("nanosleep_calibration");
+  if (config.secure_storage_crypto_threads() > 0 &&
+      platform::storage::AeadHandler::GetInstance().EnableParallelCrypto(
+          config.secure_storage_crypto_threads()) != 0) {
+    LOG(WARNING) << "Initialization of parallel secure storage crypto failed";
+  }
+  if (config.secure_storage_block_cache_bytes() > 0 &&
+      platform::storage::AeadHandler::GetInstance().EnableBlockCache(
+          config.secure_storage_block_cache_bytes()) != 0) {
+    LOG(WARNING) << "Initialization of the secure storage block cache failed";
+  }
+  if (config.secure_storage_read_ahead_bytes() > 0 &&
+      platform::storage::AeadHandler::GetInstance().EnableReadAhead(
+          config.secure_storage_read_ahead_bytes()) != 0) {
+    LOG(WARNING) << "Initialization of secure storage read-ahead failed";
+  }
+  if (config.secure_storage_digest_write_back_updates() > 0 &&
+      platform::storage::AeadHandler::GetInstance().EnableDigestWriteBack(
+          config.secure_storage_digest_write_back_updates(),
+          absl::Milliseconds(config.secure_storage_digest_write_back_ms())) !=
+          0) {
+    LOG(WARNING) << "Initialization of secure storage digest write-back failed";
+  }
+  timer.EndPhase("secure_storage");
+  // Static initialization is complete, so the static maps of identity
+  // components are frozen, which makes their lookups on the handshake and
+  // sealing paths lock-free.
+  AssertionGeneratorMap::Freeze();
+  AssertionVerifierMap::Freeze();
+  IdentityExpectationMatcherMap::Freeze();
+  SecretSealerMap::Freeze();
   // This call can fail, but it should not stop the enclave from running.
+  AssertionAuthorityInitOptions authority_init_options;
+  authority_init_options.num_threads =
+      config.assertion_authority_init_threads();
+  authority_init_options.defer_deferrable_authorities =
+      config.defer_assertion_authority_init();
+  std::vector<AssertionAuthorityInitRecord> authority_init_records;
   status = InitializeEnclaveAssertionAuthorities(
       config.enclave_assertion_authority_configs().begin(),
-      config.enclave_assertion_authority_configs().end());
+      config.enclave_assertion_authority_configs().end(),
+      authority_init_options, &authority_init_records);
   if (!status.ok()) {
     LOG(WARNING) << "Initialization of enclave assertion authorities failed: "
                  << status;
   }
+  for (const AssertionAuthorityInitRecord &record : authority_init_records) {
+    VLOG(1) << "Assertion "
+            << (record.is_generator ? "generator " : "verifier ")
+            << record.description.ShortDebugString()
+            << (record.deferred ? " deferred"
+                                : " initialized in " +
+                                      absl::FormatDuration(record.duration))
+            << ": " << record.status;
+  }
+  timer.EndPhase("assertion_authorities");
 
   status = VerifyAndSetState(EnclaveState::kInternalInitializing,
                              EnclaveState::kUserInitializing);
@@ -210,7 +503,23 @@ Status TrustedApplication::InitializeInternal(const EnclaveConfig &config) {
     return status;
   }
 
-  return Initialize(config);
+  // A snapshot replaces the application's own initialization, while the
+  // runtime above is initialized from |config| as usual.
+  if (config.has_snapshot()) {
+    CleansingVector<uint8_t> state;
+    status = UnsealSnapshot(config.snapshot(), &state);
+    timer.EndPhase("snapshot_unseal");
+    if (!status.ok()) {
+      return status;
+    }
+    status = Restore(config, state);
+    timer.EndPhase("user_restore");
+    return status;
+  }
+
+  status = Initialize(config);
+  timer.EndPhase("user_initialize");
+  return status;
 }
 
 void InitializeIO(const EnclaveConfig &config) {
@@ -229,6 +538,43 @@ void InitializeIO(const EnclaveConfig &config) {
     io_manager.RegisterHostFileDescriptor(config.stderr_fd());
   }
 
+  if (config.native_io_buffer_size() > 0) {
+    io_manager.SetNativeBufferSize(config.native_io_buffer_size());
+  }
+  if (config.readdir_batch_size() > 0) {
+    io_manager.SetReaddirBatchSize(config.readdir_batch_size());
+  }
+
+  if (config.getaddrinfo_cache_size() > 0) {
+    constexpr int64_t kNanosecondsPerSecond = 1000000000;
+    AddrinfoCache::GetInstance().Configure(
+        config.getaddrinfo_cache_size(),
+        config.getaddrinfo_cache_ttl_seconds() * kNanosecondsPerSecond,
+        config.getaddrinfo_negative_cache_ttl_seconds() *
+            kNanosecondsPerSecond);
+  }
+
+  const HostSystemInfo &system_info = config.host_config().system_info();
+  HostInfo host_info;
+  if (system_info.has_processors_configured()) {
+    host_info.processors_configured = system_info.processors_configured();
+  }
+  if (system_info.has_processors_online()) {
+    host_info.processors_online = system_info.processors_online();
+  }
+  if (system_info.has_page_size()) {
+    host_info.page_size = system_info.page_size();
+  }
+  host_info.cpu_affinity.assign(system_info.cpu_affinity().begin(),
+                                system_info.cpu_affinity().end());
+  host_info.sysname = system_info.sysname();
+  host_info.nodename = system_info.nodename();
+  host_info.release = system_info.release();
+  host_info.version = system_info.version();
+  host_info.machine = system_info.machine();
+  host_info.domainname = system_info.domainname();
+  HostInfoCache::GetInstance().Set(host_info);
+
   // Register handler for / so paths without other handlers are forwarded on to
   // the host system. Paths are registered without the trailing slash, so an
   // empty string is used.
@@ -260,7 +606,9 @@ int __asylo_user_init(const char *name, const char *config, size_t config_len,
     return 1;
   }
 
-  StatusSerializer<StatusProto> status_serializer(output, output_len);
+  EnclaveOutput enclave_output;
+  StatusSerializer<EnclaveOutput> status_serializer(
+      &enclave_output, enclave_output.mutable_status(), output, output_len);
 
   EnclaveConfig enclave_config;
   if (!enclave_config.ParseFromArray(config, config_len)) {
@@ -278,7 +626,8 @@ int __asylo_user_init(const char *name, const char *config, size_t config_len,
 
   SetEnclaveName(name);
   // Invoke the enclave entry-point.
-  status = trusted_application->InitializeInternal(enclave_config);
+  status = trusted_application->InitializeInternal(
+      enclave_config, enclave_output.mutable_startup_timing());
   if (!status.ok()) {
     trusted_application->SetState(EnclaveState::kUninitialized);
     return status_serializer.Serialize(status);
@@ -295,12 +644,18 @@ int __asylo_user_run(const char *input, size_t input_len, char **output,
     return 1;
   }
 
-  EnclaveOutput enclave_output;
+  // Both messages, their submessages and the serialized output are allocated
+  // on the request arena, which is released at once when the call returns.
+  RequestArenaScope arena_scope;
+  google::protobuf::Arena *arena = arena_scope.arena();
+  EnclaveOutput *enclave_output =
+      google::protobuf::Arena::CreateMessage<EnclaveOutput>(arena);
   StatusSerializer<EnclaveOutput> status_serializer(
-      &enclave_output, enclave_output.mutable_status(), output, output_len);
+      enclave_output, enclave_output->mutable_status(), output, output_len);
 
-  EnclaveInput enclave_input;
-  if (!enclave_input.ParseFromArray(input, input_len)) {
+  EnclaveInput *enclave_input =
+      google::protobuf::Arena::CreateMessage<EnclaveInput>(arena);
+  if (!enclave_input->ParseFromArray(input, input_len)) {
     status = Status(error::GoogleError::INVALID_ARGUMENT,
                     "Failed to parse EnclaveInput");
     return status_serializer.Serialize(status);
@@ -314,10 +669,137 @@ int __asylo_user_run(const char *input, size_t input_len, char **output,
   }
 
   // Invoke the enclave entry-point.
-  status = trusted_application->Run(enclave_input, &enclave_output);
+  status = trusted_application->Run(*enclave_input, enclave_output);
   return status_serializer.Serialize(status);
 }
 
+int __asylo_user_run_batch(const char *input, size_t input_len, char **output,
+                           size_t *output_len) {
+  Status status = VerifyOutputArguments(output, output_len);
+  if (!status.ok()) {
+    return 1;
+  }
+
+  // A batch holds many inputs and outputs, so its messages are allocated on the
+  // request arena, which is released at once when the call returns.
+  RequestArenaScope arena_scope;
+  google::protobuf::Arena *arena = arena_scope.arena();
+  EnclaveOutputBatch *output_batch =
+      google::protobuf::Arena::CreateMessage<EnclaveOutputBatch>(arena);
+  StatusSerializer<EnclaveOutputBatch> status_serializer(
+      output_batch, output_batch->mutable_status(), output, output_len);
+
+  EnclaveInputBatch *input_batch =
+      google::protobuf::Arena::CreateMessage<EnclaveInputBatch>(arena);
+  if (!input_batch->ParseFromArray(input, input_len)) {
+    status = Status(error::GoogleError::INVALID_ARGUMENT,
+                    "Failed to parse EnclaveInputBatch");
+    return status_serializer.Serialize(status);
+  }
+
+  TrustedApplication *trusted_application = GetApplicationInstance();
+  if (trusted_application->GetState() != EnclaveState::kRunning) {
+    status = Status(error::GoogleError::FAILED_PRECONDITION,
+                    "Enclave not in state RUNNING");
+    return status_serializer.Serialize(status);
+  }
+
+  // Invoke the enclave entry-point. The outputs of a failed batch are not
+  // returned, so the caller never sees a partial batch.
+  status = trusted_application->RunBatch(*input_batch, output_batch);
+  if (!status.ok()) {
+    output_batch->clear_outputs();
+  }
+  return status_serializer.Serialize(status);
+}
+
+int __asylo_user_run_with_buffers(const char *input, size_t input_len,
+                                  char *output_buffer, size_t output_capacity,
+                                  char **output, size_t *output_len) {
+  Status status = VerifyOutputArguments(output, output_len);
+  if (!status.ok()) {
+    return 1;
+  }
+
+  // Both messages and all of their submessages are allocated on the request
+  // arena, which is released at once when the call returns.
+  RequestArenaScope arena_scope;
+  google::protobuf::Arena *arena = arena_scope.arena();
+  EnclaveOutput *enclave_output =
+      google::protobuf::Arena::CreateMessage<EnclaveOutput>(arena);
+  StatusSerializer<EnclaveOutput> status_serializer(
+      enclave_output, enclave_output->mutable_status(), output_buffer,
+      output_capacity, output, output_len);
+
+  // |input| is parsed directly out of untrusted memory. The parser never reads
+  // outside of [input, input + input_len), so a host modifying the buffer
+  // during the call can only change the message it sends, as it could have done
+  // before the call.
+  EnclaveInput *enclave_input =
+      google::protobuf::Arena::CreateMessage<EnclaveInput>(arena);
+  if (!enclave_input->ParseFromArray(input, input_len)) {
+    status = Status(error::GoogleError::INVALID_ARGUMENT,
+                    "Failed to parse EnclaveInput");
+    return status_serializer.Serialize(status);
+  }
+
+  TrustedApplication *trusted_application = GetApplicationInstance();
+  if (trusted_application->GetState() != EnclaveState::kRunning) {
+    status = Status(error::GoogleError::FAILED_PRECONDITION,
+                    "Enclave not in state RUNNING");
+    return status_serializer.Serialize(status);
+  }
+
+  // Invoke the enclave entry-point.
+  status = trusted_application->Run(*enclave_input, enclave_output);
+  return status_serializer.Serialize(status);
+}
+
+int __asylo_user_run_raw(const char *input, size_t input_len,
+                         char *output_buffer, size_t output_capacity,
+                         char **output, size_t *output_len, int *status_code) {
+  if (!output || !output_len || !status_code) {
+    return 1;
+  }
+
+  // The output string is reused by all raw calls on a thread, so that calls
+  // with outputs no larger than earlier ones do not allocate.
+  static thread_local std::string *raw_output = new std::string;
+  raw_output->clear();
+
+  Status status;
+  TrustedApplication *trusted_application = GetApplicationInstance();
+  if (trusted_application->GetState() != EnclaveState::kRunning) {
+    status = Status(error::GoogleError::FAILED_PRECONDITION,
+                    "Enclave not in state RUNNING");
+  } else {
+    // Invoke the enclave entry-point.
+    status = trusted_application->RunRaw(ByteContainerView(input, input_len),
+                                         raw_output);
+  }
+
+  *status_code = status.CanonicalCode();
+  if (!status.ok()) {
+    raw_output->assign(status.error_message().data(),
+                       status.error_message().size());
+  }
+
+  *output_len = raw_output->size();
+  if (*output_len == 0 || (output_buffer && *output_len <= output_capacity)) {
+    *output = output_buffer;
+  } else {
+    *output = reinterpret_cast<char *>(enc_untrusted_malloc(*output_len));
+    if (!*output) {
+      *output_len = 0;
+      return 1;
+    }
+  }
+  if (*output_len > 0) {
+    BoundaryCopyOut(*output, raw_output->data(), *output_len);
+  }
+  return 0;
+}
+
 int __asylo_user_fini(const char *input, size_t input_len, char **output,
                       size_t *output_len) {
   Status status = VerifyOutputArguments(output, output_len);
@@ -348,10 +830,157 @@ int __asylo_user_fini(const char *input, size_t input_len, char **output,
     return status_serializer.Serialize(status);
   }
 
+  // Stop the log flushers and let parked threads leave the enclave so it can
+  // be destroyed.
+  DisableAsyncLogging();
+  SyslogBatcher::GetInstance().Disable();
+  ThreadManager::GetInstance()->ReleaseParkedThreads();
   trusted_application->SetState(EnclaveState::kFinalized);
   return status_serializer.Serialize(status);
 }
 
+int __asylo_user_reset(const char *input, size_t input_len, char **output,
+                       size_t *output_len) {
+  Status status = VerifyOutputArguments(output, output_len);
+  if (!status.ok()) {
+    return 1;
+  }
+
+  StatusSerializer<StatusProto> status_serializer(output, output_len);
+
+  asylo::EnclaveFinal enclave_final;
+  if (!enclave_final.ParseFromArray(input, input_len)) {
+    status = Status(error::GoogleError::INVALID_ARGUMENT,
+                    "Failed to parse EnclaveFinal");
+    return status_serializer.Serialize(status);
+  }
+
+  TrustedApplication *trusted_application = GetApplicationInstance();
+  status = trusted_application->VerifyAndSetState(EnclaveState::kRunning,
+                                                  EnclaveState::kFinalizing);
+  if (!status.ok()) {
+    return status_serializer.Serialize(status);
+  }
+
+  // Invoke the enclave entry-point. The application may be left half reset on
+  // failure, so it is not run again. Parked threads stay in the enclave either
+  // way, and are released when it is finalized.
+  status = trusted_application->Reset(enclave_final);
+  trusted_application->SetState(status.ok() ? EnclaveState::kRunning
+                                            : EnclaveState::kFinalized);
+  return status_serializer.Serialize(status);
+}
+
+int __asylo_get_resource_stats(char **output, size_t *output_len) {
+  Status status = VerifyOutputArguments(output, output_len);
+  if (!status.ok()) {
+    return 1;
+  }
+
+  EnclaveResourceStats stats;
+  enc_heap_usage heap_usage;
+  enc_get_heap_usage(&heap_usage);
+  stats.set_heap_max_bytes(heap_usage.max_size);
+  stats.set_heap_in_use_bytes(heap_usage.in_use);
+  stats.set_heap_peak_in_use_bytes(heap_usage.peak_in_use);
+  stats.set_heap_committed_bytes(heap_usage.committed);
+  stats.set_heap_peak_committed_bytes(heap_usage.peak_committed);
+
+  if (enc_get_malloc_calls) {
+    enc_malloc_class_calls malloc_calls[64];
+    size_t num_classes = enc_get_malloc_calls(
+        malloc_calls, sizeof(malloc_calls) / sizeof(malloc_calls[0]));
+    for (size_t i = 0; i < num_classes; ++i) {
+      MallocSizeClassStats *size_class = stats.add_malloc_size_classes();
+      if (malloc_calls[i].max_size != SIZE_MAX) {
+        size_class->set_max_size(malloc_calls[i].max_size);
+      }
+      size_class->set_calls(malloc_calls[i].calls);
+    }
+  }
+
+  stats.set_untrusted_frees_pending(enc_get_untrusted_frees_pending());
+
+  if (enc_get_frame_protector_usage) {
+    enc_frame_protector_usage protector_usage;
+    enc_get_frame_protector_usage(&protector_usage);
+    stats.set_frame_protectors(protector_usage.protectors);
+    stats.set_idle_frame_protectors(protector_usage.idle_protectors);
+    stats.set_frame_protector_buffer_bytes(protector_usage.buffer_bytes);
+    stats.set_frame_protector_max_buffer_bytes(
+        protector_usage.max_protector_buffer_bytes);
+  }
+
+  int tcs_in_use;
+  int tcs_peak_in_use;
+  enc_get_tcs_usage(&tcs_in_use, &tcs_peak_in_use);
+  stats.set_tcs_in_use(tcs_in_use);
+  stats.set_tcs_peak_in_use(tcs_peak_in_use);
+
+  ThreadManager *thread_manager = ThreadManager::GetInstance();
+  stats.set_parked_threads(thread_manager->GetParkedThreadCount());
+  stats.set_running_threads(thread_manager->GetRunningThreadCount());
+  stats.set_open_file_descriptors(
+      io::IOManager::GetInstance().CountOpenFileDescriptors());
+
+  std::vector<std::pair<int, io::IOStatsSnapshot>> fd_io_stats;
+  std::vector<std::pair<std::string, io::IOStatsSnapshot>> handler_io_stats;
+  io::IOManager::GetInstance().GetIOStats(&fd_io_stats, &handler_io_stats);
+  for (const auto &entry : fd_io_stats) {
+    FileDescriptorIOStats *fd_io = stats.add_file_descriptor_io();
+    fd_io->set_fd(entry.first);
+    CopyIOStats(entry.second, fd_io->mutable_stats());
+  }
+  for (const auto &entry : handler_io_stats) {
+    PathHandlerIOStats *handler_io = stats.add_path_handler_io();
+    handler_io->set_path_prefix(entry.first);
+    CopyIOStats(entry.second, handler_io->mutable_stats());
+  }
+
+  // Serialize to a trusted buffer first, since the host may modify untrusted
+  // memory concurrently.
+  std::string serialized;
+  if (!stats.SerializeToString(&serialized)) {
+    return 1;
+  }
+  *output = reinterpret_cast<char *>(enc_untrusted_malloc(serialized.size()));
+  if (!*output) {
+    return 1;
+  }
+  BoundaryCopyOut(*output, serialized.data(), serialized.size());
+  *output_len = serialized.size();
+  return 0;
+}
+
+int __asylo_user_snapshot(char **output, size_t *output_len) {
+  Status status = VerifyOutputArguments(output, output_len);
+  if (!status.ok()) {
+    return 1;
+  }
+
+  EnclaveSnapshot enclave_snapshot;
+  StatusSerializer<EnclaveSnapshot> status_serializer(
+      &enclave_snapshot, enclave_snapshot.mutable_status(), output,
+      output_len);
+
+  TrustedApplication *trusted_application = GetApplicationInstance();
+  if (trusted_application->GetState() != EnclaveState::kRunning) {
+    status = Status(error::GoogleError::FAILED_PRECONDITION,
+                    "Enclave not in state RUNNING");
+    return status_serializer.Serialize(status);
+  }
+
+  // Invoke the enclave entry-point. The plaintext state never leaves the
+  // enclave, and is cleared once sealed.
+  std::string state;
+  status = trusted_application->Snapshot(&state);
+  if (status.ok()) {
+    status = SealSnapshot(state, enclave_snapshot.mutable_sealed_state());
+  }
+  OPENSSL_cleanse(&state[0], state.size());
+  return status_serializer.Serialize(status);
+}
+
 int __asylo_threading_donate() {
   TrustedApplication *trusted_application = GetApplicationInstance();
   EnclaveState current_state = trusted_application->GetState();
@@ -391,14 +1020,9 @@ int __asylo_handle_signal(const char *input, size_t input_len) {
     ucontext.uc_mcontext.gregs[greg_index] =
         static_cast<greg_t>(signal.gregs(greg_index));
   }
+  // A signal blocked by this thread is held by the SignalManager until the
+  // thread unblocks it.
   SignalManager *signal_manager = SignalManager::GetInstance();
-  const sigset_t mask = signal_manager->GetSignalMask();
-
-  // If the signal is blocked and still passed into the enclave. The signal
-  // masks inside the enclave is out of sync with the untrusted signal mask.
-  if (sigismember(&mask, signum)) {
-    return -1;
-  }
   if (!signal_manager->HandleSignal(signum, &info, &ucontext).ok()) {
     return 1;
   }
@@ -23,6 +23,8 @@
 
 #include <string>
 
+#include <google/protobuf/arena.h>
+#include "asylo/crypto/util/byte_container_view.h"
 #include "asylo/enclave.pb.h"
 #include "asylo/platform/arch/include/trusted/entry_points.h"
 #include "asylo/platform/core/trusted_global_state.h"
@@ -88,7 +90,8 @@ class TrustedApplication {
   };
 
   /// \private
-  Status InitializeInternal(const EnclaveConfig &config);
+  Status InitializeInternal(const EnclaveConfig &config,
+                            EnclaveStartupTiming *timing);
 
   /// Implements enclave initialization entry-point.
   ///
@@ -109,6 +112,41 @@ class TrustedApplication {
     return Status::OkStatus();
   }
 
+  /// Implements the batched enclave execution entry-point.
+  ///
+  /// Runs the inputs passed to a single EnclaveClient::EnterAndRunBatch() call
+  /// in order, so that the cost of entering the enclave and of serializing the
+  /// messages across the boundary is paid once for the whole batch. The
+  /// default implementation calls Run() on each input. Applications override
+  /// it to process the batch together, such as to share work between inputs.
+  ///
+  /// \param inputs Messages passed by the untrusted caller.
+  /// \param outputs Messages passed back to the untrusted caller. An output is
+  ///                added for each input, in order, with the status of running
+  ///                it in its status field.
+  /// \return OK status, or an error if the batch as a whole failed, in which
+  ///         case only the error is returned to the untrusted caller.
+  /// \anchor run-batch
+  virtual Status RunBatch(const EnclaveInputBatch &inputs,
+                          EnclaveOutputBatch *outputs);
+
+  /// Implements the raw enclave execution entry-point.
+  ///
+  /// Unlike Run(), the input and output are opaque bytes which are passed
+  /// across the enclave boundary without any protobuf serialization. This is
+  /// intended for high-rate request loops with small messages. A non-OK status
+  /// is returned to the untrusted caller in the canonical error space.
+  ///
+  /// \param input Bytes passed by the untrusted caller, in trusted memory.
+  /// \param output Bytes passed back to the untrusted caller. It is empty on
+  ///               entry, and keeps its capacity across calls on a thread.
+  /// \return OK status or error
+  /// \anchor run-raw
+  virtual Status RunRaw(ByteContainerView input, std::string *output) {
+    return Status(error::GoogleError::UNIMPLEMENTED,
+                  "RunRaw is not implemented by this enclave");
+  }
+
   /// Implements enclave finalization behavior.
   ///
   /// \param final_input Message passed on enclave finalization.
@@ -118,6 +156,50 @@ class TrustedApplication {
     return Status::OkStatus();
   }
 
+  /// Implements enclave reset behavior.
+  ///
+  /// Clears the application state so that the enclave can be reused as if it
+  /// had just been loaded, without reloading its pages. The Asylo runtime
+  /// state set up at initialization is kept. The default implementation calls
+  /// Finalize() and then Initialize() with the configuration the enclave was
+  /// initialized with. If reset fails, the enclave can only be destroyed.
+  ///
+  /// \param final_input Message passed on enclave reset.
+  /// \return OK status or error
+  /// \anchor reset
+  virtual Status Reset(const EnclaveFinal &final_input);
+
+  /// Implements the enclave snapshot entry-point.
+  ///
+  /// Serializes the application state built by Initialize(), such as loaded
+  /// models and primed caches, so that new instances of the enclave can be
+  /// restored from it with Restore() instead of being initialized. The runtime
+  /// seals `state` to the MRENCLAVE of the enclave before it leaves the
+  /// enclave. Called on a running enclave, concurrently with Run().
+  ///
+  /// \param[out] state The serialized application state.
+  /// \return OK status or error
+  /// \anchor snapshot
+  virtual Status Snapshot(std::string *state) {
+    return Status(error::GoogleError::UNIMPLEMENTED,
+                  "Snapshot is not implemented by this enclave");
+  }
+
+  /// Implements enclave restoration.
+  ///
+  /// Called instead of Initialize() when the enclave is initialized with
+  /// EnclaveConfig.snapshot set, once the runtime is initialized from `config`
+  /// and the snapshot is unsealed.
+  ///
+  /// \param config The configuration used to initialize the enclave.
+  /// \param state The application state serialized by Snapshot().
+  /// \return An OK status or an error if the enclave could not be restored.
+  /// \anchor restore
+  virtual Status Restore(const EnclaveConfig &config, ByteContainerView state) {
+    return Status(error::GoogleError::UNIMPLEMENTED,
+                  "Restore is not implemented by this enclave");
+  }
+
   /// Trivial destructor.
   ///
   /// Trivial destructor. Note that classes derived from of TrustedApplication
@@ -147,6 +229,19 @@ class TrustedApplication {
                                size_t *output_len);
   friend int __asylo_user_run(const char *input, size_t input_len,
                               char **output, size_t *output_len);
+  friend int __asylo_user_run_batch(const char *input, size_t input_len,
+                                    char **output, size_t *output_len);
+  friend int __asylo_user_run_with_buffers(const char *input,
+                                           size_t input_len,
+                                           char *output_buffer,
+                                           size_t output_capacity,
+                                           char **output, size_t *output_len);
+  friend int __asylo_user_run_raw(const char *input, size_t input_len,
+                                  char *output_buffer, size_t output_capacity,
+                                  char **output, size_t *output_len,
+                                  int *status_code);
+  friend int __asylo_user_reset(const char *input, size_t input_len,
+                                 char **output, size_t *output_len);
   friend int __asylo_user_fini(const char *input, size_t input_len,
                                char **output, size_t *output_len);
   friend int __asylo_threading_donate();
@@ -165,6 +260,22 @@ TrustedApplication *BuildTrustedApplication();
 /// \relates TrustedApplication
 TrustedApplication *GetApplicationInstance();
 
+/// Returns the arena of the Run() or RunBatch() call in progress on the
+/// calling thread, or nullptr outside of one.
+///
+/// The input and output messages of the call are allocated on the arena.
+/// Application code may also allocate on it the messages and arrays that it
+/// needs only until the call returns, with
+/// `google::protobuf::Arena::CreateMessage()` and
+/// `google::protobuf::Arena::CreateArray()`. The arena starts in a block
+/// that each thread keeps across calls, so a call whose allocations fit in the
+/// block does not use the enclave's allocator for them, and all of them are
+/// released at once when the call returns.
+///
+/// \return The arena of the current call, or nullptr.
+/// \relates TrustedApplication
+google::protobuf::Arena *GetRequestArena();
+
 }  // namespace asylo
 
 #endif  // ASYLO_PLATFORM_CORE_TRUSTED_APPLICATION_H_
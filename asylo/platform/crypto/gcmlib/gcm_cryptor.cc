@@ -24,10 +24,13 @@
 #include <openssl/evp.h>
 #include <openssl/mem.h>
 #include <openssl/rand.h>
+#include <algorithm>
+#include <array>
 #include <cstdlib>
 #include <cstring>
 #include <ctime>
 
+#include "absl/base/attributes.h"
 #include "absl/memory/memory.h"
 #include "absl/synchronization/mutex.h"
 #include "asylo/crypto/util/bssl_util.h"
@@ -53,6 +56,10 @@ constexpr uint8_t kCmacDerivationConstant[kKeyIdLength] = {
     0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
     0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
     0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00};
+constexpr uint8_t kGmacDerivationConstant[kKeyIdLength] = {
+    0x00, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00};
 
 bool GenerateDerivedKey(const GcmCryptorKey &wrapping_key,
                         const uint8_t *key_id, GcmCryptorKey *dk) {
@@ -85,17 +92,136 @@ bool GenerateDerivedKey(const GcmCryptorKey &wrapping_key,
   return true;
 }
 
+// Initializes |context| for AES-GCM with the key derived from |gcm_key| and
+// |key_id|.
+bool InitDerivedKeyContext(const GcmCryptorKey &gcm_key, const uint8_t *key_id,
+                           EVP_AEAD_CTX *context) {
+  GcmCryptorKey derived_key;
+  if (!GenerateDerivedKey(gcm_key, key_id, &derived_key)) {
+    LOG(ERROR) << "Failed to derive key for GCM: " << BsslLastErrorString();
+    return false;
+  }
+
+  if (!EVP_AEAD_CTX_init(context, EVP_aead_aes_256_gcm(),
+                         reinterpret_cast<const uint8_t *>(derived_key.data()),
+                         kKeyLength, kTagLength, nullptr)) {
+    LOG(ERROR) << "EVP_AEAD_CTX_init failed: " << BsslLastErrorString();
+    EVP_AEAD_CTX_cleanup(context);
+    return false;
+  }
+
+  return true;
+}
+
+// Source of GcmCryptor instance ids.
+std::atomic<uint64_t> next_instance_id(1);
+
+// Number of decryption contexts each thread keeps per cryptor. Reads that
+// interleave blocks written under a few key ids, such as blocks of a file
+// written by several threads, find all of their contexts here.
+constexpr size_t kDecryptContextCount = 4;
+
+// An initialized decryption context for the derived key of |key_id|. |last_use|
+// orders the contexts of a thread by recency of use, zero marking an unused
+// entry.
+struct DecryptContext {
+  uint8_t key_id[kKeyIdLength];
+  uint64_t last_use;
+  EVP_AEAD_CTX context;
+};
+
+// State of a GcmCryptor private to one thread: the key id and context used for
+// encryption, with the number of blocks encrypted under it, and the contexts
+// of the key ids decrypted most recently.
+struct ThreadCryptorState {
+  uint64_t instance_id;
+  uint8_t encrypt_key_id[kKeyIdLength];
+  size_t encrypt_key_uses;
+  bool has_encrypt_context;
+  EVP_AEAD_CTX encrypt_context;
+  uint64_t decrypt_uses;
+  DecryptContext decrypt_contexts[kDecryptContextCount];
+};
+
+// Number of cryptors whose state each thread keeps. Threads rarely use more
+// than a few cryptors at a time, one per key and block length.
+constexpr size_t kThreadCryptorStateCount = 16;
+
+using ThreadCryptorStates =
+    std::array<ThreadCryptorState, kThreadCryptorStateCount>;
+
+ABSL_CONST_INIT thread_local ThreadCryptorStates *thread_cryptor_states =
+    nullptr;
+
+// Returns the current thread's state of the cryptor with |instance_id|,
+// replacing the state of another cryptor in the same slot if needed.
+ThreadCryptorState *GetThreadCryptorState(uint64_t instance_id) {
+  if (!thread_cryptor_states) {
+    thread_cryptor_states = new ThreadCryptorStates();
+  }
+
+  ThreadCryptorState *state =
+      &(*thread_cryptor_states)[instance_id % kThreadCryptorStateCount];
+  if (state->instance_id != instance_id) {
+    if (state->has_encrypt_context) {
+      EVP_AEAD_CTX_cleanup(&state->encrypt_context);
+    }
+    for (DecryptContext &entry : state->decrypt_contexts) {
+      if (entry.last_use != 0) {
+        EVP_AEAD_CTX_cleanup(&entry.context);
+        entry.last_use = 0;
+      }
+    }
+    state->instance_id = instance_id;
+    state->encrypt_key_uses = 0;
+    state->has_encrypt_context = false;
+    state->decrypt_uses = 0;
+  }
+  return state;
+}
+
+// Returns the current thread's decryption context for |key_id| in |state|,
+// initializing it with the key derived from |gcm_key| in place of the least
+// recently used context if there is none. Returns nullptr on failure.
+EVP_AEAD_CTX *GetDecryptContext(ThreadCryptorState *state,
+                                const GcmCryptorKey &gcm_key,
+                                const uint8_t *key_id) {
+  DecryptContext *victim = &state->decrypt_contexts[0];
+  for (DecryptContext &entry : state->decrypt_contexts) {
+    if (entry.last_use != 0 &&
+        memcmp(entry.key_id, key_id, kKeyIdLength) == 0) {
+      entry.last_use = ++state->decrypt_uses;
+      return &entry.context;
+    }
+    if (entry.last_use < victim->last_use) {
+      victim = &entry;
+    }
+  }
+
+  if (victim->last_use != 0) {
+    EVP_AEAD_CTX_cleanup(&victim->context);
+    victim->last_use = 0;
+  }
+  if (!InitDerivedKeyContext(gcm_key, key_id, &victim->context)) {
+    return nullptr;
+  }
+  memcpy(victim->key_id, key_id, kKeyIdLength);
+  victim->last_use = ++state->decrypt_uses;
+  return &victim->context;
+}
+
 }  // namespace
 
 GcmCryptor::GcmCryptor(size_t block_length, const GcmCryptorKey &gcm_key,
-                       const GcmCryptorKey &cmac_key)
+                       const GcmCryptorKey &cmac_key, bool integrity_only)
     : kBlockLength(block_length),
+      kIntegrityOnly(integrity_only),
       kGcmKey(gcm_key),
       kCmacKey(cmac_key),
-      key_id_counter_(0) {}
+      instance_id_(next_instance_id.fetch_add(1, std::memory_order_relaxed)) {}
 
 std::unique_ptr<GcmCryptor> GcmCryptor::Create(
-    size_t block_length, const GcmCryptorKey &master_key) {
+    size_t block_length, const GcmCryptorKey &master_key, bool integrity_only) {
   if (block_length == 0) {
     return nullptr;
   }
@@ -126,8 +252,13 @@ std::unique_ptr<GcmCryptor> GcmCryptor::Create(
     return nullptr;
   }
 
+  // Tags of integrity-only blocks are computed under a separate key, so that
+  // they never verify as blocks encrypted under the same master key.
   GcmCryptorKey gcm_key;
-  if (!GenerateDerivedKey(master_key, kGcmDerivationConstant, &gcm_key)) {
+  if (!GenerateDerivedKey(master_key,
+                          integrity_only ? kGmacDerivationConstant
+                                         : kGcmDerivationConstant,
+                          &gcm_key)) {
     LOG(ERROR) << "Failed to derive key for GCM: " << BsslLastErrorString();
     return nullptr;
   }
@@ -138,134 +269,210 @@ std::unique_ptr<GcmCryptor> GcmCryptor::Create(
     return nullptr;
   }
 
-  GcmCryptor *gcm_cryptor = new GcmCryptor(block_length, gcm_key, cmac_key);
+  GcmCryptor *gcm_cryptor =
+      new GcmCryptor(block_length, gcm_key, cmac_key, integrity_only);
   return absl::WrapUnique(gcm_cryptor);
 }
 
 bool GcmCryptor::EncryptBlock(const uint8_t *plaintext_data, uint8_t *token,
                               uint8_t *ciphertext_data) {
-  if (plaintext_data == nullptr || token == nullptr ||
-      ciphertext_data == nullptr) {
-    LOG(ERROR) << "Invalid input to GcmCryptor::EncryptBlock.";
-    return false;
-  }
+  return EncryptBlocks(1, &plaintext_data, &token, &ciphertext_data);
+}
 
-  absl::MutexLock lock(&mu_);
+bool GcmCryptor::DecryptBlock(const uint8_t *ciphertext_data,
+                              const uint8_t *token, uint8_t *plaintext_data) {
+  return DecryptBlocks(1, &ciphertext_data, &token, &plaintext_data);
+}
 
-  if (1 != RAND_bytes(next_token_.nonce, kNonceLength)) {
-    LOG(ERROR)
-        << "Failed to generate random nonce for GcmCryptor::EncryptBlock: "
-        << BsslLastErrorString();
+bool GcmCryptor::EncryptBlocks(size_t count,
+                               const uint8_t *const plaintext_data[],
+                               uint8_t *const tokens[],
+                               uint8_t *const ciphertext_data[]) {
+  if (plaintext_data == nullptr || tokens == nullptr ||
+      ciphertext_data == nullptr) {
+    LOG(ERROR) << "Invalid input to GcmCryptor::EncryptBlocks.";
     return false;
   }
-
-  if (key_id_counter_ % kKeyIdCycle == 0) {
-    key_id_counter_ = 0;
-
-    if (1 != RAND_bytes(next_token_.key_id, kKeyIdLength)) {
-      LOG(ERROR)
-          << "Failed to generate random token for GcmCryptor::EncryptBlock: "
-          << BsslLastErrorString();
+  for (size_t i = 0; i < count; ++i) {
+    if (plaintext_data[i] == nullptr || tokens[i] == nullptr ||
+        ciphertext_data[i] == nullptr) {
+      LOG(ERROR) << "Invalid input to GcmCryptor::EncryptBlocks.";
       return false;
     }
+  }
 
-    if (!GenerateDerivedGcmKey(next_token_.key_id, &next_derived_key_)) {
-      LOG(ERROR) << "Failed to derive key for GcmCryptor::EncryptBlock: "
+  // The key id changes every kKeyIdCycle blocks encrypted by the thread, and
+  // the context for the derived key serves every block encrypted under it.
+  ThreadCryptorState *state = GetThreadCryptorState(instance_id_);
+  for (size_t i = 0; i < count; ++i) {
+    if (!state->has_encrypt_context ||
+        state->encrypt_key_uses == kKeyIdCycle) {
+      if (state->has_encrypt_context) {
+        EVP_AEAD_CTX_cleanup(&state->encrypt_context);
+        state->has_encrypt_context = false;
+      }
+
+      if (1 != RAND_bytes(state->encrypt_key_id, kKeyIdLength)) {
+        LOG(ERROR) << "Failed to generate random token for "
+                      "GcmCryptor::EncryptBlocks: "
+                   << BsslLastErrorString();
+        return false;
+      }
+
+      if (!InitDerivedKeyContext(kGcmKey, state->encrypt_key_id,
+                                 &state->encrypt_context)) {
+        LOG(ERROR) << "Failed to derive key for GcmCryptor::EncryptBlocks.";
+        return false;
+      }
+      state->encrypt_key_uses = 0;
+      state->has_encrypt_context = true;
+    }
+
+    Token block_token;
+    if (1 != RAND_bytes(block_token.nonce, kNonceLength)) {
+      LOG(ERROR) << "Failed to generate random nonce for "
+                    "GcmCryptor::EncryptBlocks: "
                  << BsslLastErrorString();
       return false;
     }
-  }
-
-  // Increment the key reuse counter only if the key was successfully generated.
-  key_id_counter_++;
+    memcpy(block_token.key_id, state->encrypt_key_id, kKeyIdLength);
+
+    // Advance the key reuse counter before sealing, so that a key id is never
+    // used for more than kKeyIdCycle blocks, even if sealing fails.
+    state->encrypt_key_uses++;
+
+    if (kIntegrityOnly) {
+      // The tag is computed before the plaintext is moved, since the
+      // plaintext may overlap the tag of the output.
+      uint8_t tag[kTagLength];
+      if (!AuthenticateBlock(&state->encrypt_context, block_token.nonce,
+                             plaintext_data[i], tag, /*verify=*/false)) {
+        return false;
+      }
+      if (ciphertext_data[i] != plaintext_data[i]) {
+        memmove(ciphertext_data[i], plaintext_data[i], kBlockLength);
+      }
+      memcpy(ciphertext_data[i] + kBlockLength, tag, kTagLength);
+      memcpy(tokens[i], block_token.data(), kTokenLength);
+      continue;
+    }
 
-  EVP_AEAD_CTX context;
-  if (!EVP_AEAD_CTX_init(
-          &context, EVP_aead_aes_256_gcm(),
-          reinterpret_cast<const uint8_t *>(next_derived_key_.data()),
-          kKeyLength, kTagLength, nullptr)) {
-    LOG(ERROR) << "EVP_AEAD_CTX_init failed: " << BsslLastErrorString();
-    EVP_AEAD_CTX_cleanup(&context);
-    return false;
-  }
+    size_t ciphertext_length;
+    size_t max_ciphertext_length = kBlockLength + kTagLength;
+    if (!EVP_AEAD_CTX_seal(&state->encrypt_context, ciphertext_data[i],
+                           &ciphertext_length, max_ciphertext_length,
+                           block_token.nonce, kNonceLength, plaintext_data[i],
+                           kBlockLength, nullptr, 0)) {
+      LOG(ERROR) << "EVP_AEAD_CTX_seal failed: " << BsslLastErrorString();
+      return false;
+    }
 
-  size_t ciphertext_length;
-  size_t max_ciphertext_length = kBlockLength + kTagLength;
-  if (!EVP_AEAD_CTX_seal(&context, ciphertext_data, &ciphertext_length,
-                         max_ciphertext_length, next_token_.nonce, kNonceLength,
-                         plaintext_data, kBlockLength, nullptr, 0)) {
-    LOG(ERROR) << "EVP_AEAD_CTX_seal failed: " << BsslLastErrorString();
-    EVP_AEAD_CTX_cleanup(&context);
-    return false;
-  }
+    if (ciphertext_length != max_ciphertext_length) {
+      LOG(ERROR) << "EVP_AEAD_CTX_seal failed to encrypt complete plaintext, "
+                 << "expected ciphertext_length = " << max_ciphertext_length
+                 << ", encountered ciphertext_length = " << ciphertext_length;
+      return false;
+    }
 
-  if (ciphertext_length != max_ciphertext_length) {
-    LOG(ERROR) << "EVP_AEAD_CTX_seal failed to encrypt complete plaintext, "
-               << "expected ciphertext_length = " << max_ciphertext_length
-               << ", encountered ciphertext_length = " << ciphertext_length;
-    EVP_AEAD_CTX_cleanup(&context);
-    return false;
+    memcpy(tokens[i], block_token.data(), kTokenLength);
   }
 
-  memcpy(token, next_token_.data(), kTokenLength);
-
-  EVP_AEAD_CTX_cleanup(&context);
   return true;
 }
 
-bool GcmCryptor::DecryptBlock(const uint8_t *ciphertext_data,
-                              const uint8_t *token, uint8_t *plaintext_data) {
-  if (ciphertext_data == nullptr || token == nullptr ||
+bool GcmCryptor::DecryptBlocks(size_t count,
+                               const uint8_t *const ciphertext_data[],
+                               const uint8_t *const tokens[],
+                               uint8_t *const plaintext_data[]) {
+  if (ciphertext_data == nullptr || tokens == nullptr ||
       plaintext_data == nullptr) {
-    LOG(ERROR) << "Invalid input to GcmCryptor::DecryptBlock.";
+    LOG(ERROR) << "Invalid input to GcmCryptor::DecryptBlocks.";
     return false;
   }
+  for (size_t i = 0; i < count; ++i) {
+    if (ciphertext_data[i] == nullptr || tokens[i] == nullptr ||
+        plaintext_data[i] == nullptr) {
+      LOG(ERROR) << "Invalid input to GcmCryptor::DecryptBlocks.";
+      return false;
+    }
+  }
 
-  const Token *tok = reinterpret_cast<const Token *>(token);
+  // Blocks usually share a key id with a block decrypted shortly before, in
+  // which case the derived key and the context are set up once for all of
+  // them, and kept for later calls by the thread. The key id is copied, as
+  // decryption may overwrite earlier tokens when done in place.
+  ThreadCryptorState *state = GetThreadCryptorState(instance_id_);
+  EVP_AEAD_CTX *context = nullptr;
+  uint8_t context_key_id[kKeyIdLength];
+  for (size_t i = 0; i < count; ++i) {
+    const Token *tok = reinterpret_cast<const Token *>(tokens[i]);
+
+    if (!context || memcmp(context_key_id, tok->key_id, kKeyIdLength) != 0) {
+      context = GetDecryptContext(state, kGcmKey, tok->key_id);
+      if (!context) {
+        LOG(ERROR) << "Failed to derive key for GcmCryptor::DecryptBlocks.";
+        return false;
+      }
+      memcpy(context_key_id, tok->key_id, kKeyIdLength);
+    }
 
-  GcmCryptorKey derived_key;
-  if (!GenerateDerivedGcmKey(tok->key_id, &derived_key)) {
-    LOG(ERROR) << "Failed to derive key for GcmCryptor::DecryptBlock: "
-               << BsslLastErrorString();
-    return false;
-  }
+    if (kIntegrityOnly) {
+      uint8_t tag[kTagLength];
+      memcpy(tag, ciphertext_data[i] + kBlockLength, kTagLength);
+      if (!AuthenticateBlock(context, tok->nonce, ciphertext_data[i], tag,
+                             /*verify=*/true)) {
+        return false;
+      }
+      if (plaintext_data[i] != ciphertext_data[i]) {
+        memmove(plaintext_data[i], ciphertext_data[i], kBlockLength);
+      }
+      continue;
+    }
 
-  EVP_AEAD_CTX context;
-  if (!EVP_AEAD_CTX_init(&context, EVP_aead_aes_256_gcm(),
-                         reinterpret_cast<const uint8_t *>(derived_key.data()),
-                         kKeyLength, kTagLength, nullptr)) {
-    LOG(ERROR) << "EVP_AEAD_CTX_init failed: " << BsslLastErrorString();
-    EVP_AEAD_CTX_cleanup(&context);
-    return false;
+    size_t plaintext_length;
+    if (!EVP_AEAD_CTX_open(context, plaintext_data[i], &plaintext_length,
+                           kBlockLength, tok->nonce, kNonceLength,
+                           ciphertext_data[i], kBlockLength + kTagLength,
+                           nullptr, 0)) {
+      LOG(ERROR) << "EVP_AEAD_CTX_open failed: " << BsslLastErrorString();
+      return false;
+    }
+
+    if (plaintext_length != kBlockLength) {
+      LOG(ERROR) << "EVP_AEAD_CTX_open failed to decrypt complete ciphertext, "
+                 << "expected plaintext_length = " << kBlockLength
+                 << ", encountered plaintext_length = " << plaintext_length;
+      return false;
+    }
   }
 
-  size_t plaintext_length;
-  if (!EVP_AEAD_CTX_open(&context, plaintext_data, &plaintext_length,
-                         kBlockLength, tok->nonce, kNonceLength,
-                         ciphertext_data, kBlockLength + kTagLength, nullptr,
-                         0)) {
-    LOG(ERROR) << "EVP_AEAD_CTX_open failed: " << BsslLastErrorString();
-    EVP_AEAD_CTX_cleanup(&context);
-    return false;
+  return true;
+}
+
+bool GcmCryptor::AuthenticateBlock(const EVP_AEAD_CTX *context,
+                                   const uint8_t *nonce,
+                                   const uint8_t *plaintext, uint8_t *tag,
+                                   bool verify) const {
+  size_t length;
+  if (verify) {
+    uint8_t unused;
+    if (!EVP_AEAD_CTX_open(context, &unused, &length, 0, nonce, kNonceLength,
+                           tag, kTagLength, plaintext, kBlockLength)) {
+      LOG(ERROR) << "EVP_AEAD_CTX_open failed: " << BsslLastErrorString();
+      return false;
+    }
+    return true;
   }
 
-  if (plaintext_length != kBlockLength) {
-    LOG(ERROR) << "EVP_AEAD_CTX_open failed to decrypt complete ciphertext, "
-               << "expected plaintext_length = " << kBlockLength
-               << ", encountered plaintext_length = " << plaintext_length;
-    EVP_AEAD_CTX_cleanup(&context);
+  if (!EVP_AEAD_CTX_seal(context, tag, &length, kTagLength, nonce,
+                         kNonceLength, nullptr, 0, plaintext, kBlockLength) ||
+      length != kTagLength) {
+    LOG(ERROR) << "EVP_AEAD_CTX_seal failed: " << BsslLastErrorString();
     return false;
   }
-
-  EVP_AEAD_CTX_cleanup(&context);
   return true;
 }
 
-bool GcmCryptor::GenerateDerivedGcmKey(const uint8_t *key_id,
-                                       GcmCryptorKey *dk) {
-  return GenerateDerivedKey(kGcmKey, key_id, dk);
-}
-
 bool GcmCryptor::GetAuthTag(uint8_t out[16], const uint8_t *in,
                             size_t in_len) const {
   if (1 != AES_CMAC(out, reinterpret_cast<const uint8_t *>(kCmacKey.data()),
@@ -282,19 +489,57 @@ bool GcmCryptor::GetAuthTag(uint8_t out[16], const uint8_t *in,
 // timescale - the expectation is that over the lifetime of the program the
 // number of utilized keys is substantially limited, and notable accumulation of
 // unused keys is unlikely, or limited by the client application. I.e., memory
-// utilization in enclave is not guarded at the level of this library.
+// utilization in enclave is not guarded at the level of this library. The same
+// holds for the snapshots of the registry, one of which is published per key.
 GcmCryptor *GcmCryptorRegistry::GetGcmCryptor(size_t block_length,
-                                              const GcmCryptorKey &key) {
+                                              const GcmCryptorKey &key,
+                                              bool integrity_only) {
+  GcmCryptor *cryptor = Find(snapshot_.load(std::memory_order_acquire),
+                             block_length, key, integrity_only);
+  if (cryptor) {
+    return cryptor;
+  }
+
   absl::MutexLock lock(&mu_);
 
-  auto it = cryptor_registry_.find(key);
-  if (it != cryptor_registry_.end()) {
-    return it->second.get();
+  // Another thread may have registered the key since the snapshot was read.
+  const Snapshot *snapshot = snapshot_.load(std::memory_order_relaxed);
+  cryptor = Find(snapshot, block_length, key, integrity_only);
+  if (cryptor) {
+    return cryptor;
+  }
+
+  std::unique_ptr<GcmCryptor> new_cryptor =
+      GcmCryptor::Create(block_length, key, integrity_only);
+  if (!new_cryptor) {
+    return nullptr;
+  }
+  cryptor = new_cryptor.get();
+  cryptors_.push_back(std::move(new_cryptor));
+
+  auto next_snapshot = snapshot ? absl::make_unique<Snapshot>(*snapshot)
+                                : absl::make_unique<Snapshot>();
+  (*next_snapshot)[{block_length, integrity_only}].emplace(key, cryptor);
+  snapshot_.store(next_snapshot.get(), std::memory_order_release);
+  snapshots_.push_back(std::move(next_snapshot));
+  return cryptor;
+}
+
+GcmCryptor *GcmCryptorRegistry::Find(const Snapshot *snapshot,
+                                     size_t block_length,
+                                     const GcmCryptorKey &key,
+                                     bool integrity_only) {
+  if (!snapshot) {
+    return nullptr;
+  }
+
+  auto cryptors = snapshot->find({block_length, integrity_only});
+  if (cryptors == snapshot->end()) {
+    return nullptr;
   }
 
-  auto result =
-      cryptor_registry_.emplace(key, GcmCryptor::Create(block_length, key));
-  return result.first->second.get();
+  auto it = cryptors->second.find(key);
+  return it != cryptors->second.end() ? it->second : nullptr;
 }
 
 }  // namespace gcmlib
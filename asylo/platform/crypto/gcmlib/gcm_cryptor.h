@@ -20,9 +20,13 @@
 #define ASYLO_PLATFORM_CRYPTO_GCMLIB_GCM_CRYPTOR_H_
 
 #include <openssl/evp.h>
+#include <atomic>
+#include <cstdint>
+#include <map>
 #include <memory>
 #include <string>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
 #include "absl/synchronization/mutex.h"
@@ -48,25 +52,59 @@ constexpr size_t kKeyIdLength = 32;
 using GcmCryptorKey = SafeBytes<kKeyLength>;
 
 // GcmCryptor implements AES-GCM encryption and decryption.
+//
+// An integrity-only cryptor authenticates blocks without encrypting them. The
+// "ciphertext" of a block is its plaintext followed by the AES-GMAC tag of the
+// plaintext, computed as the AES-GCM tag of an empty message with the
+// plaintext as associated data, under a key separate from that of encryption.
+// Blocks and tokens have the same layout in both modes, and decryption only
+// verifies the tag and copies the plaintext, or nothing when done in place.
+//
+// A cryptor is immutable once created. Each thread encrypts with its own key
+// id and AEAD context, and keeps the contexts of the few key ids it decrypted
+// most recently, so threads using the same cryptor do not contend and key
+// derivations are reused across calls.
 class GcmCryptor {
  public:
-  // Initializes the cryptor with the specified 32 byte key.
+  // Initializes the cryptor with the specified 32 byte key. The cryptor only
+  // authenticates blocks if |integrity_only| is true.
   static std::unique_ptr<GcmCryptor> Create(size_t block_length,
-                                            const GcmCryptorKey &master_key);
+                                            const GcmCryptorKey &master_key,
+                                            bool integrity_only = false);
   virtual ~GcmCryptor() = default;
 
   // Encrypts the input plaintext block with an auto-generated token. No
   // associated data is used. Returns true on success, with the encrypted
-  // ciphertext and the generated token supplied. Returns false otherwise.
+  // ciphertext and the generated token supplied. Returns false otherwise. May
+  // be called concurrently from several threads.
   bool EncryptBlock(const uint8_t *plaintext_data, uint8_t *token,
                     uint8_t *ciphertext_data);
 
   // Decrypts the input ciphertext block using the specified token generated at
   // the encryption time. Returns true on success, with the decrypted plaintext
-  // supplied. Returns false otherwise.
+  // supplied. Returns false otherwise. May be called concurrently from several
+  // threads.
   bool DecryptBlock(const uint8_t *ciphertext_data, const uint8_t *token,
                     uint8_t *plaintext_data);
 
+  // Encrypts |count| independent plaintext blocks, each with its own
+  // auto-generated token, in the same way as |count| calls to EncryptBlock.
+  // Blocks sharing a derived key are encrypted with a single AEAD context, so
+  // the per-block setup cost is amortized over the batch. Returns true on
+  // success, false otherwise. May be called concurrently from several threads.
+  bool EncryptBlocks(size_t count, const uint8_t *const plaintext_data[],
+                     uint8_t *const tokens[],
+                     uint8_t *const ciphertext_data[]);
+
+  // Decrypts |count| independent ciphertext blocks in the same way as |count|
+  // calls to DecryptBlock. The key derivation and AEAD context are reused
+  // across blocks whose tokens share a key id. Returns true if all
+  // blocks were decrypted and authenticated, false otherwise. May be called
+  // concurrently from several threads.
+  bool DecryptBlocks(size_t count, const uint8_t *const ciphertext_data[],
+                     const uint8_t *const tokens[],
+                     uint8_t *const plaintext_data[]);
+
   // Generates auth tag, in particular CMAC, for the specified data. Returns
   // true on success, false on failure.
   bool GetAuthTag(uint8_t out[16], const uint8_t *in, size_t in_len) const;
@@ -84,23 +122,33 @@ class GcmCryptor {
   };
 
   GcmCryptor(size_t block_length, const GcmCryptorKey &gcm_key,
-             const GcmCryptorKey &cmac_key);
-  bool GenerateDerivedGcmKey(const uint8_t *key_id, GcmCryptorKey *dk);
+             const GcmCryptorKey &cmac_key, bool integrity_only);
+
+  // Computes the tag of |plaintext| with |context| and |nonce| into |tag|, or
+  // verifies |tag| against it if |verify| is true, for integrity-only
+  // cryptors. Returns false on failure.
+  bool AuthenticateBlock(const EVP_AEAD_CTX *context, const uint8_t *nonce,
+                         const uint8_t *plaintext, uint8_t *tag,
+                         bool verify) const;
 
   const size_t kBlockLength;
+  const bool kIntegrityOnly;
   const GcmCryptorKey kGcmKey;
   const GcmCryptorKey kCmacKey;
-  Token next_token_ GUARDED_BY(mu_);
-  uint64_t key_id_counter_;
-  GcmCryptorKey next_derived_key_ GUARDED_BY(mu_);
-  absl::Mutex mu_;
+
+  // Identifies the per-thread state of this cryptor. Never reused by another
+  // instance, so that state left behind when a cryptor is destroyed cannot be
+  // picked up by a cryptor with a different key.
+  const uint64_t instance_id_;
 
   GcmCryptor(const GcmCryptor &) = delete;
   GcmCryptor &operator=(const GcmCryptor &) = delete;
 };
 
 // Singleton class represents a registry of keys used by the enclave mapped to
-// associated instances of GCM cryptors.
+// associated instances of GCM cryptors. Lookups of registered keys read an
+// immutable snapshot of the registry without taking a lock; registering a key
+// publishes a new snapshot.
 class GcmCryptorRegistry {
  public:
   static GcmCryptorRegistry &GetInstance() {
@@ -108,9 +156,11 @@ class GcmCryptorRegistry {
     return *instance;
   }
 
-  // Accessor to the instance of GCM cryptor associated with a given key.
-  GcmCryptor *GetGcmCryptor(size_t block_length, const GcmCryptorKey &key)
-      LOCKS_EXCLUDED(mu_);
+  // Accessor to the instance of GCM cryptor associated with a given block
+  // length, key and mode, see GcmCryptor::Create. Returns nullptr if the
+  // cryptor cannot be created.
+  GcmCryptor *GetGcmCryptor(size_t block_length, const GcmCryptorKey &key,
+                            bool integrity_only = false) LOCKS_EXCLUDED(mu_);
 
   class SafeBytesHasher {
    public:
@@ -131,12 +181,27 @@ class GcmCryptorRegistry {
   };
 
  private:
-  GcmCryptorRegistry() = default;
+  // Registered cryptors keyed on block length and mode, then on key.
+  using KeyMap =
+      std::unordered_map<GcmCryptorKey, GcmCryptor *, SafeBytesHasher>;
+  using Snapshot = std::map<std::pair<size_t, bool>, KeyMap>;
+
+  GcmCryptorRegistry() : snapshot_(nullptr) {}
   GcmCryptorRegistry(GcmCryptorRegistry const &) = delete;
   void operator=(GcmCryptorRegistry const &) = delete;
-  std::unordered_map<GcmCryptorKey, std::unique_ptr<GcmCryptor>,
-                     SafeBytesHasher>
-      cryptor_registry_ GUARDED_BY(mu_);
+
+  // Returns the cryptor for |block_length|, |key| and |integrity_only| in
+  // |snapshot|, or nullptr if there is none.
+  static GcmCryptor *Find(const Snapshot *snapshot, size_t block_length,
+                          const GcmCryptorKey &key, bool integrity_only);
+
+  // The current snapshot, or nullptr if no key is registered.
+  std::atomic<const Snapshot *> snapshot_;
+
+  // Owners of the cryptors and of every snapshot published, since lookups may
+  // still be reading earlier snapshots.
+  std::vector<std::unique_ptr<GcmCryptor>> cryptors_ GUARDED_BY(mu_);
+  std::vector<std::unique_ptr<Snapshot>> snapshots_ GUARDED_BY(mu_);
   absl::Mutex mu_;
 };
 
@@ -20,6 +20,9 @@
 
 #include <openssl/rand.h>
 
+#include <thread>
+#include <vector>
+
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 #include "asylo/crypto/util/bytes.h"
@@ -195,6 +198,144 @@ TEST(GcmCryptorTest, DecryptWithAlteredCiphertextFails) {
       decryptor->DecryptBlock(encryptor_buffer, token, decryptor_buffer));
 }
 
+// Tests batched encryption and decryption across several derived keys.
+TEST(GcmCryptorTest, DecryptBlocksAfterEncryptBlocksReturnsOriginalTexts) {
+  constexpr size_t kNumBlocks = 2 * kKeyIdCycle + 10;
+  constexpr size_t kCipherLength = kBlockLength + kTagLength;
+  std::vector<uint8_t> plaintext(kNumBlocks * kBlockLength);
+  std::vector<uint8_t> ciphertext(kNumBlocks * kCipherLength);
+  std::vector<uint8_t> tokens(kNumBlocks * kTokenLength);
+  std::vector<uint8_t> decrypted(kNumBlocks * kBlockLength);
+  ASSERT_EQ(RAND_bytes(plaintext.data(), plaintext.size()), 1);
+
+  std::vector<const uint8_t*> plaintext_blocks;
+  std::vector<uint8_t*> ciphertext_blocks;
+  std::vector<uint8_t*> token_blocks;
+  std::vector<uint8_t*> decrypted_blocks;
+  for (size_t i = 0; i < kNumBlocks; ++i) {
+    plaintext_blocks.push_back(plaintext.data() + i * kBlockLength);
+    ciphertext_blocks.push_back(ciphertext.data() + i * kCipherLength);
+    token_blocks.push_back(tokens.data() + i * kTokenLength);
+    decrypted_blocks.push_back(decrypted.data() + i * kBlockLength);
+  }
+
+  GcmCryptorKey key;
+  ASSERT_EQ(RAND_bytes(key.data(), key.size()), 1);
+  auto encryptor = GcmCryptor::Create(kBlockLength, key);
+  auto decryptor = GcmCryptor::Create(kBlockLength, key);
+  ASSERT_TRUE(encryptor->EncryptBlocks(kNumBlocks, plaintext_blocks.data(),
+                                       token_blocks.data(),
+                                       ciphertext_blocks.data()));
+
+  // Nonces are unique, and the key id changes every kKeyIdCycle blocks as it
+  // does for single block encryption.
+  for (size_t i = 1; i < kNumBlocks; ++i) {
+    EXPECT_NE(memcmp(token_blocks[i - 1], token_blocks[i], kNonceLength), 0);
+    int key_id_comparison =
+        memcmp(token_blocks[i - 1] + kNonceLength,
+               token_blocks[i] + kNonceLength, kKeyIdLength);
+    if (i % kKeyIdCycle == 0) {
+      EXPECT_NE(key_id_comparison, 0);
+    } else {
+      EXPECT_EQ(key_id_comparison, 0);
+    }
+  }
+
+  std::vector<const uint8_t*> const_ciphertext_blocks(
+      ciphertext_blocks.begin(), ciphertext_blocks.end());
+  std::vector<const uint8_t*> const_token_blocks(token_blocks.begin(),
+                                                 token_blocks.end());
+  ASSERT_TRUE(decryptor->DecryptBlocks(
+      kNumBlocks, const_ciphertext_blocks.data(), const_token_blocks.data(),
+      decrypted_blocks.data()));
+  EXPECT_EQ(plaintext, decrypted);
+
+  // Blocks encrypted in a batch can be decrypted one at a time.
+  uint8_t decryptor_buffer[kBlockLength];
+  ASSERT_TRUE(decryptor->DecryptBlock(ciphertext_blocks[kKeyIdCycle],
+                                      token_blocks[kKeyIdCycle],
+                                      decryptor_buffer));
+  EXPECT_EQ(memcmp(plaintext_blocks[kKeyIdCycle], decryptor_buffer,
+                   kBlockLength),
+            0);
+}
+
+// Tests decryption of blocks that alternate between derived keys, and that
+// blocks of a key id evicted from the thread's contexts still decrypt.
+TEST(GcmCryptorTest, DecryptInterleavedKeyIdsReturnsOriginalTexts) {
+  constexpr size_t kNumKeys = 6;
+  constexpr size_t kNumBlocks = kNumKeys * kKeyIdCycle;
+  constexpr size_t kCipherLength = kBlockLength + kTagLength;
+  std::vector<uint8_t> plaintext(kNumBlocks * kBlockLength);
+  std::vector<uint8_t> ciphertext(kNumBlocks * kCipherLength);
+  std::vector<uint8_t> tokens(kNumBlocks * kTokenLength);
+  ASSERT_EQ(RAND_bytes(plaintext.data(), plaintext.size()), 1);
+
+  GcmCryptorKey key;
+  ASSERT_EQ(RAND_bytes(key.data(), key.size()), 1);
+  auto cryptor = GcmCryptor::Create(kBlockLength, key);
+  for (size_t i = 0; i < kNumBlocks; ++i) {
+    ASSERT_TRUE(cryptor->EncryptBlock(plaintext.data() + i * kBlockLength,
+                                      tokens.data() + i * kTokenLength,
+                                      ciphertext.data() + i * kCipherLength));
+  }
+
+  // Visit the first blocks of every key id in turn, with some key ids visited
+  // more often than others.
+  uint8_t decrypted[kBlockLength];
+  for (size_t round = 0; round < 4; ++round) {
+    for (size_t key_index = 0; key_index < kNumKeys; ++key_index) {
+      for (size_t repeat = 0; repeat <= key_index % 2; ++repeat) {
+        size_t i = key_index * kKeyIdCycle + round;
+        ASSERT_TRUE(cryptor->DecryptBlock(ciphertext.data() + i * kCipherLength,
+                                          tokens.data() + i * kTokenLength,
+                                          decrypted));
+        EXPECT_EQ(memcmp(plaintext.data() + i * kBlockLength, decrypted,
+                         kBlockLength),
+                  0);
+      }
+    }
+  }
+}
+
+// Tests batched decryption with one altered ciphertext block.
+TEST(GcmCryptorTest, DecryptBlocksWithAlteredCiphertextFails) {
+  constexpr size_t kNumBlocks = 8;
+  constexpr size_t kCipherLength = kBlockLength + kTagLength;
+  uint8_t plaintext[kNumBlocks][kBlockLength];
+  uint8_t ciphertext[kNumBlocks][kCipherLength];
+  uint8_t tokens[kNumBlocks][kTokenLength];
+  uint8_t decrypted[kNumBlocks][kBlockLength];
+  ASSERT_EQ(RAND_bytes(&plaintext[0][0], sizeof(plaintext)), 1);
+
+  const uint8_t* plaintext_blocks[kNumBlocks];
+  uint8_t* ciphertext_blocks[kNumBlocks];
+  const uint8_t* const_ciphertext_blocks[kNumBlocks];
+  uint8_t* token_blocks[kNumBlocks];
+  const uint8_t* const_token_blocks[kNumBlocks];
+  uint8_t* decrypted_blocks[kNumBlocks];
+  for (size_t i = 0; i < kNumBlocks; ++i) {
+    plaintext_blocks[i] = plaintext[i];
+    ciphertext_blocks[i] = ciphertext[i];
+    const_ciphertext_blocks[i] = ciphertext[i];
+    token_blocks[i] = tokens[i];
+    const_token_blocks[i] = tokens[i];
+    decrypted_blocks[i] = decrypted[i];
+  }
+
+  GcmCryptorKey key;
+  ASSERT_EQ(RAND_bytes(key.data(), key.size()), 1);
+  auto cryptor = GcmCryptor::Create(kBlockLength, key);
+  ASSERT_TRUE(cryptor->EncryptBlocks(kNumBlocks, plaintext_blocks, token_blocks,
+                                     ciphertext_blocks));
+
+  // Alter the ciphertext of a block in the middle of the batch.
+  ++ciphertext[kNumBlocks / 2][0];
+
+  EXPECT_FALSE(cryptor->DecryptBlocks(kNumBlocks, const_ciphertext_blocks,
+                                      const_token_blocks, decrypted_blocks));
+}
+
 // Tests GCM cryptor registry returns consistent instance of GCM cryptor.
 TEST(GcmCryptorTest, GetGcmCryptorIsConsistent) {
   GcmCryptorKey key;
@@ -209,5 +350,122 @@ TEST(GcmCryptorTest, GetGcmCryptorIsConsistent) {
   EXPECT_EQ(c1, c2);
 }
 
+// Tests integrity-only blocks are stored in plaintext and verified on
+// decryption, in place or not.
+TEST(GcmCryptorTest, IntegrityOnlyKeepsPlaintextAndVerifiesTag) {
+  uint8_t plaintext[kBlockLength];
+  uint8_t encryptor_buffer[kBlockLength + kTagLength];
+  uint8_t decryptor_buffer[kBlockLength + kTagLength];
+  uint8_t token[kTokenLength];
+  GcmCryptorKey key;
+  ASSERT_EQ(RAND_bytes(key.data(), key.size()), 1);
+  auto cryptor = GcmCryptor::Create(kBlockLength, key, /*integrity_only=*/true);
+  ASSERT_NE(cryptor, nullptr);
+  for (int i = 0; i < 100; ++i) {
+    ASSERT_EQ(RAND_bytes(plaintext, kBlockLength), 1);
+    ASSERT_TRUE(cryptor->EncryptBlock(plaintext, token, encryptor_buffer));
+    EXPECT_EQ(memcmp(plaintext, encryptor_buffer, kBlockLength), 0);
+
+    ASSERT_TRUE(
+        cryptor->DecryptBlock(encryptor_buffer, token, decryptor_buffer));
+    EXPECT_EQ(memcmp(plaintext, decryptor_buffer, kBlockLength), 0);
+    ASSERT_TRUE(
+        cryptor->DecryptBlock(encryptor_buffer, token, encryptor_buffer));
+    EXPECT_EQ(memcmp(plaintext, encryptor_buffer, kBlockLength), 0);
+
+    // Altering the data or the tag fails verification.
+    encryptor_buffer[i % kBlockLength] ^= 1;
+    EXPECT_FALSE(
+        cryptor->DecryptBlock(encryptor_buffer, token, decryptor_buffer));
+    encryptor_buffer[i % kBlockLength] ^= 1;
+    encryptor_buffer[kBlockLength + i % kTagLength] ^= 1;
+    EXPECT_FALSE(
+        cryptor->DecryptBlock(encryptor_buffer, token, decryptor_buffer));
+  }
+}
+
+// Tests blocks do not verify in a mode other than the one they were encrypted
+// in under the same key.
+TEST(GcmCryptorTest, DecryptInOtherModeFails) {
+  uint8_t plaintext[kBlockLength];
+  uint8_t encryptor_buffer[kBlockLength + kTagLength];
+  uint8_t decryptor_buffer[kBlockLength + kTagLength];
+  uint8_t token[kTokenLength];
+  GcmCryptorKey key;
+  ASSERT_EQ(RAND_bytes(key.data(), key.size()), 1);
+  ASSERT_EQ(RAND_bytes(plaintext, kBlockLength), 1);
+  GcmCryptor* encrypting =
+      GcmCryptorRegistry::GetInstance().GetGcmCryptor(kBlockLength, key);
+  GcmCryptor* integrity_only = GcmCryptorRegistry::GetInstance().GetGcmCryptor(
+      kBlockLength, key, /*integrity_only=*/true);
+  ASSERT_NE(encrypting, nullptr);
+  ASSERT_NE(integrity_only, nullptr);
+  EXPECT_NE(encrypting, integrity_only);
+
+  ASSERT_TRUE(encrypting->EncryptBlock(plaintext, token, encryptor_buffer));
+  EXPECT_FALSE(
+      integrity_only->DecryptBlock(encryptor_buffer, token, decryptor_buffer));
+  ASSERT_TRUE(integrity_only->EncryptBlock(plaintext, token, encryptor_buffer));
+  EXPECT_FALSE(
+      encrypting->DecryptBlock(encryptor_buffer, token, decryptor_buffer));
+}
+
+// Tests threads encrypting and decrypting with the same registered cryptor,
+// including blocks encrypted by other threads.
+TEST(GcmCryptorTest, ConcurrentEncryptDecryptReturnsOriginalTexts) {
+  constexpr int kNumThreads = 4;
+  constexpr size_t kNumBlocks = 2 * kKeyIdCycle + 10;
+  constexpr size_t kCipherLength = kBlockLength + kTagLength;
+  GcmCryptorKey key;
+  ASSERT_EQ(RAND_bytes(key.data(), key.size()), 1);
+
+  std::vector<std::vector<uint8_t>> plaintexts(kNumThreads);
+  std::vector<std::vector<uint8_t>> ciphertexts(kNumThreads);
+  std::vector<std::vector<uint8_t>> tokens(kNumThreads);
+  std::vector<std::thread> threads;
+  for (int thread = 0; thread < kNumThreads; ++thread) {
+    plaintexts[thread].resize(kNumBlocks * kBlockLength);
+    ciphertexts[thread].resize(kNumBlocks * kCipherLength);
+    tokens[thread].resize(kNumBlocks * kTokenLength);
+    ASSERT_EQ(RAND_bytes(plaintexts[thread].data(), plaintexts[thread].size()),
+              1);
+  }
+
+  for (int thread = 0; thread < kNumThreads; ++thread) {
+    threads.emplace_back([&, thread] {
+      GcmCryptor* cryptor =
+          GcmCryptorRegistry::GetInstance().GetGcmCryptor(kBlockLength, key);
+      ASSERT_NE(cryptor, nullptr);
+      uint8_t decrypted[kBlockLength];
+      for (size_t i = 0; i < kNumBlocks; ++i) {
+        const uint8_t* plaintext =
+            plaintexts[thread].data() + i * kBlockLength;
+        uint8_t* ciphertext = ciphertexts[thread].data() + i * kCipherLength;
+        uint8_t* token = tokens[thread].data() + i * kTokenLength;
+        ASSERT_TRUE(cryptor->EncryptBlock(plaintext, token, ciphertext));
+        ASSERT_TRUE(cryptor->DecryptBlock(ciphertext, token, decrypted));
+        ASSERT_EQ(memcmp(plaintext, decrypted, kBlockLength), 0);
+      }
+    });
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+
+  GcmCryptor* cryptor =
+      GcmCryptorRegistry::GetInstance().GetGcmCryptor(kBlockLength, key);
+  uint8_t decrypted[kBlockLength];
+  for (int thread = 0; thread < kNumThreads; ++thread) {
+    for (size_t i = 0; i < kNumBlocks; ++i) {
+      ASSERT_TRUE(cryptor->DecryptBlock(
+          ciphertexts[thread].data() + i * kCipherLength,
+          tokens[thread].data() + i * kTokenLength, decrypted));
+      ASSERT_EQ(memcmp(plaintexts[thread].data() + i * kBlockLength, decrypted,
+                       kBlockLength),
+                0);
+    }
+  }
+}
+
 }  // namespace
 }  // namespace asylo
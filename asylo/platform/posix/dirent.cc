@@ -17,22 +17,217 @@
  */
 
 #include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
+#include <algorithm>
+#include <cstddef>
 #include <cstdint>
-#include <cstdlib>
+#include <new>
 
-int closedir(DIR *) { abort(); }
+#include "absl/base/thread_annotations.h"
+#include "absl/synchronization/mutex.h"
+#include "asylo/platform/posix/io/io_manager.h"
 
-DIR *opendir(const char *) { abort(); }
+using asylo::io::IOManager;
 
-struct dirent *readdir(DIR *) {
-  abort();
+namespace {
+
+// Longest file name a Linux host reports, excluding the terminating null.
+constexpr size_t kMaxNameLength = 255;
+
+// Offsets of the fields of a Linux struct linux_dirent64, as filled in by the
+// host's getdents64:
+//   uint64_t d_ino; int64_t d_off; uint16_t d_reclen; uint8_t d_type;
+//   char d_name[];
+constexpr size_t kHostInoOffset = 0;
+constexpr size_t kHostReclenOffset = 16;
+constexpr size_t kHostNameOffset = 19;
+
+// Smallest batch able to hold any single host record.
+constexpr size_t kMinBatchSize = 512;
+
+// A directory stream. The DIR is the first member, so a DIR * handed out by
+// opendir converts back to its DirStream. The buffer holds a batch of host
+// records in [dd_loc, dd_size), which readdir parses one record at a time.
+// dd_seek counts the entries returned since the stream was opened or rewound,
+// which is the position reported by telldir.
+struct DirStream {
+  DIR dir;
+  absl::Mutex mu;
+  union {
+    struct dirent entry;
+    char entry_storage[offsetof(struct dirent, d_name) + kMaxNameLength + 1];
+  };
+};
+
+DirStream *ToDirStream(DIR *dirp) {
+  return reinterpret_cast<DirStream *>(dirp);
+}
+
+// Fetches the next batch of host records into the buffer of |dirp|. Returns
+// false at the end of the directory or on error, setting errno only on error.
+bool FillBuffer(DIR *dirp) {
+  ssize_t ret = IOManager::GetInstance().GetDents(dirp->dd_fd, dirp->dd_buf,
+                                                  dirp->dd_len);
+  if (ret <= 0) {
+    return false;
+  }
+  dirp->dd_loc = 0;
+  dirp->dd_size = ret;
+  return true;
+}
+
+// Parses the next entry of |stream| into its entry storage. Returns false at
+// the end of the directory or on error, setting errno only on error.
+bool NextEntry(DirStream *stream) EXCLUSIVE_LOCKS_REQUIRED(stream->mu) {
+  DIR *dirp = &stream->dir;
+  if (dirp->dd_loc >= dirp->dd_size && !FillBuffer(dirp)) {
+    return false;
+  }
+
+  // The records were copied into the enclave before parsing, but are still
+  // host-supplied, so each one is checked to lie within the batch and to hold
+  // a terminated name.
+  const char *record = dirp->dd_buf + dirp->dd_loc;
+  size_t remaining = dirp->dd_size - dirp->dd_loc;
+  uint16_t reclen;
+  if (remaining < kHostNameOffset + 1) {
+    errno = EIO;
+    return false;
+  }
+  memcpy(&reclen, record + kHostReclenOffset, sizeof(reclen));
+  if (reclen < kHostNameOffset + 1 || reclen > remaining) {
+    errno = EIO;
+    return false;
+  }
+  const char *name = record + kHostNameOffset;
+  size_t name_length = strnlen(name, reclen - kHostNameOffset);
+  if (name_length == reclen - kHostNameOffset ||
+      name_length > kMaxNameLength) {
+    errno = EIO;
+    return false;
+  }
+
+  uint64_t ino;
+  memcpy(&ino, record + kHostInoOffset, sizeof(ino));
+  dirp->dd_loc += reclen;
+  dirp->dd_seek++;
+
+  struct dirent *entry = &stream->entry;
+  entry->d_ino = ino;
+  entry->d_off = dirp->dd_seek;
+  entry->d_reclen = offsetof(struct dirent, d_name) + name_length + 1;
+  memcpy(entry->d_name, name, name_length + 1);
+  return true;
+}
+
+// Returns |stream| to its first entry, dropping any buffered records.
+int Rewind(DirStream *stream) EXCLUSIVE_LOCKS_REQUIRED(stream->mu) {
+  DIR *dirp = &stream->dir;
+  dirp->dd_loc = 0;
+  dirp->dd_size = 0;
+  dirp->dd_seek = 0;
+  return IOManager::GetInstance().LSeek(dirp->dd_fd, 0, SEEK_SET);
 }
 
-int readdir_r(DIR *, struct dirent *, struct dirent **) { abort(); }
+}  // namespace
+
+int closedir(DIR *dirp) {
+  if (!dirp) {
+    errno = EBADF;
+    return -1;
+  }
+  int ret = close(dirp->dd_fd);
+  delete[] dirp->dd_buf;
+  delete ToDirStream(dirp);
+  return ret;
+}
 
-void rewinddir(DIR *) { abort(); }
+DIR *opendir(const char *name) {
+  int fd = open(name, O_RDONLY);
+  if (fd < 0) {
+    return nullptr;
+  }
+  struct stat stat_buffer;
+  if (fstat(fd, &stat_buffer) != 0) {
+    close(fd);
+    return nullptr;
+  }
+  if (!S_ISDIR(stat_buffer.st_mode)) {
+    close(fd);
+    errno = ENOTDIR;
+    return nullptr;
+  }
 
-void seekdir(DIR *, int64_t) { abort(); }
+  size_t batch_size =
+      std::max(IOManager::GetInstance().readdir_batch_size(), kMinBatchSize);
+  DirStream *stream = new (std::nothrow) DirStream;
+  char *buffer = new (std::nothrow) char[batch_size];
+  if (!stream || !buffer) {
+    delete stream;
+    delete[] buffer;
+    close(fd);
+    errno = ENOMEM;
+    return nullptr;
+  }
+  DIR *dirp = &stream->dir;
+  dirp->dd_fd = fd;
+  dirp->dd_loc = 0;
+  dirp->dd_seek = 0;
+  dirp->dd_buf = buffer;
+  dirp->dd_len = batch_size;
+  dirp->dd_size = 0;
+  return dirp;
+}
 
-int64_t telldir(DIR *) { abort(); }
+struct dirent *readdir(DIR *dirp) {
+  DirStream *stream = ToDirStream(dirp);
+  absl::MutexLock lock(&stream->mu);
+  return NextEntry(stream) ? &stream->entry : nullptr;
+}
+
+int readdir_r(DIR *dirp, struct dirent *entry, struct dirent **result) {
+  DirStream *stream = ToDirStream(dirp);
+  absl::MutexLock lock(&stream->mu);
+  int saved_errno = errno;
+  errno = 0;
+  if (!NextEntry(stream)) {
+    *result = nullptr;
+    int error = errno;
+    errno = saved_errno;
+    return error;
+  }
+  errno = saved_errno;
+  memcpy(entry, &stream->entry, stream->entry.d_reclen);
+  *result = entry;
+  return 0;
+}
+
+void rewinddir(DIR *dirp) {
+  DirStream *stream = ToDirStream(dirp);
+  absl::MutexLock lock(&stream->mu);
+  Rewind(stream);
+}
+
+// Positions are entry counts rather than host directory cookies, which the
+// enclave cannot validate. Seeking backwards rewinds the stream and reads
+// forward again, a batch at a time.
+void seekdir(DIR *dirp, int64_t loc) {
+  DirStream *stream = ToDirStream(dirp);
+  absl::MutexLock lock(&stream->mu);
+  if (loc < dirp->dd_seek && Rewind(stream) != 0) {
+    return;
+  }
+  while (dirp->dd_seek < loc && NextEntry(stream)) {
+  }
+}
+
+int64_t telldir(DIR *dirp) {
+  DirStream *stream = ToDirStream(dirp);
+  absl::MutexLock lock(&stream->mu);
+  return dirp->dd_seek;
+}
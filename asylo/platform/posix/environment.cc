@@ -0,0 +1,57 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+// Replaces the newlib getenv, which scans environ under the environment lock,
+// with a lookup in the EnvironmentTable installed when the enclave is
+// initialized. The functions modifying the environment are replaced to make
+// getenv read environ again once they are called.
+
+#include <reent.h>
+#include <stdlib.h>
+
+#include "asylo/platform/posix/environment_table.h"
+
+extern "C" {
+
+char *getenv(const char *name) {
+  const asylo::EnvironmentTable *table = asylo::GetEnvironmentTable();
+  if (table) {
+    return table->Get(name);
+  }
+  return _getenv_r(_REENT, name);
+}
+
+int setenv(const char *name, const char *value, int overwrite) {
+  int result = _setenv_r(_REENT, name, value, overwrite);
+  asylo::MarkEnvironmentModified();
+  return result;
+}
+
+int unsetenv(const char *name) {
+  int result = _unsetenv_r(_REENT, name);
+  asylo::MarkEnvironmentModified();
+  return result;
+}
+
+int putenv(char *string) {
+  int result = _putenv_r(_REENT, string);
+  asylo::MarkEnvironmentModified();
+  return result;
+}
+
+}  // extern "C"
@@ -0,0 +1,123 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/posix/environment_table.h"
+
+#include <atomic>
+#include <cstring>
+
+namespace asylo {
+namespace {
+
+// The installed table, which is never freed since getenv returns pointers into
+// it.
+std::atomic<const EnvironmentTable *> installed_table(nullptr);
+
+// Whether the environment has been modified since the table was installed.
+std::atomic<bool> environment_modified(false);
+
+}  // namespace
+
+constexpr size_t EnvironmentTable::kEmptySlot;
+
+std::unique_ptr<EnvironmentTable> EnvironmentTable::Create(
+    char *const *entries) {
+  std::unique_ptr<EnvironmentTable> table(new EnvironmentTable);
+  size_t count = 0;
+  for (char *const *entry = entries; entry && *entry; ++entry) {
+    ++count;
+  }
+  size_t capacity = 1;
+  while (capacity < 2 * count) {
+    capacity <<= 1;
+  }
+  table->slots_.assign(capacity, {kEmptySlot, 0, 0});
+
+  for (size_t i = 0; i < count; ++i) {
+    const char *entry = entries[i];
+    const char *equals = strchr(entry, '=');
+    if (!equals) {
+      continue;
+    }
+    size_t name_length = equals - entry;
+    uint64_t hash = Hash(entry, name_length);
+    size_t index = hash & (capacity - 1);
+    bool duplicate = false;
+    while (table->slots_[index].offset != kEmptySlot) {
+      const Slot &slot = table->slots_[index];
+      if (slot.hash == hash && slot.name_length == name_length &&
+          memcmp(table->storage_.data() + slot.offset, entry, name_length) ==
+              0) {
+        duplicate = true;
+        break;
+      }
+      index = (index + 1) & (capacity - 1);
+    }
+    if (duplicate) {
+      continue;
+    }
+    table->slots_[index] = {table->storage_.size(), name_length, hash};
+    table->storage_.append(entry, strlen(entry) + 1);
+    ++table->size_;
+  }
+  return table;
+}
+
+char *EnvironmentTable::Get(const char *name) const {
+  size_t name_length = strlen(name);
+  uint64_t hash = Hash(name, name_length);
+  size_t mask = slots_.size() - 1;
+  for (size_t index = hash & mask; slots_[index].offset != kEmptySlot;
+       index = (index + 1) & mask) {
+    const Slot &slot = slots_[index];
+    const char *entry = storage_.data() + slot.offset;
+    if (slot.hash == hash && slot.name_length == name_length &&
+        memcmp(entry, name, name_length) == 0) {
+      return const_cast<char *>(entry + name_length + 1);
+    }
+  }
+  return nullptr;
+}
+
+uint64_t EnvironmentTable::Hash(const char *name, size_t length) {
+  // 64-bit FNV-1a.
+  uint64_t hash = 0xcbf29ce484222325;
+  for (size_t i = 0; i < length; ++i) {
+    hash = (hash ^ static_cast<uint8_t>(name[i])) * 0x100000001b3;
+  }
+  return hash;
+}
+
+void InstallEnvironmentTable(char *const *entries) {
+  installed_table.store(EnvironmentTable::Create(entries).release(),
+                        std::memory_order_release);
+  environment_modified.store(false, std::memory_order_release);
+}
+
+void MarkEnvironmentModified() {
+  environment_modified.store(true, std::memory_order_release);
+}
+
+const EnvironmentTable *GetEnvironmentTable() {
+  if (environment_modified.load(std::memory_order_acquire)) {
+    return nullptr;
+  }
+  return installed_table.load(std::memory_order_acquire);
+}
+
+}  // namespace asylo
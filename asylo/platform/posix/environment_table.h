@@ -0,0 +1,93 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_PLATFORM_POSIX_ENVIRONMENT_TABLE_H_
+#define ASYLO_PLATFORM_POSIX_ENVIRONMENT_TABLE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace asylo {
+
+// An immutable hash table of environment variables, which getenv consults
+// instead of scanning environ under the newlib environment lock.
+//
+// The enclave's table is installed after the environment variables of the
+// EnclaveConfig are set, and serves getenv until the environment is modified
+// with setenv, unsetenv or putenv, after which getenv reads environ again.
+// Writes made directly to environ are not detected.
+class EnvironmentTable {
+ public:
+  // Returns a table of the "NAME=VALUE" strings of the null-terminated array
+  // |entries|, in the format of environ. Entries without '=' are ignored. The
+  // first entry for a name is kept, as getenv finds it first in environ.
+  static std::unique_ptr<EnvironmentTable> Create(char *const *entries);
+
+  EnvironmentTable(const EnvironmentTable &) = delete;
+  EnvironmentTable &operator=(const EnvironmentTable &) = delete;
+
+  // Returns the value of |name|, or nullptr if the table does not hold it. The
+  // value is owned by the table.
+  char *Get(const char *name) const;
+
+  // Returns the number of variables in the table.
+  size_t size() const { return size_; }
+
+ private:
+  // A variable in |storage_|.
+  struct Slot {
+    // Offset in |storage_| of the "NAME=VALUE" string, or kEmptySlot.
+    size_t offset;
+    size_t name_length;
+    uint64_t hash;
+  };
+
+  static constexpr size_t kEmptySlot = SIZE_MAX;
+
+  EnvironmentTable() = default;
+
+  // Returns the hash of the |length|-byte |name|.
+  static uint64_t Hash(const char *name, size_t length);
+
+  // Null-terminated "NAME=VALUE" strings, back to back.
+  std::string storage_;
+
+  // Open-addressed slots, a power of two in number.
+  std::vector<Slot> slots_;
+  size_t size_ = 0;
+};
+
+// Installs a table of the null-terminated array |entries| as the enclave's
+// table, which serves getenv until MarkEnvironmentModified() is called. Must
+// be called while the enclave runs a single thread.
+void InstallEnvironmentTable(char *const *entries);
+
+// Makes getenv read environ instead of the installed table, after the
+// environment has been modified.
+void MarkEnvironmentModified();
+
+// Returns the enclave's table, or nullptr if none is installed or the
+// environment has been modified since.
+const EnvironmentTable *GetEnvironmentTable();
+
+}  // namespace asylo
+
+#endif  // ASYLO_PLATFORM_POSIX_ENVIRONMENT_TABLE_H_
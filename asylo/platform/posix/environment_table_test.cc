@@ -0,0 +1,98 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/posix/environment_table.h"
+
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace asylo {
+namespace {
+
+// Returns the null-terminated environ-style array of |entries|.
+std::vector<char *> MakeEntries(std::vector<std::string> *entries) {
+  std::vector<char *> pointers;
+  for (std::string &entry : *entries) {
+    pointers.push_back(&entry[0]);
+  }
+  pointers.push_back(nullptr);
+  return pointers;
+}
+
+TEST(EnvironmentTableTest, FindsVariables) {
+  std::vector<std::string> entries;
+  for (int i = 0; i < 100; ++i) {
+    entries.push_back("VAR" + std::to_string(i) + "=value" + std::to_string(i));
+  }
+  entries.push_back("EMPTY=");
+  entries.push_back("EQUALS=a=b");
+  std::vector<char *> pointers = MakeEntries(&entries);
+  auto table = EnvironmentTable::Create(pointers.data());
+  EXPECT_EQ(table->size(), 102);
+
+  for (int i = 0; i < 100; ++i) {
+    const char *value = table->Get(("VAR" + std::to_string(i)).c_str());
+    ASSERT_NE(value, nullptr) << i;
+    EXPECT_EQ(std::string(value), "value" + std::to_string(i));
+  }
+  ASSERT_NE(table->Get("EMPTY"), nullptr);
+  EXPECT_EQ(std::string(table->Get("EMPTY")), "");
+  ASSERT_NE(table->Get("EQUALS"), nullptr);
+  EXPECT_EQ(std::string(table->Get("EQUALS")), "a=b");
+
+  EXPECT_EQ(table->Get("VAR"), nullptr);
+  EXPECT_EQ(table->Get("VAR1="), nullptr);
+  EXPECT_EQ(table->Get("VAR100"), nullptr);
+  EXPECT_EQ(table->Get(""), nullptr);
+}
+
+TEST(EnvironmentTableTest, KeepsFirstEntryAndSkipsMalformedEntries) {
+  std::vector<std::string> entries = {"NAME=first", "MALFORMED", "NAME=second"};
+  std::vector<char *> pointers = MakeEntries(&entries);
+  auto table = EnvironmentTable::Create(pointers.data());
+  EXPECT_EQ(table->size(), 1);
+  EXPECT_EQ(std::string(table->Get("NAME")), "first");
+  EXPECT_EQ(table->Get("MALFORMED"), nullptr);
+
+  // The table holds its own copy of the variables.
+  entries[0][5] = 'X';
+  EXPECT_EQ(std::string(table->Get("NAME")), "first");
+}
+
+TEST(EnvironmentTableTest, EmptyTable) {
+  auto table = EnvironmentTable::Create(nullptr);
+  EXPECT_EQ(table->size(), 0);
+  EXPECT_EQ(table->Get("NAME"), nullptr);
+}
+
+TEST(EnvironmentTableTest, ModificationDisablesInstalledTable) {
+  std::vector<std::string> entries = {"NAME=value"};
+  std::vector<char *> pointers = MakeEntries(&entries);
+  InstallEnvironmentTable(pointers.data());
+  const EnvironmentTable *table = GetEnvironmentTable();
+  ASSERT_NE(table, nullptr);
+  EXPECT_EQ(std::string(table->Get("NAME")), "value");
+
+  MarkEnvironmentModified();
+  EXPECT_EQ(GetEnvironmentTable(), nullptr);
+}
+
+}  // namespace
+}  // namespace asylo
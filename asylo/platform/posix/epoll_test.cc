@@ -0,0 +1,110 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <sys/epoll.h>
+#include <unistd.h>
+#include <cerrno>
+
+#include <gtest/gtest.h>
+
+namespace asylo {
+namespace {
+
+class EnclaveEpollTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    epfd_ = epoll_create1(0);
+    ASSERT_GE(epfd_, 0);
+    ASSERT_EQ(pipe(pipe_fds_), 0);
+  }
+
+  void TearDown() override {
+    close(pipe_fds_[0]);
+    close(pipe_fds_[1]);
+    close(epfd_);
+  }
+
+  int epfd_;
+  int pipe_fds_[2];
+};
+
+// Tests that a ready descriptor is reported with the data it was registered
+// with.
+TEST_F(EnclaveEpollTest, ReportsReadyDescriptorWithCallerData) {
+  int marker;
+  struct epoll_event event = {};
+  event.events = EPOLLIN;
+  event.data.ptr = &marker;
+  ASSERT_EQ(epoll_ctl(epfd_, EPOLL_CTL_ADD, pipe_fds_[0], &event), 0);
+
+  struct epoll_event ready[4];
+  EXPECT_EQ(epoll_wait(epfd_, ready, 4, 0), 0);
+
+  ASSERT_EQ(write(pipe_fds_[1], "x", 1), 1);
+  ASSERT_EQ(epoll_wait(epfd_, ready, 4, 1000), 1);
+  EXPECT_EQ(ready[0].events & EPOLLIN, EPOLLIN);
+  EXPECT_EQ(ready[0].data.ptr, &marker);
+}
+
+// Tests that modified and deleted registrations take effect.
+TEST_F(EnclaveEpollTest, ModifyAndDelete) {
+  struct epoll_event event = {};
+  event.events = EPOLLOUT;
+  event.data.u64 = 7;
+  ASSERT_EQ(epoll_ctl(epfd_, EPOLL_CTL_ADD, pipe_fds_[1], &event), 0);
+  EXPECT_EQ(epoll_ctl(epfd_, EPOLL_CTL_ADD, pipe_fds_[1], &event), -1);
+  EXPECT_EQ(errno, EEXIST);
+
+  struct epoll_event ready[4];
+  ASSERT_EQ(epoll_wait(epfd_, ready, 4, 0), 1);
+  EXPECT_EQ(ready[0].data.u64, 7);
+
+  event.events = EPOLLIN;
+  event.data.u64 = 8;
+  ASSERT_EQ(epoll_ctl(epfd_, EPOLL_CTL_MOD, pipe_fds_[1], &event), 0);
+  EXPECT_EQ(epoll_wait(epfd_, ready, 4, 0), 0);
+
+  ASSERT_EQ(epoll_ctl(epfd_, EPOLL_CTL_DEL, pipe_fds_[1], nullptr), 0);
+  EXPECT_EQ(epoll_ctl(epfd_, EPOLL_CTL_DEL, pipe_fds_[1], nullptr), -1);
+  EXPECT_EQ(errno, ENOENT);
+}
+
+TEST_F(EnclaveEpollTest, RejectsInvalidArguments) {
+  struct epoll_event event = {};
+  event.events = EPOLLIN;
+
+  // The target of epoll_ctl must be an epoll instance.
+  EXPECT_EQ(epoll_ctl(pipe_fds_[0], EPOLL_CTL_ADD, pipe_fds_[1], &event), -1);
+  EXPECT_EQ(errno, EINVAL);
+
+  EXPECT_EQ(epoll_ctl(epfd_, EPOLL_CTL_ADD, epfd_, &event), -1);
+  EXPECT_EQ(errno, EINVAL);
+
+  EXPECT_EQ(epoll_ctl(epfd_, EPOLL_CTL_ADD, -1, &event), -1);
+  EXPECT_EQ(errno, EBADF);
+
+  struct epoll_event ready[1];
+  EXPECT_EQ(epoll_wait(epfd_, ready, 0, 0), -1);
+  EXPECT_EQ(errno, EINVAL);
+
+  EXPECT_EQ(epoll_create(0), -1);
+  EXPECT_EQ(errno, EINVAL);
+}
+
+}  // namespace
+}  // namespace asylo
@@ -0,0 +1,117 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/posix/host_info_cache.h"
+
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+namespace asylo {
+namespace {
+
+// Copies |value| into the utsname field |field|, truncating it to leave room
+// for the terminating null byte.
+template <size_t N>
+void CopyField(const std::string &value, char (&field)[N]) {
+  size_t size = std::min(value.size(), N - 1);
+  memcpy(field, value.data(), size);
+  field[size] = '\0';
+}
+
+}  // namespace
+
+HostInfoCache &HostInfoCache::GetInstance() {
+  static HostInfoCache *instance = new HostInfoCache;
+  return *instance;
+}
+
+void HostInfoCache::Set(const HostInfo &info) {
+  processors_configured_ = info.processors_configured;
+  processors_online_ = info.processors_online;
+  page_size_ = info.page_size;
+
+  absl::MutexLock lock(&mu_);
+  has_cpu_affinity_ = !info.cpu_affinity.empty();
+  cpu_affinity_ = info.cpu_affinity;
+  has_uname_ = !info.sysname.empty() || !info.nodename.empty() ||
+               !info.release.empty() || !info.version.empty() ||
+               !info.machine.empty();
+  uname_ = info;
+  uname_.cpu_affinity.clear();
+}
+
+void HostInfoCache::Invalidate() {
+  processors_configured_ = -1;
+  processors_online_ = -1;
+
+  absl::MutexLock lock(&mu_);
+  has_cpu_affinity_ = false;
+  cpu_affinity_.clear();
+}
+
+long HostInfoCache::processors_configured() const {
+  return processors_configured_.load(std::memory_order_relaxed);
+}
+
+long HostInfoCache::processors_online() const {
+  return processors_online_.load(std::memory_order_relaxed);
+}
+
+long HostInfoCache::page_size() const {
+  return page_size_.load(std::memory_order_relaxed);
+}
+
+void HostInfoCache::set_processors_configured(long count) {
+  processors_configured_.store(count, std::memory_order_relaxed);
+}
+
+void HostInfoCache::set_processors_online(long count) {
+  processors_online_.store(count, std::memory_order_relaxed);
+}
+
+bool HostInfoCache::GetCpuAffinity(std::vector<int> *cpus) const {
+  absl::MutexLock lock(&mu_);
+  if (!has_cpu_affinity_) {
+    return false;
+  }
+  *cpus = cpu_affinity_;
+  return true;
+}
+
+void HostInfoCache::SetCpuAffinity(std::vector<int> cpus) {
+  absl::MutexLock lock(&mu_);
+  has_cpu_affinity_ = true;
+  cpu_affinity_ = std::move(cpus);
+}
+
+bool HostInfoCache::GetUname(struct utsname *buf) const {
+  absl::MutexLock lock(&mu_);
+  if (!has_uname_) {
+    return false;
+  }
+  CopyField(uname_.sysname, buf->sysname);
+  CopyField(uname_.nodename, buf->nodename);
+  CopyField(uname_.release, buf->release);
+  CopyField(uname_.version, buf->version);
+  CopyField(uname_.machine, buf->machine);
+  CopyField(uname_.domainname, buf->domainname);
+  return true;
+}
+
+}  // namespace asylo
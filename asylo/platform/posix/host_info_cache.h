@@ -0,0 +1,113 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_PLATFORM_POSIX_HOST_INFO_CACHE_H_
+#define ASYLO_PLATFORM_POSIX_HOST_INFO_CACHE_H_
+
+#include <sys/utsname.h>
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include "absl/synchronization/mutex.h"
+
+namespace asylo {
+
+// Facts about the host system which sysconf, sched_getaffinity and uname
+// report. Unknown counts are -1.
+struct HostInfo {
+  long processors_configured = -1;
+  long processors_online = -1;
+  long page_size = -1;
+
+  // CPUs the host process may run on. Empty if unknown.
+  std::vector<int> cpu_affinity;
+
+  // Fields of struct utsname. All empty if unknown.
+  std::string sysname;
+  std::string nodename;
+  std::string release;
+  std::string version;
+  std::string machine;
+  std::string domainname;
+};
+
+// Host facts which rarely or never change while an enclave runs, served inside
+// the enclave so that frequent callers, such as thread pools asking for the
+// number of processors, do not leave the enclave each time.
+//
+// The cache is filled when the enclave is initialized. Callers fall back to
+// asking the host for anything the cache does not hold, and store the answer.
+// Invalidate() is the refresh hook for hosts whose processors change: it
+// forgets the processor counts and affinity, so the next callers ask the host
+// again. The page size and the uname fields never change and are kept.
+//
+// Like any value obtained from the host, cached values are untrusted. All
+// methods are thread-safe.
+class HostInfoCache {
+ public:
+  HostInfoCache() = default;
+  HostInfoCache(const HostInfoCache &) = delete;
+  HostInfoCache &operator=(const HostInfoCache &) = delete;
+
+  // Returns the cache consulted by the enclave's libc.
+  static HostInfoCache &GetInstance();
+
+  // Replaces the cached facts with the known facts of |info|.
+  void Set(const HostInfo &info);
+
+  // Forgets the processor counts and affinity.
+  void Invalidate();
+
+  // Return the cached values of sysconf(_SC_NPROCESSORS_CONF),
+  // sysconf(_SC_NPROCESSORS_ONLN) and sysconf(_SC_PAGESIZE), or -1 if unknown.
+  long processors_configured() const;
+  long processors_online() const;
+  long page_size() const;
+
+  // Store a processor count reported by the host.
+  void set_processors_configured(long count);
+  void set_processors_online(long count);
+
+  // Stores the cached CPU affinity in |cpus| and returns true, or returns false
+  // if it is unknown.
+  bool GetCpuAffinity(std::vector<int> *cpus) const;
+
+  // Stores a CPU affinity reported by the host.
+  void SetCpuAffinity(std::vector<int> cpus);
+
+  // Fills |buf| with the cached uname fields, truncating each to fit, and
+  // returns true, or returns false if they are unknown.
+  bool GetUname(struct utsname *buf) const;
+
+ private:
+  std::atomic<long> processors_configured_{-1};
+  std::atomic<long> processors_online_{-1};
+  std::atomic<long> page_size_{-1};
+
+  mutable absl::Mutex mu_;
+  bool has_cpu_affinity_ GUARDED_BY(mu_) = false;
+  std::vector<int> cpu_affinity_ GUARDED_BY(mu_);
+  bool has_uname_ GUARDED_BY(mu_) = false;
+  HostInfo uname_ GUARDED_BY(mu_);
+};
+
+}  // namespace asylo
+
+#endif  // ASYLO_PLATFORM_POSIX_HOST_INFO_CACHE_H_
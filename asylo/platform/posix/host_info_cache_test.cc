@@ -0,0 +1,117 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/posix/host_info_cache.h"
+
+#include <sys/utsname.h>
+
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace asylo {
+namespace {
+
+HostInfo MakeInfo() {
+  HostInfo info;
+  info.processors_configured = 8;
+  info.processors_online = 4;
+  info.page_size = 4096;
+  info.cpu_affinity = {0, 2, 3};
+  info.sysname = "Linux";
+  info.nodename = "host";
+  info.release = "4.15.0";
+  info.version = "#1 SMP";
+  info.machine = "x86_64";
+  info.domainname = "(none)";
+  return info;
+}
+
+TEST(HostInfoCacheTest, EmptyCacheKnowsNothing) {
+  HostInfoCache cache;
+  EXPECT_EQ(cache.processors_configured(), -1);
+  EXPECT_EQ(cache.processors_online(), -1);
+  EXPECT_EQ(cache.page_size(), -1);
+  std::vector<int> cpus;
+  EXPECT_FALSE(cache.GetCpuAffinity(&cpus));
+  struct utsname name;
+  EXPECT_FALSE(cache.GetUname(&name));
+}
+
+TEST(HostInfoCacheTest, ServesWhatIsSet) {
+  HostInfoCache cache;
+  cache.Set(MakeInfo());
+  EXPECT_EQ(cache.processors_configured(), 8);
+  EXPECT_EQ(cache.processors_online(), 4);
+  EXPECT_EQ(cache.page_size(), 4096);
+
+  std::vector<int> cpus;
+  ASSERT_TRUE(cache.GetCpuAffinity(&cpus));
+  EXPECT_EQ(cpus, std::vector<int>({0, 2, 3}));
+
+  struct utsname name;
+  ASSERT_TRUE(cache.GetUname(&name));
+  EXPECT_EQ(std::string(name.sysname), "Linux");
+  EXPECT_EQ(std::string(name.nodename), "host");
+  EXPECT_EQ(std::string(name.release), "4.15.0");
+  EXPECT_EQ(std::string(name.version), "#1 SMP");
+  EXPECT_EQ(std::string(name.machine), "x86_64");
+  EXPECT_EQ(std::string(name.domainname), "(none)");
+}
+
+TEST(HostInfoCacheTest, TruncatesLongUnameFields) {
+  HostInfoCache cache;
+  HostInfo info = MakeInfo();
+  info.nodename = std::string(sizeof(utsname::nodename) + 10, 'a');
+  cache.Set(info);
+
+  struct utsname name;
+  ASSERT_TRUE(cache.GetUname(&name));
+  EXPECT_EQ(std::string(name.nodename),
+            std::string(sizeof(utsname::nodename) - 1, 'a'));
+}
+
+TEST(HostInfoCacheTest, InvalidateForgetsOnlyProcessorFacts) {
+  HostInfoCache cache;
+  cache.Set(MakeInfo());
+  cache.Invalidate();
+  EXPECT_EQ(cache.processors_configured(), -1);
+  EXPECT_EQ(cache.processors_online(), -1);
+  std::vector<int> cpus;
+  EXPECT_FALSE(cache.GetCpuAffinity(&cpus));
+
+  EXPECT_EQ(cache.page_size(), 4096);
+  struct utsname name;
+  EXPECT_TRUE(cache.GetUname(&name));
+}
+
+TEST(HostInfoCacheTest, CachesValuesFetchedLater) {
+  HostInfoCache cache;
+  cache.set_processors_configured(16);
+  cache.set_processors_online(12);
+  cache.SetCpuAffinity({1, 5});
+  EXPECT_EQ(cache.processors_configured(), 16);
+  EXPECT_EQ(cache.processors_online(), 12);
+  std::vector<int> cpus;
+  ASSERT_TRUE(cache.GetCpuAffinity(&cpus));
+  EXPECT_EQ(cpus, std::vector<int>({1, 5}));
+}
+
+}  // namespace
+}  // namespace asylo
@@ -17,13 +17,50 @@
  */
 
 #include <ifaddrs.h>
+#include <atomic>
+#include <cstdint>
 #include <cstdlib>
 
+#include "asylo/platform/arch/include/trusted/enclave_interface.h"
 #include "asylo/platform/arch/include/trusted/host_calls.h"
+#include "asylo/platform/core/shared_name.h"
+#include "asylo/platform/posix/ifaddrs_cache.h"
+
+namespace {
+
+// Returns the counter of changes to the host's network interfaces published by
+// the host, or null if the host does not publish one.
+const std::atomic<uint64_t> *NetworkChangeCounter() {
+  static const std::atomic<uint64_t> *counter = [] {
+    void *addr = enc_untrusted_acquire_shared_resource(
+        kAddressName, "network_change_generation");
+    if (!addr ||
+        !enc_is_outside_enclave(addr, sizeof(std::atomic<uint64_t>))) {
+      return static_cast<const std::atomic<uint64_t> *>(nullptr);
+    }
+    return static_cast<const std::atomic<uint64_t> *>(addr);
+  }();
+  return counter;
+}
+
+}  // namespace
 
 extern "C" {
 
-int getifaddrs(struct ifaddrs **ifap) { return enc_untrusted_getifaddrs(ifap); }
+int getifaddrs(struct ifaddrs **ifap) {
+  const std::atomic<uint64_t> *counter = NetworkChangeCounter();
+  uint64_t generation =
+      counter ? counter->load(std::memory_order_acquire) : 0;
+  asylo::IfAddrsCache &cache = asylo::IfAddrsCache::GetInstance();
+  if (cache.Get(generation, ifap)) {
+    return 0;
+  }
+  int ret = enc_untrusted_getifaddrs(ifap);
+  if (ret == 0) {
+    cache.Set(generation, *ifap);
+  }
+  return ret;
+}
 
 void freeifaddrs(struct ifaddrs *ifa) { enc_untrusted_freeifaddrs(ifa); }
 
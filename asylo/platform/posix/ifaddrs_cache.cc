@@ -0,0 +1,58 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/posix/ifaddrs_cache.h"
+
+#include <cstdlib>
+
+#include "absl/strings/string_view.h"
+#include "asylo/platform/common/bridge_flat_serializer.h"
+
+namespace asylo {
+
+IfAddrsCache &IfAddrsCache::GetInstance() {
+  static IfAddrsCache *instance = new IfAddrsCache;
+  return *instance;
+}
+
+void IfAddrsCache::Set(uint64_t generation, const struct ifaddrs *list) {
+  if (generation == 0) {
+    return;
+  }
+  char *serialized = nullptr;
+  size_t length = 0;
+  if (!SerializeIfAddrs(list, &serialized, &length)) {
+    return;
+  }
+  absl::MutexLock lock(&mu_);
+  if (generation >= generation_) {
+    generation_ = generation;
+    snapshot_.assign(serialized, length);
+  }
+  free(serialized);
+}
+
+bool IfAddrsCache::Get(uint64_t generation, struct ifaddrs **list) const {
+  absl::ReaderMutexLock lock(&mu_);
+  if (generation == 0 || generation != generation_) {
+    return false;
+  }
+  return DeserializeIfAddrs(snapshot_, list);
+}
+
+}  // namespace asylo
@@ -0,0 +1,70 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_PLATFORM_POSIX_IFADDRS_CACHE_H_
+#define ASYLO_PLATFORM_POSIX_IFADDRS_CACHE_H_
+
+#include <ifaddrs.h>
+
+#include <cstdint>
+#include <string>
+
+#include "absl/synchronization/mutex.h"
+
+namespace asylo {
+
+// A snapshot of the host's network interfaces served inside the enclave, so
+// that repeated getifaddrs calls, such as those gRPC makes when resolving
+// wildcard listen addresses, do not leave the enclave each time.
+//
+// The host counts changes to its interfaces and their addresses in a
+// generation counter it publishes in untrusted memory. A snapshot is tagged
+// with the generation read before it was fetched from the host, and only
+// served while the counter still reads that generation. Generation zero means
+// the host does not detect changes, and is never cached.
+//
+// Like the lists getifaddrs returns from the host, snapshots are untrusted.
+// All methods are thread-safe.
+class IfAddrsCache {
+ public:
+  IfAddrsCache() = default;
+  IfAddrsCache(const IfAddrsCache &) = delete;
+  IfAddrsCache &operator=(const IfAddrsCache &) = delete;
+
+  // Returns the cache consulted by the enclave's getifaddrs.
+  static IfAddrsCache &GetInstance();
+
+  // Replaces the snapshot with a copy of |list|, fetched from the host after
+  // the change counter read |generation|. Does nothing if |generation| is zero
+  // or older than the cached snapshot.
+  void Set(uint64_t generation, const struct ifaddrs *list);
+
+  // Stores a copy of the snapshot in |*list| and returns true if one taken at
+  // the nonzero |generation| is cached, and returns false otherwise. The copy
+  // is released with freeifaddrs.
+  bool Get(uint64_t generation, struct ifaddrs **list) const;
+
+ private:
+  mutable absl::Mutex mu_;
+  uint64_t generation_ GUARDED_BY(mu_) = 0;
+  std::string snapshot_ GUARDED_BY(mu_);
+};
+
+}  // namespace asylo
+
+#endif  // ASYLO_PLATFORM_POSIX_IFADDRS_CACHE_H_
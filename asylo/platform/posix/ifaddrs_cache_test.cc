@@ -0,0 +1,109 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/posix/ifaddrs_cache.h"
+
+#include <ifaddrs.h>
+#include <net/if.h>
+#include <netinet/in.h>
+
+#include <cstring>
+
+#include <gtest/gtest.h>
+#include "asylo/platform/common/bridge_flat_serializer.h"
+
+namespace asylo {
+namespace {
+
+// A one-entry ifaddrs list for the loopback interface.
+class LoopbackList {
+ public:
+  LoopbackList() {
+    memset(&addr_, 0, sizeof(addr_));
+    addr_.sin_family = AF_INET;
+    addr_.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    memset(&entry_, 0, sizeof(entry_));
+    entry_.ifa_name = name_;
+    entry_.ifa_flags = IFF_UP | IFF_LOOPBACK;
+    entry_.ifa_addr = reinterpret_cast<struct sockaddr *>(&addr_);
+  }
+
+  const struct ifaddrs *get() const { return &entry_; }
+
+ private:
+  char name_[3] = "lo";
+  struct sockaddr_in addr_;
+  struct ifaddrs entry_;
+};
+
+TEST(IfAddrsCacheTest, EmptyCacheServesNothing) {
+  IfAddrsCache cache;
+  struct ifaddrs *list = nullptr;
+  EXPECT_FALSE(cache.Get(1, &list));
+  EXPECT_FALSE(cache.Get(0, &list));
+}
+
+TEST(IfAddrsCacheTest, ServesCopyAtSameGeneration) {
+  IfAddrsCache cache;
+  LoopbackList loopback;
+  cache.Set(3, loopback.get());
+
+  struct ifaddrs *list = nullptr;
+  ASSERT_TRUE(cache.Get(3, &list));
+  ASSERT_NE(list, nullptr);
+  EXPECT_NE(list, loopback.get());
+  EXPECT_STREQ(list->ifa_name, "lo");
+  EXPECT_EQ(list->ifa_next, nullptr);
+  ASSERT_NE(list->ifa_addr, nullptr);
+  EXPECT_EQ(reinterpret_cast<struct sockaddr_in *>(list->ifa_addr)
+                ->sin_addr.s_addr,
+            htonl(INADDR_LOOPBACK));
+  FreeDeserializedIfAddrs(list);
+}
+
+TEST(IfAddrsCacheTest, ChangedGenerationMisses) {
+  IfAddrsCache cache;
+  LoopbackList loopback;
+  cache.Set(3, loopback.get());
+
+  struct ifaddrs *list = nullptr;
+  EXPECT_FALSE(cache.Get(4, &list));
+  EXPECT_FALSE(cache.Get(2, &list));
+
+  // A snapshot fetched at an older generation does not replace a newer one.
+  cache.Set(2, nullptr);
+  ASSERT_TRUE(cache.Get(3, &list));
+  EXPECT_NE(list, nullptr);
+  FreeDeserializedIfAddrs(list);
+
+  cache.Set(4, nullptr);
+  ASSERT_TRUE(cache.Get(4, &list));
+  EXPECT_EQ(list, nullptr);
+}
+
+TEST(IfAddrsCacheTest, GenerationZeroIsNeverCached) {
+  IfAddrsCache cache;
+  LoopbackList loopback;
+  cache.Set(0, loopback.get());
+
+  struct ifaddrs *list = nullptr;
+  EXPECT_FALSE(cache.Get(0, &list));
+}
+
+}  // namespace
+}  // namespace asylo
@@ -23,9 +23,39 @@
 // <fcntl.h>, in order to complement redirection to <sys/fcntl.h> with
 // enclave-specific extensions to POSIX definitions.
 #include <sys/fcntl.h>
+#include <sys/types.h>
 
 #define O_SECURE 0x80000000
+
+// Together with O_SECURE, creates an unnamed secure file in the directory that
+// is opened, which is encrypted under a key held only in the enclave and does
+// not outlive the file descriptor. Not supported without O_SECURE.
+#define O_TMPFILE 0x40000000
+
+// Together with O_SECURE, creates a secure file whose data is stored in
+// plaintext and only authenticated, for data that needs integrity but not
+// confidentiality. Existing files must be opened in the mode they were created
+// with. Not supported without O_SECURE, nor with O_TMPFILE.
+#define O_INTEGRITY_ONLY 0x20000000
 #undef O_NONBLOCK
 #define O_NONBLOCK 04000
 
+// Flags accepted by splice. The values match those of the Linux host, so they
+// are passed across the enclave boundary unchanged.
+#define SPLICE_F_MOVE 1
+#define SPLICE_F_NONBLOCK 2
+#define SPLICE_F_MORE 4
+#define SPLICE_F_GIFT 8
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+ssize_t splice(int fd_in, off_t *off_in, int fd_out, off_t *off_out,
+               size_t len, unsigned int flags);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
 #endif  // ASYLO_PLATFORM_POSIX_INCLUDE_FCNTL_H_
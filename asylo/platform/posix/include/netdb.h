@@ -34,6 +34,20 @@ const char *gai_strerror(int ecode);
 #define AI_CANONNAME 0x0002
 #define AI_NUMERICHOST 0x0004
 
+/* Error values returned by 'getaddrinfo'. These match the values used by the
+   host, which are passed through unchanged. */
+#define EAI_BADFLAGS -1
+#define EAI_NONAME -2
+#define EAI_AGAIN -3
+#define EAI_FAIL -4
+#define EAI_NODATA -5
+#define EAI_FAMILY -6
+#define EAI_SOCKTYPE -7
+#define EAI_SERVICE -8
+#define EAI_MEMORY -10
+#define EAI_SYSTEM -11
+#define EAI_OVERFLOW -12
+
 // Description of data base entry for a single host.
 struct hostent {
   char *h_name;                // Official name of host.
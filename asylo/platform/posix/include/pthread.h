@@ -0,0 +1,41 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_PLATFORM_POSIX_INCLUDE_PTHREAD_H_
+#define ASYLO_PLATFORM_POSIX_INCLUDE_PTHREAD_H_
+
+#include_next <pthread.h>
+
+#include <sched.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Set and get the CPU affinity of the host thread running |thread|, which must
+// be the calling thread. Return ENOSYS for any other thread.
+int pthread_setaffinity_np(pthread_t thread, size_t cpusetsize,
+                           const cpu_set_t *cpuset);
+int pthread_getaffinity_np(pthread_t thread, size_t cpusetsize,
+                           cpu_set_t *cpuset);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
+#endif  // ASYLO_PLATFORM_POSIX_INCLUDE_PTHREAD_H_
@@ -53,6 +53,12 @@ typedef CpuSet cpu_set_t;
 // translates that to the enclave's cpu_set_t type (defined above).
 int sched_getaffinity(pid_t pid, size_t cpusetsize, cpu_set_t *mask);
 
+// Calls sched_setaffinity() on the host. A |pid| of zero sets the affinity of
+// the host thread running the calling enclave thread. The affinity
+// sched_getaffinity() reports for a |pid| of zero is that of the process, and
+// is not changed.
+int sched_setaffinity(pid_t pid, size_t cpusetsize, const cpu_set_t *mask);
+
 // Implemented as call to host sched_yield().
 int sched_yield(void);
 
@@ -0,0 +1,68 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_PLATFORM_POSIX_INCLUDE_SEMAPHORE_H_
+#define ASYLO_PLATFORM_POSIX_INCLUDE_SEMAPHORE_H_
+
+#include <limits.h>
+#include <pthread.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SEM_VALUE_MAX INT_MAX
+
+// An unnamed counting semaphore. Semaphores may only be shared between threads
+// of the same enclave.
+typedef struct {
+  uint32_t _count;
+  uint32_t _waiters;
+  pthread_spinlock_t _lock;
+  __pthread_list_t _queue;
+} sem_t;
+
+// Initializes |sem| with |value|. Returns -1 and sets errno to ENOSYS if
+// |pshared| is non-zero, or to EINVAL if |value| exceeds SEM_VALUE_MAX.
+int sem_init(sem_t *sem, int pshared, unsigned int value);
+
+// Destroys |sem|. Returns -1 and sets errno to EBUSY if threads are waiting on
+// |sem|.
+int sem_destroy(sem_t *sem);
+
+// Decrements |sem|, first spinning and then sleeping on the host while its
+// value is zero.
+int sem_wait(sem_t *sem);
+
+// Decrements |sem| if its value is non-zero, otherwise returns -1 and sets
+// errno to EAGAIN.
+int sem_trywait(sem_t *sem);
+
+// Increments |sem| and wakes a waiter, if any. Returns -1 and sets errno to
+// EOVERFLOW if the value would exceed SEM_VALUE_MAX.
+int sem_post(sem_t *sem);
+
+// Stores the value of |sem| in |*value|.
+int sem_getvalue(sem_t *sem, int *value);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
+#endif  // ASYLO_PLATFORM_POSIX_INCLUDE_SEMAPHORE_H_
@@ -31,6 +31,29 @@
 // IOCTL to set a key on a secure file.
 #define ENCLAVE_STORAGE_SET_KEY (ENCLAVE_STORAGE_IOCTL_TYPE | 0x00000001)
 
+// IOCTL to select the block length of a newly created secure file. Takes a
+// pointer to a uint32_t holding 128, 4096 or 65536, and must precede
+// ENCLAVE_STORAGE_SET_KEY.
+#define ENCLAVE_STORAGE_SET_BLOCK_SIZE (ENCLAVE_STORAGE_IOCTL_TYPE | 0x00000002)
+
+// IOCTL to select whether the digest of a secure file is written on every
+// write even if the enclave defers digest updates. Takes a pointer to a
+// uint32_t which is nonzero to write the digest on every write.
+#define ENCLAVE_STORAGE_SET_DIGEST_WRITE_THROUGH \
+  (ENCLAVE_STORAGE_IOCTL_TYPE | 0x00000003)
+
+// IOCTL to start or resume re-encrypting a secure file under a new key. Takes
+// a pointer to a key_info holding the new key.
+#define ENCLAVE_STORAGE_BEGIN_KEY_ROTATION \
+  (ENCLAVE_STORAGE_IOCTL_TYPE | 0x00000004)
+
+// IOCTL to re-encrypt the next blocks of a secure file under the key of its
+// rotation. Takes a pointer to an int64_t holding the maximum number of blocks
+// to re-encrypt, which receives the number of blocks left, zero once the
+// rotation is complete.
+#define ENCLAVE_STORAGE_ROTATE_KEY_STEP \
+  (ENCLAVE_STORAGE_IOCTL_TYPE | 0x00000005)
+
 #define TIOCGWINSZ 0x5413
 
 struct winsize {
@@ -63,7 +63,17 @@ struct msghdr {
   int msg_flags;
 };
 
+// A message sent by sendmmsg or received by recvmmsg, along with the number
+// of bytes transferred for it.
+struct mmsghdr {
+  struct msghdr msg_hdr;
+  unsigned int msg_len;
+};
+
+struct timespec;
+
 int accept(int sockfd, struct sockaddr *addr, socklen_t *addrlen);
+int accept4(int sockfd, struct sockaddr *addr, socklen_t *addrlen, int flags);
 int bind(int sockfd, const struct sockaddr *addr, socklen_t addrlen);
 int connect(int sockfd, const struct sockaddr *addr, socklen_t addrlen);
 
@@ -93,9 +103,16 @@ ssize_t recvfrom(int sockfd, void *buf, size_t len, int flags,
 // No implemention provided.
 ssize_t recvmsg(int sockfd, struct msghdr *msg, int flags);
 
+// Receives up to |vlen| messages with a single host call.
+int recvmmsg(int sockfd, struct mmsghdr *msgvec, unsigned int vlen, int flags,
+             struct timespec *timeout);
+
 ssize_t send(int sockfd, const void *buf, size_t len, int flags);
 ssize_t sendmsg(int sockfd, const struct msghdr *msg, int flags);
 
+// Sends up to |vlen| messages with a single host call.
+int sendmmsg(int sockfd, struct mmsghdr *msgvec, unsigned int vlen, int flags);
+
 int setsockopt(int socket, int level, int option_name, const void *option_value,
                socklen_t option_len);
 
@@ -103,6 +120,10 @@ int setsockopt(int socket, int level, int option_name, const void *option_value,
 int shutdown(int sockfd, int how);
 int socket(int domain, int type, int protocol);
 
+// Creates a pair of connected AF_UNIX stream sockets kept inside the enclave.
+// |type| must hold SOCK_SECURE.
+int socketpair(int domain, int type, int protocol, int sv[2]);
+
 // For setsockopt(2)
 #define SOL_SOCKET 1
 
@@ -297,6 +318,8 @@ enum {
 #define SOCK_CLOEXEC 02000000
 // Atomically mark descriptor(s) as non-blocking.
 #define SOCK_NONBLOCK 00004000
+// Keep the socket pair inside the enclave. Has the value of O_SECURE.
+#define SOCK_SECURE 0x80000000
 
 #define SOL_SOCKET 1
 #define SO_REUSEADDR 2
@@ -0,0 +1,47 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_PLATFORM_POSIX_INCLUDE_UNISTD_H_
+#define ASYLO_PLATFORM_POSIX_INCLUDE_UNISTD_H_
+
+// This header file is a redirect file that replaces newlib's redirect file
+// <unistd.h>, in order to complement redirection to <sys/unistd.h> with
+// enclave-specific extensions to POSIX definitions.
+#include <sys/unistd.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+ssize_t pread(int fd, void *buf, size_t count, off_t offset);
+ssize_t pwrite(int fd, const void *buf, size_t count, off_t offset);
+
+// Creates a host pipe like pipe(). With O_SECURE in |flags|, the pipe is
+// instead kept inside the enclave, so its data never reaches the host. The
+// ends of such a pipe may be polled, but not registered with epoll or used
+// with splice or sendfile.
+int pipe2(int pipefd[2], int flags);
+
+ssize_t copy_file_range(int fd_in, off_t *off_in, int fd_out, off_t *off_out,
+                        size_t len, unsigned int flags);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
+#endif  // ASYLO_PLATFORM_POSIX_INCLUDE_UNISTD_H_
@@ -0,0 +1,106 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/posix/io/attribute_cache.h"
+
+namespace asylo {
+namespace io {
+
+void AttributeCache::Track(const void *handle, absl::string_view path) {
+  absl::MutexLock lock(&mu_);
+  Entry &entry = entries_[handle];
+  entry.path.assign(path.data(), path.size());
+  entry.valid = false;
+}
+
+void AttributeCache::Untrack(const void *handle) {
+  absl::MutexLock lock(&mu_);
+  entries_.erase(handle);
+}
+
+bool AttributeCache::IsTracked(const void *handle) const {
+  absl::MutexLock lock(&mu_);
+  return entries_.count(handle) != 0;
+}
+
+bool AttributeCache::Lookup(const void *handle, struct stat *st,
+                            uint64_t *generation) const {
+  absl::MutexLock lock(&mu_);
+  auto it = entries_.find(handle);
+  if (it == entries_.end()) {
+    *generation = 0;
+    return false;
+  }
+  if (!it->second.valid) {
+    *generation = it->second.generation;
+    return false;
+  }
+  *st = it->second.st;
+  return true;
+}
+
+void AttributeCache::Insert(const void *handle, const struct stat &st,
+                            uint64_t generation) {
+  absl::MutexLock lock(&mu_);
+  auto it = entries_.find(handle);
+  if (it == entries_.end() || it->second.generation != generation) {
+    return;
+  }
+  it->second.st = st;
+  it->second.valid = true;
+}
+
+bool AttributeCache::LookupPath(absl::string_view path,
+                                struct stat *st) const {
+  absl::MutexLock lock(&mu_);
+  for (const auto &it : entries_) {
+    if (it.second.valid && it.second.path == path) {
+      *st = it.second.st;
+      return true;
+    }
+  }
+  return false;
+}
+
+void AttributeCache::Invalidate(const void *handle) {
+  absl::MutexLock lock(&mu_);
+  auto it = entries_.find(handle);
+  if (it == entries_.end()) {
+    return;
+  }
+  // Copy the path, since the loop below also resets this entry.
+  std::string path = it->second.path;
+  InvalidatePathLocked(path);
+}
+
+void AttributeCache::InvalidatePath(absl::string_view path) {
+  absl::MutexLock lock(&mu_);
+  InvalidatePathLocked(path);
+}
+
+void AttributeCache::InvalidatePathLocked(absl::string_view path) {
+  for (auto &it : entries_) {
+    if (it.second.path == path) {
+      it.second.valid = false;
+      it.second.generation++;
+    }
+  }
+}
+
+}  // namespace io
+}  // namespace asylo
@@ -0,0 +1,101 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_PLATFORM_POSIX_IO_ATTRIBUTE_CACHE_H_
+#define ASYLO_PLATFORM_POSIX_IO_ATTRIBUTE_CACHE_H_
+
+#include <sys/stat.h>
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+
+#include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
+
+namespace asylo {
+namespace io {
+
+// Caches the attributes of open files whose contents only change through the
+// enclave, such as secure files, so that repeated fstat and stat calls on them
+// do not leave the enclave.
+//
+// An open file is identified by an opaque handle, the address of its
+// IOContext, which is shared by all file descriptors duplicated from it. Each
+// tracked file is also indexed by its canonical path, so that stat on the path
+// of an open file is served from the same entry. Writing to a file invalidates
+// the attributes of every open file with the same path. All methods are
+// thread-safe.
+class AttributeCache {
+ public:
+  AttributeCache() = default;
+  AttributeCache(const AttributeCache &) = delete;
+  AttributeCache &operator=(const AttributeCache &) = delete;
+
+  // Starts tracking the open file |handle| at the canonical |path|. Attributes
+  // are only cached for tracked files.
+  void Track(const void *handle, absl::string_view path);
+
+  // Stops tracking |handle| and forgets its attributes, when it is closed.
+  void Untrack(const void *handle);
+
+  // Returns whether |handle| is tracked.
+  bool IsTracked(const void *handle) const;
+
+  // Copies the cached attributes of |handle| to |st| and returns true, or
+  // returns false if none are cached. On a miss, |*generation| is set to the
+  // value to pass to Insert once the attributes are fetched.
+  bool Lookup(const void *handle, struct stat *st, uint64_t *generation) const;
+
+  // Stores the attributes |st| of the tracked file |handle|, fetched after a
+  // Lookup which returned |generation|. Does nothing if |handle| is not
+  // tracked or was invalidated since, in which case |st| may be stale.
+  void Insert(const void *handle, const struct stat &st, uint64_t generation);
+
+  // Copies the cached attributes of an open file at the canonical |path| to
+  // |st| and returns true, or returns false if none are cached.
+  bool LookupPath(absl::string_view path, struct stat *st) const;
+
+  // Forgets the attributes of every open file with the same path as |handle|,
+  // after |handle| is written to.
+  void Invalidate(const void *handle);
+
+  // Forgets the attributes of every open file at the canonical |path|, after
+  // the file at |path| is changed or replaced by path.
+  void InvalidatePath(absl::string_view path);
+
+ private:
+  struct Entry {
+    std::string path;
+    bool valid = false;
+    uint64_t generation = 0;
+    struct stat st;
+  };
+
+  // Forgets the attributes of every open file at |path|.
+  void InvalidatePathLocked(absl::string_view path)
+      EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  mutable absl::Mutex mu_;
+  std::unordered_map<const void *, Entry> entries_ GUARDED_BY(mu_);
+};
+
+}  // namespace io
+}  // namespace asylo
+
+#endif  // ASYLO_PLATFORM_POSIX_IO_ATTRIBUTE_CACHE_H_
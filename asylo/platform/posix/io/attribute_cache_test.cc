@@ -0,0 +1,120 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/posix/io/attribute_cache.h"
+
+#include <sys/stat.h>
+
+#include <cstdint>
+
+#include <gtest/gtest.h>
+
+namespace asylo {
+namespace io {
+namespace {
+
+struct stat StatWithSize(off_t size) {
+  struct stat st = {};
+  st.st_size = size;
+  return st;
+}
+
+// Fetches the attributes of |handle| through |cache|, as IOManager does,
+// storing |fetched| on a miss. Returns the size seen.
+off_t FStat(AttributeCache *cache, const void *handle, off_t fetched) {
+  struct stat st;
+  uint64_t generation;
+  if (cache->Lookup(handle, &st, &generation)) {
+    return st.st_size;
+  }
+  cache->Insert(handle, StatWithSize(fetched), generation);
+  return fetched;
+}
+
+TEST(AttributeCacheTest, CachesOnlyTrackedFiles) {
+  AttributeCache cache;
+  int tracked, untracked;
+  cache.Track(&tracked, "/secure/a");
+  EXPECT_EQ(FStat(&cache, &tracked, 10), 10);
+  EXPECT_EQ(FStat(&cache, &tracked, 20), 10);
+  EXPECT_EQ(FStat(&cache, &untracked, 10), 10);
+  EXPECT_EQ(FStat(&cache, &untracked, 20), 20);
+  EXPECT_TRUE(cache.IsTracked(&tracked));
+  EXPECT_FALSE(cache.IsTracked(&untracked));
+}
+
+TEST(AttributeCacheTest, LookupByPath) {
+  AttributeCache cache;
+  int handle;
+  cache.Track(&handle, "/secure/a");
+  struct stat st;
+  EXPECT_FALSE(cache.LookupPath("/secure/a", &st));
+  FStat(&cache, &handle, 10);
+  ASSERT_TRUE(cache.LookupPath("/secure/a", &st));
+  EXPECT_EQ(st.st_size, 10);
+  EXPECT_FALSE(cache.LookupPath("/secure/b", &st));
+}
+
+// Tests that a write through one file invalidates every open file at the same
+// path, but not files at other paths.
+TEST(AttributeCacheTest, WriteInvalidatesSamePath) {
+  AttributeCache cache;
+  int writer, reader, other;
+  cache.Track(&writer, "/secure/a");
+  cache.Track(&reader, "/secure/a");
+  cache.Track(&other, "/secure/b");
+  FStat(&cache, &writer, 10);
+  FStat(&cache, &reader, 10);
+  FStat(&cache, &other, 30);
+
+  cache.Invalidate(&writer);
+  EXPECT_EQ(FStat(&cache, &reader, 20), 20);
+  EXPECT_EQ(FStat(&cache, &writer, 20), 20);
+  EXPECT_EQ(FStat(&cache, &other, 40), 30);
+
+  cache.InvalidatePath("/secure/b");
+  EXPECT_EQ(FStat(&cache, &other, 40), 40);
+}
+
+// Tests that attributes fetched before an invalidation are not stored.
+TEST(AttributeCacheTest, StaleInsertIsDropped) {
+  AttributeCache cache;
+  int handle;
+  cache.Track(&handle, "/secure/a");
+  struct stat st;
+  uint64_t generation;
+  ASSERT_FALSE(cache.Lookup(&handle, &st, &generation));
+  cache.Invalidate(&handle);
+  cache.Insert(&handle, StatWithSize(10), generation);
+  EXPECT_FALSE(cache.Lookup(&handle, &st, &generation));
+}
+
+TEST(AttributeCacheTest, UntrackForgetsFile) {
+  AttributeCache cache;
+  int handle;
+  cache.Track(&handle, "/secure/a");
+  FStat(&cache, &handle, 10);
+  cache.Untrack(&handle);
+  struct stat st;
+  EXPECT_FALSE(cache.LookupPath("/secure/a", &st));
+  EXPECT_EQ(FStat(&cache, &handle, 20), 20);
+}
+
+}  // namespace
+}  // namespace io
+}  // namespace asylo
@@ -0,0 +1,342 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/posix/io/enclave_pipe.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+
+namespace asylo {
+namespace io {
+namespace {
+
+// Registration of a poll waiter with the buffers of an enclave pipe end, which
+// keeps them alive in case the end is closed during the poll.
+class EnclavePipePollRegistration : public IOManager::PollRegistration {
+ public:
+  EnclavePipePollRegistration(std::shared_ptr<EnclavePipeBuffer> in,
+                              std::shared_ptr<EnclavePipeBuffer> out,
+                              IOManager::PollWaiter *waiter)
+      : in_(std::move(in)), out_(std::move(out)), waiter_(waiter) {
+    if (in_) {
+      in_->AddPollWaiter(waiter_);
+    }
+    if (out_) {
+      out_->AddPollWaiter(waiter_);
+    }
+  }
+
+  ~EnclavePipePollRegistration() override {
+    if (in_) {
+      in_->RemovePollWaiter(waiter_);
+    }
+    if (out_) {
+      out_->RemovePollWaiter(waiter_);
+    }
+  }
+
+ private:
+  std::shared_ptr<EnclavePipeBuffer> in_;
+  std::shared_ptr<EnclavePipeBuffer> out_;
+  IOManager::PollWaiter *waiter_;
+};
+
+}  // namespace
+
+ssize_t EnclavePipeBuffer::Read(void *buf, size_t count, bool nonblocking) {
+  if (count == 0) {
+    return 0;
+  }
+
+  absl::MutexLock lock(&lock_);
+  while (ring_.empty()) {
+    if (ring_.is_closed_for_write()) {
+      return 0;
+    }
+    if (nonblocking) {
+      errno = EAGAIN;
+      return -1;
+    }
+    readable_.Wait(&lock_);
+  }
+
+  // The ring holds at least as many bytes as are requested here, so the read
+  // does not block.
+  size_t size = std::min(count, ring_.size());
+  size_t ret = ring_.Read(static_cast<uint8_t *>(buf), size);
+  writable_.SignalAll();
+  NotifyPollWaiters();
+  return ret;
+}
+
+ssize_t EnclavePipeBuffer::Write(const void *buf, size_t count,
+                                 bool nonblocking) {
+  const uint8_t *bytes = static_cast<const uint8_t *>(buf);
+  // A small write waits for room for all of its bytes, so it is not split.
+  size_t needed = count <= kEnclavePipeAtomicWrite ? count : 1;
+  size_t written = 0;
+
+  absl::MutexLock lock(&lock_);
+  while (written < count) {
+    if (ring_.is_closed_for_read()) {
+      if (written > 0) {
+        return written;
+      }
+      errno = EPIPE;
+      return -1;
+    }
+    if (ring_.available() < std::min(needed, count - written)) {
+      if (nonblocking) {
+        if (written > 0) {
+          return written;
+        }
+        errno = EAGAIN;
+        return -1;
+      }
+      writable_.Wait(&lock_);
+      continue;
+    }
+
+    size_t size = std::min(count - written, ring_.available());
+    written += ring_.Write(bytes + written, size);
+    readable_.SignalAll();
+    NotifyPollWaiters();
+  }
+  return written;
+}
+
+void EnclavePipeBuffer::CloseReadEnd() {
+  absl::MutexLock lock(&lock_);
+  ring_.close_for_read();
+  writable_.SignalAll();
+  NotifyPollWaiters();
+}
+
+void EnclavePipeBuffer::CloseWriteEnd() {
+  absl::MutexLock lock(&lock_);
+  ring_.close_for_write();
+  readable_.SignalAll();
+  NotifyPollWaiters();
+}
+
+short EnclavePipeBuffer::ReadEvents() {
+  absl::MutexLock lock(&lock_);
+  short events = 0;
+  if (!ring_.empty()) {
+    events |= POLLIN | POLLRDNORM;
+  }
+  if (ring_.is_closed_for_write()) {
+    events |= POLLHUP;
+  }
+  return events;
+}
+
+short EnclavePipeBuffer::WriteEvents() {
+  absl::MutexLock lock(&lock_);
+  if (ring_.is_closed_for_read()) {
+    return POLLERR;
+  }
+  return ring_.available() >= kEnclavePipeAtomicWrite ? POLLOUT | POLLWRNORM
+                                                      : 0;
+}
+
+void EnclavePipeBuffer::AddPollWaiter(IOManager::PollWaiter *waiter) {
+  absl::MutexLock lock(&lock_);
+  poll_waiters_.push_back(waiter);
+}
+
+void EnclavePipeBuffer::RemovePollWaiter(IOManager::PollWaiter *waiter) {
+  absl::MutexLock lock(&lock_);
+  poll_waiters_.erase(
+      std::remove(poll_waiters_.begin(), poll_waiters_.end(), waiter),
+      poll_waiters_.end());
+}
+
+void EnclavePipeBuffer::NotifyPollWaiters() {
+  for (IOManager::PollWaiter *waiter : poll_waiters_) {
+    waiter->Notify();
+  }
+}
+
+IOContextEnclavePipe::IOContextEnclavePipe(
+    std::shared_ptr<EnclavePipeBuffer> in,
+    std::shared_ptr<EnclavePipeBuffer> out, bool is_socket, int status_flags,
+    int descriptor_flags)
+    : in_(std::move(in)),
+      out_(std::move(out)),
+      is_socket_(is_socket),
+      status_flags_(status_flags & O_NONBLOCK),
+      descriptor_flags_(descriptor_flags & FD_CLOEXEC) {}
+
+bool IOContextEnclavePipe::nonblocking() const {
+  return (status_flags_.load(std::memory_order_relaxed) & O_NONBLOCK) != 0;
+}
+
+ssize_t IOContextEnclavePipe::Read(void *buf, size_t count) {
+  if (!in_) {
+    errno = EBADF;
+    return -1;
+  }
+  return in_->Read(buf, count, nonblocking());
+}
+
+ssize_t IOContextEnclavePipe::Write(const void *buf, size_t count) {
+  if (!out_) {
+    errno = EBADF;
+    return -1;
+  }
+  return out_->Write(buf, count, nonblocking());
+}
+
+int IOContextEnclavePipe::Close() {
+  if (in_) {
+    in_->CloseReadEnd();
+  }
+  if (out_) {
+    out_->CloseWriteEnd();
+  }
+  return 0;
+}
+
+int IOContextEnclavePipe::FCntl(int cmd, int64_t arg) {
+  switch (cmd) {
+    case F_GETFL: {
+      int access_mode = in_ && out_ ? O_RDWR : in_ ? O_RDONLY : O_WRONLY;
+      return access_mode | status_flags_.load(std::memory_order_relaxed);
+    }
+    case F_SETFL:
+      status_flags_.store(arg & O_NONBLOCK, std::memory_order_relaxed);
+      return 0;
+    case F_GETFD:
+      return descriptor_flags_.load(std::memory_order_relaxed);
+    case F_SETFD:
+      descriptor_flags_.store(arg & FD_CLOEXEC, std::memory_order_relaxed);
+      return 0;
+    default:
+      errno = EINVAL;
+      return -1;
+  }
+}
+
+int IOContextEnclavePipe::FStat(struct stat *st) {
+  memset(st, 0, sizeof(*st));
+  st->st_mode = (is_socket_ ? S_IFSOCK : S_IFIFO) | S_IRUSR | S_IWUSR;
+  st->st_nlink = 1;
+  st->st_blksize = kEnclavePipeAtomicWrite;
+  return 0;
+}
+
+ssize_t IOContextEnclavePipe::Writev(const struct iovec *iov, int iovcnt) {
+  ssize_t total = 0;
+  for (int i = 0; i < iovcnt; ++i) {
+    ssize_t ret = Write(iov[i].iov_base, iov[i].iov_len);
+    if (ret < 0) {
+      return total > 0 ? total : -1;
+    }
+    total += ret;
+    if (static_cast<size_t>(ret) < iov[i].iov_len) {
+      break;
+    }
+  }
+  return total;
+}
+
+ssize_t IOContextEnclavePipe::Readv(const struct iovec *iov, int iovcnt) {
+  if (!in_) {
+    errno = EBADF;
+    return -1;
+  }
+
+  // Only the first non-empty buffer waits for data; the rest take what is
+  // already in the pipe.
+  ssize_t total = 0;
+  for (int i = 0; i < iovcnt; ++i) {
+    if (iov[i].iov_len == 0) {
+      continue;
+    }
+    ssize_t ret = in_->Read(iov[i].iov_base, iov[i].iov_len,
+                            nonblocking() || total > 0);
+    if (ret < 0) {
+      return total > 0 ? total : -1;
+    }
+    total += ret;
+    if (static_cast<size_t>(ret) < iov[i].iov_len) {
+      break;
+    }
+  }
+  return total;
+}
+
+int IOContextEnclavePipe::Shutdown(int how) {
+  if (!is_socket_) {
+    errno = ENOTSOCK;
+    return -1;
+  }
+  if (how != SHUT_RD && how != SHUT_WR && how != SHUT_RDWR) {
+    errno = EINVAL;
+    return -1;
+  }
+  if (how != SHUT_WR) {
+    in_->CloseReadEnd();
+  }
+  if (how != SHUT_RD) {
+    out_->CloseWriteEnd();
+  }
+  return 0;
+}
+
+ssize_t IOContextEnclavePipe::Send(const void *buf, size_t len, int flags) {
+  if (!is_socket_) {
+    errno = ENOTSOCK;
+    return -1;
+  }
+  if (flags & ~(MSG_DONTWAIT | MSG_NOSIGNAL)) {
+    errno = EOPNOTSUPP;
+    return -1;
+  }
+  return out_->Write(buf, len, nonblocking() || (flags & MSG_DONTWAIT));
+}
+
+short IOContextEnclavePipe::PollEvents(short events) {
+  short revents = 0;
+  if (in_) {
+    revents |= in_->ReadEvents();
+  }
+  if (out_) {
+    revents |= out_->WriteEvents();
+  }
+  return revents & (events | POLLERR | POLLHUP);
+}
+
+std::unique_ptr<IOManager::PollRegistration>
+IOContextEnclavePipe::AddPollWaiter(IOManager::PollWaiter *waiter) {
+  return std::unique_ptr<IOManager::PollRegistration>(
+      new EnclavePipePollRegistration(in_, out_, waiter));
+}
+
+}  // namespace io
+}  // namespace asylo
@@ -0,0 +1,145 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_PLATFORM_POSIX_IO_ENCLAVE_PIPE_H_
+#define ASYLO_PLATFORM_POSIX_IO_ENCLAVE_PIPE_H_
+
+#include <sys/types.h>
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#include "absl/synchronization/mutex.h"
+#include "asylo/platform/common/ring_buffer.h"
+#include "asylo/platform/posix/io/io_manager.h"
+
+namespace asylo {
+namespace io {
+
+// Number of bytes an enclave pipe holds, the default capacity of a Linux pipe.
+constexpr size_t kEnclavePipeCapacity = 65536;
+
+// Writes of at most this many bytes to an enclave pipe are never interleaved
+// with other writes. This is PIPE_BUF, as on Linux.
+constexpr size_t kEnclavePipeAtomicWrite = 4096;
+
+// A one-way stream of bytes between threads of the same enclave. Its data is
+// kept in trusted memory and never passes through the host.
+//
+// RingBuffer supports a single reader and a single writer, so any number of
+// readers and writers are serialized by a mutex, under which the ring is never
+// read while empty or written while full. Blocked readers and writers sleep on
+// condition variables rather than spinning, and threads in poll(2) are woken
+// through the PollWaiters registered with the pipe.
+class EnclavePipeBuffer {
+ public:
+  EnclavePipeBuffer() = default;
+  EnclavePipeBuffer(const EnclavePipeBuffer &) = delete;
+  EnclavePipeBuffer &operator=(const EnclavePipeBuffer &) = delete;
+
+  // Reads up to |count| bytes into |buf|, waiting for data unless
+  // |nonblocking|. Returns the number of bytes read, 0 once the pipe is empty
+  // and its write end is closed, or -1 with errno set to EAGAIN.
+  ssize_t Read(void *buf, size_t count, bool nonblocking);
+
+  // Writes |count| bytes from |buf|, waiting for room unless |nonblocking|.
+  // Returns the number of bytes written, or -1 with errno set to EAGAIN if
+  // nothing could be written without blocking, or to EPIPE if the read end is
+  // closed.
+  ssize_t Write(const void *buf, size_t count, bool nonblocking);
+
+  // Marks the read end closed, failing current and future writes.
+  void CloseReadEnd();
+
+  // Marks the write end closed. Readers drain the remaining data and then see
+  // end of stream.
+  void CloseWriteEnd();
+
+  // Returns the poll(2) events of the read end of the pipe.
+  short ReadEvents();
+
+  // Returns the poll(2) events of the write end of the pipe.
+  short WriteEvents();
+
+  // Registers |waiter| to be notified whenever the events of either end of the
+  // pipe may have changed, until it is passed to RemovePollWaiter.
+  void AddPollWaiter(IOManager::PollWaiter *waiter);
+  void RemovePollWaiter(IOManager::PollWaiter *waiter);
+
+ private:
+  // Notifies the registered poll waiters.
+  void NotifyPollWaiters() EXCLUSIVE_LOCKS_REQUIRED(lock_);
+
+  absl::Mutex lock_;
+
+  // Signaled when data is written or the write end is closed.
+  absl::CondVar readable_;
+
+  // Signaled when data is read or the read end is closed.
+  absl::CondVar writable_;
+
+  RingBuffer<kEnclavePipeCapacity> ring_ GUARDED_BY(lock_);
+
+  std::vector<IOManager::PollWaiter *> poll_waiters_ GUARDED_BY(lock_);
+};
+
+// IOContext implementation for an end of a pipe or socket pair created inside
+// the enclave. A pipe end holds either an input or an output buffer, and a
+// socket end holds both, sharing each with its peer.
+//
+// These contexts are not backed by a host file descriptor, so they may be
+// polled but not registered with epoll, splice or sendfile.
+class IOContextEnclavePipe : public IOManager::IOContext {
+ public:
+  // Creates an end reading from |in| and writing to |out|, either of which may
+  // be null. |is_socket| selects socket rather than pipe semantics for calls
+  // such as send and shutdown. |status_flags| may hold O_NONBLOCK and
+  // |descriptor_flags| may hold FD_CLOEXEC.
+  IOContextEnclavePipe(std::shared_ptr<EnclavePipeBuffer> in,
+                       std::shared_ptr<EnclavePipeBuffer> out, bool is_socket,
+                       int status_flags, int descriptor_flags);
+
+  ssize_t Read(void *buf, size_t count) override;
+  ssize_t Write(const void *buf, size_t count) override;
+  int Close() override;
+  int FCntl(int cmd, int64_t arg) override;
+  int FStat(struct stat *st) override;
+  ssize_t Writev(const struct iovec *iov, int iovcnt) override;
+  ssize_t Readv(const struct iovec *iov, int iovcnt) override;
+  int Shutdown(int how) override;
+  ssize_t Send(const void *buf, size_t len, int flags) override;
+  short PollEvents(short events) override;
+  std::unique_ptr<IOManager::PollRegistration> AddPollWaiter(
+      IOManager::PollWaiter *waiter) override;
+
+ private:
+  bool nonblocking() const;
+
+  std::shared_ptr<EnclavePipeBuffer> in_;
+  std::shared_ptr<EnclavePipeBuffer> out_;
+  const bool is_socket_;
+  std::atomic<int> status_flags_;
+  std::atomic<int> descriptor_flags_;
+};
+
+}  // namespace io
+}  // namespace asylo
+
+#endif  // ASYLO_PLATFORM_POSIX_IO_ENCLAVE_PIPE_H_
@@ -0,0 +1,214 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace asylo {
+namespace {
+
+class EnclavePipeTest : public ::testing::Test {
+ protected:
+  void SetUp() override { ASSERT_EQ(pipe2(fds_, O_SECURE), 0); }
+
+  void TearDown() override {
+    close(fds_[0]);
+    close(fds_[1]);
+  }
+
+  int fds_[2];
+};
+
+TEST_F(EnclavePipeTest, ReadsWhatIsWritten) {
+  ASSERT_EQ(write(fds_[1], "hello", 5), 5);
+  char buf[8];
+  ASSERT_EQ(read(fds_[0], buf, sizeof(buf)), 5);
+  EXPECT_EQ(std::string(buf, 5), "hello");
+}
+
+TEST_F(EnclavePipeTest, EndsAreOneWay) {
+  char c = 'x';
+  EXPECT_EQ(write(fds_[0], &c, 1), -1);
+  EXPECT_EQ(errno, EBADF);
+  EXPECT_EQ(read(fds_[1], &c, 1), -1);
+  EXPECT_EQ(errno, EBADF);
+}
+
+TEST_F(EnclavePipeTest, NonblockingReadOfEmptyPipeFails) {
+  ASSERT_EQ(fcntl(fds_[0], F_SETFL, O_NONBLOCK), 0);
+  EXPECT_EQ(fcntl(fds_[0], F_GETFL), O_RDONLY | O_NONBLOCK);
+  char c;
+  EXPECT_EQ(read(fds_[0], &c, 1), -1);
+  EXPECT_EQ(errno, EAGAIN);
+}
+
+TEST_F(EnclavePipeTest, ClosingWriteEndEndsStream) {
+  ASSERT_EQ(write(fds_[1], "x", 1), 1);
+  ASSERT_EQ(close(fds_[1]), 0);
+  fds_[1] = -1;
+  char c;
+  EXPECT_EQ(read(fds_[0], &c, 1), 1);
+  EXPECT_EQ(read(fds_[0], &c, 1), 0);
+}
+
+TEST_F(EnclavePipeTest, WritingWithoutReaderFails) {
+  ASSERT_EQ(close(fds_[0]), 0);
+  fds_[0] = -1;
+  EXPECT_EQ(write(fds_[1], "x", 1), -1);
+  EXPECT_EQ(errno, EPIPE);
+}
+
+TEST_F(EnclavePipeTest, PollReportsReadiness) {
+  struct pollfd pfds[2] = {{fds_[0], POLLIN, 0}, {fds_[1], POLLOUT, 0}};
+  ASSERT_EQ(poll(pfds, 2, 0), 1);
+  EXPECT_EQ(pfds[0].revents, 0);
+  EXPECT_EQ(pfds[1].revents, POLLOUT);
+
+  std::thread writer([this] { EXPECT_EQ(write(fds_[1], "x", 1), 1); });
+  pfds[1].events = 0;
+  EXPECT_EQ(poll(pfds, 2, -1), 1);
+  EXPECT_EQ(pfds[0].revents, POLLIN);
+  writer.join();
+}
+
+// Tests that a poll set mixing enclave pipes and host descriptors does not wait
+// on the host once a pipe is ready.
+TEST_F(EnclavePipeTest, PollDoesNotWaitOnHostWhenPipeReady) {
+  int sock = socket(AF_INET, SOCK_DGRAM, 0);
+  ASSERT_GE(sock, 0);
+  ASSERT_EQ(write(fds_[1], "x", 1), 1);
+  struct pollfd pfds[2] = {{sock, POLLIN, 0}, {fds_[0], POLLIN, 0}};
+  EXPECT_EQ(poll(pfds, 2, -1), 1);
+  EXPECT_EQ(pfds[0].revents, 0);
+  EXPECT_EQ(pfds[1].revents, POLLIN);
+  EXPECT_EQ(pfds[0].fd, sock);
+  close(sock);
+}
+
+// Tests that a thread polling enclave pipes together with host descriptors is
+// woken when a pipe becomes ready.
+TEST_F(EnclavePipeTest, PollOnHostIsWokenByPipe) {
+  int sock = socket(AF_INET, SOCK_DGRAM, 0);
+  ASSERT_GE(sock, 0);
+  std::thread writer([this] { EXPECT_EQ(write(fds_[1], "x", 1), 1); });
+  struct pollfd pfds[2] = {{sock, POLLIN, 0}, {fds_[0], POLLIN, 0}};
+  EXPECT_EQ(poll(pfds, 2, -1), 1);
+  EXPECT_EQ(pfds[0].revents, 0);
+  EXPECT_EQ(pfds[1].revents, POLLIN);
+  writer.join();
+
+  // The wake-up is consumed, so a later poll times out.
+  char c;
+  ASSERT_EQ(read(fds_[0], &c, 1), 1);
+  EXPECT_EQ(poll(pfds, 2, 10), 0);
+  close(sock);
+}
+
+// Tests that bytes written by several threads all reach several readers.
+TEST_F(EnclavePipeTest, ManyWritersAndReaders) {
+  static constexpr int kThreads = 2;
+  static constexpr int kBytesPerThread = 100000;
+  std::vector<std::thread> writers;
+  for (int i = 0; i < kThreads; ++i) {
+    writers.emplace_back([this] {
+      std::vector<char> data(kBytesPerThread, 'x');
+      EXPECT_EQ(write(fds_[1], data.data(), data.size()), kBytesPerThread);
+    });
+  }
+
+  std::atomic<int> total(0);
+  std::vector<std::thread> readers;
+  for (int i = 0; i < kThreads; ++i) {
+    readers.emplace_back([this, &total] {
+      char buf[1024];
+      ssize_t ret;
+      while ((ret = read(fds_[0], buf, sizeof(buf))) > 0) {
+        total += ret;
+      }
+      EXPECT_EQ(ret, 0);
+    });
+  }
+
+  for (std::thread &writer : writers) {
+    writer.join();
+  }
+  ASSERT_EQ(close(fds_[1]), 0);
+  fds_[1] = -1;
+  for (std::thread &reader : readers) {
+    reader.join();
+  }
+  EXPECT_EQ(total, kThreads * kBytesPerThread);
+}
+
+// Tests that without O_SECURE, pipe2 creates a host pipe like pipe.
+TEST(HostPipeTest, Pipe2WithoutSecureFlagCreatesHostPipe) {
+  int fds[2];
+  ASSERT_EQ(pipe2(fds, O_NONBLOCK | O_CLOEXEC), 0);
+  EXPECT_EQ(fcntl(fds[0], F_GETFL) & O_NONBLOCK, O_NONBLOCK);
+  EXPECT_EQ(fcntl(fds[1], F_GETFD), FD_CLOEXEC);
+  char c;
+  EXPECT_EQ(read(fds[0], &c, 1), -1);
+  EXPECT_EQ(errno, EAGAIN);
+  ASSERT_EQ(write(fds[1], "x", 1), 1);
+  EXPECT_EQ(read(fds[0], &c, 1), 1);
+  EXPECT_EQ(close(fds[0]), 0);
+  EXPECT_EQ(close(fds[1]), 0);
+
+  EXPECT_EQ(pipe2(fds, O_APPEND), -1);
+  EXPECT_EQ(errno, EINVAL);
+}
+
+TEST(EnclaveSocketPairTest, IsBidirectional) {
+  int sv[2];
+  ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM | SOCK_SECURE, 0, sv), 0);
+  char buf[4];
+  ASSERT_EQ(send(sv[0], "ping", 4, 0), 4);
+  ASSERT_EQ(read(sv[1], buf, sizeof(buf)), 4);
+  EXPECT_EQ(std::string(buf, 4), "ping");
+  ASSERT_EQ(write(sv[1], "pong", 4), 4);
+  ASSERT_EQ(read(sv[0], buf, sizeof(buf)), 4);
+  EXPECT_EQ(std::string(buf, 4), "pong");
+
+  ASSERT_EQ(shutdown(sv[0], SHUT_WR), 0);
+  EXPECT_EQ(read(sv[1], buf, sizeof(buf)), 0);
+  EXPECT_EQ(close(sv[0]), 0);
+  EXPECT_EQ(close(sv[1]), 0);
+}
+
+TEST(EnclaveSocketPairTest, OnlyLocalStreamsAreSupported) {
+  int sv[2];
+  EXPECT_EQ(socketpair(AF_INET, SOCK_STREAM | SOCK_SECURE, 0, sv), -1);
+  EXPECT_EQ(errno, EAFNOSUPPORT);
+  EXPECT_EQ(socketpair(AF_UNIX, SOCK_DGRAM | SOCK_SECURE, 0, sv), -1);
+  EXPECT_EQ(errno, EOPNOTSUPP);
+  EXPECT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, sv), -1);
+  EXPECT_EQ(errno, EOPNOTSUPP);
+}
+
+}  // namespace
+}  // namespace asylo
@@ -0,0 +1,101 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/posix/io/epoll_context.h"
+
+#include <errno.h>
+#include <limits.h>
+
+#include "asylo/platform/arch/include/trusted/host_calls.h"
+
+namespace asylo {
+namespace io {
+
+ssize_t IOContextEpoll::Read(void *buf, size_t count) {
+  errno = EINVAL;
+  return -1;
+}
+
+ssize_t IOContextEpoll::Write(const void *buf, size_t count) {
+  errno = EINVAL;
+  return -1;
+}
+
+int IOContextEpoll::Close() { return enc_untrusted_close(host_fd_); }
+
+int IOContextEpoll::EpollCtl(int op, int fd, int host_fd,
+                             struct epoll_event *event) {
+  if (op != EPOLL_CTL_ADD && op != EPOLL_CTL_MOD && op != EPOLL_CTL_DEL) {
+    errno = EINVAL;
+    return -1;
+  }
+  if (op != EPOLL_CTL_DEL && !event) {
+    errno = EFAULT;
+    return -1;
+  }
+
+  struct epoll_event host_event;
+  if (event) {
+    host_event.events = event->events;
+    host_event.data.u64 = static_cast<uint64_t>(fd);
+  }
+
+  // Duplicate and missing registrations are diagnosed by the host, which also
+  // drops descriptors from the interest list once they are closed.
+  absl::MutexLock lock(&interest_lock_);
+  int ret = enc_untrusted_epoll_ctl(host_fd_, op, host_fd,
+                                    event ? &host_event : nullptr);
+  if (ret != 0) {
+    return ret;
+  }
+  if (op == EPOLL_CTL_DEL) {
+    interest_.erase(fd);
+  } else {
+    interest_[fd] = *event;
+  }
+  return 0;
+}
+
+int IOContextEpoll::EpollWait(struct epoll_event *events, int maxevents,
+                              int timeout) {
+  int ret = enc_untrusted_epoll_wait(host_fd_, events, maxevents, timeout);
+  if (ret <= 0) {
+    return ret;
+  }
+
+  // Replace the host's tags with the caller's registered data, discarding any
+  // events for descriptors this instance does not know about.
+  absl::MutexLock lock(&interest_lock_);
+  int count = 0;
+  for (int i = 0; i < ret; ++i) {
+    uint64_t tag = events[i].data.u64;
+    if (tag > INT_MAX) continue;
+    auto it = interest_.find(static_cast<int>(tag));
+    if (it == interest_.end()) continue;
+    events[count].events =
+        events[i].events & (it->second.events | EPOLLERR | EPOLLHUP);
+    events[count].data = it->second.data;
+    ++count;
+  }
+  return count;
+}
+
+int IOContextEpoll::GetHostFileDescriptor() { return host_fd_; }
+
+}  // namespace io
+}  // namespace asylo
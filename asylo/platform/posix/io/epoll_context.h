@@ -0,0 +1,68 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_PLATFORM_POSIX_IO_EPOLL_CONTEXT_H_
+#define ASYLO_PLATFORM_POSIX_IO_EPOLL_CONTEXT_H_
+
+#include <sys/epoll.h>
+
+#include <unordered_map>
+
+#include "absl/synchronization/mutex.h"
+#include "asylo/platform/posix/io/io_manager.h"
+
+namespace asylo {
+namespace io {
+
+// IOContext implementation wrapping a host epoll instance.
+//
+// Host file descriptors are registered with the host instance tagged by their
+// enclave file descriptor rather than by the caller's epoll_data, which is kept
+// inside the enclave. Events reported by the host are mapped back through this
+// interest list, so an untrusted host can neither forge the epoll_data handed
+// to the application nor report events for descriptors that were never
+// registered.
+class IOContextEpoll : public IOManager::IOContext {
+ public:
+  explicit IOContextEpoll(int host_fd) : host_fd_(host_fd) {}
+  ssize_t Read(void *buf, size_t count) override;
+  ssize_t Write(const void *buf, size_t count) override;
+  int Close() override;
+  int EpollCtl(int op, int fd, int host_fd,
+               struct epoll_event *event) override;
+  int EpollWait(struct epoll_event *events, int maxevents,
+                int timeout) override;
+  int GetHostFileDescriptor() override;
+
+ private:
+  // Host file descriptor of the epoll instance.
+  int host_fd_;
+
+  // Guards |interest_|.
+  absl::Mutex interest_lock_;
+
+  // The event mask and caller data registered for each enclave file
+  // descriptor.
+  std::unordered_map<int, struct epoll_event> interest_
+      GUARDED_BY(interest_lock_);
+};
+
+}  // namespace io
+}  // namespace asylo
+
+#endif  // ASYLO_PLATFORM_POSIX_IO_EPOLL_CONTEXT_H_
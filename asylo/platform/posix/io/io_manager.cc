@@ -23,10 +23,17 @@
 #include <poll.h>
 #include <stdint.h>
 
-#include "absl/algorithm/container.h"
-#include "absl/strings/str_cat.h"
+#include <algorithm>
+#include <array>
+#include <memory>
+
+#include "absl/base/attributes.h"
 #include "absl/strings/string_view.h"
+#include "absl/time/time.h"
+#include "asylo/platform/arch/include/trusted/enclave_interface.h"
 #include "asylo/platform/arch/include/trusted/host_calls.h"
+#include "asylo/platform/posix/io/enclave_pipe.h"
+#include "asylo/platform/posix/io/epoll_context.h"
 #include "asylo/platform/posix/io/native_paths.h"
 #include "asylo/platform/posix/io/util.h"
 #include "asylo/util/posix_error_space.h"
@@ -34,10 +41,152 @@
 
 namespace asylo {
 namespace io {
+namespace {
+
+// A string buffer used to hold a canonical path while it is passed to a path
+// handler. Released buffers are kept on a per-thread free list so that path
+// resolution does not allocate once a thread has warmed up, while still
+// allowing path operations to nest.
+struct PathBuffer {
+  std::string path;
+  PathBuffer *next = nullptr;
+};
+
+ABSL_CONST_INIT thread_local PathBuffer *free_path_buffers = nullptr;
+
+// Takes a PathBuffer from the current thread's free list for the lifetime of
+// the object.
+class ScopedPathBuffer {
+ public:
+  ScopedPathBuffer() : buffer_(free_path_buffers) {
+    if (buffer_) {
+      free_path_buffers = buffer_->next;
+    } else {
+      buffer_ = new PathBuffer();
+    }
+  }
+
+  ScopedPathBuffer(const ScopedPathBuffer &) = delete;
+  ScopedPathBuffer &operator=(const ScopedPathBuffer &) = delete;
+
+  ~ScopedPathBuffer() {
+    buffer_->next = free_path_buffers;
+    free_path_buffers = buffer_;
+  }
+
+  std::string *get() { return &buffer_->path; }
+
+ private:
+  PathBuffer *buffer_;
+};
+
+// Returns the number of bytes described by the |iovcnt| entries of |iov|.
+size_t IovLength(const struct iovec *iov, int iovcnt) {
+  size_t length = 0;
+  for (int i = 0; iov && i < iovcnt; ++i) {
+    length += iov[i].iov_len;
+  }
+  return length;
+}
+
+// Number of relative path resolutions remembered by each thread.
+constexpr size_t kCanonicalPathCacheSize = 16;
+
+// A cached resolution of a relative path. Entries are only valid while
+// |generation| matches the IOManager's current path generation.
+struct CanonicalPathCacheEntry {
+  uint64_t generation = 0;
+  std::string relative_path;
+  std::string canonical_path;
+  IOManager::VirtualPathHandler *handler = nullptr;
+};
+
+using CanonicalPathCache =
+    std::array<CanonicalPathCacheEntry, kCanonicalPathCacheSize>;
+
+ABSL_CONST_INIT thread_local CanonicalPathCache *canonical_path_cache = nullptr;
+
+// Returns the slot of the current thread's cache which may hold |path|.
+CanonicalPathCacheEntry *CacheEntryForPath(absl::string_view path) {
+  if (!canonical_path_cache) {
+    canonical_path_cache = new CanonicalPathCache();
+  }
+
+  // FNV-1a hash of the path.
+  uint64_t hash = 14695981039346656037ULL;
+  for (char c : path) {
+    hash = (hash ^ static_cast<uint8_t>(c)) * 1099511628211ULL;
+  }
+  return &(*canonical_path_cache)[hash % kCanonicalPathCacheSize];
+}
+
+// A host pipe through which PollWaiters wake a thread waiting on the host in
+// Poll. Each thread has its own, created on first use and kept for the
+// lifetime of the enclave.
+struct HostWakePipe {
+  int read_fd = -1;
+  int write_fd = -1;
+};
+
+thread_local HostWakePipe host_wake_pipe;
+
+// Returns the wake pipe of the calling thread, or null if it cannot be
+// created.
+HostWakePipe *GetHostWakePipe() {
+  if (host_wake_pipe.read_fd < 0) {
+    int fds[2];
+    if (enc_untrusted_pipe(fds) != 0) {
+      return nullptr;
+    }
+    for (int fd : fds) {
+      if (enc_untrusted_fcntl(fd, F_SETFL, static_cast<int64_t>(O_NONBLOCK)) <
+          0) {
+        enc_untrusted_close(fds[0]);
+        enc_untrusted_close(fds[1]);
+        return nullptr;
+      }
+    }
+    host_wake_pipe.read_fd = fds[0];
+    host_wake_pipe.write_fd = fds[1];
+  }
+  return &host_wake_pipe;
+}
+
+// Discards the bytes written to |pipe| by PollWaiters.
+void DrainHostWakePipe(const HostWakePipe &pipe) {
+  char buffer[16];
+  while (enc_untrusted_read(pipe.read_fd, buffer, sizeof(buffer)) > 0) {
+  }
+}
+
+// Polls the host file descriptors |host_fds| for |timeout| milliseconds and
+// copies their events to the entries of |fds| listed in |host_index|, which
+// may be shorter than |host_fds|. Returns the number of those entries with
+// events, or -1 on failure.
+int PollHost(struct pollfd *fds, const std::vector<nfds_t> &host_index,
+             std::vector<struct pollfd> *host_fds, int timeout) {
+  if (enc_untrusted_poll(host_fds->data(), host_fds->size(), timeout) < 0) {
+    return -1;
+  }
+  int ret = 0;
+  for (size_t j = 0; j < host_index.size(); ++j) {
+    fds[host_index[j]].revents = (*host_fds)[j].revents;
+    if ((*host_fds)[j].revents) {
+      ++ret;
+    }
+  }
+  return ret;
+}
+
+}  // namespace
 
 IOManager::FileDescriptorTable::FileDescriptorTable()
     : maximum_fd_soft_limit(kMaxOpenFiles),
-      maximum_fd_hard_limit(kMaxOpenFiles) {}
+      maximum_fd_hard_limit(kMaxOpenFiles) {
+  for (std::atomic<IOContext *> &context : published_contexts_) {
+    context.store(nullptr, std::memory_order_relaxed);
+  }
+}
 
 std::shared_ptr<IOManager::IOContext> IOManager::FileDescriptorTable::Get(
     int fd) {
@@ -45,6 +194,26 @@ std::shared_ptr<IOManager::IOContext> IOManager::FileDescriptorTable::Get(
   return fd_table_[fd];
 }
 
+IOManager::IOContext *IOManager::FileDescriptorTable::Protect(
+    int fd, HazardPointerDomain::Guard *guard) {
+  if (!IsFileDescriptorValid(fd)) return nullptr;
+  return guard->Protect(published_contexts_[fd]);
+}
+
+void IOManager::FileDescriptorTable::SetEntry(
+    int fd, std::shared_ptr<IOContext> context) {
+  published_contexts_[fd].store(context.get());
+  std::shared_ptr<IOContext> old_context = std::move(fd_table_[fd]);
+  fd_table_[fd] = std::move(context);
+  // Other entries keep a shared context alive, so only the last reference
+  // needs to wait for readers which may still be using it.
+  if (old_context && old_context.unique()) {
+    IOContext *pointer = old_context.get();
+    retired_contexts_.Retire(pointer,
+                             [old_context]() mutable { old_context.reset(); });
+  }
+}
+
 bool IOManager::FileDescriptorTable::HasSharedIOContext(int fd) {
   if (!IsFileDescriptorValid(fd)) return false;
   return !fd_table_[fd].unique();
@@ -52,7 +221,7 @@ bool IOManager::FileDescriptorTable::HasSharedIOContext(int fd) {
 
 void IOManager::FileDescriptorTable::Delete(int fd) {
   if (!IsFileDescriptorValid(fd)) return;
-  fd_table_[fd] = nullptr;
+  SetEntry(fd, nullptr);
 }
 
 bool IOManager::FileDescriptorTable::IsFileDescriptorUnused(int fd) {
@@ -65,7 +234,7 @@ int IOManager::FileDescriptorTable::Insert(IOContext *context) {
   if (fd < 0) {
     return -1;
   }
-  fd_table_[fd] = std::shared_ptr<IOContext>(context);
+  SetEntry(fd, std::shared_ptr<IOContext>(context));
   return fd;
 }
 
@@ -74,7 +243,7 @@ int IOManager::FileDescriptorTable::CopyFileDescriptor(int oldfd, int startfd) {
   if (!IsFileDescriptorValid(oldfd) || newfd == -1) {
     return -1;
   }
-  fd_table_[newfd] = fd_table_[oldfd];
+  SetEntry(newfd, fd_table_[oldfd]);
   return newfd;
 }
 
@@ -84,7 +253,7 @@ int IOManager::FileDescriptorTable::CopyFileDescriptorToSpecifiedTarget(
       fd_table_[newfd]) {
     return -1;
   }
-  fd_table_[newfd] = fd_table_[oldfd];
+  SetEntry(newfd, fd_table_[oldfd]);
   return newfd;
 }
 
@@ -123,6 +292,16 @@ int IOManager::FileDescriptorTable::GetHighestFileDescriptorUsed() {
   return -1;
 }
 
+int IOManager::FileDescriptorTable::CountFileDescriptorsUsed() {
+  int count = 0;
+  for (const auto &context : fd_table_) {
+    if (context) {
+      ++count;
+    }
+  }
+  return count;
+}
+
 int IOManager::FileDescriptorTable::GetNextFreeFileDescriptor(int startfd) {
   if (startfd < 0) {
     return -1;
@@ -145,12 +324,17 @@ int IOManager::Access(const char *path, int mode) {
 }
 
 int IOManager::CloseFileDescriptor(int fd) {
-  std::shared_ptr<IOContext> context = fd_table_.Get(fd);
+  // Holding a reference here would keep the context out of the hazard domain
+  // when its entry is deleted, so use the pointer owned by the table.
+  IOContext *context = fd_table_.Get(fd).get();
   if (context) {
     int ret = 0;
     // Only close the host file descriptor if this is the last reference to
     // it.
     if (!fd_table_.HasSharedIOContext(fd)) {
+      if (context->AttributesCacheable()) {
+        attribute_cache_.Untrack(context);
+      }
       ret = context->Close();
     }
     fd_table_.Delete(fd);
@@ -167,52 +351,9 @@ int IOManager::Close(int fd) {
 
 IOManager::VirtualPathHandler *IOManager::HandlerForPath(
     absl::string_view path) const {
-  // Start by looking for a full match.
-  std::string current_prefix(path);
-
-  // Keep looking until we find a match or run out of handlers to check.
-  while (true) {
-    // Find the first handler with a prefix greater or equal to this path.
-    // If there is an exact match, this will be it.  Otherwise, any match must
-    // be before this.
-    auto iter = prefix_to_handler_.lower_bound(current_prefix);
-
-    // iter->first is the registered prefix.
-    // iter->second.get() is a pointer to the registered handler.
-
-    // lower_bound can land directory on a match.
-    if (iter != prefix_to_handler_.end() && current_prefix == iter->first) {
-      return iter->second.get();
-    }
-
-    // Since we started with the lower_bound, any prefixes will be found
-    // before that iterator.  If there are none, we're done.
-    if (iter == prefix_to_handler_.begin()) break;
-    --iter;
-
-    // Determine how much this handler's prefix and the current prefix have in
-    // common.
-    std::string::const_iterator end_prefix, end_path;
-    std::tie(end_prefix, end_path) =
-        absl::c_mismatch(iter->first, current_prefix);
-
-    // If the entire prefix is in the current prefix up to a /, it's a match.
-    if (end_prefix == iter->first.end() && *end_path == '/') {
-      return iter->second.get();
-    }
-
-    // Back up the prefix to nearest directory.  We know there can't be a
-    // matching handler with a longer prefix match or we would have found it by
-    // now.
-    while (*end_prefix != '/') --end_prefix;
-
-    // The next iteration of the loop will look for a matching handler using
-    // that directory prefix.
-    current_prefix = std::string(iter->first.begin(), end_prefix);
-  }
-
-  // Didn't find a handler.
-  return nullptr;
+  const std::unique_ptr<VirtualPathHandler> *handler =
+      handlers_.FindLongestPrefix(path);
+  return handler ? handler->get() : nullptr;
 }
 
 int IOManager::Open(const char *path, int flags, mode_t mode) {
@@ -221,13 +362,21 @@ int IOManager::Open(const char *path, int flags, mode_t mode) {
     std::unique_ptr<IOContext> context =
         handler->Open(canonical_path, flags, mode);
 
+    if (flags & O_TRUNC) {
+      attribute_cache_.InvalidatePath(canonical_path);
+    }
     if (context) {
+      context->handler_io_stats_ = handler->io_stats_;
+      if (context->AttributesCacheable()) {
+        attribute_cache_.Track(context.get(), canonical_path);
+      }
       absl::WriterMutexLock lock(&fd_table_lock_);
       int fd = fd_table_.Insert(context.get());
       if (fd >= 0) {
         context.release();
         return fd;
       }
+      attribute_cache_.Untrack(context.get());
       errno = ENFILE;
     }
     return -1;
@@ -270,8 +419,16 @@ int IOManager::Dup2(int oldfd, int newfd) {
 int IOManager::Pipe(int pipefd[2]) {
   int res = enc_untrusted_pipe(pipefd);
   if (res != -1) {
-    pipefd[0] = RegisterHostFileDescriptor(pipefd[0]);
-    pipefd[1] = RegisterHostFileDescriptor(pipefd[1]);
+    size_t buffer_size = native_buffer_size_;
+    absl::WriterMutexLock lock(&fd_table_lock_);
+    for (int i = 0; i < 2; ++i) {
+      auto context = ::absl::make_unique<IOContextNative>(
+          pipefd[i], buffer_size, /*seekable=*/false);
+      pipefd[i] = fd_table_.Insert(context.get());
+      if (pipefd[i] >= 0) {
+        context.release();
+      }
+    }
     if (pipefd[0] < 0 || pipefd[1] < 0) {
       errno = EMFILE;
       return -1;
@@ -280,35 +437,369 @@ int IOManager::Pipe(int pipefd[2]) {
   return res;
 }
 
+int IOManager::InsertContextPair(std::unique_ptr<IOContext> first,
+                                 std::unique_ptr<IOContext> second,
+                                 int fds[2]) {
+  absl::WriterMutexLock lock(&fd_table_lock_);
+  fds[0] = fd_table_.Insert(first.get());
+  if (fds[0] < 0) {
+    errno = EMFILE;
+    return -1;
+  }
+  first.release();
+  fds[1] = fd_table_.Insert(second.get());
+  if (fds[1] < 0) {
+    fd_table_.Delete(fds[0]);
+    errno = EMFILE;
+    return -1;
+  }
+  second.release();
+  return 0;
+}
+
+int IOManager::Pipe2(int pipefd[2], int flags) {
+  if (flags & ~(O_NONBLOCK | O_CLOEXEC | O_SECURE)) {
+    errno = EINVAL;
+    return -1;
+  }
+  int descriptor_flags = (flags & O_CLOEXEC) ? FD_CLOEXEC : 0;
+  if (!(flags & O_SECURE)) {
+    if (Pipe(pipefd) != 0) {
+      return -1;
+    }
+    for (int i = 0; i < 2; ++i) {
+      if (((flags & O_NONBLOCK) && FCntl(pipefd[i], F_SETFL, O_NONBLOCK) < 0) ||
+          (descriptor_flags &&
+           FCntl(pipefd[i], F_SETFD, descriptor_flags) < 0)) {
+        int saved_errno = errno;
+        Close(pipefd[0]);
+        Close(pipefd[1]);
+        errno = saved_errno;
+        return -1;
+      }
+    }
+    return 0;
+  }
+  int status_flags = flags & O_NONBLOCK;
+  auto buffer = std::make_shared<EnclavePipeBuffer>();
+  return InsertContextPair(
+      ::absl::make_unique<IOContextEnclavePipe>(
+          buffer, nullptr, /*is_socket=*/false, status_flags, descriptor_flags),
+      ::absl::make_unique<IOContextEnclavePipe>(
+          nullptr, buffer, /*is_socket=*/false, status_flags, descriptor_flags),
+      pipefd);
+}
+
+int IOManager::SocketPair(int domain, int type, int protocol, int sv[2]) {
+  if (domain != AF_UNIX) {
+    errno = EAFNOSUPPORT;
+    return -1;
+  }
+  int type_flags = type & (SOCK_NONBLOCK | SOCK_CLOEXEC | SOCK_SECURE);
+  if ((type & ~type_flags) != SOCK_STREAM || !(type & SOCK_SECURE)) {
+    errno = EOPNOTSUPP;
+    return -1;
+  }
+  if (protocol != 0) {
+    errno = EPROTONOSUPPORT;
+    return -1;
+  }
+  int status_flags = (type & SOCK_NONBLOCK) ? O_NONBLOCK : 0;
+  int descriptor_flags = (type & SOCK_CLOEXEC) ? FD_CLOEXEC : 0;
+  auto forward = std::make_shared<EnclavePipeBuffer>();
+  auto backward = std::make_shared<EnclavePipeBuffer>();
+  return InsertContextPair(
+      ::absl::make_unique<IOContextEnclavePipe>(backward, forward,
+                                                /*is_socket=*/true,
+                                                status_flags, descriptor_flags),
+      ::absl::make_unique<IOContextEnclavePipe>(forward, backward,
+                                                /*is_socket=*/true,
+                                                status_flags, descriptor_flags),
+      sv);
+}
+
 int IOManager::Poll(struct pollfd *fds, nfds_t nfds, int timeout) {
-  std::vector<int> enclave_fd(nfds);
-  {
-    absl::ReaderMutexLock lock(&fd_table_lock_);
-    for (int i = 0; i < nfds; ++i) {
-      enclave_fd[i] = fds[i].fd;
-      std::shared_ptr<IOContext> context = fd_table_.Get(enclave_fd[i]);
+  // Descriptors backed by the host are gathered into a set of their own, so
+  // that only they are copied out to the host. Enclave-local descriptors, such
+  // as enclave pipes, are checked here.
+  std::vector<struct pollfd> host_fds;
+  std::vector<nfds_t> host_index;
+  std::vector<nfds_t> local_index;
+  for (nfds_t i = 0; i < nfds; ++i) {
+    fds[i].revents = 0;
+    HazardPointerDomain::Guard guard;
+    IOContext *context = fd_table_.Protect(fds[i].fd, &guard);
+    if (!context) {
+      continue;
+    }
+    int host_fd = context->GetHostFileDescriptor();
+    if (host_fd < 0) {
+      local_index.push_back(i);
+    } else {
+      host_index.push_back(i);
+      host_fds.push_back({host_fd, fds[i].events, 0});
+    }
+  }
+  if (local_index.empty()) {
+    return PollHost(fds, host_index, &host_fds, timeout);
+  }
+
+  auto poll_local = [this, fds, &local_index]() {
+    int ret = 0;
+    for (nfds_t i : local_index) {
+      HazardPointerDomain::Guard guard;
+      IOContext *context = fd_table_.Protect(fds[i].fd, &guard);
+      fds[i].revents = context ? context->PollEvents(fds[i].events) : POLLNVAL;
+      if (fds[i].revents) {
+        ++ret;
+      }
+    }
+    return ret;
+  };
+
+  absl::Time deadline = timeout < 0
+                            ? absl::InfiniteFuture()
+                            : absl::Now() + absl::Milliseconds(timeout);
+  while (true) {
+    // Once a local descriptor is ready, the host descriptors are checked
+    // without waiting, and if there are none, nothing leaves the enclave.
+    int ret = poll_local();
+    absl::Duration remaining = deadline - absl::Now();
+    if (ret > 0 || remaining <= absl::ZeroDuration()) {
+      if (host_fds.empty()) {
+        return ret;
+      }
+      int host_ret = PollHost(fds, host_index, &host_fds, /*timeout=*/0);
+      return host_ret < 0 ? -1 : ret + host_ret;
+    }
+    int wait_timeout =
+        timeout < 0 ? -1
+                    : static_cast<int>(absl::ToInt64Milliseconds(
+                          absl::Ceil(remaining, absl::Milliseconds(1))));
+
+    // Register to be woken when a local descriptor may have become ready, and
+    // check them again so that no change since the last check is missed.
+    // Without host descriptors the thread waits inside the enclave; otherwise
+    // it waits on the host and is woken through its wake pipe.
+    HostWakePipe *wake_pipe = nullptr;
+    if (!host_fds.empty()) {
+      wake_pipe = GetHostWakePipe();
+      if (!wake_pipe) {
+        return -1;
+      }
+    }
+    PollWaiter waiter(wake_pipe ? wake_pipe->write_fd : -1);
+    std::vector<std::unique_ptr<PollRegistration>> registrations;
+    for (nfds_t i : local_index) {
+      HazardPointerDomain::Guard guard;
+      IOContext *context = fd_table_.Protect(fds[i].fd, &guard);
       if (context) {
-        fds[i].fd = context->GetHostFileDescriptor();
+        registrations.push_back(context->AddPollWaiter(&waiter));
+      }
+    }
+    int host_ret = 0;
+    if (poll_local() == 0) {
+      if (wake_pipe) {
+        host_fds.push_back({wake_pipe->read_fd, POLLIN, 0});
+        host_ret = PollHost(fds, host_index, &host_fds, wait_timeout);
+        host_fds.pop_back();
       } else {
-        fds[i].fd = -1;
+        waiter.Wait(wait_timeout);
       }
     }
+    registrations.clear();
+    if (wake_pipe && waiter.notified()) {
+      DrainHostWakePipe(*wake_pipe);
+    }
+    if (host_ret < 0) {
+      return -1;
+    }
+    if (host_ret > 0) {
+      return host_ret + poll_local();
+    }
   }
-  int ret = enc_untrusted_poll(fds, nfds, timeout);
-  for (int i = 0; i < nfds; ++i) {
-    fds[i].fd = enclave_fd[i];
+}
+
+void IOManager::PollWaiter::Notify() {
+  absl::MutexLock lock(&mu_);
+  if (notified_) {
+    return;
+  }
+  notified_ = true;
+  if (host_wake_fd_ >= 0) {
+    char byte = 0;
+    enc_untrusted_write(host_wake_fd_, &byte, 1);
+  }
+}
+
+bool IOManager::PollWaiter::Wait(int timeout) {
+  absl::MutexLock lock(&mu_);
+  if (timeout < 0) {
+    mu_.Await(absl::Condition(&notified_));
+    return true;
+  }
+  return mu_.AwaitWithTimeout(absl::Condition(&notified_),
+                              absl::Milliseconds(timeout));
+}
+
+bool IOManager::PollWaiter::notified() {
+  absl::MutexLock lock(&mu_);
+  return notified_;
+}
+
+int IOManager::EpollCreate(int flags) {
+  if (flags & ~EPOLL_CLOEXEC) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  int host_fd = enc_untrusted_epoll_create1(flags);
+  if (host_fd == -1) {
+    return -1;
+  }
+
+  absl::WriterMutexLock lock(&fd_table_lock_);
+  auto context = ::absl::make_unique<IOContextEpoll>(host_fd);
+  int fd = fd_table_.Insert(context.get());
+  if (fd < 0) {
+    context->Close();
+    errno = EMFILE;
+    return -1;
+  }
+  context.release();
+  return fd;
+}
+
+int IOManager::EpollCtl(int epfd, int op, int fd, struct epoll_event *event) {
+  if (epfd == fd) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  // The host epoll instance watches the host file descriptor backing |fd|, so
+  // only descriptors delegated to the host may be registered.
+  HazardPointerDomain::Guard guard;
+  IOContext *target = fd_table_.Protect(fd, &guard);
+  if (!target) {
+    errno = EBADF;
+    return -1;
+  }
+  int host_fd = target->GetHostFileDescriptor();
+  if (host_fd < 0) {
+    errno = EPERM;
+    return -1;
+  }
+
+  return CallWithContext(epfd, [op, fd, host_fd, event](IOContext *context) {
+    return context->EpollCtl(op, fd, host_fd, event);
+  });
+}
+
+int IOManager::EpollWait(int epfd, struct epoll_event *events, int maxevents,
+                         int timeout) {
+  if (maxevents <= 0) {
+    errno = EINVAL;
+    return -1;
+  }
+  return CallWithContext(
+      epfd, [events, maxevents, timeout](IOContext *context) {
+        return context->EpollWait(events, maxevents, timeout);
+      });
+}
+
+int IOManager::HostFileDescriptor(int fd) {
+  HazardPointerDomain::Guard guard;
+  IOContext *context = fd_table_.Protect(fd, &guard);
+  if (!context) {
+    errno = EBADF;
+    return -1;
+  }
+  int host_fd = context->GetHostFileDescriptor();
+  if (host_fd < 0) {
+    errno = EINVAL;
+    return -1;
+  }
+  return host_fd;
+}
+
+ssize_t IOManager::SendFile(int out_fd, int in_fd, off_t *offset,
+                            size_t count) {
+  int host_out_fd = HostFileDescriptor(out_fd);
+  if (host_out_fd < 0) {
+    return -1;
+  }
+  int host_in_fd = HostFileDescriptor(in_fd);
+  if (host_in_fd < 0) {
+    return -1;
+  }
+  return enc_untrusted_sendfile(host_out_fd, host_in_fd, offset, count);
+}
+
+ssize_t IOManager::Splice(int fd_in, off_t *off_in, int fd_out,
+                          off_t *off_out, size_t len, unsigned int flags) {
+  int host_fd_in = HostFileDescriptor(fd_in);
+  if (host_fd_in < 0) {
+    return -1;
+  }
+  int host_fd_out = HostFileDescriptor(fd_out);
+  if (host_fd_out < 0) {
+    return -1;
+  }
+  return enc_untrusted_splice(host_fd_in, off_in, host_fd_out, off_out, len,
+                              flags);
+}
+
+ssize_t IOManager::CopyFileRange(int fd_in, off_t *off_in, int fd_out,
+                                 off_t *off_out, size_t len,
+                                 unsigned int flags) {
+  if (flags != 0) {
+    errno = EINVAL;
+    return -1;
+  }
+  int host_fd_in = HostFileDescriptor(fd_in);
+  if (host_fd_in < 0) {
+    return -1;
+  }
+  int host_fd_out = HostFileDescriptor(fd_out);
+  if (host_fd_out < 0) {
+    return -1;
+  }
+  return enc_untrusted_copy_file_range(host_fd_in, off_in, host_fd_out,
+                                       off_out, len, flags);
+}
+
+int IOManager::SubmitAsync(int fd, const enc_async_io_request &request) {
+  enc_async_io_request host_request = request;
+  host_request.host_fd = HostFileDescriptor(fd);
+  if (host_request.host_fd < 0) {
+    return -1;
+  }
+  return enc_async_io_submit(&host_request);
+}
+
+int IOManager::ReapAsync(enc_async_io_completion *completions,
+                         int min_completions, int max_completions) {
+  int count = 0;
+  while (true) {
+    count += enc_async_io_reap(completions + count, max_completions - count);
+    if (count >= min_completions || count == max_completions) {
+      return count;
+    }
+    enc_pause();
+  }
+}
+
+void IOManager::InvalidateAttributes(IOContext *context) {
+  if (context->AttributesCacheable()) {
+    attribute_cache_.Invalidate(context);
   }
-  return ret;
 }
 
 template <typename IOAction>
-typename std::result_of<IOAction(std::shared_ptr<IOManager::IOContext>)>::type
+typename std::result_of<IOAction(IOManager::IOContext *)>::type
 IOManager::CallWithContext(int fd, IOAction action) {
-  std::shared_ptr<IOContext> context;
-  {
-    absl::ReaderMutexLock lock(&fd_table_lock_);
-    context = fd_table_.Get(fd);
-  }
+  HazardPointerDomain::Guard guard;
+  IOContext *context = fd_table_.Protect(fd, &guard);
   if (context) {
     return action(context);
   }
@@ -316,21 +807,41 @@ IOManager::CallWithContext(int fd, IOAction action) {
   return -1;
 }
 
+template <typename IOAction>
+ssize_t IOManager::CallWithStats(int fd, IOStats::Direction direction,
+                                 size_t requested, IOAction action) {
+  return CallWithContext(
+      fd, [direction, requested, &action](IOContext *context) -> ssize_t {
+        int64_t start = IOStatsClockNanoseconds();
+        ssize_t result = action(context);
+        int error = errno;
+        int64_t elapsed = IOStatsClockNanoseconds() - start;
+        context->io_stats_.Record(direction, requested, result, error,
+                                  elapsed);
+        if (context->handler_io_stats_) {
+          context->handler_io_stats_->Record(direction, requested, result,
+                                             error, elapsed);
+        }
+        errno = error;
+        return result;
+      });
+}
+
 template <typename IOAction>
 typename std::result_of<IOAction(IOManager::VirtualPathHandler *,
                                  const char *)>::type
 IOManager::CallWithHandler(const char *path, IOAction action) {
-  StatusOr<std::string> status = CanonicalizePath(path);
+  ScopedPathBuffer canonical_path;
+  VirtualPathHandler *handler = nullptr;
+  Status status = ResolvePath(path, canonical_path.get(), &handler);
   if (!status.ok()) {
-    errno = status.status().error_code();
+    errno = status.error_code();
     return -1;
   }
 
-  absl::string_view canonical_path = status.ValueOrDie();
-  VirtualPathHandler *handler = HandlerForPath(canonical_path);
   if (handler) {
     // Invoke the path handler if one is installed.
-    return action(handler, canonical_path.data());
+    return action(handler, canonical_path.get()->c_str());
   }
 
   errno = ENOENT;
@@ -342,21 +853,21 @@ typename std::result_of<IOAction(IOManager::VirtualPathHandler *, const char *,
                                  const char *)>::type
 IOManager::CallWithHandler(const char *path1, const char *path2,
                            IOAction action) {
-  StatusOr<std::string> status1 = CanonicalizePath(path1);
-  StatusOr<std::string> status2 = CanonicalizePath(path2);
+  ScopedPathBuffer canonical_path1;
+  ScopedPathBuffer canonical_path2;
+  VirtualPathHandler *handler1 = nullptr;
+  VirtualPathHandler *handler2 = nullptr;
+  Status status1 = ResolvePath(path1, canonical_path1.get(), &handler1);
+  Status status2 = ResolvePath(path2, canonical_path2.get(), &handler2);
   if (!status1.ok()) {
-    errno = status1.status().error_code();
+    errno = status1.error_code();
     return -1;
   }
   if (!status2.ok()) {
-    errno = status2.status().error_code();
+    errno = status2.error_code();
     return -1;
   }
 
-  absl::string_view canonical_path1 = status1.ValueOrDie();
-  absl::string_view canonical_path2 = status2.ValueOrDie();
-  VirtualPathHandler *handler1 = HandlerForPath(canonical_path1);
-  VirtualPathHandler *handler2 = HandlerForPath(canonical_path2);
   if (handler1 != handler2) {
     errno = EXDEV;
     return -1;
@@ -364,7 +875,8 @@ IOManager::CallWithHandler(const char *path1, const char *path2,
 
   if (handler1) {
     // Invoke the path handler if one is installed.
-    return action(handler1, canonical_path1.data(), canonical_path2.data());
+    return action(handler1, canonical_path1.get()->c_str(),
+                  canonical_path2.get()->c_str());
   }
 
   errno = ENOENT;
@@ -372,9 +884,10 @@ IOManager::CallWithHandler(const char *path1, const char *path2,
 }
 
 int IOManager::Read(int fd, char *buf, size_t count) {
-  return CallWithContext(fd, [buf, count](std::shared_ptr<IOContext> context) {
-    return context->Read(buf, count);
-  });
+  return CallWithStats(fd, IOStats::Direction::kRead, count,
+                       [buf, count](IOContext *context) {
+                         return context->Read(buf, count);
+                       });
 }
 
 bool IOManager::RegisterVirtualPathHandler(
@@ -384,12 +897,42 @@ bool IOManager::RegisterVirtualPathHandler(
     return false;
   }
 
-  prefix_to_handler_.emplace(path_prefix, std::move(handler));
+  {
+    absl::MutexLock lock(&handler_io_stats_lock_);
+    std::shared_ptr<IOStats> &io_stats = handler_io_stats_[path_prefix];
+    if (!io_stats) {
+      io_stats = std::make_shared<IOStats>();
+    }
+    handler->io_stats_ = io_stats;
+  }
+  handlers_.Insert(path_prefix, std::move(handler));
+  path_generation_.fetch_add(1, std::memory_order_acq_rel);
   return true;
 }
 
 void IOManager::DeregisterVirtualPathHandler(const std::string &path_prefix) {
-  prefix_to_handler_.erase(path_prefix);
+  handlers_.Erase(path_prefix);
+  path_generation_.fetch_add(1, std::memory_order_acq_rel);
+}
+
+void IOManager::GetIOStats(
+    std::vector<std::pair<int, IOStatsSnapshot>> *fd_stats,
+    std::vector<std::pair<std::string, IOStatsSnapshot>> *handler_stats) {
+  fd_stats->clear();
+  handler_stats->clear();
+  {
+    absl::ReaderMutexLock lock(&fd_table_lock_);
+    for (int fd = 0; fd < kMaxOpenFiles; ++fd) {
+      std::shared_ptr<IOContext> context = fd_table_.Get(fd);
+      if (context) {
+        fd_stats->emplace_back(fd, context->io_stats_.Snapshot());
+      }
+    }
+  }
+  absl::MutexLock lock(&handler_io_stats_lock_);
+  for (const auto &entry : handler_io_stats_) {
+    handler_stats->emplace_back(entry.first, entry.second->Snapshot());
+  }
 }
 
 Status IOManager::SetCurrentWorkingDirectory(absl::string_view path) {
@@ -397,6 +940,7 @@ Status IOManager::SetCurrentWorkingDirectory(absl::string_view path) {
   Status status = working_directory.status();
   if (status.ok()) {
     current_working_directory_ = working_directory.ValueOrDie();
+    path_generation_.fetch_add(1, std::memory_order_acq_rel);
   }
 
   return status;
@@ -407,60 +951,88 @@ std::string IOManager::GetCurrentWorkingDirectory() const {
 }
 
 StatusOr<std::string> IOManager::CanonicalizePath(absl::string_view path) const {
+  std::string canonical_path;
+  VirtualPathHandler *handler;
+  Status status = ResolvePath(path, &canonical_path, &handler);
+  if (!status.ok()) {
+    return status;
+  }
+  return canonical_path;
+}
+
+Status IOManager::ResolvePath(absl::string_view path,
+                              std::string *canonical_path,
+                              VirtualPathHandler **handler) const {
   // Cannot resolve an empty path.
   if (path.empty()) {
     return Status(error::PosixError::P_ENOENT,
                   "Cannot canonicalize empty path");
   }
 
-  // In some cases, the handler may be restricted for a given path.
-  // By default, though, any handler is fine.
-  VirtualPathHandler *required_handler = nullptr;
-
-  // Handle relative paths.
-  std::string relative_path;
-  if (path.front() != '/') {
-    std::string working_directory = GetCurrentWorkingDirectory();
-
-    // If the current working directory has not yet been set, cannot
-    // canonicalize relative paths.
-    if (working_directory.empty()) {
-      return Status(error::PosixError::P_ENOENT,
-                    "Canonicalization of relative path before initialization");
-    }
-
-    // Prepend the working directory to the given path. Don't worry about
-    // possible duplicate '/' characters, as NormalizePath will strip them out.
-    relative_path = absl::StrCat(working_directory, "/", path);
-    path = relative_path;
+  // Absolute paths only need to be normalized to remove any directory
+  // traversals.
+  if (path.front() == '/') {
+    util::NormalizePath(path, canonical_path);
+    *handler = HandlerForPath(*canonical_path);
+    return Status::OkStatus();
+  }
 
-    // Relative paths are only allowed to resolve to the same handler as the
-    // working directory.
-    required_handler = HandlerForPath(working_directory);
+  // Relative paths resolve against the current working directory, so a
+  // previous resolution of the same path is valid until the working directory
+  // or the set of handlers changes.
+  uint64_t generation = path_generation_.load(std::memory_order_acquire);
+  CanonicalPathCacheEntry *entry = CacheEntryForPath(path);
+  if (entry->generation == generation && entry->relative_path == path) {
+    canonical_path->assign(entry->canonical_path);
+    *handler = entry->handler;
+    return Status::OkStatus();
   }
 
-  // Normalize the path to remove any directory traversals.
-  std::string ret = util::NormalizePath(path);
+  // If the current working directory has not yet been set, cannot
+  // canonicalize relative paths.
+  const std::string &working_directory = current_working_directory_;
+  if (working_directory.empty()) {
+    return Status(error::PosixError::P_ENOENT,
+                  "Canonicalization of relative path before initialization");
+  }
 
-  // If the allowed handler for this path is restricted, check that it matches
-  // the requirement.
-  if (required_handler && HandlerForPath(ret) != required_handler) {
+  // Prepend the working directory to the given path. Don't worry about
+  // possible duplicate '/' characters, as NormalizePath will strip them out.
+  ScopedPathBuffer joined_path;
+  joined_path.get()->assign(working_directory);
+  joined_path.get()->push_back('/');
+  joined_path.get()->append(path.data(), path.size());
+  util::NormalizePath(*joined_path.get(), canonical_path);
+  *handler = HandlerForPath(*canonical_path);
+
+  // Relative paths are only allowed to resolve to the same handler as the
+  // working directory.
+  VirtualPathHandler *required_handler = HandlerForPath(working_directory);
+  if (required_handler && *handler != required_handler) {
     return Status(error::PosixError::P_EACCES,
                   "Relative path resolution across access domains");
   }
 
-  return ret;
+  entry->generation = generation;
+  entry->relative_path.assign(path.data(), path.size());
+  entry->canonical_path.assign(*canonical_path);
+  entry->handler = *handler;
+  return Status::OkStatus();
 }
 
 int IOManager::Write(int fd, const char *buf, size_t count) {
-  return CallWithContext(fd, [buf, count](std::shared_ptr<IOContext> context) {
-    return context->Write(buf, count);
-  });
+  return CallWithStats(fd, IOStats::Direction::kWrite, count,
+                       [this, buf, count](IOContext *context) {
+                         InvalidateAttributes(context);
+                         return context->Write(buf, count);
+                       });
 }
 
 int IOManager::Chown(const char *path, uid_t owner, gid_t group) {
-  return CallWithHandler(path, [owner, group](VirtualPathHandler *handler,
-                                              const char *canonical_path) {
+  return CallWithHandler(path, [this, owner, group](
+                                   VirtualPathHandler *handler,
+                                   const char *canonical_path) {
+    attribute_cache_.InvalidatePath(canonical_path);
     return handler->Chown(canonical_path, owner, group);
   });
 }
@@ -468,17 +1040,19 @@ int IOManager::Chown(const char *path, uid_t owner, gid_t group) {
 int IOManager::Link(const char *from, const char *to) {
   return CallWithHandler(
       from, to,
-      [](VirtualPathHandler *handler, const char *canonical_from,
-         const char *canonical_to) {
+      [this](VirtualPathHandler *handler, const char *canonical_from,
+             const char *canonical_to) {
+        attribute_cache_.InvalidatePath(canonical_from);
         return handler->Link(canonical_from, canonical_to);
       });
 }
 
 int IOManager::Unlink(const char *pathname) {
-  return CallWithHandler(
-      pathname, [](VirtualPathHandler *handler, const char *canonical_path) {
-        return handler->Unlink(canonical_path);
-      });
+  return CallWithHandler(pathname, [this](VirtualPathHandler *handler,
+                                          const char *canonical_path) {
+    attribute_cache_.InvalidatePath(canonical_path);
+    return handler->Unlink(canonical_path);
+  });
 }
 
 ssize_t IOManager::ReadLink(const char *path, char *buf, size_t bufsize) {
@@ -497,23 +1071,33 @@ int IOManager::SymLink(const char *from, const char *to) {
       });
 }
 
+// Files with cached attributes are regular files, so both stat and lstat of
+// their paths are served from the cache.
 int IOManager::Stat(const char *pathname, struct stat *stat_buffer) {
-  return CallWithHandler(pathname, [stat_buffer](VirtualPathHandler *handler,
-                                                 const char *canonical_path) {
+  return CallWithHandler(pathname, [this, stat_buffer](
+                                       VirtualPathHandler *handler,
+                                       const char *canonical_path) {
+    if (attribute_cache_.LookupPath(canonical_path, stat_buffer)) {
+      return 0;
+    }
     return handler->Stat(canonical_path, stat_buffer);
   });
 }
 
 int IOManager::LStat(const char *pathname, struct stat *stat_buffer) {
-  return CallWithHandler(pathname, [stat_buffer](VirtualPathHandler *handler,
-                                                 const char *canonical_path) {
+  return CallWithHandler(pathname, [this, stat_buffer](
+                                       VirtualPathHandler *handler,
+                                       const char *canonical_path) {
+    if (attribute_cache_.LookupPath(canonical_path, stat_buffer)) {
+      return 0;
+    }
     return handler->LStat(canonical_path, stat_buffer);
   });
 }
 
 int IOManager::LSeek(int fd, off_t offset, int whence) {
   return CallWithContext(fd,
-                         [offset, whence](std::shared_ptr<IOContext> context) {
+                         [offset, whence](IOContext *context) {
                            return context->LSeek(offset, whence);
                          });
 }
@@ -531,32 +1115,52 @@ int IOManager::FCntl(int fd, int cmd, int64_t arg) {
     errno = EBADF;
     return -1;
   }
-  return CallWithContext(fd, [cmd, arg](std::shared_ptr<IOContext> context) {
+  return CallWithContext(fd, [cmd, arg](IOContext *context) {
     return context->FCntl(cmd, arg);
   });
 }
 
 int IOManager::FSync(int fd) {
-  return CallWithContext(
-      fd, [](std::shared_ptr<IOContext> context) { return context->FSync(); });
+  return CallWithContext(fd, [this](IOContext *context) {
+    InvalidateAttributes(context);
+    return context->FSync();
+  });
+}
+
+int IOManager::FTruncate(int fd, off_t length) {
+  return CallWithContext(fd, [this, length](IOContext *context) {
+    InvalidateAttributes(context);
+    return context->FTruncate(length);
+  });
 }
 
 int IOManager::FStat(int fd, struct stat *stat_buffer) {
-  return CallWithContext(fd, [stat_buffer](std::shared_ptr<IOContext> context) {
-    return context->FStat(stat_buffer);
+  return CallWithContext(fd, [this, stat_buffer](IOContext *context) {
+    if (!context->AttributesCacheable()) {
+      return context->FStat(stat_buffer);
+    }
+    uint64_t generation;
+    if (attribute_cache_.Lookup(context, stat_buffer, &generation)) {
+      return 0;
+    }
+    int ret = context->FStat(stat_buffer);
+    if (ret == 0) {
+      attribute_cache_.Insert(context, *stat_buffer, generation);
+    }
+    return ret;
   });
 }
 
 int IOManager::Isatty(int fd) {
   return CallWithContext(
-      fd, [](std::shared_ptr<IOContext> context) { return context->Isatty(); });
+      fd, [](IOContext *context) { return context->Isatty(); });
 }
 
 int IOManager::Ioctl(int fd, int request, void *argp) {
-  return CallWithContext(fd,
-                         [request, argp](std::shared_ptr<IOContext> context) {
-                           return context->Ioctl(request, argp);
-                         });
+  return CallWithContext(fd, [this, request, argp](IOContext *context) {
+    InvalidateAttributes(context);
+    return context->Ioctl(request, argp);
+  });
 }
 
 int IOManager::Mkdir(const char *path, mode_t mode) {
@@ -567,19 +1171,57 @@ int IOManager::Mkdir(const char *path, mode_t mode) {
 }
 
 ssize_t IOManager::Writev(int fd, const struct iovec *iov, int iovcnt) {
-  return CallWithContext(fd, [iov, iovcnt](std::shared_ptr<IOContext> context) {
-    return context->Writev(iov, iovcnt);
+  return CallWithStats(fd, IOStats::Direction::kWrite, IovLength(iov, iovcnt),
+                       [this, iov, iovcnt](IOContext *context) {
+                         InvalidateAttributes(context);
+                         return context->Writev(iov, iovcnt);
+                       });
+}
+
+ssize_t IOManager::Pread(int fd, void *buf, size_t count, off_t offset) {
+  if (offset < 0) {
+    errno = EINVAL;
+    return -1;
+  }
+  return CallWithStats(fd, IOStats::Direction::kRead, count,
+                       [buf, count, offset](IOContext *context) {
+                         return context->Pread(buf, count, offset);
+                       });
+}
+
+ssize_t IOManager::Pwrite(int fd, const void *buf, size_t count,
+                          off_t offset) {
+  if (offset < 0) {
+    errno = EINVAL;
+    return -1;
+  }
+  return CallWithStats(fd, IOStats::Direction::kWrite, count,
+                       [this, buf, count, offset](IOContext *context) {
+                         InvalidateAttributes(context);
+                         return context->Pwrite(buf, count, offset);
+                       });
+}
+
+ssize_t IOManager::GetDents(int fd, void *buf, size_t count) {
+  return CallWithContext(fd, [buf, count](IOContext *context) {
+    return context->GetDents(buf, count);
   });
 }
 
 ssize_t IOManager::Readv(int fd, const struct iovec *iov, int iovcnt) {
-  return CallWithContext(fd, [iov, iovcnt](std::shared_ptr<IOContext> context) {
-    return context->Readv(iov, iovcnt);
-  });
+  return CallWithStats(fd, IOStats::Direction::kRead, IovLength(iov, iovcnt),
+                       [iov, iovcnt](IOContext *context) {
+                         return context->Readv(iov, iovcnt);
+                       });
 }
 
 mode_t IOManager::Umask(mode_t mask) { return enc_untrusted_umask(mask); }
 
+int IOManager::CountOpenFileDescriptors() {
+  absl::ReaderMutexLock lock(&fd_table_lock_);
+  return fd_table_.CountFileDescriptorsUsed();
+}
+
 int IOManager::GetRLimit(int resource, struct rlimit *rlim) {
   if (!rlim) {
     errno = EFAULT;
@@ -627,30 +1269,38 @@ int IOManager::SetRLimit(int resource, const struct rlimit *rlim) {
 int IOManager::SetSockOpt(int sockfd, int level, int option_name,
                           const void *option_value, socklen_t option_len) {
   return CallWithContext(sockfd, [level, option_name, option_value, option_len](
-                                     std::shared_ptr<IOContext> context) {
+                                     IOContext *context) {
     return context->SetSockOpt(level, option_name, option_value, option_len);
   });
 }
 
+int IOManager::SetIntSockOpts(int sockfd,
+                              const struct enc_int_sockopt *options,
+                              size_t count) {
+  return CallWithContext(sockfd, [options, count](IOContext *context) {
+    return context->SetIntSockOpts(options, count);
+  });
+}
+
 int IOManager::Connect(int sockfd, const struct sockaddr *addr,
                        socklen_t addrlen) {
   return CallWithContext(sockfd,
-                         [addr, addrlen](std::shared_ptr<IOContext> context) {
+                         [addr, addrlen](IOContext *context) {
                            return context->Connect(addr, addrlen);
                          });
 }
 
 int IOManager::Shutdown(int sockfd, int how) {
-  return CallWithContext(sockfd, [how](std::shared_ptr<IOContext> context) {
+  return CallWithContext(sockfd, [how](IOContext *context) {
     return context->Shutdown(how);
   });
 }
 
 ssize_t IOManager::Send(int sockfd, const void *buf, size_t len, int flags) {
-  return CallWithContext(sockfd,
-                         [buf, len, flags](std::shared_ptr<IOContext> context) {
-                           return context->Send(buf, len, flags);
-                         });
+  return CallWithStats(sockfd, IOStats::Direction::kWrite, len,
+                       [buf, len, flags](IOContext *context) {
+                         return context->Send(buf, len, flags);
+                       });
 }
 
 int IOManager::Socket(int domain, int type, int protocol) {
@@ -669,14 +1319,14 @@ int IOManager::Socket(int domain, int type, int protocol) {
 int IOManager::GetSockOpt(int sockfd, int level, int optname, void *optval,
                           socklen_t *optlen) {
   return CallWithContext(sockfd, [level, optname, optval,
-                                  optlen](std::shared_ptr<IOContext> context) {
+                                  optlen](IOContext *context) {
     return context->GetSockOpt(level, optname, optval, optlen);
   });
 }
 
 int IOManager::Accept(int sockfd, struct sockaddr *addr, socklen_t *addrlen) {
   int ret = CallWithContext(
-      sockfd, [addr, addrlen](std::shared_ptr<IOContext> context) {
+      sockfd, [addr, addrlen](IOContext *context) {
         return context->Accept(addr, addrlen);
       });
   if (ret < 0) {
@@ -689,38 +1339,75 @@ int IOManager::Accept(int sockfd, struct sockaddr *addr, socklen_t *addrlen) {
   return ret;
 }
 
+int IOManager::Accept4(int sockfd, struct sockaddr *addr, socklen_t *addrlen,
+                       int flags) {
+  if (flags & ~(SOCK_NONBLOCK | SOCK_CLOEXEC)) {
+    errno = EINVAL;
+    return -1;
+  }
+  int ret = CallWithContext(
+      sockfd, [addr, addrlen, flags](IOContext *context) {
+        return context->Accept4(addr, addrlen, flags);
+      });
+  if (ret < 0) {
+    return -1;
+  }
+  ret = this->RegisterHostFileDescriptor(ret);
+  if (ret < 0) {
+    errno = EMFILE;
+  }
+  return ret;
+}
+
 int IOManager::Bind(int sockfd, const struct sockaddr *addr,
                     socklen_t addrlen) {
   return CallWithContext(sockfd,
-                         [addr, addrlen](std::shared_ptr<IOContext> context) {
+                         [addr, addrlen](IOContext *context) {
                            return context->Bind(addr, addrlen);
                          });
 }
 
 int IOManager::Listen(int sockfd, int backlog) {
-  return CallWithContext(sockfd, [backlog](std::shared_ptr<IOContext> context) {
+  return CallWithContext(sockfd, [backlog](IOContext *context) {
     return context->Listen(backlog);
   });
 }
 
 ssize_t IOManager::SendMsg(int sockfd, const struct msghdr *msg, int flags) {
-  return CallWithContext(sockfd,
-                         [msg, flags](std::shared_ptr<IOContext> context) {
-                           return context->SendMsg(msg, flags);
-                         });
+  size_t requested = msg ? IovLength(msg->msg_iov, msg->msg_iovlen) : 0;
+  return CallWithStats(sockfd, IOStats::Direction::kWrite, requested,
+                       [msg, flags](IOContext *context) {
+                         return context->SendMsg(msg, flags);
+                       });
 }
 
 ssize_t IOManager::RecvMsg(int sockfd, struct msghdr *msg, int flags) {
-  return CallWithContext(sockfd,
-                         [msg, flags](std::shared_ptr<IOContext> context) {
-                           return context->RecvMsg(msg, flags);
-                         });
+  size_t requested = msg ? IovLength(msg->msg_iov, msg->msg_iovlen) : 0;
+  return CallWithStats(sockfd, IOStats::Direction::kRead, requested,
+                       [msg, flags](IOContext *context) {
+                         return context->RecvMsg(msg, flags);
+                       });
+}
+
+int IOManager::SendMmsg(int sockfd, struct mmsghdr *msgvec, unsigned int vlen,
+                        int flags) {
+  return CallWithContext(sockfd, [msgvec, vlen, flags](IOContext *context) {
+    return context->SendMmsg(msgvec, vlen, flags);
+  });
+}
+
+int IOManager::RecvMmsg(int sockfd, struct mmsghdr *msgvec, unsigned int vlen,
+                        int flags, struct timespec *timeout) {
+  return CallWithContext(
+      sockfd, [msgvec, vlen, flags, timeout](IOContext *context) {
+        return context->RecvMmsg(msgvec, vlen, flags, timeout);
+      });
 }
 
 int IOManager::GetSockName(int sockfd, struct sockaddr *addr,
                            socklen_t *addrlen) {
   return CallWithContext(sockfd,
-                         [addr, addrlen](std::shared_ptr<IOContext> context) {
+                         [addr, addrlen](IOContext *context) {
                            return context->GetSockName(addr, addrlen);
                          });
 }
@@ -728,7 +1415,7 @@ int IOManager::GetSockName(int sockfd, struct sockaddr *addr,
 int IOManager::GetPeerName(int sockfd, struct sockaddr *addr,
                            socklen_t *addrlen) {
   return CallWithContext(sockfd,
-                         [addr, addrlen](std::shared_ptr<IOContext> context) {
+                         [addr, addrlen](IOContext *context) {
                            return context->GetPeerName(addr, addrlen);
                          });
 }
@@ -20,6 +20,7 @@
 #define ASYLO_PLATFORM_POSIX_IO_IO_MANAGER_H_
 
 #include <errno.h>
+#include <sys/epoll.h>
 #include <sys/resource.h>
 #include <sys/socket.h>
 #include <sys/stat.h>
@@ -29,15 +30,26 @@
 #include <stdint.h>
 #include <cstdlib>
 #include <functional>
+#include <array>
+#include <atomic>
 #include <map>
 #include <memory>
 #include <queue>
+#include <string>
 #include <type_traits>
 #include <unordered_map>
+#include <utility>
+#include <vector>
 
 #include "absl/memory/memory.h"
 #include "absl/strings/string_view.h"
 #include "absl/synchronization/mutex.h"
+#include "asylo/platform/arch/include/trusted/async_io.h"
+#include "asylo/platform/arch/include/trusted/host_calls.h"
+#include "asylo/platform/common/hazard_pointer.h"
+#include "asylo/platform/posix/io/attribute_cache.h"
+#include "asylo/platform/posix/io/io_stats.h"
+#include "asylo/platform/posix/io/path_trie.h"
 #include "asylo/platform/storage/secure/enclave_storage_secure.h"
 #include "asylo/util/statusor.h"
 
@@ -52,6 +64,44 @@ class IOManager {
   // time.
   static const constexpr int kMaxOpenFiles = 1024;
 
+  // Wakes a thread waiting in Poll when a context not backed by a host file
+  // descriptor may have become ready. A thread which also polls host file
+  // descriptors waits on the host, and is woken by a byte written to
+  // |host_wake_fd|; a thread which polls only enclave contexts waits inside
+  // the enclave.
+  class PollWaiter {
+   public:
+    // |host_wake_fd| is a non-blocking host file descriptor, or -1.
+    explicit PollWaiter(int host_wake_fd) : host_wake_fd_(host_wake_fd) {}
+
+    PollWaiter(const PollWaiter &) = delete;
+    PollWaiter &operator=(const PollWaiter &) = delete;
+
+    // Wakes the waiting thread. Only the first call after construction has an
+    // effect.
+    void Notify() LOCKS_EXCLUDED(mu_);
+
+    // Waits inside the enclave until Notify is called or |timeout|
+    // milliseconds pass, without a limit if |timeout| is negative. Returns
+    // true if Notify was called.
+    bool Wait(int timeout) LOCKS_EXCLUDED(mu_);
+
+    // Returns true if Notify has been called.
+    bool notified() LOCKS_EXCLUDED(mu_);
+
+   private:
+    absl::Mutex mu_;
+    bool notified_ GUARDED_BY(mu_) = false;
+    const int host_wake_fd_;
+  };
+
+  // The registration of a PollWaiter with an IOContext, which is removed when
+  // the object is destroyed. It may outlive the context.
+  class PollRegistration {
+   public:
+    virtual ~PollRegistration() = default;
+  };
+
   // An IOContext object represents an abstract I/O stream. Different concrete
   // implementations might wrap a native file descriptor on the host, a virtual
   // device like "/dev/urandom" backed by software, or a secure stream with
@@ -67,6 +117,18 @@ class IOManager {
     // Implements IOManager::Write.
     virtual ssize_t Write(const void *buf, size_t count) = 0;
 
+    // Implements IOManager::Pread.
+    virtual ssize_t Pread(void *buf, size_t count, off_t offset) {
+      errno = ENOSYS;
+      return -1;
+    }
+
+    // Implements IOManager::Pwrite.
+    virtual ssize_t Pwrite(const void *buf, size_t count, off_t offset) {
+      errno = ENOSYS;
+      return -1;
+    }
+
     // Implements IOManager::Close.
     virtual int Close() = 0;
 
@@ -88,6 +150,12 @@ class IOManager {
       return -1;
     }
 
+    // Implements IOManager::FTruncate.
+    virtual int FTruncate(off_t length) {
+      errno = ENOSYS;
+      return -1;
+    }
+
     // Implements IOManager::FStat.
     virtual int FStat(struct stat *st) {
       errno = ENOSYS;
@@ -117,6 +185,12 @@ class IOManager {
       return -1;
     }
 
+    // Implements IOManager::GetDents.
+    virtual ssize_t GetDents(void *buf, size_t count) {
+      errno = ENOTDIR;
+      return -1;
+    }
+
     // Implements setsockopt.
     virtual int SetSockOpt(int level, int option_name, const void *option_value,
                            socklen_t option_len) {
@@ -124,6 +198,20 @@ class IOManager {
       return -1;
     }
 
+    // Sets |count| integer socket options in order, stopping at the first
+    // failure. Contexts backed by a host socket override this to set them all
+    // in a single host call.
+    virtual int SetIntSockOpts(const struct enc_int_sockopt *options,
+                               size_t count) {
+      for (size_t i = 0; i < count; ++i) {
+        if (SetSockOpt(options[i].level, options[i].option_name,
+                       &options[i].value, sizeof(options[i].value)) != 0) {
+          return -1;
+        }
+      }
+      return 0;
+    }
+
     // Implements connect.
     virtual int Connect(const struct sockaddr *addr, socklen_t addrlen) {
       errno = ENOSYS;
@@ -155,6 +243,12 @@ class IOManager {
       return -1;
     }
 
+    // Implements accept4.
+    virtual int Accept4(struct sockaddr *addr, socklen_t *addrlen, int flags) {
+      errno = ENOSYS;
+      return -1;
+    }
+
     // Implements bind.
     virtual int Bind(const struct sockaddr *addr, socklen_t addrlen) {
       errno = ENOSYS;
@@ -179,6 +273,20 @@ class IOManager {
       return -1;
     }
 
+    // Implements sendmmsg.
+    virtual int SendMmsg(struct mmsghdr *msgvec, unsigned int vlen,
+                         int flags) {
+      errno = ENOSYS;
+      return -1;
+    }
+
+    // Implements recvmmsg.
+    virtual int RecvMmsg(struct mmsghdr *msgvec, unsigned int vlen, int flags,
+                         struct timespec *timeout) {
+      errno = ENOSYS;
+      return -1;
+    }
+
     // Implements getsockname.
     virtual int GetSockName(struct sockaddr *addr, socklen_t *addrlen) {
       errno = ENOSYS;
@@ -191,10 +299,51 @@ class IOManager {
       return -1;
     }
 
+    // Implements epoll_ctl. |fd| is the enclave file descriptor being
+    // registered with this epoll instance and |host_fd| is the host file
+    // descriptor backing it.
+    virtual int EpollCtl(int op, int fd, int host_fd,
+                         struct epoll_event *event) {
+      errno = EINVAL;
+      return -1;
+    }
+
+    // Implements epoll_wait.
+    virtual int EpollWait(struct epoll_event *events, int maxevents,
+                          int timeout) {
+      errno = EINVAL;
+      return -1;
+    }
+
     virtual int GetHostFileDescriptor() { return -1; }
 
+    // Returns the poll(2) events among |events|, plus POLLERR and POLLHUP,
+    // which are ready on a context not backed by a host file descriptor.
+    virtual short PollEvents(short events) { return 0; }
+
+    // Registers |waiter| to be notified when the events returned by
+    // PollEvents may have changed, for the lifetime of the returned object.
+    // Returns null if the events of the context never change on their own.
+    virtual std::unique_ptr<PollRegistration> AddPollWaiter(
+        PollWaiter *waiter) {
+      return nullptr;
+    }
+
+    // Returns true if the attributes reported by FStat only change when the
+    // enclave writes through this context, so IOManager may cache them until
+    // then.
+    virtual bool AttributesCacheable() { return false; }
+
    private:
     friend class IOManager;
+
+    // Reads and writes done through this context, shared by the file
+    // descriptors duplicated from it.
+    IOStats io_stats_;
+
+    // Reads and writes done through all the contexts opened by the same
+    // VirtualPathHandler, or null if the context was not opened by one.
+    std::shared_ptr<IOStats> handler_io_stats_;
   };
 
   // A VirtualPathHandler maps file paths to appropriate behavior
@@ -254,11 +403,16 @@ class IOManager {
 
    private:
     friend class IOManager;
+
+    // Reads and writes done through the contexts this handler opened, set
+    // when the handler is registered.
+    std::shared_ptr<IOStats> io_stats_;
   };
 
   // A table of virtual file descriptors managed by the IOManager.
-  // This class is not thread safe. IOManager is responsible for locking the
-  // access to objects of this class.
+  // This class is not thread safe. IOManager is responsible for serializing
+  // calls which modify the table, and calls which read it other than
+  // Protect().
   class FileDescriptorTable {
    public:
     FileDescriptorTable();
@@ -267,6 +421,12 @@ class IOManager {
     // no such context exists.
     std::shared_ptr<IOContext> Get(int fd);
 
+    // Returns the IOContext associated with a file descriptor, or nullptr if
+    // no such context exists, and protects it from destruction for the
+    // lifetime of |guard|. This may be called concurrently with any other
+    // method of the table, and takes no locks.
+    IOContext *Protect(int fd, HazardPointerDomain::Guard *guard);
+
     // Returns whether the IOContext for |fd| is shared by more than one
     // fd_table_ entry. Returns false if |fd| is not  valid.
     bool HasSharedIOContext(int fd);
@@ -302,6 +462,9 @@ class IOManager {
 
     bool SetFileDescriptorLimits(const struct rlimit *rlim);
 
+    // Returns the number of file descriptors in use.
+    int CountFileDescriptorsUsed();
+
     int get_maximum_fd_soft_limit();
 
     int get_maximum_fd_hard_limit();
@@ -318,8 +481,18 @@ class IOManager {
     // |startfd|. Returns -1 if there is no file descriptor available.
     int GetNextFreeFileDescriptor(int startfd);
 
+    // Stores |context| as the entry for |fd|, which must be valid. A context
+    // whose last entry is replaced is destroyed once no reader protects it.
+    void SetEntry(int fd, std::shared_ptr<IOContext> context);
+
     std::array<std::shared_ptr<IOContext>, kMaxOpenFiles> fd_table_;
 
+    // The contexts of fd_table_, published for lock-free readers.
+    std::array<std::atomic<IOContext *>, kMaxOpenFiles> published_contexts_;
+
+    // Defers destruction of contexts removed from the table.
+    HazardPointerDomain retired_contexts_;
+
     // The maximum file descriptor number allowed.
     int maximum_fd_soft_limit;
 
@@ -380,6 +553,19 @@ class IOManager {
   // |pipefd[1]| refers to the write end.
   int Pipe(int pipefd[2]);
 
+  // Implements pipe2(2). |flags| may hold O_NONBLOCK and O_CLOEXEC, which
+  // apply to both ends, and O_SECURE. Without O_SECURE the pipe is a host pipe
+  // like one created by Pipe. With it, the pipe is kept inside the enclave, so
+  // its data never reaches the host, but its ends cannot be registered with
+  // epoll or used with splice or sendfile.
+  int Pipe2(int pipefd[2], int flags) LOCKS_EXCLUDED(fd_table_lock_);
+
+  // Implements socketpair(2) for AF_UNIX stream sockets kept inside the
+  // enclave like the pipes created by Pipe2 with O_SECURE. |type| must hold
+  // SOCK_SECURE, since socket pairs backed by the host are not supported.
+  int SocketPair(int domain, int type, int protocol, int sv[2])
+      LOCKS_EXCLUDED(fd_table_lock_);
+
   // Reads up to |count| bytes from the stream into |buf|, returning the number
   // of bytes read on success or -1 on error.
   int Read(int fd, char *buf, size_t count);
@@ -400,6 +586,9 @@ class IOManager {
   // Implements fsync(2).
   int FSync(int fd);
 
+  // Implements ftruncate(2).
+  int FTruncate(int fd, off_t length);
+
   // Implements ioctl(2).
   int Ioctl(int fd, int request, void *argp);
 
@@ -416,6 +605,42 @@ class IOManager {
   int Poll(struct pollfd *fds, nfds_t nfds, int timeout)
       LOCKS_EXCLUDED(fd_table_lock_);
 
+  // Implements epoll_create1(2).
+  int EpollCreate(int flags) LOCKS_EXCLUDED(fd_table_lock_);
+
+  // Implements epoll_ctl(2).
+  int EpollCtl(int epfd, int op, int fd, struct epoll_event *event);
+
+  // Implements epoll_wait(2).
+  int EpollWait(int epfd, struct epoll_event *events, int maxevents,
+                int timeout);
+
+  // Submits |request| for asynchronous execution on the host file descriptor
+  // backing the enclave file descriptor |fd|, ignoring |request.host_fd|.
+  // Returns 0 on success, or -1 with errno set as by enc_async_io_submit, or to
+  // EBADF if |fd| is not open or EINVAL if it is not backed by a host file
+  // descriptor.
+  int SubmitAsync(int fd, const enc_async_io_request &request);
+
+  // Stores between |min_completions| and |max_completions| completed
+  // asynchronous operations in |completions|, spinning until at least
+  // |min_completions| are available. Returns the number stored.
+  int ReapAsync(enc_async_io_completion *completions, int min_completions,
+                int max_completions);
+
+  // Implements sendfile(2). Both descriptors must be backed by host file
+  // descriptors, so that the data is copied on the host without entering the
+  // enclave; otherwise fails with EINVAL.
+  ssize_t SendFile(int out_fd, int in_fd, off_t *offset, size_t count);
+
+  // Implements splice(2), under the same restrictions as SendFile.
+  ssize_t Splice(int fd_in, off_t *off_in, int fd_out, off_t *off_out,
+                 size_t len, unsigned int flags);
+
+  // Implements copy_file_range(2), under the same restrictions as SendFile.
+  ssize_t CopyFileRange(int fd_in, off_t *off_in, int fd_out, off_t *off_out,
+                        size_t len, unsigned int flags);
+
   // Implements mkdir(2).
   int Mkdir(const char *pathname, mode_t mode);
 
@@ -425,6 +650,16 @@ class IOManager {
   // Implements readv(2).
   ssize_t Readv(int fd, const struct iovec *iov, int iovcnt);
 
+  // Implements pread(2).
+  ssize_t Pread(int fd, void *buf, size_t count, off_t offset);
+
+  // Implements pwrite(2).
+  ssize_t Pwrite(int fd, const void *buf, size_t count, off_t offset);
+
+  // Implements getdents64(2), reading the next records of the directory open
+  // on |fd| into |buf| in the Linux linux_dirent64 layout.
+  ssize_t GetDents(int fd, void *buf, size_t count);
+
   // Implements umask(2).
   mode_t Umask(mode_t mask);
 
@@ -432,6 +667,9 @@ class IOManager {
   int GetRLimit(int resource, struct rlimit *rlim)
       LOCKS_EXCLUDED(fd_table_lock_);
 
+  // Returns the number of file descriptors open in the enclave.
+  int CountOpenFileDescriptors() LOCKS_EXCLUDED(fd_table_lock_);
+
   // Implements setrlimit(2).
   int SetRLimit(int resource, const struct rlimit *rlim)
       LOCKS_EXCLUDED(fd_table_lock_);
@@ -440,6 +678,12 @@ class IOManager {
   int SetSockOpt(int sockfd, int level, int option_name,
                  const void *option_value, socklen_t option_len);
 
+  // Sets the |count| integer socket options |options| on |sockfd| in order.
+  // Returns 0, or -1 with errno set by the first option which fails, in which
+  // case the later options are not set.
+  int SetIntSockOpts(int sockfd, const struct enc_int_sockopt *options,
+                     size_t count);
+
   // Implements connect(2).
   int Connect(int sockfd, const struct sockaddr *addr, socklen_t addrlen);
 
@@ -456,6 +700,11 @@ class IOManager {
   // Implements accept(2).
   int Accept(int sockfd, struct sockaddr *addr, socklen_t *addrlen);
 
+  // Implements accept4(2). Only SOCK_NONBLOCK and SOCK_CLOEXEC are accepted in
+  // |flags|.
+  int Accept4(int sockfd, struct sockaddr *addr, socklen_t *addrlen,
+              int flags);
+
   // Implements bind(2).
   int Bind(int sockfd, const struct sockaddr *addr, socklen_t addrlen);
 
@@ -468,6 +717,14 @@ class IOManager {
   // Implements recvmsg(2).
   ssize_t RecvMsg(int sockfd, struct msghdr *msg, int flags);
 
+  // Implements sendmmsg(2).
+  int SendMmsg(int sockfd, struct mmsghdr *msgvec, unsigned int vlen,
+               int flags);
+
+  // Implements recvmmsg(2).
+  int RecvMmsg(int sockfd, struct mmsghdr *msgvec, unsigned int vlen,
+               int flags, struct timespec *timeout);
+
   // Implements getsockname(2).
   int GetSockName(int sockfd, struct sockaddr *addr, socklen_t *addrlen);
 
@@ -482,6 +739,27 @@ class IOManager {
   // operating system.
   int RegisterHostFileDescriptor(int host_fd) LOCKS_EXCLUDED(fd_table_lock_);
 
+  // Returns the host file descriptor backing the enclave file descriptor |fd|,
+  // or -1 with errno set to EBADF if |fd| is not open or to EINVAL if it is
+  // not backed by a host file descriptor.
+  int HostFileDescriptor(int fd) LOCKS_EXCLUDED(fd_table_lock_);
+
+  // Sets the size of the trusted buffer staging reads and writes on host
+  // regular files and pipes opened after this call. Zero, the default,
+  // disables buffering.
+  void SetNativeBufferSize(size_t size) { native_buffer_size_ = size; }
+
+  // Returns the buffer size set by SetNativeBufferSize.
+  size_t native_buffer_size() const { return native_buffer_size_; }
+
+  // Sets the size of the buffer each directory stream opened after this call
+  // fetches entries into, so that readdir leaves the enclave once per batch of
+  // entries rather than once per entry.
+  void SetReaddirBatchSize(size_t size) { readdir_batch_size_ = size; }
+
+  // Returns the batch size set by SetReaddirBatchSize.
+  size_t readdir_batch_size() const { return readdir_batch_size_; }
+
   // Registers the handler responsible for a given path prefix.
   // When processing a path, the handler with the longest prefix shared with the
   // path will be chosen.  Prefixes are considered shared only on whole
@@ -495,6 +773,19 @@ class IOManager {
   // Deregisters the handler responsible for a given path prefix
   void DeregisterVirtualPathHandler(const std::string &path_prefix);
 
+  // Stores the totals of the reads and writes done on each open file
+  // descriptor in |fd_stats|, by increasing file descriptor, and those done on
+  // the files opened through the handlers registered under each path prefix in
+  // |handler_stats|, by path prefix. File descriptors duplicated from one
+  // another share their totals. Handler totals include closed files, and are
+  // kept when the handler is deregistered. Reads and writes counted are those
+  // done by Read, Write, Readv, Writev, Pread, Pwrite, Send, SendMsg and
+  // RecvMsg.
+  void GetIOStats(
+      std::vector<std::pair<int, IOStatsSnapshot>> *fd_stats,
+      std::vector<std::pair<std::string, IOStatsSnapshot>> *handler_stats)
+      LOCKS_EXCLUDED(fd_table_lock_, handler_io_stats_lock_);
+
   Status SetCurrentWorkingDirectory(absl::string_view path);
   std::string GetCurrentWorkingDirectory() const;
 
@@ -508,20 +799,47 @@ class IOManager {
   // relative paths and path normalization.
   StatusOr<std::string> CanonicalizePath(absl::string_view path) const;
 
+  // Canonicalizes |path| into |canonical_path|, reusing its storage, and stores
+  // the VirtualPathHandler responsible for the result in |handler|. Relative
+  // paths are resolved through a small per-thread cache which is invalidated
+  // whenever the working directory or the set of handlers changes.
+  Status ResolvePath(absl::string_view path, std::string *canonical_path,
+                     VirtualPathHandler **handler) const;
+
   // Closes a file descriptor by removing it from |fd_table_|, and closing the
   // corresponding host file descriptor if this is the last reference to it.
   // This method does not obtain a locker. Caller of this method is responsible
   // for obtaining |fd_table_lock_|.
   int CloseFileDescriptor(int fd) EXCLUSIVE_LOCKS_REQUIRED(fd_table_lock_);
 
+  // Forgets the cached attributes of the file |context| is open on, before it
+  // is modified through |context|.
+  void InvalidateAttributes(IOContext *context);
+
+  // Inserts |first| and |second| into |fd_table_|, storing their file
+  // descriptors in |fds|. Returns 0 on success, or -1 with errno set to EMFILE
+  // if the table can not hold both.
+  int InsertContextPair(std::unique_ptr<IOContext> first,
+                        std::unique_ptr<IOContext> second, int fds[2])
+      LOCKS_EXCLUDED(fd_table_lock_);
+
   // Fetches the VirtualFileHandler associated with a given path, or
   // nullptr if no entry is found.
   VirtualPathHandler *HandlerForPath(absl::string_view path) const;
 
-  // Locks the mutex corresponding to |fd| and perform thread safe action.
+  // Performs |action| on the IOContext corresponding to |fd|. The context is
+  // looked up without taking |fd_table_lock_|, and remains valid until
+  // |action| returns even if |fd| is closed concurrently.
+  template <typename IOAction>
+  typename std::result_of<IOAction(IOContext *)>::type CallWithContext(
+      int fd, IOAction action) LOCKS_EXCLUDED(fd_table_lock_);
+
+  // Performs |action|, a read or write in |direction| of |requested| bytes, on
+  // the IOContext corresponding to |fd| as CallWithContext does, and records
+  // its result and duration in the statistics of the context.
   template <typename IOAction>
-  typename std::result_of<IOAction(std::shared_ptr<IOContext>)>::type
-  CallWithContext(int fd, IOAction action) LOCKS_EXCLUDED(fd_table_lock_);
+  ssize_t CallWithStats(int fd, IOStats::Direction direction, size_t requested,
+                        IOAction action) LOCKS_EXCLUDED(fd_table_lock_);
 
   // Looks up the appropriate VirtualPathHandler and calls the given function on
   // it.  Errors related to path resolution and handler lookups are handled.
@@ -539,14 +857,34 @@ class IOManager {
                                    const char *)>::type
   CallWithHandler(const char *path1, const char *path2, IOAction action);
 
-  // A map from path prefix to VirtualPathHandler.
-  std::map<std::string, std::unique_ptr<VirtualPathHandler>> prefix_to_handler_;
+  // A trie mapping path prefixes to VirtualPathHandlers.
+  util::PathTrie<std::unique_ptr<VirtualPathHandler>> handlers_;
+
+  // Incremented whenever the working directory or the set of registered
+  // handlers changes, invalidating cached relative path resolutions.
+  std::atomic<uint64_t> path_generation_{1};
+
+  // Size of the buffer given to new buffered IOContextNative instances.
+  std::atomic<size_t> native_buffer_size_{0};
+
+  // Size of the buffer given to new directory streams.
+  std::atomic<size_t> readdir_batch_size_{32768};
 
   FileDescriptorTable fd_table_;
 
+  // Attributes of open files which only change through the enclave, keyed by
+  // IOContext, so fstat and stat on them stay inside the enclave.
+  AttributeCache attribute_cache_;
+
   // A mutex that locks the fd_table_.
   absl::Mutex fd_table_lock_;
 
+  // Statistics of the handlers registered under each path prefix, kept after
+  // the handlers are deregistered.
+  std::map<std::string, std::shared_ptr<IOStats>> handler_io_stats_
+      GUARDED_BY(handler_io_stats_lock_);
+  absl::Mutex handler_io_stats_lock_;
+
   std::string current_working_directory_;
 };
 
@@ -0,0 +1,69 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/posix/io/io_stats.h"
+
+#include <errno.h>
+#include <time.h>
+
+namespace asylo {
+namespace io {
+
+void IOStats::Record(Direction direction, size_t requested, ssize_t result,
+                     int error, int64_t nanoseconds) {
+  bool read = direction == Direction::kRead;
+  (read ? read_ops_ : write_ops_).fetch_add(1, std::memory_order_relaxed);
+  if (result >= 0) {
+    (read ? read_bytes_ : write_bytes_)
+        .fetch_add(result, std::memory_order_relaxed);
+    if (static_cast<size_t>(result) < requested) {
+      (read ? short_reads_ : short_writes_)
+          .fetch_add(1, std::memory_order_relaxed);
+    }
+  } else if (error == EAGAIN || error == EWOULDBLOCK) {
+    would_block_.fetch_add(1, std::memory_order_relaxed);
+  } else {
+    errors_.fetch_add(1, std::memory_order_relaxed);
+  }
+  if (nanoseconds > 0) {
+    nanoseconds_.fetch_add(nanoseconds, std::memory_order_relaxed);
+  }
+}
+
+IOStatsSnapshot IOStats::Snapshot() const {
+  IOStatsSnapshot snapshot;
+  snapshot.read_ops = read_ops_.load(std::memory_order_relaxed);
+  snapshot.read_bytes = read_bytes_.load(std::memory_order_relaxed);
+  snapshot.write_ops = write_ops_.load(std::memory_order_relaxed);
+  snapshot.write_bytes = write_bytes_.load(std::memory_order_relaxed);
+  snapshot.short_reads = short_reads_.load(std::memory_order_relaxed);
+  snapshot.short_writes = short_writes_.load(std::memory_order_relaxed);
+  snapshot.would_block = would_block_.load(std::memory_order_relaxed);
+  snapshot.errors = errors_.load(std::memory_order_relaxed);
+  snapshot.nanoseconds = nanoseconds_.load(std::memory_order_relaxed);
+  return snapshot;
+}
+
+int64_t IOStatsClockNanoseconds() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return static_cast<int64_t>(now.tv_sec) * 1000000000 + now.tv_nsec;
+}
+
+}  // namespace io
+}  // namespace asylo
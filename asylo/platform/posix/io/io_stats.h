@@ -0,0 +1,94 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_PLATFORM_POSIX_IO_IO_STATS_H_
+#define ASYLO_PLATFORM_POSIX_IO_IO_STATS_H_
+
+#include <sys/types.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace asylo {
+namespace io {
+
+// Totals of the reads and writes done on an open file, or on all the files
+// opened through a VirtualPathHandler.
+struct IOStatsSnapshot {
+  // Operations and the bytes they transferred.
+  uint64_t read_ops = 0;
+  uint64_t read_bytes = 0;
+  uint64_t write_ops = 0;
+  uint64_t write_bytes = 0;
+
+  // Operations which transferred fewer bytes than requested, including reads
+  // at end of file.
+  uint64_t short_reads = 0;
+  uint64_t short_writes = 0;
+
+  // Operations which failed with EAGAIN or EWOULDBLOCK, and with any other
+  // error.
+  uint64_t would_block = 0;
+  uint64_t errors = 0;
+
+  // Time spent in the operations, most of which is spent in host calls for
+  // files backed by the host.
+  uint64_t nanoseconds = 0;
+};
+
+// Counters of the reads and writes done on an open file. All methods are
+// thread-safe, and counters are updated without locks.
+class IOStats {
+ public:
+  enum class Direction { kRead, kWrite };
+
+  IOStats() = default;
+  IOStats(const IOStats &) = delete;
+  IOStats &operator=(const IOStats &) = delete;
+
+  // Records an operation in |direction| which asked to transfer |requested|
+  // bytes, returned |result| and took |nanoseconds|. |error| is the errno
+  // value of a failed operation, whose |result| is negative.
+  void Record(Direction direction, size_t requested, ssize_t result, int error,
+              int64_t nanoseconds);
+
+  // Returns the current totals. Totals of operations recorded concurrently
+  // may be partially included.
+  IOStatsSnapshot Snapshot() const;
+
+ private:
+  std::atomic<uint64_t> read_ops_{0};
+  std::atomic<uint64_t> read_bytes_{0};
+  std::atomic<uint64_t> write_ops_{0};
+  std::atomic<uint64_t> write_bytes_{0};
+  std::atomic<uint64_t> short_reads_{0};
+  std::atomic<uint64_t> short_writes_{0};
+  std::atomic<uint64_t> would_block_{0};
+  std::atomic<uint64_t> errors_{0};
+  std::atomic<uint64_t> nanoseconds_{0};
+};
+
+// Returns the value of CLOCK_MONOTONIC in nanoseconds, which IOManager uses to
+// time operations. Reading it does not leave the enclave.
+int64_t IOStatsClockNanoseconds();
+
+}  // namespace io
+}  // namespace asylo
+
+#endif  // ASYLO_PLATFORM_POSIX_IO_IO_STATS_H_
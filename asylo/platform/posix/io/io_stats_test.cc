@@ -0,0 +1,103 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/posix/io/io_stats.h"
+
+#include <errno.h>
+
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace asylo {
+namespace io {
+namespace {
+
+using Direction = IOStats::Direction;
+
+TEST(IOStatsTest, CountsOperationsAndBytes) {
+  IOStats stats;
+  stats.Record(Direction::kRead, 100, 100, 0, 5);
+  stats.Record(Direction::kRead, 100, 40, 0, 7);
+  stats.Record(Direction::kWrite, 10, 10, 0, 1);
+
+  IOStatsSnapshot snapshot = stats.Snapshot();
+  EXPECT_EQ(snapshot.read_ops, 2);
+  EXPECT_EQ(snapshot.read_bytes, 140);
+  EXPECT_EQ(snapshot.short_reads, 1);
+  EXPECT_EQ(snapshot.write_ops, 1);
+  EXPECT_EQ(snapshot.write_bytes, 10);
+  EXPECT_EQ(snapshot.short_writes, 0);
+  EXPECT_EQ(snapshot.nanoseconds, 13);
+}
+
+TEST(IOStatsTest, EndOfFileIsShortButEmptyRequestIsNot) {
+  IOStats stats;
+  stats.Record(Direction::kRead, 10, 0, 0, 0);
+  stats.Record(Direction::kRead, 0, 0, 0, 0);
+  EXPECT_EQ(stats.Snapshot().short_reads, 1);
+}
+
+TEST(IOStatsTest, SeparatesWouldBlockFromOtherErrors) {
+  IOStats stats;
+  stats.Record(Direction::kRead, 10, -1, EAGAIN, 0);
+  stats.Record(Direction::kWrite, 10, -1, EWOULDBLOCK, 0);
+  stats.Record(Direction::kWrite, 10, -1, EPIPE, 0);
+
+  IOStatsSnapshot snapshot = stats.Snapshot();
+  EXPECT_EQ(snapshot.read_ops, 1);
+  EXPECT_EQ(snapshot.write_ops, 2);
+  EXPECT_EQ(snapshot.would_block, 2);
+  EXPECT_EQ(snapshot.errors, 1);
+  EXPECT_EQ(snapshot.read_bytes, 0);
+  EXPECT_EQ(snapshot.short_writes, 0);
+}
+
+TEST(IOStatsTest, ConcurrentRecordsAreAllCounted) {
+  constexpr int kThreads = 4;
+  constexpr int kRecordsPerThread = 10000;
+  IOStats stats;
+  std::vector<std::thread> threads;
+  for (int i = 0; i < kThreads; ++i) {
+    threads.emplace_back([&stats] {
+      for (int j = 0; j < kRecordsPerThread; ++j) {
+        stats.Record(Direction::kWrite, 2, 1, 0, 1);
+      }
+    });
+  }
+  for (std::thread &thread : threads) {
+    thread.join();
+  }
+
+  IOStatsSnapshot snapshot = stats.Snapshot();
+  EXPECT_EQ(snapshot.write_ops, kThreads * kRecordsPerThread);
+  EXPECT_EQ(snapshot.write_bytes, kThreads * kRecordsPerThread);
+  EXPECT_EQ(snapshot.short_writes, kThreads * kRecordsPerThread);
+  EXPECT_EQ(snapshot.nanoseconds, kThreads * kRecordsPerThread);
+}
+
+TEST(IOStatsTest, ClockIsMonotonic) {
+  int64_t first = IOStatsClockNanoseconds();
+  EXPECT_GT(first, 0);
+  EXPECT_GE(IOStatsClockNanoseconds(), first);
+}
+
+}  // namespace
+}  // namespace io
+}  // namespace asylo
@@ -18,48 +18,215 @@
 
 #include "asylo/platform/posix/io/native_paths.h"
 
+#include <errno.h>
 #include <fcntl.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include <algorithm>
 
 #include "asylo/platform/arch/include/trusted/host_calls.h"
 #include "asylo/platform/posix/io/secure_paths.h"
+#include "asylo/platform/storage/secure/enclave_storage_secure.h"
 
 namespace asylo {
 namespace io {
+namespace {
+
+// Transfers of at least this many bytes are streamed through the thread's
+// untrusted staging buffer instead of being copied whole by the host call.
+constexpr size_t kLargeTransferSize = 64 * 1024;
+
+// Reads from |fd|. Only large reads of seekable files are streamed, since a
+// streamed read of a pipe or socket could block for data the caller did not
+// need.
+ssize_t HostRead(int fd, void *buf, size_t count, bool seekable) {
+  return seekable && count >= kLargeTransferSize
+             ? enc_untrusted_read_large(fd, buf, count)
+             : enc_untrusted_read(fd, buf, count);
+}
+
+ssize_t HostWrite(int fd, const void *buf, size_t count) {
+  return count >= kLargeTransferSize
+             ? enc_untrusted_write_large(fd, buf, count)
+             : enc_untrusted_write(fd, buf, count);
+}
+
+}  // namespace
+
+IOContextNative::IOContextNative(int host_fd, size_t buffer_size,
+                                 bool seekable)
+    : host_fd_(host_fd),
+      buffer_size_(buffer_size),
+      seekable_(seekable),
+      buffer_(buffer_size > 0 ? new uint8_t[buffer_size] : nullptr) {}
+
+int IOContextNative::FlushWritesLocked() {
+  size_t written = 0;
+  while (written < write_size_) {
+    ssize_t ret = HostWrite(host_fd_, buffer_.get() + written,
+                            write_size_ - written);
+    if (ret <= 0) {
+      write_size_ = 0;
+      return -1;
+    }
+    written += ret;
+  }
+  write_size_ = 0;
+  return 0;
+}
 
-int IOContextNative::Close() { return enc_untrusted_close(host_fd_); }
+void IOContextNative::DiscardReadAheadLocked() {
+  if (!seekable_) {
+    return;
+  }
+  if (read_begin_ < read_end_) {
+    enc_untrusted_lseek(host_fd_, -static_cast<off_t>(read_end_ - read_begin_),
+                        SEEK_CUR);
+  }
+  read_begin_ = 0;
+  read_end_ = 0;
+}
+
+int IOContextNative::Sync() {
+  if (buffer_size_ == 0) {
+    return 0;
+  }
+  absl::MutexLock lock(&buffer_lock_);
+  DiscardReadAheadLocked();
+  return FlushWritesLocked();
+}
+
+int IOContextNative::Close() {
+  int ret = Sync();
+  if (enc_untrusted_close(host_fd_) != 0) {
+    return -1;
+  }
+  return ret;
+}
 
 ssize_t IOContextNative::Read(void *buf, size_t count) {
-  return enc_untrusted_read(host_fd_, buf, count);
+  if (buffer_size_ == 0) {
+    return HostRead(host_fd_, buf, count, seekable_);
+  }
+  absl::MutexLock lock(&buffer_lock_);
+  if (FlushWritesLocked() != 0) {
+    return -1;
+  }
+  if (read_begin_ == read_end_) {
+    // Large reads gain nothing from an intermediate copy.
+    if (count >= buffer_size_) {
+      return HostRead(host_fd_, buf, count, seekable_);
+    }
+    ssize_t ret = HostRead(host_fd_, buffer_.get(), buffer_size_, seekable_);
+    if (ret <= 0) {
+      return ret;
+    }
+    read_begin_ = 0;
+    read_end_ = std::min(static_cast<size_t>(ret), buffer_size_);
+  }
+  size_t size = std::min(count, read_end_ - read_begin_);
+  memcpy(buf, buffer_.get() + read_begin_, size);
+  read_begin_ += size;
+  return size;
 }
 
 ssize_t IOContextNative::Write(const void *buf, size_t count) {
-  return enc_untrusted_write(host_fd_, buf, count);
+  if (buffer_size_ == 0) {
+    return HostWrite(host_fd_, buf, count);
+  }
+  absl::MutexLock lock(&buffer_lock_);
+  DiscardReadAheadLocked();
+  if (write_size_ + count > buffer_size_ && FlushWritesLocked() != 0) {
+    return -1;
+  }
+  // The buffer is still holding unread data of a non-seekable stream, or the
+  // write is large enough to gain nothing from coalescing.
+  if (read_begin_ < read_end_ || count >= buffer_size_) {
+    return HostWrite(host_fd_, buf, count);
+  }
+  memcpy(buffer_.get() + write_size_, buf, count);
+  write_size_ += count;
+  return count;
+}
+
+ssize_t IOContextNative::Pread(void *buf, size_t count, off_t offset) {
+  if (Sync() != 0) {
+    return -1;
+  }
+  return enc_untrusted_pread(host_fd_, buf, count, offset);
+}
+
+ssize_t IOContextNative::Pwrite(const void *buf, size_t count, off_t offset) {
+  if (Sync() != 0) {
+    return -1;
+  }
+  return enc_untrusted_pwrite(host_fd_, buf, count, offset);
 }
 
 int IOContextNative::LSeek(off_t offset, int whence) {
+  if (Sync() != 0) {
+    return -1;
+  }
   return enc_untrusted_lseek(host_fd_, offset, whence);
 }
 
 int IOContextNative::FCntl(int cmd, int64_t arg) {
+  if (Sync() != 0) {
+    return -1;
+  }
   return enc_untrusted_fcntl(host_fd_, cmd, arg);
 }
 
-int IOContextNative::FSync() { return enc_untrusted_fsync(host_fd_); }
+int IOContextNative::FSync() {
+  if (Sync() != 0) {
+    return -1;
+  }
+  return enc_untrusted_fsync(host_fd_);
+}
 
 int IOContextNative::FStat(struct stat *stat_buffer) {
+  if (Sync() != 0) {
+    return -1;
+  }
   return enc_untrusted_fstat(host_fd_, stat_buffer);
 }
 
 int IOContextNative::Isatty() { return enc_untrusted_isatty(host_fd_); }
 
 ssize_t IOContextNative::Writev(const struct iovec *iov, int iovcnt) {
+  if (Sync() != 0) {
+    return -1;
+  }
   return enc_untrusted_writev(host_fd_, iov, iovcnt);
 }
 
 ssize_t IOContextNative::Readv(const struct iovec *iov, int iovcnt) {
+  if (buffer_size_ > 0) {
+    absl::MutexLock lock(&buffer_lock_);
+    if (FlushWritesLocked() != 0) {
+      return -1;
+    }
+    // Read-ahead data cannot be returned to a pipe, so it is consumed first
+    // as a short read.
+    if (read_begin_ < read_end_) {
+      size_t total = 0;
+      for (int i = 0; i < iovcnt && read_begin_ < read_end_; ++i) {
+        size_t size = std::min(iov[i].iov_len, read_end_ - read_begin_);
+        memcpy(iov[i].iov_base, buffer_.get() + read_begin_, size);
+        read_begin_ += size;
+        total += size;
+      }
+      return total;
+    }
+  }
   return enc_untrusted_readv(host_fd_, iov, iovcnt);
 }
 
+ssize_t IOContextNative::GetDents(void *buf, size_t count) {
+  return enc_untrusted_getdents64(host_fd_, buf, count);
+}
+
 int IOContextNative::SetSockOpt(int level, int option_name,
                                 const void *option_value,
                                 socklen_t option_len) {
@@ -67,6 +234,11 @@ int IOContextNative::SetSockOpt(int level, int option_name,
                                   option_len);
 }
 
+int IOContextNative::SetIntSockOpts(const struct enc_int_sockopt *options,
+                                    size_t count) {
+  return enc_untrusted_setsockopts(host_fd_, options, count);
+}
+
 int IOContextNative::Connect(const struct sockaddr *addr, socklen_t addrlen) {
   return enc_untrusted_connect(host_fd_, addr, addrlen);
 }
@@ -88,6 +260,11 @@ int IOContextNative::Accept(struct sockaddr *addr, socklen_t *addrlen) {
   return enc_untrusted_accept(host_fd_, addr, addrlen);
 }
 
+int IOContextNative::Accept4(struct sockaddr *addr, socklen_t *addrlen,
+                             int flags) {
+  return enc_untrusted_accept4(host_fd_, addr, addrlen, flags);
+}
+
 int IOContextNative::Bind(const struct sockaddr *addr, socklen_t addrlen) {
   return enc_untrusted_bind(host_fd_, addr, addrlen);
 }
@@ -104,6 +281,16 @@ ssize_t IOContextNative::RecvMsg(struct msghdr *msg, int flags) {
   return enc_untrusted_recvmsg(host_fd_, msg, flags);
 }
 
+int IOContextNative::SendMmsg(struct mmsghdr *msgvec, unsigned int vlen,
+                              int flags) {
+  return enc_untrusted_sendmmsg(host_fd_, msgvec, vlen, flags);
+}
+
+int IOContextNative::RecvMmsg(struct mmsghdr *msgvec, unsigned int vlen,
+                              int flags, struct timespec *timeout) {
+  return enc_untrusted_recvmmsg(host_fd_, msgvec, vlen, flags, timeout);
+}
+
 int IOContextNative::GetSockName(struct sockaddr *addr, socklen_t *addrlen) {
   return enc_untrusted_getsockname(host_fd_, addr, addrlen);
 }
@@ -112,20 +299,51 @@ int IOContextNative::GetPeerName(struct sockaddr *addr, socklen_t *addrlen) {
   return enc_untrusted_getpeername(host_fd_, addr, addrlen);
 }
 
-int IOContextNative::GetHostFileDescriptor() { return host_fd_; }
+int IOContextNative::GetHostFileDescriptor() {
+  // Pending writes are flushed so that they are visible to whatever operation
+  // the caller performs on the host file descriptor. Any error is reported by
+  // the next buffered operation instead.
+  if (buffer_size_ > 0) {
+    absl::MutexLock lock(&buffer_lock_);
+    FlushWritesLocked();
+  }
+  return host_fd_;
+}
 
 std::unique_ptr<IOManager::IOContext> NativePathHandler::Open(const char *path,
                                                               int flags,
                                                               mode_t mode) {
   if (flags & O_SECURE) {
+    if (flags & O_TMPFILE) {
+      if (flags & O_INTEGRITY_ONLY) {
+        errno = EINVAL;
+        return nullptr;
+      }
+      return IOContextEphemeral::Create(path, flags, mode);
+    }
     return IOContextSecure::Create(path, flags, mode);
   }
+  if (flags & (O_TMPFILE | O_INTEGRITY_ONLY)) {
+    errno = EINVAL;
+    return nullptr;
+  }
 
   int host_fd = enc_untrusted_open(path, flags, mode);
   if (host_fd < 0) {
     return nullptr;
   }
 
+  // Only regular files and FIFOs are buffered. Devices such as terminals must
+  // see each write as it is made.
+  size_t buffer_size = IOManager::GetInstance().native_buffer_size();
+  if (buffer_size > 0) {
+    struct stat stat_buffer;
+    if (enc_untrusted_fstat(host_fd, &stat_buffer) == 0 &&
+        (S_ISREG(stat_buffer.st_mode) || S_ISFIFO(stat_buffer.st_mode))) {
+      return ::absl::make_unique<IOContextNative>(
+          host_fd, buffer_size, S_ISREG(stat_buffer.st_mode));
+    }
+  }
   return ::absl::make_unique<IOContextNative>(host_fd);
 }
 
@@ -138,7 +356,8 @@ int NativePathHandler::Link(const char *existing, const char *new_link) {
 }
 
 int NativePathHandler::Unlink(const char *pathname) {
-  return enc_untrusted_unlink(pathname);
+  // The file may be a secure file with sidecars to remove along with it.
+  return platform::storage::secure_unlink(pathname);
 }
 
 ssize_t NativePathHandler::ReadLink(const char *path_name, char *buf,
@@ -19,6 +19,12 @@
 #ifndef ASYLO_PLATFORM_POSIX_IO_NATIVE_PATHS_H_
 #define ASYLO_PLATFORM_POSIX_IO_NATIVE_PATHS_H_
 
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/synchronization/mutex.h"
 #include "asylo/platform/posix/io/io_manager.h"
 
 namespace asylo {
@@ -26,11 +32,28 @@ namespace io {
 
 // IOContext implementation wrapping a host file descriptor, delegating IO
 // operations to the host operating system.
+//
+// A context may optionally stage I/O through a trusted buffer, so that runs of
+// small reads and writes each cost one host call per buffer rather than one
+// per call. Reads fetch a full buffer ahead of the caller, and writes are
+// coalesced until the buffer fills or the stream is synced, sought, or
+// closed. An error from a deferred write is reported by the call that flushes
+// it. Data held in the buffer is not visible to operations performed directly
+// on the host file descriptor, such as poll.
 class IOContextNative : public IOManager::IOContext {
  public:
-  explicit IOContextNative(int host_fd) : host_fd_(host_fd) {}
+  explicit IOContextNative(int host_fd) : IOContextNative(host_fd, 0, false) {}
+
+  // Creates a context staging I/O through a buffer of |buffer_size| bytes, or
+  // delegating every operation directly if |buffer_size| is zero. |seekable|
+  // indicates whether read-ahead data can be returned to the host stream by
+  // seeking back over it.
+  IOContextNative(int host_fd, size_t buffer_size, bool seekable);
+
   ssize_t Read(void *buf, size_t count) override;
   ssize_t Write(const void *buf, size_t count) override;
+  ssize_t Pread(void *buf, size_t count, off_t offset) override;
+  ssize_t Pwrite(const void *buf, size_t count, off_t offset) override;
   int LSeek(off_t offset, int whence) override;
   int FCntl(int cmd, int64_t arg) override;
   int FSync() override;
@@ -39,25 +62,60 @@ class IOContextNative : public IOManager::IOContext {
   int Close() override;
   ssize_t Writev(const struct iovec *iov, int iovcnt) override;
   ssize_t Readv(const struct iovec *iov, int iovcnt) override;
+  ssize_t GetDents(void *buf, size_t count) override;
   int SetSockOpt(int level, int option_name, const void *option_value,
                  socklen_t option_len) override;
+  int SetIntSockOpts(const struct enc_int_sockopt *options,
+                     size_t count) override;
   int Connect(const struct sockaddr *addr, socklen_t addrlen) override;
   int Shutdown(int how) override;
   ssize_t Send(const void *buf, size_t len, int flags) override;
   int GetSockOpt(int level, int optname, void *optval,
                  socklen_t *optlen) override;
   int Accept(struct sockaddr *addr, socklen_t *addrlen) override;
+  int Accept4(struct sockaddr *addr, socklen_t *addrlen, int flags) override;
   int Bind(const struct sockaddr *addr, socklen_t addrlen) override;
   int Listen(int backlog) override;
   ssize_t SendMsg(const struct msghdr *msg, int flags) override;
   ssize_t RecvMsg(struct msghdr *msg, int flags) override;
+  int SendMmsg(struct mmsghdr *msgvec, unsigned int vlen, int flags) override;
+  int RecvMmsg(struct mmsghdr *msgvec, unsigned int vlen, int flags,
+               struct timespec *timeout) override;
   int GetSockName(struct sockaddr *addr, socklen_t *addrlen) override;
   int GetPeerName(struct sockaddr *addr, socklen_t *addrlen) override;
   int GetHostFileDescriptor() override;
 
  private:
+  // Writes out any coalesced writes. Returns 0 on success, or -1 if the host
+  // failed to accept them, in which case they are discarded.
+  int FlushWritesLocked() EXCLUSIVE_LOCKS_REQUIRED(buffer_lock_);
+
+  // Discards any read-ahead data of a seekable stream, returning the host file
+  // position to the position seen by the caller. Read-ahead data of other
+  // streams cannot be returned to the host, so it is kept until it is read.
+  void DiscardReadAheadLocked() EXCLUSIVE_LOCKS_REQUIRED(buffer_lock_);
+
+  // Brings the host stream up to date with the buffer before an operation
+  // that bypasses it. Returns 0 on success, or -1 if a deferred write failed.
+  int Sync() LOCKS_EXCLUDED(buffer_lock_);
+
   // Host file descriptor implementing this stream.
   int host_fd_;
+
+  // Size of |buffer_|, or zero if I/O is unbuffered.
+  const size_t buffer_size_;
+
+  // Whether the host stream supports lseek.
+  const bool seekable_;
+
+  absl::Mutex buffer_lock_;
+
+  // Holds either read-ahead data in [read_begin_, read_end_) or coalesced
+  // writes in [0, write_size_), never both.
+  std::unique_ptr<uint8_t[]> buffer_;
+  size_t read_begin_ GUARDED_BY(buffer_lock_) = 0;
+  size_t read_end_ GUARDED_BY(buffer_lock_) = 0;
+  size_t write_size_ GUARDED_BY(buffer_lock_) = 0;
 };
 
 // VirtualPathHandler implementation handling paths to be forwarded to the host.
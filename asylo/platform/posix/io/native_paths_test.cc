@@ -0,0 +1,152 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/posix/io/native_paths.h"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cerrno>
+#include <string>
+
+#include <gtest/gtest.h>
+#include "absl/memory/memory.h"
+#include "asylo/platform/arch/include/trusted/host_calls.h"
+#include "asylo/test/util/test_flags.h"
+
+namespace asylo {
+namespace io {
+namespace {
+
+constexpr size_t kBufferSize = 16;
+
+class BufferedNativeTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    path_ = FLAGS_test_tmpdir + "/buffered_native_test";
+    host_fd_ = enc_untrusted_open(path_.c_str(), O_RDWR | O_CREAT | O_TRUNC,
+                                  0644);
+    ASSERT_GE(host_fd_, 0);
+    context_ = ::absl::make_unique<IOContextNative>(host_fd_, kBufferSize,
+                                                    /*seekable=*/true);
+  }
+
+  void TearDown() override { EXPECT_EQ(context_->Close(), 0); }
+
+  // Returns the contents of the file as seen by the host.
+  std::string HostContents() {
+    std::string contents(64, '\0');
+    int fd = enc_untrusted_open(path_.c_str(), O_RDONLY);
+    EXPECT_GE(fd, 0);
+    ssize_t size = enc_untrusted_read(fd, &contents[0], contents.size());
+    EXPECT_GE(size, 0);
+    enc_untrusted_close(fd);
+    contents.resize(size);
+    return contents;
+  }
+
+  std::string path_;
+  int host_fd_;
+  std::unique_ptr<IOContextNative> context_;
+};
+
+// Tests that small writes are held back until the buffer is flushed.
+TEST_F(BufferedNativeTest, CoalescesSmallWrites) {
+  EXPECT_EQ(context_->Write("abc", 3), 3);
+  EXPECT_EQ(context_->Write("def", 3), 3);
+  EXPECT_EQ(HostContents(), "");
+  EXPECT_EQ(context_->FSync(), 0);
+  EXPECT_EQ(HostContents(), "abcdef");
+}
+
+// Tests that a write that overflows the buffer flushes it first, preserving
+// the order of the data.
+TEST_F(BufferedNativeTest, OverflowFlushesInOrder) {
+  EXPECT_EQ(context_->Write("0123456789", 10), 10);
+  EXPECT_EQ(context_->Write("abcdefghij", 10), 10);
+  EXPECT_EQ(HostContents(), "0123456789");
+  EXPECT_EQ(context_->Write("ABCDEFGHIJKLMNOPQRST", 20), 20);
+  EXPECT_EQ(HostContents(), "0123456789abcdefghijABCDEFGHIJKLMNOPQRST");
+}
+
+// Tests that small reads are served from read-ahead data, and that the file
+// position seen by the caller ignores the read-ahead.
+TEST_F(BufferedNativeTest, ReadsAheadAndTracksPosition) {
+  ASSERT_EQ(enc_untrusted_write(host_fd_, "line one\nline two\n", 18), 18);
+  ASSERT_EQ(enc_untrusted_lseek(host_fd_, 0, SEEK_SET), 0);
+
+  char buf[8];
+  ASSERT_EQ(context_->Read(buf, 5), 5);
+  EXPECT_EQ(std::string(buf, 5), "line ");
+  ASSERT_EQ(context_->Read(buf, 4), 4);
+  EXPECT_EQ(std::string(buf, 4), "one\n");
+  EXPECT_EQ(context_->LSeek(0, SEEK_CUR), 9);
+
+  // A write lands where the caller expects, not after the read-ahead.
+  EXPECT_EQ(context_->Write("LINE", 4), 4);
+  EXPECT_EQ(context_->FSync(), 0);
+  EXPECT_EQ(HostContents(), "line one\nLINE two\n");
+}
+
+// Tests that a read following buffered writes observes them.
+TEST_F(BufferedNativeTest, ReadAfterWrite) {
+  EXPECT_EQ(context_->Write("hello", 5), 5);
+  EXPECT_EQ(context_->LSeek(0, SEEK_SET), 0);
+  char buf[5];
+  ASSERT_EQ(context_->Read(buf, 5), 5);
+  EXPECT_EQ(std::string(buf, 5), "hello");
+}
+
+// Tests that transfers larger than the staging buffer are streamed in chunks
+// and arrive intact.
+TEST_F(BufferedNativeTest, StreamsLargeTransfers) {
+  std::string data(3 * 1024 * 1024 + 17, '\0');
+  for (size_t i = 0; i < data.size(); ++i) {
+    data[i] = static_cast<char>(i * 7);
+  }
+  ASSERT_EQ(context_->Write(data.data(), data.size()), data.size());
+  ASSERT_EQ(context_->LSeek(0, SEEK_SET), 0);
+
+  std::string read_back(data.size() + 100, '\0');
+  ASSERT_EQ(context_->Read(&read_back[0], read_back.size()), data.size());
+  read_back.resize(data.size());
+  EXPECT_EQ(read_back, data);
+}
+
+// Tests that read-ahead data of a pipe survives operations which bypass the
+// buffer, since it cannot be returned to the host.
+TEST(BufferedNativePipeTest, KeepsReadAheadData) {
+  int pipe_fds[2];
+  ASSERT_EQ(enc_untrusted_pipe(pipe_fds), 0);
+  IOContextNative reader(pipe_fds[0], kBufferSize, /*seekable=*/false);
+  ASSERT_EQ(enc_untrusted_write(pipe_fds[1], "0123456789", 10), 10);
+
+  char buf[10];
+  ASSERT_EQ(reader.Read(buf, 3), 3);
+  struct stat stat_buffer;
+  EXPECT_EQ(reader.FStat(&stat_buffer), 0);
+  ASSERT_EQ(reader.Read(buf + 3, 7), 7);
+  EXPECT_EQ(std::string(buf, 10), "0123456789");
+
+  EXPECT_EQ(reader.Close(), 0);
+  EXPECT_EQ(enc_untrusted_close(pipe_fds[1]), 0);
+}
+
+}  // namespace
+}  // namespace io
+}  // namespace asylo
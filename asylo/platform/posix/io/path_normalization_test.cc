@@ -16,6 +16,7 @@
  *
  */
 
+#include <string>
 #include <utility>
 #include <vector>
 
@@ -59,6 +60,15 @@ TEST_P(PathNormalizationTest, HasExpectedResult) {
   EXPECT_EQ(NormalizePath(params.first), params.second);
 }
 
+// Verifies that normalizing into a buffer which already holds an unrelated path
+// overwrites its previous contents.
+TEST_P(PathNormalizationTest, ReusedBufferHasExpectedResult) {
+  PathParams::value_type params = GetParam();
+  std::string normalized = "/stale/previous/result";
+  NormalizePath(params.first, &normalized);
+  EXPECT_EQ(normalized, params.second);
+}
+
 // Returns a mapping of inputs to outputs to be verified.
 PathParams GetTestPathParams() {
   return {
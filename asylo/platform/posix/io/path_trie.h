@@ -0,0 +1,134 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_PLATFORM_POSIX_IO_PATH_TRIE_H_
+#define ASYLO_PLATFORM_POSIX_IO_PATH_TRIE_H_
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+
+#include "absl/strings/string_view.h"
+
+namespace asylo {
+namespace io {
+namespace util {
+
+// A trie keyed on path components, mapping absolute path prefixes to values.
+// Lookups walk a path one component at a time and return the value bound to
+// the longest registered prefix that ends on a component boundary, without
+// allocating. The empty prefix is bound to the root and matches every path.
+//
+// PathTrie is not thread-safe; callers are responsible for synchronizing
+// modifications with lookups.
+template <typename T>
+class PathTrie {
+ public:
+  PathTrie() = default;
+  PathTrie(const PathTrie &) = delete;
+  PathTrie &operator=(const PathTrie &) = delete;
+
+  // Binds |value| to |prefix|. Returns false and leaves the trie unchanged if
+  // |prefix| is already bound.
+  bool Insert(absl::string_view prefix, T value) {
+    Node *node = &root_;
+    ForEachComponent(prefix, [&node](absl::string_view component) {
+      auto it = node->children.find(component);
+      if (it == node->children.end()) {
+        it = node->children
+                 .emplace(std::string(component),
+                          std::unique_ptr<Node>(new Node()))
+                 .first;
+      }
+      node = it->second.get();
+      return true;
+    });
+    if (node->has_value) return false;
+    node->value = std::move(value);
+    node->has_value = true;
+    return true;
+  }
+
+  // Removes the value bound to |prefix|, if any, pruning nodes which no longer
+  // lead to a value.
+  void Erase(absl::string_view prefix) { EraseFrom(&root_, prefix); }
+
+  // Returns the value bound to the longest prefix of the canonical path
+  // |path|, or nullptr if no registered prefix matches.
+  const T *FindLongestPrefix(absl::string_view path) const {
+    const Node *node = &root_;
+    const T *match = root_.has_value ? &root_.value : nullptr;
+    ForEachComponent(path, [&node, &match](absl::string_view component) {
+      auto it = node->children.find(component);
+      if (it == node->children.end()) return false;
+      node = it->second.get();
+      if (node->has_value) match = &node->value;
+      return true;
+    });
+    return match;
+  }
+
+ private:
+  struct Node {
+    std::map<std::string, std::unique_ptr<Node>, std::less<>> children;
+    bool has_value = false;
+    T value{};
+  };
+
+  // Invokes |visit| on each non-empty component of |path| in order, stopping
+  // early if it returns false.
+  template <typename Visitor>
+  static void ForEachComponent(absl::string_view path, Visitor visit) {
+    size_t begin = 0;
+    while (begin < path.size()) {
+      size_t end = path.find('/', begin);
+      if (end == absl::string_view::npos) end = path.size();
+      if (end > begin && !visit(path.substr(begin, end - begin))) return;
+      begin = end + 1;
+    }
+  }
+
+  // Erases |path| relative to |node|. Returns true if |node| is left without a
+  // value or children and may be removed by its parent.
+  static bool EraseFrom(Node *node, absl::string_view path) {
+    size_t begin = path.find_first_not_of('/');
+    if (begin == absl::string_view::npos) {
+      node->has_value = false;
+      node->value = T{};
+    } else {
+      size_t end = path.find('/', begin);
+      if (end == absl::string_view::npos) end = path.size();
+      auto it = node->children.find(path.substr(begin, end - begin));
+      if (it == node->children.end()) return false;
+      if (EraseFrom(it->second.get(), path.substr(end))) {
+        node->children.erase(it);
+      }
+    }
+    return !node->has_value && node->children.empty();
+  }
+
+  Node root_;
+};
+
+}  // namespace util
+}  // namespace io
+}  // namespace asylo
+
+#endif  // ASYLO_PLATFORM_POSIX_IO_PATH_TRIE_H_
@@ -0,0 +1,113 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/posix/io/path_trie.h"
+
+#include <gtest/gtest.h>
+
+namespace asylo {
+namespace io {
+namespace util {
+namespace {
+
+// Returns the value matched for |path|, or -1 if there is no match.
+int Lookup(const PathTrie<int> &trie, absl::string_view path) {
+  const int *value = trie.FindLongestPrefix(path);
+  return value ? *value : -1;
+}
+
+TEST(PathTrieTest, EmptyTrieMatchesNothing) {
+  PathTrie<int> trie;
+  EXPECT_EQ(Lookup(trie, "/"), -1);
+  EXPECT_EQ(Lookup(trie, "/foo"), -1);
+}
+
+TEST(PathTrieTest, RootPrefixMatchesEverything) {
+  PathTrie<int> trie;
+  ASSERT_TRUE(trie.Insert("", 1));
+  EXPECT_EQ(Lookup(trie, "/"), 1);
+  EXPECT_EQ(Lookup(trie, "/foo/bar"), 1);
+}
+
+// Tests that the deepest prefix ending on a component boundary wins.
+TEST(PathTrieTest, LongestComponentPrefixMatches) {
+  PathTrie<int> trie;
+  ASSERT_TRUE(trie.Insert("", 1));
+  ASSERT_TRUE(trie.Insert("/dev", 2));
+  ASSERT_TRUE(trie.Insert("/dev/random", 3));
+
+  EXPECT_EQ(Lookup(trie, "/dev"), 2);
+  EXPECT_EQ(Lookup(trie, "/dev/urandom"), 2);
+  EXPECT_EQ(Lookup(trie, "/dev/random"), 3);
+  EXPECT_EQ(Lookup(trie, "/dev/random/foo"), 3);
+  EXPECT_EQ(Lookup(trie, "/devices"), 1);
+  EXPECT_EQ(Lookup(trie, "/dev/randomly"), 2);
+  EXPECT_EQ(Lookup(trie, "/tmp"), 1);
+}
+
+// Tests that interior nodes without a value don't match.
+TEST(PathTrieTest, InteriorNodesDoNotMatch) {
+  PathTrie<int> trie;
+  ASSERT_TRUE(trie.Insert("/a/b/c", 1));
+  EXPECT_EQ(Lookup(trie, "/a"), -1);
+  EXPECT_EQ(Lookup(trie, "/a/b"), -1);
+  EXPECT_EQ(Lookup(trie, "/a/b/c/d"), 1);
+}
+
+TEST(PathTrieTest, DuplicateInsertIsRejected) {
+  PathTrie<int> trie;
+  ASSERT_TRUE(trie.Insert("/foo", 1));
+  EXPECT_FALSE(trie.Insert("/foo", 2));
+  EXPECT_EQ(Lookup(trie, "/foo"), 1);
+}
+
+TEST(PathTrieTest, EraseRemovesOnlyThatPrefix) {
+  PathTrie<int> trie;
+  ASSERT_TRUE(trie.Insert("", 1));
+  ASSERT_TRUE(trie.Insert("/foo", 2));
+  ASSERT_TRUE(trie.Insert("/foo/bar", 3));
+
+  trie.Erase("/foo");
+  EXPECT_EQ(Lookup(trie, "/foo"), 1);
+  EXPECT_EQ(Lookup(trie, "/foo/bar"), 3);
+
+  trie.Erase("/foo/bar");
+  EXPECT_EQ(Lookup(trie, "/foo/bar"), 1);
+
+  trie.Erase("");
+  EXPECT_EQ(Lookup(trie, "/foo/bar"), -1);
+
+  // Erasing an unbound prefix is a no-op, and erased prefixes may be rebound.
+  trie.Erase("/not/present");
+  ASSERT_TRUE(trie.Insert("/foo", 4));
+  EXPECT_EQ(Lookup(trie, "/foo/bar"), 4);
+}
+
+// Tests that move-only values are owned by the trie.
+TEST(PathTrieTest, HoldsMoveOnlyValues) {
+  PathTrie<std::unique_ptr<int>> trie;
+  ASSERT_TRUE(trie.Insert("/foo", std::unique_ptr<int>(new int(7))));
+  const std::unique_ptr<int> *value = trie.FindLongestPrefix("/foo/bar");
+  ASSERT_NE(value, nullptr);
+  EXPECT_EQ(**value, 7);
+}
+
+}  // namespace
+}  // namespace util
+}  // namespace io
+}  // namespace asylo
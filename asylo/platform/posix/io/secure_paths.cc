@@ -46,14 +46,39 @@ ssize_t IOContextSecure::Write(const void *buf, size_t count) {
   return platform::storage::secure_write(host_fd_, buf, count);
 }
 
+ssize_t IOContextSecure::Pread(void *buf, size_t count, off_t offset) {
+  return platform::storage::secure_pread(host_fd_, buf, count, offset);
+}
+
+ssize_t IOContextSecure::Pwrite(const void *buf, size_t count, off_t offset) {
+  return platform::storage::secure_pwrite(host_fd_, buf, count, offset);
+}
+
 int IOContextSecure::LSeek(off_t offset, int whence) {
   return platform::storage::secure_lseek(host_fd_, offset, whence);
 }
 
-int IOContextSecure::FSync() { return enc_untrusted_fsync(host_fd_); }
+int IOContextSecure::FSync() {
+  return platform::storage::secure_fsync(host_fd_);
+}
 
+int IOContextSecure::FTruncate(off_t length) {
+  return platform::storage::secure_ftruncate(host_fd_, length);
+}
+
+// Reports the logical size of the plaintext rather than the size of the
+// encrypted file on the host.
 int IOContextSecure::FStat(struct stat *st) {
-  return enc_untrusted_fstat(host_fd_, st);
+  int ret = enc_untrusted_fstat(host_fd_, st);
+  if (ret != 0) {
+    return ret;
+  }
+  off_t logical_size = AeadHandler::GetInstance().GetLogicalSize(host_fd_);
+  if (logical_size < 0) {
+    return -1;
+  }
+  st->st_size = logical_size;
+  return 0;
 }
 
 int IOContextSecure::Isatty() { return enc_untrusted_isatty(host_fd_); }
@@ -65,6 +90,30 @@ int IOContextSecure::Ioctl(int request, void *argp) {
       return AeadHandler::GetInstance().SetMasterKey(
           host_fd_, ioctl_param->data, ioctl_param->length);
     }
+    case ENCLAVE_STORAGE_SET_BLOCK_SIZE: {
+      const uint32_t *block_size = reinterpret_cast<const uint32_t *>(argp);
+      return AeadHandler::GetInstance().SetBlockLength(host_fd_, *block_size);
+    }
+    case ENCLAVE_STORAGE_SET_DIGEST_WRITE_THROUGH: {
+      const uint32_t *write_through = reinterpret_cast<const uint32_t *>(argp);
+      return AeadHandler::GetInstance().SetDigestWriteThrough(
+          host_fd_, *write_through != 0);
+    }
+    case ENCLAVE_STORAGE_BEGIN_KEY_ROTATION: {
+      struct key_info *ioctl_param = reinterpret_cast<struct key_info *>(argp);
+      return AeadHandler::GetInstance().BeginKeyRotation(
+          host_fd_, ioctl_param->data, ioctl_param->length);
+    }
+    case ENCLAVE_STORAGE_ROTATE_KEY_STEP: {
+      int64_t *blocks = reinterpret_cast<int64_t *>(argp);
+      int64_t remaining =
+          AeadHandler::GetInstance().RotateKeyStep(host_fd_, *blocks);
+      if (remaining == -1) {
+        return -1;
+      }
+      *blocks = remaining;
+      return 0;
+    }
     default:
       errno = ENOSYS;
   }
@@ -72,5 +121,49 @@ int IOContextSecure::Ioctl(int request, void *argp) {
   return -1;
 }
 
+ssize_t IOContextEphemeral::Read(void *buf, size_t count) {
+  return file_->Read(buf, count);
+}
+
+ssize_t IOContextEphemeral::Write(const void *buf, size_t count) {
+  return file_->Write(buf, count);
+}
+
+ssize_t IOContextEphemeral::Pread(void *buf, size_t count, off_t offset) {
+  return file_->Pread(buf, count, offset);
+}
+
+ssize_t IOContextEphemeral::Pwrite(const void *buf, size_t count,
+                                   off_t offset) {
+  return file_->Pwrite(buf, count, offset);
+}
+
+int IOContextEphemeral::Close() { return file_->Close(); }
+
+int IOContextEphemeral::LSeek(off_t offset, int whence) {
+  return file_->LSeek(offset, whence);
+}
+
+// The contents of an ephemeral file do not outlive the enclave, so there is
+// nothing to make durable.
+int IOContextEphemeral::FSync() { return 0; }
+
+int IOContextEphemeral::FTruncate(off_t length) {
+  return file_->Truncate(length);
+}
+
+int IOContextEphemeral::FStat(struct stat *st) {
+  int ret = enc_untrusted_fstat(file_->host_fd(), st);
+  if (ret != 0) {
+    return ret;
+  }
+  st->st_size = file_->size();
+  return 0;
+}
+
+int IOContextEphemeral::Isatty() {
+  return enc_untrusted_isatty(file_->host_fd());
+}
+
 }  // namespace io
 }  // namespace asylo
@@ -20,6 +20,7 @@
 #define ASYLO_PLATFORM_POSIX_IO_SECURE_PATHS_H_
 
 #include "asylo/platform/posix/io/io_manager.h"
+#include "asylo/platform/storage/secure/ephemeral_file.h"
 
 namespace asylo {
 namespace io {
@@ -37,12 +38,16 @@ class IOContextSecure : public IOManager::IOContext {
  protected:
   ssize_t Read(void *buf, size_t count) override;
   ssize_t Write(const void *buf, size_t count) override;
+  ssize_t Pread(void *buf, size_t count, off_t offset) override;
+  ssize_t Pwrite(const void *buf, size_t count, off_t offset) override;
   int Close() override;
   int LSeek(off_t offset, int whence) override;
   int FSync() override;
+  int FTruncate(off_t length) override;
   int FStat(struct stat *st) override;
   int Isatty() override;
   int Ioctl(int request, void *argp) override;
+  bool AttributesCacheable() override { return true; }
 
  private:
   explicit IOContextSecure(int host_fd) : host_fd_(host_fd) {}
@@ -51,6 +56,43 @@ class IOContextSecure : public IOManager::IOContext {
   int host_fd_;
 };
 
+// IOContext implementation wrapping an ephemeral file, created by opening a
+// directory with O_SECURE | O_TMPFILE.
+class IOContextEphemeral : public IOManager::IOContext {
+ public:
+  // Factory method to create an instance of the class. Returns nullptr with
+  // errno set on failure.
+  static std::unique_ptr<IOManager::IOContext> Create(const char *path,
+                                                      int flags, mode_t mode) {
+    std::unique_ptr<platform::storage::EphemeralFile> file =
+        platform::storage::EphemeralFile::Create(path, flags, mode);
+    if (!file) {
+      return nullptr;
+    }
+    return std::unique_ptr<IOManager::IOContext>(
+        new IOContextEphemeral(std::move(file)));
+  }
+
+ protected:
+  ssize_t Read(void *buf, size_t count) override;
+  ssize_t Write(const void *buf, size_t count) override;
+  ssize_t Pread(void *buf, size_t count, off_t offset) override;
+  ssize_t Pwrite(const void *buf, size_t count, off_t offset) override;
+  int Close() override;
+  int LSeek(off_t offset, int whence) override;
+  int FSync() override;
+  int FTruncate(off_t length) override;
+  int FStat(struct stat *st) override;
+  int Isatty() override;
+
+ private:
+  explicit IOContextEphemeral(
+      std::unique_ptr<platform::storage::EphemeralFile> file)
+      : file_(std::move(file)) {}
+
+  std::unique_ptr<platform::storage::EphemeralFile> file_;
+};
+
 }  // namespace io
 }  // namespace asylo
 
@@ -18,10 +18,6 @@
 
 #include "asylo/platform/posix/io/util.h"
 
-#include <vector>
-
-#include "absl/strings/str_cat.h"
-#include "absl/strings/str_join.h"
 #include "absl/strings/string_view.h"
 
 namespace asylo {
@@ -29,10 +25,16 @@ namespace io {
 namespace util {
 
 std::string NormalizePath(absl::string_view path) {
-  // Collects the current view of the directories in the path.
-  std::vector<absl::string_view> directories;
+  std::string normalized;
+  NormalizePath(path, &normalized);
+  return normalized;
+}
+
+void NormalizePath(absl::string_view path, std::string *normalized) {
+  normalized->clear();
 
-  // Scan through the path, finding the directories.
+  // Scan through the path, appending each directory to the output as it is
+  // found so that the result is built without intermediate allocations.
   size_t current_directory = 0;
   while (current_directory < path.size()) {
     // Extract the next directory name.
@@ -47,18 +49,22 @@ std::string NormalizePath(absl::string_view path) {
     // If the directory name is empty or ".", leave it out entirely.
     if (name.empty() || name == ".") continue;
 
-    // If the directory name is "..", back up by one.
+    // If the directory name is "..", back up by one. If already at the root,
+    // stay at the root.
     if (name == "..") {
-      // If already at the root, stay at the root.
-      if (!directories.empty()) directories.pop_back();
+      size_t last_separator = normalized->rfind('/');
+      if (last_separator != std::string::npos) {
+        normalized->resize(last_separator);
+      }
       continue;
     }
 
     // Otherwise, keep track of this directory.
-    directories.push_back(name);
+    normalized->push_back('/');
+    normalized->append(name.data(), name.size());
   }
 
-  return absl::StrCat("/", absl::StrJoin(directories, "/"));
+  if (normalized->empty()) normalized->push_back('/');
 }
 
 }  // namespace util
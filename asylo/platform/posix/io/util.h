@@ -19,6 +19,8 @@
 #ifndef ASYLO_PLATFORM_POSIX_IO_UTIL_H_
 #define ASYLO_PLATFORM_POSIX_IO_UTIL_H_
 
+#include <string>
+
 #include "absl/strings/string_view.h"
 
 namespace asylo {
@@ -27,6 +29,10 @@ namespace util {
 
 std::string NormalizePath(absl::string_view path);
 
+// Writes the normalized form of |path| to |normalized|, reusing its storage.
+// |path| must not refer to the contents of |normalized|.
+void NormalizePath(absl::string_view path, std::string *normalized);
+
 }  // namespace util
 }  // namespace io
 }  // namespace asylo
@@ -0,0 +1,187 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+// Replaces the newlib malloc family with a ThreadCachingAllocator over the
+// enclave heap. Small requests are served from per-thread caches without
+// taking the global newlib malloc lock; larger requests, and pointers not owned
+// by the allocator, are passed through to the newlib implementation. Calls are
+// counted by size class for enc_get_malloc_calls, and per thread for
+// enc_get_thread_malloc_calls.
+
+#include <errno.h>
+#include <reent.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <atomic>
+#include <new>
+
+#include "asylo/platform/arch/include/trusted/heap.h"
+#include "asylo/platform/arch/include/trusted/resource_usage.h"
+#include "asylo/platform/posix/malloc/thread_caching_allocator.h"
+
+namespace asylo {
+namespace {
+
+// The free objects of the calling thread. Enclave threads are bound to a TCS
+// and keep their TLS across entries, so caches are never orphaned.
+thread_local ThreadCachingAllocator::ThreadCache thread_cache;
+
+// Storage for the allocator, which is constructed on first use so that
+// allocations made during enclave initialization are served as well.
+alignas(ThreadCachingAllocator) uint8_t
+    allocator_storage[sizeof(ThreadCachingAllocator)];
+std::atomic<ThreadCachingAllocator *> allocator(nullptr);
+std::atomic<bool> allocator_initializing(false);
+
+ThreadCachingAllocator *GetAllocator() {
+  ThreadCachingAllocator *instance = allocator.load(std::memory_order_acquire);
+  if (instance) {
+    return instance;
+  }
+  if (allocator_initializing.exchange(true, std::memory_order_acq_rel)) {
+    // Another thread is constructing the allocator.
+    while (!(instance = allocator.load(std::memory_order_acquire))) {
+    }
+    return instance;
+  }
+  void *region_base;
+  size_t region_size;
+  enc_get_heap_region(&region_base, &region_size);
+  instance = new (allocator_storage)
+      ThreadCachingAllocator(region_base, region_size, enc_reserve_heap_range);
+  allocator.store(instance, std::memory_order_release);
+  return instance;
+}
+
+// The malloc calls made by one thread, by size class, followed by the calls
+// too large for the allocator. Only the owning thread writes the counts.
+// Records are trivially constructible, and are linked into malloc_calls_list
+// on first use and never unlinked, since enclave threads keep their TLS.
+struct MallocCalls {
+  std::atomic<uint64_t> calls[ThreadCachingAllocator::kNumClasses + 1];
+  MallocCalls *next;
+  bool registered;
+};
+
+thread_local MallocCalls malloc_calls;
+std::atomic<MallocCalls *> malloc_calls_list(nullptr);
+
+void CountMallocCall(size_t size) {
+  MallocCalls *record = &malloc_calls;
+  if (!record->registered) {
+    record->registered = true;
+    record->next = malloc_calls_list.load(std::memory_order_relaxed);
+    while (!malloc_calls_list.compare_exchange_weak(
+        record->next, record, std::memory_order_release,
+        std::memory_order_relaxed)) {
+    }
+  }
+  int index = size <= ThreadCachingAllocator::kMaxSize
+                  ? ThreadCachingAllocator::SizeClass(size)
+                  : ThreadCachingAllocator::kNumClasses;
+  std::atomic<uint64_t> &calls = record->calls[index];
+  calls.store(calls.load(std::memory_order_relaxed) + 1,
+              std::memory_order_relaxed);
+}
+
+}  // namespace
+}  // namespace asylo
+
+extern "C" {
+
+void *malloc(size_t size) {
+  asylo::CountMallocCall(size);
+  if (size <= asylo::ThreadCachingAllocator::kMaxSize) {
+    void *ptr = asylo::GetAllocator()->Allocate(&asylo::thread_cache, size);
+    if (ptr) {
+      return ptr;
+    }
+  }
+  return _malloc_r(_REENT, size);
+}
+
+void free(void *ptr) {
+  asylo::ThreadCachingAllocator *instance = asylo::GetAllocator();
+  if (instance->Owns(ptr)) {
+    instance->Deallocate(&asylo::thread_cache, ptr);
+    return;
+  }
+  _free_r(_REENT, ptr);
+}
+
+void *calloc(size_t count, size_t size) {
+  if (size != 0 && count > SIZE_MAX / size) {
+    errno = ENOMEM;
+    return nullptr;
+  }
+  void *ptr = malloc(count * size);
+  if (ptr) {
+    memset(ptr, 0, count * size);
+  }
+  return ptr;
+}
+
+void *realloc(void *ptr, size_t size) {
+  asylo::ThreadCachingAllocator *instance = asylo::GetAllocator();
+  if (!instance->Owns(ptr)) {
+    return ptr ? _realloc_r(_REENT, ptr, size) : malloc(size);
+  }
+  size_t old_size = instance->AllocationSize(ptr);
+  if (size <= old_size) {
+    return ptr;
+  }
+  void *new_ptr = malloc(size);
+  if (new_ptr) {
+    memcpy(new_ptr, ptr, old_size);
+    instance->Deallocate(&asylo::thread_cache, ptr);
+  }
+  return new_ptr;
+}
+
+size_t enc_get_malloc_calls(struct enc_malloc_class_calls *entries,
+                            size_t capacity) {
+  constexpr int kNumEntries = asylo::ThreadCachingAllocator::kNumClasses + 1;
+  size_t count = capacity < kNumEntries ? capacity : kNumEntries;
+  for (size_t i = 0; i < count; ++i) {
+    entries[i].max_size =
+        i < asylo::ThreadCachingAllocator::kNumClasses
+            ? asylo::ThreadCachingAllocator::ClassSize(i)
+            : SIZE_MAX;
+    entries[i].calls = 0;
+  }
+  for (asylo::MallocCalls *record =
+           asylo::malloc_calls_list.load(std::memory_order_acquire);
+       record; record = record->next) {
+    for (size_t i = 0; i < count; ++i) {
+      entries[i].calls += record->calls[i].load(std::memory_order_relaxed);
+    }
+  }
+  return count;
+}
+
+uint64_t enc_get_thread_malloc_calls(void) {
+  uint64_t calls = 0;
+  for (const std::atomic<uint64_t> &count : asylo::malloc_calls.calls) {
+    calls += count.load(std::memory_order_relaxed);
+  }
+  return calls;
+}
+
+}  // extern "C"
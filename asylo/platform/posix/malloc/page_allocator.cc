@@ -0,0 +1,166 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/posix/malloc/page_allocator.h"
+
+#include <errno.h>
+
+#include <cstring>
+
+namespace asylo {
+
+constexpr size_t PageAllocator::kPageSize;
+constexpr size_t PageAllocator::kReserveChunkSize;
+constexpr size_t PageAllocator::kMaxFreeRanges;
+
+void *PageAllocator::Allocate(size_t size) {
+  if (size == 0 || size > SIZE_MAX - kPageSize) {
+    return nullptr;
+  }
+  size = RoundUpToPage(size);
+
+  McsLockGuard lock(&lock_);
+  size_t index = 0;
+  while (index < free_range_count_ &&
+         free_ranges_[index].end - free_ranges_[index].begin < size) {
+    ++index;
+  }
+  if (index == free_range_count_) {
+    if (!Grow(size)) {
+      return nullptr;
+    }
+    // The new address space is at the bottom of the region.
+    index = 0;
+    if (free_ranges_[index].end - free_ranges_[index].begin < size) {
+      return nullptr;
+    }
+  }
+
+  uintptr_t address = free_ranges_[index].begin;
+  free_ranges_[index].begin += size;
+  if (free_ranges_[index].begin == free_ranges_[index].end) {
+    EraseRange(index);
+  }
+  if (backend_.commit(reinterpret_cast<void *>(address), size) != 0) {
+    // The range was just carved from the table, so returning it never needs
+    // an additional entry.
+    MarkFree(address, address + size, /*decommit=*/false);
+    return nullptr;
+  }
+  return reinterpret_cast<void *>(address);
+}
+
+int PageAllocator::Free(void *address, size_t size) {
+  uintptr_t begin = reinterpret_cast<uintptr_t>(address);
+  if (size == 0 || (begin % kPageSize) != 0 || size > SIZE_MAX - kPageSize) {
+    return EINVAL;
+  }
+  size = RoundUpToPage(size);
+
+  McsLockGuard lock(&lock_);
+  if (begin < region_begin_ || begin >= region_end_ ||
+      size > region_end_ - begin) {
+    return EINVAL;
+  }
+  return MarkFree(begin, begin + size, /*decommit=*/true);
+}
+
+bool PageAllocator::Grow(size_t size) {
+  size_t chunk_size = size < kReserveChunkSize ? kReserveChunkSize : size;
+  void *chunk = backend_.reserve(chunk_size);
+  if (!chunk) {
+    return false;
+  }
+  uintptr_t begin = reinterpret_cast<uintptr_t>(chunk);
+  if (region_end_ == 0) {
+    region_end_ = begin + chunk_size;
+  } else if (begin + chunk_size != region_begin_) {
+    // The backend broke its contract; the address space cannot be tracked.
+    return false;
+  }
+  region_begin_ = begin;
+  return MarkFree(begin, begin + chunk_size, /*decommit=*/false) == 0;
+}
+
+int PageAllocator::MarkFree(uintptr_t begin, uintptr_t end, bool decommit) {
+  // Find the free ranges [first, last) which overlap or adjoin the new range.
+  size_t first = 0;
+  while (first < free_range_count_ && free_ranges_[first].end < begin) {
+    ++first;
+  }
+  size_t last = first;
+  while (last < free_range_count_ && free_ranges_[last].begin <= end) {
+    ++last;
+  }
+
+  if (first == last) {
+    if (free_range_count_ == kMaxFreeRanges) {
+      return ENOMEM;
+    }
+    if (decommit) {
+      backend_.decommit(reinterpret_cast<void *>(begin), end - begin);
+    }
+    InsertRange(first, {begin, end});
+    return 0;
+  }
+
+  if (decommit) {
+    // Only decommit the gaps between free ranges, which are allocated.
+    uintptr_t cursor = begin;
+    for (size_t i = first; i < last; ++i) {
+      if (free_ranges_[i].begin > cursor) {
+        backend_.decommit(reinterpret_cast<void *>(cursor),
+                          free_ranges_[i].begin - cursor);
+      }
+      if (free_ranges_[i].end > cursor) {
+        cursor = free_ranges_[i].end;
+      }
+    }
+    if (cursor < end) {
+      backend_.decommit(reinterpret_cast<void *>(cursor), end - cursor);
+    }
+  }
+
+  Range merged = {free_ranges_[first].begin, free_ranges_[last - 1].end};
+  if (begin < merged.begin) {
+    merged.begin = begin;
+  }
+  if (end > merged.end) {
+    merged.end = end;
+  }
+  free_ranges_[first] = merged;
+  for (size_t i = last - 1; i > first; --i) {
+    EraseRange(i);
+  }
+  return 0;
+}
+
+void PageAllocator::EraseRange(size_t index) {
+  memmove(&free_ranges_[index], &free_ranges_[index + 1],
+          (free_range_count_ - index - 1) * sizeof(Range));
+  --free_range_count_;
+}
+
+void PageAllocator::InsertRange(size_t index, Range range) {
+  memmove(&free_ranges_[index + 1], &free_ranges_[index],
+          (free_range_count_ - index) * sizeof(Range));
+  free_ranges_[index] = range;
+  ++free_range_count_;
+}
+
+}  // namespace asylo
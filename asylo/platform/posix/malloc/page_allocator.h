@@ -0,0 +1,116 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_PLATFORM_POSIX_MALLOC_PAGE_ALLOCATOR_H_
+#define ASYLO_PLATFORM_POSIX_MALLOC_PAGE_ALLOCATOR_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include "asylo/platform/common/mcs_lock.h"
+
+namespace asylo {
+
+// Allocates page-granular ranges of memory, as needed to implement anonymous
+// mmap(2) and munmap(2).
+//
+// The allocator manages a single contiguous region of address space, which it
+// extends downwards on demand through its Backend, and keeps a sorted table of
+// the free ranges within it. Pages are committed when allocated and
+// decommitted when freed, so memory is only backed while it is mapped. The
+// allocator never allocates memory for itself, so it can serve a malloc
+// implementation built on top of it.
+class PageAllocator {
+ public:
+  // Operations through which the allocator obtains and backs memory.
+  struct Backend {
+    // Reserves |size| bytes of address space immediately below any address
+    // space previously returned. Returns nullptr on failure.
+    void *(*reserve)(size_t size);
+
+    // Backs a reserved range with zero-filled memory. Returns 0 on success.
+    int (*commit)(void *address, size_t size);
+
+    // Releases the memory backing a committed range.
+    void (*decommit)(void *address, size_t size);
+  };
+
+  static constexpr size_t kPageSize = 4096;
+
+  // Minimum number of bytes of address space reserved at a time.
+  static constexpr size_t kReserveChunkSize = 1024 * 1024;
+
+  // Maximum number of disjoint free ranges tracked by the allocator.
+  static constexpr size_t kMaxFreeRanges = 1024;
+
+  constexpr explicit PageAllocator(Backend backend)
+      : backend_(backend),
+        region_begin_(0),
+        region_end_(0),
+        free_range_count_(0),
+        free_ranges_() {}
+
+  PageAllocator(const PageAllocator &) = delete;
+  PageAllocator &operator=(const PageAllocator &) = delete;
+
+  // Allocates |size| bytes of zero-filled memory, rounded up to a whole number
+  // of pages. Returns nullptr if no memory is available.
+  void *Allocate(size_t size);
+
+  // Frees the pages in the |size| bytes at |address|, which must be
+  // page-aligned. Pages in the range which are already free are ignored.
+  // Returns 0 on success, EINVAL if the range does not lie within the region
+  // managed by the allocator, or ENOMEM if freeing the range would exceed
+  // kMaxFreeRanges.
+  int Free(void *address, size_t size);
+
+ private:
+  struct Range {
+    uintptr_t begin = 0;
+    uintptr_t end = 0;
+  };
+
+  static size_t RoundUpToPage(size_t size) {
+    return (size + kPageSize - 1) & ~(kPageSize - 1);
+  }
+
+  // Extends the region downwards by at least |size| bytes.
+  bool Grow(size_t size);
+
+  // Marks [|begin|, |end|) free, merging it with any free ranges it overlaps
+  // or adjoins. Pages in the range which were allocated are decommitted if
+  // |decommit| is true. Requires lock_ to be held.
+  int MarkFree(uintptr_t begin, uintptr_t end, bool decommit);
+
+  // Removes the free range at |index| from the table.
+  void EraseRange(size_t index);
+
+  // Inserts |range| into the table at |index|, which must have space.
+  void InsertRange(size_t index, Range range);
+
+  const Backend backend_;
+  McsLock lock_;
+  uintptr_t region_begin_;
+  uintptr_t region_end_;
+  size_t free_range_count_;
+  Range free_ranges_[kMaxFreeRanges];
+};
+
+}  // namespace asylo
+
+#endif  // ASYLO_PLATFORM_POSIX_MALLOC_PAGE_ALLOCATOR_H_
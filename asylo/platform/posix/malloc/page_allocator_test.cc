@@ -0,0 +1,189 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/posix/malloc/page_allocator.h"
+
+#include <errno.h>
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace asylo {
+namespace {
+
+constexpr size_t kPageSize = PageAllocator::kPageSize;
+constexpr size_t kRegionPages = 4096;
+
+// A fake backend over a region of host memory, which hands out address space
+// from the top down and tracks which pages are committed.
+uint8_t *region = nullptr;
+size_t region_reserved = 0;
+std::vector<bool> *committed = nullptr;
+
+void *Reserve(size_t size) {
+  if (size > kRegionPages * kPageSize - region_reserved) {
+    return nullptr;
+  }
+  region_reserved += size;
+  return region + kRegionPages * kPageSize - region_reserved;
+}
+
+size_t PageIndex(void *address) {
+  return (static_cast<uint8_t *>(address) - region) / kPageSize;
+}
+
+int Commit(void *address, size_t size) {
+  for (size_t i = 0; i < size / kPageSize; ++i) {
+    EXPECT_FALSE((*committed)[PageIndex(address) + i]);
+    (*committed)[PageIndex(address) + i] = true;
+  }
+  memset(address, 0, size);
+  return 0;
+}
+
+void Decommit(void *address, size_t size) {
+  for (size_t i = 0; i < size / kPageSize; ++i) {
+    EXPECT_TRUE((*committed)[PageIndex(address) + i]);
+    (*committed)[PageIndex(address) + i] = false;
+  }
+  // Leave stale contents behind to check that commit clears them.
+  memset(address, 0xa5, size);
+}
+
+class PageAllocatorTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    region = static_cast<uint8_t *>(
+        aligned_alloc(kPageSize, kRegionPages * kPageSize));
+    region_reserved = 0;
+    committed = new std::vector<bool>(kRegionPages, false);
+    // The allocator is over-aligned, so it is not allocated with plain new.
+    void *storage =
+        aligned_alloc(alignof(PageAllocator), sizeof(PageAllocator));
+    allocator_ = new (storage) PageAllocator({Reserve, Commit, Decommit});
+  }
+
+  void TearDown() override {
+    allocator_->~PageAllocator();
+    free(allocator_);
+    delete committed;
+    free(region);
+  }
+
+  size_t CommittedPages() const {
+    size_t count = 0;
+    for (bool page : *committed) {
+      count += page;
+    }
+    return count;
+  }
+
+  PageAllocator *allocator_;
+};
+
+TEST_F(PageAllocatorTest, AllocatesZeroedPages) {
+  uint8_t *memory = static_cast<uint8_t *>(allocator_->Allocate(100));
+  ASSERT_NE(memory, nullptr);
+  EXPECT_EQ(reinterpret_cast<uintptr_t>(memory) % kPageSize, 0);
+  EXPECT_EQ(CommittedPages(), 1);
+  for (size_t i = 0; i < kPageSize; ++i) {
+    ASSERT_EQ(memory[i], 0);
+  }
+  memset(memory, 1, kPageSize);
+  EXPECT_EQ(allocator_->Free(memory, 100), 0);
+  EXPECT_EQ(CommittedPages(), 0);
+
+  // The freed page is reused and cleared again.
+  EXPECT_EQ(allocator_->Allocate(kPageSize), memory);
+  EXPECT_EQ(memory[0], 0);
+}
+
+TEST_F(PageAllocatorTest, CoalescesFreeRanges) {
+  uint8_t *first = static_cast<uint8_t *>(allocator_->Allocate(kPageSize));
+  uint8_t *second = static_cast<uint8_t *>(allocator_->Allocate(kPageSize));
+  uint8_t *third = static_cast<uint8_t *>(allocator_->Allocate(kPageSize));
+  ASSERT_EQ(second, first + kPageSize);
+  ASSERT_EQ(third, second + kPageSize);
+
+  EXPECT_EQ(allocator_->Free(second, kPageSize), 0);
+  EXPECT_EQ(allocator_->Free(first, kPageSize), 0);
+  EXPECT_EQ(allocator_->Free(third, kPageSize), 0);
+  EXPECT_EQ(CommittedPages(), 0);
+  EXPECT_EQ(allocator_->Allocate(3 * kPageSize), first);
+}
+
+TEST_F(PageAllocatorTest, FreesPartialAndOverlappingRanges) {
+  uint8_t *memory = static_cast<uint8_t *>(allocator_->Allocate(8 * kPageSize));
+  ASSERT_NE(memory, nullptr);
+  EXPECT_EQ(allocator_->Free(memory + 2 * kPageSize, 2 * kPageSize), 0);
+  EXPECT_EQ(CommittedPages(), 6);
+
+  // Freeing pages which are already free must not decommit them again.
+  EXPECT_EQ(allocator_->Free(memory, 8 * kPageSize), 0);
+  EXPECT_EQ(CommittedPages(), 0);
+}
+
+TEST_F(PageAllocatorTest, GrowsBeyondReserveChunk) {
+  size_t size = PageAllocator::kReserveChunkSize + kPageSize;
+  void *small = allocator_->Allocate(kPageSize);
+  void *large = allocator_->Allocate(size);
+  ASSERT_NE(small, nullptr);
+  ASSERT_NE(large, nullptr);
+  EXPECT_EQ(CommittedPages(), 1 + size / kPageSize);
+  EXPECT_EQ(allocator_->Free(large, size), 0);
+  EXPECT_EQ(allocator_->Free(small, kPageSize), 0);
+}
+
+TEST_F(PageAllocatorTest, RejectsInvalidRanges) {
+  EXPECT_EQ(allocator_->Allocate(0), nullptr);
+  uint8_t *memory = static_cast<uint8_t *>(allocator_->Allocate(kPageSize));
+  ASSERT_NE(memory, nullptr);
+  EXPECT_EQ(allocator_->Free(memory + 1, kPageSize), EINVAL);
+  EXPECT_EQ(allocator_->Free(memory, 0), EINVAL);
+  int local;
+  EXPECT_EQ(allocator_->Free(&local, kPageSize), EINVAL);
+  EXPECT_EQ(allocator_->Allocate(kRegionPages * kPageSize), nullptr);
+}
+
+TEST_F(PageAllocatorTest, ReportsFreeRangeExhaustion) {
+  constexpr size_t kPages = 2 * PageAllocator::kMaxFreeRanges + 2;
+  std::vector<void *> pages;
+  for (size_t i = 0; i < kPages; ++i) {
+    pages.push_back(allocator_->Allocate(kPageSize));
+    ASSERT_NE(pages.back(), nullptr);
+  }
+  // Freeing every other page leaves each free page isolated between two
+  // allocated ones. The unused tail of the reserved address space takes the
+  // remaining entry.
+  size_t i = 0;
+  for (; i + 1 < PageAllocator::kMaxFreeRanges; ++i) {
+    ASSERT_EQ(allocator_->Free(pages[2 * i + 1], kPageSize), 0);
+  }
+  EXPECT_EQ(allocator_->Free(pages[2 * i + 1], kPageSize), ENOMEM);
+
+  // Freeing a page adjoining a free range needs no new entry.
+  EXPECT_EQ(allocator_->Free(pages[0], kPageSize), 0);
+}
+
+}  // namespace
+}  // namespace asylo
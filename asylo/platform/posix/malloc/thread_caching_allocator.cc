@@ -0,0 +1,233 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/posix/malloc/thread_caching_allocator.h"
+
+#include <cstring>
+#include <new>
+
+namespace asylo {
+namespace {
+
+// Number of bytes moved between a thread cache and a central list at a time,
+// before clamping to the batch size bounds below.
+constexpr size_t kTransferBytes = 32 * 1024;
+constexpr size_t kMinBatchSize = 2;
+constexpr size_t kMaxBatchSize = 32;
+
+// Number of size classes spaced linearly, 16 bytes apart, up to 128 bytes.
+// Larger classes are spaced four to each doubling of size.
+constexpr int kNumLinearClasses = 8;
+constexpr size_t kLinearClassStep = 16;
+
+// Free objects are linked through their first word.
+void *&NextFree(void *object) { return *reinterpret_cast<void **>(object); }
+
+// Returns the index of the most significant set bit of |value|, which must
+// not be zero.
+int Log2Floor(size_t value) { return 63 - __builtin_clzll(value); }
+
+}  // namespace
+
+constexpr size_t ThreadCachingAllocator::kMaxSize;
+constexpr int ThreadCachingAllocator::kNumClasses;
+constexpr size_t ThreadCachingAllocator::kSpanSize;
+constexpr size_t ThreadCachingAllocator::kSpanChunkSize;
+
+void ThreadCachingAllocator::ThreadCache::Flush(
+    ThreadCachingAllocator *allocator) {
+  for (int size_class = 0; size_class < kNumClasses; ++size_class) {
+    FreeList *list = &lists_[size_class];
+    if (list->length > 0) {
+      allocator->Release(list, size_class, list->length);
+    }
+  }
+}
+
+ThreadCachingAllocator::ThreadCachingAllocator(void *region_base,
+                                               size_t region_size,
+                                               SpanSource source)
+    : region_base_(reinterpret_cast<uintptr_t>(region_base) & -kSpanSize),
+      region_size_(
+          region_size +
+          (reinterpret_cast<uintptr_t>(region_base) & (kSpanSize - 1))),
+      source_(source),
+      next_span_(0),
+      span_limit_(0),
+      span_map_(nullptr) {
+  for (CentralList &central : central_) {
+    central.head = nullptr;
+  }
+}
+
+int ThreadCachingAllocator::SizeClass(size_t size) {
+  if (size <= kNumLinearClasses * kLinearClassStep) {
+    return size == 0 ? 0 : (size - 1) / kLinearClassStep;
+  }
+  size_t last_byte = size - 1;
+  int log2 = Log2Floor(last_byte);
+  int group = log2 - Log2Floor(kNumLinearClasses * kLinearClassStep);
+  int step = (last_byte >> (log2 - 2)) - 4;
+  return kNumLinearClasses + group * 4 + step;
+}
+
+size_t ThreadCachingAllocator::ClassSize(int size_class) {
+  if (size_class < kNumLinearClasses) {
+    return (size_class + 1) * kLinearClassStep;
+  }
+  int group = (size_class - kNumLinearClasses) / 4;
+  int step = (size_class - kNumLinearClasses) % 4;
+  size_t group_base = (kNumLinearClasses * kLinearClassStep) << group;
+  return group_base + (step + 1) * (group_base / 4);
+}
+
+size_t ThreadCachingAllocator::BatchSize(int size_class) {
+  size_t batch = kTransferBytes / ClassSize(size_class);
+  if (batch < kMinBatchSize) {
+    return kMinBatchSize;
+  }
+  return batch > kMaxBatchSize ? kMaxBatchSize : batch;
+}
+
+void *ThreadCachingAllocator::Allocate(ThreadCache *cache, size_t size) {
+  if (size > kMaxSize) {
+    return nullptr;
+  }
+  int size_class = SizeClass(size);
+  ThreadCache::FreeList *list = &cache->lists_[size_class];
+  if (!list->head && !Refill(list, size_class)) {
+    return nullptr;
+  }
+  void *object = list->head;
+  list->head = NextFree(object);
+  --list->length;
+  return object;
+}
+
+void ThreadCachingAllocator::Deallocate(ThreadCache *cache, void *ptr) {
+  int size_class = SpanEntry(ptr)->load(std::memory_order_relaxed) - 1;
+  ThreadCache::FreeList *list = &cache->lists_[size_class];
+  NextFree(ptr) = list->head;
+  list->head = ptr;
+  // Keep at most two batches per class, so memory freed by one thread does not
+  // stay out of reach of the others indefinitely.
+  size_t batch = BatchSize(size_class);
+  if (++list->length > 2 * batch) {
+    Release(list, size_class, batch);
+  }
+}
+
+bool ThreadCachingAllocator::Owns(const void *ptr) const {
+  const std::atomic<uint8_t> *entry = SpanEntry(ptr);
+  return entry && entry->load(std::memory_order_relaxed) != 0;
+}
+
+size_t ThreadCachingAllocator::AllocationSize(const void *ptr) const {
+  return ClassSize(SpanEntry(ptr)->load(std::memory_order_relaxed) - 1);
+}
+
+const std::atomic<uint8_t> *ThreadCachingAllocator::SpanEntry(
+    const void *ptr) const {
+  std::atomic<uint8_t> *span_map = span_map_.load(std::memory_order_acquire);
+  uintptr_t offset = reinterpret_cast<uintptr_t>(ptr) - region_base_;
+  if (!span_map || offset >= region_size_) {
+    return nullptr;
+  }
+  return &span_map[offset / kSpanSize];
+}
+
+bool ThreadCachingAllocator::Refill(ThreadCache::FreeList *list,
+                                    int size_class) {
+  CentralList *central = &central_[size_class];
+  size_t batch = BatchSize(size_class);
+  McsLockGuard lock(&central->lock);
+  if (!central->head) {
+    void *span = NewSpan(size_class);
+    if (!span) {
+      return false;
+    }
+    // Thread the span's objects onto the central list in address order.
+    size_t object_size = ClassSize(size_class);
+    uint8_t *object = reinterpret_cast<uint8_t *>(span);
+    uint8_t *last = object + (kSpanSize / object_size - 1) * object_size;
+    for (; object < last; object += object_size) {
+      NextFree(object) = object + object_size;
+    }
+    NextFree(last) = nullptr;
+    central->head = span;
+  }
+  while (central->head && list->length < batch) {
+    void *object = central->head;
+    central->head = NextFree(object);
+    NextFree(object) = list->head;
+    list->head = object;
+    ++list->length;
+  }
+  return true;
+}
+
+void ThreadCachingAllocator::Release(ThreadCache::FreeList *list,
+                                     int size_class, size_t count) {
+  // Detach the first |count| objects before taking the lock.
+  void *first = list->head;
+  void *last = first;
+  for (size_t i = 1; i < count; ++i) {
+    last = NextFree(last);
+  }
+  list->head = NextFree(last);
+  list->length -= count;
+
+  CentralList *central = &central_[size_class];
+  McsLockGuard lock(&central->lock);
+  NextFree(last) = central->head;
+  central->head = first;
+}
+
+void *ThreadCachingAllocator::NewSpan(int size_class) {
+  McsLockGuard lock(&span_lock_);
+  std::atomic<uint8_t> *span_map = span_map_.load(std::memory_order_relaxed);
+  if (!span_map) {
+    size_t span_count = region_size_ / kSpanSize + 1;
+    void *storage = source_(span_count, kCacheLineSize);
+    if (!storage) {
+      return nullptr;
+    }
+    span_map = new (storage) std::atomic<uint8_t>[span_count];
+    for (size_t i = 0; i < span_count; ++i) {
+      span_map[i].store(0, std::memory_order_relaxed);
+    }
+    span_map_.store(span_map, std::memory_order_release);
+  }
+  if (next_span_ == span_limit_) {
+    void *chunk = source_(kSpanChunkSize, kSpanSize);
+    uintptr_t start = reinterpret_cast<uintptr_t>(chunk);
+    if (!chunk || start - region_base_ >= region_size_ ||
+        region_size_ - (start - region_base_) < kSpanChunkSize) {
+      return nullptr;
+    }
+    next_span_ = start;
+    span_limit_ = start + kSpanChunkSize;
+  }
+  uintptr_t span = next_span_;
+  next_span_ += kSpanSize;
+  span_map[(span - region_base_) / kSpanSize].store(size_class + 1,
+                                                    std::memory_order_relaxed);
+  return reinterpret_cast<void *>(span);
+}
+
+}  // namespace asylo
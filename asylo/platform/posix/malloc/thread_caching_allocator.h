@@ -0,0 +1,159 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_PLATFORM_POSIX_MALLOC_THREAD_CACHING_ALLOCATOR_H_
+#define ASYLO_PLATFORM_POSIX_MALLOC_THREAD_CACHING_ALLOCATOR_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include "asylo/platform/common/mcs_lock.h"
+
+namespace asylo {
+
+// A small-object allocator in which each thread serves most requests from a
+// private cache of free objects, touching shared state only to move objects in
+// batches between its cache and a central free list.
+//
+// Objects are grouped into size classes. Each class is backed by spans, fixed
+// size blocks of memory obtained from a SpanSource and divided into objects of
+// the class size. A byte map over the region spans are drawn from records the
+// class of each span, so the allocator can recognize its own objects and their
+// sizes from a bare pointer. Memory is never returned to the SpanSource.
+class ThreadCachingAllocator {
+ public:
+  // Returns |size| bytes of memory aligned to |alignment|, or nullptr if no
+  // memory is available.
+  using SpanSource = void *(*)(size_t size, size_t alignment);
+
+  // Largest request served by the allocator.
+  static constexpr size_t kMaxSize = 8192;
+
+  // Number of size classes.
+  static constexpr int kNumClasses = 32;
+
+  // Size and alignment of a span.
+  static constexpr size_t kSpanSize = 64 * 1024;
+
+  // Number of bytes requested from the SpanSource at a time.
+  static constexpr size_t kSpanChunkSize = 1024 * 1024;
+
+  // The free objects available to a single thread. A cache is trivially
+  // constructible, so it may be declared thread_local without depending on
+  // dynamic TLS initialization. Objects held by a cache are only available to
+  // other threads after a call to Flush().
+  class ThreadCache {
+   public:
+    constexpr ThreadCache() : lists_() {}
+
+    ThreadCache(const ThreadCache &) = delete;
+    ThreadCache &operator=(const ThreadCache &) = delete;
+
+    // Returns all objects held by this cache to the central free lists of
+    // |allocator|.
+    void Flush(ThreadCachingAllocator *allocator);
+
+   private:
+    friend class ThreadCachingAllocator;
+
+    struct FreeList {
+      void *head = nullptr;
+      size_t length = 0;
+    };
+
+    FreeList lists_[kNumClasses];
+  };
+
+  // Creates an allocator drawing spans from |source|. Spans must lie within
+  // the |region_size| bytes starting at |region_base|.
+  ThreadCachingAllocator(void *region_base, size_t region_size,
+                         SpanSource source);
+
+  ThreadCachingAllocator(const ThreadCachingAllocator &) = delete;
+  ThreadCachingAllocator &operator=(const ThreadCachingAllocator &) = delete;
+
+  // Allocates an object of at least |size| bytes from |cache|, aligned to 16
+  // bytes. Returns nullptr if |size| exceeds kMaxSize or no memory is
+  // available.
+  void *Allocate(ThreadCache *cache, size_t size);
+
+  // Returns |ptr|, which must be owned by this allocator, to |cache|.
+  void Deallocate(ThreadCache *cache, void *ptr);
+
+  // Returns true if |ptr| points into a span owned by this allocator.
+  bool Owns(const void *ptr) const;
+
+  // Returns the usable size of the object at |ptr|, which must be owned by
+  // this allocator.
+  size_t AllocationSize(const void *ptr) const;
+
+  // Returns the size class serving requests of |size| bytes, which must not
+  // exceed kMaxSize.
+  static int SizeClass(size_t size);
+
+  // Returns the object size of |size_class|.
+  static size_t ClassSize(int size_class);
+
+ private:
+  // Objects of one size class available to all threads.
+  struct alignas(kCacheLineSize) CentralList {
+    McsLock lock;
+    void *head;
+  };
+
+  // Returns the number of objects moved between a thread cache and a central
+  // list at a time for |size_class|.
+  static size_t BatchSize(int size_class);
+
+  // Returns the span map entry covering |ptr|, or nullptr if |ptr| lies
+  // outside the region.
+  const std::atomic<uint8_t> *SpanEntry(const void *ptr) const;
+
+  // Moves up to a batch of objects of |size_class| from the central list into
+  // |list|, carving a new span if the central list is empty. Returns false if
+  // no memory is available.
+  bool Refill(ThreadCache::FreeList *list, int size_class);
+
+  // Moves |count| objects from the head of |list| to the central list of
+  // |size_class|.
+  void Release(ThreadCache::FreeList *list, int size_class, size_t count);
+
+  // Returns a fresh span assigned to |size_class|, or nullptr if no memory
+  // is available.
+  void *NewSpan(int size_class);
+
+  const uintptr_t region_base_;
+  const size_t region_size_;
+  const SpanSource source_;
+
+  CentralList central_[kNumClasses];
+
+  // Guards the span pool and creation of the span map.
+  McsLock span_lock_;
+  uintptr_t next_span_;
+  uintptr_t span_limit_;
+
+  // One entry per span in the region, holding the size class of the span plus
+  // one, or zero if the span does not belong to the allocator.
+  std::atomic<std::atomic<uint8_t> *> span_map_;
+};
+
+}  // namespace asylo
+
+#endif  // ASYLO_PLATFORM_POSIX_MALLOC_THREAD_CACHING_ALLOCATOR_H_
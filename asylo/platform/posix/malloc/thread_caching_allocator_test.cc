@@ -0,0 +1,178 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/posix/malloc/thread_caching_allocator.h"
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <set>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace asylo {
+namespace {
+
+using ThreadCache = ThreadCachingAllocator::ThreadCache;
+
+constexpr size_t kRegionSize = 64 * ThreadCachingAllocator::kSpanChunkSize;
+constexpr int kThreads = 8;
+constexpr int kIterations = 20000;
+
+// A region of host memory standing in for the enclave heap, from which spans
+// are carved by a bump pointer.
+uint8_t *region = nullptr;
+size_t region_used = 0;
+
+void *ReserveFromRegion(size_t size, size_t alignment) {
+  size_t start = (region_used + alignment - 1) & -alignment;
+  if (start + size > kRegionSize) {
+    return nullptr;
+  }
+  region_used = start + size;
+  return region + start;
+}
+
+class ThreadCachingAllocatorTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    region = static_cast<uint8_t *>(
+        aligned_alloc(ThreadCachingAllocator::kSpanSize, kRegionSize));
+    region_used = 0;
+    // The allocator is over-aligned, so it is not allocated with plain new.
+    void *storage = aligned_alloc(alignof(ThreadCachingAllocator),
+                                  sizeof(ThreadCachingAllocator));
+    allocator_ = new (storage)
+        ThreadCachingAllocator(region, kRegionSize, ReserveFromRegion);
+  }
+
+  void TearDown() override {
+    allocator_->~ThreadCachingAllocator();
+    free(allocator_);
+    free(region);
+  }
+
+  ThreadCachingAllocator *allocator_;
+};
+
+TEST(ThreadCachingAllocatorSizeClassTest, ClassesCoverAllSizes) {
+  EXPECT_EQ(ThreadCachingAllocator::SizeClass(0), 0);
+  EXPECT_EQ(ThreadCachingAllocator::ClassSize(0), 16);
+  EXPECT_EQ(ThreadCachingAllocator::SizeClass(ThreadCachingAllocator::kMaxSize),
+            ThreadCachingAllocator::kNumClasses - 1);
+  EXPECT_EQ(ThreadCachingAllocator::ClassSize(
+                ThreadCachingAllocator::kNumClasses - 1),
+            ThreadCachingAllocator::kMaxSize);
+
+  int previous_class = 0;
+  for (size_t size = 1; size <= ThreadCachingAllocator::kMaxSize; ++size) {
+    int size_class = ThreadCachingAllocator::SizeClass(size);
+    size_t class_size = ThreadCachingAllocator::ClassSize(size_class);
+    ASSERT_GE(class_size, size);
+    ASSERT_EQ(class_size % 16, 0);
+    ASSERT_TRUE(size_class == previous_class ||
+                size_class == previous_class + 1);
+    if (size_class > 0) {
+      ASSERT_LT(ThreadCachingAllocator::ClassSize(size_class - 1), size);
+    }
+    previous_class = size_class;
+  }
+}
+
+TEST_F(ThreadCachingAllocatorTest, AllocatesDistinctOwnedObjects) {
+  ThreadCache cache;
+  std::set<void *> objects;
+  for (size_t size = 1; size <= ThreadCachingAllocator::kMaxSize; size += 37) {
+    void *object = allocator_->Allocate(&cache, size);
+    ASSERT_NE(object, nullptr);
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(object) % 16, 0);
+    EXPECT_TRUE(allocator_->Owns(object));
+    EXPECT_GE(allocator_->AllocationSize(object), size);
+    memset(object, 0xa5, size);
+    EXPECT_TRUE(objects.insert(object).second);
+  }
+  for (void *object : objects) {
+    allocator_->Deallocate(&cache, object);
+  }
+  cache.Flush(allocator_);
+}
+
+TEST_F(ThreadCachingAllocatorTest, RejectsForeignAndLargeRequests) {
+  ThreadCache cache;
+  int local = 0;
+  EXPECT_FALSE(allocator_->Owns(&local));
+  EXPECT_EQ(allocator_->Allocate(&cache, ThreadCachingAllocator::kMaxSize + 1),
+            nullptr);
+}
+
+TEST_F(ThreadCachingAllocatorTest, ReusesFreedObjects) {
+  ThreadCache cache;
+  void *object = allocator_->Allocate(&cache, 64);
+  allocator_->Deallocate(&cache, object);
+  EXPECT_EQ(allocator_->Allocate(&cache, 64), object);
+}
+
+TEST_F(ThreadCachingAllocatorTest, ReturnsNullWhenRegionIsExhausted) {
+  ThreadCache cache;
+  size_t allocated = 0;
+  while (allocator_->Allocate(&cache, ThreadCachingAllocator::kMaxSize)) {
+    allocated += ThreadCachingAllocator::kMaxSize;
+    ASSERT_LE(allocated, kRegionSize);
+  }
+  EXPECT_GT(allocated, kRegionSize / 2);
+}
+
+// Passes objects allocated on one thread to others to be freed, checking that
+// no object is handed out twice while live.
+TEST_F(ThreadCachingAllocatorTest, ConcurrentAllocateAndFree) {
+  std::vector<std::thread> threads;
+  for (int i = 0; i < kThreads; ++i) {
+    threads.emplace_back([this, i] {
+      ThreadCache cache;
+      std::vector<uint32_t *> live;
+      for (int j = 0; j < kIterations; ++j) {
+        size_t size = 16 + (i * 131 + j * 17) % 2048;
+        uint32_t *object =
+            static_cast<uint32_t *>(allocator_->Allocate(&cache, size));
+        ASSERT_NE(object, nullptr);
+        object[1] = j;
+        live.push_back(object);
+        if (live.size() > 64) {
+          for (uint32_t *freed : live) {
+            ASSERT_LT(freed[1], kIterations);
+            allocator_->Deallocate(&cache, freed);
+          }
+          live.clear();
+        }
+      }
+      for (uint32_t *freed : live) {
+        allocator_->Deallocate(&cache, freed);
+      }
+      cache.Flush(allocator_);
+    });
+  }
+  for (std::thread &thread : threads) {
+    thread.join();
+  }
+}
+
+}  // namespace
+}  // namespace asylo
@@ -18,15 +18,93 @@
 
 #include <sys/mman.h>
 
-#include <stdlib.h>
+#include <errno.h>
+#include <stdint.h>
+
+#include "asylo/platform/arch/include/trusted/heap.h"
+#include "asylo/platform/posix/io/io_manager.h"
+#include "asylo/platform/posix/malloc/page_allocator.h"
+
+namespace {
+
+// Serves anonymous mappings from address space reserved at the top of the
+// enclave heap. Constant-initialized, so that mmap may be used by allocators
+// running before static constructors.
+asylo::PageAllocator page_allocator({enc_reserve_heap_address_space,
+                                     enc_commit_heap_pages,
+                                     enc_decommit_heap_pages});
+
+// Fills the |length| bytes at |memory| with the contents of the file open on
+// |fd| from |offset|. Bytes past the end of the file are left zero. Returns 0
+// on success, or an errno value on failure.
+int ReadFileIntoMapping(uint8_t *memory, size_t length, int fd, off_t offset) {
+  size_t bytes_read = 0;
+  while (bytes_read < length) {
+    ssize_t result = asylo::io::IOManager::GetInstance().Pread(
+        fd, memory + bytes_read, length - bytes_read, offset + bytes_read);
+    if (result < 0) {
+      return errno;
+    }
+    if (result == 0) {
+      break;
+    }
+    bytes_read += result;
+  }
+  return 0;
+}
+
+}  // namespace
 
 extern "C" {
 
 void *mmap(void *addr, size_t length, int prot, int flags, int fd,
            off_t offset) {
-  abort();
+  // Files are mapped by copying their contents into enclave pages, which for
+  // secure files decrypts and verifies them once at mapping time. Changes to
+  // the mapping cannot be carried back to the file, so only private mappings
+  // are supported. The pages are filled eagerly even where EDMM lets them be
+  // committed on demand: trusted exception handlers are not told the faulting
+  // address, so a first touch could only be resolved from a host signal whose
+  // address the enclave cannot trust.
+  const bool is_file = !(flags & MAP_ANONYMOUS);
+  if ((flags & MAP_FIXED) || (prot & PROT_EXEC) ||
+      (is_file && (flags & MAP_SHARED))) {
+    errno = ENOTSUP;
+    return MAP_FAILED;
+  }
+  if (length == 0 ||
+      (is_file &&
+       (offset < 0 ||
+        offset % static_cast<off_t>(asylo::PageAllocator::kPageSize) != 0))) {
+    errno = EINVAL;
+    return MAP_FAILED;
+  }
+  // The hint |addr| is ignored, as permitted without MAP_FIXED. Enclave pages
+  // are always readable and writable, so |prot| is not enforced either.
+  void *memory = page_allocator.Allocate(length);
+  if (!memory) {
+    errno = ENOMEM;
+    return MAP_FAILED;
+  }
+  if (is_file) {
+    int result = ReadFileIntoMapping(static_cast<uint8_t *>(memory), length,
+                                     fd, offset);
+    if (result != 0) {
+      page_allocator.Free(memory, length);
+      errno = result;
+      return MAP_FAILED;
+    }
+  }
+  return memory;
 }
 
-int munmap(void *addr, size_t length) { abort(); }
+int munmap(void *addr, size_t length) {
+  int result = page_allocator.Free(addr, length);
+  if (result != 0) {
+    errno = result;
+    return -1;
+  }
+  return 0;
+}
 
 }  // extern "C"
@@ -0,0 +1,118 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include "asylo/test/util/test_flags.h"
+
+namespace asylo {
+namespace {
+
+constexpr size_t kPageSize = 4096;
+
+TEST(EnclaveMmanTest, AnonymousMappingIsZeroedAndWritable) {
+  constexpr size_t kLength = 16 * kPageSize + 1;
+  uint8_t *memory = static_cast<uint8_t *>(mmap(
+      nullptr, kLength, PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE,
+      -1, 0));
+  ASSERT_NE(memory, MAP_FAILED);
+  EXPECT_EQ(reinterpret_cast<uintptr_t>(memory) % kPageSize, 0);
+  for (size_t i = 0; i < kLength; ++i) {
+    ASSERT_EQ(memory[i], 0);
+  }
+  memset(memory, 0x5a, kLength);
+  EXPECT_EQ(munmap(memory, kLength), 0);
+}
+
+TEST(EnclaveMmanTest, UnmappedPagesAreReused) {
+  void *first = mmap(nullptr, kPageSize, PROT_READ | PROT_WRITE,
+                     MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+  ASSERT_NE(first, MAP_FAILED);
+  memset(first, 1, kPageSize);
+  ASSERT_EQ(munmap(first, kPageSize), 0);
+
+  uint8_t *second = static_cast<uint8_t *>(mmap(
+      nullptr, kPageSize, PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE,
+      -1, 0));
+  ASSERT_NE(second, MAP_FAILED);
+  EXPECT_EQ(second, first);
+  EXPECT_EQ(second[0], 0);
+  EXPECT_EQ(munmap(second, kPageSize), 0);
+}
+
+TEST(EnclaveMmanTest, PrivateFileMappingHoldsFileContents) {
+  const std::string path = FLAGS_test_tmpdir + "/mman_test";
+  std::string contents(kPageSize + 100, '\0');
+  for (size_t i = 0; i < contents.size(); ++i) {
+    contents[i] = static_cast<char>(i % 251);
+  }
+  int fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+  ASSERT_GE(fd, 0);
+  ASSERT_EQ(write(fd, contents.data(), contents.size()), contents.size());
+
+  // The whole file, with the rest of its last page zeroed.
+  constexpr size_t kLength = 2 * kPageSize;
+  uint8_t *memory = static_cast<uint8_t *>(
+      mmap(nullptr, kLength, PROT_READ, MAP_PRIVATE, fd, 0));
+  ASSERT_NE(memory, MAP_FAILED);
+  EXPECT_EQ(memcmp(memory, contents.data(), contents.size()), 0);
+  for (size_t i = contents.size(); i < kLength; ++i) {
+    ASSERT_EQ(memory[i], 0);
+  }
+  EXPECT_EQ(munmap(memory, kLength), 0);
+
+  // A mapping from a page offset, which leaves the file position alone.
+  memory = static_cast<uint8_t *>(
+      mmap(nullptr, 100, PROT_READ, MAP_PRIVATE, fd, kPageSize));
+  ASSERT_NE(memory, MAP_FAILED);
+  EXPECT_EQ(memcmp(memory, contents.data() + kPageSize, 100), 0);
+  EXPECT_EQ(lseek(fd, 0, SEEK_CUR), contents.size());
+  EXPECT_EQ(munmap(memory, 100), 0);
+
+  EXPECT_EQ(mmap(nullptr, kPageSize, PROT_READ, MAP_SHARED, fd, 0),
+            MAP_FAILED);
+  EXPECT_EQ(errno, ENOTSUP);
+  EXPECT_EQ(mmap(nullptr, kPageSize, PROT_READ, MAP_PRIVATE, fd, 100),
+            MAP_FAILED);
+  EXPECT_EQ(errno, EINVAL);
+  EXPECT_EQ(close(fd), 0);
+}
+
+TEST(EnclaveMmanTest, RejectsUnsupportedMappings) {
+  EXPECT_EQ(mmap(nullptr, kPageSize, PROT_READ, MAP_PRIVATE, -1, 0),
+            MAP_FAILED);
+  EXPECT_EQ(errno, EBADF);
+  EXPECT_EQ(mmap(nullptr, 0, PROT_READ, MAP_ANONYMOUS | MAP_PRIVATE, -1, 0),
+            MAP_FAILED);
+  EXPECT_EQ(errno, EINVAL);
+
+  int local;
+  EXPECT_EQ(munmap(&local, kPageSize), -1);
+  EXPECT_EQ(errno, EINVAL);
+}
+
+}  // namespace
+}  // namespace asylo
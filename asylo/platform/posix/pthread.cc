@@ -18,31 +18,29 @@
 
 #include <pthread.h>
 
+#include <sched.h>
+#include <semaphore.h>
 #include <signal.h>
 #include <sys/reent.h>
+#include <time.h>
+#include <atomic>
 #include <cerrno>
 #include <cstdio>
 #include <cstdlib>
 #include <functional>
-#include <unordered_map>
 
 #include "asylo/platform/arch/include/trusted/enclave_interface.h"
 #include "asylo/platform/arch/include/trusted/host_calls.h"
+#include "asylo/platform/arch/include/trusted/time.h"
+#include "asylo/platform/common/mcs_lock.h"
+#include "asylo/platform/common/spin_lock.h"
+#include "asylo/platform/common/time_util.h"
 #include "asylo/platform/core/trusted_global_state.h"
 #include "asylo/platform/posix/threading/thread_manager.h"
+#include "asylo/platform/posix/threading/thread_specific.h"
 
 namespace {
 
-static inline int InterlockedExchange(pthread_spinlock_t *dest,
-                                      pthread_spinlock_t old_value,
-                                      pthread_spinlock_t new_value);
-
-static inline int InterlockedExchange(pthread_spinlock_t *dest,
-                                      pthread_spinlock_t old_value,
-                                      pthread_spinlock_t new_value) {
-  return __sync_val_compare_and_swap(dest, old_value, new_value);
-}
-
 // Confirms that |parameter| is not nullptr and is within the enclave.
 template <typename T>
 static int check_parameter(T *parameter) {
@@ -52,23 +50,15 @@ static int check_parameter(T *parameter) {
   return 0;
 }
 
-static thread_local std::unordered_map<uint64_t, void *> *tls_map = nullptr;
-
-static void init_tls_map() {
-  tls_map = new std::unordered_map<uint64_t, void *>();
-}
-
+// Spin locks guard the wait queues which sleeping threads are woken from, so
+// they never sleep themselves and are acquired without a SpinLockWaitHook.
 inline int pthread_spin_lock(pthread_spinlock_t *lock) {
-  while (InterlockedExchange(lock, 0, 1) != 0) {
-    while (*lock) {
-      enc_pause();
-    }
-  }
+  SpinLockAcquire(lock);
   return 0;
 }
 
 inline int pthread_spin_unlock(pthread_spinlock_t *lock) {
-  *lock = 0;
+  SpinLockRelease(lock);
   return 0;
 }
 
@@ -86,6 +76,56 @@ class SpinLock {
   pthread_spinlock_t *lock_;
 };
 
+// Number of times a blocked thread polls for the condition it is waiting for
+// before it sleeps on the host. Spinning briefly avoids an enclave exit for
+// short waits, while sleeping keeps idle waiters from occupying a core.
+constexpr int kSpinsBeforeSleep = 1000;
+
+// Blocks until |done()| returns true, first spinning and then sleeping on the
+// host. A thread which makes |done()| true for the caller must then wake the
+// caller with enc_untrusted_thread_wake.
+template <typename Predicate>
+void WaitUntil(Predicate done) {
+  for (int i = 0; i < kSpinsBeforeSleep; ++i) {
+    if (done()) {
+      return;
+    }
+    enc_pause();
+  }
+  while (!done()) {
+    enc_untrusted_thread_wait();
+  }
+}
+
+// Blocks until |done()| returns true or the realtime clock reaches |deadline|,
+// in nanoseconds, and returns whether |done()| returned true. Once the time
+// left is within the nanosleep exit threshold, the caller polls the enclave
+// clock rather than paying for a host sleep which would overshoot the
+// deadline; until then it sleeps on the host for at most the time left.
+template <typename Predicate>
+bool WaitUntilDeadline(Predicate done, int64_t deadline) {
+  for (int i = 0; i < kSpinsBeforeSleep; ++i) {
+    if (done()) {
+      return true;
+    }
+    enc_pause();
+  }
+  while (!done()) {
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    int64_t remaining = deadline - asylo::TimeSpecToNanoseconds(&now);
+    if (remaining <= 0) {
+      return false;
+    }
+    if (remaining <= enc_nanosleep_exit_threshold()) {
+      enc_pause();
+    } else {
+      enc_untrusted_thread_wait_timeout(remaining);
+    }
+  }
+  return true;
+}
+
 // Returns the first pthread_t in the |list|.
 pthread_t pthread_list_first(const __pthread_list_t &list) {
   if (!list._first) {
@@ -187,6 +227,21 @@ void pthread_list_remove_first(__pthread_list_t *list) {
   free_list_node(old_first);
 }
 
+// Removes |thread_id| from the |list|. Returns false if it was not there.
+bool pthread_list_remove(__pthread_list_t *list, pthread_t thread_id) {
+  __pthread_list_node_t **link = &list->_first;
+  while (*link) {
+    __pthread_list_node_t *current = *link;
+    if (current->_thread_id == thread_id) {
+      *link = current->_next;
+      free_list_node(current);
+      return true;
+    }
+    link = &current->_next;
+  }
+  return false;
+}
+
 // Returns whether the given |list| contains |thread_id|.
 bool pthread_list_contains(const __pthread_list_t &list, pthread_t thread_id) {
   __pthread_list_node_t *current = list._first;
@@ -237,6 +292,121 @@ int pthread_mutex_lock_internal(pthread_mutex_t *mutex) {
   return EBUSY;
 }
 
+// Returns true if |mutex| looks like it could be taken by |self|. Reads the
+// mutex without holding its lock, so that spinning threads share its cache
+// line instead of bouncing it between cores; the answer is only a hint.
+bool pthread_mutex_available(pthread_mutex_t *mutex, pthread_t self) {
+  if (__atomic_load_n(&mutex->_owner, __ATOMIC_RELAXED) != PTHREAD_T_NULL) {
+    return false;
+  }
+  __pthread_list_node_t *first =
+      __atomic_load_n(&mutex->_queue._first, __ATOMIC_RELAXED);
+  return !first || first->_thread_id == self;
+}
+
+// Adds |self| to |queue|, releases |lock|, which guards |queue| and must be
+// held, and blocks until a waker removes |self| from |queue|.
+void pthread_list_wait(pthread_spinlock_t *lock, __pthread_list_t *queue,
+                       pthread_t self) {
+  if (!pthread_list_contains(*queue, self)) {
+    pthread_list_insert_last(queue, self);
+  }
+  pthread_spin_unlock(lock);
+  WaitUntil([lock, queue, self] {
+    SpinLock spin_lock(lock);
+    return !pthread_list_contains(*queue, self);
+  });
+}
+
+// Wakes and removes every thread in |waiters|, which must have been detached
+// from any shared queue.
+void pthread_list_wake_all(__pthread_list_t *waiters) {
+  while (pthread_list_first(*waiters) != PTHREAD_T_NULL) {
+    pthread_t waiter = pthread_list_first(*waiters);
+    pthread_list_remove_first(waiters);
+    enc_untrusted_thread_wake(waiter);
+  }
+}
+
+// Fields of pthread_rwlock_t::_state. Readers and writers take the lock with
+// a single compare-and-swap of the state when it is free for them, and only
+// take the spinlock guarding the queues of waiters to sleep or to wake others.
+// While a writer waits, new readers are held back so writers do not starve.
+constexpr uint32_t kRwlockReaderMask = 0xffff;
+constexpr uint32_t kRwlockWriterWaiting = 1u << 16;
+constexpr uint32_t kRwlockWriterWaitingMask = 0x7fffu << 16;
+constexpr uint32_t kRwlockWriterHeld = 1u << 31;
+
+// Takes a read lock on |rwlock| and returns 0 if no writer holds or waits for
+// it. Returns EBUSY otherwise, or EAGAIN if there are too many readers.
+int pthread_rwlock_tryrdlock_internal(pthread_rwlock_t *rwlock) {
+  uint32_t state = __atomic_load_n(&rwlock->_state, __ATOMIC_RELAXED);
+  while (true) {
+    if (state & (kRwlockWriterHeld | kRwlockWriterWaitingMask)) {
+      return EBUSY;
+    }
+    if ((state & kRwlockReaderMask) == kRwlockReaderMask) {
+      return EAGAIN;
+    }
+    if (__atomic_compare_exchange_n(&rwlock->_state, &state, state + 1,
+                                    /*weak=*/true, __ATOMIC_SEQ_CST,
+                                    __ATOMIC_RELAXED)) {
+      return 0;
+    }
+  }
+}
+
+// Takes a write lock on |rwlock| and returns 0 if it is not held. Returns EBUSY
+// otherwise.
+int pthread_rwlock_trywrlock_internal(pthread_rwlock_t *rwlock) {
+  uint32_t state = __atomic_load_n(&rwlock->_state, __ATOMIC_RELAXED);
+  while (true) {
+    if (state & (kRwlockWriterHeld | kRwlockReaderMask)) {
+      return EBUSY;
+    }
+    if (__atomic_compare_exchange_n(&rwlock->_state, &state,
+                                    state | kRwlockWriterHeld,
+                                    /*weak=*/true, __ATOMIC_SEQ_CST,
+                                    __ATOMIC_RELAXED)) {
+      rwlock->_writer = pthread_self();
+      return 0;
+    }
+  }
+}
+
+// Wakes the first queued writer of |rwlock| if there is one, and otherwise all
+// queued readers. Woken threads retry taking the lock.
+void pthread_rwlock_wake_waiters(pthread_rwlock_t *rwlock) {
+  __pthread_list_t readers = PTHREAD_LIST_INITIALIZER;
+  pthread_spin_lock(&rwlock->_lock);
+  pthread_t writer = pthread_list_first(rwlock->_writer_queue);
+  if (writer != PTHREAD_T_NULL) {
+    pthread_list_remove_first(&rwlock->_writer_queue);
+  } else {
+    readers = rwlock->_reader_queue;
+    rwlock->_reader_queue._first = nullptr;
+  }
+  pthread_spin_unlock(&rwlock->_lock);
+
+  if (writer != PTHREAD_T_NULL) {
+    enc_untrusted_thread_wake(writer);
+  }
+  pthread_list_wake_all(&readers);
+}
+
+// Decrements |sem| and returns true if its value is non-zero.
+bool sem_trywait_internal(sem_t *sem) {
+  uint32_t count = __atomic_load_n(&sem->_count, __ATOMIC_RELAXED);
+  while (count > 0) {
+    if (__atomic_compare_exchange_n(&sem->_count, &count, count - 1,
+                                    /*weak=*/true, __ATOMIC_SEQ_CST,
+                                    __ATOMIC_RELAXED)) {
+      return true;
+    }
+  }
+  return false;
+}
+
 }  //  namespace
 
 using asylo::ThreadManager;
@@ -250,9 +420,10 @@ pthread_t pthread_self() { return enc_thread_self(); }
 int pthread_create(pthread_t *thread, const pthread_attr_t *attr,
                    void *(*start_routine)(void *), void *arg) {
   std::function<void *(void *)> start_function(start_routine);
+  bool detached = attr && attr->detach_state == PTHREAD_CREATE_DETACHED;
 
   ThreadManager *thread_manager = ThreadManager::GetInstance();
-  return thread_manager->CreateThread(start_function, arg, thread);
+  return thread_manager->CreateThread(start_function, arg, detached, thread);
 }
 
 int pthread_join(pthread_t thread, void **value_ptr) {
@@ -260,46 +431,27 @@ int pthread_join(pthread_t thread, void **value_ptr) {
   return thread_manager->JoinThread(thread, value_ptr);
 }
 
-int pthread_key_create(pthread_key_t *key, void (*destructor)(void *)) {
-  static pthread_key_t next_key = 0;
-  static pthread_mutex_t next_key_lock = PTHREAD_MUTEX_INITIALIZER;
+int pthread_detach(pthread_t thread) {
+  ThreadManager *thread_manager = ThreadManager::GetInstance();
+  return thread_manager->DetachThread(thread);
+}
 
-  if (pthread_mutex_lock(&next_key_lock) != 0) {
-    abort();
-  }
-  *key = next_key++;
-  if (pthread_mutex_unlock(&next_key_lock) != 0) {
-    abort();
-  }
-  return 0;
+int pthread_key_create(pthread_key_t *key, void (*destructor)(void *)) {
+  return asylo::ThreadSpecificKeyCreate(key, destructor);
 }
 
 int pthread_key_delete(pthread_key_t key) {
-  return 0;
+  return asylo::ThreadSpecificKeyDelete(key);
 }
 
 void *pthread_getspecific(pthread_key_t key) {
-  if (!tls_map) {
-    init_tls_map();
-  }
-
-  std::unordered_map<uint64_t, void *>::const_iterator specific =
-      tls_map->find(key);
-  if (specific == tls_map->end()) {
-    return nullptr;
-  }
-
-  return specific->second;
+  return asylo::GetThreadSpecific(key);
 }
 
 int pthread_setspecific(pthread_key_t key, const void *value) {
-  if (!tls_map) {
-    init_tls_map();
-  }
-
-  tls_map->emplace(key, const_cast<void *>(value));
-  return 0;
+  return asylo::SetThreadSpecific(key, value);
 }
+
 // Initializes |mutex|, |attr| is unused.
 int pthread_mutex_init(pthread_mutex_t *mutex,
                        const pthread_mutexattr_t *attr) {
@@ -335,16 +487,38 @@ int pthread_mutex_lock(pthread_mutex_t *mutex) {
     return ret;
   }
 
-  while (true) {
-    {
+  // Spin on the mutex for a while before joining its queue of waiters and
+  // sleeping on the host until the queue hands the mutex over.
+  pthread_t self = pthread_self();
+  for (int i = 0; i < kSpinsBeforeSleep; ++i) {
+    if (pthread_mutex_available(mutex, self)) {
       SpinLock lock(&mutex->_lock);
       ret = pthread_mutex_lock_internal(mutex);
+      if (ret == 0) {
+        return ret;
+      }
     }
+    enc_pause();
+  }
+
+  {
+    SpinLock lock(&mutex->_lock);
+    ret = pthread_mutex_lock_internal(mutex);
     if (ret == 0) {
       return ret;
     }
+    if (!pthread_list_contains(mutex->_queue, self)) {
+      pthread_list_insert_last(&mutex->_queue, self);
+    }
+  }
 
-    enc_pause();
+  while (true) {
+    enc_untrusted_thread_wait();
+    SpinLock lock(&mutex->_lock);
+    ret = pthread_mutex_lock_internal(mutex);
+    if (ret == 0) {
+      return ret;
+    }
   }
 }
 
@@ -369,22 +543,29 @@ int pthread_mutex_unlock(pthread_mutex_t *mutex) {
   }
 
   pthread_t self = pthread_self();
+  pthread_t next_owner = PTHREAD_T_NULL;
+  {
+    SpinLock lock(&mutex->_lock);
 
-  SpinLock lock(&mutex->_lock);
+    if (mutex->_owner == PTHREAD_T_NULL) {
+      return EINVAL;
+    }
 
-  if (mutex->_owner == PTHREAD_T_NULL) {
-    return EINVAL;
-  }
+    if (mutex->_owner != self) {
+      return EPERM;
+    }
 
-  if (mutex->_owner != self) {
-    return EPERM;
+    --mutex->_refcount;
+    if (mutex->_refcount == 0) {
+      mutex->_owner = PTHREAD_T_NULL;
+      next_owner = pthread_list_first(mutex->_queue);
+    }
   }
 
-  --mutex->_refcount;
-  if (mutex->_refcount == 0) {
-    mutex->_owner = PTHREAD_T_NULL;
+  // The first queued waiter is the only thread that may take the mutex next.
+  if (next_owner != PTHREAD_T_NULL) {
+    enc_untrusted_thread_wake(next_owner);
   }
-
   return 0;
 }
 
@@ -458,23 +639,69 @@ int pthread_cond_wait(pthread_cond_t *cond, pthread_mutex_t *mutex) {
     return ret;
   }
 
-  while (true) {
-    pthread_spin_unlock(&cond->_lock);
-    enc_pause();
-    pthread_spin_lock(&cond->_lock);
+  pthread_spin_unlock(&cond->_lock);
 
-    if (!pthread_list_contains(cond->_queue, self)) {
-      break;
-    }
-  }
+  WaitUntil([cond, self] {
+    SpinLock lock(&cond->_lock);
+    return !pthread_list_contains(cond->_queue, self);
+  });
 
-  pthread_spin_unlock(&cond->_lock);
   return pthread_mutex_lock(mutex);
 }
 
+// Like pthread_cond_wait, but gives up at the CLOCK_REALTIME time |abstime|.
+// A waiter which times out removes itself from the queue; if a signal removed
+// it first, the signal is consumed and the wait succeeds.
 int pthread_cond_timedwait(pthread_cond_t *cond, pthread_mutex_t *mutex,
                            const struct timespec *abstime) {
-  return 0;
+  int ret = check_parameter<pthread_cond_t>(cond);
+  if (ret != 0) {
+    return ret;
+  }
+
+  ret = check_parameter<pthread_mutex_t>(mutex);
+  if (ret != 0) {
+    return ret;
+  }
+
+  if (!abstime || abstime->tv_nsec < 0 || abstime->tv_nsec >= 1000000000 ||
+      !asylo::IsRepresentableAsNanoseconds(abstime)) {
+    return EINVAL;
+  }
+  int64_t deadline = asylo::TimeSpecToNanoseconds(abstime);
+
+  pthread_t self = pthread_self();
+
+  pthread_spin_lock(&cond->_lock);
+  if (!pthread_list_contains(cond->_queue, self)) {
+    pthread_list_insert_last(&cond->_queue, self);
+  }
+
+  ret = pthread_mutex_unlock(mutex);
+  if (ret != 0) {
+    pthread_list_remove(&cond->_queue, self);
+    pthread_spin_unlock(&cond->_lock);
+    return ret;
+  }
+
+  pthread_spin_unlock(&cond->_lock);
+
+  bool signaled = WaitUntilDeadline(
+      [cond, self] {
+        SpinLock lock(&cond->_lock);
+        return !pthread_list_contains(cond->_queue, self);
+      },
+      deadline);
+  if (!signaled) {
+    SpinLock lock(&cond->_lock);
+    signaled = !pthread_list_remove(&cond->_queue, self);
+  }
+
+  ret = pthread_mutex_lock(mutex);
+  if (ret != 0) {
+    return ret;
+  }
+  return signaled ? 0 : ETIMEDOUT;
 }
 
 int pthread_condattr_init(pthread_condattr_t *attr) { return 0; }
@@ -499,7 +726,7 @@ int pthread_cond_signal(pthread_cond_t *cond) {
 
   pthread_spin_unlock(&cond->_lock);
 
-
+  enc_untrusted_thread_wake(first);
   return 0;
 }
 
@@ -510,13 +737,277 @@ int pthread_cond_broadcast(pthread_cond_t *cond) {
     return ret;
   }
 
+  // Detach the whole queue so that waiters can be woken after releasing the
+  // lock.
   pthread_spin_lock(&cond->_lock);
+  __pthread_list_t waiters = cond->_queue;
+  cond->_queue._first = nullptr;
+  pthread_spin_unlock(&cond->_lock);
 
-  while (pthread_list_first(cond->_queue) != PTHREAD_T_NULL) {
-    pthread_list_remove_first(&cond->_queue);
+  pthread_list_wake_all(&waiters);
+  return 0;
+}
+
+// Initializes |rwlock|, |attr| is unused.
+int pthread_rwlock_init(pthread_rwlock_t *rwlock,
+                        const pthread_rwlockattr_t *attr) {
+  int ret = check_parameter<pthread_rwlock_t>(rwlock);
+  if (ret != 0) {
+    return ret;
   }
 
-  pthread_spin_unlock(&cond->_lock);
+  *rwlock = PTHREAD_RWLOCK_INITIALIZER;
+  return 0;
+}
+
+// Destroys |rwlock|, returns error if it is held or threads are waiting on it.
+int pthread_rwlock_destroy(pthread_rwlock_t *rwlock) {
+  int ret = check_parameter<pthread_rwlock_t>(rwlock);
+  if (ret != 0) {
+    return ret;
+  }
+
+  SpinLock spin_lock(&rwlock->_lock);
+  if (__atomic_load_n(&rwlock->_state, __ATOMIC_RELAXED) != 0 ||
+      pthread_list_first(rwlock->_reader_queue) != PTHREAD_T_NULL ||
+      pthread_list_first(rwlock->_writer_queue) != PTHREAD_T_NULL) {
+    return EBUSY;
+  }
+  return 0;
+}
+
+// Takes a read lock on |rwlock|. Readers wait while a writer holds or waits for
+// the lock, so a thread which takes a read lock it already holds may deadlock
+// with a waiting writer.
+int pthread_rwlock_rdlock(pthread_rwlock_t *rwlock) {
+  int ret = check_parameter<pthread_rwlock_t>(rwlock);
+  if (ret != 0) {
+    return ret;
+  }
+
+  for (int i = 0; i < kSpinsBeforeSleep; ++i) {
+    ret = pthread_rwlock_tryrdlock_internal(rwlock);
+    if (ret != EBUSY) {
+      return ret;
+    }
+    enc_pause();
+  }
+
+  pthread_t self = pthread_self();
+  while (true) {
+    pthread_spin_lock(&rwlock->_lock);
+    ret = pthread_rwlock_tryrdlock_internal(rwlock);
+    if (ret != EBUSY) {
+      pthread_spin_unlock(&rwlock->_lock);
+      return ret;
+    }
+    pthread_list_wait(&rwlock->_lock, &rwlock->_reader_queue, self);
+  }
+}
+
+int pthread_rwlock_tryrdlock(pthread_rwlock_t *rwlock) {
+  int ret = check_parameter<pthread_rwlock_t>(rwlock);
+  if (ret != 0) {
+    return ret;
+  }
+
+  return pthread_rwlock_tryrdlock_internal(rwlock);
+}
+
+// Takes a write lock on |rwlock|.
+int pthread_rwlock_wrlock(pthread_rwlock_t *rwlock) {
+  int ret = check_parameter<pthread_rwlock_t>(rwlock);
+  if (ret != 0) {
+    return ret;
+  }
+
+  pthread_t self = pthread_self();
+  if (__atomic_load_n(&rwlock->_writer, __ATOMIC_RELAXED) == self) {
+    return EDEADLK;
+  }
+
+  for (int i = 0; i < kSpinsBeforeSleep; ++i) {
+    if (pthread_rwlock_trywrlock_internal(rwlock) == 0) {
+      return 0;
+    }
+    enc_pause();
+  }
+
+  // Announce the waiting writer, which holds back new readers, before checking
+  // the lock under the spinlock so that the last reader out wakes it.
+  __atomic_add_fetch(&rwlock->_state, kRwlockWriterWaiting, __ATOMIC_SEQ_CST);
+  while (true) {
+    pthread_spin_lock(&rwlock->_lock);
+    if (pthread_rwlock_trywrlock_internal(rwlock) == 0) {
+      __atomic_sub_fetch(&rwlock->_state, kRwlockWriterWaiting,
+                         __ATOMIC_SEQ_CST);
+      pthread_spin_unlock(&rwlock->_lock);
+      return 0;
+    }
+    pthread_list_wait(&rwlock->_lock, &rwlock->_writer_queue, self);
+  }
+}
+
+int pthread_rwlock_trywrlock(pthread_rwlock_t *rwlock) {
+  int ret = check_parameter<pthread_rwlock_t>(rwlock);
+  if (ret != 0) {
+    return ret;
+  }
+
+  return pthread_rwlock_trywrlock_internal(rwlock);
+}
+
+// Releases the read or write lock held on |rwlock| by the calling thread.
+int pthread_rwlock_unlock(pthread_rwlock_t *rwlock) {
+  int ret = check_parameter<pthread_rwlock_t>(rwlock);
+  if (ret != 0) {
+    return ret;
+  }
+
+  uint32_t state = __atomic_load_n(&rwlock->_state, __ATOMIC_RELAXED);
+  if (state & kRwlockWriterHeld) {
+    if (rwlock->_writer != pthread_self()) {
+      return EPERM;
+    }
+    rwlock->_writer = PTHREAD_T_NULL;
+    __atomic_fetch_and(&rwlock->_state, ~kRwlockWriterHeld, __ATOMIC_SEQ_CST);
+    pthread_rwlock_wake_waiters(rwlock);
+    return 0;
+  }
+
+  if ((state & kRwlockReaderMask) == 0) {
+    return EPERM;
+  }
+  uint32_t previous =
+      __atomic_fetch_sub(&rwlock->_state, 1, __ATOMIC_SEQ_CST);
+  // The last reader out hands the lock to a waiting writer.
+  if ((previous & kRwlockReaderMask) == 1 &&
+      (previous & kRwlockWriterWaitingMask)) {
+    pthread_rwlock_wake_waiters(rwlock);
+  }
+  return 0;
+}
+
+int pthread_rwlockattr_init(pthread_rwlockattr_t *attr) { return 0; }
+
+int pthread_rwlockattr_destroy(pthread_rwlockattr_t *attr) { return 0; }
+
+// Functions available via <semaphore.h>
+
+int sem_init(sem_t *sem, int pshared, unsigned int value) {
+  if (check_parameter<sem_t>(sem) != 0 ||
+      value > static_cast<unsigned int>(SEM_VALUE_MAX)) {
+    errno = EINVAL;
+    return -1;
+  }
+  if (pshared) {
+    errno = ENOSYS;
+    return -1;
+  }
+
+  sem->_count = value;
+  sem->_waiters = 0;
+  sem->_lock = PTHREAD_SPINLOCK_INITIALIZER;
+  sem->_queue._first = nullptr;
+  return 0;
+}
+
+int sem_destroy(sem_t *sem) {
+  if (check_parameter<sem_t>(sem) != 0) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  SpinLock spin_lock(&sem->_lock);
+  if (pthread_list_first(sem->_queue) != PTHREAD_T_NULL) {
+    errno = EBUSY;
+    return -1;
+  }
+  return 0;
+}
+
+int sem_wait(sem_t *sem) {
+  if (check_parameter<sem_t>(sem) != 0) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  for (int i = 0; i < kSpinsBeforeSleep; ++i) {
+    if (sem_trywait_internal(sem)) {
+      return 0;
+    }
+    enc_pause();
+  }
+
+  // Announce the waiter before checking the value under the spinlock, so that
+  // a concurrent sem_post() either is seen here or sees the waiter.
+  __atomic_add_fetch(&sem->_waiters, 1, __ATOMIC_SEQ_CST);
+  pthread_t self = pthread_self();
+  while (true) {
+    pthread_spin_lock(&sem->_lock);
+    if (sem_trywait_internal(sem)) {
+      pthread_spin_unlock(&sem->_lock);
+      __atomic_sub_fetch(&sem->_waiters, 1, __ATOMIC_SEQ_CST);
+      return 0;
+    }
+    pthread_list_wait(&sem->_lock, &sem->_queue, self);
+  }
+}
+
+int sem_trywait(sem_t *sem) {
+  if (check_parameter<sem_t>(sem) != 0) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  if (!sem_trywait_internal(sem)) {
+    errno = EAGAIN;
+    return -1;
+  }
+  return 0;
+}
+
+int sem_post(sem_t *sem) {
+  if (check_parameter<sem_t>(sem) != 0) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  uint32_t count = __atomic_load_n(&sem->_count, __ATOMIC_RELAXED);
+  do {
+    if (count >= static_cast<uint32_t>(SEM_VALUE_MAX)) {
+      errno = EOVERFLOW;
+      return -1;
+    }
+  } while (!__atomic_compare_exchange_n(&sem->_count, &count, count + 1,
+                                        /*weak=*/true, __ATOMIC_SEQ_CST,
+                                        __ATOMIC_RELAXED));
+
+  // Posting without waiters stays within the enclave and off the spinlock.
+  if (__atomic_load_n(&sem->_waiters, __ATOMIC_SEQ_CST) == 0) {
+    return 0;
+  }
+
+  pthread_spin_lock(&sem->_lock);
+  pthread_t first = pthread_list_first(sem->_queue);
+  if (first != PTHREAD_T_NULL) {
+    pthread_list_remove_first(&sem->_queue);
+  }
+  pthread_spin_unlock(&sem->_lock);
+
+  if (first != PTHREAD_T_NULL) {
+    enc_untrusted_thread_wake(first);
+  }
+  return 0;
+}
+
+int sem_getvalue(sem_t *sem, int *value) {
+  if (check_parameter<sem_t>(sem) != 0 || !value) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  *value = static_cast<int>(__atomic_load_n(&sem->_count, __ATOMIC_RELAXED));
   return 0;
 }
 
@@ -533,22 +1024,74 @@ int pthread_mutexattr_settype(pthread_mutexattr_t *mutexattr, int type) {
   return 0;
 }
 
-int pthread_attr_init(pthread_attr_t *attr) { return 0; }
+int pthread_attr_init(pthread_attr_t *attr) {
+  attr->detach_state = PTHREAD_CREATE_JOINABLE;
+  return 0;
+}
+
 int pthread_attr_destroy(pthread_attr_t *attr) { return 0; }
-int pthread_attr_setdetachstate(pthread_attr_t *attr, int type) { return 0; }
+
+int pthread_attr_setdetachstate(pthread_attr_t *attr, int type) {
+  if (type != PTHREAD_CREATE_JOINABLE && type != PTHREAD_CREATE_DETACHED) {
+    return EINVAL;
+  }
+  attr->detach_state = type;
+  return 0;
+}
+
+int pthread_attr_getdetachstate(const pthread_attr_t *attr, int *type) {
+  *type = attr->detach_state;
+  return 0;
+}
 
 int pthread_cancel(pthread_t unused) { return ENOSYS; }
 
-// Following functions are required to keep Newlib's malloc thread safe.
-static pthread_mutex_t malloc_mutex = PTHREAD_MUTEX_RECURSIVE_INITIALIZER;
+// Only the affinity of the calling thread is supported, since the enclave does
+// not know the host threads running its other threads. The affinity is read
+// from the host rather than from the process affinity sched_getaffinity()
+// caches.
+int pthread_setaffinity_np(pthread_t thread, size_t cpusetsize,
+                           const cpu_set_t *cpuset) {
+  if (thread != pthread_self()) {
+    return ENOSYS;
+  }
+  return enc_untrusted_sched_setaffinity(0, cpusetsize, cpuset) == 0 ? 0
+                                                                     : errno;
+}
+
+int pthread_getaffinity_np(pthread_t thread, size_t cpusetsize,
+                           cpu_set_t *cpuset) {
+  if (thread != pthread_self()) {
+    return ENOSYS;
+  }
+  return enc_untrusted_sched_getaffinity(0, cpusetsize, cpuset) == 0 ? 0
+                                                                     : errno;
+}
+
+// Following functions are required to keep Newlib's malloc thread safe. The
+// allocator lock is taken on every allocation, so it is a queue lock on which
+// each waiter spins in its own cache line. Newlib may re-enter the allocator
+// while holding the lock, so it is recursive.
+static asylo::McsLock malloc_lock;
+static std::atomic<pthread_t> malloc_lock_owner(PTHREAD_T_NULL);
+static int malloc_lock_depth = 0;
+static thread_local asylo::McsLock::Node malloc_lock_node;
 
 void __malloc_lock(struct reent *) {
   // If pthread_self() == nullptr Enclave is in initialization state and single
   // threaded.
-  if (!pthread_self()) {
+  pthread_t self = pthread_self();
+  if (!self) {
+    return;
+  }
+  // Only the calling thread can have stored its own id as the owner.
+  if (malloc_lock_owner.load(std::memory_order_relaxed) == self) {
+    ++malloc_lock_depth;
     return;
   }
-  pthread_mutex_lock(&malloc_mutex);
+  malloc_lock.Acquire(&malloc_lock_node);
+  malloc_lock_owner.store(self, std::memory_order_relaxed);
+  malloc_lock_depth = 1;
 }
 
 void __malloc_unlock(struct reent *) {
@@ -557,7 +1100,10 @@ void __malloc_unlock(struct reent *) {
   if (!pthread_self()) {
     return;
   }
-  pthread_mutex_unlock(&malloc_mutex);
+  if (--malloc_lock_depth == 0) {
+    malloc_lock_owner.store(PTHREAD_T_NULL, std::memory_order_relaxed);
+    malloc_lock.Release(&malloc_lock_node);
+  }
 }
 
 }  // extern "C"
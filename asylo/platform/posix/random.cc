@@ -0,0 +1,35 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <errno.h>
+#include <stdint.h>
+#include <sys/random.h>
+
+#include "asylo/platform/arch/include/trusted/hardware_random.h"
+
+extern "C" {
+
+ssize_t getrandom(void *buf, size_t buflen, unsigned int flags) {
+  if (flags & ~(GRND_NONBLOCK | GRND_RANDOM)) {
+    errno = EINVAL;
+    return -1;
+  }
+  return enc_hardware_random(static_cast<uint8_t *>(buf), buflen);
+}
+
+}  // extern "C"
@@ -0,0 +1,71 @@
+/*
+ *
+ * Copyright 2017 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/random.h>
+#include <unistd.h>
+#include <cstdint>
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+namespace asylo {
+namespace {
+
+// Sizes that exercise the buffered path, the direct path, and the boundary
+// between them.
+constexpr size_t kSizes[] = {1, 12, 16, 100, 496, 512, 513, 4096, 100000};
+
+TEST(RandomTest, GetRandomFillsBuffer) {
+  for (size_t size : kSizes) {
+    std::vector<uint8_t> first(size, 0);
+    std::vector<uint8_t> second(size, 0);
+    ASSERT_EQ(getrandom(first.data(), size, 0), size);
+    ASSERT_EQ(getrandom(second.data(), size, GRND_NONBLOCK), size);
+    if (size >= 16) {
+      EXPECT_NE(first, second) << size;
+    }
+  }
+}
+
+TEST(RandomTest, GetRandomRejectsUnknownFlags) {
+  uint8_t byte;
+  errno = 0;
+  EXPECT_EQ(getrandom(&byte, sizeof(byte), 0x80), -1);
+  EXPECT_EQ(errno, EINVAL);
+}
+
+TEST(RandomTest, URandomReadsDoNotRepeat) {
+  int fd = open("/dev/urandom", O_RDONLY);
+  ASSERT_GE(fd, 0);
+  std::vector<std::vector<uint8_t>> nonces;
+  for (int i = 0; i < 64; ++i) {
+    std::vector<uint8_t> nonce(12);
+    ASSERT_EQ(read(fd, nonce.data(), nonce.size()), nonce.size());
+    for (const auto &previous : nonces) {
+      EXPECT_NE(previous, nonce);
+    }
+    nonces.push_back(nonce);
+  }
+  EXPECT_EQ(close(fd), 0);
+}
+
+}  // namespace
+}  // namespace asylo
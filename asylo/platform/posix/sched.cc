@@ -18,10 +18,13 @@
 
 #include <sched.h>
 
+#include <errno.h>
 #include <string.h>  // memset
 #include <bitset>
+#include <vector>
 
 #include "asylo/platform/arch/include/trusted/host_calls.h"
+#include "asylo/platform/posix/host_info_cache.h"
 
 inline size_t WordNum(int cpu) { return cpu / (8 * sizeof(CpuSetWord)); }
 
@@ -68,8 +71,46 @@ int CpuSetEqual(CpuSet *set1, CpuSet *set2) {
   return 1;
 }
 
+// The affinity of the calling process is served from HostInfoCache, fetching
+// and caching it on the first call if the cache does not hold it. Other
+// processes are always asked about on the host.
 int sched_getaffinity(pid_t pid, size_t cpusetsize, cpu_set_t *mask) {
-  return enc_untrusted_sched_getaffinity(pid, cpusetsize, mask);
+  if (pid != 0) {
+    return enc_untrusted_sched_getaffinity(pid, cpusetsize, mask);
+  }
+
+  asylo::HostInfoCache &cache = asylo::HostInfoCache::GetInstance();
+  std::vector<int> cpus;
+  if (!cache.GetCpuAffinity(&cpus)) {
+    int ret = enc_untrusted_sched_getaffinity(pid, cpusetsize, mask);
+    if (ret != 0) {
+      return ret;
+    }
+    for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+      if (CPU_ISSET(cpu, mask)) {
+        cpus.push_back(cpu);
+      }
+    }
+    cache.SetCpuAffinity(cpus);
+    return 0;
+  }
+
+  // Match the host call, which rejects masks smaller than cpu_set_t.
+  if (cpusetsize < sizeof(cpu_set_t)) {
+    errno = EINVAL;
+    return -1;
+  }
+  CPU_ZERO(mask);
+  for (int cpu : cpus) {
+    if (cpu >= 0 && cpu < CPU_SETSIZE) {
+      CPU_SET(cpu, mask);
+    }
+  }
+  return 0;
+}
+
+int sched_setaffinity(pid_t pid, size_t cpusetsize, const cpu_set_t *mask) {
+  return enc_untrusted_sched_setaffinity(pid, cpusetsize, mask);
 }
 
 int sched_yield() { return enc_untrusted_sched_yield(); }
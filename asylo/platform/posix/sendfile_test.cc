@@ -0,0 +1,129 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <fcntl.h>
+#include <sys/sendfile.h>
+#include <unistd.h>
+#include <cerrno>
+#include <string>
+
+#include <gtest/gtest.h>
+#include "asylo/test/util/test_flags.h"
+
+namespace asylo {
+namespace {
+
+constexpr char kContents[] = "zero copy transfer";
+constexpr size_t kContentsSize = sizeof(kContents) - 1;
+
+class EnclaveSendFileTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    ASSERT_EQ(pipe(pipe_fds_), 0);
+    path_ = FLAGS_test_tmpdir + "/sendfile_test";
+    int fd = open(path_.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    ASSERT_GE(fd, 0);
+    ASSERT_EQ(write(fd, kContents, kContentsSize), kContentsSize);
+    ASSERT_EQ(close(fd), 0);
+    file_fd_ = open(path_.c_str(), O_RDWR);
+    ASSERT_GE(file_fd_, 0);
+  }
+
+  void TearDown() override {
+    close(file_fd_);
+    close(pipe_fds_[0]);
+    close(pipe_fds_[1]);
+  }
+
+  // Reads |size| bytes from the read end of the pipe.
+  std::string ReadPipe(size_t size) {
+    std::string buf(size, '\0');
+    EXPECT_EQ(read(pipe_fds_[0], &buf[0], size), size);
+    return buf;
+  }
+
+  std::string path_;
+  int file_fd_;
+  int pipe_fds_[2];
+};
+
+// Tests that sendfile with an offset reads from that offset, advances it, and
+// leaves the file position alone.
+TEST_F(EnclaveSendFileTest, SendFileWithOffset) {
+  off_t offset = 5;
+  ASSERT_EQ(sendfile(pipe_fds_[1], file_fd_, &offset, 4), 4);
+  EXPECT_EQ(offset, 9);
+  EXPECT_EQ(ReadPipe(4), "copy");
+  EXPECT_EQ(lseek(file_fd_, 0, SEEK_CUR), 0);
+}
+
+// Tests that sendfile without an offset consumes the file position.
+TEST_F(EnclaveSendFileTest, SendFileWithoutOffset) {
+  ASSERT_EQ(sendfile(pipe_fds_[1], file_fd_, nullptr, kContentsSize),
+            kContentsSize);
+  EXPECT_EQ(ReadPipe(kContentsSize), kContents);
+  EXPECT_EQ(lseek(file_fd_, 0, SEEK_CUR), kContentsSize);
+}
+
+// Tests that splice moves data from a pipe into a file at an offset.
+TEST_F(EnclaveSendFileTest, SpliceFromPipe) {
+  ASSERT_EQ(write(pipe_fds_[1], "ZERO", 4), 4);
+  off_t offset = 0;
+  ASSERT_EQ(splice(pipe_fds_[0], nullptr, file_fd_, &offset, 4, 0), 4);
+  EXPECT_EQ(offset, 4);
+
+  char buf[kContentsSize];
+  ASSERT_EQ(pread(file_fd_, buf, kContentsSize, 0), kContentsSize);
+  EXPECT_EQ(std::string(buf, kContentsSize), "ZERO copy transfer");
+}
+
+// Tests that copy_file_range copies between two files.
+TEST_F(EnclaveSendFileTest, CopyFileRange) {
+  std::string copy_path = path_ + ".copy";
+  int copy_fd = open(copy_path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+  ASSERT_GE(copy_fd, 0);
+
+  off_t off_in = 10;
+  off_t off_out = 0;
+  ASSERT_EQ(copy_file_range(file_fd_, &off_in, copy_fd, &off_out, 8, 0), 8);
+  EXPECT_EQ(off_in, 18);
+  EXPECT_EQ(off_out, 8);
+
+  char buf[8];
+  ASSERT_EQ(pread(copy_fd, buf, sizeof(buf), 0), sizeof(buf));
+  EXPECT_EQ(std::string(buf, sizeof(buf)), "transfer");
+
+  EXPECT_EQ(copy_file_range(file_fd_, &off_in, copy_fd, &off_out, 8, 1), -1);
+  EXPECT_EQ(errno, EINVAL);
+  EXPECT_EQ(close(copy_fd), 0);
+}
+
+// Tests that descriptors not backed by the host are rejected.
+TEST_F(EnclaveSendFileTest, RejectsDescriptorsWithoutHostFile) {
+  int random_fd = open("/dev/urandom", O_RDONLY);
+  ASSERT_GE(random_fd, 0);
+  EXPECT_EQ(sendfile(pipe_fds_[1], random_fd, nullptr, 1), -1);
+  EXPECT_EQ(errno, EINVAL);
+  EXPECT_EQ(close(random_fd), 0);
+
+  EXPECT_EQ(sendfile(-1, file_fd_, nullptr, 1), -1);
+  EXPECT_EQ(errno, EBADF);
+}
+
+}  // namespace
+}  // namespace asylo
@@ -18,18 +18,25 @@
 
 #include <signal.h>
 
+#include <errno.h>
 #include <pthread.h>
+#include <string.h>
 #include <cstdlib>
+#include <string>
 
 #include "absl/synchronization/mutex.h"
-#include "asylo/platform/arch/include/trusted/host_calls.h"
 #include "asylo/platform/arch/include/trusted/register_signal.h"
 #include "asylo/platform/core/trusted_global_state.h"
 #include "asylo/platform/posix/signal/signal_manager.h"
 
 extern "C" {
 
-int pthread_sigmask(int how, const sigset_t *set, sigset_t *oldset) { abort(); }
+int pthread_sigmask(int how, const sigset_t *set, sigset_t *oldset) {
+  if (sigprocmask(how, set, oldset) != 0) {
+    return errno;
+  }
+  return 0;
+}
 
 // Registers a signal handler for |signum|.
 //
@@ -48,6 +55,10 @@ int pthread_sigmask(int how, const sigset_t *set, sigset_t *oldset) { abort(); }
 // the enclave is run in simulation mode and TCS is active (i.e. a thread is
 // running inside the enclave), then this function will call the signal handler
 // registered inside the enclave directly.
+//
+// The host is only called the first time a handler is registered for
+// |signum|. Replacing the handler later only changes the enclave's copy, which
+// also enforces the sa_mask of the new handler.
 int sigaction(int signum, const struct sigaction *act,
               struct sigaction *oldact) {
   if (signum == SIGILL) {
@@ -57,41 +68,40 @@ int sigaction(int signum, const struct sigaction *act,
   // Guards sigaction calls. This is to ensure that signal handlers are not
   // overwritten between the time sigaction gets |oldact| and sets |act|.
   static absl::Mutex sigaction_lock;
+  bool first_registration;
   {
     absl::MutexLock lock(&sigaction_lock);
     asylo::SignalManager *signal_manager = asylo::SignalManager::GetInstance();
     if (oldact) {
-      if (signal_manager->GetSigAction(signum)) {
-        oldact = const_cast<struct sigaction *>(
-            signal_manager->GetSigAction(signum));
+      const struct sigaction *current = signal_manager->GetSigAction(signum);
+      if (current) {
+        *oldact = *current;
       } else {
+        memset(oldact, 0, sizeof(*oldact));
         oldact->sa_handler = SIG_DFL;
       }
     }
-    signal_manager->SetSigAction(signum, *act);
+    if (!act) {
+      return 0;
+    }
+    first_registration = signal_manager->SetSigAction(signum, *act);
   }
-  sigset_t mask;
-  sigemptyset(&mask);
-  if (act) {
-    mask = act->sa_mask;
+  if (!first_registration) {
+    return 0;
   }
   const std::string enclave_name = asylo::GetEnclaveName();
   // Pass a C string because enc_register_signal has C linkage. This string is
   // copied to untrusted memory when going across enclave boundary.
-  return enc_register_signal(signum, mask, enclave_name.c_str());
+  return enc_register_signal(signum, act->sa_mask, enclave_name.c_str());
 }
 
 // Sets the signal mask with |set|.
 //
-// This method sets the signal mask both inside the enclave and on the host.
-// If |how| is SIG_UNBLOCK, the signals to unblock are unblocked inside the
-// enclave first, then on the host.
-// If |how| is SIG_BLOCK, the signals to block are blocked on the host first,
-// then inside the enclave.
-// If |how| is SIG_SETMASK, |set| is separated to signals to block and to
-// unblock. The signals to unblock are processed inside the enclave first, then
-// on the host, and the signals to block are processed on the host first, then
-// inside the enclave.
+// The signal mask is kept inside the enclave only, so this method does not
+// leave the enclave. The host keeps forwarding every signal with a registered
+// handler, and signals arriving while blocked are held by SignalManager until
+// they are unblocked, at which point their handlers run before this method
+// returns.
 // |oldset| is set to the signal mask used inside the enclave prior to this
 // call.
 int sigprocmask(int how, const sigset_t *set, sigset_t *oldset) {
@@ -106,30 +116,17 @@ int sigprocmask(int how, const sigset_t *set, sigset_t *oldset) {
   if (!set) {
     return 0;
   }
-  sigset_t signals_to_block;
-  sigemptyset(&signals_to_block);
-  sigset_t signals_to_unblock;
-  sigemptyset(&signals_to_unblock);
-  if (how == SIG_BLOCK || how == SIG_SETMASK) {
-    signals_to_block = *set;
+  if (how == SIG_BLOCK) {
+    signal_manager->BlockSignals(*set);
+    return 0;
   }
-
   if (how == SIG_UNBLOCK) {
-    signals_to_unblock = *set;
-  } else if (how == SIG_SETMASK) {
-    signals_to_unblock = signal_manager->GetUnblockedSet(*set);
+    signal_manager->UnblockSignals(*set);
+  } else {
+    signal_manager->SetSignalMask(*set);
   }
-
-  // Unblock signals inside the enclave before unblocking signals on the host.
-  signal_manager->UnblockSignals(signals_to_unblock);
-
-  // |oldset| is already filled with the signal mask inside the enclave.
-  int res = enc_untrusted_sigprocmask(how, set, /*oldset=*/nullptr);
-
-  // Block signals inside the enclave after the host.
-  signal_manager->BlockSignals(signals_to_block);
-
-  return res;
+  signal_manager->DeliverPendingSignals();
+  return 0;
 }
 
 // Registers a signal handler for |signum| with |handler|.
@@ -17,6 +17,8 @@
  */
 
 #include <signal.h>
+#include <string.h>
+#include <sys/ucontext.h>
 
 #include "absl/memory/memory.h"
 #include "absl/strings/str_cat.h"
@@ -36,6 +38,8 @@ const sigset_t EmptySigSet() {
 
 }  // namespace
 
+constexpr int SignalManager::kMaxSignals;
+
 thread_local sigset_t SignalManager::signal_mask_ = EmptySigSet();
 
 SignalManager *SignalManager::GetInstance() {
@@ -51,44 +55,86 @@ Status SignalManager::HandleSignal(int signum, siginfo_t *info,
         error::GoogleError::INTERNAL,
         absl::StrCat("No handler has been registered for signal: ", signum));
   }
+  if (sigismember(&signal_mask_, signum)) {
+    {
+      absl::MutexLock lock(&pending_info_lock_);
+      pending_info_[signum] = *info;
+    }
+    pending_.fetch_or(uint64_t{1} << signum);
+    return Status::OkStatus();
+  }
+  return CallHandler(*act, signum, info, ucontext);
+}
+
+Status SignalManager::CallHandler(const struct sigaction &act, int signum,
+                                  siginfo_t *info, void *ucontext) {
   Status status;
   sigset_t old_mask = GetSignalMask();
-  BlockSignals(act->sa_mask);
-  bool is_siginfo = act->sa_flags & SA_SIGINFO;
-  if (is_siginfo && act->sa_sigaction) {
-    act->sa_sigaction(signum, info, ucontext);
-  } else if (!is_siginfo && act->sa_handler) {
-    act->sa_handler(signum);
+  BlockSignals(act.sa_mask);
+  bool is_siginfo = act.sa_flags & SA_SIGINFO;
+  if (is_siginfo && act.sa_sigaction) {
+    act.sa_sigaction(signum, info, ucontext);
+  } else if (!is_siginfo && act.sa_handler) {
+    act.sa_handler(signum);
   } else {
     status = Status(
         error::GoogleError::INTERNAL,
         absl::StrCat("Handler registered for signal: ", signum, " is invalid"));
   }
   SetSignalMask(old_mask);
+  // Signals blocked by the handler's sa_mask may have arrived meanwhile.
+  DeliverPendingSignals();
   return status;
 }
 
-void SignalManager::SetSigAction(int signum, const struct sigaction &act) {
-  // To avoid deadlock, block all signals before registering a signal handler.
-  sigset_t mask;
-  sigfillset(&mask);
-  sigset_t old_mask;
-  sigprocmask(SIG_SETMASK, &mask, &old_mask);
-  {
-    absl::MutexLock lock(&signal_to_sigaction_lock_);
-    signal_to_sigaction_[signum] = absl::make_unique<struct sigaction>(act);
+bool SignalManager::SetSigAction(int signum, const struct sigaction &act) {
+  if (signum <= 0 || signum >= kMaxSignals) {
+    return false;
   }
-  // Set the signal mask back to the original one to unblock the signals.
-  sigprocmask(SIG_SETMASK, &old_mask, nullptr);
+  auto stored = absl::make_unique<const struct sigaction>(act);
+  absl::MutexLock lock(&signal_to_sigaction_lock_);
+  const struct sigaction *previous = sigactions_[signum].exchange(stored.get());
+  sigaction_storage_.push_back(std::move(stored));
+  return previous == nullptr;
 }
 
 const struct sigaction *SignalManager::GetSigAction(int signum) const {
-  absl::MutexLock lock(&signal_to_sigaction_lock_);
-  auto sigaction_iterator = signal_to_sigaction_.find(signum);
-  if (sigaction_iterator == signal_to_sigaction_.end()) {
+  if (signum <= 0 || signum >= kMaxSignals) {
     return nullptr;
   }
-  return sigaction_iterator->second.get();
+  return sigactions_[signum].load(std::memory_order_acquire);
+}
+
+void SignalManager::DeliverPendingSignals() {
+  uint64_t pending = pending_.load(std::memory_order_acquire);
+  while (pending != 0) {
+    int signum = 0;
+    while (signum < kMaxSignals &&
+           (!(pending & (uint64_t{1} << signum)) ||
+            sigismember(&signal_mask_, signum))) {
+      ++signum;
+    }
+    if (signum == kMaxSignals) {
+      return;
+    }
+    // Only the thread clearing the bit delivers the signal.
+    uint64_t bit = uint64_t{1} << signum;
+    if (pending_.fetch_and(~bit) & bit) {
+      siginfo_t info;
+      {
+        absl::MutexLock lock(&pending_info_lock_);
+        info = pending_info_[signum];
+      }
+      // The interrupted context of a deferred signal is not known.
+      ucontext_t ucontext;
+      memset(&ucontext, 0, sizeof(ucontext));
+      const struct sigaction *act = GetSigAction(signum);
+      if (act) {
+        CallHandler(*act, signum, &info, &ucontext);
+      }
+    }
+    pending = pending_.load(std::memory_order_acquire);
+  }
 }
 
 void SignalManager::BlockSignals(const sigset_t &set) {
@@ -123,4 +169,3 @@ const sigset_t SignalManager::GetUnblockedSet(const sigset_t &set) {
 }
 
 }  // namespace asylo
-
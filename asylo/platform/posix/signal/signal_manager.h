@@ -20,8 +20,10 @@
 #define ASYLO_PLATFORM_POSIX_SIGNAL_SIGNAL_MANAGER_H_
 
 #include <signal.h>
+#include <atomic>
+#include <cstdint>
 #include <memory>
-#include <unordered_map>
+#include <vector>
 
 #include "absl/synchronization/mutex.h"
 #include "asylo/util/status.h"
@@ -30,20 +32,29 @@ namespace asylo {
 
 // SignalManager class is a singleton responsible for maintaining mapping
 // between signum and registered signal handlers.
+//
+// Signal masks are kept per thread entirely inside the enclave, so blocking and
+// unblocking signals never leaves the enclave. A signal the host delivers to a
+// thread that blocks it is recorded as pending, and its handler runs once the
+// thread unblocks it. Like standard signals on the host, a signal that arrives
+// again while pending is delivered only once.
 class SignalManager {
  public:
   static SignalManager *GetInstance();
 
-  // Locates and calls the handler registered for |signum|.
+  // Locates and calls the handler registered for |signum|, or records |signum|
+  // as pending if the calling thread blocks it.
   Status HandleSignal(int signum, siginfo_t *info, void *ucontext);
 
-  // Sets a signal handler pointer for a specific signal |signum|.
-  void SetSigAction(int signum, const struct sigaction &act)
+  // Sets a signal handler pointer for a specific signal |signum|. Returns true
+  // if no handler was registered for |signum| before, in which case the host
+  // must be asked to forward the signal to the enclave.
+  bool SetSigAction(int signum, const struct sigaction &act)
       LOCKS_EXCLUDED(signal_to_sigaction_lock_);
 
-  // Gets a signal handler for a specific signal |signum|.
-  const struct sigaction *GetSigAction(int signum) const
-      LOCKS_EXCLUDED(signal_to_sigaction_lock_);
+  // Gets a signal handler for a specific signal |signum|. The returned action
+  // remains valid after it is replaced. Does not block.
+  const struct sigaction *GetSigAction(int signum) const;
 
   // Blocks all the signals in |set|.
   void BlockSignals(const sigset_t &set);
@@ -60,14 +71,38 @@ class SignalManager {
   // Gets the set of unblocked signals in |set|.
   const sigset_t GetUnblockedSet(const sigset_t &set);
 
+  // Runs the handlers of pending signals the calling thread no longer blocks.
+  // Called after the thread's signal mask is relaxed.
+  void DeliverPendingSignals() LOCKS_EXCLUDED(pending_info_lock_);
+
  private:
+  // Signals numbered at or above this are neither registered nor deferred.
+  static constexpr int kMaxSignals = 64;
+
   SignalManager() = default;  // Private to enforce singleton.
   SignalManager(SignalManager const &) = delete;
   void operator=(SignalManager const &) = delete;
 
+  // Calls the handler |act| registered for |signum|, with the signals in its
+  // sa_mask blocked.
+  Status CallHandler(const struct sigaction &act, int signum, siginfo_t *info,
+                     void *ucontext);
+
+  // Handlers indexed by signal number, read without locking on delivery.
+  std::atomic<const struct sigaction *> sigactions_[kMaxSignals] = {};
+
+  // Owns every action ever registered, so that a handler being delivered on
+  // one thread is not freed by a sigaction call on another.
   mutable absl::Mutex signal_to_sigaction_lock_;
-  std::unordered_map<int, std::unique_ptr<struct sigaction>>
-      signal_to_sigaction_ GUARDED_BY(signal_to_sigaction_lock_);
+  std::vector<std::unique_ptr<const struct sigaction>> sigaction_storage_
+      GUARDED_BY(signal_to_sigaction_lock_);
+
+  // Bit |signum| is set while |signum| is pending.
+  std::atomic<uint64_t> pending_{0};
+
+  // The siginfo of each pending signal.
+  absl::Mutex pending_info_lock_;
+  siginfo_t pending_info_[kMaxSignals] GUARDED_BY(pending_info_lock_);
 
   thread_local static sigset_t signal_mask_;
 };
@@ -0,0 +1,130 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/posix/signal/signal_manager.h"
+
+#include <signal.h>
+
+#include <thread>
+
+#include <gtest/gtest.h>
+
+namespace asylo {
+namespace {
+
+int handled_count[NSIG];
+
+void CountingHandler(int signum) { handled_count[signum]++; }
+
+// Registers CountingHandler for |signum|, blocking the signals in |blocked|
+// while it runs.
+void Register(int signum, const sigset_t &blocked) {
+  struct sigaction act = {};
+  act.sa_handler = &CountingHandler;
+  act.sa_mask = blocked;
+  SignalManager::GetInstance()->SetSigAction(signum, act);
+}
+
+void Register(int signum) {
+  sigset_t empty;
+  sigemptyset(&empty);
+  Register(signum, empty);
+}
+
+Status Deliver(int signum) {
+  siginfo_t info = {};
+  info.si_signo = signum;
+  return SignalManager::GetInstance()->HandleSignal(signum, &info, nullptr);
+}
+
+sigset_t SetOf(int signum) {
+  sigset_t set;
+  sigemptyset(&set);
+  sigaddset(&set, signum);
+  return set;
+}
+
+TEST(SignalManagerTest, ReportsFirstRegistration) {
+  struct sigaction act = {};
+  act.sa_handler = &CountingHandler;
+  SignalManager *signal_manager = SignalManager::GetInstance();
+  EXPECT_TRUE(signal_manager->SetSigAction(SIGWINCH, act));
+  EXPECT_FALSE(signal_manager->SetSigAction(SIGWINCH, act));
+  EXPECT_FALSE(signal_manager->HandleSignal(SIGPWR, nullptr, nullptr).ok());
+}
+
+TEST(SignalManagerTest, DeliversUnblockedSignal) {
+  Register(SIGUSR1);
+  ASSERT_TRUE(Deliver(SIGUSR1).ok());
+  EXPECT_EQ(handled_count[SIGUSR1], 1);
+}
+
+// Tests that a blocked signal is held until it is unblocked, and is delivered
+// once however many times it arrived.
+TEST(SignalManagerTest, DefersBlockedSignal) {
+  Register(SIGUSR2);
+  SignalManager *signal_manager = SignalManager::GetInstance();
+  signal_manager->BlockSignals(SetOf(SIGUSR2));
+  ASSERT_TRUE(Deliver(SIGUSR2).ok());
+  ASSERT_TRUE(Deliver(SIGUSR2).ok());
+  EXPECT_EQ(handled_count[SIGUSR2], 0);
+
+  signal_manager->UnblockSignals(SetOf(SIGUSR2));
+  signal_manager->DeliverPendingSignals();
+  EXPECT_EQ(handled_count[SIGUSR2], 1);
+  signal_manager->DeliverPendingSignals();
+  EXPECT_EQ(handled_count[SIGUSR2], 1);
+}
+
+int nested_count_in_handler = -1;
+
+void BlockingHandler(int signum) {
+  // SIGHUP arrives while this handler blocks it.
+  Deliver(SIGHUP);
+  nested_count_in_handler = handled_count[SIGHUP];
+}
+
+// Tests that a signal blocked by a handler's sa_mask runs after the handler.
+TEST(SignalManagerTest, DeliversSignalBlockedByHandlerAfterIt) {
+  Register(SIGHUP);
+  struct sigaction act = {};
+  act.sa_handler = &BlockingHandler;
+  act.sa_mask = SetOf(SIGHUP);
+  SignalManager::GetInstance()->SetSigAction(SIGTERM, act);
+
+  ASSERT_TRUE(Deliver(SIGTERM).ok());
+  EXPECT_EQ(nested_count_in_handler, 0);
+  EXPECT_EQ(handled_count[SIGHUP], 1);
+}
+
+// Tests that a signal pending because one thread blocks it is delivered by
+// another thread which does not.
+TEST(SignalManagerTest, OtherThreadDeliversPendingSignal) {
+  Register(SIGALRM);
+  SignalManager *signal_manager = SignalManager::GetInstance();
+  signal_manager->BlockSignals(SetOf(SIGALRM));
+  ASSERT_TRUE(Deliver(SIGALRM).ok());
+  std::thread([signal_manager] {
+    signal_manager->DeliverPendingSignals();
+  }).join();
+  EXPECT_EQ(handled_count[SIGALRM], 1);
+  signal_manager->UnblockSignals(SetOf(SIGALRM));
+}
+
+}  // namespace
+}  // namespace asylo
@@ -0,0 +1,242 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/posix/sockets/addrinfo_cache.h"
+
+#include <netinet/in.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <utility>
+
+namespace asylo {
+namespace {
+
+// Appends the bytes of |value| to |key|.
+template <typename T>
+void AppendKeyField(const T &value, std::string *key) {
+  key->append(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+// Appends an optional string to |key| so that a null string, an empty string
+// and any other string all produce distinct keys.
+void AppendKeyString(const char *value, std::string *key) {
+  key->push_back(value ? 1 : 0);
+  if (value) {
+    key->append(value);
+    key->push_back('\0');
+  }
+}
+
+std::string MakeKey(const char *node, const char *service,
+                    const struct addrinfo *hints) {
+  std::string key;
+  AppendKeyString(node, &key);
+  AppendKeyString(service, &key);
+  // getaddrinfo reads only these four fields of |hints| and treats a null
+  // |hints| as all of them being zero.
+  int fields[4] = {0, 0, 0, 0};
+  if (hints) {
+    fields[0] = hints->ai_flags;
+    fields[1] = hints->ai_family;
+    fields[2] = hints->ai_socktype;
+    fields[3] = hints->ai_protocol;
+  }
+  AppendKeyField(fields, &key);
+  return key;
+}
+
+// Returns the number of bytes of |addr| that may be read, which is the size of
+// the structure for its family. The address length in the list is reported by
+// the host and is not used to bound the copy.
+size_t SockaddrSize(const struct sockaddr *addr) {
+  switch (addr->sa_family) {
+    case AF_INET:
+      return sizeof(struct sockaddr_in);
+    case AF_INET6:
+      return sizeof(struct sockaddr_in6);
+    default:
+      return 0;
+  }
+}
+
+// Releases a partially built list, mirroring freeaddrinfo.
+void FreeList(struct addrinfo *list) {
+  while (list) {
+    struct addrinfo *next = list->ai_next;
+    free(list->ai_addr);
+    free(list->ai_canonname);
+    free(list);
+    list = next;
+  }
+}
+
+}  // namespace
+
+AddrinfoCache &AddrinfoCache::GetInstance() {
+  static AddrinfoCache *instance = new AddrinfoCache();
+  return *instance;
+}
+
+void AddrinfoCache::Configure(size_t max_entries, int64_t ttl_nanoseconds,
+                              int64_t negative_ttl_nanoseconds) {
+  absl::MutexLock lock(&mu_);
+  max_entries_ = max_entries;
+  ttl_ = ttl_nanoseconds;
+  negative_ttl_ = negative_ttl_nanoseconds;
+  entries_.clear();
+  lru_.clear();
+}
+
+bool AddrinfoCache::enabled() const {
+  absl::MutexLock lock(&mu_);
+  return max_entries_ > 0;
+}
+
+bool AddrinfoCache::Lookup(const char *node, const char *service,
+                           const struct addrinfo *hints, int64_t now,
+                           int *result, struct addrinfo **res) {
+  std::string key = MakeKey(node, service, hints);
+  absl::MutexLock lock(&mu_);
+  auto it = entries_.find(key);
+  if (it == entries_.end()) {
+    return false;
+  }
+  if (now >= it->second.expiry) {
+    EraseLocked(it);
+    return false;
+  }
+
+  const Entry &entry = it->second;
+  if (entry.result == 0) {
+    struct addrinfo *head = nullptr;
+    struct addrinfo **tail = &head;
+    for (const Record &record : entry.records) {
+      struct addrinfo *info =
+          static_cast<struct addrinfo *>(calloc(1, sizeof(struct addrinfo)));
+      if (!info) {
+        FreeList(head);
+        return false;
+      }
+      *tail = info;
+      tail = &info->ai_next;
+      info->ai_flags = record.flags;
+      info->ai_family = record.family;
+      info->ai_socktype = record.socktype;
+      info->ai_protocol = record.protocol;
+      info->ai_addrlen = record.addrlen;
+      if (record.has_addr) {
+        info->ai_addr =
+            static_cast<struct sockaddr *>(malloc(record.addr.size()));
+        if (!info->ai_addr) {
+          FreeList(head);
+          return false;
+        }
+        memcpy(info->ai_addr, record.addr.data(), record.addr.size());
+      }
+      if (record.has_canonname) {
+        info->ai_canonname =
+            static_cast<char *>(malloc(record.canonname.size() + 1));
+        if (!info->ai_canonname) {
+          FreeList(head);
+          return false;
+        }
+        memcpy(info->ai_canonname, record.canonname.c_str(),
+               record.canonname.size() + 1);
+      }
+    }
+    *res = head;
+  }
+  *result = entry.result;
+  lru_.splice(lru_.begin(), lru_, entry.lru_position);
+  return true;
+}
+
+void AddrinfoCache::Insert(const char *node, const char *service,
+                           const struct addrinfo *hints, int64_t now,
+                           int result, const struct addrinfo *res) {
+  if (result != 0 && result != EAI_NONAME && result != EAI_NODATA) {
+    return;
+  }
+
+  Entry entry;
+  entry.result = result;
+  if (result == 0) {
+    for (const struct addrinfo *info = res; info; info = info->ai_next) {
+      Record record;
+      record.flags = info->ai_flags;
+      record.family = info->ai_family;
+      record.socktype = info->ai_socktype;
+      record.protocol = info->ai_protocol;
+      record.addrlen = info->ai_addrlen;
+      record.has_addr = info->ai_addr != nullptr;
+      if (record.has_addr) {
+        size_t size = SockaddrSize(info->ai_addr);
+        if (size == 0) {
+          return;
+        }
+        record.addr.assign(reinterpret_cast<const char *>(info->ai_addr),
+                           size);
+        record.addrlen = std::min<socklen_t>(info->ai_addrlen, size);
+      }
+      record.has_canonname = info->ai_canonname != nullptr;
+      if (record.has_canonname) {
+        record.canonname = info->ai_canonname;
+      }
+      entry.records.push_back(std::move(record));
+    }
+  }
+
+  std::string key = MakeKey(node, service, hints);
+  absl::MutexLock lock(&mu_);
+  int64_t ttl = result == 0 ? ttl_ : negative_ttl_;
+  if (max_entries_ == 0 || ttl <= 0) {
+    return;
+  }
+  entry.expiry = now + ttl;
+
+  auto it = entries_.find(key);
+  if (it != entries_.end()) {
+    EraseLocked(it);
+  }
+  while (entries_.size() >= max_entries_) {
+    EraseLocked(entries_.find(lru_.back()));
+  }
+  lru_.push_front(key);
+  entry.lru_position = lru_.begin();
+  entries_.emplace(std::move(key), std::move(entry));
+}
+
+void AddrinfoCache::Invalidate() {
+  absl::MutexLock lock(&mu_);
+  entries_.clear();
+  lru_.clear();
+}
+
+size_t AddrinfoCache::size() const {
+  absl::MutexLock lock(&mu_);
+  return entries_.size();
+}
+
+void AddrinfoCache::EraseLocked(
+    std::unordered_map<std::string, Entry>::iterator it) {
+  lru_.erase(it->second.lru_position);
+  entries_.erase(it);
+}
+
+}  // namespace asylo
@@ -0,0 +1,122 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_PLATFORM_POSIX_SOCKETS_ADDRINFO_CACHE_H_
+#define ASYLO_PLATFORM_POSIX_SOCKETS_ADDRINFO_CACHE_H_
+
+#include <netdb.h>
+#include <sys/socket.h>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "absl/synchronization/mutex.h"
+
+namespace asylo {
+
+// A bounded, least-recently-used cache of getaddrinfo results, keyed on the
+// node, service, and the hint fields getaddrinfo honors. Successful lookups
+// are kept for a configurable time-to-live; authoritative failures
+// (EAI_NONAME and EAI_NODATA) are kept for a separate, typically shorter,
+// negative time-to-live. Transient failures are never cached.
+//
+// Results handed out by Lookup() are allocated in the same way as results
+// deserialized from the host, so they are released with freeaddrinfo(). All
+// methods are thread-safe. Times are supplied by the caller as nanoseconds on
+// a monotonic clock.
+class AddrinfoCache {
+ public:
+  AddrinfoCache() = default;
+  AddrinfoCache(const AddrinfoCache &) = delete;
+  AddrinfoCache &operator=(const AddrinfoCache &) = delete;
+
+  // Returns the cache consulted by getaddrinfo inside the enclave.
+  static AddrinfoCache &GetInstance();
+
+  // Sets the maximum number of cached lookups and the lifetimes of positive
+  // and negative entries. A |max_entries| of zero disables the cache. Existing
+  // entries are discarded.
+  void Configure(size_t max_entries, int64_t ttl_nanoseconds,
+                 int64_t negative_ttl_nanoseconds);
+
+  // Returns true if the cache has been configured to hold any entries.
+  bool enabled() const;
+
+  // Looks up a result for the given getaddrinfo arguments at time |now|. On a
+  // hit returns true, stores the cached getaddrinfo return value in |result|
+  // and, if that value is zero, a newly allocated copy of the cached list in
+  // |res|.
+  bool Lookup(const char *node, const char *service,
+              const struct addrinfo *hints, int64_t now, int *result,
+              struct addrinfo **res);
+
+  // Records the outcome |result| and, on success, the list |res| of a
+  // getaddrinfo call made with the given arguments at time |now|.
+  void Insert(const char *node, const char *service,
+              const struct addrinfo *hints, int64_t now, int result,
+              const struct addrinfo *res);
+
+  // Discards every cached entry, for instance after the host's resolver
+  // configuration changed.
+  void Invalidate();
+
+  // Returns the number of entries currently cached, including expired ones
+  // which have not yet been evicted.
+  size_t size() const;
+
+ private:
+  // A single element of a cached addrinfo list.
+  struct Record {
+    int flags;
+    int family;
+    int socktype;
+    int protocol;
+    socklen_t addrlen;
+    bool has_addr;
+    bool has_canonname;
+    std::string addr;
+    std::string canonname;
+  };
+
+  struct Entry {
+    int result;
+    int64_t expiry;
+    std::vector<Record> records;
+    std::list<std::string>::iterator lru_position;
+  };
+
+  // Erases the entry at |it| from both the map and the recency list.
+  void EraseLocked(std::unordered_map<std::string, Entry>::iterator it)
+      EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  mutable absl::Mutex mu_;
+  size_t max_entries_ GUARDED_BY(mu_) = 0;
+  int64_t ttl_ GUARDED_BY(mu_) = 0;
+  int64_t negative_ttl_ GUARDED_BY(mu_) = 0;
+
+  // Cache keys ordered from most to least recently used.
+  std::list<std::string> lru_ GUARDED_BY(mu_);
+  std::unordered_map<std::string, Entry> entries_ GUARDED_BY(mu_);
+};
+
+}  // namespace asylo
+
+#endif  // ASYLO_PLATFORM_POSIX_SOCKETS_ADDRINFO_CACHE_H_
@@ -0,0 +1,177 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/posix/sockets/addrinfo_cache.h"
+
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <stdlib.h>
+#include <string.h>
+#include <cstdint>
+
+#include <gtest/gtest.h>
+
+namespace asylo {
+namespace {
+
+constexpr int64_t kTtl = 1000;
+constexpr int64_t kNegativeTtl = 100;
+
+// Builds a single-element list, allocated the same way as host results.
+struct addrinfo *MakeList(const char *address, uint16_t port,
+                          const char *canonname) {
+  struct addrinfo *info =
+      static_cast<struct addrinfo *>(calloc(1, sizeof(struct addrinfo)));
+  struct sockaddr_in *addr =
+      static_cast<struct sockaddr_in *>(calloc(1, sizeof(struct sockaddr_in)));
+  addr->sin_family = AF_INET;
+  addr->sin_port = htons(port);
+  inet_pton(AF_INET, address, &addr->sin_addr);
+  info->ai_family = AF_INET;
+  info->ai_socktype = SOCK_STREAM;
+  info->ai_addrlen = sizeof(*addr);
+  info->ai_addr = reinterpret_cast<struct sockaddr *>(addr);
+  if (canonname) {
+    info->ai_canonname = strdup(canonname);
+  }
+  return info;
+}
+
+void FreeList(struct addrinfo *list) {
+  while (list) {
+    struct addrinfo *next = list->ai_next;
+    free(list->ai_addr);
+    free(list->ai_canonname);
+    free(list);
+    list = next;
+  }
+}
+
+class AddrinfoCacheTest : public ::testing::Test {
+ protected:
+  void SetUp() override { cache_.Configure(2, kTtl, kNegativeTtl); }
+
+  AddrinfoCache cache_;
+};
+
+TEST_F(AddrinfoCacheTest, DisabledByDefault) {
+  AddrinfoCache cache;
+  EXPECT_FALSE(cache.enabled());
+  struct addrinfo *list = MakeList("10.0.0.1", 80, nullptr);
+  cache.Insert("host", "80", nullptr, 0, 0, list);
+  FreeList(list);
+  EXPECT_EQ(cache.size(), 0);
+}
+
+TEST_F(AddrinfoCacheTest, HitReturnsIndependentCopy) {
+  struct addrinfo *list = MakeList("10.0.0.1", 80, "host.example");
+  cache_.Insert("host", "80", nullptr, 0, 0, list);
+  FreeList(list);
+
+  int result = -1;
+  struct addrinfo *res = nullptr;
+  ASSERT_TRUE(cache_.Lookup("host", "80", nullptr, 10, &result, &res));
+  EXPECT_EQ(result, 0);
+  ASSERT_NE(res, nullptr);
+  EXPECT_EQ(res->ai_next, nullptr);
+  EXPECT_EQ(res->ai_family, AF_INET);
+  EXPECT_EQ(res->ai_socktype, SOCK_STREAM);
+  ASSERT_EQ(res->ai_addrlen, sizeof(struct sockaddr_in));
+  const struct sockaddr_in *addr =
+      reinterpret_cast<const struct sockaddr_in *>(res->ai_addr);
+  EXPECT_EQ(ntohs(addr->sin_port), 80);
+  EXPECT_STREQ(res->ai_canonname, "host.example");
+  FreeList(res);
+}
+
+TEST_F(AddrinfoCacheTest, KeyIncludesServiceAndHints) {
+  struct addrinfo *list = MakeList("10.0.0.1", 80, nullptr);
+  cache_.Insert("host", "80", nullptr, 0, 0, list);
+  FreeList(list);
+
+  struct addrinfo hints;
+  memset(&hints, 0, sizeof(hints));
+  int result;
+  struct addrinfo *res = nullptr;
+  EXPECT_TRUE(cache_.Lookup("host", "80", &hints, 0, &result, &res));
+  FreeList(res);
+
+  hints.ai_family = AF_INET6;
+  EXPECT_FALSE(cache_.Lookup("host", "80", &hints, 0, &result, &res));
+  EXPECT_FALSE(cache_.Lookup("host", "443", nullptr, 0, &result, &res));
+  EXPECT_FALSE(cache_.Lookup("host", nullptr, nullptr, 0, &result, &res));
+  EXPECT_FALSE(cache_.Lookup(nullptr, "80", nullptr, 0, &result, &res));
+}
+
+TEST_F(AddrinfoCacheTest, EntriesExpire) {
+  struct addrinfo *list = MakeList("10.0.0.1", 80, nullptr);
+  cache_.Insert("host", "80", nullptr, 0, 0, list);
+  FreeList(list);
+
+  int result;
+  struct addrinfo *res = nullptr;
+  EXPECT_FALSE(cache_.Lookup("host", "80", nullptr, kTtl, &result, &res));
+  EXPECT_EQ(cache_.size(), 0);
+}
+
+TEST_F(AddrinfoCacheTest, NegativeCaching) {
+  cache_.Insert("missing", "80", nullptr, 0, EAI_NONAME, nullptr);
+  cache_.Insert("flaky", "80", nullptr, 0, EAI_AGAIN, nullptr);
+  EXPECT_EQ(cache_.size(), 1);
+
+  int result = 0;
+  struct addrinfo *res = nullptr;
+  ASSERT_TRUE(cache_.Lookup("missing", "80", nullptr, kNegativeTtl - 1,
+                            &result, &res));
+  EXPECT_EQ(result, EAI_NONAME);
+  EXPECT_EQ(res, nullptr);
+  EXPECT_FALSE(
+      cache_.Lookup("missing", "80", nullptr, kNegativeTtl, &result, &res));
+  EXPECT_FALSE(cache_.Lookup("flaky", "80", nullptr, 0, &result, &res));
+}
+
+TEST_F(AddrinfoCacheTest, EvictsLeastRecentlyUsed) {
+  struct addrinfo *list = MakeList("10.0.0.1", 80, nullptr);
+  cache_.Insert("a", "80", nullptr, 0, 0, list);
+  cache_.Insert("b", "80", nullptr, 0, 0, list);
+
+  int result;
+  struct addrinfo *res = nullptr;
+  ASSERT_TRUE(cache_.Lookup("a", "80", nullptr, 0, &result, &res));
+  FreeList(res);
+  cache_.Insert("c", "80", nullptr, 0, 0, list);
+  FreeList(list);
+
+  EXPECT_EQ(cache_.size(), 2);
+  EXPECT_FALSE(cache_.Lookup("b", "80", nullptr, 0, &result, &res));
+  ASSERT_TRUE(cache_.Lookup("a", "80", nullptr, 0, &result, &res));
+  FreeList(res);
+  ASSERT_TRUE(cache_.Lookup("c", "80", nullptr, 0, &result, &res));
+  FreeList(res);
+}
+
+TEST_F(AddrinfoCacheTest, Invalidate) {
+  cache_.Insert("missing", "80", nullptr, 0, EAI_NONAME, nullptr);
+  cache_.Invalidate();
+  EXPECT_EQ(cache_.size(), 0);
+  EXPECT_TRUE(cache_.enabled());
+}
+
+}  // namespace
+}  // namespace asylo
@@ -0,0 +1,145 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <string>
+
+#include <gtest/gtest.h>
+
+namespace asylo {
+namespace {
+
+constexpr int kMessageCount = 4;
+
+// Binds |fd| to an ephemeral loopback port and stores the bound address in
+// |addr|.
+void BindLoopback(int fd, struct sockaddr_in *addr) {
+  memset(addr, 0, sizeof(*addr));
+  addr->sin_family = AF_INET;
+  addr->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  addr->sin_port = 0;
+  ASSERT_EQ(bind(fd, reinterpret_cast<struct sockaddr *>(addr), sizeof(*addr)),
+            0);
+  socklen_t addrlen = sizeof(*addr);
+  ASSERT_EQ(
+      getsockname(fd, reinterpret_cast<struct sockaddr *>(addr), &addrlen), 0);
+}
+
+TEST(MmsgTest, SendAndReceiveBatch) {
+  int receiver = socket(AF_INET, SOCK_DGRAM, 0);
+  ASSERT_GE(receiver, 0);
+  int sender = socket(AF_INET, SOCK_DGRAM, 0);
+  ASSERT_GE(sender, 0);
+  struct sockaddr_in addr;
+  BindLoopback(receiver, &addr);
+  ASSERT_EQ(connect(sender, reinterpret_cast<struct sockaddr *>(&addr),
+                    sizeof(addr)),
+            0);
+
+  std::string payloads[kMessageCount];
+  struct iovec send_iov[kMessageCount];
+  struct mmsghdr send_msgs[kMessageCount];
+  memset(send_msgs, 0, sizeof(send_msgs));
+  for (int i = 0; i < kMessageCount; ++i) {
+    payloads[i] = "datagram " + std::to_string(i);
+    send_iov[i].iov_base = &payloads[i][0];
+    send_iov[i].iov_len = payloads[i].size();
+    send_msgs[i].msg_hdr.msg_iov = &send_iov[i];
+    send_msgs[i].msg_hdr.msg_iovlen = 1;
+  }
+  ASSERT_EQ(sendmmsg(sender, send_msgs, kMessageCount, 0), kMessageCount);
+  for (int i = 0; i < kMessageCount; ++i) {
+    EXPECT_EQ(send_msgs[i].msg_len, payloads[i].size());
+  }
+
+  char buffers[kMessageCount][64];
+  struct iovec recv_iov[kMessageCount];
+  struct sockaddr_in sources[kMessageCount];
+  struct mmsghdr recv_msgs[kMessageCount];
+  memset(recv_msgs, 0, sizeof(recv_msgs));
+  for (int i = 0; i < kMessageCount; ++i) {
+    recv_iov[i].iov_base = buffers[i];
+    recv_iov[i].iov_len = sizeof(buffers[i]);
+    recv_msgs[i].msg_hdr.msg_iov = &recv_iov[i];
+    recv_msgs[i].msg_hdr.msg_iovlen = 1;
+    recv_msgs[i].msg_hdr.msg_name = &sources[i];
+    recv_msgs[i].msg_hdr.msg_namelen = sizeof(sources[i]);
+  }
+
+  int received = 0;
+  while (received < kMessageCount) {
+    int ret = recvmmsg(receiver, recv_msgs + received,
+                       kMessageCount - received, 0, nullptr);
+    ASSERT_GT(ret, 0) << strerror(errno);
+    received += ret;
+  }
+  for (int i = 0; i < kMessageCount; ++i) {
+    ASSERT_EQ(recv_msgs[i].msg_len, payloads[i].size());
+    EXPECT_EQ(std::string(buffers[i], recv_msgs[i].msg_len), payloads[i]);
+    EXPECT_EQ(recv_msgs[i].msg_hdr.msg_namelen, sizeof(sources[i]));
+    EXPECT_EQ(sources[i].sin_family, AF_INET);
+  }
+
+  EXPECT_EQ(close(sender), 0);
+  EXPECT_EQ(close(receiver), 0);
+}
+
+TEST(MmsgTest, Accept4AppliesFlags) {
+  int listener = socket(AF_INET, SOCK_STREAM, 0);
+  ASSERT_GE(listener, 0);
+  struct sockaddr_in addr;
+  BindLoopback(listener, &addr);
+  ASSERT_EQ(listen(listener, 1), 0);
+
+  int client = socket(AF_INET, SOCK_STREAM, 0);
+  ASSERT_GE(client, 0);
+  ASSERT_EQ(connect(client, reinterpret_cast<struct sockaddr *>(&addr),
+                    sizeof(addr)),
+            0);
+
+  struct sockaddr_in peer;
+  socklen_t peerlen = sizeof(peer);
+  int accepted =
+      accept4(listener, reinterpret_cast<struct sockaddr *>(&peer), &peerlen,
+              SOCK_NONBLOCK);
+  ASSERT_GE(accepted, 0) << strerror(errno);
+  EXPECT_EQ(peerlen, sizeof(peer));
+  EXPECT_NE(fcntl(accepted, F_GETFL) & O_NONBLOCK, 0);
+
+  EXPECT_EQ(close(accepted), 0);
+  EXPECT_EQ(close(client), 0);
+  EXPECT_EQ(close(listener), 0);
+}
+
+TEST(MmsgTest, Accept4RejectsUnknownFlags) {
+  int listener = socket(AF_INET, SOCK_STREAM, 0);
+  ASSERT_GE(listener, 0);
+  errno = 0;
+  EXPECT_EQ(accept4(listener, nullptr, nullptr, ~0), -1);
+  EXPECT_EQ(errno, EINVAL);
+  EXPECT_EQ(close(listener), 0);
+}
+
+}  // namespace
+}  // namespace asylo
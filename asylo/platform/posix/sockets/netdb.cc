@@ -18,8 +18,11 @@
 
 #include <netdb.h>
 #include <stdlib.h>
+#include <time.h>
 
 #include "asylo/platform/arch/include/trusted/host_calls.h"
+#include "asylo/platform/common/time_util.h"
+#include "asylo/platform/posix/sockets/addrinfo_cache.h"
 
 extern "C" {
 
@@ -28,7 +31,23 @@ const char *gai_strerror(int ecode) { abort(); }
 
 int getaddrinfo(const char *node, const char *service,
                 const struct addrinfo *hints, struct addrinfo **res) {
-  return enc_untrusted_getaddrinfo(node, service, hints, res);
+  asylo::AddrinfoCache &cache = asylo::AddrinfoCache::GetInstance();
+  if (!cache.enabled()) {
+    return enc_untrusted_getaddrinfo(node, service, hints, res);
+  }
+
+  // Reading the monotonic clock does not leave the enclave, so a cache hit
+  // costs no host calls at all.
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  int64_t now = asylo::TimeSpecToNanoseconds(&ts);
+  int ret;
+  if (cache.Lookup(node, service, hints, now, &ret, res)) {
+    return ret;
+  }
+  ret = enc_untrusted_getaddrinfo(node, service, hints, res);
+  cache.Insert(node, service, hints, now, ret, ret == 0 ? *res : nullptr);
+  return ret;
 }
 
 void freeaddrinfo(struct addrinfo *res) {
@@ -49,6 +49,10 @@ int socket(int domain, int type, int protocol) {
   return IOManager::GetInstance().Socket(domain, type, protocol);
 }
 
+int socketpair(int domain, int type, int protocol, int sv[2]) {
+  return IOManager::GetInstance().SocketPair(domain, type, protocol, sv);
+}
+
 ssize_t recv(int sockfd, void *buf, size_t len, int flags) { abort(); }
 
 int getsockopt(int sockfd, int level, int optname, void *optval,
@@ -61,6 +65,10 @@ int accept(int sockfd, struct sockaddr *addr, socklen_t *addrlen) {
   return IOManager::GetInstance().Accept(sockfd, addr, addrlen);
 }
 
+int accept4(int sockfd, struct sockaddr *addr, socklen_t *addrlen, int flags) {
+  return IOManager::GetInstance().Accept4(sockfd, addr, addrlen, flags);
+}
+
 int bind(int sockfd, const struct sockaddr *addr, socklen_t addrlen) {
   return IOManager::GetInstance().Bind(sockfd, addr, addrlen);
 }
@@ -77,6 +85,16 @@ ssize_t recvmsg(int sockfd, struct msghdr *msg, int flags) {
   return IOManager::GetInstance().RecvMsg(sockfd, msg, flags);
 }
 
+int sendmmsg(int sockfd, struct mmsghdr *msgvec, unsigned int vlen, int flags) {
+  return IOManager::GetInstance().SendMmsg(sockfd, msgvec, vlen, flags);
+}
+
+int recvmmsg(int sockfd, struct mmsghdr *msgvec, unsigned int vlen, int flags,
+             struct timespec *timeout) {
+  return IOManager::GetInstance().RecvMmsg(sockfd, msgvec, vlen, flags,
+                                           timeout);
+}
+
 int getsockname(int sockfd, struct sockaddr *addr, socklen_t *addrlen) {
   return IOManager::GetInstance().GetSockName(sockfd, addr, addrlen);
 }
@@ -0,0 +1,171 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/posix/sockets/socket_benchmark.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "asylo/platform/posix/sockets/socket_transmit.h"
+#include "asylo/platform/storage/utils/fd_closer.h"
+#include "asylo/util/posix_error_space.h"
+
+namespace asylo {
+namespace {
+
+constexpr int64_t kNanosecondsPerSecond = 1000000000;
+
+int64_t MonotonicNanoseconds() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return static_cast<int64_t>(ts.tv_sec) * kNanosecondsPerSecond + ts.tv_nsec;
+}
+
+// Returns the |percentile|th percentile of the sorted samples in |sorted|.
+int64_t Percentile(const std::vector<int64_t> &sorted, int percentile) {
+  if (sorted.empty()) {
+    return 0;
+  }
+  size_t index = (sorted.size() - 1) * percentile / 100;
+  return sorted[index];
+}
+
+// Connects a new stream socket to the server described by |input| and stores
+// it in |fd|.
+Status ConnectToServer(const SocketBenchmarkInput &input,
+                       platform::storage::FdCloser *fd) {
+  int ret = -1;
+  switch (input.transport()) {
+    case SocketBenchmarkInput::TCP: {
+      fd->reset(socket(AF_INET, SOCK_STREAM, 0));
+      struct sockaddr_in addr;
+      memset(&addr, 0, sizeof(addr));
+      addr.sin_family = AF_INET;
+      addr.sin_port = htons(input.server_port());
+      addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+      if (fd->get() >= 0) {
+        ret = connect(fd->get(), reinterpret_cast<struct sockaddr *>(&addr),
+                      sizeof(addr));
+      }
+      break;
+    }
+    case SocketBenchmarkInput::UDS: {
+      fd->reset(socket(AF_UNIX, SOCK_STREAM, 0));
+      struct sockaddr_un addr;
+      memset(&addr, 0, sizeof(addr));
+      addr.sun_family = AF_UNIX;
+      strncpy(addr.sun_path, input.socket_name().c_str(),
+              sizeof(addr.sun_path) - 1);
+      if (fd->get() >= 0) {
+        ret = connect(fd->get(), reinterpret_cast<struct sockaddr *>(&addr),
+                      sizeof(addr));
+      }
+      break;
+    }
+    case SocketBenchmarkInput::INET6: {
+      fd->reset(socket(AF_INET6, SOCK_STREAM, 0));
+      struct sockaddr_in6 addr;
+      memset(&addr, 0, sizeof(addr));
+      addr.sin6_family = AF_INET6;
+      addr.sin6_port = htons(input.server_port());
+      addr.sin6_addr = in6addr_loopback;
+      if (fd->get() >= 0) {
+        ret = connect(fd->get(), reinterpret_cast<struct sockaddr *>(&addr),
+                      sizeof(addr));
+      }
+      break;
+    }
+    default:
+      return Status(error::GoogleError::INVALID_ARGUMENT,
+                    "Unknown benchmark transport");
+  }
+  if (ret != 0) {
+    return Status(static_cast<error::PosixError>(errno), "connect error");
+  }
+  return Status::OkStatus();
+}
+
+}  // namespace
+
+Status RunSocketBenchmarkClient(const SocketBenchmarkInput &input,
+                                SocketBenchmarkOutput *output) {
+  if (input.message_size() <= 0 || input.round_trips() <= 0) {
+    return Status(error::GoogleError::INVALID_ARGUMENT,
+                  "Benchmark message size and round trips must be positive");
+  }
+
+  platform::storage::FdCloser fd;
+  Status status = ConnectToServer(input, &fd);
+  if (!status.ok()) {
+    return status;
+  }
+
+  SocketTransmit transmit;
+  std::unique_ptr<char[]> buf(new char[input.message_size()]);
+  for (int i = 0; i < input.warmup_round_trips(); ++i) {
+    if (!(status = transmit.Read(fd.get(), buf.get(), input.message_size()))
+             .ok() ||
+        !(status = transmit.Write(fd.get(), buf.get(), input.message_size()))
+             .ok()) {
+      return status;
+    }
+  }
+  transmit.reset();
+
+  std::vector<int64_t> latencies;
+  latencies.reserve(input.round_trips());
+  int64_t start = MonotonicNanoseconds();
+  int64_t previous = start;
+  for (int i = 0; i < input.round_trips(); ++i) {
+    if (!(status = transmit.Read(fd.get(), buf.get(), input.message_size()))
+             .ok() ||
+        !(status = transmit.Write(fd.get(), buf.get(), input.message_size()))
+             .ok()) {
+      return status;
+    }
+    int64_t now = MonotonicNanoseconds();
+    latencies.push_back(now - previous);
+    previous = now;
+  }
+  int64_t elapsed = previous - start;
+
+  std::sort(latencies.begin(), latencies.end());
+  output->set_round_trips(input.round_trips());
+  output->set_elapsed_ns(elapsed);
+  output->set_requests_per_second(
+      elapsed > 0 ? static_cast<double>(input.round_trips()) *
+                        kNanosecondsPerSecond / elapsed
+                  : 0.0);
+  output->set_p50_latency_ns(Percentile(latencies, 50));
+  output->set_p99_latency_ns(Percentile(latencies, 99));
+  output->set_read_calls(transmit.GetRead());
+  output->set_write_calls(transmit.GetWrite());
+  return Status::OkStatus();
+}
+
+}  // namespace asylo
@@ -0,0 +1,41 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_PLATFORM_POSIX_SOCKETS_SOCKET_BENCHMARK_H_
+#define ASYLO_PLATFORM_POSIX_SOCKETS_SOCKET_BENCHMARK_H_
+
+#include "asylo/platform/posix/sockets/socket_benchmark.pb.h"
+#include "asylo/util/status.h"
+
+namespace asylo {
+
+// Connects to the echo server described by |input| and performs
+// |input.warmup_round_trips()| unmeasured and then |input.round_trips()|
+// measured requests. Each request reads |input.message_size()| bytes from the
+// server and writes as many back, matching the peer behavior of
+// SocketServer::ServerRoundtripTransmit. Throughput, latency percentiles and
+// syscall counts of the measured requests are stored in |output|.
+//
+// The same code runs natively and inside an enclave so that both columns of a
+// comparison measure identical work.
+Status RunSocketBenchmarkClient(const SocketBenchmarkInput &input,
+                                SocketBenchmarkOutput *output);
+
+}  // namespace asylo
+
+#endif  // ASYLO_PLATFORM_POSIX_SOCKETS_SOCKET_BENCHMARK_H_
@@ -0,0 +1,247 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+// Measures request throughput and latency of stream sockets used from inside
+// an enclave, and of the same client code running natively, against an echo
+// server on the host. Whether the enclave runs in hardware or simulation mode
+// is decided when it is built; pass --enclave_label to tell the two apart in
+// the report.
+
+#include <signal.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_split.h"
+#include "asylo/benchmarks/benchmark_report.h"
+#include "asylo/client.h"
+#include "asylo/platform/posix/sockets/socket_benchmark.h"
+#include "asylo/platform/posix/sockets/socket_benchmark.pb.h"
+#include "asylo/platform/posix/sockets/socket_client.h"
+#include "asylo/platform/posix/sockets/socket_server.h"
+#include "asylo/platform/posix/sockets/socket_test_transmit.h"
+#include "asylo/util/logging.h"
+#include "gflags/gflags.h"
+
+DEFINE_string(enclave_path, "", "Path to the benchmark enclave");
+DEFINE_string(transports, "tcp,uds,inet6",
+              "Comma-separated transports to measure: tcp, uds and inet6");
+DEFINE_string(message_sizes, "64,1024,16384",
+              "Comma-separated request sizes in bytes");
+DEFINE_string(modes, "native,enclave",
+              "Comma-separated client locations: native and enclave");
+DEFINE_string(enclave_label, "enclave",
+              "Name reported for the enclave mode, e.g. sim or hw");
+DEFINE_int32(round_trips, 10000, "Measured requests per run");
+DEFINE_int32(warmup_round_trips, 100, "Unmeasured requests per run");
+DEFINE_string(socket_dir, "/tmp", "Directory for UNIX domain sockets");
+DEFINE_string(json_output, "", "File to also write the results to as JSON");
+
+namespace asylo {
+namespace {
+
+constexpr char kEnclaveName[] = "socket_benchmark";
+
+bool ParseTransport(const std::string &name,
+                    SocketBenchmarkInput::Transport *transport) {
+  if (name == "tcp") {
+    *transport = SocketBenchmarkInput::TCP;
+  } else if (name == "uds") {
+    *transport = SocketBenchmarkInput::UDS;
+  } else if (name == "inet6") {
+    *transport = SocketBenchmarkInput::INET6;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+// Sets up an echo server for |input|, updating it with the server address, and
+// runs |client| against it.
+template <typename ClientFunction>
+Status RunAgainstServer(SocketBenchmarkInput *input, ClientFunction client) {
+  SocketServer server;
+  Status status;
+  if (input->transport() == SocketBenchmarkInput::UDS) {
+    std::string socket_name = FLAGS_socket_dir + "/socket_benchmark_" +
+                              std::to_string(getpid());
+    unlink(socket_name.c_str());
+    status = server.ServerSetup(socket_name);
+    input->set_socket_name(socket_name);
+  } else {
+    // The server listens on the IPv6 wildcard address, which also accepts
+    // IPv4 connections.
+    status = server.ServerSetup();
+    input->set_server_port(server.GetPort());
+  }
+  if (!status.ok()) {
+    return status;
+  }
+
+  Status server_status;
+  int requests = input->warmup_round_trips() + input->round_trips();
+  std::thread server_thread([&server, &server_status, input, requests] {
+    server_status = server.ServerAccept();
+    if (server_status.ok()) {
+      server_status =
+          server.ServerRoundtripTransmit(input->message_size(), requests);
+    }
+  });
+  status = client(*input);
+  if (!status.ok()) {
+    // The client may have failed before connecting. Make and drop a
+    // connection so that the server thread unblocks and fails too.
+    SocketClient unblock;
+    if (input->transport() == SocketBenchmarkInput::UDS) {
+      unblock.ClientSetup(input->socket_name());
+    } else {
+      unblock.ClientSetup(kLocalIpv6AddrStr, input->server_port());
+    }
+  }
+  server_thread.join();
+  if (input->transport() == SocketBenchmarkInput::UDS) {
+    unlink(input->socket_name().c_str());
+  }
+  return status.ok() ? server_status : status;
+}
+
+}  // namespace
+}  // namespace asylo
+
+int main(int argc, char *argv[]) {
+  ::google::ParseCommandLineFlags(&argc, &argv, /*remove_flags=*/true);
+  // A failed run leaves the echo server writing to a closed connection.
+  signal(SIGPIPE, SIG_IGN);
+
+  std::vector<asylo::SocketBenchmarkInput::Transport> transports;
+  for (const auto &name : absl::StrSplit(FLAGS_transports, ',')) {
+    asylo::SocketBenchmarkInput::Transport transport;
+    if (!asylo::ParseTransport(std::string(name), &transport)) {
+      LOG(QFATAL) << "Unknown transport: " << name;
+    }
+    transports.push_back(transport);
+  }
+  std::vector<int> message_sizes;
+  for (const auto &size : absl::StrSplit(FLAGS_message_sizes, ',')) {
+    int value;
+    if (!absl::SimpleAtoi(size, &value) || value <= 0) {
+      LOG(QFATAL) << "Invalid message size: " << size;
+    }
+    message_sizes.push_back(value);
+  }
+  std::vector<std::string> modes = absl::StrSplit(FLAGS_modes, ',');
+
+  asylo::EnclaveClient *client = nullptr;
+  asylo::EnclaveManager *manager = nullptr;
+  for (const auto &mode : modes) {
+    if (mode == "enclave") {
+      asylo::EnclaveManager::Configure(asylo::EnclaveManagerOptions());
+      auto manager_result = asylo::EnclaveManager::Instance();
+      if (!manager_result.ok()) {
+        LOG(QFATAL) << "EnclaveManager unavailable: "
+                    << manager_result.status();
+      }
+      manager = manager_result.ValueOrDie();
+      asylo::SGXLoader loader(FLAGS_enclave_path, /*debug=*/true);
+      asylo::Status status = manager->LoadEnclave(asylo::kEnclaveName, loader);
+      if (!status.ok()) {
+        LOG(QFATAL) << "Load " << FLAGS_enclave_path << " failed: " << status;
+      }
+      client = manager->GetClient(asylo::kEnclaveName);
+    } else if (mode != "native") {
+      LOG(QFATAL) << "Unknown mode: " << mode;
+    }
+  }
+
+  asylo::BenchmarkRecorder recorder("socket");
+  printf("%-6s %-10s %8s %12s %10s %10s %8s %8s\n", "proto", "mode", "bytes",
+         "req/s", "p50(us)", "p99(us)", "reads", "writes");
+  for (asylo::SocketBenchmarkInput::Transport transport : transports) {
+    for (int message_size : message_sizes) {
+      for (const auto &mode : modes) {
+        asylo::SocketBenchmarkInput input;
+        input.set_transport(transport);
+        input.set_message_size(message_size);
+        input.set_round_trips(FLAGS_round_trips);
+        input.set_warmup_round_trips(FLAGS_warmup_round_trips);
+
+        asylo::SocketBenchmarkOutput result;
+        asylo::Status status = asylo::RunAgainstServer(
+            &input, [&](const asylo::SocketBenchmarkInput &server_input) {
+              if (mode == "native") {
+                return asylo::RunSocketBenchmarkClient(server_input, &result);
+              }
+              asylo::EnclaveInput enclave_input;
+              *enclave_input.MutableExtension(asylo::socket_benchmark_input) =
+                  server_input;
+              asylo::EnclaveOutput enclave_output;
+              asylo::Status enclave_status =
+                  client->EnterAndRun(enclave_input, &enclave_output);
+              result = enclave_output.GetExtension(
+                  asylo::socket_benchmark_output);
+              return enclave_status;
+            });
+        if (!status.ok()) {
+          LOG(QFATAL) << "Benchmark run failed: " << status;
+        }
+        printf("%-6s %-10s %8d %12.0f %10.1f %10.1f %8d %8d\n",
+               asylo::SocketBenchmarkInput::Transport_Name(transport).c_str(),
+               mode == "native" ? "native" : FLAGS_enclave_label.c_str(),
+               message_size, result.requests_per_second(),
+               result.p50_latency_ns() / 1000.0,
+               result.p99_latency_ns() / 1000.0, result.read_calls(),
+               result.write_calls());
+
+        asylo::BenchmarkResult *recorded = recorder.AddResult(
+            {{"transport",
+              asylo::SocketBenchmarkInput::Transport_Name(transport)},
+             {"mode", mode == "native" ? "native" : FLAGS_enclave_label},
+             {"bytes", absl::StrCat(message_size)}});
+        asylo::AddMetric("req/s", result.requests_per_second(),
+                         asylo::BenchmarkMetric::HIGHER_IS_BETTER, recorded);
+        asylo::AddMetric("p50_us", result.p50_latency_ns() / 1000.0,
+                         asylo::BenchmarkMetric::LOWER_IS_BETTER, recorded);
+        asylo::AddMetric("p99_us", result.p99_latency_ns() / 1000.0,
+                         asylo::BenchmarkMetric::LOWER_IS_BETTER, recorded);
+        asylo::AddMetric("reads", result.read_calls(),
+                         asylo::BenchmarkMetric::LOWER_IS_BETTER, recorded);
+        asylo::AddMetric("writes", result.write_calls(),
+                         asylo::BenchmarkMetric::LOWER_IS_BETTER, recorded);
+      }
+    }
+  }
+
+  if (client) {
+    asylo::EnclaveFinal final_input;
+    asylo::Status status = manager->DestroyEnclave(client, final_input);
+    if (!status.ok()) {
+      LOG(QFATAL) << "Destroy " << FLAGS_enclave_path << " failed: " << status;
+    }
+  }
+
+  asylo::Status status = recorder.WriteJson(FLAGS_json_output);
+  if (!status.ok()) {
+    LOG(QFATAL) << status;
+  }
+  return 0;
+}
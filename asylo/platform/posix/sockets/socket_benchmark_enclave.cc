@@ -0,0 +1,49 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/posix/sockets/socket_benchmark.h"
+#include "asylo/platform/posix/sockets/socket_benchmark.pb.h"
+#include "asylo/trusted_application.h"
+#include "asylo/util/status.h"
+
+namespace asylo {
+
+// Runs the socket benchmark client inside the enclave against a server set up
+// by the driver.
+class SocketBenchmarkApplication : public TrustedApplication {
+ public:
+  Status Run(const EnclaveInput &input, EnclaveOutput *output) override {
+    if (!input.HasExtension(socket_benchmark_input)) {
+      return Status(error::GoogleError::INVALID_ARGUMENT,
+                    "Missing socket benchmark input");
+    }
+    SocketBenchmarkOutput result;
+    Status status = RunSocketBenchmarkClient(
+        input.GetExtension(socket_benchmark_input), &result);
+    if (status.ok() && output) {
+      *output->MutableExtension(socket_benchmark_output) = result;
+    }
+    return status;
+  }
+};
+
+TrustedApplication *BuildTrustedApplication() {
+  return new SocketBenchmarkApplication;
+}
+
+}  // namespace asylo
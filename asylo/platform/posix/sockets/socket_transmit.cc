@@ -42,14 +42,16 @@ Status SocketTransmit::Read(int fd, void *buf, size_t read_len) {
           break;
       }
     } else if (!nbytes) {
-      return Status(error::PosixError::P_EPIPE, "connection closed by peer");
+      return Status(error::PosixError::P_EPIPE,
+                    Status::StaticMessage("connection closed by peer"));
     } else {
       read_bytes += nbytes;
       ++read_count_;
     }
   }
   if (read_bytes < read_len) {
-    return Status(static_cast<error::PosixError>(errno), "read error");
+    return Status(static_cast<error::PosixError>(errno),
+                  Status::StaticMessage("read error"));
   }
   return Status::OkStatus();
 }
@@ -74,7 +76,8 @@ Status SocketTransmit::Write(int fd, const void *buf, size_t write_len) {
     }
   }
   if (write_bytes < write_len) {
-    return Status(static_cast<error::PosixError>(errno), "write error");
+    return Status(static_cast<error::PosixError>(errno),
+                  Status::StaticMessage("write error"));
   }
   return Status::OkStatus();
 }
@@ -82,7 +85,7 @@ Status SocketTransmit::Write(int fd, const void *buf, size_t write_len) {
 Status SocketTransmit::RecvMsg(int sockfd, struct msghdr *msg, int flags) {
   if (recvmsg(sockfd, msg, flags) == -1) {
     return Status(static_cast<error::PosixError>(errno),
-                  std::string("recvmsg error:") + strerror(errno));
+                  Status::StaticMessage("recvmsg error"));
   }
   return Status::OkStatus();
 }
@@ -91,7 +94,7 @@ Status SocketTransmit::SendMsg(int sockfd, const struct msghdr *msg,
                                int flags) {
   if (sendmsg(sockfd, msg, flags) == -1) {
     return Status(static_cast<error::PosixError>(errno),
-                  std::string("sendmsg error:") + strerror(errno));
+                  Status::StaticMessage("sendmsg error"));
   }
   return Status::OkStatus();
 }
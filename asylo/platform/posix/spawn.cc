@@ -0,0 +1,179 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+// Implements posix_spawn and posix_spawnp, which the enclave cannot implement
+// with fork and exec, as a single host call carrying the program, its
+// arguments and environment, and the file actions applied in the child.
+//
+// The descriptors the file actions close or duplicate from are translated to
+// the host file descriptors backing them if they are open in the enclave, and
+// otherwise passed to the host unchanged, as they may name descriptors set up
+// by earlier actions in the child. The descriptors actions open or duplicate to
+// are always numbered as in the child. Spawn attributes are not supported.
+
+#include <errno.h>
+#include <spawn.h>
+
+#include <deque>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "asylo/platform/arch/include/trusted/host_calls.h"
+#include "asylo/platform/common/bridge_types.h"
+#include "asylo/platform/common/spawn_request.h"
+#include "asylo/platform/posix/io/io_manager.h"
+
+using asylo::SpawnFileAction;
+using asylo::io::IOManager;
+
+struct __posix_spawn_file_actions {
+  std::vector<SpawnFileAction> actions;
+
+  // Paths of the kOpen actions, which do not move as paths are added.
+  std::deque<std::string> paths;
+};
+
+namespace {
+
+// Returns the host file descriptor backing the enclave file descriptor |fd| if
+// there is one, and |fd| otherwise.
+int TranslateFileDescriptor(int fd) {
+  int host_fd = IOManager::GetInstance().HostFileDescriptor(fd);
+  return host_fd < 0 ? fd : host_fd;
+}
+
+int Spawn(pid_t *pid, const char *path, bool search_path,
+          const posix_spawn_file_actions_t *file_actions,
+          const posix_spawnattr_t *attrp, char *const argv[],
+          char *const envp[]) {
+  if (attrp && *attrp) {
+    return ENOSYS;
+  }
+
+  std::vector<SpawnFileAction> actions;
+  if (file_actions && *file_actions) {
+    actions = (*file_actions)->actions;
+  }
+  for (SpawnFileAction &action : actions) {
+    if (action.type != SpawnFileAction::kOpen) {
+      action.fd = TranslateFileDescriptor(action.fd);
+    }
+  }
+
+  std::string request;
+  asylo::SerializeSpawnRequest(path, search_path, actions.data(),
+                               actions.size(), argv, envp, &request);
+  pid_t child;
+  if (enc_untrusted_posix_spawn(request.data(), request.size(), &child) !=
+      0) {
+    return errno;
+  }
+  if (pid) {
+    *pid = child;
+  }
+  return 0;
+}
+
+// Appends a copy of |action| to |file_actions|.
+int AddFileAction(posix_spawn_file_actions_t *file_actions,
+                  const SpawnFileAction &action) {
+  if (!file_actions || !*file_actions) {
+    return EINVAL;
+  }
+  if (action.fd < 0 ||
+      (action.type == SpawnFileAction::kDup2 && action.new_fd < 0)) {
+    return EBADF;
+  }
+  (*file_actions)->actions.push_back(action);
+  return 0;
+}
+
+}  // namespace
+
+extern "C" {
+
+int posix_spawn(pid_t *pid, const char *path,
+                const posix_spawn_file_actions_t *file_actions,
+                const posix_spawnattr_t *attrp, char *const argv[],
+                char *const envp[]) {
+  return Spawn(pid, path, /*search_path=*/false, file_actions, attrp, argv,
+               envp);
+}
+
+int posix_spawnp(pid_t *pid, const char *file,
+                 const posix_spawn_file_actions_t *file_actions,
+                 const posix_spawnattr_t *attrp, char *const argv[],
+                 char *const envp[]) {
+  return Spawn(pid, file, /*search_path=*/true, file_actions, attrp, argv,
+               envp);
+}
+
+int posix_spawn_file_actions_init(posix_spawn_file_actions_t *file_actions) {
+  *file_actions = new (std::nothrow) __posix_spawn_file_actions;
+  return *file_actions ? 0 : ENOMEM;
+}
+
+int posix_spawn_file_actions_destroy(
+    posix_spawn_file_actions_t *file_actions) {
+  if (!file_actions || !*file_actions) {
+    return EINVAL;
+  }
+  delete *file_actions;
+  *file_actions = nullptr;
+  return 0;
+}
+
+int posix_spawn_file_actions_addclose(posix_spawn_file_actions_t *file_actions,
+                                      int fd) {
+  SpawnFileAction action = {};
+  action.type = SpawnFileAction::kClose;
+  action.fd = fd;
+  return AddFileAction(file_actions, action);
+}
+
+int posix_spawn_file_actions_adddup2(posix_spawn_file_actions_t *file_actions,
+                                     int fd, int new_fd) {
+  SpawnFileAction action = {};
+  action.type = SpawnFileAction::kDup2;
+  action.fd = fd;
+  action.new_fd = new_fd;
+  return AddFileAction(file_actions, action);
+}
+
+int posix_spawn_file_actions_addopen(
+    posix_spawn_file_actions_t *__restrict file_actions, int fd,
+    const char *__restrict path, int flags, mode_t mode) {
+  if (!file_actions || !*file_actions) {
+    return EINVAL;
+  }
+  (*file_actions)->paths.emplace_back(path);
+  SpawnFileAction action = {};
+  action.type = SpawnFileAction::kOpen;
+  action.fd = fd;
+  action.flags = ToBridgeFileFlags(flags);
+  action.mode = mode;
+  action.path = (*file_actions)->paths.back().c_str();
+  int result = AddFileAction(file_actions, action);
+  if (result != 0) {
+    (*file_actions)->paths.pop_back();
+  }
+  return result;
+}
+
+}  // extern "C"
@@ -27,11 +27,13 @@
 #include <unistd.h>
 #include <iostream>
 #include <unordered_set>
+#include <vector>
 
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 #include "absl/strings/str_cat.h"
-#include "asylo/platform/common/bridge_proto_serializer.h"
+#include "absl/strings/str_split.h"
+#include "asylo/platform/common/bridge_flat_serializer.h"
 #include "asylo/platform/posix/syscalls_test.pb.h"
 #include "asylo/test/util/enclave_test.h"
 
@@ -153,7 +155,7 @@ bool SockaddrsEqual(const struct sockaddr *sa1, const struct sockaddr *sa2) {
            (addr1->sin6_port == addr2->sin6_port) &&
            (addr1->sin6_flowinfo == addr2->sin6_flowinfo) &&
            (memcmp(&(addr1->sin6_addr.s6_addr), &(addr2->sin6_addr.s6_addr),
-                   asylo::kIn6AddrNumBytes) == 0) &&
+                   sizeof(addr1->sin6_addr.s6_addr)) == 0) &&
            (addr1->sin6_scope_id == addr2->sin6_scope_id);
   }
   return false;
@@ -280,6 +282,32 @@ TEST_F(SyscallsTest, Mkdir) {
   closedir(directory);
 }
 
+// Tests readdir(). Lists a directory holding more entries than fit in one
+// batch inside the enclave, and checks that every entry is seen exactly once.
+TEST_F(SyscallsTest, Readdir) {
+  const std::string test_dir = absl::StrCat(FLAGS_test_tmpdir, "/readdir");
+  ASSERT_EQ(mkdir(test_dir.c_str(), 0777), 0);
+  std::unordered_set<std::string> expected = {".", ".."};
+  for (int i = 0; i < 2000; ++i) {
+    std::string name = absl::StrCat("file", i);
+    int fd = open(absl::StrCat(test_dir, "/", name).c_str(),
+                  O_CREAT | O_WRONLY, 0644);
+    ASSERT_GE(fd, 0);
+    close(fd);
+    expected.insert(name);
+  }
+
+  SyscallsTestOutput test_output;
+  ASSERT_TRUE(RunSyscallInsideEnclave("readdir", test_dir, &test_output));
+  ASSERT_TRUE(test_output.has_string_syscall_return());
+  std::vector<std::string> names =
+      absl::StrSplit(test_output.string_syscall_return(), '\n',
+                     absl::SkipEmpty());
+  EXPECT_EQ(names.size(), expected.size());
+  EXPECT_EQ(std::unordered_set<std::string>(names.begin(), names.end()),
+            expected);
+}
+
 // Tests dup() and dup2(). Calls dup() and dup2() on a file descriptor, and
 // checks whether the new file descriptor behaves the same as the original one.
 TEST_F(SyscallsTest, Dup) {
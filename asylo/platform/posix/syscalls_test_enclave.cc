@@ -18,6 +18,7 @@
 
 #include <errno.h>
 #include <fcntl.h>
+#include <dirent.h>
 #include <ifaddrs.h>
 #include <regex.h>
 #include <sched.h>
@@ -27,10 +28,11 @@
 #include <unistd.h>
 #include <algorithm>
 #include <unordered_set>
+#include <vector>
 
 #include "absl/strings/str_cat.h"
 #include "asylo/util/logging.h"
-#include "asylo/platform/common/bridge_proto_serializer.h"
+#include "asylo/platform/common/bridge_flat_serializer.h"
 #include "asylo/platform/posix/syscalls_test.pb.h"
 #include "asylo/platform/storage/utils/fd_closer.h"
 #include "asylo/test/util/enclave_test_application.h"
@@ -68,6 +70,8 @@ class SyscallsEnclave : public EnclaveTestCase {
       return RunFcntlTest(test_input.path_name());
     } else if (test_input.test_target() == "mkdir") {
       return RunMkdirTest(test_input.path_name());
+    } else if (test_input.test_target() == "readdir") {
+      return RunReaddirTest(test_input.path_name(), output);
     } else if (test_input.test_target() == "dup") {
       return RunDupTest(test_input.path_name());
     } else if (test_input.test_target() == "gethostname") {
@@ -459,6 +463,63 @@ class SyscallsEnclave : public EnclaveTestCase {
     return Status::OkStatus();
   }
 
+  // Lists the directory at |path|, returning the names of its entries one per
+  // line, and checks that seekdir, telldir and rewinddir return to the entries
+  // seen in the listing.
+  Status RunReaddirTest(const std::string &path, EnclaveOutput *output) {
+    DIR *directory = opendir(path.c_str());
+    if (!directory) {
+      return Status(static_cast<error::GoogleError>(errno),
+                    absl::StrCat("opendir failed:", strerror(errno)));
+    }
+    std::vector<std::string> names;
+    errno = 0;
+    struct dirent *entry;
+    while ((entry = readdir(directory)) != nullptr) {
+      names.push_back(entry->d_name);
+    }
+    if (errno != 0) {
+      closedir(directory);
+      return Status(static_cast<error::GoogleError>(errno),
+                    absl::StrCat("readdir failed:", strerror(errno)));
+    }
+    if (names.empty()) {
+      closedir(directory);
+      return Status(error::GoogleError::INTERNAL, "readdir found no entries");
+    }
+
+    int64_t middle = names.size() / 2;
+    seekdir(directory, middle);
+    entry = readdir(directory);
+    if (!entry || names[middle] != entry->d_name ||
+        telldir(directory) != middle + 1) {
+      closedir(directory);
+      return Status(error::GoogleError::INTERNAL,
+                    "seekdir did not return to the same entry");
+    }
+    rewinddir(directory);
+    entry = readdir(directory);
+    if (!entry || names[0] != entry->d_name) {
+      closedir(directory);
+      return Status(error::GoogleError::INTERNAL,
+                    "rewinddir did not return to the first entry");
+    }
+    if (closedir(directory) != 0) {
+      return Status(static_cast<error::GoogleError>(errno),
+                    absl::StrCat("closedir failed:", strerror(errno)));
+    }
+
+    SyscallsTestOutput output_ret;
+    std::string *listing = output_ret.mutable_string_syscall_return();
+    for (const std::string &name : names) {
+      absl::StrAppend(listing, name, "\n");
+    }
+    if (output) {
+      output->MutableExtension(syscalls_test_output)->CopyFrom(output_ret);
+    }
+    return Status::OkStatus();
+  }
+
   Status RunGetHostNameTest(EnclaveOutput *output) {
     char buf[1024];
     if (gethostname(buf, sizeof(buf)) == -1) {
@@ -1043,6 +1104,7 @@ class SyscallsEnclave : public EnclaveTestCase {
     freeifaddrs(front);
     SyscallsTestOutput output_ret;
     output_ret.set_serialized_proto_return(std::string(serialized_ifaddrs, len));
+    free(serialized_ifaddrs);
     output_ret.set_int_syscall_return(ret);
     if (output) {
       output->MutableExtension(syscalls_test_output)->CopyFrom(output_ret);
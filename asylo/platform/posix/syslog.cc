@@ -26,12 +26,16 @@
 #include <memory>
 
 #include "asylo/platform/arch/include/trusted/host_calls.h"
+#include "asylo/platform/common/bridge_types.h"
+#include "asylo/platform/posix/syslog_batcher.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 void openlog(const char *ident, int option, int facility) {
+  // Buffered messages were logged under the previous settings.
+  asylo::SyslogBatcher::GetInstance().Flush();
   enc_untrusted_openlog(ident, option, facility);
 }
 
@@ -39,12 +43,26 @@ void syslog(int priority, const char *format, ...) {
   va_list args;
   va_start(args, format);
   // Get the size of the formatted string.
-  int size = vsnprintf(nullptr, 0, format, args);
-  // Create a buffer with the same size as the formatted string.
-  std::unique_ptr<char[]> buffer(new char[size]);
+  va_list size_args;
+  va_copy(size_args, args);
+  int size = vsnprintf(nullptr, 0, format, size_args);
+  va_end(size_args);
+  if (size < 0) {
+    va_end(args);
+    return;
+  }
+  // Create a buffer holding the formatted string and its terminating null.
+  std::unique_ptr<char[]> buffer(new char[size + 1]);
   // Reads the formatted string to the buffer.
-  vsnprintf(buffer.get(), size, format, args);
-  enc_untrusted_syslog(priority, buffer.get());
+  vsnprintf(buffer.get(), size + 1, format, args);
+  va_end(args);
+
+  asylo::SyslogBatcher &batcher = asylo::SyslogBatcher::GetInstance();
+  if (!batcher.Log(ToBridgeSysLogPriority(priority), buffer.get(), size)) {
+    enc_untrusted_syslog(priority, buffer.get());
+  } else if (LOG_PRI(priority) <= LOG_CRIT) {
+    batcher.Flush();
+  }
 }
 
 #ifdef __cplusplus
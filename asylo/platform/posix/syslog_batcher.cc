@@ -0,0 +1,107 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/posix/syslog_batcher.h"
+
+#include <utility>
+
+#include "asylo/platform/common/syslog_batch.h"
+
+namespace asylo {
+
+SyslogBatcher::~SyslogBatcher() { Disable(); }
+
+SyslogBatcher &SyslogBatcher::GetInstance() {
+  static SyslogBatcher *instance = new SyslogBatcher;
+  return *instance;
+}
+
+bool SyslogBatcher::Enable(size_t batch_bytes, absl::Duration flush_interval,
+                           Sender sender) {
+  absl::MutexLock control_lock(&control_mu_);
+  {
+    absl::MutexLock send_lock(&send_mu_);
+    absl::MutexLock lock(&mu_);
+    if (enabled_) {
+      return false;
+    }
+    sender_ = std::move(sender);
+    batch_bytes_ = batch_bytes;
+    flush_interval_ = flush_interval;
+    stopping_ = false;
+    enabled_ = true;
+  }
+  flush_thread_ = std::thread(&SyslogBatcher::FlushLoop, this);
+  return true;
+}
+
+void SyslogBatcher::Disable() {
+  absl::MutexLock control_lock(&control_mu_);
+  {
+    absl::MutexLock lock(&mu_);
+    if (!enabled_) {
+      return;
+    }
+    enabled_ = false;
+    stopping_ = true;
+  }
+  flush_thread_.join();
+  Flush();
+}
+
+bool SyslogBatcher::Log(int32_t priority, const char *message, size_t length) {
+  bool full;
+  {
+    absl::MutexLock lock(&mu_);
+    if (!enabled_) {
+      return false;
+    }
+    AppendSyslogRecord(priority, message, length, &records_);
+    full = records_.size() >= batch_bytes_;
+  }
+  if (full) {
+    Flush();
+  }
+  return true;
+}
+
+void SyslogBatcher::Flush() {
+  absl::MutexLock send_lock(&send_mu_);
+  std::vector<uint8_t> records;
+  {
+    absl::MutexLock lock(&mu_);
+    records.swap(records_);
+  }
+  if (!records.empty() && sender_) {
+    sender_(records.data(), records.size());
+  }
+}
+
+void SyslogBatcher::FlushLoop() {
+  while (true) {
+    {
+      absl::MutexLock lock(&mu_);
+      if (mu_.AwaitWithTimeout(absl::Condition(&stopping_), flush_interval_)) {
+        return;
+      }
+    }
+    Flush();
+  }
+}
+
+}  // namespace asylo
@@ -0,0 +1,102 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_PLATFORM_POSIX_SYSLOG_BATCHER_H_
+#define ASYLO_PLATFORM_POSIX_SYSLOG_BATCHER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <thread>
+#include <vector>
+
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+
+namespace asylo {
+
+// Buffers syslog messages inside the enclave and sends them to the host in
+// batches, each with a single host call, so that services logging audit
+// events at a high rate do not leave the enclave for every message.
+//
+// Messages are serialized as described in asylo/platform/common/syslog_batch.h
+// and passed to a sender. A batch is sent when it reaches a size threshold,
+// when a background thread finds it older than the flush interval, and when
+// Flush() is called, which the enclave's syslog does after each message of
+// LOG_CRIT or more severe priority. Batches are sent in the order their
+// messages were logged.
+//
+// All methods are thread-safe.
+class SyslogBatcher {
+ public:
+  // Sends |size| bytes of serialized messages at |records| to the host.
+  using Sender = std::function<void(const uint8_t *records, size_t size)>;
+
+  SyslogBatcher() = default;
+  SyslogBatcher(const SyslogBatcher &) = delete;
+  SyslogBatcher &operator=(const SyslogBatcher &) = delete;
+
+  // Sends any buffered messages and stops the flush thread.
+  ~SyslogBatcher();
+
+  // Returns the batcher used by the enclave's syslog.
+  static SyslogBatcher &GetInstance();
+
+  // Starts buffering messages, which are passed to |sender| in batches of
+  // about |batch_bytes| bytes, and at least every |flush_interval|. Starts a
+  // thread, which an enclave must be configured to allow. Returns false if the
+  // batcher is already enabled.
+  bool Enable(size_t batch_bytes, absl::Duration flush_interval,
+              Sender sender) LOCKS_EXCLUDED(control_mu_, send_mu_, mu_);
+
+  // Sends any buffered messages, stops the flush thread and stops buffering.
+  // Does nothing if the batcher is not enabled.
+  void Disable() LOCKS_EXCLUDED(control_mu_, send_mu_, mu_);
+
+  // Buffers the |length|-byte |message| with the bridge |priority|, and sends
+  // the batch if it has reached the size threshold. Returns false, without
+  // buffering the message, if the batcher is not enabled.
+  bool Log(int32_t priority, const char *message, size_t length)
+      LOCKS_EXCLUDED(send_mu_, mu_);
+
+  // Sends any buffered messages.
+  void Flush() LOCKS_EXCLUDED(send_mu_, mu_);
+
+ private:
+  // Runs Flush() every |flush_interval_| until the batcher is disabled.
+  void FlushLoop() LOCKS_EXCLUDED(send_mu_, mu_);
+
+  // Serializes Enable() and Disable().
+  absl::Mutex control_mu_ ACQUIRED_BEFORE(send_mu_);
+  std::thread flush_thread_ GUARDED_BY(control_mu_);
+
+  // Held while a batch is sent, so that batches reach the host in order.
+  absl::Mutex send_mu_ ACQUIRED_BEFORE(mu_);
+  Sender sender_ GUARDED_BY(send_mu_);
+
+  absl::Mutex mu_;
+  bool enabled_ GUARDED_BY(mu_) = false;
+  bool stopping_ GUARDED_BY(mu_) = false;
+  size_t batch_bytes_ GUARDED_BY(mu_) = 0;
+  absl::Duration flush_interval_ GUARDED_BY(mu_);
+  std::vector<uint8_t> records_ GUARDED_BY(mu_);
+};
+
+}  // namespace asylo
+
+#endif  // ASYLO_PLATFORM_POSIX_SYSLOG_BATCHER_H_
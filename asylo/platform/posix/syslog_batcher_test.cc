@@ -0,0 +1,130 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/posix/syslog_batcher.h"
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include "absl/synchronization/mutex.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "asylo/platform/common/syslog_batch.h"
+
+namespace asylo {
+namespace {
+
+using ::testing::ElementsAre;
+using ::testing::IsEmpty;
+using ::testing::Pair;
+
+// Records the messages of each batch passed to its sender.
+class BatchRecorder {
+ public:
+  SyslogBatcher::Sender sender() {
+    return [this](const uint8_t *records, size_t size) {
+      std::vector<std::pair<int32_t, std::string>> batch;
+      EXPECT_TRUE(ForEachSyslogRecord(
+          records, size,
+          [&batch](int32_t priority, const char *message, size_t length) {
+            batch.emplace_back(priority, std::string(message, length));
+          }));
+      absl::MutexLock lock(&mu_);
+      batches_.push_back(std::move(batch));
+    };
+  }
+
+  std::vector<std::vector<std::pair<int32_t, std::string>>> batches() {
+    absl::MutexLock lock(&mu_);
+    return batches_;
+  }
+
+ private:
+  absl::Mutex mu_;
+  std::vector<std::vector<std::pair<int32_t, std::string>>> batches_;
+};
+
+// Logs |message| with |priority| to |batcher|.
+bool Log(SyslogBatcher *batcher, int32_t priority, const std::string &message) {
+  return batcher->Log(priority, message.data(), message.size());
+}
+
+TEST(SyslogBatcherTest, LogFailsUnlessEnabled) {
+  SyslogBatcher batcher;
+  EXPECT_FALSE(Log(&batcher, 6, "message"));
+
+  BatchRecorder recorder;
+  ASSERT_TRUE(batcher.Enable(1024, absl::Hours(1), recorder.sender()));
+  EXPECT_FALSE(batcher.Enable(1024, absl::Hours(1), recorder.sender()));
+  EXPECT_TRUE(Log(&batcher, 6, "message"));
+  batcher.Disable();
+  EXPECT_FALSE(Log(&batcher, 6, "late message"));
+  EXPECT_THAT(recorder.batches(),
+              ElementsAre(ElementsAre(Pair(6, "message"))));
+}
+
+TEST(SyslogBatcherTest, SendsBatchAtSizeThreshold) {
+  SyslogBatcher batcher;
+  BatchRecorder recorder;
+  ASSERT_TRUE(batcher.Enable(SyslogRecordSize(5) * 3, absl::Hours(1),
+                             recorder.sender()));
+  EXPECT_TRUE(Log(&batcher, 1, "first"));
+  EXPECT_TRUE(Log(&batcher, 2, "other"));
+  EXPECT_THAT(recorder.batches(), IsEmpty());
+  EXPECT_TRUE(Log(&batcher, 3, "third"));
+  EXPECT_TRUE(Log(&batcher, 4, ""));
+  EXPECT_THAT(recorder.batches(),
+              ElementsAre(ElementsAre(Pair(1, "first"), Pair(2, "other"),
+                                      Pair(3, "third"))));
+
+  batcher.Flush();
+  EXPECT_THAT(recorder.batches().back(), ElementsAre(Pair(4, "")));
+  batcher.Flush();
+  EXPECT_EQ(recorder.batches().size(), 2);
+}
+
+TEST(SyslogBatcherTest, SendsBatchAfterFlushInterval) {
+  SyslogBatcher batcher;
+  BatchRecorder recorder;
+  ASSERT_TRUE(
+      batcher.Enable(1024, absl::Milliseconds(10), recorder.sender()));
+  EXPECT_TRUE(Log(&batcher, 6, "message"));
+  absl::Time deadline = absl::Now() + absl::Seconds(30);
+  while (recorder.batches().empty() && absl::Now() < deadline) {
+    absl::SleepFor(absl::Milliseconds(1));
+  }
+  EXPECT_THAT(recorder.batches(),
+              ElementsAre(ElementsAre(Pair(6, "message"))));
+}
+
+TEST(SyslogBatchTest, RejectsTruncatedRecord) {
+  std::vector<uint8_t> batch;
+  AppendSyslogRecord(6, "message", 7, &batch);
+  batch.resize(batch.size() - SyslogRecordSize(0));
+  int visited = 0;
+  EXPECT_FALSE(ForEachSyslogRecord(
+      batch.data(), batch.size(),
+      [&visited](int32_t, const char *, size_t) { ++visited; }));
+  EXPECT_EQ(visited, 0);
+}
+
+}  // namespace
+}  // namespace asylo
@@ -18,16 +18,28 @@
 
 #include "asylo/platform/posix/threading/thread_manager.h"
 
+#include <errno.h>
+
 #include <algorithm>
 #include <cstdlib>
 #include <memory>
+#include <new>
 
 #include "asylo/platform/arch/include/trusted/host_calls.h"
 #include "asylo/platform/core/trusted_global_state.h"
+#include "asylo/platform/posix/threading/thread_specific.h"
 
 namespace asylo {
 
-ThreadManager::Thread::Thread() {
+ThreadManager::Thread::Thread()
+    : arg(nullptr),
+      ret(nullptr),
+      thread_id(PTHREAD_T_NULL),
+      state(ThreadState::JOINED),
+      detached(false),
+      references(0),
+      index(0),
+      next(nullptr) {
   this->lock = PTHREAD_MUTEX_INITIALIZER;
   this->state_change_cond = PTHREAD_COND_INITIALIZER;
 }
@@ -47,9 +59,22 @@ int ThreadManager::Thread::UpdateThreadState(pthread_t thread_id,
   return pthread_mutex_unlock(&this->lock);
 }
 
-ThreadManager::ThreadManager() {
+constexpr int ThreadManager::kMaxThreads;
+constexpr int ThreadManager::kThreadSlabSize;
+
+ThreadManager::ThreadManager()
+    : queued_threads_(nullptr),
+      last_queued_thread_(nullptr),
+      parked_thread_limit_(0),
+      idle_threads_(0),
+      pending_wakeups_(0),
+      allocated_threads_(0),
+      free_threads_(nullptr),
+      running_threads_(0) {
   this->threads_lock_ = PTHREAD_MUTEX_INITIALIZER;
   this->scheduled_lock_ = PTHREAD_MUTEX_INITIALIZER;
+  this->parked_cond_ = PTHREAD_COND_INITIALIZER;
+  joinable_threads_.fill(PTHREAD_T_NULL);
 }
 
 ThreadManager *ThreadManager::GetInstance() {
@@ -57,41 +82,57 @@ ThreadManager *ThreadManager::GetInstance() {
   return instance;
 }
 
-std::shared_ptr<ThreadManager::Thread> ThreadManager::QueueThread(
-    const std::function<void *(void *)> &function, void *arg) {
-  LockQueuedThreads();
-  queued_threads_.emplace(std::make_shared<Thread>());
-  std::shared_ptr<Thread> thread = queued_threads_.back();
+ThreadManager::Thread *ThreadManager::QueueThread(
+    const std::function<void *(void *)> &function, void *arg, bool detached) {
+  LockThreadsList();
+  Thread *thread = AllocateThread();
+  UnlockThreadsList();
   if (!thread) {
-    UnlockQueuedThreads();
     return nullptr;
   }
 
+  // The descriptor is not visible to other threads until it is queued.
   thread->state = Thread::ThreadState::QUEUED;
   thread->start_routine = function;
   thread->arg = arg;
-  thread->lock = PTHREAD_MUTEX_INITIALIZER;
+  thread->ret = nullptr;
+  thread->detached = detached;
+  thread->references = 2;
+  thread->next = nullptr;
+
+  LockQueuedThreads();
+  if (last_queued_thread_) {
+    last_queued_thread_->next = thread;
+  } else {
+    queued_threads_ = thread;
+  }
+  last_queued_thread_ = thread;
   UnlockQueuedThreads();
   return thread;
 }
 
 int ThreadManager::CreateThread(const std::function<void *(void *)> &function,
-                                void *arg, pthread_t *thread_id) {
+                                void *arg, bool detached,
+                                pthread_t *thread_id) {
   // Add thread entry point to queue of waiting jobs.
-  std::shared_ptr<Thread> thread = QueueThread(function, arg);
+  Thread *thread = QueueThread(function, arg, detached);
   if (!thread) {
+    return EAGAIN;
+  }
+
+  // Wake a parked thread to run the job if there is one. Otherwise, exit and
+  // create a thread to enter with EnterAndDonateThread().
+  if (!WakeParkedThread() &&
+      enc_untrusted_create_thread(GetEnclaveName().c_str())) {
+    ReleaseThread(thread);
     return -1;
   }
+
   int ret = pthread_mutex_lock(&thread->lock);
   if (ret != 0) {
     return ret;
   }
 
-  // Exit and create a thread to enter with EnterAndDonateThread().
-  if (enc_untrusted_create_thread(GetEnclaveName().c_str())) {
-    return -1;
-  }
-
   // Wait until a thread enters and executes the job.
   while (thread->state == Thread::ThreadState::QUEUED) {
     if (pthread_cond_wait(&thread->state_change_cond, &thread->lock)) {
@@ -103,64 +144,166 @@ int ThreadManager::CreateThread(const std::function<void *(void *)> &function,
     *thread_id = thread->thread_id;
   }
 
-  return pthread_mutex_unlock(&thread->lock);
+  ret = pthread_mutex_unlock(&thread->lock);
+  ReleaseThread(thread);
+  return ret;
 }
 
 int ThreadManager::StartThread() {
-  LockQueuedThreads();
-  // If there are no jobs waiting to be executed, abort.
-  if (queued_threads_.empty()) {
-    UnlockQueuedThreads();
-    abort();
+  bool ran_job = false;
+  while (true) {
+    LockQueuedThreads();
+    if (!queued_threads_) {
+      bool woken = ParkThread();
+      if (!woken && !ran_job && parked_thread_limit_ == 0) {
+        // A thread was donated with no job waiting to be executed.
+        UnlockQueuedThreads();
+        abort();
+      }
+      UnlockQueuedThreads();
+      if (!woken) {
+        return 0;
+      }
+      // The job this thread was woken for may have been taken by a thread
+      // donated in the meantime, so check the queue again.
+      continue;
+    }
+    int ret = RunQueuedThread();
+    if (ret != 0) {
+      return ret;
+    }
+    ran_job = true;
   }
+}
 
-  LockThreadsList();
-  // Move Thread from queued_threads_ onto threads_.
-  std::shared_ptr<Thread> thread = AllocateThread(queued_threads_.front());
-  queued_threads_.pop();
-  UnlockQueuedThreads();
-  UnlockThreadsList();
-  if (!thread) {
-    return -1;
+int ThreadManager::RunQueuedThread() {
+  Thread *thread = queued_threads_;
+  queued_threads_ = thread->next;
+  if (!queued_threads_) {
+    last_queued_thread_ = nullptr;
   }
+  UnlockQueuedThreads();
 
+  // A thread detached when it was created is never joinable. Otherwise, only
+  // the running thread registers the descriptor, so |detached| is not yet
+  // shared.
   pthread_t self = pthread_self();
+  LockThreadsList();
+  ++running_threads_;
+  if (!thread->detached) {
+    joinable_threads_[thread->index] = self;
+  }
+  UnlockThreadsList();
+
   int ret = thread->UpdateThreadState(self, Thread::ThreadState::RUNNING);
   if (ret != 0) {
     return ret;
   }
 
-  // Run the job.
+  // Run the job, then destroy its thread-specific values before it is
+  // reported done, so that joining threads observe their destructors.
   thread->ret = thread->start_routine(thread->arg);
+  RunThreadSpecificDestructors();
 
-  ret = thread->UpdateThreadState(self, Thread::ThreadState::DONE);
-  if (ret != 0) {
-    return ret;
-  }
-
-  // Wait until the thread is joined.
+  // Report the job done, and wait until it is joined unless it is detached.
   ret = pthread_mutex_lock(&thread->lock);
   if (ret != 0) {
     return ret;
   }
-  while (thread->state != Thread::ThreadState::JOINED) {
+  thread->state = Thread::ThreadState::DONE;
+  if (pthread_cond_broadcast(&thread->state_change_cond)) {
+    abort();
+  }
+  while (thread->state != Thread::ThreadState::JOINED && !thread->detached) {
     if (pthread_cond_wait(&thread->state_change_cond, &thread->lock)) {
       abort();
     }
   }
+  ret = pthread_mutex_unlock(&thread->lock);
+  if (ret != 0) {
+    return ret;
+  }
 
+  LockThreadsList();
+  --running_threads_;
+  UnlockThreadsList();
+  ReleaseThread(thread);
   return 0;
 }
 
+void ThreadManager::SetParkedThreadLimit(int limit) {
+  LockQueuedThreads();
+  parked_thread_limit_ = limit;
+  UnlockQueuedThreads();
+}
+
+void ThreadManager::ReleaseParkedThreads() {
+  LockQueuedThreads();
+  parked_thread_limit_ = 0;
+  if (pthread_cond_broadcast(&parked_cond_) != 0) {
+    abort();
+  }
+  UnlockQueuedThreads();
+}
+
+bool ThreadManager::ParkThread() {
+  if (idle_threads_ + pending_wakeups_ >= parked_thread_limit_) {
+    return false;
+  }
+  ++idle_threads_;
+  while (pending_wakeups_ == 0 && parked_thread_limit_ > 0) {
+    if (pthread_cond_wait(&parked_cond_, &scheduled_lock_)) {
+      abort();
+    }
+  }
+  if (pending_wakeups_ == 0) {
+    // Released by ReleaseParkedThreads().
+    --idle_threads_;
+    return false;
+  }
+  // The waking thread has already moved this thread from idle_threads_.
+  --pending_wakeups_;
+  return true;
+}
+
+bool ThreadManager::WakeParkedThread() {
+  LockQueuedThreads();
+  bool woken = idle_threads_ > 0;
+  if (woken) {
+    --idle_threads_;
+    ++pending_wakeups_;
+    if (pthread_cond_signal(&parked_cond_) != 0) {
+      abort();
+    }
+  }
+  UnlockQueuedThreads();
+  return woken;
+}
+
+int ThreadManager::GetParkedThreadCount() {
+  LockQueuedThreads();
+  int count = idle_threads_;
+  UnlockQueuedThreads();
+  return count;
+}
+
+int ThreadManager::GetRunningThreadCount() {
+  LockThreadsList();
+  int count = running_threads_;
+  UnlockThreadsList();
+  return count;
+}
+
 int ThreadManager::JoinThread(pthread_t thread_id, void **return_value) {
   LockThreadsList();
-  std::shared_ptr<Thread> thread = GetThread(thread_id);
+  Thread *thread = ClaimThread(thread_id);
   UnlockThreadsList();
   if (!thread) {
     return -1;
   }
 
-  // Wait until the job is finished executing.
+  // Wait until the job is finished executing. The running thread keeps the
+  // descriptor until it observes the JOINED state.
   int ret = pthread_mutex_lock(&thread->lock);
   if (ret != 0) {
     return ret;
@@ -180,34 +323,84 @@ int ThreadManager::JoinThread(pthread_t thread_id, void **return_value) {
     return ret;
   }
 
-  ret = thread->UpdateThreadState(thread_id, Thread::ThreadState::JOINED);
+  return thread->UpdateThreadState(thread_id, Thread::ThreadState::JOINED);
+}
+
+int ThreadManager::DetachThread(pthread_t thread_id) {
+  LockThreadsList();
+  Thread *thread = ClaimThread(thread_id);
+  UnlockThreadsList();
+  if (!thread) {
+    return ESRCH;
+  }
+
+  int ret = pthread_mutex_lock(&thread->lock);
   if (ret != 0) {
     return ret;
   }
-
-  return 0;
+  thread->detached = true;
+  if (pthread_cond_broadcast(&thread->state_change_cond)) {
+    abort();
+  }
+  return pthread_mutex_unlock(&thread->lock);
 }
 
-std::shared_ptr<ThreadManager::Thread> ThreadManager::AllocateThread(
-    std::shared_ptr<Thread> thread) {
-  pthread_t thread_id = pthread_self();
-  threads_[thread_id] = thread;
+ThreadManager::Thread *ThreadManager::AllocateThread() {
+  if (!free_threads_) {
+    if (allocated_threads_ == kMaxThreads) {
+      return nullptr;
+    }
+    std::unique_ptr<Thread[]> &slab =
+        slabs_[allocated_threads_ / kThreadSlabSize];
+    slab.reset(new (std::nothrow) Thread[kThreadSlabSize]);
+    if (!slab) {
+      return nullptr;
+    }
+    for (int i = kThreadSlabSize - 1; i >= 0; --i) {
+      slab[i].index = allocated_threads_ + i;
+      slab[i].next = free_threads_;
+      free_threads_ = &slab[i];
+    }
+    allocated_threads_ += kThreadSlabSize;
+  }
 
-  int ret = thread->UpdateThreadState(thread_id, Thread::ThreadState::RUNNING);
-  if (ret != 0) {
+  Thread *thread = free_threads_;
+  free_threads_ = thread->next;
+  return thread;
+}
+
+void ThreadManager::ReleaseThread(Thread *thread) {
+  if (pthread_mutex_lock(&thread->lock) != 0) {
     abort();
   }
+  bool last_reference = --thread->references == 0;
+  if (pthread_mutex_unlock(&thread->lock) != 0) {
+    abort();
+  }
+  if (!last_reference) {
+    return;
+  }
 
-  return thread;
+  // Drop anything captured by the start_routine now rather than when the
+  // descriptor is reused.
+  thread->start_routine = nullptr;
+  LockThreadsList();
+  thread->next = free_threads_;
+  free_threads_ = thread;
+  UnlockThreadsList();
 }
 
-std::shared_ptr<ThreadManager::Thread> ThreadManager::GetThread(
-    pthread_t thread_id) {
-  std::shared_ptr<Thread> ret = nullptr;
-  if (threads_.find(thread_id) != threads_.end()) {
-    ret = threads_[thread_id];
+ThreadManager::Thread *ThreadManager::ClaimThread(pthread_t thread_id) {
+  if (thread_id == PTHREAD_T_NULL) {
+    return nullptr;
   }
-  return ret;
+  for (int i = 0; i < allocated_threads_; ++i) {
+    if (joinable_threads_[i] == thread_id) {
+      joinable_threads_[i] = PTHREAD_T_NULL;
+      return &slabs_[i / kThreadSlabSize][i % kThreadSlabSize];
+    }
+  }
+  return nullptr;
 }
 
 void ThreadManager::LockThreadsList() {
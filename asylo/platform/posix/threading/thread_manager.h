@@ -20,36 +20,75 @@
 #define ASYLO_PLATFORM_POSIX_THREADING_THREAD_MANAGER_H_
 
 #include <pthread.h>
+#include <array>
 #include <functional>
 #include <memory>
-#include <queue>
-#include <unordered_map>
-#include <utility>
 
 namespace asylo {
 
 // ThreadManager class is a singleton responsible for:
 // - Maintaining a queue of thread start_routine functions.
+// - Keeping a pool of idle donated threads parked inside the enclave, which
+//   are woken to run new start_routines without exiting the enclave.
+//
+// Each start_routine is tracked by a thread descriptor taken from slabs which
+// are allocated as the number of threads grows and are never freed. Released
+// descriptors are kept on an intrusive free list and recycled, so creating and
+// joining threads does not allocate once the enclave has reached its peak
+// number of threads.
 class ThreadManager {
  public:
+  // Maximum number of threads tracked at once. Every running thread and every
+  // thread waiting to be joined occupies a TCS, as does the creator of each
+  // queued thread, so the limit is set well above the TCS count of enclaves.
+  static constexpr int kMaxThreads = 2048;
+
   static ThreadManager *GetInstance();
 
   // Adds the given |function| to a start_routine queue of functions waiting to
   // be run by the pthreads implementation. |arg| will be saved to pass to the
   // start_routine. |thread_id| will be updated to the pthread_t of the created
-  // thread.
+  // thread. If |detached| is true, the resources of the thread are released
+  // when it returns, and it cannot be joined. Returns EAGAIN if kMaxThreads
+  // threads are already tracked.
   int CreateThread(const std::function<void *(void *)> &function, void *arg,
-                   pthread_t *thread_id);
-
-  // Removes a function from the start_routine queue and runs it. If no
-  // start_routine is present this function will abort().
+                   bool detached, pthread_t *thread_id);
+
+  // Removes a function from the start_routine queue and runs it. Once the
+  // start_routine has been joined or detached, or if none is present, the
+  // calling thread parks itself to wait for further start_routines while fewer
+  // than the configured number of threads are parked, and returns otherwise.
+  // If no start_routine is present and the thread cannot be parked, this
+  // function will abort().
   int StartThread();
 
+  // Sets the maximum number of idle threads kept parked by StartThread().
+  void SetParkedThreadLimit(int limit);
+
+  // Stops parking idle threads and makes all currently parked threads return
+  // from StartThread().
+  void ReleaseParkedThreads();
+
   // Waits till given |thread_id| has returned and assigns its returned void* to
   // |return_value|.
   int JoinThread(pthread_t thread_id, void **return_value);
 
+  // Marks |thread_id| as detached, so that its resources are released when it
+  // returns without being joined. Returns ESRCH if |thread_id| is not a
+  // joinable thread.
+  int DetachThread(pthread_t thread_id);
+
+  // Returns the number of idle threads parked inside the enclave.
+  int GetParkedThreadCount();
+
+  // Returns the number of start_routines which are running or waiting to be
+  // joined.
+  int GetRunningThreadCount();
+
  private:
+  // Number of thread descriptors allocated at once.
+  static constexpr int kThreadSlabSize = 32;
+
   ThreadManager();
   ThreadManager(ThreadManager const &) = delete;
   void operator=(ThreadManager const &) = delete;
@@ -75,28 +114,60 @@ class ThreadManager {
     pthread_t thread_id;
     ThreadState state;
 
+    // Whether the thread is released without being joined.
+    bool detached;
+
+    // Number of the creating and running threads which still use the
+    // descriptor. It is released when the count drops to zero.
+    int references;
+
+    // Position of the descriptor in the table of ThreadManager.
+    int index;
+
+    // Next descriptor in queued_threads_ or in the free list, guarded by the
+    // lock of that list.
+    Thread *next;
+
     // Requires lock is held. Updates the state and broadcasts to
     // state_change_cond and releases the lock.
     int UpdateThreadState(pthread_t thread_id, ThreadState state);
   };
 
-  // Creates a Thread for the given parameters, adds it to the queued_threads_
-  // queue then returns a pointer to it.
-  std::shared_ptr<Thread> QueueThread(
-      const std::function<void *(void *)> &function, void *arg);
+  // Requires LockQueuedThreads(), which it releases. Runs the first queued
+  // start_routine and waits until it is joined or detached.
+  int RunQueuedThread();
 
-  // Adds given |thread| to the threads_ list, sets its state to RUNNING, and
-  // returns its thread_id.
-  std::shared_ptr<Thread> AllocateThread(std::shared_ptr<Thread> thread);
+  // Requires LockQueuedThreads(). Parks the calling thread until it is woken
+  // to run a queued start_routine or released. Returns false if the thread may
+  // not be parked or was released.
+  bool ParkThread();
 
-  // Returns a Thread pointer for a given |thread_id|. Requires
-  // LockQueuedThreads().
-  std::shared_ptr<Thread> GetThread(pthread_t thread_id);
+  // Hands the most recently queued start_routine to a parked thread. Returns
+  // false if no thread is parked.
+  bool WakeParkedThread();
 
-  // Locks threads_.
+  // Takes a descriptor for the given parameters, adds it to the end of
+  // queued_threads_ and returns it, or returns nullptr if none is available.
+  Thread *QueueThread(const std::function<void *(void *)> &function, void *arg,
+                      bool detached);
+
+  // Returns a descriptor taken from the free list, allocating a slab if the
+  // list is empty, or nullptr if kMaxThreads descriptors are in use. Requires
+  // LockThreadsList().
+  Thread *AllocateThread();
+
+  // Drops a reference to |thread|, returning it to the free list if it was the
+  // last one.
+  void ReleaseThread(Thread *thread);
+
+  // Returns the joinable thread |thread_id| and makes it no longer joinable,
+  // or returns nullptr if there is none. Requires LockThreadsList().
+  Thread *ClaimThread(pthread_t thread_id);
+
+  // Locks the thread table.
   void LockThreadsList();
 
-  // Unlocks threads_.
+  // Unlocks the thread table.
   void UnlockThreadsList();
 
   // Locks queued_threads_.
@@ -108,16 +179,46 @@ class ThreadManager {
   // Guards queued_threads_.
   pthread_mutex_t scheduled_lock_;
 
-  // Queue of start_routines waiting to be run.
-  // std::shared_ptr is documented to use atomic increments/decrements to manage
-  // a refcount instead of using a mutex.
-  std::queue<std::shared_ptr<Thread>> queued_threads_;
+  // First and last of the start_routines waiting to be run, linked through
+  // Thread::next.
+  Thread *queued_threads_;
+  Thread *last_queued_thread_;
+
+  // Signalled when a parked thread is handed a start_routine or released.
+  // Guarded by scheduled_lock_, as are the counters below.
+  pthread_cond_t parked_cond_;
+
+  // Maximum number of threads parked at a time.
+  int parked_thread_limit_;
 
-  // Guards threads_.
+  // Number of parked threads which have not been handed a start_routine.
+  int idle_threads_;
+
+  // Number of start_routines handed to parked threads which have not been
+  // picked up yet.
+  int pending_wakeups_;
+
+  // Guards the members below.
   pthread_mutex_t threads_lock_;
 
-  // List of currently running threads or threads waiting to be joined.
-  std::unordered_map<pthread_t, std::shared_ptr<Thread>> threads_;
+  // Slabs of thread descriptors. Descriptor |i| is entry i % kThreadSlabSize
+  // of slab i / kThreadSlabSize.
+  std::array<std::unique_ptr<Thread[]>, kMaxThreads / kThreadSlabSize> slabs_;
+
+  // Number of descriptors in allocated slabs.
+  int allocated_threads_;
+
+  // Released descriptors, linked through Thread::next.
+  Thread *free_threads_;
+
+  // pthread_t of the running joinable thread using each descriptor, or
+  // PTHREAD_T_NULL if the descriptor is not used by one. pthread_t values are
+  // addresses of SGX thread data rather than small integers, so joins scan the
+  // allocated prefix of the table.
+  std::array<pthread_t, kMaxThreads> joinable_threads_;
+
+  // Number of start_routines which are running or waiting to be joined.
+  int running_threads_;
 };
 
 }  // namespace asylo
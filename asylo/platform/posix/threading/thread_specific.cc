@@ -0,0 +1,157 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/posix/threading/thread_specific.h"
+
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+
+#include "asylo/platform/common/spin_lock.h"
+
+namespace asylo {
+namespace {
+
+constexpr int kIndexBits = 7;
+constexpr uint32_t kIndexMask = (1u << kIndexBits) - 1;
+
+static_assert(kMaxThreadSpecificKeys == 1 << kIndexBits,
+              "Key indices must cover exactly kMaxThreadSpecificKeys slots");
+
+// Generations wrap within the bits of a key left over by the index. A stale
+// value only becomes visible again after an index is reused 2^24 times.
+constexpr uint32_t kGenerationMask = UINT32_MAX >> kIndexBits;
+
+// A key index. Its generation is odd while a key holds the index, and even
+// while the index is free.
+struct KeyRecord {
+  std::atomic<uint32_t> generation;
+  std::atomic<void (*)(void *)> destructor;
+};
+
+KeyRecord keys[kMaxThreadSpecificKeys];
+
+// Guards creation and deletion of keys.
+SpinLock keys_lock;
+
+// The value of a key index in a thread, and the generation of the key which
+// set it. A zeroed slot never matches a key, whose generation is odd.
+struct Slot {
+  void *value;
+  uint32_t generation;
+};
+
+thread_local Slot slots[kMaxThreadSpecificKeys];
+
+uint32_t KeyIndex(pthread_key_t key) {
+  return static_cast<uint32_t>(key) & kIndexMask;
+}
+
+uint32_t KeyGeneration(pthread_key_t key) {
+  return static_cast<uint32_t>(key) >> kIndexBits;
+}
+
+}  // namespace
+
+int ThreadSpecificKeyCreate(pthread_key_t *key, void (*destructor)(void *)) {
+  keys_lock.Acquire();
+  for (uint32_t index = 0; index < kMaxThreadSpecificKeys; ++index) {
+    uint32_t generation =
+        keys[index].generation.load(std::memory_order_relaxed);
+    if (generation % 2 == 1) {
+      continue;
+    }
+    generation = (generation + 1) & kGenerationMask;
+    keys[index].destructor.store(destructor, std::memory_order_relaxed);
+    keys[index].generation.store(generation, std::memory_order_release);
+    keys_lock.Release();
+    *key = static_cast<pthread_key_t>((generation << kIndexBits) | index);
+    return 0;
+  }
+  keys_lock.Release();
+  return EAGAIN;
+}
+
+int ThreadSpecificKeyDelete(pthread_key_t key) {
+  uint32_t index = KeyIndex(key);
+  uint32_t generation = KeyGeneration(key);
+  keys_lock.Acquire();
+  if (keys[index].generation.load(std::memory_order_relaxed) != generation ||
+      generation % 2 == 0) {
+    keys_lock.Release();
+    return EINVAL;
+  }
+  keys[index].destructor.store(nullptr, std::memory_order_relaxed);
+  keys[index].generation.store((generation + 1) & kGenerationMask,
+                               std::memory_order_release);
+  keys_lock.Release();
+  return 0;
+}
+
+void *GetThreadSpecific(pthread_key_t key) {
+  const Slot &slot = slots[KeyIndex(key)];
+  return slot.generation == KeyGeneration(key) ? slot.value : nullptr;
+}
+
+int SetThreadSpecific(pthread_key_t key, const void *value) {
+  uint32_t index = KeyIndex(key);
+  uint32_t generation = KeyGeneration(key);
+  if (keys[index].generation.load(std::memory_order_acquire) != generation ||
+      generation % 2 == 0) {
+    return EINVAL;
+  }
+  slots[index].value = const_cast<void *>(value);
+  slots[index].generation = generation;
+  return 0;
+}
+
+void RunThreadSpecificDestructors() {
+  // Destructors may set values again, which calls for a further pass.
+  for (int i = 0; i < kThreadSpecificDestructorIterations; ++i) {
+    bool ran_destructor = false;
+    for (uint32_t index = 0; index < kMaxThreadSpecificKeys; ++index) {
+      Slot &slot = slots[index];
+      if (!slot.value) {
+        continue;
+      }
+      uint32_t generation =
+          keys[index].generation.load(std::memory_order_acquire);
+      void (*destructor)(void *) =
+          keys[index].destructor.load(std::memory_order_acquire);
+      // Skip values of deleted keys, and keys deleted or recreated while their
+      // destructor was read.
+      if (slot.generation != generation || !destructor ||
+          keys[index].generation.load(std::memory_order_acquire) !=
+              generation) {
+        continue;
+      }
+      void *value = slot.value;
+      slot.value = nullptr;
+      destructor(value);
+      ran_destructor = true;
+    }
+    if (!ran_destructor) {
+      break;
+    }
+  }
+  for (Slot &slot : slots) {
+    slot = Slot{nullptr, 0};
+  }
+}
+
+}  // namespace asylo
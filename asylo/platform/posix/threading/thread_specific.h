@@ -0,0 +1,67 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_PLATFORM_POSIX_THREADING_THREAD_SPECIFIC_H_
+#define ASYLO_PLATFORM_POSIX_THREADING_THREAD_SPECIFIC_H_
+
+#include <pthread.h>
+
+namespace asylo {
+
+// Thread-specific data keys backing pthread_key_create() and friends.
+//
+// Each thread holds a fixed array of kMaxThreadSpecificKeys slots, indexed by
+// the low bits of a key, so getting and setting a value costs an array access.
+// The remaining bits of a key hold the generation of its index, which changes
+// whenever a key is created or deleted. A slot remembers the generation it was
+// set under, so values set under a deleted key are never visible through a key
+// which later reuses its index.
+
+// The maximum number of keys which may exist at a time. This is the minimum
+// POSIX allows for PTHREAD_KEYS_MAX.
+constexpr int kMaxThreadSpecificKeys = 128;
+
+// The maximum number of times RunThreadSpecificDestructors() passes over the
+// keys of a thread. This is PTHREAD_DESTRUCTOR_ITERATIONS.
+constexpr int kThreadSpecificDestructorIterations = 4;
+
+// Creates a key in |*key| with an optional |destructor|. Returns EAGAIN if
+// kMaxThreadSpecificKeys keys already exist.
+int ThreadSpecificKeyCreate(pthread_key_t *key, void (*destructor)(void *));
+
+// Deletes |key| without running its destructor. Returns EINVAL if |key| does
+// not exist.
+int ThreadSpecificKeyDelete(pthread_key_t key);
+
+// Returns the value of |key| for the calling thread, or nullptr if none was
+// set.
+void *GetThreadSpecific(pthread_key_t key);
+
+// Sets the value of |key| for the calling thread. Returns EINVAL if |key| does
+// not exist.
+int SetThreadSpecific(pthread_key_t key, const void *value);
+
+// Runs the destructors of the keys of the calling thread which hold a value,
+// as a finishing thread does, then clears all of its values. Since enclave
+// threads are reused to run further start routines, this leaves the thread as
+// if it were new.
+void RunThreadSpecificDestructors();
+
+}  // namespace asylo
+
+#endif  // ASYLO_PLATFORM_POSIX_THREADING_THREAD_SPECIFIC_H_
@@ -0,0 +1,159 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/posix/threading/thread_specific.h"
+
+#include <cerrno>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace asylo {
+namespace {
+
+int destructor_calls = 0;
+void *destroyed_value = nullptr;
+
+void CountingDestructor(void *value) {
+  ++destructor_calls;
+  destroyed_value = value;
+}
+
+pthread_key_t resetting_key;
+int resets_left = 0;
+
+// Sets its value again a bounded number of times.
+void ResettingDestructor(void *value) {
+  ++destructor_calls;
+  if (resets_left-- > 0) {
+    SetThreadSpecific(resetting_key, value);
+  }
+}
+
+class ThreadSpecificTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    destructor_calls = 0;
+    destroyed_value = nullptr;
+  }
+
+  void TearDown() override { RunThreadSpecificDestructors(); }
+};
+
+TEST_F(ThreadSpecificTest, SetAndGet) {
+  pthread_key_t key;
+  ASSERT_EQ(ThreadSpecificKeyCreate(&key, nullptr), 0);
+  int value;
+  EXPECT_EQ(GetThreadSpecific(key), nullptr);
+  ASSERT_EQ(SetThreadSpecific(key, &value), 0);
+  EXPECT_EQ(GetThreadSpecific(key), &value);
+  ASSERT_EQ(SetThreadSpecific(key, nullptr), 0);
+  EXPECT_EQ(GetThreadSpecific(key), nullptr);
+  EXPECT_EQ(ThreadSpecificKeyDelete(key), 0);
+}
+
+TEST_F(ThreadSpecificTest, ValuesArePerThread) {
+  pthread_key_t key;
+  ASSERT_EQ(ThreadSpecificKeyCreate(&key, nullptr), 0);
+  int main_value;
+  int other_value;
+  ASSERT_EQ(SetThreadSpecific(key, &main_value), 0);
+  std::thread other([key, &other_value] {
+    EXPECT_EQ(GetThreadSpecific(key), nullptr);
+    EXPECT_EQ(SetThreadSpecific(key, &other_value), 0);
+    EXPECT_EQ(GetThreadSpecific(key), &other_value);
+  });
+  other.join();
+  EXPECT_EQ(GetThreadSpecific(key), &main_value);
+  EXPECT_EQ(ThreadSpecificKeyDelete(key), 0);
+}
+
+TEST_F(ThreadSpecificTest, RecycledKeyDoesNotSeeStaleValue) {
+  pthread_key_t key;
+  ASSERT_EQ(ThreadSpecificKeyCreate(&key, nullptr), 0);
+  int value;
+  ASSERT_EQ(SetThreadSpecific(key, &value), 0);
+  ASSERT_EQ(ThreadSpecificKeyDelete(key), 0);
+
+  pthread_key_t recycled_key;
+  ASSERT_EQ(ThreadSpecificKeyCreate(&recycled_key, nullptr), 0);
+  EXPECT_NE(recycled_key, key);
+  EXPECT_EQ(GetThreadSpecific(recycled_key), nullptr);
+
+  // The deleted key may no longer be used.
+  EXPECT_EQ(SetThreadSpecific(key, &value), EINVAL);
+  EXPECT_EQ(ThreadSpecificKeyDelete(key), EINVAL);
+  EXPECT_EQ(ThreadSpecificKeyDelete(recycled_key), 0);
+}
+
+TEST_F(ThreadSpecificTest, KeysAreLimited) {
+  std::vector<pthread_key_t> keys(kMaxThreadSpecificKeys);
+  for (pthread_key_t &key : keys) {
+    ASSERT_EQ(ThreadSpecificKeyCreate(&key, nullptr), 0);
+  }
+  pthread_key_t extra_key;
+  EXPECT_EQ(ThreadSpecificKeyCreate(&extra_key, nullptr), EAGAIN);
+  for (pthread_key_t key : keys) {
+    EXPECT_EQ(ThreadSpecificKeyDelete(key), 0);
+  }
+  ASSERT_EQ(ThreadSpecificKeyCreate(&extra_key, nullptr), 0);
+  EXPECT_EQ(ThreadSpecificKeyDelete(extra_key), 0);
+}
+
+TEST_F(ThreadSpecificTest, DestructorsRunOnFinishingThread) {
+  pthread_key_t key;
+  ASSERT_EQ(ThreadSpecificKeyCreate(&key, &CountingDestructor), 0);
+  int value;
+  std::thread other([key, &value] {
+    EXPECT_EQ(SetThreadSpecific(key, &value), 0);
+    RunThreadSpecificDestructors();
+    EXPECT_EQ(GetThreadSpecific(key), nullptr);
+  });
+  other.join();
+  EXPECT_EQ(destructor_calls, 1);
+  EXPECT_EQ(destroyed_value, &value);
+  EXPECT_EQ(ThreadSpecificKeyDelete(key), 0);
+}
+
+TEST_F(ThreadSpecificTest, DestructorsSkipNullAndDeletedKeys) {
+  pthread_key_t null_key;
+  pthread_key_t deleted_key;
+  ASSERT_EQ(ThreadSpecificKeyCreate(&null_key, &CountingDestructor), 0);
+  ASSERT_EQ(ThreadSpecificKeyCreate(&deleted_key, &CountingDestructor), 0);
+  int value;
+  ASSERT_EQ(SetThreadSpecific(deleted_key, &value), 0);
+  ASSERT_EQ(ThreadSpecificKeyDelete(deleted_key), 0);
+  RunThreadSpecificDestructors();
+  EXPECT_EQ(destructor_calls, 0);
+  EXPECT_EQ(ThreadSpecificKeyDelete(null_key), 0);
+}
+
+TEST_F(ThreadSpecificTest, DestructorPassesAreBounded) {
+  ASSERT_EQ(ThreadSpecificKeyCreate(&resetting_key, &ResettingDestructor), 0);
+  int value;
+  resets_left = 100;
+  ASSERT_EQ(SetThreadSpecific(resetting_key, &value), 0);
+  RunThreadSpecificDestructors();
+  EXPECT_EQ(destructor_calls, kThreadSpecificDestructorIterations);
+  EXPECT_EQ(GetThreadSpecific(resetting_key), nullptr);
+  EXPECT_EQ(ThreadSpecificKeyDelete(resetting_key), 0);
+}
+
+}  // namespace
+}  // namespace asylo
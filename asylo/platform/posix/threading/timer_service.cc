@@ -0,0 +1,153 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/posix/threading/timer_service.h"
+
+#include <time.h>
+
+#include <utility>
+#include <vector>
+
+#include "asylo/platform/common/time_util.h"
+
+namespace asylo {
+namespace {
+
+// Value of |wake_time_| while the service thread is awake. It is awake until it
+// has checked the wheel, so a timer scheduled meanwhile need not wake it.
+constexpr int64_t kAwake = INT64_MIN;
+
+}  // namespace
+
+constexpr int64_t TimerService::kTickNanoseconds;
+
+TimerService *TimerService::GetInstance() {
+  static TimerService *instance = new TimerService;
+  return instance;
+}
+
+TimerService::TimerService()
+    : wheel_(kTickNanoseconds, Now()),
+      thread_started_(false),
+      stopping_(false),
+      wake_time_(kAwake) {
+  pthread_mutex_init(&lock_, nullptr);
+  pthread_cond_init(&wake_cond_, nullptr);
+}
+
+TimerService::~TimerService() {
+  pthread_mutex_lock(&lock_);
+  stopping_ = true;
+  pthread_cond_signal(&wake_cond_);
+  pthread_mutex_unlock(&lock_);
+  if (thread_started_) {
+    pthread_join(thread_, nullptr);
+  }
+  pthread_cond_destroy(&wake_cond_);
+  pthread_mutex_destroy(&lock_);
+}
+
+TimerService::TimerId TimerService::ScheduleAt(int64_t deadline_ns,
+                                               Callback callback) {
+  pthread_mutex_lock(&lock_);
+  if (wheel_.size() == 0) {
+    // The time of an empty wheel is not advanced while the service sleeps, so
+    // bring it up to date before placing the timer.
+    std::vector<Callback> none;
+    wheel_.Advance(Now(), &none);
+  }
+  TimerId id = wheel_.Schedule(deadline_ns, std::move(callback));
+  StartThreadLocked();
+  if (deadline_ns < wake_time_) {
+    pthread_cond_signal(&wake_cond_);
+  }
+  pthread_mutex_unlock(&lock_);
+  return id;
+}
+
+TimerService::TimerId TimerService::ScheduleAfter(int64_t delay_ns,
+                                                  Callback callback) {
+  return ScheduleAt(Now() + delay_ns, std::move(callback));
+}
+
+bool TimerService::Cancel(TimerId id) {
+  pthread_mutex_lock(&lock_);
+  bool cancelled = wheel_.Cancel(id);
+  pthread_mutex_unlock(&lock_);
+  return cancelled;
+}
+
+size_t TimerService::pending() {
+  pthread_mutex_lock(&lock_);
+  size_t size = wheel_.size();
+  pthread_mutex_unlock(&lock_);
+  return size;
+}
+
+int64_t TimerService::Now() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return TimeSpecToNanoseconds(&now);
+}
+
+void *TimerService::ThreadMain(void *arg) {
+  static_cast<TimerService *>(arg)->Run();
+  return nullptr;
+}
+
+void TimerService::StartThreadLocked() {
+  if (thread_started_) {
+    return;
+  }
+  thread_started_ = pthread_create(&thread_, nullptr, ThreadMain, this) == 0;
+}
+
+void TimerService::Run() {
+  std::vector<Callback> expired;
+  pthread_mutex_lock(&lock_);
+  while (!stopping_) {
+    int64_t now = Now();
+    wheel_.Advance(now, &expired);
+    if (!expired.empty()) {
+      pthread_mutex_unlock(&lock_);
+      for (Callback &callback : expired) {
+        callback();
+      }
+      expired.clear();
+      pthread_mutex_lock(&lock_);
+      continue;
+    }
+
+    wake_time_ = wheel_.NextEventTime();
+    if (wake_time_ == TimerWheel::kNoEvent) {
+      pthread_cond_wait(&wake_cond_, &lock_);
+    } else {
+      // pthread_cond_timedwait() takes a CLOCK_REALTIME deadline.
+      struct timespec realtime;
+      clock_gettime(CLOCK_REALTIME, &realtime);
+      struct timespec deadline;
+      NanosecondsToTimeSpec(&deadline, TimeSpecToNanoseconds(&realtime) +
+                                           (wake_time_ - now));
+      pthread_cond_timedwait(&wake_cond_, &lock_, &deadline);
+    }
+    wake_time_ = kAwake;
+  }
+  pthread_mutex_unlock(&lock_);
+}
+
+}  // namespace asylo
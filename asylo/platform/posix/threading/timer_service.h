@@ -0,0 +1,107 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_PLATFORM_POSIX_THREADING_TIMER_SERVICE_H_
+#define ASYLO_PLATFORM_POSIX_THREADING_TIMER_SERVICE_H_
+
+#include <pthread.h>
+
+#include <cstdint>
+#include <functional>
+
+#include "asylo/platform/posix/threading/timer_wheel.h"
+
+namespace asylo {
+
+// Runs callbacks at CLOCK_MONOTONIC deadlines from a single thread, so that
+// code waiting for timeouts, retries and lease renewals does not hold a
+// thread of its own for each pending timer.
+//
+// Timers are kept in a TimerWheel with millisecond ticks. The service thread
+// sleeps until the next deadline and runs the callbacks of the expired timers
+// in order. Inside an enclave the thread is a pthread, and so runs on a donated
+// thread; it reads the monotonic clock that the host keeps ticking in shared
+// memory, and waits on the host between deadlines, so pending timers cost
+// neither enclave exits nor spinning.
+//
+// Callbacks run on the service thread and must not block. They may schedule
+// and cancel timers. Methods may be called concurrently from several threads.
+class TimerService {
+ public:
+  using TimerId = TimerWheel::TimerId;
+  using Callback = TimerWheel::Callback;
+
+  // Length of the ticks of the wheel. Deadlines are rounded up to a tick.
+  static constexpr int64_t kTickNanoseconds = 1000000;
+
+  // Returns the service shared by the enclave. Its thread is started by the
+  // first timer scheduled.
+  static TimerService *GetInstance();
+
+  TimerService();
+
+  TimerService(const TimerService &) = delete;
+  TimerService &operator=(const TimerService &) = delete;
+
+  // Stops and joins the service thread. Pending timers are dropped.
+  ~TimerService();
+
+  // Runs |callback| once the monotonic clock reaches |deadline_ns|, and
+  // returns an id for cancelling it.
+  TimerId ScheduleAt(int64_t deadline_ns, Callback callback);
+
+  // Runs |callback| once |delay_ns| nanoseconds have passed.
+  TimerId ScheduleAfter(int64_t delay_ns, Callback callback);
+
+  // Cancels the timer |id|. Returns false if its callback has already run or
+  // started, or it was already cancelled.
+  bool Cancel(TimerId id);
+
+  // Returns the number of pending timers.
+  size_t pending();
+
+  // Returns the value of CLOCK_MONOTONIC in nanoseconds.
+  static int64_t Now();
+
+ private:
+  static void *ThreadMain(void *arg);
+
+  // Runs expired timers until the service stops.
+  void Run();
+
+  // Starts the service thread if it is not running. Requires |lock_|.
+  void StartThreadLocked();
+
+  pthread_mutex_t lock_;
+  pthread_cond_t wake_cond_;
+
+  // Guarded by |lock_|.
+  TimerWheel wheel_;
+  bool thread_started_;
+  bool stopping_;
+
+  // Deadline the service thread sleeps until, or TimerWheel::kNoEvent.
+  // Guarded by |lock_|.
+  int64_t wake_time_;
+
+  pthread_t thread_;
+};
+
+}  // namespace asylo
+
+#endif  // ASYLO_PLATFORM_POSIX_THREADING_TIMER_SERVICE_H_
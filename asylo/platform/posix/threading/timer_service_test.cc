@@ -0,0 +1,99 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/posix/threading/timer_service.h"
+
+#include <pthread.h>
+
+#include <atomic>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace asylo {
+namespace {
+
+constexpr int64_t kMillisecond = 1000000;
+
+// Waits up to a few seconds for |count| to reach |expected|.
+bool WaitForCount(const std::atomic<int> &count, int expected) {
+  int64_t deadline = TimerService::Now() + 5000 * kMillisecond;
+  while (count.load() < expected && TimerService::Now() < deadline) {
+    sched_yield();
+  }
+  return count.load() >= expected;
+}
+
+TEST(TimerServiceTest, RunsTimersInDeadlineOrder) {
+  TimerService service;
+  std::atomic<int> count(0);
+  std::vector<int> order;
+  pthread_mutex_t order_lock = PTHREAD_MUTEX_INITIALIZER;
+  int64_t start = TimerService::Now();
+  for (int i : {3, 1, 2}) {
+    service.ScheduleAt(start + i * 20 * kMillisecond,
+                       [i, start, &count, &order, &order_lock] {
+                         EXPECT_GE(TimerService::Now(),
+                                   start + i * 20 * kMillisecond);
+                         pthread_mutex_lock(&order_lock);
+                         order.push_back(i);
+                         pthread_mutex_unlock(&order_lock);
+                         count.fetch_add(1);
+                       });
+  }
+  ASSERT_TRUE(WaitForCount(count, 3));
+  EXPECT_EQ(order, std::vector<int>({1, 2, 3}));
+  EXPECT_EQ(service.pending(), 0);
+}
+
+TEST(TimerServiceTest, EarlierTimerWakesService) {
+  TimerService service;
+  std::atomic<int> count(0);
+  service.ScheduleAfter(60000 * kMillisecond, [&count] { count += 100; });
+  service.ScheduleAfter(kMillisecond, [&count] { count.fetch_add(1); });
+  ASSERT_TRUE(WaitForCount(count, 1));
+  EXPECT_EQ(count.load(), 1);
+  EXPECT_EQ(service.pending(), 1);
+}
+
+TEST(TimerServiceTest, CancelledTimerDoesNotRun) {
+  TimerService service;
+  std::atomic<int> count(0);
+  TimerService::TimerId id =
+      service.ScheduleAfter(20 * kMillisecond, [&count] { count += 100; });
+  service.ScheduleAfter(40 * kMillisecond, [&count] { count.fetch_add(1); });
+  EXPECT_TRUE(service.Cancel(id));
+  EXPECT_FALSE(service.Cancel(id));
+  ASSERT_TRUE(WaitForCount(count, 1));
+  EXPECT_EQ(count.load(), 1);
+}
+
+TEST(TimerServiceTest, CallbacksMayScheduleTimers) {
+  TimerService service;
+  std::atomic<int> count(0);
+  std::function<void()> rearm = [&service, &count, &rearm] {
+    if (count.fetch_add(1) + 1 < 5) {
+      service.ScheduleAfter(kMillisecond, rearm);
+    }
+  };
+  service.ScheduleAfter(kMillisecond, rearm);
+  ASSERT_TRUE(WaitForCount(count, 5));
+}
+
+}  // namespace
+}  // namespace asylo
@@ -0,0 +1,169 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/posix/threading/timer_wheel.h"
+
+#include <algorithm>
+#include <iterator>
+#include <utility>
+
+namespace asylo {
+
+constexpr int TimerWheel::kSlotBits;
+constexpr int TimerWheel::kSlotsPerLevel;
+constexpr int TimerWheel::kLevels;
+constexpr int64_t TimerWheel::kNoEvent;
+
+namespace {
+
+// Number of ticks covered by a slot of |level|.
+int64_t SlotSpan(int level) {
+  return int64_t{1} << (TimerWheel::kSlotBits * level);
+}
+
+}  // namespace
+
+TimerWheel::TimerWheel(int64_t tick_ns, int64_t now_ns)
+    : tick_ns_(std::max<int64_t>(tick_ns, 1)),
+      current_tick_(std::max<int64_t>(now_ns, 0) / tick_ns_),
+      next_id_(1) {}
+
+TimerWheel::TimerId TimerWheel::Schedule(int64_t deadline_ns,
+                                         Callback callback) {
+  int64_t expiry_tick = 0;
+  if (deadline_ns > 0) {
+    expiry_tick = deadline_ns / tick_ns_ + (deadline_ns % tick_ns_ != 0);
+  }
+  TimerId id = next_id_++;
+  overdue_.push_back(Timer{id, expiry_tick, std::move(callback)});
+  Slot::iterator it = std::prev(overdue_.end());
+  timers_[id] = Location{&overdue_, it};
+  Place(&overdue_, it);
+  return id;
+}
+
+bool TimerWheel::Cancel(TimerId id) {
+  auto location = timers_.find(id);
+  if (location == timers_.end()) {
+    return false;
+  }
+  location->second.slot->erase(location->second.it);
+  timers_.erase(location);
+  return true;
+}
+
+void TimerWheel::Advance(int64_t now_ns, std::vector<Callback> *expired) {
+  int64_t target_tick = std::max<int64_t>(now_ns, 0) / tick_ns_;
+  for (Timer &timer : overdue_) {
+    expired->push_back(std::move(timer.callback));
+    timers_.erase(timer.id);
+  }
+  overdue_.clear();
+
+  // Only the ticks at which a slot holding timers is reached are visited.
+  while (!timers_.empty()) {
+    int64_t next_tick = NextEventTime() / tick_ns_;
+    if (next_tick > target_tick) {
+      break;
+    }
+    ProcessTick(next_tick, expired);
+  }
+  current_tick_ = std::max(current_tick_, target_tick);
+}
+
+int64_t TimerWheel::NextEventTime() const {
+  if (!overdue_.empty()) {
+    return current_tick_ * tick_ns_;
+  }
+  if (timers_.empty()) {
+    return kNoEvent;
+  }
+  int64_t next_tick = kNoEvent;
+  for (int level = 0; level < kLevels; ++level) {
+    for (int slot = 0; slot < kSlotsPerLevel; ++slot) {
+      if (!slots_[level][slot].empty()) {
+        next_tick = std::min(next_tick, SlotTick(level, slot));
+      }
+    }
+  }
+  return next_tick * tick_ns_;
+}
+
+void TimerWheel::Place(Slot *from, Slot::iterator it) {
+  int64_t expiry_tick = it->expiry_tick;
+  int64_t delta = expiry_tick - current_tick_;
+  Slot *to = &overdue_;
+  if (delta > 0) {
+    // Timers beyond the span of the wheel wait in the last slot of the top
+    // level, and are placed again when it is reached.
+    if (delta >= SlotSpan(kLevels)) {
+      expiry_tick = current_tick_ + SlotSpan(kLevels) - 1;
+      delta = SlotSpan(kLevels) - 1;
+    }
+    int level = 0;
+    while (delta >= SlotSpan(level + 1)) {
+      ++level;
+    }
+    int slot = (expiry_tick >> (kSlotBits * level)) & (kSlotsPerLevel - 1);
+    to = &slots_[level][slot];
+  }
+  if (to != from) {
+    to->splice(to->end(), *from, it);
+    timers_[it->id].slot = to;
+  }
+}
+
+void TimerWheel::ProcessTick(int64_t tick, std::vector<Callback> *expired) {
+  current_tick_ = tick;
+
+  // Move the timers of each higher level slot starting at this tick down to
+  // the levels below. Each level's slots start at multiples of its span, and a
+  // level is only reached when the levels below it wrap around.
+  for (int level = 1; level < kLevels; ++level) {
+    if (tick % SlotSpan(level) != 0) {
+      break;
+    }
+    Slot cascading;
+    Slot *slot = &slots_[level][(tick >> (kSlotBits * level)) &
+                                (kSlotsPerLevel - 1)];
+    cascading.splice(cascading.end(), *slot);
+    while (!cascading.empty()) {
+      timers_[cascading.front().id].slot = &cascading;
+      Place(&cascading, cascading.begin());
+    }
+  }
+
+  for (Slot *slot : {&overdue_, &slots_[0][tick & (kSlotsPerLevel - 1)]}) {
+    for (Timer &timer : *slot) {
+      expired->push_back(std::move(timer.callback));
+      timers_.erase(timer.id);
+    }
+    slot->clear();
+  }
+}
+
+int64_t TimerWheel::SlotTick(int level, int slot) const {
+  int64_t base = current_tick_ >> (kSlotBits * level);
+  int64_t index = base + ((slot - base) & (kSlotsPerLevel - 1));
+  if (index == base) {
+    index += kSlotsPerLevel;
+  }
+  return index << (kSlotBits * level);
+}
+
+}  // namespace asylo
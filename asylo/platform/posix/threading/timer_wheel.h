@@ -0,0 +1,126 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_PLATFORM_POSIX_THREADING_TIMER_WHEEL_H_
+#define ASYLO_PLATFORM_POSIX_THREADING_TIMER_WHEEL_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <unordered_map>
+#include <vector>
+
+namespace asylo {
+
+// A hierarchical timing wheel holding timers with callbacks.
+//
+// Time is divided into ticks of a fixed length. Level 0 of the wheel has a
+// slot for each of the next |kSlotsPerLevel| ticks, and each further level
+// has slots |kSlotsPerLevel| times as long as those of the level below. A timer
+// is placed in the lowest level whose span covers its deadline, and the slots
+// of higher levels are moved down a level as time reaches them. Scheduling and
+// cancelling a timer take constant time, and advancing the wheel takes time
+// proportional to the number of slots holding timers that it passes, however
+// long the jump.
+//
+// Deadlines further away than the span of the top level wait in its last slot
+// and are placed again when it is reached. Deadlines are rounded up to a whole
+// tick, so a timer never expires early.
+//
+// The wheel is not thread-safe.
+class TimerWheel {
+ public:
+  using TimerId = uint64_t;
+  using Callback = std::function<void()>;
+
+  // Number of slots in each level, and number of levels.
+  static constexpr int kSlotBits = 6;
+  static constexpr int kSlotsPerLevel = 1 << kSlotBits;
+  static constexpr int kLevels = 4;
+
+  // Returned by NextEventTime() if the wheel holds no timers.
+  static constexpr int64_t kNoEvent = INT64_MAX;
+
+  // Creates an empty wheel with ticks of |tick_ns| nanoseconds, whose time
+  // starts at |now_ns|.
+  TimerWheel(int64_t tick_ns, int64_t now_ns);
+
+  TimerWheel(const TimerWheel &) = delete;
+  TimerWheel &operator=(const TimerWheel &) = delete;
+
+  // Adds a timer that expires at |deadline_ns| and runs |callback|, and
+  // returns its id. A deadline which has already passed expires on the next
+  // call to Advance().
+  TimerId Schedule(int64_t deadline_ns, Callback callback);
+
+  // Removes the timer |id|. Returns false if it is not in the wheel, because
+  // it has expired or was cancelled.
+  bool Cancel(TimerId id);
+
+  // Advances the time of the wheel to |now_ns|, and appends the callbacks of
+  // the timers expiring by then to |expired| in order of expiry. Times earlier
+  // than the wheel's time are ignored.
+  void Advance(int64_t now_ns, std::vector<Callback> *expired);
+
+  // Returns the earliest time at which Advance() has work to do: a timer
+  // expires, or the timers of a higher level move down. Returns |kNoEvent| if
+  // the wheel is empty.
+  int64_t NextEventTime() const;
+
+  // Returns the number of timers in the wheel.
+  size_t size() const { return timers_.size(); }
+
+ private:
+  struct Timer {
+    TimerId id;
+    int64_t expiry_tick;
+    Callback callback;
+  };
+  using Slot = std::list<Timer>;
+
+  // Places the timer at |it| in |from| into the slot for its expiry.
+  void Place(Slot *from, Slot::iterator it);
+
+  // Moves the wheel to |tick| and collects the timers expiring then.
+  void ProcessTick(int64_t tick, std::vector<Callback> *expired);
+
+  // Returns the first tick after the current one at which slot |slot| of
+  // level |level| is reached.
+  int64_t SlotTick(int level, int slot) const;
+
+  const int64_t tick_ns_;
+  int64_t current_tick_;
+  TimerId next_id_;
+
+  Slot slots_[kLevels][kSlotsPerLevel];
+
+  // Timers whose deadline had passed when they were scheduled.
+  Slot overdue_;
+
+  // The slot holding each timer, and its position in the slot.
+  struct Location {
+    Slot *slot;
+    Slot::iterator it;
+  };
+  std::unordered_map<TimerId, Location> timers_;
+};
+
+}  // namespace asylo
+
+#endif  // ASYLO_PLATFORM_POSIX_THREADING_TIMER_WHEEL_H_
@@ -0,0 +1,158 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/posix/threading/timer_wheel.h"
+
+#include <map>
+#include <random>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace asylo {
+namespace {
+
+constexpr int64_t kTick = 1000;
+
+// Runs the callbacks collected by advancing |wheel| to |now|.
+void AdvanceAndRun(TimerWheel *wheel, int64_t now) {
+  std::vector<TimerWheel::Callback> expired;
+  wheel->Advance(now, &expired);
+  for (TimerWheel::Callback &callback : expired) {
+    callback();
+  }
+}
+
+TEST(TimerWheelTest, EmptyWheelHasNoEvent) {
+  TimerWheel wheel(kTick, 0);
+  EXPECT_EQ(wheel.NextEventTime(), TimerWheel::kNoEvent);
+  AdvanceAndRun(&wheel, 1000 * kTick);
+  EXPECT_EQ(wheel.size(), 0);
+}
+
+TEST(TimerWheelTest, TimerExpiresAtItsDeadline) {
+  TimerWheel wheel(kTick, 0);
+  int runs = 0;
+  wheel.Schedule(5 * kTick + 1, [&runs] { ++runs; });
+  EXPECT_LE(wheel.NextEventTime(), 6 * kTick);
+
+  // The deadline is rounded up to a whole tick.
+  AdvanceAndRun(&wheel, 5 * kTick + 1);
+  EXPECT_EQ(runs, 0);
+  AdvanceAndRun(&wheel, 6 * kTick);
+  EXPECT_EQ(runs, 1);
+  AdvanceAndRun(&wheel, 100 * kTick);
+  EXPECT_EQ(runs, 1);
+  EXPECT_EQ(wheel.size(), 0);
+}
+
+TEST(TimerWheelTest, PassedDeadlineExpiresOnNextAdvance) {
+  TimerWheel wheel(kTick, 50 * kTick);
+  int runs = 0;
+  wheel.Schedule(10 * kTick, [&runs] { ++runs; });
+  EXPECT_EQ(wheel.NextEventTime(), 50 * kTick);
+  AdvanceAndRun(&wheel, 50 * kTick);
+  EXPECT_EQ(runs, 1);
+}
+
+TEST(TimerWheelTest, CancelledTimerDoesNotRun) {
+  TimerWheel wheel(kTick, 0);
+  int runs = 0;
+  TimerWheel::TimerId id = wheel.Schedule(3 * kTick, [&runs] { ++runs; });
+  wheel.Schedule(4 * kTick, [&runs] { runs += 10; });
+  EXPECT_TRUE(wheel.Cancel(id));
+  EXPECT_FALSE(wheel.Cancel(id));
+  AdvanceAndRun(&wheel, 10 * kTick);
+  EXPECT_EQ(runs, 10);
+}
+
+TEST(TimerWheelTest, DeadlineBeyondSpanExpiresOnTime) {
+  // Span of the wheel in ticks.
+  constexpr int64_t kSpan = int64_t{1}
+                            << (TimerWheel::kSlotBits * TimerWheel::kLevels);
+  TimerWheel wheel(kTick, 0);
+  int runs = 0;
+  int64_t deadline = (3 * kSpan + 12345) * kTick;
+  wheel.Schedule(deadline, [&runs] { ++runs; });
+  AdvanceAndRun(&wheel, deadline - kTick);
+  EXPECT_EQ(runs, 0);
+  AdvanceAndRun(&wheel, deadline);
+  EXPECT_EQ(runs, 1);
+}
+
+// Timers with deadlines at all levels of the wheel, advanced in irregular
+// steps, run exactly once, in the first step which reaches their deadline.
+TEST(TimerWheelTest, MatchesModel) {
+  struct Expectation {
+    int64_t scheduled_at;
+    int64_t deadline;
+    int runs;
+    // Times of the steps before and in which the timer ran.
+    int64_t previous_step;
+    int64_t run_step;
+  };
+
+  std::mt19937 random(1);
+  TimerWheel wheel(kTick, 0);
+  std::map<int, Expectation> timers;
+  std::vector<TimerWheel::TimerId> ids;
+  int64_t previous = 0;
+  int64_t now = 0;
+  for (int step = 0; step < 2000; ++step) {
+    for (int i = random() % 5; i > 0; --i) {
+      int index = static_cast<int>(ids.size());
+      int64_t delay = (random() % 4 == 0) ? random() % (int64_t{1} << 30)
+                                          : random() % (1 << 16);
+      timers[index] = Expectation{now, now + delay, 0, 0, 0};
+      ids.push_back(
+          wheel.Schedule(now + delay, [&timers, &previous, &now, index] {
+            Expectation *timer = &timers[index];
+            ++timer->runs;
+            timer->previous_step = previous;
+            timer->run_step = now;
+          }));
+    }
+    if (random() % 7 == 0 && !ids.empty()) {
+      int index = random() % ids.size();
+      if (wheel.Cancel(ids[index])) {
+        timers.erase(index);
+      }
+    }
+    previous = now;
+    now += (random() % 10 == 0) ? random() % (int64_t{1} << 28)
+                                : random() % (1 << 14);
+    AdvanceAndRun(&wheel, now);
+  }
+  previous = now;
+  now += int64_t{1} << 40;
+  AdvanceAndRun(&wheel, now);
+  EXPECT_EQ(wheel.size(), 0);
+
+  for (const auto &entry : timers) {
+    const Expectation &timer = entry.second;
+    int64_t tick_deadline = (timer.deadline + kTick - 1) / kTick * kTick;
+    ASSERT_EQ(timer.runs, 1) << entry.first;
+    EXPECT_GE(timer.run_step, tick_deadline) << entry.first;
+    if (tick_deadline > timer.scheduled_at) {
+      EXPECT_LT(timer.previous_step, tick_deadline) << entry.first;
+    }
+  }
+}
+
+}  // namespace
+}  // namespace asylo
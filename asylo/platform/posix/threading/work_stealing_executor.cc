@@ -0,0 +1,287 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/posix/threading/work_stealing_executor.h"
+
+#include <pthread.h>
+#include <sched.h>
+
+#include <algorithm>
+#include <utility>
+
+#include "asylo/platform/common/cpu_topology.h"
+#include "asylo/util/posix_error_space.h"
+#include "asylo/util/status.h"
+
+namespace asylo {
+namespace {
+
+// The worker running on the calling thread, if any.
+thread_local void *current_worker = nullptr;
+
+}  // namespace
+
+StatusOr<std::unique_ptr<WorkStealingExecutor>> WorkStealingExecutor::Create(
+    int num_workers) {
+  return Create(std::vector<WorkerPlacement>(std::max(num_workers, 0)));
+}
+
+StatusOr<std::unique_ptr<WorkStealingExecutor>>
+WorkStealingExecutor::CreatePerNumaNode(int workers_per_node) {
+  std::vector<WorkerPlacement> placements;
+  std::vector<std::vector<int>> node_cpus = ReadNumaNodeCpus();
+  for (size_t node = 0; node < node_cpus.size(); ++node) {
+    if (node_cpus[node].empty()) {
+      continue;
+    }
+    for (int i = 0; i < workers_per_node; ++i) {
+      WorkerPlacement placement;
+      placement.cpus = node_cpus[node];
+      placement.group = static_cast<int>(node);
+      placements.push_back(std::move(placement));
+    }
+  }
+  if (placements.empty()) {
+    return Create(workers_per_node);
+  }
+  return Create(placements);
+}
+
+StatusOr<std::unique_ptr<WorkStealingExecutor>> WorkStealingExecutor::Create(
+    const std::vector<WorkerPlacement> &placements) {
+  if (placements.empty()) {
+    return Status(error::GoogleError::INVALID_ARGUMENT,
+                  "An executor needs at least one worker");
+  }
+  for (const WorkerPlacement &placement : placements) {
+    for (int cpu : placement.cpus) {
+      if (cpu < 0 || cpu >= CPU_SETSIZE) {
+        return Status(error::GoogleError::INVALID_ARGUMENT,
+                      "Worker CPU is out of range");
+      }
+    }
+  }
+  std::unique_ptr<WorkStealingExecutor> executor(
+      new WorkStealingExecutor(placements));
+  for (const std::unique_ptr<Worker> &worker : executor->workers_) {
+    int result =
+        pthread_create(&worker->thread, nullptr, &WorkerMain, worker.get());
+    if (result != 0) {
+      return Status(static_cast<error::PosixError>(result),
+                    "Failed to start executor worker");
+    }
+    ++executor->started_workers_;
+  }
+  return std::move(executor);
+}
+
+WorkStealingExecutor::WorkStealingExecutor(
+    const std::vector<WorkerPlacement> &placements)
+    : started_workers_(0),
+      next_worker_(0),
+      pending_tasks_(0),
+      sleeping_workers_(0),
+      stopping_(false) {
+  sleep_lock_ = PTHREAD_MUTEX_INITIALIZER;
+  wake_cond_ = PTHREAD_COND_INITIALIZER;
+  int num_workers = static_cast<int>(placements.size());
+  for (int i = 0; i < num_workers; ++i) {
+    workers_.emplace_back(new Worker());
+    workers_.back()->executor = this;
+    workers_.back()->index = i;
+    workers_.back()->placement = placements[i];
+  }
+  for (const std::unique_ptr<Worker> &worker : workers_) {
+    for (bool same_group : {true, false}) {
+      for (int i = 1; i < num_workers; ++i) {
+        Worker *victim = workers_[(worker->index + i) % num_workers].get();
+        if ((victim->placement.group == worker->placement.group) ==
+            same_group) {
+          worker->victims.push_back(victim);
+        }
+      }
+    }
+  }
+}
+
+WorkStealingExecutor::~WorkStealingExecutor() {
+  pthread_mutex_lock(&sleep_lock_);
+  stopping_ = true;
+  pthread_cond_broadcast(&wake_cond_);
+  pthread_mutex_unlock(&sleep_lock_);
+  for (size_t i = 0; i < started_workers_; ++i) {
+    pthread_join(workers_[i]->thread, nullptr);
+  }
+}
+
+void WorkStealingExecutor::Submit(Task task) {
+  // Count the task before publishing it, so that a worker which takes it
+  // never observes the count going below zero.
+  pending_tasks_.fetch_add(1);
+  Worker *target = CurrentWorker();
+  if (!target) {
+    target = workers_[next_worker_.fetch_add(1, std::memory_order_relaxed) %
+                      workers_.size()]
+                 .get();
+  }
+  target->lock.Acquire();
+  target->tasks.push_back(std::move(task));
+  target->lock.Release();
+
+  // WaitForTask() registers as sleeping before checking pending_tasks_, so
+  // either the sleeper sees the new task or this thread sees the sleeper.
+  if (sleeping_workers_.load() > 0) {
+    pthread_mutex_lock(&sleep_lock_);
+    pthread_cond_signal(&wake_cond_);
+    pthread_mutex_unlock(&sleep_lock_);
+  }
+}
+
+void WorkStealingExecutor::ParallelFor(
+    size_t begin, size_t end, size_t grain,
+    const std::function<void(size_t, size_t)> &body) {
+  if (begin >= end) {
+    return;
+  }
+  if (grain == 0) {
+    grain = 1;
+  }
+  size_t num_chunks = (end - begin - 1) / grain + 1;
+
+  // Helpers may start after all chunks have been claimed, and even after this
+  // call has returned, so they share ownership of the progress counters and
+  // only touch |body| while holding an unclaimed chunk.
+  struct Progress {
+    std::atomic<size_t> next_chunk{0};
+    std::atomic<size_t> finished_chunks{0};
+  };
+  auto progress = std::make_shared<Progress>();
+  const std::function<void(size_t, size_t)> *body_ptr = &body;
+  auto run_chunks = [progress, body_ptr, begin, end, grain, num_chunks] {
+    size_t chunk;
+    while ((chunk = progress->next_chunk.fetch_add(1)) < num_chunks) {
+      size_t chunk_begin = begin + chunk * grain;
+      (*body_ptr)(chunk_begin, std::min(end, chunk_begin + grain));
+      progress->finished_chunks.fetch_add(1, std::memory_order_release);
+    }
+  };
+
+  size_t num_helpers = std::min(num_chunks - 1, workers_.size());
+  for (size_t i = 0; i < num_helpers; ++i) {
+    Submit(run_chunks);
+  }
+  run_chunks();
+
+  // Help with other work while the remaining chunks finish.
+  Worker *self = CurrentWorker();
+  while (progress->finished_chunks.load(std::memory_order_acquire) <
+         num_chunks) {
+    if (!RunOneTask(self)) {
+      sched_yield();
+    }
+  }
+}
+
+void *WorkStealingExecutor::WorkerMain(void *arg) {
+  Worker *worker = static_cast<Worker *>(arg);
+  if (!worker->placement.cpus.empty()) {
+    cpu_set_t mask;
+    CPU_ZERO(&mask);
+    for (int cpu : worker->placement.cpus) {
+      CPU_SET(cpu, &mask);
+    }
+    // Placement only affects performance, so a worker which cannot be pinned
+    // runs wherever it was started.
+    pthread_setaffinity_np(pthread_self(), sizeof(mask), &mask);
+  }
+  current_worker = worker;
+  worker->executor->WorkerLoop(worker);
+  current_worker = nullptr;
+  return nullptr;
+}
+
+void WorkStealingExecutor::WorkerLoop(Worker *worker) {
+  while (true) {
+    if (RunOneTask(worker)) {
+      continue;
+    }
+    if (stopping_ && pending_tasks_ == 0) {
+      return;
+    }
+    WaitForTask();
+  }
+}
+
+bool WorkStealingExecutor::RunOneTask(Worker *self) {
+  Task task;
+  if (self) {
+    self->lock.Acquire();
+    if (!self->tasks.empty()) {
+      task = std::move(self->tasks.back());
+      self->tasks.pop_back();
+    }
+    self->lock.Release();
+  }
+
+  if (self) {
+    for (size_t i = 0; !task && i < self->victims.size(); ++i) {
+      task = Steal(self->victims[i]);
+    }
+  } else {
+    size_t num_workers = workers_.size();
+    size_t start = next_worker_.load(std::memory_order_relaxed);
+    for (size_t i = 0; !task && i < num_workers; ++i) {
+      task = Steal(workers_[(start + i) % num_workers].get());
+    }
+  }
+
+  if (!task) {
+    return false;
+  }
+  pending_tasks_.fetch_sub(1);
+  task();
+  return true;
+}
+
+WorkStealingExecutor::Task WorkStealingExecutor::Steal(Worker *victim) {
+  Task task;
+  victim->lock.Acquire();
+  if (!victim->tasks.empty()) {
+    task = std::move(victim->tasks.front());
+    victim->tasks.pop_front();
+  }
+  victim->lock.Release();
+  return task;
+}
+
+void WorkStealingExecutor::WaitForTask() {
+  pthread_mutex_lock(&sleep_lock_);
+  sleeping_workers_.fetch_add(1);
+  while (pending_tasks_.load() == 0 && !stopping_) {
+    pthread_cond_wait(&wake_cond_, &sleep_lock_);
+  }
+  sleeping_workers_.fetch_sub(1);
+  pthread_mutex_unlock(&sleep_lock_);
+}
+
+WorkStealingExecutor::Worker *WorkStealingExecutor::CurrentWorker() {
+  Worker *worker = static_cast<Worker *>(current_worker);
+  return worker && worker->executor == this ? worker : nullptr;
+}
+
+}  // namespace asylo
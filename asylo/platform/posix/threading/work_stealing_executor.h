@@ -0,0 +1,155 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_PLATFORM_POSIX_THREADING_WORK_STEALING_EXECUTOR_H_
+#define ASYLO_PLATFORM_POSIX_THREADING_WORK_STEALING_EXECUTOR_H_
+
+#include <pthread.h>
+
+#include <atomic>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "asylo/platform/common/spin_lock.h"
+#include "asylo/util/statusor.h"
+
+namespace asylo {
+
+// Runs tasks on a fixed set of worker threads. Each worker owns a deque of
+// tasks: tasks submitted from a worker are pushed to and popped from the back
+// of its own deque, while idle workers steal from the front of the deques of
+// others. Tasks submitted from other threads are spread over the workers in
+// turn.
+//
+// Workers may be placed in locality groups, such as the NUMA nodes of the
+// host. An idle worker steals from the workers of its own group before those
+// of other groups, so that tasks and the memory they touch tend to stay on one
+// socket.
+//
+// Inside an enclave, workers are pthreads and so run on donated threads; with
+// a thread pool configured in the EnclaveConfig, creating the executor does
+// not leave the enclave.
+class WorkStealingExecutor {
+ public:
+  using Task = std::function<void()>;
+
+  // Where a worker runs. The worker's thread is pinned to |cpus| when it
+  // starts, unless it is empty, and |group| identifies the workers it prefers
+  // to steal from.
+  struct WorkerPlacement {
+    std::vector<int> cpus;
+    int group = 0;
+  };
+
+  // Creates an executor with |num_workers| worker threads in a single group.
+  static StatusOr<std::unique_ptr<WorkStealingExecutor>> Create(
+      int num_workers);
+
+  // Creates an executor with a worker thread for each of |placements|.
+  static StatusOr<std::unique_ptr<WorkStealingExecutor>> Create(
+      const std::vector<WorkerPlacement> &placements);
+
+  // Creates an executor with |workers_per_node| worker threads on each NUMA
+  // node of the host, pinned to the CPUs of their node and grouped by node.
+  // If the host does not describe its topology, creates |workers_per_node|
+  // unpinned workers in a single group.
+  static StatusOr<std::unique_ptr<WorkStealingExecutor>> CreatePerNumaNode(
+      int workers_per_node);
+
+  WorkStealingExecutor(const WorkStealingExecutor &) = delete;
+  WorkStealingExecutor &operator=(const WorkStealingExecutor &) = delete;
+
+  // Runs all tasks already submitted, then stops and joins the workers.
+  ~WorkStealingExecutor();
+
+  // Schedules |task| to run on a worker thread.
+  void Submit(Task task);
+
+  // Invokes |body| on consecutive subranges of [|begin|, |end|) of at most
+  // |grain| elements each, in parallel, and returns once all invocations have
+  // finished. The calling thread takes part in the work.
+  void ParallelFor(size_t begin, size_t end, size_t grain,
+                   const std::function<void(size_t, size_t)> &body);
+
+  // Returns the number of worker threads.
+  int num_workers() const { return static_cast<int>(workers_.size()); }
+
+ private:
+  struct Worker {
+    WorkStealingExecutor *executor;
+    int index;
+    pthread_t thread;
+    WorkerPlacement placement;
+
+    // The other workers in the order they are stolen from: those of the same
+    // group first, each list starting after this worker.
+    std::vector<Worker *> victims;
+
+    // Guards |tasks|.
+    SpinLock lock;
+    std::deque<Task> tasks;
+  };
+
+  explicit WorkStealingExecutor(const std::vector<WorkerPlacement> &placements);
+
+  static void *WorkerMain(void *arg);
+
+  // Runs tasks on behalf of |worker| until the executor stops.
+  void WorkerLoop(Worker *worker);
+
+  // Runs one task, preferring the back of the deque of |self| if non-null and
+  // stealing from the other workers otherwise. Returns false if no task was
+  // found.
+  bool RunOneTask(Worker *self);
+
+  // Takes the task at the front of the deque of |victim|, if any.
+  static Task Steal(Worker *victim);
+
+  // Sleeps until a task is submitted or the executor stops.
+  void WaitForTask();
+
+  // Returns the worker whose thread is the calling thread, or nullptr.
+  Worker *CurrentWorker();
+
+  std::vector<std::unique_ptr<Worker>> workers_;
+
+  // Number of workers whose threads have been started.
+  size_t started_workers_;
+
+  // Worker receiving the next task submitted from outside the executor.
+  std::atomic<unsigned> next_worker_;
+
+  // Number of tasks submitted and not yet taken from a deque.
+  std::atomic<size_t> pending_tasks_;
+
+  // Number of workers asleep in WaitForTask().
+  std::atomic<int> sleeping_workers_;
+
+  std::atomic<bool> stopping_;
+
+  // Wakes sleeping workers.
+  pthread_mutex_t sleep_lock_;
+  pthread_cond_t wake_cond_;
+};
+
+}  // namespace asylo
+
+#endif  // ASYLO_PLATFORM_POSIX_THREADING_WORK_STEALING_EXECUTOR_H_
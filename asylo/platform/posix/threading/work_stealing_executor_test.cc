@@ -0,0 +1,157 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/posix/threading/work_stealing_executor.h"
+
+#include <sched.h>
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace asylo {
+namespace {
+
+constexpr int kNumWorkers = 4;
+
+std::unique_ptr<WorkStealingExecutor> CreateExecutor() {
+  auto executor_result = WorkStealingExecutor::Create(kNumWorkers);
+  EXPECT_TRUE(executor_result.ok());
+  return std::move(executor_result).ValueOrDie();
+}
+
+TEST(WorkStealingExecutorTest, RejectsEmptyPool) {
+  EXPECT_FALSE(WorkStealingExecutor::Create(0).ok());
+}
+
+TEST(WorkStealingExecutorTest, RunsAllSubmittedTasks) {
+  constexpr int kNumTasks = 10000;
+  std::atomic<int> count(0);
+  {
+    std::unique_ptr<WorkStealingExecutor> executor = CreateExecutor();
+    EXPECT_EQ(executor->num_workers(), kNumWorkers);
+    for (int i = 0; i < kNumTasks; ++i) {
+      executor->Submit([&count] { count.fetch_add(1); });
+    }
+  }
+  // Destroying the executor runs the remaining tasks.
+  EXPECT_EQ(count.load(), kNumTasks);
+}
+
+TEST(WorkStealingExecutorTest, TasksSubmittedFromTasksRun) {
+  constexpr int kFanOut = 64;
+  std::atomic<int> count(0);
+  {
+    std::unique_ptr<WorkStealingExecutor> executor = CreateExecutor();
+    WorkStealingExecutor *raw_executor = executor.get();
+    for (int i = 0; i < kFanOut; ++i) {
+      executor->Submit([raw_executor, &count] {
+        for (int j = 0; j < kFanOut; ++j) {
+          raw_executor->Submit([&count] { count.fetch_add(1); });
+        }
+      });
+    }
+  }
+  EXPECT_EQ(count.load(), kFanOut * kFanOut);
+}
+
+TEST(WorkStealingExecutorTest, ParallelForCoversRangeOnce) {
+  constexpr size_t kBegin = 3;
+  constexpr size_t kEnd = 10007;
+  std::unique_ptr<WorkStealingExecutor> executor = CreateExecutor();
+  for (size_t grain : {1, 7, 1000, 20000}) {
+    std::vector<std::atomic<int>> visits(kEnd);
+    executor->ParallelFor(kBegin, kEnd, grain,
+                          [&visits, grain](size_t begin, size_t end) {
+                            EXPECT_LE(end - begin, grain);
+                            for (size_t i = begin; i < end; ++i) {
+                              visits[i].fetch_add(1);
+                            }
+                          });
+    for (size_t i = 0; i < kEnd; ++i) {
+      ASSERT_EQ(visits[i].load(), i < kBegin ? 0 : 1) << i;
+    }
+  }
+}
+
+TEST(WorkStealingExecutorTest, NestedParallelFor) {
+  std::unique_ptr<WorkStealingExecutor> executor = CreateExecutor();
+  WorkStealingExecutor *raw_executor = executor.get();
+  std::atomic<size_t> sum(0);
+  executor->ParallelFor(0, 16, 1, [raw_executor, &sum](size_t, size_t) {
+    raw_executor->ParallelFor(0, 100, 10, [&sum](size_t begin, size_t end) {
+      sum.fetch_add(end - begin);
+    });
+  });
+  EXPECT_EQ(sum.load(), 1600);
+}
+
+TEST(WorkStealingExecutorTest, RejectsOutOfRangeCpu) {
+  WorkStealingExecutor::WorkerPlacement placement;
+  placement.cpus = {-1};
+  EXPECT_FALSE(WorkStealingExecutor::Create({placement}).ok());
+}
+
+// Tests that workers run on the CPUs they are placed on, and that work is
+// shared across groups.
+TEST(WorkStealingExecutorTest, PlacedWorkersRunOnTheirCpus) {
+  constexpr int kNumTasks = 100;
+  std::vector<WorkStealingExecutor::WorkerPlacement> placements(3);
+  for (int i = 0; i < 3; ++i) {
+    placements[i].cpus = {0};
+    placements[i].group = i / 2;
+  }
+  auto executor_result = WorkStealingExecutor::Create(placements);
+  ASSERT_TRUE(executor_result.ok());
+  std::unique_ptr<WorkStealingExecutor> executor =
+      std::move(executor_result).ValueOrDie();
+
+  std::atomic<int> sum(0);
+  executor->ParallelFor(0, 1000, 1, [&sum](size_t begin, size_t end) {
+    sum.fetch_add(static_cast<int>(end - begin));
+  });
+  EXPECT_EQ(sum.load(), 1000);
+
+  std::atomic<int> count(0);
+  std::atomic<int> off_cpu(0);
+  for (int i = 0; i < kNumTasks; ++i) {
+    executor->Submit([&count, &off_cpu] {
+      count.fetch_add(1);
+      if (sched_getcpu() != 0) {
+        off_cpu.fetch_add(1);
+      }
+    });
+  }
+  executor.reset();
+  EXPECT_EQ(count.load(), kNumTasks);
+  EXPECT_EQ(off_cpu.load(), 0);
+}
+
+TEST(WorkStealingExecutorTest, CreatesWorkersPerNumaNode) {
+  auto executor_result = WorkStealingExecutor::CreatePerNumaNode(2);
+  ASSERT_TRUE(executor_result.ok());
+  std::unique_ptr<WorkStealingExecutor> executor =
+      std::move(executor_result).ValueOrDie();
+  EXPECT_GE(executor->num_workers(), 2);
+  EXPECT_EQ(executor->num_workers() % 2, 0);
+}
+
+}  // namespace
+}  // namespace asylo
@@ -18,6 +18,7 @@
 
 #include <sys/time.h>
 #include <time.h>
+#include <algorithm>
 #include <atomic>
 #include <cstring>
 
@@ -25,6 +26,7 @@
 #include "asylo/platform/arch/include/trusted/host_calls.h"
 #include "asylo/platform/arch/include/trusted/time.h"
 #include "asylo/platform/common/time_util.h"
+#include "asylo/platform/common/tsc_clock.h"
 #include "asylo/platform/core/shared_name.h"
 #include "common/inc/sgx_trts.h"
 
@@ -32,6 +34,7 @@ using asylo::NanosecondsToTimeSpec;
 using asylo::NanosecondsToTimeVal;
 using asylo::SharedName;
 using asylo::TimeSpecToNanoseconds;
+using asylo::TscClockCalibration;
 
 namespace {
 
@@ -49,8 +52,44 @@ std::atomic<int64_t> *GetClockAddressOrDie(const char *name) {
   return static_cast<std::atomic<int64_t> *>(addr);
 }
 
+// Set once the enclave may read time from the TSC.
+std::atomic<bool> tsc_clock_enabled(false);
+
+// Fetches the address of the TSC calibration published by the host, aborting
+// if the address was not found or refers to enclave memory.
+const TscClockCalibration *GetTscCalibrationOrDie() {
+  void *addr = enc_untrusted_acquire_shared_resource(kAddressName,
+                                                     "clock_tsc_calibration");
+  if (!addr || !enc_is_outside_enclave(addr, sizeof(TscClockCalibration))) {
+    abort();
+  }
+  return static_cast<const TscClockCalibration *>(addr);
+}
+
+// Reads the monotonic and realtime clocks from the TSC. Returns false if the
+// TSC clock is not enabled or the host has not calibrated it.
+inline bool TscClocks(int64_t *monotonic, int64_t *realtime) {
+  if (!tsc_clock_enabled.load(std::memory_order_relaxed)) {
+    return false;
+  }
+  static const TscClockCalibration *calibration = GetTscCalibrationOrDie();
+  return asylo::TscToClocks(*calibration, asylo::ReadTsc(), monotonic,
+                            realtime);
+}
+
 // Returns the value of a monotonic clock as a number of nanoseconds.
 inline int64_t MonotonicClock() {
+  int64_t monotonic, realtime;
+  if (TscClocks(&monotonic, &realtime)) {
+    // A recalibration by the host may move the converted time back by a few
+    // nanoseconds. Do not let a thread observe that.
+    thread_local static int64_t last_tsc_monotonic = 0;
+    if (monotonic > last_tsc_monotonic) {
+      last_tsc_monotonic = monotonic;
+    }
+    return last_tsc_monotonic;
+  }
+
   static std::atomic<int64_t> *clock_monotonic =
       GetClockAddressOrDie("clock_monotonic");
   thread_local static int64_t last_tick = *clock_monotonic;
@@ -61,11 +100,29 @@ inline int64_t MonotonicClock() {
 
 // Returns the value of a monotonic clock as a number of nanoseconds.
 inline int64_t RealtimeClock() {
+  int64_t monotonic, realtime;
+  if (TscClocks(&monotonic, &realtime)) {
+    return realtime;
+  }
+
   static std::atomic<int64_t> *clock_realtime =
       GetClockAddressOrDie("clock_realtime");
   return *clock_realtime;
 }
 
+// Sleeps shorter than this many nanoseconds busy wait inside the enclave, and
+// longer sleeps leave the enclave to sleep on the host.
+std::atomic<int64_t> nanosleep_exit_threshold(INT64_C(3000000));
+
+// Bounds on an automatically calibrated exit threshold.
+constexpr int64_t kMinCalibratedExitThreshold = INT64_C(10000);
+constexpr int64_t kMaxCalibratedExitThreshold = INT64_C(3000000);
+
+// Number of host sleeps timed to calibrate the exit threshold. The cost is
+// averaged over all of them, since the ticked monotonic clock only advances in
+// steps of tens of microseconds.
+constexpr int kExitCalibrationRounds = 16;
+
 // Busy wait with asm("pause").
 static int busy_sleep(const struct timespec *requested) {
   int64_t deadline = MonotonicClock() + TimeSpecToNanoseconds(requested);
@@ -79,14 +136,45 @@ static int busy_sleep(const struct timespec *requested) {
 
 extern "C" {
 
+void enc_set_nanosleep_exit_threshold(int64_t threshold) {
+  nanosleep_exit_threshold.store(threshold, std::memory_order_relaxed);
+}
+
+int64_t enc_nanosleep_exit_threshold() {
+  return nanosleep_exit_threshold.load(std::memory_order_relaxed);
+}
+
+int64_t enc_calibrate_nanosleep_exit_threshold() {
+  // Time zero-length host sleeps. Their cost is the enclave exit and re-entry
+  // plus the host's timer slack, which is what a sleep leaving the enclave
+  // overshoots by. Sleeps shorter than that are better spent waiting here.
+  struct timespec zero;
+  NanosecondsToTimeSpec(&zero, 0);
+  int64_t start = MonotonicClock();
+  for (int i = 0; i < kExitCalibrationRounds; ++i) {
+    enc_untrusted_nanosleep(&zero, nullptr);
+  }
+  int64_t cost = (MonotonicClock() - start) / kExitCalibrationRounds;
+
+  int64_t threshold =
+      std::min(std::max(cost, kMinCalibratedExitThreshold),
+               kMaxCalibratedExitThreshold);
+  enc_set_nanosleep_exit_threshold(threshold);
+  return threshold;
+}
+
+void enc_enable_tsc_clock() {
+  tsc_clock_enabled.store(true, std::memory_order_relaxed);
+}
+
 // Custom in-enclave nanosleep that will leave the enclave for the standard
 // nanosleep if the requested sleep time is longer than we expect an enclave
 // round-trip to take. Otherwise, busy wait.
 int nanosleep(const struct timespec *requested, struct timespec *remainder) {
-  // If we want to sleep more than 3ms, then exit the enclave to sleep.
-  constexpr int64_t kExitThreshold = INT64_C(3000000);
+  // If we want to sleep more than the exit threshold, then exit the enclave to
+  // sleep.
   int64_t delay = TimeSpecToNanoseconds(requested);
-  if (delay > kExitThreshold) {
+  if (delay > nanosleep_exit_threshold.load(std::memory_order_relaxed)) {
     return enc_untrusted_nanosleep(requested, remainder);
   }
   // Otherwise, wait on the shared clock.
@@ -24,11 +24,20 @@
 
 #include "asylo/platform/arch/include/trusted/host_calls.h"
 #include "asylo/platform/core/trusted_global_state.h"
+#include "asylo/platform/posix/host_info_cache.h"
 #include "asylo/platform/posix/io/io_manager.h"
 #include "asylo/util/statusor.h"
 
+using asylo::HostInfoCache;
 using asylo::io::IOManager;
 
+namespace {
+
+// Page size reported if the host's is unknown, the size of an SGX page.
+constexpr long kDefaultPageSize = 4096;
+
+}  // namespace
+
 extern "C" {
 
 int access(const char *path_name, int mode) {
@@ -49,6 +58,10 @@ int symlink(const char *path1, const char *path2) {
 
 int pipe(int pipefd[2]) { return IOManager::GetInstance().Pipe(pipefd); }
 
+int pipe2(int pipefd[2], int flags) {
+  return IOManager::GetInstance().Pipe2(pipefd, flags);
+}
+
 int gethostname(char *name, size_t len) {
   asylo::StatusOr<const asylo::EnclaveConfig *> config_result =
       asylo::GetEnclaveConfig();
@@ -77,11 +90,31 @@ int gethostname(char *name, size_t len) {
 // Only _SC_NPROCESSORS_ONLN and _SC_NPROCESSORS_CONF are supported for now. In
 // these cases, the return value is retrieved from the host. For any other
 // arguments, -1 is returned.
+// Processor counts and the page size are served from HostInfoCache. Counts it
+// does not hold are fetched from the host once and cached.
 long sysconf(int name) {
+  HostInfoCache &cache = HostInfoCache::GetInstance();
   switch (name) {
-    case _SC_NPROCESSORS_CONF:
-    case _SC_NPROCESSORS_ONLN:
-      return enc_untrusted_sysconf(name);
+    case _SC_NPROCESSORS_CONF: {
+      long count = cache.processors_configured();
+      if (count < 0) {
+        count = enc_untrusted_sysconf(name);
+        if (count > 0) cache.set_processors_configured(count);
+      }
+      return count;
+    }
+    case _SC_NPROCESSORS_ONLN: {
+      long count = cache.processors_online();
+      if (count < 0) {
+        count = enc_untrusted_sysconf(name);
+        if (count > 0) cache.set_processors_online(count);
+      }
+      return count;
+    }
+    case _SC_PAGESIZE: {
+      long size = cache.page_size();
+      return size > 0 ? size : kDefaultPageSize;
+    }
     default:
       errno = ENOSYS;
       return -1;
@@ -106,6 +139,18 @@ int dup2(int oldfd, int newfd) {
 
 int fsync(int fd) { return IOManager::GetInstance().FSync(fd); }
 
+int ftruncate(int fd, off_t length) {
+  return IOManager::GetInstance().FTruncate(fd, length);
+}
+
+ssize_t pread(int fd, void *buf, size_t count, off_t offset) {
+  return IOManager::GetInstance().Pread(fd, buf, count, offset);
+}
+
+ssize_t pwrite(int fd, const void *buf, size_t count, off_t offset) {
+  return IOManager::GetInstance().Pwrite(fd, buf, count, offset);
+}
+
 char *getcwd(char *buf, size_t bufsize) {
   asylo::StatusOr<const asylo::EnclaveConfig *> config_result =
       asylo::GetEnclaveConfig();
@@ -16,16 +16,28 @@
  *
  */
 
-#include <stdlib.h>
+#include <errno.h>
 #include <sys/utsname.h>
 
-#include "asylo/platform/arch/include/trusted/host_calls.h"
+#include "asylo/platform/posix/host_info_cache.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
-int uname(struct utsname *buf) { abort(); }
+// The host's uname fields are captured when the enclave is initialized and
+// served from HostInfoCache.
+int uname(struct utsname *buf) {
+  if (!buf) {
+    errno = EFAULT;
+    return -1;
+  }
+  if (!asylo::HostInfoCache::GetInstance().GetUname(buf)) {
+    errno = ENOSYS;
+    return -1;
+  }
+  return 0;
+}
 
 #ifdef __cplusplus
 }  // extern "C"
@@ -22,11 +22,15 @@
 
 // IO syscall interface constants.
 #include <fcntl.h>
+#include <sys/stat.h>
 
+#include <algorithm>
+#include <atomic>
 #include <iomanip>
 
 #include "absl/strings/escaping.h"
 #include "absl/synchronization/mutex.h"
+#include "absl/time/clock.h"
 #include "asylo/crypto/util/byte_container_view.h"
 #include "asylo/crypto/util/bytes.h"
 #include "asylo/platform/arch/include/trusted/host_calls.h"
@@ -100,9 +104,61 @@ ssize_t write_all(int fd, const void* buf, size_t len) {
   return offset;
 }
 
+// Reads from |fd| at |file_offset| without moving its cursor. Returns -1 on
+// failure, or min(|len|, bytes to EOF) on success.
+ssize_t pread_all(int fd, void* buf, size_t len, off_t file_offset) {
+  size_t bytes_to_read = len;
+  size_t offset = 0;
+
+  while (bytes_to_read > 0) {
+    ssize_t bytes_read;
+    do {
+      bytes_read =
+          enc_untrusted_pread(fd, static_cast<uint8_t*>(buf) + offset,
+                              bytes_to_read, file_offset + offset);
+    } while ((bytes_read == -1) && is_transient_error(errno));
+    if (bytes_read == -1) {
+      return -1;
+    }
+    if (bytes_read == 0) {
+      return offset;
+    }
+
+    bytes_to_read -= bytes_read;
+    offset += bytes_read;
+  }
+
+  return offset;
+}
+
+// Writes to |fd| at |file_offset| without moving its cursor. Returns -1 on
+// failure, or |len| on success.
+ssize_t pwrite_all(int fd, const void* buf, size_t len, off_t file_offset) {
+  size_t bytes_to_write = len;
+  size_t offset = 0;
+
+  while (bytes_to_write > 0) {
+    ssize_t bytes_written;
+    do {
+      bytes_written = enc_untrusted_pwrite(
+          fd, static_cast<const uint8_t*>(buf) + offset, bytes_to_write,
+          file_offset + offset);
+    } while ((bytes_written == -1) && is_transient_error(errno));
+    if (bytes_written == -1) {
+      return -1;
+    }
+
+    bytes_to_write -= bytes_written;
+    offset += bytes_written;
+  }
+
+  return offset;
+}
+
 // Returns offset to the plaintext buffer associated with the |block_index| of
-// a full block.
-const uint8_t* GetPlaintextBuffer(size_t first_partial_block_bytes_count,
+// a full block of |block_length| bytes.
+const uint8_t* GetPlaintextBuffer(size_t block_length,
+                                  size_t first_partial_block_bytes_count,
                                   int64_t block_index, const void* buf) {
   const uint8_t* plaintext_data = reinterpret_cast<const uint8_t*>(buf);
   if (first_partial_block_bytes_count > 0) {
@@ -110,39 +166,282 @@ const uint8_t* GetPlaintextBuffer(size_t first_partial_block_bytes_count,
       plaintext_data += first_partial_block_bytes_count;
     }
     if (block_index > 1) {
-      plaintext_data += (block_index - 1) * kBlockLength;
+      plaintext_data += (block_index - 1) * block_length;
     }
   } else {
-    plaintext_data += block_index * kBlockLength;
+    plaintext_data += block_index * block_length;
   }
 
   return plaintext_data;
 }
 
-uint8_t* GetPlaintextBuffer(size_t first_partial_block_bytes_count,
+uint8_t* GetPlaintextBuffer(size_t block_length,
+                            size_t first_partial_block_bytes_count,
                             int64_t block_index, void* buf) {
   return const_cast<uint8_t*>(
-      GetPlaintextBuffer(first_partial_block_bytes_count, block_index,
-                         const_cast<const void*>(buf)));
+      GetPlaintextBuffer(block_length, first_partial_block_bytes_count,
+                         block_index, const_cast<const void*>(buf)));
+}
+
+// Largest staging buffer kept by a thread between requests. Larger requests
+// grow the buffer, which is released once they complete.
+constexpr size_t kMaxRetainedStagingBytes = 1024 * 1024;
+
+// Staging buffers of the current thread for secure blocks read from and
+// written to files, reused across requests so that the space is not
+// allocated on every call. Each file operation uses at most one buffer of each
+// kind at a time, so threads do not share them.
+ABSL_CONST_INIT thread_local std::vector<uint8_t>* read_staging = nullptr;
+ABSL_CONST_INIT thread_local std::vector<uint8_t>* write_staging = nullptr;
+
+// Provides at least |size| bytes of one of the staging buffers of the current
+// thread for the duration of a request.
+class StagingBuffer {
+ public:
+  StagingBuffer(std::vector<uint8_t>** staging, size_t size) {
+    if (!*staging) {
+      *staging = new std::vector<uint8_t>();
+    }
+    storage_ = *staging;
+    if (storage_->size() < size) {
+      storage_->resize(size);
+    }
+  }
+
+  ~StagingBuffer() {
+    if (storage_->size() > kMaxRetainedStagingBytes) {
+      std::vector<uint8_t>().swap(*storage_);
+    }
+  }
+
+  uint8_t* data() { return storage_->data(); }
+
+ private:
+  std::vector<uint8_t>* storage_;
+
+  StagingBuffer(const StagingBuffer&) = delete;
+  StagingBuffer& operator=(const StagingBuffer&) = delete;
+};
+
+// Requests covering fewer bytes than this are processed on the calling thread
+// even if parallel crypto is enabled, since the cost of handing blocks to the
+// workers would exceed the gain.
+constexpr size_t kMinParallelCryptoBytes = 16384;
+
+// Approximate number of bytes of blocks processed by each parallel task.
+constexpr size_t kParallelCryptoGrainBytes = 8192;
+
+// Approximate number of bytes of blocks read by each host call when the auth
+// tags of a file are collected on open.
+constexpr size_t kAuthTagReadBytes = size_t{1} << 20;
+
+// Number of AD chunks whose auth tags are collected before they are added to
+// the AD together, which bounds the memory held for the tags.
+constexpr size_t kAuthTagWindowChunks = 16;
+
+// Number of consecutive reads of a file, each starting where the previous one
+// ended, after which blocks past the reads are fetched ahead.
+constexpr int kReadAheadTriggerReads = 2;
+
+// The file header packs the block length code into the top byte of the logical
+// file size. A zero code denotes kBlockLength, which keeps the header of files
+// with the default block length identical to the original format; any other
+// code is the base-2 logarithm of the block length. The top bit of the code
+// marks integrity-only files, whose blocks are stored in plaintext.
+constexpr int kBlockCodeShift = 56;
+constexpr uint64_t kIntegrityOnlyCode = 0x80;
+constexpr uint64_t kFileSizeMask = (uint64_t{1} << kBlockCodeShift) - 1;
+
+// Number of leaves in each chunk of the AD, which is the unit in which leaf
+// hashes are loaded from the integrity index, and the length of the slot of
+// each chunk in the index.
+constexpr size_t kChunkLeafCount =
+    MerkleAuthenticatedDictionary::kChunkLeafCount;
+constexpr size_t kLeafHashLength = MerkleAuthenticatedDictionary::kHashLength;
+constexpr size_t kIndexChunkSlotLength = kChunkLeafCount * kLeafHashLength;
+
+// Maximum number of chunks written to the integrity index in a single write.
+constexpr size_t kMaxIndexChunksPerWrite = 64;
+
+std::string IntegrityIndexPath(const std::string& path) {
+  return path + kIntegrityIndexSuffix;
+}
+
+std::string KeyRotationPath(const std::string& path) {
+  return path + kKeyRotationSuffix;
+}
+
+// Returns true if the file open on |fd| starts with |magic|, or is empty if
+// |allow_empty| is true.
+bool HasSidecarMagic(int fd, uint64_t magic, bool allow_empty) {
+  uint64_t file_magic;
+  if (enc_untrusted_lseek(fd, 0, SEEK_SET) != 0) {
+    return false;
+  }
+  ssize_t bytes_read = read_all(fd, &file_magic, sizeof(file_magic));
+  return (allow_empty && bytes_read == 0) ||
+         (bytes_read == sizeof(file_magic) && file_magic == magic);
+}
+
+// Opens the sidecar file at |path| for writing, creating it with |magic| in
+// place if it does not exist. Returns -1 with errno set to EEXIST if a file
+// at |path| is not a sidecar starting with |magic|.
+int OpenSidecarForWrite(const std::string& path, uint64_t magic) {
+  int fd = enc_untrusted_open(path.c_str(), O_RDWR | O_CREAT,
+                              S_IRUSR | S_IWUSR);
+  if (fd == -1) {
+    return -1;
+  }
+  if (!HasSidecarMagic(fd, magic, /*allow_empty=*/true)) {
+    enc_untrusted_close(fd);
+    errno = EEXIST;
+    return -1;
+  }
+  if (enc_untrusted_lseek(fd, 0, SEEK_SET) != 0 ||
+      write_all(fd, &magic, sizeof(magic)) != sizeof(magic)) {
+    enc_untrusted_close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+// Removes the file at |path| if it is a sidecar starting with |magic|.
+void RemoveSidecarFile(const std::string& path, uint64_t magic) {
+  int fd = enc_untrusted_open(path.c_str(), O_RDONLY);
+  if (fd == -1) {
+    return;
+  }
+  bool is_sidecar = HasSidecarMagic(fd, magic, /*allow_empty=*/false);
+  enc_untrusted_close(fd);
+  if (is_sidecar && enc_untrusted_unlink(path.c_str()) == -1) {
+    LOG(WARNING) << "Failed to remove sidecar file, path=" << path
+                 << ", errno = " << errno;
+  }
+}
+
+// Message authenticated under a key to identify it in a key rotation record.
+constexpr char kKeyCheckMessage[] = "asylo secure storage key rotation";
+
+bool IsSupportedBlockLength(size_t block_length) {
+  return block_length == kBlockLength || block_length == kBlockLength4KiB ||
+         block_length == kBlockLength64KiB;
+}
+
+uint64_t EncodeSizeAndBlockLength(size_t file_size, size_t block_length,
+                                  bool integrity_only) {
+  uint64_t code = 0;
+  if (block_length != kBlockLength) {
+    while ((size_t{1} << code) < block_length) {
+      code++;
+    }
+  }
+  if (integrity_only) {
+    code |= kIntegrityOnlyCode;
+  }
+  return (code << kBlockCodeShift) | (file_size & kFileSizeMask);
+}
+
+// Returns false if |encoded| does not describe a supported block length.
+bool DecodeSizeAndBlockLength(uint64_t encoded, size_t* file_size,
+                              size_t* block_length, bool* integrity_only) {
+  uint64_t code = encoded >> kBlockCodeShift;
+  *integrity_only = (code & kIntegrityOnlyCode) != 0;
+  code &= ~kIntegrityOnlyCode;
+  *file_size = encoded & kFileSizeMask;
+  if (code == 0) {
+    *block_length = kBlockLength;
+    return true;
+  }
+  if (code >= 8 * sizeof(size_t)) {
+    return false;
+  }
+  *block_length = size_t{1} << code;
+  return *block_length != kBlockLength &&
+         IsSupportedBlockLength(*block_length);
 }
 
 }  // namespace
 
 using Tag = UnsafeBytes<kTagLength>;
-using Token = UnsafeBytes<kTokenLength>;
-using Block = UnsafeBytes<kBlockLength>;
-using Ciphertext = UnsafeBytes<kCipherBlockLength>;
-using SecureBlock = UnsafeBytes<kSecureBlockLength>;
 
 using TagView = ByteContainerView;
-using TokenView = ByteContainerView;
-using BlockView = ByteContainerView;
-using CiphertextView = ByteContainerView;
-using SecureBlockView = ByteContainerView;
+
+void AeadHandler::RemoveSidecarFiles(const std::string& path) {
+  RemoveSidecarFile(IntegrityIndexPath(path), kIntegrityIndexMagic);
+  RemoveSidecarFile(KeyRotationPath(path), kKeyRotationMagic);
+}
 
 AeadHandler::AeadHandler()
-    : offset_translator_(OffsetTranslator::Create(
-          sizeof(FileHeader), kBlockLength, kSecureBlockLength)) {}
+    : read_ahead_bytes_(0),
+      block_cache_bytes_(0),
+      digest_write_back_updates_(0) {
+  offset_translators_.emplace(
+      kBlockLength, absl::make_unique<BlockOffsetTranslator<kBlockLength>>());
+  offset_translators_.emplace(
+      kBlockLength4KiB,
+      absl::make_unique<BlockOffsetTranslator<kBlockLength4KiB>>());
+  offset_translators_.emplace(
+      kBlockLength64KiB,
+      absl::make_unique<BlockOffsetTranslator<kBlockLength64KiB>>());
+}
+
+template <typename LockT>
+AeadHandler::FileControl* AeadHandler::AcquireFile(
+    int fd, std::shared_ptr<FileControl>* file_ref,
+    std::unique_ptr<LockT>* file_lock) {
+  {
+    FileShard& shard = GetFileShard(fd);
+    absl::ReaderMutexLock shard_lock(&shard.mu);
+    auto entry = shard.files.find(fd);
+    if (entry == shard.files.end()) {
+      return nullptr;
+    }
+    *file_ref = entry->second;
+  }
+
+  *file_lock = absl::make_unique<LockT>(&(*file_ref)->mu);
+  if ((*file_ref)->fds.count(fd) == 0) {
+    file_lock->reset();
+    file_ref->reset();
+    return nullptr;
+  }
+  return file_ref->get();
+}
+
+const OffsetTranslator* AeadHandler::GetOffsetTranslatorForBlockLength(
+    size_t block_length) const {
+  auto it = offset_translators_.find(block_length);
+  return it == offset_translators_.end() ? nullptr : it->second.get();
+}
+
+bool AeadHandler::ReadBlockLength(const std::string& path,
+                                  size_t* block_length,
+                                  bool* integrity_only) const {
+  int fd = enc_untrusted_open(path.c_str(), O_RDONLY);
+  if (fd == -1) {
+    LOG(ERROR) << "Failed to open file to read its header, path=" << path
+               << ", errno = " << errno;
+    return false;
+  }
+
+  FdCloser fd_closer(fd, &enc_untrusted_close);
+
+  FileHeader file_header;
+  ssize_t bytes_read = read_all(fd, file_header.data(), sizeof(FileHeader));
+  if (bytes_read != sizeof(FileHeader)) {
+    LOG(ERROR) << "Failed to read the file header, bytes read = " << bytes_read;
+    return false;
+  }
+
+  size_t file_size;
+  if (!DecodeSizeAndBlockLength(file_header.size_and_block_code, &file_size,
+                                block_length, integrity_only)) {
+    LOG(ERROR) << "Unsupported block length recorded for file, path=" << path;
+    errno = EINVAL;
+    return false;
+  }
+  return true;
+}
 
 bool AeadHandler::Deserialize(FileControl* file_ctrl) {
   if (!file_ctrl) {
@@ -150,13 +449,13 @@ bool AeadHandler::Deserialize(FileControl* file_ctrl) {
     return false;
   }
 
-  const GcmCryptor* cryptor = GetGcmCryptor(*file_ctrl);
+  const GcmCryptor* cryptor = GetDigestCryptor(*file_ctrl);
   if (!cryptor) {
     return false;
   }
 
   if (file_ctrl->is_new) {
-    if (!UpdateDigest(file_ctrl, *cryptor)) {
+    if (!UpdateDigest(file_ctrl)) {
       LOG(ERROR) << "Failed to update header on a new file, path="
                  << file_ctrl->path << ", errno = " << errno;
       return false;
@@ -168,7 +467,7 @@ bool AeadHandler::Deserialize(FileControl* file_ctrl) {
     return true;
   }
 
-  // Rebuild the Merkle tree.
+  // Restore the Merkle tree.
   int fd = enc_untrusted_open(file_ctrl->path.c_str(), O_RDONLY);
   if (fd == -1) {
     LOG(ERROR) << "Failed to open file for collecting security metadata, path="
@@ -190,174 +489,849 @@ bool AeadHandler::Deserialize(FileControl* file_ctrl) {
   // collect integrity metadata across the file using the initially untrusted
   // value of the file size - then validation of the hash of the file digest
   // confirms validity of both the file size and the integrity metadata.
-  const int64_t blocks_count =
-      (file_header.file_size + kBlockLength - 1) / kBlockLength;
-  Tag tag;
-  for (int64_t block_index = 0; block_index < blocks_count; block_index++) {
-    off_t offset = enc_untrusted_lseek(fd, kBlockLength, SEEK_CUR);
-    if (offset == -1) {
-      LOG(ERROR)
-          << "Failed lseek past block when collecting integrity metadata.";
-      return false;
-    }
-
-    bytes_read = read_all(fd, tag.data(), kTagLength);
-    if (bytes_read != kTagLength) {
-      LOG(ERROR) << "Failed to read integrity metadata, bytes_read="
-                 << bytes_read;
-      return false;
-    }
+  size_t file_size;
+  size_t block_length;
+  bool integrity_only;
+  if (!DecodeSizeAndBlockLength(file_header.size_and_block_code, &file_size,
+                                &block_length, &integrity_only) ||
+      block_length != file_ctrl->block_length ||
+      integrity_only != file_ctrl->integrity_only) {
+    LOG(ERROR) << "Unexpected block length or mode in the file header, path="
+               << file_ctrl->path;
+    return false;
+  }
 
-    std::string tag_string(reinterpret_cast<char*>(tag.data()), kTagLength);
-    VLOG(2) << "Adding auth tag as leaf to rebuild Merkle tree: "
-            << absl::BytesToHexString(tag_string);
-    file_ctrl->ad->AddLeaf(tag_string);
+  // A file extended by Truncate has fewer blocks than its size covers, and
+  // the blocks past them read as zeros. The number of blocks is bounded by the
+  // untrusted size of the file on the host, and is validated along with the
+  // AD, whose root depends on it, before any integrity metadata is allocated
+  // for them.
+  const off_t physical_eof_offset = enc_untrusted_lseek(fd, 0, SEEK_END);
+  if (physical_eof_offset == -1 ||
+      enc_untrusted_lseek(fd, sizeof(FileHeader), SEEK_SET) == -1) {
+    LOG(ERROR) << "Failed lseek when collecting integrity metadata.";
+    return false;
+  }
+  const int64_t blocks_count = std::min<int64_t>(
+      (file_size + block_length - 1) / block_length,
+      std::max<off_t>(physical_eof_offset - sizeof(FileHeader), 0) /
+          static_cast<off_t>(file_ctrl->secure_block_length()));
+
+  // Restore the AD from the chunk roots in the integrity index, which defers
+  // reading the leaf hashes of each chunk until its blocks are accessed. If the
+  // index is missing or stale, e.g. because the file was not closed after its
+  // last write, fall back to collecting the auth tags of all blocks.
+  if (LoadIntegrityIndex(file_ctrl, blocks_count) &&
+      ValidateDigest(file_ctrl, file_header, *cryptor)) {
+    VLOG(2) << "Restored chunk roots from the integrity index.";
+    file_ctrl->logical_size = file_size;
+    file_ctrl->sealed_leaf_count = blocks_count;
+    return true;
+  }
 
-    offset = enc_untrusted_lseek(fd, kTokenLength, SEEK_CUR);
-    if (offset == -1) {
-      LOG(ERROR)
-          << "Failed lseek past token when collecting integrity metadata.";
-      return false;
-    }
+  file_ctrl->ad = absl::make_unique<MerkleAuthenticatedDictionary>();
+  if (!CollectAuthTags(fd, file_ctrl, blocks_count)) {
+    return false;
   }
 
   VLOG(2) << "Pushed block auth tags on initialization.";
 
+  // Validate AD root, the file size and the block length.
+  if (!ValidateDigest(file_ctrl, file_header, *cryptor)) {
+    LOG(ERROR) << "Failure validating integrity root for file "
+               << file_ctrl->path << ", current root: "
+               << absl::BytesToHexString(file_ctrl->ad->CurrentRoot());
+    return false;
+  }
+
+  // Write the whole index when the file is finalized, so that it can be used
+  // the next time the file is opened.
+  for (size_t chunk = 0; chunk < file_ctrl->ad->ChunkCount(); chunk++) {
+    file_ctrl->dirty_index_chunks.insert(chunk);
+  }
+
+  file_ctrl->logical_size = file_size;
+  file_ctrl->sealed_leaf_count = blocks_count;
+  return true;
+}
+
+bool AeadHandler::ValidateDigest(FileControl* file_ctrl,
+                                 const FileHeader& file_header,
+                                 const GcmCryptor& cryptor) const {
   // Prepare file data digest.
   DataDigest data_digest;
   std::copy_n(
       reinterpret_cast<const uint8_t*>(file_ctrl->ad->CurrentRoot().data()),
       kRootHashLength, data_digest.data());
-  data_digest.file_size = file_header.file_size;
+  data_digest.size_and_block_code = file_header.size_and_block_code;
 
-  // Validate AD root and the file size.
   FileHash new_hash;
-  if (!cryptor->GetAuthTag(new_hash.data(), data_digest.data(),
-                           sizeof(DataDigest))) {
+  if (!cryptor.GetAuthTag(new_hash.data(), data_digest.data(),
+                          sizeof(DataDigest))) {
     LOG(ERROR) << "Failed to generate CMAC for integrity verification, root="
                << file_ctrl->ad->CurrentRoot();
     return false;
   }
 
-  if (new_hash != file_header.file_hash) {
-    LOG(ERROR) << "Failure validating integrity root for file "
-               << file_ctrl->path << ", current root: "
-               << absl::BytesToHexString(file_ctrl->ad->CurrentRoot());
-    return false;
+  return new_hash == file_header.file_hash;
+}
+
+bool AeadHandler::CollectAuthTags(int fd, FileControl* file_ctrl,
+                                  int64_t blocks_count) const {
+  const size_t block_length = file_ctrl->block_length;
+  const size_t secure_block_length = file_ctrl->secure_block_length();
+  const int64_t window_blocks =
+      kAuthTagWindowChunks * MerkleAuthenticatedDictionary::kChunkLeafCount;
+  const int64_t read_blocks =
+      std::max<size_t>(1, kAuthTagReadBytes / secure_block_length);
+  std::vector<uint8_t> blocks(std::min(read_blocks, blocks_count) *
+                              secure_block_length);
+  std::vector<uint8_t> tags(std::min(window_blocks, blocks_count) *
+                            kTagLength);
+
+  // Whole chunks of the AD are independent subtrees, which are hashed on the
+  // crypto workers if parallel crypto is enabled.
+  const MerkleAuthenticatedDictionary::ParallelFor parallel_for =
+      [this](size_t count, const std::function<void(size_t, size_t)>& body) {
+        if (!crypto_executor_ || count < 2) {
+          body(0, count);
+          return;
+        }
+        crypto_executor_->ParallelFor(0, count, 1, body);
+      };
+
+  for (int64_t window = 0; window < blocks_count; window += window_blocks) {
+    const int64_t window_count =
+        std::min(window_blocks, blocks_count - window);
+
+    // Read whole blocks rather than seeking to each tag, so that the tags of
+    // many blocks are collected with a single host call.
+    for (int64_t done = 0; done < window_count;) {
+      const int64_t count = std::min(read_blocks, window_count - done);
+      const size_t length = count * secure_block_length;
+      const off_t offset =
+          sizeof(FileHeader) + (window + done) * secure_block_length;
+      ssize_t bytes_read = pread_all(fd, blocks.data(), length, offset);
+      if (bytes_read != length) {
+        LOG(ERROR) << "Failed to read integrity metadata, bytes_read="
+                   << bytes_read;
+        return false;
+      }
+      for (int64_t i = 0; i < count; i++) {
+        std::copy_n(blocks.data() + i * secure_block_length + block_length,
+                    kTagLength, tags.data() + (done + i) * kTagLength);
+      }
+      done += count;
+    }
+
+    VLOG(2) << "Adding " << window_count
+            << " auth tags as leaves to rebuild Merkle tree.";
+    if (file_ctrl->ad->AddLeaves(tags.data(), kTagLength, window_count,
+                                 parallel_for) == 0) {
+      LOG(ERROR) << "Failed to add auth tags to the Merkle tree.";
+      return false;
+    }
   }
 
-  file_ctrl->logical_size = file_header.file_size;
   return true;
 }
 
-bool AeadHandler::InitializeFile(int fd, const char* path_name,
-                                 bool is_new_file) {
-  if (!IsPathNameValid(path_name)) {
-    LOG(ERROR) << "Invalid input when initializing file, path_name="
-               << path_name;
-    errno = EINVAL;
+bool AeadHandler::LoadIntegrityIndex(FileControl* file_ctrl,
+                                     size_t leaf_count) const {
+  int fd = enc_untrusted_open(IntegrityIndexPath(file_ctrl->path).c_str(),
+                              O_RDONLY);
+  if (fd == -1) {
+    VLOG(2) << "No integrity index for file, path=" << file_ctrl->path;
     return false;
   }
 
-  absl::MutexLock global_lock(&mu_);
+  FdCloser fd_closer(fd, &enc_untrusted_close);
 
-  auto fd_it = fmap_.find(fd);
-  if (fd_it != fmap_.end()) {
-    LOG(ERROR) << "Attempt made to initialize already initialized file, fd="
-               << fd << ", path_name = " << path_name
-               << ", is_new_file = " << is_new_file;
-    errno = EEXIST;
+  IndexHeader index_header;
+  ssize_t bytes_read = read_all(fd, &index_header, sizeof(IndexHeader));
+  if (bytes_read != sizeof(IndexHeader) ||
+      index_header.magic != kIntegrityIndexMagic ||
+      index_header.leaf_count != leaf_count ||
+      index_header.chunk_leaf_count != kChunkLeafCount) {
+    VLOG(2) << "Integrity index does not match the file, path="
+            << file_ctrl->path;
     return false;
   }
 
-  VLOG(2) << "Initializing secure file, fd = " << fd
-          << ", path_name = " << path_name;
-  auto path_it = opened_files_.find(path_name);
-  std::shared_ptr<FileControl> file_ctrl =
-      (path_it == opened_files_.end())
-          ? std::make_shared<FileControl>(path_name, is_new_file)
-          : path_it->second;
-  fmap_.emplace(fd, file_ctrl);
-  opened_files_.emplace(path_name, file_ctrl);
+  // Read all chunk roots at once.
+  const size_t chunk_count =
+      (leaf_count + kChunkLeafCount - 1) / kChunkLeafCount;
+  std::vector<uint8_t> chunk_roots(chunk_count * kLeafHashLength);
+  const off_t roots_offset =
+      sizeof(IndexHeader) + chunk_count * kIndexChunkSlotLength;
+  if (enc_untrusted_lseek(fd, roots_offset, SEEK_SET) != roots_offset) {
+    LOG(ERROR) << "Failed lseek to the chunk roots of the integrity index.";
+    return false;
+  }
+  bytes_read = read_all(fd, chunk_roots.data(), chunk_roots.size());
+  if (bytes_read != chunk_roots.size()) {
+    VLOG(2) << "Failed to read the chunk roots of the integrity index, "
+               "bytes_read="
+            << bytes_read;
+    return false;
+  }
 
+  file_ctrl->ad->ResetToChunkRoots(leaf_count, chunk_roots.data());
   return true;
 }
 
-bool AeadHandler::RetrieveLogicalOffset(int fd, off_t* logical_offset) const {
-  if (fd < 0) {
-    errno = EINVAL;
-    return false;
+bool AeadHandler::LoadIntegrityChunks(FileControl* file_ctrl,
+                                      int64_t first_block,
+                                      int64_t last_block) const {
+  MerkleAuthenticatedDictionary* ad = file_ctrl->ad.get();
+  first_block = std::max<int64_t>(first_block, 0);
+  last_block = std::min<int64_t>(last_block, ad->LeafCount() - 1);
+  if (first_block > last_block) {
+    return true;
   }
 
-  off_t physical_offset = enc_untrusted_lseek(fd, 0, SEEK_CUR);
-  if (physical_offset == -1) {
-    LOG(ERROR) << "Failed to retrieve SEEK_CUR offset on descriptor: " << fd;
-    return false;
+  const size_t first_chunk = first_block / kChunkLeafCount;
+  const size_t last_chunk = last_block / kChunkLeafCount;
+  size_t chunk = first_chunk;
+  while (chunk <= last_chunk && ad->IsChunkLoaded(chunk)) {
+    chunk++;
+  }
+  if (chunk > last_chunk) {
+    return true;
   }
 
-  *logical_offset = offset_translator_->PhysicalToLogical(physical_offset);
-  if (*logical_offset == OffsetTranslator::kInvalidOffset) {
-    LOG(ERROR) << "The file is corrupted, fd = " << fd;
+  int fd = enc_untrusted_open(IntegrityIndexPath(file_ctrl->path).c_str(),
+                              O_RDONLY);
+  if (fd == -1) {
+    LOG(ERROR) << "Failed to open the integrity index of file, path="
+               << file_ctrl->path << ", errno = " << errno;
     return false;
   }
 
+  FdCloser fd_closer(fd, &enc_untrusted_close);
+
+  // Read each run of consecutive chunks that are not loaded at once.
+  std::vector<uint8_t> leaf_hashes;
+  while (chunk <= last_chunk) {
+    size_t end_chunk = chunk + 1;
+    while (end_chunk <= last_chunk && !ad->IsChunkLoaded(end_chunk)) {
+      end_chunk++;
+    }
+
+    const size_t first_leaf = chunk * kChunkLeafCount;
+    const size_t end_leaf =
+        std::min(end_chunk * kChunkLeafCount, ad->LeafCount());
+    leaf_hashes.resize((end_leaf - first_leaf) * kLeafHashLength);
+    const off_t offset = sizeof(IndexHeader) + chunk * kIndexChunkSlotLength;
+    ssize_t bytes_read =
+        pread_all(fd, leaf_hashes.data(), leaf_hashes.size(), offset);
+    if (bytes_read != leaf_hashes.size()) {
+      LOG(ERROR) << "Failed to read a chunk of the integrity index, bytes_read="
+                 << bytes_read;
+      return false;
+    }
+
+    for (; chunk < end_chunk; chunk++) {
+      if (!ad->LoadChunk(chunk, leaf_hashes.data() +
+                                    (chunk * kChunkLeafCount - first_leaf) *
+                                        kLeafHashLength)) {
+        LOG(ERROR) << "Integrity verification of the integrity index failed, "
+                      "path="
+                   << file_ctrl->path << ", chunk = " << chunk;
+        return false;
+      }
+    }
+
+    while (chunk <= last_chunk && ad->IsChunkLoaded(chunk)) {
+      chunk++;
+    }
+  }
+
+  VLOG(2) << "Loaded integrity index chunks up to " << last_chunk
+          << ", path = " << file_ctrl->path;
   return true;
 }
 
-GcmCryptor* AeadHandler::GetGcmCryptor(const FileControl& file_ctrl) const {
-  if (!file_ctrl.master_key) {
-    LOG(ERROR) << "Master key has not been set, path = " << file_ctrl.path;
-    return nullptr;
+bool AeadHandler::AreIntegrityChunksLoaded(const FileControl& file_ctrl,
+                                           int64_t first_block,
+                                           int64_t last_block) const {
+  const MerkleAuthenticatedDictionary& ad = *file_ctrl.ad;
+  first_block = std::max<int64_t>(first_block, 0);
+  last_block = std::min<int64_t>(last_block, ad.LeafCount() - 1);
+  if (first_block > last_block) {
+    return true;
   }
 
-  GcmCryptor* cryptor = GcmCryptorRegistry::GetInstance().GetGcmCryptor(
-      kBlockLength, *file_ctrl.master_key);
-  if (!cryptor) {
-    LOG(ERROR) << "Unable to instantiate GCM cryptor.";
+  for (size_t chunk = first_block / kChunkLeafCount;
+       chunk <= last_block / kChunkLeafCount; chunk++) {
+    if (!ad.IsChunkLoaded(chunk)) {
+      return false;
+    }
   }
-
-  return cryptor;
+  return true;
 }
 
-ssize_t AeadHandler::DecryptAndVerify(int fd, void* buf, size_t count) {
-  if (!buf) {
-    errno = EINVAL;
-    return -1;
+bool AeadHandler::PersistIntegrityIndex(FileControl* file_ctrl) const {
+  if (file_ctrl->dirty_index_chunks.empty()) {
+    return true;
   }
 
-  off_t logical_offset;
-  if (!RetrieveLogicalOffset(fd, &logical_offset)) {
-    return -1;
+  int fd = OpenSidecarForWrite(IntegrityIndexPath(file_ctrl->path),
+                               kIntegrityIndexMagic);
+  if (fd == -1) {
+    LOG(ERROR) << "Failed to open the integrity index of file, path="
+               << file_ctrl->path << ", errno = " << errno;
+    return false;
   }
 
-  FileControl* file_ctrl;
-  std::unique_ptr<absl::MutexLock> file_lock;
-  {
-    absl::MutexLock global_lock(&mu_);
+  FdCloser fd_closer(fd, &enc_untrusted_close);
 
-    auto entry = fmap_.find(fd);
-    if (entry == fmap_.end()) {
-      LOG(ERROR) << "Attempt made to read from an unopened file, fd = " << fd;
-      errno = ENOENT;
-      return -1;
+  // Write each run of consecutive dirty chunks at once, up to a bounded
+  // buffer size. The chunk roots and the header are written last, so that the
+  // index only passes validation once all its chunks are in place.
+  MerkleAuthenticatedDictionary* ad = file_ctrl->ad.get();
+  std::vector<uint8_t> leaf_hashes;
+  auto it = file_ctrl->dirty_index_chunks.begin();
+  while (it != file_ctrl->dirty_index_chunks.end()) {
+    const size_t first_chunk = *it;
+    size_t end_chunk = first_chunk;
+    leaf_hashes.clear();
+    while (it != file_ctrl->dirty_index_chunks.end() && *it == end_chunk &&
+           end_chunk - first_chunk < kMaxIndexChunksPerWrite) {
+      const size_t length = ad->ChunkLeafCount(end_chunk) * kLeafHashLength;
+      leaf_hashes.resize(leaf_hashes.size() + length);
+      ad->CopyChunkLeafHashes(end_chunk,
+                              leaf_hashes.data() + leaf_hashes.size() - length);
+      ++it;
+      end_chunk++;
     }
 
-    file_ctrl = entry->second.get();
-    file_lock = absl::make_unique<absl::MutexLock>(&file_ctrl->mu);
+    const off_t offset =
+        sizeof(IndexHeader) + first_chunk * kIndexChunkSlotLength;
+    if (enc_untrusted_lseek(fd, offset, SEEK_SET) != offset ||
+        write_all(fd, leaf_hashes.data(), leaf_hashes.size()) !=
+            leaf_hashes.size()) {
+      LOG(ERROR) << "Failed to write a chunk of the integrity index, path="
+                 << file_ctrl->path;
+      return false;
+    }
   }
 
-  return DecryptAndVerifyInternal(fd, buf, count, *file_ctrl, logical_offset);
-}
+  const size_t chunk_count = ad->ChunkCount();
+  std::vector<uint8_t> chunk_roots(chunk_count * kLeafHashLength);
+  ad->CopyChunkRoots(chunk_roots.data());
+  const off_t roots_offset =
+      sizeof(IndexHeader) + chunk_count * kIndexChunkSlotLength;
+  if (enc_untrusted_lseek(fd, roots_offset, SEEK_SET) != roots_offset ||
+      write_all(fd, chunk_roots.data(), chunk_roots.size()) !=
+          chunk_roots.size()) {
+    LOG(ERROR) << "Failed to write the chunk roots of the integrity index, "
+                  "path="
+               << file_ctrl->path;
+    return false;
+  }
 
-ssize_t AeadHandler::DecryptAndVerifyInternal(int fd, void* buf, size_t count,
-                                              const FileControl& file_ctrl,
-                                              off_t logical_offset) const {
-  if (count == 0) {
-    return 0;
+  IndexHeader index_header;
+  index_header.magic = kIntegrityIndexMagic;
+  index_header.leaf_count = ad->LeafCount();
+  index_header.chunk_leaf_count = kChunkLeafCount;
+  if (enc_untrusted_lseek(fd, 0, SEEK_SET) != 0 ||
+      write_all(fd, &index_header, sizeof(IndexHeader)) !=
+          sizeof(IndexHeader)) {
+    LOG(ERROR) << "Failed to write the header of the integrity index, path="
+               << file_ctrl->path;
+    return false;
   }
 
-  // Check for logical EOF.
-  if (logical_offset >= file_ctrl.logical_size) {
+  if (!fd_closer.reset()) {
+    LOG(ERROR) << "Failed to close the integrity index, path="
+               << file_ctrl->path;
+    return false;
+  }
+
+  file_ctrl->dirty_index_chunks.clear();
+  return true;
+}
+
+bool AeadHandler::InitializeFile(int fd, const char* path_name,
+                                 bool is_new_file, bool is_append,
+                                 bool integrity_only) {
+  if (!IsPathNameValid(path_name)) {
+    LOG(ERROR) << "Invalid input when initializing file, path_name="
+               << path_name;
+    errno = EINVAL;
+    return false;
+  }
+
+  absl::MutexLock global_lock(&mu_);
+
+  FileShard& shard = GetFileShard(fd);
+  bool is_open;
+  {
+    absl::ReaderMutexLock shard_lock(&shard.mu);
+    is_open = shard.files.count(fd) > 0;
+  }
+  if (is_open) {
+    LOG(ERROR) << "Attempt made to initialize already initialized file, fd="
+               << fd << ", path_name = " << path_name
+               << ", is_new_file = " << is_new_file;
+    errno = EEXIST;
+    return false;
+  }
+
+  VLOG(2) << "Initializing secure file, fd = " << fd
+          << ", path_name = " << path_name;
+  auto path_it = opened_files_.find(path_name);
+  std::shared_ptr<FileControl> file_ctrl;
+  if (path_it != opened_files_.end()) {
+    file_ctrl = path_it->second;
+  } else {
+    // Existing files keep the block length and mode they were created with, so
+    // that offsets are translated correctly from the start.
+    size_t block_length = kBlockLength;
+    bool recorded_integrity_only = integrity_only;
+    if (!is_new_file && !ReadBlockLength(path_name, &block_length,
+                                         &recorded_integrity_only)) {
+      return false;
+    }
+    file_ctrl = std::make_shared<FileControl>(
+        path_name, is_new_file, block_length, recorded_integrity_only,
+        GetOffsetTranslatorForBlockLength(block_length));
+  }
+  if (file_ctrl->integrity_only != integrity_only) {
+    LOG(ERROR) << "Attempt made to open a file in a mode other than the one "
+                  "it was created with, path_name = "
+               << path_name << ", integrity_only = " << integrity_only;
+    errno = EINVAL;
+    return false;
+  }
+  {
+    absl::MutexLock file_lock(&file_ctrl->mu);
+    file_ctrl->fds[fd] = is_append;
+  }
+  {
+    absl::MutexLock shard_lock(&shard.mu);
+    shard.files.emplace(fd, file_ctrl);
+  }
+  opened_files_.emplace(path_name, file_ctrl);
+
+  return true;
+}
+
+bool AeadHandler::SetLogicalOffset(int fd, const FileControl& file_ctrl,
+                                   off_t logical_offset) const {
+  const off_t physical_offset =
+      file_ctrl.offset_translator->LogicalToPhysical(logical_offset);
+  return enc_untrusted_lseek(fd, physical_offset, SEEK_SET) != -1;
+}
+
+bool AeadHandler::RetrieveLogicalOffset(int fd, const FileControl& file_ctrl,
+                                        off_t* logical_offset) const {
+  if (fd < 0) {
+    errno = EINVAL;
+    return false;
+  }
+
+  off_t physical_offset = enc_untrusted_lseek(fd, 0, SEEK_CUR);
+  if (physical_offset == -1) {
+    LOG(ERROR) << "Failed to retrieve SEEK_CUR offset on descriptor: " << fd;
+    return false;
+  }
+
+  *logical_offset =
+      file_ctrl.offset_translator->PhysicalToLogical(physical_offset);
+  if (*logical_offset == OffsetTranslator::kInvalidOffset) {
+    LOG(ERROR) << "The file is corrupted, fd = " << fd;
+    return false;
+  }
+
+  return true;
+}
+
+GcmCryptor* AeadHandler::GetGcmCryptor(const FileControl& file_ctrl) const {
+  if (!file_ctrl.has_key_rotation) {
+    return GetDigestCryptor(file_ctrl);
+  }
+
+  if (!file_ctrl.rotation_key) {
+    LOG(ERROR) << "Key rotation has not been resumed, path = "
+               << file_ctrl.path;
+    errno = EACCES;
+    return nullptr;
+  }
+
+  GcmCryptor* cryptor = GcmCryptorRegistry::GetInstance().GetGcmCryptor(
+      file_ctrl.block_length, *file_ctrl.rotation_key,
+      file_ctrl.integrity_only);
+  if (!cryptor) {
+    LOG(ERROR) << "Unable to instantiate GCM cryptor.";
+  }
+
+  return cryptor;
+}
+
+GcmCryptor* AeadHandler::GetDigestCryptor(const FileControl& file_ctrl) const {
+  if (!file_ctrl.master_key) {
+    LOG(ERROR) << "Master key has not been set, path = " << file_ctrl.path;
+    return nullptr;
+  }
+
+  GcmCryptor* cryptor = GcmCryptorRegistry::GetInstance().GetGcmCryptor(
+      file_ctrl.block_length, *file_ctrl.master_key, file_ctrl.integrity_only);
+  if (!cryptor) {
+    LOG(ERROR) << "Unable to instantiate GCM cryptor.";
+  }
+
+  return cryptor;
+}
+
+bool AeadHandler::DecryptFileBlocks(const FileControl& file_ctrl,
+                                    GcmCryptor* cryptor, size_t count,
+                                    const int64_t* block_indices,
+                                    const uint8_t* const ciphertexts[],
+                                    const uint8_t* const tokens[],
+                                    uint8_t* const plaintexts[]) const {
+  if (!file_ctrl.has_key_rotation) {
+    return cryptor->DecryptBlocks(count, ciphertexts, tokens, plaintexts);
+  }
+
+  GcmCryptor* previous_cryptor = GetDigestCryptor(file_ctrl);
+  if (!previous_cryptor) {
+    return false;
+  }
+
+  // Blocks re-encrypted by a rotation step that was interrupted before its
+  // progress was recorded are under the new key past the rotation point, so a
+  // block is decrypted with the other key if the key of its side fails. The
+  // auth tag of the block is verified against the AD either way. A failed
+  // attempt clears its output, which may overlap the ciphertext, so each block
+  // is decrypted into a bounce block.
+  const size_t block_length = file_ctrl.block_length;
+  std::vector<uint8_t> block(block_length);
+  uint8_t* const block_data = block.data();
+  for (size_t idx = 0; idx < count; idx++) {
+    GcmCryptor* expected_cryptor = block_indices[idx] < file_ctrl.rotated_blocks
+                                       ? cryptor
+                                       : previous_cryptor;
+    GcmCryptor* other_cryptor =
+        expected_cryptor == cryptor ? previous_cryptor : cryptor;
+    if (!expected_cryptor->DecryptBlocks(1, &ciphertexts[idx], &tokens[idx],
+                                         &block_data) &&
+        !other_cryptor->DecryptBlocks(1, &ciphertexts[idx], &tokens[idx],
+                                      &block_data)) {
+      return false;
+    }
+    std::copy_n(block_data, block_length, plaintexts[idx]);
+  }
+
+  return true;
+}
+
+ssize_t AeadHandler::DecryptAndVerify(int fd, void* buf, size_t count) {
+  if (!buf) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  std::shared_ptr<FileControl> file_ref;
+  std::unique_ptr<absl::MutexLock> file_lock;
+  FileControl* file_ctrl = AcquireFile(fd, &file_ref, &file_lock);
+  if (!file_ctrl) {
+    LOG(ERROR) << "Attempt made to read from an unopened file, fd = " << fd;
+    errno = ENOENT;
+    return -1;
+  }
+
+  off_t logical_offset;
+  if (!RetrieveLogicalOffset(fd, *file_ctrl, &logical_offset)) {
+    return -1;
+  }
+
+  ssize_t bytes_read = ReadLocked(fd, buf, count, file_ctrl, logical_offset);
+  if (bytes_read > 0 &&
+      !SetLogicalOffset(fd, *file_ctrl, logical_offset + bytes_read)) {
+    LOG(ERROR) << "Failed lseek to the end of read range.";
+    return -1;
+  }
+
+  return bytes_read;
+}
+
+ssize_t AeadHandler::DecryptAndVerifyAt(int fd, void* buf, size_t count,
+                                        off_t logical_offset) {
+  if (!buf || logical_offset < 0) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  // Reads of blocks whose integrity metadata is loaded, from files without a
+  // block cache or appends held back in the enclave, do not modify the
+  // FileControl, so readers share the file lock and proceed concurrently.
+  {
+    std::shared_ptr<FileControl> file_ref;
+    std::unique_ptr<absl::ReaderMutexLock> file_lock;
+    FileControl* file_ctrl = AcquireFile(fd, &file_ref, &file_lock);
+    if (!file_ctrl) {
+      LOG(ERROR) << "Attempt made to read from an unopened file, fd = "
+                 << fd;
+      errno = ENOENT;
+      return -1;
+    }
+
+    if (!file_ctrl->cache && !file_ctrl->has_append_tail &&
+        (count == 0 ||
+         AreIntegrityChunksLoaded(
+             *file_ctrl, logical_offset / file_ctrl->block_length,
+             (logical_offset + count - 1) / file_ctrl->block_length))) {
+      return ReadSequential(fd, buf, count, *file_ctrl, logical_offset);
+    }
+  }
+
+  // Otherwise the read loads integrity metadata or updates the block cache,
+  // and takes the file lock exclusively. The file is looked up again, since it
+  // may have been closed while no lock was held.
+  std::shared_ptr<FileControl> file_ref;
+  std::unique_ptr<absl::MutexLock> file_lock;
+  FileControl* file_ctrl = AcquireFile(fd, &file_ref, &file_lock);
+  if (!file_ctrl) {
+    LOG(ERROR) << "Attempt made to read from an unopened file, fd = " << fd;
+    errno = ENOENT;
+    return -1;
+  }
+
+  return ReadLocked(fd, buf, count, file_ctrl, logical_offset);
+}
+
+ssize_t AeadHandler::ReadLocked(int fd, void* buf, size_t count,
+                                FileControl* file_ctrl,
+                                off_t logical_offset) const {
+  if (file_ctrl->cache) {
+    return ReadCached(fd, buf, count, file_ctrl, logical_offset);
+  }
+
+  // Reads see the data held back by appends once it is written to the file.
+  if (!FlushAppends(file_ctrl)) {
+    return -1;
+  }
+
+  // Load the leaf hashes of the blocks to read if they have not been accessed
+  // since the file was opened.
+  if (count > 0 &&
+      !LoadIntegrityChunks(file_ctrl, logical_offset / file_ctrl->block_length,
+                           (logical_offset + count - 1) /
+                               file_ctrl->block_length)) {
+    return -1;
+  }
+
+  return ReadSequential(fd, buf, count, *file_ctrl, logical_offset);
+}
+
+ssize_t AeadHandler::ReadSequential(int fd, void* buf, size_t count,
+                                    const FileControl& file_ctrl,
+                                    off_t logical_offset) const {
+  if (!read_ahead_executor_ || count == 0 || file_ctrl.has_key_rotation) {
+    return DecryptAndVerifyInternal(fd, buf, count, file_ctrl, logical_offset);
+  }
+
+  // Only ranges of stored blocks are served from the read-ahead. Reads at the
+  // end of the file or of its data are left to DecryptAndVerifyInternal.
+  ReadAhead* read_ahead = file_ctrl.read_ahead.get();
+  const size_t block_length = file_ctrl.block_length;
+  const off_t stored_end =
+      std::min<off_t>(file_ctrl.logical_size,
+                      file_ctrl.ad->LeafCount() * block_length);
+  bool served = false;
+  {
+    absl::MutexLock lock(&read_ahead->mu);
+    if (logical_offset != read_ahead->next_offset) {
+      read_ahead->sequential_reads = 0;
+      read_ahead->segments.clear();
+      read_ahead->fetch_end_block = 0;
+      read_ahead->generation++;
+    } else if (read_ahead->sequential_reads < kReadAheadTriggerReads) {
+      read_ahead->sequential_reads++;
+    }
+
+    if (logical_offset + static_cast<off_t>(count) <= stored_end) {
+      // Wait for the segment being fetched if the range starts in it, rather
+      // than reading its blocks a second time.
+      const int64_t first_block = logical_offset / block_length;
+      if (read_ahead->fetch_pending &&
+          first_block >= read_ahead->pending_block &&
+          first_block < read_ahead->fetch_end_block) {
+        read_ahead->mu.Await(
+            absl::Condition(read_ahead, &ReadAhead::FetchIdle));
+      }
+      served =
+          CopyReadAhead(file_ctrl, read_ahead, buf, count, logical_offset);
+    }
+  }
+
+  ssize_t bytes_read =
+      served ? count
+             : DecryptAndVerifyInternal(fd, buf, count, file_ctrl,
+                                        logical_offset);
+  if (bytes_read <= 0) {
+    return bytes_read;
+  }
+
+  const off_t read_end = logical_offset + bytes_read;
+  absl::MutexLock lock(&read_ahead->mu);
+  read_ahead->next_offset = read_end;
+  const int64_t read_end_block = read_end / block_length;
+  while (!read_ahead->segments.empty() &&
+         read_ahead->segments.front()->first_block +
+                 read_ahead->segments.front()->block_count <=
+             read_end_block) {
+    read_ahead->segments.pop_front();
+  }
+  if (read_ahead->sequential_reads >= kReadAheadTriggerReads) {
+    ScheduleReadAhead(fd, file_ctrl, read_ahead, read_end);
+  }
+  return bytes_read;
+}
+
+bool AeadHandler::CopyReadAhead(const FileControl& file_ctrl,
+                                ReadAhead* read_ahead, void* buf, size_t count,
+                                off_t logical_offset) const {
+  const size_t block_length = file_ctrl.block_length;
+  const int64_t first_block = logical_offset / block_length;
+  const int64_t last_block = (logical_offset + count - 1) / block_length;
+  uint8_t* dest = reinterpret_cast<uint8_t*>(buf);
+  auto segment = read_ahead->segments.begin();
+  for (int64_t block_index = first_block; block_index <= last_block;
+       block_index++) {
+    while (segment != read_ahead->segments.end() &&
+           (*segment)->first_block + (*segment)->block_count <= block_index) {
+      ++segment;
+    }
+    if (segment == read_ahead->segments.end() ||
+        (*segment)->first_block > block_index) {
+      return false;
+    }
+
+    // The block was fetched without the file lock, so its auth tag is only
+    // trusted if it matches the AD now, as in DecryptAndVerifyInternal.
+    const size_t segment_index = block_index - (*segment)->first_block;
+    const std::string tag(reinterpret_cast<const char*>(
+                              (*segment)->tags.data() +
+                              segment_index * kTagLength),
+                          kTagLength);
+    if (file_ctrl.ad->LeafHash(block_index + 1) !=
+        file_ctrl.ad->LeafHash(tag)) {
+      VLOG(2) << "Block fetched ahead has changed, block = " << block_index;
+      return false;
+    }
+
+    const off_t block_offset = block_index * block_length;
+    const off_t copy_begin = std::max<off_t>(block_offset, logical_offset);
+    const off_t copy_end = std::min<off_t>(block_offset + block_length,
+                                           logical_offset + count);
+    std::copy_n((*segment)->plaintexts.data() +
+                    segment_index * block_length + (copy_begin - block_offset),
+                copy_end - copy_begin, dest + (copy_begin - logical_offset));
+  }
+  return true;
+}
+
+void AeadHandler::ScheduleReadAhead(int fd, const FileControl& file_ctrl,
+                                    ReadAhead* read_ahead,
+                                    off_t read_end) const {
+  if (read_ahead->fetch_pending) {
+    return;
+  }
+
+  // Segments are half the window, so that the next one is fetched while the
+  // reads consume the previous one.
+  const size_t block_length = file_ctrl.block_length;
+  const int64_t window_blocks =
+      std::max<int64_t>(2, read_ahead_bytes_ / block_length);
+  const int64_t next_block = read_end / block_length;
+  const int64_t begin = std::max(read_ahead->fetch_end_block, next_block);
+  const int64_t end =
+      std::min<int64_t>(begin + window_blocks / 2, file_ctrl.ad->LeafCount());
+  if (begin - next_block >= window_blocks || begin >= end) {
+    return;
+  }
+
+  GcmCryptor* cryptor = GetGcmCryptor(file_ctrl);
+  if (!cryptor) {
+    return;
+  }
+
+  read_ahead->fetch_pending = true;
+  read_ahead->pending_block = begin;
+  read_ahead->fetch_end_block = end;
+  const off_t physical_offset =
+      file_ctrl.offset_translator->LogicalToPhysical(begin * block_length);
+  std::shared_ptr<ReadAhead> read_ahead_ref = file_ctrl.read_ahead;
+  const int64_t generation = read_ahead->generation;
+  read_ahead_executor_->Submit([read_ahead_ref, generation, fd, cryptor,
+                                block_length, physical_offset, begin, end] {
+    FetchReadAheadSegment(read_ahead_ref, generation, fd, cryptor,
+                          block_length, physical_offset, begin, end - begin);
+  });
+}
+
+void AeadHandler::FetchReadAheadSegment(std::shared_ptr<ReadAhead> read_ahead,
+                                        int64_t generation, int fd,
+                                        GcmCryptor* cryptor,
+                                        size_t block_length,
+                                        off_t physical_offset,
+                                        int64_t first_block,
+                                        int64_t block_count) {
+  const size_t cipher_block_length = block_length + kTagLength;
+  const size_t secure_block_length = cipher_block_length + kTokenLength;
+  std::vector<uint8_t> secure_blocks(block_count * secure_block_length);
+  ssize_t bytes_read = pread_all(fd, secure_blocks.data(),
+                                 secure_blocks.size(), physical_offset);
+
+  // A segment which cannot be read or decrypted in full, such as one holding
+  // a sparse block, is dropped, and its blocks are read when they are needed.
+  auto segment = std::make_shared<ReadAheadSegment>();
+  segment->first_block = first_block;
+  segment->block_count = block_count;
+  bool fetched = bytes_read == static_cast<ssize_t>(secure_blocks.size());
+  if (fetched) {
+    segment->plaintexts.resize(block_count * block_length);
+    segment->tags.resize(block_count * kTagLength);
+    std::vector<const uint8_t*> ciphertexts(block_count);
+    std::vector<const uint8_t*> tokens(block_count);
+    std::vector<uint8_t*> plaintexts(block_count);
+    for (int64_t idx = 0; idx < block_count; idx++) {
+      const uint8_t* secure_block =
+          secure_blocks.data() + idx * secure_block_length;
+      ciphertexts[idx] = secure_block;
+      tokens[idx] = secure_block + cipher_block_length;
+      plaintexts[idx] = segment->plaintexts.data() + idx * block_length;
+      std::copy_n(secure_block + block_length, kTagLength,
+                  segment->tags.data() + idx * kTagLength);
+    }
+    fetched = cryptor->DecryptBlocks(block_count, ciphertexts.data(),
+                                     tokens.data(), plaintexts.data());
+  }
+
+  absl::MutexLock lock(&read_ahead->mu);
+  read_ahead->fetch_pending = false;
+  if (fetched && read_ahead->generation == generation) {
+    read_ahead->segments.push_back(std::move(segment));
+  }
+}
+
+ssize_t AeadHandler::DecryptAndVerifyInternal(int fd, void* buf, size_t count,
+                                              const FileControl& file_ctrl,
+                                              off_t logical_offset) const {
+  if (count == 0) {
+    return 0;
+  }
+
+  const size_t block_length = file_ctrl.block_length;
+  const size_t cipher_block_length = file_ctrl.cipher_block_length();
+  const size_t secure_block_length = file_ctrl.secure_block_length();
+  const OffsetTranslator& offset_translator = *file_ctrl.offset_translator;
+
+  // Check for logical EOF.
+  if (logical_offset >= file_ctrl.logical_size) {
     return 0;
   }
 
@@ -366,42 +1340,51 @@ ssize_t AeadHandler::DecryptAndVerifyInternal(int fd, void* buf, size_t count,
     count = file_ctrl.logical_size - logical_offset;
   }
 
+  // Data past the blocks of the file, which a file extended by Truncate has,
+  // reads as zeros.
+  const off_t blocks_end = file_ctrl.ad->LeafCount() * block_length;
+  if (logical_offset + count > blocks_end) {
+    const size_t stored_count =
+        logical_offset < blocks_end ? blocks_end - logical_offset : 0;
+    ssize_t bytes_read = 0;
+    if (stored_count > 0) {
+      bytes_read = DecryptAndVerifyInternal(fd, buf, stored_count, file_ctrl,
+                                            logical_offset);
+      if (bytes_read < static_cast<ssize_t>(stored_count)) {
+        return bytes_read;
+      }
+    }
+    memset(reinterpret_cast<uint8_t*>(buf) + stored_count, 0,
+           count - stored_count);
+    return count;
+  }
+
   // Determine data breakdown into logical blocks.
   size_t first_partial_block_bytes_count;
   size_t last_partial_block_bytes_count;
   size_t full_inclusive_blocks_bytes_count;
-  offset_translator_->ReduceLogicalRangeToFullLogicalBlocks(
+  offset_translator.ReduceLogicalRangeToFullLogicalBlocks(
       logical_offset, count, &first_partial_block_bytes_count,
       &last_partial_block_bytes_count, &full_inclusive_blocks_bytes_count);
 
   // Use single read buffer to minimize the number of read calls to the host.
-  std::vector<uint8_t> buffer;
   const size_t physical_bytes_count =
-      (full_inclusive_blocks_bytes_count / kBlockLength) * kSecureBlockLength;
-  buffer.resize(physical_bytes_count);
+      (full_inclusive_blocks_bytes_count / block_length) * secure_block_length;
+  StagingBuffer buffer(&read_staging, physical_bytes_count);
 
-  // Move cursor to the first full block to read.
+  // The range may start and end within a single block, so the block start is
+  // derived from the offset.
+  const size_t first_block_bytes_skipped = logical_offset % block_length;
   const off_t first_logical_block_offset =
-      (first_partial_block_bytes_count > 0)
-          ? (logical_offset + first_partial_block_bytes_count - kBlockLength)
-          : logical_offset;
+      logical_offset - first_block_bytes_skipped;
   const off_t first_physical_block_offset =
-      offset_translator_->LogicalToPhysical(first_logical_block_offset);
-  if (first_partial_block_bytes_count > 0) {
-    off_t offset =
-        enc_untrusted_lseek(fd, first_physical_block_offset, SEEK_SET);
-    if (offset == -1) {
-      LOG(ERROR)
-          << "Failed lseek to the fist block offset when reading file data.";
-      return -1;
-    }
-  }
+      offset_translator.LogicalToPhysical(first_logical_block_offset);
 
   // Perform the read. Read may have been requested beyond EOF - cannot require
   // that bytes_read is equal to physical_bytes_count. The read was not
   // requested at EOF - checked this above.
-  ssize_t bytes_read =
-      enc_untrusted_read(fd, buffer.data(), physical_bytes_count);
+  ssize_t bytes_read = pread_all(fd, buffer.data(), physical_bytes_count,
+                                 first_physical_block_offset);
   if (bytes_read <= 0) {
     LOG(ERROR) << "Cannot verify data - data has not been read, fd = " << fd;
     return -1;
@@ -409,320 +1392,1379 @@ ssize_t AeadHandler::DecryptAndVerifyInternal(int fd, void* buf, size_t count,
 
   // Process only complete blocks read, since need per-block metadata to decrypt
   // the block.
-  bytes_read = (bytes_read / kSecureBlockLength) * kSecureBlockLength;
+  bytes_read = (bytes_read / secure_block_length) * secure_block_length;
   if (bytes_read == 0) {
     LOG(ERROR) << "Cannot verify data - data has not been read, fd = " << fd;
     return -1;
   }
 
-  // Move cursor to the position of the end of the read range.
-  off_t new_cur_logical_offset = logical_offset + count;
-  if (bytes_read != physical_bytes_count) {
-    int64_t blocks_not_read =
-        (physical_bytes_count - bytes_read) / kSecureBlockLength;
-    if (last_partial_block_bytes_count > 0) {
-      new_cur_logical_offset -= last_partial_block_bytes_count;
-      blocks_not_read--;
-    }
-    new_cur_logical_offset -= blocks_not_read * kBlockLength;
-  }
-  const off_t new_cur_physical_offset =
-      offset_translator_->LogicalToPhysical(new_cur_logical_offset);
-  off_t offset = enc_untrusted_lseek(fd, new_cur_physical_offset, SEEK_SET);
-  if (offset == -1) {
-    LOG(ERROR) << "Failed lseek to the end of read range.";
-    return -1;
-  }
-
   GcmCryptor* cryptor = GetGcmCryptor(file_ctrl);
   if (!cryptor) {
     return -1;
   }
 
-  // Cycle through blocks.
-  const int64_t blocks_read = bytes_read / kSecureBlockLength;
-  const int64_t blocks_read_max = physical_bytes_count / kSecureBlockLength;
+  const int64_t blocks_read = bytes_read / secure_block_length;
+  const int64_t blocks_read_max = physical_bytes_count / secure_block_length;
   const off_t first_block_index =
-      (first_physical_block_offset - sizeof(FileHeader)) / kSecureBlockLength;
-  size_t read_count = 0;
-  for (int64_t block_index = 0; block_index < blocks_read; block_index++) {
-    const size_t merkle_block_idx = first_block_index + block_index + 1;
-
-    uint8_t* plaintext_data =
-        GetPlaintextBuffer(first_partial_block_bytes_count, block_index, buf);
-
-    // Detect full blocks that belong to sparse regions in the file - no need to
-    // decrypt.
-    if (file_ctrl.ad->LeafHash(merkle_block_idx) == file_ctrl.zero_hash) {
-      VLOG(2) << "A sparse region block detected.";
-      memset(plaintext_data, 0, kBlockLength);
-      read_count += kBlockLength;
-      continue;
+      (first_physical_block_offset - sizeof(FileHeader)) / secure_block_length;
+
+  // Verify and decrypt the blocks, possibly in parallel. AD lookups are const,
+  // and each range of blocks touches only its own part of the read buffer and
+  // of |buf|, and is decrypted in a single batch. Full blocks are decrypted
+  // straight into |buf|, and partial blocks at the ends of the range in place
+  // in the read buffer, from which the requested part is copied.
+  const bool first_block_is_partial = first_partial_block_bytes_count > 0;
+  const bool last_block_is_partial = last_partial_block_bytes_count > 0;
+  std::atomic<size_t> read_count(0);
+  auto decrypt_blocks = [&](int64_t begin, int64_t end) -> bool {
+    std::vector<int64_t> block_indices;
+    std::vector<const uint8_t*> ciphertexts;
+    std::vector<const uint8_t*> tokens;
+    std::vector<uint8_t*> decrypt_targets;
+    uint8_t* first_partial_plaintext = nullptr;
+    uint8_t* last_partial_plaintext = nullptr;
+    size_t range_read_count = 0;
+    for (int64_t block_index = begin; block_index < end; block_index++) {
+      const bool is_first_partial = block_index == 0 && first_block_is_partial;
+      const bool is_last_partial =
+          block_index == blocks_read_max - 1 && last_block_is_partial;
+      uint8_t* plaintext_data =
+          GetPlaintextBuffer(block_length, first_partial_block_bytes_count,
+                             block_index, buf);
+
+      const size_t merkle_block_idx = first_block_index + block_index + 1;
+      const std::string leaf_hash = file_ctrl.ad->LeafHash(merkle_block_idx);
+
+      // Detect full blocks that belong to sparse regions in the file - no need
+      // to decrypt. Only the part of the block within the read range is
+      // cleared.
+      if (leaf_hash == file_ctrl.zero_hash) {
+        VLOG(2) << "A sparse region block detected.";
+        size_t sparse_bytes = block_length;
+        if (is_first_partial) {
+          sparse_bytes = first_partial_block_bytes_count;
+        } else if (is_last_partial) {
+          sparse_bytes = last_partial_block_bytes_count;
+        }
+        memset(plaintext_data, 0, sparse_bytes);
+        range_read_count += sparse_bytes;
+        continue;
+      }
+
+      uint8_t* secure_block = buffer.data() + block_index * secure_block_length;
+      TagView tag(secure_block + block_length, kTagLength);
+      VLOG(2) << "Auth tag read: "
+              << absl::BytesToHexString(absl::string_view(
+                     reinterpret_cast<const char*>(tag.data()), kTagLength));
+
+      // Note: Verifying integrity tag will be replaced with integrity
+      // verification against AD root if/when AD tree will be stored in a file
+      // (i.e. if/when optimizing integrity assurance for large files).
+      if (leaf_hash != file_ctrl.ad->LeafHash(std::string(
+                           reinterpret_cast<const char*>(tag.data()),
+                           kTagLength))) {
+        LOG(ERROR) << "Integrity verification failed, fd = " << fd;
+        return false;
+      }
+
+      VLOG(2) << "Ciphertext read: "
+              << absl::BytesToHexString(absl::string_view(
+                     reinterpret_cast<const char*>(secure_block),
+                     cipher_block_length));
+      VLOG(2) << "Token read: "
+              << absl::BytesToHexString(absl::string_view(
+                     reinterpret_cast<const char*>(secure_block +
+                                                   cipher_block_length),
+                     kTokenLength));
+      block_indices.push_back(first_block_index + block_index);
+      ciphertexts.push_back(secure_block);
+      tokens.push_back(secure_block + cipher_block_length);
+
+      // Determine the target for decryption depending on whether the read
+      // block is at the end of the full range.
+      if (is_first_partial) {
+        first_partial_plaintext = secure_block;
+        decrypt_targets.push_back(secure_block);
+      } else if (is_last_partial) {
+        last_partial_plaintext = secure_block;
+        decrypt_targets.push_back(secure_block);
+      } else {
+        decrypt_targets.push_back(plaintext_data);
+        range_read_count += block_length;
+      }
     }
 
-    CiphertextView ciphertext(buffer.data() + block_index * kSecureBlockLength,
-                              kCipherBlockLength);
-    VLOG(2) << "Ciphertext read: "
-            << absl::BytesToHexString(absl::string_view(
-                   reinterpret_cast<const char*>(ciphertext.data()),
-                   kCipherBlockLength));
-
-    TagView tag(buffer.data() + block_index * kSecureBlockLength + kBlockLength,
-                kTagLength);
-    VLOG(2) << "Auth tag read: "
-            << absl::BytesToHexString(absl::string_view(
-                   reinterpret_cast<const char*>(tag.data()), kTagLength));
-
-    TokenView token(
-        buffer.data() + block_index * kSecureBlockLength + kCipherBlockLength,
-        kTokenLength);
-    VLOG(2) << "Token read: "
-            << absl::BytesToHexString(absl::string_view(
-                   reinterpret_cast<const char*>(token.data()), kTokenLength));
-
-    // Note: Verifying integrity tag will be replaced with integrity
-    // verification against AD root if/when AD tree will be stored in a file
-    // (i.e. if/when optimizing integrity assurance for large files).
-    if (file_ctrl.ad->LeafHash(merkle_block_idx) !=
-        file_ctrl.ad->LeafHash(
-            std::string(reinterpret_cast<const char*>(tag.data()), kTagLength))) {
-      LOG(ERROR) << "Integrity verification failed, fd = " << fd;
-      return -1;
+    if (!ciphertexts.empty() &&
+        !DecryptFileBlocks(file_ctrl, cryptor, ciphertexts.size(),
+                           block_indices.data(), ciphertexts.data(),
+                           tokens.data(), decrypt_targets.data())) {
+      LOG(ERROR) << "Decryption failed, fd = " << fd;
+      return false;
     }
 
-    // Bounce block for reading partial blocks at the ends of the full range.
-    Block bounce_block;
-    // Target for decryption - bounce block or the supplied buffer.
-    uint8_t* decrypt_target;
-    // Determine the target depending on whether the read block is at the end of
-    // the full range.
-    if ((block_index == 0 && first_partial_block_bytes_count > 0) ||
-        (block_index == blocks_read_max - 1 &&
-         last_partial_block_bytes_count > 0)) {
-      decrypt_target = bounce_block.data();
-    } else {
-      decrypt_target = plaintext_data;
+    // Copy the requested parts of the partial blocks, if decrypted.
+    if (first_partial_plaintext) {
+      std::copy_n(first_partial_plaintext + first_block_bytes_skipped,
+                  first_partial_block_bytes_count,
+                  GetPlaintextBuffer(block_length,
+                                     first_partial_block_bytes_count, 0, buf));
+      range_read_count += first_partial_block_bytes_count;
     }
-
-    // Decrypt the block.
-    if (!cryptor->DecryptBlock(ciphertext.data(), token.data(),
-                               decrypt_target)) {
-      LOG(ERROR) << "Decryption failed, fd = " << fd;
-      return -1;
+    if (last_partial_plaintext) {
+      std::copy_n(last_partial_plaintext, last_partial_block_bytes_count,
+                  GetPlaintextBuffer(block_length,
+                                     first_partial_block_bytes_count,
+                                     blocks_read_max - 1, buf));
+      range_read_count += last_partial_block_bytes_count;
     }
 
-    // Copy content from the bounce buffer, if used. Increment the count of read
-    // bytes.
-    if (block_index == 0 && first_partial_block_bytes_count > 0) {
-      std::copy_n(
-          bounce_block.begin() + kBlockLength - first_partial_block_bytes_count,
-          first_partial_block_bytes_count, plaintext_data);
-      read_count += first_partial_block_bytes_count;
-    } else if (block_index == blocks_read_max - 1 &&
-               last_partial_block_bytes_count > 0) {
-      std::copy_n(bounce_block.begin(), last_partial_block_bytes_count,
-                  plaintext_data);
-      read_count += last_partial_block_bytes_count;
-    } else {
-      read_count += kBlockLength;
-    }
+    read_count += range_read_count;
+    return true;
+  };
+  if (!ForEachBlockRange(blocks_read, block_length, decrypt_blocks)) {
+    return -1;
+  }
+
+  VLOG(2) << "Verified read blocks, blocks_read = " << blocks_read
+          << ", bytes_read = " << bytes_read;
+  return read_count.load();
+}
+
+bool AeadHandler::UpdateDigest(FileControl* file_ctrl) const {
+  if (!file_ctrl) {
+    errno = EINVAL;
+    return false;
+  }
+
+  const GcmCryptor* cryptor = GetDigestCryptor(*file_ctrl);
+  if (!cryptor) {
+    return false;
+  }
+
+  std::string root = file_ctrl->ad->CurrentRoot();
+  if (root.size() != kRootHashLength) {
+    LOG(ERROR) << "Unexpected size of root hash encountered, size="
+               << root.size();
+    return false;
+  }
+
+  // Prepare file data digest.
+  DataDigest data_digest;
+  std::copy_n(reinterpret_cast<const uint8_t*>(root.data()), kRootHashLength,
+              data_digest.data());
+  data_digest.size_and_block_code = EncodeSizeAndBlockLength(
+      file_ctrl->persisted_size(), file_ctrl->block_length,
+      file_ctrl->integrity_only);
+
+  FileHeader header;
+  if (!cryptor->GetAuthTag(header.data(), data_digest.data(),
+                           sizeof(DataDigest))) {
+    LOG(ERROR) << "Failed to generate CMAC, root = " << root;
+    return false;
+  }
+  header.size_and_block_code = data_digest.size_and_block_code;
+
+  VLOG(2) << "Updating the digest for file: " << file_ctrl->path
+          << ", root hash: " << absl::BytesToHexString(root);
+
+  // Write the header through a descriptor already open for writing if there
+  // is one, rather than opening the file for it.
+  int fd = file_ctrl->digest_fd;
+  FdCloser fd_closer(-1, &enc_untrusted_close);
+  if (fd == -1) {
+    fd = enc_untrusted_open(file_ctrl->path.c_str(), O_WRONLY);
+    if (fd == -1) {
+      LOG(ERROR) << "Failed to open file to save data digest, path="
+                 << file_ctrl->path << ", errno = " << errno;
+      return false;
+    }
+    fd_closer.reset(fd);
+  }
+
+  ssize_t bytes_written =
+      pwrite_all(fd, header.data(), sizeof(FileHeader), /*file_offset=*/0);
+  if (bytes_written != sizeof(FileHeader)) {
+    LOG(ERROR) << "Failed to write full digest to file, path="
+               << file_ctrl->path << ", bytes written = " << bytes_written;
+    return false;
+  }
+
+  if (!fd_closer.reset()) {
+    LOG(ERROR) << "Failed to close the file after digest update, path="
+               << file_ctrl->path;
+    return false;
+  }
+
+  file_ctrl->sealed_leaf_count = file_ctrl->ad->LeafCount();
+  file_ctrl->unsealed_blocks = 0;
+  file_ctrl->deferred_digest_updates = 0;
+  return true;
+}
+
+bool AeadHandler::DeferDigestUpdate(int fd, FileControl* file_ctrl) const {
+  file_ctrl->digest_fd = fd;
+  if (digest_write_back_updates_ == 0 || file_ctrl->digest_write_through) {
+    return UpdateDigest(file_ctrl);
+  }
+
+  const absl::Time now = absl::Now();
+  if (file_ctrl->deferred_digest_updates == 0) {
+    file_ctrl->first_deferred_digest_update = now;
+  }
+  file_ctrl->deferred_digest_updates++;
+  if (file_ctrl->deferred_digest_updates >= digest_write_back_updates_ ||
+      (digest_write_back_delay_ > absl::ZeroDuration() &&
+       now - file_ctrl->first_deferred_digest_update >=
+           digest_write_back_delay_)) {
+    return UpdateDigest(file_ctrl);
+  }
+  return true;
+}
+
+bool AeadHandler::FlushDigest(FileControl* file_ctrl) const {
+  if (file_ctrl->deferred_digest_updates == 0) {
+    return true;
+  }
+  return UpdateDigest(file_ctrl);
+}
+
+bool AeadHandler::ReadFullBlock(const FileControl& file_ctrl,
+                                off_t logical_offset, uint8_t* block) const {
+  return ReadFullBlocks(file_ctrl, {logical_offset}, block);
+}
+
+bool AeadHandler::ReadFullBlocks(const FileControl& file_ctrl,
+                                 const std::vector<off_t>& logical_offsets,
+                                 uint8_t* blocks) const {
+  const size_t block_length = file_ctrl.block_length;
+  for (size_t idx = 0; idx < logical_offsets.size(); idx++) {
+    if (logical_offsets[idx] < 0 || logical_offsets[idx] % block_length != 0 ||
+        (idx > 0 && logical_offsets[idx] <= logical_offsets[idx - 1])) {
+      errno = EINVAL;
+      return false;
+    }
+  }
+
+  int fd = enc_untrusted_open(file_ctrl.path.c_str(), O_RDONLY);
+  if (fd == -1) {
+    LOG(ERROR) << "Failed to open file to read a block, path=" << file_ctrl.path
+               << ", errno = " << errno;
+    return false;
+  }
+
+  FdCloser fd_closer(fd, &enc_untrusted_close);
+
+  // Read each run of consecutive blocks at once.
+  for (size_t begin = 0; begin < logical_offsets.size();) {
+    size_t end = begin + 1;
+    while (end < logical_offsets.size() &&
+           logical_offsets[end] == logical_offsets[end - 1] + block_length) {
+      end++;
+    }
+
+    uint8_t* run = blocks + begin * block_length;
+    const size_t run_length = (end - begin) * block_length;
+    ssize_t bytes_read = DecryptAndVerifyInternal(
+        fd, run, run_length, file_ctrl, logical_offsets[begin]);
+    if (bytes_read == -1) {
+      return false;
+    }
+
+    if (bytes_read < run_length) {
+      memset(run + bytes_read, 0, run_length - bytes_read);
+    }
+    begin = end;
+  }
+
+  return true;
+}
+
+ssize_t AeadHandler::EncryptAndPersist(int fd, const void* buf, size_t count) {
+  if (!buf) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  std::shared_ptr<FileControl> file_ref;
+  std::unique_ptr<absl::MutexLock> file_lock;
+  FileControl* file_ctrl = AcquireFile(fd, &file_ref, &file_lock);
+  if (!file_ctrl) {
+    LOG(ERROR) << "Attempt made to write to an unopened file, fd = " << fd;
+    errno = ENOENT;
+    return -1;
+  }
+  const bool is_append = file_ctrl->fds.at(fd);
+
+  // Writes through O_APPEND descriptors go to the end of the file, and leave
+  // the cursor there.
+  if (is_append) {
+    ssize_t bytes_written = AppendLocked(fd, buf, count, file_ctrl);
+    if (bytes_written >= 0 &&
+        !SetLogicalOffset(fd, *file_ctrl, file_ctrl->logical_size)) {
+      LOG(ERROR) << "Failed lseek to the end of the file after append.";
+      return -1;
+    }
+
+    return bytes_written;
+  }
+
+  off_t logical_offset;
+  if (!RetrieveLogicalOffset(fd, *file_ctrl, &logical_offset)) {
+    return -1;
+  }
+
+  ssize_t bytes_written =
+      WriteLocked(fd, buf, count, file_ctrl, logical_offset);
+  if (bytes_written > 0 &&
+      !SetLogicalOffset(fd, *file_ctrl, logical_offset + bytes_written)) {
+    LOG(ERROR) << "Failed lseek to the end of write range.";
+    return -1;
+  }
+
+  return bytes_written;
+}
+
+ssize_t AeadHandler::EncryptAndPersistAt(int fd, const void* buf, size_t count,
+                                         off_t logical_offset) {
+  if (!buf || logical_offset < 0) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  std::shared_ptr<FileControl> file_ref;
+  std::unique_ptr<absl::MutexLock> file_lock;
+  FileControl* file_ctrl = AcquireFile(fd, &file_ref, &file_lock);
+  if (!file_ctrl) {
+    LOG(ERROR) << "Attempt made to write to an unopened file, fd = " << fd;
+    errno = ENOENT;
+    return -1;
+  }
+
+  return WriteLocked(fd, buf, count, file_ctrl, logical_offset);
+}
+
+ssize_t AeadHandler::WriteLocked(int fd, const void* buf, size_t count,
+                                 FileControl* file_ctrl,
+                                 off_t logical_offset) const {
+  if (count == 0) {
+    return 0;
+  }
+
+  if (file_ctrl->cache) {
+    return WriteCached(fd, buf, count, file_ctrl, logical_offset);
+  }
+
+  // Write the data held back by appends first, so that partial blocks are read
+  // back from the file below.
+  if (!FlushAppends(file_ctrl)) {
+    return -1;
+  }
+
+  const size_t block_length = file_ctrl->block_length;
+  const OffsetTranslator& offset_translator = *file_ctrl->offset_translator;
+
+  // Load the leaf hashes of the blocks to overwrite, and of the last block of
+  // the file, whose chunk receives any appended blocks.
+  const int64_t last_leaf = file_ctrl->ad->LeafCount() - 1;
+  if (!LoadIntegrityChunks(file_ctrl, logical_offset / block_length,
+                           (logical_offset + count - 1) / block_length) ||
+      !LoadIntegrityChunks(file_ctrl, last_leaf, last_leaf)) {
+    return -1;
+  }
+
+  // Determine data breakdown into logical blocks.
+  size_t first_partial_block_bytes_count;
+  size_t last_partial_block_bytes_count;
+  size_t full_inclusive_blocks_bytes_count;
+  offset_translator.ReduceLogicalRangeToFullLogicalBlocks(
+      logical_offset, count, &first_partial_block_bytes_count,
+      &last_partial_block_bytes_count, &full_inclusive_blocks_bytes_count);
+
+  // The range may start and end within a single block, so the block start is
+  // derived from the offset.
+  const size_t first_block_bytes_skipped = logical_offset % block_length;
+  const off_t first_logical_block_offset =
+      logical_offset - first_block_bytes_skipped;
+
+  // Bounce blocks for writing the partial blocks at the ends of the range, if
+  // any. Both are read with a single open of the file, and with a single read
+  // if they are adjacent.
+  std::vector<off_t> edge_offsets;
+  if (first_partial_block_bytes_count > 0) {
+    edge_offsets.push_back(first_logical_block_offset);
+  }
+  if (last_partial_block_bytes_count > 0) {
+    edge_offsets.push_back(logical_offset + count -
+                           last_partial_block_bytes_count);
+  }
+  std::vector<uint8_t> edge_blocks(edge_offsets.size() * block_length);
+  if (!edge_offsets.empty() &&
+      !ReadFullBlocks(*file_ctrl, edge_offsets, edge_blocks.data())) {
+    LOG(ERROR) << "failed to read the misaligned blocks when writing, fd = "
+               << fd;
+    return -1;
+  }
+
+  uint8_t* first_block = nullptr;
+  if (first_partial_block_bytes_count > 0) {
+    first_block = edge_blocks.data();
+    std::copy_n(reinterpret_cast<const uint8_t*>(buf),
+                first_partial_block_bytes_count,
+                first_block + first_block_bytes_skipped);
+  }
+
+  uint8_t* last_block = nullptr;
+  if (last_partial_block_bytes_count > 0) {
+    last_block = edge_blocks.data() + edge_blocks.size() - block_length;
+    std::copy_n(reinterpret_cast<const uint8_t*>(buf) + count -
+                    last_partial_block_bytes_count,
+                last_partial_block_bytes_count, last_block);
+  }
+
+  GcmCryptor* cryptor = GetGcmCryptor(*file_ctrl);
+  if (!cryptor) {
+    return -1;
+  }
+
+  VLOG(2) << "Writing data to file, count = " << count << ", fd = " << fd;
+
+  // Determine the source for encryption of each block - bounce block or the
+  // supplied buffer - depending on whether the written block is at the end of
+  // the full range.
+  const int64_t blocks_to_write =
+      full_inclusive_blocks_bytes_count / block_length;
+  auto plaintext_block = [&](int64_t block_index) -> const uint8_t* {
+    if (block_index == 0 && first_block) {
+      return first_block;
+    }
+    if (block_index == blocks_to_write - 1 && last_block) {
+      return last_block;
+    }
+    return GetPlaintextBuffer(block_length, first_partial_block_bytes_count,
+                              block_index, buf);
+  };
+  if (!WriteBlocks(fd, file_ctrl, cryptor,
+                   first_logical_block_offset / block_length, blocks_to_write,
+                   plaintext_block)) {
+    return -1;
+  }
+
+  // Writes inside the file do not shrink it.
+  file_ctrl->logical_size =
+      std::max<size_t>(file_ctrl->logical_size, logical_offset + count);
+
+  if (!DeferDigestUpdate(fd, file_ctrl)) {
+    return -1;
+  }
+
+  VLOG(2) << "Wrote data to file, bytes_written = " << count;
+
+  return count;
+}
+
+ssize_t AeadHandler::AppendLocked(int fd, const void* buf, size_t count,
+                                  FileControl* file_ctrl) const {
+  // The block cache already holds back partial blocks and digest updates.
+  if (file_ctrl->cache) {
+    return WriteCached(fd, buf, count, file_ctrl, file_ctrl->logical_size);
+  }
+
+  if (count == 0) {
+    return 0;
+  }
+
+  GcmCryptor* cryptor = GetGcmCryptor(*file_ctrl);
+  if (!cryptor) {
+    return -1;
+  }
+
+  const size_t block_length = file_ctrl->block_length;
+  const int64_t tail_block = file_ctrl->logical_size / block_length;
+  std::vector<uint8_t>& tail = file_ctrl->append_tail;
+
+  // Load the leaf hashes of the last block of the file, whose chunk receives
+  // the appended blocks.
+  const int64_t last_leaf = file_ctrl->ad->LeafCount() - 1;
+  if (!LoadIntegrityChunks(file_ctrl, last_leaf, last_leaf)) {
+    return -1;
+  }
+
+  // The partial last block of the file is read once, by the first append after
+  // the file was opened or written otherwise.
+  if (!file_ctrl->has_append_tail) {
+    const size_t tail_size = file_ctrl->logical_size % block_length;
+    tail.resize(block_length);
+    if (tail_size > 0 &&
+        !ReadFullBlock(*file_ctrl, tail_block * block_length, tail.data())) {
+      LOG(ERROR) << "Failed to read the last block when appending, fd = "
+                 << fd;
+      tail.clear();
+      return -1;
+    }
+    tail.resize(tail_size);
+    file_ctrl->append_tail_persisted = tail_size;
+    file_ctrl->has_append_tail = true;
+  }
+
+  VLOG(2) << "Appending data to file, count = " << count << ", fd = " << fd;
+
+  // Write the blocks filled by the data, starting with the tail block, and
+  // keep the rest of the data as the new tail.
+  const uint8_t* data = reinterpret_cast<const uint8_t*>(buf);
+  const size_t tail_size = tail.size();
+  const int64_t full_blocks = (tail_size + count) / block_length;
+  if (full_blocks > 0) {
+    if (tail_size > 0) {
+      tail.insert(tail.end(), data, data + block_length - tail_size);
+    }
+
+    auto plaintext_block = [&](int64_t block_index) -> const uint8_t* {
+      if (block_index == 0 && tail_size > 0) {
+        return tail.data();
+      }
+      return data + block_index * block_length - tail_size;
+    };
+    if (!WriteBlocks(fd, file_ctrl, cryptor, tail_block, full_blocks,
+                     plaintext_block)) {
+      return -1;
+    }
+
+    tail.assign(data + full_blocks * block_length - tail_size, data + count);
+    file_ctrl->append_tail_persisted = 0;
+    file_ctrl->unsealed_blocks += full_blocks;
+  } else {
+    tail.insert(tail.end(), data, data + count);
+  }
+  file_ctrl->logical_size += count;
+
+  // The blocks covered by the digest must match it, so that the file can be
+  // opened at its last sealed size if it is not closed. Rewriting the last
+  // sealed block therefore updates the digest at once.
+  if ((full_blocks > 0 && tail_block < file_ctrl->sealed_leaf_count) ||
+      file_ctrl->unsealed_blocks >= kAppendSealBlockCount) {
+    if (!UpdateDigest(file_ctrl)) {
+      return -1;
+    }
+  }
+
+  return count;
+}
+
+bool AeadHandler::FlushAppends(FileControl* file_ctrl) const {
+  std::vector<uint8_t>& tail = file_ctrl->append_tail;
+  const bool is_tail_dirty = tail.size() > file_ctrl->append_tail_persisted;
+  if (!is_tail_dirty && file_ctrl->unsealed_blocks == 0) {
+    tail.clear();
+    file_ctrl->append_tail_persisted = 0;
+    file_ctrl->has_append_tail = false;
+    return true;
+  }
+
+  GcmCryptor* cryptor = GetGcmCryptor(*file_ctrl);
+  if (!cryptor) {
+    return false;
+  }
+
+  if (is_tail_dirty) {
+    int fd = enc_untrusted_open(file_ctrl->path.c_str(), O_WRONLY);
+    if (fd == -1) {
+      LOG(ERROR) << "Failed to open file to write appended data, path="
+                 << file_ctrl->path << ", errno = " << errno;
+      return false;
+    }
+
+    FdCloser fd_closer(fd, &enc_untrusted_close);
+
+    // Bytes past the logical size of the file read as zeros.
+    const int64_t last_leaf = file_ctrl->ad->LeafCount() - 1;
+    std::vector<uint8_t> block(tail);
+    block.resize(file_ctrl->block_length);
+    if (!LoadIntegrityChunks(file_ctrl, last_leaf, last_leaf) ||
+        !WriteBlocks(fd, file_ctrl, cryptor,
+                     file_ctrl->logical_size / file_ctrl->block_length, 1,
+                     [&block](int64_t) { return block.data(); })) {
+      return false;
+    }
+
+    if (!fd_closer.reset()) {
+      LOG(ERROR) << "Failed to close the file after writing appended data, "
+                    "path="
+                 << file_ctrl->path;
+      return false;
+    }
+  }
+
+  tail.clear();
+  file_ctrl->append_tail_persisted = 0;
+  file_ctrl->has_append_tail = false;
+  return UpdateDigest(file_ctrl);
+}
+
+bool AeadHandler::WriteBlocks(
+    int fd, FileControl* file_ctrl, GcmCryptor* cryptor, int64_t first_block,
+    int64_t block_count,
+    const std::function<const uint8_t*(int64_t)>& plaintext_block) const {
+  const size_t block_length = file_ctrl->block_length;
+  const size_t cipher_block_length = file_ctrl->cipher_block_length();
+  const size_t secure_block_length = file_ctrl->secure_block_length();
+
+  // Append leafs to the Merkle Tree to account for sparse region blocks,
+  // which are neither encrypted nor written.
+  const int64_t eof_block_index = file_ctrl->ad->LeafCount();
+  if (eof_block_index < first_block) {
+    VLOG(2) << "Adding empty auth tags to AD for blocks from a sparse region, "
+               "count = "
+            << first_block - eof_block_index;
+    if (file_ctrl->ad->AddLeafHashes(file_ctrl->zero_hash,
+                                     first_block - eof_block_index) == 0) {
+      LOG(ERROR) << "Failed to add a sparse region to AD, fd = " << fd;
+      return false;
+    }
+  }
+
+  // During a key rotation, blocks past the rotation point remain encrypted
+  // under the previous key. |rotated_count| blocks of the request precede it.
+  GcmCryptor* previous_cryptor = cryptor;
+  int64_t rotated_count = block_count;
+  if (file_ctrl->has_key_rotation) {
+    previous_cryptor = GetDigestCryptor(*file_ctrl);
+    if (!previous_cryptor) {
+      return false;
+    }
+    rotated_count = std::max<int64_t>(
+        0, std::min<int64_t>(block_count,
+                             file_ctrl->rotated_blocks - first_block));
+  }
+
+  // Use single write buffer to minimize the number of write calls to the host.
+  const size_t physical_bytes_count = block_count * secure_block_length;
+  StagingBuffer buffer(&write_staging, physical_bytes_count);
+
+  // Encrypt the blocks, possibly in parallel. Each range of blocks touches only
+  // its own part of the write buffer and is encrypted in a single batch per
+  // key; the integrity tags are added to the AD in block order once all blocks
+  // are encrypted.
+  auto encrypt_blocks = [&](int64_t begin, int64_t end) -> bool {
+    std::vector<const uint8_t*> encrypt_sources;
+    std::vector<uint8_t*> tokens;
+    std::vector<uint8_t*> ciphertexts;
+    for (int64_t block_index = begin; block_index < end; block_index++) {
+      encrypt_sources.push_back(plaintext_block(block_index));
+      uint8_t* ciphertext = buffer.data() + block_index * secure_block_length;
+      ciphertexts.push_back(ciphertext);
+      tokens.push_back(ciphertext + cipher_block_length);
+    }
+
+    const size_t rotated = std::max<int64_t>(
+        0, std::min<int64_t>(end, rotated_count) - begin);
+    const size_t previous = ciphertexts.size() - rotated;
+    if ((rotated > 0 &&
+         !cryptor->EncryptBlocks(rotated, encrypt_sources.data(),
+                                 tokens.data(), ciphertexts.data())) ||
+        (previous > 0 &&
+         !previous_cryptor->EncryptBlocks(
+             previous, encrypt_sources.data() + rotated,
+             tokens.data() + rotated, ciphertexts.data() + rotated))) {
+      LOG(ERROR) << "Encryption failed, fd = " << fd;
+      return false;
+    }
+
+    for (uint8_t* ciphertext : ciphertexts) {
+      VLOG(2) << "Ciphertext generated: "
+              << absl::BytesToHexString(absl::string_view(
+                     reinterpret_cast<const char*>(ciphertext), block_length));
+      VLOG(2) << "Auth tag generated: "
+              << absl::BytesToHexString(absl::string_view(
+                     reinterpret_cast<const char*>(ciphertext + block_length),
+                     kTagLength));
+      VLOG(2) << "Token generated: "
+              << absl::BytesToHexString(absl::string_view(
+                     reinterpret_cast<const char*>(ciphertext +
+                                                   cipher_block_length),
+                     kTokenLength));
+    }
+    return true;
+  };
+  if (!ForEachBlockRange(block_count, block_length, encrypt_blocks)) {
+    return false;
+  }
+
+  // Note: with block alignment constraint in place, partial block writes are
+  // not permissible - complete blocks must be written. Thus, the options are:
+  // 1. Allow partial yet block-aligned writes - this would require truncating
+  //    partially written blocks, which has a perf impact.
+  // 2. Require complete data to be written in a write loop that terminates only
+  //    on error or when all data has been written, following the POSIX model -
+  //    this may lead to "long" writes when "large" amount of data is written.
+  // In this code optimize operation for full writes - i.e. the option #2.
+  const off_t physical_offset =
+      file_ctrl->offset_translator->LogicalToPhysical(first_block *
+                                                      block_length);
+  ssize_t bytes_written =
+      pwrite_all(fd, buffer.data(), physical_bytes_count, physical_offset);
+  if (bytes_written != physical_bytes_count) {
+    LOG(ERROR) << "Failed to write encrypted data to file, path="
+               << file_ctrl->path << ", bytes written = " << bytes_written;
+    return false;
+  }
+
+  for (int64_t idx = 0; idx < block_count; idx++) {
+    std::string tag_string(
+        reinterpret_cast<char*>(buffer.data() + idx * secure_block_length +
+                                block_length),
+        kTagLength);
+    int64_t block_index = first_block + idx;
+    if (block_index < eof_block_index) {
+      VLOG(2) << "Updating auth tag on AD: "
+              << absl::BytesToHexString(tag_string);
+      file_ctrl->ad->UpdateLeaf(block_index + 1, tag_string);
+    } else {
+      VLOG(2) << "Appending auth tag to AD: "
+              << absl::BytesToHexString(tag_string);
+      file_ctrl->ad->AddLeaf(tag_string);
+    }
+  }
+
+  const int64_t first_dirty_block = std::min(first_block, eof_block_index);
+  const int64_t last_dirty_block = first_block + block_count - 1;
+  for (int64_t chunk = first_dirty_block / kChunkLeafCount;
+       chunk <= last_dirty_block / kChunkLeafCount; chunk++) {
+    file_ctrl->dirty_index_chunks.insert(chunk);
+  }
+
+  return true;
+}
+
+bool AeadHandler::ReadBlocksFromFile(int fd, FileControl* file_ctrl,
+                                     int64_t first_block, int64_t end_block,
+                                     uint8_t* blocks) const {
+  const size_t block_length = file_ctrl->block_length;
+  const int64_t file_end_block =
+      std::min<int64_t>(end_block, file_ctrl->ad->LeafCount());
+  ssize_t bytes_read = 0;
+  if (first_block < file_end_block) {
+    const off_t logical_offset = first_block * block_length;
+    if (!LoadIntegrityChunks(file_ctrl, first_block, file_end_block - 1)) {
+      return false;
+    }
+    bytes_read = DecryptAndVerifyInternal(
+        fd, blocks, (file_end_block - first_block) * block_length, *file_ctrl,
+        logical_offset);
+    if (bytes_read == -1) {
+      return false;
+    }
+  }
+
+  memset(blocks + bytes_read, 0,
+         (end_block - first_block) * block_length - bytes_read);
+  return true;
+}
+
+uint8_t* AeadHandler::InsertCachedBlock(FileControl* file_ctrl,
+                                        int64_t block_index) const {
+  uint8_t* block = file_ctrl->cache->Insert(block_index);
+  if (!block) {
+    // All blocks that could be evicted are dirty.
+    if (!FlushCache(file_ctrl)) {
+      return nullptr;
+    }
+    block = file_ctrl->cache->Insert(block_index);
+  }
+  return block;
+}
+
+bool AeadHandler::FlushCache(FileControl* file_ctrl) const {
+  BlockCache* cache = file_ctrl->cache.get();
+  if (!cache || cache->dirty_count() == 0) {
+    return true;
+  }
+
+  GcmCryptor* cryptor = GetGcmCryptor(*file_ctrl);
+  if (!cryptor) {
+    return false;
+  }
+
+  int fd = enc_untrusted_open(file_ctrl->path.c_str(), O_WRONLY);
+  if (fd == -1) {
+    LOG(ERROR) << "Failed to open file to write back cached blocks, path="
+               << file_ctrl->path << ", errno = " << errno;
+    return false;
+  }
+
+  FdCloser fd_closer(fd, &enc_untrusted_close);
+
+  // Write each run of consecutive dirty blocks at once.
+  const std::vector<int64_t> dirty_blocks = cache->DirtyBlocks();
+  std::vector<const uint8_t*> run_blocks;
+  for (size_t begin = 0; begin < dirty_blocks.size();) {
+    size_t end = begin + 1;
+    while (end < dirty_blocks.size() &&
+           dirty_blocks[end] == dirty_blocks[end - 1] + 1) {
+      end++;
+    }
+
+    const int64_t first_block = dirty_blocks[begin];
+    const int64_t last_leaf = file_ctrl->ad->LeafCount() - 1;
+    if (!LoadIntegrityChunks(file_ctrl, first_block, dirty_blocks[end - 1]) ||
+        !LoadIntegrityChunks(file_ctrl, last_leaf, last_leaf)) {
+      return false;
+    }
+
+    // Collect the plaintexts up front, since cache lookups are not
+    // thread-safe.
+    run_blocks.clear();
+    for (size_t idx = begin; idx < end; idx++) {
+      run_blocks.push_back(cache->Find(dirty_blocks[idx]));
+    }
+
+    if (!WriteBlocks(fd, file_ctrl, cryptor, first_block, end - begin,
+                     [&run_blocks](int64_t block_index) {
+                       return run_blocks[block_index];
+                     })) {
+      return false;
+    }
+
+    begin = end;
+  }
+
+  cache->MarkAllClean();
+
+  VLOG(2) << "Wrote back cached blocks, count = " << dirty_blocks.size()
+          << ", path = " << file_ctrl->path;
+
+  if (!fd_closer.reset()) {
+    LOG(ERROR) << "Failed to close the file after writing back cached blocks, "
+                  "path="
+               << file_ctrl->path;
+    return false;
+  }
+
+  return UpdateDigest(file_ctrl);
+}
+
+ssize_t AeadHandler::ReadCached(int fd, void* buf, size_t count,
+                                FileControl* file_ctrl,
+                                off_t logical_offset) const {
+  // Check for logical EOF, and do not read beyond it.
+  if (count == 0 || logical_offset >= file_ctrl->logical_size) {
+    return 0;
+  }
+  if (logical_offset + count >= file_ctrl->logical_size) {
+    count = file_ctrl->logical_size - logical_offset;
+  }
+
+  const size_t block_length = file_ctrl->block_length;
+  const int64_t first_block = logical_offset / block_length;
+  const int64_t last_block = (logical_offset + count - 1) / block_length;
+  BlockCache* cache = file_ctrl->cache.get();
+  uint8_t* plaintext_data = reinterpret_cast<uint8_t*>(buf);
+
+  // Copies the part of |block| within the read range to |buf|.
+  auto copy_block = [&](int64_t block_index, const uint8_t* block) {
+    const size_t begin =
+        block_index == first_block ? logical_offset % block_length : 0;
+    const size_t end = block_index == last_block
+                           ? (logical_offset + count - 1) % block_length + 1
+                           : block_length;
+    std::copy(block + begin, block + end, plaintext_data);
+    plaintext_data += end - begin;
+  };
+
+  std::vector<uint8_t> run;
+  for (int64_t block_index = first_block; block_index <= last_block;) {
+    const uint8_t* block = cache->Find(block_index);
+    if (block) {
+      copy_block(block_index, block);
+      block_index++;
+      continue;
+    }
+
+    // Read each run of consecutive blocks missing from the cache at once.
+    const int64_t run_first_block = block_index;
+    int64_t end_block = block_index + 1;
+    while (end_block <= last_block && !cache->Contains(end_block)) {
+      end_block++;
+    }
+    run.resize((end_block - block_index) * block_length);
+    if (!ReadBlocksFromFile(fd, file_ctrl, block_index, end_block,
+                            run.data())) {
+      return -1;
+    }
+    for (; block_index < end_block; block_index++) {
+      const uint8_t* run_block =
+          run.data() + (block_index - run_first_block) * block_length;
+      copy_block(block_index, run_block);
+      uint8_t* cached_block = InsertCachedBlock(file_ctrl, block_index);
+      if (!cached_block) {
+        return -1;
+      }
+      std::copy_n(run_block, block_length, cached_block);
+    }
+  }
+
+  return count;
+}
+
+ssize_t AeadHandler::WriteCached(int fd, const void* buf, size_t count,
+                                 FileControl* file_ctrl,
+                                 off_t logical_offset) const {
+  const size_t block_length = file_ctrl->block_length;
+  const int64_t first_block = logical_offset / block_length;
+  const int64_t last_block = (logical_offset + count - 1) / block_length;
+  BlockCache* cache = file_ctrl->cache.get();
+  const uint8_t* plaintext_data = reinterpret_cast<const uint8_t*>(buf);
+
+  VLOG(2) << "Writing data to cache, count = " << count << ", fd = " << fd;
+
+  std::vector<uint8_t> bounce_block;
+  for (int64_t block_index = first_block; block_index <= last_block;
+       block_index++) {
+    const size_t begin =
+        block_index == first_block ? logical_offset % block_length : 0;
+    const size_t end = block_index == last_block
+                           ? (logical_offset + count - 1) % block_length + 1
+                           : block_length;
+
+    uint8_t* block = cache->Find(block_index);
+    if (!block) {
+      // Blocks that are only partially overwritten keep the rest of their
+      // data.
+      const bool is_partial = begin > 0 || end < block_length;
+      if (is_partial) {
+        bounce_block.resize(block_length);
+        if (!ReadBlocksFromFile(fd, file_ctrl, block_index, block_index + 1,
+                                bounce_block.data())) {
+          return -1;
+        }
+      }
+      block = InsertCachedBlock(file_ctrl, block_index);
+      if (!block) {
+        return -1;
+      }
+      if (is_partial) {
+        std::copy_n(bounce_block.begin(), block_length, block);
+      }
+    }
+
+    std::copy(plaintext_data, plaintext_data + end - begin, block + begin);
+    plaintext_data += end - begin;
+    cache->MarkDirty(block_index);
+
+    // Extend the file as blocks are buffered, so that the digest written if
+    // blocks are written back in the middle of the loop covers them.
+    file_ctrl->logical_size = std::max<size_t>(
+        file_ctrl->logical_size, block_index * block_length + end);
+  }
+
+  return count;
+}
+
+bool AeadHandler::FinalizeFile(int fd) {
+  absl::MutexLock global_lock(&mu_);
+
+  if (fd < 0) {
+    errno = EINVAL;
+    return false;
+  }
+
+  // Remove the descriptor so that no further operation finds it.
+  std::shared_ptr<FileControl> file_ref;
+  {
+    FileShard& shard = GetFileShard(fd);
+    absl::MutexLock shard_lock(&shard.mu);
+    auto entry = shard.files.find(fd);
+    if (entry == shard.files.end()) {
+      LOG(ERROR) << "Attempt made to finalize uninitialized file, fd = " << fd;
+      errno = ENOENT;
+      return false;
+    }
+    file_ref = std::move(entry->second);
+    shard.files.erase(entry);
+  }
+
+  // Wait until operations in progress on the file finish. Those that looked
+  // the descriptor up and wait for the lock find it closed once they hold it.
+  FileControl* file_ctrl = file_ref.get();
+  absl::MutexLock file_lock(&file_ctrl->mu);
+
+  // A segment may be being fetched through the descriptor, which the caller
+  // closes once the file is finalized.
+  {
+    ReadAhead* read_ahead = file_ctrl->read_ahead.get();
+    absl::MutexLock read_ahead_lock(&read_ahead->mu);
+    read_ahead->mu.Await(absl::Condition(read_ahead, &ReadAhead::FetchIdle));
+  }
+
+  VLOG(2) << "Finalizing secure file, fd = " << fd
+          << ", pathname = " << file_ctrl->path;
+
+  bool result = true;
+  if (!FlushCache(file_ctrl) || !FlushAppends(file_ctrl) ||
+      !FlushDigest(file_ctrl)) {
+    LOG(ERROR) << "Failed to write back cached blocks when finalizing file, "
+                  "path="
+               << file_ctrl->path;
+    result = false;
+  }
+
+  // The file data remains verifiable without the index - a missing or stale
+  // index only makes the next open collect the auth tags from all blocks.
+  if (file_ctrl->is_deserialized && !PersistIntegrityIndex(file_ctrl)) {
+    LOG(WARNING) << "Failed to persist the integrity index, path="
+                 << file_ctrl->path;
+  }
+
+  // Other descriptors of the same file keep sharing its control structure,
+  // including the block cache.
+  file_ctrl->fds.erase(fd);
+  if (file_ctrl->fds.empty()) {
+    opened_files_.erase(file_ctrl->path);
+  }
+  if (file_ctrl->digest_fd == fd) {
+    file_ctrl->digest_fd = -1;
+  }
+
+  return result;
+}
+
+// Note: questionable whether to allow setting the key only on newly opened
+// files, and only if not set yet - arguably, such intelligence may need to
+// reside outside of AeadHandler on the side of the IOCTL client. If not done
+// correctly by the client, IO ops will simply fail, as intended.
+int AeadHandler::SetMasterKey(int fd, const uint8_t* key_data,
+                              uint32_t key_length) {
+  if (!key_data || key_length != kKeyLength) {
+    LOG(ERROR) << "Attempt made to set an invalid key.";
+    errno = EINVAL;
+    return -1;
+  }
+
+  std::shared_ptr<FileControl> file_ref;
+  std::unique_ptr<absl::MutexLock> file_lock;
+  FileControl* file_ctrl = AcquireFile(fd, &file_ref, &file_lock);
+  if (!file_ctrl) {
+    LOG(ERROR) << "Attempt made to set key on an unopened file, fd = " << fd;
+    errno = ENOENT;
+    return -1;
+  }
+
+  if (file_ctrl->is_deserialized) {
+    if (memcmp(file_ctrl->master_key->data(), key_data, kKeyLength) != 0) {
+      LOG(ERROR) << "Attempt made to set a new key on an existing file, fd="
+                 << fd;
+      return -1;
+    }
+
+    return 0;
+  }
+
+  file_ctrl->master_key =
+      absl::make_unique<GcmCryptorKey>(key_data, key_length);
+  const bool is_new_file = file_ctrl->is_new;
+  if (!Deserialize(file_ctrl)) {
+    LOG(ERROR) << "Failed to deserialize integrity metadata for file, path="
+               << file_ctrl->path;
+    return -1;
+  }
+
+  // A new file replaces any file at its path, including a rotation record
+  // left behind by it.
+  if (is_new_file) {
+    RemoveSidecarFile(KeyRotationPath(file_ctrl->path), kKeyRotationMagic);
+  } else {
+    LoadKeyRotationRecord(file_ctrl);
+  }
+
+  file_ctrl->is_deserialized = true;
+  if (block_cache_bytes_ >= file_ctrl->block_length) {
+    file_ctrl->cache = absl::make_unique<BlockCache>(
+        file_ctrl->block_length, block_cache_bytes_ / file_ctrl->block_length);
+  }
+  return 0;
+}
+
+int AeadHandler::SetBlockLength(int fd, size_t block_length) {
+  if (!IsSupportedBlockLength(block_length)) {
+    LOG(ERROR) << "Attempt made to set an unsupported block length: "
+               << block_length;
+    errno = EINVAL;
+    return -1;
+  }
+
+  std::shared_ptr<FileControl> file_ref;
+  std::unique_ptr<absl::MutexLock> file_lock;
+  FileControl* file_ctrl = AcquireFile(fd, &file_ref, &file_lock);
+  if (!file_ctrl) {
+    LOG(ERROR) << "Attempt made to set block length on an unopened file, fd = "
+               << fd;
+    errno = ENOENT;
+    return -1;
+  }
+
+  if (file_ctrl->block_length == block_length) {
+    return 0;
+  }
+
+  if (!file_ctrl->is_new || file_ctrl->is_deserialized) {
+    LOG(ERROR) << "Attempt made to change the block length of an existing "
+                  "file, fd = "
+               << fd;
+    errno = EINVAL;
+    return -1;
+  }
+
+  file_ctrl->block_length = block_length;
+  file_ctrl->offset_translator =
+      GetOffsetTranslatorForBlockLength(block_length);
+  return 0;
+}
+
+int AeadHandler::EnableParallelCrypto(int num_workers) {
+  absl::MutexLock global_lock(&mu_);
+  if (crypto_executor_ || !opened_files_.empty()) {
+    LOG(ERROR) << "Parallel crypto can only be enabled once, before files are "
+                  "opened.";
+    errno = EINVAL;
+    return -1;
+  }
+
+  auto executor_result = WorkStealingExecutor::Create(num_workers);
+  if (!executor_result.ok()) {
+    LOG(ERROR) << "Failed to start parallel crypto workers: "
+               << executor_result.status();
+    errno = EINVAL;
+    return -1;
   }
 
-  VLOG(2) << "Verified read blocks, blocks_read = " << blocks_read
-          << ", bytes_read = " << bytes_read;
-  return read_count;
+  crypto_executor_ = std::move(executor_result).ValueOrDie();
+  return 0;
 }
 
-bool AeadHandler::UpdateDigest(FileControl* file_ctrl,
-                               const GcmCryptor& cryptor) const {
-  if (!file_ctrl) {
+int AeadHandler::EnableReadAhead(size_t window_bytes) {
+  absl::MutexLock global_lock(&mu_);
+  if (read_ahead_executor_ || !opened_files_.empty() || window_bytes == 0) {
+    LOG(ERROR) << "Read-ahead can only be enabled once, before files are "
+                  "opened.";
     errno = EINVAL;
-    return false;
+    return -1;
   }
 
-  int fd = enc_untrusted_open(file_ctrl->path.c_str(), O_WRONLY);
-  if (fd == -1) {
-    LOG(ERROR) << "Failed to open file to save data digest, path="
-               << file_ctrl->path << ", errno = " << errno;
-    return false;
+  auto executor_result = WorkStealingExecutor::Create(/*num_workers=*/1);
+  if (!executor_result.ok()) {
+    LOG(ERROR) << "Failed to start the read-ahead worker: "
+               << executor_result.status();
+    errno = EINVAL;
+    return -1;
   }
 
-  FdCloser fd_closer(fd, &enc_untrusted_close);
+  read_ahead_executor_ = std::move(executor_result).ValueOrDie();
+  read_ahead_bytes_ = window_bytes;
+  return 0;
+}
 
-  std::string root = file_ctrl->ad->CurrentRoot();
-  if (root.size() != kRootHashLength) {
-    LOG(ERROR) << "Unexpected size of root hash encountered, size="
-               << root.size();
-    return false;
+int AeadHandler::EnableBlockCache(size_t capacity_bytes) {
+  absl::MutexLock global_lock(&mu_);
+  if (block_cache_bytes_ > 0 || !opened_files_.empty() ||
+      capacity_bytes == 0) {
+    LOG(ERROR) << "The block cache can only be enabled once, before files are "
+                  "opened.";
+    errno = EINVAL;
+    return -1;
   }
 
-  // Prepare file data digest.
-  DataDigest data_digest;
-  std::copy_n(reinterpret_cast<const uint8_t*>(root.data()), kRootHashLength,
-              data_digest.data());
-  data_digest.file_size = file_ctrl->logical_size;
+  block_cache_bytes_ = capacity_bytes;
+  return 0;
+}
 
-  FileHeader header;
-  if (!cryptor.GetAuthTag(header.data(), data_digest.data(),
-                          sizeof(DataDigest))) {
-    LOG(ERROR) << "Failed to generate CMAC, root = " << root;
-    return false;
+int AeadHandler::EnableDigestWriteBack(int64_t max_deferred_updates,
+                                       absl::Duration max_delay) {
+  absl::MutexLock global_lock(&mu_);
+  if (digest_write_back_updates_ > 0 || !opened_files_.empty() ||
+      max_deferred_updates <= 0) {
+    LOG(ERROR) << "Digest write-back can only be enabled once, before files "
+                  "are opened.";
+    errno = EINVAL;
+    return -1;
   }
-  header.file_size = file_ctrl->logical_size;
 
-  VLOG(2) << "Updating the digest for file: " << file_ctrl->path
-          << ", root hash: " << absl::BytesToHexString(root);
-  ssize_t bytes_written = write_all(fd, header.data(), sizeof(FileHeader));
-  if (bytes_written != sizeof(FileHeader)) {
-    LOG(ERROR) << "Failed to write full digest to file, path="
-               << file_ctrl->path << ", bytes written = " << bytes_written;
-    return false;
+  digest_write_back_updates_ = max_deferred_updates;
+  digest_write_back_delay_ = max_delay;
+  return 0;
+}
+
+int AeadHandler::SetDigestWriteThrough(int fd, bool write_through) {
+  std::shared_ptr<FileControl> file_ref;
+  std::unique_ptr<absl::MutexLock> file_lock;
+  FileControl* file_ctrl = AcquireFile(fd, &file_ref, &file_lock);
+  if (!file_ctrl) {
+    LOG(ERROR) << "Attempt made to set the digest policy of an unopened "
+                  "file, fd = "
+               << fd;
+    errno = ENOENT;
+    return -1;
   }
 
-  if (!fd_closer.reset()) {
-    LOG(ERROR) << "Failed to close the file after digest update, path="
-               << file_ctrl->path;
-    return false;
+  file_ctrl->digest_write_through = write_through;
+  if (write_through && !FlushDigest(file_ctrl)) {
+    return -1;
+  }
+  return 0;
+}
+
+int AeadHandler::Flush(int fd) {
+  std::shared_ptr<FileControl> file_ref;
+  std::unique_ptr<absl::MutexLock> file_lock;
+  FileControl* file_ctrl = AcquireFile(fd, &file_ref, &file_lock);
+  if (!file_ctrl) {
+    LOG(ERROR) << "Attempt made to flush an unopened file, fd = " << fd;
+    errno = ENOENT;
+    return -1;
   }
 
-  return true;
+  return FlushCache(file_ctrl) && FlushAppends(file_ctrl) &&
+                 FlushDigest(file_ctrl)
+             ? 0
+             : -1;
 }
 
-bool AeadHandler::ReadFullBlock(const FileControl& file_ctrl,
-                                off_t logical_offset, Block* block) const {
-  if (logical_offset < 0 || logical_offset % kBlockLength != 0) {
+int AeadHandler::Truncate(int fd, off_t length) {
+  if (length < 0) {
     errno = EINVAL;
-    return false;
+    return -1;
   }
 
-  int fd = enc_untrusted_open(file_ctrl.path.c_str(), O_RDONLY);
-  if (fd == -1) {
-    LOG(ERROR) << "Failed to open file to read a block, path=" << file_ctrl.path
-               << ", errno = " << errno;
-    return false;
+  std::shared_ptr<FileControl> file_ref;
+  std::unique_ptr<absl::MutexLock> file_lock;
+  FileControl* file_ctrl = AcquireFile(fd, &file_ref, &file_lock);
+  if (!file_ctrl) {
+    LOG(ERROR) << "Attempt made to truncate an unopened file, fd = " << fd;
+    errno = ENOENT;
+    return -1;
   }
 
-  FdCloser fd_closer(fd, &enc_untrusted_close);
-
-  off_t physical_offset = offset_translator_->LogicalToPhysical(logical_offset);
-  off_t offset = enc_untrusted_lseek(fd, physical_offset, SEEK_SET);
-  if (offset == -1) {
-    LOG(ERROR) << "Failed lseek when reading a full block.";
-    return false;
+  if (!file_ctrl->is_deserialized) {
+    LOG(ERROR) << "Attempt made to truncate a file without a key, fd = " << fd;
+    errno = EINVAL;
+    return -1;
   }
 
-  ssize_t bytes_read = DecryptAndVerifyInternal(fd, block->data(), kBlockLength,
-                                                file_ctrl, logical_offset);
-  if (bytes_read == -1) {
+  // The held back last block of appends ends at the logical size.
+  if (!FlushAppends(file_ctrl)) {
     return -1;
   }
 
-  if (bytes_read < kBlockLength) {
-    memset(block->data() + bytes_read, 0, kBlockLength - bytes_read);
+  // The blocks of the file are not rewritten, so the file may only shrink to
+  // the end of its blocks, including those written back from the cache. The
+  // bytes of the last block past the logical size are zeros, so extending
+  // the file exposes zeros.
+  const size_t block_length = file_ctrl->block_length;
+  if (length < file_ctrl->logical_size) {
+    if (!FlushCache(file_ctrl)) {
+      return -1;
+    }
+    if (length < file_ctrl->ad->LeafCount() * block_length) {
+      LOG(ERROR) << "Attempt made to truncate stored blocks of a file, fd = "
+                 << fd;
+      errno = EINVAL;
+      return -1;
+    }
   }
 
-  return true;
+  if (length == file_ctrl->logical_size) {
+    return 0;
+  }
+  file_ctrl->logical_size = length;
+  return DeferDigestUpdate(fd, file_ctrl) ? 0 : -1;
 }
 
-ssize_t AeadHandler::EncryptAndPersist(int fd, const void* buf, size_t count) {
-  if (!buf) {
+int AeadHandler::BeginKeyRotation(int fd, const uint8_t* key_data,
+                                  uint32_t key_length) {
+  if (!key_data || key_length != kKeyLength) {
+    LOG(ERROR) << "Attempt made to rotate to an invalid key.";
     errno = EINVAL;
     return -1;
   }
 
-  off_t logical_offset;
-  if (!RetrieveLogicalOffset(fd, &logical_offset)) {
+  std::shared_ptr<FileControl> file_ref;
+  std::unique_ptr<absl::MutexLock> file_lock;
+  FileControl* file_ctrl = AcquireFile(fd, &file_ref, &file_lock);
+  if (!file_ctrl) {
+    LOG(ERROR) << "Attempt made to rotate the key of an unopened file, fd = "
+               << fd;
+    errno = ENOENT;
     return -1;
   }
 
-  FileControl* file_ctrl;
-  std::unique_ptr<absl::MutexLock> file_lock;
-  {
-    absl::MutexLock global_lock(&mu_);
+  if (!file_ctrl->is_deserialized) {
+    LOG(ERROR) << "Attempt made to rotate the key of a file without a key, "
+                  "fd = "
+               << fd;
+    errno = EINVAL;
+    return -1;
+  }
 
-    auto entry = fmap_.find(fd);
-    if (entry == fmap_.end()) {
-      LOG(ERROR) << "Attempt made to write to an unopened file, fd = " << fd;
-      errno = ENOENT;
+  auto key = absl::make_unique<GcmCryptorKey>(key_data, key_length);
+  GcmCryptor* cryptor = GcmCryptorRegistry::GetInstance().GetGcmCryptor(
+      file_ctrl->block_length, *key, file_ctrl->integrity_only);
+  FileHash key_check;
+  if (!cryptor ||
+      !cryptor->GetAuthTag(key_check.data(),
+                           reinterpret_cast<const uint8_t*>(kKeyCheckMessage),
+                           sizeof(kKeyCheckMessage) - 1)) {
+    LOG(ERROR) << "Failed to identify the key of a key rotation, fd = " << fd;
+    return -1;
+  }
+
+  if (file_ctrl->has_key_rotation) {
+    if (key_check != file_ctrl->rotation_key_check) {
+      LOG(ERROR) << "Attempt made to rotate to another key than the rotation "
+                    "in progress, fd = "
+                 << fd;
+      errno = EINVAL;
       return -1;
     }
 
-    file_ctrl = entry->second.get();
-    file_lock = absl::make_unique<absl::MutexLock>(&file_ctrl->mu);
-  }
-
-  if (count == 0) {
+    if (!file_ctrl->rotation_key) {
+      file_ctrl->rotation_key = std::move(key);
+    }
     return 0;
   }
 
-  // Determine data breakdown into logical blocks.
-  size_t first_partial_block_bytes_count;
-  size_t last_partial_block_bytes_count;
-  size_t full_inclusive_blocks_bytes_count;
-  offset_translator_->ReduceLogicalRangeToFullLogicalBlocks(
-      logical_offset, count, &first_partial_block_bytes_count,
-      &last_partial_block_bytes_count, &full_inclusive_blocks_bytes_count);
+  // The record is written before any block is re-encrypted, so that blocks
+  // under the new key are found if the rotation is interrupted.
+  file_ctrl->has_key_rotation = true;
+  file_ctrl->rotation_key_check = key_check;
+  file_ctrl->rotation_key = std::move(key);
+  file_ctrl->rotated_blocks = 0;
+  if (!PersistKeyRotationRecord(*file_ctrl)) {
+    file_ctrl->has_key_rotation = false;
+    file_ctrl->rotation_key.reset();
+    return -1;
+  }
 
-  // Bounce block for writing the first partial block in the range, if any.
-  Block first_block;
-  if (first_partial_block_bytes_count > 0) {
-    if (!ReadFullBlock(
-            *file_ctrl,
-            logical_offset + first_partial_block_bytes_count - kBlockLength,
-            &first_block)) {
-      LOG(ERROR)
-          << "failed to read the first misaligned block when writing, fd = "
-          << fd;
-      return -1;
-    }
+  return 0;
+}
 
-    std::copy_n(
-        reinterpret_cast<const uint8_t*>(buf), first_partial_block_bytes_count,
-        first_block.data() + kBlockLength - first_partial_block_bytes_count);
+int64_t AeadHandler::RotateKeyStep(int fd, int64_t max_blocks) {
+  if (max_blocks <= 0) {
+    errno = EINVAL;
+    return -1;
   }
 
-  // Bounce block for writing the last partial block in the range, if any.
-  Block last_block;
-  if (last_partial_block_bytes_count > 0) {
-    if (!ReadFullBlock(*file_ctrl,
-                       logical_offset + count - last_partial_block_bytes_count,
-                       &last_block)) {
-      LOG(ERROR)
-          << "failed to read the last misaligned block when writing, fd = "
-          << fd;
-      return -1;
-    }
-
-    std::copy_n(reinterpret_cast<const uint8_t*>(buf) + count -
-                    last_partial_block_bytes_count,
-                last_partial_block_bytes_count, last_block.data());
+  std::shared_ptr<FileControl> file_ref;
+  std::unique_ptr<absl::MutexLock> file_lock;
+  FileControl* file_ctrl = AcquireFile(fd, &file_ref, &file_lock);
+  if (!file_ctrl) {
+    LOG(ERROR) << "Attempt made to rotate the key of an unopened file, fd = "
+               << fd;
+    errno = ENOENT;
+    return -1;
   }
 
-  const off_t first_logical_block_offset =
-      (first_partial_block_bytes_count > 0)
-          ? (logical_offset + first_partial_block_bytes_count - kBlockLength)
-          : logical_offset;
-  const off_t first_physical_block_offset =
-      offset_translator_->LogicalToPhysical(first_logical_block_offset);
-  const int64_t eof_block_index = file_ctrl->ad->LeafCount();
-  int64_t start_block_to_write = 0;
-  if (first_physical_block_offset > file_ctrl->physical_size()) {
-    // Append leafs to the Merkle Tree to account for sparse region blocks.
-    int64_t sparse_blocks_count =
-        (first_physical_block_offset - file_ctrl->physical_size()) /
-        kSecureBlockLength;
-    for (int64_t idx = 0; idx < sparse_blocks_count; idx++) {
-      VLOG(2) << "Adding an empty auth tag to AD for a block "
-                 "from a sparse region: "
-              << absl::BytesToHexString(file_ctrl->zero_hash);
-      file_ctrl->ad->AddLeafHash(file_ctrl->zero_hash);
-    }
-    start_block_to_write = eof_block_index + sparse_blocks_count;
-  } else {
-    int64_t blocks_to_eof =
-        (file_ctrl->physical_size() - first_physical_block_offset) /
-        kSecureBlockLength;
-    start_block_to_write = eof_block_index - blocks_to_eof;
+  if (!file_ctrl->has_key_rotation) {
+    LOG(ERROR) << "No key rotation in progress, fd = " << fd;
+    errno = EINVAL;
+    return -1;
   }
 
   GcmCryptor* cryptor = GetGcmCryptor(*file_ctrl);
@@ -730,206 +2772,225 @@ ssize_t AeadHandler::EncryptAndPersist(int fd, const void* buf, size_t count) {
     return -1;
   }
 
-  VLOG(2) << "Writing data to file, count = " << count << ", fd = " << fd;
-
-  // Use single write buffer to minimize the number of write calls to the host.
-  std::vector<uint8_t> buffer;
-  const int64_t blocks_to_write =
-      full_inclusive_blocks_bytes_count / kBlockLength;
-  const size_t physical_bytes_count = blocks_to_write * kSecureBlockLength;
-  buffer.resize(physical_bytes_count);
-
-  // Cycle through blocks.
-  std::vector<Tag> tags;
-  for (int64_t block_index = 0; block_index < blocks_to_write; block_index++) {
-    const uint8_t* plaintext_data =
-        GetPlaintextBuffer(first_partial_block_bytes_count, block_index, buf);
-
-    // Source for encryption - bounce block or the supplied buffer.
-    const uint8_t* encrypt_source;
-    // Determine the source depending on whether the written block is at the end
-    // of the full range.
-    if (block_index == 0 && first_partial_block_bytes_count > 0) {
-      encrypt_source = first_block.data();
-    } else if (block_index == blocks_to_write - 1 &&
-               last_partial_block_bytes_count > 0) {
-      encrypt_source = last_block.data();
-    } else {
-      encrypt_source = plaintext_data;
+  // Blocks held back in the block cache or by appends are not re-encrypted
+  // here, since WriteBlocks encrypts them under the key of their side of the
+  // rotation point when they are written.
+  const size_t block_length = file_ctrl->block_length;
+  const int64_t leaf_count = file_ctrl->ad->LeafCount();
+  const int64_t first_block = file_ctrl->rotated_blocks;
+  const int64_t end_block =
+      first_block + std::min<int64_t>(max_blocks, leaf_count - first_block);
+  if (first_block < end_block) {
+    int rotation_fd = enc_untrusted_open(file_ctrl->path.c_str(), O_RDWR);
+    if (rotation_fd == -1) {
+      LOG(ERROR) << "Failed to open file to rotate its key, path="
+                 << file_ctrl->path << ", errno = " << errno;
+      return -1;
     }
 
-    Ciphertext* ciphertext =
-        Ciphertext::Place(&buffer, block_index * kSecureBlockLength);
-    Token* token = Token::Place(
-        &buffer, block_index * kSecureBlockLength + kCipherBlockLength);
+    FdCloser fd_closer(rotation_fd, &enc_untrusted_close);
 
-    // Encrypt the block.
-    if (!cryptor->EncryptBlock(encrypt_source, token->data(),
-                               ciphertext->data())) {
-      LOG(ERROR) << "Encryption failed, fd = " << fd;
+    std::vector<uint8_t> blocks((end_block - first_block) * block_length);
+    if (!ReadBlocksFromFile(rotation_fd, file_ctrl, first_block, end_block,
+                            blocks.data())) {
       return -1;
     }
-    VLOG(2) << "Ciphertext generated: "
-            << absl::BytesToHexString(absl::string_view(
-                   reinterpret_cast<const char*>(ciphertext->data()),
-                   kBlockLength));
-    VLOG(2) << "Token generated: "
-            << absl::BytesToHexString(absl::string_view(
-                   reinterpret_cast<const char*>(token->data()), kTokenLength));
 
-    TagView tag(ciphertext->data() + kBlockLength, kTagLength);
-    tags.push_back(tag);
-    VLOG(2) << "Auth tag generated: "
-            << absl::BytesToHexString(absl::string_view(
-                   reinterpret_cast<const char*>(tag.data()), kTagLength));
-  }
+    // Advance the rotation point first, so that WriteBlocks selects the new
+    // key. Blocks of sparse regions are not written, and remain sparse.
+    file_ctrl->rotated_blocks = end_block;
+    const MerkleAuthenticatedDictionary& ad = *file_ctrl->ad;
+    for (int64_t begin = first_block; begin < end_block;) {
+      if (ad.LeafHash(begin + 1) == file_ctrl->zero_hash) {
+        begin++;
+        continue;
+      }
+
+      int64_t end = begin + 1;
+      while (end < end_block && ad.LeafHash(end + 1) != file_ctrl->zero_hash) {
+        end++;
+      }
+
+      const uint8_t* run = blocks.data() + (begin - first_block) * block_length;
+      if (!WriteBlocks(rotation_fd, file_ctrl, cryptor, begin, end - begin,
+                       [run, block_length](int64_t block_index) {
+                         return run + block_index * block_length;
+                       })) {
+        return -1;
+      }
+      begin = end;
+    }
 
-  // Move cursor to the first full block to write.
-  if (first_partial_block_bytes_count > 0) {
-    off_t offset =
-        enc_untrusted_lseek(fd, first_physical_block_offset, SEEK_SET);
-    if (offset == -1) {
-      LOG(ERROR)
-          << "Failed lseek to the fist block offset when writing file data.";
+    if (!fd_closer.reset()) {
+      LOG(ERROR) << "Failed to close the file after rotating its key, path="
+                 << file_ctrl->path;
       return -1;
     }
-  }
-
-  // Note: with block alignment constraint in place, partial block writes are
-  // not permissible - complete blocks must be written. Thus, the options are:
-  // 1. Allow partial yet block-aligned writes - this would require truncating
-  //    partially written blocks, which has a perf impact.
-  // 2. Require complete data to be written in a write loop that terminates only
-  //    on error or when all data has been written, following the POSIX model -
-  //    this may lead to "long" writes when "large" amount of data is written.
-  // In this code optimize operation for full writes - i.e. the option #2.
-  ssize_t bytes_written = write_all(fd, buffer.data(), physical_bytes_count);
-  if (bytes_written != physical_bytes_count) {
-    LOG(ERROR) << "Failed to write encrypted data to file, path="
-               << file_ctrl->path << ", bytes written = " << bytes_written;
-    return -1;
-  }
 
-  // Move cursor to the position of the end of the write range.
-  if (last_partial_block_bytes_count > 0) {
-    off_t new_cur_logical_offset = logical_offset + count;
-    off_t new_cur_physical_offset =
-        offset_translator_->LogicalToPhysical(new_cur_logical_offset);
-    off_t offset = enc_untrusted_lseek(fd, new_cur_physical_offset, SEEK_SET);
-    if (offset == -1) {
-      LOG(ERROR)
-          << "Failed lseek to the last block offset when reading file data.";
+    if (!UpdateDigest(file_ctrl)) {
       return -1;
     }
   }
 
-  for (int64_t idx = 0; idx < tags.size(); idx++) {
-    std::string tag_string(reinterpret_cast<char*>(tags[idx].data()), kTagLength);
-    int64_t block_index = start_block_to_write + idx;
-    if (block_index < eof_block_index) {
-      VLOG(2) << "Updating auth tag on AD: "
-              << absl::BytesToHexString(tag_string);
-      file_ctrl->ad->UpdateLeaf(block_index + 1, tag_string);
-    } else {
-      VLOG(2) << "Appending auth tag to AD: "
-              << absl::BytesToHexString(tag_string);
-      file_ctrl->ad->AddLeaf(tag_string);
-    }
+  if (file_ctrl->rotated_blocks >= leaf_count) {
+    return CompleteKeyRotation(file_ctrl) ? 0 : -1;
   }
 
-  file_ctrl->logical_size = logical_offset + count;
-
-  if (!UpdateDigest(file_ctrl, *cryptor)) {
+  if (!PersistKeyRotationRecord(*file_ctrl)) {
     return -1;
   }
 
-  VLOG(2) << "Wrote data to file, bytes_written = " << bytes_written;
+  VLOG(2) << "Rotated the key of blocks [" << first_block << ", " << end_block
+          << "), path = " << file_ctrl->path;
+  return leaf_count - file_ctrl->rotated_blocks;
+}
 
-  return count;
+void AeadHandler::LoadKeyRotationRecord(FileControl* file_ctrl) const {
+  int fd =
+      enc_untrusted_open(KeyRotationPath(file_ctrl->path).c_str(), O_RDONLY);
+  if (fd == -1) {
+    return;
+  }
+
+  FdCloser fd_closer(fd, &enc_untrusted_close);
+
+  const GcmCryptor* cryptor = GetDigestCryptor(*file_ctrl);
+  KeyRotationRecord record;
+  FileHash record_hash;
+  if (!cryptor ||
+      read_all(fd, &record, sizeof(KeyRotationRecord)) !=
+          sizeof(KeyRotationRecord) ||
+      record.magic != kKeyRotationMagic ||
+      !cryptor->GetAuthTag(record_hash.data(),
+                           reinterpret_cast<const uint8_t*>(&record),
+                           sizeof(KeyRotationRecord) - sizeof(FileHash)) ||
+      record_hash != record.record_hash ||
+      record.rotated_blocks > file_ctrl->ad->LeafCount()) {
+    LOG(WARNING) << "Ignoring a stale key rotation record, path="
+                 << file_ctrl->path;
+    return;
+  }
+
+  file_ctrl->has_key_rotation = true;
+  file_ctrl->rotation_key_check = record.key_check;
+  file_ctrl->rotated_blocks = record.rotated_blocks;
 }
 
-bool AeadHandler::FinalizeFile(int fd) {
-  absl::MutexLock global_lock(&mu_);
+bool AeadHandler::PersistKeyRotationRecord(const FileControl& file_ctrl) const {
+  const GcmCryptor* cryptor = GetDigestCryptor(file_ctrl);
+  if (!cryptor) {
+    return false;
+  }
 
-  if (fd < 0) {
-    errno = EINVAL;
+  KeyRotationRecord record;
+  record.magic = kKeyRotationMagic;
+  record.rotated_blocks = file_ctrl.rotated_blocks;
+  record.key_check = file_ctrl.rotation_key_check;
+  if (!cryptor->GetAuthTag(record.record_hash.data(),
+                           reinterpret_cast<const uint8_t*>(&record),
+                           sizeof(KeyRotationRecord) - sizeof(FileHash))) {
+    LOG(ERROR) << "Failed to generate CMAC of the key rotation record, path="
+               << file_ctrl.path;
     return false;
   }
 
-  auto entry = fmap_.find(fd);
-  if (entry == fmap_.end()) {
-    LOG(ERROR) << "Attempt made to finalize uninitialized file, fd = " << fd;
-    errno = ENOENT;
+  int fd = OpenSidecarForWrite(KeyRotationPath(file_ctrl.path),
+                               kKeyRotationMagic);
+  if (fd == -1) {
+    LOG(ERROR) << "Failed to open the key rotation record of file, path="
+               << file_ctrl.path << ", errno = " << errno;
     return false;
   }
 
-  FileControl* file_ctrl = entry->second.get();
-  {
-    // Wait until the file is not operated on - once that is the case, it will
-    // remain the case throughout this function, as guaranteed by global_lock.
-    absl::MutexLock file_lock(&file_ctrl->mu);
+  FdCloser fd_closer(fd, &enc_untrusted_close);
+
+  if (pwrite_all(fd, &record, sizeof(KeyRotationRecord), /*file_offset=*/0) !=
+      sizeof(KeyRotationRecord)) {
+    LOG(ERROR) << "Failed to write the key rotation record, path="
+               << file_ctrl.path;
+    return false;
   }
 
-  VLOG(2) << "Finalizing secure file, fd = " << fd
-          << ", pathname = " << file_ctrl->path;
-  opened_files_.erase(file_ctrl->path);
-  fmap_.erase(fd);
+  if (!fd_closer.reset()) {
+    LOG(ERROR) << "Failed to close the key rotation record, path="
+               << file_ctrl.path;
+    return false;
+  }
 
   return true;
 }
 
-// Note: questionable whether to allow setting the key only on newly opened
-// files, and only if not set yet - arguably, such intelligence may need to
-// reside outside of AeadHandler on the side of the IOCTL client. If not done
-// correctly by the client, IO ops will simply fail, as intended.
-int AeadHandler::SetMasterKey(int fd, const uint8_t* key_data,
-                              uint32_t key_length) {
-  if (!key_data || key_length != kKeyLength) {
-    LOG(ERROR) << "Attempt made to set an invalid key.";
-    errno = EINVAL;
-    return -1;
+bool AeadHandler::CompleteKeyRotation(FileControl* file_ctrl) const {
+  // The digest is written under the new key before the record is removed, so
+  // that a record left behind in between no longer validates.
+  std::unique_ptr<GcmCryptorKey> previous_key =
+      std::move(file_ctrl->master_key);
+  file_ctrl->master_key = std::move(file_ctrl->rotation_key);
+  file_ctrl->has_key_rotation = false;
+  if (!UpdateDigest(file_ctrl)) {
+    file_ctrl->rotation_key = std::move(file_ctrl->master_key);
+    file_ctrl->master_key = std::move(previous_key);
+    file_ctrl->has_key_rotation = true;
+    return false;
   }
 
-  FileControl* file_ctrl;
-  std::unique_ptr<absl::MutexLock> file_lock;
-  {
-    absl::MutexLock global_lock(&mu_);
-
-    auto entry = fmap_.find(fd);
-    if (entry == fmap_.end()) {
-      LOG(ERROR) << "Attempt made to set key on an unopened file, fd = " << fd;
-      errno = ENOENT;
-      return -1;
-    }
-
-    file_ctrl = entry->second.get();
-    file_lock = absl::make_unique<absl::MutexLock>(&file_ctrl->mu);
+  file_ctrl->rotated_blocks = 0;
+  if (enc_untrusted_unlink(KeyRotationPath(file_ctrl->path).c_str()) == -1) {
+    LOG(WARNING) << "Failed to remove the key rotation record, path="
+                 << file_ctrl->path << ", errno = " << errno;
   }
 
-  if (file_ctrl->is_deserialized) {
-    if (memcmp(file_ctrl->master_key->data(), key_data, kKeyLength) != 0) {
-      LOG(ERROR) << "Attempt made to set a new key on an existing file, fd="
-                 << fd;
-      return -1;
-    }
+  VLOG(2) << "Completed key rotation, path = " << file_ctrl->path;
+  return true;
+}
 
-    return 0;
+bool AeadHandler::ForEachBlockRange(
+    int64_t block_count, size_t block_length,
+    const std::function<bool(int64_t, int64_t)>& body) const {
+  if (block_count == 0) {
+    return true;
   }
+  if (!crypto_executor_ || block_count < 2 ||
+      block_count * block_length < kMinParallelCryptoBytes) {
+    return body(0, block_count);
+  }
+
+  // Ranges are independent, so once any range fails the remaining ones are
+  // skipped rather than processed.
+  std::atomic<bool> failed(false);
+  const size_t grain =
+      std::max<size_t>(1, kParallelCryptoGrainBytes / block_length);
+  crypto_executor_->ParallelFor(
+      0, block_count, grain, [&body, &failed](size_t begin, size_t end) {
+        if (failed.load(std::memory_order_relaxed)) {
+          return;
+        }
+        if (!body(begin, end)) {
+          failed.store(true, std::memory_order_relaxed);
+        }
+      });
+  return !failed.load();
+}
 
-  file_ctrl->master_key =
-      absl::make_unique<GcmCryptorKey>(key_data, key_length);
-  if (!Deserialize(file_ctrl)) {
-    LOG(ERROR) << "Failed to deserialize integrity metadata for file, path="
-               << file_ctrl->path;
-    return -1;
+const OffsetTranslator& AeadHandler::GetOffsetTranslator(int fd) {
+  std::shared_ptr<FileControl> file_ref;
+  std::unique_ptr<absl::ReaderMutexLock> file_lock;
+  FileControl* file_ctrl = AcquireFile(fd, &file_ref, &file_lock);
+  if (!file_ctrl) {
+    return *GetOffsetTranslatorForBlockLength(kBlockLength);
   }
-
-  file_ctrl->is_deserialized = true;
-  return 0;
+  return *file_ctrl->offset_translator;
 }
 
-const OffsetTranslator& AeadHandler::GetOffsetTranslator() const {
-  return *offset_translator_;
+off_t AeadHandler::GetLogicalSize(int fd) {
+  std::shared_ptr<FileControl> file_ref;
+  std::unique_ptr<absl::ReaderMutexLock> file_lock;
+  FileControl* file_ctrl = AcquireFile(fd, &file_ref, &file_lock);
+  if (!file_ctrl) {
+    errno = ENOENT;
+    return -1;
+  }
+  return file_ctrl->logical_size;
 }
 
 }  // namespace storage
@@ -20,16 +20,25 @@
 #define ASYLO_PLATFORM_STORAGE_SECURE_AEAD_HANDLER_H_
 
 #include <stdint.h>
+#include <array>
+#include <deque>
+#include <functional>
 #include <memory>
+#include <set>
 #include <string>
 #include <unordered_map>
+#include <vector>
 
 #include "absl/base/attributes.h"
+#include "absl/memory/memory.h"
 #include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
 #include "asylo/crypto/util/bytes.h"
 #include "asylo/platform/crypto/gcmlib/gcm_cryptor.h"
+#include "asylo/platform/posix/threading/work_stealing_executor.h"
 #include "asylo/platform/storage/secure/authenticated_dictionary.h"
-#include "asylo/platform/storage/secure/ctmmt_authenticated_dictionary.h"
+#include "asylo/platform/storage/secure/block_cache.h"
+#include "asylo/platform/storage/secure/merkle_authenticated_dictionary.h"
 #include "asylo/platform/storage/utils/offset_translator.h"
 
 namespace asylo {
@@ -42,9 +51,16 @@ using crypto::gcmlib::kKeyLength;
 using crypto::gcmlib::kTagLength;
 using crypto::gcmlib::kTokenLength;
 
-// Length of file blocks to encrypt/decrypt.
+// Length of file blocks to encrypt/decrypt in files that do not record a
+// block length. This is also the block length of newly created files unless
+// AeadHandler::SetBlockLength selects another one.
 constexpr size_t kBlockLength = 128;
-using Block = UnsafeBytes<kBlockLength>;
+
+// Larger block lengths that may be selected for bulk data. Each block carries
+// its own tag, token and Merkle leaf, so larger blocks reduce space overhead
+// and the number of cryptographic operations per byte.
+constexpr size_t kBlockLength4KiB = 4096;
+constexpr size_t kBlockLength64KiB = 65536;
 
 // Length of the file digest (of the AD root).
 constexpr int64_t kRootHashLength = 32;
@@ -52,12 +68,37 @@ constexpr int64_t kRootHashLength = 32;
 // Length of the hash of the file digest (of the AD root).
 constexpr int64_t kFileHashLength = 16;
 
-// Constants for the secure block structure - the secure block consists of
-// the ciphertext of the same length as the original plaintext, followed by the
-// integrity tag, followed by the encryption token.
+// Constants for the secure block structure of files with the default block
+// length - the secure block consists of the ciphertext of the same length as
+// the original plaintext, followed by the integrity tag, followed by the
+// encryption token.
 constexpr size_t kCipherBlockLength = kBlockLength + kTagLength;
 constexpr size_t kSecureBlockLength = kCipherBlockLength + kTokenLength;
 
+// A secure file at <path> may be accompanied on the host by two sidecar files:
+// its integrity index at <path>.integrity, and the record of a key rotation in
+// progress at <path>.rekey. Each starts with a magic number, so that a file of
+// the same name which is not a sidecar is never overwritten or removed in its
+// place. Unlinking the secure file through IOManager removes its sidecars.
+
+// Suffix appended to the path of a secure file to form the path of its
+// integrity index.
+constexpr char kIntegrityIndexSuffix[] = ".integrity";
+
+// Suffix appended to the path of a secure file to form the path of the record
+// of a key rotation in progress.
+constexpr char kKeyRotationSuffix[] = ".rekey";
+
+// Magic numbers at the start of the integrity index and the key rotation
+// record.
+constexpr uint64_t kIntegrityIndexMagic = 0x5844494f4c595341;  // "ASYLOIDX"
+constexpr uint64_t kKeyRotationMagic = 0x59454b4f4c595341;     // "ASYLOKEY"
+
+// Number of blocks which may be appended to a file through O_APPEND descriptors
+// before the file digest is updated. Appends which do not fill a block are kept
+// in the enclave until the block fills or the file is flushed.
+constexpr int64_t kAppendSealBlockCount = 64;
+
 using FileHash = UnsafeBytes<kFileHashLength>;
 using FileDigest = UnsafeBytes<kRootHashLength>;
 
@@ -76,11 +117,20 @@ class AeadHandler {
     return *instance;
   }
 
+  // Removes the sidecar files of the secure file at |path|, leaving alone
+  // files at their paths which are not sidecars.
+  static void RemoveSidecarFiles(const std::string& path);
+
   // Loads integrity metadata, initializes integrity assurance for a newly
   // opened file, returns false on failure. Does not modify the state of the
   // file descriptor. By contract, absolute (canonical) |path_name| is expected.
-  // The function performs a weak validation that the path is canonical.
-  bool InitializeFile(int fd, const char* path_name, bool is_new_file)
+  // The function performs a weak validation that the path is canonical. Writes
+  // through |fd| are appended to the end of the file if |is_append| is true.
+  // Blocks of a new file are stored in plaintext and only authenticated if
+  // |integrity_only| is true; an existing file must be opened in the mode it
+  // was created with, or the call fails with EINVAL.
+  bool InitializeFile(int fd, const char* path_name, bool is_new_file,
+                      bool is_append, bool integrity_only = false)
       LOCKS_EXCLUDED(mu_);
 
   // Decrypts read data in-place, verifies data has not been tampered with,
@@ -92,8 +142,17 @@ class AeadHandler {
   ssize_t EncryptAndPersist(int fd, const void* buf, size_t count)
       LOCKS_EXCLUDED(mu_);
 
+  // Positional counterparts of DecryptAndVerify and EncryptAndPersist, which
+  // access the file at |logical_offset| and do not use or modify the cursor of
+  // |fd|. Reads of disjoint or overlapping ranges run concurrently, unless they
+  // need to load integrity metadata or the file has a block cache.
+  ssize_t DecryptAndVerifyAt(int fd, void* buf, size_t count,
+                             off_t logical_offset) LOCKS_EXCLUDED(mu_);
+  ssize_t EncryptAndPersistAt(int fd, const void* buf, size_t count,
+                              off_t logical_offset) LOCKS_EXCLUDED(mu_);
+
   // Frees resources used to assure integrity of an opened file, persists
-  // integrity metadata to a designated location on disk, returns false on
+  // integrity metadata to the integrity index of the file, returns false on
   // failure. Does not modify the state of the file descriptor.
   bool FinalizeFile(int fd) LOCKS_EXCLUDED(mu_);
 
@@ -101,7 +160,109 @@ class AeadHandler {
   int SetMasterKey(int fd, const uint8_t* key_data, uint32_t key_length)
       LOCKS_EXCLUDED(mu_);
 
-  const OffsetTranslator& GetOffsetTranslator() const;
+  // Selects the block length of a newly created file. Must be called before
+  // the master key is set, since setting the key writes the file header which
+  // records the block length. |block_length| must be one of kBlockLength,
+  // kBlockLength4KiB or kBlockLength64KiB. Returns 0 on success, or -1 with
+  // errno set on failure. Requesting the block length a file already has
+  // always succeeds.
+  int SetBlockLength(int fd, size_t block_length) LOCKS_EXCLUDED(mu_);
+
+  // Starts |num_workers| threads which encrypt and decrypt the blocks of large
+  // reads and writes in parallel with the calling thread. Without them, every
+  // block is processed on the calling thread. May be called at most once,
+  // before any file is opened. Returns 0 on success, or -1 with errno set on
+  // failure.
+  int EnableParallelCrypto(int num_workers) LOCKS_EXCLUDED(mu_);
+
+  // Keeps up to |capacity_bytes| of decrypted blocks of each open file cached
+  // in enclave memory, shared by all descriptors of the file. Writes are
+  // buffered in the cache until they are flushed, the file is closed, or space
+  // is needed for other blocks. May be called at most once, before any file is
+  // opened. Returns 0 on success, or -1 with errno set on failure.
+  int EnableBlockCache(size_t capacity_bytes) LOCKS_EXCLUDED(mu_);
+
+  // Fetches up to |window_bytes| of blocks past the reads of each open file
+  // ahead of time once the file is read sequentially. A helper thread reads
+  // the blocks from the host and decrypts them while the application consumes
+  // the data read before, so that streaming reads take about the longer of
+  // the host I/O and the decryption rather than their sum. Blocks fetched
+  // ahead are verified against the integrity metadata when they are read, and
+  // are read again if the file changed since. Files with a block cache or a
+  // key rotation in progress are not read ahead. May be called at most once,
+  // before any file is opened. Returns 0 on success, or -1 with errno set on
+  // failure.
+  int EnableReadAhead(size_t window_bytes) LOCKS_EXCLUDED(mu_);
+
+  // Starts re-encrypting the file opened on |fd| under the |key_length| byte
+  // key at |key_data|, or resumes an interrupted rotation to that key. The
+  // blocks are re-encrypted by calls to RotateKeyStep, which the application
+  // makes at the rate it chooses, typically from a background thread, and the
+  // file can be read and written in between. Progress is recorded alongside
+  // the file, so that a rotation interrupted by closing the file or by the
+  // enclave stopping resumes where it left off. Until then, the file can be
+  // opened with its previous key, but not read or written. Returns 0 on
+  // success, or -1 with errno set on failure.
+  int BeginKeyRotation(int fd, const uint8_t* key_data, uint32_t key_length)
+      LOCKS_EXCLUDED(mu_);
+
+  // Re-encrypts up to |max_blocks| further blocks of the file opened on |fd|
+  // under the key of its rotation, holding the file lock for these blocks
+  // only. Once all blocks are re-encrypted, the rotation completes and the
+  // file is then opened with the new key. Returns the number of blocks left
+  // to re-encrypt, which is zero once the rotation is complete, or -1 with
+  // errno set on failure.
+  int64_t RotateKeyStep(int fd, int64_t max_blocks) LOCKS_EXCLUDED(mu_);
+
+  // Defers writing the digest of a file after its data is written, unless the
+  // file uses write-through, see SetDigestWriteThrough. A deferred digest is
+  // written when the file is synced or closed, when blocks are written back
+  // from the block cache or appends are flushed, on the
+  // |max_deferred_updates|th write since the digest was last written, or on
+  // the first write at least |max_delay| after the first deferred one. There
+  // is no timer, so a non-positive |max_delay| only bounds the number of
+  // writes. May be called at most once, before any file is opened. Returns 0
+  // on success, or -1 with errno set on failure.
+  //
+  // Until its digest is written, the data of a file on the host does not
+  // match its header. If the enclave stops before then, the next open of the
+  // file ignores the blocks written past the size recorded in the header, as
+  // it does for appends not yet sealed. If blocks within that size were
+  // rewritten, the file fails integrity validation: the lost writes are
+  // detected rather than rolled back, and the file cannot be read again.
+  // Files using write-through remain readable as of their last completed
+  // write. Appends through O_APPEND descriptors seal the digest every
+  // kAppendSealBlockCount blocks either way.
+  int EnableDigestWriteBack(int64_t max_deferred_updates,
+                            absl::Duration max_delay) LOCKS_EXCLUDED(mu_);
+
+  // Selects whether the digest of the file opened on |fd| is written on every
+  // write, as it is for all files unless digest write-back is enabled. Applies
+  // to all descriptors of the file. Returns 0 on success, or -1 with errno set
+  // on failure.
+  int SetDigestWriteThrough(int fd, bool write_through) LOCKS_EXCLUDED(mu_);
+
+  // Writes the blocks of the file opened on |fd| which are buffered in the
+  // block cache or held back from appends to the file, and updates its digest.
+  // Returns 0 on success, or -1 with errno set on failure.
+  int Flush(int fd) LOCKS_EXCLUDED(mu_);
+
+  // Sets the logical size of the file opened on |fd| to |length|. A file is
+  // extended with a sparse region, which reads as zeros and is not stored, so
+  // extending a file takes constant time regardless of |length|. A file may
+  // only be shortened within such a region. Returns 0 on success, or -1 with
+  // errno set on failure.
+  int Truncate(int fd, off_t length) LOCKS_EXCLUDED(mu_);
+
+  // Returns the offset translator matching the layout of the file opened on
+  // |fd|, or the translator for the default layout if |fd| is not an
+  // initialized secure file.
+  const OffsetTranslator& GetOffsetTranslator(int fd) LOCKS_EXCLUDED(mu_);
+
+  // Returns the logical size of the file opened on |fd|, including data held
+  // back in the block cache or the append tail, or -1 with errno set if |fd|
+  // is not an initialized secure file.
+  off_t GetLogicalSize(int fd) LOCKS_EXCLUDED(mu_);
 
  private:
   // Structure represents the file header layout.
@@ -109,9 +270,11 @@ class AeadHandler {
     // Hash of the DataDigest.
     FileHash file_hash;
 
-    // Logical file size - is incorporated into DataDigest and is protected by
-    // FileHash.
-    size_t file_size;
+    // Logical file size in the low bits and the block length code in the top
+    // byte, see EncodeSizeAndBlockLength. Files written before block lengths
+    // were configurable have a zero code, which denotes kBlockLength. Is
+    // incorporated into DataDigest and is protected by FileHash.
+    uint64_t size_and_block_code;
 
     // Returns the address of the FileHeader instance.
     uint8_t* data() { return file_hash.data(); }
@@ -123,32 +286,181 @@ class AeadHandler {
     // AD digest of the file data.
     FileDigest file_digest;
 
-    // Logical file size.
-    size_t file_size;
+    // Logical file size and block length code, as in FileHeader.
+    uint64_t size_and_block_code;
 
     // Returns the address of the DataDigest instance.
     uint8_t* data() { return file_digest.data(); }
   } ABSL_ATTRIBUTE_PACKED;
 
+  // Structure represents the header of the integrity index kept alongside a
+  // secure file. The header is followed by the leaf hashes of the AD, in slots
+  // of kChunkLeafCount hashes per chunk, followed by the chunk roots. The index
+  // is not trusted: the chunk roots are validated against the file digest on
+  // load, and the leaf hashes of each chunk against its root when the chunk is
+  // first accessed.
+  struct IndexHeader {
+    // kIntegrityIndexMagic.
+    uint64_t magic;
+
+    // Number of leaves in the AD.
+    uint64_t leaf_count;
+
+    // Number of leaves in each chunk of the AD.
+    uint64_t chunk_leaf_count;
+  } ABSL_ATTRIBUTE_PACKED;
+
+  // Structure represents the record of a key rotation in progress, kept
+  // alongside a secure file until the rotation completes. The record is not
+  // trusted beyond its hash: a block found under the other key than the one
+  // the record implies is still decrypted, and a block under neither fails
+  // to decrypt.
+  struct KeyRotationRecord {
+    // kKeyRotationMagic.
+    uint64_t magic;
+
+    // Number of leading blocks of the file re-encrypted under the new key.
+    uint64_t rotated_blocks;
+
+    // CMAC of a constant under the new key, which identifies the key.
+    FileHash key_check;
+
+    // CMAC of the fields above under the key of the file digest.
+    FileHash record_hash;
+  } ABSL_ATTRIBUTE_PACKED;
+
+  // Consecutive blocks of a file fetched ahead of sequential reads, holding
+  // the plaintext and the auth tag of each block. The auth tags are checked
+  // against the AD when the blocks are read.
+  struct ReadAheadSegment {
+    int64_t first_block;
+    int64_t block_count;
+    std::vector<uint8_t> plaintexts;
+    std::vector<uint8_t> tags;
+  };
+
+  // State of the read-ahead of a file, see EnableReadAhead. Shared with the
+  // helper task fetching a segment, which does not hold the file lock.
+  struct ReadAhead {
+    absl::Mutex mu;
+
+    // Logical offset at which the last read ended, and the number of
+    // consecutive reads that started there.
+    off_t next_offset GUARDED_BY(mu) = 0;
+    int sequential_reads GUARDED_BY(mu) = 0;
+
+    // Segments fetched and not yet read past, in ascending order of blocks.
+    std::deque<std::shared_ptr<ReadAheadSegment>> segments GUARDED_BY(mu);
+
+    // Whether a segment starting at |pending_block| is being fetched, and the
+    // block past the last one fetched or being fetched.
+    bool fetch_pending GUARDED_BY(mu) = false;
+    int64_t pending_block GUARDED_BY(mu) = 0;
+    int64_t fetch_end_block GUARDED_BY(mu) = 0;
+
+    // Incremented whenever the reads stop being sequential, so that a segment
+    // fetched for earlier reads is discarded.
+    int64_t generation GUARDED_BY(mu) = 0;
+
+    bool FetchIdle() EXCLUSIVE_LOCKS_REQUIRED(mu) { return !fetch_pending; }
+  };
+
   // File (data set) control structure for an opened file.
   struct FileControl {
     const std::string path;
     size_t logical_size;
     bool is_new;
     bool is_deserialized;
-    std::unique_ptr<AuthenticatedDictionary> ad;
+    std::unique_ptr<MerkleAuthenticatedDictionary> ad;
+
+    // Chunks of the AD whose leaf hashes changed since the integrity index was
+    // last persisted.
+    std::set<size_t> dirty_index_chunks;
+
+    // Plaintext of recently accessed blocks and of blocks written but not yet
+    // flushed, or nullptr if block caching is disabled.
+    std::unique_ptr<BlockCache> cache;
+
+    // Whether |append_tail| holds the data of the partial last block of the
+    // file, which is then updated by appends without reading it back. Only
+    // the first |append_tail_persisted| bytes of it are written to the file.
+    bool has_append_tail;
+    std::vector<uint8_t> append_tail;
+    size_t append_tail_persisted;
+
+    // Number of AD leaves covered by the file digest last written, and the
+    // number of blocks appended since then.
+    size_t sealed_leaf_count;
+    int64_t unsealed_blocks;
+
+    // Whether the file digest is written on every write even if digest
+    // write-back is enabled.
+    bool digest_write_through;
+
+    // Number of digest updates deferred since the digest was last written, and
+    // the time of the first of them.
+    int64_t deferred_digest_updates;
+    absl::Time first_deferred_digest_update;
+
+    // A descriptor of the file known to be open for writing, through which the
+    // digest is written, or -1 if the file is opened to write the digest.
+    int digest_fd;
+
     std::string zero_hash;
     std::unique_ptr<GcmCryptorKey> master_key;
 
-    // Mutex for protecting FileControl instance.
+    // Whether the file has a key rotation in progress, and the check value of
+    // the new key, see KeyRotationRecord. The new key is null while the
+    // rotation is interrupted, in which case the file cannot be used until the
+    // rotation is resumed. Blocks before |rotated_blocks| are encrypted under
+    // the new key, and the other blocks under |master_key|, which also keys
+    // the file digest until the rotation completes.
+    bool has_key_rotation;
+    FileHash rotation_key_check;
+    std::unique_ptr<GcmCryptorKey> rotation_key;
+    int64_t rotated_blocks;
+
+    // Length of plaintext in each block of the file, and the translator for
+    // the corresponding layout. The translator is owned by AeadHandler.
+    size_t block_length;
+    const OffsetTranslator* offset_translator;
+
+    // Whether blocks of the file are stored in plaintext and only
+    // authenticated, see GcmCryptor. Fixed when the file is created.
+    const bool integrity_only;
+
+    // Descriptors open on the file, mapped to whether they were opened with
+    // O_APPEND. An operation that looked the file up by a descriptor checks
+    // that it is still open once it holds |mu|.
+    std::unordered_map<int, bool> fds;
+
+    // Blocks fetched ahead of sequential reads of the file.
+    const std::shared_ptr<ReadAhead> read_ahead;
+
+    // Mutex for protecting FileControl instance. Held shared by reads that
+    // do not modify the FileControl, and exclusively otherwise.
     absl::Mutex mu;
 
-    FileControl(const char* path_name, bool is_new_file)
+    FileControl(const char* path_name, bool is_new_file, size_t block_len,
+                bool integrity_only_mode, const OffsetTranslator* translator)
         : path(path_name),
           logical_size(0),
           is_new(is_new_file),
           is_deserialized(false),
-          ad(absl::make_unique<CTMMTAuthenticatedDictionary>()) {
+          ad(absl::make_unique<MerkleAuthenticatedDictionary>()),
+          has_append_tail(false),
+          append_tail_persisted(0),
+          sealed_leaf_count(0),
+          unsealed_blocks(0),
+          digest_write_through(false),
+          deferred_digest_updates(0),
+          digest_fd(-1),
+          has_key_rotation(false),
+          rotated_blocks(0),
+          block_length(block_len),
+          offset_translator(translator),
+          integrity_only(integrity_only_mode),
+          read_ahead(std::make_shared<ReadAhead>()) {
       UnsafeBytes<kTagLength> tag;
       memset(tag.data(), 0, kTagLength);
       std::string tag_string(reinterpret_cast<char*>(tag.data()), kTagLength);
@@ -159,10 +471,32 @@ class AeadHandler {
     // metadata is placed after the block data, hence, only full blocks are
     // written - there are no partial blocks.
     size_t physical_size() {
-      return sizeof(FileHeader) + ad->LeafCount() * kSecureBlockLength;
+      return sizeof(FileHeader) + ad->LeafCount() * secure_block_length();
+    }
+
+    // Logical size of the data written to the file, which excludes appended
+    // data held back in |append_tail|.
+    size_t persisted_size() const {
+      return logical_size - (append_tail.size() - append_tail_persisted);
+    }
+
+    // Length of a block's ciphertext followed by its integrity tag.
+    size_t cipher_block_length() const { return block_length + kTagLength; }
+
+    // Length of a full block including all of its metadata.
+    size_t secure_block_length() const {
+      return cipher_block_length() + kTokenLength;
     }
   };
 
+  // Offset translator for files with |kLength| byte blocks. The supported
+  // block lengths are known at compile time, so translation of their offsets
+  // is specialized for them.
+  template <size_t kLength>
+  using BlockOffsetTranslator =
+      FixedOffsetTranslator<sizeof(FileHeader), kLength,
+                            kLength + kTagLength + kTokenLength>;
+
   AeadHandler();
   AeadHandler(AeadHandler const&) = delete;
   void operator=(AeadHandler const&) = delete;
@@ -170,41 +504,290 @@ class AeadHandler {
   // Loads and validates integrity metadata, returns false on failure.
   bool Deserialize(FileControl* file_ctrl);
 
+  // Returns true if the root of the AD of |file_ctrl| together with the size
+  // and block length recorded in |file_header| match the file hash.
+  bool ValidateDigest(FileControl* file_ctrl, const FileHeader& file_header,
+                      const GcmCryptor& cryptor) const;
+
+  // Resets the AD of |file_ctrl| to |leaf_count| leaves with the chunk roots
+  // recorded in the integrity index, without loading any chunks. Returns false
+  // if the index is missing or does not describe |leaf_count| leaves.
+  bool LoadIntegrityIndex(FileControl* file_ctrl, size_t leaf_count) const;
+
+  // Rebuilds the AD of |file_ctrl| from the auth tags of all |blocks_count|
+  // blocks of the file opened on |fd|, without moving its cursor. The tags are
+  // read in large batches, and whole chunks of the AD are hashed on the crypto
+  // workers if parallel crypto is enabled. Returns false on failure.
+  bool CollectAuthTags(int fd, FileControl* file_ctrl,
+                       int64_t blocks_count) const;
+
+  // Returns true if the leaf hashes of the chunks of the AD covering blocks
+  // [|first_block|, |last_block|] are loaded.
+  bool AreIntegrityChunksLoaded(const FileControl& file_ctrl,
+                                int64_t first_block, int64_t last_block) const;
+
+  // Loads the leaf hashes of the chunks of the AD covering blocks
+  // [|first_block|, |last_block|] from the integrity index, if not loaded yet.
+  // Returns false on failure.
+  bool LoadIntegrityChunks(FileControl* file_ctrl, int64_t first_block,
+                           int64_t last_block) const;
+
+  // Writes the dirty chunks and the chunk roots of the AD of |file_ctrl| to the
+  // integrity index. Returns false on failure.
+  bool PersistIntegrityIndex(FileControl* file_ctrl) const;
+
+  // Reads the block length and mode recorded in the header of the existing
+  // file at |path|. The values are not authenticated until the file is
+  // deserialized. Returns false on failure.
+  bool ReadBlockLength(const std::string& path, size_t* block_length,
+                       bool* integrity_only) const;
+
+  // Returns the offset translator for files with |block_length|, or nullptr if
+  // the block length is not supported.
+  const OffsetTranslator* GetOffsetTranslatorForBlockLength(
+      size_t block_length) const;
+
   // Retrieves logical cursor offset associated with a file descriptor |fd|.
   // Returns false on failure.
-  bool RetrieveLogicalOffset(int fd, off_t* logical_offset) const;
+  bool RetrieveLogicalOffset(int fd, const FileControl& file_ctrl,
+                             off_t* logical_offset) const;
 
-  // Updates digest of the file data in the secure file header.
-  bool UpdateDigest(FileControl* file_ctrl, const GcmCryptor& cryptor) const;
+  // Moves the cursor of |fd| to the physical position of |logical_offset|.
+  // Returns false on failure.
+  bool SetLogicalOffset(int fd, const FileControl& file_ctrl,
+                        off_t logical_offset) const;
+
+  // Runs |body| on consecutive ranges [begin, end) of block indices covering
+  // [0, |block_count|) of a request on blocks of |block_length| bytes. The
+  // ranges are processed in parallel if the request is large enough and
+  // parallel crypto is enabled, and |body| must then only touch state of the
+  // blocks in its range. Returns false if any invocation of |body| returned
+  // false.
+  bool ForEachBlockRange(
+      int64_t block_count, size_t block_length,
+      const std::function<bool(int64_t, int64_t)>& body) const;
+
+  // Encrypts |block_count| full blocks starting at |first_block|, whose
+  // plaintexts are returned by |plaintext_block| called with indices relative
+  // to |first_block|, writes them to the file opened on |fd| without moving its
+  // cursor, and records their auth tags in the AD. Blocks between the end of
+  // the file and |first_block| are recorded as a sparse region. Returns false
+  // on failure.
+  bool WriteBlocks(int fd, FileControl* file_ctrl, GcmCryptor* cryptor,
+                   int64_t first_block, int64_t block_count,
+                   const std::function<const uint8_t*(int64_t)>&
+                       plaintext_block) const;
+
+  // Reads the plaintext of blocks [|first_block|, |end_block|) of the file
+  // opened on |fd| into |blocks|. Blocks past the end of the file data read as
+  // zeros. Does not move the cursor of |fd|. Returns false on failure.
+  bool ReadBlocksFromFile(int fd, FileControl* file_ctrl, int64_t first_block,
+                          int64_t end_block, uint8_t* blocks) const;
+
+  // Adds |block_index| to the block cache of |file_ctrl|, writing back the
+  // dirty blocks first if no block can be evicted. Returns the plaintext of
+  // the zero-filled block, or nullptr on failure.
+  uint8_t* InsertCachedBlock(FileControl* file_ctrl, int64_t block_index) const;
+
+  // Writes back the dirty blocks in the block cache of |file_ctrl| and updates
+  // the file digest. Returns false on failure.
+  bool FlushCache(FileControl* file_ctrl) const;
+
+  // Read and write the file at |logical_offset| with the file lock held
+  // exclusively, without moving the cursor of |fd|. Implement the cursor-based
+  // and positional public operations.
+  ssize_t ReadLocked(int fd, void* buf, size_t count, FileControl* file_ctrl,
+                     off_t logical_offset) const;
+  ssize_t WriteLocked(int fd, const void* buf, size_t count,
+                      FileControl* file_ctrl, off_t logical_offset) const;
+
+  // Appends to the end of the file with the file lock held exclusively. Full
+  // blocks are written at once, while the partial last block is held back in
+  // the enclave, and the digest is only updated every kAppendSealBlockCount
+  // blocks. Does not move the cursor of |fd|.
+  ssize_t AppendLocked(int fd, const void* buf, size_t count,
+                       FileControl* file_ctrl) const;
+
+  // Writes the partial last block held back by appends, if any, and updates
+  // the file digest if appended blocks are not covered by it yet. Returns
+  // false on failure.
+  bool FlushAppends(FileControl* file_ctrl) const;
+
+  // Implementations of ReadLocked and WriteLocked for files with a block
+  // cache, which serve blocks from and buffer blocks in the cache.
+  ssize_t ReadCached(int fd, void* buf, size_t count, FileControl* file_ctrl,
+                     off_t logical_offset) const;
+  ssize_t WriteCached(int fd, const void* buf, size_t count,
+                      FileControl* file_ctrl, off_t logical_offset) const;
+
+  // Updates digest of the file data in the secure file header. Appended data
+  // held back in the enclave is not covered by the digest.
+  bool UpdateDigest(FileControl* file_ctrl) const;
+
+  // Records a change of the file digest made by a write through |fd|, and
+  // updates the digest unless the update can be deferred, see
+  // EnableDigestWriteBack. Returns false on failure.
+  bool DeferDigestUpdate(int fd, FileControl* file_ctrl) const;
+
+  // Updates the file digest if an update of it was deferred. Returns false on
+  // failure.
+  bool FlushDigest(FileControl* file_ctrl) const;
 
   // Returns an instance of GcmCryptor associated with a file, or nullptr if was
-  // not able to retrieve. The caller does not own the instance.
+  // not able to retrieve. Blocks are encrypted with it, which during a key
+  // rotation keys the blocks before the rotation point. The caller does not
+  // own the instance.
   GcmCryptor* GetGcmCryptor(const FileControl& file_ctrl) const;
 
+  // Returns the instance of GcmCryptor for the master key of a file, which
+  // keys the file digest and, during a key rotation, the blocks past the
+  // rotation point. Returns nullptr if was not able to retrieve.
+  GcmCryptor* GetDigestCryptor(const FileControl& file_ctrl) const;
+
+  // Decrypts |count| blocks of a file with |cryptor|, as
+  // GcmCryptor::DecryptBlocks does. During a key rotation, each block is
+  // decrypted with the key of its side of the rotation point, or else with
+  // the other key. |block_indices| are the indices of the blocks in the file.
+  bool DecryptFileBlocks(const FileControl& file_ctrl, GcmCryptor* cryptor,
+                         size_t count, const int64_t* block_indices,
+                         const uint8_t* const ciphertexts[],
+                         const uint8_t* const tokens[],
+                         uint8_t* const plaintexts[]) const;
+
+  // Loads the record of a key rotation of the file, if there is a valid one.
+  // A record that does not validate under the master key, such as one left
+  // behind by a completed rotation, is ignored.
+  void LoadKeyRotationRecord(FileControl* file_ctrl) const;
+
+  // Writes the record of the key rotation of the file. Returns false on
+  // failure.
+  bool PersistKeyRotationRecord(const FileControl& file_ctrl) const;
+
+  // Switches the file to the key of its rotation once all blocks are
+  // re-encrypted, and removes the rotation record. Returns false on failure.
+  bool CompleteKeyRotation(FileControl* file_ctrl) const;
+
   // Similar to DecryptAndVerify, but is called by internal implementation, and
-  // as such does not take a file lock. The cursor associated with the file
-  // descriptor |fd| is expected to be at the position of |logical_offset|.
+  // as such does not take a file lock. Reads at |logical_offset| without moving
+  // the cursor of |fd|. Does not modify |file_ctrl|, so may be called with the
+  // file lock held shared, provided the integrity metadata of the range is
+  // loaded.
   ssize_t DecryptAndVerifyInternal(int fd, void* buf, size_t count,
                                    const FileControl& file_ctrl,
                                    off_t logical_offset) const;
 
-  // Reads a single full block of a file at a specified logical offset. Returns
-  // false on failure.
+  // Reads as DecryptAndVerifyInternal does, serving the range from blocks
+  // fetched ahead if they cover it and match the AD, and schedules the fetch
+  // of further blocks once the file is read sequentially.
+  ssize_t ReadSequential(int fd, void* buf, size_t count,
+                         const FileControl& file_ctrl,
+                         off_t logical_offset) const;
+
+  // Copies the |count| bytes at |logical_offset| into |buf| from the segments
+  // of |read_ahead|. Returns false if a block of the range is not fetched or
+  // its auth tag does not match the AD, such as when the block was written
+  // since it was fetched.
+  bool CopyReadAhead(const FileControl& file_ctrl, ReadAhead* read_ahead,
+                     void* buf, size_t count, off_t logical_offset) const
+      EXCLUSIVE_LOCKS_REQUIRED(read_ahead->mu);
+
+  // Starts fetching the next segment of the file through |fd| if no fetch is
+  // in progress and the blocks fetched extend less than the read-ahead window
+  // past |read_end|.
+  void ScheduleReadAhead(int fd, const FileControl& file_ctrl,
+                         ReadAhead* read_ahead, off_t read_end) const
+      EXCLUSIVE_LOCKS_REQUIRED(read_ahead->mu);
+
+  // Reads |block_count| blocks of |block_length| bytes starting with
+  // |first_block| at |physical_offset| of |fd|, decrypts them with |cryptor|
+  // and adds them to |read_ahead| unless its |generation| changed. Runs on
+  // the read-ahead worker.
+  static void FetchReadAheadSegment(std::shared_ptr<ReadAhead> read_ahead,
+                                    int64_t generation, int fd,
+                                    GcmCryptor* cryptor, size_t block_length,
+                                    off_t physical_offset, int64_t first_block,
+                                    int64_t block_count);
+
+  // Reads a single full block of a file at a specified logical offset into
+  // |block|, which must hold the file's block length. Returns false on
+  // failure.
   bool ReadFullBlock(const FileControl& file_ctrl, off_t logical_offset,
-                     Block* block) const;
+                     uint8_t* block) const;
+
+  // Reads the full blocks of a file at the block-aligned, ascending
+  // |logical_offsets| into consecutive blocks of |blocks|, opening the file
+  // once and reading each run of adjacent blocks with a single host read.
+  // Blocks past the end of the file data read as zeros. Returns false on
+  // failure.
+  bool ReadFullBlocks(const FileControl& file_ctrl,
+                      const std::vector<off_t>& logical_offsets,
+                      uint8_t* blocks) const;
+
+  // Number of shards of the map of open descriptors.
+  static constexpr size_t kFileShardCount = 16;
+
+  // A shard of the map of file (data set) controls for opened files keyed on
+  // int identity of files, holding the descriptors equal modulo
+  // kFileShardCount. Lookups hold the lock of their shard shared and only
+  // while copying the entry, so operations on different files do not
+  // serialize, and none waits for the file lock of another file.
+  struct FileShard {
+    absl::Mutex mu;
+    std::unordered_map<int, std::shared_ptr<FileControl>> files GUARDED_BY(mu);
+  };
 
-  // Map of file (data set) controls for opened files keyed on int identity of
-  // files.
-  std::unordered_map<int, std::shared_ptr<FileControl>> fmap_ GUARDED_BY(mu_);
+  // Returns the shard holding |fd|.
+  FileShard& GetFileShard(int fd) {
+    return file_shards_[static_cast<unsigned>(fd) % kFileShardCount];
+  }
 
-  // Map of file (data set) controls for opened files keyed on string paths of
-  // files.
-  std::unordered_map<std::string, std::shared_ptr<FileControl>> opened_files_;
+  // Looks up the file opened on |fd| and acquires its lock with a LockT, an
+  // absl::MutexLock or absl::ReaderMutexLock, held by |file_lock|. |file_ref|
+  // keeps the FileControl alive while the lock is held, and must outlive
+  // |file_lock|. Returns nullptr if no file is open on |fd|, including when it
+  // is closed while waiting for the lock.
+  template <typename LockT>
+  FileControl* AcquireFile(int fd, std::shared_ptr<FileControl>* file_ref,
+                           std::unique_ptr<LockT>* file_lock);
 
-  // An instance that performs operations on untrusted file offset.
-  std::unique_ptr<OffsetTranslator> offset_translator_;
+  std::array<FileShard, kFileShardCount> file_shards_;
 
-  // Mutex for protecting map members of the class.
+  // Map of file (data set) controls for opened files keyed on string paths of
+  // files.
+  std::unordered_map<std::string, std::shared_ptr<FileControl>> opened_files_
+      GUARDED_BY(mu_);
+
+  // Instances that perform operations on untrusted file offsets, keyed on the
+  // supported block lengths. Populated at construction and not modified
+  // afterwards.
+  std::unordered_map<size_t, std::unique_ptr<OffsetTranslator>>
+      offset_translators_;
+
+  // Executor running per-block crypto of large requests, or nullptr if
+  // parallel crypto is not enabled. Set at most once, during enclave
+  // initialization, and only read afterwards.
+  std::unique_ptr<WorkStealingExecutor> crypto_executor_;
+
+  // Worker fetching blocks ahead of sequential reads, and the number of bytes
+  // of blocks fetched ahead of the reads of each file, or nullptr and zero if
+  // read-ahead is not enabled. Set at most once, during enclave
+  // initialization, and only read afterwards.
+  std::unique_ptr<WorkStealingExecutor> read_ahead_executor_;
+  size_t read_ahead_bytes_;
+
+  // Capacity of the block cache of each open file in bytes, or zero if block
+  // caching is disabled. Set at most once, during enclave initialization, and
+  // only read afterwards.
+  size_t block_cache_bytes_;
+
+  // Number of writes and time after which a deferred digest update is written,
+  // or zero writes if digest updates are not deferred. Set at most once,
+  // during enclave initialization, and only read afterwards.
+  int64_t digest_write_back_updates_;
+  absl::Duration digest_write_back_delay_;
+
+  // Mutex serializing the opening and closing of files, and protecting
+  // |opened_files_|. Not taken by operations on open files.
   absl::Mutex mu_;
 };
 
@@ -0,0 +1,94 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/storage/secure/block_cache.h"
+
+#include <algorithm>
+#include <iterator>
+
+namespace asylo {
+namespace platform {
+namespace storage {
+
+BlockCache::BlockCache(size_t block_length, size_t capacity)
+    : block_length_(block_length), capacity_(capacity), dirty_count_(0) {}
+
+uint8_t* BlockCache::Find(int64_t block_index) {
+  auto it = index_.find(block_index);
+  if (it == index_.end()) {
+    return nullptr;
+  }
+  entries_.splice(entries_.begin(), entries_, it->second);
+  return it->second->data.data();
+}
+
+uint8_t* BlockCache::Insert(int64_t block_index) {
+  if (capacity_ == 0) {
+    return nullptr;
+  }
+
+  if (entries_.size() >= capacity_) {
+    Entry& victim = entries_.back();
+    if (victim.is_dirty) {
+      return nullptr;
+    }
+
+    // Reuse the buffer of the evicted block.
+    index_.erase(victim.block_index);
+    victim.block_index = block_index;
+    std::fill(victim.data.begin(), victim.data.end(), 0);
+    entries_.splice(entries_.begin(), entries_, std::prev(entries_.end()));
+  } else {
+    entries_.push_front(
+        Entry{block_index, false, std::vector<uint8_t>(block_length_)});
+  }
+
+  index_[block_index] = entries_.begin();
+  return entries_.front().data.data();
+}
+
+void BlockCache::MarkDirty(int64_t block_index) {
+  auto it = index_.find(block_index);
+  if (it != index_.end() && !it->second->is_dirty) {
+    it->second->is_dirty = true;
+    dirty_count_++;
+  }
+}
+
+std::vector<int64_t> BlockCache::DirtyBlocks() const {
+  std::vector<int64_t> dirty_blocks;
+  dirty_blocks.reserve(dirty_count_);
+  for (const Entry& entry : entries_) {
+    if (entry.is_dirty) {
+      dirty_blocks.push_back(entry.block_index);
+    }
+  }
+  std::sort(dirty_blocks.begin(), dirty_blocks.end());
+  return dirty_blocks;
+}
+
+void BlockCache::MarkAllClean() {
+  for (Entry& entry : entries_) {
+    entry.is_dirty = false;
+  }
+  dirty_count_ = 0;
+}
+
+}  // namespace storage
+}  // namespace platform
+}  // namespace asylo
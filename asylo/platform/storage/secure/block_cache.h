@@ -0,0 +1,97 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_PLATFORM_STORAGE_SECURE_BLOCK_CACHE_H_
+#define ASYLO_PLATFORM_STORAGE_SECURE_BLOCK_CACHE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <unordered_map>
+#include <vector>
+
+namespace asylo {
+namespace platform {
+namespace storage {
+
+// Bounded least recently used cache of the plaintext of file blocks, keyed on
+// the index of each block in its file. Blocks may be marked dirty to buffer
+// writes; dirty blocks are never evicted, so the owner is expected to write
+// them back and mark them clean when the cache runs out of space.
+//
+// The class is not thread-safe.
+class BlockCache {
+ public:
+  // Creates a cache holding up to |capacity| blocks of |block_length| bytes.
+  BlockCache(size_t block_length, size_t capacity);
+
+  BlockCache(const BlockCache&) = delete;
+  BlockCache& operator=(const BlockCache&) = delete;
+
+  size_t block_length() const { return block_length_; }
+  size_t capacity() const { return capacity_; }
+  size_t size() const { return entries_.size(); }
+  size_t dirty_count() const { return dirty_count_; }
+
+  // Returns true if |block_index| is cached.
+  bool Contains(int64_t block_index) const {
+    return index_.find(block_index) != index_.end();
+  }
+
+  // Returns the cached plaintext of |block_index|, making it the most
+  // recently used block, or nullptr if the block is not cached.
+  uint8_t* Find(int64_t block_index);
+
+  // Adds |block_index| to the cache as a clean, zero-filled block and returns
+  // its plaintext, evicting the least recently used block if the cache is
+  // full. Returns nullptr if the cache is full and its least recently used
+  // block is dirty. The block must not be cached already.
+  uint8_t* Insert(int64_t block_index);
+
+  // Marks the cached |block_index| dirty.
+  void MarkDirty(int64_t block_index);
+
+  // Returns the indices of the dirty blocks in ascending order.
+  std::vector<int64_t> DirtyBlocks() const;
+
+  // Marks all blocks clean.
+  void MarkAllClean();
+
+ private:
+  struct Entry {
+    int64_t block_index;
+    bool is_dirty;
+    std::vector<uint8_t> data;
+  };
+
+  const size_t block_length_;
+  const size_t capacity_;
+
+  // Cached blocks, most recently used first, and their positions keyed on
+  // block index.
+  std::list<Entry> entries_;
+  std::unordered_map<int64_t, std::list<Entry>::iterator> index_;
+
+  size_t dirty_count_;
+};
+
+}  // namespace storage
+}  // namespace platform
+}  // namespace asylo
+
+#endif  // ASYLO_PLATFORM_STORAGE_SECURE_BLOCK_CACHE_H_
@@ -0,0 +1,247 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+// Tests of secure storage reads and writes through the block cache.
+
+#include <fcntl.h>
+#include <openssl/rand.h>
+
+#include <vector>
+
+#include <gtest/gtest.h>
+#include "absl/strings/str_cat.h"
+#include "asylo/platform/arch/include/trusted/host_calls.h"
+#include "asylo/platform/storage/secure/aead_handler.h"
+#include "asylo/platform/storage/secure/enclave_storage_secure.h"
+#include "asylo/test/util/test_flags.h"
+#include "asylo/util/cleansing_types.h"
+
+namespace asylo {
+namespace {
+
+using platform::crypto::gcmlib::kKeyLength;
+using platform::storage::AeadHandler;
+using platform::storage::kBlockLength;
+using platform::storage::kBlockLength4KiB;
+using platform::storage::kFileHashLength;
+using platform::storage::kTagLength;
+using platform::storage::kTokenLength;
+using platform::storage::secure_close;
+using platform::storage::secure_fsync;
+using platform::storage::secure_lseek;
+using platform::storage::secure_open;
+using platform::storage::secure_read;
+using platform::storage::secure_write;
+
+// Holds 128 blocks of kBlockLength, or 4 blocks of kBlockLength4KiB.
+constexpr size_t kCacheBytes = 16 * 1024;
+
+constexpr off_t kFileHeaderLength = kFileHashLength + sizeof(uint64_t);
+
+class BlockCacheStorageTest : public ::testing::TestWithParam<size_t> {
+ protected:
+  static void SetUpTestCase() {
+    ASSERT_EQ(AeadHandler::GetInstance().EnableBlockCache(kCacheBytes), 0);
+  }
+
+  void SetUp() override {
+    path_ = absl::StrCat(FLAGS_test_tmpdir, "/BlockCacheStorageTest.txt");
+    remove(path_.c_str());
+
+    key_.resize(kKeyLength);
+    ASSERT_EQ(RAND_bytes(key_.data(), key_.size()), 1);
+  }
+
+  // Returns |length| random bytes.
+  std::vector<uint8_t> RandomData(size_t length) {
+    std::vector<uint8_t> data(length);
+    EXPECT_EQ(RAND_bytes(data.data(), data.size()), 1);
+    return data;
+  }
+
+  // Opens the test file for reading and writing and sets its key, selecting
+  // the block length under test if the file is new. Returns the file
+  // descriptor, or -1 on failure.
+  int OpenWithKey() {
+    bool is_new = access(path_.c_str(), F_OK) != 0;
+    int fd = secure_open(path_.c_str(), O_RDWR | O_CREAT,
+                         S_IRWXU | S_IRWXG | S_IRWXO);
+    if (fd < 0) {
+      return -1;
+    }
+    if ((is_new &&
+         AeadHandler::GetInstance().SetBlockLength(fd, GetParam()) != 0) ||
+        AeadHandler::GetInstance().SetMasterKey(fd, key_.data(),
+                                                key_.size()) != 0) {
+      secure_close(fd);
+      return -1;
+    }
+    return fd;
+  }
+
+  // Returns the size of the test file on the host.
+  off_t PhysicalSize() {
+    int fd = enc_untrusted_open(path_.c_str(), O_RDONLY);
+    off_t size = enc_untrusted_lseek(fd, 0, SEEK_END);
+    enc_untrusted_close(fd);
+    return size;
+  }
+
+  // Reads |length| bytes at |offset| from |fd|.
+  std::vector<uint8_t> ReadAt(int fd, off_t offset, size_t length) {
+    std::vector<uint8_t> data(length);
+    EXPECT_EQ(secure_lseek(fd, offset, SEEK_SET), offset);
+    EXPECT_EQ(secure_read(fd, data.data(), data.size()), data.size());
+    return data;
+  }
+
+  std::string path_;
+  CleansingVector<uint8_t> key_;
+};
+
+INSTANTIATE_TEST_CASE_P(BlockLengths, BlockCacheStorageTest,
+                        ::testing::Values(kBlockLength, kBlockLength4KiB));
+
+TEST_P(BlockCacheStorageTest, EnableTwiceFails) {
+  EXPECT_EQ(AeadHandler::GetInstance().EnableBlockCache(kCacheBytes), -1);
+  EXPECT_EQ(errno, EINVAL);
+}
+
+TEST_P(BlockCacheStorageTest, WritesAreBufferedUntilFsync) {
+  int fd = OpenWithKey();
+  ASSERT_GE(fd, 0);
+  const std::vector<uint8_t> data = RandomData(3 * GetParam());
+  EXPECT_EQ(secure_write(fd, data.data(), data.size()), data.size());
+  EXPECT_EQ(PhysicalSize(), kFileHeaderLength);
+
+  // Seeking to the end sees the buffered blocks, and writes them back.
+  EXPECT_EQ(secure_lseek(fd, 0, SEEK_END), data.size());
+  const off_t physical_size =
+      kFileHeaderLength + 3 * (GetParam() + kTagLength + kTokenLength);
+  EXPECT_EQ(PhysicalSize(), physical_size);
+
+  // Overwrites are buffered too.
+  const std::vector<uint8_t> update = RandomData(GetParam() / 2);
+  EXPECT_EQ(secure_lseek(fd, 100, SEEK_SET), 100);
+  EXPECT_EQ(secure_write(fd, update.data(), update.size()), update.size());
+  EXPECT_EQ(ReadAt(fd, 100, update.size()), update);
+  EXPECT_EQ(secure_fsync(fd), 0);
+  EXPECT_EQ(secure_close(fd), 0);
+
+  std::vector<uint8_t> expected = data;
+  std::copy(update.begin(), update.end(), expected.begin() + 100);
+  fd = OpenWithKey();
+  ASSERT_GE(fd, 0);
+  EXPECT_EQ(ReadAt(fd, 0, expected.size()), expected);
+  EXPECT_EQ(secure_close(fd), 0);
+  EXPECT_EQ(PhysicalSize(), physical_size);
+}
+
+TEST_P(BlockCacheStorageTest, LargeMisalignedReadWriteSuccess) {
+  // Larger than the cache, so blocks are written back and evicted while the
+  // data is written and read.
+  constexpr off_t kOffset = 1000;
+  const std::vector<uint8_t> data = RandomData(3 * kCacheBytes + 100);
+  int fd = OpenWithKey();
+  ASSERT_GE(fd, 0);
+  EXPECT_EQ(secure_lseek(fd, kOffset, SEEK_SET), kOffset);
+  EXPECT_EQ(secure_write(fd, data.data(), data.size()), data.size());
+  EXPECT_EQ(ReadAt(fd, kOffset, data.size()), data);
+  EXPECT_EQ(ReadAt(fd, 0, kOffset), std::vector<uint8_t>(kOffset, 0));
+  EXPECT_EQ(secure_close(fd), 0);
+
+  fd = OpenWithKey();
+  ASSERT_GE(fd, 0);
+  EXPECT_EQ(ReadAt(fd, kOffset, data.size()), data);
+
+  // Reading a range again is served from the cache.
+  const off_t middle = kOffset + data.size() / 2;
+  EXPECT_EQ(ReadAt(fd, middle, 100),
+            std::vector<uint8_t>(data.begin() + data.size() / 2,
+                                 data.begin() + data.size() / 2 + 100));
+  EXPECT_EQ(secure_close(fd), 0);
+}
+
+TEST_P(BlockCacheStorageTest, SparseWriteSuccess) {
+  // Leave a gap of several blocks between two buffered writes.
+  const std::vector<uint8_t> data = RandomData(100);
+  const off_t gap_end = 5 * GetParam() + 10;
+  int fd = OpenWithKey();
+  ASSERT_GE(fd, 0);
+  EXPECT_EQ(secure_write(fd, data.data(), data.size()), data.size());
+  EXPECT_EQ(secure_lseek(fd, gap_end, SEEK_SET), gap_end);
+  EXPECT_EQ(secure_write(fd, data.data(), data.size()), data.size());
+  EXPECT_EQ(ReadAt(fd, data.size(), gap_end - data.size()),
+            std::vector<uint8_t>(gap_end - data.size(), 0));
+  EXPECT_EQ(secure_close(fd), 0);
+
+  fd = OpenWithKey();
+  ASSERT_GE(fd, 0);
+  EXPECT_EQ(ReadAt(fd, 0, data.size()), data);
+  EXPECT_EQ(ReadAt(fd, data.size(), gap_end - data.size()),
+            std::vector<uint8_t>(gap_end - data.size(), 0));
+  EXPECT_EQ(ReadAt(fd, gap_end, data.size()), data);
+  EXPECT_EQ(secure_close(fd), 0);
+}
+
+TEST_P(BlockCacheStorageTest, CacheIsSharedAcrossDescriptors) {
+  int writer_fd = OpenWithKey();
+  ASSERT_GE(writer_fd, 0);
+  int reader_fd = OpenWithKey();
+  ASSERT_GE(reader_fd, 0);
+
+  const std::vector<uint8_t> data = RandomData(GetParam() + 10);
+  EXPECT_EQ(secure_write(writer_fd, data.data(), data.size()), data.size());
+  EXPECT_EQ(ReadAt(reader_fd, 0, data.size()), data);
+
+  // Closing one descriptor writes the blocks back, and the other one keeps
+  // using the cache.
+  EXPECT_EQ(secure_close(writer_fd), 0);
+  EXPECT_GT(PhysicalSize(), kFileHeaderLength);
+  EXPECT_EQ(ReadAt(reader_fd, 0, data.size()), data);
+  EXPECT_EQ(secure_close(reader_fd), 0);
+}
+
+TEST_P(BlockCacheStorageTest, ModifiedBlockFails) {
+  const std::vector<uint8_t> data = RandomData(4 * GetParam());
+  int fd = OpenWithKey();
+  ASSERT_GE(fd, 0);
+  EXPECT_EQ(secure_write(fd, data.data(), data.size()), data.size());
+  EXPECT_EQ(secure_close(fd), 0);
+
+  // Corrupt the ciphertext of the second block.
+  fd = enc_untrusted_open(path_.c_str(), O_RDWR);
+  ASSERT_GE(fd, 0);
+  const off_t block_offset =
+      kFileHeaderLength + GetParam() + kTagLength + kTokenLength;
+  ASSERT_EQ(enc_untrusted_lseek(fd, block_offset, SEEK_SET), block_offset);
+  EXPECT_EQ(enc_untrusted_write(fd, "xx", 2), 2);
+  enc_untrusted_close(fd);
+
+  fd = OpenWithKey();
+  ASSERT_GE(fd, 0);
+  std::vector<uint8_t> read_buffer(data.size());
+  EXPECT_EQ(ReadAt(fd, 0, GetParam()),
+            std::vector<uint8_t>(data.begin(), data.begin() + GetParam()));
+  EXPECT_EQ(secure_lseek(fd, 0, SEEK_SET), 0);
+  EXPECT_EQ(secure_read(fd, read_buffer.data(), read_buffer.size()), -1);
+  EXPECT_EQ(secure_close(fd), 0);
+}
+
+}  // namespace
+}  // namespace asylo
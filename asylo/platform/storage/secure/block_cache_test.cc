@@ -0,0 +1,92 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/storage/secure/block_cache.h"
+
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace asylo {
+namespace platform {
+namespace storage {
+namespace {
+
+constexpr size_t kBlockLength = 16;
+
+TEST(BlockCacheTest, InsertedBlocksAreZeroFilled) {
+  BlockCache cache(kBlockLength, 2);
+  EXPECT_EQ(cache.Find(1), nullptr);
+  EXPECT_FALSE(cache.Contains(1));
+
+  uint8_t* block = cache.Insert(1);
+  ASSERT_NE(block, nullptr);
+  EXPECT_EQ(std::vector<uint8_t>(block, block + kBlockLength),
+            std::vector<uint8_t>(kBlockLength, 0));
+  block[0] = 1;
+  EXPECT_EQ(cache.Find(1), block);
+  EXPECT_TRUE(cache.Contains(1));
+  EXPECT_EQ(cache.size(), 1);
+}
+
+TEST(BlockCacheTest, EvictsLeastRecentlyUsedBlock) {
+  BlockCache cache(kBlockLength, 2);
+  ASSERT_NE(cache.Insert(1), nullptr);
+  ASSERT_NE(cache.Insert(2), nullptr);
+  ASSERT_NE(cache.Find(1), nullptr);
+
+  // The buffer of an evicted block is cleared before it is reused.
+  cache.Find(1)[0] = 1;
+  cache.Find(2)[0] = 2;
+  uint8_t* block = cache.Insert(3);
+  ASSERT_NE(block, nullptr);
+  EXPECT_EQ(block[0], 0);
+  EXPECT_TRUE(cache.Contains(2));
+  EXPECT_TRUE(cache.Contains(3));
+  EXPECT_FALSE(cache.Contains(1));
+  EXPECT_EQ(cache.size(), 2);
+}
+
+TEST(BlockCacheTest, DirtyBlocksAreNotEvicted) {
+  BlockCache cache(kBlockLength, 2);
+  ASSERT_NE(cache.Insert(5), nullptr);
+  ASSERT_NE(cache.Insert(3), nullptr);
+  cache.MarkDirty(5);
+  cache.MarkDirty(3);
+  cache.MarkDirty(3);
+  EXPECT_EQ(cache.dirty_count(), 2);
+  EXPECT_EQ(cache.DirtyBlocks(), std::vector<int64_t>({3, 5}));
+  EXPECT_EQ(cache.Insert(7), nullptr);
+
+  cache.MarkAllClean();
+  EXPECT_EQ(cache.dirty_count(), 0);
+  EXPECT_TRUE(cache.DirtyBlocks().empty());
+  EXPECT_NE(cache.Insert(7), nullptr);
+  EXPECT_FALSE(cache.Contains(5));
+}
+
+TEST(BlockCacheTest, ZeroCapacityCachesNothing) {
+  BlockCache cache(kBlockLength, 0);
+  EXPECT_EQ(cache.Insert(1), nullptr);
+  EXPECT_EQ(cache.size(), 0);
+}
+
+}  // namespace
+}  // namespace storage
+}  // namespace platform
+}  // namespace asylo
@@ -0,0 +1,221 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+// Tests of secure storage with deferred updates of the file digest.
+
+#include <fcntl.h>
+#include <openssl/rand.h>
+
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include "absl/strings/str_cat.h"
+#include "absl/time/time.h"
+#include "asylo/platform/arch/include/trusted/host_calls.h"
+#include "asylo/platform/storage/secure/aead_handler.h"
+#include "asylo/platform/storage/secure/enclave_storage_secure.h"
+#include "asylo/test/util/test_flags.h"
+#include "asylo/util/cleansing_types.h"
+
+namespace asylo {
+namespace {
+
+using platform::crypto::gcmlib::kKeyLength;
+using platform::storage::AeadHandler;
+using platform::storage::kBlockLength;
+using platform::storage::kFileHashLength;
+using platform::storage::secure_close;
+using platform::storage::secure_fsync;
+using platform::storage::secure_lseek;
+using platform::storage::secure_open;
+using platform::storage::secure_read;
+using platform::storage::secure_write;
+
+// Number of writes after which the deferred digest is written.
+constexpr int64_t kMaxDeferredUpdates = 4;
+
+constexpr size_t kFileHeaderLength = kFileHashLength + sizeof(uint64_t);
+
+class DigestWriteBackTest : public ::testing::Test {
+ protected:
+  static void SetUpTestCase() {
+    ASSERT_EQ(AeadHandler::GetInstance().EnableDigestWriteBack(
+                  kMaxDeferredUpdates, absl::Hours(1)),
+              0);
+  }
+
+  void SetUp() override {
+    path_ = absl::StrCat(FLAGS_test_tmpdir, "/DigestWriteBackTest.txt");
+    remove(path_.c_str());
+
+    key_.resize(kKeyLength);
+    ASSERT_EQ(RAND_bytes(key_.data(), key_.size()), 1);
+  }
+
+  // Opens the secure file at |path| for reading and writing and sets its key.
+  // Returns the file descriptor, or -1 on failure.
+  int OpenWithKey(const std::string &path) {
+    int fd = secure_open(path.c_str(), O_RDWR | O_CREAT,
+                         S_IRWXU | S_IRWXG | S_IRWXO);
+    if (fd < 0) {
+      return -1;
+    }
+    if (AeadHandler::GetInstance().SetMasterKey(fd, key_.data(),
+                                                key_.size()) != 0) {
+      secure_close(fd);
+      return -1;
+    }
+    return fd;
+  }
+
+  // Returns the contents of the file at |path| on the host.
+  std::string RawContents(const std::string &path) {
+    int fd = enc_untrusted_open(path.c_str(), O_RDONLY);
+    EXPECT_GE(fd, 0);
+    std::string contents;
+    char buffer[4096];
+    ssize_t bytes_read;
+    while ((bytes_read = enc_untrusted_read(fd, buffer, sizeof(buffer))) > 0) {
+      contents.append(buffer, bytes_read);
+    }
+    enc_untrusted_close(fd);
+    return contents;
+  }
+
+  // Copies the file at |from| on the host to |to|.
+  void CopyFile(const std::string &from, const std::string &to) {
+    const std::string contents = RawContents(from);
+    int fd = enc_untrusted_open(to.c_str(), O_WRONLY | O_CREAT | O_TRUNC,
+                                S_IRUSR | S_IWUSR);
+    ASSERT_GE(fd, 0);
+    EXPECT_EQ(enc_untrusted_write(fd, contents.data(), contents.size()),
+              contents.size());
+    enc_untrusted_close(fd);
+  }
+
+  // Returns the header of the test file on the host.
+  std::string RawHeader() {
+    return RawContents(path_).substr(0, kFileHeaderLength);
+  }
+
+  std::string path_;
+  CleansingVector<uint8_t> key_;
+};
+
+TEST_F(DigestWriteBackTest, EnableTwiceFails) {
+  EXPECT_EQ(AeadHandler::GetInstance().EnableDigestWriteBack(
+                kMaxDeferredUpdates, absl::ZeroDuration()),
+            -1);
+  EXPECT_EQ(errno, EINVAL);
+}
+
+TEST_F(DigestWriteBackTest, DigestIsWrittenOnFsync) {
+  int fd = OpenWithKey(path_);
+  ASSERT_GE(fd, 0);
+  const std::string initial_header = RawHeader();
+  EXPECT_EQ(secure_write(fd, "data", 4), 4);
+  EXPECT_EQ(RawHeader(), initial_header);
+
+  EXPECT_EQ(secure_fsync(fd), 0);
+  EXPECT_NE(RawHeader(), initial_header);
+  EXPECT_EQ(secure_close(fd), 0);
+
+  fd = OpenWithKey(path_);
+  ASSERT_GE(fd, 0);
+  char buffer[4];
+  EXPECT_EQ(secure_read(fd, buffer, sizeof(buffer)), sizeof(buffer));
+  EXPECT_EQ(std::string(buffer, sizeof(buffer)), "data");
+  EXPECT_EQ(secure_close(fd), 0);
+}
+
+TEST_F(DigestWriteBackTest, DigestIsWrittenAfterMaxDeferredUpdates) {
+  int fd = OpenWithKey(path_);
+  ASSERT_GE(fd, 0);
+  std::string header = RawHeader();
+  for (int64_t i = 1; i < kMaxDeferredUpdates; ++i) {
+    EXPECT_EQ(secure_write(fd, "x", 1), 1);
+    EXPECT_EQ(RawHeader(), header);
+  }
+  EXPECT_EQ(secure_write(fd, "x", 1), 1);
+  EXPECT_NE(RawHeader(), header);
+
+  // The count starts over once the digest is written.
+  header = RawHeader();
+  EXPECT_EQ(secure_write(fd, "x", 1), 1);
+  EXPECT_EQ(RawHeader(), header);
+  EXPECT_EQ(secure_close(fd), 0);
+  EXPECT_NE(RawHeader(), header);
+}
+
+TEST_F(DigestWriteBackTest, WriteThroughFileWritesDigestOnEveryWrite) {
+  int fd = OpenWithKey(path_);
+  ASSERT_GE(fd, 0);
+  EXPECT_EQ(secure_write(fd, "x", 1), 1);
+
+  // Selecting write-through writes the pending digest.
+  std::string header = RawHeader();
+  EXPECT_EQ(AeadHandler::GetInstance().SetDigestWriteThrough(fd, true), 0);
+  EXPECT_NE(RawHeader(), header);
+
+  for (int i = 0; i < 3; ++i) {
+    header = RawHeader();
+    EXPECT_EQ(secure_write(fd, "x", 1), 1);
+    EXPECT_NE(RawHeader(), header);
+  }
+  EXPECT_EQ(secure_close(fd), 0);
+}
+
+// Tests what the next open of a file sees if the enclave stops before a
+// deferred digest is written, by opening copies of the file taken at that
+// point. Data written past the recorded size is ignored, while rewritten data
+// makes the file fail validation rather than read back stale data.
+TEST_F(DigestWriteBackTest, FileWithUnwrittenDigest) {
+  const std::string extended_path = absl::StrCat(path_, ".extended");
+  const std::string rewritten_path = absl::StrCat(path_, ".rewritten");
+  remove(extended_path.c_str());
+  remove(rewritten_path.c_str());
+
+  // Seal one full block, then extend the file by another block.
+  const std::string block(kBlockLength, 'a');
+  int fd = OpenWithKey(path_);
+  ASSERT_GE(fd, 0);
+  EXPECT_EQ(secure_write(fd, block.data(), block.size()), block.size());
+  EXPECT_EQ(secure_fsync(fd), 0);
+  EXPECT_EQ(secure_write(fd, "more", 4), 4);
+  CopyFile(path_, extended_path);
+  EXPECT_EQ(secure_lseek(fd, 0, SEEK_SET), 0);
+  EXPECT_EQ(secure_write(fd, "bbbb", 4), 4);
+  CopyFile(path_, rewritten_path);
+  EXPECT_EQ(secure_close(fd), 0);
+
+  fd = OpenWithKey(extended_path);
+  ASSERT_GE(fd, 0);
+  std::vector<char> buffer(2 * kBlockLength);
+  EXPECT_EQ(secure_read(fd, buffer.data(), buffer.size()), kBlockLength);
+  EXPECT_EQ(std::string(buffer.data(), kBlockLength), block);
+  EXPECT_EQ(secure_close(fd), 0);
+
+  EXPECT_EQ(OpenWithKey(rewritten_path), -1);
+
+  remove(extended_path.c_str());
+  remove(rewritten_path.c_str());
+}
+
+}  // namespace
+}  // namespace asylo
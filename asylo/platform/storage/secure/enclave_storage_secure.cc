@@ -37,9 +37,9 @@ namespace platform {
 namespace storage {
 
 int secure_open(const char *pathname, int flags, ...) {
-  if ((flags & O_APPEND) || (flags & O_TRUNC)) {
-    LOG(ERROR) << "Currently O_APPEND and O_TRUNC file creation flags are not "
-                  "supported by the Secure Storage.";
+  if (flags & O_TRUNC) {
+    LOG(ERROR) << "Currently O_TRUNC file creation flag is not supported by "
+                  "the Secure Storage.";
     return -1;
   }
 
@@ -52,7 +52,10 @@ int secure_open(const char *pathname, int flags, ...) {
   }
 
   bool is_new_file = (enc_untrusted_access(pathname, F_OK) == -1);
-  int fd = enc_untrusted_open(pathname, flags, mode);
+  // Appends are positioned at the logical end of the file by AeadHandler. The
+  // host file is opened without O_APPEND, which would make the host ignore the
+  // offsets of block writes.
+  int fd = enc_untrusted_open(pathname, flags & ~O_APPEND, mode);
   if (fd == -1) {
     LOG(ERROR) << "Failed to securely open file: " << pathname;
     return -1;
@@ -67,7 +70,9 @@ int secure_open(const char *pathname, int flags, ...) {
     return -1;
   }
 
-  if (!AeadHandler::GetInstance().InitializeFile(fd, pathname, is_new_file)) {
+  if (!AeadHandler::GetInstance().InitializeFile(
+          fd, pathname, is_new_file, flags & O_APPEND,
+          flags & O_INTEGRITY_ONLY)) {
     LOG(ERROR) << "Failed to initialize secure handling of file: " << pathname;
     return -1;
   }
@@ -84,18 +89,46 @@ ssize_t secure_write(int fd, const void *buf, size_t count) {
   return AeadHandler::GetInstance().EncryptAndPersist(fd, buf, count);
 }
 
+ssize_t secure_pread(int fd, void *buf, size_t count, off_t offset) {
+  return AeadHandler::GetInstance().DecryptAndVerifyAt(fd, buf, count, offset);
+}
+
+ssize_t secure_pwrite(int fd, const void *buf, size_t count, off_t offset) {
+  return AeadHandler::GetInstance().EncryptAndPersistAt(fd, buf, count,
+                                                        offset);
+}
+
 int secure_close(int fd) {
   bool finalize_result = AeadHandler::GetInstance().FinalizeFile(fd);
   return (finalize_result && enc_untrusted_close(fd) == 0) ? 0 : -1;
 }
 
+int secure_fsync(int fd) {
+  if (AeadHandler::GetInstance().Flush(fd) != 0) {
+    return -1;
+  }
+  return enc_untrusted_fsync(fd);
+}
+
+int secure_ftruncate(int fd, off_t length) {
+  int flags = enc_untrusted_fcntl(fd, F_GETFL);
+  if (flags == -1) {
+    return -1;
+  }
+  if ((flags & O_ACCMODE) == O_RDONLY) {
+    errno = EBADF;
+    return -1;
+  }
+  return AeadHandler::GetInstance().Truncate(fd, length);
+}
+
 off_t secure_lseek(int fd, off_t offset, int whence) {
   if (offset < 0) {
     return -1;
   }
 
   const OffsetTranslator &offset_translator =
-      AeadHandler::GetInstance().GetOffsetTranslator();
+      AeadHandler::GetInstance().GetOffsetTranslator(fd);
 
   // The net logical offset to which lseek has been requested.
   off_t logical_offset;
@@ -114,6 +147,12 @@ off_t secure_lseek(int fd, off_t offset, int whence) {
       logical_offset = logical_cur_offset + offset;
     } break;
     case SEEK_END: {
+      // Blocks buffered in the block cache may extend the file.
+      if (AeadHandler::GetInstance().Flush(fd) != 0) {
+        LOG(ERROR) << "Failed to flush the file before seeking to its end, fd="
+                   << fd;
+        return -1;
+      }
       off_t physical_eof_offset = enc_untrusted_lseek(fd, 0, SEEK_END);
       if (physical_eof_offset == -1) {
         LOG(ERROR) << "Failed to retrieve EOF offset on descriptor: " << fd;
@@ -136,6 +175,14 @@ off_t secure_lseek(int fd, off_t offset, int whence) {
   return offset_translator.PhysicalToLogical(physical_offset);
 }
 
+int secure_unlink(const char *pathname) {
+  if (enc_untrusted_unlink(pathname) == -1) {
+    return -1;
+  }
+  AeadHandler::RemoveSidecarFiles(pathname);
+  return 0;
+}
+
 }  // namespace storage
 }  // namespace platform
 }  // namespace asylo
@@ -42,10 +42,29 @@ ssize_t secure_read(int fd, void *buf, size_t count);
 // responsibility to explicitly set file offset on error as the client desires.
 ssize_t secure_write(int fd, const void *buf, size_t count);
 
+// Read and write at the logical |offset| without using or moving the file
+// offset of |fd|. Concurrent reads of the same file do not exclude each other.
+ssize_t secure_pread(int fd, void *buf, size_t count, off_t offset);
+ssize_t secure_pwrite(int fd, const void *buf, size_t count, off_t offset);
+
 int secure_close(int fd);
 
+// Writes data buffered by the secure IO layer to the file before synchronizing
+// it with the storage device.
+int secure_fsync(int fd);
+
+// Sets the logical size of the file to |length|. Extending a file adds a
+// sparse region without writing it; shrinking is only supported within such a
+// region.
+int secure_ftruncate(int fd, off_t length);
+
 off_t secure_lseek(int fd, off_t offset, int whence);
 
+// Removes the file at |pathname| together with the sidecar files kept on the
+// host if it is a secure file. Files at the paths of the sidecars which are
+// not sidecars are left alone.
+int secure_unlink(const char *pathname);
+
 }  // namespace storage
 }  // namespace platform
 }  // namespace asylo
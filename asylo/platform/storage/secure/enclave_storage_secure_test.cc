@@ -20,8 +20,12 @@
 
 // IO syscall interface constants.
 #include <fcntl.h>
+#include <unistd.h>
 #include <openssl/rand.h>
 
+#include <thread>
+#include <vector>
+
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 #include "absl/strings/str_cat.h"
@@ -40,12 +44,22 @@ namespace {
 
 using platform::crypto::gcmlib::kKeyLength;
 using platform::storage::AeadHandler;
+using platform::storage::kAppendSealBlockCount;
 using platform::storage::kBlockLength;
+using platform::storage::kBlockLength4KiB;
+using platform::storage::kBlockLength64KiB;
 using platform::storage::kCipherBlockLength;
 using platform::storage::kFileHashLength;
+using platform::storage::kIntegrityIndexSuffix;
+using platform::storage::kKeyRotationSuffix;
+using platform::storage::kTagLength;
+using platform::storage::kTokenLength;
 using platform::storage::secure_close;
+using platform::storage::secure_ftruncate;
 using platform::storage::secure_lseek;
 using platform::storage::secure_open;
+using platform::storage::secure_pread;
+using platform::storage::secure_pwrite;
 using platform::storage::secure_read;
 using platform::storage::secure_write;
 using ::testing::Not;
@@ -59,9 +73,13 @@ class EnclaveStorageSecureTest : public ::testing::Test,
   void PrepareTest();
   Status OpenWriteClose(off_t offset);
   Status OpenReadVerifyClose(off_t offset, size_t bytes_expected);
+  Status OpenWriteRepeatedClose(int iterations);
 
   const int64_t kFileHeaderLength = kFileHashLength + sizeof(size_t);
   const std::string& GetPath() const { return path_; }
+  std::string GetIndexPath() const {
+    return absl::StrCat(path_, kIntegrityIndexSuffix);
+  }
   const void* GetWriteBuffer() const {
     return reinterpret_cast<const void*>(write_buffer_);
   }
@@ -202,6 +220,33 @@ Status EnclaveStorageSecureTest::OpenReadVerifyClose(off_t offset,
   return Status::OkStatus();
 }
 
+Status EnclaveStorageSecureTest::OpenWriteRepeatedClose(int iterations) {
+  int fd = secure_open(GetPath().c_str(), O_WRONLY | O_CREAT,
+                       S_IRWXU | S_IRWXG | S_IRWXO);
+  if (fd < 0) {
+    return Status(error::GoogleError::INTERNAL,
+                  absl::StrCat("Secure open path ", GetPath(), " failed."));
+  }
+
+  platform::storage::FdCloser fd_closer(fd, &secure_close);
+
+  if (EmulateSetKeyIoctl(fd) != 0) {
+    return Status(error::GoogleError::INTERNAL, "Set Master Key failed.");
+  }
+
+  for (int iter = 0; iter < iterations; iter++) {
+    if (secure_write(fd, GetWriteBuffer(), test_buf_len_) != test_buf_len_) {
+      return Status(error::GoogleError::INTERNAL, "Secure write failed.");
+    }
+  }
+
+  if (!fd_closer.reset()) {
+    return Status(error::GoogleError::INTERNAL, "Secure close failed.");
+  }
+
+  return Status::OkStatus();
+}
+
 //
 // Success cases.
 //
@@ -533,6 +578,338 @@ TEST_P(EnclaveStorageSecureTest, FileTruncateAttack) {
   EXPECT_THAT(OpenWriteClose(0), Not(IsOk()));
 }
 
+// Number of iterations of OpenWriteRepeatedClose that write a file spanning
+// three chunks of the integrity index.
+int IterationsForThreeIndexChunks(size_t test_buf_len) {
+  return 3 * 1024 * kBlockLength / test_buf_len;
+}
+
+// Offsets of the leaf hashes of the second chunk and of the chunk roots in the
+// integrity index of a file spanning three chunks.
+constexpr off_t kIndexHeaderLength = 24;
+constexpr off_t kIndexChunkSlotLength = 1024 * 32;
+constexpr off_t kIndexSecondChunkOffset =
+    kIndexHeaderLength + kIndexChunkSlotLength;
+constexpr off_t kIndexChunkRootsOffset =
+    kIndexHeaderLength + 3 * kIndexChunkSlotLength;
+
+TEST_P(EnclaveStorageSecureTest, IntegrityIndexReopenReadWriteSuccess) {
+  const int iterations = IterationsForThreeIndexChunks(test_buf_len_);
+  EXPECT_THAT(OpenWriteRepeatedClose(iterations), IsOk());
+  EXPECT_EQ(access(GetIndexPath().c_str(), F_OK), 0);
+
+  // Reads and writes in different chunks after reopening the file.
+  const off_t middle_offset = (iterations / 2) * test_buf_len_;
+  EXPECT_THAT(OpenReadVerifyClose(middle_offset, test_buf_len_), IsOk());
+  EXPECT_THAT(OpenWriteClose(middle_offset), IsOk());
+  EXPECT_THAT(OpenReadVerifyClose(0, test_buf_len_), IsOk());
+  EXPECT_THAT(OpenReadVerifyClose(middle_offset, test_buf_len_), IsOk());
+  EXPECT_THAT(
+      OpenReadVerifyClose((iterations - 1) * test_buf_len_, test_buf_len_),
+      IsOk());
+
+  // Appending to a reopened file extends the last chunk.
+  int fd = secure_open(GetPath().c_str(), O_WRONLY);
+  ASSERT_GE(fd, 0);
+  ASSERT_EQ(EmulateSetKeyIoctl(fd), 0);
+  const off_t eof_offset = iterations * test_buf_len_;
+  EXPECT_EQ(secure_lseek(fd, eof_offset, SEEK_SET), eof_offset);
+  EXPECT_EQ(secure_write(fd, GetWriteBuffer(), test_buf_len_), test_buf_len_);
+  EXPECT_EQ(secure_close(fd), 0);
+  EXPECT_THAT(OpenReadVerifyClose(eof_offset, test_buf_len_), IsOk());
+}
+
+TEST_P(EnclaveStorageSecureTest, IntegrityIndexMissingSuccess) {
+  const int iterations = IterationsForThreeIndexChunks(test_buf_len_);
+  EXPECT_THAT(OpenWriteRepeatedClose(iterations), IsOk());
+
+  // Without the index, integrity metadata is collected from the file data and
+  // the index is recreated on close.
+  EXPECT_EQ(remove(GetIndexPath().c_str()), 0);
+  EXPECT_THAT(OpenReadVerifyClose(test_buf_len_, test_buf_len_), IsOk());
+  EXPECT_EQ(access(GetIndexPath().c_str(), F_OK), 0);
+  EXPECT_THAT(OpenReadVerifyClose(test_buf_len_, test_buf_len_), IsOk());
+}
+
+TEST_P(EnclaveStorageSecureTest, UnlinkRemovesIntegrityIndex) {
+  EXPECT_THAT(OpenWriteClose(0), IsOk());
+  EXPECT_EQ(access(GetIndexPath().c_str(), F_OK), 0);
+  EXPECT_EQ(unlink(GetPath().c_str()), 0);
+  EXPECT_EQ(access(GetIndexPath().c_str(), F_OK), -1);
+}
+
+TEST_P(EnclaveStorageSecureTest, IntegrityIndexDoesNotReplaceOtherFile) {
+  // A file at the path of the index which is not an index is neither
+  // overwritten nor removed with the secure file.
+  const std::string contents = "not an integrity index";
+  int fd = enc_untrusted_open(GetIndexPath().c_str(), O_WRONLY | O_CREAT,
+                              S_IRUSR | S_IWUSR);
+  ASSERT_GE(fd, 0);
+  EXPECT_EQ(enc_untrusted_write(fd, contents.data(), contents.size()),
+            contents.size());
+  enc_untrusted_close(fd);
+
+  // The secure file remains usable without the index.
+  EXPECT_THAT(OpenWriteClose(0), IsOk());
+  EXPECT_THAT(OpenReadVerifyClose(0, test_buf_len_), IsOk());
+  EXPECT_EQ(unlink(GetPath().c_str()), 0);
+
+  char buffer[64];
+  fd = enc_untrusted_open(GetIndexPath().c_str(), O_RDONLY);
+  ASSERT_GE(fd, 0);
+  EXPECT_EQ(enc_untrusted_read(fd, buffer, sizeof(buffer)), contents.size());
+  enc_untrusted_close(fd);
+  EXPECT_EQ(std::string(buffer, contents.size()), contents);
+  EXPECT_EQ(enc_untrusted_unlink(GetIndexPath().c_str()), 0);
+}
+
+TEST_P(EnclaveStorageSecureTest, IntegrityIndexChunkRootsModified) {
+  const int iterations = IterationsForThreeIndexChunks(test_buf_len_);
+  EXPECT_THAT(OpenWriteRepeatedClose(iterations), IsOk());
+
+  // A modified chunk root fails validation against the file digest, so
+  // integrity metadata is collected from the file data instead.
+  int fd = enc_untrusted_open(GetIndexPath().c_str(), O_WRONLY);
+  ASSERT_GE(fd, 0);
+  EXPECT_EQ(enc_untrusted_lseek(fd, kIndexChunkRootsOffset, SEEK_SET),
+            kIndexChunkRootsOffset);
+  EXPECT_GT(enc_untrusted_write(fd, "xx", 2), 0);
+  enc_untrusted_close(fd);
+  EXPECT_THAT(OpenReadVerifyClose(0, test_buf_len_), IsOk());
+}
+
+TEST_P(EnclaveStorageSecureTest, IntegrityIndexLeafHashesModified) {
+  const int iterations = IterationsForThreeIndexChunks(test_buf_len_);
+  EXPECT_THAT(OpenWriteRepeatedClose(iterations), IsOk());
+
+  // Modify a leaf hash in the second chunk - form of tampering.
+  int fd = enc_untrusted_open(GetIndexPath().c_str(), O_WRONLY);
+  ASSERT_GE(fd, 0);
+  EXPECT_EQ(enc_untrusted_lseek(fd, kIndexSecondChunkOffset, SEEK_SET),
+            kIndexSecondChunkOffset);
+  EXPECT_GT(enc_untrusted_write(fd, "xx", 2), 0);
+  enc_untrusted_close(fd);
+
+  // Only blocks of the modified chunk fail to verify.
+  EXPECT_THAT(OpenReadVerifyClose(0, test_buf_len_), IsOk());
+  EXPECT_THAT(OpenReadVerifyClose(1024 * kBlockLength, test_buf_len_),
+              Not(IsOk()));
+}
+
+TEST_P(EnclaveStorageSecureTest, PositionalReadWriteSuccess) {
+  int fd = secure_open(GetPath().c_str(), O_RDWR | O_CREAT,
+                       S_IRWXU | S_IRWXG | S_IRWXO);
+  ASSERT_GE(fd, 0);
+  ASSERT_EQ(EmulateSetKeyIoctl(fd), 0);
+
+  // Positional operations leave the cursor in place.
+  constexpr off_t kOffset = 37;
+  EXPECT_EQ(secure_pwrite(fd, GetWriteBuffer(), test_buf_len_, kOffset),
+            test_buf_len_);
+  EXPECT_EQ(secure_lseek(fd, 0, SEEK_CUR), 0);
+  EXPECT_EQ(secure_pread(fd, GetReadBuffer(), test_buf_len_, kOffset),
+            test_buf_len_);
+  EXPECT_EQ(memcmp(GetWriteBuffer(), GetReadBuffer(), test_buf_len_), 0);
+  EXPECT_EQ(secure_pread(fd, GetReadBuffer(), test_buf_len_,
+                         kOffset + test_buf_len_),
+            0);
+  EXPECT_EQ(secure_lseek(fd, 0, SEEK_CUR), 0);
+  EXPECT_EQ(secure_read(fd, GetReadBuffer(), kOffset), kOffset);
+  EXPECT_EQ(memcmp(GetReadBuffer(), GetZeroBuffer(), kOffset), 0);
+
+  EXPECT_EQ(secure_pread(fd, GetReadBuffer(), test_buf_len_, -1), -1);
+  EXPECT_EQ(errno, EINVAL);
+  EXPECT_EQ(secure_close(fd), 0);
+
+  EXPECT_THAT(OpenReadVerifyClose(kOffset, test_buf_len_), IsOk());
+}
+
+TEST_P(EnclaveStorageSecureTest, ConcurrentPositionalReadsSuccess) {
+  const int iterations = IterationsForThreeIndexChunks(test_buf_len_);
+  EXPECT_THAT(OpenWriteRepeatedClose(iterations), IsOk());
+
+  int fd = secure_open(GetPath().c_str(), O_RDONLY);
+  ASSERT_GE(fd, 0);
+  ASSERT_EQ(EmulateSetKeyIoctl(fd), 0);
+
+  // Each thread reads an interleaved subset of the written buffers, so the
+  // threads share chunks of the integrity index loaded by any of them.
+  constexpr int kThreadCount = 4;
+  std::vector<std::thread> threads;
+  for (int thread = 0; thread < kThreadCount; thread++) {
+    threads.emplace_back([this, fd, iterations, thread] {
+      std::vector<char> buffer(test_buf_len_);
+      for (int iter = thread; iter < iterations; iter += kThreadCount) {
+        ASSERT_EQ(secure_pread(fd, buffer.data(), test_buf_len_,
+                               iter * test_buf_len_),
+                  test_buf_len_);
+        ASSERT_EQ(memcmp(GetWriteBuffer(), buffer.data(), test_buf_len_), 0);
+      }
+    });
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+
+  EXPECT_EQ(secure_lseek(fd, 0, SEEK_CUR), 0);
+  EXPECT_EQ(secure_close(fd), 0);
+}
+
+TEST_P(EnclaveStorageSecureTest, CloseDuringReadsOfSameFileSuccess) {
+  const int iterations = IterationsForThreeIndexChunks(test_buf_len_);
+  EXPECT_THAT(OpenWriteRepeatedClose(iterations), IsOk());
+
+  int read_fd = secure_open(GetPath().c_str(), O_RDONLY);
+  ASSERT_GE(read_fd, 0);
+  ASSERT_EQ(EmulateSetKeyIoctl(read_fd), 0);
+
+  // Descriptors of the same file are opened and closed while another one is
+  // read from, which must not affect its reads.
+  std::thread reader([this, read_fd, iterations] {
+    std::vector<char> buffer(test_buf_len_);
+    for (int iter = 0; iter < iterations; iter++) {
+      ASSERT_EQ(secure_pread(read_fd, buffer.data(), test_buf_len_,
+                             iter * test_buf_len_),
+                test_buf_len_);
+      ASSERT_EQ(memcmp(GetWriteBuffer(), buffer.data(), test_buf_len_), 0);
+    }
+  });
+  for (int iter = 0; iter < 8; iter++) {
+    int fd = secure_open(GetPath().c_str(), O_RDONLY);
+    EXPECT_GE(fd, 0);
+    EXPECT_EQ(EmulateSetKeyIoctl(fd), 0);
+    EXPECT_EQ(secure_close(fd), 0);
+  }
+  reader.join();
+
+  EXPECT_EQ(secure_close(read_fd), 0);
+}
+
+TEST_P(EnclaveStorageSecureTest, AppendReopenReadSuccess) {
+  int fd = secure_open(GetPath().c_str(), O_WRONLY | O_CREAT | O_APPEND,
+                       S_IRWXU | S_IRWXG | S_IRWXO);
+  ASSERT_GE(fd, 0);
+  ASSERT_EQ(EmulateSetKeyIoctl(fd), 0);
+
+  // Appends span more blocks than are appended between digest updates, and
+  // leave a partial last block.
+  const int iterations =
+      (kAppendSealBlockCount + 2) * kBlockLength / test_buf_len_ + 1;
+  for (int iter = 0; iter < iterations; iter++) {
+    ASSERT_EQ(secure_write(fd, GetWriteBuffer(), test_buf_len_),
+              test_buf_len_);
+  }
+  const off_t eof_offset = iterations * test_buf_len_;
+  EXPECT_EQ(secure_lseek(fd, 0, SEEK_CUR), eof_offset);
+  EXPECT_EQ(secure_close(fd), 0);
+
+  EXPECT_THAT(OpenReadVerifyClose(0, test_buf_len_), IsOk());
+  EXPECT_THAT(OpenReadVerifyClose((iterations / 2) * test_buf_len_,
+                                  test_buf_len_),
+              IsOk());
+  EXPECT_THAT(OpenReadVerifyClose(eof_offset - test_buf_len_, test_buf_len_),
+              IsOk());
+  EXPECT_THAT(OpenReadVerifyClose(eof_offset, 0), IsOk());
+}
+
+TEST_P(EnclaveStorageSecureTest, AppendToExistingFileSuccess) {
+  EXPECT_THAT(OpenWriteClose(0), IsOk());
+
+  // Appends ignore the cursor, and continue the partial last block of the
+  // file.
+  int fd = secure_open(GetPath().c_str(), O_WRONLY | O_APPEND);
+  ASSERT_GE(fd, 0);
+  ASSERT_EQ(EmulateSetKeyIoctl(fd), 0);
+  EXPECT_EQ(secure_write(fd, GetWriteBuffer(), test_buf_len_), test_buf_len_);
+  EXPECT_EQ(secure_lseek(fd, 0, SEEK_CUR), 2 * test_buf_len_);
+  EXPECT_EQ(secure_lseek(fd, 0, SEEK_SET), 0);
+  EXPECT_EQ(secure_write(fd, GetWriteBuffer(), test_buf_len_), test_buf_len_);
+  EXPECT_EQ(secure_lseek(fd, 0, SEEK_CUR), 3 * test_buf_len_);
+  EXPECT_EQ(secure_close(fd), 0);
+
+  EXPECT_THAT(OpenReadVerifyClose(0, test_buf_len_), IsOk());
+  EXPECT_THAT(OpenReadVerifyClose(test_buf_len_, test_buf_len_), IsOk());
+  EXPECT_THAT(OpenReadVerifyClose(2 * test_buf_len_, test_buf_len_), IsOk());
+  EXPECT_THAT(OpenReadVerifyClose(3 * test_buf_len_, 0), IsOk());
+}
+
+TEST_P(EnclaveStorageSecureTest, AppendReadBackSuccess) {
+  int fd = secure_open(GetPath().c_str(), O_RDWR | O_CREAT | O_APPEND,
+                       S_IRWXU | S_IRWXG | S_IRWXO);
+  ASSERT_GE(fd, 0);
+  ASSERT_EQ(EmulateSetKeyIoctl(fd), 0);
+
+  // Reads see appended data held back in the enclave, and appends continue
+  // after them.
+  constexpr size_t kRecordLength = 16;
+  for (int iter = 0; iter < 3; iter++) {
+    ASSERT_EQ(secure_write(fd, GetWriteBuffer(), kRecordLength),
+              kRecordLength);
+    EXPECT_EQ(secure_pread(fd, GetReadBuffer(), test_buf_len_, 0),
+              (iter + 1) * kRecordLength);
+    EXPECT_EQ(memcmp(GetWriteBuffer(), GetReadBuffer(),
+                     (iter + 1) * kRecordLength),
+              0);
+  }
+
+  // Writes at an offset are not appended.
+  EXPECT_EQ(secure_pwrite(fd, GetZeroBuffer(), kRecordLength, 0),
+            kRecordLength);
+  EXPECT_EQ(secure_write(fd, GetWriteBuffer(), kRecordLength), kRecordLength);
+  EXPECT_EQ(secure_pread(fd, GetReadBuffer(), test_buf_len_, 0),
+            4 * kRecordLength);
+  EXPECT_EQ(memcmp(GetZeroBuffer(), GetReadBuffer(), kRecordLength), 0);
+  EXPECT_EQ(memcmp(GetWriteBuffer(), read_buffer_ + kRecordLength,
+                   3 * kRecordLength),
+            0);
+  EXPECT_EQ(secure_close(fd), 0);
+}
+
+TEST_P(EnclaveStorageSecureTest, AppendUnclosedFileOpensAtSealedSize) {
+  int fd = secure_open(GetPath().c_str(), O_WRONLY | O_CREAT | O_APPEND,
+                       S_IRWXU | S_IRWXG | S_IRWXO);
+  ASSERT_GE(fd, 0);
+  ASSERT_EQ(EmulateSetKeyIoctl(fd), 0);
+
+  // Append short records until the digest is updated, and a few more which
+  // are not covered by the digest.
+  constexpr size_t kRecordLength = 16;
+  const size_t sealed_size = kAppendSealBlockCount * kBlockLength;
+  for (size_t size = 0; size < sealed_size + 3 * kBlockLength;
+       size += kRecordLength) {
+    ASSERT_EQ(secure_write(fd, GetWriteBuffer(), kRecordLength),
+              kRecordLength);
+  }
+
+  // Emulate a crash by saving the host file before it is closed.
+  std::vector<char> unclosed_file;
+  int host_fd = enc_untrusted_open(GetPath().c_str(), O_RDONLY);
+  ASSERT_GE(host_fd, 0);
+  char buffer[kMaxTestBufLen];
+  ssize_t bytes_read;
+  while ((bytes_read = enc_untrusted_read(host_fd, buffer, sizeof(buffer))) >
+         0) {
+    unclosed_file.insert(unclosed_file.end(), buffer, buffer + bytes_read);
+  }
+  enc_untrusted_close(host_fd);
+  EXPECT_EQ(secure_close(fd), 0);
+
+  host_fd = enc_untrusted_open(GetPath().c_str(), O_WRONLY | O_TRUNC);
+  ASSERT_GE(host_fd, 0);
+  EXPECT_EQ(enc_untrusted_write(host_fd, unclosed_file.data(),
+                                unclosed_file.size()),
+            unclosed_file.size());
+  enc_untrusted_close(host_fd);
+  EXPECT_EQ(remove(GetIndexPath().c_str()), 0);
+
+  // The file opens with the data covered by the last digest update.
+  const off_t last_offset =
+      (sealed_size - test_buf_len_) / kRecordLength * kRecordLength;
+  EXPECT_THAT(OpenReadVerifyClose(0, test_buf_len_), IsOk());
+  EXPECT_THAT(OpenReadVerifyClose(last_offset, test_buf_len_), IsOk());
+  EXPECT_THAT(OpenReadVerifyClose(sealed_size, 0), IsOk());
+}
+
 TEST_P(EnclaveStorageSecureTest, KeyNotSetFailure) {
   // Open for write.
   int fd = secure_open(GetPath().c_str(), O_WRONLY | O_CREAT,
@@ -575,15 +952,264 @@ TEST_P(EnclaveStorageSecureTest, UnknownFdIoctlFailure) {
   EXPECT_EQ(errno, ENOENT);
 }
 
-TEST_P(EnclaveStorageSecureTest, UnsupportedFileCreationFlagFailure) {
-  // Open for write with O_APPEND.
-  int fd = secure_open(GetPath().c_str(), O_WRONLY | O_CREAT | O_APPEND,
+TEST_P(EnclaveStorageSecureTest, LargeBlockLengthReopenReadWriteSuccess) {
+  for (size_t block_length : {kBlockLength4KiB, kBlockLength64KiB}) {
+    PrepareTest();
+
+    // Create the file with the selected block length and write at an offset
+    // which lands in the middle of the first block.
+    int fd = secure_open(GetPath().c_str(), O_WRONLY | O_CREAT,
+                         S_IRWXU | S_IRWXG | S_IRWXO);
+    ASSERT_GE(fd, 0);
+    EXPECT_EQ(AeadHandler::GetInstance().SetBlockLength(fd, block_length), 0);
+    EXPECT_EQ(EmulateSetKeyIoctl(fd), 0);
+    constexpr off_t kOffset = 100;
+    EXPECT_EQ(secure_lseek(fd, kOffset, SEEK_SET), kOffset);
+    EXPECT_EQ(secure_write(fd, GetWriteBuffer(), test_buf_len_),
+              test_buf_len_);
+    EXPECT_EQ(secure_close(fd), 0);
+
+    // The file holds a single block of the selected length.
+    fd = enc_untrusted_open(GetPath().c_str(), O_RDONLY);
+    ASSERT_GE(fd, 0);
+    EXPECT_EQ(enc_untrusted_lseek(fd, 0, SEEK_END),
+              kFileHeaderLength + block_length + kTagLength + kTokenLength);
+    enc_untrusted_close(fd);
+
+    // The block length is recovered from the header on reopen.
+    EXPECT_THAT(OpenReadVerifyClose(kOffset, test_buf_len_), IsOk());
+
+    // Data before the written range reads back as zeros.
+    fd = secure_open(GetPath().c_str(), O_RDONLY);
+    ASSERT_GE(fd, 0);
+    EXPECT_EQ(EmulateSetKeyIoctl(fd), 0);
+    EXPECT_EQ(secure_read(fd, GetReadBuffer(), kOffset), kOffset);
+    EXPECT_EQ(memcmp(GetReadBuffer(), GetZeroBuffer(), kOffset), 0);
+    EXPECT_EQ(secure_close(fd), 0);
+
+    // Rewriting the existing file keeps its block length.
+    EXPECT_THAT(OpenWriteClose(0), IsOk());
+    EXPECT_THAT(OpenReadVerifyClose(0, test_buf_len_), IsOk());
+  }
+}
+
+TEST_P(EnclaveStorageSecureTest, SetBlockLengthFailure) {
+  int fd = secure_open(GetPath().c_str(), O_WRONLY | O_CREAT,
                        S_IRWXU | S_IRWXG | S_IRWXO);
-  EXPECT_EQ(fd, -1);
+  ASSERT_GE(fd, 0);
+
+  // Only the supported block lengths are accepted.
+  EXPECT_EQ(AeadHandler::GetInstance().SetBlockLength(fd, 1024), -1);
+  EXPECT_EQ(errno, EINVAL);
+
+  // The block length is fixed once the header has been written.
+  EXPECT_EQ(EmulateSetKeyIoctl(fd), 0);
+  EXPECT_EQ(AeadHandler::GetInstance().SetBlockLength(fd, kBlockLength), 0);
+  EXPECT_EQ(AeadHandler::GetInstance().SetBlockLength(fd, kBlockLength4KiB),
+            -1);
+  EXPECT_EQ(errno, EINVAL);
+  EXPECT_EQ(secure_close(fd), 0);
+
+  EXPECT_EQ(AeadHandler::GetInstance().SetBlockLength(fd, kBlockLength4KiB),
+            -1);
+  EXPECT_EQ(errno, ENOENT);
+}
+
+TEST_P(EnclaveStorageSecureTest, KeyRotationReadableBetweenStepsSuccess) {
+  EXPECT_THAT(OpenWriteClose(0), IsOk());
+  EXPECT_THAT(OpenWriteClose(test_buf_len_), IsOk());
+
+  CleansingVector<uint8_t> new_key(kKeyLength);
+  ASSERT_EQ(RAND_bytes(new_key.data(), new_key.size()), 1);
+
+  int fd = secure_open(GetPath().c_str(), O_RDWR);
+  ASSERT_GE(fd, 0);
+  EXPECT_EQ(EmulateSetKeyIoctl(fd), 0);
+  ASSERT_EQ(AeadHandler::GetInstance().BeginKeyRotation(fd, new_key.data(),
+                                                        new_key.size()),
+            0);
+
+  // The file reads back and can be written between steps.
+  int64_t remaining;
+  do {
+    remaining = AeadHandler::GetInstance().RotateKeyStep(fd, 1);
+    ASSERT_GE(remaining, 0);
+    EXPECT_EQ(secure_pwrite(fd, GetWriteBuffer(), test_buf_len_ / 2, 0),
+              test_buf_len_ / 2);
+    for (off_t offset : {off_t{0}, static_cast<off_t>(test_buf_len_)}) {
+      EXPECT_EQ(secure_pread(fd, GetReadBuffer(), test_buf_len_, offset),
+                test_buf_len_);
+      EXPECT_EQ(memcmp(GetReadBuffer(), GetWriteBuffer(), test_buf_len_), 0);
+    }
+  } while (remaining > 0);
+  EXPECT_EQ(secure_close(fd), 0);
+
+  // The file is only opened with the new key once the rotation completes.
+  fd = secure_open(GetPath().c_str(), O_RDONLY);
+  ASSERT_GE(fd, 0);
+  EXPECT_EQ(EmulateSetKeyIoctl(fd), -1);
+  EXPECT_EQ(secure_close(fd), 0);
+
+  key_ = new_key;
+  EXPECT_THAT(OpenReadVerifyClose(0, test_buf_len_), IsOk());
+  EXPECT_THAT(OpenReadVerifyClose(test_buf_len_, test_buf_len_), IsOk());
+}
+
+TEST_P(EnclaveStorageSecureTest, KeyRotationResumedAfterReopenSuccess) {
+  EXPECT_THAT(OpenWriteClose(0), IsOk());
+  EXPECT_THAT(OpenWriteClose(test_buf_len_), IsOk());
+
+  CleansingVector<uint8_t> new_key(kKeyLength);
+  ASSERT_EQ(RAND_bytes(new_key.data(), new_key.size()), 1);
+
+  // Rotate part of the file and close it.
+  int fd = secure_open(GetPath().c_str(), O_RDWR);
+  ASSERT_GE(fd, 0);
+  EXPECT_EQ(EmulateSetKeyIoctl(fd), 0);
+  ASSERT_EQ(AeadHandler::GetInstance().BeginKeyRotation(fd, new_key.data(),
+                                                        new_key.size()),
+            0);
+  EXPECT_GT(AeadHandler::GetInstance().RotateKeyStep(fd, 1), 0);
+  EXPECT_EQ(secure_close(fd), 0);
+
+  // The file is opened with the previous key, but cannot be read until the
+  // rotation is resumed with the same new key.
+  fd = secure_open(GetPath().c_str(), O_RDWR);
+  ASSERT_GE(fd, 0);
+  EXPECT_EQ(EmulateSetKeyIoctl(fd), 0);
+  EXPECT_EQ(secure_pread(fd, GetReadBuffer(), test_buf_len_, 0), -1);
+  EXPECT_EQ(errno, EACCES);
+  EXPECT_EQ(AeadHandler::GetInstance().BeginKeyRotation(fd, key_.data(),
+                                                        key_.size()),
+            -1);
+  EXPECT_EQ(errno, EINVAL);
+  ASSERT_EQ(AeadHandler::GetInstance().BeginKeyRotation(fd, new_key.data(),
+                                                        new_key.size()),
+            0);
+  EXPECT_EQ(secure_pread(fd, GetReadBuffer(), test_buf_len_, 0),
+            test_buf_len_);
+  EXPECT_EQ(memcmp(GetReadBuffer(), GetWriteBuffer(), test_buf_len_), 0);
+  EXPECT_EQ(AeadHandler::GetInstance().RotateKeyStep(fd, INT64_MAX), 0);
+  EXPECT_EQ(AeadHandler::GetInstance().RotateKeyStep(fd, 1), -1);
+  EXPECT_EQ(secure_close(fd), 0);
+
+  key_ = new_key;
+  EXPECT_THAT(OpenReadVerifyClose(0, test_buf_len_), IsOk());
+  EXPECT_THAT(OpenReadVerifyClose(test_buf_len_, test_buf_len_), IsOk());
+}
+
+TEST_P(EnclaveStorageSecureTest, UnlinkRemovesKeyRotationRecord) {
+  EXPECT_THAT(OpenWriteClose(0), IsOk());
+  EXPECT_THAT(OpenWriteClose(test_buf_len_), IsOk());
+
+  CleansingVector<uint8_t> new_key(kKeyLength);
+  ASSERT_EQ(RAND_bytes(new_key.data(), new_key.size()), 1);
+  int fd = secure_open(GetPath().c_str(), O_RDWR);
+  ASSERT_GE(fd, 0);
+  EXPECT_EQ(EmulateSetKeyIoctl(fd), 0);
+  ASSERT_EQ(AeadHandler::GetInstance().BeginKeyRotation(fd, new_key.data(),
+                                                        new_key.size()),
+            0);
+  EXPECT_GT(AeadHandler::GetInstance().RotateKeyStep(fd, 1), 0);
+  EXPECT_EQ(secure_close(fd), 0);
+
+  const std::string record_path = absl::StrCat(path_, kKeyRotationSuffix);
+  EXPECT_EQ(access(record_path.c_str(), F_OK), 0);
+  EXPECT_EQ(unlink(GetPath().c_str()), 0);
+  EXPECT_EQ(access(record_path.c_str(), F_OK), -1);
+}
+
+TEST_P(EnclaveStorageSecureTest, SparseExtensionSuccess) {
+  EXPECT_THAT(OpenWriteClose(0), IsOk());
+
+  // Extending the file adds a hole that reads back as zeros.
+  constexpr off_t kExtendedSize = 1024 * 1024;
+  const off_t hole_offset = kExtendedSize / 2;
+  int fd = secure_open(GetPath().c_str(), O_RDWR);
+  ASSERT_GE(fd, 0);
+  EXPECT_EQ(EmulateSetKeyIoctl(fd), 0);
+  EXPECT_EQ(secure_ftruncate(fd, kExtendedSize), 0);
+  EXPECT_EQ(secure_lseek(fd, 0, SEEK_END), kExtendedSize);
+  EXPECT_EQ(secure_pread(fd, GetReadBuffer(), test_buf_len_, test_buf_len_),
+            test_buf_len_);
+  EXPECT_EQ(memcmp(GetReadBuffer(), GetZeroBuffer(), test_buf_len_), 0);
+  EXPECT_EQ(secure_pread(fd, GetReadBuffer(), test_buf_len_,
+                         kExtendedSize - test_buf_len_),
+            test_buf_len_);
+  EXPECT_EQ(memcmp(GetReadBuffer(), GetZeroBuffer(), test_buf_len_), 0);
+
+  // Write into the middle of the hole.
+  EXPECT_EQ(secure_pwrite(fd, GetWriteBuffer(), test_buf_len_, hole_offset),
+            test_buf_len_);
+
+  // The file cannot be shrunk below its stored data, but can be within the
+  // hole that follows it.
+  EXPECT_EQ(secure_ftruncate(fd, test_buf_len_), -1);
+  EXPECT_EQ(errno, EINVAL);
+  EXPECT_EQ(secure_ftruncate(fd, kExtendedSize - 1), 0);
+  EXPECT_EQ(secure_lseek(fd, 0, SEEK_END), kExtendedSize - 1);
+  EXPECT_EQ(secure_close(fd), 0);
+
+  // The contents and size persist.
+  EXPECT_THAT(OpenReadVerifyClose(0, test_buf_len_), IsOk());
+  EXPECT_THAT(OpenReadVerifyClose(hole_offset, test_buf_len_), IsOk());
+  fd = secure_open(GetPath().c_str(), O_RDONLY);
+  ASSERT_GE(fd, 0);
+  EXPECT_EQ(EmulateSetKeyIoctl(fd), 0);
+  EXPECT_EQ(secure_lseek(fd, 0, SEEK_END), kExtendedSize - 1);
+  EXPECT_EQ(secure_pread(fd, GetReadBuffer(), test_buf_len_,
+                         hole_offset - test_buf_len_),
+            test_buf_len_);
+  EXPECT_EQ(memcmp(GetReadBuffer(), GetZeroBuffer(), test_buf_len_), 0);
+  EXPECT_EQ(secure_ftruncate(fd, kExtendedSize), -1);
+  EXPECT_EQ(errno, EBADF);
+  EXPECT_EQ(secure_close(fd), 0);
+}
+
+TEST_P(EnclaveStorageSecureTest, IntegrityOnlyReopenReadWriteSuccess) {
+  int fd = secure_open(GetPath().c_str(), O_WRONLY | O_CREAT | O_INTEGRITY_ONLY,
+                       S_IRWXU | S_IRWXG | S_IRWXO);
+  ASSERT_GE(fd, 0);
+  EXPECT_EQ(EmulateSetKeyIoctl(fd), 0);
+  EXPECT_EQ(secure_write(fd, GetWriteBuffer(), test_buf_len_), test_buf_len_);
+  EXPECT_EQ(secure_close(fd), 0);
 
+  // The data is stored in plaintext after the file header.
+  fd = enc_untrusted_open(GetPath().c_str(), O_RDWR);
+  ASSERT_GE(fd, 0);
+  EXPECT_EQ(enc_untrusted_lseek(fd, kFileHeaderLength, SEEK_SET),
+            kFileHeaderLength);
+  EXPECT_EQ(enc_untrusted_read(fd, GetReadBuffer(), kBlockLength),
+            kBlockLength);
+  EXPECT_EQ(memcmp(GetReadBuffer(), GetWriteBuffer(), kBlockLength), 0);
+
+  // The file is only opened in the mode it was created with.
+  int secure_fd = secure_open(GetPath().c_str(), O_RDONLY);
+  EXPECT_EQ(secure_fd, -1);
+  secure_fd = secure_open(GetPath().c_str(), O_RDONLY | O_INTEGRITY_ONLY);
+  ASSERT_GE(secure_fd, 0);
+  EXPECT_EQ(EmulateSetKeyIoctl(secure_fd), 0);
+  EXPECT_EQ(secure_read(secure_fd, GetReadBuffer(), test_buf_len_),
+            test_buf_len_);
+  EXPECT_EQ(memcmp(GetReadBuffer(), GetWriteBuffer(), test_buf_len_), 0);
+  EXPECT_EQ(secure_close(secure_fd), 0);
+
+  // Modified data fails verification.
+  EXPECT_EQ(enc_untrusted_lseek(fd, kFileHeaderLength, SEEK_SET),
+            kFileHeaderLength);
+  EXPECT_EQ(enc_untrusted_write(fd, "xx", 2), 2);
+  enc_untrusted_close(fd);
+  secure_fd = secure_open(GetPath().c_str(), O_RDONLY | O_INTEGRITY_ONLY);
+  ASSERT_GE(secure_fd, 0);
+  EXPECT_EQ(EmulateSetKeyIoctl(secure_fd), 0);
+  EXPECT_EQ(secure_read(secure_fd, GetReadBuffer(), test_buf_len_), -1);
+  EXPECT_EQ(secure_close(secure_fd), 0);
+}
+
+TEST_P(EnclaveStorageSecureTest, UnsupportedFileCreationFlagFailure) {
   // Open for write with O_TRUNC.
-  fd = secure_open(GetPath().c_str(), O_WRONLY | O_CREAT | O_TRUNC,
-                   S_IRWXU | S_IRWXG | S_IRWXO);
+  int fd = secure_open(GetPath().c_str(), O_WRONLY | O_CREAT | O_TRUNC,
+                       S_IRWXU | S_IRWXG | S_IRWXO);
   EXPECT_EQ(fd, -1);
 }
 
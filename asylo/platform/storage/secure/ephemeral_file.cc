@@ -0,0 +1,490 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/storage/secure/ephemeral_file.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <openssl/mem.h>
+#include <openssl/rand.h>
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <string>
+
+#include "absl/memory/memory.h"
+#include "absl/strings/escaping.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "asylo/platform/arch/include/trusted/host_calls.h"
+#include "asylo/util/logging.h"
+
+namespace asylo {
+namespace platform {
+namespace storage {
+namespace {
+
+constexpr size_t kKeyLength = 32;
+constexpr size_t kTagLength = 16;
+constexpr size_t kNonceLength = 12;
+
+// Length of a block on the host, its ciphertext followed by its tag.
+constexpr size_t kSealedBlockLength = kEphemeralBlockLength + kTagLength;
+
+// Largest number of blocks read or written with a single host call, which
+// bounds the memory staged for a request.
+constexpr size_t kMaxBatchBlocks = 256;
+
+// Largest size of a file, which keeps offsets on the host within off_t.
+constexpr uint64_t kMaxFileSize = uint64_t{1} << 44;
+
+// Prefix of the name a file is created under before it is unlinked.
+constexpr char kNamePrefix[] = "/.asylo_ephemeral_";
+
+// Number of random names tried before creating a file fails.
+constexpr int kMaxCreateAttempts = 8;
+
+bool is_transient_error(int err) { return (err == EAGAIN) || (err == EINTR); }
+
+// Reads from |fd| at |file_offset|. Returns -1 on failure, or min(|len|, bytes
+// to EOF) on success.
+ssize_t pread_all(int fd, void* buf, size_t len, off_t file_offset) {
+  size_t offset = 0;
+  while (offset < len) {
+    ssize_t bytes_read;
+    do {
+      bytes_read = enc_untrusted_pread(fd, static_cast<uint8_t*>(buf) + offset,
+                                       len - offset, file_offset + offset);
+    } while ((bytes_read == -1) && is_transient_error(errno));
+    if (bytes_read == -1) {
+      return -1;
+    }
+    if (bytes_read == 0) {
+      break;
+    }
+    offset += bytes_read;
+  }
+  return offset;
+}
+
+// Writes |len| bytes to |fd| at |file_offset|. Returns false on failure.
+bool pwrite_all(int fd, const void* buf, size_t len, off_t file_offset) {
+  size_t offset = 0;
+  while (offset < len) {
+    ssize_t bytes_written;
+    do {
+      bytes_written = enc_untrusted_pwrite(
+          fd, static_cast<const uint8_t*>(buf) + offset, len - offset,
+          file_offset + offset);
+    } while ((bytes_written == -1) && is_transient_error(errno));
+    if (bytes_written == -1) {
+      return false;
+    }
+    offset += bytes_written;
+  }
+  return true;
+}
+
+// Returns the number of blocks holding |size| bytes.
+uint64_t BlockCount(uint64_t size) {
+  return (size + kEphemeralBlockLength - 1) / kEphemeralBlockLength;
+}
+
+// Nonce of the |generation|th write of |block|.
+void BlockNonce(uint64_t block, uint32_t generation,
+                uint8_t nonce[kNonceLength]) {
+  memcpy(nonce, &block, sizeof(block));
+  memcpy(nonce + sizeof(block), &generation, sizeof(generation));
+}
+
+}  // namespace
+
+std::unique_ptr<EphemeralFile> EphemeralFile::Create(const char* dir_path,
+                                                     int flags, mode_t mode) {
+  int access_mode = flags & O_ACCMODE;
+  if (access_mode != O_WRONLY && access_mode != O_RDWR) {
+    errno = EINVAL;
+    return nullptr;
+  }
+
+  // Blocks partly covered by a write are read back, so the host file is
+  // always opened for reading too.
+  int host_fd = -1;
+  for (int attempt = 0; attempt < kMaxCreateAttempts && host_fd < 0;
+       ++attempt) {
+    uint8_t name[16];
+    if (RAND_bytes(name, sizeof(name)) != 1) {
+      errno = EIO;
+      return nullptr;
+    }
+    std::string path = absl::StrCat(
+        dir_path, kNamePrefix,
+        absl::BytesToHexString(absl::string_view(
+            reinterpret_cast<const char*>(name), sizeof(name))));
+    host_fd = enc_untrusted_open(path.c_str(), O_RDWR | O_CREAT | O_EXCL, mode);
+    if (host_fd < 0) {
+      if (errno == EEXIST) {
+        continue;
+      }
+      LOG(ERROR) << "Failed to create ephemeral file in " << dir_path;
+      return nullptr;
+    }
+    if (enc_untrusted_unlink(path.c_str()) != 0) {
+      int unlink_errno = errno;
+      LOG(ERROR) << "Failed to unlink ephemeral file " << path;
+      enc_untrusted_close(host_fd);
+      errno = unlink_errno;
+      return nullptr;
+    }
+  }
+  if (host_fd < 0) {
+    return nullptr;
+  }
+
+  auto file = absl::WrapUnique(new EphemeralFile(host_fd, flags));
+  uint8_t key[kKeyLength];
+  bool keyed = RAND_bytes(key, sizeof(key)) == 1 &&
+               EVP_AEAD_CTX_init(&file->context_, EVP_aead_aes_256_gcm(), key,
+                                 sizeof(key), kTagLength, nullptr) == 1;
+  OPENSSL_cleanse(key, sizeof(key));
+  if (!keyed) {
+    LOG(ERROR) << "Failed to generate the key of an ephemeral file";
+    errno = EIO;
+    return nullptr;
+  }
+  return file;
+}
+
+EphemeralFile::EphemeralFile(int host_fd, int flags)
+    : host_fd_(host_fd),
+      readable_((flags & O_ACCMODE) == O_RDWR),
+      is_append_(flags & O_APPEND),
+      closed_(false),
+      size_(0),
+      cursor_(0) {
+  EVP_AEAD_CTX_zero(&context_);
+}
+
+EphemeralFile::~EphemeralFile() {
+  {
+    absl::MutexLock lock(&mu_);
+    if (!closed_) {
+      enc_untrusted_close(host_fd_);
+    }
+  }
+  EVP_AEAD_CTX_cleanup(&context_);
+}
+
+ssize_t EphemeralFile::Read(void* buf, size_t count) {
+  if (!readable_) {
+    errno = EBADF;
+    return -1;
+  }
+  absl::MutexLock lock(&mu_);
+  ssize_t bytes_read = PreadLocked(buf, count, cursor_);
+  if (bytes_read > 0) {
+    cursor_ += bytes_read;
+  }
+  return bytes_read;
+}
+
+ssize_t EphemeralFile::Write(const void* buf, size_t count) {
+  absl::MutexLock lock(&mu_);
+  uint64_t offset = is_append_ ? size_ : cursor_;
+  ssize_t bytes_written = PwriteLocked(buf, count, offset);
+  if (bytes_written >= 0) {
+    cursor_ = offset + bytes_written;
+  }
+  return bytes_written;
+}
+
+ssize_t EphemeralFile::Pread(void* buf, size_t count, off_t offset) {
+  if (!readable_) {
+    errno = EBADF;
+    return -1;
+  }
+  if (offset < 0) {
+    errno = EINVAL;
+    return -1;
+  }
+  absl::ReaderMutexLock lock(&mu_);
+  return PreadLocked(buf, count, offset);
+}
+
+ssize_t EphemeralFile::Pwrite(const void* buf, size_t count, off_t offset) {
+  if (offset < 0) {
+    errno = EINVAL;
+    return -1;
+  }
+  absl::MutexLock lock(&mu_);
+  return PwriteLocked(buf, count, offset);
+}
+
+off_t EphemeralFile::LSeek(off_t offset, int whence) {
+  absl::MutexLock lock(&mu_);
+  off_t base;
+  switch (whence) {
+    case SEEK_SET:
+      base = 0;
+      break;
+    case SEEK_CUR:
+      base = cursor_;
+      break;
+    case SEEK_END:
+      base = size_;
+      break;
+    default:
+      errno = EINVAL;
+      return -1;
+  }
+  if ((offset < 0 && base < -offset) ||
+      (offset > 0 && offset > static_cast<off_t>(kMaxFileSize) - base)) {
+    errno = EINVAL;
+    return -1;
+  }
+  cursor_ = base + offset;
+  return cursor_;
+}
+
+int EphemeralFile::Truncate(off_t length) {
+  if (length < 0 || static_cast<uint64_t>(length) > kMaxFileSize) {
+    errno = EINVAL;
+    return -1;
+  }
+  absl::MutexLock lock(&mu_);
+  if (static_cast<uint64_t>(length) < size_) {
+    // Blocks past the new end no longer hold data. The tail of the new last
+    // block is cleared, so that it reads as zeros if the file is extended
+    // again.
+    uint64_t block_count = BlockCount(length);
+    if (block_count < stored_.size()) {
+      std::fill(stored_.begin() + block_count, stored_.end(), false);
+    }
+    size_t tail = length % kEphemeralBlockLength;
+    if (tail != 0 && IsStored(block_count - 1)) {
+      std::vector<uint8_t> block(kEphemeralBlockLength);
+      if (!ReadBlocks(block_count - 1, 1, block.data())) {
+        return -1;
+      }
+      memset(block.data() + tail, 0, kEphemeralBlockLength - tail);
+      if (!WriteBlocks(block_count - 1, 1,
+                       [&block](size_t) { return block.data(); })) {
+        return -1;
+      }
+    }
+  }
+  size_ = length;
+  return 0;
+}
+
+off_t EphemeralFile::size() {
+  absl::ReaderMutexLock lock(&mu_);
+  return size_;
+}
+
+int EphemeralFile::Close() {
+  absl::MutexLock lock(&mu_);
+  if (closed_) {
+    errno = EBADF;
+    return -1;
+  }
+  closed_ = true;
+  generations_.clear();
+  stored_.clear();
+  return enc_untrusted_close(host_fd_);
+}
+
+bool EphemeralFile::ReadBlocks(uint64_t first_block, size_t count,
+                               uint8_t* blocks) const {
+  // Blocks past the last one holding data are not read from the host.
+  size_t stored_count = count;
+  while (stored_count > 0 && !IsStored(first_block + stored_count - 1)) {
+    --stored_count;
+  }
+  std::vector<uint8_t> sealed(stored_count * kSealedBlockLength);
+  ssize_t bytes_read = 0;
+  if (stored_count > 0) {
+    bytes_read = pread_all(host_fd_, sealed.data(), sealed.size(),
+                           first_block * kSealedBlockLength);
+    if (bytes_read < 0) {
+      return false;
+    }
+  }
+
+  for (size_t i = 0; i < count; ++i) {
+    uint64_t block = first_block + i;
+    uint8_t* plaintext = blocks + i * kEphemeralBlockLength;
+    if (!IsStored(block)) {
+      memset(plaintext, 0, kEphemeralBlockLength);
+      continue;
+    }
+    if ((i + 1) * kSealedBlockLength > static_cast<size_t>(bytes_read)) {
+      LOG(ERROR) << "Ephemeral file is missing block " << block;
+      errno = EIO;
+      return false;
+    }
+    uint8_t nonce[kNonceLength];
+    BlockNonce(block, generations_[block], nonce);
+    size_t plaintext_length;
+    if (!EVP_AEAD_CTX_open(&context_, plaintext, &plaintext_length,
+                           kEphemeralBlockLength, nonce, sizeof(nonce),
+                           sealed.data() + i * kSealedBlockLength,
+                           kSealedBlockLength,
+                           reinterpret_cast<const uint8_t*>(&block),
+                           sizeof(block)) ||
+        plaintext_length != kEphemeralBlockLength) {
+      LOG(ERROR) << "Failed to authenticate block " << block
+                 << " of an ephemeral file";
+      errno = EIO;
+      return false;
+    }
+  }
+  return true;
+}
+
+bool EphemeralFile::WriteBlocks(
+    uint64_t first_block, size_t count,
+    const std::function<const uint8_t*(size_t)>& plaintext_block) {
+  uint64_t end_block = first_block + count;
+  if (generations_.size() < end_block) {
+    generations_.resize(end_block, 0);
+    stored_.resize(end_block, false);
+  }
+
+  write_buffer_.resize(count * kSealedBlockLength);
+  for (size_t i = 0; i < count; ++i) {
+    uint64_t block = first_block + i;
+    // The generation is advanced before sealing and never rolled back, even
+    // if the write fails, since the host may have seen the sealed block.
+    if (generations_[block] == std::numeric_limits<uint32_t>::max()) {
+      errno = EOVERFLOW;
+      return false;
+    }
+    ++generations_[block];
+    stored_[block] = true;
+
+    uint8_t nonce[kNonceLength];
+    BlockNonce(block, generations_[block], nonce);
+    size_t sealed_length;
+    if (!EVP_AEAD_CTX_seal(&context_, write_buffer_.data() +
+                                          i * kSealedBlockLength,
+                           &sealed_length, kSealedBlockLength, nonce,
+                           sizeof(nonce), plaintext_block(i),
+                           kEphemeralBlockLength,
+                           reinterpret_cast<const uint8_t*>(&block),
+                           sizeof(block))) {
+      LOG(ERROR) << "Failed to seal block " << block
+                 << " of an ephemeral file";
+      errno = EIO;
+      return false;
+    }
+  }
+  return pwrite_all(host_fd_, write_buffer_.data(), write_buffer_.size(),
+                    first_block * kSealedBlockLength);
+}
+
+ssize_t EphemeralFile::PreadLocked(void* buf, size_t count,
+                                   uint64_t offset) const {
+  if (offset >= size_) {
+    return 0;
+  }
+  count = std::min<uint64_t>(count, size_ - offset);
+
+  uint8_t* out = static_cast<uint8_t*>(buf);
+  std::vector<uint8_t> blocks;
+  size_t done = 0;
+  while (done < count) {
+    uint64_t position = offset + done;
+    size_t block_offset = position % kEphemeralBlockLength;
+    size_t block_count = std::min<uint64_t>(
+        kMaxBatchBlocks, BlockCount(block_offset + count - done));
+    blocks.resize(block_count * kEphemeralBlockLength);
+    if (!ReadBlocks(position / kEphemeralBlockLength, block_count,
+                    blocks.data())) {
+      return done > 0 ? done : -1;
+    }
+    size_t length = std::min(count - done, blocks.size() - block_offset);
+    memcpy(out + done, blocks.data() + block_offset, length);
+    done += length;
+  }
+  return done;
+}
+
+ssize_t EphemeralFile::PwriteLocked(const void* buf, size_t count,
+                                    uint64_t offset) {
+  if (offset > kMaxFileSize || count > kMaxFileSize - offset) {
+    errno = EFBIG;
+    return -1;
+  }
+
+  const uint8_t* data = static_cast<const uint8_t*>(buf);
+  std::vector<uint8_t> edges;
+  size_t done = 0;
+  while (done < count) {
+    uint64_t position = offset + done;
+    uint64_t first_block = position / kEphemeralBlockLength;
+    size_t block_offset = position % kEphemeralBlockLength;
+    size_t block_count = std::min<uint64_t>(
+        kMaxBatchBlocks, BlockCount(block_offset + count - done));
+    size_t length = std::min(
+        count - done, block_count * kEphemeralBlockLength - block_offset);
+
+    // Blocks only partly covered by the write are merged with their contents.
+    size_t last_end = (block_offset + length) % kEphemeralBlockLength;
+    bool first_partial = block_offset != 0 || length < kEphemeralBlockLength;
+    bool last_partial = last_end != 0 && block_count > 1;
+    edges.resize(2 * kEphemeralBlockLength);
+    uint8_t* first_edge = edges.data();
+    uint8_t* last_edge = edges.data() + kEphemeralBlockLength;
+    if (first_partial) {
+      if (!ReadBlocks(first_block, 1, first_edge)) {
+        return done > 0 ? done : -1;
+      }
+      memcpy(first_edge + block_offset, data + done,
+             std::min(length, kEphemeralBlockLength - block_offset));
+    }
+    if (last_partial) {
+      if (!ReadBlocks(first_block + block_count - 1, 1, last_edge)) {
+        return done > 0 ? done : -1;
+      }
+      memcpy(last_edge, data + done + length - last_end, last_end);
+    }
+
+    bool written = WriteBlocks(
+        first_block, block_count, [&](size_t i) -> const uint8_t* {
+          if (i == 0 && first_partial) {
+            return first_edge;
+          }
+          if (i == block_count - 1 && last_partial) {
+            return last_edge;
+          }
+          return data + done + (i * kEphemeralBlockLength - block_offset);
+        });
+    if (!written) {
+      return done > 0 ? done : -1;
+    }
+    done += length;
+    size_ = std::max<uint64_t>(size_, offset + done);
+  }
+  return done;
+}
+
+}  // namespace storage
+}  // namespace platform
+}  // namespace asylo
@@ -0,0 +1,151 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_PLATFORM_STORAGE_SECURE_EPHEMERAL_FILE_H_
+#define ASYLO_PLATFORM_STORAGE_SECURE_EPHEMERAL_FILE_H_
+
+#include <openssl/aead.h>
+#include <sys/types.h>
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/synchronization/mutex.h"
+
+namespace asylo {
+namespace platform {
+namespace storage {
+
+// Length of plaintext in each block of an ephemeral file.
+constexpr size_t kEphemeralBlockLength = 4096;
+
+// An unnamed scratch file kept in an untrusted directory, for data that does
+// not outlive the enclave, such as sort spills and intermediate results.
+//
+// Unlike files handled by AeadHandler, an ephemeral file has no header, no
+// integrity index and no persistent key. It is encrypted with AES-256-GCM
+// under a random key generated when the file is created and held only in the
+// enclave, and each block is sealed with its index as associated data. The
+// enclave keeps a 32-bit write generation per block, which forms the nonce
+// together with the block index, so the host cannot move, replace or roll
+// back blocks without failing their authentication, and no integrity metadata
+// is written. Blocks that were never written are not stored and read as zeros.
+//
+// The file is unlinked from the directory as soon as it is created, so its
+// storage is released by the host once it is closed, and the data cannot be
+// read once the enclave drops the key.
+//
+// Methods follow the conventions of the corresponding POSIX calls, returning
+// -1 with errno set on failure, and may be called concurrently from several
+// threads.
+class EphemeralFile {
+ public:
+  // Creates an ephemeral file in the host directory |dir_path|, with the
+  // permissions |mode| and the access mode and O_APPEND flag of |flags|. The
+  // file must be opened for writing. Returns nullptr with errno set on
+  // failure.
+  static std::unique_ptr<EphemeralFile> Create(const char* dir_path, int flags,
+                                               mode_t mode);
+
+  EphemeralFile(const EphemeralFile&) = delete;
+  EphemeralFile& operator=(const EphemeralFile&) = delete;
+
+  // Closes the host file if Close was not called.
+  ~EphemeralFile();
+
+  ssize_t Read(void* buf, size_t count) LOCKS_EXCLUDED(mu_);
+  ssize_t Write(const void* buf, size_t count) LOCKS_EXCLUDED(mu_);
+
+  // Read and write at |offset| without using or moving the file offset. Reads
+  // do not exclude each other.
+  ssize_t Pread(void* buf, size_t count, off_t offset) LOCKS_EXCLUDED(mu_);
+  ssize_t Pwrite(const void* buf, size_t count, off_t offset)
+      LOCKS_EXCLUDED(mu_);
+
+  off_t LSeek(off_t offset, int whence) LOCKS_EXCLUDED(mu_);
+
+  // Sets the size of the file to |length|. Extending the file does not write
+  // to the host.
+  int Truncate(off_t length) LOCKS_EXCLUDED(mu_);
+
+  // Returns the size of the file.
+  off_t size() LOCKS_EXCLUDED(mu_);
+
+  // Closes the host file, which releases its storage.
+  int Close() LOCKS_EXCLUDED(mu_);
+
+  // Returns the descriptor of the host file.
+  int host_fd() const { return host_fd_; }
+
+ private:
+  EphemeralFile(int host_fd, int flags);
+
+  // Reads the plaintext of the |count| blocks starting at |first_block| into
+  // |blocks|, with a single host read for the blocks that were written.
+  // Returns false with errno set on failure.
+  bool ReadBlocks(uint64_t first_block, size_t count, uint8_t* blocks) const
+      SHARED_LOCKS_REQUIRED(mu_);
+
+  // Seals the |count| blocks starting at |first_block|, whose plaintexts are
+  // returned by |plaintext_block| called with indices relative to
+  // |first_block|, and writes them to the host with a single host write.
+  // Returns false with errno set on failure.
+  bool WriteBlocks(uint64_t first_block, size_t count,
+                   const std::function<const uint8_t*(size_t)>& plaintext_block)
+      EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  // Returns whether |block| holds data stored on the host.
+  bool IsStored(uint64_t block) const SHARED_LOCKS_REQUIRED(mu_) {
+    return block < stored_.size() && stored_[block];
+  }
+
+  ssize_t PreadLocked(void* buf, size_t count, uint64_t offset) const
+      SHARED_LOCKS_REQUIRED(mu_);
+  ssize_t PwriteLocked(const void* buf, size_t count, uint64_t offset)
+      EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  int host_fd_;
+  const bool readable_;
+  const bool is_append_;
+  EVP_AEAD_CTX context_;
+
+  absl::Mutex mu_;
+  bool closed_ GUARDED_BY(mu_);
+  uint64_t size_ GUARDED_BY(mu_);
+  uint64_t cursor_ GUARDED_BY(mu_);
+
+  // Write generation of each block, and whether the block holds data. Blocks
+  // past the end of the vectors, and blocks cut off by Truncate, read as
+  // zeros. Generations never decrease, even for blocks that no longer hold
+  // data, so that no nonce is used twice. The vectors only grow on writes, so
+  // that extending the file takes constant time.
+  std::vector<uint32_t> generations_ GUARDED_BY(mu_);
+  std::vector<bool> stored_ GUARDED_BY(mu_);
+
+  // Staging space for the sealed blocks of a write.
+  std::vector<uint8_t> write_buffer_ GUARDED_BY(mu_);
+};
+
+}  // namespace storage
+}  // namespace platform
+}  // namespace asylo
+
+#endif  // ASYLO_PLATFORM_STORAGE_SECURE_EPHEMERAL_FILE_H_
@@ -0,0 +1,175 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+// Tests of ephemeral secure files.
+
+#include "asylo/platform/storage/secure/ephemeral_file.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#include <random>
+#include <string>
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include "asylo/platform/arch/include/trusted/host_calls.h"
+#include "asylo/test/util/test_flags.h"
+
+namespace asylo {
+namespace {
+
+using platform::storage::EphemeralFile;
+using platform::storage::kEphemeralBlockLength;
+
+class EphemeralFileTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    file_ = EphemeralFile::Create(FLAGS_test_tmpdir.c_str(), O_RDWR,
+                                  S_IRUSR | S_IWUSR);
+    ASSERT_NE(file_, nullptr);
+  }
+
+  // Returns |length| bytes of |file_| read at |offset|.
+  std::string ReadAt(off_t offset, size_t length) {
+    std::string data(length, '\0');
+    ssize_t bytes_read = file_->Pread(&data[0], length, offset);
+    EXPECT_GE(bytes_read, 0);
+    data.resize(std::max<ssize_t>(bytes_read, 0));
+    return data;
+  }
+
+  std::unique_ptr<EphemeralFile> file_;
+};
+
+TEST_F(EphemeralFileTest, MatchesPlainFileModel) {
+  // Random writes, reads and truncations are checked against a string holding
+  // the expected contents.
+  std::mt19937 random(1);
+  std::string model;
+  for (int iter = 0; iter < 300; ++iter) {
+    size_t offset = random() % (6 * kEphemeralBlockLength);
+    size_t length = random() % (3 * kEphemeralBlockLength);
+    switch (random() % 4) {
+      case 0:
+      case 1: {
+        std::string data(length, static_cast<char>('a' + iter % 26));
+        ASSERT_EQ(file_->Pwrite(data.data(), length, offset), length);
+        if (model.size() < offset + length) {
+          model.resize(offset + length, '\0');
+        }
+        model.replace(offset, length, data);
+      } break;
+      case 2: {
+        ASSERT_EQ(file_->Truncate(offset), 0);
+        model.resize(offset, '\0');
+      } break;
+      case 3: {
+        std::string expected =
+            offset < model.size() ? model.substr(offset, length) : "";
+        ASSERT_EQ(ReadAt(offset, length), expected) << iter;
+      } break;
+    }
+    ASSERT_EQ(file_->size(), model.size());
+  }
+  EXPECT_EQ(ReadAt(0, model.size()), model);
+}
+
+TEST_F(EphemeralFileTest, CursorAndAppend) {
+  EXPECT_EQ(file_->Write("hello ", 6), 6);
+  EXPECT_EQ(file_->Write("world", 5), 5);
+  EXPECT_EQ(file_->LSeek(0, SEEK_CUR), 11);
+  EXPECT_EQ(file_->LSeek(-5, SEEK_END), 6);
+  char buf[5];
+  EXPECT_EQ(file_->Read(buf, sizeof(buf)), sizeof(buf));
+  EXPECT_EQ(std::string(buf, sizeof(buf)), "world");
+  EXPECT_EQ(file_->Read(buf, sizeof(buf)), 0);
+  EXPECT_EQ(file_->LSeek(-1, SEEK_SET), -1);
+  EXPECT_EQ(errno, EINVAL);
+
+  std::unique_ptr<EphemeralFile> append_file = EphemeralFile::Create(
+      FLAGS_test_tmpdir.c_str(), O_WRONLY | O_APPEND, S_IRUSR | S_IWUSR);
+  ASSERT_NE(append_file, nullptr);
+  EXPECT_EQ(append_file->Write("abc", 3), 3);
+  EXPECT_EQ(append_file->LSeek(0, SEEK_SET), 0);
+  EXPECT_EQ(append_file->Write("def", 3), 3);
+  EXPECT_EQ(append_file->size(), 6);
+  EXPECT_EQ(append_file->Read(buf, sizeof(buf)), -1);
+  EXPECT_EQ(errno, EBADF);
+}
+
+TEST_F(EphemeralFileTest, ExtensionIsNotStored) {
+  constexpr off_t kSize = off_t{1} << 30;
+  ASSERT_EQ(file_->Truncate(kSize), 0);
+  EXPECT_EQ(file_->size(), kSize);
+  EXPECT_EQ(enc_untrusted_lseek(file_->host_fd(), 0, SEEK_END), 0);
+  EXPECT_EQ(ReadAt(kSize - 10, 20), std::string(10, '\0'));
+}
+
+TEST_F(EphemeralFileTest, HostSeesOnlyCiphertext) {
+  const std::string data(2 * kEphemeralBlockLength, 'x');
+  ASSERT_EQ(file_->Pwrite(data.data(), data.size(), 0), data.size());
+
+  std::string stored(4 * kEphemeralBlockLength, '\0');
+  ssize_t stored_length = enc_untrusted_pread(file_->host_fd(), &stored[0],
+                                              stored.size(), 0);
+  ASSERT_GT(stored_length, data.size());
+  stored.resize(stored_length);
+  EXPECT_EQ(stored.find(std::string(64, 'x')), std::string::npos);
+}
+
+TEST_F(EphemeralFileTest, ModifiedBlockFails) {
+  const std::string data(kEphemeralBlockLength, 'x');
+  ASSERT_EQ(file_->Pwrite(data.data(), data.size(), 0), data.size());
+  ASSERT_EQ(enc_untrusted_pwrite(file_->host_fd(), "y", 1, 10), 1);
+
+  char buf[16];
+  EXPECT_EQ(file_->Pread(buf, sizeof(buf), 0), -1);
+  EXPECT_EQ(errno, EIO);
+}
+
+TEST_F(EphemeralFileTest, ReplayedBlockFails) {
+  std::string data(kEphemeralBlockLength, 'x');
+  ASSERT_EQ(file_->Pwrite(data.data(), data.size(), 0), data.size());
+  std::vector<char> old_block(2 * kEphemeralBlockLength);
+  ssize_t old_length = enc_untrusted_pread(file_->host_fd(), old_block.data(),
+                                           old_block.size(), 0);
+  ASSERT_GT(old_length, 0);
+
+  data.assign(kEphemeralBlockLength, 'z');
+  ASSERT_EQ(file_->Pwrite(data.data(), data.size(), 0), data.size());
+  ASSERT_EQ(
+      enc_untrusted_pwrite(file_->host_fd(), old_block.data(), old_length, 0),
+      old_length);
+
+  char buf[16];
+  EXPECT_EQ(file_->Pread(buf, sizeof(buf), 0), -1);
+  EXPECT_EQ(errno, EIO);
+}
+
+TEST(EphemeralFileCreateTest, ReadOnlyFails) {
+  EXPECT_EQ(EphemeralFile::Create(FLAGS_test_tmpdir.c_str(), O_RDONLY,
+                                  S_IRUSR | S_IWUSR),
+            nullptr);
+  EXPECT_EQ(errno, EINVAL);
+}
+
+}  // namespace
+}  // namespace asylo
@@ -0,0 +1,859 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/storage/secure/kv_store.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <openssl/hmac.h>
+#include <openssl/mem.h>
+#include <openssl/rand.h>
+#include <openssl/sha.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <cstring>
+
+#include "absl/memory/memory.h"
+#include "absl/strings/str_cat.h"
+#include "asylo/platform/arch/include/trusted/host_calls.h"
+#include "asylo/util/logging.h"
+#include "asylo/util/posix_error_space.h"
+#include "asylo/util/status_macros.h"
+
+namespace asylo {
+namespace platform {
+namespace storage {
+namespace {
+
+// Identifies a header slot of a store, "AsyloKV1".
+constexpr uint64_t kHeaderMagic = 0x31564b6f6c797341;
+
+// Size of each of the two header slots.
+constexpr size_t kHeaderSlotSize = 4096;
+
+constexpr size_t kSaltLength = 32;
+constexpr size_t kMacLength = SHA256_DIGEST_LENGTH;
+constexpr size_t kTagLength = 16;
+constexpr size_t kNonceLength = 12;
+
+// Largest plaintext of a record. Larger lengths read from a segment are
+// rejected before any memory is allocated for them.
+constexpr size_t kMaxRecordLength = 16 * 1024 * 1024;
+
+// Size of the reads of replay and compaction, and of the writes of
+// compaction.
+constexpr size_t kIoBufferSize = 1024 * 1024;
+
+constexpr uint8_t kPutRecord = 1;
+constexpr uint8_t kDeleteRecord = 2;
+
+constexpr char kHeaderKeyLabel[] = "kv store header";
+constexpr char kSegmentKeyLabel[] = "kv store segment";
+
+struct HeaderPrefix {
+  uint64_t magic;
+  uint64_t generation;
+  uint64_t next_segment_id;
+  uint64_t segment_count;
+} __attribute__((packed));
+
+struct SegmentEntry {
+  uint64_t id;
+  uint64_t length;
+  uint8_t salt[kSaltLength];
+} __attribute__((packed));
+
+static_assert(sizeof(HeaderPrefix) +
+                      kKvStoreMaxSegments * sizeof(SegmentEntry) +
+                      kMacLength <=
+                  kHeaderSlotSize,
+              "Header slot too small for the largest header");
+
+// A record is stored as its sealed length, which is authenticated as
+// associated data, followed by the sealed RecordHeader, key and value.
+using SealedLength = uint32_t;
+
+struct RecordHeader {
+  uint8_t type;
+  uint32_t key_length;
+  uint32_t value_length;
+} __attribute__((packed));
+
+bool is_transient_error(int err) { return (err == EAGAIN) || (err == EINTR); }
+
+Status ErrnoStatus(const std::string& operation) {
+  return Status(static_cast<error::PosixError>(errno),
+                absl::StrCat(operation, " failed"));
+}
+
+// Reads from |fd| at |file_offset|. Returns -1 on failure, or min(|len|, bytes
+// to EOF) on success.
+ssize_t pread_all(int fd, void* buf, size_t len, off_t file_offset) {
+  size_t offset = 0;
+  while (offset < len) {
+    ssize_t bytes_read;
+    do {
+      bytes_read = enc_untrusted_pread(fd, static_cast<uint8_t*>(buf) + offset,
+                                       len - offset, file_offset + offset);
+    } while ((bytes_read == -1) && is_transient_error(errno));
+    if (bytes_read == -1) {
+      return -1;
+    }
+    if (bytes_read == 0) {
+      break;
+    }
+    offset += bytes_read;
+  }
+  return offset;
+}
+
+// Writes |len| bytes to |fd| at |file_offset|.
+Status pwrite_all(int fd, const void* buf, size_t len, off_t file_offset) {
+  size_t offset = 0;
+  while (offset < len) {
+    ssize_t bytes_written;
+    do {
+      bytes_written = enc_untrusted_pwrite(
+          fd, static_cast<const uint8_t*>(buf) + offset, len - offset,
+          file_offset + offset);
+    } while ((bytes_written == -1) && is_transient_error(errno));
+    if (bytes_written == -1) {
+      return ErrnoStatus("pwrite");
+    }
+    offset += bytes_written;
+  }
+  return Status::OkStatus();
+}
+
+// Derives a key from |key| for |label| and |salt| with HMAC-SHA256.
+Status DeriveKey(ByteContainerView key, const char* label, const uint8_t* salt,
+                 size_t salt_length, CleansingVector<uint8_t>* derived_key) {
+  CleansingVector<uint8_t> message(label, label + strlen(label));
+  message.insert(message.end(), salt, salt + salt_length);
+  derived_key->resize(SHA256_DIGEST_LENGTH);
+  unsigned int length = 0;
+  if (!HMAC(EVP_sha256(), key.data(), key.size(), message.data(),
+            message.size(), derived_key->data(), &length) ||
+      length != derived_key->size()) {
+    return Status(error::GoogleError::INTERNAL, "Failed to derive key");
+  }
+  return Status::OkStatus();
+}
+
+// Returns the nonce of the record at |offset| of a segment.
+void RecordNonce(uint64_t offset, uint8_t nonce[kNonceLength]) {
+  memset(nonce, 0, kNonceLength);
+  memcpy(nonce + kNonceLength - sizeof(offset), &offset, sizeof(offset));
+}
+
+// Decrypts the |record_length|-byte |record| found at |offset| of the segment
+// with |context| into |plaintext|, and checks its header.
+Status OpenRecord(const EVP_AEAD_CTX* context, uint64_t offset,
+                  const uint8_t* record, size_t record_length,
+                  CleansingVector<uint8_t>* plaintext, RecordHeader* header) {
+  uint8_t nonce[kNonceLength];
+  RecordNonce(offset, nonce);
+  const size_t sealed_length = record_length - sizeof(SealedLength);
+  plaintext->resize(sealed_length);
+  size_t plaintext_length = 0;
+  if (!EVP_AEAD_CTX_open(context, plaintext->data(), &plaintext_length,
+                         plaintext->size(), nonce, sizeof(nonce),
+                         record + sizeof(SealedLength), sealed_length, record,
+                         sizeof(SealedLength))) {
+    return Status(error::GoogleError::DATA_LOSS,
+                  absl::StrCat("Record at offset ", offset,
+                               " failed authentication"));
+  }
+  if (plaintext_length < sizeof(RecordHeader)) {
+    return Status(error::GoogleError::DATA_LOSS, "Malformed record");
+  }
+  memcpy(header, plaintext->data(), sizeof(*header));
+  if ((header->type != kPutRecord && header->type != kDeleteRecord) ||
+      sizeof(RecordHeader) + static_cast<uint64_t>(header->key_length) +
+              header->value_length !=
+          plaintext_length) {
+    return Status(error::GoogleError::DATA_LOSS, "Malformed record");
+  }
+  return Status::OkStatus();
+}
+
+// Encrypts a record of |type|, |key| and |value| at |offset| of the segment
+// with |context|, appending it to |buffer|. Returns the length of the stored
+// record.
+StatusOr<uint32_t> SealRecord(const EVP_AEAD_CTX* context, uint64_t offset,
+                              uint8_t type, ByteContainerView key,
+                              ByteContainerView value,
+                              std::vector<uint8_t>* buffer) {
+  const size_t plaintext_length =
+      sizeof(RecordHeader) + key.size() + value.size();
+  if (plaintext_length > kMaxRecordLength) {
+    return Status(error::GoogleError::INVALID_ARGUMENT,
+                  absl::StrCat("Record of ", plaintext_length,
+                               " bytes exceeds the limit of ",
+                               kMaxRecordLength));
+  }
+  const SealedLength sealed_length = plaintext_length + kTagLength;
+  const RecordHeader header = {type, static_cast<uint32_t>(key.size()),
+                               static_cast<uint32_t>(value.size())};
+
+  // The record is assembled in |buffer| and sealed in place.
+  const size_t start = buffer->size();
+  buffer->resize(start + sizeof(SealedLength) + sealed_length);
+  uint8_t* record = buffer->data() + start;
+  uint8_t* plaintext = record + sizeof(SealedLength);
+  memcpy(record, &sealed_length, sizeof(sealed_length));
+  memcpy(plaintext, &header, sizeof(header));
+  memcpy(plaintext + sizeof(header), key.data(), key.size());
+  memcpy(plaintext + sizeof(header) + key.size(), value.data(), value.size());
+
+  uint8_t nonce[kNonceLength];
+  RecordNonce(offset, nonce);
+  size_t out_length = 0;
+  if (!EVP_AEAD_CTX_seal(context, plaintext, &out_length, sealed_length, nonce,
+                         sizeof(nonce), plaintext, plaintext_length, record,
+                         sizeof(SealedLength)) ||
+      out_length != sealed_length) {
+    OPENSSL_cleanse(plaintext, plaintext_length);
+    buffer->resize(start);
+    return Status(error::GoogleError::INTERNAL, "Failed to seal record");
+  }
+  return sizeof(SealedLength) + sealed_length;
+}
+
+// Reads a segment sequentially through a buffer, so that consecutive records
+// are read from the host together.
+class SegmentReader {
+ public:
+  SegmentReader(int fd, uint64_t length)
+      : fd_(fd), length_(length), buffer_offset_(0), buffer_size_(0) {}
+
+  // Points |data| at the |size| bytes at |offset|, which must lie within the
+  // committed length of the segment.
+  Status Read(uint64_t offset, size_t size, const uint8_t** data) {
+    if (offset > length_ || size > length_ - offset) {
+      return Status(error::GoogleError::DATA_LOSS,
+                    "Record extends past the committed segment");
+    }
+    if (offset < buffer_offset_ ||
+        offset + size > buffer_offset_ + buffer_size_) {
+      buffer_.resize(std::max(kIoBufferSize, size));
+      const size_t read_size =
+          std::min<uint64_t>(buffer_.size(), length_ - offset);
+      if (pread_all(fd_, buffer_.data(), read_size, offset) !=
+          static_cast<ssize_t>(read_size)) {
+        return Status(error::GoogleError::DATA_LOSS,
+                      "Failed to read committed segment data");
+      }
+      buffer_offset_ = offset;
+      buffer_size_ = read_size;
+    }
+    *data = buffer_.data() + (offset - buffer_offset_);
+    return Status::OkStatus();
+  }
+
+  // Points |data| at the record at |offset| and sets |record_length| to its
+  // stored length.
+  Status ReadRecord(uint64_t offset, const uint8_t** data,
+                    size_t* record_length) {
+    ASYLO_RETURN_IF_ERROR(Read(offset, sizeof(SealedLength), data));
+    SealedLength sealed_length;
+    memcpy(&sealed_length, *data, sizeof(sealed_length));
+    if (sealed_length < sizeof(RecordHeader) + kTagLength ||
+        sealed_length > kMaxRecordLength + kTagLength) {
+      return Status(error::GoogleError::DATA_LOSS, "Malformed record length");
+    }
+    *record_length = sizeof(SealedLength) + sealed_length;
+    return Read(offset, *record_length, data);
+  }
+
+ private:
+  const int fd_;
+  const uint64_t length_;
+  std::vector<uint8_t> buffer_;
+  uint64_t buffer_offset_;
+  size_t buffer_size_;
+};
+
+}  // namespace
+
+void KvWriteBatch::Put(ByteContainerView key, ByteContainerView value) {
+  updates_.push_back(
+      {false, std::string(key.begin(), key.end()),
+       CleansingString(value.begin(), value.end())});
+}
+
+void KvWriteBatch::Delete(ByteContainerView key) {
+  updates_.push_back(
+      {true, std::string(key.begin(), key.end()), CleansingString()});
+}
+
+SecureKvStore::Segment::Segment() : id(0), fd(-1), length(0), live_bytes(0) {
+  EVP_AEAD_CTX_zero(&context);
+}
+
+SecureKvStore::Segment::~Segment() {
+  EVP_AEAD_CTX_cleanup(&context);
+  if (fd != -1) {
+    enc_untrusted_close(fd);
+  }
+}
+
+SecureKvStore::SecureKvStore(const std::string& path,
+                             const KvStoreOptions& options)
+    : path_(path),
+      options_(options),
+      header_fd_(-1),
+      generation_(0),
+      next_segment_id_(0),
+      compaction_requested_(false),
+      closing_(false) {}
+
+SecureKvStore::~SecureKvStore() {
+  {
+    absl::MutexLock lock(&mu_);
+    closing_ = true;
+  }
+  if (compaction_thread_.joinable()) {
+    compaction_thread_.join();
+  }
+  if (header_fd_ != -1) {
+    enc_untrusted_close(header_fd_);
+  }
+}
+
+StatusOr<std::unique_ptr<SecureKvStore>> SecureKvStore::Open(
+    const std::string& path, ByteContainerView key,
+    const KvStoreOptions& options) {
+  if (key.size() != kKvStoreKeyLength) {
+    return Status(error::GoogleError::INVALID_ARGUMENT,
+                  absl::StrCat("Store key must be ", kKvStoreKeyLength,
+                               " bytes long"));
+  }
+  std::unique_ptr<SecureKvStore> store(new SecureKvStore(path, options));
+  ASYLO_RETURN_IF_ERROR(store->Initialize(key));
+  if (options.background_compaction) {
+    store->compaction_thread_ =
+        std::thread(&SecureKvStore::CompactionLoop, store.get());
+  }
+  return std::move(store);
+}
+
+Status SecureKvStore::Initialize(ByteContainerView key) {
+  ASYLO_RETURN_IF_ERROR(
+      DeriveKey(key, kHeaderKeyLabel, nullptr, 0, &header_key_));
+  ASYLO_RETURN_IF_ERROR(
+      DeriveKey(key, kSegmentKeyLabel, nullptr, 0, &segment_key_));
+
+  header_fd_ = enc_untrusted_open(path_.c_str(), O_RDWR | O_CREAT,
+                                  S_IRUSR | S_IWUSR);
+  if (header_fd_ == -1) {
+    return ErrnoStatus(absl::StrCat("Opening ", path_));
+  }
+
+  // Pick the slot with the latest valid header.
+  std::vector<uint8_t> slot(kHeaderSlotSize);
+  std::vector<uint8_t> header;
+  bool found_data = false;
+  for (int index = 0; index < 2; ++index) {
+    ssize_t size = pread_all(header_fd_, slot.data(), slot.size(),
+                             index * kHeaderSlotSize);
+    if (size == -1) {
+      return ErrnoStatus("Reading store header");
+    }
+    found_data |= size > 0;
+    HeaderPrefix prefix;
+    if (size < static_cast<ssize_t>(sizeof(prefix))) {
+      continue;
+    }
+    memcpy(&prefix, slot.data(), sizeof(prefix));
+    if (prefix.magic != kHeaderMagic ||
+        prefix.segment_count > kKvStoreMaxSegments) {
+      continue;
+    }
+    const size_t mac_offset =
+        sizeof(prefix) + prefix.segment_count * sizeof(SegmentEntry);
+    if (size < static_cast<ssize_t>(mac_offset + kMacLength)) {
+      continue;
+    }
+    uint8_t mac[kMacLength];
+    unsigned int mac_length = 0;
+    if (!HMAC(EVP_sha256(), header_key_.data(), header_key_.size(),
+              slot.data(), mac_offset, mac, &mac_length) ||
+        CRYPTO_memcmp(mac, slot.data() + mac_offset, kMacLength) != 0) {
+      continue;
+    }
+    if (header.empty() || prefix.generation > generation_) {
+      header.assign(slot.begin(), slot.begin() + mac_offset);
+      generation_ = prefix.generation;
+    }
+  }
+  if (header.empty()) {
+    if (found_data) {
+      return Status(error::GoogleError::DATA_LOSS,
+                    absl::StrCat("No valid header in ", path_));
+    }
+    return Status::OkStatus();
+  }
+
+  HeaderPrefix prefix;
+  memcpy(&prefix, header.data(), sizeof(prefix));
+  next_segment_id_ = prefix.next_segment_id;
+
+  absl::MutexLock lock(&mu_);
+  for (uint64_t i = 0; i < prefix.segment_count; ++i) {
+    SegmentEntry entry;
+    memcpy(&entry, header.data() + sizeof(prefix) + i * sizeof(entry),
+           sizeof(entry));
+    auto segment = std::make_shared<Segment>();
+    segment->id = entry.id;
+    segment->length = entry.length;
+    memcpy(segment->salt, entry.salt, sizeof(segment->salt));
+    ASYLO_RETURN_IF_ERROR(OpenSegment(segment.get(), O_RDONLY));
+    ASYLO_RETURN_IF_ERROR(ReplaySegment(segment));
+    segments_.push_back(std::move(segment));
+  }
+  return Status::OkStatus();
+}
+
+Status SecureKvStore::OpenSegment(Segment* segment, int flags) {
+  segment->path = absl::StrCat(path_, kKvStoreSegmentSuffix, segment->id);
+  CleansingVector<uint8_t> key;
+  ASYLO_RETURN_IF_ERROR(DeriveKey(segment_key_, kSegmentKeyLabel,
+                                  segment->salt, sizeof(segment->salt), &key));
+  if (!EVP_AEAD_CTX_init(&segment->context, EVP_aead_aes_256_gcm(),
+                         key.data(), key.size(), kTagLength, nullptr)) {
+    return Status(error::GoogleError::INTERNAL,
+                  "Failed to initialize segment key");
+  }
+  segment->fd =
+      enc_untrusted_open(segment->path.c_str(), flags, S_IRUSR | S_IWUSR);
+  if (segment->fd == -1) {
+    return ErrnoStatus(absl::StrCat("Opening ", segment->path));
+  }
+  return Status::OkStatus();
+}
+
+StatusOr<std::shared_ptr<SecureKvStore::Segment>> SecureKvStore::CreateSegment(
+    uint64_t id) {
+  auto segment = std::make_shared<Segment>();
+  segment->id = id;
+  if (RAND_bytes(segment->salt, sizeof(segment->salt)) != 1) {
+    return Status(error::GoogleError::INTERNAL,
+                  "Failed to generate segment salt");
+  }
+  // A file left by a commit that did not complete may hold the id already.
+  ASYLO_RETURN_IF_ERROR(
+      OpenSegment(segment.get(), O_RDWR | O_CREAT | O_TRUNC));
+  return segment;
+}
+
+Status SecureKvStore::ReplaySegment(const std::shared_ptr<Segment>& segment) {
+  SegmentReader reader(segment->fd, segment->length);
+  CleansingVector<uint8_t> plaintext;
+  uint64_t offset = 0;
+  while (offset < segment->length) {
+    const uint8_t* record;
+    size_t record_length;
+    ASYLO_RETURN_IF_ERROR(reader.ReadRecord(offset, &record, &record_length));
+    RecordHeader header;
+    ASYLO_RETURN_IF_ERROR(OpenRecord(&segment->context, offset, record,
+                                     record_length, &plaintext, &header));
+    std::string key(
+        reinterpret_cast<const char*>(plaintext.data()) + sizeof(header),
+        header.key_length);
+    auto it = index_.find(key);
+    if (it != index_.end()) {
+      Release(it->second);
+    }
+    if (header.type == kPutRecord) {
+      Location location = {segment, offset,
+                           static_cast<uint32_t>(record_length)};
+      segment->live_bytes += record_length;
+      if (it != index_.end()) {
+        it->second = std::move(location);
+      } else {
+        index_.emplace(std::move(key), std::move(location));
+      }
+    } else if (it != index_.end()) {
+      index_.erase(it);
+    }
+    offset += record_length;
+  }
+  return Status::OkStatus();
+}
+
+Status SecureKvStore::ReadRecord(const Location& location,
+                                 ByteContainerView key,
+                                 CleansingString* value) {
+  std::vector<uint8_t> record(location.length);
+  if (pread_all(location.segment->fd, record.data(), record.size(),
+                location.offset) != static_cast<ssize_t>(record.size())) {
+    return Status(error::GoogleError::DATA_LOSS,
+                  "Failed to read committed segment data");
+  }
+  CleansingVector<uint8_t> plaintext;
+  RecordHeader header;
+  ASYLO_RETURN_IF_ERROR(OpenRecord(&location.segment->context,
+                                   location.offset, record.data(),
+                                   record.size(), &plaintext, &header));
+  const uint8_t* record_key = plaintext.data() + sizeof(header);
+  if (header.type != kPutRecord ||
+      ByteContainerView(record_key, header.key_length) != key) {
+    return Status(error::GoogleError::DATA_LOSS,
+                  "Record does not hold the value of the key");
+  }
+  value->assign(reinterpret_cast<const char*>(record_key) + header.key_length,
+                header.value_length);
+  return Status::OkStatus();
+}
+
+Status SecureKvStore::Get(ByteContainerView key, CleansingString* value) {
+  Location location;
+  {
+    absl::MutexLock lock(&mu_);
+    auto it = index_.find(std::string(key.begin(), key.end()));
+    if (it == index_.end()) {
+      return Status(error::GoogleError::NOT_FOUND, "Key not found");
+    }
+    location = it->second;
+  }
+  // The location holds a reference to its segment, so the record can be read
+  // without the lock even if compaction drops the segment meanwhile.
+  return ReadRecord(location, key, value);
+}
+
+Status SecureKvStore::Put(ByteContainerView key, ByteContainerView value) {
+  KvWriteBatch batch;
+  batch.Put(key, value);
+  return Write(batch);
+}
+
+Status SecureKvStore::Delete(ByteContainerView key) {
+  KvWriteBatch batch;
+  batch.Delete(key);
+  return Write(batch);
+}
+
+Status SecureKvStore::Write(const KvWriteBatch& batch) {
+  if (batch.updates_.empty()) {
+    return Status::OkStatus();
+  }
+
+  absl::MutexLock lock(&mu_);
+  if (!commit_status_.ok()) {
+    return commit_status_;
+  }
+
+  if (!active_) {
+    if (segments_.size() >= kKvStoreMaxSegments) {
+      return Status(error::GoogleError::RESOURCE_EXHAUSTED,
+                    "Store has too many segments; it must be compacted");
+    }
+    ASYLO_ASSIGN_OR_RETURN(active_, CreateSegment(next_segment_id_++));
+    segments_.push_back(active_);
+  }
+
+  // Seal the records at the offsets they are written to.
+  const uint64_t start = active_->length;
+  std::vector<uint32_t> lengths;
+  lengths.reserve(batch.updates_.size());
+  write_buffer_.clear();
+  for (const auto& update : batch.updates_) {
+    StatusOr<uint32_t> length_result = SealRecord(
+        &active_->context, start + write_buffer_.size(),
+        update.is_delete ? kDeleteRecord : kPutRecord, update.key,
+        update.value, &write_buffer_);
+    if (!length_result.ok()) {
+      return length_result.status();
+    }
+    lengths.push_back(length_result.ValueOrDie());
+  }
+
+  // Once the records are written the nonces at their offsets are used, so a
+  // segment that fails to take them is not written again.
+  Status status =
+      pwrite_all(active_->fd, write_buffer_.data(), write_buffer_.size(),
+                 start);
+  if (status.ok() && options_.sync && enc_untrusted_fsync(active_->fd) != 0) {
+    status = ErrnoStatus("fsync");
+  }
+  if (!status.ok()) {
+    active_.reset();
+    return status;
+  }
+
+  uint64_t offset = start;
+  for (size_t i = 0; i < batch.updates_.size(); ++i) {
+    const auto& update = batch.updates_[i];
+    auto it = index_.find(update.key);
+    if (it != index_.end()) {
+      Release(it->second);
+    }
+    if (!update.is_delete) {
+      Location location = {active_, offset, lengths[i]};
+      active_->live_bytes += lengths[i];
+      if (it != index_.end()) {
+        it->second = std::move(location);
+      } else {
+        index_.emplace(update.key, std::move(location));
+      }
+    } else if (it != index_.end()) {
+      index_.erase(it);
+    }
+    offset += lengths[i];
+  }
+  active_->length = offset;
+
+  status = WriteHeader();
+  if (!status.ok()) {
+    // The index no longer matches the committed state.
+    commit_status_ = status;
+    active_.reset();
+    return status;
+  }
+
+  if (active_->length >= options_.segment_size &&
+      segments_.size() < kKvStoreMaxSegments) {
+    active_.reset();
+  }
+  if (options_.background_compaction && ShouldCompact()) {
+    compaction_requested_ = true;
+  }
+  return Status::OkStatus();
+}
+
+Status SecureKvStore::WriteHeader() {
+  std::vector<uint8_t> slot(sizeof(HeaderPrefix) +
+                            segments_.size() * sizeof(SegmentEntry) +
+                            kMacLength);
+  const HeaderPrefix prefix = {kHeaderMagic, generation_ + 1,
+                               next_segment_id_, segments_.size()};
+  memcpy(slot.data(), &prefix, sizeof(prefix));
+  uint8_t* entries = slot.data() + sizeof(prefix);
+  for (const auto& segment : segments_) {
+    SegmentEntry entry;
+    entry.id = segment->id;
+    entry.length = segment->length;
+    memcpy(entry.salt, segment->salt, sizeof(entry.salt));
+    memcpy(entries, &entry, sizeof(entry));
+    entries += sizeof(entry);
+  }
+  const size_t mac_offset = slot.size() - kMacLength;
+  unsigned int mac_length = 0;
+  if (!HMAC(EVP_sha256(), header_key_.data(), header_key_.size(),
+            slot.data(), mac_offset, slot.data() + mac_offset, &mac_length)) {
+    return Status(error::GoogleError::INTERNAL, "Failed to seal store header");
+  }
+
+  // The slot of the previous header is left intact until this one is written.
+  ASYLO_RETURN_IF_ERROR(pwrite_all(header_fd_, slot.data(), slot.size(),
+                                   (prefix.generation % 2) * kHeaderSlotSize));
+  if (options_.sync && enc_untrusted_fsync(header_fd_) != 0) {
+    return ErrnoStatus("fsync");
+  }
+  generation_ = prefix.generation;
+  return Status::OkStatus();
+}
+
+void SecureKvStore::Release(const Location& location) {
+  location.segment->live_bytes -= location.length;
+}
+
+bool SecureKvStore::ShouldCompact() const {
+  uint64_t total_bytes = 0;
+  uint64_t live_bytes = 0;
+  for (const auto& segment : segments_) {
+    if (segment != active_) {
+      total_bytes += segment->length;
+      live_bytes += segment->live_bytes;
+    }
+  }
+  if (total_bytes == 0) {
+    return false;
+  }
+  return total_bytes - live_bytes >=
+         options_.compaction_garbage_ratio * total_bytes;
+}
+
+bool SecureKvStore::CompactionPending() const {
+  return compaction_requested_ || closing_;
+}
+
+Status SecureKvStore::Compact() {
+  absl::MutexLock compaction_lock(&compaction_mu_);
+
+  // Take the live records of all segments. Commits made while they are copied
+  // go to a new segment, which follows the compacted one.
+  struct Move {
+    const std::string* key;
+    Location from;
+    uint64_t offset;
+    uint32_t length;
+  };
+  std::vector<std::shared_ptr<Segment>> victims;
+  std::vector<Move> moves;
+  uint64_t id;
+  {
+    absl::MutexLock lock(&mu_);
+    if (!commit_status_.ok()) {
+      return commit_status_;
+    }
+    if (segments_.empty()) {
+      return Status::OkStatus();
+    }
+    active_.reset();
+    victims = segments_;
+    moves.reserve(index_.size());
+    for (const auto& entry : index_) {
+      moves.push_back({nullptr, entry.second, 0, 0});
+    }
+    id = next_segment_id_++;
+  }
+
+  // Copies of the keys are needed since the index may change meanwhile.
+  std::vector<std::string> keys;
+  keys.reserve(moves.size());
+
+  // Copy the records in the order of the segments, so that each segment is
+  // read sequentially.
+  std::sort(moves.begin(), moves.end(), [](const Move& a, const Move& b) {
+    return a.from.segment->id != b.from.segment->id
+               ? a.from.segment->id < b.from.segment->id
+               : a.from.offset < b.from.offset;
+  });
+
+  std::shared_ptr<Segment> compacted;
+  ASYLO_ASSIGN_OR_RETURN(compacted, CreateSegment(id));
+  std::vector<uint8_t> buffer;
+  CleansingVector<uint8_t> plaintext;
+  uint64_t written = 0;
+  std::unique_ptr<SegmentReader> reader;
+  const Segment* reader_segment = nullptr;
+  for (auto& move : moves) {
+    const Segment* segment = move.from.segment.get();
+    if (segment != reader_segment) {
+      reader = absl::make_unique<SegmentReader>(segment->fd, segment->length);
+      reader_segment = segment;
+    }
+    const uint8_t* record;
+    size_t record_length;
+    ASYLO_RETURN_IF_ERROR(
+        reader->ReadRecord(move.from.offset, &record, &record_length));
+    RecordHeader header;
+    ASYLO_RETURN_IF_ERROR(OpenRecord(&segment->context, move.from.offset,
+                                     record, record_length, &plaintext,
+                                     &header));
+    const uint8_t* key = plaintext.data() + sizeof(header);
+    keys.emplace_back(reinterpret_cast<const char*>(key),
+                      static_cast<size_t>(header.key_length));
+    move.key = &keys.back();
+    move.offset = written + buffer.size();
+    StatusOr<uint32_t> length_result = SealRecord(
+        &compacted->context, move.offset, kPutRecord,
+        ByteContainerView(key, header.key_length),
+        ByteContainerView(key + header.key_length, header.value_length),
+        &buffer);
+    if (!length_result.ok()) {
+      return length_result.status();
+    }
+    move.length = length_result.ValueOrDie();
+    if (buffer.size() >= kIoBufferSize) {
+      ASYLO_RETURN_IF_ERROR(
+          pwrite_all(compacted->fd, buffer.data(), buffer.size(), written));
+      written += buffer.size();
+      buffer.clear();
+    }
+  }
+  ASYLO_RETURN_IF_ERROR(
+      pwrite_all(compacted->fd, buffer.data(), buffer.size(), written));
+  written += buffer.size();
+  if (options_.sync && enc_untrusted_fsync(compacted->fd) != 0) {
+    return ErrnoStatus("fsync");
+  }
+  compacted->length = written;
+
+  {
+    absl::MutexLock lock(&mu_);
+    if (!commit_status_.ok()) {
+      return commit_status_;
+    }
+    // Keys updated while the records were copied keep their new records,
+    // which follow the compacted segment.
+    for (const auto& move : moves) {
+      auto it = index_.find(*move.key);
+      if (it != index_.end() && it->second.segment == move.from.segment &&
+          it->second.offset == move.from.offset) {
+        it->second = {compacted, move.offset, move.length};
+        compacted->live_bytes += move.length;
+      }
+    }
+    // The victims are the oldest segments, since only compaction removes
+    // segments.
+    segments_.erase(segments_.begin(), segments_.begin() + victims.size());
+    if (compacted->length > 0) {
+      segments_.insert(segments_.begin(), compacted);
+    }
+    Status status = WriteHeader();
+    if (!status.ok()) {
+      commit_status_ = status;
+      return status;
+    }
+    compaction_requested_ = options_.background_compaction && ShouldCompact();
+  }
+
+  for (const auto& segment : victims) {
+    enc_untrusted_unlink(segment->path.c_str());
+  }
+  if (compacted->length == 0) {
+    enc_untrusted_unlink(compacted->path.c_str());
+  }
+  return Status::OkStatus();
+}
+
+void SecureKvStore::CompactionLoop() {
+  while (true) {
+    {
+      absl::MutexLock lock(&mu_);
+      mu_.Await(absl::Condition(this, &SecureKvStore::CompactionPending));
+      if (closing_) {
+        return;
+      }
+      compaction_requested_ = false;
+    }
+    Status status = Compact();
+    if (!status.ok()) {
+      LOG(ERROR) << "Background compaction of " << path_
+                 << " failed: " << status;
+    }
+  }
+}
+
+size_t SecureKvStore::size() {
+  absl::MutexLock lock(&mu_);
+  return index_.size();
+}
+
+size_t SecureKvStore::segment_count() {
+  absl::MutexLock lock(&mu_);
+  return segments_.size();
+}
+
+}  // namespace storage
+}  // namespace platform
+}  // namespace asylo
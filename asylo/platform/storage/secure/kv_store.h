@@ -0,0 +1,259 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_PLATFORM_STORAGE_SECURE_KV_STORE_H_
+#define ASYLO_PLATFORM_STORAGE_SECURE_KV_STORE_H_
+
+#include <openssl/aead.h>
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/synchronization/mutex.h"
+#include "asylo/crypto/util/byte_container_view.h"
+#include "asylo/util/cleansing_types.h"
+#include "asylo/util/status.h"
+#include "asylo/util/statusor.h"
+
+namespace asylo {
+namespace platform {
+namespace storage {
+
+// Length of the key of a store.
+constexpr size_t kKvStoreKeyLength = 32;
+
+// Suffix of the segment files of a store, followed by the segment id.
+constexpr char kKvStoreSegmentSuffix[] = ".segment.";
+
+// Largest number of segments a store holds.
+constexpr size_t kKvStoreMaxSegments = 64;
+
+// Options of a SecureKvStore.
+struct KvStoreOptions {
+  // Size past which the segment being written is closed and a new one started.
+  uint64_t segment_size = 4 * 1024 * 1024;
+
+  // Whether each commit is flushed to the host's storage with fsync before it
+  // returns.
+  bool sync = true;
+
+  // Whether compaction runs on a thread of the store. Without it, space held
+  // by overwritten and deleted records is only reclaimed by Compact().
+  bool background_compaction = false;
+
+  // Fraction of the closed segments' bytes that must be held by overwritten
+  // and deleted records before background compaction runs.
+  double compaction_garbage_ratio = 0.5;
+};
+
+// A set of updates committed to a SecureKvStore together.
+class KvWriteBatch {
+ public:
+  // Sets |key| to |value|.
+  void Put(ByteContainerView key, ByteContainerView value);
+
+  // Removes |key|, if present.
+  void Delete(ByteContainerView key);
+
+  // Removes all updates from the batch.
+  void Clear() { updates_.clear(); }
+
+  // Returns the number of updates in the batch.
+  size_t size() const { return updates_.size(); }
+
+ private:
+  friend class SecureKvStore;
+
+  struct Update {
+    bool is_delete;
+    std::string key;
+    CleansingString value;
+  };
+
+  std::vector<Update> updates_;
+};
+
+// A log-structured key-value store kept in untrusted files, with keys and
+// values encrypted and authenticated under a key held by the enclave.
+//
+// Updates are appended as records to the current segment file, and a batch of
+// updates is committed by rewriting the header file once, however many records
+// it holds, so that small updates do not rewrite blocks of a file or update a
+// Merkle tree as they do through secure_write(). The enclave keeps an index
+// from each key to the location of its latest record, and values are read from
+// the segments on demand.
+//
+// Each segment is encrypted with AES-256-GCM under its own key, derived from
+// the store key and a random salt, and each record with the nonce of its
+// offset in the segment. The host therefore cannot move, replace or reorder
+// records without failing their authentication. The header lists the segments
+// of the store with their committed lengths and is authenticated with a key
+// derived from the store key; it is written alternately to one of two slots,
+// so that a commit interrupted by a crash leaves the previous one in place.
+// Records past the committed length of a segment are ignored, and a segment
+// is never appended to once the store is reopened. As for secure files, the
+// host may still present an older committed state of the store as a whole.
+//
+// Overwritten and deleted records are reclaimed by compaction, which rewrites
+// the live records of all segments into a new segment. Compaction copies
+// records without holding the store's lock, so reads and commits continue
+// while it runs, in a segment of their own.
+//
+// Methods may be called concurrently from several threads.
+class SecureKvStore {
+ public:
+  // Opens the store at |path|, creating it if it does not exist, with the
+  // |kKvStoreKeyLength|-byte |key|. The header of the store is |path|, and its
+  // segments are files next to it.
+  static StatusOr<std::unique_ptr<SecureKvStore>> Open(
+      const std::string& path, ByteContainerView key,
+      const KvStoreOptions& options);
+
+  SecureKvStore(const SecureKvStore&) = delete;
+  SecureKvStore& operator=(const SecureKvStore&) = delete;
+
+  // Stops background compaction and closes the files of the store.
+  ~SecureKvStore();
+
+  // Reads the value of |key| into |value|. Returns a NOT_FOUND error if the
+  // store does not hold |key|.
+  Status Get(ByteContainerView key, CleansingString* value);
+
+  // Sets |key| to |value| in a commit of its own.
+  Status Put(ByteContainerView key, ByteContainerView value);
+
+  // Removes |key|, if present, in a commit of its own.
+  Status Delete(ByteContainerView key);
+
+  // Applies the updates of |batch| in order, and commits them with a single
+  // header write. Either all or none of them survive a crash.
+  Status Write(const KvWriteBatch& batch);
+
+  // Closes the segment being written, rewrites the live records of all
+  // segments into a new segment, and removes them.
+  Status Compact();
+
+  // Returns the number of keys in the store.
+  size_t size() LOCKS_EXCLUDED(mu_);
+
+  // Returns the number of segments of the store.
+  size_t segment_count() LOCKS_EXCLUDED(mu_);
+
+ private:
+  // A segment file with its key. Segments are shared with readers so that
+  // compaction can drop them while a read is in progress.
+  struct Segment {
+    Segment();
+    ~Segment();
+
+    uint64_t id;
+    uint8_t salt[32];
+    std::string path;
+    int fd;
+    EVP_AEAD_CTX context;
+
+    // Committed length of the segment, and the bytes of its records that are
+    // still referenced by the index.
+    uint64_t length;
+    uint64_t live_bytes;
+  };
+
+  // The record holding the latest value of a key.
+  struct Location {
+    std::shared_ptr<Segment> segment;
+    uint64_t offset;
+    uint32_t length;
+  };
+
+  SecureKvStore(const std::string& path, const KvStoreOptions& options);
+
+  // Derives the header key from |key|, and restores the header and the index.
+  Status Initialize(ByteContainerView key);
+
+  // Sets up the key of |segment| from its salt, and opens its file with
+  // |flags|.
+  Status OpenSegment(Segment* segment, int flags);
+
+  // Reads the records of |segment| up to its committed length into the index.
+  Status ReplaySegment(const std::shared_ptr<Segment>& segment)
+      EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  // Creates the segment |id| with a fresh salt.
+  StatusOr<std::shared_ptr<Segment>> CreateSegment(uint64_t id);
+
+  // Reads and decrypts the record at |location|, checking that it sets
+  // |key|, into |value|.
+  Status ReadRecord(const Location& location, ByteContainerView key,
+                    CleansingString* value);
+
+  // Writes the header listing |segments_| to the next slot.
+  Status WriteHeader() EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  // Drops |location| from the live bytes of its segment.
+  void Release(const Location& location) EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  // Returns whether the closed segments hold enough garbage to compact.
+  bool ShouldCompact() const EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  // Returns whether the compaction thread has work to do.
+  bool CompactionPending() const EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  // Runs compaction whenever a commit requests it, until the store closes.
+  void CompactionLoop();
+
+  const std::string path_;
+  const KvStoreOptions options_;
+  CleansingVector<uint8_t> header_key_;
+  CleansingVector<uint8_t> segment_key_;
+  int header_fd_;
+
+  absl::Mutex mu_;
+
+  // Segments in the order their records are applied. The last one is being
+  // written if |active_| is set.
+  std::vector<std::shared_ptr<Segment>> segments_ GUARDED_BY(mu_);
+  std::shared_ptr<Segment> active_ GUARDED_BY(mu_);
+  std::unordered_map<std::string, Location> index_ GUARDED_BY(mu_);
+  uint64_t generation_ GUARDED_BY(mu_);
+  uint64_t next_segment_id_ GUARDED_BY(mu_);
+
+  // Set when a commit fails after writing to the host, after which the state
+  // on the host is unknown and further commits are refused.
+  Status commit_status_ GUARDED_BY(mu_);
+
+  // Staging space for the records of a commit.
+  std::vector<uint8_t> write_buffer_ GUARDED_BY(mu_);
+
+  // Serializes compactions.
+  absl::Mutex compaction_mu_ ACQUIRED_BEFORE(mu_);
+
+  bool compaction_requested_ GUARDED_BY(mu_);
+  bool closing_ GUARDED_BY(mu_);
+  std::thread compaction_thread_;
+};
+
+}  // namespace storage
+}  // namespace platform
+}  // namespace asylo
+
+#endif  // ASYLO_PLATFORM_STORAGE_SECURE_KV_STORE_H_
@@ -0,0 +1,299 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+// Tests of the secure key-value store.
+
+#include "asylo/platform/storage/secure/kv_store.h"
+
+#include <fcntl.h>
+#include <openssl/rand.h>
+
+#include <string>
+#include <thread>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include "absl/strings/str_cat.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "asylo/platform/arch/include/trusted/host_calls.h"
+#include "asylo/test/util/status_matchers.h"
+#include "asylo/test/util/test_flags.h"
+#include "asylo/util/cleansing_types.h"
+
+namespace asylo {
+namespace {
+
+using platform::storage::KvStoreOptions;
+using platform::storage::KvWriteBatch;
+using platform::storage::SecureKvStore;
+using platform::storage::kKvStoreKeyLength;
+using platform::storage::kKvStoreSegmentSuffix;
+using ::testing::Not;
+
+// Largest segment id whose file is removed before each test.
+constexpr int kMaxTestSegmentId = 1024;
+
+class KvStoreTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    path_ = absl::StrCat(FLAGS_test_tmpdir, "/KvStoreTest.kv");
+    remove(path_.c_str());
+    for (int id = 0; id < kMaxTestSegmentId; ++id) {
+      remove(SegmentPath(id).c_str());
+    }
+
+    key_.resize(kKvStoreKeyLength);
+    ASSERT_EQ(RAND_bytes(key_.data(), key_.size()), 1);
+  }
+
+  std::string SegmentPath(int id) const {
+    return absl::StrCat(path_, kKvStoreSegmentSuffix, id);
+  }
+
+  // Opens the test store with |options|, failing the test on error.
+  std::unique_ptr<SecureKvStore> OpenStore(const KvStoreOptions &options) {
+    auto store_result = SecureKvStore::Open(path_, key_, options);
+    EXPECT_THAT(store_result, IsOk());
+    if (!store_result.ok()) {
+      return nullptr;
+    }
+    return std::move(store_result).ValueOrDie();
+  }
+
+  // Returns the value of |key| in |store|, or the error message.
+  static std::string GetValue(SecureKvStore *store, const std::string &key) {
+    CleansingString value;
+    Status status = store->Get(key, &value);
+    if (!status.ok()) {
+      return status.ToString();
+    }
+    return std::string(value.begin(), value.end());
+  }
+
+  // Returns whether the file at |path| exists on the host.
+  static bool FileExists(const std::string &path) {
+    int fd = enc_untrusted_open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+      return false;
+    }
+    enc_untrusted_close(fd);
+    return true;
+  }
+
+  // Writes |data| to the file at |path| on the host at |offset|, or at its
+  // end if |offset| is negative.
+  static void WriteRaw(const std::string &path, const std::string &data,
+                       off_t offset) {
+    int fd = enc_untrusted_open(path.c_str(), O_WRONLY);
+    ASSERT_GE(fd, 0);
+    if (offset < 0) {
+      offset = enc_untrusted_lseek(fd, 0, SEEK_END);
+    }
+    EXPECT_EQ(enc_untrusted_pwrite(fd, data.data(), data.size(), offset),
+              data.size());
+    enc_untrusted_close(fd);
+  }
+
+  std::string path_;
+  CleansingVector<uint8_t> key_;
+};
+
+TEST_F(KvStoreTest, PutGetDelete) {
+  std::unique_ptr<SecureKvStore> store = OpenStore(KvStoreOptions());
+  ASSERT_NE(store, nullptr);
+
+  EXPECT_THAT(store->Put("alpha", "one"), IsOk());
+  EXPECT_THAT(store->Put("beta", "two"), IsOk());
+  EXPECT_THAT(store->Put("alpha", "three"), IsOk());
+  EXPECT_EQ(GetValue(store.get(), "alpha"), "three");
+  EXPECT_EQ(GetValue(store.get(), "beta"), "two");
+  EXPECT_EQ(store->size(), 2);
+
+  EXPECT_THAT(store->Delete("alpha"), IsOk());
+  CleansingString value;
+  EXPECT_THAT(store->Get("alpha", &value), Not(IsOk()));
+  EXPECT_EQ(store->size(), 1);
+
+  // Deleting a missing key is not an error.
+  EXPECT_THAT(store->Delete("gamma"), IsOk());
+}
+
+TEST_F(KvStoreTest, CommittedStateSurvivesReopen) {
+  std::unique_ptr<SecureKvStore> store = OpenStore(KvStoreOptions());
+  ASSERT_NE(store, nullptr);
+  EXPECT_THAT(store->Put("deleted", "value"), IsOk());
+
+  KvWriteBatch batch;
+  for (int i = 0; i < 100; ++i) {
+    batch.Put(absl::StrCat("key", i), absl::StrCat("value", i));
+  }
+  batch.Delete("deleted");
+  batch.Put("key7", "rewritten");
+  EXPECT_THAT(store->Write(batch), IsOk());
+  store.reset();
+
+  store = OpenStore(KvStoreOptions());
+  ASSERT_NE(store, nullptr);
+  EXPECT_EQ(store->size(), 100);
+  EXPECT_EQ(GetValue(store.get(), "key0"), "value0");
+  EXPECT_EQ(GetValue(store.get(), "key7"), "rewritten");
+  EXPECT_EQ(GetValue(store.get(), "key99"), "value99");
+  CleansingString value;
+  EXPECT_THAT(store->Get("deleted", &value), Not(IsOk()));
+
+  // Commits after a reopen go to a new segment.
+  EXPECT_THAT(store->Put("key0", "after reopen"), IsOk());
+  EXPECT_EQ(store->segment_count(), 2);
+  store.reset();
+
+  store = OpenStore(KvStoreOptions());
+  ASSERT_NE(store, nullptr);
+  EXPECT_EQ(GetValue(store.get(), "key0"), "after reopen");
+}
+
+TEST_F(KvStoreTest, WrongKeyFails) {
+  std::unique_ptr<SecureKvStore> store = OpenStore(KvStoreOptions());
+  ASSERT_NE(store, nullptr);
+  EXPECT_THAT(store->Put("key", "value"), IsOk());
+  store.reset();
+
+  CleansingVector<uint8_t> other_key(kKvStoreKeyLength);
+  ASSERT_EQ(RAND_bytes(other_key.data(), other_key.size()), 1);
+  EXPECT_THAT(SecureKvStore::Open(path_, other_key, KvStoreOptions()),
+              Not(IsOk()));
+}
+
+TEST_F(KvStoreTest, UncommittedRecordsAreIgnored) {
+  std::unique_ptr<SecureKvStore> store = OpenStore(KvStoreOptions());
+  ASSERT_NE(store, nullptr);
+  EXPECT_THAT(store->Put("key", "value"), IsOk());
+  store.reset();
+
+  // Bytes appended past the committed length, as left by a commit that did
+  // not complete, are not read.
+  WriteRaw(SegmentPath(0), "uncommitted record", -1);
+  store = OpenStore(KvStoreOptions());
+  ASSERT_NE(store, nullptr);
+  EXPECT_EQ(store->size(), 1);
+  EXPECT_EQ(GetValue(store.get(), "key"), "value");
+}
+
+TEST_F(KvStoreTest, ModifiedRecordFails) {
+  std::unique_ptr<SecureKvStore> store = OpenStore(KvStoreOptions());
+  ASSERT_NE(store, nullptr);
+  EXPECT_THAT(store->Put("key", "value"), IsOk());
+  store.reset();
+
+  WriteRaw(SegmentPath(0), "x", 8);
+  EXPECT_THAT(SecureKvStore::Open(path_, key_, KvStoreOptions()),
+              Not(IsOk()));
+}
+
+TEST_F(KvStoreTest, CompactionReclaimsSegments) {
+  KvStoreOptions options;
+  options.segment_size = 256;
+  std::unique_ptr<SecureKvStore> store = OpenStore(options);
+  ASSERT_NE(store, nullptr);
+
+  for (int i = 0; i < 200; ++i) {
+    EXPECT_THAT(store->Put(absl::StrCat("key", i % 10), absl::StrCat(i)),
+                IsOk());
+  }
+  EXPECT_THAT(store->Delete("key0"), IsOk());
+  const size_t segment_count = store->segment_count();
+  EXPECT_GT(segment_count, 1);
+
+  EXPECT_THAT(store->Compact(), IsOk());
+  EXPECT_EQ(store->segment_count(), 1);
+  for (int id = 0; id < segment_count; ++id) {
+    EXPECT_FALSE(FileExists(SegmentPath(id))) << id;
+  }
+  EXPECT_EQ(store->size(), 9);
+  for (int i = 1; i < 10; ++i) {
+    EXPECT_EQ(GetValue(store.get(), absl::StrCat("key", i)),
+              absl::StrCat(190 + i));
+  }
+  store.reset();
+
+  store = OpenStore(options);
+  ASSERT_NE(store, nullptr);
+  EXPECT_EQ(store->size(), 9);
+  EXPECT_EQ(GetValue(store.get(), "key5"), "195");
+}
+
+TEST_F(KvStoreTest, CommitsDuringCompactionArePreserved) {
+  KvStoreOptions options;
+  options.segment_size = 1024;
+  std::unique_ptr<SecureKvStore> store = OpenStore(options);
+  ASSERT_NE(store, nullptr);
+  for (int i = 0; i < 1000; ++i) {
+    EXPECT_THAT(store->Put(absl::StrCat("key", i % 100), "old"), IsOk());
+  }
+
+  std::thread writer([&store] {
+    for (int i = 0; i < 100; ++i) {
+      if (i % 10 == 0) {
+        EXPECT_THAT(store->Delete(absl::StrCat("key", i)), IsOk());
+      } else {
+        EXPECT_THAT(store->Put(absl::StrCat("key", i), "new"), IsOk());
+      }
+    }
+  });
+  EXPECT_THAT(store->Compact(), IsOk());
+  writer.join();
+
+  auto check = [](SecureKvStore *store) {
+    EXPECT_EQ(store->size(), 90);
+    for (int i = 1; i < 100; ++i) {
+      if (i % 10 != 0) {
+        EXPECT_EQ(GetValue(store, absl::StrCat("key", i)), "new") << i;
+      }
+    }
+  };
+  check(store.get());
+  store.reset();
+
+  store = OpenStore(options);
+  ASSERT_NE(store, nullptr);
+  check(store.get());
+}
+
+TEST_F(KvStoreTest, BackgroundCompaction) {
+  KvStoreOptions options;
+  options.segment_size = 256;
+  options.background_compaction = true;
+  std::unique_ptr<SecureKvStore> store = OpenStore(options);
+  ASSERT_NE(store, nullptr);
+
+  for (int i = 0; i < 500; ++i) {
+    EXPECT_THAT(store->Put("key", absl::StrCat(i)), IsOk());
+  }
+
+  // Each closed segment only holds overwritten values, so compaction keeps
+  // the number of segments small.
+  absl::Time deadline = absl::Now() + absl::Seconds(10);
+  while (store->segment_count() > 2 && absl::Now() < deadline) {
+    absl::SleepFor(absl::Milliseconds(10));
+  }
+  EXPECT_LE(store->segment_count(), 2);
+  EXPECT_EQ(GetValue(store.get(), "key"), "499");
+}
+
+}  // namespace
+}  // namespace asylo
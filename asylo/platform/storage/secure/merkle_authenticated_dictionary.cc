@@ -0,0 +1,472 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/storage/secure/merkle_authenticated_dictionary.h"
+
+#include <openssl/sha.h>
+
+#include <algorithm>
+#include <numeric>
+#include <utility>
+
+#include "asylo/crypto/sha256_hash.h"
+#include "asylo/crypto/util/byte_container_view.h"
+#include "asylo/util/logging.h"
+
+namespace asylo {
+namespace platform {
+namespace storage {
+namespace {
+
+// Domain separation prefixes for leaf and interior node hashes, as in RFC 6962.
+constexpr uint8_t kLeafHashPrefix = 0x00;
+constexpr uint8_t kNodeHashPrefix = 0x01;
+
+// Number of interior nodes hashed together by a single HashMany() call.
+constexpr size_t kNodeBatchSize = 64;
+
+}  // namespace
+
+constexpr size_t MerkleAuthenticatedDictionary::kHashLength;
+constexpr size_t MerkleAuthenticatedDictionary::kChunkLevel;
+constexpr size_t MerkleAuthenticatedDictionary::kChunkLeafCount;
+
+MerkleAuthenticatedDictionary::MerkleAuthenticatedDictionary() : levels_(1) {}
+
+void MerkleAuthenticatedDictionary::HashLeaf(const uint8_t* data, size_t size,
+                                             Hash* hash) {
+  SHA256_CTX context;
+  SHA256_Init(&context);
+  SHA256_Update(&context, &kLeafHashPrefix, sizeof(kLeafHashPrefix));
+  SHA256_Update(&context, data, size);
+  SHA256_Final(hash->data(), &context);
+}
+
+void MerkleAuthenticatedDictionary::HashLeaves(const uint8_t* data,
+                                               size_t leaf_size, size_t count,
+                                               Hash* hashes) {
+  const size_t prefixed_size = 1 + leaf_size;
+  std::vector<uint8_t> leaves(kNodeBatchSize * prefixed_size);
+  uint8_t digests[kNodeBatchSize * kHashLength];
+  std::vector<ByteContainerView> batch;
+  batch.reserve(kNodeBatchSize);
+
+  for (size_t first = 0; first < count; first += kNodeBatchSize) {
+    batch.clear();
+    const size_t batch_size = std::min(kNodeBatchSize, count - first);
+    for (size_t i = 0; i < batch_size; i++) {
+      uint8_t* leaf = leaves.data() + i * prefixed_size;
+      leaf[0] = kLeafHashPrefix;
+      std::copy_n(data + (first + i) * leaf_size, leaf_size, leaf + 1);
+      batch.emplace_back(leaf, prefixed_size);
+    }
+    Sha256Hash::HashMany(batch.data(), batch.size(), digests);
+    for (size_t i = 0; i < batch_size; i++) {
+      hashes[first + i] = Hash(digests + i * kHashLength, kHashLength);
+    }
+  }
+}
+
+void MerkleAuthenticatedDictionary::HashNode(const Hash& left,
+                                             const Hash& right, Hash* hash) {
+  SHA256_CTX context;
+  SHA256_Init(&context);
+  SHA256_Update(&context, &kNodeHashPrefix, sizeof(kNodeHashPrefix));
+  SHA256_Update(&context, left.data(), kHashLength);
+  SHA256_Update(&context, right.data(), kHashLength);
+  SHA256_Final(hash->data(), &context);
+}
+
+void MerkleAuthenticatedDictionary::HashParents(
+    const std::vector<Hash>& children, const std::vector<size_t>& indices,
+    std::vector<Hash>* parents) {
+  constexpr size_t kNodeSize = 1 + 2 * kHashLength;
+  uint8_t nodes[kNodeBatchSize][kNodeSize];
+  uint8_t digests[kNodeBatchSize * kHashLength];
+  size_t batch_parents[kNodeBatchSize];
+  std::vector<ByteContainerView> batch;
+  batch.reserve(kNodeBatchSize);
+
+  auto flush = [&]() {
+    Sha256Hash::HashMany(batch.data(), batch.size(), digests);
+    for (size_t i = 0; i < batch.size(); i++) {
+      (*parents)[batch_parents[i]] =
+          Hash(digests + i * kHashLength, kHashLength);
+    }
+    batch.clear();
+  };
+
+  for (size_t parent : indices) {
+    if (2 * parent + 1 >= children.size()) {
+      (*parents)[parent] = children[2 * parent];
+      continue;
+    }
+    uint8_t* node = nodes[batch.size()];
+    node[0] = kNodeHashPrefix;
+    std::copy_n(children[2 * parent].data(), kHashLength, node + 1);
+    std::copy_n(children[2 * parent + 1].data(), kHashLength,
+                node + 1 + kHashLength);
+    batch_parents[batch.size()] = parent;
+    batch.emplace_back(node, kNodeSize);
+    if (batch.size() == kNodeBatchSize) {
+      flush();
+    }
+  }
+  if (!batch.empty()) {
+    flush();
+  }
+}
+
+void MerkleAuthenticatedDictionary::HashLevel(const std::vector<Hash>& children,
+                                              std::vector<Hash>* parents) {
+  parents->resize((children.size() + 1) / 2);
+  std::vector<size_t> indices(parents->size());
+  std::iota(indices.begin(), indices.end(), 0);
+  HashParents(children, indices, parents);
+}
+
+size_t MerkleAuthenticatedDictionary::AddLeaf(const std::string& data) {
+  Hash hash;
+  HashLeaf(reinterpret_cast<const uint8_t*>(data.data()), data.size(), &hash);
+  return AppendLeafHash(hash);
+}
+
+size_t MerkleAuthenticatedDictionary::AddLeafHash(const std::string& hash) {
+  if (hash.size() != kHashLength) {
+    LOG(ERROR) << "Leaf hash of unexpected size " << hash.size();
+    return 0;
+  }
+  return AppendLeafHash(
+      Hash(reinterpret_cast<const uint8_t*>(hash.data()), kHashLength));
+}
+
+size_t MerkleAuthenticatedDictionary::AddLeafHashes(const std::string& hash,
+                                                    size_t count) {
+  if (hash.size() != kHashLength) {
+    LOG(ERROR) << "Leaf hash of unexpected size " << hash.size();
+    return 0;
+  }
+  const Hash leaf(reinterpret_cast<const uint8_t*>(hash.data()), kHashLength);
+
+  // Fill up the last chunk one leaf at a time.
+  while (count > 0 && levels_[0].size() % kChunkLeafCount != 0) {
+    if (AppendLeafHash(leaf) == 0) {
+      return 0;
+    }
+    count--;
+  }
+
+  // Every node of a whole chunk of identical leaves at a given level has the
+  // same hash. Only the first leaf of each such chunk is marked dirty, which
+  // recomputes the path linking the chunk root into the tree.
+  const size_t whole_chunks = count / kChunkLeafCount;
+  if (whole_chunks > 0) {
+    const size_t first_leaf = levels_[0].size();
+    const size_t end_leaf = first_leaf + whole_chunks * kChunkLeafCount;
+    if (levels_.size() <= kChunkLevel) {
+      levels_.resize(kChunkLevel + 1);
+    }
+    Hash node = leaf;
+    for (size_t level = 0; level <= kChunkLevel; level++) {
+      levels_[level].resize(end_leaf >> level, node);
+      HashNode(node, node, &node);
+    }
+    is_dirty_.resize(end_leaf, false);
+    chunk_loaded_.resize(end_leaf / kChunkLeafCount, true);
+    for (size_t index = first_leaf; index < end_leaf;
+         index += kChunkLeafCount) {
+      MarkDirty(index);
+    }
+    count -= whole_chunks * kChunkLeafCount;
+  }
+
+  while (count > 0) {
+    if (AppendLeafHash(leaf) == 0) {
+      return 0;
+    }
+    count--;
+  }
+  return levels_[0].size();
+}
+
+size_t MerkleAuthenticatedDictionary::AddLeaves(
+    const uint8_t* data, size_t leaf_size, size_t count,
+    const ParallelFor& parallel_for) {
+  // Fill up the last chunk one leaf at a time.
+  Hash hash;
+  while (count > 0 && levels_[0].size() % kChunkLeafCount != 0) {
+    HashLeaf(data, leaf_size, &hash);
+    if (AppendLeafHash(hash) == 0) {
+      return 0;
+    }
+    data += leaf_size;
+    count--;
+  }
+
+  // The levels are sized for the whole chunks up front, so that the chunks
+  // are hashed into disjoint nodes. As in AddLeafHashes, only the first leaf
+  // of each chunk is marked dirty, which links the chunk root into the tree.
+  const size_t whole_chunks = count / kChunkLeafCount;
+  if (whole_chunks > 0) {
+    const size_t first_chunk = levels_[0].size() / kChunkLeafCount;
+    const size_t end_leaf = levels_[0].size() + whole_chunks * kChunkLeafCount;
+    if (levels_.size() <= kChunkLevel) {
+      levels_.resize(kChunkLevel + 1);
+    }
+    for (size_t level = 0; level <= kChunkLevel; level++) {
+      levels_[level].resize(end_leaf >> level);
+    }
+    is_dirty_.resize(end_leaf, false);
+    chunk_loaded_.resize(end_leaf / kChunkLeafCount, true);
+
+    const size_t chunk_size = kChunkLeafCount * leaf_size;
+    parallel_for(whole_chunks, [this, data, leaf_size, first_chunk,
+                                chunk_size](size_t begin, size_t end) {
+      for (size_t chunk = begin; chunk < end; chunk++) {
+        HashChunk(first_chunk + chunk, data + chunk * chunk_size, leaf_size);
+      }
+    });
+    for (size_t chunk = 0; chunk < whole_chunks; chunk++) {
+      MarkDirty((first_chunk + chunk) * kChunkLeafCount);
+    }
+    data += whole_chunks * chunk_size;
+    count -= whole_chunks * kChunkLeafCount;
+  }
+
+  while (count > 0) {
+    HashLeaf(data, leaf_size, &hash);
+    if (AppendLeafHash(hash) == 0) {
+      return 0;
+    }
+    data += leaf_size;
+    count--;
+  }
+  return levels_[0].size();
+}
+
+void MerkleAuthenticatedDictionary::HashChunk(size_t chunk,
+                                              const uint8_t* data,
+                                              size_t leaf_size) {
+  const size_t first_leaf = chunk * kChunkLeafCount;
+  HashLeaves(data, leaf_size, kChunkLeafCount, &levels_[0][first_leaf]);
+  std::vector<size_t> indices;
+  for (size_t level = 1; level <= kChunkLevel; level++) {
+    indices.resize(kChunkLeafCount >> level);
+    std::iota(indices.begin(), indices.end(), first_leaf >> level);
+    HashParents(levels_[level - 1], indices, &levels_[level]);
+  }
+}
+
+size_t MerkleAuthenticatedDictionary::AppendLeafHash(const Hash& hash) {
+  if (levels_[0].size() % kChunkLeafCount == 0) {
+    chunk_loaded_.push_back(true);
+  } else if (!chunk_loaded_.back()) {
+    LOG(ERROR) << "Attempt made to append a leaf to a chunk that is not loaded";
+    return 0;
+  }
+  levels_[0].push_back(hash);
+  is_dirty_.push_back(false);
+  MarkDirty(levels_[0].size() - 1);
+  return levels_[0].size();
+}
+
+std::string MerkleAuthenticatedDictionary::CurrentRoot() {
+  Hash root;
+  if (levels_[0].empty()) {
+    ::SHA256(nullptr, 0, root.data());
+  } else {
+    RecomputeDirtyPaths();
+    root = levels_.back()[0];
+  }
+  return std::string(reinterpret_cast<const char*>(root.data()), kHashLength);
+}
+
+std::string MerkleAuthenticatedDictionary::LeafHash(size_t leaf) const {
+  if (leaf == 0 || leaf > levels_[0].size() ||
+      !chunk_loaded_[(leaf - 1) / kChunkLeafCount]) {
+    return std::string();
+  }
+  const Hash& hash = levels_[0][leaf - 1];
+  return std::string(reinterpret_cast<const char*>(hash.data()), kHashLength);
+}
+
+std::string MerkleAuthenticatedDictionary::LeafHash(
+    const std::string& data) const {
+  Hash hash;
+  HashLeaf(reinterpret_cast<const uint8_t*>(data.data()), data.size(), &hash);
+  return std::string(reinterpret_cast<const char*>(hash.data()), kHashLength);
+}
+
+bool MerkleAuthenticatedDictionary::UpdateLeaf(size_t leaf,
+                                               const std::string& data) {
+  if (leaf == 0 || leaf > levels_[0].size() ||
+      !chunk_loaded_[(leaf - 1) / kChunkLeafCount]) {
+    return false;
+  }
+  HashLeaf(reinterpret_cast<const uint8_t*>(data.data()), data.size(),
+           &levels_[0][leaf - 1]);
+  MarkDirty(leaf - 1);
+  return true;
+}
+
+void MerkleAuthenticatedDictionary::MarkDirty(size_t index) {
+  if (!is_dirty_[index]) {
+    is_dirty_[index] = true;
+    dirty_nodes_.push_back(index);
+  }
+}
+
+void MerkleAuthenticatedDictionary::RecomputeDirtyPaths() {
+  if (dirty_nodes_.empty()) {
+    return;
+  }
+
+  std::sort(dirty_nodes_.begin(), dirty_nodes_.end());
+  for (size_t index : dirty_nodes_) {
+    is_dirty_[index] = false;
+  }
+
+  // Every node whose value changed since the last recomputation lies on the
+  // path of a dirty leaf: updates change their own paths, and appended leaves
+  // are the only ones whose paths gain nodes or siblings.
+  size_t level = 0;
+  while (levels_[level].size() > 1) {
+    if (levels_.size() == level + 1) {
+      levels_.emplace_back();
+    }
+    const std::vector<Hash>& children = levels_[level];
+    std::vector<Hash>& parents = levels_[level + 1];
+    parents.resize((children.size() + 1) / 2);
+
+    // Dirty children are sorted, so their parents come out sorted and only
+    // need adjacent duplicates removed.
+    dirty_parents_.clear();
+    for (size_t child : dirty_nodes_) {
+      size_t parent = child / 2;
+      if (dirty_parents_.empty() || dirty_parents_.back() != parent) {
+        dirty_parents_.push_back(parent);
+      }
+    }
+    HashParents(children, dirty_parents_, &parents);
+
+    dirty_nodes_.swap(dirty_parents_);
+    level++;
+  }
+
+  dirty_nodes_.clear();
+}
+
+size_t MerkleAuthenticatedDictionary::ChunkRootLevel() const {
+  return std::min(kChunkLevel, levels_.size() - 1);
+}
+
+size_t MerkleAuthenticatedDictionary::ChunkLeafCount(size_t chunk) const {
+  const size_t first = chunk * kChunkLeafCount;
+  if (first >= LeafCount()) {
+    return 0;
+  }
+  return std::min(kChunkLeafCount, LeafCount() - first);
+}
+
+void MerkleAuthenticatedDictionary::ResetToChunkRoots(
+    size_t leaf_count, const uint8_t* chunk_roots) {
+  levels_.assign(1, std::vector<Hash>(leaf_count));
+  dirty_nodes_.clear();
+  is_dirty_.assign(leaf_count, false);
+  chunk_loaded_.assign(ChunkCount(), false);
+  if (leaf_count == 0) {
+    return;
+  }
+
+  // Size the levels below the chunk roots. Their nodes are filled in as the
+  // chunks are loaded.
+  while (levels_.size() <= kChunkLevel && levels_.back().size() > 1) {
+    levels_.emplace_back((levels_.back().size() + 1) / 2);
+  }
+  std::vector<Hash>& roots = levels_.back();
+  for (size_t chunk = 0; chunk < roots.size(); chunk++) {
+    roots[chunk] = Hash(chunk_roots + chunk * kHashLength, kHashLength);
+  }
+
+  // Compute the levels above the chunk roots.
+  while (levels_.back().size() > 1) {
+    std::vector<Hash> parents;
+    HashLevel(levels_.back(), &parents);
+    levels_.push_back(std::move(parents));
+  }
+}
+
+bool MerkleAuthenticatedDictionary::LoadChunk(size_t chunk,
+                                              const uint8_t* leaf_hashes) {
+  if (chunk >= chunk_loaded_.size() || chunk_loaded_[chunk]) {
+    LOG(ERROR) << "Attempt made to load an invalid chunk " << chunk;
+    return false;
+  }
+
+  // Unloaded chunks hold no dirty nodes, but nodes above them may be stale.
+  RecomputeDirtyPaths();
+
+  // Hash the chunk up to its root, keeping the lower levels so that they can
+  // be stored once the root is verified.
+  const size_t chunk_level = ChunkRootLevel();
+  std::vector<std::vector<Hash>> chunk_levels(1);
+  chunk_levels[0].resize(ChunkLeafCount(chunk));
+  for (size_t index = 0; index < chunk_levels[0].size(); index++) {
+    chunk_levels[0][index] =
+        Hash(leaf_hashes + index * kHashLength, kHashLength);
+  }
+  for (size_t level = 0; level < chunk_level; level++) {
+    std::vector<Hash> parents;
+    HashLevel(chunk_levels[level], &parents);
+    chunk_levels.push_back(std::move(parents));
+  }
+
+  if (chunk_levels[chunk_level][0] != levels_[chunk_level][chunk]) {
+    LOG(ERROR) << "Leaf hashes do not match the root of chunk " << chunk;
+    return false;
+  }
+
+  for (size_t level = 0; level < chunk_level; level++) {
+    std::copy(chunk_levels[level].begin(), chunk_levels[level].end(),
+              levels_[level].begin() + (chunk << (kChunkLevel - level)));
+  }
+  chunk_loaded_[chunk] = true;
+  return true;
+}
+
+void MerkleAuthenticatedDictionary::CopyChunkLeafHashes(
+    size_t chunk, uint8_t* leaf_hashes) const {
+  const size_t first = chunk * kChunkLeafCount;
+  for (size_t index = 0; index < ChunkLeafCount(chunk); index++) {
+    std::copy_n(levels_[0][first + index].data(), kHashLength,
+                leaf_hashes + index * kHashLength);
+  }
+}
+
+void MerkleAuthenticatedDictionary::CopyChunkRoots(uint8_t* chunk_roots) {
+  RecomputeDirtyPaths();
+  const std::vector<Hash>& roots = levels_[ChunkRootLevel()];
+  for (size_t chunk = 0; chunk < ChunkCount(); chunk++) {
+    std::copy_n(roots[chunk].data(), kHashLength,
+                chunk_roots + chunk * kHashLength);
+  }
+}
+
+}  // namespace storage
+}  // namespace platform
+}  // namespace asylo
@@ -0,0 +1,205 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_PLATFORM_STORAGE_SECURE_MERKLE_AUTHENTICATED_DICTIONARY_H_
+#define ASYLO_PLATFORM_STORAGE_SECURE_MERKLE_AUTHENTICATED_DICTIONARY_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "asylo/crypto/util/bytes.h"
+#include "asylo/platform/storage/secure/authenticated_dictionary.h"
+
+namespace asylo {
+namespace platform {
+namespace storage {
+
+// Authenticated Dictionary implementation backed by an array-based Merkle tree
+// with SHA-256 node hashes. Leaf and root hashes are computed as specified in
+// RFC 6962, so results are interchangeable with CTMMTAuthenticatedDictionary.
+//
+// Each level of the tree is stored as a contiguous array of fixed-size hashes.
+// Adding or updating a leaf only marks it dirty; the nodes on the paths from
+// all dirty leaves to the root are recomputed together, once per level, the
+// next time the root is requested.
+//
+// The leaves are grouped into aligned chunks of kChunkLeafCount leaves, whose
+// subtree roots are nodes of the tree. A tree may be reset to just its chunk
+// roots and have the leaf hashes of each chunk loaded later, when first
+// needed, which lets callers persist and restore large trees incrementally.
+// Leaves of chunks that are not loaded can neither be looked up nor updated.
+//
+// Leaf hash lookups are const and do not share mutable state, so they may be
+// called concurrently with each other.
+class MerkleAuthenticatedDictionary : public AuthenticatedDictionary {
+ public:
+  // Length of a SHA-256 hash.
+  static constexpr size_t kHashLength = 32;
+
+  // Number of leaves in each chunk, and its base-2 logarithm - the level of
+  // the chunk roots in the tree.
+  static constexpr size_t kChunkLevel = 10;
+  static constexpr size_t kChunkLeafCount = size_t{1} << kChunkLevel;
+
+  // Runs |body| on consecutive subranges [begin, end) covering [0, |count|),
+  // possibly concurrently, and returns once all invocations have finished.
+  using ParallelFor = std::function<void(
+      size_t count, const std::function<void(size_t, size_t)>& body)>;
+
+  MerkleAuthenticatedDictionary();
+
+  size_t LeafCount() const final { return levels_[0].size(); }
+
+  size_t AddLeaf(const std::string& data) final;
+
+  // |hash| must be kHashLength bytes long. Returns 0 and does not add a leaf
+  // otherwise, or if the last chunk is partial and not loaded.
+  size_t AddLeafHash(const std::string& hash) final;
+
+  // Adds |count| leaves with the same |hash|, as |count| calls to AddLeafHash
+  // would. The nodes within whole chunks of these leaves are filled in rather
+  // than hashed, so that runs of identical leaves, such as the leaves of
+  // sparse regions of a file, are added without hashing each of them. Returns
+  // the new leaf count, or 0 on the same failures as AddLeafHash.
+  size_t AddLeafHashes(const std::string& hash, size_t count);
+
+  // Adds |count| leaves whose data are the consecutive |leaf_size| byte
+  // strings at |data|, as |count| calls to AddLeaf would. Whole chunks of
+  // these leaves are independent subtrees, which are hashed up to their
+  // roots through |parallel_for|, called with the number of whole chunks, so
+  // that a large tree can be built on several threads. Returns the new leaf
+  // count, or 0 if the last chunk is partial and not loaded.
+  size_t AddLeaves(const uint8_t* data, size_t leaf_size, size_t count,
+                   const ParallelFor& parallel_for);
+
+  std::string CurrentRoot() final;
+
+  // Returns an empty string if |leaf| is out of range or its chunk is not
+  // loaded.
+  std::string LeafHash(size_t leaf) const final;
+
+  std::string LeafHash(const std::string& data) const final;
+
+  // Returns false if |leaf| is out of range or its chunk is not loaded.
+  bool UpdateLeaf(size_t leaf, const std::string& data) final;
+
+  // Returns the number of chunks covering the leaves of the tree.
+  size_t ChunkCount() const {
+    return (LeafCount() + kChunkLeafCount - 1) / kChunkLeafCount;
+  }
+
+  // Returns the number of leaves in |chunk|.
+  size_t ChunkLeafCount(size_t chunk) const;
+
+  // Replaces the tree with one of |leaf_count| leaves whose chunk roots are
+  // the ChunkCount() consecutive hashes at |chunk_roots|. None of the chunks
+  // is loaded.
+  void ResetToChunkRoots(size_t leaf_count, const uint8_t* chunk_roots);
+
+  // Returns true if the leaf hashes of |chunk| are available.
+  bool IsChunkLoaded(size_t chunk) const {
+    return chunk < chunk_loaded_.size() && chunk_loaded_[chunk];
+  }
+
+  // Loads the ChunkLeafCount(|chunk|) consecutive leaf hashes at |leaf_hashes|
+  // into |chunk|. Returns false, leaving the chunk unloaded, if they do not
+  // hash to the root of the chunk.
+  bool LoadChunk(size_t chunk, const uint8_t* leaf_hashes);
+
+  // Stores the ChunkLeafCount(|chunk|) leaf hashes of the loaded |chunk|
+  // consecutively at |leaf_hashes|.
+  void CopyChunkLeafHashes(size_t chunk, uint8_t* leaf_hashes) const;
+
+  // Stores the ChunkCount() chunk roots consecutively at |chunk_roots|.
+  void CopyChunkRoots(uint8_t* chunk_roots);
+
+ private:
+  using Hash = UnsafeBytes<kHashLength>;
+
+  // Stores the leaf hash of |size| bytes at |data| in |hash|.
+  static void HashLeaf(const uint8_t* data, size_t size, Hash* hash);
+
+  // Stores the leaf hashes of the |count| consecutive |leaf_size| byte
+  // strings at |data| in |hashes|, hashing them in batches with
+  // Sha256Hash::HashMany().
+  static void HashLeaves(const uint8_t* data, size_t leaf_size, size_t count,
+                         Hash* hashes);
+
+  // Stores the hash of the interior node with children |left| and |right| in
+  // |hash|.
+  static void HashNode(const Hash& left, const Hash& right, Hash* hash);
+
+  // Recomputes the nodes at |indices| of the level above |children|, storing
+  // them in |parents|. Nodes with two children are hashed in batches with
+  // Sha256Hash::HashMany(); a node with a single child is a copy of it.
+  static void HashParents(const std::vector<Hash>& children,
+                          const std::vector<size_t>& indices,
+                          std::vector<Hash>* parents);
+
+  // Recomputes every node of the level above |children| into |parents|.
+  static void HashLevel(const std::vector<Hash>& children,
+                        std::vector<Hash>* parents);
+
+  // Computes the leaf hashes of the whole |chunk| from the kChunkLeafCount
+  // leaves of |leaf_size| bytes at |data|, and the nodes of the chunk up to its
+  // root. The levels must already hold the chunk. Only touches the nodes of
+  // the chunk, so different chunks may be hashed concurrently.
+  void HashChunk(size_t chunk, const uint8_t* data, size_t leaf_size);
+
+  // Appends a leaf with |hash| and returns the new leaf count.
+  size_t AppendLeafHash(const Hash& hash);
+
+  // Marks the leaf at zero-based |index| as needing its path recomputed.
+  void MarkDirty(size_t index);
+
+  // Recomputes all nodes on the paths from dirty leaves to the root.
+  void RecomputeDirtyPaths();
+
+  // Returns the level holding the chunk roots. Trees of a single partial chunk
+  // have fewer levels than kChunkLevel, and the root is the chunk root.
+  size_t ChunkRootLevel() const;
+
+  // Hashes of the nodes of the tree, by level. levels_[0] holds the leaf
+  // hashes. Node i of level l > 0 holds the hash of nodes 2i and 2i + 1 of
+  // level l - 1, or a copy of node 2i if node 2i + 1 does not exist. The last
+  // level holds the single root node of a non-empty tree once dirty paths are
+  // recomputed.
+  std::vector<std::vector<Hash>> levels_;
+
+  // Zero-based indices of dirty leaves, in no particular order, and a flag per
+  // leaf recording whether it is listed. During recomputation the list holds
+  // the dirty nodes of the level being processed.
+  std::vector<size_t> dirty_nodes_;
+  std::vector<bool> is_dirty_;
+
+  // Dirty nodes of the level above the one being processed. Kept as a member,
+  // like |dirty_nodes_|, to avoid reallocating on every recomputation.
+  std::vector<size_t> dirty_parents_;
+
+  // Whether the leaf hashes of each chunk are available.
+  std::vector<bool> chunk_loaded_;
+};
+
+}  // namespace storage
+}  // namespace platform
+}  // namespace asylo
+
+#endif  // ASYLO_PLATFORM_STORAGE_SECURE_MERKLE_AUTHENTICATED_DICTIONARY_H_
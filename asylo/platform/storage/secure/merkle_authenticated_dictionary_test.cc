@@ -0,0 +1,313 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/storage/secure/merkle_authenticated_dictionary.h"
+
+#include <cstdlib>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include "absl/strings/escaping.h"
+#include "asylo/platform/storage/secure/ctmmt_authenticated_dictionary.h"
+
+namespace asylo {
+namespace platform {
+namespace storage {
+namespace {
+
+// Leaf inputs and tree roots of the first eight prefixes of the RFC 6962 test
+// vectors used by the Certificate Transparency implementation.
+const char* const kTestLeaves[] = {
+    "",
+    "00",
+    "10",
+    "2021",
+    "3031",
+    "40414243",
+    "5051525354555657",
+    "606162636465666768696a6b6c6d6e6f",
+};
+
+const char* const kTestRoots[] = {
+    "6e340b9cffb37a989ca544e6bb780a2c78901d3fb33738768511a30617afa01d",
+    "fac54203e7cc696cf0dfcb42c92a1d9dbaf70ad9e621f4bd8d98662f00e3c125",
+    "aeb6bcfe274b70a14fb067a5e5578264db0fa9b51af5e0ba159158f329e06e77",
+    "d37ee418976dd95753c1c73862b9398fa2a2cf9b4ff0fdfe8b30cd95209614b7",
+    "4e3bbb1f7b478dcfe71fb631631519a3bca12c9aefca1612bfce4c13a86264d4",
+    "76e67dadbcdf1e10e1b74ddc608abd2f98dfb16fbce75277b5232a127f2087ef",
+    "ddb89be403809e325750d3d263cd78929c2942b7942a34b77e122c9594a74c8c",
+    "5dc9da79a70659a9ad559cb701ded9a2ab9d823aad2f4960cfe370eff4604328",
+};
+
+TEST(MerkleAuthenticatedDictionaryTest, EmptyTreeRootIsHashOfEmptyString) {
+  MerkleAuthenticatedDictionary ad;
+  EXPECT_EQ(ad.LeafCount(), 0);
+  EXPECT_EQ(absl::BytesToHexString(ad.CurrentRoot()),
+            "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855");
+}
+
+TEST(MerkleAuthenticatedDictionaryTest, RootsMatchTestVectors) {
+  MerkleAuthenticatedDictionary ad;
+  for (size_t i = 0; i < sizeof(kTestLeaves) / sizeof(kTestLeaves[0]); ++i) {
+    EXPECT_EQ(ad.AddLeaf(absl::HexStringToBytes(kTestLeaves[i])), i + 1);
+    EXPECT_EQ(absl::BytesToHexString(ad.CurrentRoot()), kTestRoots[i]);
+  }
+}
+
+TEST(MerkleAuthenticatedDictionaryTest, BatchedRootMatchesTestVector) {
+  MerkleAuthenticatedDictionary ad;
+  for (const char* leaf : kTestLeaves) {
+    ad.AddLeaf(absl::HexStringToBytes(leaf));
+  }
+  EXPECT_EQ(absl::BytesToHexString(ad.CurrentRoot()), kTestRoots[7]);
+}
+
+TEST(MerkleAuthenticatedDictionaryTest, LeafHashes) {
+  MerkleAuthenticatedDictionary ad;
+  const std::string data = "leaf data";
+  const std::string hash = ad.LeafHash(data);
+  EXPECT_EQ(hash.size(), MerkleAuthenticatedDictionary::kHashLength);
+
+  EXPECT_EQ(ad.AddLeaf(data), 1);
+  EXPECT_EQ(ad.AddLeafHash(hash), 2);
+  EXPECT_EQ(ad.LeafHash(1), hash);
+  EXPECT_EQ(ad.LeafHash(2), hash);
+  EXPECT_TRUE(ad.LeafHash(0).empty());
+  EXPECT_TRUE(ad.LeafHash(3).empty());
+
+  // Hashes of the wrong length are rejected.
+  EXPECT_EQ(ad.AddLeafHash("short"), 0);
+  EXPECT_EQ(ad.LeafCount(), 2);
+}
+
+TEST(MerkleAuthenticatedDictionaryTest, UpdateLeafOutOfRangeFails) {
+  MerkleAuthenticatedDictionary ad;
+  ad.AddLeaf("a");
+  EXPECT_FALSE(ad.UpdateLeaf(0, "b"));
+  EXPECT_FALSE(ad.UpdateLeaf(2, "b"));
+  EXPECT_TRUE(ad.UpdateLeaf(1, "b"));
+  EXPECT_EQ(ad.LeafHash(1), ad.LeafHash("b"));
+}
+
+// Applies the same random sequence of additions and updates to both
+// dictionary implementations, comparing roots at random points, so that roots
+// are checked both after single changes and after batches of changes.
+TEST(MerkleAuthenticatedDictionaryTest, MatchesCtmmtAuthenticatedDictionary) {
+  MerkleAuthenticatedDictionary ad;
+  CTMMTAuthenticatedDictionary reference;
+  srand(1);
+  for (int i = 0; i < 3000; ++i) {
+    const std::string data = std::to_string(rand());
+    if (reference.LeafCount() == 0 || rand() % 3 == 0) {
+      if (rand() % 4 == 0) {
+        const std::string hash = reference.LeafHash(data);
+        EXPECT_EQ(ad.AddLeafHash(hash), reference.AddLeafHash(hash));
+      } else {
+        EXPECT_EQ(ad.AddLeaf(data), reference.AddLeaf(data));
+      }
+    } else {
+      const size_t leaf = 1 + rand() % reference.LeafCount();
+      ASSERT_TRUE(ad.UpdateLeaf(leaf, data));
+      ASSERT_TRUE(reference.UpdateLeaf(leaf, data));
+    }
+    if (rand() % 16 == 0) {
+      ASSERT_EQ(ad.CurrentRoot(), reference.CurrentRoot());
+    }
+  }
+  EXPECT_EQ(ad.LeafCount(), reference.LeafCount());
+  EXPECT_EQ(ad.CurrentRoot(), reference.CurrentRoot());
+  for (size_t leaf = 1; leaf <= reference.LeafCount(); ++leaf) {
+    EXPECT_EQ(ad.LeafHash(leaf), reference.LeafHash(leaf));
+  }
+}
+
+// Restores trees of various shapes from their chunk roots, checking that the
+// restored trees match the originals before, while and after their chunks are
+// loaded.
+TEST(MerkleAuthenticatedDictionaryTest, RestoreFromChunkRoots) {
+  constexpr size_t kChunkLeafCount =
+      MerkleAuthenticatedDictionary::kChunkLeafCount;
+  constexpr size_t kHashLength = MerkleAuthenticatedDictionary::kHashLength;
+  for (size_t leaf_count : {size_t{1}, size_t{5}, kChunkLeafCount,
+                            kChunkLeafCount + 1, 3 * kChunkLeafCount - 7}) {
+    MerkleAuthenticatedDictionary ad;
+    for (size_t leaf = 0; leaf < leaf_count; ++leaf) {
+      ad.AddLeaf(std::to_string(leaf));
+    }
+    std::vector<uint8_t> chunk_roots(ad.ChunkCount() * kHashLength);
+    ad.CopyChunkRoots(chunk_roots.data());
+
+    MerkleAuthenticatedDictionary restored;
+    restored.ResetToChunkRoots(leaf_count, chunk_roots.data());
+    EXPECT_EQ(restored.LeafCount(), leaf_count);
+    EXPECT_EQ(restored.CurrentRoot(), ad.CurrentRoot());
+    EXPECT_TRUE(restored.LeafHash(1).empty());
+    EXPECT_FALSE(restored.UpdateLeaf(leaf_count, "update"));
+
+    for (size_t chunk = ad.ChunkCount(); chunk-- > 0;) {
+      EXPECT_FALSE(restored.IsChunkLoaded(chunk));
+      std::vector<uint8_t> leaf_hashes(ad.ChunkLeafCount(chunk) * kHashLength);
+      ad.CopyChunkLeafHashes(chunk, leaf_hashes.data());
+      ASSERT_TRUE(restored.LoadChunk(chunk, leaf_hashes.data()));
+      EXPECT_TRUE(restored.IsChunkLoaded(chunk));
+    }
+    for (size_t leaf = 1; leaf <= leaf_count; ++leaf) {
+      EXPECT_EQ(restored.LeafHash(leaf), ad.LeafHash(leaf));
+    }
+
+    ASSERT_TRUE(ad.UpdateLeaf(1, "update"));
+    ASSERT_TRUE(restored.UpdateLeaf(1, "update"));
+    EXPECT_EQ(restored.AddLeaf("append"), ad.AddLeaf("append"));
+    EXPECT_EQ(restored.CurrentRoot(), ad.CurrentRoot());
+  }
+}
+
+TEST(MerkleAuthenticatedDictionaryTest, AddLeafHashesMatchesAddLeafHash) {
+  constexpr size_t kChunkLeafCount =
+      MerkleAuthenticatedDictionary::kChunkLeafCount;
+  const std::string hash = MerkleAuthenticatedDictionary().LeafHash("hole");
+  for (size_t prefix : {size_t{0}, size_t{5}, kChunkLeafCount}) {
+    for (size_t count : {size_t{0}, size_t{3}, kChunkLeafCount,
+                         3 * kChunkLeafCount + 7}) {
+      MerkleAuthenticatedDictionary ad;
+      MerkleAuthenticatedDictionary expected;
+      for (size_t leaf = 0; leaf < prefix; ++leaf) {
+        ad.AddLeaf(std::to_string(leaf));
+        expected.AddLeaf(std::to_string(leaf));
+      }
+      ad.CurrentRoot();
+      for (size_t leaf = 0; leaf < count; ++leaf) {
+        expected.AddLeafHash(hash);
+      }
+
+      EXPECT_EQ(ad.AddLeafHashes(hash, count), prefix + count);
+      EXPECT_EQ(ad.CurrentRoot(), expected.CurrentRoot());
+      if (count == 0) {
+        continue;
+      }
+      EXPECT_EQ(ad.LeafHash(prefix + count), hash);
+
+      // The filled in nodes are used when the leaves are updated.
+      const size_t leaf = prefix + count / 2 + 1;
+      ASSERT_TRUE(ad.UpdateLeaf(leaf, "update"));
+      ASSERT_TRUE(expected.UpdateLeaf(leaf, "update"));
+      EXPECT_EQ(ad.AddLeaf("append"), expected.AddLeaf("append"));
+      EXPECT_EQ(ad.CurrentRoot(), expected.CurrentRoot());
+    }
+  }
+}
+
+TEST(MerkleAuthenticatedDictionaryTest, AddLeavesMatchesAddLeaf) {
+  constexpr size_t kChunkLeafCount =
+      MerkleAuthenticatedDictionary::kChunkLeafCount;
+  constexpr size_t kLeafSize = 16;
+  std::vector<uint8_t> data((4 * kChunkLeafCount + 7) * kLeafSize);
+  for (size_t i = 0; i < data.size(); ++i) {
+    data[i] = static_cast<uint8_t>(i * 7 + i / kLeafSize);
+  }
+
+  // Hashes each chunk on its own thread.
+  const MerkleAuthenticatedDictionary::ParallelFor threaded =
+      [](size_t count, const std::function<void(size_t, size_t)>& body) {
+        std::vector<std::thread> threads;
+        for (size_t i = 0; i < count; ++i) {
+          threads.emplace_back(body, i, i + 1);
+        }
+        for (std::thread& thread : threads) {
+          thread.join();
+        }
+      };
+  const MerkleAuthenticatedDictionary::ParallelFor serial =
+      [](size_t count, const std::function<void(size_t, size_t)>& body) {
+        body(0, count);
+      };
+
+  for (const auto& parallel_for : {serial, threaded}) {
+    for (size_t prefix : {size_t{0}, size_t{5}, kChunkLeafCount}) {
+      for (size_t count : {size_t{0}, size_t{3}, kChunkLeafCount,
+                           3 * kChunkLeafCount + 7}) {
+        MerkleAuthenticatedDictionary ad;
+        MerkleAuthenticatedDictionary expected;
+        for (size_t leaf = 0; leaf < prefix; ++leaf) {
+          ad.AddLeaf(std::to_string(leaf));
+          expected.AddLeaf(std::to_string(leaf));
+        }
+        ad.CurrentRoot();
+        for (size_t leaf = 0; leaf < count; ++leaf) {
+          expected.AddLeaf(std::string(
+              reinterpret_cast<const char*>(&data[leaf * kLeafSize]),
+              kLeafSize));
+        }
+
+        EXPECT_EQ(ad.AddLeaves(data.data(), kLeafSize, count, parallel_for),
+                  prefix + count);
+        EXPECT_EQ(ad.CurrentRoot(), expected.CurrentRoot());
+        if (count == 0) {
+          continue;
+        }
+        EXPECT_EQ(ad.LeafHash(prefix + count / 2),
+                  expected.LeafHash(prefix + count / 2));
+
+        // The hashed nodes are used when the leaves are updated.
+        const size_t leaf = prefix + count / 2 + 1;
+        ASSERT_TRUE(ad.UpdateLeaf(leaf, "update"));
+        ASSERT_TRUE(expected.UpdateLeaf(leaf, "update"));
+        EXPECT_EQ(ad.AddLeaf("append"), expected.AddLeaf("append"));
+        EXPECT_EQ(ad.CurrentRoot(), expected.CurrentRoot());
+      }
+    }
+  }
+}
+
+TEST(MerkleAuthenticatedDictionaryTest, RestoredChunkMismatchFails) {
+  constexpr size_t kLeafCount =
+      MerkleAuthenticatedDictionary::kChunkLeafCount + 3;
+  constexpr size_t kHashLength = MerkleAuthenticatedDictionary::kHashLength;
+  MerkleAuthenticatedDictionary ad;
+  for (size_t leaf = 0; leaf < kLeafCount; ++leaf) {
+    ad.AddLeaf(std::to_string(leaf));
+  }
+  std::vector<uint8_t> chunk_roots(ad.ChunkCount() * kHashLength);
+  ad.CopyChunkRoots(chunk_roots.data());
+
+  MerkleAuthenticatedDictionary restored;
+  restored.ResetToChunkRoots(kLeafCount, chunk_roots.data());
+
+  // Leaves cannot be appended to the partial last chunk until it is loaded.
+  EXPECT_EQ(restored.AddLeaf("append"), 0);
+
+  std::vector<uint8_t> leaf_hashes(ad.ChunkLeafCount(1) * kHashLength);
+  ad.CopyChunkLeafHashes(1, leaf_hashes.data());
+  leaf_hashes[kHashLength] ^= 1;
+  EXPECT_FALSE(restored.LoadChunk(1, leaf_hashes.data()));
+  EXPECT_FALSE(restored.IsChunkLoaded(1));
+  EXPECT_TRUE(restored.LeafHash(kLeafCount).empty());
+
+  leaf_hashes[kHashLength] ^= 1;
+  EXPECT_TRUE(restored.LoadChunk(1, leaf_hashes.data()));
+  EXPECT_FALSE(restored.LoadChunk(1, leaf_hashes.data()));
+  EXPECT_EQ(restored.LeafHash(kLeafCount), ad.LeafHash(kLeafCount));
+}
+
+}  // namespace
+}  // namespace storage
+}  // namespace platform
+}  // namespace asylo
@@ -0,0 +1,165 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+// Tests of secure storage reads and writes with parallel block crypto.
+
+#include <fcntl.h>
+#include <openssl/rand.h>
+
+#include <vector>
+
+#include <gtest/gtest.h>
+#include "absl/strings/str_cat.h"
+#include "asylo/platform/arch/include/trusted/host_calls.h"
+#include "asylo/platform/storage/secure/aead_handler.h"
+#include "asylo/platform/storage/secure/enclave_storage_secure.h"
+#include "asylo/test/util/test_flags.h"
+#include "asylo/util/cleansing_types.h"
+
+namespace asylo {
+namespace {
+
+using platform::crypto::gcmlib::kKeyLength;
+using platform::storage::AeadHandler;
+using platform::storage::kBlockLength;
+using platform::storage::kBlockLength4KiB;
+using platform::storage::kFileHashLength;
+using platform::storage::kTagLength;
+using platform::storage::kTokenLength;
+using platform::storage::secure_close;
+using platform::storage::secure_lseek;
+using platform::storage::secure_open;
+using platform::storage::secure_read;
+using platform::storage::secure_write;
+
+constexpr int kNumWorkers = 4;
+
+// Large enough to be split across the workers for every block length.
+constexpr size_t kDataLength = 256 * 1024 + 100;
+
+// Misaligned for every block length.
+constexpr off_t kWriteOffset = 1000;
+
+class ParallelCryptoTest : public ::testing::TestWithParam<size_t> {
+ protected:
+  static void SetUpTestCase() {
+    ASSERT_EQ(AeadHandler::GetInstance().EnableParallelCrypto(kNumWorkers), 0);
+  }
+
+  void SetUp() override {
+    path_ = absl::StrCat(FLAGS_test_tmpdir, "/ParallelCryptoTest.txt");
+    remove(path_.c_str());
+
+    key_.resize(kKeyLength);
+    ASSERT_EQ(RAND_bytes(key_.data(), key_.size()), 1);
+    data_.resize(kDataLength);
+    ASSERT_EQ(RAND_bytes(data_.data(), data_.size()), 1);
+  }
+
+  // Opens the test file and sets its key, selecting the block length under
+  // test if |create| is true. Returns the file descriptor, or -1 on failure.
+  int OpenWithKey(bool create) {
+    int fd = create ? secure_open(path_.c_str(), O_RDWR | O_CREAT,
+                                  S_IRWXU | S_IRWXG | S_IRWXO)
+                    : secure_open(path_.c_str(), O_RDONLY);
+    if (fd < 0) {
+      return -1;
+    }
+    if ((create &&
+         AeadHandler::GetInstance().SetBlockLength(fd, GetParam()) != 0) ||
+        AeadHandler::GetInstance().SetMasterKey(fd, key_.data(),
+                                                key_.size()) != 0) {
+      secure_close(fd);
+      return -1;
+    }
+    return fd;
+  }
+
+  // Writes |data_| at kWriteOffset to a new file.
+  void WriteData() {
+    int fd = OpenWithKey(/*create=*/true);
+    ASSERT_GE(fd, 0);
+    ASSERT_EQ(secure_lseek(fd, kWriteOffset, SEEK_SET), kWriteOffset);
+    EXPECT_EQ(secure_write(fd, data_.data(), data_.size()), data_.size());
+    EXPECT_EQ(secure_close(fd), 0);
+  }
+
+  std::string path_;
+  CleansingVector<uint8_t> key_;
+  std::vector<uint8_t> data_;
+};
+
+INSTANTIATE_TEST_CASE_P(BlockLengths, ParallelCryptoTest,
+                        ::testing::Values(kBlockLength, kBlockLength4KiB));
+
+TEST_P(ParallelCryptoTest, EnableTwiceFails) {
+  EXPECT_EQ(AeadHandler::GetInstance().EnableParallelCrypto(kNumWorkers), -1);
+  EXPECT_EQ(errno, EINVAL);
+}
+
+TEST_P(ParallelCryptoTest, ReadWriteSuccess) {
+  WriteData();
+
+  int fd = OpenWithKey(/*create=*/false);
+  ASSERT_GE(fd, 0);
+  std::vector<uint8_t> read_buffer(kWriteOffset + kDataLength);
+  EXPECT_EQ(secure_read(fd, read_buffer.data(), read_buffer.size()),
+            read_buffer.size());
+  EXPECT_EQ(secure_close(fd), 0);
+
+  EXPECT_EQ(std::vector<uint8_t>(read_buffer.begin(),
+                                 read_buffer.begin() + kWriteOffset),
+            std::vector<uint8_t>(kWriteOffset, 0));
+  EXPECT_EQ(std::vector<uint8_t>(read_buffer.begin() + kWriteOffset,
+                                 read_buffer.end()),
+            data_);
+}
+
+TEST_P(ParallelCryptoTest, ModifiedBlockFails) {
+  WriteData();
+
+  // Corrupt the ciphertext of a block in the middle of the file. Its
+  // integrity tag is intact, so the failure is detected by the decryption on
+  // a crypto worker.
+  int fd = enc_untrusted_open(path_.c_str(), O_RDWR);
+  ASSERT_GE(fd, 0);
+  const size_t block_index = kDataLength / 2 / GetParam();
+  const off_t block_offset =
+      kFileHashLength + sizeof(uint64_t) +
+      block_index * (GetParam() + kTagLength + kTokenLength);
+  ASSERT_EQ(enc_untrusted_lseek(fd, block_offset, SEEK_SET), block_offset);
+  uint8_t block_data[kTagLength];
+  ASSERT_EQ(enc_untrusted_read(fd, block_data, sizeof(block_data)),
+            sizeof(block_data));
+  for (uint8_t &byte : block_data) {
+    byte ^= 0xff;
+  }
+  ASSERT_EQ(enc_untrusted_lseek(fd, block_offset, SEEK_SET), block_offset);
+  EXPECT_EQ(enc_untrusted_write(fd, block_data, sizeof(block_data)),
+            sizeof(block_data));
+  enc_untrusted_close(fd);
+
+  fd = OpenWithKey(/*create=*/false);
+  ASSERT_GE(fd, 0);
+  std::vector<uint8_t> read_buffer(kWriteOffset + kDataLength);
+  EXPECT_EQ(secure_read(fd, read_buffer.data(), read_buffer.size()), -1);
+  EXPECT_EQ(secure_close(fd), 0);
+}
+
+}  // namespace
+}  // namespace asylo
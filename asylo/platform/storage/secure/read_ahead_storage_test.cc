@@ -0,0 +1,234 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+// Tests of secure storage reads with read-ahead enabled.
+
+#include <fcntl.h>
+#include <openssl/rand.h>
+
+#include <algorithm>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include "absl/strings/str_cat.h"
+#include "asylo/platform/arch/include/trusted/host_calls.h"
+#include "asylo/platform/storage/secure/aead_handler.h"
+#include "asylo/platform/storage/secure/enclave_storage_secure.h"
+#include "asylo/test/util/test_flags.h"
+#include "asylo/util/cleansing_types.h"
+
+namespace asylo {
+namespace {
+
+using platform::crypto::gcmlib::kKeyLength;
+using platform::storage::AeadHandler;
+using platform::storage::kBlockLength;
+using platform::storage::kBlockLength4KiB;
+using platform::storage::kFileHashLength;
+using platform::storage::kTagLength;
+using platform::storage::kTokenLength;
+using platform::storage::secure_close;
+using platform::storage::secure_lseek;
+using platform::storage::secure_open;
+using platform::storage::secure_pwrite;
+using platform::storage::secure_read;
+using platform::storage::secure_write;
+
+// Holds 128 blocks of kBlockLength, or 4 blocks of kBlockLength4KiB.
+constexpr size_t kReadAheadBytes = 16 * 1024;
+
+// Spans many read-ahead windows for every block length.
+constexpr size_t kDataLength = 256 * 1024 + 100;
+
+// Misaligned for every block length, so that reads end within blocks.
+constexpr size_t kReadLength = 1000;
+
+class ReadAheadStorageTest : public ::testing::TestWithParam<size_t> {
+ protected:
+  static void SetUpTestCase() {
+    ASSERT_EQ(AeadHandler::GetInstance().EnableReadAhead(kReadAheadBytes), 0);
+  }
+
+  void SetUp() override {
+    path_ = absl::StrCat(FLAGS_test_tmpdir, "/ReadAheadStorageTest.txt");
+    remove(path_.c_str());
+
+    key_.resize(kKeyLength);
+    ASSERT_EQ(RAND_bytes(key_.data(), key_.size()), 1);
+    data_.resize(kDataLength);
+    ASSERT_EQ(RAND_bytes(data_.data(), data_.size()), 1);
+  }
+
+  // Opens the test file for reading and writing and sets its key, selecting
+  // the block length under test if |create| is true. Returns the file
+  // descriptor, or -1 on failure.
+  int OpenWithKey(bool create) {
+    int flags = create ? O_RDWR | O_CREAT : O_RDWR;
+    int fd = secure_open(path_.c_str(), flags, S_IRWXU | S_IRWXG | S_IRWXO);
+    if (fd < 0) {
+      return -1;
+    }
+    if ((create &&
+         AeadHandler::GetInstance().SetBlockLength(fd, GetParam()) != 0) ||
+        AeadHandler::GetInstance().SetMasterKey(fd, key_.data(),
+                                                key_.size()) != 0) {
+      secure_close(fd);
+      return -1;
+    }
+    return fd;
+  }
+
+  // Writes |data_| to a new file.
+  void WriteData() {
+    int fd = OpenWithKey(/*create=*/true);
+    ASSERT_GE(fd, 0);
+    EXPECT_EQ(secure_write(fd, data_.data(), data_.size()), data_.size());
+    EXPECT_EQ(secure_close(fd), 0);
+  }
+
+  // Reads |fd| from its cursor to the end in kReadLength reads. Returns the
+  // data read, or stops at the first failed read and leaves |*failed| set.
+  std::vector<uint8_t> ReadToEnd(int fd, bool* failed) {
+    std::vector<uint8_t> data;
+    std::vector<uint8_t> buffer(kReadLength);
+    *failed = false;
+    while (true) {
+      ssize_t bytes_read = secure_read(fd, buffer.data(), buffer.size());
+      if (bytes_read < 0) {
+        *failed = true;
+        return data;
+      }
+      if (bytes_read == 0) {
+        return data;
+      }
+      data.insert(data.end(), buffer.begin(), buffer.begin() + bytes_read);
+    }
+  }
+
+  std::string path_;
+  CleansingVector<uint8_t> key_;
+  std::vector<uint8_t> data_;
+};
+
+INSTANTIATE_TEST_CASE_P(BlockLengths, ReadAheadStorageTest,
+                        ::testing::Values(kBlockLength, kBlockLength4KiB));
+
+TEST_P(ReadAheadStorageTest, EnableTwiceFails) {
+  EXPECT_EQ(AeadHandler::GetInstance().EnableReadAhead(kReadAheadBytes), -1);
+  EXPECT_EQ(errno, EINVAL);
+}
+
+TEST_P(ReadAheadStorageTest, SequentialReadsMatchData) {
+  WriteData();
+
+  int fd = OpenWithKey(/*create=*/false);
+  ASSERT_GE(fd, 0);
+  bool failed;
+  EXPECT_EQ(ReadToEnd(fd, &failed), data_);
+  EXPECT_FALSE(failed);
+
+  // Reads after a seek start over, and still match the data.
+  const off_t offset = kDataLength / 3;
+  ASSERT_EQ(secure_lseek(fd, offset, SEEK_SET), offset);
+  EXPECT_EQ(ReadToEnd(fd, &failed),
+            std::vector<uint8_t>(data_.begin() + offset, data_.end()));
+  EXPECT_FALSE(failed);
+  EXPECT_EQ(secure_close(fd), 0);
+}
+
+TEST_P(ReadAheadStorageTest, RandomReadsMatchData) {
+  WriteData();
+
+  int fd = OpenWithKey(/*create=*/false);
+  ASSERT_GE(fd, 0);
+  std::vector<uint8_t> buffer(kReadLength);
+  for (int iter = 0; iter < 100; iter++) {
+    const off_t offset = (iter * 7919 * kReadLength) % kDataLength;
+    ASSERT_EQ(secure_lseek(fd, offset, SEEK_SET), offset);
+    // Two reads from each offset, the second continuing the first.
+    for (int read = 0; read < 2; read++) {
+      const off_t read_offset =
+          std::min<off_t>(offset + read * kReadLength, kDataLength);
+      const size_t read_length =
+          std::min<size_t>(kReadLength, kDataLength - read_offset);
+      ASSERT_EQ(secure_read(fd, buffer.data(), buffer.size()), read_length);
+      ASSERT_TRUE(std::equal(buffer.begin(), buffer.begin() + read_length,
+                             data_.begin() + read_offset));
+    }
+  }
+  EXPECT_EQ(secure_close(fd), 0);
+}
+
+TEST_P(ReadAheadStorageTest, WritesDuringReadsAreSeen) {
+  WriteData();
+
+  int fd = OpenWithKey(/*create=*/false);
+  ASSERT_GE(fd, 0);
+  std::vector<uint8_t> buffer(kReadLength);
+  for (int read = 0; read < 4; read++) {
+    ASSERT_EQ(secure_read(fd, buffer.data(), buffer.size()), buffer.size());
+  }
+
+  // Overwrite data just past the reads, which has been fetched ahead.
+  const off_t write_offset = 4 * kReadLength + 10;
+  std::vector<uint8_t> update(3 * GetParam());
+  ASSERT_EQ(RAND_bytes(update.data(), update.size()), 1);
+  ASSERT_EQ(secure_pwrite(fd, update.data(), update.size(), write_offset),
+            update.size());
+  std::copy(update.begin(), update.end(), data_.begin() + write_offset);
+
+  bool failed;
+  EXPECT_EQ(ReadToEnd(fd, &failed),
+            std::vector<uint8_t>(data_.begin() + 4 * kReadLength, data_.end()));
+  EXPECT_FALSE(failed);
+  EXPECT_EQ(secure_close(fd), 0);
+}
+
+TEST_P(ReadAheadStorageTest, ModifiedBlockFails) {
+  WriteData();
+
+  // Corrupt the auth tag of a block in the middle of the file, which is
+  // fetched ahead of the reads before it.
+  int fd = enc_untrusted_open(path_.c_str(), O_RDWR);
+  ASSERT_GE(fd, 0);
+  const size_t block_index = kDataLength / 2 / GetParam();
+  const off_t tag_offset =
+      kFileHashLength + sizeof(uint64_t) +
+      block_index * (GetParam() + kTagLength + kTokenLength) + GetParam();
+  uint8_t tag[kTagLength];
+  ASSERT_EQ(enc_untrusted_pread(fd, tag, sizeof(tag), tag_offset),
+            sizeof(tag));
+  for (uint8_t &byte : tag) {
+    byte ^= 0xff;
+  }
+  ASSERT_EQ(enc_untrusted_pwrite(fd, tag, sizeof(tag), tag_offset),
+            sizeof(tag));
+  enc_untrusted_close(fd);
+
+  fd = OpenWithKey(/*create=*/false);
+  ASSERT_GE(fd, 0);
+  bool failed;
+  std::vector<uint8_t> data = ReadToEnd(fd, &failed);
+  EXPECT_TRUE(failed);
+  EXPECT_LE(data.size(), block_index * GetParam());
+  EXPECT_TRUE(std::equal(data.begin(), data.end(), data_.begin()));
+  EXPECT_EQ(secure_close(fd), 0);
+}
+
+}  // namespace
+}  // namespace asylo
@@ -0,0 +1,442 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/storage/secure/shared_segment.h"
+
+#include <openssl/hmac.h>
+#include <openssl/mem.h>
+#include <openssl/rand.h>
+
+#include <algorithm>
+#include <cstring>
+
+#include "absl/base/attributes.h"
+#include "absl/memory/memory.h"
+#include "absl/strings/str_cat.h"
+#include "asylo/platform/arch/include/trusted/enclave_interface.h"
+#include "asylo/platform/arch/include/trusted/host_calls.h"
+#include "asylo/platform/core/trusted_global_state.h"
+#include "asylo/util/cleansing_types.h"
+#include "asylo/util/status_macros.h"
+
+namespace asylo {
+namespace platform {
+namespace storage {
+namespace {
+
+constexpr char kMagic[8] = {'A', 'S', 'Y', 'L', 'O', 'S', 'E', 'G'};
+constexpr uint32_t kVersion = 1;
+constexpr size_t kSaltLength = 32;
+constexpr size_t kNonceLength = 12;
+constexpr size_t kTagLength = 16;
+constexpr char kKeyLabel[] = "Asylo shared segment";
+
+// Length of a sealed page as stored in a segment.
+constexpr size_t kStoredPageLength = kSharedSegmentPageLength + kTagLength;
+
+// Largest number of nodes in the level of the tree kept in the enclave.
+constexpr uint64_t kMaxCachedNodes = 1024;
+
+// Domain separators of the hashes of leaves, inner nodes and the root.
+constexpr uint8_t kLeafPrefix = 0;
+constexpr uint8_t kNodePrefix = 1;
+constexpr uint8_t kRootPrefix = 2;
+
+struct SegmentHeader {
+  char magic[sizeof(kMagic)];
+  uint32_t version;
+  uint32_t page_length;
+  uint64_t data_size;
+  uint8_t salt[kSaltLength];
+} ABSL_ATTRIBUTE_PACKED;
+
+using Hash = std::array<uint8_t, SHA256_DIGEST_LENGTH>;
+
+// Returns the number of nodes in each level of the tree over |page_count|
+// pages, from the leaves up to the root. Each level pairs the nodes of the one
+// below, and the last node of a level with an odd number of nodes is promoted
+// unchanged.
+std::vector<uint64_t> LevelCounts(uint64_t page_count) {
+  std::vector<uint64_t> counts;
+  if (page_count == 0) {
+    return counts;
+  }
+  counts.push_back(page_count);
+  while (counts.back() > 1) {
+    counts.push_back((counts.back() + 1) / 2);
+  }
+  return counts;
+}
+
+Hash LeafHash(const uint8_t* stored_page) {
+  SHA256_CTX context;
+  SHA256_Init(&context);
+  SHA256_Update(&context, &kLeafPrefix, 1);
+  SHA256_Update(&context, stored_page, kStoredPageLength);
+  Hash hash;
+  SHA256_Final(hash.data(), &context);
+  return hash;
+}
+
+Hash NodeHash(const Hash& left, const Hash& right) {
+  SHA256_CTX context;
+  SHA256_Init(&context);
+  SHA256_Update(&context, &kNodePrefix, 1);
+  SHA256_Update(&context, left.data(), left.size());
+  SHA256_Update(&context, right.data(), right.size());
+  Hash hash;
+  SHA256_Final(hash.data(), &context);
+  return hash;
+}
+
+// Returns the level above |nodes|.
+std::vector<Hash> ParentLevel(const std::vector<Hash>& nodes) {
+  std::vector<Hash> parents;
+  parents.reserve((nodes.size() + 1) / 2);
+  for (size_t i = 0; i < nodes.size(); i += 2) {
+    parents.push_back(i + 1 < nodes.size() ? NodeHash(nodes[i], nodes[i + 1])
+                                           : nodes[i]);
+  }
+  return parents;
+}
+
+// Returns the root hash of a segment with |header| and the tree root
+// |tree_root|.
+std::string RootHash(const SegmentHeader& header, const Hash& tree_root) {
+  SHA256_CTX context;
+  SHA256_Init(&context);
+  SHA256_Update(&context, &kRootPrefix, 1);
+  SHA256_Update(&context, &header, sizeof(header));
+  SHA256_Update(&context, tree_root.data(), tree_root.size());
+  std::string root_hash(kSharedSegmentRootHashLength, '\0');
+  SHA256_Final(reinterpret_cast<uint8_t*>(&root_hash[0]), &context);
+  return root_hash;
+}
+
+// Returns the hash of the root of a tree whose top levels start with |level|.
+Hash TreeRoot(std::vector<Hash> level) {
+  if (level.empty()) {
+    Hash hash;
+    SHA256(nullptr, 0, hash.data());
+    return hash;
+  }
+  while (level.size() > 1) {
+    level = ParentLevel(level);
+  }
+  return level[0];
+}
+
+// Initializes |context| with the page key derived from |key| and |salt|.
+Status InitializeContext(ByteContainerView key, const uint8_t* salt,
+                         EVP_AEAD_CTX* context) {
+  if (key.size() != kSharedSegmentKeyLength) {
+    return Status(error::GoogleError::INVALID_ARGUMENT,
+                  "Invalid shared segment key length");
+  }
+  CleansingVector<uint8_t> message(kKeyLabel, kKeyLabel + strlen(kKeyLabel));
+  message.insert(message.end(), salt, salt + kSaltLength);
+  CleansingVector<uint8_t> page_key(SHA256_DIGEST_LENGTH);
+  unsigned int length = 0;
+  if (!HMAC(EVP_sha256(), key.data(), key.size(), message.data(),
+            message.size(), page_key.data(), &length) ||
+      length != page_key.size() ||
+      !EVP_AEAD_CTX_init(context, EVP_aead_aes_256_gcm(), page_key.data(),
+                         page_key.size(), kTagLength, nullptr)) {
+    return Status(error::GoogleError::INTERNAL,
+                  "Failed to derive shared segment key");
+  }
+  return Status::OkStatus();
+}
+
+void PageNonce(uint64_t page, uint8_t nonce[kNonceLength]) {
+  memset(nonce, 0, kNonceLength);
+  memcpy(nonce, &page, sizeof(page));
+}
+
+}  // namespace
+
+Status BuildSharedSegment(ByteContainerView key, ByteContainerView data,
+                          std::string* segment, std::string* root_hash) {
+  SegmentHeader header;
+  memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.version = kVersion;
+  header.page_length = kSharedSegmentPageLength;
+  header.data_size = data.size();
+  if (RAND_bytes(header.salt, sizeof(header.salt)) != 1) {
+    return Status(error::GoogleError::INTERNAL, "Failed to generate salt");
+  }
+
+  EVP_AEAD_CTX context;
+  ASYLO_RETURN_IF_ERROR(InitializeContext(key, header.salt, &context));
+
+  const uint64_t page_count =
+      (data.size() + kSharedSegmentPageLength - 1) / kSharedSegmentPageLength;
+  segment->assign(reinterpret_cast<const char*>(&header), sizeof(header));
+  segment->resize(sizeof(header) + page_count * kStoredPageLength);
+
+  std::vector<Hash> level;
+  level.reserve(page_count);
+  CleansingVector<uint8_t> plaintext(kSharedSegmentPageLength);
+  bool sealed = true;
+  for (uint64_t page = 0; page < page_count && sealed; ++page) {
+    const size_t offset = page * kSharedSegmentPageLength;
+    const size_t length =
+        std::min(kSharedSegmentPageLength, data.size() - offset);
+    std::fill(plaintext.begin(), plaintext.end(), 0);
+    memcpy(plaintext.data(), data.data() + offset, length);
+
+    uint8_t* stored = reinterpret_cast<uint8_t*>(&(*segment)[0]) +
+                      sizeof(header) + page * kStoredPageLength;
+    uint8_t nonce[kNonceLength];
+    PageNonce(page, nonce);
+    size_t stored_length = 0;
+    sealed = EVP_AEAD_CTX_seal(&context, stored, &stored_length,
+                               kStoredPageLength, nonce, sizeof(nonce),
+                               plaintext.data(), plaintext.size(), nullptr,
+                               0) == 1 &&
+             stored_length == kStoredPageLength;
+    if (sealed) {
+      level.push_back(LeafHash(stored));
+    }
+  }
+  EVP_AEAD_CTX_cleanup(&context);
+  if (!sealed) {
+    return Status(error::GoogleError::INTERNAL, "Failed to seal page");
+  }
+
+  // The levels are stored from the leaves up, including the root.
+  while (!level.empty()) {
+    for (const Hash& node : level) {
+      segment->append(reinterpret_cast<const char*>(node.data()), node.size());
+    }
+    if (level.size() == 1) {
+      break;
+    }
+    level = ParentLevel(level);
+  }
+  *root_hash = RootHash(header, TreeRoot(level));
+  return Status::OkStatus();
+}
+
+StatusOr<std::unique_ptr<SharedSegment>> SharedSegment::Open(
+    const std::string& name, ByteContainerView key) {
+  const EnclaveConfig* config;
+  ASYLO_ASSIGN_OR_RETURN(config, GetEnclaveConfig());
+  const SharedSegmentConfig* segment_config = nullptr;
+  for (const SharedSegmentConfig& candidate : config->shared_segments()) {
+    if (candidate.name() == name) {
+      segment_config = &candidate;
+      break;
+    }
+  }
+  if (!segment_config) {
+    return Status(error::GoogleError::NOT_FOUND,
+                  absl::StrCat("No shared segment named ", name,
+                               " in the enclave configuration"));
+  }
+
+  void* resource =
+      enc_untrusted_acquire_shared_resource(kMemBlockName, name.c_str());
+  if (!resource) {
+    return Status(error::GoogleError::NOT_FOUND,
+                  absl::StrCat("Shared segment ", name,
+                               " is not registered by the host"));
+  }
+  StatusOr<std::unique_ptr<SharedSegment>> segment_result =
+      Status(error::GoogleError::INVALID_ARGUMENT,
+             "Shared segment mapping is not in untrusted memory");
+  if (enc_is_outside_enclave(resource, sizeof(SharedSegmentMapping))) {
+    // The mapping is copied once so that the host cannot change it after it
+    // is validated.
+    SharedSegmentMapping mapping;
+    memcpy(&mapping, resource, sizeof(mapping));
+    segment_result = OpenMapping(mapping, key, segment_config->root_hash());
+  }
+  if (!segment_result.ok()) {
+    enc_untrusted_release_shared_resource(kMemBlockName, name.c_str());
+    return segment_result.status();
+  }
+  std::unique_ptr<SharedSegment> segment =
+      std::move(segment_result).ValueOrDie();
+  segment->resource_name_ = name;
+  return std::move(segment);
+}
+
+StatusOr<std::unique_ptr<SharedSegment>> SharedSegment::OpenMapping(
+    const SharedSegmentMapping& mapping, ByteContainerView key,
+    ByteContainerView root_hash) {
+  const void* base = reinterpret_cast<const void*>(mapping.address);
+  if (mapping.size < sizeof(SegmentHeader) ||
+      mapping.address + mapping.size < mapping.address ||
+      !enc_is_outside_enclave(base, mapping.size)) {
+    return Status(error::GoogleError::INVALID_ARGUMENT,
+                  "Shared segment mapping is not in untrusted memory");
+  }
+  auto segment = absl::WrapUnique(
+      new SharedSegment(static_cast<const uint8_t*>(base), mapping.size));
+  ASYLO_RETURN_IF_ERROR(segment->Initialize(key, root_hash));
+  return std::move(segment);
+}
+
+SharedSegment::SharedSegment(const uint8_t* base, uint64_t mapping_size)
+    : base_(base),
+      mapping_size_(mapping_size),
+      data_size_(0),
+      page_count_(0),
+      cached_level_(0),
+      context_initialized_(false) {}
+
+SharedSegment::~SharedSegment() {
+  if (context_initialized_) {
+    EVP_AEAD_CTX_cleanup(&context_);
+  }
+  if (!resource_name_.empty()) {
+    enc_untrusted_release_shared_resource(kMemBlockName,
+                                          resource_name_.c_str());
+  }
+}
+
+Status SharedSegment::Initialize(ByteContainerView key,
+                                 ByteContainerView root_hash) {
+  SegmentHeader header;
+  memcpy(&header, base_, sizeof(header));
+  if (memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 ||
+      header.version != kVersion ||
+      header.page_length != kSharedSegmentPageLength) {
+    return Status(error::GoogleError::DATA_LOSS,
+                  "Malformed shared segment header");
+  }
+  data_size_ = header.data_size;
+  if (data_size_ > mapping_size_) {
+    return Status(error::GoogleError::DATA_LOSS,
+                  "Shared segment is truncated");
+  }
+  page_count_ =
+      (data_size_ + kSharedSegmentPageLength - 1) / kSharedSegmentPageLength;
+
+  level_counts_ = LevelCounts(page_count_);
+  uint64_t offset = sizeof(header) + page_count_ * kStoredPageLength;
+  for (uint64_t count : level_counts_) {
+    level_offsets_.push_back(offset);
+    offset += count * SHA256_DIGEST_LENGTH;
+  }
+  if (offset != mapping_size_) {
+    return Status(error::GoogleError::DATA_LOSS,
+                  "Shared segment has the wrong size");
+  }
+
+  // The lowest level small enough to keep is copied into the enclave and
+  // checked against the root hash. Its nodes are trusted from then on.
+  cached_level_ = 0;
+  while (cached_level_ < level_counts_.size() &&
+         level_counts_[cached_level_] > kMaxCachedNodes) {
+    ++cached_level_;
+  }
+  if (cached_level_ < level_counts_.size()) {
+    cached_nodes_.resize(level_counts_[cached_level_]);
+    memcpy(cached_nodes_.data(), base_ + level_offsets_[cached_level_],
+           cached_nodes_.size() * SHA256_DIGEST_LENGTH);
+  }
+  const std::string expected_root = RootHash(header, TreeRoot(cached_nodes_));
+  if (root_hash.size() != expected_root.size() ||
+      CRYPTO_memcmp(root_hash.data(), expected_root.data(),
+                    expected_root.size()) != 0) {
+    return Status(error::GoogleError::DATA_LOSS,
+                  "Shared segment does not match its root hash");
+  }
+
+  ASYLO_RETURN_IF_ERROR(InitializeContext(key, header.salt, &context_));
+  context_initialized_ = true;
+  return Status::OkStatus();
+}
+
+Status SharedSegment::Read(void* buf, size_t count, uint64_t offset) const {
+  if (offset > data_size_ || count > data_size_ - offset) {
+    return Status(error::GoogleError::OUT_OF_RANGE,
+                  "Read past the end of the shared segment");
+  }
+  uint8_t* out = static_cast<uint8_t*>(buf);
+  CleansingVector<uint8_t> plaintext(kSharedSegmentPageLength);
+  while (count > 0) {
+    const uint64_t page = offset / kSharedSegmentPageLength;
+    const size_t page_offset = offset % kSharedSegmentPageLength;
+    const size_t length =
+        std::min(count, kSharedSegmentPageLength - page_offset);
+    if (length == kSharedSegmentPageLength) {
+      ASYLO_RETURN_IF_ERROR(ReadPage(page, out));
+    } else {
+      ASYLO_RETURN_IF_ERROR(ReadPage(page, plaintext.data()));
+      memcpy(out, plaintext.data() + page_offset, length);
+    }
+    out += length;
+    offset += length;
+    count -= length;
+  }
+  return Status::OkStatus();
+}
+
+Status SharedSegment::ReadPage(uint64_t page, uint8_t* plaintext) const {
+  // The page is validated and decrypted from a copy, so that the host cannot
+  // change it between the two.
+  std::vector<uint8_t> stored(kStoredPageLength);
+  memcpy(stored.data(),
+         base_ + sizeof(SegmentHeader) + page * kStoredPageLength,
+         stored.size());
+
+  Hash hash = LeafHash(stored.data());
+  uint64_t index = page;
+  for (size_t level = 0; level < cached_level_; ++level) {
+    const uint64_t sibling = index ^ 1;
+    if (sibling < level_counts_[level]) {
+      const Hash sibling_hash = ReadNode(level, sibling);
+      hash = index & 1 ? NodeHash(sibling_hash, hash)
+                       : NodeHash(hash, sibling_hash);
+    }
+    index /= 2;
+  }
+  if (CRYPTO_memcmp(hash.data(), cached_nodes_[index].data(), hash.size()) !=
+      0) {
+    return Status(error::GoogleError::DATA_LOSS,
+                  absl::StrCat("Shared segment page ", page,
+                               " failed validation"));
+  }
+
+  uint8_t nonce[kNonceLength];
+  PageNonce(page, nonce);
+  size_t plaintext_length = 0;
+  if (EVP_AEAD_CTX_open(&context_, plaintext, &plaintext_length,
+                        kSharedSegmentPageLength, nonce, sizeof(nonce),
+                        stored.data(), stored.size(), nullptr, 0) != 1 ||
+      plaintext_length != kSharedSegmentPageLength) {
+    return Status(error::GoogleError::DATA_LOSS,
+                  absl::StrCat("Failed to decrypt shared segment page ", page));
+  }
+  return Status::OkStatus();
+}
+
+SharedSegment::Hash SharedSegment::ReadNode(size_t level,
+                                            uint64_t index) const {
+  Hash hash;
+  memcpy(hash.data(), base_ + level_offsets_[level] + index * hash.size(),
+         hash.size());
+  return hash;
+}
+
+}  // namespace storage
+}  // namespace platform
+}  // namespace asylo
@@ -0,0 +1,148 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_PLATFORM_STORAGE_SECURE_SHARED_SEGMENT_H_
+#define ASYLO_PLATFORM_STORAGE_SECURE_SHARED_SEGMENT_H_
+
+#include <openssl/aead.h>
+#include <openssl/sha.h>
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "asylo/crypto/util/byte_container_view.h"
+#include "asylo/platform/common/shared_segment_mapping.h"
+#include "asylo/util/status.h"
+#include "asylo/util/statusor.h"
+
+namespace asylo {
+namespace platform {
+namespace storage {
+
+// Length of the key of a shared segment.
+constexpr size_t kSharedSegmentKeyLength = 32;
+
+// Length of plaintext in each page of a shared segment.
+constexpr size_t kSharedSegmentPageLength = 4096;
+
+// Length of the root hash of a shared segment.
+constexpr size_t kSharedSegmentRootHashLength = SHA256_DIGEST_LENGTH;
+
+// Builds a shared segment holding |data| encrypted under the
+// |kSharedSegmentKeyLength|-byte |key|, and sets |root_hash| to the hash that
+// authenticates it. The segment is written to a host file by the caller and
+// registered with EnclaveManager::RegisterSharedSegment(), and |root_hash| is
+// listed with its name in EnclaveConfig.shared_segments of the enclaves that
+// read it.
+Status BuildSharedSegment(ByteContainerView key, ByteContainerView data,
+                          std::string* segment, std::string* root_hash);
+
+// Read-only data kept once in untrusted memory and shared by all the enclaves
+// a host loads, such as models, dictionaries and lookup tables.
+//
+// A segment is a header, the pages of the data each sealed with AES-256-GCM
+// under a key derived from the segment key and a random salt, with the page
+// index as nonce, and the levels of a Merkle tree over the sealed pages. The
+// root hash covers the header and the tree, so the host cannot modify, move or
+// replace pages, or substitute another segment, without failing validation.
+//
+// Opening a segment copies one level of the tree of at most a few thousand
+// nodes into the enclave and checks it against the root hash. Each page is
+// then copied into the enclave, checked against that level and decrypted only
+// when it is read, so the enclave holds none of the data it does not read and
+// opening takes time independent of the size of the segment.
+//
+// Methods may be called concurrently from several threads.
+class SharedSegment {
+ public:
+  // Opens the segment the host registered under |name|, whose root hash is
+  // listed under that name in EnclaveConfig.shared_segments, with the
+  // |kSharedSegmentKeyLength|-byte |key|.
+  static StatusOr<std::unique_ptr<SharedSegment>> Open(const std::string& name,
+                                                       ByteContainerView key);
+
+  // Opens the segment held in the untrusted memory described by |mapping|,
+  // with the |kSharedSegmentKeyLength|-byte |key| and the expected
+  // |root_hash|.
+  static StatusOr<std::unique_ptr<SharedSegment>> OpenMapping(
+      const SharedSegmentMapping& mapping, ByteContainerView key,
+      ByteContainerView root_hash);
+
+  SharedSegment(const SharedSegment&) = delete;
+  SharedSegment& operator=(const SharedSegment&) = delete;
+
+  // Releases the shared resource of a segment opened by name.
+  ~SharedSegment();
+
+  // Reads |count| bytes of data at |offset| into |buf|. Returns an
+  // OUT_OF_RANGE error if the range extends past the end of the data, and a
+  // DATA_LOSS error if a page fails validation.
+  Status Read(void* buf, size_t count, uint64_t offset) const;
+
+  // Returns the length of the data.
+  uint64_t size() const { return data_size_; }
+
+ private:
+  using Hash = std::array<uint8_t, SHA256_DIGEST_LENGTH>;
+
+  SharedSegment(const uint8_t* base, uint64_t mapping_size);
+
+  // Validates the header and the tree of the segment against |root_hash| and
+  // initializes the context from |key|.
+  Status Initialize(ByteContainerView key, ByteContainerView root_hash);
+
+  // Validates |page| and decrypts it into |plaintext|, which holds
+  // |kSharedSegmentPageLength| bytes.
+  Status ReadPage(uint64_t page, uint8_t* plaintext) const;
+
+  // Returns node |index| of tree level |level|, copied from the host.
+  Hash ReadNode(size_t level, uint64_t index) const;
+
+  // Untrusted memory holding the segment.
+  const uint8_t* const base_;
+  const uint64_t mapping_size_;
+
+  // Name of the shared resource released when the segment is destroyed, or
+  // empty if the segment was not opened by name.
+  std::string resource_name_;
+
+  uint64_t data_size_;
+  uint64_t page_count_;
+
+  // Offset in the segment and number of nodes of each level of the tree, from
+  // the leaves up to the root.
+  std::vector<uint64_t> level_offsets_;
+  std::vector<uint64_t> level_counts_;
+
+  // The level of the tree kept in the enclave, against which pages are
+  // validated.
+  size_t cached_level_;
+  std::vector<Hash> cached_nodes_;
+
+  bool context_initialized_;
+  EVP_AEAD_CTX context_;
+};
+
+}  // namespace storage
+}  // namespace platform
+}  // namespace asylo
+
+#endif  // ASYLO_PLATFORM_STORAGE_SECURE_SHARED_SEGMENT_H_
@@ -0,0 +1,183 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+// Tests of shared read-only segments.
+
+#include "asylo/platform/storage/secure/shared_segment.h"
+
+#include <openssl/rand.h>
+
+#include <cstdlib>
+#include <random>
+#include <string>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include "asylo/test/util/status_matchers.h"
+#include "asylo/util/cleansing_types.h"
+
+namespace asylo {
+namespace {
+
+using platform::storage::BuildSharedSegment;
+using platform::storage::SharedSegment;
+using platform::storage::kSharedSegmentKeyLength;
+using platform::storage::kSharedSegmentPageLength;
+using ::testing::Not;
+
+class SharedSegmentTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    key_.resize(kSharedSegmentKeyLength);
+    ASSERT_EQ(RAND_bytes(key_.data(), key_.size()), 1);
+  }
+
+  ~SharedSegmentTest() override { free(mapped_); }
+
+  // Builds a segment holding |data| into |segment_| and |root_hash_|.
+  void Build(const std::string& data) {
+    ASSERT_THAT(BuildSharedSegment(key_, data, &segment_, &root_hash_),
+                IsOk());
+  }
+
+  // Opens |segment_| from a copy of it outside the enclave, as mapped by the
+  // host.
+  StatusOr<std::unique_ptr<SharedSegment>> Open() {
+    free(mapped_);
+    mapped_ = static_cast<char*>(malloc(segment_.size()));
+    memcpy(mapped_, segment_.data(), segment_.size());
+    SharedSegmentMapping mapping;
+    mapping.address = reinterpret_cast<uint64_t>(mapped_);
+    mapping.size = segment_.size();
+    return SharedSegment::OpenMapping(mapping, key_, root_hash_);
+  }
+
+  // Returns |length| bytes of |segment| read at |offset|, or the error
+  // message.
+  static std::string ReadAt(const SharedSegment& segment, uint64_t offset,
+                            size_t length) {
+    std::string data(length, '\0');
+    Status status = segment.Read(&data[0], length, offset);
+    return status.ok() ? data : status.ToString();
+  }
+
+  CleansingVector<uint8_t> key_;
+  std::string segment_;
+  std::string root_hash_;
+  char* mapped_ = nullptr;
+};
+
+TEST_F(SharedSegmentTest, ReadsMatchData) {
+  // Enough pages that the tree has levels above the one kept in the enclave.
+  std::mt19937 random(1);
+  std::string data(3000 * kSharedSegmentPageLength + 123, '\0');
+  for (char& c : data) {
+    c = static_cast<char>(random());
+  }
+  Build(data);
+  auto segment_result = Open();
+  ASSERT_THAT(segment_result, IsOk());
+  std::unique_ptr<SharedSegment> segment =
+      std::move(segment_result).ValueOrDie();
+  EXPECT_EQ(segment->size(), data.size());
+
+  for (int iter = 0; iter < 200; ++iter) {
+    size_t offset = random() % data.size();
+    size_t length =
+        std::min<size_t>(random() % (3 * kSharedSegmentPageLength),
+                         data.size() - offset);
+    ASSERT_EQ(ReadAt(*segment, offset, length), data.substr(offset, length))
+        << offset << " " << length;
+  }
+  EXPECT_EQ(ReadAt(*segment, 0, data.size()), data);
+
+  char c;
+  EXPECT_THAT(segment->Read(&c, 1, data.size()), Not(IsOk()));
+}
+
+TEST_F(SharedSegmentTest, EmptySegment) {
+  Build("");
+  auto segment_result = Open();
+  ASSERT_THAT(segment_result, IsOk());
+  EXPECT_EQ(segment_result.ValueOrDie()->size(), 0);
+}
+
+TEST_F(SharedSegmentTest, HostSeesOnlyCiphertext) {
+  Build(std::string(4 * kSharedSegmentPageLength, 'x'));
+  EXPECT_EQ(segment_.find(std::string(64, 'x')), std::string::npos);
+}
+
+TEST_F(SharedSegmentTest, ModifiedPageFailsWhenRead) {
+  const std::string data(4000 * kSharedSegmentPageLength, 'x');
+  Build(data);
+  // Pages start after the header. Modifying one is only detected when it is
+  // read.
+  segment_[100 + 2000 * (kSharedSegmentPageLength + 16)] ^= 1;
+  auto segment_result = Open();
+  ASSERT_THAT(segment_result, IsOk());
+  std::unique_ptr<SharedSegment> segment =
+      std::move(segment_result).ValueOrDie();
+  EXPECT_EQ(ReadAt(*segment, 0, 10), data.substr(0, 10));
+  char buf[10];
+  EXPECT_THAT(segment->Read(buf, sizeof(buf), 2000 * kSharedSegmentPageLength),
+              Not(IsOk()));
+}
+
+TEST_F(SharedSegmentTest, SwappedPagesFail) {
+  std::string data(2 * kSharedSegmentPageLength, 'a');
+  data.replace(kSharedSegmentPageLength, kSharedSegmentPageLength,
+               kSharedSegmentPageLength, 'b');
+  Build(data);
+  const size_t stored_length = kSharedSegmentPageLength + 16;
+  const size_t first = segment_.size() - 3 * 32 - 2 * stored_length;
+  std::string first_page = segment_.substr(first, stored_length);
+  segment_.replace(first, stored_length,
+                   segment_.substr(first + stored_length, stored_length));
+  segment_.replace(first + stored_length, stored_length, first_page);
+  auto segment_result = Open();
+  ASSERT_THAT(segment_result, IsOk());
+  char buf[10];
+  EXPECT_THAT(segment_result.ValueOrDie()->Read(buf, sizeof(buf), 0),
+              Not(IsOk()));
+}
+
+TEST_F(SharedSegmentTest, WrongRootHashOrKeyFails) {
+  Build(std::string(10 * kSharedSegmentPageLength, 'x'));
+  const std::string root_hash = root_hash_;
+  root_hash_[0] ^= 1;
+  EXPECT_THAT(Open(), Not(IsOk()));
+
+  // A segment built from other data does not match the root hash.
+  root_hash_ = root_hash;
+  std::string other_root_hash;
+  ASSERT_THAT(BuildSharedSegment(key_, std::string(10, 'y'), &segment_,
+                                 &other_root_hash),
+              IsOk());
+  EXPECT_THAT(Open(), Not(IsOk()));
+
+  Build(std::string(10, 'x'));
+  ASSERT_EQ(RAND_bytes(key_.data(), key_.size()), 1);
+  auto segment_result = Open();
+  ASSERT_THAT(segment_result, IsOk());
+  char buf[10];
+  EXPECT_THAT(segment_result.ValueOrDie()->Read(buf, sizeof(buf), 0),
+              Not(IsOk()));
+}
+
+}  // namespace
+}  // namespace asylo
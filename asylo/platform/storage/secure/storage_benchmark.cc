@@ -0,0 +1,359 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/storage/secure/storage_benchmark.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <openssl/rand.h>
+#include <time.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "asylo/platform/arch/include/trusted/host_calls.h"
+#include "asylo/platform/crypto/gcmlib/gcm_cryptor.h"
+#include "asylo/platform/storage/secure/aead_handler.h"
+#include "asylo/platform/storage/secure/enclave_storage_secure.h"
+#include "asylo/platform/storage/secure/merkle_authenticated_dictionary.h"
+#include "asylo/util/posix_error_space.h"
+
+namespace asylo {
+namespace {
+
+using platform::crypto::gcmlib::kKeyLength;
+using platform::storage::AeadHandler;
+using platform::storage::kIntegrityIndexSuffix;
+using platform::storage::MerkleAuthenticatedDictionary;
+
+constexpr int64_t kNanosecondsPerSecond = 1000000000;
+
+int64_t MonotonicNanoseconds() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return static_cast<int64_t>(ts.tv_sec) * kNanosecondsPerSecond + ts.tv_nsec;
+}
+
+// Returns the throughput of transferring |bytes| in |elapsed_ns|, in MB/s.
+double MegabytesPerSecond(int64_t bytes, int64_t elapsed_ns) {
+  return elapsed_ns > 0 ? static_cast<double>(bytes) * 1000 / elapsed_ns : 0.0;
+}
+
+Status ErrnoStatus(const std::string& operation) {
+  return Status(static_cast<error::PosixError>(errno),
+                absl::StrCat(operation, " failed"));
+}
+
+// The file under measurement, accessed through the backend selected by the
+// benchmark input.
+class BenchmarkFile {
+ public:
+  BenchmarkFile(const StorageBenchmarkInput& input,
+                const std::vector<uint8_t>& key)
+      : input_(input), key_(key), fd_(-1) {}
+
+  ~BenchmarkFile() { Close(); }
+
+  BenchmarkFile(const BenchmarkFile&) = delete;
+  BenchmarkFile& operator=(const BenchmarkFile&) = delete;
+
+  // Opens the file for reading and writing, creating it if |create| is true.
+  // Secure files are ready for IO once their key is set, which verifies the
+  // integrity metadata of existing files.
+  Status Open(bool create) {
+    const int flags = O_RDWR | (create ? O_CREAT : 0);
+    if (!is_secure()) {
+      fd_ = enc_untrusted_open(input_.path().c_str(), flags, 0600);
+      return fd_ < 0 ? ErrnoStatus("open") : Status::OkStatus();
+    }
+
+    fd_ = platform::storage::secure_open(
+        input_.path().c_str(),
+        flags | (input_.integrity_only() ? O_INTEGRITY_ONLY : 0), 0600);
+    if (fd_ < 0) {
+      return ErrnoStatus("secure_open");
+    }
+    AeadHandler& handler = AeadHandler::GetInstance();
+    if (create && input_.block_length() > 0 &&
+        handler.SetBlockLength(fd_, input_.block_length()) != 0) {
+      return ErrnoStatus("SetBlockLength");
+    }
+    if (handler.SetMasterKey(fd_, key_.data(), key_.size()) != 0) {
+      return ErrnoStatus("SetMasterKey");
+    }
+    return Status::OkStatus();
+  }
+
+  ssize_t Read(void* buf, size_t count) {
+    return is_secure() ? platform::storage::secure_read(fd_, buf, count)
+                       : enc_untrusted_read(fd_, buf, count);
+  }
+
+  ssize_t Write(const void* buf, size_t count) {
+    return is_secure() ? platform::storage::secure_write(fd_, buf, count)
+                       : enc_untrusted_write(fd_, buf, count);
+  }
+
+  ssize_t Pread(void* buf, size_t count, off_t offset) {
+    return is_secure()
+               ? platform::storage::secure_pread(fd_, buf, count, offset)
+               : enc_untrusted_pread(fd_, buf, count, offset);
+  }
+
+  ssize_t Pwrite(const void* buf, size_t count, off_t offset) {
+    return is_secure()
+               ? platform::storage::secure_pwrite(fd_, buf, count, offset)
+               : enc_untrusted_pwrite(fd_, buf, count, offset);
+  }
+
+  int Fsync() {
+    return is_secure() ? platform::storage::secure_fsync(fd_)
+                       : enc_untrusted_fsync(fd_);
+  }
+
+  // Closes the file, writing any data buffered by the secure IO layer.
+  Status Close() {
+    if (fd_ < 0) {
+      return Status::OkStatus();
+    }
+    int result = is_secure() ? platform::storage::secure_close(fd_)
+                             : enc_untrusted_close(fd_);
+    fd_ = -1;
+    return result != 0 ? ErrnoStatus("close") : Status::OkStatus();
+  }
+
+  // Removes the file, and the integrity index of a secure file.
+  void Remove() {
+    enc_untrusted_unlink(input_.path().c_str());
+    if (is_secure()) {
+      enc_untrusted_unlink(
+          absl::StrCat(input_.path(), kIntegrityIndexSuffix).c_str());
+    }
+  }
+
+ private:
+  bool is_secure() const {
+    return input_.backend() == StorageBenchmarkInput::SECURE;
+  }
+
+  const StorageBenchmarkInput& input_;
+  const std::vector<uint8_t>& key_;
+  int fd_;
+};
+
+// Writes the whole file sequentially, including the fsync which makes the
+// data durable.
+Status MeasureSequentialWrite(const StorageBenchmarkInput& input,
+                              BenchmarkFile* file,
+                              StorageBenchmarkOutput* output) {
+  std::vector<uint8_t> buf(input.io_size(), 0x5a);
+  const int64_t start = MonotonicNanoseconds();
+  for (int64_t offset = 0; offset < input.file_size();) {
+    const size_t count =
+        std::min<int64_t>(input.io_size(), input.file_size() - offset);
+    ssize_t result = file->Write(buf.data(), count);
+    if (result <= 0) {
+      return ErrnoStatus("write");
+    }
+    offset += result;
+  }
+  if (file->Fsync() != 0) {
+    return ErrnoStatus("fsync");
+  }
+  output->set_sequential_write_mbps(MegabytesPerSecond(
+      input.file_size(), MonotonicNanoseconds() - start));
+  return Status::OkStatus();
+}
+
+Status MeasureSequentialRead(const StorageBenchmarkInput& input,
+                             BenchmarkFile* file,
+                             StorageBenchmarkOutput* output) {
+  std::vector<uint8_t> buf(input.io_size());
+  int64_t total = 0;
+  const int64_t start = MonotonicNanoseconds();
+  ssize_t result;
+  while ((result = file->Read(buf.data(), buf.size())) > 0) {
+    total += result;
+  }
+  const int64_t elapsed = MonotonicNanoseconds() - start;
+  if (result < 0) {
+    return ErrnoStatus("read");
+  }
+  if (total != input.file_size()) {
+    return Status(error::GoogleError::DATA_LOSS,
+                  absl::StrCat("Read ", total, " bytes of ",
+                               input.file_size()));
+  }
+  output->set_sequential_read_mbps(MegabytesPerSecond(total, elapsed));
+  return Status::OkStatus();
+}
+
+// Reads and then writes |input.random_ops()| times at random offsets which are
+// multiples of |input.io_size()|. The random writes include a final fsync.
+Status MeasureRandomAccess(const StorageBenchmarkInput& input,
+                           BenchmarkFile* file, std::mt19937* random,
+                           StorageBenchmarkOutput* output) {
+  if (input.random_ops() <= 0) {
+    return Status::OkStatus();
+  }
+  std::uniform_int_distribution<int64_t> slot(
+      0, input.file_size() / input.io_size() - 1);
+  std::vector<uint8_t> buf(input.io_size());
+  const int64_t bytes = static_cast<int64_t>(input.random_ops()) *
+                        input.io_size();
+
+  int64_t start = MonotonicNanoseconds();
+  for (int i = 0; i < input.random_ops(); ++i) {
+    if (file->Pread(buf.data(), buf.size(), slot(*random) * input.io_size()) !=
+        input.io_size()) {
+      return ErrnoStatus("pread");
+    }
+  }
+  output->set_random_read_mbps(
+      MegabytesPerSecond(bytes, MonotonicNanoseconds() - start));
+
+  start = MonotonicNanoseconds();
+  for (int i = 0; i < input.random_ops(); ++i) {
+    if (file->Pwrite(buf.data(), buf.size(),
+                     slot(*random) * input.io_size()) != input.io_size()) {
+      return ErrnoStatus("pwrite");
+    }
+  }
+  if (file->Fsync() != 0) {
+    return ErrnoStatus("fsync");
+  }
+  output->set_random_write_mbps(
+      MegabytesPerSecond(bytes, MonotonicNanoseconds() - start));
+  return Status::OkStatus();
+}
+
+Status MeasureFsync(const StorageBenchmarkInput& input, BenchmarkFile* file,
+                    std::mt19937* random, StorageBenchmarkOutput* output) {
+  if (input.fsync_ops() <= 0) {
+    return Status::OkStatus();
+  }
+  std::uniform_int_distribution<int64_t> slot(
+      0, input.file_size() / input.io_size() - 1);
+  std::vector<uint8_t> buf(input.io_size(), 0xa5);
+  const int64_t start = MonotonicNanoseconds();
+  for (int i = 0; i < input.fsync_ops(); ++i) {
+    if (file->Pwrite(buf.data(), buf.size(),
+                     slot(*random) * input.io_size()) != input.io_size()) {
+      return ErrnoStatus("pwrite");
+    }
+    if (file->Fsync() != 0) {
+      return ErrnoStatus("fsync");
+    }
+  }
+  output->set_fsync_ns((MonotonicNanoseconds() - start) / input.fsync_ops());
+  return Status::OkStatus();
+}
+
+// Measures updating one leaf of an authenticated dictionary with a leaf per
+// block of the file, and computing the new root - the integrity work of
+// writing a single block.
+void MeasureMerkleRoot(const StorageBenchmarkInput& input,
+                       std::mt19937* random, StorageBenchmarkOutput* output) {
+  const int64_t block_length =
+      input.block_length() > 0 ? input.block_length()
+                               : platform::storage::kBlockLength;
+  const int64_t leaf_count =
+      (input.file_size() + block_length - 1) / block_length;
+  if (input.random_ops() <= 0 || leaf_count == 0) {
+    return;
+  }
+
+  MerkleAuthenticatedDictionary dictionary;
+  for (int64_t leaf = 0; leaf < leaf_count; ++leaf) {
+    dictionary.AddLeaf(std::to_string(leaf));
+  }
+  dictionary.CurrentRoot();
+
+  std::uniform_int_distribution<int64_t> leaf(1, leaf_count);
+  const int64_t start = MonotonicNanoseconds();
+  for (int i = 0; i < input.random_ops(); ++i) {
+    dictionary.UpdateLeaf(leaf(*random), std::to_string(i));
+    dictionary.CurrentRoot();
+  }
+  output->set_merkle_root_ns((MonotonicNanoseconds() - start) /
+                             input.random_ops());
+}
+
+Status RunPhases(const StorageBenchmarkInput& input, BenchmarkFile* file,
+                 StorageBenchmarkOutput* output) {
+  std::mt19937 random(input.random_seed());
+
+  Status status = file->Open(/*create=*/true);
+  if (!status.ok() ||
+      !(status = MeasureSequentialWrite(input, file, output)).ok() ||
+      !(status = file->Close()).ok()) {
+    return status;
+  }
+
+  const int64_t start = MonotonicNanoseconds();
+  if (!(status = file->Open(/*create=*/false)).ok()) {
+    return status;
+  }
+  output->set_open_ns(MonotonicNanoseconds() - start);
+
+  if (!(status = MeasureSequentialRead(input, file, output)).ok() ||
+      !(status = MeasureRandomAccess(input, file, &random, output)).ok() ||
+      !(status = MeasureFsync(input, file, &random, output)).ok() ||
+      !(status = file->Close()).ok()) {
+    return status;
+  }
+
+  if (input.backend() == StorageBenchmarkInput::SECURE) {
+    MeasureMerkleRoot(input, &random, output);
+  }
+  return Status::OkStatus();
+}
+
+}  // namespace
+
+Status RunStorageBenchmark(const StorageBenchmarkInput& input,
+                           StorageBenchmarkOutput* output) {
+  if (input.backend() != StorageBenchmarkInput::SECURE &&
+      input.backend() != StorageBenchmarkInput::UNTRUSTED) {
+    return Status(error::GoogleError::INVALID_ARGUMENT,
+                  "Unknown benchmark backend");
+  }
+  if (input.path().empty() || input.io_size() <= 0 ||
+      input.file_size() < input.io_size()) {
+    return Status(error::GoogleError::INVALID_ARGUMENT,
+                  "Benchmark needs a path, and a file of at least one IO");
+  }
+
+  std::vector<uint8_t> key(kKeyLength);
+  if (RAND_bytes(key.data(), key.size()) != 1) {
+    return Status(error::GoogleError::INTERNAL, "Failed to generate a key");
+  }
+
+  BenchmarkFile file(input, key);
+  file.Remove();
+  Status status = RunPhases(input, &file, output);
+  file.Close();
+  file.Remove();
+  return status;
+}
+
+}  // namespace asylo
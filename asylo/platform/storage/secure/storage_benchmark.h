@@ -0,0 +1,41 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_PLATFORM_STORAGE_SECURE_STORAGE_BENCHMARK_H_
+#define ASYLO_PLATFORM_STORAGE_SECURE_STORAGE_BENCHMARK_H_
+
+#include "asylo/platform/storage/secure/storage_benchmark.pb.h"
+#include "asylo/util/status.h"
+
+namespace asylo {
+
+// Creates the file at |input.path()|, writes |input.file_size()| bytes to it
+// sequentially and reads them back in |input.io_size()| calls, reopens it, and
+// performs |input.random_ops()| reads and writes at random aligned offsets and
+// |input.fsync_ops()| writes each followed by fsync. Throughput and latency of
+// each phase are stored in |output|, and the file is removed.
+//
+// Secure files are accessed through the secure storage library, and untrusted
+// files through host calls, so that both backends are measured from inside
+// the enclave with the same access pattern.
+Status RunStorageBenchmark(const StorageBenchmarkInput& input,
+                           StorageBenchmarkOutput* output);
+
+}  // namespace asylo
+
+#endif  // ASYLO_PLATFORM_STORAGE_SECURE_STORAGE_BENCHMARK_H_
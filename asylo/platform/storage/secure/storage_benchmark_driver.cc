@@ -0,0 +1,207 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+// Measures open latency, sequential and random throughput, fsync cost and
+// Merkle root computation time of secure storage files inside an enclave, and
+// of plain host files accessed from the same enclave for comparison. Whether
+// the enclave runs in hardware or simulation mode is decided when it is built;
+// pass --enclave_label to tell the two apart in the report.
+
+#include <stdio.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_split.h"
+#include "asylo/benchmarks/benchmark_report.h"
+#include "asylo/client.h"
+#include "asylo/platform/storage/secure/storage_benchmark.pb.h"
+#include "asylo/util/logging.h"
+#include "gflags/gflags.h"
+
+DEFINE_string(enclave_path, "", "Path to the benchmark enclave");
+DEFINE_string(backends, "untrusted,secure",
+              "Comma-separated file backends to measure: untrusted and secure");
+DEFINE_string(file_sizes, "1048576,16777216",
+              "Comma-separated file sizes in bytes");
+DEFINE_string(block_lengths, "128,4096,65536",
+              "Comma-separated secure storage block lengths in bytes");
+DEFINE_int32(io_size, 4096, "Bytes per read and write call");
+DEFINE_int32(random_ops, 1000, "Random reads and writes measured per run");
+DEFINE_int32(fsync_ops, 100, "Write and fsync pairs measured per run");
+DEFINE_bool(integrity_only, false,
+            "Whether secure files are authenticated but not encrypted");
+DEFINE_int32(crypto_threads, 0,
+             "Secure storage threads encrypting and decrypting blocks");
+DEFINE_int64(block_cache_bytes, 0,
+             "Secure storage block cache capacity per file in bytes");
+DEFINE_int64(read_ahead_bytes, 0,
+             "Secure storage bytes read ahead of sequential reads per file");
+DEFINE_string(enclave_label, "enclave",
+              "Name reported for the enclave mode, e.g. sim or hw");
+DEFINE_string(test_dir, "/tmp", "Directory for the benchmark files");
+DEFINE_string(json_output, "", "File to also write the results to as JSON");
+
+namespace asylo {
+namespace {
+
+constexpr char kEnclaveName[] = "storage_benchmark";
+
+bool ParseBackend(const std::string &name,
+                  StorageBenchmarkInput::Backend *backend) {
+  if (name == "untrusted") {
+    *backend = StorageBenchmarkInput::UNTRUSTED;
+  } else if (name == "secure") {
+    *backend = StorageBenchmarkInput::SECURE;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+// Parses a comma-separated list of positive integers from |flag|.
+std::vector<int64_t> ParseSizes(const std::string &flag,
+                                const std::string &name) {
+  std::vector<int64_t> sizes;
+  for (const auto &size : absl::StrSplit(flag, ',')) {
+    int64_t value;
+    if (!absl::SimpleAtoi(size, &value) || value <= 0) {
+      LOG(QFATAL) << "Invalid " << name << ": " << size;
+    }
+    sizes.push_back(value);
+  }
+  return sizes;
+}
+
+}  // namespace
+}  // namespace asylo
+
+int main(int argc, char *argv[]) {
+  ::google::ParseCommandLineFlags(&argc, &argv, /*remove_flags=*/true);
+
+  std::vector<asylo::StorageBenchmarkInput::Backend> backends;
+  for (const auto &name : absl::StrSplit(FLAGS_backends, ',')) {
+    asylo::StorageBenchmarkInput::Backend backend;
+    if (!asylo::ParseBackend(std::string(name), &backend)) {
+      LOG(QFATAL) << "Unknown backend: " << name;
+    }
+    backends.push_back(backend);
+  }
+  std::vector<int64_t> file_sizes =
+      asylo::ParseSizes(FLAGS_file_sizes, "file size");
+  std::vector<int64_t> block_lengths =
+      asylo::ParseSizes(FLAGS_block_lengths, "block length");
+
+  asylo::EnclaveManager::Configure(asylo::EnclaveManagerOptions());
+  auto manager_result = asylo::EnclaveManager::Instance();
+  if (!manager_result.ok()) {
+    LOG(QFATAL) << "EnclaveManager unavailable: " << manager_result.status();
+  }
+  asylo::EnclaveManager *manager = manager_result.ValueOrDie();
+  asylo::EnclaveConfig config;
+  config.set_secure_storage_crypto_threads(FLAGS_crypto_threads);
+  config.set_secure_storage_block_cache_bytes(FLAGS_block_cache_bytes);
+  config.set_secure_storage_read_ahead_bytes(FLAGS_read_ahead_bytes);
+  asylo::SGXLoader loader(FLAGS_enclave_path, /*debug=*/true);
+  asylo::Status status =
+      manager->LoadEnclave(asylo::kEnclaveName, loader, config);
+  if (!status.ok()) {
+    LOG(QFATAL) << "Load " << FLAGS_enclave_path << " failed: " << status;
+  }
+  asylo::EnclaveClient *client = manager->GetClient(asylo::kEnclaveName);
+
+  asylo::BenchmarkRecorder recorder("storage");
+  printf("%-9s %-8s %10s %6s %10s %8s %8s %8s %8s %10s %9s\n", "backend",
+         "mode", "bytes", "block", "open(us)", "seqW", "seqR", "rndW", "rndR",
+         "fsync(us)", "root(us)");
+  for (asylo::StorageBenchmarkInput::Backend backend : backends) {
+    // The block length only applies to secure files.
+    std::vector<int64_t> run_block_lengths = block_lengths;
+    if (backend != asylo::StorageBenchmarkInput::SECURE) {
+      run_block_lengths = {0};
+    }
+    for (int64_t file_size : file_sizes) {
+      for (int64_t block_length : run_block_lengths) {
+        asylo::StorageBenchmarkInput input;
+        input.set_backend(backend);
+        input.set_path(FLAGS_test_dir + "/storage_benchmark_" +
+                       std::to_string(getpid()));
+        input.set_file_size(file_size);
+        input.set_block_length(block_length);
+        input.set_io_size(FLAGS_io_size);
+        input.set_random_ops(FLAGS_random_ops);
+        input.set_fsync_ops(FLAGS_fsync_ops);
+        input.set_integrity_only(FLAGS_integrity_only);
+
+        asylo::EnclaveInput enclave_input;
+        *enclave_input.MutableExtension(asylo::storage_benchmark_input) =
+            input;
+        asylo::EnclaveOutput enclave_output;
+        status = client->EnterAndRun(enclave_input, &enclave_output);
+        if (!status.ok()) {
+          LOG(QFATAL) << "Benchmark run failed: " << status;
+        }
+        const asylo::StorageBenchmarkOutput &result =
+            enclave_output.GetExtension(asylo::storage_benchmark_output);
+        printf("%-9s %-8s %10lld %6lld %10.1f %8.1f %8.1f %8.1f %8.1f %10.1f "
+               "%9.1f\n",
+               asylo::StorageBenchmarkInput::Backend_Name(backend).c_str(),
+               FLAGS_enclave_label.c_str(), static_cast<long long>(file_size),
+               static_cast<long long>(block_length), result.open_ns() / 1000.0,
+               result.sequential_write_mbps(), result.sequential_read_mbps(),
+               result.random_write_mbps(), result.random_read_mbps(),
+               result.fsync_ns() / 1000.0, result.merkle_root_ns() / 1000.0);
+
+        asylo::BenchmarkResult *recorded = recorder.AddResult(
+            {{"backend", asylo::StorageBenchmarkInput::Backend_Name(backend)},
+             {"mode", FLAGS_enclave_label},
+             {"bytes", absl::StrCat(file_size)},
+             {"block", absl::StrCat(block_length)}});
+        asylo::AddMetric("open_us", result.open_ns() / 1000.0,
+                         asylo::BenchmarkMetric::LOWER_IS_BETTER, recorded);
+        asylo::AddMetric("seq_write_MBps", result.sequential_write_mbps(),
+                         asylo::BenchmarkMetric::HIGHER_IS_BETTER, recorded);
+        asylo::AddMetric("seq_read_MBps", result.sequential_read_mbps(),
+                         asylo::BenchmarkMetric::HIGHER_IS_BETTER, recorded);
+        asylo::AddMetric("rnd_write_MBps", result.random_write_mbps(),
+                         asylo::BenchmarkMetric::HIGHER_IS_BETTER, recorded);
+        asylo::AddMetric("rnd_read_MBps", result.random_read_mbps(),
+                         asylo::BenchmarkMetric::HIGHER_IS_BETTER, recorded);
+        asylo::AddMetric("fsync_us", result.fsync_ns() / 1000.0,
+                         asylo::BenchmarkMetric::LOWER_IS_BETTER, recorded);
+        asylo::AddMetric("root_us", result.merkle_root_ns() / 1000.0,
+                         asylo::BenchmarkMetric::LOWER_IS_BETTER, recorded);
+      }
+    }
+  }
+
+  asylo::EnclaveFinal final_input;
+  status = manager->DestroyEnclave(client, final_input);
+  if (!status.ok()) {
+    LOG(QFATAL) << "Destroy " << FLAGS_enclave_path << " failed: " << status;
+  }
+
+  status = recorder.WriteJson(FLAGS_json_output);
+  if (!status.ok()) {
+    LOG(QFATAL) << status;
+  }
+  return 0;
+}
@@ -40,6 +40,10 @@ namespace storage {
 // The physical offset evaluated by this class never falls into metadata
 // regions. Metadata regions are considered right-open in offset-increasing
 // direction.
+//
+// Instances created by Create translate offsets of a layout chosen at run
+// time. Layouts known at compile time are better served by
+// FixedOffsetTranslator.
 class OffsetTranslator {
  public:
   // Represents an invalid offset.
@@ -49,32 +53,116 @@ class OffsetTranslator {
                                                   size_t payload_len,
                                                   size_t block_len);
 
+  virtual ~OffsetTranslator() = default;
+
   // Converts the file's physical offset to its logical view exposed to the
   // client of the secure storage API. Returned kInvalidOffset indicates a
   // failure.
-  off_t PhysicalToLogical(off_t offset) const;
+  virtual off_t PhysicalToLogical(off_t offset) const;
 
   // Converts the file's logical offset exposed to the client of the secure
   // storage API to the corresponding physical offset in the file with metadata.
   // Returned kInvalidOffset indicates a failure.
-  off_t LogicalToPhysical(off_t offset) const;
+  virtual off_t LogicalToPhysical(off_t offset) const;
 
   // Given the logical offset and the total count of bytes in a range,
   // calculates the count of bytes in partial blocks, and the total count of
   // bytes in the full inclusive blocks. Expects non-negative |logical_offset|.
-  void ReduceLogicalRangeToFullLogicalBlocks(
+  virtual void ReduceLogicalRangeToFullLogicalBlocks(
       off_t logical_offset, size_t count,
       size_t* first_partial_block_bytes_count,
       size_t* last_partial_block_bytes_count,
-      size_t* full_inclusive_blocks_bytes_count);
+      size_t* full_inclusive_blocks_bytes_count) const;
 
- private:
+ protected:
   OffsetTranslator(size_t header_len, size_t payload_len, size_t block_len);
+
+ private:
   const size_t header_length_;
   const size_t payload_length_;
   const size_t block_length_;
 };
 
+// OffsetTranslator for a layout with a |kHeaderLength| byte header and
+// |kBlockLength| byte blocks holding |kPayloadLength| bytes of payload, fixed
+// at compile time. With constant lengths, the compiler replaces the divisions
+// of the translation with shifts for powers of two and with multiplications
+// otherwise. The static members translate offsets without a virtual call, and
+// may be evaluated at compile time.
+template <size_t kHeaderLength, size_t kPayloadLength, size_t kBlockLength>
+class FixedOffsetTranslator final : public OffsetTranslator {
+ public:
+  static_assert(kHeaderLength > 0 && kPayloadLength > 0 &&
+                    kPayloadLength < kBlockLength,
+                "Degenerate secure file layout");
+
+  FixedOffsetTranslator()
+      : OffsetTranslator(kHeaderLength, kPayloadLength, kBlockLength) {}
+
+  static constexpr off_t ToLogical(off_t offset) {
+    return offset < static_cast<off_t>(kHeaderLength)
+               ? kInvalidOffset
+               : (static_cast<size_t>(offset) - kHeaderLength) % kBlockLength >=
+                         kPayloadLength
+                     ? kInvalidOffset
+                     : static_cast<off_t>(
+                           (static_cast<size_t>(offset) - kHeaderLength) /
+                               kBlockLength * kPayloadLength +
+                           (static_cast<size_t>(offset) - kHeaderLength) %
+                               kBlockLength);
+  }
+
+  static constexpr off_t ToPhysical(off_t offset) {
+    return offset < 0 ? kInvalidOffset
+                      : static_cast<off_t>(
+                            kHeaderLength +
+                            static_cast<size_t>(offset) / kPayloadLength *
+                                kBlockLength +
+                            static_cast<size_t>(offset) % kPayloadLength);
+  }
+
+  static void ReduceToFullBlocks(off_t logical_offset, size_t count,
+                                 size_t* first_partial_block_bytes_count,
+                                 size_t* last_partial_block_bytes_count,
+                                 size_t* full_inclusive_blocks_bytes_count) {
+    size_t in_block_offset =
+        static_cast<size_t>(logical_offset) % kPayloadLength;
+    size_t first_partial =
+        in_block_offset > 0 ? kPayloadLength - in_block_offset : 0;
+    size_t last_partial = 0;
+    size_t full_blocks_bytes_count = 0;
+    if (first_partial >= count) {
+      first_partial = count;
+    } else {
+      last_partial = (count - first_partial) % kPayloadLength;
+      full_blocks_bytes_count = count - first_partial - last_partial;
+    }
+    *first_partial_block_bytes_count = first_partial;
+    *last_partial_block_bytes_count = last_partial;
+    *full_inclusive_blocks_bytes_count =
+        full_blocks_bytes_count + (first_partial > 0 ? kPayloadLength : 0) +
+        (last_partial > 0 ? kPayloadLength : 0);
+  }
+
+  off_t PhysicalToLogical(off_t offset) const override {
+    return ToLogical(offset);
+  }
+
+  off_t LogicalToPhysical(off_t offset) const override {
+    return ToPhysical(offset);
+  }
+
+  void ReduceLogicalRangeToFullLogicalBlocks(
+      off_t logical_offset, size_t count,
+      size_t* first_partial_block_bytes_count,
+      size_t* last_partial_block_bytes_count,
+      size_t* full_inclusive_blocks_bytes_count) const override {
+    ReduceToFullBlocks(logical_offset, count, first_partial_block_bytes_count,
+                       last_partial_block_bytes_count,
+                       full_inclusive_blocks_bytes_count);
+  }
+};
+
 }  // namespace storage
 }  // namespace platform
 }  // namespace asylo
@@ -25,6 +25,7 @@
 namespace asylo {
 namespace {
 
+using platform::storage::FixedOffsetTranslator;
 using platform::storage::OffsetTranslator;
 
 class OffsetTranslatorTest : public ::testing::Test,
@@ -191,5 +192,58 @@ TEST_P(OffsetTranslatorTest, ReduceLogicalRangeToFullLogicalBlocksTest) {
   }
 }
 
+// Fixed translators are evaluated at compile time.
+static_assert(FixedOffsetTranslator<10, 40, 50>::ToPhysical(85) == 115,
+              "Fixed logical to physical translation");
+static_assert(FixedOffsetTranslator<10, 40, 50>::ToLogical(115) == 85,
+              "Fixed physical to logical translation");
+static_assert(FixedOffsetTranslator<10, 40, 50>::ToLogical(55) ==
+                  kInvalidOffset,
+              "Fixed translation of metadata");
+
+// Checks that the fixed translator of a layout agrees with the translator
+// created for it at run time.
+template <size_t kHeaderLength, size_t kPayloadLength, size_t kBlockLength>
+void ExpectFixedMatchesRuntime() {
+  FixedOffsetTranslator<kHeaderLength, kPayloadLength, kBlockLength> fixed;
+  const OffsetTranslator &fixed_translator = fixed;
+  std::unique_ptr<OffsetTranslator> runtime_translator =
+      OffsetTranslator::Create(kHeaderLength, kPayloadLength, kBlockLength);
+  ASSERT_NE(runtime_translator, nullptr);
+
+  const off_t end = kHeaderLength + 4 * kBlockLength;
+  for (off_t offset = -1; offset < end; offset++) {
+    EXPECT_EQ(fixed_translator.PhysicalToLogical(offset),
+              runtime_translator->PhysicalToLogical(offset));
+    EXPECT_EQ(fixed_translator.LogicalToPhysical(offset),
+              runtime_translator->LogicalToPhysical(offset));
+  }
+
+  // Offsets and counts step through all positions in a block on small
+  // layouts, and through a sample of them on large ones.
+  const off_t offset_step = kPayloadLength / 16 + 1;
+  const size_t count_step = kPayloadLength / 16 + 3;
+  for (off_t offset = 0; offset < static_cast<off_t>(3 * kPayloadLength);
+       offset += offset_step) {
+    for (size_t count = 0; count < 3 * kPayloadLength; count += count_step) {
+      size_t fixed_counts[3];
+      size_t runtime_counts[3];
+      fixed_translator.ReduceLogicalRangeToFullLogicalBlocks(
+          offset, count, &fixed_counts[0], &fixed_counts[1], &fixed_counts[2]);
+      runtime_translator->ReduceLogicalRangeToFullLogicalBlocks(
+          offset, count, &runtime_counts[0], &runtime_counts[1],
+          &runtime_counts[2]);
+      EXPECT_THAT(fixed_counts, ::testing::ElementsAreArray(runtime_counts))
+          << "offset = " << offset << ", count = " << count;
+    }
+  }
+}
+
+TEST(FixedOffsetTranslatorTest, MatchesRuntimeTranslator) {
+  ExpectFixedMatchesRuntime<10, 40, 50>();
+  ExpectFixedMatchesRuntime<24, 128, 188>();
+  ExpectFixedMatchesRuntime<24, 4096, 4156>();
+}
+
 }  // namespace
 }  // namespace asylo
@@ -20,9 +20,12 @@
 
 #include <stdlib.h>
 
+#include <chrono>
+
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 #include "absl/strings/str_cat.h"
+#include "asylo/util/logging.h"
 
 namespace asylo {
 namespace {
@@ -31,6 +34,10 @@ constexpr size_t kNumThreads = 5;
 constexpr size_t kAllocations = 100;
 constexpr size_t kAllocationSize = 10000;
 
+// Parameters of the small allocation throughput test.
+constexpr size_t kSmallAllocationRounds = 2000;
+constexpr size_t kSmallAllocationsPerRound = 64;
+
 static void *MallocStress(void *) {
   void *mem[kAllocations];
   for (int i = 0; i < kAllocations; ++i) {
@@ -43,6 +50,30 @@ static void *MallocStress(void *) {
   return nullptr;
 }
 
+// Returned by SmallMallocStress when an allocation fails.
+char small_malloc_failed;
+
+// Repeatedly allocates and frees a batch of small objects of varying size.
+// Returns nullptr on success, or &small_malloc_failed if malloc fails.
+static void *SmallMallocStress(void *) {
+  void *mem[kSmallAllocationsPerRound];
+  for (int round = 0; round < kSmallAllocationRounds; ++round) {
+    for (int i = 0; i < kSmallAllocationsPerRound; ++i) {
+      mem[i] = malloc(16 + (i * 40) % 1024);
+      if (!mem[i]) {
+        for (int j = 0; j < i; ++j) {
+          free(mem[j]);
+        }
+        return &small_malloc_failed;
+      }
+    }
+    for (int i = 0; i < kSmallAllocationsPerRound; ++i) {
+      free(mem[i]);
+    }
+  }
+  return nullptr;
+}
+
 // Creates kNumThreads that run |MallocStress| and waits for all threads to
 // join.
 TEST(MallocTest, EnclaveMalloc) {
@@ -57,5 +88,29 @@ TEST(MallocTest, EnclaveMalloc) {
   }
 }
 
+// Runs |SmallMallocStress| on kNumThreads concurrently and reports the
+// aggregate rate of malloc/free pairs.
+TEST(MallocTest, SmallAllocationThroughput) {
+  pthread_t threads[kNumThreads];
+
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < kNumThreads; ++i) {
+    ASSERT_EQ(
+        pthread_create(&threads[i], nullptr, &SmallMallocStress, nullptr), 0);
+  }
+  for (int i = 0; i < kNumThreads; ++i) {
+    void *failed;
+    ASSERT_EQ(pthread_join(threads[i], &failed), 0);
+    EXPECT_EQ(failed, nullptr);
+  }
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+
+  double operations =
+      kNumThreads * kSmallAllocationRounds * kSmallAllocationsPerRound;
+  LOG(INFO) << "Small allocation throughput: " << operations / elapsed.count()
+            << " malloc/free pairs per second";
+}
+
 }  // namespace
 }  // namespace asylo
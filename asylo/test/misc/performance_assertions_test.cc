@@ -0,0 +1,84 @@
+/*
+ *
+ * Copyright 2017 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/test/util/performance_assertions.h"
+
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <gtest/gtest-spi.h>
+#include <gtest/gtest.h>
+
+namespace asylo {
+namespace {
+
+// Keeps the compiler from eliding the allocations of MallocAndFree().
+void *volatile allocation;
+
+void MallocAndFree(int count) {
+  for (int i = 0; i < count; ++i) {
+    allocation = malloc(16);
+    free(allocation);
+  }
+}
+
+void MallocTwiceWithLimitOfOne() {
+  EXPECT_MAX_ALLOCS(1);
+  MallocAndFree(2);
+}
+
+void AccessWithLimitOfZero() {
+  EXPECT_MAX_OCALLS(0);
+  access("/", F_OK);
+}
+
+TEST(PerformanceAssertionsTest, MallocsAreCounted) {
+  EXPECT_TRUE(MallocsCounted());
+}
+
+TEST(PerformanceAssertionsTest, MallocsWithinLimitPass) {
+  EXPECT_MAX_ALLOCS(3);
+  MallocAndFree(3);
+}
+
+TEST(PerformanceAssertionsTest, MallocsOverLimitFail) {
+  EXPECT_NONFATAL_FAILURE(MallocTwiceWithLimitOfOne(),
+                          "Expected at most 1 malloc calls, but 2 were made");
+}
+
+TEST(PerformanceAssertionsTest, NestedScopesAreCountedSeparately) {
+  EXPECT_MAX_ALLOCS(3);
+  MallocAndFree(1);
+  {
+    EXPECT_MAX_ALLOCS(2);
+    MallocAndFree(2);
+  }
+}
+
+TEST(PerformanceAssertionsTest, HostCallsOverLimitFail) {
+  if (!HostCallsCounted()) {
+    // Host calls are only counted in enclaves built with
+    // --define=ASYLO_INSTRUMENT_HOST_CALLS=1.
+    return;
+  }
+  EXPECT_NONFATAL_FAILURE(AccessWithLimitOfZero(),
+                          "Expected at most 0 host calls, but 1 were made");
+}
+
+}  // namespace
+}  // namespace asylo
@@ -0,0 +1,165 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <string>
+
+#include <gtest/gtest.h>
+#include "asylo/client.h"
+#include "asylo/identity/sealed_secret.pb.h"
+#include "asylo/test/util/enclave_test.h"
+#include "asylo/test/util/status_matchers.h"
+#include "asylo/util/status.h"
+
+namespace asylo {
+namespace {
+
+constexpr char kRestoredEnclaveUrl[] = "/snapshot_restored";
+
+class SnapshotTest : public EnclaveTest {
+ protected:
+  void SetUp() override {
+    EnclaveTest::SetUp();
+    StatusOr<EnclaveManager *> manager_result = EnclaveManager::Instance();
+    ASSERT_THAT(manager_result, IsOk());
+    manager_ = manager_result.ValueOrDie();
+  }
+
+  void TearDown() override { TearDownBase(/*skip_finalize=*/finalized_); }
+
+  // Sets the state of the enclave under test to |state|.
+  void SetState(const std::string &state) {
+    EnclaveInput input;
+    SetEnclaveInputTestString(&input, state);
+    ASSERT_THAT(client_->EnterAndRun(input, nullptr), IsOk());
+  }
+
+  // Returns the state of the enclave attached to |client|.
+  std::string GetState(EnclaveClient *client) {
+    EnclaveInput input;
+    EnclaveOutput output;
+    Status status = client->EnterAndRun(input, &output);
+    EXPECT_THAT(status, IsOk());
+    return GetEnclaveOutputTestString(output);
+  }
+
+  // Loads a second instance of the enclave under test, restored from
+  // |snapshot|, and returns the status of loading it.
+  Status LoadRestoredEnclave(const std::string &snapshot) {
+    EnclaveConfig config = config_;
+    config.set_snapshot(snapshot);
+    SGXLoader loader(FLAGS_enclave_path, /*debug=*/true);
+    return manager_->LoadEnclave(kRestoredEnclaveUrl, loader, config);
+  }
+
+  // Destroys the enclave loaded by LoadRestoredEnclave().
+  void DestroyRestoredEnclave() {
+    EnclaveClient *client = manager_->GetClient(kRestoredEnclaveUrl);
+    ASSERT_NE(client, nullptr);
+    EnclaveFinal final_input;
+    EXPECT_THAT(manager_->DestroyEnclave(client, final_input), IsOk());
+  }
+
+  EnclaveManager *manager_;
+
+  // Whether the enclave under test is already finalized.
+  bool finalized_ = false;
+};
+
+TEST_F(SnapshotTest, RestoreRoundTripsState) {
+  SetState("warmed up");
+  std::string snapshot;
+  ASSERT_THAT(manager_->SnapshotEnclave(client_, &snapshot), IsOk());
+
+  // The snapshot carries the state as it was when it was taken.
+  SetState("changed");
+  ASSERT_THAT(LoadRestoredEnclave(snapshot), IsOk());
+  EnclaveClient *restored = manager_->GetClient(kRestoredEnclaveUrl);
+  ASSERT_NE(restored, nullptr);
+  EXPECT_EQ(GetState(restored), "warmed up");
+  EXPECT_EQ(GetState(client_), "changed");
+  DestroyRestoredEnclave();
+}
+
+TEST_F(SnapshotTest, TamperedSnapshotFails) {
+  SetState("warmed up");
+  std::string snapshot;
+  ASSERT_THAT(manager_->SnapshotEnclave(client_, &snapshot), IsOk());
+  SealedSecret sealed_secret;
+  ASSERT_TRUE(sealed_secret.ParseFromString(snapshot));
+  ASSERT_FALSE(sealed_secret.secret_ciphertext().empty());
+
+  std::string ciphertext = sealed_secret.secret_ciphertext();
+  ciphertext[0] ^= 0xff;
+  sealed_secret.set_secret_ciphertext(ciphertext);
+  std::string tampered;
+  ASSERT_TRUE(sealed_secret.SerializeToString(&tampered));
+  EXPECT_THAT(LoadRestoredEnclave(tampered),
+              StatusIs(error::GoogleError::INVALID_ARGUMENT));
+
+  EXPECT_THAT(LoadRestoredEnclave("not a snapshot"),
+              StatusIs(error::GoogleError::INVALID_ARGUMENT));
+}
+
+TEST_F(SnapshotTest, WrongSecretNameFails) {
+  SetState("warmed up");
+  std::string snapshot;
+  ASSERT_THAT(manager_->SnapshotEnclave(client_, &snapshot), IsOk());
+  SealedSecret sealed_secret;
+  ASSERT_TRUE(sealed_secret.ParseFromString(snapshot));
+  SealedSecretHeader header;
+  ASSERT_TRUE(header.ParseFromString(sealed_secret.sealed_secret_header()));
+
+  header.set_secret_name("Some other secret");
+  ASSERT_TRUE(
+      header.SerializeToString(sealed_secret.mutable_sealed_secret_header()));
+  std::string renamed;
+  ASSERT_TRUE(sealed_secret.SerializeToString(&renamed));
+  EXPECT_THAT(LoadRestoredEnclave(renamed),
+              StatusIs(error::GoogleError::INVALID_ARGUMENT));
+}
+
+TEST_F(SnapshotTest, SnapshotOfStoppedEnclaveFails) {
+  // A failed reset leaves the enclave finalized.
+  EnclaveFinal final_input;
+  EXPECT_THAT(manager_->ResetEnclave(client_, final_input),
+              StatusIs(error::GoogleError::ABORTED));
+  finalized_ = true;
+
+  std::string snapshot;
+  EXPECT_THAT(manager_->SnapshotEnclave(client_, &snapshot),
+              StatusIs(error::GoogleError::FAILED_PRECONDITION));
+}
+
+TEST_F(SnapshotTest, DefaultSnapshotIsUnimplemented) {
+  // The enclave has no state, so it falls back to the default Snapshot().
+  std::string snapshot;
+  EXPECT_THAT(manager_->SnapshotEnclave(client_, &snapshot),
+              StatusIs(error::GoogleError::UNIMPLEMENTED));
+}
+
+TEST_F(SnapshotTest, DefaultRestoreIsUnimplemented) {
+  // The enclave falls back to the default Restore() for this state.
+  SetState("default");
+  std::string snapshot;
+  ASSERT_THAT(manager_->SnapshotEnclave(client_, &snapshot), IsOk());
+  EXPECT_THAT(LoadRestoredEnclave(snapshot),
+              StatusIs(error::GoogleError::UNIMPLEMENTED));
+}
+
+}  // namespace
+}  // namespace asylo
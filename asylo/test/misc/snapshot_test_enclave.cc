@@ -0,0 +1,76 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <string>
+
+#include "asylo/crypto/util/byte_container_view.h"
+#include "asylo/test/util/enclave_test_application.h"
+#include "asylo/util/status.h"
+
+namespace asylo {
+
+// The restored state that makes the enclave fall back to the default Restore()
+// of TrustedApplication.
+constexpr char kDefaultRestoreState[] = "default";
+
+// An enclave whose application state is a string. Run() sets the state to the
+// input test string if there is one, and returns the state as the output test
+// string. An enclave without state falls back to the default Snapshot().
+class SnapshotTest : public EnclaveTestCase {
+ public:
+  SnapshotTest() = default;
+
+  Status Run(const EnclaveInput &input, EnclaveOutput *output) override {
+    std::string state = GetEnclaveInputTestString(input);
+    if (!state.empty()) {
+      state_ = state;
+    }
+    SetEnclaveOutputTestString(output, state_);
+    return Status::OkStatus();
+  }
+
+  Status Snapshot(std::string *state) override {
+    if (state_.empty()) {
+      return TrustedApplication::Snapshot(state);
+    }
+    *state = state_;
+    return Status::OkStatus();
+  }
+
+  Status Restore(const EnclaveConfig &config,
+                 ByteContainerView state) override {
+    std::string restored(state.begin(), state.end());
+    if (restored == kDefaultRestoreState) {
+      return TrustedApplication::Restore(config, state);
+    }
+    state_ = restored;
+    return Status::OkStatus();
+  }
+
+  // Fails, which leaves the enclave finalized rather than running.
+  Status Reset(const EnclaveFinal &final_input) override {
+    return Status(error::GoogleError::ABORTED, "Reset is not supported");
+  }
+
+ private:
+  std::string state_;
+};
+
+TrustedApplication *BuildTrustedApplication() { return new SnapshotTest; }
+
+}  // namespace asylo
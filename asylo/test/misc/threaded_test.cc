@@ -16,7 +16,10 @@
  *
  */
 
+#include <errno.h>
 #include <pthread.h>
+#include <semaphore.h>
+#include <time.h>
 
 #include <cstdio>
 #include <mutex>
@@ -106,5 +109,189 @@ TEST(ThreadedTest, EnclaveThread) {
   }
 }
 
+constexpr int kIncrementsPerThread = 1000;
+
+static pthread_rwlock_t rwlock = PTHREAD_RWLOCK_INITIALIZER;
+static int guarded_count = 0;
+
+void *write_then_read(void *arg) {
+  for (int i = 0; i < kIncrementsPerThread; ++i) {
+    pthread_rwlock_wrlock(&rwlock);
+    ++guarded_count;
+    pthread_rwlock_unlock(&rwlock);
+
+    pthread_rwlock_rdlock(&rwlock);
+    int seen = guarded_count;
+    pthread_rwlock_unlock(&rwlock);
+    if (seen <= i) {
+      return nullptr;
+    }
+  }
+  return arg;
+}
+
+// Tests that readers share a pthread_rwlock_t, that writers exclude readers and
+// other writers, and that the lock is handed over between threads.
+TEST(ThreadedTest, RwLock) {
+  ASSERT_EQ(pthread_rwlock_rdlock(&rwlock), 0);
+  ASSERT_EQ(pthread_rwlock_tryrdlock(&rwlock), 0);
+  EXPECT_EQ(pthread_rwlock_trywrlock(&rwlock), EBUSY);
+  EXPECT_EQ(pthread_rwlock_destroy(&rwlock), EBUSY);
+  ASSERT_EQ(pthread_rwlock_unlock(&rwlock), 0);
+  ASSERT_EQ(pthread_rwlock_unlock(&rwlock), 0);
+  EXPECT_EQ(pthread_rwlock_unlock(&rwlock), EPERM);
+
+  ASSERT_EQ(pthread_rwlock_wrlock(&rwlock), 0);
+  EXPECT_EQ(pthread_rwlock_tryrdlock(&rwlock), EBUSY);
+  EXPECT_EQ(pthread_rwlock_trywrlock(&rwlock), EBUSY);
+  ASSERT_EQ(pthread_rwlock_unlock(&rwlock), 0);
+
+  pthread_t threads[2];
+  for (pthread_t &thread : threads) {
+    ASSERT_EQ(pthread_create(&thread, nullptr, write_then_read, &global_arg),
+              0);
+  }
+  for (pthread_t thread : threads) {
+    void *ret_val;
+    ASSERT_EQ(pthread_join(thread, &ret_val), 0);
+    EXPECT_EQ(ret_val, &global_arg);
+  }
+  EXPECT_EQ(guarded_count, 2 * kIncrementsPerThread);
+  EXPECT_EQ(pthread_rwlock_destroy(&rwlock), 0);
+}
+
+static sem_t items;
+static sem_t slots;
+static int buffer = 0;
+
+void *produce(void *arg) {
+  for (int i = 1; i <= kIncrementsPerThread; ++i) {
+    sem_wait(&slots);
+    buffer = i;
+    sem_post(&items);
+  }
+  return arg;
+}
+
+// Tests that a pair of semaphores hands values between threads in order.
+TEST(ThreadedTest, Semaphore) {
+  ASSERT_EQ(sem_init(&items, 0, 0), 0);
+  ASSERT_EQ(sem_init(&slots, 0, 1), 0);
+  int value;
+  ASSERT_EQ(sem_getvalue(&slots, &value), 0);
+  EXPECT_EQ(value, 1);
+  EXPECT_EQ(sem_trywait(&items), -1);
+  EXPECT_EQ(errno, EAGAIN);
+
+  pthread_t thread;
+  ASSERT_EQ(pthread_create(&thread, nullptr, produce, &global_arg), 0);
+  for (int i = 1; i <= kIncrementsPerThread; ++i) {
+    ASSERT_EQ(sem_wait(&items), 0);
+    EXPECT_EQ(buffer, i);
+    ASSERT_EQ(sem_post(&slots), 0);
+  }
+  void *ret_val;
+  ASSERT_EQ(pthread_join(thread, &ret_val), 0);
+  EXPECT_EQ(ret_val, &global_arg);
+
+  EXPECT_EQ(sem_destroy(&items), 0);
+  EXPECT_EQ(sem_destroy(&slots), 0);
+}
+
+static pthread_mutex_t ready_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t ready_cond = PTHREAD_COND_INITIALIZER;
+static bool ready = false;
+
+// Returns the CLOCK_REALTIME time |milliseconds| from now.
+struct timespec DeadlineAfter(int milliseconds) {
+  struct timespec deadline;
+  clock_gettime(CLOCK_REALTIME, &deadline);
+  deadline.tv_nsec += (milliseconds % 1000) * 1000000L;
+  deadline.tv_sec += milliseconds / 1000 + deadline.tv_nsec / 1000000000L;
+  deadline.tv_nsec %= 1000000000L;
+  return deadline;
+}
+
+void *set_ready(void *arg) {
+  pthread_mutex_lock(&ready_lock);
+  ready = true;
+  pthread_cond_signal(&ready_cond);
+  pthread_mutex_unlock(&ready_lock);
+  return arg;
+}
+
+// Tests that a timed wait times out when not signaled, both within and beyond
+// the nanosleep exit threshold, and returns early when signaled.
+TEST(ThreadedTest, CondTimedWait) {
+  ASSERT_EQ(pthread_mutex_lock(&ready_lock), 0);
+  struct timespec deadline = DeadlineAfter(1);
+  EXPECT_EQ(pthread_cond_timedwait(&ready_cond, &ready_lock, &deadline),
+            ETIMEDOUT);
+  deadline = DeadlineAfter(50);
+  EXPECT_EQ(pthread_cond_timedwait(&ready_cond, &ready_lock, &deadline),
+            ETIMEDOUT);
+  struct timespec now;
+  clock_gettime(CLOCK_REALTIME, &now);
+  EXPECT_TRUE(now.tv_sec > deadline.tv_sec ||
+              (now.tv_sec == deadline.tv_sec &&
+               now.tv_nsec >= deadline.tv_nsec));
+
+  pthread_t thread;
+  ASSERT_EQ(pthread_create(&thread, nullptr, set_ready, &global_arg), 0);
+  deadline = DeadlineAfter(60000);
+  while (!ready) {
+    ASSERT_EQ(pthread_cond_timedwait(&ready_cond, &ready_lock, &deadline), 0);
+  }
+  ASSERT_EQ(pthread_mutex_unlock(&ready_lock), 0);
+  void *ret_val;
+  ASSERT_EQ(pthread_join(thread, &ret_val), 0);
+
+  deadline.tv_nsec = 1000000000L;
+  ASSERT_EQ(pthread_mutex_lock(&ready_lock), 0);
+  EXPECT_EQ(pthread_cond_timedwait(&ready_cond, &ready_lock, &deadline),
+            EINVAL);
+  ASSERT_EQ(pthread_mutex_unlock(&ready_lock), 0);
+}
+
+static sem_t detached_done;
+
+void *post_detached_done(void *arg) {
+  sem_post(&detached_done);
+  return arg;
+}
+
+// Tests that detached threads run and release their resources without being
+// joined, whether detached when created or afterwards.
+TEST(ThreadedTest, DetachedThreads) {
+  ASSERT_EQ(sem_init(&detached_done, 0, 0), 0);
+
+  pthread_attr_t attr;
+  ASSERT_EQ(pthread_attr_init(&attr), 0);
+  ASSERT_EQ(pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED), 0);
+  int detach_state;
+  ASSERT_EQ(pthread_attr_getdetachstate(&attr, &detach_state), 0);
+  EXPECT_EQ(detach_state, PTHREAD_CREATE_DETACHED);
+
+  // More threads than the enclave has TCSs, so that descriptors and TCSs of
+  // returned threads must be reused.
+  constexpr int kDetachedThreads = 100;
+  for (int i = 0; i < kDetachedThreads; ++i) {
+    pthread_t thread;
+    if (i % 2 == 0) {
+      ASSERT_EQ(
+          pthread_create(&thread, &attr, post_detached_done, &global_arg), 0);
+    } else {
+      ASSERT_EQ(
+          pthread_create(&thread, nullptr, post_detached_done, &global_arg),
+          0);
+      ASSERT_EQ(pthread_detach(thread), 0);
+      EXPECT_NE(pthread_join(thread, nullptr), 0);
+    }
+    ASSERT_EQ(sem_wait(&detached_done), 0);
+  }
+  EXPECT_EQ(pthread_attr_destroy(&attr), 0);
+  EXPECT_EQ(sem_destroy(&detached_done), 0);
+}
+
 }  // namespace
 }  // namespace asylo
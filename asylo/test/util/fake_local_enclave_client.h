@@ -41,6 +41,12 @@ class FakeLocalEnclaveClient : public EnclaveClient {
     return enclave_->Run(input, output);
   }
 
+  Status EnterAndRunRaw(ByteContainerView input,
+                        std::string *output) override {
+    output->clear();
+    return enclave_->RunRaw(input, output).ToCanonical();
+  }
+
  private:
   Status EnterAndInitialize(const EnclaveConfig &config) override {
     return enclave_->Initialize(config);
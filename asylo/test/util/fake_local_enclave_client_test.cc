@@ -18,6 +18,9 @@
 
 #include "asylo/test/util/fake_local_enclave_client.h"
 
+#include <string>
+#include <vector>
+
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 #include "asylo/test/util/status_matchers.h"
@@ -35,6 +38,12 @@ class TrivialMockEnclave {
     return status_;
   }
 
+  Status RunRaw(ByteContainerView input, std::string *output) {
+    output->assign(reinterpret_cast<const char *>(input.data()),
+                   input.size());
+    return status_;
+  }
+
   Status Initialize(const EnclaveConfig &config) { return status_; }
 
   Status Finalize(const EnclaveFinal &final_input) { return status_; }
@@ -55,6 +64,28 @@ TEST(FakeLocalEnclaveClientTest, RunReturnsStatus) {
               StatusIs(error::GoogleError::INVALID_ARGUMENT));
 }
 
+TEST(FakeLocalEnclaveClientTest, RunRawPassesBytes) {
+  FakeLocalEnclaveClient<TrivialMockEnclave> client(
+      absl::make_unique<TrivialMockEnclave>(Status::OkStatus()));
+
+  std::string output = "stale";
+  EXPECT_THAT(client.EnterAndRunRaw("request", &output), IsOk());
+  EXPECT_EQ(output, "request");
+}
+
+TEST(FakeLocalEnclaveClientTest, RunBatchReturnsStatusOfEachInput) {
+  FakeLocalEnclaveClient<TrivialMockEnclave> client(
+      absl::make_unique<TrivialMockEnclave>(
+          Status(error::GoogleError::INVALID_ARGUMENT, "test")));
+
+  std::vector<EnclaveInput> inputs(3);
+  std::vector<EnclaveOutput> outputs(1);
+  EXPECT_THAT(client.EnterAndRunBatch(inputs, &outputs), IsOk());
+  ASSERT_EQ(outputs.size(), inputs.size());
+  for (const EnclaveOutput &output : outputs) {
+    EXPECT_EQ(output.status().code(), error::GoogleError::INVALID_ARGUMENT);
+  }
+}
 
 }  // namespace
 }  // namespace asylo
@@ -0,0 +1,107 @@
+/*
+ *
+ * Copyright 2017 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/test/util/performance_assertions.h"
+
+#include <string>
+
+#include "asylo/platform/arch/include/trusted/host_call_stats.h"
+#include "asylo/platform/arch/include/trusted/resource_usage.h"
+
+namespace asylo {
+
+ThreadPerformanceCounters GetThreadPerformanceCounters() {
+  ThreadPerformanceCounters counters = {};
+  ThreadHostCallCounts host_call_counts;
+  if (GetThreadHostCallCounts(&host_call_counts)) {
+    counters.host_calls_counted = true;
+    counters.host_calls = host_call_counts.calls;
+    counters.host_call_latency_ns = host_call_counts.total_latency_ns;
+  }
+  if (enc_get_thread_malloc_calls) {
+    counters.mallocs_counted = true;
+    counters.mallocs = enc_get_thread_malloc_calls();
+  }
+  return counters;
+}
+
+bool HostCallsCounted() {
+  return GetThreadPerformanceCounters().host_calls_counted;
+}
+
+bool MallocsCounted() { return GetThreadPerformanceCounters().mallocs_counted; }
+
+void PerformanceCountersListener::OnTestStart(
+    const ::testing::TestInfo &test_info) {
+  start_ = GetThreadPerformanceCounters();
+}
+
+void PerformanceCountersListener::OnTestEnd(
+    const ::testing::TestInfo &test_info) {
+  ThreadPerformanceCounters end = GetThreadPerformanceCounters();
+  if (end.host_calls_counted) {
+    ::testing::Test::RecordProperty(
+        "host_calls", std::to_string(end.host_calls - start_.host_calls));
+    ::testing::Test::RecordProperty(
+        "host_call_latency_ns",
+        std::to_string(end.host_call_latency_ns -
+                       start_.host_call_latency_ns));
+  }
+  if (end.mallocs_counted) {
+    ::testing::Test::RecordProperty(
+        "mallocs", std::to_string(end.mallocs - start_.mallocs));
+  }
+}
+
+namespace internal {
+
+MaxCallsExpectation::MaxCallsExpectation(Kind kind, uint64_t max_calls,
+                                         const char *file, int line)
+    : kind_(kind), max_calls_(max_calls), file_(file), line_(line) {
+  counted_ = CountCalls(&start_calls_);
+}
+
+MaxCallsExpectation::~MaxCallsExpectation() {
+  uint64_t end_calls;
+  if (!counted_ || !CountCalls(&end_calls)) {
+    return;
+  }
+  uint64_t calls = end_calls - start_calls_;
+  if (calls > max_calls_) {
+    ADD_FAILURE_AT(file_, line_)
+        << "Expected at most " << max_calls_
+        << (kind_ == Kind::kHostCalls ? " host calls" : " malloc calls")
+        << ", but " << calls << " were made";
+  }
+}
+
+bool MaxCallsExpectation::CountCalls(uint64_t *calls) const {
+  ThreadPerformanceCounters counters = GetThreadPerformanceCounters();
+  switch (kind_) {
+    case Kind::kHostCalls:
+      *calls = counters.host_calls;
+      return counters.host_calls_counted;
+    case Kind::kMallocs:
+      *calls = counters.mallocs;
+      return counters.mallocs_counted;
+  }
+  return false;
+}
+
+}  // namespace internal
+}  // namespace asylo
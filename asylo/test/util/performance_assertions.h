@@ -0,0 +1,132 @@
+/*
+ *
+ * Copyright 2017 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_TEST_UTIL_PERFORMANCE_ASSERTIONS_H_
+#define ASYLO_TEST_UTIL_PERFORMANCE_ASSERTIONS_H_
+
+// Expectations on the host calls and malloc calls made by code under test, for
+// tests run inside an enclave with cc_enclave_test.
+//
+// EXPECT_MAX_OCALLS(n) expects the calling thread to make at most |n| host
+// calls from where it appears to the end of the enclosing scope, and
+// EXPECT_MAX_ALLOCS(n) expects it to make at most |n| malloc calls. For
+// example:
+//
+//   TEST(ReadTest, CachedReadStaysInEnclave) {
+//     ...
+//     {
+//       EXPECT_MAX_OCALLS(0);
+//       EXPECT_MAX_ALLOCS(0);
+//       EXPECT_EQ(read(fd, buf, sizeof(buf)), sizeof(buf));
+//     }
+//   }
+//
+// Only the calls of the calling thread are counted, so that work done by other
+// threads does not make the expectations flaky.
+//
+// Host calls are only counted if the enclave was built with
+// --define=ASYLO_INSTRUMENT_HOST_CALLS=1, and malloc calls only if it links
+// //asylo/platform/posix/malloc:thread_caching_malloc. Expectations on calls
+// which are not counted are not checked. Tests which must not pass vacuously
+// can check HostCallsCounted() and MallocsCounted().
+
+#include <cstdint>
+
+#include <gtest/gtest.h>
+
+namespace asylo {
+
+// Calls made by the calling thread so far. A count is only meaningful if the
+// matching |*_counted| field is true.
+struct ThreadPerformanceCounters {
+  bool host_calls_counted;
+  uint64_t host_calls;
+  uint64_t host_call_latency_ns;
+
+  bool mallocs_counted;
+  uint64_t mallocs;
+};
+
+// Returns the counters of the calling thread.
+ThreadPerformanceCounters GetThreadPerformanceCounters();
+
+// Returns whether host calls and malloc calls are counted in this enclave.
+bool HostCallsCounted();
+bool MallocsCounted();
+
+// A test event listener which records the host calls, their total latency and
+// the malloc calls made by each test as the properties "host_calls",
+// "host_call_latency_ns" and "mallocs" of the test, which appear in its XML
+// report. Properties for calls which are not counted are not recorded.
+class PerformanceCountersListener : public ::testing::EmptyTestEventListener {
+ public:
+  void OnTestStart(const ::testing::TestInfo &test_info) override;
+  void OnTestEnd(const ::testing::TestInfo &test_info) override;
+
+ private:
+  ThreadPerformanceCounters start_;
+};
+
+namespace internal {
+
+// Implements EXPECT_MAX_OCALLS and EXPECT_MAX_ALLOCS. Adds a failure at |file|
+// and |line| if the calling thread makes more than |max_calls| calls of kind
+// |kind| during the lifetime of the object.
+class MaxCallsExpectation {
+ public:
+  enum class Kind { kHostCalls, kMallocs };
+
+  MaxCallsExpectation(Kind kind, uint64_t max_calls, const char *file,
+                      int line);
+  ~MaxCallsExpectation();
+
+  MaxCallsExpectation(const MaxCallsExpectation &) = delete;
+  MaxCallsExpectation &operator=(const MaxCallsExpectation &) = delete;
+
+ private:
+  // Sets |calls| to the calls of kind |kind_| made by the calling thread so
+  // far. Returns false if they are not counted.
+  bool CountCalls(uint64_t *calls) const;
+
+  const Kind kind_;
+  const uint64_t max_calls_;
+  const char *const file_;
+  const int line_;
+  bool counted_;
+  uint64_t start_calls_;
+};
+
+}  // namespace internal
+}  // namespace asylo
+
+#define ASYLO_PERFORMANCE_CONCAT_INNER(a, b) a##b
+#define ASYLO_PERFORMANCE_CONCAT(a, b) ASYLO_PERFORMANCE_CONCAT_INNER(a, b)
+
+#define EXPECT_MAX_OCALLS(n)                                              \
+  ::asylo::internal::MaxCallsExpectation ASYLO_PERFORMANCE_CONCAT(        \
+      asylo_max_ocalls_, __LINE__)(                                       \
+      ::asylo::internal::MaxCallsExpectation::Kind::kHostCalls, (n),      \
+      __FILE__, __LINE__)
+
+#define EXPECT_MAX_ALLOCS(n)                                              \
+  ::asylo::internal::MaxCallsExpectation ASYLO_PERFORMANCE_CONCAT(        \
+      asylo_max_allocs_, __LINE__)(                                       \
+      ::asylo::internal::MaxCallsExpectation::Kind::kMallocs, (n),        \
+      __FILE__, __LINE__)
+
+#endif  // ASYLO_TEST_UTIL_PERFORMANCE_ASSERTIONS_H_
@@ -18,14 +18,107 @@
 
 #include "asylo/util/error_space.h"
 
+#include <cstdint>
+
 namespace asylo {
 namespace error {
+namespace {
+
+// The maximum number of error spaces in a program.
+constexpr int kMaxErrorSpaces = 64;
+
+// The number of slots in the table indexing error spaces by name. It is a
+// power of two larger than kMaxErrorSpaces so that probe sequences are short.
+constexpr size_t kNameSlots = 256;
+
+struct RegisteredErrorSpace {
+  const ErrorSpace *space;
+  // The name of |space|, which is kept so that looking up a name does not
+  // call SpaceName(), and its hash.
+  const std::string *name;
+  size_t name_hash;
+};
+
+// The registered error spaces, indexed by ID. An entry is written once before
+// |num_error_spaces| is advanced past it, and never changes afterwards. All of
+// the tables here are constant-initialized, so error spaces may be registered
+// and found during the dynamic initialization of other globals.
+RegisteredErrorSpace error_spaces[kMaxErrorSpaces];
+std::atomic<int> num_error_spaces(0);
+std::atomic<int> next_error_space_id(0);
+
+// An open-addressed table of one plus the ID of each registered error space,
+// probed linearly from the hash of its name. Zero is an empty slot.
+std::atomic<int> ids_by_name[kNameSlots];
+
+// Returns the 64-bit FNV-1a hash of |name|.
+size_t HashName(const std::string &name) {
+  uint64_t hash = 0xcbf29ce484222325ULL;
+  for (unsigned char c : name) {
+    hash = (hash ^ c) * 0x100000001b3ULL;
+  }
+  return static_cast<size_t>(hash);
+}
+
+}  // namespace
+
+namespace error_internal {
+
+void RegisterErrorSpace(const ErrorSpace *space) {
+  std::string *name = new std::string(space->SpaceName());
+  if (ErrorSpace::Find(*name)) {
+    LOG(FATAL) << "Adding duplicate error space " << *name;
+  }
+  int id = next_error_space_id.fetch_add(1, std::memory_order_relaxed);
+  if (id >= kMaxErrorSpaces) {
+    LOG(FATAL) << "Too many error spaces to add " << *name;
+  }
+  size_t name_hash = HashName(*name);
+  error_spaces[id] = {space, name, name_hash};
+  space->id_.store(id, std::memory_order_relaxed);
+
+  // Publish the entry in ID order, so that |num_error_spaces| only covers
+  // complete entries.
+  int expected = id;
+  while (!num_error_spaces.compare_exchange_weak(expected, id + 1,
+                                                 std::memory_order_release,
+                                                 std::memory_order_relaxed)) {
+    expected = id;
+  }
+
+  for (size_t probe = 0;; ++probe) {
+    int empty = 0;
+    if (ids_by_name[(name_hash + probe) % kNameSlots].compare_exchange_strong(
+            empty, id + 1, std::memory_order_release,
+            std::memory_order_relaxed)) {
+      return;
+    }
+  }
+}
+
+}  // namespace error_internal
 
 ErrorSpace const *ErrorSpace::Find(const std::string &name) {
-  auto iter = error_internal::AsyloErrorSpaceStaticMap::GetValue(name);
-  return (iter == error_internal::AsyloErrorSpaceStaticMap::value_end())
-             ? nullptr
-             : &*iter;
+  size_t name_hash = HashName(name);
+  for (size_t probe = 0; probe < kNameSlots; ++probe) {
+    int slot = ids_by_name[(name_hash + probe) % kNameSlots].load(
+        std::memory_order_acquire);
+    if (slot == 0) {
+      return nullptr;
+    }
+    const RegisteredErrorSpace &entry = error_spaces[slot - 1];
+    if (entry.name_hash == name_hash && *entry.name == name) {
+      return entry.space;
+    }
+  }
+  return nullptr;
+}
+
+ErrorSpace const *ErrorSpace::FindById(int id) {
+  if (id < 0 || id >= num_error_spaces.load(std::memory_order_acquire)) {
+    return nullptr;
+  }
+  return error_spaces[id].space;
 }
 
 ErrorSpace const *GetErrorSpace(
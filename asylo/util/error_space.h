@@ -19,10 +19,11 @@
 #ifndef ASYLO_UTIL_ERROR_SPACE_H_
 #define ASYLO_UTIL_ERROR_SPACE_H_
 
+#include <atomic>
 #include <string>
 #include <unordered_map>
 
-#include "asylo/platform/common/static_map.h"
+#include "asylo/util/logging.h"
 
 // This file, along with the associated cc file, defines the basic
 // infrastructure for error-spaces that could be used with the
@@ -40,6 +41,15 @@ static constexpr char kCanonicalErrorSpaceName[] =
 // class for all error-space implementations.
 class ErrorSpace;
 
+namespace error_internal {
+
+// Registers |space| so that ErrorSpace::Find() can find it by name, and
+// assigns it the next integer ID. Registering a second error space with the
+// same name is fatal.
+void RegisterErrorSpace(const ErrorSpace *space);
+
+}  // namespace error_internal
+
 /// \cond Internal
 /// ErrorSpaceAdlTag is a zero-byte template struct that is used for invoking
 /// the correct implementation of GetErrorSpace() and related methods.
@@ -159,10 +169,12 @@ enum GoogleError : int {
 ///   2. An implementation of the ErrorSpace interface.
 ///   3. An implementation of an appropriately-typed GetErrorSpace() function.
 ///
-/// The error-space library maintains a global map of singletons for all the
-/// error-space implementations loaded into the current address space. This map
-/// can be queried to retrieve singleton pointers associated with a given name
-/// using the ErrorSpace::Find(const string &name) method. To enable seamless
+/// The error-space library maintains a global table of singletons for all the
+/// error-space implementations loaded into the current address space. Each
+/// registered error space is assigned a dense integer ID. The table can be
+/// queried to retrieve singleton pointers associated with a given name using
+/// the ErrorSpace::Find(const string &name) method, or with a given ID using
+/// ErrorSpace::FindById(int id). Lookups do not take locks. To enable seamless
 /// bookkeeping of such singletons, the error-space infrastructure defines an
 /// intermediate template class called ErrorSpaceImplementationHelper, which is
 /// derived from the ErrorSpace abstract class. Any error-space implementation
@@ -245,32 +257,46 @@ class ErrorSpace {
   /// \return A singleton pointer to an ErrorSpace on success, nullptr on
   ///         failure.
   static ErrorSpace const *Find(const std::string &name);
+
+  /// Finds and returns the ErrorSpace singleton pointer whose id() equals `id`.
+  /// \param id The ID to search for.
+  /// \return A singleton pointer to an ErrorSpace on success, nullptr on
+  ///         failure.
+  static ErrorSpace const *FindById(int id);
+
+  /// Gets the integer ID assigned to the error space when it was registered.
+  /// IDs are dense and start at zero, but depend on the order of registration,
+  /// so they differ between programs and must not be persisted or sent across
+  /// the enclave boundary.
+  /// \return The ID of this ErrorSpace, or -1 if it is not registered.
+  int id() const { return id_.load(std::memory_order_relaxed); }
+
+ private:
+  friend void error_internal::RegisterErrorSpace(const ErrorSpace *space);
+
+  mutable std::atomic<int> id_{-1};
 };
 
 /// \cond Internal
 namespace error_internal {
 
-// Namer object for the ErrorSpace base class. Used for creating an ErrorSpace
-// static map.
-struct ErrorSpaceNamer {
-  std::string operator()(const ErrorSpace &space) { return space.SpaceName(); }
+// Registers an error-space singleton when constructed.
+class ErrorSpaceInserter {
+ public:
+  explicit ErrorSpaceInserter(const ErrorSpace *space) {
+    RegisterErrorSpace(space);
+  }
 };
 
-// Static map providing a mapping from error-space name string to an error-space
-// singleton pointer.
-class AsyloErrorSpaceStaticMap
-    : public ::asylo::StaticMap<AsyloErrorSpaceStaticMap, const ErrorSpace,
-                                ErrorSpaceNamer> {};
-
 }  // namespace error_internal
 /// \endcond
 
 /// An intermediate template class that to help define an ErrorSpace subclass.
 /// ErrorSpaceImplementationHelper automatically creates and inserts a singleton
-/// instance of `ErrorSpaceT` into the global error-space singleton map. It is
+/// instance of `ErrorSpaceT` into the global error-space singleton table. It is
 /// customary to derive the class `ErrorSpaceT` from
 /// `ErrorSpaceImplementationHelper<ErrorSpaceT>` to ensure correct management
-/// of the map.
+/// of the table.
 template <typename ErrorSpaceT>
 class ErrorSpaceImplementationHelper : public ErrorSpace {
  protected:
@@ -330,7 +356,7 @@ class ErrorSpaceImplementationHelper : public ErrorSpace {
   }
 
  private:
-  using InserterType = error_internal::AsyloErrorSpaceStaticMap::ValueInserter;
+  using InserterType = error_internal::ErrorSpaceInserter;
   InserterType *DoNotOptimize(InserterType *inserter) { return inserter; }
   static InserterType inserter_;
   std::unordered_map<int, std::pair<std::string, GoogleError>> code_translation_map_;
@@ -340,9 +366,9 @@ class ErrorSpaceImplementationHelper : public ErrorSpace {
 
 /// \cond Internal
 // Instantiate inserter_ with a singleton pointer of |ErrorSpaceT| so that the
-// singleton pointer gets inserted into the global map.
+// singleton pointer gets inserted into the global table.
 template <typename ErrorSpaceT>
-error_internal::AsyloErrorSpaceStaticMap::ValueInserter
+error_internal::ErrorSpaceInserter
     ErrorSpaceImplementationHelper<ErrorSpaceT>::inserter_(
         GetErrorSpace(ErrorSpaceAdlTag<typename ErrorSpaceT::code_type>()));
 /// \endcond
@@ -69,6 +69,18 @@ TEST_F(ErrorSpaceTest, GoogleErrorSpaceInterface) {
   }
 }
 
+// Make sure that registered error spaces have IDs which find them, and that
+// looking up unknown names and IDs fails.
+TEST_F(ErrorSpaceTest, FindById) {
+  ErrorSpace const *space = error_enum_traits<GoogleError>::get_error_space();
+  EXPECT_GE(space->id(), 0);
+  EXPECT_EQ(ErrorSpace::FindById(space->id()), space);
+
+  EXPECT_EQ(ErrorSpace::Find("::asylo::error::NoSuchErrorSpace"), nullptr);
+  EXPECT_EQ(ErrorSpace::FindById(-1), nullptr);
+  EXPECT_EQ(ErrorSpace::FindById(1 << 20), nullptr);
+}
+
 }  // namespace
 }  // namespace error
 }  // namespace asylo
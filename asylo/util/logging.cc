@@ -21,16 +21,22 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <libgen.h>
+#include <pthread.h>
 #include <string.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
+#include <algorithm>
+#include <atomic>
 #include <cctype>
+#include <climits>
 #include <cstdio>
 #include <cstdlib>
 #include <ctime>
+#include <memory>
 #include <sstream>
 #include <string>
+#include <vector>
 
 namespace asylo {
 
@@ -51,15 +57,100 @@ std::string *log_file_directory = nullptr;
 // enclave name (enclave log).
 std::string *log_basename = nullptr;
 
+// Guards the VLOG thresholds and the list of registered VLOG sites.
+pthread_mutex_t vlog_lock = PTHREAD_MUTEX_INITIALIZER;
+
 // The VLOG level, only VLOG with level equal to or below this level is logged,
 // specified at the time the enclave is initialized.
-int vlog_level = 0;
+std::atomic<int> vlog_level(0);
+
+// A per-module VLOG threshold set with set_vmodule.
+struct VmoduleEntry {
+  std::string pattern;
+  int level;
+};
+
+// The per-module thresholds, in the order they were given.
+std::vector<VmoduleEntry> *vmodule_entries = nullptr;
+
+// The VLOG sites that have cached their threshold.
+internal::VlogSite *vlog_sites = nullptr;
 
 const char *GetBasename(const char *file_path) {
   const char *slash = strrchr(file_path, '/');
   return slash ? slash + 1 : file_path;
 }
 
+// Returns whether |name| matches |pattern|, in which '*' matches any sequence
+// of characters and '?' matches any one character.
+bool MatchPattern(const char *pattern, const char *name) {
+  for (; *pattern; ++pattern, ++name) {
+    if (*pattern == '*') {
+      for (const char *rest = name;; ++rest) {
+        if (MatchPattern(pattern + 1, rest)) {
+          return true;
+        }
+        if (!*rest) {
+          return false;
+        }
+      }
+    }
+    if (!*name || (*pattern != '?' && *pattern != *name)) {
+      return false;
+    }
+  }
+  return !*name;
+}
+
+// Returns the VLOG threshold of the sites in |file|. Must be called with
+// |vlog_lock| held.
+int GetFileVlogLevel(const char *file) {
+  if (vmodule_entries && !vmodule_entries->empty()) {
+    std::string path = file;
+    size_t dot = path.rfind('.');
+    if (dot != std::string::npos && path.find('/', dot) == std::string::npos) {
+      path.resize(dot);
+    }
+    const char *module = GetBasename(path.c_str());
+    for (const VmoduleEntry &entry : *vmodule_entries) {
+      bool has_slash = entry.pattern.find('/') != std::string::npos;
+      if (MatchPattern(entry.pattern.c_str(),
+                       has_slash ? path.c_str() : module)) {
+        return entry.level;
+      }
+    }
+  }
+  return vlog_level.load(std::memory_order_relaxed);
+}
+
+// Parses a `<pattern>=<level>` list into |entries|. Returns false if it is
+// malformed.
+bool ParseVmodule(const std::string &spec, std::vector<VmoduleEntry> *entries) {
+  size_t begin = 0;
+  while (begin < spec.size()) {
+    size_t end = spec.find(',', begin);
+    if (end == std::string::npos) {
+      end = spec.size();
+    }
+    std::string entry = spec.substr(begin, end - begin);
+    size_t equals = entry.find('=');
+    if (equals == 0 || equals == std::string::npos ||
+        equals + 1 == entry.size()) {
+      return false;
+    }
+    const char *level_text = entry.c_str() + equals + 1;
+    char *level_end;
+    errno = 0;
+    long level = strtol(level_text, &level_end, 10);
+    if (*level_end || errno || level < INT_MIN || level > INT_MAX) {
+      return false;
+    }
+    entries->push_back({entry.substr(0, equals), static_cast<int>(level)});
+    begin = end + 1;
+  }
+  return true;
+}
+
 // Builds a valid file name from a string.
 const std::string BuildFilename(std::string filename) {
   for (size_t i = 0; i < filename.size(); ++i) {
@@ -70,11 +161,28 @@ const std::string BuildFilename(std::string filename) {
   return filename;
 }
 
+// The log file is opened on first use and kept open, so that writing a message
+// costs a single write instead of an open, a write and a close. It is reopened
+// when the log directory or basename changes.
+pthread_mutex_t log_file_lock = PTHREAD_MUTEX_INITIALIZER;
+int log_file_fd = -1;
+
+// Closes the log file, so that the next write opens it at its current path.
+void ResetLogFile() {
+  pthread_mutex_lock(&log_file_lock);
+  if (log_file_fd >= 0) {
+    close(log_file_fd);
+    log_file_fd = -1;
+  }
+  pthread_mutex_unlock(&log_file_lock);
+}
+
 bool set_log_basename(const std::string &filename) {
   if (log_basename || filename.empty()) {
     return false;
   }
   log_basename = new std::string(filename);
+  ResetLogFile();
   return true;
 }
 
@@ -85,6 +193,178 @@ const std::string get_log_basename() {
   return *log_basename;
 }
 
+// Appends |size| bytes at |data| to the log file.
+void WriteLogFile(const char *data, size_t size) {
+  pthread_mutex_lock(&log_file_lock);
+  std::string log_path;
+  if (log_file_fd < 0) {
+    log_path = get_log_directory() + get_log_basename();
+    log_file_fd = open(log_path.c_str(), O_WRONLY | O_APPEND | O_CREAT, 0666);
+  }
+  if (log_file_fd < 0) {
+    pthread_mutex_unlock(&log_file_lock);
+    fprintf(stderr, "Failed to open log file : %s!\n", log_path.c_str());
+    return;
+  }
+  while (size > 0) {
+    ssize_t written = write(log_file_fd, data, size);
+    if (written < 0 && errno == EINTR) {
+      continue;
+    }
+    if (written <= 0) {
+      fprintf(stderr, "Failed to write to log file!\n");
+      break;
+    }
+    data += written;
+    size -= written;
+  }
+  pthread_mutex_unlock(&log_file_lock);
+}
+
+// A bounded, lock-free queue of log messages with many producers and a single
+// consumer. Each slot carries a sequence number which tells whether it is free
+// for the producer claiming it or filled for the consumer, as in Vyukov's
+// bounded queue.
+class AsyncLogQueue {
+ public:
+  explicit AsyncLogQueue(size_t capacity)
+      : mask_(capacity - 1), slots_(new Slot[capacity]) {
+    for (size_t i = 0; i < capacity; ++i) {
+      slots_[i].sequence.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  // Moves |message| into the queue. Returns false if the queue is full.
+  bool Push(std::string *message) {
+    size_t position = push_position_.load(std::memory_order_relaxed);
+    while (true) {
+      Slot *slot = &slots_[position & mask_];
+      size_t sequence = slot->sequence.load(std::memory_order_acquire);
+      intptr_t difference = static_cast<intptr_t>(sequence) -
+                            static_cast<intptr_t>(position);
+      if (difference == 0) {
+        if (push_position_.compare_exchange_weak(position, position + 1,
+                                                 std::memory_order_relaxed)) {
+          slot->message.swap(*message);
+          slot->sequence.store(position + 1, std::memory_order_release);
+          return true;
+        }
+      } else if (difference < 0) {
+        return false;
+      } else {
+        position = push_position_.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  // Moves the oldest message in the queue to |message|. Returns false if the
+  // queue is empty. Must not be called concurrently with itself.
+  bool Pop(std::string *message) {
+    Slot *slot = &slots_[pop_position_ & mask_];
+    if (slot->sequence.load(std::memory_order_acquire) != pop_position_ + 1) {
+      return false;
+    }
+    message->swap(slot->message);
+    slot->message.clear();
+    slot->sequence.store(pop_position_ + mask_ + 1, std::memory_order_release);
+    ++pop_position_;
+    return true;
+  }
+
+ private:
+  struct Slot {
+    std::atomic<size_t> sequence;
+    std::string message;
+  };
+
+  const size_t mask_;
+  std::unique_ptr<Slot[]> slots_;
+  std::atomic<size_t> push_position_{0};
+  size_t pop_position_ = 0;
+};
+
+// The most bytes the flusher writes in one batch.
+constexpr size_t kMaxAsyncLogBatchSize = 64 * 1024;
+
+// How long the flusher sleeps when it finds the queue empty.
+constexpr long kAsyncLogFlushIntervalNanoseconds = 2 * 1000 * 1000;
+
+// The queue producers push to, or nullptr if asynchronous logging is disabled.
+// The queue is never freed once created, since producers may still hold it.
+std::atomic<AsyncLogQueue *> async_log_queue{nullptr};
+AsyncLogQueue *created_async_log_queue = nullptr;
+
+// Serializes EnableAsyncLogging and DisableAsyncLogging.
+pthread_mutex_t async_log_control_lock = PTHREAD_MUTEX_INITIALIZER;
+pthread_t async_log_flusher;
+std::atomic<bool> async_log_stopping{false};
+
+// Held by the single consumer of the queue, which is usually the flusher.
+pthread_mutex_t async_log_drain_lock = PTHREAD_MUTEX_INITIALIZER;
+uint64_t reported_dropped_log_messages = 0;
+
+std::atomic<uint64_t> dropped_log_messages{0};
+
+// Writes a batch of queued messages to the log file and standard output.
+// Returns the number of messages written.
+size_t DrainAsyncLogQueue() {
+  pthread_mutex_lock(&async_log_drain_lock);
+  static std::string *batch = new std::string();
+  static std::string *message = new std::string();
+  size_t count = 0;
+  batch->clear();
+  while (batch->size() < kMaxAsyncLogBatchSize &&
+         created_async_log_queue->Pop(message)) {
+    batch->append(*message);
+    ++count;
+  }
+  uint64_t dropped = dropped_log_messages.load(std::memory_order_relaxed);
+  if (dropped != reported_dropped_log_messages) {
+    batch->append(std::to_string(dropped - reported_dropped_log_messages));
+    batch->append(" log messages dropped\n");
+    reported_dropped_log_messages = dropped;
+  }
+  if (!batch->empty()) {
+    WriteLogFile(batch->data(), batch->size());
+    fwrite(batch->data(), 1, batch->size(), stdout);
+    fflush(stdout);
+  }
+  pthread_mutex_unlock(&async_log_drain_lock);
+  return count;
+}
+
+// Writes out queued messages until the queue is empty.
+void FlushAsyncLogQueue() {
+  if (created_async_log_queue) {
+    while (DrainAsyncLogQueue() > 0) {
+    }
+  }
+}
+
+void *RunAsyncLogFlusher(void *) {
+  while (!async_log_stopping.load(std::memory_order_acquire)) {
+    if (DrainAsyncLogQueue() == 0) {
+      struct timespec interval = {0, kAsyncLogFlushIntervalNanoseconds};
+      nanosleep(&interval, nullptr);
+    }
+  }
+  return nullptr;
+}
+
+// Queues |size| bytes at |text| for the flusher. Returns false if
+// asynchronous logging is disabled.
+bool QueueAsyncLog(const char *text, size_t size) {
+  AsyncLogQueue *queue = async_log_queue.load(std::memory_order_acquire);
+  if (!queue) {
+    return false;
+  }
+  std::string line(text, size);
+  if (!queue->Push(&line)) {
+    dropped_log_messages.fetch_add(1, std::memory_order_relaxed);
+  }
+  return true;
+}
+
 }  // namespace
 
 bool set_log_directory(const std::string &log_directory) {
@@ -100,6 +380,7 @@ bool set_log_directory(const std::string &log_directory) {
   } else {
     log_file_directory = new std::string(tmp_directory + "/");
   }
+  ResetLogFile();
   return true;
 }
 
@@ -110,9 +391,56 @@ const std::string get_log_directory() {
   return *log_file_directory;
 }
 
-void set_vlog_level(int level) { vlog_level = level; }
+namespace internal {
+
+// Recomputes the thresholds of the registered VLOG sites. Must be called with
+// |vlog_lock| held.
+void UpdateVlogSites() {
+  for (VlogSite *site = vlog_sites; site; site = site->next_) {
+    site->level_.store(
+        std::min(GetFileVlogLevel(site->file_), VlogSite::kUninitialized - 1),
+        std::memory_order_relaxed);
+  }
+}
+
+bool VlogSite::Initialize(int level) {
+  pthread_mutex_lock(&vlog_lock);
+  int site_level = level_.load(std::memory_order_relaxed);
+  if (site_level == kUninitialized) {
+    site_level = std::min(GetFileVlogLevel(file_), kUninitialized - 1);
+    level_.store(site_level, std::memory_order_relaxed);
+    next_ = vlog_sites;
+    vlog_sites = this;
+  }
+  pthread_mutex_unlock(&vlog_lock);
+  return level <= site_level;
+}
+
+}  // namespace internal
+
+void set_vlog_level(int level) {
+  pthread_mutex_lock(&vlog_lock);
+  vlog_level.store(level, std::memory_order_relaxed);
+  internal::UpdateVlogSites();
+  pthread_mutex_unlock(&vlog_lock);
+}
+
+int get_vlog_level() { return vlog_level.load(std::memory_order_relaxed); }
 
-int get_vlog_level() { return vlog_level; }
+bool set_vmodule(const std::string &spec) {
+  std::vector<VmoduleEntry> entries;
+  if (!ParseVmodule(spec, &entries)) {
+    return false;
+  }
+  pthread_mutex_lock(&vlog_lock);
+  if (!vmodule_entries) {
+    vmodule_entries = new std::vector<VmoduleEntry>();
+  }
+  vmodule_entries->swap(entries);
+  internal::UpdateVlogSites();
+  pthread_mutex_unlock(&vlog_lock);
+  return true;
+}
 
 bool EnsureDirectory(const char *path) {
   struct stat dirStat;
@@ -151,13 +479,95 @@ bool InitLogging(const char *directory, const char *file_name, int level) {
   return true;
 }
 
-LogMessage::LogMessage(const char *file, int line) { Init(file, line, INFO); }
+bool EnableAsyncLogging(size_t queue_capacity) {
+  pthread_mutex_lock(&async_log_control_lock);
+  bool enabled = async_log_queue.load(std::memory_order_relaxed) != nullptr;
+  if (!enabled && queue_capacity > 0) {
+    if (!created_async_log_queue) {
+      size_t capacity = 1;
+      while (capacity < queue_capacity) {
+        capacity <<= 1;
+      }
+      created_async_log_queue = new AsyncLogQueue(capacity);
+    }
+    async_log_stopping.store(false, std::memory_order_relaxed);
+    if (pthread_create(&async_log_flusher, nullptr, &RunAsyncLogFlusher,
+                       nullptr) == 0) {
+      async_log_queue.store(created_async_log_queue,
+                            std::memory_order_release);
+      enabled = true;
+    }
+  }
+  pthread_mutex_unlock(&async_log_control_lock);
+  return enabled;
+}
+
+void DisableAsyncLogging() {
+  pthread_mutex_lock(&async_log_control_lock);
+  if (async_log_queue.exchange(nullptr, std::memory_order_acq_rel)) {
+    async_log_stopping.store(true, std::memory_order_release);
+    pthread_join(async_log_flusher, nullptr);
+    FlushAsyncLogQueue();
+  }
+  pthread_mutex_unlock(&async_log_control_lock);
+}
+
+uint64_t GetDroppedLogMessageCount() {
+  return dropped_log_messages.load(std::memory_order_relaxed);
+}
+
+const char *LogMessageBuffer::data() {
+  if (overflow_buffer_.empty()) {
+    return pbase();
+  }
+  Spill();
+  return overflow_buffer_.data();
+}
+
+size_t LogMessageBuffer::size() {
+  if (overflow_buffer_.empty()) {
+    return pptr() - pbase();
+  }
+  Spill();
+  return overflow_buffer_.size();
+}
+
+void LogMessageBuffer::Spill() {
+  overflow_buffer_.append(pbase(), pptr() - pbase());
+  setp(inline_buffer_, inline_buffer_ + kInlineSize);
+}
+
+LogMessageBuffer::int_type LogMessageBuffer::overflow(int_type c) {
+  Spill();
+  if (!traits_type::eq_int_type(c, traits_type::eof())) {
+    overflow_buffer_.push_back(traits_type::to_char_type(c));
+  }
+  return traits_type::not_eof(c);
+}
+
+std::streamsize LogMessageBuffer::xsputn(const char *s,
+                                         std::streamsize count) {
+  if (count > epptr() - pptr()) {
+    Spill();
+    overflow_buffer_.append(s, count);
+  } else {
+    memcpy(pptr(), s, count);
+    pbump(count);
+  }
+  return count;
+}
+
+LogMessage::LogMessage(const char *file, int line) : stream_(&buffer_) {
+  Init(file, line, INFO);
+}
 
-LogMessage::LogMessage(const char *file, int line, LogSeverity severity) {
+LogMessage::LogMessage(const char *file, int line, LogSeverity severity)
+    : stream_(&buffer_) {
   Init(file, line, severity);
 }
 
-LogMessage::LogMessage(const char *file, int line, const std::string &result) {
+LogMessage::LogMessage(const char *file, int line, const std::string &result)
+    : stream_(&buffer_) {
   Init(file, line, FATAL);
   stream() << "Check failed: " << result << " ";
 }
@@ -165,6 +575,53 @@ LogMessage::LogMessage(const char *file, int line, const std::string &result) {
 static constexpr const char *LogSeverityNames[4] = {"INFO", "WARNING", "ERROR",
                                                     "FATAL"};
 
+namespace {
+
+// The length of the local date/time prefix "YYYY-MM-DD hh:mm:ss  ".
+constexpr size_t kTimePrefixSize = 21;
+
+// The date/time prefix of the last message logged by this thread. Messages
+// logged within the same second reuse it instead of converting the time again.
+struct TimePrefixCache {
+  time_t seconds;
+  bool valid;
+  char text[kTimePrefixSize + 1];
+};
+
+thread_local TimePrefixCache time_prefix_cache = {0, false, {}};
+
+// Returns the date/time prefix for |seconds| since the epoch.
+const char *GetTimePrefix(time_t seconds) {
+  TimePrefixCache *cache = &time_prefix_cache;
+  if (!cache->valid || cache->seconds != seconds) {
+    struct tm local_time;
+    localtime_r(&seconds, &local_time);
+    strftime(cache->text, sizeof(cache->text), "%Y-%m-%d %H:%M:%S  ",
+             &local_time);
+    cache->seconds = seconds;
+    cache->valid = true;
+  }
+  return cache->text;
+}
+
+// Formats |value| in decimal into the end of |buffer|, and returns the start
+// of the formatted text.
+char *FormatDecimal(int value, char *buffer_end) {
+  unsigned int magnitude =
+      value < 0 ? 0u - static_cast<unsigned int>(value) : value;
+  char *start = buffer_end;
+  do {
+    *--start = '0' + magnitude % 10;
+    magnitude /= 10;
+  } while (magnitude != 0);
+  if (value < 0) {
+    *--start = '-';
+  }
+  return start;
+}
+
+}  // namespace
+
 void LogMessage::Init(const char *file, int line, LogSeverity severity) {
   severity_ = severity;
 
@@ -175,41 +632,48 @@ void LogMessage::Init(const char *file, int line, LogSeverity severity) {
   struct timespec time_stamp;
   clock_gettime(CLOCK_REALTIME, &time_stamp);
 
-  constexpr int kTimeMessageSize = 22;
-  char buffer[kTimeMessageSize];
-  strftime(buffer, kTimeMessageSize, "%Y-%m-%d %H:%M:%S  ",
-           localtime(&time_stamp.tv_sec));
-  stream() << buffer;
-  stream() << LogSeverityNames[severity_] << "  " << filename << " : " << line
-           << " : ";
+  char line_buffer[16];
+  char *line_end = line_buffer + sizeof(line_buffer);
+  char *line_start = FormatDecimal(line, line_end);
+
+  const char *severity_name = LogSeverityNames[severity_];
+  buffer_.sputn(GetTimePrefix(time_stamp.tv_sec), kTimePrefixSize);
+  buffer_.sputn(severity_name, strlen(severity_name));
+  buffer_.sputn("  ", 2);
+  buffer_.sputn(filename, strlen(filename));
+  buffer_.sputn(" : ", 3);
+  buffer_.sputn(line_start, line_end - line_start);
+  buffer_.sputn(" : ", 3);
 }
 
 LogMessage::~LogMessage() {
-  std::string message_text = stream_.str();
-  SendToLog(message_text);
+  size_t size = buffer_.size();
+  if (size == 0 || buffer_.data()[size - 1] != '\n') {
+    buffer_.sputc('\n');
+    size = buffer_.size();
+  }
+  SendToLog(buffer_.data(), size);
 }
 
-void LogMessage::SendToLog(const std::string &message_text) {
-  std::string log_path = get_log_directory() + get_log_basename();
-
-  FILE *file = fopen(log_path.c_str(), "ab");
-  if (file) {
-    if (fprintf(file, "%s", message_text.c_str()) > 0) {
-      if (message_text.back() != '\n') {
-        fprintf(file, "\n");
-      }
-    } else {
-      fprintf(stderr, "Failed to write to log file : %s!\n", log_path.c_str());
+void LogMessage::SendToLog(const char *message_text, size_t size) {
+  if (severity_ < FATAL && QueueAsyncLog(message_text, size)) {
+    if (severity_ >= ERROR) {
+      fwrite(message_text, 1, size, stderr);
+      fflush(stderr);
     }
-    fclose(file);
-  } else {
-    fprintf(stderr, "Failed to open log file : %s!\n", log_path.c_str());
+    return;
+  }
+
+  // Keep the log in order by writing out messages queued before this one.
+  if (severity_ == FATAL) {
+    FlushAsyncLogQueue();
   }
+  WriteLogFile(message_text, size);
   if (severity_ >= ERROR) {
-    fprintf(stderr, "%s\n", message_text.c_str());
+    fwrite(message_text, 1, size, stderr);
     fflush(stderr);
   }
-  printf("%s\n", message_text.c_str());
+  fwrite(message_text, 1, size, stdout);
   fflush(stdout);
 
   // if FATAL occurs, abort enclave.
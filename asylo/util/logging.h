@@ -19,6 +19,8 @@
 #ifndef ASYLO_UTIL_LOGGING_H_
 #define ASYLO_UTIL_LOGGING_H_
 
+#include <atomic>
+#include <climits>
 #include <cstdint>
 #include <cstdlib>
 #include <memory>
@@ -70,8 +72,30 @@
 #define LOG_IF(severity, condition) \
   !(condition) ? (void)0 : asylo::LogMessageVoidify() & LOG(severity)
 
+/// The highest `VLOG` level compiled in. `VLOG` statements with a constant
+/// level above it compile to nothing, whatever the runtime verbosity. Defaults
+/// to no limit, and may be lowered for a build with, e.g.,
+/// `--copt=-DASYLO_MAX_VLOG_LEVEL=0`.
+#ifndef ASYLO_MAX_VLOG_LEVEL
+#define ASYLO_MAX_VLOG_LEVEL INT_MAX
+#endif
+
+/// True if `VLOG(level)` at this point in the source is logged. The verbosity
+/// of each call site is computed from `set_vlog_level` and `set_vmodule` on its
+/// first use and cached, so that checking a disabled site costs one load and
+/// one branch.
+///
+/// \param level The numeric level to check.
+#define VLOG_IS_ON(level)                                    \
+  ((level) <= ASYLO_MAX_VLOG_LEVEL &&                        \
+   []() -> ::asylo::internal::VlogSite & {                   \
+     static ::asylo::internal::VlogSite vlog_site(__FILE__); \
+     return vlog_site;                                       \
+   }().IsOn(level))
+
 /// A `LOG` command with an associated verbosity level. The verbosity threshold
-/// may be configured at runtime with `set_vlog_level` and `InitLogging`.
+/// may be configured at runtime with `set_vlog_level`, `set_vmodule` and
+/// `InitLogging`, and bounded at build time with `ASYLO_MAX_VLOG_LEVEL`.
 ///
 /// `VLOG` statements are logged at `INFO` severity if they are logged at all.
 /// The numeric levels are on a different scale than the severity levels.
@@ -82,7 +106,7 @@
 /// ```
 ///
 /// \param level The numeric level that determines whether to log the message.
-#define VLOG(level) LOG_IF(INFO, (level) <= get_vlog_level())
+#define VLOG(level) LOG_IF(INFO, VLOG_IS_ON(level))
 
 /// Terminates the program with a fatal error if the specified condition is
 /// false.
@@ -289,6 +313,18 @@ void set_vlog_level(int level);
 /// \return The current verbosity threshold for VLOG.
 int get_vlog_level();
 
+/// Sets per-module verbosity thresholds for VLOG, which take precedence over
+/// the threshold set with `set_vlog_level` in the files they match.
+///
+/// \param spec A comma-separated list of `<pattern>=<level>` entries. A pattern
+///        is matched against the name of a source file without its directory
+///        and extension, or against its path without extension if it contains
+///        a slash, and may contain `*` and `?` wildcards. The first matching
+///        entry applies. An empty list clears the module thresholds.
+/// \return True if and only if |spec| is well formed. If it is not, the
+///         thresholds are unchanged.
+bool set_vmodule(const std::string &spec);
+
 /// Sets the log directory, as specified when this enclave is initialized. This
 /// is only set once. Any request to reset it will return false.
 ///
@@ -321,6 +357,99 @@ bool EnsureDirectory(const char *path);
 ///        a level equal to or lower than it will be logged.
 bool InitLogging(const char *directory, const char *file_name, int level);
 
+/// Enables asynchronous logging.
+///
+/// Log messages below `FATAL` severity are queued in memory, and a background
+/// thread writes them to the log file and standard output in batches. Messages
+/// logged while the queue is full are dropped and counted. A `FATAL` message
+/// first writes out the queued messages, and is then written synchronously.
+/// Messages of `ERROR` severity and above are still copied to standard error
+/// synchronously.
+///
+/// \param queue_capacity The number of messages the queue holds, which is
+///        rounded up to a power of two. Ignored if asynchronous logging has
+///        been enabled before.
+/// \return True if and only if asynchronous logging is enabled.
+bool EnableAsyncLogging(size_t queue_capacity);
+
+/// Writes out all queued messages and stops asynchronous logging. Does nothing
+/// if asynchronous logging is not enabled.
+void DisableAsyncLogging();
+
+/// Gets the number of messages dropped because the asynchronous log queue was
+/// full.
+///
+/// \return The number of dropped messages since the program started.
+uint64_t GetDroppedLogMessageCount();
+
+/// \cond Internal
+namespace internal {
+
+/// The cached verbosity threshold of one VLOG call site. Sites are constant
+/// initialized, and are registered on first use so that changes to the
+/// thresholds update them.
+class VlogSite {
+ public:
+  constexpr explicit VlogSite(const char *file)
+      : file_(file), level_(kUninitialized), next_(nullptr) {}
+
+  /// Returns whether a VLOG at |level| is logged at this site.
+  bool IsOn(int level) {
+    int site_level = level_.load(std::memory_order_relaxed);
+    if (ABSL_PREDICT_TRUE(level > site_level)) {
+      return false;
+    }
+    return site_level != kUninitialized || Initialize(level);
+  }
+
+ private:
+  friend void UpdateVlogSites();
+
+  // Marks a site whose threshold has not been computed. Any level passes the
+  // fast check against it, and computed thresholds are kept below it.
+  static constexpr int kUninitialized = INT_MAX;
+
+  // Computes and caches the threshold of the site and registers it. Returns
+  // whether a VLOG at |level| is logged.
+  bool Initialize(int level);
+
+  const char *const file_;
+  std::atomic<int> level_;
+
+  // Next registered site, guarded by the lock of the thresholds.
+  VlogSite *next_;
+};
+
+}  // namespace internal
+
+/// A stream buffer that holds a log message in an inline buffer, so that a
+/// typical message is built without allocating. Text that does not fit is moved
+/// to a heap-allocated string.
+class LogMessageBuffer : public std::streambuf {
+ public:
+  LogMessageBuffer() { setp(inline_buffer_, inline_buffer_ + kInlineSize); }
+
+  /// Returns the start of the text written so far.
+  const char *data();
+
+  /// Returns the size of the text written so far.
+  size_t size();
+
+ protected:
+  int_type overflow(int_type c) override;
+  std::streamsize xsputn(const char *s, std::streamsize count) override;
+
+ private:
+  static constexpr size_t kInlineSize = 512;
+
+  // Moves the inline buffer contents to |overflow_buffer_|.
+  void Spill();
+
+  char inline_buffer_[kInlineSize];
+  std::string overflow_buffer_;
+};
+/// \endcond
+
 /// Class representing a log message created by a log macro.
 class LogMessage {
  public:
@@ -348,20 +477,21 @@ class LogMessage {
   /// The destructor flushes the message.
   ~LogMessage();
 
-  /// Gets a reference to the underlying string stream.
+  /// Gets a reference to the underlying stream.
   ///
-  /// \return A reference to the underlying string stream.
-  std::ostringstream &stream() { return stream_; }
+  /// \return A reference to the underlying stream.
+  std::ostream &stream() { return stream_; }
 
  private:
   void Init(const char *file, int line, LogSeverity severity);
 
-  // Sends the message to print.
-  void SendToLog(const std::string &message_text);
+  // Sends the message to print. |message_text| ends with a newline.
+  void SendToLog(const char *message_text, size_t size);
 
-  // stream_ reads all the input messages into a stringstream, then it's
-  // converted into a string in the destructor for printing.
-  std::ostringstream stream_;
+  // stream_ writes all the input messages into buffer_, which is printed in
+  // the destructor.
+  LogMessageBuffer buffer_;
+  std::ostream stream_;
   LogSeverity severity_;
 
   LogMessage(const LogMessage &) = delete;
@@ -0,0 +1,141 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/util/logging.h"
+
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include "asylo/test/util/test_flags.h"
+
+namespace asylo {
+namespace {
+
+using ::testing::HasSubstr;
+using ::testing::Not;
+
+constexpr char kLogName[] = "logging_test";
+
+std::string ReadLogFile() {
+  std::ifstream file(get_log_directory() + kLogName);
+  std::stringstream contents;
+  contents << file.rdbuf();
+  return contents.str();
+}
+
+class LoggingTest : public ::testing::Test {
+ protected:
+  static void SetUpTestCase() {
+    ASSERT_TRUE(InitLogging(FLAGS_test_tmpdir.c_str(), kLogName, 0));
+  }
+};
+
+// Verify that a message is written with its severity, file and line prefix,
+// and that a message too long for the inline message buffer is kept whole.
+TEST_F(LoggingTest, MessageHasPrefixAndFullText) {
+  std::string long_message(2000, 'x');
+  int line = __LINE__ + 1;
+  LOG(WARNING) << "short message";
+  LOG(INFO) << "long " << long_message << " end";
+
+  std::string log = ReadLogFile();
+  EXPECT_THAT(log, HasSubstr("  WARNING  logging_test.cc : " +
+                             std::to_string(line) + " : short message\n"));
+  EXPECT_THAT(log, HasSubstr("long " + long_message + " end\n"));
+}
+
+// Verify that messages logged asynchronously all reach the log file, in order,
+// once asynchronous logging is disabled.
+TEST_F(LoggingTest, AsyncLoggingWritesMessagesInOrder) {
+  LOG(INFO) << "synchronous message";
+  ASSERT_TRUE(EnableAsyncLogging(1024));
+
+  constexpr int kNumMessages = 100;
+  for (int i = 0; i < kNumMessages; ++i) {
+    LOG(INFO) << "asynchronous message " << i << ".";
+  }
+  DisableAsyncLogging();
+  LOG(INFO) << "final message";
+
+  std::string log = ReadLogFile();
+  EXPECT_THAT(log, HasSubstr("synchronous message\n"));
+  size_t position = 0;
+  for (int i = 0; i < kNumMessages; ++i) {
+    std::string message = "asynchronous message " + std::to_string(i) + ".\n";
+    size_t found = log.find(message, position);
+    ASSERT_NE(found, std::string::npos) << message;
+    position = found + message.size();
+  }
+  EXPECT_NE(log.find("final message\n", position), std::string::npos);
+  EXPECT_EQ(GetDroppedLogMessageCount(), 0);
+}
+
+// Returns whether a VLOG at |level| is logged at a single call site.
+bool VlogIsOnAtOneSite(int level) { return VLOG_IS_ON(level); }
+
+// Verify that a call site that has cached its threshold follows later changes
+// of the VLOG level.
+TEST_F(LoggingTest, VlogSiteFollowsLevelChanges) {
+  set_vlog_level(0);
+  EXPECT_TRUE(VlogIsOnAtOneSite(0));
+  EXPECT_FALSE(VlogIsOnAtOneSite(1));
+  set_vlog_level(2);
+  EXPECT_TRUE(VlogIsOnAtOneSite(2));
+  EXPECT_FALSE(VlogIsOnAtOneSite(3));
+
+  VLOG(2) << "verbose message";
+  VLOG(3) << "too verbose message";
+  std::string log = ReadLogFile();
+  EXPECT_THAT(log, HasSubstr("verbose message\n"));
+  EXPECT_THAT(log, Not(HasSubstr("too verbose message")));
+
+  set_vlog_level(0);
+  EXPECT_FALSE(VlogIsOnAtOneSite(1));
+}
+
+// Verify that per-module thresholds apply to the files they match, and that
+// clearing them restores the VLOG level.
+TEST_F(LoggingTest, VmoduleOverridesVlogLevel) {
+  set_vlog_level(0);
+  ASSERT_TRUE(set_vmodule("other=5,logging_te?t=3,logging_test=4"));
+  EXPECT_TRUE(VlogIsOnAtOneSite(3));
+  EXPECT_FALSE(VlogIsOnAtOneSite(4));
+
+  ASSERT_TRUE(set_vmodule("*/util/logging_*=1"));
+  EXPECT_TRUE(VlogIsOnAtOneSite(1));
+  EXPECT_FALSE(VlogIsOnAtOneSite(2));
+
+  ASSERT_TRUE(set_vmodule("logging=2"));
+  EXPECT_FALSE(VlogIsOnAtOneSite(1));
+
+  ASSERT_TRUE(set_vmodule("*=2"));
+  EXPECT_FALSE(set_vmodule("logging_test"));
+  EXPECT_FALSE(set_vmodule("=1"));
+  EXPECT_FALSE(set_vmodule("logging_test=x"));
+  EXPECT_TRUE(VlogIsOnAtOneSite(2));
+
+  ASSERT_TRUE(set_vmodule(""));
+  EXPECT_TRUE(VlogIsOnAtOneSite(0));
+  EXPECT_FALSE(VlogIsOnAtOneSite(1));
+}
+
+}  // namespace
+}  // namespace asylo
@@ -18,34 +18,163 @@
 
 #include "asylo/util/status.h"
 
+#include <atomic>
+
 #include "absl/strings/str_cat.h"
 #include "asylo/util/status_error_space.h"
 
 namespace asylo {
+namespace status_internal {
+
+// The representation of a Status with a message.
+struct StatusRep {
+  // The number of Status objects referring to this representation. Unused if
+  // |immortal| is set.
+  std::atomic<int> references;
+
+  // Whether this representation is shared by every Status built with the same
+  // static message, and is never freed.
+  bool immortal;
+
+  const error::ErrorSpace *space;
+  int code;
+
+  // The message, which refers either to |owned_message| or to a static
+  // message.
+  absl::string_view message;
+  std::string owned_message;
+};
+
+}  // namespace status_internal
+
+namespace {
 
-Status::Status()
-    : error_space_(
-          error::error_enum_traits<error::GoogleError>::get_error_space()),
-      error_code_(error::GoogleError::OK) {}
+using status_internal::StatusRep;
+
+// In an inline representation, the lowest bit is set, the next bits hold the
+// ID of the error space and the upper 32 bits hold the error code.
+constexpr uintptr_t kInlineTag = 1;
+constexpr int kSpaceIdShift = 1;
+constexpr int kCodeShift = 32;
+
+static_assert(sizeof(uintptr_t) >= 8,
+              "An inline Status needs a 64-bit representation");
+
+// The immortal representations of statuses with static messages. A slot is
+// never emptied once filled.
+constexpr size_t kStaticRepSlots = 256;
+constexpr size_t kStaticRepProbes = 8;
+std::atomic<StatusRep *> static_reps[kStaticRepSlots];
+
+bool IsInline(uintptr_t rep) { return rep & kInlineTag; }
+
+StatusRep *AsRep(uintptr_t rep) { return reinterpret_cast<StatusRep *>(rep); }
+
+// Returns a newly allocated representation of |code| from |space| which
+// refers to |message|, owned by the caller.
+StatusRep *NewRep(const error::ErrorSpace *space, int code,
+                  absl::string_view message, bool immortal) {
+  StatusRep *rep = new StatusRep;
+  rep->references.store(1, std::memory_order_relaxed);
+  rep->immortal = immortal;
+  rep->space = space;
+  rep->code = code;
+  rep->message = message;
+  return rep;
+}
+
+// Returns the shared representation of |code| from |space| with the static
+// message |message|, or nullptr if there is no room for it.
+StatusRep *FindOrAddStaticRep(const error::ErrorSpace *space, int code,
+                              absl::string_view message) {
+  size_t hash = reinterpret_cast<uintptr_t>(message.data()) * 31 +
+                reinterpret_cast<uintptr_t>(space) * 17 +
+                static_cast<unsigned>(code);
+  hash ^= hash >> 16;
+  StatusRep *added = nullptr;
+  for (size_t probe = 0; probe < kStaticRepProbes; ++probe) {
+    std::atomic<StatusRep *> *slot =
+        &static_reps[(hash + probe) % kStaticRepSlots];
+    StatusRep *entry = slot->load(std::memory_order_acquire);
+    if (!entry) {
+      if (!added) {
+        added = NewRep(space, code, message, /*immortal=*/true);
+      }
+      if (slot->compare_exchange_strong(entry, added,
+                                        std::memory_order_acq_rel)) {
+        return added;
+      }
+    }
+    if (entry->space == space && entry->code == code &&
+        entry->message.data() == message.data() &&
+        entry->message.size() == message.size()) {
+      delete added;
+      return entry;
+    }
+  }
+  delete added;
+  return nullptr;
+}
+
+}  // namespace
 
 Status::Status(const error::ErrorSpace *space, int code, std::string message)
-    : error_space_(space), error_code_(code), message_(std::move(message)) {}
+    : rep_(kOkRep) {
+  Set(space, code, message);
+}
 
-Status Status::OkStatus() { return Status(); }
+Status &Status::operator=(const Status &other) {
+  other.Ref();
+  Unref();
+  rep_ = other.rep_;
+  return *this;
+}
 
-int Status::error_code() const { return error_code_; }
+Status &Status::operator=(Status &&other) {
+  if (this != &other) {
+    Unref();
+    rep_ = other.rep_;
+    other.rep_ = kOkRep;
+  }
+  return *this;
+}
 
-absl::string_view Status::error_message() const { return message_; }
+Status Status::OkStatus() { return Status(); }
 
-const error::ErrorSpace *Status::error_space() const { return error_space_; }
+int Status::error_code() const {
+  if (rep_ == kOkRep) {
+    return error::GoogleError::OK;
+  }
+  if (IsInline(rep_)) {
+    return static_cast<int32_t>(rep_ >> kCodeShift);
+  }
+  return AsRep(rep_)->code;
+}
 
-bool Status::ok() const { return error_code_ == 0; }
+absl::string_view Status::error_message() const {
+  if (rep_ == kOkRep || IsInline(rep_)) {
+    return absl::string_view();
+  }
+  return AsRep(rep_)->message;
+}
+
+const error::ErrorSpace *Status::error_space() const {
+  if (rep_ == kOkRep) {
+    return error::error_enum_traits<error::GoogleError>::get_error_space();
+  }
+  if (IsInline(rep_)) {
+    return error::ErrorSpace::FindById(
+        static_cast<uint32_t>(rep_) >> kSpaceIdShift);
+  }
+  return AsRep(rep_)->space;
+}
 
 std::string Status::ToString() const {
-  return ok() ? error_space_->String(error_code_)
-              : absl::StrCat(error_space_->SpaceName(),
-                             "::", error_space_->String(error_code_), ": ",
-                             message_);
+  const error::ErrorSpace *space = error_space();
+  return ok() ? space->String(error_code())
+              : absl::StrCat(space->SpaceName(),
+                             "::", space->String(error_code()), ": ",
+                             error_message());
 }
 
 Status Status::ToCanonical() const {
@@ -54,34 +183,35 @@ Status Status::ToCanonical() const {
 }
 
 error::GoogleError Status::CanonicalCode() const {
-  return error_space_->GoogleErrorCode(error_code_);
+  return error_space()->GoogleErrorCode(error_code());
 }
 
 void Status::SaveTo(StatusProto *status_proto) const {
-  status_proto->set_code(error_code_);
-  status_proto->set_error_message(message_);
-  status_proto->set_space(error_space_->SpaceName());
+  status_proto->set_code(error_code());
+  status_proto->set_error_message(std::string(error_message()));
+  status_proto->set_space(error_space()->SpaceName());
   status_proto->set_canonical_code(CanonicalCode());
 }
 
 void Status::RestoreFrom(const StatusProto &status_proto) {
   // Set the error code from the error space, if recognized.
-  error_space_ = error::ErrorSpace::Find(status_proto.space());
-  if (error_space_) {
+  const error::ErrorSpace *space =
+      error::ErrorSpace::Find(status_proto.space());
+  int code;
+  if (space) {
     // The canonical code must match the canonical code as computed by the
     // error space.
     if (status_proto.has_canonical_code() &&
-        (error_space_->GoogleErrorCode(status_proto.code()) !=
+        (space->GoogleErrorCode(status_proto.code()) !=
          status_proto.canonical_code())) {
       SetInvalid();
       return;
     } else {
-      error_code_ = status_proto.code();
+      code = status_proto.code();
     }
   } else {
     // Error space lookup failed. Use the canonical error space.
-    error_space_ =
-        error::error_enum_traits<error::GoogleError>::get_error_space();
+    space = error::error_enum_traits<error::GoogleError>::get_error_space();
 
     // Both error code and canonical code must be OK, or neither.
     if (status_proto.has_canonical_code() &&
@@ -90,25 +220,81 @@ void Status::RestoreFrom(const StatusProto &status_proto) {
       return;
     }
     if (status_proto.has_canonical_code()) {
-      error_code_ = status_proto.canonical_code();
+      code = status_proto.canonical_code();
     } else {
       // Default to error::GoogleError::UNKNOWN.
-      error_code_ = error::GoogleError::UNKNOWN;
+      code = error::GoogleError::UNKNOWN;
     }
   }
-  if (!ok()) {
-    message_ = status_proto.error_message();
-  } else {
-    message_.clear();
-  }
+  Set(space, code, code != 0 ? status_proto.error_message() : "");
 }
 
 bool Status::IsCanonical() const {
-  return error_space_->SpaceName() == error::kCanonicalErrorSpaceName;
+  return error_space()->SpaceName() == error::kCanonicalErrorSpaceName;
 }
 
 void Status::SetInvalid() {
-  Set(error::StatusError::INVALID, "Failed to parse invalid StatusProto");
+  SetStatic(error::error_enum_traits<error::StatusError>::get_error_space(),
+            static_cast<int>(error::StatusError::INVALID),
+            "Failed to parse invalid StatusProto");
+}
+
+void Status::Set(const error::ErrorSpace *space, int code,
+                 absl::string_view message) {
+  uintptr_t new_rep = kOkRep;
+  // An error space which is not registered has no ID, so it cannot be stored
+  // inline.
+  int id = message.empty() ? space->id() : -1;
+  if (id >= 0) {
+    if (code != 0 || space != error::error_enum_traits<
+                                  error::GoogleError>::get_error_space()) {
+      new_rep = kInlineTag |
+                (static_cast<uintptr_t>(id) << kSpaceIdShift) |
+                (static_cast<uintptr_t>(static_cast<uint32_t>(code))
+                 << kCodeShift);
+    }
+  } else {
+    // |message| may refer to the current message of this object, so it is
+    // copied before the current representation is released.
+    StatusRep *rep = NewRep(space, code, absl::string_view(),
+                            /*immortal=*/false);
+    rep->owned_message = std::string(message);
+    rep->message = rep->owned_message;
+    new_rep = reinterpret_cast<uintptr_t>(rep);
+  }
+  Unref();
+  rep_ = new_rep;
+}
+
+void Status::SetStatic(const error::ErrorSpace *space, int code,
+                       absl::string_view message) {
+  if (message.empty()) {
+    Set(space, code, message);
+    return;
+  }
+  Unref();
+  StatusRep *rep = FindOrAddStaticRep(space, code, message);
+  if (!rep) {
+    rep = NewRep(space, code, message, /*immortal=*/false);
+  }
+  rep_ = reinterpret_cast<uintptr_t>(rep);
+}
+
+void Status::Ref() const {
+  if (rep_ == kOkRep || IsInline(rep_) || AsRep(rep_)->immortal) {
+    return;
+  }
+  AsRep(rep_)->references.fetch_add(1, std::memory_order_relaxed);
+}
+
+void Status::Unref() {
+  if (rep_ == kOkRep || IsInline(rep_) || AsRep(rep_)->immortal) {
+    return;
+  }
+  StatusRep *rep = AsRep(rep_);
+  if (rep->references.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+    delete rep;
+  }
 }
 
 bool operator==(const Status &lhs, const Status &rhs) {
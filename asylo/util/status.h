@@ -19,6 +19,7 @@
 #ifndef ASYLO_UTIL_STATUS_H_
 #define ASYLO_UTIL_STATUS_H_
 
+#include <cstdint>
 #include <ostream>
 #include <string>
 #include <type_traits>
@@ -34,10 +35,32 @@ namespace asylo {
 /// Status contains information about an error. Status contains an error code
 /// from some error space and a message string suitable for logging or
 /// debugging.
+///
+/// A Status is a single word. OK statuses and statuses without a message are
+/// stored inline and never allocate. A message is kept in a reference-counted
+/// representation shared by all copies of the Status. Messages wrapped in
+/// StaticMessage are not copied, and a Status with a static message is
+/// allocated only the first time it is built.
 class Status {
  public:
+  /// A message which outlives every Status it is stored in, such as a string
+  /// literal. Status refers to the message instead of copying it.
+  class StaticMessage {
+   public:
+    /// Wraps `message`, which must never be freed or modified.
+    ///
+    /// \param message A NUL-terminated string with static storage duration.
+    explicit StaticMessage(const char *message) : message_(message) {}
+
+    /// Gets the wrapped message.
+    absl::string_view message() const { return message_; }
+
+   private:
+    absl::string_view message_;
+  };
+
   /// Builds an OK Status in the canonical error space.
-  Status();
+  Status() : rep_(kOkRep) {}
 
   /// Constructs a Status object containing an error code and message.
   ///
@@ -52,11 +75,27 @@ class Status {
   /// \param code A symbolic error code.
   /// \param message The associated error message.
   template <typename Enum>
-  Status(Enum code, absl::string_view message) {
+  Status(Enum code, absl::string_view message) : rep_(kOkRep) {
     Set(code, message);
   }
 
-  Status(const Status &other) = default;
+  /// Constructs a Status object containing an error code and a message which
+  /// is not copied. The error space is deduced from `code`.
+  ///
+  /// \param code A symbolic error code.
+  /// \param message The associated error message.
+  template <typename Enum>
+  Status(Enum code, StaticMessage message) : rep_(kOkRep) {
+    SetStatic(error::error_enum_traits<Enum>::get_error_space(),
+              static_cast<int>(code), message.message());
+  }
+
+  Status(const Status &other) : rep_(other.rep_) { Ref(); }
+
+  /// Moves `other` into a new Status, leaving `other` OK.
+  Status(Status &&other) : rep_(other.rep_) { other.rep_ = kOkRep; }
+
+  ~Status() { Unref(); }
 
   /// Constructs a Status object from `StatusT`. `StatusT` must be a status-type
   /// object. I.e.,
@@ -73,12 +112,15 @@ class Status {
   template <typename StatusT,
             typename E = typename absl::enable_if_t<
                 status_internal::status_type_traits<StatusT>::is_status>>
-  explicit Status(const StatusT &other) {
+  explicit Status(const StatusT &other) : rep_(kOkRep) {
     Set(status_internal::status_type_traits<StatusT>::CanonicalCode(other),
         other.error_message());
   }
 
-  Status &operator=(const Status &other) = default;
+  Status &operator=(const Status &other);
+
+  /// Moves `other` into this object, leaving `other` OK.
+  Status &operator=(Status &&other);
 
   /// Constructs an OK status object.
   ///
@@ -104,8 +146,8 @@ class Status {
                 status_internal::status_type_traits<StatusT>::is_status>>
   StatusT ToOtherStatus() {
     Status status = ToCanonical();
-    return StatusT(status_internal::ErrorCodeHolder(status.error_code_),
-                   status.message_);
+    return StatusT(status_internal::ErrorCodeHolder(status.error_code()),
+                   std::string(status.error_message()));
   }
 
   /// Gets the integer error code for this object.
@@ -126,7 +168,7 @@ class Status {
   /// Indicates whether this object is OK (indicates no error).
   ///
   /// \return True if this object indicates no error.
-  bool ok() const;
+  bool ok() const { return rep_ == kOkRep || error_code() == 0; }
 
   /// Gets a string representation of this object.
   ///
@@ -189,19 +231,34 @@ class Status {
   /// \return True if this object matches `code`.
   template <typename Enum>
   bool Is(Enum code) const {
-    return (static_cast<int>(code) == error_code_) &&
-           (error::error_enum_traits<Enum>::get_error_space() == error_space_);
+    return (static_cast<int>(code) == error_code()) &&
+           (error::error_enum_traits<Enum>::get_error_space() ==
+            error_space());
   }
 
  private:
+  // The representation of an OK status in the canonical error space.
+  static constexpr uintptr_t kOkRep = 0;
+
   // Sets this object to hold an error code |code| and error message |message|.
   template <typename Enum>
   void Set(Enum code, absl::string_view message) {
-    error_space_ = error::error_enum_traits<Enum>::get_error_space();
-    error_code_ = static_cast<int>(code);
-    message_ = std::string(message);
+    Set(error::error_enum_traits<Enum>::get_error_space(),
+        static_cast<int>(code), message);
   }
 
+  // Sets this object to hold |code| from |space| and a copy of |message|,
+  // releasing its previous value.
+  void Set(const error::ErrorSpace *space, int code, absl::string_view message);
+
+  // As Set(), but refers to |message| instead of copying it.
+  void SetStatic(const error::ErrorSpace *space, int code,
+                 absl::string_view message);
+
+  // Adds and releases a reference to the representation of this object.
+  void Ref() const;
+  void Unref();
+
   // Returns true if the error code for this object is in the canonical error
   // space.
   bool IsCanonical() const;
@@ -210,9 +267,13 @@ class Status {
   // invalid StatusProto.
   void SetInvalid();
 
-  const error::ErrorSpace *error_space_;
-  int error_code_;
-  std::string message_;
+  // One of:
+  //   * kOkRep.
+  //   * An error code and the ID of its error space, with the lowest bit
+  //     set, for a status without a message.
+  //   * A pointer to a status_internal::StatusRep holding the error space, the
+  //     error code and the message.
+  uintptr_t rep_;
 };
 
 bool operator==(const Status &lhs, const Status &rhs);
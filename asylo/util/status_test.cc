@@ -24,6 +24,7 @@
 #include <gtest/gtest.h>
 #include "asylo/test/util/status_matchers.h"
 #include "asylo/util/posix_error_space.h"
+#include "asylo/util/status_error_space.h"
 #include "include/grpcpp/support/status.h"
 
 namespace asylo {
@@ -367,5 +368,61 @@ TEST(StatusTest, IsOkMatcher) {
   EXPECT_THAT(einval_status, Not(IsOk()));
 }
 
+TEST(StatusTest, SinglePointerWide) {
+  EXPECT_EQ(sizeof(Status), sizeof(void *));
+}
+
+// Verify that a status without a message keeps its error space and code.
+TEST(StatusTest, NoMessage) {
+  Status einval_status(error::PosixError::P_EINVAL, "");
+  EXPECT_THAT(einval_status, StatusIs(error::PosixError::P_EINVAL));
+  EXPECT_TRUE(einval_status.error_message().empty());
+  EXPECT_EQ(einval_status, Status(error::PosixError::P_EINVAL, ""));
+
+  Status non_canonical_ok_status(error::StatusError::OK, "");
+  EXPECT_TRUE(non_canonical_ok_status.ok());
+  EXPECT_EQ(non_canonical_ok_status.error_space(),
+            error::error_enum_traits<error::StatusError>::get_error_space());
+  EXPECT_NE(non_canonical_ok_status, Status::OkStatus());
+}
+
+// Verify that a static message is not copied, and that statuses built with the
+// same static message are equal.
+TEST(StatusTest, StaticMessage) {
+  Status status(error::GoogleError::NOT_FOUND,
+                Status::StaticMessage(kErrorMessage1));
+  EXPECT_EQ(status.error_message().data(), kErrorMessage1);
+  EXPECT_EQ(status, Status(error::GoogleError::NOT_FOUND, kErrorMessage1));
+
+  Status other_status(error::GoogleError::NOT_FOUND,
+                      Status::StaticMessage(kErrorMessage1));
+  EXPECT_EQ(other_status.error_message().data(), kErrorMessage1);
+  EXPECT_EQ(status, other_status);
+
+  Status posix_status(error::PosixError::P_ENOENT,
+                      Status::StaticMessage(kErrorMessage1));
+  EXPECT_THAT(posix_status, StatusIs(error::PosixError::P_ENOENT));
+  EXPECT_EQ(posix_status.error_message(), kErrorMessage1);
+}
+
+// Verify that copies and moves of a status keep its message.
+TEST(StatusTest, CopyAndMove) {
+  Status status(error::GoogleError::INTERNAL, std::string(kErrorMessage2));
+  Status copy = status;
+  EXPECT_EQ(copy.error_message().data(), status.error_message().data());
+
+  Status assigned(error::GoogleError::NOT_FOUND, kErrorMessage1);
+  assigned = copy;
+  EXPECT_EQ(assigned, status);
+
+  Status moved = std::move(copy);
+  EXPECT_EQ(moved, status);
+  EXPECT_THAT(copy, IsOk());
+
+  status = Status::OkStatus();
+  EXPECT_EQ(moved.error_message(), kErrorMessage2);
+  EXPECT_EQ(assigned.error_message(), kErrorMessage2);
+}
+
 }  // namespace
 }  // namespace asylo
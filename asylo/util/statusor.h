@@ -19,6 +19,9 @@
 #ifndef ASYLO_UTIL_STATUSOR_H_
 #define ASYLO_UTIL_STATUSOR_H_
 
+#include <type_traits>
+#include <utility>
+
 #include "asylo/util/logging.h"
 #include "asylo/util/status.h"
 #include "asylo/util/status_error_space.h"
@@ -90,14 +93,12 @@ class StatusOr {
   /// an empty vector, it will actually invoke the default constructor of
   /// StatusOr.
   explicit StatusOr()
-      : variant_(Status(error::GoogleError::UNKNOWN, "Unknown error")),
-        has_value_(false) {}
+      : status_(error::GoogleError::UNKNOWN,
+                Status::StaticMessage("Unknown error")) {}
 
   ~StatusOr() {
-    if (has_value_) {
-      variant_.value_.~T();
-    } else {
-      variant_.status_.~Status();
+    if (ok()) {
+      value_.~T();
     }
   }
 
@@ -111,7 +112,7 @@ class StatusOr {
   /// convenience.
   ///
   /// \param status The non-OK Status object to initalize to.
-  StatusOr(const Status &status) : variant_(status), has_value_(false) {
+  StatusOr(const Status &status) : status_(status) {
     if (status.ok()) {
       LOG(FATAL) << "Cannot instantiate StatusOr with Status::OkStatus()";
     }
@@ -127,7 +128,7 @@ class StatusOr {
   /// matter of convenience.
   ///
   /// \param value The wrapped value to initialize to.
-  StatusOr(const T &value) : variant_(value), has_value_(true) {}
+  StatusOr(const T &value) { new (&value_) T(value); }
 
   /// Constructs a StatusOr object that contains `value`. The resulting object
   /// is considered to have an OK status. The wrapped element can be accessed
@@ -139,14 +140,12 @@ class StatusOr {
   /// convenience.
   ///
   /// \param value The value to move-initialize to.
-  StatusOr(T &&value) : variant_(std::move(value)), has_value_(true) {}
+  StatusOr(T &&value) { new (&value_) T(std::move(value)); }
 
   /// Copy constructor.
-  StatusOr(const StatusOr &other) : has_value_(other.has_value_) {
-    if (has_value_) {
-      new (&variant_) variant(other.variant_.value_);
-    } else {
-      new (&variant_) variant(other.variant_.status_);
+  StatusOr(const StatusOr &other) : status_(other.status_) {
+    if (ok()) {
+      new (&value_) T(other.value_);
     }
   }
 
@@ -159,11 +158,11 @@ class StatusOr {
       return *this;
     }
 
-    // Construct the variant object using the variant object of the source.
-    if (other.has_value_) {
-      AssignValue(other.variant_.value_);
+    // Construct the value or status using the value or status of the source.
+    if (other.ok()) {
+      AssignValue(other.value_);
     } else {
-      AssignStatus(other.variant_.status_);
+      AssignStatus(other.status_);
     }
     return *this;
   }
@@ -174,11 +173,9 @@ class StatusOr {
   /// error code.
   ///
   /// \param other The StatusOr object to copy and set to a non-OK status.
-  StatusOr(StatusOr &&other) : has_value_(other.has_value_) {
-    if (has_value_) {
-      new (&variant_) variant(std::move(other.variant_.value_));
-    } else {
-      new (&variant_) variant(std::move(other.variant_.status_));
+  StatusOr(StatusOr &&other) : status_(other.status_) {
+    if (ok()) {
+      new (&value_) T(std::move(other.value_));
     }
 
     // The donor object may have previously held a valid value that is now
@@ -199,11 +196,11 @@ class StatusOr {
       return *this;
     }
 
-    // Construct the variant object using the variant object of the donor.
-    if (other.has_value_) {
-      AssignValue(std::move(other.variant_.value_));
+    // Construct the value or status using the value or status of the donor.
+    if (other.ok()) {
+      AssignValue(std::move(other.value_));
     } else {
-      AssignStatus(std::move(other.variant_.status_));
+      AssignStatus(other.status_);
     }
 
     // The donor object may have previously held a valid value that is now
@@ -213,19 +210,50 @@ class StatusOr {
     return *this;
   }
 
+  /// Converting copy constructor.
+  ///
+  /// Constructs a StatusOr object holding `other`'s status, or a `T`
+  /// converted from `other`'s value.
+  ///
+  /// \param other The StatusOr object to copy.
+  template <typename U, typename = typename std::enable_if<
+                            !std::is_same<T, U>::value &&
+                            std::is_convertible<const U &, T>::value>::type>
+  StatusOr(const StatusOr<U> &other) : status_(other.status_) {
+    if (ok()) {
+      new (&value_) T(other.value_);
+    }
+  }
+
+  /// Converting move constructor.
+  ///
+  /// Constructs a StatusOr object holding `other`'s status, or a `T`
+  /// converted from `other`'s moved value. Sets `other` to contain a non-OK
+  /// status with a `StatusError::INVALID` error code.
+  ///
+  /// \param other The StatusOr object to move from.
+  template <typename U, typename = typename std::enable_if<
+                            !std::is_same<T, U>::value &&
+                            std::is_convertible<U &&, T>::value>::type>
+  StatusOr(StatusOr<U> &&other) : status_(other.status_) {
+    if (ok()) {
+      new (&value_) T(std::move(other.value_));
+    }
+    other.Clear();
+  }
 
   /// Indicates whether the object contains a `T` value.
   ///
   /// \return True if this StatusOr object's status is OK (i.e. a call to ok()
   /// returns true). If this function returns true, then it is safe to access
   /// the wrapped element through a call to ValueOrDie().
-  bool ok() const { return has_value_; }
+  bool ok() const { return status_.ok(); }
 
   /// Gets the stored status object, or an OK status if a `T` value is stored.
   ///
   /// \return The stored non-OK status object, or an OK status if this object
   ///         has a value.
-  Status status() const { return ok() ? Status::OkStatus() : variant_.status_; }
+  Status status() const { return status_; }
 
   /// Gets the stored `T` value.
   ///
@@ -237,7 +265,7 @@ class StatusOr {
     if (!ok()) {
       LOG(FATAL) << "Object does not have a usable value";
     }
-    return variant_.value_;
+    return value_;
   }
 
   /// Gets a mutable reference to the stored `T` value.
@@ -250,7 +278,7 @@ class StatusOr {
     if (!ok()) {
       LOG(FATAL) << "Object does not have a usable value";
     }
-    return variant_.value_;
+    return value_;
   }
 
   /// Moves and returns the internally-stored `T` value.
@@ -265,82 +293,63 @@ class StatusOr {
     if (!ok()) {
       LOG(FATAL) << "Object does not have a usable value";
     }
-    T tmp(std::move(variant_.value_));
+    T tmp(std::move(value_));
 
     // Invalidate this StatusOr object.
     Clear();
     return std::move(tmp);
   }
 
+  /// Moves and returns the internally-stored `T` value.
+  ///
+  /// Equivalent to `std::move(*this).ValueOrDie()`, for call sites where the
+  /// object is not an rvalue. The StatusOr object is invalidated after this
+  /// call.
+  ///
+  /// \return The stored `T` value.
+  T ConsumeValueOrDie() { return std::move(*this).ValueOrDie(); }
+
  private:
+  template <typename U>
+  friend class StatusOr;
+
   // Clears the current state of the StatusOr object and sets it to contain a
   // Status object with a StatusError::INVALID error code.
   void Clear() {
-    AssignStatus(Status(error::StatusError::INVALID, "The object was moved"));
+    AssignStatus(Status(error::StatusError::INVALID,
+                        Status::StaticMessage("The object was moved")));
   }
 
-  // Resets the |variant_| member to contain the |status| and sets |has_value_|
-  // to indicate that the StatusOr object does not have a value. Destroys the
-  // existing |variant_| member if necessary.
-  template <class U>
-  void AssignStatus(U &&status) {
+  // Sets |status_| to the non-OK |status|, destroying the existing |value_| if
+  // there is one.
+  void AssignStatus(const Status &status) {
     if (ok()) {
-      variant_.value_.~T();
-      new (&variant_) variant(std::forward<U>(status));
-    } else {
-      // Reuse the existing Status object.
-      variant_.status_ = std::forward<U>(status);
+      value_.~T();
     }
-    has_value_ = false;
+    status_ = status;
   }
 
-  // Resets the |variant_| member to contain the |value| and sets |has_value_|
-  // to indicate that the StatusOr object has a value. Destroys the existing
-  // |variant_| member.
+  // Sets |value_| to |value| and |status_| to OK, destroying the existing
+  // |value_| if there is one.
   template <class U>
   void AssignValue(U &&value) {
     if (ok()) {
       // We cannot assume that T is move-assignable.
-      variant_.value_.~T();
-    } else {
-      variant_.status_.~Status();
+      value_.~T();
     }
-    new (&variant_) variant(std::forward<U>(value));
-    has_value_ = true;
+    new (&value_) T(std::forward<U>(value));
+    status_ = Status::OkStatus();
   }
 
-  union variant {
-    // A non-OK status.
-    Status status_;
+  // The status of this object, which is OK if and only if |value_| holds an
+  // element of type T. A Status is a single word, so a StatusOr is only a word
+  // larger than T.
+  Status status_;
 
-    // An element of type T.
+  union {
+    // An element of type T, if |status_| is OK.
     T value_;
-
-    variant() {}
-
-    variant(const Status &status) : status_(status) {}
-
-    variant(Status &&status) : status_(std::move(status)) {}
-
-    variant(const T &value) : value_(value) {}
-
-    variant(T &&value) : value_(std::move(value)) {}
-
-    // This destructor must be explicitly defined because it is deleted due to
-    // the variant type having non-static data members with non-trivial
-    // destructors.
-    ~variant() {}
   };
-
-  // One of: a non-OK status or an element of type T.
-  variant variant_;
-
-  // Indicates the active member of the variant_ member.
-  //
-  // A value of true indicates that value_ is the active member of variant_.
-  //
-  // A value of false indicates that status_ is the active member of variant_.
-  bool has_value_;
 };
 
 }  // namespace asylo
@@ -435,5 +435,53 @@ TEST(StatusOrTest, ValueOrDieMovedValue) {
             static_cast<int>(error::StatusError::INVALID));
 }
 
+// Verify that ConsumeValueOrDie() moves the value out of a StatusOr object.
+TEST(StatusOrTest, ConsumeValueOrDie) {
+  std::string *str = new std::string(kStringElement);
+  StatusOr<std::unique_ptr<std::string>> statusor(
+      std::unique_ptr<std::string>{str});
+
+  std::unique_ptr<std::string> moved_value = statusor.ConsumeValueOrDie();
+  EXPECT_EQ(moved_value.get(), str);
+  EXPECT_FALSE(statusor.ok());
+  EXPECT_EQ(statusor.status().error_code(),
+            static_cast<int>(error::StatusError::INVALID));
+}
+
+// Verify that a StatusOr object can be moved into a StatusOr of a type its
+// value converts to.
+TEST(StatusOrTest, ConvertingMoveConstructor) {
+  std::string *str = new std::string(kStringElement);
+  StatusOr<std::unique_ptr<std::string>> statusor(
+      std::unique_ptr<std::string>{str});
+
+  StatusOr<std::shared_ptr<const std::string>> converted(std::move(statusor));
+  ASSERT_THAT(converted, IsOk());
+  EXPECT_EQ(converted.ValueOrDie().get(), str);
+  EXPECT_FALSE(statusor.ok());
+
+  StatusOr<std::unique_ptr<std::string>> error_statusor(
+      Status(error::GoogleError::NOT_FOUND, "not found"));
+  StatusOr<std::shared_ptr<const std::string>> converted_error(
+      std::move(error_statusor));
+  EXPECT_EQ(converted_error.status().error_code(),
+            static_cast<int>(error::GoogleError::NOT_FOUND));
+}
+
+// Verify that a StatusOr object can be copied into a StatusOr of a type its
+// value converts to.
+TEST(StatusOrTest, ConvertingCopyConstructor) {
+  StatusOr<const char *> statusor(kStringElement);
+  StatusOr<std::string> converted(statusor);
+  ASSERT_THAT(converted, IsOk());
+  EXPECT_EQ(converted.ValueOrDie(), kStringElement);
+  EXPECT_THAT(statusor, IsOk());
+}
+
+// Verify that a StatusOr is one word larger than its value.
+TEST(StatusOrTest, Size) {
+  EXPECT_EQ(sizeof(StatusOr<void *>), 2 * sizeof(void *));
+}
+
 }  // namespace
 }  // namespace asylo
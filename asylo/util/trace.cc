@@ -0,0 +1,289 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/util/trace.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <string.h>
+#include <unistd.h>
+#include <atomic>
+#include <ctime>
+#include <vector>
+
+#include "asylo/platform/common/tsc_clock.h"
+
+namespace asylo {
+namespace {
+
+// The number of records buffered by each thread before they are written out.
+constexpr uint64_t kThreadBufferCapacity = 1024;
+
+// Events recorded by one thread. The owning thread appends records at |head|,
+// and they are written out from |tail| under |trace_lock|. Buffers are never
+// freed once registered, so that the events of exited threads are written out
+// by the next flush.
+struct ThreadTraceBuffer {
+  TraceRecord records[kThreadBufferCapacity];
+  std::atomic<uint64_t> head;
+  std::atomic<uint64_t> tail;
+  uint32_t thread_id;
+  ThreadTraceBuffer *next;
+};
+
+// Head of the list of all thread buffers.
+std::atomic<ThreadTraceBuffer *> thread_buffers(nullptr);
+
+// The ID given to the next thread which records an event.
+std::atomic<uint32_t> next_thread_id(1);
+
+thread_local ThreadTraceBuffer *current_buffer = nullptr;
+
+std::atomic<bool> tracing_enabled(false);
+
+// Guards the trace file, the names and the tails of the thread buffers.
+pthread_mutex_t trace_lock = PTHREAD_MUTEX_INITIALIZER;
+int trace_fd = -1;
+
+// Interned names, indexed by name ID minus one, and the number of them which
+// have been written to the trace file.
+std::vector<const char *> *trace_names = nullptr;
+size_t trace_names_written = 0;
+
+ThreadTraceBuffer *CurrentBuffer() {
+  if (!current_buffer) {
+    ThreadTraceBuffer *buffer = new ThreadTraceBuffer();
+    buffer->head.store(0, std::memory_order_relaxed);
+    buffer->tail.store(0, std::memory_order_relaxed);
+    buffer->thread_id = next_thread_id.fetch_add(1, std::memory_order_relaxed);
+    buffer->next = thread_buffers.load(std::memory_order_relaxed);
+    while (!thread_buffers.compare_exchange_weak(buffer->next, buffer)) {
+    }
+    current_buffer = buffer;
+  }
+  return current_buffer;
+}
+
+TraceRecord MakeRecord(TraceRecordType type) {
+  TraceRecord record;
+  memset(&record, 0, sizeof(record));
+  record.type = static_cast<uint8_t>(type);
+  return record;
+}
+
+TraceRecord MakeClockRecord() {
+  TraceRecord record = MakeRecord(TraceRecordType::kClock);
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  record.timestamp = ReadTsc();
+  record.argument = static_cast<int64_t>(now.tv_sec) * 1000000000 + now.tv_nsec;
+  return record;
+}
+
+// Appends the definitions of the names not yet written to |output|. Requires
+// |trace_lock|.
+void AppendNewNames(std::vector<TraceRecord> *output) {
+  if (!trace_names) {
+    return;
+  }
+  for (; trace_names_written < trace_names->size(); ++trace_names_written) {
+    const char *name = (*trace_names)[trace_names_written];
+    size_t length = strlen(name);
+    TraceRecord record = MakeRecord(TraceRecordType::kName);
+    record.name_id = trace_names_written + 1;
+    record.argument = length;
+    output->push_back(record);
+
+    size_t text_records = (length + sizeof(TraceRecord) - 1) /
+                          sizeof(TraceRecord);
+    size_t text_start = output->size();
+    output->resize(text_start + text_records);
+    char *text = reinterpret_cast<char *>(&(*output)[text_start]);
+    memset(text, 0, text_records * sizeof(TraceRecord));
+    memcpy(text, name, length);
+  }
+}
+
+// Moves the buffered events of all threads to |output|. Requires |trace_lock|.
+void TakeBufferedEvents(std::vector<TraceRecord> *output) {
+  for (ThreadTraceBuffer *buffer =
+           thread_buffers.load(std::memory_order_acquire);
+       buffer; buffer = buffer->next) {
+    uint64_t head = buffer->head.load(std::memory_order_acquire);
+    uint64_t tail = buffer->tail.load(std::memory_order_relaxed);
+    for (; tail != head; ++tail) {
+      output->push_back(buffer->records[tail % kThreadBufferCapacity]);
+    }
+    buffer->tail.store(head, std::memory_order_release);
+  }
+}
+
+// Writes |records| to the trace file. Requires |trace_lock|.
+void WriteRecords(const std::vector<TraceRecord> &records) {
+  const char *data = reinterpret_cast<const char *>(records.data());
+  size_t size = records.size() * sizeof(TraceRecord);
+  while (size > 0) {
+    ssize_t written = write(trace_fd, data, size);
+    if (written < 0 && errno == EINTR) {
+      continue;
+    }
+    if (written <= 0) {
+      break;
+    }
+    data += written;
+    size -= written;
+  }
+}
+
+// Writes out new names and the buffered events of all threads in one write,
+// or discards the events if there is no trace file. Requires |trace_lock|.
+void DrainTrace() {
+  std::vector<TraceRecord> records;
+  AppendNewNames(&records);
+  TakeBufferedEvents(&records);
+  if (trace_fd < 0) {
+    return;
+  }
+  records.push_back(MakeClockRecord());
+  WriteRecords(records);
+}
+
+void AppendRecord(TracePhase phase, uint32_t name_id, bool has_argument,
+                  int64_t argument) {
+  ThreadTraceBuffer *buffer = CurrentBuffer();
+  uint64_t head = buffer->head.load(std::memory_order_relaxed);
+  if (head - buffer->tail.load(std::memory_order_acquire) ==
+      kThreadBufferCapacity) {
+    pthread_mutex_lock(&trace_lock);
+    DrainTrace();
+    pthread_mutex_unlock(&trace_lock);
+  }
+
+  TraceRecord *record = &buffer->records[head % kThreadBufferCapacity];
+  record->timestamp = ReadTsc();
+  record->thread_id = buffer->thread_id;
+  record->name_id = name_id;
+  record->type = static_cast<uint8_t>(TraceRecordType::kEvent);
+  record->phase = static_cast<uint8_t>(phase);
+  record->has_argument = has_argument;
+  memset(record->reserved, 0, sizeof(record->reserved));
+  record->argument = argument;
+  buffer->head.store(head + 1, std::memory_order_release);
+}
+
+}  // namespace
+
+bool EnableTracing(const std::string &path) {
+  pthread_mutex_lock(&trace_lock);
+  if (trace_fd >= 0) {
+    pthread_mutex_unlock(&trace_lock);
+    return false;
+  }
+  // Discard events left over from an earlier trace.
+  DrainTrace();
+  trace_fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+  if (trace_fd < 0) {
+    pthread_mutex_unlock(&trace_lock);
+    return false;
+  }
+
+  std::vector<TraceRecord> records;
+  TraceRecord header = MakeRecord(TraceRecordType::kHeader);
+  header.argument = kTraceMagic;
+  records.push_back(header);
+  records.push_back(MakeClockRecord());
+  trace_names_written = 0;
+  AppendNewNames(&records);
+  WriteRecords(records);
+  tracing_enabled.store(true, std::memory_order_release);
+  pthread_mutex_unlock(&trace_lock);
+  return true;
+}
+
+void DisableTracing() {
+  pthread_mutex_lock(&trace_lock);
+  if (trace_fd >= 0) {
+    tracing_enabled.store(false, std::memory_order_release);
+    DrainTrace();
+    close(trace_fd);
+    trace_fd = -1;
+  }
+  pthread_mutex_unlock(&trace_lock);
+}
+
+void FlushTrace() {
+  pthread_mutex_lock(&trace_lock);
+  if (trace_fd >= 0) {
+    DrainTrace();
+  }
+  pthread_mutex_unlock(&trace_lock);
+}
+
+bool IsTracingEnabled() {
+  return tracing_enabled.load(std::memory_order_acquire);
+}
+
+namespace trace_internal {
+
+uint32_t InternTraceName(const char *name) {
+  pthread_mutex_lock(&trace_lock);
+  if (!trace_names) {
+    trace_names = new std::vector<const char *>();
+  }
+  trace_names->push_back(name);
+  uint32_t name_id = trace_names->size();
+  pthread_mutex_unlock(&trace_lock);
+  return name_id;
+}
+
+void RecordTraceEvent(TracePhase phase, uint32_t name_id) {
+  if (IsTracingEnabled()) {
+    AppendRecord(phase, name_id, /*has_argument=*/false, 0);
+  }
+}
+
+void RecordTraceEvent(TracePhase phase, uint32_t name_id, int64_t argument) {
+  if (IsTracingEnabled()) {
+    AppendRecord(phase, name_id, /*has_argument=*/true, argument);
+  }
+}
+
+ScopedTraceEvent::ScopedTraceEvent(uint32_t name_id) : name_id_(0) {
+  if (IsTracingEnabled()) {
+    AppendRecord(TracePhase::kBegin, name_id, /*has_argument=*/false, 0);
+    name_id_ = name_id;
+  }
+}
+
+ScopedTraceEvent::ScopedTraceEvent(uint32_t name_id, int64_t argument)
+    : name_id_(0) {
+  if (IsTracingEnabled()) {
+    AppendRecord(TracePhase::kBegin, name_id, /*has_argument=*/true, argument);
+    name_id_ = name_id;
+  }
+}
+
+ScopedTraceEvent::~ScopedTraceEvent() {
+  if (name_id_ != 0 && IsTracingEnabled()) {
+    AppendRecord(TracePhase::kEnd, name_id_, /*has_argument=*/false, 0);
+  }
+}
+
+}  // namespace trace_internal
+}  // namespace asylo
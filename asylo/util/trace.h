@@ -0,0 +1,179 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_UTIL_TRACE_H_
+#define ASYLO_UTIL_TRACE_H_
+
+#include <cstdint>
+#include <string>
+
+/// \cond Internal
+#define ASYLO_TRACE_CONCAT_INNER(a, b) a##b
+#define ASYLO_TRACE_CONCAT(a, b) ASYLO_TRACE_CONCAT_INNER(a, b)
+#define ASYLO_TRACE_UNIQUE(prefix) ASYLO_TRACE_CONCAT(prefix, __LINE__)
+
+#define ASYLO_TRACE_NAME_ID(name)                                     \
+  static const uint32_t ASYLO_TRACE_UNIQUE(asylo_trace_name_id_) = \
+      ::asylo::trace_internal::InternTraceName(name)
+/// \endcond
+
+/// Traces the enclosing scope as an event named `name`.
+///
+/// `TRACE_EVENT` records a begin event when it is reached and an end event
+/// when the enclosing scope exits. An optional integer argument is recorded
+/// with the begin event. Example:
+///
+/// ```
+/// Status HandleRequest(const Request &request) {
+///   TRACE_EVENT("HandleRequest", request.size());
+///   ...
+/// }
+/// ```
+///
+/// \param name A string literal naming the event.
+#define TRACE_EVENT(name, ...)                                         \
+  ASYLO_TRACE_NAME_ID(name);                                           \
+  ::asylo::trace_internal::ScopedTraceEvent ASYLO_TRACE_UNIQUE(        \
+      asylo_trace_event_)(ASYLO_TRACE_UNIQUE(asylo_trace_name_id_), \
+                          ##__VA_ARGS__)
+
+/// Records an instant event named `name`, with an optional integer argument.
+///
+/// \param name A string literal naming the event.
+#define TRACE_EVENT_INSTANT(name, ...)                                      \
+  do {                                                                      \
+    ASYLO_TRACE_NAME_ID(name);                                              \
+    ::asylo::trace_internal::RecordTraceEvent(                              \
+        ::asylo::TracePhase::kInstant,                                      \
+        ASYLO_TRACE_UNIQUE(asylo_trace_name_id_), ##__VA_ARGS__);           \
+  } while (0)
+
+/// Records `value` as the current value of the counter named `name`.
+///
+/// \param name A string literal naming the counter.
+/// \param value The integer value of the counter.
+#define TRACE_COUNTER(name, value)                                  \
+  do {                                                              \
+    ASYLO_TRACE_NAME_ID(name);                                      \
+    ::asylo::trace_internal::RecordTraceEvent(                      \
+        ::asylo::TracePhase::kCounter,                              \
+        ASYLO_TRACE_UNIQUE(asylo_trace_name_id_), (value));         \
+  } while (0)
+
+namespace asylo {
+
+/// The phase of a trace event, using the codes of the Chrome trace event
+/// format.
+enum class TracePhase : uint8_t {
+  kBegin = 'B',
+  kEnd = 'E',
+  kInstant = 'i',
+  kCounter = 'C',
+};
+
+/// The kinds of records in a trace.
+enum class TraceRecordType : uint8_t {
+  /// The first record of a trace. Its `argument` is `kTraceMagic`.
+  kHeader = 1,
+  /// A trace event.
+  kEvent = 2,
+  /// Defines the text of the name `name_id`. Its `argument` is the length of
+  /// the text, which fills the following records, padded with zeros.
+  kName = 3,
+  /// Relates the `timestamp` time stamp counter value to the `argument` value
+  /// of the monotonic clock, in nanoseconds.
+  kClock = 4,
+};
+
+/// The value identifying the header record of a trace.
+constexpr int64_t kTraceMagic = 0x3130435254595341;  // "ASYTRC01"
+
+/// A fixed-size trace record. A trace is a sequence of these records in host
+/// byte order.
+struct TraceRecord {
+  /// The time stamp counter value at which the event happened.
+  uint64_t timestamp;
+  /// The ID of the thread that recorded the event.
+  uint32_t thread_id;
+  /// The ID of the event name.
+  uint32_t name_id;
+  /// A TraceRecordType value.
+  uint8_t type;
+  /// A TracePhase value for events.
+  uint8_t phase;
+  /// Whether `argument` was given for an event.
+  uint8_t has_argument;
+  uint8_t reserved[5];
+  /// The argument of the record.
+  int64_t argument;
+};
+
+static_assert(sizeof(TraceRecord) == 32, "TraceRecord must be 32 bytes");
+
+/// Starts recording trace events to the file at `path`, which is truncated.
+///
+/// Events are buffered per thread and written to the file in batches, so
+/// that recording an event does not leave the enclave. Tracing must not
+/// already be enabled.
+///
+/// \param path The path of the trace file.
+/// \return True if tracing was enabled.
+bool EnableTracing(const std::string &path);
+
+/// Writes out the events buffered by all threads, stops tracing and closes the
+/// trace file. Does nothing if tracing is not enabled. Events recorded
+/// concurrently with this call may be lost.
+void DisableTracing();
+
+/// Writes out the events buffered by all threads.
+void FlushTrace();
+
+/// Returns whether tracing is enabled.
+bool IsTracingEnabled();
+
+/// \cond Internal
+namespace trace_internal {
+
+// Returns the ID of |name|, which must have static storage duration.
+uint32_t InternTraceName(const char *name);
+
+// Records an event with phase |phase| for the name |name_id|.
+void RecordTraceEvent(TracePhase phase, uint32_t name_id);
+void RecordTraceEvent(TracePhase phase, uint32_t name_id, int64_t argument);
+
+// Records a begin event on construction and an end event on destruction.
+class ScopedTraceEvent {
+ public:
+  explicit ScopedTraceEvent(uint32_t name_id);
+  ScopedTraceEvent(uint32_t name_id, int64_t argument);
+  ~ScopedTraceEvent();
+
+  ScopedTraceEvent(const ScopedTraceEvent &) = delete;
+  ScopedTraceEvent &operator=(const ScopedTraceEvent &) = delete;
+
+ private:
+  // The name of the event, or zero if tracing was disabled when it began.
+  uint32_t name_id_;
+};
+
+}  // namespace trace_internal
+/// \endcond
+
+}  // namespace asylo
+
+#endif  // ASYLO_UTIL_TRACE_H_
@@ -0,0 +1,149 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/util/trace_decoder.h"
+
+#include <string.h>
+#include <cstdio>
+#include <unordered_map>
+#include <vector>
+
+#include "asylo/util/trace.h"
+
+namespace asylo {
+namespace {
+
+// Appends |text| to |json| as a JSON string.
+void AppendJsonString(const std::string &text, std::string *json) {
+  json->push_back('"');
+  for (char c : text) {
+    if (c == '"' || c == '\\') {
+      json->push_back('\\');
+      json->push_back(c);
+    } else if (static_cast<unsigned char>(c) < 0x20) {
+      char escape[8];
+      snprintf(escape, sizeof(escape), "\\u%04x", c);
+      json->append(escape);
+    } else {
+      json->push_back(c);
+    }
+  }
+  json->push_back('"');
+}
+
+Status InvalidTrace(const std::string &message) {
+  return Status(error::GoogleError::INVALID_ARGUMENT,
+                "Invalid trace: " + message);
+}
+
+}  // namespace
+
+Status DecodeTraceToChromeJson(const std::string &trace, std::string *json) {
+  if (trace.size() % sizeof(TraceRecord) != 0) {
+    return InvalidTrace("size is not a multiple of the record size");
+  }
+  std::vector<TraceRecord> records(trace.size() / sizeof(TraceRecord));
+  memcpy(records.data(), trace.data(), trace.size());
+  if (records.empty() ||
+      records[0].type != static_cast<uint8_t>(TraceRecordType::kHeader) ||
+      records[0].argument != kTraceMagic) {
+    return InvalidTrace("missing header");
+  }
+
+  // Collect the names and the first and last clock records.
+  std::unordered_map<uint32_t, std::string> names;
+  const TraceRecord *first_clock = nullptr;
+  const TraceRecord *last_clock = nullptr;
+  for (size_t i = 1; i < records.size(); ++i) {
+    const TraceRecord &record = records[i];
+    if (record.type == static_cast<uint8_t>(TraceRecordType::kName)) {
+      size_t length = record.argument;
+      size_t text_records =
+          (length + sizeof(TraceRecord) - 1) / sizeof(TraceRecord);
+      if (record.argument < 0 || text_records > records.size() - i - 1) {
+        return InvalidTrace("truncated name");
+      }
+      names[record.name_id].assign(
+          reinterpret_cast<const char *>(&records[i + 1]), length);
+      i += text_records;
+    } else if (record.type == static_cast<uint8_t>(TraceRecordType::kClock)) {
+      if (!first_clock) {
+        first_clock = &record;
+      }
+      last_clock = &record;
+    }
+  }
+  if (!first_clock) {
+    return InvalidTrace("missing clock record");
+  }
+  double nanoseconds_per_tick = 1.0;
+  if (last_clock->timestamp > first_clock->timestamp) {
+    nanoseconds_per_tick =
+        static_cast<double>(last_clock->argument - first_clock->argument) /
+        (last_clock->timestamp - first_clock->timestamp);
+  }
+
+  json->assign("{\"traceEvents\":[");
+  bool first_event = true;
+  for (size_t i = 1; i < records.size(); ++i) {
+    const TraceRecord &record = records[i];
+    if (record.type == static_cast<uint8_t>(TraceRecordType::kName)) {
+      i += (record.argument + sizeof(TraceRecord) - 1) / sizeof(TraceRecord);
+      continue;
+    }
+    if (record.type != static_cast<uint8_t>(TraceRecordType::kEvent)) {
+      continue;
+    }
+    auto name = names.find(record.name_id);
+    if (name == names.end()) {
+      return InvalidTrace("undefined name " + std::to_string(record.name_id));
+    }
+
+    double microseconds =
+        static_cast<int64_t>(record.timestamp - first_clock->timestamp) *
+        nanoseconds_per_tick / 1000;
+    char timestamp[32];
+    snprintf(timestamp, sizeof(timestamp), "%.3f", microseconds);
+
+    if (!first_event) {
+      json->push_back(',');
+    }
+    first_event = false;
+    json->append("{\"name\":");
+    AppendJsonString(name->second, json);
+    json->append(",\"ph\":\"");
+    json->push_back(static_cast<char>(record.phase));
+    json->append("\",\"ts\":");
+    json->append(timestamp);
+    json->append(",\"pid\":1,\"tid\":");
+    json->append(std::to_string(record.thread_id));
+    if (record.phase == static_cast<uint8_t>(TracePhase::kInstant)) {
+      json->append(",\"s\":\"t\"");
+    }
+    if (record.has_argument) {
+      json->append(",\"args\":{\"value\":");
+      json->append(std::to_string(record.argument));
+      json->push_back('}');
+    }
+    json->push_back('}');
+  }
+  json->append("]}\n");
+  return Status::OkStatus();
+}
+
+}  // namespace asylo
@@ -0,0 +1,41 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_UTIL_TRACE_DECODER_H_
+#define ASYLO_UTIL_TRACE_DECODER_H_
+
+#include <string>
+
+#include "asylo/util/status.h"
+
+namespace asylo {
+
+/// Decodes a binary trace written by EnableTracing() into the JSON trace event
+/// format, which can be loaded by chrome://tracing and by Perfetto.
+///
+/// Time stamp counter values are converted to microseconds since the first
+/// clock record of the trace, using the clock records written by the tracer.
+///
+/// \param trace The contents of a trace file.
+/// \param json The decoded trace.
+/// \return An INVALID_ARGUMENT error if `trace` is not a valid trace.
+Status DecodeTraceToChromeJson(const std::string &trace, std::string *json);
+
+}  // namespace asylo
+
+#endif  // ASYLO_UTIL_TRACE_DECODER_H_
@@ -0,0 +1,109 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/util/trace.h"
+
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include "asylo/test/util/status_matchers.h"
+#include "asylo/test/util/test_flags.h"
+#include "asylo/util/trace_decoder.h"
+
+namespace asylo {
+namespace {
+
+using ::testing::HasSubstr;
+using ::testing::Not;
+
+std::string ReadFile(const std::string &path) {
+  std::ifstream file(path, std::ios::binary);
+  std::stringstream contents;
+  contents << file.rdbuf();
+  return contents.str();
+}
+
+// Returns the number of non-overlapping occurrences of |pattern| in |text|.
+int CountOccurrences(const std::string &text, const std::string &pattern) {
+  int count = 0;
+  for (size_t position = text.find(pattern); position != std::string::npos;
+       position = text.find(pattern, position + pattern.size())) {
+    ++count;
+  }
+  return count;
+}
+
+// Verify that events recorded on several threads, including more than fit in
+// a thread buffer, are all decoded with their names and arguments.
+TEST(TraceTest, EventsAreDecoded) {
+  std::string path = FLAGS_test_tmpdir + "/trace_test.trace";
+  ASSERT_TRUE(EnableTracing(path));
+  EXPECT_TRUE(IsTracingEnabled());
+  EXPECT_FALSE(EnableTracing(path));
+
+  constexpr int kThreads = 4;
+  constexpr int kEventsPerThread = 3000;
+  std::vector<std::thread> threads;
+  for (int i = 0; i < kThreads; ++i) {
+    threads.emplace_back([] {
+      for (int j = 0; j < kEventsPerThread; ++j) {
+        TRACE_EVENT("\"work\"", j);
+      }
+    });
+  }
+  for (std::thread &thread : threads) {
+    thread.join();
+  }
+  TRACE_EVENT_INSTANT("instant");
+  TRACE_COUNTER("counter", 42);
+  DisableTracing();
+  EXPECT_FALSE(IsTracingEnabled());
+  TRACE_EVENT_INSTANT("after disable");
+
+  std::string json;
+  ASSERT_THAT(DecodeTraceToChromeJson(ReadFile(path), &json), IsOk());
+  EXPECT_EQ(CountOccurrences(json, "{\"name\":\"\\\"work\\\"\",\"ph\":\"B\""),
+            kThreads * kEventsPerThread);
+  EXPECT_EQ(CountOccurrences(json, "{\"name\":\"\\\"work\\\"\",\"ph\":\"E\""),
+            kThreads * kEventsPerThread);
+  EXPECT_THAT(json, HasSubstr("\"args\":{\"value\":2999}"));
+  EXPECT_THAT(json, HasSubstr("{\"name\":\"instant\",\"ph\":\"i\""));
+  EXPECT_THAT(json, HasSubstr("{\"name\":\"counter\",\"ph\":\"C\""));
+  EXPECT_THAT(json, HasSubstr("\"args\":{\"value\":42}"));
+  EXPECT_THAT(json, Not(HasSubstr("after disable")));
+}
+
+// Verify that the decoder rejects data that is not a trace.
+TEST(TraceTest, DecoderRejectsInvalidTrace) {
+  std::string json;
+  EXPECT_THAT(DecodeTraceToChromeJson("", &json),
+              StatusIs(error::GoogleError::INVALID_ARGUMENT));
+  EXPECT_THAT(DecodeTraceToChromeJson(std::string(sizeof(TraceRecord), 'x'),
+                                      &json),
+              StatusIs(error::GoogleError::INVALID_ARGUMENT));
+  EXPECT_THAT(DecodeTraceToChromeJson(std::string(5, '\0'), &json),
+              StatusIs(error::GoogleError::INVALID_ARGUMENT));
+}
+
+}  // namespace
+}  // namespace asylo
@@ -0,0 +1,67 @@
+/*
+ *
+ * Copyright 2018 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+// Converts a binary trace written by asylo::EnableTracing() to the JSON trace
+// event format.
+//
+// Usage: trace_to_json <trace file> [<output file>]
+//
+// The JSON trace is written to standard output if no output file is given.
+
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+#include "asylo/util/status.h"
+#include "asylo/util/trace_decoder.h"
+
+int main(int argc, char *argv[]) {
+  if (argc != 2 && argc != 3) {
+    fprintf(stderr, "Usage: %s <trace file> [<output file>]\n", argv[0]);
+    return 1;
+  }
+
+  std::ifstream input(argv[1], std::ios::binary);
+  if (!input) {
+    fprintf(stderr, "Failed to open %s\n", argv[1]);
+    return 1;
+  }
+  std::stringstream trace;
+  trace << input.rdbuf();
+
+  std::string json;
+  asylo::Status status = asylo::DecodeTraceToChromeJson(trace.str(), &json);
+  if (!status.ok()) {
+    fprintf(stderr, "%s\n", status.ToString().c_str());
+    return 1;
+  }
+
+  if (argc == 2) {
+    std::cout << json;
+    return 0;
+  }
+  std::ofstream output(argv[2]);
+  output << json;
+  if (!output) {
+    fprintf(stderr, "Failed to write %s\n", argv[2]);
+    return 1;
+  }
+  return 0;
+}